@@ -6,28 +6,57 @@
 
 #include <jni.h>
 #include <assert.h>
+#include <pthread.h>
 #include "BRCoreJni.h"
 
 static JavaVM *jvm = NULL;
 
+//
+// The JNIEnv of each native (Core) thread, cached once the thread is attached.  A thread that
+// exits while still attached is detached by the key's destructor.
+//
+static pthread_key_t envKey;
+static pthread_once_t envKeyOnce = PTHREAD_ONCE_INIT;
+
+static void
+envKeyDestructor (void *env) {
+    if (NULL != jvm)
+        (*jvm)->DetachCurrentThread (jvm);
+}
+
+static void
+envKeyCreate (void) {
+    pthread_key_create (&envKey, envKeyDestructor);
+}
+
 extern
 JNIEnv *getEnv() {
     JNIEnv *env;
 
     if (NULL == jvm) return NULL;
 
+    pthread_once (&envKeyOnce, envKeyCreate);
+    env = (JNIEnv *) pthread_getspecific (envKey);
+    if (NULL != env) return env;
+
     int status = (*jvm)->GetEnv(jvm, (void **) &env, JNI_VERSION_1_6);
 
-    if (status != JNI_OK)
-      status = (*jvm)->AttachCurrentThread(jvm, (JNIEnv **) &env, NULL);
+    // Only threads attached here are cached (and detached on exit); Java threads are not ours.
+    if (status != JNI_OK) {
+        status = (*jvm)->AttachCurrentThread(jvm, (JNIEnv **) &env, NULL);
+        if (status == JNI_OK) pthread_setspecific (envKey, env);
+    }
 
     return status == JNI_OK ? env : NULL;
 }
 
 extern
 void releaseEnv () {
-    if (NULL != jvm)
+    if (NULL != jvm) {
+        pthread_once (&envKeyOnce, envKeyCreate);
+        pthread_setspecific (envKey, NULL);
         (*jvm)->DetachCurrentThread (jvm);
+    }
 }
 
 JNIEXPORT jint JNICALL
@@ -40,6 +69,9 @@ JNI_OnLoad (JavaVM *theJvm, void *reserved) {
 
     jvm = theJvm;
 
+    // Resolve, once, the IDs used on every native call.
+    initializeJNIReference (env);
+
     return JNI_VERSION_1_6;
 }
 
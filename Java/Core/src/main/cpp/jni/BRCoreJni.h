@@ -32,6 +32,15 @@ getJNIReference (
         JNIEnv *env,
         jobject thisObject);
 
+/**
+ * Resolve the BRCoreJniReference field ID used by getJNIReference(); called from JNI_OnLoad.
+ *
+ * @param env
+ */
+extern void
+initializeJNIReference (
+        JNIEnv *env);
+
 //
 // Support
 //
@@ -11,10 +11,34 @@
 #define JNI_REFERENCE_ADDRESS_FIELD_NAME "jniReferenceAddress"
 #define JNI_REFERENCE_ADDRESS_FIELD_TYPE "J" // long
 
+#define JNI_REFERENCE_CLASS_NAME "com/breadwallet/core/BRCoreJniReference"
+
+// Every JNI reference class derives from BRCoreJniReference; one field ID serves them all.
+static jclass jniReferenceClass = NULL;
+static jfieldID jniReferenceField = NULL;
+
+extern void initializeJNIReference (
+        JNIEnv *env)
+{
+    if (NULL != jniReferenceField) return;
+
+    jclass thisClass = (*env)->FindClass (env, JNI_REFERENCE_CLASS_NAME);
+    assert (NULL != thisClass);
+    jniReferenceClass = (*env)->NewGlobalRef (env, thisClass);
+    (*env)->DeleteLocalRef (env, thisClass);
+
+    jniReferenceField = (*env)->GetFieldID(env, jniReferenceClass,
+                                           JNI_REFERENCE_ADDRESS_FIELD_NAME,
+                                           JNI_REFERENCE_ADDRESS_FIELD_TYPE);
+    assert (NULL != jniReferenceField);
+}
+
 static jfieldID getJNIReferenceField (
         JNIEnv *env,
         jobject thisObject)
 {
+    if (NULL != jniReferenceField) return jniReferenceField;
+
     jclass thisClass = (*env)->GetObjectClass (env, thisObject);
     jfieldID thisFieldId = (*env)->GetFieldID(env, thisClass,
                               JNI_REFERENCE_ADDRESS_FIELD_NAME,
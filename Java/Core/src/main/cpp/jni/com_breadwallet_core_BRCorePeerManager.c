@@ -45,6 +45,16 @@ static jmethodID blockConstructor;
 static jclass peerClass;
 static jmethodID peerConstructor;
 
+// BRCorePeerManager.Listener methods - resolved once, from the interface, for every callback
+static jclass listenerClass;
+static jmethodID listenerSyncStarted;
+static jmethodID listenerSyncStopped;
+static jmethodID listenerTxStatusUpdate;
+static jmethodID listenerSaveBlocks;
+static jmethodID listenerSavePeers;
+static jmethodID listenerNetworkIsReachable;
+static jmethodID listenerTxPublished;
+
 /*
  * Class:     com_breadwallet_core_BRCorePeerManager
  * Method:    getConnectStatusValue
@@ -435,6 +445,13 @@ Java_com_breadwallet_core_BRCorePeerManager_disposeNative
     }
 }
 
+static jmethodID
+lookupListenerMethod (JNIEnv *env, char *name, char *type) {
+    jmethodID listenerMethod = (*env)->GetMethodID(env, listenerClass, name, type);
+    assert (NULL != listenerMethod);
+    return listenerMethod;
+}
+
 /*
  * Class:     com_breadwallet_core_BRCorePeerManager
  * Method:    initializeNative
@@ -455,22 +472,23 @@ JNIEXPORT void JNICALL Java_com_breadwallet_core_BRCorePeerManager_initializeNat
 
     peerConstructor = (*env)->GetMethodID(env, peerClass, "<init>", "(J)V");
     assert (NULL != peerConstructor);
+
+    listenerClass = (*env)->FindClass(env, "com/breadwallet/core/BRCorePeerManager$Listener");
+    assert (NULL != listenerClass);
+    listenerClass = (*env)->NewGlobalRef (env, listenerClass);
+
+    listenerSyncStarted        = lookupListenerMethod (env, "syncStarted",        "()V");
+    listenerSyncStopped        = lookupListenerMethod (env, "syncStopped",        "(Ljava/lang/String;)V");
+    listenerTxStatusUpdate     = lookupListenerMethod (env, "txStatusUpdate",     "()V");
+    listenerSaveBlocks         = lookupListenerMethod (env, "saveBlocks",         "(Z[Lcom/breadwallet/core/BRCoreMerkleBlock;)V");
+    listenerSavePeers          = lookupListenerMethod (env, "savePeers",          "(Z[Lcom/breadwallet/core/BRCorePeer;)V");
+    listenerNetworkIsReachable = lookupListenerMethod (env, "networkIsReachable", "()Z");
+    listenerTxPublished        = lookupListenerMethod (env, "txPublished",        "(Ljava/lang/String;)V");
 }
 
 //
 // Callbacks
 //
-static jmethodID
-lookupListenerMethod (JNIEnv *env, jobject listener, char *name, char *type) {
-    jclass listenerClass = (*env)->GetObjectClass(env, listener);
-
-    // Method, if found.
-    jmethodID listenerMethod = (*env)->GetMethodID(env, listenerClass, name, type);
-
-    // Clean up and return.
-    (*env)->DeleteLocalRef (env, listenerClass);
-    return listenerMethod;
-}
 
 static void
 syncStarted(void *info) {
@@ -480,10 +498,7 @@ syncStarted(void *info) {
     jobject listener = (*env)->NewLocalRef (env, (jobject) info);
     if ((*env)->IsSameObject (env, listener, NULL)) return; // GC reclaimed
 
-    jmethodID listenerMethod =
-            lookupListenerMethod(env, listener,
-                                 "syncStarted",
-                                 "()V");
+    jmethodID listenerMethod = listenerSyncStarted;
     (*env)->CallVoidMethod(env, listener, listenerMethod);
     (*env)->DeleteLocalRef (env, listener);
 }
@@ -496,10 +511,7 @@ syncStopped(void *info, int error) {
     jobject listener = (*env)->NewLocalRef (env, (jobject) info);
     if ((*env)->IsSameObject (env, listener, NULL)) return; // GC reclaimed
 
-    jmethodID listenerMethod =
-            lookupListenerMethod(env, listener,
-                                 "syncStopped",
-                                 "(Ljava/lang/String;)V");
+    jmethodID listenerMethod = listenerSyncStopped;
 
     jstring errorString = (*env)->NewStringUTF (env, (error == 0 ? "" : strerror (error)));
 
@@ -516,10 +528,7 @@ txStatusUpdate(void *info) {
     jobject listener = (*env)->NewLocalRef (env, (jobject) info);
     if ((*env)->IsSameObject (env, listener, NULL)) return; // GC reclaimed
 
-    jmethodID listenerMethod =
-            lookupListenerMethod(env, listener,
-                                 "txStatusUpdate",
-                                 "()V");
+    jmethodID listenerMethod = listenerTxStatusUpdate;
 
     (*env)->CallVoidMethod(env, listener, listenerMethod);
     (*env)->DeleteLocalRef (env, listener);
@@ -534,10 +543,7 @@ saveBlocks(void *info, int replace, BRMerkleBlock *blocks[], size_t blockCount)
     if ((*env)->IsSameObject (env, listener, NULL)) return; // GC reclaimed
 
     // The saveBlocks callback
-    jmethodID listenerMethod =
-            lookupListenerMethod(env, listener,
-                                 "saveBlocks",
-                                 "(Z[Lcom/breadwallet/core/BRCoreMerkleBlock;)V");
+    jmethodID listenerMethod = listenerSaveBlocks;
     assert (NULL != listenerMethod);
 
     // Create the Java BRCoreMerkleBlock array
@@ -566,10 +572,7 @@ savePeers(void *info, int replace, const BRPeer peers[], size_t count) {
     if ((*env)->IsSameObject (env, listener, NULL)) return; // GC reclaimed
 
     // The savePeers callback
-    jmethodID listenerMethod =
-            lookupListenerMethod(env, listener,
-                                 "savePeers",
-                                 "(Z[Lcom/breadwallet/core/BRCorePeer;)V");
+    jmethodID listenerMethod = listenerSavePeers;
     assert (NULL != listenerMethod);
 
     jobjectArray peerArray = (*env)->NewObjectArray(env, count, peerClass, 0);
@@ -599,10 +602,7 @@ networkIsReachable(void *info) {
     jobject listener = (*env)->NewLocalRef(env, (jobject) info);
     if ((*env)->IsSameObject (env, listener, NULL)) return 0; // GC reclaimed
 
-    jmethodID listenerMethod =
-            lookupListenerMethod(env, listener,
-                                 "networkIsReachable",
-                                 "()Z");
+    jmethodID listenerMethod = listenerNetworkIsReachable;
     assert (NULL != listenerMethod);
 
     int networkIsOn = (*env)->CallBooleanMethod(env, listener, listenerMethod);
@@ -626,10 +626,7 @@ txPublished (void *info, int error) {
     // If listener was GS reclaimed, skip the callback
     if ((*env)->IsSameObject (env, listener, NULL)) return;
 
-    jmethodID listenerMethod =
-            lookupListenerMethod(env, listener,
-                                 "txPublished",
-                                 "(Ljava/lang/String;)V");
+    jmethodID listenerMethod = listenerTxPublished;
     assert (NULL != listenerMethod);
 
     jstring errorString = (*env)->NewStringUTF (env, (error == 0 ? "" : strerror (error)));
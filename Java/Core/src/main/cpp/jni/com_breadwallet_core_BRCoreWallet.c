@@ -5,6 +5,7 @@
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "BRCoreJni.h"
 #include "support/BRAddress.h"
@@ -29,6 +30,7 @@ JNI_COPY_TRANSACTION (BRTransaction *tx) {
 }
 
 /* Forward Declarations */
+static jmethodID lookupListenerMethod (JNIEnv *env, char *name, char *type);
 static void balanceChanged(void *info, uint64_t balance);
 static void txAdded(void *info, BRTransaction *tx);
 static void txUpdated(void *info, const UInt256 txHashes[], size_t count,
@@ -45,6 +47,13 @@ static jmethodID addressConstructor;
 static jclass transactionClass;
 static jmethodID transactionConstructor;
 
+// BRCoreWallet.Listener methods - resolved once, from the interface, for every callback
+static jclass listenerClass;
+static jmethodID listenerBalanceChanged;
+static jmethodID listenerTxAdded;
+static jmethodID listenerTxUpdated;
+static jmethodID listenerTxDeleted;
+
 
 /*
  * Class:     com_breadwallet_core_BRCoreWallet
@@ -165,6 +174,48 @@ Java_com_breadwallet_core_BRCoreWallet_getAllAddresses
     return addrArray;
 }
 
+/*
+ * Class:     com_breadwallet_core_BRCoreWallet
+ * Method:    jniFillAllAddresses
+ * Signature: (Ljava/nio/ByteBuffer;)I
+ *
+ * Fill the direct `buffer` with all addresses as:
+ *    uint32 count, then count * { uint8 length, length * char }  (little endian)
+ * Return the number of bytes required; `buffer` is only filled if its capacity is sufficient.
+ */
+JNIEXPORT jint JNICALL
+Java_com_breadwallet_core_BRCoreWallet_jniFillAllAddresses
+        (JNIEnv *env, jobject thisObject, jobject buffer) {
+    BRWallet *wallet = (BRWallet *) getJNIReference (env, thisObject);
+
+    uint8_t *bytes    = (*env)->GetDirectBufferAddress (env, buffer);
+    size_t bytesCount = (size_t) (*env)->GetDirectBufferCapacity (env, buffer);
+    assert (NULL != bytes);
+
+    size_t addrCount = BRWalletAllAddrs (wallet, NULL, 0);
+    BRAddress *addresses = (BRAddress *) calloc (addrCount, sizeof (BRAddress));
+    addrCount = BRWalletAllAddrs (wallet, addresses, addrCount);
+
+    size_t offset = sizeof (uint32_t);
+    for (size_t index = 0; index < addrCount; index++)
+        offset += 1 + strlen (addresses[index].s);
+
+    if (offset <= bytesCount) {
+        UInt32SetLE (bytes, (uint32_t) addrCount);
+
+        for (size_t index = 0, fill = sizeof (uint32_t); index < addrCount; index++) {
+            size_t length = strlen (addresses[index].s);
+            bytes[fill++] = (uint8_t) length;
+            memcpy (&bytes[fill], addresses[index].s, length);
+            fill += length;
+        }
+    }
+
+    if (NULL != addresses) free (addresses);
+
+    return (jint) offset;
+}
+
 
 /*
  * Class:     com_breadwallet_core_BRCoreWallet
@@ -227,6 +278,60 @@ Java_com_breadwallet_core_BRCoreWallet_jniGetTransactions
     return transactionArray;
 }
 
+/*
+ * Class:     com_breadwallet_core_BRCoreWallet
+ * Method:    jniFillTransactions
+ * Signature: (Ljava/nio/ByteBuffer;)I
+ *
+ * Fill the direct `buffer` with all transactions as:
+ *    uint32 count, then count * { uint8[32] txHash, uint32 blockHeight, uint32 timestamp,
+ *                                 uint32 length, length * uint8 serialization }  (little endian)
+ * Return the number of bytes required; `buffer` is only filled if its capacity is sufficient.
+ */
+JNIEXPORT jint JNICALL
+Java_com_breadwallet_core_BRCoreWallet_jniFillTransactions
+        (JNIEnv *env, jobject thisObject, jobject buffer) {
+    BRWallet  *wallet  = (BRWallet  *) getJNIReference (env, thisObject);
+
+    uint8_t *bytes    = (*env)->GetDirectBufferAddress (env, buffer);
+    size_t bytesCount = (size_t) (*env)->GetDirectBufferCapacity (env, buffer);
+    assert (NULL != bytes);
+
+    size_t transactionCount = BRWalletTransactions (wallet, NULL, 0);
+    BRTransaction **transactions = (BRTransaction **) calloc (transactionCount, sizeof (BRTransaction *));
+    transactionCount = BRWalletTransactions (wallet, transactions, transactionCount);
+
+    size_t offset = sizeof (uint32_t);
+    size_t *lengths = (size_t *) calloc (transactionCount, sizeof (size_t));
+    for (size_t index = 0; index < transactionCount; index++) {
+        lengths[index] = BRTransactionSerialize (transactions[index], NULL, 0);
+        offset += sizeof (UInt256) + 3 * sizeof (uint32_t) + lengths[index];
+    }
+
+    if (offset <= bytesCount) {
+        UInt32SetLE (bytes, (uint32_t) transactionCount);
+
+        for (size_t index = 0, fill = sizeof (uint32_t); index < transactionCount; index++) {
+            BRTransaction *transaction = transactions[index];
+
+            UInt256Set (&bytes[fill], transaction->txHash);
+            fill += sizeof (UInt256);
+            UInt32SetLE (&bytes[fill], transaction->blockHeight);
+            fill += sizeof (uint32_t);
+            UInt32SetLE (&bytes[fill], transaction->timestamp);
+            fill += sizeof (uint32_t);
+            UInt32SetLE (&bytes[fill], (uint32_t) lengths[index]);
+            fill += sizeof (uint32_t);
+            fill += BRTransactionSerialize (transaction, &bytes[fill], lengths[index]);
+        }
+    }
+
+    if (NULL != lengths) free (lengths);
+    if (NULL != transactions) free (transactions);
+
+    return (jint) offset;
+}
+
 /*
  * Class:     com_breadwallet_core_BRCoreWallet
  * Method:    getTransactionsConfirmedBefore
@@ -679,21 +784,24 @@ JNIEXPORT void JNICALL Java_com_breadwallet_core_BRCoreWallet_initializeNative
 
     transactionConstructor = (*env)->GetMethodID(env, transactionClass, "<init>", "(J)V");
     assert (NULL != transactionConstructor);
+
+    listenerClass = (*env)->FindClass(env, "com/breadwallet/core/BRCoreWallet$Listener");
+    assert (NULL != listenerClass);
+    listenerClass = (*env)->NewGlobalRef (env, listenerClass);
+
+    listenerBalanceChanged = lookupListenerMethod (env, "balanceChanged", "(J)V");
+    listenerTxAdded        = lookupListenerMethod (env, "onTxAdded",      "(Lcom/breadwallet/core/BRCoreTransaction;)V");
+    listenerTxUpdated      = lookupListenerMethod (env, "onTxUpdated",    "(Ljava/lang/String;II)V");
+    listenerTxDeleted      = lookupListenerMethod (env, "onTxDeleted",    "(Ljava/lang/String;II)V");
 }
 
 //
 //
 //
 static jmethodID
-lookupListenerMethod (JNIEnv *env, jobject listener, char *name, char *type) {
-    // Class with desired method.
-    jclass listenerClass = (*env)->GetObjectClass(env, listener);
-
-    // Method, if found.
+lookupListenerMethod (JNIEnv *env, char *name, char *type) {
     jmethodID listenerMethod = (*env)->GetMethodID(env, listenerClass, name, type);
-
-    // Clean up and return.
-    (*env)->DeleteLocalRef (env, listenerClass);
+    assert (NULL != listenerMethod);
     return listenerMethod;
 }
 
@@ -706,10 +814,7 @@ balanceChanged(void *info, uint64_t balance) {
     if ((*env)->IsSameObject (env, listener, NULL)) return; // GC reclaimed
 
     // The onBalanceChanged callback
-    jmethodID listenerMethod =
-            lookupListenerMethod(env, listener,
-                                 "balanceChanged",
-                                 "(J)V");
+    jmethodID listenerMethod = listenerBalanceChanged;
     assert (NULL != listenerMethod);
 
     (*env)->CallVoidMethod(env, listener, listenerMethod, balance);
@@ -727,10 +832,7 @@ txAdded(void *info, BRTransaction *tx) {
     if ((*env)->IsSameObject (env, listener, NULL)) return; // GC reclaimed
 
     // The onTxAdded listener
-    jmethodID listenerMethod =
-            lookupListenerMethod(env, listener,
-                                 "onTxAdded",
-                                 "(Lcom/breadwallet/core/BRCoreTransaction;)V");
+    jmethodID listenerMethod = listenerTxAdded;
     assert (NULL != listenerMethod);
 
     // Create the BRCoreTransaction
@@ -756,10 +858,7 @@ txUpdated(void *info, const UInt256 txHashes[], size_t count, uint32_t blockHeig
     if ((*env)->IsSameObject (env, listener, NULL)) return; // GC reclaimed
 
     // The onTxUpdated callback
-    jmethodID listenerMethod =
-            lookupListenerMethod(env, listener,
-                                 "onTxUpdated",
-                                 "(Ljava/lang/String;II)V");
+    jmethodID listenerMethod = listenerTxUpdated;
     assert (NULL != listenerMethod);
 
     // Invoke the callback for each of txHashes.
@@ -784,10 +883,7 @@ txDeleted(void *info, UInt256 txHash, int notifyUser, int recommendRescan) {
     if ((*env)->IsSameObject (env, listener, NULL)) return; // GC reclaimed
 
     // The onTxDeleted callback
-    jmethodID listenerMethod =
-            lookupListenerMethod(env, listener,
-                                 "onTxDeleted",
-                                 "(Ljava/lang/String;II)V");
+    jmethodID listenerMethod = listenerTxDeleted;
     assert (NULL != listenerMethod);
 
     // Invoke the callback for the provided txHash
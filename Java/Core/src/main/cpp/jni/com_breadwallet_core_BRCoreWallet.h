@@ -47,6 +47,14 @@ JNIEXPORT jobject JNICALL Java_com_breadwallet_core_BRCoreWallet_getLegacyAddres
 JNIEXPORT jobjectArray JNICALL Java_com_breadwallet_core_BRCoreWallet_getAllAddresses
   (JNIEnv *, jobject);
 
+/*
+ * Class:     com_breadwallet_core_BRCoreWallet
+ * Method:    jniFillAllAddresses
+ * Signature: (Ljava/nio/ByteBuffer;)I
+ */
+JNIEXPORT jint JNICALL Java_com_breadwallet_core_BRCoreWallet_jniFillAllAddresses
+  (JNIEnv *, jobject, jobject);
+
 /*
  * Class:     com_breadwallet_core_BRCoreWallet
  * Method:    containsAddress
@@ -71,6 +79,14 @@ JNIEXPORT jboolean JNICALL Java_com_breadwallet_core_BRCoreWallet_addressIsUsed
 JNIEXPORT jobjectArray JNICALL Java_com_breadwallet_core_BRCoreWallet_jniGetTransactions
   (JNIEnv *, jobject);
 
+/*
+ * Class:     com_breadwallet_core_BRCoreWallet
+ * Method:    jniFillTransactions
+ * Signature: (Ljava/nio/ByteBuffer;)I
+ */
+JNIEXPORT jint JNICALL Java_com_breadwallet_core_BRCoreWallet_jniFillTransactions
+  (JNIEnv *, jobject, jobject);
+
 /*
  * Class:     com_breadwallet_core_BRCoreWallet
  * Method:    getTransactionsConfirmedBefore
@@ -10,6 +10,8 @@
 package com.breadwallet.core;
 
 import java.lang.ref.WeakReference;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 
 /**
  *
@@ -42,6 +44,11 @@ public class BRCoreWallet extends BRCoreJniReference
     //
     protected WeakReference<Listener> listener = null;
 
+    //
+    // The initial capacity of a bulk ByteBuffer; grown, once, to the required size.
+    //
+    private static final int BULK_BUFFER_INITIAL_CAPACITY = 64 * 1024;
+
     //
     //
     //
@@ -85,6 +92,25 @@ public class BRCoreWallet extends BRCoreJniReference
     // returns the number addresses written, or total number available if addrs is NULL
     public native BRCoreAddress[] getAllAddresses ();
 
+    /**
+     * As getAllAddresses() but return all addresses in one direct, little-endian ByteBuffer,
+     * without creating a BRCoreAddress per address.  The layout is:
+     * <pre>
+     *     int count, then count * { byte length, length * ASCII char }
+     * </pre>
+     * @return
+     */
+    public ByteBuffer getAllAddressesBuffer () {
+        ByteBuffer buffer = ByteBuffer.allocateDirect(BULK_BUFFER_INITIAL_CAPACITY);
+        int size;
+        while ((size = jniFillAllAddresses(buffer)) > buffer.capacity())
+            buffer = ByteBuffer.allocateDirect(size);
+        buffer.limit(size);
+        return buffer.order(ByteOrder.LITTLE_ENDIAN);
+    }
+
+    private native int jniFillAllAddresses (ByteBuffer buffer);
+
     // true if the address was previously generated by BRWalletUnusedAddrs() (even if it's now used)
     // int BRWalletContainsAddress(BRWallet *wallet, const char *addr);
     public native boolean containsAddress (BRCoreAddress address);
@@ -113,6 +139,27 @@ public class BRCoreWallet extends BRCoreJniReference
      */
     private native BRCoreTransaction[] jniGetTransactions ();
 
+    /**
+     * As getTransactions() but return all transactions in one direct, little-endian ByteBuffer,
+     * without creating a BRCoreTransaction per transaction.  The layout is:
+     * <pre>
+     *     int count, then count * { byte[32] hash, int blockHeight, int timestamp,
+     *                               int length, byte[length] serialization }
+     * </pre>
+     * A serialization may be passed to BRCoreTransaction(byte[], long, long) if needed.
+     * @return
+     */
+    public ByteBuffer getTransactionsBuffer () {
+        ByteBuffer buffer = ByteBuffer.allocateDirect(BULK_BUFFER_INITIAL_CAPACITY);
+        int size;
+        while ((size = jniFillTransactions(buffer)) > buffer.capacity())
+            buffer = ByteBuffer.allocateDirect(size);
+        buffer.limit(size);
+        return buffer.order(ByteOrder.LITTLE_ENDIAN);
+    }
+
+    private native int jniFillTransactions (ByteBuffer buffer);
+
     public native BRCoreTransaction[] getTransactionsConfirmedBefore (long blockHeight);
 
     public native long getBalance ();
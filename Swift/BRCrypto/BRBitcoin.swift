@@ -437,6 +437,15 @@ public class BitcoinWalletManager: WalletManager {
                                     walletEvent   = WalletEvent.transferDeleted(transfer: transfer)
                                 }
 
+                            case BITCOIN_TRANSACTION_CONDENSED:
+                                // Still the wallet's, but `coreTransaction` is freed by now; drop the
+                                // transfer holding it, comparing the pointer only, and announce nothing.
+                                if let index = wallet.transfers.firstIndex (where: {
+                                    ($0 as? BitcoinTransfer).map { $0.core == coreTransaction } ?? false }) {
+                                    wallet.transfers.remove(at: index)
+                                }
+                                return
+
                             default:
                                 return
                             }
@@ -279,6 +279,35 @@ public class EthereumTransfer: Transfer {
         self.identifier = tid
         self.state = TransferState (ewm: wallet._manager.core, tid: tid)
     }
+
+    ///
+    /// Create a transfer from a Core summary.  The summarized properties are read from `summary`
+    /// rather than from Core, which would take a call, and the EWM lock, for each one.
+    ///
+    init (wallet: EthereumWallet,
+          summary: BREthereumTransferSummary) {
+        self._wallet = wallet
+        self.identifier = summary.transfer
+        self.state = TransferState (ewm: wallet._manager.core, summary: summary)
+
+        self.source = Address.ethereum (summary.source)
+        self.target = Address.ethereum (summary.target)
+        self.amount = (AMOUNT_ETHER == summary.amount.type
+            ? Amount (value: summary.amount.u.ether.valueInWEI,
+                      unit: wallet.currency.defaultUnit,
+                      negative: false)
+            : Amount (value: summary.amount.u.tokenQuantity.valueAsInteger,
+                      unit: wallet.currency.defaultUnit,
+                      negative: false))
+        self.fee = Amount (value: summary.fee.valueInWEI,
+                           unit: Ethereum.currency.defaultUnit,
+                           negative: false)
+        self.feeBasis = TransferFeeBasis.ethereum(
+            gasPrice: Amount (value: summary.feeBasis.u.gas.price.etherPerGas.valueInWEI,
+                              unit: Ethereum.Units.GWEI,
+                              negative: false),
+            gasLimit: summary.feeBasis.u.gas.limit.amountOfGas)
+    }
     
     convenience init? (wallet: EthereumWallet,
                        target: Address,
@@ -348,6 +377,32 @@ public class EthereumWallet: Wallet {
         }
     }
 
+    ///
+    /// Add every one of Core's transfers not yet held, reading them as summaries in batches, with
+    /// one call into Core per batch rather than several per transfer.
+    ///
+    internal func addTransfers () {
+        let batchCount = 256
+        var summaries = [BREthereumTransferSummary] (repeating: BREthereumTransferSummary(),
+                                                     count: batchCount)
+        var held = Set (transfers.map { ($0 as! EthereumTransfer).identifier })
+        var start = 0
+
+        while true {
+            let filled = summaries.withUnsafeMutableBufferPointer {
+                ewmWalletGetTransferSummaries (self.core, self.identifier, start, batchCount, $0.baseAddress)
+            }
+
+            for summary in summaries[0..<filled] where !held.contains (summary.transfer) {
+                held.insert (summary.transfer)
+                transfers.append (EthereumTransfer (wallet: self, summary: summary))
+            }
+
+            if filled < batchCount { break }
+            start += filled
+        }
+    }
+
     internal func findTransfer (identifier: BREthereumTransfer) -> EthereumTransfer? {
         return transfers.first { identifier == ($0 as! EthereumTransfer).identifier } as? EthereumTransfer
     }
@@ -691,6 +746,7 @@ public class EthereumWalletManager: WalletManager {
                         if case .created = event,
                             case .none = ewm.findWallet(identifier: wid!) {
                             ewm.addWallet (identifier: wid!)
+                            ewm.findWallet (identifier: wid!)?.addTransfers()
                         }
 
                         if let wallet = ewm.findWallet (identifier: wid!) {
@@ -792,7 +848,11 @@ public class EthereumWalletManager: WalletManager {
                             }
                         }
                     }
-                }})
+                }},
+
+            funcEstimateGasBatch: nil,
+
+            funcGetBalanceBatch: nil)
     }()
     
     ///
@@ -1064,6 +1124,33 @@ extension EthereumTokenEvent {
 }
 
 extension TransferState {
+    init (ewm: BREthereumEWM,
+          summary: BREthereumTransferSummary) {
+        switch summary.status {
+        case TRANSFER_STATUS_INCLUDED:
+            let confirmation =  TransferConfirmation (
+                blockNumber: summary.blockNumber,
+                transactionIndex: summary.transactionIndex,
+                timestamp: summary.blockTimestamp,
+                fee: Amount (value: summary.fee.valueInWEI, unit: Ethereum.Units.ETHER, negative: false))
+
+            self = .included(confirmation: confirmation)
+
+        case TRANSFER_STATUS_ERRORED:
+            // The reason isn't summarized; errored transfers are few.
+            let reasonBytes = ewmTransferStatusGetError(ewm, summary.transfer)
+            self = .failed (reason: asUTF8String(reasonBytes!))
+
+        case TRANSFER_STATUS_CREATED: self = .created
+        case TRANSFER_STATUS_SUBMITTED: self = .submitted
+        case TRANSFER_STATUS_CANCELLED: self = .created
+        case TRANSFER_STATUS_REPLACED: self = .created
+        case TRANSFER_STATUS_DELETED: self = .deleted
+        default:
+            self = .created
+        }
+    }
+
     init (ewm: BREthereumEWM,
           tid: BREthereumTransfer) {
         switch ewmTransferGetStatus(ewm, tid) {
@@ -38,16 +38,35 @@
 #define BCASH_PUBKEY_ADDRESS 28
 #define BCASH_SCRIPT_ADDRESS 40
 
-#define polymod(x) ((((x) & 0x07ffffffff) << 5) ^ (-(((x) >> 35) & 1) & 0x98f2bc8e61) ^\
-    (-(((x) >> 36) & 1) & 0x79b76d99e2) ^ (-(((x) >> 37) & 1) & 0xf33e5fb3c4) ^\
-    (-(((x) >> 38) & 1) & 0xae2eabe2a8) ^ (-(((x) >> 39) & 1) & 0x1e4f43e470))
+// the same table driven checksum update as bech32, with the generator terms of the 40bit cashaddr checksum
+static const uint64_t _polymodTable[32] = {
+    0x0000000000, 0x98f2bc8e61, 0x79b76d99e2, 0xe145d11783, 0xf33e5fb3c4, 0x6bcce33da5, 0x8a89322a26, 0x127b8ea447,
+    0xae2eabe2a8, 0x36dc176cc9, 0xd799c67b4a, 0x4f6b7af52b, 0x5d10f4516c, 0xc5e248df0d, 0x24a799c88e, 0xbc552546ef,
+    0x1e4f43e470, 0x86bdff6a11, 0x67f82e7d92, 0xff0a92f3f3, 0xed711c57b4, 0x7583a0d9d5, 0x94c671ce56, 0x0c34cd4037,
+    0xb061e806d8, 0x28935488b9, 0xc9d6859f3a, 0x512439115b, 0x435fb7b51c, 0xdbad0b3b7d, 0x3ae8da2cfe, 0xa21a66a29f
+};
+
+#define polymod(x) ((((x) & 0x07ffffffff) << 5) ^ _polymodTable[((x) >> 35) & 0x1f])
+
+// 5bit values of bech32 digits indexed by ascii character (either case), or -1 if not a bech32 digit
+static const int8_t _digits[128] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    15, -1, 10, 17, 21, 20, 26, 30,  7,  5, -1, -1, -1, -1, -1, -1,
+    -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+     1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1,
+    -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+     1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1
+};
 
 // returns the number of bytes written to data21 (maximum of 21)
 static size_t _BRBCashAddrDecode(char *hrp12, uint8_t *data21, const char *addr)
 {
     size_t i, j, bufLen, addrLen = (addr) ? strlen(addr) : 0, sep = addrLen;
     uint64_t x, chk = 1;
-    uint8_t c, buf[22], upper = 0, lower = 0;
+    uint8_t buf[22], upper = 0, lower = 0;
+    int8_t c;
     
     assert(hrp12 != NULL);
     assert(data21 != NULL);
@@ -66,19 +85,9 @@ static size_t _BRBCashAddrDecode(char *hrp12, uint8_t *data21, const char *addr)
     memset(buf, 0, sizeof(buf));
     
     for (i = sep + 1, j = 0; i < addrLen; i++, j++) {
-        switch (tolower(addr[i])) {
-            case 'q': c = 0;  break; case 'p': c = 1;  break; case 'z': c = 2;  break; case 'r': c = 3;  break;
-            case 'y': c = 4;  break; case '9': c = 5;  break; case 'x': c = 6;  break; case '8': c = 7;  break;
-            case 'g': c = 8;  break; case 'f': c = 9;  break; case '2': c = 10; break; case 't': c = 11; break;
-            case 'v': c = 12; break; case 'd': c = 13; break; case 'w': c = 14; break; case '0': c = 15; break;
-            case 's': c = 16; break; case '3': c = 17; break; case 'j': c = 18; break; case 'n': c = 19; break;
-            case '5': c = 20; break; case '4': c = 21; break; case 'k': c = 22; break; case 'h': c = 23; break;
-            case 'c': c = 24; break; case 'e': c = 25; break; case '6': c = 26; break; case 'm': c = 27; break;
-            case 'u': c = 28; break; case 'a': c = 29; break; case '7': c = 30; break; case 'l': c = 31; break;
-            default: return 0; // invalid bech32 digit
-        }
-        
-        chk = polymod(chk) ^ c;
+        c = _digits[(uint8_t)addr[i]];
+        if (c < 0) return 0; // invalid bech32 digit
+        chk = polymod(chk) ^ (uint8_t)c;
         if (j > 35 || i + 8 >= addrLen) continue;
         x = (j % 8)*5 - ((j % 8)*5/8)*8;
         buf[(j/8)*5 + (j % 8)*5/8] |= (c << 3) >> x;
@@ -30,6 +30,10 @@
 extern const BRChainParams *BRBCashParams;
 extern const BRChainParams *BRBCashTestNetParams;
 
+// height of the last block bitcoin cash shares with bitcoin, see BRPeerManagerShareBlocks()
+#define BCASH_FORKHEIGHT         478558
+#define BCASH_TESTNET_FORKHEIGHT 1155875
+
 static inline const BRChainParams *BRChainParamsGetBitcash (int mainnet) {
     return mainnet ? BRBCashParams : BRBCashTestNetParams;
 }
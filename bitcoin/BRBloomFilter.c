@@ -32,11 +32,17 @@
 #include <assert.h>
 
 #define BLOOM_MAX_HASH_FUNCS 50
+#define BLOOM_HASH_BATCH     8 // hash functions computed at a time when checking for a match, which stops at a miss
 
-inline static uint32_t _BRBloomFilterHash(const BRBloomFilter *filter, const uint8_t *data, size_t dataLen,
-                                          uint32_t hashNum)
+// sets idxs to the filter bit indexes of data for count hash functions, starting with hashNum
+inline static void _BRBloomFilterHashes(const BRBloomFilter *filter, const uint8_t *data, size_t dataLen,
+                                        uint32_t hashNum, uint32_t count, uint32_t idxs[])
 {
-    return BRMurmur3_32(data, dataLen, hashNum*0xfba4c795 + filter->tweak) % (filter->length*8);
+    uint32_t i, seeds[BLOOM_MAX_HASH_FUNCS];
+    
+    for (i = 0; i < count; i++) seeds[i] = (hashNum + i)*0xfba4c795 + filter->tweak;
+    BRMurmur3_32Seeds(idxs, seeds, count, data, dataLen);
+    for (i = 0; i < count; i++) idxs[i] %= filter->length*8;
 }
 
 // returns a newly allocated bloom filter struct that must be freed by calling BRBloomFilterFree()
@@ -124,14 +130,18 @@ size_t BRBloomFilterSerialize(const BRBloomFilter *filter, uint8_t *buf, size_t
 // true if data is matched by filter
 int BRBloomFilterContainsData(const BRBloomFilter *filter, const uint8_t *data, size_t dataLen)
 {
-    uint32_t i, idx;
+    uint32_t i, j, n, idxs[BLOOM_HASH_BATCH];
     
     assert(filter != NULL);
     assert(data != NULL || dataLen == 0);
     
-    for (i = 0; data && i < filter->hashFuncs; i++) {
-        idx = _BRBloomFilterHash(filter, data, dataLen, i);
-        if (! (filter->filter[idx >> 3] & (1 << (7 & idx)))) return 0;
+    for (i = 0; data && i < filter->hashFuncs; i += n) {
+        n = (filter->hashFuncs - i < BLOOM_HASH_BATCH) ? filter->hashFuncs - i : BLOOM_HASH_BATCH;
+        _BRBloomFilterHashes(filter, data, dataLen, i, n, idxs);
+        
+        for (j = 0; j < n; j++) {
+            if (! (filter->filter[idxs[j] >> 3] & (1 << (7 & idxs[j])))) return 0;
+        }
     }
     
     return (data) ? 1 : 0;
@@ -140,17 +150,31 @@ int BRBloomFilterContainsData(const BRBloomFilter *filter, const uint8_t *data,
 // add data to filter
 void BRBloomFilterInsertData(BRBloomFilter *filter, const uint8_t *data, size_t dataLen)
 {
-    uint32_t i, idx;
+    uint32_t i, idxs[BLOOM_MAX_HASH_FUNCS];
     
     assert(filter != NULL);
     assert(data != NULL || dataLen == 0);
-    
-    for (i = 0; data && i < filter->hashFuncs; i++) {
-        idx = _BRBloomFilterHash(filter, data, dataLen, i);
-        filter->filter[idx >> 3] |= (1 << (7 & idx));
-    }
-    
-    if (data) filter->elemCount++;
+    assert(filter->hashFuncs <= BLOOM_MAX_HASH_FUNCS);
+    if (! data) return;
+    _BRBloomFilterHashes(filter, data, dataLen, 0, filter->hashFuncs, idxs);
+    for (i = 0; i < filter->hashFuncs; i++) filter->filter[idxs[i] >> 3] |= (1 << (7 & idxs[i]));
+    filter->elemCount++;
+}
+
+// add each of items to filter
+void BRBloomFilterInsertDataArray(BRBloomFilter *filter, const uint8_t *items[], const size_t itemLens[],
+                                  size_t itemsCount)
+{
+    assert(items != NULL || itemsCount == 0);
+    assert(itemLens != NULL || itemsCount == 0);
+    for (size_t i = 0; i < itemsCount; i++) BRBloomFilterInsertData(filter, items[i], itemLens[i]);
+}
+
+// returns the expected false positive rate of filter once elemCount elements have been inserted
+double BRBloomFilterFalsePositiveRate(const BRBloomFilter *filter, size_t elemCount)
+{
+    assert(filter != NULL);
+    return pow(1.0 - exp(-(double)filter->hashFuncs*elemCount/(filter->length*8.0)), filter->hashFuncs);
 }
 
 // frees memory allocated for filter
@@ -160,3 +184,58 @@ void BRBloomFilterFree(BRBloomFilter *filter)
     if (filter->filter) free(filter->filter);
     free(filter);
 }
+
+// returns the high 64 bits of a*b, the multiply and shift used to map item hashes into the range [0, n*m)
+inline static uint64_t _BRBlockFilterMap(uint64_t a, uint64_t b)
+{
+    uint64_t al = a & 0xffffffff, ah = a >> 32, bl = b & 0xffffffff, bh = b >> 32, x = ah*bl, y = al*bh;
+    
+    return ah*bh + (x >> 32) + (y >> 32) + (((al*bl >> 32) + (x & 0xffffffff) + (y & 0xffffffff)) >> 32);
+}
+
+static int _BRBlockFilterCompare(const void *a, const void *b)
+{
+    return (*(const uint64_t *)a < *(const uint64_t *)b) ? -1 : (*(const uint64_t *)a > *(const uint64_t *)b);
+}
+
+// true if any of the items (output scripts) are matched by the serialized basic filter for the block with blockHash
+int BRBlockFilterMatchAny(const uint8_t *filter, size_t filterLen, UInt256 blockHash, const uint8_t *items[],
+                          const size_t itemLens[], size_t itemsCount)
+{
+    size_t i, j = 0, off = 0, bit, bitsLen, end;
+    uint64_t n = BRVarInt(filter, filterLen, &off), f, q, r, value = 0, *targets;
+    int match = 0;
+    
+    assert(filter != NULL || filterLen == 0);
+    assert(items != NULL || itemsCount == 0);
+    assert(itemLens != NULL || itemsCount == 0);
+    if (off == 0 || n == 0 || itemsCount == 0 || n > UINT64_MAX/BLOCK_FILTER_BASIC_M) return 0;
+    f = n*BLOCK_FILTER_BASIC_M;
+    targets = malloc(itemsCount*sizeof(*targets));
+    assert(targets != NULL);
+    
+    for (i = 0; i < itemsCount; i++) { // the siphash key is the first 16 bytes of the block hash
+        targets[i] = _BRBlockFilterMap(BRSip64(blockHash.u8, items[i], itemLens[i]), f);
+    }
+    
+    qsort(targets, itemsCount, sizeof(*targets), _BRBlockFilterCompare);
+    bit = off*8;
+    bitsLen = filterLen*8;
+    
+    // values are sorted and delta encoded, each delta as a unary quotient followed by a P bit remainder, msb first
+    for (i = 0; i < n && j < itemsCount && ! match; i++) {
+        for (q = 0; bit < bitsLen && (filter[bit/8] >> (7 - bit % 8) & 1); bit++) q++;
+        if (++bit + BLOCK_FILTER_BASIC_P > bitsLen) break; // truncated filter
+        
+        for (r = 0, end = bit + BLOCK_FILTER_BASIC_P; bit < end; bit++) {
+            r = (r << 1) | (filter[bit/8] >> (7 - bit % 8) & 1);
+        }
+        
+        value += (q << BLOCK_FILTER_BASIC_P) + r;
+        while (j < itemsCount && targets[j] < value) j++;
+        if (j < itemsCount && targets[j] == value) match = 1;
+    }
+    
+    free(targets);
+    return match;
+}
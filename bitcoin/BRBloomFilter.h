@@ -25,6 +25,7 @@
 #ifndef BRBloomFilter_h
 #define BRBloomFilter_h
 
+#include "BRInt.h"
 #include <stddef.h>
 #include <inttypes.h>
 
@@ -72,9 +73,26 @@ int BRBloomFilterContainsData(const BRBloomFilter *filter, const uint8_t *data,
 // add data to filter
 void BRBloomFilterInsertData(BRBloomFilter *filter, const uint8_t *data, size_t dataLen);
 
+// add each of items to filter
+void BRBloomFilterInsertDataArray(BRBloomFilter *filter, const uint8_t *items[], const size_t itemLens[],
+                                  size_t itemsCount);
+
+// returns the expected false positive rate of filter once elemCount elements have been inserted
+double BRBloomFilterFalsePositiveRate(const BRBloomFilter *filter, size_t elemCount);
+
 // frees memory allocated for filter
 void BRBloomFilterFree(BRBloomFilter *filter);
 
+// compact block filters are explained in BIP158: https://github.com/bitcoin/bips/blob/master/bip-0158.mediawiki
+
+#define BLOCK_FILTER_BASIC   0      // filter type of the basic filter, matching output scripts and spent output scripts
+#define BLOCK_FILTER_BASIC_P 19     // golomb-rice coding parameter
+#define BLOCK_FILTER_BASIC_M 784931 // inverse false positive rate
+
+// true if any of the items (output scripts) are matched by the serialized basic filter for the block with blockHash
+int BRBlockFilterMatchAny(const uint8_t *filter, size_t filterLen, UInt256 blockHash, const uint8_t *items[],
+                          const size_t itemLens[], size_t itemsCount);
+
 #ifdef __cplusplus
 }
 #endif
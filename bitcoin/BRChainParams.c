@@ -135,3 +135,56 @@ static const BRChainParams BRTestNetParamsRecord = {
     sizeof(BRTestNetCheckpoints)/sizeof(*BRTestNetCheckpoints)
 };
 const BRChainParams *BRTestNetParams = &BRTestNetParamsRecord;
+
+// number of checkpoints below height, by binary search
+static size_t _BRCheckpointsBelowHeight(const BRChainParams *params, uint32_t height)
+{
+    size_t lo = 0, hi = params->checkpointsCount;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+
+        if (params->checkpoints[mid].height < height) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+// returns the checkpoint at height, or NULL if there isn't one
+const BRCheckPoint *BRChainParamsCheckpointAtHeight(const BRChainParams *params, uint32_t height)
+{
+    size_t i;
+
+    assert(params != NULL);
+    i = _BRCheckpointsBelowHeight(params, height);
+    return (i < params->checkpointsCount && params->checkpoints[i].height == height) ? &params->checkpoints[i] : NULL;
+}
+
+// returns the last checkpoint below height, or the first checkpoint (the genesis block) if there isn't one
+const BRCheckPoint *BRChainParamsCheckpointBeforeHeight(const BRChainParams *params, uint32_t height)
+{
+    size_t i;
+
+    assert(params != NULL && params->checkpointsCount > 0);
+    i = _BRCheckpointsBelowHeight(params, height);
+    return &params->checkpoints[(i > 0) ? i - 1 : 0];
+}
+
+// returns the last checkpoint with a timestamp before timestamp, or the first checkpoint if there isn't one
+const BRCheckPoint *BRChainParamsCheckpointBeforeTimestamp(const BRChainParams *params, uint32_t timestamp)
+{
+    size_t lo = 0, hi;
+
+    assert(params != NULL && params->checkpointsCount > 0);
+    hi = params->checkpointsCount;
+
+    while (lo < hi) { // count the checkpoints before timestamp
+        size_t mid = lo + (hi - lo)/2;
+
+        if (params->checkpoints[mid].timestamp < timestamp) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return &params->checkpoints[(lo > 0) ? lo - 1 : 0];
+}
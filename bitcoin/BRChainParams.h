@@ -43,13 +43,22 @@ typedef struct {
     uint32_t magicNumber;
     uint64_t services;
     int (*verifyDifficulty)(const BRMerkleBlock *block, const BRSet *blockSet); // blockSet must have last 2016 blocks
-    const BRCheckPoint *checkpoints;
+    const BRCheckPoint *checkpoints; // sorted by height, and so also by timestamp, starting with the genesis block
     size_t checkpointsCount;
 } BRChainParams;
 
 extern const BRChainParams *BRMainNetParams;
 extern const BRChainParams *BRTestNetParams;
 
+// returns the checkpoint at height, or NULL if there isn't one
+const BRCheckPoint *BRChainParamsCheckpointAtHeight(const BRChainParams *params, uint32_t height);
+
+// returns the last checkpoint below height, or the first checkpoint (the genesis block) if there isn't one
+const BRCheckPoint *BRChainParamsCheckpointBeforeHeight(const BRChainParams *params, uint32_t height);
+
+// returns the last checkpoint with a timestamp before timestamp, or the first checkpoint if there isn't one
+const BRCheckPoint *BRChainParamsCheckpointBeforeTimestamp(const BRChainParams *params, uint32_t timestamp);
+
 static inline const BRChainParams *BRChainParamsGetBitcoin (int mainnet) {
     return mainnet ? BRMainNetParams : BRTestNetParams;
 }
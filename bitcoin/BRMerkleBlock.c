@@ -30,6 +30,7 @@
 #include <limits.h>
 #include <string.h>
 #include <assert.h>
+#include <stdatomic.h>
 
 #define MAX_PROOF_OF_WORK 0x1d00ffff    // highest value for difficulty target (higher values are less difficult)
 #define TARGET_TIMESPAN   (14*24*60*60) // the targeted timespan between difficulty target adjustments
@@ -83,62 +84,204 @@ BRMerkleBlock *BRMerkleBlockNew(void)
     return block;
 }
 
-// returns a deep copy of block and that must be freed by calling BRMerkleBlockFree()
+// unless a block is an arena block, its hashes and flags are stored together following a reference count, and are
+// shared by all copies of the block
+typedef union {
+    atomic_size_t refCount;
+    UInt256 align; // keeps the hashes that follow aligned
+} BRMerkleTree;
+
+// returns the shared storage holding block's hashes and flags, or NULL if it has none or is an arena block
+static BRMerkleTree *_BRMerkleBlockTree(const BRMerkleBlock *block)
+{
+    void *p = (block->hashes) ? (void *)block->hashes : (void *)block->flags;
+
+    return (p && ! block->arena) ? (BRMerkleTree *)p - 1 : NULL;
+}
+
+// replaces block's hashes and flags with newly allocated shared storage holding a copy of them, either may be NULL
+static void _BRMerkleBlockTreeNew(BRMerkleBlock *block, const void *hashes, size_t hashesLen, const void *flags,
+                                  size_t flagsLen)
+{
+    BRMerkleTree *tree = (hashes || flags) ? malloc(sizeof(*tree) + hashesLen + flagsLen) : NULL;
+
+    assert(tree != NULL || (! hashes && ! flags));
+    block->hashes = NULL;
+    block->flags = NULL;
+    block->arena = 0;
+
+    if (tree) {
+        atomic_init(&tree->refCount, 1);
+        if (hashes) block->hashes = memcpy(tree + 1, hashes, hashesLen);
+        if (flags) block->flags = memcpy((uint8_t *)(tree + 1) + hashesLen, flags, flagsLen);
+    }
+}
+
+// drops block's reference to its shared hashes and flags, freeing them along with the last copy of the block
+static void _BRMerkleBlockTreeRelease(BRMerkleBlock *block)
+{
+    BRMerkleTree *tree = _BRMerkleBlockTree(block);
+
+    if (tree && atomic_fetch_sub(&tree->refCount, 1) == 1) free(tree);
+    block->hashes = NULL;
+    block->flags = NULL;
+}
+
+// returns a copy of block that must be freed by calling BRMerkleBlockFree(), hashes and flags are immutable once set,
+// so they're shared with block rather than copied
 BRMerkleBlock *BRMerkleBlockCopy(const BRMerkleBlock *block)
 {
     BRMerkleBlock *cpy = BRMerkleBlockNew();
+    BRMerkleTree *tree;
 
     assert(block != NULL);
     *cpy = *block;
-    cpy->hashes = NULL;
-    cpy->flags = NULL;
-    BRMerkleBlockSetTxHashes(cpy, block->hashes, block->hashesCount, block->flags, block->flagsLen);
+    tree = _BRMerkleBlockTree(block);
+
+    if (tree) atomic_fetch_add(&tree->refCount, 1);
+    else if (block->arena) { // an arena block's hashes and flags are freed along with it, so they can't be shared
+        _BRMerkleBlockTreeNew(cpy, block->hashes, block->hashesCount*sizeof(UInt256), block->flags, block->flagsLen);
+    }
+
     return cpy;
 }
 
+// parses the 80 byte header in buf into block, without computing blockHash
+static size_t _BRMerkleBlockParseHeader(BRMerkleBlock *block, const uint8_t *buf)
+{
+    size_t off = 0;
+    
+    block->version = UInt32GetLE(&buf[off]);
+    off += sizeof(uint32_t);
+    block->prevBlock = UInt256Get(&buf[off]);
+    off += sizeof(UInt256);
+    block->merkleRoot = UInt256Get(&buf[off]);
+    off += sizeof(UInt256);
+    block->timestamp = UInt32GetLE(&buf[off]);
+    off += sizeof(uint32_t);
+    block->target = UInt32GetLE(&buf[off]);
+    off += sizeof(uint32_t);
+    block->nonce = UInt32GetLE(&buf[off]);
+    off += sizeof(uint32_t);
+    return off;
+}
+
+// parses the serialized merkleblock or header in buf into block, leaving hashes and flags NULL and instead setting
+// hashesOff and flagsOff to where they're found in buf (or to SIZE_MAX if they're missing or truncated)
+static void _BRMerkleBlockParse(BRMerkleBlock *block, const uint8_t *buf, size_t bufLen, size_t *hashesOff,
+                                size_t *flagsOff)
+{
+    size_t off = _BRMerkleBlockParseHeader(block, buf), len = 0;
+    
+    *hashesOff = *flagsOff = SIZE_MAX;
+    
+    if (off + sizeof(uint32_t) <= bufLen) {
+        block->totalTx = UInt32GetLE(&buf[off]);
+        off += sizeof(uint32_t);
+        block->hashesCount = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
+        off += len;
+        len = block->hashesCount*sizeof(UInt256);
+        if (off + len <= bufLen) *hashesOff = off;
+        off += len;
+        block->flagsLen = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
+        off += len;
+        len = block->flagsLen;
+        if (off + len <= bufLen) *flagsOff = off;
+    }
+    
+    BRSHA256_2(&block->blockHash, buf, 80);
+}
+
 // buf must contain either a serialized merkleblock or header
 // returns a merkle block struct that must be freed by calling BRMerkleBlockFree()
 BRMerkleBlock *BRMerkleBlockParse(const uint8_t *buf, size_t bufLen)
 {
     BRMerkleBlock *block = (buf && 80 <= bufLen) ? BRMerkleBlockNew() : NULL;
-    size_t off = 0, len = 0;
+    size_t hashesOff, flagsOff;
     
     assert(buf != NULL || bufLen == 0);
     
     if (block) {
-        block->version = UInt32GetLE(&buf[off]);
-        off += sizeof(uint32_t);
-        block->prevBlock = UInt256Get(&buf[off]);
-        off += sizeof(UInt256);
-        block->merkleRoot = UInt256Get(&buf[off]);
-        off += sizeof(UInt256);
-        block->timestamp = UInt32GetLE(&buf[off]);
-        off += sizeof(uint32_t);
-        block->target = UInt32GetLE(&buf[off]);
-        off += sizeof(uint32_t);
-        block->nonce = UInt32GetLE(&buf[off]);
-        off += sizeof(uint32_t);
+        _BRMerkleBlockParse(block, buf, bufLen, &hashesOff, &flagsOff);
+        _BRMerkleBlockTreeNew(block, (hashesOff != SIZE_MAX) ? &buf[hashesOff] : NULL,
+                              (hashesOff != SIZE_MAX) ? block->hashesCount*sizeof(UInt256) : 0,
+                              (flagsOff != SIZE_MAX) ? &buf[flagsOff] : NULL,
+                              (flagsOff != SIZE_MAX) ? block->flagsLen : 0);
+    }
+    
+    return block;
+}
+
+// parses only the 80 byte header of the serialized merkleblock or header in buf, leaving totalTx, hashes and flags
+// empty, for blocks whose matched tx hashes are no longer needed
+// returns a merkle block struct that must be freed by calling BRMerkleBlockFree()
+BRMerkleBlock *BRMerkleBlockParseHeader(const uint8_t *buf, size_t bufLen)
+{
+    BRMerkleBlock *block = (buf && 80 <= bufLen) ? BRMerkleBlockNew() : NULL;
+
+    assert(buf != NULL || bufLen == 0);
+
+    if (block) {
+        _BRMerkleBlockParseHeader(block, buf);
+        BRSHA256_2(&block->blockHash, buf, 80);
+    }
+
+    return block;
+}
+
+// same as BRMerkleBlockParse(), except hashes and flags are allocated along with the block so that BRMerkleBlockFree()
+// releases it with one call to free()
+BRMerkleBlock *BRMerkleBlockParseArena(const uint8_t *buf, size_t bufLen)
+{
+    BRMerkleBlock b = BR_MERKLE_BLOCK_NONE, *block = NULL;
+    size_t hashesOff, flagsOff, hashesLen = 0, flagsLen = 0, blockSize = (sizeof(*block) + 15) & ~(size_t)15;
+    
+    assert(buf != NULL || bufLen == 0);
+    
+    if (buf && 80 <= bufLen) {
+        _BRMerkleBlockParse(&b, buf, bufLen, &hashesOff, &flagsOff);
+        if (hashesOff != SIZE_MAX) hashesLen = b.hashesCount*sizeof(UInt256);
+        if (flagsOff != SIZE_MAX) flagsLen = b.flagsLen;
+        block = malloc(blockSize + hashesLen + flagsLen);
+        assert(block != NULL);
+        *block = b;
+        block->height = BLOCK_UNKNOWN_HEIGHT;
+        block->arena = 1;
+        if (hashesOff != SIZE_MAX) block->hashes = (UInt256 *)((uint8_t *)block + blockSize);
+        if (block->hashes) memcpy(block->hashes, &buf[hashesOff], hashesLen);
+        if (flagsOff != SIZE_MAX) block->flags = (uint8_t *)block + blockSize + hashesLen;
+        if (block->flags) memcpy(block->flags, &buf[flagsOff], flagsLen);
+    }
+    
+    return block;
+}
+
+// parses up to blocksCount consecutive 80 byte block headers in buf, hashing them several at a time
+// returns the number of headers parsed into blocks, which must each be freed by calling BRMerkleBlockFree()
+size_t BRMerkleBlockParseHeaders(BRMerkleBlock *blocks[], size_t blocksCount, const uint8_t *buf, size_t bufLen)
+{
+    void *mds[64];
+    const void *datas[64];
+    size_t i, j, n, lens[64], count = (bufLen/80 < blocksCount) ? bufLen/80 : blocksCount;
+    
+    assert(blocks != NULL || blocksCount == 0);
+    assert(buf != NULL || bufLen == 0);
+    
+    for (i = 0; i < count; i += n) {
+        n = (count - i < 64) ? count - i : 64;
         
-        if (off + sizeof(uint32_t) <= bufLen) {
-            block->totalTx = UInt32GetLE(&buf[off]);
-            off += sizeof(uint32_t);
-            block->hashesCount = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
-            off += len;
-            len = block->hashesCount*sizeof(UInt256);
-            block->hashes = (off + len <= bufLen) ? malloc(len) : NULL;
-            if (block->hashes) memcpy(block->hashes, &buf[off], len);
-            off += len;
-            block->flagsLen = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
-            off += len;
-            len = block->flagsLen;
-            block->flags = (off + len <= bufLen) ? malloc(len) : NULL;
-            if (block->flags) memcpy(block->flags, &buf[off], len);
+        for (j = 0; j < n; j++) {
+            blocks[i + j] = BRMerkleBlockNew();
+            _BRMerkleBlockParseHeader(blocks[i + j], &buf[(i + j)*80]);
+            mds[j] = &blocks[i + j]->blockHash;
+            datas[j] = &buf[(i + j)*80];
+            lens[j] = 80;
         }
         
-        BRSHA256_2(&block->blockHash, buf, 80);
+        BRSHA256_2Batch(mds, datas, lens, n);
     }
     
-    return block;
+    return count;
 }
 
 // returns number of bytes written to buf, or total bufLen needed if buf is NULL (block->height is not serialized)
@@ -182,41 +325,71 @@ size_t BRMerkleBlockSerialize(const BRMerkleBlock *block, uint8_t *buf, size_t b
     return (! buf || len <= bufLen) ? len : 0;
 }
 
-static size_t _BRMerkleBlockTxHashesR(const BRMerkleBlock *block, UInt256 *txHashes, size_t hashesCount, size_t *idx,
-                                      size_t *hashIdx, size_t *flagIdx, int depth)
+typedef struct {
+    size_t left, right; // child node indexes, SIZE_MAX if the branch is missing
+    int depth;
+    int leaf;
+} _BRMerkleNode;
+
+// walks the partial merkle tree in the depth-first order it's encoded in, without recursion, writing up to hashesCount
+// matched tx hashes to txHashes, and if nodes isn't NULL, recording each node's depth and children and the hash of
+// each leaf, so that the root can then be calculated a whole tree level at a time, returns the number of matched tx
+static size_t _BRMerkleBlockWalk(const BRMerkleBlock *block, _BRMerkleNode *nodes, UInt256 *values, size_t *count,
+                                 UInt256 *txHashes, size_t hashesCount)
 {
-    uint8_t flag;
-    
-    if (*flagIdx/8 < block->flagsLen && *hashIdx < block->hashesCount) {
-        flag = (block->flags[*flagIdx/8] & (1 << (*flagIdx % 8)));
-        (*flagIdx)++;
-    
-        if (! flag || depth == _ceil_log2(block->totalTx)) {
-            if (flag && *idx < hashesCount) {
-                if (txHashes) txHashes[*idx] = block->hashes[*hashIdx]; // leaf
-                (*idx)++;
-            }
+    size_t parents[64], n, idx = 0, hashIdx = 0, flagIdx = 0, txCount = 0;
+    uint8_t rights[64], flag; // rights[i] is true once the branch at parents[i] has its left child
+    int depth = 0, maxDepth = _ceil_log2(block->totalTx);
+    
+    while (flagIdx/8 < block->flagsLen && hashIdx < block->hashesCount) {
+        flag = (block->flags[flagIdx/8] & (1 << (flagIdx % 8)));
+        flagIdx++;
+        n = idx++;
         
-            (*hashIdx)++;
+        if (nodes) {
+            nodes[n].depth = depth;
+            nodes[n].leaf = (! flag || depth == maxDepth);
+            nodes[n].left = nodes[n].right = SIZE_MAX;
         }
-        else {
-            _BRMerkleBlockTxHashesR(block, txHashes, hashesCount, idx, hashIdx, flagIdx, depth + 1); // left branch
-            _BRMerkleBlockTxHashesR(block, txHashes, hashesCount, idx, hashIdx, flagIdx, depth + 1); // right branch
+        
+        if (flag && depth < maxDepth) { // descend into the left branch
+            parents[depth] = n, rights[depth] = 0;
+            depth++;
+            continue;
         }
+        
+        if (flag && txCount < hashesCount && txHashes) txHashes[txCount] = block->hashes[hashIdx]; // matched leaf
+        if (flag) txCount++;
+        if (values) values[n] = block->hashes[hashIdx];
+        hashIdx++;
+        
+        while (depth > 0) { // attach n to its parent, and climb past each branch whose right child is done
+            if (! rights[depth - 1]) {
+                if (nodes) nodes[parents[depth - 1]].left = n;
+                rights[depth - 1] = 1;
+                break;
+            }
+            
+            if (nodes) nodes[parents[depth - 1]].right = n;
+            n = parents[--depth];
+        }
+        
+        if (depth == 0) break; // the root is done
     }
-
-    return *idx;
+    
+    if (count) *count = idx;
+    return txCount;
 }
 
 // populates txHashes with the matched tx hashes in the block
 // returns number of hashes written, or the total hashesCount needed if txHashes is NULL
 size_t BRMerkleBlockTxHashes(const BRMerkleBlock *block, UInt256 *txHashes, size_t hashesCount)
 {
-    size_t idx = 0, hashIdx = 0, flagIdx = 0;
-
-    assert(block != NULL);
+    size_t count;
     
-    return _BRMerkleBlockTxHashesR(block, txHashes, (txHashes) ? hashesCount : SIZE_MAX, &idx, &hashIdx, &flagIdx, 0);
+    assert(block != NULL);
+    count = _BRMerkleBlockWalk(block, NULL, NULL, NULL, txHashes, (txHashes) ? hashesCount : 0);
+    return (txHashes && count > hashesCount) ? hashesCount : count;
 }
 
 // sets the hashes and flags fields for a block created with BRMerkleBlockNew()
@@ -227,39 +400,81 @@ void BRMerkleBlockSetTxHashes(BRMerkleBlock *block, const UInt256 hashes[], size
     assert(hashes != NULL || hashesCount == 0);
     assert(flags != NULL || flagsLen == 0);
     
-    if (block->hashes) free(block->hashes);
-    block->hashes = (hashesCount > 0) ? malloc(hashesCount*sizeof(UInt256)) : NULL;
-    if (block->hashes) memcpy(block->hashes, hashes, hashesCount*sizeof(UInt256));
-    if (block->flags) free(block->flags);
-    block->flags = (flagsLen > 0) ? malloc(flagsLen) : NULL;
-    if (block->flags) memcpy(block->flags, flags, flagsLen);
+    _BRMerkleBlockTreeRelease(block);
+    _BRMerkleBlockTreeNew(block, (hashesCount > 0) ? hashes : NULL, hashesCount*sizeof(UInt256),
+                          (flagsLen > 0) ? flags : NULL, flagsLen);
+    block->hashesCount = hashesCount;
+    block->flagsLen = flagsLen;
 }
 
-// recursively walks the merkle tree to calculate the merkle root
+// calculates the merkle root of the partial merkle tree, hashing all the nodes of each tree level in one batch, and
+// writes up to hashesCount matched tx hashes to txHashes, and the number matched to txCount, from the same walk
 // NOTE: this merkle tree design has a security vulnerability (CVE-2012-2459), which can be defended against by
 // considering the merkle root invalid if there are duplicate hashes in any rows with an even number of elements
-static UInt256 _BRMerkleBlockRootR(const BRMerkleBlock *block, size_t *hashIdx, size_t *flagIdx, int depth)
+static UInt256 _BRMerkleBlockRoot(const BRMerkleBlock *block, UInt256 *txHashes, size_t hashesCount, size_t *txCount)
 {
-    uint8_t flag;
-    UInt256 hashes[2], md = UINT256_ZERO;
-
-    if (*flagIdx/8 < block->flagsLen && *hashIdx < block->hashesCount) {
-        flag = (block->flags[*flagIdx/8] & (1 << (*flagIdx % 8)));
-        (*flagIdx)++;
-
-        if (flag && depth != _ceil_log2(block->totalTx)) {
-            hashes[0] = _BRMerkleBlockRootR(block, hashIdx, flagIdx, depth + 1); // left branch
-            hashes[1] = _BRMerkleBlockRootR(block, hashIdx, flagIdx, depth + 1); // right branch
-
-            if (! UInt256IsZero(hashes[0]) && ! UInt256Eq(hashes[0], hashes[1])) {
-                if (UInt256IsZero(hashes[1])) hashes[1] = hashes[0]; // if right branch is missing, dup left branch
-                BRSHA256_2(&md, hashes, sizeof(hashes));
+    size_t i, n, count = 0, maxNodes = block->flagsLen*8;
+    int depth, maxDepth = _ceil_log2(block->totalTx);
+    _BRMerkleNode *nodes = (maxNodes > 0) ? malloc(maxNodes*sizeof(*nodes)) : NULL;
+    UInt256 *values = (maxNodes > 0) ? calloc(maxNodes, sizeof(*values)) : NULL, (*pairs)[2], left, right,
+            md = UINT256_ZERO;
+    size_t *order, *lens, levelStart[maxDepth + 2];
+    void **mds;
+    const void **datas;
+    
+    *txCount = 0;
+    
+    if (! nodes || ! values || block->hashesCount == 0) {
+        if (nodes) free(nodes);
+        if (values) free(values);
+        return md;
+    }
+    
+    *txCount = _BRMerkleBlockWalk(block, nodes, values, &count, txHashes, hashesCount);
+    order = malloc(count*sizeof(*order));
+    pairs = malloc(count*sizeof(*pairs));
+    mds = malloc(count*sizeof(*mds));
+    datas = malloc(count*sizeof(*datas));
+    lens = malloc(count*sizeof(*lens));
+    assert(nodes != NULL && values != NULL && order != NULL && pairs != NULL && mds != NULL && datas != NULL &&
+           lens != NULL);
+    
+    // bucket the branch nodes by depth so each level can be hashed together, deepest level first
+    memset(levelStart, 0, sizeof(levelStart));
+    for (i = 0; i < count; i++) if (! nodes[i].leaf) levelStart[nodes[i].depth + 1]++;
+    for (depth = 0; depth <= maxDepth; depth++) levelStart[depth + 1] += levelStart[depth];
+    for (i = 0; i < count; i++) if (! nodes[i].leaf) order[levelStart[nodes[i].depth]++] = i;
+    for (depth = maxDepth + 1; depth > 0; depth--) levelStart[depth] = levelStart[depth - 1];
+    levelStart[0] = 0;
+    
+    for (depth = maxDepth - 1; depth >= 0 && count > 0; depth--) {
+        for (i = levelStart[depth], n = 0; i < levelStart[depth + 1]; i++, n++) {
+            left = (nodes[order[i]].left != SIZE_MAX) ? values[nodes[order[i]].left] : UINT256_ZERO;
+            right = (nodes[order[i]].right != SIZE_MAX) ? values[nodes[order[i]].right] : UINT256_ZERO;
+            
+            if (UInt256IsZero(left) || UInt256Eq(left, right)) { // defend against (CVE-2012-2459)
+                count = 0;
+                break;
             }
-            else *hashIdx = SIZE_MAX; // defend against (CVE-2012-2459)
+            
+            if (UInt256IsZero(right)) right = left; // if right branch is missing, dup left branch
+            pairs[n][0] = left, pairs[n][1] = right;
+            mds[n] = &values[order[i]];
+            datas[n] = pairs[n];
+            lens[n] = sizeof(pairs[n]);
         }
-        else md = block->hashes[(*hashIdx)++]; // leaf
+        
+        if (count > 0) BRSHA256_2Batch(mds, datas, lens, n);
     }
     
+    if (count > 0) md = values[0];
+    free(nodes);
+    free(values);
+    free(order);
+    free(pairs);
+    free(mds);
+    free(datas);
+    free(lens);
     return md;
 }
 
@@ -267,14 +482,25 @@ static UInt256 _BRMerkleBlockRootR(const BRMerkleBlock *block, size_t *hashIdx,
 // NOTE: this only checks if the block difficulty matches the difficulty target in the header, it does not check if the
 // target is correct for the block's height in the chain - use BRMerkleBlockVerifyDifficulty() for that
 int BRMerkleBlockIsValid(const BRMerkleBlock *block, uint32_t currentTime)
+{
+    size_t txCount;
+    
+    return BRMerkleBlockIsValidTxHashes(block, currentTime, NULL, 0, &txCount);
+}
+
+// same as BRMerkleBlockIsValid(), and also populates txHashes with up to hashesCount of the matched tx hashes in the
+// block, setting txCount to the total number matched, from the same walk of the merkle tree that checks its root
+int BRMerkleBlockIsValidTxHashes(const BRMerkleBlock *block, uint32_t currentTime, UInt256 *txHashes,
+                                 size_t hashesCount, size_t *txCount)
 {
     assert(block != NULL);
+    assert(txCount != NULL);
     
     // target is in "compact" format, where the most significant byte is the size of the value in bytes, next
     // bit is the sign, and the last 23 bits is the value after having been right shifted by (size - 3)*8 bits
     const uint32_t size = block->target >> 24, target = block->target & 0x007fffff;
-    size_t hashIdx = 0, flagIdx = 0;
-    UInt256 merkleRoot = _BRMerkleBlockRootR(block, &hashIdx, &flagIdx, 0), t = UINT256_ZERO;
+    UInt256 merkleRoot = _BRMerkleBlockRoot(block, txHashes, (txHashes) ? hashesCount : 0, txCount),
+            t = UINT256_ZERO;
     int r = 1;
     
     // check if merkle root is correct
@@ -286,8 +512,8 @@ int BRMerkleBlockIsValid(const BRMerkleBlock *block, uint32_t currentTime)
     // check if proof-of-work target is out of range
     if (target == 0 || (block->target & 0x00800000) || block->target > MAX_PROOF_OF_WORK) r = 0;
     
-    if (size > 3) UInt32SetLE(&t.u8[size - 3], target);
-    else UInt32SetLE(t.u8, target >> (3 - size)*8);
+    if (r && size > 3) UInt32SetLE(&t.u8[size - 3], target); // size is at most 32 if target is in range
+    else if (r) UInt32SetLE(t.u8, target >> (3 - size)*8);
     
     for (int i = sizeof(t) - 1; r && i >= 0; i--) { // check proof-of-work
         if (block->blockHash.u8[i] < t.u8[i]) break;
@@ -362,12 +588,19 @@ int BRMerkleBlockVerifyDifficulty(const BRMerkleBlock *block, const BRMerkleBloc
     return r;
 }
 
+// returns the bytes of memory held by block, including its hashes and flags, which may be shared with copies of it
+size_t BRMerkleBlockMemoryUsage(const BRMerkleBlock *block)
+{
+    assert(block != NULL);
+    
+    return sizeof(*block) + block->hashesCount*sizeof(UInt256) + block->flagsLen;
+}
+
 // frees memory allocated by BRMerkleBlockParse
 void BRMerkleBlockFree(BRMerkleBlock *block)
 {
     assert(block != NULL);
     
-    if (block->hashes) free(block->hashes);
-    if (block->flags) free(block->flags);
-    free(block);
+    _BRMerkleBlockTreeRelease(block);
+    free(block); // an arena block's hashes and flags are freed along with it
 }
@@ -51,21 +51,35 @@ typedef struct {
     uint8_t *flags;
     size_t flagsLen;
     uint32_t height;
+    uint32_t arena; // true if hashes and flags share the block allocation, see BRMerkleBlockParseArena(), otherwise
+                    // they're immutable once set, and shared by copies of the block
 } BRMerkleBlock;
 
 #define BR_MERKLE_BLOCK_NONE ((const BRMerkleBlock) { UINT256_ZERO, 0, UINT256_ZERO, UINT256_ZERO, 0, 0, 0, 0, NULL, 0,\
-                                                      NULL, 0, 0 })
+                                                      NULL, 0, 0, 0 })
 
 // returns a newly allocated merkle block struct that must be freed by calling BRMerkleBlockFree()
 BRMerkleBlock *BRMerkleBlockNew(void);
 
-// returns a deep copy of block and that must be freed by calling BRMerkleBlockFree()
+// returns a copy of block that must be freed by calling BRMerkleBlockFree(), sharing block's hashes and flags
 BRMerkleBlock *BRMerkleBlockCopy(const BRMerkleBlock *block);
 
 // buf must contain either a serialized merkleblock or header
 // returns a merkle block struct that must be freed by calling BRMerkleBlockFree()
 BRMerkleBlock *BRMerkleBlockParse(const uint8_t *buf, size_t bufLen);
 
+// same as BRMerkleBlockParse(), except hashes and flags are allocated along with the block so that BRMerkleBlockFree()
+// releases it with one call to free()
+BRMerkleBlock *BRMerkleBlockParseArena(const uint8_t *buf, size_t bufLen);
+
+// parses only the 80 byte header of a serialized merkleblock or header, leaving totalTx, hashes and flags empty
+// returns a merkle block struct that must be freed by calling BRMerkleBlockFree()
+BRMerkleBlock *BRMerkleBlockParseHeader(const uint8_t *buf, size_t bufLen);
+
+// parses up to blocksCount consecutive 80 byte block headers in buf, hashing them several at a time
+// returns the number of headers parsed into blocks, which must each be freed by calling BRMerkleBlockFree()
+size_t BRMerkleBlockParseHeaders(BRMerkleBlock *blocks[], size_t blocksCount, const uint8_t *buf, size_t bufLen);
+
 // returns number of bytes written to buf, or total bufLen needed if buf is NULL (block->height is not serialized)
 size_t BRMerkleBlockSerialize(const BRMerkleBlock *block, uint8_t *buf, size_t bufLen);
 
@@ -82,6 +96,11 @@ void BRMerkleBlockSetTxHashes(BRMerkleBlock *block, const UInt256 hashes[], size
 // target is correct for the block's height in the chain - use BRMerkleBlockVerifyDifficulty() for that
 int BRMerkleBlockIsValid(const BRMerkleBlock *block, uint32_t currentTime);
 
+// same as BRMerkleBlockIsValid(), and also populates txHashes with up to hashesCount of the matched tx hashes in the
+// block, setting txCount to the total number matched, from the same walk of the merkle tree that checks its root
+int BRMerkleBlockIsValidTxHashes(const BRMerkleBlock *block, uint32_t currentTime, UInt256 *txHashes,
+                                 size_t hashesCount, size_t *txCount);
+
 // true if the given tx hash is known to be included in the block
 int BRMerkleBlockContainsTxHash(const BRMerkleBlock *block, UInt256 txHash);
 
@@ -103,6 +122,9 @@ inline static int BRMerkleBlockEq(const void *block, const void *otherBlock)
             UInt256Eq(((const BRMerkleBlock *)block)->blockHash, ((const BRMerkleBlock *)otherBlock)->blockHash));
 }
 
+// returns the bytes of memory held by block, including its hashes and flags, which may be shared with copies of it
+size_t BRMerkleBlockMemoryUsage(const BRMerkleBlock *block);
+
 // frees memory allocated for block
 void BRMerkleBlockFree(BRMerkleBlock *block);
 
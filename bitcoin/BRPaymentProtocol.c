@@ -25,9 +25,11 @@
 #include "BRPaymentProtocol.h"
 #include "BRCrypto.h"
 #include "BRArray.h"
+#include "BRSet.h"
 #include <string.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <pthread.h>
 
 // BIP70 payment protocol: https://github.com/bitcoin/bips/blob/master/bip-0070.mediawiki
 // BIP75 payment protocol encryption: https://github.com/bitcoin/bips/blob/master/bip-0075.mediawiki
@@ -268,6 +270,72 @@ typedef enum {
     encrypted_msg_status_msg = 9
 } encrypted_msg_key;
 
+// returns a pointer into buf to the value of the length delimited field with key number at index idx among fields
+// with that key, and writes its length to dataLen, or returns NULL if idx is out-of-bounds
+static const uint8_t *_ProtoBufRepeated(const uint8_t *buf, size_t bufLen, uint64_t key, size_t idx, size_t *dataLen)
+{
+    size_t off = 0;
+    
+    while (buf && off < bufLen) {
+        const uint8_t *data = NULL;
+        size_t len = bufLen;
+        uint64_t i = 0, k = _ProtoBufField(&i, &data, buf, &len, &off);
+        
+        if ((k >> 3) == key && data && idx-- == 0) {
+            *dataLen = len;
+            return data;
+        }
+    }
+    
+    return NULL;
+}
+
+// reads a serialized output without copying it, script points into buf
+// returns true if the output has the required script
+static int _BRPaymentProtocolOutputView(const uint8_t *buf, size_t bufLen, uint64_t *amount, const uint8_t **script,
+                                        size_t *scriptLen)
+{
+    size_t off = 0;
+    
+    *amount = 0, *script = NULL, *scriptLen = 0;
+    
+    while (buf && off < bufLen) {
+        const uint8_t *data = NULL;
+        size_t dataLen = bufLen;
+        uint64_t i = 0, key = _ProtoBufField(&i, &data, buf, &dataLen, &off);
+        
+        if ((key >> 3) == output_amount && (key & 0x07) == PROTOBUF_VARINT) *amount = i;
+        if ((key >> 3) == output_script && data) *script = data, *scriptLen = dataLen;
+    }
+    
+    return (*script != NULL);
+}
+
+// reads the valid output at index idx among the output fields with key number in buf, skipping those without a script
+// as parsing does, returns true if idx is in bounds
+static int _BRPaymentProtocolOutputsView(const uint8_t *buf, size_t bufLen, uint64_t key, size_t idx, uint64_t *amount,
+                                         const uint8_t **script, size_t *scriptLen)
+{
+    size_t off = 0;
+    
+    while (buf && off < bufLen) {
+        const uint8_t *data = NULL, *s;
+        size_t dataLen = bufLen, sLen;
+        uint64_t i = 0, a, k = _ProtoBufField(&i, &data, buf, &dataLen, &off);
+        
+        if ((k >> 3) != key || ! data || ! _BRPaymentProtocolOutputView(data, dataLen, &a, &s, &sLen) || idx-- > 0) {
+            continue;
+        }
+        
+        if (amount) *amount = a;
+        if (script) *script = s;
+        if (scriptLen) *scriptLen = sLen;
+        return 1;
+    }
+    
+    return 0;
+}
+
 static BRTxOutput _BRPaymentProtocolOutput(uint64_t amount, uint8_t *script, size_t scriptLen)
 {
     BRTxOutput out = BR_TX_OUTPUT_NONE;
@@ -604,26 +672,13 @@ size_t BRPaymentProtocolRequestSerialize(const BRPaymentProtocolRequest *req, ui
 // returns 0 if index is out-of-bounds
 size_t BRPaymentProtocolRequestCert(const BRPaymentProtocolRequest *req, uint8_t *cert, size_t certLen, size_t idx)
 {
-    size_t off = 0, len = 0;
+    size_t len = 0;
+    const uint8_t *data;
     
     assert(req != NULL);
-    
-    while (req->pkiData && off < req->pkiDataLen) {
-        const uint8_t *data = NULL;
-        size_t dataLen = req->pkiDataLen;
-        uint64_t i = 0, key = _ProtoBufField(&i, &data, req->pkiData, &dataLen, &off);
-        
-        if ((key >> 3) == certificates_cert && data) {
-            if (idx == 0) {
-                len = dataLen;
-                if (cert && len <= certLen) memcpy(cert, data, len);
-                break;
-            }
-            else idx--;
-        }
-    }
-    
-    return (idx == 0 && (! cert || len <= certLen)) ? len : 0;
+    data = _ProtoBufRepeated(req->pkiData, req->pkiDataLen, certificates_cert, idx, &len);
+    if (data && cert && len <= certLen) memcpy(cert, data, len);
+    return (data && (! cert || len <= certLen)) ? len : 0;
 }
 
 // writes the hash of the request to md needed to sign or verify the request
@@ -908,6 +963,316 @@ void BRPaymentProtocolACKFree(BRPaymentProtocolACK *ack)
     free(ack);
 }
 
+// buf must contain a serialized details struct
+// returns true if the view was parsed
+int BRPaymentProtocolDetailsViewParse(BRPaymentProtocolDetailsView *view, const uint8_t *buf, size_t bufLen)
+{
+    size_t off = 0;
+    const uint8_t *s;
+    size_t sLen;
+    uint64_t a;
+
+    assert(view != NULL);
+    assert(buf != NULL || bufLen == 0);
+    memset(view, 0, sizeof(*view));
+    view->buf = buf, view->bufLen = bufLen;
+    view->network = "main", view->networkLen = strlen("main");
+
+    while (buf && off < bufLen) {
+        const uint8_t *data = NULL;
+        size_t dLen = bufLen;
+        uint64_t i = 0, key = _ProtoBufField(&i, &data, buf, &dLen, &off);
+
+        switch (key >> 3) {
+            case details_network: if (data) view->network = (const char *)data, view->networkLen = dLen; break;
+            case details_outputs: view->outCount += (data && _BRPaymentProtocolOutputView(data, dLen, &a, &s, &sLen));
+                break;
+            case details_time: view->time = i; break;
+            case details_expires: view->expires = i; break;
+            case details_memo: if (data) view->memo = (const char *)data, view->memoLen = dLen; break;
+            case details_payment_url: if (data) view->paymentURL = (const char *)data, view->paymentURLLen = dLen;
+                break;
+            case details_merch_data: if (data) view->merchantData = data, view->merchDataLen = dLen; break;
+            default: break;
+        }
+    }
+
+    return (off == bufLen);
+}
+
+// reads the output at index idx without copying it, script points into view->buf
+// returns true if idx is less than view->outCount
+int BRPaymentProtocolDetailsViewOutput(const BRPaymentProtocolDetailsView *view, size_t idx, uint64_t *amount,
+                                       const uint8_t **script, size_t *scriptLen)
+{
+    assert(view != NULL);
+    return _BRPaymentProtocolOutputsView(view->buf, view->bufLen, details_outputs, idx, amount, script, scriptLen);
+}
+
+// buf must contain a serialized request struct
+// returns true if the view was parsed and has details
+int BRPaymentProtocolRequestViewParse(BRPaymentProtocolRequestView *view, const uint8_t *buf, size_t bufLen)
+{
+    size_t off = 0;
+
+    assert(view != NULL);
+    assert(buf != NULL || bufLen == 0);
+    memset(view, 0, sizeof(*view));
+    view->buf = buf, view->bufLen = bufLen;
+    view->version = 1;
+    view->pkiType = "none", view->pkiTypeLen = strlen("none");
+
+    while (buf && off < bufLen) {
+        const uint8_t *data = NULL;
+        size_t dataLen = bufLen;
+        uint64_t i = 0, key = _ProtoBufField(&i, &data, buf, &dataLen, &off);
+
+        switch (key >> 3) {
+            case request_version: view->version = (uint32_t)i; break;
+            case request_pki_type: if (data) view->pkiType = (const char *)data, view->pkiTypeLen = dataLen; break;
+            case request_pki_data: if (data) view->pkiData = data, view->pkiDataLen = dataLen; break;
+            case request_details: if (data) view->details = data, view->detailsLen = dataLen; break;
+            case request_signature: if (data) view->signature = data, view->sigLen = dataLen; break;
+            default: break;
+        }
+    }
+
+    return (off == bufLen && view->details); // details are required
+}
+
+// returns a pointer into view->buf to the DER encoded certificate corresponding to index, and writes its length to
+// certLen, or returns NULL if index is out-of-bounds
+const uint8_t *BRPaymentProtocolRequestViewCert(const BRPaymentProtocolRequestView *view, size_t idx,
+                                                size_t *certLen)
+{
+    assert(view != NULL);
+    assert(certLen != NULL);
+    return _ProtoBufRepeated(view->pkiData, view->pkiDataLen, certificates_cert, idx, certLen);
+}
+
+// writes the hash of the request to md needed to verify the request, computed over view->buf with the signature
+// emptied, without re-serializing the request
+// returns the number of bytes written, or the total mdLen needed if md is NULL
+size_t BRPaymentProtocolRequestViewDigest(const BRPaymentProtocolRequestView *view, uint8_t *md, size_t mdLen)
+{
+    static const uint8_t emptySig[] = { (request_signature << 3) | PROTOBUF_LENDELIM, 0 };
+    size_t off = 0, fieldOff, sigOff, sigEnd, dataLen, sigLen, len = 0;
+    uint64_t key;
+
+    assert(view != NULL);
+    if (view->pkiTypeLen == strlen("x509+sha256") && strncmp(view->pkiType, "x509+sha256", view->pkiTypeLen) == 0) {
+        len = 256/8;
+    }
+    else if (view->pkiTypeLen == strlen("x509+sha1") && strncmp(view->pkiType, "x509+sha1", view->pkiTypeLen) == 0) {
+        len = 160/8;
+    }
+
+    if (md && len > 0 && len <= mdLen) {
+        sigOff = sigEnd = view->bufLen;
+
+        while (view->buf && off < view->bufLen) { // find the signature field, the last one wins, as when parsing
+            fieldOff = off, dataLen = view->bufLen;
+            key = _ProtoBufField(NULL, NULL, view->buf, &dataLen, &off);
+            if ((key >> 3) == request_signature) sigOff = fieldOff, sigEnd = off;
+        }
+
+        sigLen = (sigOff < view->bufLen) ? sizeof(emptySig) : 0; // an empty signature replaces a signature field
+
+        if (len == 256/8) {
+            BRSHA256Context ctx;
+
+            BRSHA256Init(&ctx);
+            BRSHA256Update(&ctx, view->buf, sigOff);
+            BRSHA256Update(&ctx, emptySig, sigLen);
+            BRSHA256Update(&ctx, &view->buf[sigEnd], view->bufLen - sigEnd);
+            BRSHA256Final(&ctx, md);
+        }
+        else {
+            uint8_t *buf = malloc(view->bufLen + sizeof(emptySig));
+
+            assert(buf != NULL);
+            memcpy(buf, view->buf, sigOff);
+            memcpy(&buf[sigOff], emptySig, sigLen);
+            memcpy(&buf[sigOff + sigLen], &view->buf[sigEnd], view->bufLen - sigEnd);
+            BRSHA1(md, buf, sigOff + sigLen + view->bufLen - sigEnd);
+            free(buf);
+        }
+    }
+
+    return (! md || len <= mdLen) ? len : 0;
+}
+
+typedef struct {
+    UInt256 hash; // SHA256 of the certificate, or chain
+    uint64_t expires;
+} BRPaymentProtocolCertCacheEntry;
+
+inline static size_t _BRCertCacheEntryHash(const void *entry)
+{
+    return (size_t)((const BRPaymentProtocolCertCacheEntry *)entry)->hash.u32[0];
+}
+
+inline static int _BRCertCacheEntryEq(const void *entry, const void *otherEntry)
+{
+    return UInt256Eq(((const BRPaymentProtocolCertCacheEntry *)entry)->hash,
+                     ((const BRPaymentProtocolCertCacheEntry *)otherEntry)->hash);
+}
+
+BR_SET_DEFINE(_BRCertCacheSet, BRPaymentProtocolCertCacheEntry, _BRCertCacheEntryHash, _BRCertCacheEntryEq)
+
+struct BRPaymentProtocolCertCacheStruct {
+    BRPaymentProtocolCertCacheEntry *entries; // capacity entries in insertion order, wrapping around at next
+    size_t capacity, count, next;
+    BRSet *set;
+    pthread_mutex_t lock;
+};
+
+// returns a newly allocated cache holding up to capacity certificates, the oldest are evicted first, that must be
+// freed by calling BRPaymentProtocolCertCacheFree()
+BRPaymentProtocolCertCache *BRPaymentProtocolCertCacheNew(size_t capacity)
+{
+    BRPaymentProtocolCertCache *cache = calloc(1, sizeof(*cache));
+
+    assert(cache != NULL);
+    cache->capacity = (capacity > 0) ? capacity : 1;
+    cache->entries = calloc(cache->capacity, sizeof(*cache->entries));
+    assert(cache->entries != NULL);
+    cache->set = BRSetNew(_BRCertCacheEntryHash, _BRCertCacheEntryEq, cache->capacity);
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+// records that cert passed verification, and may be trusted until expires, seconds since unix epoch (the earliest
+// notAfter of the chain, or sooner if revocation should be re-checked)
+void BRPaymentProtocolCertCacheAdd(BRPaymentProtocolCertCache *cache, const uint8_t *cert, size_t certLen,
+                                   uint64_t expires)
+{
+    BRPaymentProtocolCertCacheEntry entry = { UINT256_ZERO, expires }, *e;
+
+    assert(cache != NULL);
+    assert(cert != NULL || certLen == 0);
+    BRSHA256(&entry.hash, cert, certLen);
+    pthread_mutex_lock(&cache->lock);
+    e = _BRCertCacheSetGet(cache->set, &entry);
+
+    if (e) e->expires = expires; // re-verified, extend the existing entry
+    else {
+        e = &cache->entries[cache->next];
+        if (cache->count == cache->capacity) _BRCertCacheSetRemove(cache->set, e); // evict the oldest
+        else cache->count++;
+        *e = entry;
+        _BRCertCacheSetAdd(cache->set, e);
+        cache->next = (cache->next + 1) % cache->capacity;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// returns true if cert passed verification and hasn't expired by currentTime, seconds since unix epoch
+int BRPaymentProtocolCertCacheContains(BRPaymentProtocolCertCache *cache, const uint8_t *cert, size_t certLen,
+                                       uint64_t currentTime)
+{
+    BRPaymentProtocolCertCacheEntry entry = { UINT256_ZERO, 0 }, *e;
+    int r;
+
+    assert(cache != NULL);
+    assert(cert != NULL || certLen == 0);
+    BRSHA256(&entry.hash, cert, certLen);
+    pthread_mutex_lock(&cache->lock);
+    e = _BRCertCacheSetGet(cache->set, &entry);
+    r = (e && currentTime < e->expires);
+    pthread_mutex_unlock(&cache->lock);
+    return r;
+}
+
+// frees memory allocated for cache
+void BRPaymentProtocolCertCacheFree(BRPaymentProtocolCertCache *cache)
+{
+    assert(cache != NULL);
+    BRSetFree(cache->set);
+    free(cache->entries);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+// buf must contain a serialized payment struct
+// returns true if the view was parsed
+int BRPaymentProtocolPaymentViewParse(BRPaymentProtocolPaymentView *view, const uint8_t *buf, size_t bufLen)
+{
+    size_t off = 0;
+    const uint8_t *s;
+    size_t sLen;
+    uint64_t a;
+
+    assert(view != NULL);
+    assert(buf != NULL || bufLen == 0);
+    memset(view, 0, sizeof(*view));
+    view->buf = buf, view->bufLen = bufLen;
+
+    while (buf && off < bufLen) {
+        const uint8_t *data = NULL;
+        size_t dLen = bufLen;
+        uint64_t i = 0, key = _ProtoBufField(&i, &data, buf, &dLen, &off);
+
+        switch (key >> 3) {
+            case payment_transactions: if (data) view->txCount++; break;
+            case payment_refund_to:
+                view->refundToCount += (data && _BRPaymentProtocolOutputView(data, dLen, &a, &s, &sLen));
+                break;
+            case payment_memo: if (data) view->memo = (const char *)data, view->memoLen = dLen; break;
+            case payment_merch_data: if (data) view->merchantData = data, view->merchDataLen = dLen; break;
+            default: break;
+        }
+    }
+
+    return (off == bufLen);
+}
+
+// returns a pointer into view->buf to the serialized transaction at index idx, which isn't verified, and can be read
+// with BRTransactionViewParse(), and writes its length to txLen, or returns NULL if idx is out-of-bounds
+const uint8_t *BRPaymentProtocolPaymentViewTransaction(const BRPaymentProtocolPaymentView *view, size_t idx,
+                                                       size_t *txLen)
+{
+    assert(view != NULL);
+    assert(txLen != NULL);
+    return _ProtoBufRepeated(view->buf, view->bufLen, payment_transactions, idx, txLen);
+}
+
+// reads the refund output at index idx without copying it, script points into view->buf
+// returns true if idx is less than view->refundToCount
+int BRPaymentProtocolPaymentViewRefundTo(const BRPaymentProtocolPaymentView *view, size_t idx, uint64_t *amount,
+                                         const uint8_t **script, size_t *scriptLen)
+{
+    assert(view != NULL);
+    return _BRPaymentProtocolOutputsView(view->buf, view->bufLen, payment_refund_to, idx, amount, script, scriptLen);
+}
+
+// buf must contain a serialized ACK struct
+// returns true if the view was parsed and has a payment
+int BRPaymentProtocolACKViewParse(BRPaymentProtocolACKView *view, const uint8_t *buf, size_t bufLen)
+{
+    size_t off = 0;
+
+    assert(view != NULL);
+    assert(buf != NULL || bufLen == 0);
+    memset(view, 0, sizeof(*view));
+    view->buf = buf, view->bufLen = bufLen;
+
+    while (buf && off < bufLen) {
+        const uint8_t *data = NULL;
+        size_t dataLen = bufLen;
+        uint64_t i = 0, key = _ProtoBufField(&i, &data, buf, &dataLen, &off);
+
+        switch (key >> 3) {
+            case ack_payment: if (data) view->payment = data, view->paymentLen = dataLen; break;
+            case ack_memo: if (data) view->memo = (const char *)data, view->memoLen = dataLen; break;
+            default: break;
+        }
+    }
+
+    return (off == bufLen && view->payment); // payment is required
+}
+
 // returns a newly allocated invoice request struct that must be freed by calling BRPaymentProtocolInvoiceRequestFree()
 BRPaymentProtocolInvoiceRequest *BRPaymentProtocolInvoiceRequestNew(BRKey *senderPubKey, uint64_t amount,
                                                                     const char *pkiType, uint8_t *pkiData,
@@ -1020,26 +1385,13 @@ size_t BRPaymentProtocolInvoiceRequestSerialize(BRPaymentProtocolInvoiceRequest
 size_t BRPaymentProtocolInvoiceRequestCert(const BRPaymentProtocolInvoiceRequest *req, uint8_t *cert, size_t certLen,
                                            size_t idx)
 {
-    size_t off = 0, len = 0;
+    size_t len = 0;
+    const uint8_t *data;
     
     assert(req != NULL);
-    
-    while (req->pkiData && off < req->pkiDataLen) {
-        const uint8_t *data = NULL;
-        size_t dataLen = req->pkiDataLen;
-        uint64_t i = 0, key = _ProtoBufField(&i, &data, req->pkiData, &dataLen, &off);
-        
-        if ((key >> 3) == certificates_cert && data) {
-            if (idx == 0) {
-                len = dataLen;
-                if (cert && len <= certLen) memcpy(cert, data, len);
-                break;
-            }
-            else idx--;
-        }
-    }
-    
-    return (idx == 0 && (! cert || len <= certLen)) ? len : 0;
+    data = _ProtoBufRepeated(req->pkiData, req->pkiDataLen, certificates_cert, idx, &len);
+    if (data && cert && len <= certLen) memcpy(cert, data, len);
+    return (data && (! cert || len <= certLen)) ? len : 0;
 }
 
 // writes the hash of the request to md needed to sign or verify the request
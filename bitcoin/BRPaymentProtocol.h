@@ -144,6 +144,120 @@ size_t BRPaymentProtocolACKSerialize(const BRPaymentProtocolACK *ack, uint8_t *b
 // frees memory allocated for ACK struct
 void BRPaymentProtocolACKFree(BRPaymentProtocolACK *ack);
 
+// zero-copy views of serialized messages: parsing a view allocates nothing, and all its pointers, which are not NULL
+// terminated, point into the serialized buffer, which must remain valid for as long as the view is used
+
+typedef struct {
+    const uint8_t *buf; // the serialized details
+    size_t bufLen;
+    const char *network; // default is "main"
+    size_t networkLen;
+    size_t outCount; // outputs are read with BRPaymentProtocolDetailsViewOutput()
+    uint64_t time;
+    uint64_t expires;
+    const char *memo; // optional
+    size_t memoLen;
+    const char *paymentURL; // optional
+    size_t paymentURLLen;
+    const uint8_t *merchantData; // optional
+    size_t merchDataLen;
+} BRPaymentProtocolDetailsView;
+
+// buf must contain a serialized details struct
+// returns true if the view was parsed
+int BRPaymentProtocolDetailsViewParse(BRPaymentProtocolDetailsView *view, const uint8_t *buf, size_t bufLen);
+
+// reads the output at index idx without copying it, script points into view->buf
+// returns true if idx is less than view->outCount
+int BRPaymentProtocolDetailsViewOutput(const BRPaymentProtocolDetailsView *view, size_t idx, uint64_t *amount,
+                                       const uint8_t **script, size_t *scriptLen);
+
+typedef struct {
+    const uint8_t *buf; // the serialized request
+    size_t bufLen;
+    uint32_t version; // default is 1
+    const char *pkiType; // default is "none"
+    size_t pkiTypeLen;
+    const uint8_t *pkiData; // optional, certificates are read with BRPaymentProtocolRequestViewCert()
+    size_t pkiDataLen;
+    const uint8_t *details; // serialized details struct, required, see BRPaymentProtocolDetailsViewParse()
+    size_t detailsLen;
+    const uint8_t *signature; // optional
+    size_t sigLen;
+} BRPaymentProtocolRequestView;
+
+// buf must contain a serialized request struct
+// returns true if the view was parsed and has details
+int BRPaymentProtocolRequestViewParse(BRPaymentProtocolRequestView *view, const uint8_t *buf, size_t bufLen);
+
+// returns a pointer into view->buf to the DER encoded certificate corresponding to index, and writes its length to
+// certLen, or returns NULL if index is out-of-bounds
+const uint8_t *BRPaymentProtocolRequestViewCert(const BRPaymentProtocolRequestView *view, size_t idx,
+                                                size_t *certLen);
+
+// writes the hash of the request to md needed to verify the request, computed over view->buf with the signature
+// emptied, without re-serializing the request
+// returns the number of bytes written, or the total mdLen needed if md is NULL
+size_t BRPaymentProtocolRequestViewDigest(const BRPaymentProtocolRequestView *view, uint8_t *md, size_t mdLen);
+
+// a cache of DER encoded certificates, or whole certificate chains such as a request's pkiData, that have already
+// passed X.509 verification, keyed by their SHA256 hash, so requests that repeat a PKI chain can skip re-verifying it
+typedef struct BRPaymentProtocolCertCacheStruct BRPaymentProtocolCertCache;
+
+// returns a newly allocated cache holding up to capacity certificates, the oldest are evicted first, that must be
+// freed by calling BRPaymentProtocolCertCacheFree()
+BRPaymentProtocolCertCache *BRPaymentProtocolCertCacheNew(size_t capacity);
+
+// records that cert passed verification, and may be trusted until expires, seconds since unix epoch (the earliest
+// notAfter of the chain, or sooner if revocation should be re-checked)
+void BRPaymentProtocolCertCacheAdd(BRPaymentProtocolCertCache *cache, const uint8_t *cert, size_t certLen,
+                                   uint64_t expires);
+
+// returns true if cert passed verification and hasn't expired by currentTime, seconds since unix epoch
+int BRPaymentProtocolCertCacheContains(BRPaymentProtocolCertCache *cache, const uint8_t *cert, size_t certLen,
+                                       uint64_t currentTime);
+
+// frees memory allocated for cache
+void BRPaymentProtocolCertCacheFree(BRPaymentProtocolCertCache *cache);
+
+typedef struct {
+    const uint8_t *buf; // the serialized payment
+    size_t bufLen;
+    const uint8_t *merchantData; // optional
+    size_t merchDataLen;
+    size_t txCount; // transactions are read with BRPaymentProtocolPaymentViewTransaction()
+    size_t refundToCount; // refund outputs are read with BRPaymentProtocolPaymentViewRefundTo()
+    const char *memo; // optional
+    size_t memoLen;
+} BRPaymentProtocolPaymentView;
+
+// buf must contain a serialized payment struct
+// returns true if the view was parsed
+int BRPaymentProtocolPaymentViewParse(BRPaymentProtocolPaymentView *view, const uint8_t *buf, size_t bufLen);
+
+// returns a pointer into view->buf to the serialized transaction at index idx, which isn't verified, and can be read
+// with BRTransactionViewParse(), and writes its length to txLen, or returns NULL if idx is out-of-bounds
+const uint8_t *BRPaymentProtocolPaymentViewTransaction(const BRPaymentProtocolPaymentView *view, size_t idx,
+                                                       size_t *txLen);
+
+// reads the refund output at index idx without copying it, script points into view->buf
+// returns true if idx is less than view->refundToCount
+int BRPaymentProtocolPaymentViewRefundTo(const BRPaymentProtocolPaymentView *view, size_t idx, uint64_t *amount,
+                                         const uint8_t **script, size_t *scriptLen);
+
+typedef struct {
+    const uint8_t *buf; // the serialized ACK
+    size_t bufLen;
+    const uint8_t *payment; // serialized payment struct, required, see BRPaymentProtocolPaymentViewParse()
+    size_t paymentLen;
+    const char *memo; // optional
+    size_t memoLen;
+} BRPaymentProtocolACKView;
+
+// buf must contain a serialized ACK struct
+// returns true if the view was parsed and has a payment
+int BRPaymentProtocolACKViewParse(BRPaymentProtocolACKView *view, const uint8_t *buf, size_t bufLen);
+
 typedef struct {
     BRKey senderPubKey; // sender's public key, required
     uint64_t amount; // amount is integer-number-of-satoshis, defaults to 0
@@ -24,11 +24,13 @@
 
 #include "BRPeer.h"
 #include "BRMerkleBlock.h"
+#include "BRBloomFilter.h"
 #include "BRAddress.h"
 #include "BRSet.h"
 #include "BRArray.h"
 #include "BRCrypto.h"
 #include "BRInt.h"
+#include "BRStats.h"
 #include <stdlib.h>
 #include <float.h>
 #include <inttypes.h>
@@ -38,8 +40,10 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <netdb.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <netinet/in.h>	
 #include <arpa/inet.h>
 
@@ -47,15 +51,42 @@
 #define MAX_MSG_LENGTH     0x02000000
 #define MAX_GETDATA_HASHES 50000
 #define ENABLED_SERVICES   0ULL  // we don't provide full blocks to remote nodes
-#define PROTOCOL_VERSION   70013
+#define PROTOCOL_VERSION   70014 // BIP152 compact blocks
 #define MIN_PROTO_VERSION  70002 // peers earlier than this protocol version not supported (need v0.9 txFee relay rules)
 #define LOCAL_HOST         ((UInt128) { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 0x7f, 0x00, 0x00, 0x01 })
 #define CONNECT_TIMEOUT    3.0
+#define CONNECT_RACE_DELAY 0.25 // rfc 8305 connection attempt delay before racing IPv4 against IPv6
 #define MESSAGE_TIMEOUT    10.0
 #define WITNESS_FLAG       0x40000000
 
 #define PTHREAD_STACK_SIZE  (512 * 1024)
 
+#define RECORD_RECEIVED     0
+#define RECORD_SENT         1
+#define RECORD_PREFIX_LEN   9 // direction byte, followed by microseconds since the unix epoch, little endian
+
+#define PAYLOAD_POOL_COUNT  8        // receive buffers kept for reuse, shared by all peers
+#define PAYLOAD_POOL_MAX    0x100000 // larger receive buffers are freed rather than pooled
+#define PAYLOAD_MIN_SIZE    0x1000
+
+#define TX_PAYLOAD_COUNT    8 // serialized tx kept for sending to other peers that request them, shared by all peers
+
+#define TX_IN_FLIGHT_MAX    500   // most tx requested from a peer at a time in response to its invs
+#define TX_REQUEST_TIMEOUT  5.0   // seconds a tx requested from one peer has to arrive before another peer is asked
+#define TX_PENDING_MAX      20000 // most announced tx a peer can have waiting to be requested, more are dropped
+#define TX_REQUESTS_MAX     20000 // tx requests remembered across all peers before old ones are pruned
+#define TX_REQUEST_EXPIRY   60.0  // seconds a tx request is remembered
+
+#define HEADERS_MAX_THREADS 4   // most threads used to validate the headers in a single headers message
+#define HEADERS_THREAD_MIN  500 // fewest headers given to each validation thread
+
+#define MSG_TYPE_SLOTS      64 // power of 2 at least twice the number of message types in _BRPeerMsgTypes
+
+#define KNOWN_TX_GENERATION 5000 // tx hashes remembered per generation, the previous generation is remembered as well
+
+#define SEND_COALESCE_MAX   0x1000  // largest message payload queued during a send batch, larger ones are sent at once
+#define SEND_QUEUE_MAX      0x10000 // most bytes queued during a send batch before they're written to the socket
+
 // the standard blockchain download protocol works as follows (for SPV mode):
 // - local peer sends getblocks
 // - remote peer reponds with inv containing up to 500 block hashes
@@ -83,6 +114,11 @@
 // - if at any point tx messages consume enough wallet addresses to drop below the bip32 chain gap limit, more addresses
 //   are generated and local peer sends filterload with an updated bloom filter
 // - after filterload is sent, getdata is sent to re-request recent blocks that may contain new tx matching the filter
+//
+// when far behind, the peer manager instead syncs headers first:
+// - the download peer sends getheaders repeatedly, as above, but all the way to its last block
+// - the peer manager then sends getdata for disjoint ranges of the filtered blocks to each connected peer, and ping
+// - each remote peer responds with multiple merkleblock and tx messages, followed by pong
 
 typedef enum {
     inv_undefined = 0,
@@ -91,9 +127,26 @@ typedef enum {
     inv_filtered_block = 3,
     inv_witness_block = inv_block | WITNESS_FLAG,
     inv_witness_tx = inv_tx | WITNESS_FLAG,
+    inv_cmpct_block = 4,
     inv_filtered_witness_block = inv_filtered_block | WITNESS_FLAG
 } inv_type;
 
+typedef enum {
+    loop_opening = 0, // waiting for the event loop thread to open the socket
+    loop_connecting,  // non-blocking connect in progress
+    loop_connected
+} loop_state;
+
+typedef struct {
+    UInt256 txHash;
+    double time; // when the tx can next be requested
+} tx_pending;
+
+typedef struct {
+    uint64_t key[2]; // message type as set by _BRPeerMsgTypeKey()
+    int (*handler)(void *info, const uint8_t *msg, size_t msgLen);
+} msg_handler;
+
 typedef struct {
     BRPeer peer; // superstruct on top of BRPeer
     uint32_t magicNumber;
@@ -105,12 +158,17 @@ typedef struct {
     char *useragent;
     uint32_t version, lastblock, earliestKeyTime, currentBlockHeight;
     double startTime, pingTime;
+    uint64_t getblocksTime; // BRStatsMicroseconds() when getblocks was sent, 0 once its inv reply arrives
     volatile double disconnectTime, mempoolTime;
-    int sentVerack, gotVerack, sentGetaddr, sentFilter, sentGetdata, sentMempool, sentGetblocks;
+    int sentVerack, gotVerack, sentGetaddr, sentFilter, sentGetdata, sentMempool, sentGetblocks, headersFirst;
+    int sentGetcfilters, cmpctWitness;
     UInt256 lastBlockHash;
     BRMerkleBlock *currentBlock;
-    UInt256 *currentBlockTxHashes, *knownBlockHashes, *knownTxHashes;
-    BRSet *knownTxHashSet;
+    UInt256 *currentBlockTxHashes, *knownBlockHashes;
+    UInt256 *knownTxHashes; // KNOWN_TX_GENERATION hashes for each of two generations
+    size_t knownTxCount; // hashes in the current generation
+    int knownTxGen; // index of the current generation
+    BRSet *knownTxHashSets[2];
     volatile int socket;
     void *info;
     void (*connected)(void *info);
@@ -120,6 +178,14 @@ typedef struct {
     void (*hasTx)(void *info, UInt256 txHash);
     void (*rejectedTx)(void *info, UInt256 txHash, uint8_t code);
     void (*relayedBlock)(void *info, BRMerkleBlock *block);
+    void (*relayedFilter)(void *info, UInt256 blockHash, const uint8_t *filter, size_t filterLen);
+    int (*wantsTx)(void *info, const BRTransactionView *view);
+    size_t (*knownTx)(void *info, BRTransaction *transactions[], size_t txCount);
+    UInt256 cmpctHash; // hash of the compact block being reconstructed
+    uint8_t cmpctHeader[80];
+    BRTransaction **cmpctTx; // tx of the compact block being reconstructed, NULL for those still missing
+    size_t cmpctCount;
+    msg_handler *msgHandlers; // set by BRPeerSetMessageHandler()
     void (*notfound)(void *info, const UInt256 txHashes[], size_t txCount, const UInt256 blockHashes[],
                      size_t blockCount);
     void (*setFeePerKb)(void *info, uint64_t feePerKb);
@@ -130,11 +196,80 @@ typedef struct {
     void (**volatile pongCallback)(void *info, int success);
     void *volatile mempoolInfo;
     void (*volatile mempoolCallback)(void *info, int success);
+    int eventLoop, socketFlags;
+    FILE *recordFile, *replayFile;
+    loop_state loopState;
+    uint8_t header[HEADER_LENGTH], *payload; // partially read message, when serviced by the event loop thread
+    size_t headerLen, payloadLen, payloadSize;
+    double msgTimeout;
+    tx_pending *txPending; // announced tx waiting on another peer, or for fewer tx to be in flight
+    size_t txInFlight, txCapped; // tx requested and not yet received, and pending tx deferred by TX_IN_FLIGHT_MAX
+    const void *txRequestScope; // tx requests are shared with peers of the same scope, the peer itself if NULL
+    double txRequestTime, txPendingTime; // when tx were last requested, and when a pending tx is next due
+    int mempoolPending; // the mempool response arrived, its ping waits until no tx are pending
+    uint8_t *sendQueue; // messages coalesced during a send batch, with their headers
+    int sendBatch; // nesting depth of BRPeerBeginBatch() calls
     pthread_t thread;
     pthread_mutex_t lock;
+    pthread_mutex_t sendLock; // serializes socket writes, and guards sendQueue and sendBatch
 } BRPeerContext;
 
+// message types counted by BRStatsPeerMsgsIn and BRStatsPeerMsgsOut, in index order, other types are counted after them
+static const char *_BRPeerMsgTypes[] = {
+    MSG_VERSION, MSG_VERACK, MSG_ADDR, MSG_INV, MSG_GETDATA, MSG_NOTFOUND, MSG_GETBLOCKS, MSG_GETHEADERS,
+    MSG_TX, MSG_BLOCK, MSG_HEADERS, MSG_GETADDR, MSG_MEMPOOL, MSG_PING, MSG_PONG, MSG_FILTERLOAD,
+    MSG_FILTERADD, MSG_FILTERCLEAR, MSG_MERKLEBLOCK, MSG_ALERT, MSG_REJECT, MSG_FEEFILTER, MSG_GETCFILTERS, MSG_CFILTER,
+    MSG_SENDCMPCT, MSG_CMPCTBLOCK, MSG_GETBLOCKTXN, MSG_BLOCKTXN
+};
+
+#define MSG_TYPES_COUNT (sizeof(_BRPeerMsgTypes)/sizeof(*_BRPeerMsgTypes))
+
+// message types are looked up by their 12 byte null padded form, read as two words, in an open addressed hashtable
+static uint64_t _BRPeerMsgTypeKeys[MSG_TYPES_COUNT][2];
+static uint8_t _BRPeerMsgTypeSlots[MSG_TYPE_SLOTS]; // index in _BRPeerMsgTypes + 1 of the type in each slot, or 0
+static pthread_once_t _msgTypesOnce = PTHREAD_ONCE_INIT;
+
+// sets key to the words of the 12 byte message type, which stops at the first null, and returns its hashtable slot
+static size_t _BRPeerMsgTypeKey(uint64_t key[2], const char *type)
+{
+    uint8_t s[12] = { 0 };
+
+    strncpy((char *)s, type, sizeof(s));
+    key[0] = UInt64GetLE(s);
+    key[1] = UInt32GetLE(&s[8]);
+    return (size_t)(((key[0] ^ key[1])*0x9e3779b97f4a7c15) >> 32) & (MSG_TYPE_SLOTS - 1);
+}
+
+static void _BRPeerMsgTypesInit(void)
+{
+    size_t i, j;
+
+    assert(MSG_TYPES_COUNT*2 <= MSG_TYPE_SLOTS);
+
+    for (i = 0; i < MSG_TYPES_COUNT; i++) {
+        j = _BRPeerMsgTypeKey(_BRPeerMsgTypeKeys[i], _BRPeerMsgTypes[i]);
+        while (_BRPeerMsgTypeSlots[j] != 0) j = (j + 1) & (MSG_TYPE_SLOTS - 1);
+        _BRPeerMsgTypeSlots[j] = (uint8_t)(i + 1);
+    }
+}
+
+// returns the index of type in _BRPeerMsgTypes, or MSG_TYPES_COUNT if it isn't one of them, and sets key for type
+static size_t _BRPeerMsgTypeIndex(uint64_t key[2], const char *type)
+{
+    size_t i, j;
+
+    pthread_once(&_msgTypesOnce, _BRPeerMsgTypesInit);
+
+    for (j = _BRPeerMsgTypeKey(key, type); _BRPeerMsgTypeSlots[j] != 0; j = (j + 1) & (MSG_TYPE_SLOTS - 1)) {
+        i = _BRPeerMsgTypeSlots[j] - 1;
+        if (_BRPeerMsgTypeKeys[i][0] == key[0] && _BRPeerMsgTypeKeys[i][1] == key[1]) return i;
+    }
+
+    return MSG_TYPES_COUNT;
+}
+
 void BRPeerSendVersionMessage(BRPeer *peer);
+static void _BRPeerSendGetblockdata(BRPeer *peer, const UInt256 blockHashes[], size_t blockCount, inv_type type);
 void BRPeerSendVerackMessage(BRPeer *peer);
 void BRPeerSendAddr(BRPeer *peer);
 
@@ -143,24 +278,39 @@ inline static int _BRPeerIsIPv4(const BRPeer *peer)
     return (peer->address.u64[0] == 0 && peer->address.u16[4] == 0 && peer->address.u16[5] == 0xffff);
 }
 
+BR_SET_DEFINE(_BRTxHashSet, UInt256, BRTransactionHash, BRTransactionEq) // txHash is the first member of BRTransaction
+
+inline static int _BRPeerKnowsTxHash(const BRPeerContext *ctx, const UInt256 *txHash)
+{
+    return (_BRTxHashSetContains(ctx->knownTxHashSets[ctx->knownTxGen], txHash) ||
+            _BRTxHashSetContains(ctx->knownTxHashSets[ctx->knownTxGen ^ 1], txHash));
+}
+
+// adds txHash to the known tx hashes and returns true, or returns false if it was already known
+// when the current generation is full, the previous one is forgotten and its memory reused for a new generation
+static int _BRPeerAddKnownTxHash(BRPeerContext *ctx, UInt256 txHash)
+{
+    UInt256 *hashes;
+
+    if (_BRPeerKnowsTxHash(ctx, &txHash)) return 0;
+
+    if (ctx->knownTxCount == KNOWN_TX_GENERATION) {
+        ctx->knownTxGen ^= 1;
+        ctx->knownTxCount = 0;
+        BRSetClear(ctx->knownTxHashSets[ctx->knownTxGen]);
+    }
+
+    hashes = &ctx->knownTxHashes[ctx->knownTxGen*KNOWN_TX_GENERATION];
+    hashes[ctx->knownTxCount] = txHash;
+    _BRTxHashSetAdd(ctx->knownTxHashSets[ctx->knownTxGen], &hashes[ctx->knownTxCount++]);
+    return 1;
+}
+
 static void _BRPeerAddKnownTxHashes(const BRPeer *peer, const UInt256 txHashes[], size_t txCount)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
-    UInt256 *knownTxHashes = ctx->knownTxHashes;
-    size_t i, j;
-    
-    for (i = 0; i < txCount; i++) {
-        if (! BRSetContains(ctx->knownTxHashSet, &txHashes[i])) {
-            array_add(knownTxHashes, txHashes[i]);
-            
-            if (ctx->knownTxHashes != knownTxHashes) { // check if knownTxHashes was moved to a new memory location
-                ctx->knownTxHashes = knownTxHashes;
-                BRSetClear(ctx->knownTxHashSet);
-                for (j = array_count(knownTxHashes); j > 0; j--) BRSetAdd(ctx->knownTxHashSet, &knownTxHashes[j - 1]);
-            }
-            else BRSetAdd(ctx->knownTxHashSet, &knownTxHashes[array_count(knownTxHashes) - 1]);
-        }
-    }
+
+    for (size_t i = 0; i < txCount; i++) _BRPeerAddKnownTxHash(ctx, txHashes[i]);
 }
 
 static void _BRPeerDidConnect(BRPeer *peer)
@@ -174,6 +324,14 @@ static void _BRPeerDidConnect(BRPeer *peer)
         ctx->status = BRPeerStatusConnected;
         peer_log(peer, "connected with lastblock: %"PRIu32, ctx->lastblock);
         pthread_mutex_unlock(&ctx->lock);
+
+        if (ctx->knownTx && ctx->version >= 70014) { // BIP152
+            uint8_t msg[sizeof(uint8_t) + sizeof(uint64_t)] = { 0 }; // don't announce new blocks as compact blocks
+
+            UInt64SetLE(&msg[1], 2); // version 2 compact blocks use wtxids
+            BRPeerSendMessage(peer, msg, sizeof(msg), MSG_SENDCMPCT);
+        }
+
         if (ctx->connected) ctx->connected(ctx->info);
     }
     else {
@@ -256,6 +414,8 @@ static int _BRPeerAcceptVerackMessage(BRPeer *peer, const uint8_t *msg, size_t m
         gettimeofday(&tv, NULL);
         ctx->pingTime = tv.tv_sec + (double)tv.tv_usec/1000000 - ctx->startTime; // use verack time as initial ping time
         ctx->startTime = 0;
+        BR_TRACE_ADD(BRTracePeerConnect, BRStatsMicroseconds() - (uint64_t)(ctx->pingTime*1000000),
+                     BRStatsMicroseconds(), peer->port);
         peer_log(peer, "got verack in %fs", ctx->pingTime);
         ctx->gotVerack = 1;
         _BRPeerDidConnect(peer);
@@ -311,6 +471,192 @@ static int _BRPeerAcceptAddrMessage(BRPeer *peer, const uint8_t *msg, size_t msg
     return r;
 }
 
+typedef struct {
+    UInt256 txHash;
+    const void *scope; // peers share tx requests only within a scope, see BRPeerSetTxRequestScope()
+    const void *requester; // the peer the tx was last requested from, until it arrives or isn't found
+    int received;
+    double time; // when the tx was last requested
+} tx_request;
+
+inline static size_t _BRTxRequestHash(const void *req)
+{
+    return BRTransactionHash(req) ^ (size_t)((const tx_request *)req)->scope;
+}
+
+inline static int _BRTxRequestEq(const void *req, const void *otherReq)
+{
+    return (((const tx_request *)req)->scope == ((const tx_request *)otherReq)->scope &&
+            BRTransactionEq(req, otherReq));
+}
+
+enum { tx_admit_request, tx_admit_received, tx_admit_wait };
+
+// tx requests are tracked across all peers in a scope, so a tx announced by several of them is only requested from one,
+// unless it doesn't arrive in time, or the peer doesn't have it
+static pthread_mutex_t _txRequestLock = PTHREAD_MUTEX_INITIALIZER;
+static BRSet *_txRequests = NULL;
+static size_t _txRequestsPruneCount = TX_REQUESTS_MAX;
+
+// removes tx requests older than TX_REQUEST_EXPIRY, must be called with _txRequestLock held
+static void _BRPeerTxRequestsPrune(double time)
+{
+    size_t i, count = BRSetCount(_txRequests);
+    tx_request **all = malloc(count*sizeof(*all));
+
+    assert(all != NULL);
+    count = BRSetAll(_txRequests, (void **)all, count);
+
+    for (i = 0; i < count; i++) {
+        if (time < all[i]->time + TX_REQUEST_EXPIRY) continue;
+        BRSetRemove(_txRequests, all[i]);
+        free(all[i]);
+    }
+
+    free(all);
+    // during a flood of recent requests, don't prune again until the set has doubled
+    _txRequestsPruneCount = (BRSetCount(_txRequests)*2 > TX_REQUESTS_MAX) ? BRSetCount(_txRequests)*2 : TX_REQUESTS_MAX;
+}
+
+// returns tx_admit_request and records the request if txHash should be requested from the peer now,
+// tx_admit_received if it was already received from another peer, or tx_admit_wait if another peer was asked for it
+// less than TX_REQUEST_TIMEOUT seconds ago, in which case retryTime is set to when the peer can be asked
+static int _BRPeerTxRequestAdmit(BRPeerContext *ctx, UInt256 txHash, double time, double *retryTime)
+{
+    tx_request *req, key = { txHash, (ctx->txRequestScope) ? ctx->txRequestScope : ctx, NULL, 0, 0 };
+    int admit = tx_admit_request;
+
+    pthread_mutex_lock(&_txRequestLock);
+    if (! _txRequests) _txRequests = BRSetNew(_BRTxRequestHash, _BRTxRequestEq, 100);
+    req = BRSetGet(_txRequests, &key);
+
+    if (req && req->received) {
+        admit = tx_admit_received;
+    }
+    else if (req && time < req->time + TX_REQUEST_TIMEOUT) {
+        admit = tx_admit_wait;
+        *retryTime = req->time + TX_REQUEST_TIMEOUT;
+    }
+    else {
+        if (! req && BRSetCount(_txRequests) >= _txRequestsPruneCount) _BRPeerTxRequestsPrune(time);
+
+        if (! req) {
+            req = calloc(1, sizeof(*req));
+            assert(req != NULL);
+            *req = key;
+            BRSetAdd(_txRequests, req);
+        }
+
+        req->requester = ctx;
+        req->time = time;
+    }
+
+    pthread_mutex_unlock(&_txRequestLock);
+    return admit;
+}
+
+// records that a requested tx was received, or that the peer didn't have it so other peers can be asked right away,
+// only tx last requested from this peer count against its txInFlight, not those sent unrequested or for a merkleblock
+static void _BRPeerTxRequestDone(BRPeerContext *ctx, UInt256 txHash, int received)
+{
+    tx_request *req, key = { txHash, (ctx->txRequestScope) ? ctx->txRequestScope : ctx, NULL, 0, 0 };
+    int requested = 0;
+
+    pthread_mutex_lock(&_txRequestLock);
+    req = (_txRequests) ? BRSetGet(_txRequests, &key) : NULL;
+
+    if (req) {
+        if (received) req->received = 1;
+        else if (! req->received) req->time = 0;
+        requested = (req->requester == ctx);
+        if (requested) req->requester = NULL;
+    }
+
+    pthread_mutex_unlock(&_txRequestLock);
+    if (requested && ctx->txInFlight > 0) ctx->txInFlight--;
+}
+
+// admission control for announced tx: keeps those in txHashes that should be requested now, and returns their count,
+// defers the rest to txPending, and calls hasTx for any received from another peer in the meantime
+static size_t _BRPeerAdmitTx(BRPeer *peer, UInt256 txHashes[], size_t txCount, double time)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    size_t i, j = 0, dropped = 0;
+    double retryTime;
+    int admit;
+
+    for (i = 0; i < txCount; i++) {
+        if (ctx->txInFlight >= TX_IN_FLIGHT_MAX) { // retried as requested tx arrive, or after a timeout
+            admit = tx_admit_wait;
+            retryTime = time + TX_REQUEST_TIMEOUT;
+            ctx->txCapped++;
+        }
+        else admit = _BRPeerTxRequestAdmit(ctx, txHashes[i], time, &retryTime);
+
+        if (admit == tx_admit_request) {
+            txHashes[j++] = txHashes[i];
+            ctx->txInFlight++;
+            ctx->txRequestTime = time;
+        }
+        else if (admit == tx_admit_received) {
+            if (ctx->hasTx) ctx->hasTx(ctx->info, txHashes[i]);
+        }
+        else if (array_count(ctx->txPending) < TX_PENDING_MAX) {
+            array_add(ctx->txPending, ((tx_pending) { txHashes[i], retryTime }));
+            if (retryTime < ctx->txPendingTime) ctx->txPendingTime = retryTime;
+        }
+        else dropped++;
+    }
+
+    if (dropped > 0) peer_log(peer, "dropping %zu announced tx, too many are pending", dropped);
+    return j;
+}
+
+// sends the mempool callback's ping once the mempool response's tx are no longer pending
+static void _BRPeerMempoolDone(BRPeer *peer)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+
+    BRPeerSendPing(peer, ctx->mempoolInfo, ctx->mempoolCallback);
+    ctx->mempoolCallback = NULL;
+    ctx->mempoolPending = 0;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->mempoolTime = DBL_MAX;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+// requests pending tx that are due, up to TX_IN_FLIGHT_MAX in flight
+static void _BRPeerRequestPendingTx(BRPeer *peer, double time)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    tx_pending *pending = ctx->txPending;
+    size_t i, n = 0, count = array_count(pending);
+    UInt256 txHashes[TX_IN_FLIGHT_MAX];
+
+    array_new(ctx->txPending, count);
+    ctx->txPendingTime = DBL_MAX;
+    ctx->txCapped = 0;
+    if (ctx->txInFlight > 0 && time >= ctx->txRequestTime + TX_REQUEST_TIMEOUT) ctx->txInFlight = 0; // unanswered
+
+    for (i = 0; i < count; i++) {
+        if (pending[i].time > time) {
+            array_add(ctx->txPending, pending[i]);
+            if (pending[i].time < ctx->txPendingTime) ctx->txPendingTime = pending[i].time;
+        }
+        else txHashes[n++] = pending[i].txHash;
+
+        if (n == TX_IN_FLIGHT_MAX || (n > 0 && i + 1 == count)) {
+            n = _BRPeerAdmitTx(peer, txHashes, n, time);
+            if (n > 0) BRPeerSendGetdata(peer, txHashes, n, NULL, 0);
+            n = 0;
+        }
+    }
+
+    array_free(pending);
+    if (ctx->mempoolPending && ctx->mempoolCallback && array_count(ctx->txPending) == 0) _BRPeerMempoolDone(peer);
+}
+
 static int _BRPeerAcceptInvMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
@@ -329,6 +675,7 @@ static int _BRPeerAcceptInvMessage(BRPeer *peer, const uint8_t *msg, size_t msgL
         inv_type type;
         const uint8_t *transactions[count], *blocks[count];
         size_t i, j, txCount = 0, blockCount = 0;
+        struct timeval tv;
         
         peer_log(peer, "got inv with %zu item(s)", count);
 
@@ -362,6 +709,11 @@ static int _BRPeerAcceptInvMessage(BRPeer *peer, const uint8_t *msg, size_t msgL
             if (blockCount == 1 && UInt256Eq(ctx->lastBlockHash, UInt256Get(blocks[0]))) blockCount = 0;
             if (blockCount == 1) ctx->lastBlockHash = UInt256Get(blocks[0]);
 
+            if (blockCount > 1 && ctx->getblocksTime > 0) { // the reply to getblocks
+                BR_TRACE_ADD(BRTracePeerGetblocks, ctx->getblocksTime, BRStatsMicroseconds(), blockCount);
+                ctx->getblocksTime = 0;
+            }
+
             UInt256 hash, blockHashes[blockCount], txHashes[txCount];
 
             for (i = 0; i < blockCount; i++) {
@@ -379,13 +731,15 @@ static int _BRPeerAcceptInvMessage(BRPeer *peer, const uint8_t *msg, size_t msgL
             for (i = 0, j = 0; i < txCount; i++) {
                 hash = UInt256Get(transactions[i]);
                 
-                if (BRSetContains(ctx->knownTxHashSet, &hash)) {
+                if (_BRPeerKnowsTxHash(ctx, &hash)) {
                     if (ctx->hasTx) ctx->hasTx(ctx->info, hash);
                 }
                 else txHashes[j++] = hash;
             }
             
             _BRPeerAddKnownTxHashes(peer, txHashes, j);
+            gettimeofday(&tv, NULL);
+            j = _BRPeerAdmitTx(peer, txHashes, j, tv.tv_sec + (double)tv.tv_usec/1000000);
             if (j > 0 || blockCount > 0) BRPeerSendGetdata(peer, txHashes, j, blockHashes, blockCount);
     
             // to improve chain download performance, if we received 500 block hashes, request the next 500 block hashes
@@ -397,13 +751,8 @@ static int _BRPeerAcceptInvMessage(BRPeer *peer, const uint8_t *msg, size_t msgL
             
             if (txCount > 0 && ctx->mempoolCallback) {
                 peer_log(peer, "got initial mempool response");
-                BRPeerSendPing(peer, ctx->mempoolInfo, ctx->mempoolCallback);
-                ctx->mempoolCallback = NULL;
-
-                pthread_mutex_lock(&ctx->lock);
-                ctx->mempoolTime = DBL_MAX;
-                pthread_mutex_unlock(&ctx->lock);
-
+                if (array_count(ctx->txPending) > 0) ctx->mempoolPending = 1; // the ping waits for pending tx
+                else _BRPeerMempoolDone(peer);
             }
         }
     }
@@ -414,11 +763,20 @@ static int _BRPeerAcceptInvMessage(BRPeer *peer, const uint8_t *msg, size_t msgL
 static int _BRPeerAcceptTxMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
-    BRTransaction *tx = BRTransactionParse(msg, msgLen);
+    BRTransactionView view;
+    BRTransaction *tx = NULL;
     UInt256 txHash;
-    int r = 1;
+    int r = 1, wanted = 1;
+
+    // index the tx in place first, so a tx the wantsTx callback doesn't want is never fully parsed
+    if (ctx->wantsTx && (ctx->sentFilter || ctx->sentGetdata)) {
+        if (BRTransactionViewParse(&view, msg, msgLen)) wanted = ctx->wantsTx(ctx->info, &view);
+        else r = 0;
+    }
+    
+    if (r && wanted) tx = BRTransactionParseArena(msg, msgLen);
 
-    if (! tx) {
+    if (! r || (wanted && ! tx)) {
         peer_log(peer, "malformed tx message with length: %zu", msgLen);
         r = 0;
     }
@@ -428,10 +786,21 @@ static int _BRPeerAcceptTxMessage(BRPeer *peer, const uint8_t *msg, size_t msgLe
         r = 0;
     }
     else {
-        txHash = tx->txHash;
+        txHash = (tx) ? tx->txHash : view.txHash;
         peer_log(peer, "got tx: %s", u256hex(txHash));
+        _BRPeerTxRequestDone(ctx, txHash, 1);
+
+        if (ctx->txCapped > 0 && ctx->txInFlight <= TX_IN_FLIGHT_MAX/2) { // request more of the deferred tx
+            struct timeval tv;
+
+            gettimeofday(&tv, NULL);
+            _BRPeerRequestPendingTx(peer, tv.tv_sec + (double)tv.tv_usec/1000000);
+        }
 
-        if (ctx->relayedTx) {
+        if (! tx) {
+            peer_log(peer, "discarding tx: %s", u256hex(txHash));
+        }
+        else if (ctx->relayedTx) {
             ctx->relayedTx(ctx->info, tx);
         }
         else BRTransactionFree(tx);
@@ -455,6 +824,55 @@ static int _BRPeerAcceptTxMessage(BRPeer *peer, const uint8_t *msg, size_t msgLe
     return r;
 }
 
+typedef struct {
+    const uint8_t *headers;
+    size_t count;
+    uint32_t now;
+    BRMerkleBlock **blocks;
+    uint8_t *valid;
+} BRHeadersBatch;
+
+// parses a run of serialized headers and checks each one's proof-of-work and timestamp, blocks[i] is NULL if the
+// header is malformed
+static void *_BRPeerValidateHeaders(void *info)
+{
+    BRHeadersBatch *batch = info;
+
+    for (size_t i = 0; i < batch->count; i++) {
+        batch->blocks[i] = BRMerkleBlockParse(&batch->headers[81*i], 81);
+        batch->valid[i] = (batch->blocks[i] && BRMerkleBlockIsValid(batch->blocks[i], batch->now));
+    }
+
+    return NULL;
+}
+
+// validates count headers, splitting large messages across worker threads, linking them to the chain is left to the
+// relayedBlock callback
+static void _BRPeerValidateHeadersParallel(const uint8_t *headers, size_t count, uint32_t now, BRMerkleBlock *blocks[],
+                                           uint8_t valid[])
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t i, n = count/HEADERS_THREAD_MIN, started = 0;
+    BRHeadersBatch batches[HEADERS_MAX_THREADS];
+    pthread_t threads[HEADERS_MAX_THREADS];
+
+    if (n > HEADERS_MAX_THREADS) n = HEADERS_MAX_THREADS;
+    if (cpus > 0 && n > (size_t)cpus) n = (size_t)cpus;
+    if (n < 1) n = 1;
+    
+    for (i = 0; i < n; i++) {
+        size_t start = count*i/n, end = count*(i + 1)/n;
+
+        batches[i] = (BRHeadersBatch) { &headers[81*start], end - start, now, &blocks[start], &valid[start] };
+    }
+    
+    // the calling thread takes the first batch, and any batch its worker thread couldn't be started for
+    for (i = 1; i < n && pthread_create(&threads[i], NULL, _BRPeerValidateHeaders, &batches[i]) == 0; i++) started++;
+    for (; i < n; i++) _BRPeerValidateHeaders(&batches[i]);
+    _BRPeerValidateHeaders(&batches[0]);
+    for (i = 1; i <= started; i++) pthread_join(threads[i], NULL);
+}
+
 static int _BRPeerAcceptHeadersMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
@@ -473,15 +891,24 @@ static int _BRPeerAcceptHeadersMessage(BRPeer *peer, const uint8_t *msg, size_t
         // headers immediately, and switch to requesting blocks when we receive a header newer than earliestKeyTime
         uint32_t timestamp = (count > 0) ? UInt32GetLE(&msg[off + 81*(count - 1) + 68]) : 0;
     
-        if (count >= 2000 || (timestamp > 0 && timestamp + 7*24*60*60 + BLOCK_MAX_TIME_DRIFT >= ctx->earliestKeyTime)) {
+        // when syncing headers first, keep requesting headers until there are fewer than 2000
+        if (count >= 2000 || (timestamp > 0 && timestamp + 7*24*60*60 + BLOCK_MAX_TIME_DRIFT >= ctx->earliestKeyTime) ||
+            ctx->headersFirst) {
             size_t last = 0;
             time_t now = time(NULL);
             UInt256 locators[2];
+            BRMerkleBlock **blocks = (count > 0) ? malloc(count*sizeof(*blocks)) : NULL;
+            uint8_t *valid = (count > 0) ? malloc(count*sizeof(*valid)) : NULL;
             
-            BRSHA256_2(&locators[0], &msg[off + 81*(count - 1)], 80);
-            BRSHA256_2(&locators[1], &msg[off], 80);
+            if (count > 0) {
+                BRSHA256_2(&locators[0], &msg[off + 81*(count - 1)], 80);
+                BRSHA256_2(&locators[1], &msg[off], 80);
+            }
 
-            if (timestamp > 0 && timestamp + 7*24*60*60 + BLOCK_MAX_TIME_DRIFT >= ctx->earliestKeyTime) {
+            if (ctx->headersFirst) {
+                if (count >= 2000) BRPeerSendGetheaders(peer, locators, 2, UINT256_ZERO);
+            }
+            else if (timestamp > 0 && timestamp + 7*24*60*60 + BLOCK_MAX_TIME_DRIFT >= ctx->earliestKeyTime) {
                 // request blocks for the remainder of the chain
                 timestamp = (++last < count) ? UInt32GetLE(&msg[off + 81*last + 68]) : 0;
 
@@ -494,14 +921,22 @@ static int _BRPeerAcceptHeadersMessage(BRPeer *peer, const uint8_t *msg, size_t
             }
             else BRPeerSendGetheaders(peer, locators, 2, UINT256_ZERO);
 
-            for (size_t i = 0; r && i < count; i++) {
-                BRMerkleBlock *block = BRMerkleBlockParse(&msg[off + 81*i], 81);
+            if (count > 0) {
+                assert(blocks != NULL && valid != NULL);
+                _BRPeerValidateHeadersParallel(&msg[off], count, (uint32_t)now, blocks, valid);
+            }
+            
+            for (size_t i = 0; i < count; i++) {
+                BRMerkleBlock *block = blocks[i];
                 
-                if (! block) {
+                if (! r) { // free the headers after an invalid one
+                    if (block) BRMerkleBlockFree(block);
+                }
+                else if (! block) {
                     peer_log(peer, "malformed headers message with length: %zu", msgLen);
                     r = 0;
                 }
-                else if (! BRMerkleBlockIsValid(block, (uint32_t)now)) {
+                else if (! valid[i]) {
                     peer_log(peer, "invalid block header: %s", u256hex(block->blockHash));
                     BRMerkleBlockFree(block);
                     r = 0;
@@ -511,6 +946,9 @@ static int _BRPeerAcceptHeadersMessage(BRPeer *peer, const uint8_t *msg, size_t
                 }
                 else BRMerkleBlockFree(block);
             }
+            
+            if (blocks) free(blocks);
+            if (valid) free(valid);
         }
         else {
             peer_log(peer, "non-standard headers message, %zu is fewer header(s) than expected", count);
@@ -528,6 +966,70 @@ static int _BRPeerAcceptGetaddrMessage(BRPeer *peer, const uint8_t *msg, size_t
     return 1;
 }
 
+typedef struct {
+    UInt256 wtxHash;
+    size_t refCount; // one for each sender, plus one while it's in _txPayloads
+    size_t len;
+    uint8_t bytes[];
+} tx_payload;
+
+// a tx that's published is requested by every connected peer, it's serialized once for all of them and shared
+static pthread_mutex_t _txPayloadLock = PTHREAD_MUTEX_INITIALIZER;
+static tx_payload *_txPayloads[TX_PAYLOAD_COUNT];
+static size_t _txPayloadNext = 0; // slot replaced by the next newly serialized tx
+
+// returns the serialized tx, release it with _BRPeerTxPayloadRelease()
+static tx_payload *_BRPeerTxPayloadRetain(const BRTransaction *tx)
+{
+    tx_payload *payload = NULL, *old = NULL;
+    size_t i, len;
+
+    pthread_mutex_lock(&_txPayloadLock);
+
+    for (i = 0; ! payload && i < TX_PAYLOAD_COUNT; i++) {
+        if (_txPayloads[i] && UInt256Eq(_txPayloads[i]->wtxHash, tx->wtxHash)) payload = _txPayloads[i];
+    }
+
+    if (payload) payload->refCount++;
+    pthread_mutex_unlock(&_txPayloadLock);
+    if (payload) return payload;
+
+    len = BRTransactionSerialize(tx, NULL, 0);
+    payload = malloc(sizeof(*payload) + len);
+    assert(payload != NULL);
+    payload->wtxHash = tx->wtxHash;
+    payload->refCount = 1;
+    payload->len = BRTransactionSerialize(tx, payload->bytes, len);
+    if (UInt256IsZero(tx->wtxHash)) return payload; // unsigned tx aren't shared
+    pthread_mutex_lock(&_txPayloadLock);
+
+    for (i = 0; i < TX_PAYLOAD_COUNT; i++) { // another peer may have serialized it in the meantime
+        if (_txPayloads[i] && UInt256Eq(_txPayloads[i]->wtxHash, tx->wtxHash)) break;
+    }
+
+    if (i == TX_PAYLOAD_COUNT) {
+        old = _txPayloads[_txPayloadNext];
+        if (old && --old->refCount > 0) old = NULL; // still being sent, the last sender frees it
+        _txPayloads[_txPayloadNext] = payload;
+        _txPayloadNext = (_txPayloadNext + 1) % TX_PAYLOAD_COUNT;
+        payload->refCount++;
+    }
+
+    pthread_mutex_unlock(&_txPayloadLock);
+    if (old) free(old);
+    return payload;
+}
+
+static void _BRPeerTxPayloadRelease(tx_payload *payload)
+{
+    size_t refCount;
+
+    pthread_mutex_lock(&_txPayloadLock);
+    refCount = --payload->refCount;
+    pthread_mutex_unlock(&_txPayloadLock);
+    if (refCount == 0) free(payload);
+}
+
 static int _BRPeerAcceptGetdataMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
@@ -558,16 +1060,16 @@ static int _BRPeerAcceptGetdataMessage(BRPeer *peer, const uint8_t *msg, size_t
                     if (ctx->requestedTx) tx = ctx->requestedTx(ctx->info, hash);
 
                     if (tx && BRTransactionVSize(tx) < TX_MAX_SIZE) {
-                        uint8_t buf[BRTransactionSerialize(tx, NULL, 0)];
-                        size_t bufLen = BRTransactionSerialize(tx, buf, sizeof(buf));
-                        char txHex[bufLen*2 + 1];
+                        tx_payload *payload = _BRPeerTxPayloadRetain(tx);
+                        char txHex[payload->len*2 + 1];
                         
-                        for (size_t j = 0; j < bufLen; j++) {
-                            sprintf(&txHex[j*2], "%02x", buf[j]);
+                        for (size_t j = 0; j < payload->len; j++) {
+                            sprintf(&txHex[j*2], "%02x", payload->bytes[j]);
                         }
                         
                         peer_log(peer, "publishing tx: %s", txHex);
-                        BRPeerSendMessage(peer, buf, bufLen, MSG_TX);
+                        BRPeerSendMessage(peer, payload->bytes, payload->len, MSG_TX);
+                        _BRPeerTxPayloadRelease(payload);
                         break;
                     }
                     
@@ -626,7 +1128,7 @@ static int _BRPeerAcceptNotfoundMessage(BRPeer *peer, const uint8_t *msg, size_t
             
             switch (type) {
                 case inv_witness_tx: // drop through
-                case inv_tx: array_add(txHashes, hash); break;
+                case inv_tx: array_add(txHashes, hash); _BRPeerTxRequestDone(ctx, hash, 0); break;
                 case inv_filtered_witness_block: // drop through
                 case inv_witness_block: // drop through
                 case inv_filtered_block: // drop through
@@ -691,6 +1193,7 @@ static int _BRPeerAcceptPongMessage(BRPeer *peer, const uint8_t *msg, size_t msg
             // 50% low pass filter on current ping time
             ctx->pingTime = ctx->pingTime*0.5 + pingTime*0.5;
             ctx->startTime = 0;
+            BRStatsRecord(BRStatsPeerPingTime, (uint64_t)(pingTime*1000000));
             peer_log(peer, "got pong in %fs", pingTime);
         }
         else peer_log(peer, "got pong");
@@ -714,14 +1217,16 @@ static int _BRPeerAcceptMerkleblockMessage(BRPeer *peer, const uint8_t *msg, siz
     // a merkleblock message, the remote node is expected to send tx messages for the tx referenced in the block. When a
     // non-tx message is received we should have all the tx in the merkleblock.
     BRPeerContext *ctx = (BRPeerContext *)peer;
-    BRMerkleBlock *block = BRMerkleBlockParse(msg, msgLen);
+    BRMerkleBlock *block = BRMerkleBlockParseArena(msg, msgLen);
+    UInt256 _hashes[128], *hashes = _hashes;
+    size_t count = 0;
     int r = 1;
   
     if (! block) {
         peer_log(peer, "malformed merkleblock message with length: %zu", msgLen);
         r = 0;
     }
-    else if (! BRMerkleBlockIsValid(block, (uint32_t)time(NULL))) {
+    else if (! BRMerkleBlockIsValidTxHashes(block, (uint32_t)time(NULL), _hashes, 128, &count)) {
         peer_log(peer, "invalid merkleblock: %s", u256hex(block->blockHash));
         BRMerkleBlockFree(block);
         block = NULL;
@@ -734,14 +1239,14 @@ static int _BRPeerAcceptMerkleblockMessage(BRPeer *peer, const uint8_t *msg, siz
         r = 0;
     }
     else {
-        size_t count = BRMerkleBlockTxHashes(block, NULL, 0);
-        UInt256 _hashes[128], *hashes = (count <= 128) ? _hashes : malloc(count*sizeof(UInt256));
-        
-        assert(hashes != NULL);
-        count = BRMerkleBlockTxHashes(block, hashes, count);
+        if (count > 128) { // the merkle tree was already walked for the first 128, walk it again for the rest
+            hashes = malloc(count*sizeof(UInt256));
+            assert(hashes != NULL);
+            count = BRMerkleBlockTxHashes(block, hashes, count);
+        }
 
         for (size_t i = count; i > 0; i--) { // reverse order for more efficient removal as tx arrive
-            if (BRSetContains(ctx->knownTxHashSet, &hashes[i - 1])) continue;
+            if (_BRPeerKnowsTxHash(ctx, &hashes[i - 1])) continue;
             array_add(ctx->currentBlockTxHashes, hashes[i - 1]);
         }
 
@@ -761,172 +1266,595 @@ static int _BRPeerAcceptMerkleblockMessage(BRPeer *peer, const uint8_t *msg, siz
     return r;
 }
 
-// described in BIP61: https://github.com/bitcoin/bips/blob/master/bip-0061.mediawiki
-static int _BRPeerAcceptRejectMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
+// full blocks are only requested when a compact block filter matches, the block is relayed as a merkleblock with a
+// complete merkle tree, after each of its transactions
+static int _BRPeerAcceptBlockMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
-    size_t off = 0, strLen = (size_t)BRVarInt(msg, msgLen, &off);
+    size_t off = 80, l = 0, count = (msgLen > off) ? (size_t)BRVarInt(&msg[off], msgLen - off, &l) : 0, i, n, w;
+    BRMerkleBlock *block = NULL;
     int r = 1;
     
-    if (off + strLen + sizeof(uint8_t) > msgLen) {
-        peer_log(peer, "malformed reject message, length is %zu, should be >= %zu", msgLen,
-                 off + strLen + sizeof(uint8_t));
+    if (l == 0 || count == 0 || count > (msgLen - off - l)/60) { // transactions are at least 60 bytes
+        peer_log(peer, "malformed block message with length: %zu", msgLen);
+        r = 0;
+    }
+    else if (! ctx->sentGetdata) {
+        peer_log(peer, "got block message without requesting it");
         r = 0;
     }
     else {
-        char type[(strLen < 0x1000) ? strLen + 1 : 0x1000];
-        uint8_t code;
-        size_t len = 0, hashLen = 0;
-
-        strncpy(type, (const char *)&msg[off], sizeof(type) - 1);
-        type[sizeof(type) - 1] = '\0';
-        off += strLen;
-        code = msg[off++];
-        strLen = (size_t)BRVarInt(&msg[off], (off <= msgLen ? msgLen - off : 0), &len);
-        off += len;
-        if (strncmp(type, MSG_TX, sizeof(type)) == 0) hashLen = sizeof(UInt256);
+        BRTransaction **transactions = calloc(count, sizeof(*transactions));
+        UInt256 *hashes = malloc(count*sizeof(*hashes));
         
-        if (off + strLen + hashLen > msgLen) {
-            peer_log(peer, "malformed reject message, length is %zu, should be >= %zu", msgLen, off + strLen + hashLen);
+        assert(transactions != NULL);
+        assert(hashes != NULL);
+        off += l;
+
+        for (i = 0; i < count && off < msgLen; i++) {
+            transactions[i] = BRTransactionParseArena(&msg[off], msgLen - off);
+            if (! transactions[i]) break;
+            off += BRTransactionSerialize(transactions[i], NULL, 0);
+            hashes[i] = transactions[i]->txHash;
+        }
+
+        for (n = 0, w = count; ; w = (w + 1)/2) { // every node of the tree is flagged as the parent of a matched tx
+            n += w;
+            if (w <= 1) break;
+        }
+
+        uint8_t flags[(n + 7)/8];
+
+        memset(flags, 0xff, sizeof(flags));
+        block = (i == count && off == msgLen) ? BRMerkleBlockParse(msg, 80) : NULL;
+
+        if (block) {
+            block->totalTx = (uint32_t)count;
+            BRMerkleBlockSetTxHashes(block, hashes, count, flags, sizeof(flags));
+        }
+
+        if (! block || ! BRMerkleBlockIsValid(block, (uint32_t)time(NULL))) {
+            peer_log(peer, "invalid block message with length: %zu", msgLen);
+            if (block) BRMerkleBlockFree(block);
+            block = NULL;
             r = 0;
         }
-        else {
-            char reason[(strLen < 0x1000) ? strLen + 1 : 0x1000];
-            UInt256 txHash = UINT256_ZERO;
-            
-            strncpy(reason, (const char *)&msg[off], sizeof(reason) - 1);
-            reason[sizeof(reason) - 1] = '\0';
-            off += strLen;
-            if (hashLen == sizeof(UInt256)) txHash = UInt256Get(&msg[off]);
-            off += hashLen;
+        else peer_log(peer, "got block %s with %zu tx", u256hex(block->blockHash), count);
 
-            if (! UInt256IsZero(txHash)) {
-                peer_log(peer, "rejected %s code: 0x%x reason: \"%s\" txid: %s", type, code, reason, u256hex(txHash));
-                if (ctx->rejectedTx) ctx->rejectedTx(ctx->info, txHash, code);
-            }
-            else peer_log(peer, "rejected %s code: 0x%x reason: \"%s\"", type, code, reason);
+        for (i = 0; i < count && transactions[i]; i++) {
+            if (block && ctx->relayedTx) ctx->relayedTx(ctx->info, transactions[i]);
+            else BRTransactionFree(transactions[i]);
         }
+
+        free(transactions);
+        free(hashes);
+        
+        if (block && ctx->relayedBlock) ctx->relayedBlock(ctx->info, block);
+        else if (block) BRMerkleBlockFree(block);
     }
 
     return r;
 }
 
-// BIP133: https://github.com/bitcoin/bips/blob/master/bip-0133.mediawiki
-static int _BRPeerAcceptFeeFilterMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
+// described in BIP157: https://github.com/bitcoin/bips/blob/master/bip-0157.mediawiki
+static int _BRPeerAcceptCfilterMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
+    size_t off = 1 + sizeof(UInt256), l = 0;
+    uint64_t len = (msgLen > off) ? BRVarInt(&msg[off], msgLen - off, &l) : 0;
     int r = 1;
     
-    if (sizeof(uint64_t) > msgLen) {
-        peer_log(peer, "malformed feefilter message, length is %zu, should be >= %zu", msgLen, sizeof(uint64_t));
+    if (l == 0 || len > msgLen - off - l) {
+        peer_log(peer, "malformed cfilter message with length: %zu", msgLen);
         r = 0;
     }
-    else {
-        pthread_mutex_lock(&ctx->lock);
-        ctx->feePerKb = UInt64GetLE(msg);
-        pthread_mutex_unlock(&ctx->lock);
-        
-        peer_log(peer, "got feefilter with rate %"PRIu64, ctx->feePerKb);
-        if (ctx->setFeePerKb) ctx->setFeePerKb(ctx->info, ctx->feePerKb);
+    else if (! ctx->sentGetcfilters) {
+        peer_log(peer, "got cfilter message without requesting it");
+        r = 0;
     }
-    
+    else if (msg[0] != BLOCK_FILTER_BASIC) {
+        peer_log(peer, "dropping cfilter message, unknown filter type %d", msg[0]);
+    }
+    else if (ctx->relayedFilter) ctx->relayedFilter(ctx->info, UInt256Get(&msg[1]), &msg[off + l], (size_t)len);
+
     return r;
 }
 
-static int _BRPeerAcceptMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen, const char *type)
+// described in BIP61: https://github.com/bitcoin/bips/blob/master/bip-0061.mediawiki
+// described in BIP152: https://github.com/bitcoin/bips/blob/master/bip-0152.mediawiki
+static int _BRPeerAcceptSendcmpctMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
     int r = 1;
-    
-    if (ctx->currentBlock && strncmp(MSG_TX, type, 12) != 0) { // if we receive a non-tx message, merkleblock is done
-        peer_log(peer, "incomplete merkleblock %s, expected %zu more tx, got %s", u256hex(ctx->currentBlock->blockHash),
-                 array_count(ctx->currentBlockTxHashes), type);
-        array_clear(ctx->currentBlockTxHashes);
-        ctx->currentBlock = NULL;
+
+    if (sizeof(uint8_t) + sizeof(uint64_t) > msgLen) {
+        peer_log(peer, "malformed sendcmpct message, length is %zu, should be %zu", msgLen,
+                 sizeof(uint8_t) + sizeof(uint64_t));
         r = 0;
     }
-    else if (strncmp(MSG_VERSION, type, 12) == 0) r = _BRPeerAcceptVersionMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_VERACK, type, 12) == 0) r = _BRPeerAcceptVerackMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_ADDR, type, 12) == 0) r = _BRPeerAcceptAddrMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_INV, type, 12) == 0) r = _BRPeerAcceptInvMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_TX, type, 12) == 0) r = _BRPeerAcceptTxMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_HEADERS, type, 12) == 0) r = _BRPeerAcceptHeadersMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_GETADDR, type, 12) == 0) r = _BRPeerAcceptGetaddrMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_GETDATA, type, 12) == 0) r = _BRPeerAcceptGetdataMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_NOTFOUND, type, 12) == 0) r = _BRPeerAcceptNotfoundMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_PING, type, 12) == 0) r = _BRPeerAcceptPingMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_PONG, type, 12) == 0) r = _BRPeerAcceptPongMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_MERKLEBLOCK, type, 12) == 0) r = _BRPeerAcceptMerkleblockMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_REJECT, type, 12) == 0) r = _BRPeerAcceptRejectMessage(peer, msg, msgLen);
-    else if (strncmp(MSG_FEEFILTER, type, 12) == 0) r = _BRPeerAcceptFeeFilterMessage(peer, msg, msgLen);
-    else peer_log(peer, "dropping %s, length %zu, not implemented", type, msgLen);
+    else if (UInt64GetLE(&msg[1]) == 2) { // version 2 compact blocks have short ids of wtxids and witness tx
+        peer_log(peer, "got sendcmpct version 2");
+        ctx->cmpctWitness = 1;
+    }
 
     return r;
 }
 
-static int _BRPeerOpenSocket(BRPeer *peer, int domain, double timeout, int *error)
+inline static size_t _BRPeerShortIdHash(const void *shortId)
+{
+    return (size_t)*(const uint64_t *)shortId;
+}
+
+inline static int _BRPeerShortIdEq(const void *shortId, const void *otherShortId)
+{
+    return (*(const uint64_t *)shortId == *(const uint64_t *)otherShortId);
+}
+
+// serializes the block reconstructed from a compact block and processes it as a block message, or requests the full
+// block if it's invalid, which can happen if a tx matched the short id of a different tx in the block
+static void _BRPeerCmpctBlockDone(BRPeer *peer)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
-    struct sockaddr_storage addr;
-    struct timeval tv;
-    fd_set fds;
-    socklen_t addrLen, optLen;
-    int count, arg = 0, err = 0, on = 1, r = 1;
+    size_t i, off = 80, len = off + BRVarIntSize(ctx->cmpctCount);
+    uint8_t *buf;
+
+    for (i = 0; i < ctx->cmpctCount; i++) len += BRTransactionSerialize(ctx->cmpctTx[i], NULL, 0);
+    buf = malloc(len);
+    assert(buf != NULL);
+    memcpy(buf, ctx->cmpctHeader, 80);
+    off += BRVarIntSet(&buf[off], len - off, ctx->cmpctCount);
+
+    for (i = 0; i < ctx->cmpctCount; i++) {
+        off += BRTransactionSerialize(ctx->cmpctTx[i], &buf[off], len - off);
+        BRTransactionFree(ctx->cmpctTx[i]);
+    }
 
-    ctx->socket = socket(domain, SOCK_STREAM, 0);
-    
-    if (ctx->socket < 0) {
-        err = errno;
+    free(ctx->cmpctTx);
+    ctx->cmpctTx = NULL;
+    ctx->cmpctCount = 0;
+
+    if (! _BRPeerAcceptBlockMessage(peer, buf, off)) {
+        peer_log(peer, "couldn't reconstruct compact block %s, requesting full block", u256hex(ctx->cmpctHash));
+        _BRPeerSendGetblockdata(peer, &ctx->cmpctHash, 1, inv_witness_block);
+    }
+
+    free(buf);
+}
+
+// frees the tx of a partially reconstructed compact block
+static void _BRPeerCmpctBlockClear(BRPeerContext *ctx)
+{
+    for (size_t i = 0; i < ctx->cmpctCount; i++) {
+        if (ctx->cmpctTx[i]) BRTransactionFree(ctx->cmpctTx[i]);
+    }
+
+    free(ctx->cmpctTx);
+    ctx->cmpctTx = NULL;
+    ctx->cmpctCount = 0;
+}
+
+// the block is reconstructed from prefilled tx, and tx returned by the knownTx callback whose wtxid has a matching
+// short id, then any remaining tx are requested with getblocktxn
+static int _BRPeerAcceptCmpctblockMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    size_t off = 80 + sizeof(uint64_t), l = 0, idLen = 6, idCount, preCount, count = 0, i, j, txCount;
+    uint64_t *shortIds, shortId[2] = { 0, 0 }, *id;
+    uint8_t key[32];
+    int r = 1;
+
+    idCount = (msgLen > off) ? (size_t)BRVarInt(&msg[off], msgLen - off, &l) : 0;
+    off += l;
+    if (l == 0 || idCount > (msgLen - off)/idLen) off = msgLen + 1;
+    else off += idCount*idLen;
+    preCount = (off < msgLen) ? (size_t)BRVarInt(&msg[off], msgLen - off, &l) : 0;
+    off += (off < msgLen) ? l : msgLen + 1;
+
+    if (off > msgLen || preCount > (msgLen - off)/60 || idCount + preCount == 0) { // tx are at least 60 bytes
+        peer_log(peer, "malformed cmpctblock message with length: %zu", msgLen);
+        r = 0;
+    }
+    else if (! ctx->sentGetdata) {
+        peer_log(peer, "got cmpctblock message without requesting it");
         r = 0;
     }
     else {
-        tv.tv_sec = 1; // one second timeout for send/receive, so thread doesn't block for too long
-        tv.tv_usec = 0;
-        setsockopt(ctx->socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-        setsockopt(ctx->socket, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
-        setsockopt(ctx->socket, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
-#ifdef SO_NOSIGPIPE // BSD based systems have a SO_NOSIGPIPE socket option to supress SIGPIPE signals
-        setsockopt(ctx->socket, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
-#endif
-        arg = fcntl(ctx->socket, F_GETFL, NULL);
-        if (arg < 0 || fcntl(ctx->socket, F_SETFL, arg | O_NONBLOCK) < 0) r = 0; // temporarily set socket non-blocking
-        if (! r) err = errno;
+        if (ctx->cmpctTx) _BRPeerCmpctBlockClear(ctx); // a previous compact block is replaced
+        memcpy(ctx->cmpctHeader, msg, 80);
+        BRSHA256_2(&ctx->cmpctHash, msg, 80);
+        ctx->cmpctCount = idCount + preCount;
+        ctx->cmpctTx = calloc(ctx->cmpctCount, sizeof(*ctx->cmpctTx));
+        assert(ctx->cmpctTx != NULL);
+
+        for (i = 0, j = SIZE_MAX; r && i < preCount; i++) { // prefilled indexes are differentially encoded
+            j += (size_t)BRVarInt(&msg[off], msgLen - off, &l) + 1;
+            off += l;
+            if (l == 0 || j >= ctx->cmpctCount || ctx->cmpctTx[j]) r = 0;
+            if (r) ctx->cmpctTx[j] = BRTransactionParse(&msg[off], msgLen - off);
+            if (r && ! ctx->cmpctTx[j]) r = 0;
+            if (r) off += BRTransactionSerialize(ctx->cmpctTx[j], NULL, 0);
+        }
+
+        if (! r) {
+            peer_log(peer, "invalid cmpctblock message with length: %zu", msgLen);
+            _BRPeerCmpctBlockClear(ctx);
+            return r;
+        }
+
+        // short ids are the lower 6 bytes of the sipHash of each wtxid, keyed by the hash of the header and nonce
+        BRSHA256(key, msg, 80 + sizeof(uint64_t));
+        shortIds = calloc(idCount*2 + 1, sizeof(*shortIds)); // each short id is followed by its index in the block
+        assert(shortIds != NULL);
+
+        BRSet *idSet = BRSetNew(_BRPeerShortIdHash, _BRPeerShortIdEq, idCount);
+        
+        for (i = 0, j = 0, off = 80 + sizeof(uint64_t) + BRVarIntSize(idCount); i < idCount; i++, off += idLen) {
+            while (ctx->cmpctTx[j]) j++; // short ids are for the tx that aren't prefilled, in order
+            shortIds[i*2] = UInt32GetLE(&msg[off]) | (uint64_t)UInt16GetLE(&msg[off + 4]) << 32;
+            shortIds[i*2 + 1] = j++;
+            BRSetAdd(idSet, &shortIds[i*2]);
+        }
+
+        txCount = (ctx->knownTx) ? ctx->knownTx(ctx->info, NULL, 0) : 0;
+
+        BRTransaction *_knownTx[(txCount <= 0x1000) ? txCount + 1 : 1], **knownTx = (txCount <= 0x1000) ? _knownTx :
+            malloc(txCount*sizeof(*knownTx));
+        
+        assert(knownTx != NULL);
+        if (txCount > 0) txCount = ctx->knownTx(ctx->info, knownTx, txCount);
+
+        for (i = 0; i < txCount; i++) {
+            shortId[0] = BRSip64(key, knownTx[i]->wtxHash.u8, sizeof(UInt256)) & 0xffffffffffffULL;
+            id = BRSetGet(idSet, shortId);
+            j = (id) ? (size_t)id[1] : 0;
+
+            if (! id) BRTransactionFree(knownTx[i]);
+            else if (ctx->cmpctTx[j]) { // a short id shared by more than one known tx is requested with getblocktxn
+                BRTransactionFree(ctx->cmpctTx[j]);
+                BRTransactionFree(knownTx[i]);
+                ctx->cmpctTx[j] = NULL;
+                BRSetRemove(idSet, id);
+            }
+            else ctx->cmpctTx[j] = knownTx[i]; // the known tx are copies that peer owns
+        }
+
+        if (knownTx != _knownTx) free(knownTx);
+        BRSetFree(idSet);
+        free(shortIds);
+
+        for (i = 0; i < ctx->cmpctCount; i++) {
+            if (! ctx->cmpctTx[i]) count++;
+        }
+
+        peer_log(peer, "got cmpctblock %s with %zu tx, %zu missing", u256hex(ctx->cmpctHash), ctx->cmpctCount, count);
+
+        if (count == 0) _BRPeerCmpctBlockDone(peer);
+        else {
+            size_t getLen = sizeof(UInt256) + BRVarIntSize(count) + count*9; // indexes are at most 9 byte varints
+            uint8_t *getMsg = malloc(getLen);
+
+            assert(getMsg != NULL);
+            UInt256Set(getMsg, ctx->cmpctHash);
+            off = sizeof(UInt256);
+            off += BRVarIntSet(&getMsg[off], getLen - off, count);
+
+            for (i = 0, j = SIZE_MAX; i < ctx->cmpctCount; i++) { // missing indexes are differentially encoded
+                if (ctx->cmpctTx[i]) continue;
+                off += BRVarIntSet(&getMsg[off], getLen - off, i - j - 1);
+                j = i;
+            }
+
+            BRPeerSendMessage(peer, getMsg, off, MSG_GETBLOCKTXN);
+            free(getMsg);
+        }
     }
 
-    if (r) {
-        memset(&addr, 0, sizeof(addr));
+    return r;
+}
+
+static int _BRPeerAcceptBlocktxnMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    size_t off = sizeof(UInt256), l = 0, count = (msgLen > off) ? (size_t)BRVarInt(&msg[off], msgLen - off, &l) : 0, i;
+    int r = 1;
+
+    off += l;
+
+    if (l == 0 || count > (msgLen - off)/60) {
+        peer_log(peer, "malformed blocktxn message with length: %zu", msgLen);
+        r = 0;
+    }
+    else if (! ctx->cmpctTx || ! UInt256Eq(UInt256Get(msg), ctx->cmpctHash)) {
+        peer_log(peer, "got blocktxn message for %s without requesting it", u256hex(UInt256Get(msg)));
+    }
+    else {
+        for (i = 0; r && i < ctx->cmpctCount; i++) { // tx are in the order of the missing indexes that were requested
+            if (ctx->cmpctTx[i]) continue;
+            if (count-- == 0 || off >= msgLen) r = 0;
+            if (r) ctx->cmpctTx[i] = BRTransactionParse(&msg[off], msgLen - off);
+            if (r && ! ctx->cmpctTx[i]) r = 0;
+            if (r) off += BRTransactionSerialize(ctx->cmpctTx[i], NULL, 0);
+        }
+
+        if (! r || count != 0 || off != msgLen) {
+            peer_log(peer, "invalid blocktxn message with length: %zu", msgLen);
+            _BRPeerCmpctBlockClear(ctx);
+            r = 0;
+        }
+        else _BRPeerCmpctBlockDone(peer);
+    }
+
+    return r;
+}
+
+static int _BRPeerAcceptRejectMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    size_t off = 0, strLen = (size_t)BRVarInt(msg, msgLen, &off);
+    int r = 1;
+    
+    if (off + strLen + sizeof(uint8_t) > msgLen) {
+        peer_log(peer, "malformed reject message, length is %zu, should be >= %zu", msgLen,
+                 off + strLen + sizeof(uint8_t));
+        r = 0;
+    }
+    else {
+        char type[(strLen < 0x1000) ? strLen + 1 : 0x1000];
+        uint8_t code;
+        size_t len = 0, hashLen = 0;
+
+        strncpy(type, (const char *)&msg[off], sizeof(type) - 1);
+        type[sizeof(type) - 1] = '\0';
+        off += strLen;
+        code = msg[off++];
+        strLen = (size_t)BRVarInt(&msg[off], (off <= msgLen ? msgLen - off : 0), &len);
+        off += len;
+        if (strncmp(type, MSG_TX, sizeof(type)) == 0) hashLen = sizeof(UInt256);
         
-        if (domain == PF_INET6) {
-            ((struct sockaddr_in6 *)&addr)->sin6_family = AF_INET6;
-            ((struct sockaddr_in6 *)&addr)->sin6_addr = *(struct in6_addr *)&peer->address;
-            ((struct sockaddr_in6 *)&addr)->sin6_port = htons(peer->port);
-            addrLen = sizeof(struct sockaddr_in6);
+        if (off + strLen + hashLen > msgLen) {
+            peer_log(peer, "malformed reject message, length is %zu, should be >= %zu", msgLen, off + strLen + hashLen);
+            r = 0;
         }
         else {
-            ((struct sockaddr_in *)&addr)->sin_family = AF_INET;
-            ((struct sockaddr_in *)&addr)->sin_addr = *(struct in_addr *)&peer->address.u32[3];
-            ((struct sockaddr_in *)&addr)->sin_port = htons(peer->port);
-            addrLen = sizeof(struct sockaddr_in);
+            char reason[(strLen < 0x1000) ? strLen + 1 : 0x1000];
+            UInt256 txHash = UINT256_ZERO;
+            
+            strncpy(reason, (const char *)&msg[off], sizeof(reason) - 1);
+            reason[sizeof(reason) - 1] = '\0';
+            off += strLen;
+            if (hashLen == sizeof(UInt256)) txHash = UInt256Get(&msg[off]);
+            off += hashLen;
+
+            if (! UInt256IsZero(txHash)) {
+                peer_log(peer, "rejected %s code: 0x%x reason: \"%s\" txid: %s", type, code, reason, u256hex(txHash));
+                if (ctx->rejectedTx) ctx->rejectedTx(ctx->info, txHash, code);
+            }
+            else peer_log(peer, "rejected %s code: 0x%x reason: \"%s\"", type, code, reason);
         }
+    }
+
+    return r;
+}
+
+// BIP133: https://github.com/bitcoin/bips/blob/master/bip-0133.mediawiki
+static int _BRPeerAcceptFeeFilterMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    int r = 1;
+    
+    if (sizeof(uint64_t) > msgLen) {
+        peer_log(peer, "malformed feefilter message, length is %zu, should be >= %zu", msgLen, sizeof(uint64_t));
+        r = 0;
+    }
+    else {
+        pthread_mutex_lock(&ctx->lock);
+        ctx->feePerKb = UInt64GetLE(msg);
+        pthread_mutex_unlock(&ctx->lock);
         
-        if (connect(ctx->socket, (struct sockaddr *)&addr, addrLen) < 0) err = errno;
+        peer_log(peer, "got feefilter with rate %"PRIu64, ctx->feePerKb);
+        if (ctx->setFeePerKb) ctx->setFeePerKb(ctx->info, ctx->feePerKb);
+    }
+    
+    return r;
+}
+
+// handlers for received messages, in _BRPeerMsgTypes index order, NULL for types that are only sent
+static int (*const _BRPeerMsgHandlers[])(BRPeer *peer, const uint8_t *msg, size_t msgLen) = {
+    _BRPeerAcceptVersionMessage, _BRPeerAcceptVerackMessage, _BRPeerAcceptAddrMessage, _BRPeerAcceptInvMessage,
+    _BRPeerAcceptGetdataMessage, _BRPeerAcceptNotfoundMessage, NULL, NULL, // getblocks, getheaders
+    _BRPeerAcceptTxMessage, _BRPeerAcceptBlockMessage, _BRPeerAcceptHeadersMessage, _BRPeerAcceptGetaddrMessage,
+    NULL, _BRPeerAcceptPingMessage, _BRPeerAcceptPongMessage, NULL, NULL, NULL, // mempool, filterload/add/clear
+    _BRPeerAcceptMerkleblockMessage, NULL, _BRPeerAcceptRejectMessage, _BRPeerAcceptFeeFilterMessage, // alert
+    NULL, _BRPeerAcceptCfilterMessage, // getcfilters
+    _BRPeerAcceptSendcmpctMessage, _BRPeerAcceptCmpctblockMessage, NULL, _BRPeerAcceptBlocktxnMessage // getblocktxn
+};
+
+static int _BRPeerAcceptMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen, const char *type)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    uint64_t key[2];
+    size_t i = _BRPeerMsgTypeIndex(key, type), j = array_count(ctx->msgHandlers);
+    int (*handler)(BRPeer *, const uint8_t *, size_t) = (i < MSG_TYPES_COUNT) ? _BRPeerMsgHandlers[i] : NULL;
+    int r = 1;
+
+    assert(sizeof(_BRPeerMsgHandlers)/sizeof(*_BRPeerMsgHandlers) == MSG_TYPES_COUNT);
+    
+    if (ctx->currentBlock && handler != _BRPeerAcceptTxMessage) { // if we receive a non-tx message, merkleblock is done
+        peer_log(peer, "incomplete merkleblock %s, expected %zu more tx, got %s", u256hex(ctx->currentBlock->blockHash),
+                 array_count(ctx->currentBlockTxHashes), type);
+        array_clear(ctx->currentBlockTxHashes);
+        ctx->currentBlock = NULL;
+        r = 0;
+    }
+    else if (handler) r = handler(peer, msg, msgLen);
+    else {
+        while (j > 0 && (ctx->msgHandlers[j - 1].key[0] != key[0] || ctx->msgHandlers[j - 1].key[1] != key[1])) j--;
+        if (j > 0) r = ctx->msgHandlers[j - 1].handler(ctx->info, msg, msgLen);
+        else peer_log(peer, "dropping %s, length %zu, not implemented", type, msgLen);
+    }
+
+    return r;
+}
+
+// opens a socket and connects to peer, waiting up to timeout seconds, or if timeout is negative, leaving the socket
+// non-blocking with a connect in progress (loopState is then loop_connecting)
+// returns a new non-blocking socket with the options every peer connection uses, or -1 on error with errno set
+// flags is set to the socket's original file status flags, to be restored once it's connected
+static int _BRPeerNewSocket(int domain, int *flags)
+{
+    struct timeval tv;
+    int fd = socket(domain, SOCK_STREAM, 0), on = 1, err;
+
+    if (fd < 0) return fd;
+    tv.tv_sec = 1; // one second timeout for send/receive, so thread doesn't block for too long
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+#ifdef SO_NOSIGPIPE // BSD based systems have a SO_NOSIGPIPE socket option to supress SIGPIPE signals
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    *flags = fcntl(fd, F_GETFL, NULL);
+
+    if (*flags < 0 || fcntl(fd, F_SETFL, *flags | O_NONBLOCK) < 0) { // temporarily set socket non-blocking
+        err = errno;
+        close(fd);
+        errno = err;
+        fd = -1;
+    }
+
+    return fd;
+}
+
+// starts a non-blocking connect of fd to peer, returns 0 if it completed immediately, or an errno.h code
+static int _BRPeerStartConnect(BRPeer *peer, int fd, int domain)
+{
+    struct sockaddr_storage addr;
+    socklen_t addrLen;
+
+    memset(&addr, 0, sizeof(addr));
+
+    if (domain == PF_INET6) {
+        ((struct sockaddr_in6 *)&addr)->sin6_family = AF_INET6;
+        ((struct sockaddr_in6 *)&addr)->sin6_addr = *(struct in6_addr *)&peer->address;
+        ((struct sockaddr_in6 *)&addr)->sin6_port = htons(peer->port);
+        addrLen = sizeof(struct sockaddr_in6);
+    }
+    else {
+        ((struct sockaddr_in *)&addr)->sin_family = AF_INET;
+        ((struct sockaddr_in *)&addr)->sin_addr = *(struct in_addr *)&peer->address.u32[3];
+        ((struct sockaddr_in *)&addr)->sin_port = htons(peer->port);
+        addrLen = sizeof(struct sockaddr_in);
+    }
+
+    return (connect(fd, (struct sockaddr *)&addr, addrLen) < 0) ? errno : 0;
+}
+
+// waits up to timeout seconds for the connect in progress on ctx->socket, returns 0 once connected or an errno.h code
+// if race is true and the connect hasn't completed after CONNECT_RACE_DELAY, or fails first, an IPv4 connect is raced
+// against it (happy eyeballs, rfc 8305), and whichever completes first replaces ctx->socket
+static int _BRPeerWaitConnect(BRPeer *peer, int *flags, double timeout, int race)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    int fds[2] = { ctx->socket, -1 }, watch[2] = { 1, 0 }, flags4 = 0, count, maxFd, e, err = 0, winner = -1;
+    double now, deadline, raceTime, wait;
+    socklen_t optLen;
+    struct timeval tv;
+    fd_set set;
+
+    gettimeofday(&tv, NULL);
+    now = tv.tv_sec + (double)tv.tv_usec/1000000;
+    deadline = now + timeout;
+    raceTime = now + CONNECT_RACE_DELAY;
+
+    while (winner < 0) {
+        if (race && (! watch[0] || now >= raceTime)) { // no result yet, race an IPv4 connect against the first one
+            race = 0;
+            peer_log(peer, "racing IPv4 connect");
+            fds[1] = _BRPeerNewSocket(PF_INET, &flags4);
+            e = (fds[1] < 0) ? errno : _BRPeerStartConnect(peer, fds[1], PF_INET);
+            if (e == 0) winner = 1;
+            else if (e == EINPROGRESS) watch[1] = 1;
+            else err = e;
+            if (winner >= 0) break;
+        }
+
+        if (! watch[0] && ! watch[1]) break;
+
+        if (now >= deadline) {
+            err = ETIMEDOUT;
+            break;
+        }
+
+        wait = ((race && raceTime < deadline) ? raceTime : deadline) - now;
+        tv.tv_sec = (time_t)wait;
+        tv.tv_usec = (long)(wait*1000000) % 1000000;
+        FD_ZERO(&set);
+        maxFd = -1;
+
+        for (int i = 0; i < 2; i++) {
+            if (! watch[i]) continue;
+            FD_SET(fds[i], &set);
+            if (fds[i] > maxFd) maxFd = fds[i];
+        }
+
+        count = select(maxFd + 1, NULL, &set, NULL, &tv);
+
+        if (count < 0 && errno != EINTR) {
+            err = errno;
+            break;
+        }
+
+        for (int i = 0; count > 0 && winner < 0 && i < 2; i++) {
+            if (! watch[i] || ! FD_ISSET(fds[i], &set)) continue;
+            e = 0;
+            optLen = sizeof(e);
+            if (getsockopt(fds[i], SOL_SOCKET, SO_ERROR, &e, &optLen) < 0) e = errno;
+            if (e == 0) winner = i;
+            else err = e, watch[i] = 0;
+        }
+
+        gettimeofday(&tv, NULL);
+        now = tv.tv_sec + (double)tv.tv_usec/1000000;
+    }
+
+    if (fds[1] >= 0 && winner == 1) { // the IPv4 connect won, so it replaces the first socket
+        pthread_mutex_lock(&ctx->lock);
+        ctx->socket = fds[1];
+        pthread_mutex_unlock(&ctx->lock);
+        close(fds[0]);
+        *flags = flags4;
+    }
+    else if (fds[1] >= 0) close(fds[1]); // ctx->socket is left open on failure, and closed when the peer disconnects
+
+    return (winner >= 0) ? 0 : (err) ? err : ETIMEDOUT;
+}
+
+static int _BRPeerOpenSocket(BRPeer *peer, int domain, double timeout, int *error)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    int arg = 0, err = 0, r = 1;
+
+    ctx->socket = _BRPeerNewSocket(domain, &arg);
+    
+    if (ctx->socket < 0) {
+        err = errno;
+        r = 0;
+    }
+    else {
+        err = _BRPeerStartConnect(peer, ctx->socket, domain);
         
-        if (err == EINPROGRESS) {
-            err = 0;
-            optLen = sizeof(err);
-            tv.tv_sec = timeout;
-            tv.tv_usec = (long)(timeout*1000000) % 1000000;
-            FD_ZERO(&fds);
-            FD_SET(ctx->socket, &fds);
-            count = select(ctx->socket + 1, NULL, &fds, NULL, &tv);
-
-            if (count <= 0 || getsockopt(ctx->socket, SOL_SOCKET, SO_ERROR, &err, &optLen) < 0 || err) {
-                if (count == 0) err = ETIMEDOUT;
-                if (count < 0 || ! err) err = errno;
-                r = 0;
-            }
+        if (err == EINPROGRESS && timeout < 0) { // the event loop thread waits for the connect to complete
+            ctx->socketFlags = arg;
+            ctx->loopState = loop_connecting;
+            return r;
+        }
+        else if (err == EINPROGRESS) {
+            err = _BRPeerWaitConnect(peer, &arg, timeout, (domain == PF_INET6 && _BRPeerIsIPv4(peer)));
+            if (err) r = 0;
         }
         else if (err && domain == PF_INET6 && _BRPeerIsIPv4(peer)) {
+            close(ctx->socket);
             return _BRPeerOpenSocket(peer, PF_INET, timeout, error); // fallback to IPv4
         }
         else if (err) r = 0;
@@ -971,17 +1899,216 @@ static double _peerGetDisconnectTime (BRPeerContext *ctx) {
     return value;
 }
 
-static double _peerGetMempoolTime (BRPeerContext *ctx) {
-    double value;
+static double _peerGetMempoolTime (BRPeerContext *ctx) {
+    double value;
+
+    pthread_mutex_lock(&ctx->lock);
+    value = ctx->mempoolTime;
+    pthread_mutex_unlock(&ctx->lock);
+
+    return value;
+}
+
+
+// sends a ping in place of a mempool response that didn't arrive in time, so the mempool callback is still called
+static void _BRPeerMempoolTimeout(BRPeer *peer)
+{
+    peer_log(peer, "done waiting for mempool response");
+    _BRPeerMempoolDone(peer);
+}
+
+// returns an errno.h code if a complete message header is malformed
+static int _BRPeerCheckHeader(BRPeer *peer, const uint8_t *header)
+{
+    int error = 0;
+
+    if (header[15] != 0) { // verify header type field is NULL terminated
+        peer_log(peer, "malformed message header: type not NULL terminated");
+        error = EPROTO;
+    }
+    else if (UInt32GetLE(&header[16]) > MAX_MSG_LENGTH) { // check message length
+        peer_log(peer, "error reading %s, message length %"PRIu32" is too long", (const char *)&header[4],
+                 UInt32GetLE(&header[16]));
+        error = EPROTO;
+    }
+
+    return error;
+}
+
+// appends a message sent or received by peer to the file set with BRPeerSetRecorder()
+static void _BRPeerRecord(BRPeer *peer, uint8_t direction, const uint8_t *header, const uint8_t *payload,
+                          size_t payloadLen)
+{
+    FILE *file = ((BRPeerContext *)peer)->recordFile;
+    uint8_t prefix[RECORD_PREFIX_LEN];
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    prefix[0] = direction;
+    UInt64SetLE(&prefix[1], (uint64_t)tv.tv_sec*1000000 + (uint64_t)tv.tv_usec);
+    flockfile(file); // messages are sent from other threads while received messages are recorded
+
+    if (fwrite(prefix, sizeof(prefix), 1, file) != 1 || fwrite(header, HEADER_LENGTH, 1, file) != 1 ||
+        (payloadLen > 0 && fwrite(payload, payloadLen, 1, file) != 1)) {
+        peer_log(peer, "error recording %s: %s", (const char *)&header[4], strerror(errno));
+    }
+
+    funlockfile(file);
+}
+
+// verifies the checksum of a complete message and processes it, returns an errno.h code on failure
+static int _BRPeerAcceptPayload(BRPeer *peer, const uint8_t *header, const uint8_t *payload)
+{
+    const char *type = (const char *)(&header[4]);
+    uint32_t msgLen = UInt32GetLE(&header[16]);
+    uint32_t checksum = UInt32GetLE(&header[20]);
+    uint64_t key[2];
+    UInt256 hash;
+    int error = 0;
+
+    if (((BRPeerContext *)peer)->recordFile) _BRPeerRecord(peer, RECORD_RECEIVED, header, payload, msgLen);
+    BRStatsCount(BRStatsPeerMsgsIn + _BRPeerMsgTypeIndex(key, type), 1);
+    BRStatsCount(BRStatsPeerBytesIn, HEADER_LENGTH + msgLen);
+    BRSHA256_2(&hash, payload, msgLen);
+
+    if (UInt32GetLE(&hash) != checksum) { // verify checksum
+        peer_log(peer, "error reading %s, invalid checksum %x, expected %x, payload length:%"PRIu32
+                 ", SHA256_2:%s", type, UInt32GetLE(&hash), checksum, msgLen, u256hex(hash));
+        error = EPROTO;
+    }
+    else if (! _BRPeerAcceptMessage(peer, payload, msgLen, type)) error = EPROTO;
+
+    return error;
+}
+
+// message payloads are read into buffers from a small pool shared by all peers, so sync traffic doesn't hit the
+// allocator for every message, and idle or disconnected peers don't each hold a buffer sized for their largest message
+static pthread_mutex_t _payloadPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t *_payloadPool[PAYLOAD_POOL_COUNT];
+static size_t _payloadPoolSize[PAYLOAD_POOL_COUNT], _payloadPoolCount = 0;
+
+// returns a receive buffer of at least len bytes, its actual size is written to size
+static uint8_t *_BRPeerPayloadGet(size_t len, size_t *size)
+{
+    uint8_t *buf = NULL;
+    size_t i, fit = SIZE_MAX, largest = SIZE_MAX, best;
+
+    if (len < PAYLOAD_MIN_SIZE) len = PAYLOAD_MIN_SIZE;
+    pthread_mutex_lock(&_payloadPoolLock);
+
+    for (i = 0; i < _payloadPoolCount; i++) { // use the smallest pooled buffer that fits, otherwise grow the largest
+        if (_payloadPoolSize[i] >= len && (fit == SIZE_MAX || _payloadPoolSize[i] < _payloadPoolSize[fit])) fit = i;
+        if (largest == SIZE_MAX || _payloadPoolSize[i] > _payloadPoolSize[largest]) largest = i;
+    }
+
+    best = (fit != SIZE_MAX) ? fit : largest;
+
+    if (best != SIZE_MAX) {
+        buf = _payloadPool[best];
+        *size = _payloadPoolSize[best];
+        _payloadPoolCount--;
+        _payloadPool[best] = _payloadPool[_payloadPoolCount];
+        _payloadPoolSize[best] = _payloadPoolSize[_payloadPoolCount];
+    }
+
+    pthread_mutex_unlock(&_payloadPoolLock);
+    
+    if (! buf || *size < len) {
+        buf = realloc(buf, len);
+        *size = len;
+    }
+
+    assert(buf != NULL);
+    return buf;
+}
+
+// returns a receive buffer from _BRPeerPayloadGet() to the pool
+static void _BRPeerPayloadPut(uint8_t *buf, size_t size)
+{
+    if (buf && size <= PAYLOAD_POOL_MAX) {
+        pthread_mutex_lock(&_payloadPoolLock);
+
+        if (_payloadPoolCount < PAYLOAD_POOL_COUNT) {
+            _payloadPool[_payloadPoolCount] = buf;
+            _payloadPoolSize[_payloadPoolCount++] = size;
+            buf = NULL;
+        }
+
+        pthread_mutex_unlock(&_payloadPoolLock);
+    }
+
+    if (buf) free(buf);
+}
+
+// closes the socket and completes outstanding callbacks once the connection has ended, peer may be freed by the
+// disconnected callback
+static void _BRPeerDidDisconnect(BRPeer *peer, int error)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    int socket;
+
+    pthread_mutex_lock(&ctx->lock);
+    socket = ctx->socket;
+    ctx->status = BRPeerStatusDisconnected;
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (socket >= 0) close(socket);
+    peer_log(peer, "disconnected");
+    
+    while (array_count(ctx->pongCallback) > 0) {
+        void (*pongCallback)(void *, int) = ctx->pongCallback[0];
+        void *pongInfo = ctx->pongInfo[0];
+        
+        array_rm(ctx->pongCallback, 0);
+        array_rm(ctx->pongInfo, 0);
+        if (pongCallback) pongCallback(pongInfo, 0);
+    }
+
+    if (ctx->mempoolCallback) ctx->mempoolCallback(ctx->mempoolInfo, 0);
+    ctx->mempoolCallback = NULL;
+    if (ctx->disconnected) ctx->disconnected(ctx->info, error);
+}
+
+// processes the messages received in the file set with BRPeerSetReplay(), in the order recorded and as fast as
+// possible, in place of a network connection, returns an errno.h code on failure
+static int _BRPeerReplay(BRPeer *peer)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    uint8_t record[RECORD_PREFIX_LEN + HEADER_LENGTH], *header = &record[RECORD_PREFIX_LEN], *payload;
+    size_t payloadSize;
+    struct timeval tv;
+    int error = 0;
+
+    gettimeofday(&tv, NULL);
+    ctx->startTime = tv.tv_sec + (double)tv.tv_usec/1000000;
+    BRPeerSendVersionMessage(peer);
+
+    while (! error && BRPeerConnectStatus(peer) != BRPeerStatusDisconnected &&
+           fread(record, sizeof(record), 1, ctx->replayFile) == 1) {
+        uint32_t msgLen = UInt32GetLE(&header[16]);
+
+        if (UInt32GetLE(header) != ctx->magicNumber) {
+            peer_log(peer, "malformed replay record: wrong magic number");
+            error = EPROTO;
+        }
+        else if ((error = _BRPeerCheckHeader(peer, header)) == 0) {
+            payload = _BRPeerPayloadGet(msgLen, &payloadSize);
+
+            if (fread(payload, 1, msgLen, ctx->replayFile) != msgLen) {
+                peer_log(peer, "error replaying %s: truncated payload", (const char *)&header[4]);
+                error = EPROTO;
+            }
+            else if (record[0] == RECORD_RECEIVED) error = _BRPeerAcceptPayload(peer, header, payload);
 
-    pthread_mutex_lock(&ctx->lock);
-    value = ctx->mempoolTime;
-    pthread_mutex_unlock(&ctx->lock);
+            _BRPeerPayloadPut(payload, payloadSize);
+        }
+    }
 
-    return value;
+    if (! error && ferror(ctx->replayFile)) error = EIO;
+    if (error) peer_log(peer, "%s", strerror(error));
+    return error;
 }
 
-
 static void *_peerThreadRoutine(void *arg)
 {
     BRPeer *peer = arg;
@@ -990,14 +2117,16 @@ static void *_peerThreadRoutine(void *arg)
 
     pthread_cleanup_push(ctx->threadCleanup, ctx->info);
     
-    if (_BRPeerOpenSocket(peer, PF_INET6, CONNECT_TIMEOUT, &error)) {
+    if (ctx->replayFile) {
+        error = _BRPeerReplay(peer);
+    }
+    else if (_BRPeerOpenSocket(peer, PF_INET6, CONNECT_TIMEOUT, &error)) {
         struct timeval tv;
         double time = 0, msgTimeout;
-        uint8_t header[HEADER_LENGTH], *payload = malloc(0x1000);
-        size_t len = 0, payloadLen = 0x1000;
+        uint8_t header[HEADER_LENGTH], *payload;
+        size_t len = 0, payloadSize;
         ssize_t n = 0;
 
-        assert(payload != NULL);
         gettimeofday(&tv, NULL);
         ctx->startTime = tv.tv_sec + (double)tv.tv_usec/1000000;
         BRPeerSendVersionMessage(peer);
@@ -1013,16 +2142,8 @@ static void *_peerThreadRoutine(void *arg)
                 gettimeofday(&tv, NULL);
                 time = tv.tv_sec + (double)tv.tv_usec/1000000;
                 if (! error && time >= _peerGetDisconnectTime(ctx)) error = ETIMEDOUT;
-
-                if (! error && time >= _peerGetMempoolTime(ctx)) {
-                    peer_log(peer, "done waiting for mempool response");
-                    BRPeerSendPing(peer, ctx->mempoolInfo, ctx->mempoolCallback);
-                    ctx->mempoolCallback = NULL;
-
-                    pthread_mutex_lock(&ctx->lock);
-                    ctx->mempoolTime = DBL_MAX;
-                    pthread_mutex_unlock(&ctx->lock);
-                }
+                if (! error && time >= _peerGetMempoolTime(ctx)) _BRPeerMempoolTimeout(peer);
+                if (! error && time >= ctx->txPendingTime) _BRPeerRequestPendingTx(peer, time);
 
                 while (sizeof(uint32_t) <= len && UInt32GetLE(header) != ctx->magicNumber) {
                     memmove(header, &header[1], --len); // consume one byte at a time until we find the magic number
@@ -1034,81 +2155,263 @@ static void *_peerThreadRoutine(void *arg)
             if (error) {
                 peer_log(peer, "%s", strerror(error));
             }
-            else if (header[15] != 0) { // verify header type field is NULL terminated
-                peer_log(peer, "malformed message header: type not NULL terminated");
-                error = EPROTO;
-            }
-            else if (len == HEADER_LENGTH) {
-                const char *type = (const char *)(&header[4]);
+            else if (len == HEADER_LENGTH && (error = _BRPeerCheckHeader(peer, header)) == 0) {
                 uint32_t msgLen = UInt32GetLE(&header[16]);
-                uint32_t checksum = UInt32GetLE(&header[20]);
-                UInt256 hash;
                 
-                if (msgLen > MAX_MSG_LENGTH) { // check message length
-                    peer_log(peer, "error reading %s, message length %"PRIu32" is too long", type, msgLen);
-                    error = EPROTO;
-                }
-                else {
-                    if (msgLen > payloadLen) payload = realloc(payload, (payloadLen = msgLen));
-                    assert(payload != NULL);
-                    len = 0;
+                payload = _BRPeerPayloadGet(msgLen, &payloadSize);
+                len = 0;
+                socket = _peerGetSocket(ctx);
+                msgTimeout = time + MESSAGE_TIMEOUT;
+                
+                while (socket >= 0 && ! error && len < msgLen) {
+                    n = read(socket, &payload[len], msgLen - len);
+                    if (n > 0) len += n;
+                    if (n == 0) error = ECONNRESET;
+                    if (n < 0 && errno != EWOULDBLOCK) error = errno;
+                    gettimeofday(&tv, NULL);
+                    time = tv.tv_sec + (double)tv.tv_usec/1000000;
+                    if (n > 0) msgTimeout = time + MESSAGE_TIMEOUT;
+                    if (! error && time >= msgTimeout) error = ETIMEDOUT;
                     socket = _peerGetSocket(ctx);
-                    msgTimeout = time + MESSAGE_TIMEOUT;
-                    
-                    while (socket >= 0 && ! error && len < msgLen) {
-                        n = read(socket, &payload[len], msgLen - len);
-                        if (n > 0) len += n;
-                        if (n == 0) error = ECONNRESET;
-                        if (n < 0 && errno != EWOULDBLOCK) error = errno;
-                        gettimeofday(&tv, NULL);
-                        time = tv.tv_sec + (double)tv.tv_usec/1000000;
-                        if (n > 0) msgTimeout = time + MESSAGE_TIMEOUT;
-                        if (! error && time >= msgTimeout) error = ETIMEDOUT;
-                        socket = _peerGetSocket(ctx);
-                    }
-                    
-                    if (error) {
-                        peer_log(peer, "%s", strerror(error));
-                    }
-                    else if (len == msgLen) {
-                        BRSHA256_2(&hash, payload, msgLen);
-                        
-                        if (UInt32GetLE(&hash) != checksum) { // verify checksum
-                            peer_log(peer, "error reading %s, invalid checksum %x, expected %x, payload length:%"PRIu32
-                                     ", SHA256_2:%s", type, UInt32GetLE(&hash), checksum, msgLen, u256hex(hash));
-                            error = EPROTO;
-                        }
-                        else if (! _BRPeerAcceptMessage(peer, payload, msgLen, type)) error = EPROTO;
-                    }
                 }
+                
+                if (error) {
+                    peer_log(peer, "%s", strerror(error));
+                }
+                else if (len == msgLen) error = _BRPeerAcceptPayload(peer, header, payload);
+
+                _BRPeerPayloadPut(payload, payloadSize);
             }
         }
-        
-        free(payload);
     }
 
-    pthread_mutex_lock(&ctx->lock);
-    socket = ctx->socket;
-    ctx->status = BRPeerStatusDisconnected;
-    pthread_mutex_unlock(&ctx->lock);
+    _BRPeerDidDisconnect(peer, error);
+    pthread_cleanup_pop(1);
+    return NULL; // detached threads don't need to return a value
+}
 
-    if (socket >= 0) close(socket);
-    peer_log(peer, "disconnected");
-    
-    while (array_count(ctx->pongCallback) > 0) {
-        void (*pongCallback)(void *, int) = ctx->pongCallback[0];
-        void *pongInfo = ctx->pongInfo[0];
-        
-        array_rm(ctx->pongCallback, 0);
-        array_rm(ctx->pongInfo, 0);
-        if (pongCallback) pongCallback(pongInfo, 0);
+// instead of a thread per peer, peers set to use the event loop are all serviced by a single shared thread that polls
+// their sockets and reads messages as data arrives
+static pthread_once_t _eventLoopOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t _eventLoopLock = PTHREAD_MUTEX_INITIALIZER;
+static BRPeerContext **_eventLoopPeers = NULL; // peers serviced by the event loop thread, guarded by _eventLoopLock
+static int _eventLoopPipe[2] = { -1, -1 }; // written to in order to wake the event loop thread when a peer is added
+static int _eventLoopRunning = 0;
+
+static void *_peerEventLoopRoutine(void *arg);
+
+static void _peerEventLoopInit(void)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+    int arg0, arg1;
+
+    array_new(_eventLoopPeers, 10);
+    if (pipe(_eventLoopPipe) != 0) return;
+    arg0 = fcntl(_eventLoopPipe[0], F_GETFL, NULL);
+    arg1 = fcntl(_eventLoopPipe[1], F_GETFL, NULL);
+
+    if (arg0 >= 0 && arg1 >= 0 && fcntl(_eventLoopPipe[0], F_SETFL, arg0 | O_NONBLOCK) == 0 &&
+        fcntl(_eventLoopPipe[1], F_SETFL, arg1 | O_NONBLOCK) == 0 && pthread_attr_init(&attr) == 0) {
+        if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) == 0 &&
+            pthread_attr_setstacksize(&attr, PTHREAD_STACK_SIZE) == 0 &&
+            pthread_create(&thread, &attr, _peerEventLoopRoutine, NULL) == 0) _eventLoopRunning = 1;
+        pthread_attr_destroy(&attr);
     }
 
-    if (ctx->mempoolCallback) ctx->mempoolCallback(ctx->mempoolInfo, 0);
-    ctx->mempoolCallback = NULL;
-    if (ctx->disconnected) ctx->disconnected(ctx->info, error);
-    pthread_cleanup_pop(1);
-    return NULL; // detached threads don't need to return a value
+    if (! _eventLoopRunning) {
+        close(_eventLoopPipe[0]);
+        close(_eventLoopPipe[1]);
+    }
+}
+
+// hands peer to the event loop thread to connect, returns false if the event loop thread couldn't be started
+static int _BRPeerEventLoopAdd(BRPeer *peer)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    uint8_t byte = 0;
+
+    pthread_once(&_eventLoopOnce, _peerEventLoopInit);
+    if (! _eventLoopRunning) return 0;
+    ctx->loopState = loop_opening;
+    ctx->headerLen = ctx->payloadLen = 0;
+    pthread_mutex_lock(&_eventLoopLock);
+    array_add(_eventLoopPeers, ctx);
+    pthread_mutex_unlock(&_eventLoopLock);
+    if (write(_eventLoopPipe[1], &byte, 1) < 0 && errno != EWOULDBLOCK) peer_log(peer, "%s", strerror(errno));
+    return 1;
+}
+
+// removes peer from the event loop once its connection has ended, peer may be freed by the disconnected callback
+static void _BRPeerEventLoopRemove(BRPeer *peer, int error)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    void (*threadCleanup)(void *) = ctx->threadCleanup;
+    void *info = ctx->info;
+
+    pthread_mutex_lock(&_eventLoopLock);
+
+    for (size_t i = array_count(_eventLoopPeers); i > 0; i--) {
+        if (_eventLoopPeers[i - 1] != ctx) continue;
+        array_rm(_eventLoopPeers, i - 1);
+        break;
+    }
+
+    pthread_mutex_unlock(&_eventLoopLock);
+    _BRPeerPayloadPut(ctx->payload, ctx->payloadSize);
+    ctx->payload = NULL;
+    ctx->payloadSize = 0;
+    _BRPeerDidDisconnect(peer, error);
+    threadCleanup(info); // the connection's "thread" has ended
+}
+
+// reads what's available on peer's socket, processing the message if it's then complete, returns an errno.h code on
+// failure
+static int _BRPeerEventLoopRead(BRPeer *peer, int socket, double time)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    uint32_t msgLen = UInt32GetLE(&ctx->header[16]);
+    ssize_t n;
+    int error = 0;
+
+    if (ctx->headerLen < HEADER_LENGTH) {
+        n = read(socket, &ctx->header[ctx->headerLen], HEADER_LENGTH - ctx->headerLen);
+        if (n > 0) ctx->headerLen += n;
+        if (n == 0) error = ECONNRESET;
+        if (n < 0 && errno != EWOULDBLOCK && errno != EINTR) error = errno;
+
+        while (sizeof(uint32_t) <= ctx->headerLen && UInt32GetLE(ctx->header) != ctx->magicNumber) {
+            memmove(ctx->header, &ctx->header[1], --ctx->headerLen); // consume one byte at a time until magic number
+        }
+
+        if (error) peer_log(peer, "%s", strerror(error));
+
+        if (! error && ctx->headerLen == HEADER_LENGTH && (error = _BRPeerCheckHeader(peer, ctx->header)) == 0) {
+            msgLen = UInt32GetLE(&ctx->header[16]);
+            ctx->payload = _BRPeerPayloadGet(msgLen, &ctx->payloadSize);
+            ctx->payloadLen = 0;
+            ctx->msgTimeout = time + MESSAGE_TIMEOUT;
+        }
+    }
+    else {
+        n = read(socket, &ctx->payload[ctx->payloadLen], msgLen - ctx->payloadLen);
+        if (n > 0) ctx->payloadLen += n, ctx->msgTimeout = time + MESSAGE_TIMEOUT;
+        if (n == 0) error = ECONNRESET;
+        if (n < 0 && errno != EWOULDBLOCK && errno != EINTR) error = errno;
+        if (error) peer_log(peer, "%s", strerror(error));
+    }
+
+    if (! error && ctx->headerLen == HEADER_LENGTH && ctx->payloadLen == msgLen) { // message is complete
+        ctx->headerLen = 0;
+        error = _BRPeerAcceptPayload(peer, ctx->header, ctx->payload);
+        _BRPeerPayloadPut(ctx->payload, ctx->payloadSize);
+        ctx->payload = NULL;
+        ctx->payloadSize = 0;
+    }
+
+    return error;
+}
+
+// handles poll() events and expired timeouts for peer, returns an errno.h code if the connection should end
+static int _BRPeerEventLoopService(BRPeer *peer, int socket, short revents, double time)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    socklen_t optLen = sizeof(int);
+    int error = 0;
+
+    if (socket < 0 || BRPeerConnectStatus(peer) == BRPeerStatusDisconnected) { // closed by BRPeerDisconnect()
+        error = ECONNRESET;
+        peer_log(peer, "%s", strerror(error));
+    }
+    else if (ctx->loopState == loop_connecting) {
+        if (revents != 0) { // connect completed
+            if (getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &optLen) < 0) error = errno;
+
+            if (error) peer_log(peer, "connect error: %s", strerror(error));
+            else {
+                peer_log(peer, "socket connected");
+                fcntl(socket, F_SETFL, ctx->socketFlags); // restore socket non-blocking status
+                ctx->loopState = loop_connected;
+                ctx->startTime = time;
+                BRPeerSendVersionMessage(peer);
+            }
+        }
+    }
+    else if (revents != 0) error = _BRPeerEventLoopRead(peer, socket, time);
+
+    if (! error && time >= _peerGetDisconnectTime(ctx)) error = ETIMEDOUT;
+    if (! error && ctx->headerLen == HEADER_LENGTH && time >= ctx->msgTimeout) error = ETIMEDOUT;
+    if (error == ETIMEDOUT) peer_log(peer, "%s", strerror(error));
+    if (! error && ctx->loopState == loop_connected && time >= _peerGetMempoolTime(ctx)) _BRPeerMempoolTimeout(peer);
+    if (! error && ctx->loopState == loop_connected && time >= ctx->txPendingTime) _BRPeerRequestPendingTx(peer, time);
+    return error;
+}
+
+static void *_peerEventLoopRoutine(void *arg)
+{
+    BRPeerContext **peers;
+    struct pollfd *fds;
+    struct timeval tv;
+    uint8_t buf[64];
+    size_t i, count;
+    int error;
+
+    array_new(peers, 10);
+    array_new(fds, 10);
+
+    for (;;) {
+        pthread_mutex_lock(&_eventLoopLock);
+        array_clear(peers);
+        array_add_array(peers, _eventLoopPeers, array_count(_eventLoopPeers));
+        pthread_mutex_unlock(&_eventLoopLock);
+        count = array_count(peers);
+        gettimeofday(&tv, NULL);
+
+        for (i = 0; i < count; i++) { // start connecting newly added peers
+            BRPeer *peer = &peers[i]->peer;
+
+            if (peers[i]->loopState != loop_opening) continue;
+            error = 0;
+
+            if (! _BRPeerOpenSocket(peer, PF_INET6, -1, &error)) {
+                _BRPeerEventLoopRemove(peer, (error) ? error : ENOTCONN);
+                peers[i] = NULL;
+            }
+            else if (peers[i]->loopState == loop_opening) { // connected immediately
+                peers[i]->loopState = loop_connected;
+                peers[i]->startTime = tv.tv_sec + (double)tv.tv_usec/1000000;
+                BRPeerSendVersionMessage(peer);
+            }
+        }
+
+        array_clear(fds);
+        array_add(fds, ((struct pollfd) { _eventLoopPipe[0], POLLIN, 0 }));
+
+        for (i = 0; i < count; i++) { // poll() ignores negative descriptors
+            short events = (peers[i] && peers[i]->loopState == loop_connecting) ? POLLOUT : POLLIN;
+
+            array_add(fds, ((struct pollfd) { (peers[i]) ? _peerGetSocket(peers[i]) : -1, events, 0 }));
+        }
+
+        // wake at least once a second to check timeouts, the same granularity as a peer thread's 1s receive timeout
+        if (poll(fds, array_count(fds), (count > 0) ? 1000 : -1) < 0) {
+            for (i = 0; i < array_count(fds); i++) fds[i].revents = 0;
+        }
+
+        if (fds[0].revents != 0) while (read(_eventLoopPipe[0], buf, sizeof(buf)) > 0);
+        gettimeofday(&tv, NULL);
+
+        for (i = 0; i < count; i++) {
+            BRPeer *peer = (peers[i]) ? &peers[i]->peer : NULL;
+
+            if (! peer) continue;
+            error = _BRPeerEventLoopService(peer, fds[i + 1].fd, fds[i + 1].revents,
+                                            tv.tv_sec + (double)tv.tv_usec/1000000);
+            if (error) _BRPeerEventLoopRemove(peer, error);
+        }
+    }
+
+    return NULL; // the event loop thread runs for the life of the process
 }
 
 static void _dummyThreadCleanup(void *info)
@@ -1125,11 +2428,17 @@ BRPeer *BRPeerNew(uint32_t magicNumber)
     array_new(ctx->useragent, 40);
     array_new(ctx->knownBlockHashes, 10);
     array_new(ctx->currentBlockTxHashes, 10);
-    array_new(ctx->knownTxHashes, 10);
-    ctx->knownTxHashSet = BRSetNew(BRTransactionHash, BRTransactionEq, 10);
+    ctx->knownTxHashes = malloc(KNOWN_TX_GENERATION*2*sizeof(*ctx->knownTxHashes)); // pages are touched as needed
+    assert(ctx->knownTxHashes != NULL);
+    ctx->knownTxHashSets[0] = BRSetNew(BRTransactionHash, BRTransactionEq, 10);
+    ctx->knownTxHashSets[1] = BRSetNew(BRTransactionHash, BRTransactionEq, 10);
     array_new(ctx->pongInfo, 10);
     array_new(ctx->pongCallback, 10);
+    array_new(ctx->msgHandlers, 2);
+    array_new(ctx->sendQueue, 0x100);
+    array_new(ctx->txPending, 10);
     ctx->pingTime = DBL_MAX;
+    ctx->txPendingTime = DBL_MAX;
     ctx->mempoolTime = DBL_MAX;
     ctx->disconnectTime = DBL_MAX;
     ctx->socket = -1;
@@ -1140,6 +2449,7 @@ BRPeer *BRPeerNew(uint32_t magicNumber)
         pthread_mutexattr_init(&attr);
         pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_NORMAL);
         pthread_mutex_init(&ctx->lock, &attr);
+        pthread_mutex_init(&ctx->sendLock, &attr);
         pthread_mutexattr_destroy(&attr);
     }
 
@@ -1196,6 +2506,84 @@ void BRPeerSetEarliestKeyTime(BRPeer *peer, uint32_t earliestKeyTime)
     ((BRPeerContext *)peer)->earliestKeyTime = earliestKeyTime;
 }
 
+// set to true to have headers requested all the way to the remote peer's last block, instead of switching to getblocks
+// after earliestKeyTime; the peer manager then requests filtered blocks itself
+void BRPeerSetHeadersFirst(BRPeer *peer, int headersFirst)
+{
+    ((BRPeerContext *)peer)->headersFirst = headersFirst;
+}
+
+// called when a "cfilter" message is received from peer, with the info passed to BRPeerSetCallbacks()
+void BRPeerSetCompactFilterCallback(BRPeer *peer,
+                                    void (*relayedFilter)(void *info, UInt256 blockHash, const uint8_t *filter,
+                                                          size_t filterLen))
+{
+    ((BRPeerContext *)peer)->relayedFilter = relayedFilter;
+}
+
+// size_t knownTx(void *, BRTransaction *[], size_t) - once set, BRPeerSendGetblockdata() requests BIP152 compact blocks
+// from peers that support them, and knownTx is called to write up to txCount tx that a new block may include to the
+// transactions array, returning the number written, or the total available if transactions is NULL, tx are copied and
+// not freed by peer, info is the info passed to BRPeerSetCallbacks()
+void BRPeerSetCompactBlockCallback(BRPeer *peer,
+                                   size_t (*knownTx)(void *info, BRTransaction *transactions[], size_t txCount))
+{
+    ((BRPeerContext *)peer)->knownTx = knownTx;
+}
+
+// peers with the same scope share tx requests, a tx announced by several of them is only requested from one, and
+// hasTx is called for a tx another of them already received, by default each peer is its own scope
+void BRPeerSetTxRequestScope(BRPeer *peer, const void *scope)
+{
+    ((BRPeerContext *)peer)->txRequestScope = scope;
+}
+
+// called when a "tx" message is received from peer, before the tx is fully parsed, return false to have the tx
+// discarded without calling relayedTx
+void BRPeerSetTxViewCallback(BRPeer *peer, int (*wantsTx)(void *info, const BRTransactionView *view))
+{
+    ((BRPeerContext *)peer)->wantsTx = wantsTx;
+}
+
+// int handler(void *, const uint8_t *, size_t) - called with the payload of each message of the given type received
+// from peer, for message types peer doesn't otherwise process, such as "sendheaders" or "addrv2", return false if
+// the message is invalid to have peer disconnect, info is the info passed to BRPeerSetCallbacks(), call before
+// connecting, and pass NULL for handler to remove it
+void BRPeerSetMessageHandler(BRPeer *peer, const char *type,
+                             int (*handler)(void *info, const uint8_t *msg, size_t msgLen))
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    uint64_t key[2];
+    size_t i = array_count(ctx->msgHandlers);
+
+    assert(type != NULL);
+    _BRPeerMsgTypeKey(key, type);
+    while (i > 0 && (ctx->msgHandlers[i - 1].key[0] != key[0] || ctx->msgHandlers[i - 1].key[1] != key[1])) i--;
+    if (i > 0) array_rm(ctx->msgHandlers, i - 1);
+    if (handler) array_add(ctx->msgHandlers, ((msg_handler) { { key[0], key[1] }, handler }));
+}
+
+// set to true before connecting to have peer serviced by a single event loop thread shared with all other such peers,
+// instead of its own thread, callbacks are then made from the event loop thread, and threadCleanup is called from it
+// when the connection ends
+void BRPeerSetEventLoop(BRPeer *peer, int eventLoop)
+{
+    ((BRPeerContext *)peer)->eventLoop = eventLoop;
+}
+
+// appends every message sent or received by peer to file, or stops recording if file is NULL
+void BRPeerSetRecorder(BRPeer *peer, FILE *file)
+{
+    ((BRPeerContext *)peer)->recordFile = file;
+}
+
+// set before connecting to have BRPeerConnect() replay a file recorded with BRPeerSetRecorder() instead of connecting
+// to the network (NULL to connect to the network)
+void BRPeerSetReplay(BRPeer *peer, FILE *file)
+{
+    ((BRPeerContext *)peer)->replayFile = file;
+}
+
 // call this when local block height changes (helps detect tarpit nodes)
 void BRPeerSetCurrentBlockHeight(BRPeer *peer, uint32_t currentBlockHeight)
 {
@@ -1233,12 +2621,19 @@ void BRPeerConnect(BRPeer *peer)
         else {
             peer_log(peer, "connecting");
             ctx->waitingForNetwork = 0;
+            array_clear(ctx->txPending);
+            ctx->txInFlight = ctx->txCapped = 0;
+            ctx->txPendingTime = DBL_MAX;
+            ctx->mempoolPending = 0;
             gettimeofday(&tv, NULL);
 
             // No race - set before the thread starts.
             ctx->disconnectTime = tv.tv_sec + (double)tv.tv_usec/1000000 + CONNECT_TIMEOUT;
 
-            if (pthread_attr_init(&attr) != 0) {
+            if (ctx->eventLoop && ! ctx->replayFile && _BRPeerEventLoopAdd(peer)) { // event loop opens the socket
+                peer_log(peer, "added to event loop");
+            }
+            else if (pthread_attr_init(&attr) != 0) {
                 // error = ENOMEM;
                 peer_log(peer, "error creating thread");
                 ctx->status = BRPeerStatusDisconnected;
@@ -1272,6 +2667,11 @@ void BRPeerDisconnect(BRPeer *peer)
         if (shutdown(socket, SHUT_RDWR) < 0) peer_log(peer, "%s", strerror(errno));
         close(socket);
     }
+    else if (ctx->replayFile) { // the replay ends before its next record
+        pthread_mutex_lock(&ctx->lock);
+        ctx->status = BRPeerStatusDisconnected;
+        pthread_mutex_unlock(&ctx->lock);
+    }
 }
 
 // call this to (re)schedule a disconnect in the given number of seconds, or < 0 to cancel (useful for sync timeout)
@@ -1348,43 +2748,91 @@ uint64_t BRPeerFeePerKb(BRPeer *peer)
 #define MSG_NOSIGNAL 0 // set to 0 if undefined (BSD has the SO_NOSIGPIPE sockopt, and windows has no signals at all)
 #endif
 
-// sends a bitcoin protocol message to peer
-void BRPeerSendMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen, const char *type)
+// writes iov to the socket, with as few sendmsg calls as the socket allows, returns an errno.h code on failure
+// must be called with ctx->sendLock held
+static int _BRPeerSendIov(BRPeerContext *ctx, struct iovec *iov, int iovCount)
+{
+    struct msghdr hdr;
+    struct timeval tv;
+    ssize_t n;
+    size_t len;
+    int socket = _peerGetSocket(ctx), error = 0;
+
+    if (socket < 0 && ! ctx->replayFile) error = ENOTCONN; // messages sent during a replay are discarded
+    while (iovCount > 0 && iov->iov_len == 0) iov++, iovCount--;
+
+    while (socket >= 0 && ! error && iovCount > 0) {
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = iov;
+        hdr.msg_iovlen = iovCount;
+        n = sendmsg(socket, &hdr, MSG_NOSIGNAL);
+        if (n < 0 && errno != EWOULDBLOCK) error = errno;
+
+        while (n > 0) { // skip past what was written, a partial write can end in the middle of any buffer
+            len = ((size_t)n < iov->iov_len) ? (size_t)n : iov->iov_len;
+            iov->iov_base = (uint8_t *)iov->iov_base + len;
+            iov->iov_len -= len;
+            n -= len;
+            while (iovCount > 0 && iov->iov_len == 0) iov++, iovCount--;
+        }
+
+        gettimeofday(&tv, NULL);
+        if (! error && iovCount > 0 && tv.tv_sec + (double)tv.tv_usec/1000000 >= _peerGetDisconnectTime(ctx)) {
+            error = ETIMEDOUT;
+        }
+
+        socket = _peerGetSocket(ctx);
+    }
+
+    return error;
+}
+
+// sends a message with the given payload checksum, or computes it if checksum is NULL
+static void _BRPeerSendMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen, const char *type,
+                               const uint8_t *checksum)
 {
     if (msgLen > MAX_MSG_LENGTH) {
         peer_log(peer, "failed to send %s, length %zu is too long", type, msgLen);
     }
     else {
         BRPeerContext *ctx = (BRPeerContext *)peer;
-        uint8_t buf[HEADER_LENGTH + msgLen], hash[32];
+        uint8_t header[HEADER_LENGTH], hash[32];
+        uint64_t key[2];
         size_t off = 0;
-        ssize_t n = 0;
-        struct timeval tv;
-        int socket, error = 0;
+        struct iovec iov[3];
+        int iovCount = 0, error = 0;
         
-        UInt32SetLE(&buf[off], ctx->magicNumber);
+        UInt32SetLE(&header[off], ctx->magicNumber);
         off += sizeof(uint32_t);
-        strncpy((char *)&buf[off], type, 12);
+        strncpy((char *)&header[off], type, 12);
         off += 12;
-        UInt32SetLE(&buf[off], (uint32_t)msgLen);
-        off += sizeof(uint32_t);
-        BRSHA256_2(hash, msg, msgLen);
-        memcpy(&buf[off], hash, sizeof(uint32_t));
+        UInt32SetLE(&header[off], (uint32_t)msgLen);
         off += sizeof(uint32_t);
-        memcpy(&buf[off], msg, msgLen);
+        if (! checksum) BRSHA256_2(hash, msg, msgLen);
+        memcpy(&header[off], (checksum) ? checksum : hash, sizeof(uint32_t));
         peer_log(peer, "sending %s", type);
-        msgLen = 0;
-        socket = _peerGetSocket(ctx);
-        if (socket < 0) error = ENOTCONN;
+        if (ctx->recordFile) _BRPeerRecord(peer, RECORD_SENT, header, msg, msgLen);
+        BRStatsCount(BRStatsPeerMsgsOut + _BRPeerMsgTypeIndex(key, type), 1);
+        BRStatsCount(BRStatsPeerBytesOut, sizeof(header) + msgLen);
+        pthread_mutex_lock(&ctx->sendLock);
         
-        while (socket >= 0 && ! error && msgLen < sizeof(buf)) {
-            n = send(socket, &buf[msgLen], sizeof(buf) - msgLen, MSG_NOSIGNAL);
-            if (n >= 0) msgLen += n;
-            if (n < 0 && errno != EWOULDBLOCK) error = errno;
-            gettimeofday(&tv, NULL);
-            if (! error && tv.tv_sec + (double)tv.tv_usec/1000000 >= _peerGetDisconnectTime(ctx)) error = ETIMEDOUT;
-            socket = _peerGetSocket(ctx);
+        if (ctx->sendBatch > 0 && msgLen <= SEND_COALESCE_MAX &&
+            array_count(ctx->sendQueue) + sizeof(header) + msgLen <= SEND_QUEUE_MAX) { // sent when the batch ends
+            array_add_array(ctx->sendQueue, header, sizeof(header));
+            array_add_array(ctx->sendQueue, msg, msgLen);
         }
+        else { // anything already queued goes out first, in the same write
+            if (array_count(ctx->sendQueue) > 0) {
+                iov[iovCount++] = (struct iovec) { ctx->sendQueue, array_count(ctx->sendQueue) };
+            }
+            
+            iov[iovCount++] = (struct iovec) { header, sizeof(header) };
+            iov[iovCount++] = (struct iovec) { (void *)msg, msgLen };
+            error = _BRPeerSendIov(ctx, iov, iovCount);
+            array_clear(ctx->sendQueue);
+        }
+        
+        pthread_mutex_unlock(&ctx->sendLock);
         
         if (error) {
             peer_log(peer, "%s", strerror(error));
@@ -1393,6 +2841,47 @@ void BRPeerSendMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen, const ch
     }
 }
 
+// sends a bitcoin protocol message to peer
+void BRPeerSendMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen, const char *type)
+{
+    _BRPeerSendMessage(peer, msg, msgLen, type, NULL);
+}
+
+// starts a send batch, small messages sent to peer are queued until the outermost batch ends, and then written to
+// the socket together, a larger message sends the queue ahead of itself
+void BRPeerBeginBatch(BRPeer *peer)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    
+    pthread_mutex_lock(&ctx->sendLock);
+    ctx->sendBatch++;
+    pthread_mutex_unlock(&ctx->sendLock);
+}
+
+// ends a send batch started with BRPeerBeginBatch(), writing the queued messages if it's the outermost one
+void BRPeerEndBatch(BRPeer *peer)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    struct iovec iov;
+    int error = 0;
+    
+    pthread_mutex_lock(&ctx->sendLock);
+    assert(ctx->sendBatch > 0);
+    
+    if (--ctx->sendBatch == 0 && array_count(ctx->sendQueue) > 0) {
+        iov = (struct iovec) { ctx->sendQueue, array_count(ctx->sendQueue) };
+        error = _BRPeerSendIov(ctx, &iov, 1);
+        array_clear(ctx->sendQueue);
+    }
+    
+    pthread_mutex_unlock(&ctx->sendLock);
+    
+    if (error) {
+        peer_log(peer, "%s", strerror(error));
+        BRPeerDisconnect(peer);
+    }
+}
+
 void BRPeerSendVersionMessage(BRPeer *peer)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
@@ -1417,7 +2906,7 @@ void BRPeerSendVersionMessage(BRPeer *peer)
     off += sizeof(UInt128);
     UInt16SetBE(&msg[off], peer->port);
     off += sizeof(uint16_t);
-    ctx->nonce = ((uint64_t)BRRand(0) << 32) | (uint64_t)BRRand(0); // random nonce
+    BRRandBytes(&ctx->nonce, sizeof(ctx->nonce)); // random nonce
     UInt64SetLE(&msg[off], ctx->nonce);
     off += sizeof(uint64_t);
     off += BRVarIntSet(&msg[off], (off <= sizeof(msg) ? sizeof(msg) - off : 0), userAgentLen);
@@ -1451,6 +2940,20 @@ void BRPeerSendFilterload(BRPeer *peer, const uint8_t *filter, size_t filterLen)
     BRPeerSendMessage(peer, filter, filterLen, MSG_FILTERLOAD);
 }
 
+void BRPeerSendFilteradd(BRPeer *peer, const uint8_t *data, size_t dataLen)
+{
+    uint8_t msg[BRVarIntSize(dataLen) + dataLen];
+    size_t off = 0;
+
+    assert(data != NULL || dataLen == 0);
+    assert(dataLen <= 520); // max script push size
+    if (! ((BRPeerContext *)peer)->sentFilter) return; // peers ban nodes that send filteradd without a filter loaded
+    off += BRVarIntSet(&msg[off], sizeof(msg) - off, dataLen);
+    memcpy(&msg[off], data, dataLen);
+    off += dataLen;
+    BRPeerSendMessage(peer, msg, off, MSG_FILTERADD);
+}
+
 void BRPeerSendMempool(BRPeer *peer, const UInt256 knownTxHashes[], size_t knownTxCount, void *info,
                        void (*completionCallback)(void *info, int success))
 {
@@ -1528,32 +3031,62 @@ void BRPeerSendGetblocks(BRPeer *peer, const UInt256 locators[], size_t locators
     if (locatorsCount > 0) {
         peer_log(peer, "calling getblocks with %zu locators: [%s,%s %s]", locatorsCount, u256hex(locators[0]),
                  (locatorsCount > 2 ? " ...," : ""), (locatorsCount > 1 ? u256hex(locators[locatorsCount - 1]) : ""));
+        ((BRPeerContext *)peer)->getblocksTime = BRStatsMicroseconds();
         BRPeerSendMessage(peer, msg, off, MSG_GETBLOCKS);
     }
 }
 
+// writes an inv message payload for hashes to msg, returns the number of bytes written
+static size_t _BRPeerInvMessage(uint8_t *msg, size_t msgLen, const UInt256 hashes[], size_t count)
+{
+    size_t i, off = 0;
+
+    off += BRVarIntSet(&msg[off], (off <= msgLen ? msgLen - off : 0), count);
+
+    for (i = 0; i < count; i++) {
+        UInt32SetLE(&msg[off], inv_tx);
+        off += sizeof(uint32_t);
+        UInt256Set(&msg[off], hashes[i]);
+        off += sizeof(UInt256);
+    }
+
+    return off;
+}
+
 void BRPeerSendInv(BRPeer *peer, const UInt256 txHashes[], size_t txCount)
 {
-    BRPeerContext *ctx = (BRPeerContext *)peer;
-    size_t knownCount = array_count(ctx->knownTxHashes);
+    BRPeerSendInvToPeers(&peer, 1, txHashes, txCount);
+}
 
-    _BRPeerAddKnownTxHashes(peer, txHashes, txCount);
-    txCount = array_count(ctx->knownTxHashes) - knownCount;
+// sends an inv for txHashes to each of peers, leaving out tx a peer already knows about, peers that are sent every
+// hash share one message payload and checksum
+void BRPeerSendInvToPeers(BRPeer *peers[], size_t peerCount, const UInt256 txHashes[], size_t txCount)
+{
+    UInt256 hashes[txCount ? txCount : 1];
+    size_t i, j, count, len = 0, msgLen = BRVarIntSize(txCount) + (sizeof(uint32_t) + sizeof(*hashes))*txCount;
+    uint8_t msg[msgLen], hash[32];
 
-    if (txCount > 0) {
-        size_t i, off = 0, msgLen = BRVarIntSize(txCount) + (sizeof(uint32_t) + sizeof(*txHashes))*txCount;
-        uint8_t msg[msgLen];
-        
-        off += BRVarIntSet(&msg[off], (off <= msgLen ? msgLen - off : 0), txCount);
-        
-        for (i = 0; i < txCount; i++) {
-            UInt32SetLE(&msg[off], inv_tx);
-            off += sizeof(uint32_t);
-            UInt256Set(&msg[off], ctx->knownTxHashes[knownCount + i]);
-            off += sizeof(UInt256);
+    for (i = 0; i < peerCount; i++) {
+        BRPeerContext *ctx = (BRPeerContext *)peers[i];
+
+        for (j = 0, count = 0; j < txCount; j++) { // only announce tx the peer doesn't already know about
+            if (_BRPeerAddKnownTxHash(ctx, txHashes[j])) hashes[count++] = txHashes[j];
+        }
+
+        if (count > 0 && count == txCount) {
+            if (len == 0) { // payload and checksum are computed for the first peer that needs the full inv
+                len = _BRPeerInvMessage(msg, msgLen, txHashes, txCount);
+                BRSHA256_2(hash, msg, len);
+            }
+
+            _BRPeerSendMessage(peers[i], msg, len, MSG_INV, hash);
         }
+        else if (count > 0) {
+            size_t peerMsgLen = BRVarIntSize(count) + (sizeof(uint32_t) + sizeof(*hashes))*count;
+            uint8_t peerMsg[peerMsgLen];
 
-        BRPeerSendMessage(peer, msg, off, MSG_INV);
+            BRPeerSendMessage(peers[i], peerMsg, _BRPeerInvMessage(peerMsg, peerMsgLen, hashes, count), MSG_INV);
+        }
     }
 }
 
@@ -1590,6 +3123,51 @@ void BRPeerSendGetdata(BRPeer *peer, const UInt256 txHashes[], size_t txCount, c
     }
 }
 
+static void _BRPeerSendGetblockdata(BRPeer *peer, const UInt256 blockHashes[], size_t blockCount, inv_type type)
+{
+    size_t i, off = 0;
+    
+    if (blockCount > MAX_GETDATA_HASHES) { // limit total hash count to MAX_GETDATA_HASHES
+        peer_log(peer, "couldn't send getdata, %zu is too many items, max is %d", blockCount, MAX_GETDATA_HASHES);
+    }
+    else if (blockCount > 0) {
+        size_t msgLen = BRVarIntSize(blockCount) + (sizeof(uint32_t) + sizeof(UInt256))*blockCount;
+        uint8_t msg[msgLen];
+
+        off += BRVarIntSet(&msg[off], (off <= msgLen ? msgLen - off : 0), blockCount);
+        
+        for (i = 0; i < blockCount; i++) {
+            UInt32SetLE(&msg[off], type);
+            off += sizeof(uint32_t);
+            UInt256Set(&msg[off], blockHashes[i]);
+            off += sizeof(UInt256);
+        }
+        
+        ((BRPeerContext *)peer)->sentGetdata = 1;
+        BRPeerSendMessage(peer, msg, off, MSG_GETDATA);
+    }
+}
+
+void BRPeerSendGetblockdata(BRPeer *peer, const UInt256 blockHashes[], size_t blockCount)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+
+    // compact blocks are requested if peer supports them, and knownTx can provide tx to reconstruct them from
+    _BRPeerSendGetblockdata(peer, blockHashes, blockCount,
+                            (ctx->knownTx && ctx->cmpctWitness) ? inv_cmpct_block : inv_witness_block);
+}
+
+void BRPeerSendGetcfilters(BRPeer *peer, uint32_t startHeight, UInt256 stopHash)
+{
+    uint8_t msg[1 + sizeof(uint32_t) + sizeof(UInt256)];
+
+    msg[0] = BLOCK_FILTER_BASIC;
+    UInt32SetLE(&msg[1], startHeight);
+    UInt256Set(&msg[1 + sizeof(uint32_t)], stopHash);
+    ((BRPeerContext *)peer)->sentGetcfilters = 1;
+    BRPeerSendMessage(peer, msg, sizeof(msg), MSG_GETCFILTERS);
+}
+
 void BRPeerSendGetaddr(BRPeer *peer)
 {
     ((BRPeerContext *)peer)->sentGetaddr = 1;
@@ -1625,6 +3203,20 @@ void BRPeerRerequestBlocks(BRPeer *peer, UInt256 fromBlock)
     }
 }
 
+// returns the bytes of memory held by peer, including its known tx hashes and send queue, but not the pooled buffers
+// of messages being read
+size_t BRPeerMemoryUsage(BRPeer *peer)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    size_t size = sizeof(*ctx) + KNOWN_TX_GENERATION*2*sizeof(*ctx->knownTxHashes);
+    
+    // the other buffers belong to the peer thread, sendQueue is the one that grows with load
+    pthread_mutex_lock(&ctx->sendLock);
+    size += array_heap_size(ctx->sendQueue);
+    pthread_mutex_unlock(&ctx->sendLock);
+    return size;
+}
+
 void BRPeerFree(BRPeer *peer)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
@@ -1632,11 +3224,18 @@ void BRPeerFree(BRPeer *peer)
     if (ctx->useragent) array_free(ctx->useragent);
     if (ctx->currentBlockTxHashes) array_free(ctx->currentBlockTxHashes);
     if (ctx->knownBlockHashes) array_free(ctx->knownBlockHashes);
-    if (ctx->knownTxHashes) array_free(ctx->knownTxHashes);
-    if (ctx->knownTxHashSet) BRSetFree(ctx->knownTxHashSet);
+    if (ctx->knownTxHashes) free(ctx->knownTxHashes);
+    if (ctx->knownTxHashSets[0]) BRSetFree(ctx->knownTxHashSets[0]);
+    if (ctx->knownTxHashSets[1]) BRSetFree(ctx->knownTxHashSets[1]);
     if (ctx->pongCallback) array_free(ctx->pongCallback);
     if (ctx->pongInfo) array_free(ctx->pongInfo);
+    if (ctx->msgHandlers) array_free(ctx->msgHandlers);
+    if (ctx->cmpctTx) _BRPeerCmpctBlockClear(ctx);
+    if (ctx->payload) free(ctx->payload);
+    if (ctx->sendQueue) array_free(ctx->sendQueue);
+    if (ctx->txPending) array_free(ctx->txPending);
     
+    pthread_mutex_destroy(&ctx->sendLock);
     pthread_mutex_destroy(&ctx->lock);
     free(ctx);
 }
@@ -30,6 +30,7 @@
 #include "BRAddress.h"
 #include "BRInt.h"
 #include <stddef.h>
+#include <stdio.h>
 #include <inttypes.h>
 
 #define peer_log(peer, ...) _peer_log("%s:%"PRIu16" " _va_first(__VA_ARGS__, NULL) "\n", BRPeerHost(peer),\
@@ -56,6 +57,7 @@ extern "C" {
 #define SERVICES_NODE_BLOOM   0x04 // BIP111: https://github.com/bitcoin/bips/blob/master/bip-0111.mediawiki
 #define SERVICES_NODE_WITNESS 0x08 // BIP144: https://github.com/bitcoin/bips/blob/master/bip-0144.mediawiki
 #define SERVICES_NODE_BCASH   0x20 // https://github.com/Bitcoin-UAHF/spec/blob/master/uahf-technical-spec.md
+#define SERVICES_NODE_COMPACT_FILTERS 0x40 // BIP157: https://github.com/bitcoin/bips/blob/master/bip-0157.mediawiki
     
 #define BR_VERSION "2.1"
 #define USER_AGENT "/bread:" BR_VERSION "/"
@@ -83,6 +85,12 @@ extern "C" {
 #define MSG_ALERT       "alert"
 #define MSG_REJECT      "reject"   // described in BIP61: https://github.com/bitcoin/bips/blob/master/bip-0061.mediawiki
 #define MSG_FEEFILTER   "feefilter"// described in BIP133 https://github.com/bitcoin/bips/blob/master/bip-0133.mediawiki
+#define MSG_GETCFILTERS "getcfilters" // BIP157: https://github.com/bitcoin/bips/blob/master/bip-0157.mediawiki
+#define MSG_CFILTER     "cfilter"
+#define MSG_SENDCMPCT   "sendcmpct" // BIP152: https://github.com/bitcoin/bips/blob/master/bip-0152.mediawiki
+#define MSG_CMPCTBLOCK  "cmpctblock"
+#define MSG_GETBLOCKTXN "getblocktxn"
+#define MSG_BLOCKTXN    "blocktxn"
 
 #define REJECT_INVALID     0x10 // transaction is invalid for some reason (invalid signature, output value > input, etc)
 #define REJECT_SPENT       0x12 // an input is already spent
@@ -102,9 +110,11 @@ typedef struct {
     uint64_t services; // bitcoin network services supported by peer
     uint64_t timestamp; // timestamp reported by peer
     uint8_t flags; // scratch variable
+    uint32_t pingTime; // ping time in milliseconds the last time the peer was connected, 0 if unknown
+    uint32_t blockRate; // filtered blocks per minute delivered the last time it was the sync peer, 0 if unknown
 } BRPeer;
 
-#define BR_PEER_NONE ((const BRPeer) { UINT128_ZERO, 0, 0, 0, 0 })
+#define BR_PEER_NONE ((const BRPeer) { UINT128_ZERO, 0, 0, 0, 0, 0, 0 })
 
 // NOTE: BRPeer functions are not thread-safe
 
@@ -118,7 +128,8 @@ BRPeer *BRPeerNew(uint32_t magicNumber);
 // void relayedTx(void *, BRTransaction *) - called when a "tx" message is received from peer
 // void hasTx(void *, UInt256 txHash) - called when an "inv" message with an already-known tx hash is received from peer
 // void rejectedTx(void *, UInt256 txHash, uint8_t) - called when a "reject" message is received from peer
-// void relayedBlock(void *, BRMerkleBlock *) - called when a "merkleblock" or "headers" message is received from peer
+// void relayedBlock(void *, BRMerkleBlock *) - called when a "merkleblock", "block" or "headers" message is received
+// from peer, relayedTx is called first for each tx in a "block" message
 // void notfound(void *, const UInt256[], size_t, const UInt256[], size_t) - called when "notfound" message is received
 // BRTransaction *requestedTx(void *, UInt256) - called when "getdata" message with a tx hash is received from peer
 // int networkIsReachable(void *) - must return true when networking is available, false otherwise
@@ -141,6 +152,55 @@ void BRPeerSetCallbacks(BRPeer *peer, void *info,
 // set earliestKeyTime to wallet creation time in order to speed up initial sync
 void BRPeerSetEarliestKeyTime(BRPeer *peer, uint32_t earliestKeyTime);
 
+// set to true to have headers requested all the way to the remote peer's last block, instead of switching to getblocks
+// after earliestKeyTime
+void BRPeerSetHeadersFirst(BRPeer *peer, int headersFirst);
+
+// void relayedFilter(void *, UInt256 blockHash, const uint8_t *, size_t) - called when a "cfilter" message is received
+// from peer, with the serialized basic filter for the block with blockHash, info is the info passed to
+// BRPeerSetCallbacks()
+void BRPeerSetCompactFilterCallback(BRPeer *peer,
+                                    void (*relayedFilter)(void *info, UInt256 blockHash, const uint8_t *filter,
+                                                          size_t filterLen));
+
+// size_t knownTx(void *, BRTransaction *[], size_t) - once set, BRPeerSendGetblockdata() requests BIP152 compact blocks
+// from peers that support them, and knownTx is called to write up to txCount tx that a new block may include to the
+// transactions array, returning the number written, or the total available if transactions is NULL, tx written are
+// copies that peer takes ownership of and frees, info is the info passed to BRPeerSetCallbacks()
+void BRPeerSetCompactBlockCallback(BRPeer *peer,
+                                   size_t (*knownTx)(void *info, BRTransaction *transactions[], size_t txCount));
+
+// peers with the same scope share tx requests, a tx announced by several of them is only requested from one, and
+// hasTx is called for a tx another of them already received, by default each peer is its own scope, peers that relay
+// tx to different wallets must not share a scope
+void BRPeerSetTxRequestScope(BRPeer *peer, const void *scope);
+
+// int wantsTx(void *, const BRTransactionView *) - called when a "tx" message is received from peer, before the tx is
+// fully parsed, return false to have the tx discarded without calling relayedTx, info is the info passed to
+// BRPeerSetCallbacks()
+void BRPeerSetTxViewCallback(BRPeer *peer, int (*wantsTx)(void *info, const BRTransactionView *view));
+
+// int handler(void *, const uint8_t *, size_t) - called with the payload of each message of the given type received
+// from peer, for message types peer doesn't otherwise process, such as "sendheaders" or "addrv2", return false if
+// the message is invalid to have peer disconnect, info is the info passed to BRPeerSetCallbacks(), call before
+// connecting, and pass NULL for handler to remove it
+void BRPeerSetMessageHandler(BRPeer *peer, const char *type,
+                             int (*handler)(void *info, const uint8_t *msg, size_t msgLen));
+
+// set to true before connecting to have peer serviced by a single event loop thread shared with all other such peers,
+// instead of its own thread (callbacks, including threadCleanup when the connection ends, are then made from that thread)
+void BRPeerSetEventLoop(BRPeer *peer, int eventLoop);
+
+// appends every message sent or received by peer to file, or stops recording if file is NULL, file must stay open while
+// recording, each record is a direction byte (0 received, 1 sent), the time in microseconds since the unix epoch as 8
+// bytes little endian, and the message header and payload as sent over the wire
+void BRPeerSetRecorder(BRPeer *peer, FILE *file);
+
+// set before connecting to have BRPeerConnect() replay a file recorded with BRPeerSetRecorder() instead of connecting
+// to the network, messages received are processed in the order recorded as fast as possible, messages sent are
+// discarded, and peer disconnects at end of file (NULL to connect to the network)
+void BRPeerSetReplay(BRPeer *peer, FILE *file);
+
 // call this when local best block height changes (helps detect tarpit nodes)
 void BRPeerSetCurrentBlockHeight(BRPeer *peer, uint32_t currentBlockHeight);
 
@@ -180,16 +240,25 @@ double BRPeerPingTime(BRPeer *peer);
 // sends a bitcoin protocol message to peer
 void BRPeerSendMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen, const char *type);
 void BRPeerSendFilterload(BRPeer *peer, const uint8_t *filter, size_t filterLen);
+void BRPeerSendFilteradd(BRPeer *peer, const uint8_t *data, size_t dataLen); // ignored until a filter is loaded
 void BRPeerSendMempool(BRPeer *peer, const UInt256 knownTxHashes[], size_t knownTxCount, void *info,
                        void (*completionCallback)(void *info, int success));
 void BRPeerSendGetheaders(BRPeer *peer, const UInt256 locators[], size_t locatorsCount, UInt256 hashStop);
 void BRPeerSendGetblocks(BRPeer *peer, const UInt256 locators[], size_t locatorsCount, UInt256 hashStop);
 void BRPeerSendInv(BRPeer *peer, const UInt256 txHashes[], size_t txCount);
+void BRPeerSendInvToPeers(BRPeer *peers[], size_t peerCount, const UInt256 txHashes[], size_t txCount); // broadcast
 void BRPeerSendGetdata(BRPeer *peer, const UInt256 txHashes[], size_t txCount, const UInt256 blockHashes[],
                        size_t blockCount);
+void BRPeerSendGetblockdata(BRPeer *peer, const UInt256 blockHashes[], size_t blockCount); // getdata for full blocks
+void BRPeerSendGetcfilters(BRPeer *peer, uint32_t startHeight, UInt256 stopHash); // basic filters from startHeight
 void BRPeerSendGetaddr(BRPeer *peer);
 void BRPeerSendPing(BRPeer *peer, void *info, void (*pongCallback)(void *info, int success));
 
+// small messages sent between BRPeerBeginBatch() and BRPeerEndBatch() are written to the socket together when the
+// outermost batch ends, batches may nest
+void BRPeerBeginBatch(BRPeer *peer);
+void BRPeerEndBatch(BRPeer *peer);
+
 // useful to get additional tx after a bloom filter update
 void BRPeerRerequestBlocks(BRPeer *peer, UInt256 fromBlock);
 
@@ -210,6 +279,10 @@ inline static int BRPeerEq(const void *peer, const void *otherPeer)
              ((const BRPeer *)peer)->port == ((const BRPeer *)otherPeer)->port));
 }
 
+// returns the bytes of memory held by peer, including its known tx hashes and send queue, but not the pooled buffers
+// of messages being read
+size_t BRPeerMemoryUsage(BRPeer *peer);
+
 // frees memory allocated for peer
 void BRPeerFree(BRPeer *peer);
 
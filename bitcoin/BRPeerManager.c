@@ -27,31 +27,46 @@
 #include "BRSet.h"
 #include "BRArray.h"
 #include "BRInt.h"
+#include "BRStats.h"
+#include "BRFeeEstimator.h"
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <time.h>
 #include <assert.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <errno.h>
 #include <netdb.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 
 #define PROTOCOL_TIMEOUT      20.0
 #define MAX_CONNECT_FAILURES  20 // notify user of network problems after this many connect failures in a row
+#define CONNECT_RACE_EXTRA    2 // extra candidate peers that race to connect until maxConnectCount of them are done
+#define DNS_MAX_THREADS       4 // concurrent dns seed lookups, shared by all peer managers
+#define DNS_CACHE_TTL         (10*60) // getaddrinfo() doesn't report record ttls, so cache seed results for 10 minutes
+#define DNS_FAILURE_TTL       30 // retry a failed seed lookup after 30 seconds
 #define PEER_FLAG_SYNCED      0x01
 #define PEER_FLAG_NEEDSUPDATE 0x02
+#define PEER_FLAG_DOWNLOADING 0x04
+#define PEER_FLAG_CANCELED    0x08 // lost a connection race, so its disconnect isn't counted as a failure
+#define DOWNLOAD_REQUEST_COUNT 500 // filtered blocks requested from each peer at a time during a headers first sync
+#define DOWNLOAD_MIN_WINDOW    2   // getdata batches kept outstanding per peer, before its throughput is measured
+#define DOWNLOAD_MAX_WINDOW    8
+#define MAX_CFILTERS_COUNT     1000 // most blocks a single getcfilters request can cover
+#define ORPHAN_MAX_COUNT       100 // default limits on orphan blocks held in memory, oldest are evicted first
+#define ORPHAN_MAX_BYTES       0x100000
+#define HEADERS_BATCH_COUNT    2000 // header snapshot blocks parsed and hashed at a time
+#define SPARE_ADDRS            100 // unused addresses derived past the gap limit before building a filter
+#define SPARE_ADDRS_WATCH_ONLY 10  // the same for watch-only wallets, which are many and mostly idle
+#define FILTERADD_MAX_FALSEPOSITIVE_RATE (BLOOM_REDUCED_FALSEPOSITIVE_RATE*5.0) // rebuild the filter instead above this
 
 #define genesis_block_hash(params) UInt256Reverse((params)->checkpoints[0].hash)
 
-typedef struct {
-    BRPeerManager *manager;
-    const char *hostname;
-    uint64_t services;
-} BRFindPeersInfo;
-
 typedef struct {
     BRPeer *peer;
     BRPeerManager *manager;
@@ -69,70 +84,112 @@ typedef struct {
     BRPeer *peers;
 } BRTxPeerList;
 
+typedef struct {
+    UInt256 blockHash;
+    BRPeer *peer; // peer the filtered block is requested from, or NULL
+    uint32_t batch; // request the block was last requested in
+    uint8_t requestCount;
+    uint8_t received;
+    uint8_t matched; // compact filter matched, and the full block is requested
+} BRBlockRequest;
+
+typedef struct {
+    BRPeer *peer;
+    BRPeerManager *manager;
+    uint32_t batch;
+    double time; // when the batch was requested
+    int waited; // times pinged again to wait for full blocks requested after their compact filters matched
+} BRBlockRequestInfo;
+
+typedef struct {
+    BRPeer *peer;
+    uint32_t inFlight, window; // getdata batches outstanding, and the most to keep outstanding
+    double rtt, rate, lastDone; // round trip time, filtered blocks per second, when a batch last completed
+} BRDownloadPeer;
+
+// tx peer lists are kept in a set indexed by txHash, which is the first struct element like in BRTransaction, and a
+// list is removed once it has no peers left
+
 // true if peer is contained in the list of peers associated with txHash
-static int _BRTxPeerListHasPeer(const BRTxPeerList *list, UInt256 txHash, const BRPeer *peer)
+static int _BRTxPeerListHasPeer(const BRSet *lists, UInt256 txHash, const BRPeer *peer)
 {
-    for (size_t i = array_count(list); i > 0; i--) {
-        if (! UInt256Eq(list[i - 1].txHash, txHash)) continue;
+    const BRTxPeerList *list = BRSetGet(lists, &txHash);
 
-        for (size_t j = array_count(list[i - 1].peers); j > 0; j--) {
-            if (BRPeerEq(&list[i - 1].peers[j - 1], peer)) return 1;
-        }
-        
-        break;
+    for (size_t i = (list) ? array_count(list->peers) : 0; i > 0; i--) {
+        if (BRPeerEq(&list->peers[i - 1], peer)) return 1;
     }
     
     return 0;
 }
 
 // number of peers associated with txHash
-static size_t _BRTxPeerListCount(const BRTxPeerList *list, UInt256 txHash)
+static size_t _BRTxPeerListCount(const BRSet *lists, UInt256 txHash)
 {
-    for (size_t i = array_count(list); i > 0; i--) {
-        if (UInt256Eq(list[i - 1].txHash, txHash)) return array_count(list[i - 1].peers);
-    }
-    
-    return 0;
+    const BRTxPeerList *list = BRSetGet(lists, &txHash);
+
+    return (list) ? array_count(list->peers) : 0;
 }
 
 // adds peer to the list of peers associated with txHash and returns the new total number of peers
-static size_t _BRTxPeerListAddPeer(BRTxPeerList **list, UInt256 txHash, const BRPeer *peer)
+static size_t _BRTxPeerListAddPeer(BRSet *lists, UInt256 txHash, const BRPeer *peer)
 {
-    for (size_t i = array_count(*list); i > 0; i--) {
-        if (! UInt256Eq((*list)[i - 1].txHash, txHash)) continue;
-        
-        for (size_t j = array_count((*list)[i - 1].peers); j > 0; j--) {
-            if (BRPeerEq(&(*list)[i - 1].peers[j - 1], peer)) return array_count((*list)[i - 1].peers);
-        }
-        
-        array_add((*list)[i - 1].peers, *peer);
-        return array_count((*list)[i - 1].peers);
+    BRTxPeerList *list = BRSetGet(lists, &txHash);
+
+    if (! list) {
+        list = calloc(1, sizeof(*list));
+        assert(list != NULL);
+        list->txHash = txHash;
+        array_new(list->peers, PEER_MAX_CONNECTIONS);
+        BRSetAdd(lists, list);
     }
 
-    array_add(*list, ((const BRTxPeerList) { txHash, NULL }));
-    array_new((*list)[array_count(*list) - 1].peers, PEER_MAX_CONNECTIONS);
-    array_add((*list)[array_count(*list) - 1].peers, *peer);
-    return 1;
+    for (size_t i = array_count(list->peers); i > 0; i--) {
+        if (BRPeerEq(&list->peers[i - 1], peer)) return array_count(list->peers);
+    }
+
+    array_add(list->peers, *peer);
+    return array_count(list->peers);
+}
+
+static void _BRTxPeerListFree(void *list)
+{
+    array_free(((BRTxPeerList *)list)->peers);
+    free(list);
 }
 
 // removes peer from the list of peers associated with txHash, returns true if peer was found
-static int _BRTxPeerListRemovePeer(BRTxPeerList *list, UInt256 txHash, const BRPeer *peer)
+static int _BRTxPeerListRemovePeer(BRSet *lists, UInt256 txHash, const BRPeer *peer)
 {
-    for (size_t i = array_count(list); i > 0; i--) {
-        if (! UInt256Eq(list[i - 1].txHash, txHash)) continue;
-        
-        for (size_t j = array_count(list[i - 1].peers); j > 0; j--) {
-            if (! BRPeerEq(&list[i - 1].peers[j - 1], peer)) continue;
-            array_rm(list[i - 1].peers, j - 1);
-            return 1;
-        }
-        
-        break;
+    BRTxPeerList *list = BRSetGet(lists, &txHash);
+
+    for (size_t i = (list) ? array_count(list->peers) : 0; i > 0; i--) {
+        if (! BRPeerEq(&list->peers[i - 1], peer)) continue;
+        array_rm(list->peers, i - 1);
+        if (array_count(list->peers) == 0) BRSetRemove(lists, list), _BRTxPeerListFree(list);
+        return 1;
     }
     
     return 0;
 }
 
+// removes the list of peers associated with txHash, such as once the tx is confirmed
+static void _BRTxPeerListRemove(BRSet *lists, UInt256 txHash)
+{
+    BRTxPeerList *list = BRSetRemove(lists, &txHash);
+
+    if (list) _BRTxPeerListFree(list);
+}
+
+// removes peer from every list of peers, such as when it disconnects
+static void _BRTxPeerListRemovePeerAll(BRSet *lists, const BRPeer *peer)
+{
+    size_t count = BRSetCount(lists);
+    BRTxPeerList *all[count ? count : 1];
+
+    count = BRSetAll(lists, (void **)all, count); // lists may be removed, so they're collected before iterating
+    for (size_t i = 0; i < count; i++) _BRTxPeerListRemovePeer(lists, all[i]->txHash, peer);
+}
+
 // comparator for sorting peers by timestamp, most recent first
 inline static int _peerTimestampCompare(const void *peer, const void *otherPeer)
 {
@@ -141,6 +198,14 @@ inline static int _peerTimestampCompare(const void *peer, const void *otherPeer)
     return 0;
 }
 
+// true if peer was measured faster than otherPeer, by block delivery rate if both have one, otherwise by ping time
+inline static int _peerIsFaster(const BRPeer *peer, const BRPeer *otherPeer)
+{
+    if (peer->blockRate > 0 && otherPeer->blockRate > 0) return (peer->blockRate > otherPeer->blockRate);
+    if (peer->blockRate != otherPeer->blockRate) return (peer->blockRate > 0);
+    return (peer->pingTime > 0 && (otherPeer->pingTime == 0 || peer->pingTime < otherPeer->pingTime));
+}
+
 // returns a hash value for a block's prevBlock value suitable for use in a hashtable
 inline static size_t _BRPrevBlockHash(const void *block)
 {
@@ -153,33 +218,39 @@ inline static int _BRPrevBlockEq(const void *block, const void *otherBlock)
     return UInt256Eq(((const BRMerkleBlock *)block)->prevBlock, ((const BRMerkleBlock *)otherBlock)->prevBlock);
 }
 
-// returns a hash value for a block's height value suitable for use in a hashtable
-inline static size_t _BRBlockHeightHash(const void *block)
-{
-    // (FNV_OFFSET xor height)*FNV_PRIME
-    return (size_t)((0x811C9dc5 ^ ((const BRMerkleBlock *)block)->height)*0x01000193);
-}
-
-// true if block and otherBlock have equal height values
-inline static int _BRBlockHeightEq(const void *block, const void *otherBlock)
-{
-    return (((const BRMerkleBlock *)block)->height == ((const BRMerkleBlock *)otherBlock)->height);
-}
+BR_SET_DEFINE(_BRBlockSet, BRMerkleBlock, BRMerkleBlockHash, BRMerkleBlockEq)
+BR_SET_DEFINE(_BROrphanSet, BRMerkleBlock, _BRPrevBlockHash, _BRPrevBlockEq)
 
 struct BRPeerManagerStruct {
     const BRChainParams *params;
     BRWallet *wallet;
-    int isConnected, connectFailureCount, misbehavinCount, dnsThreadCount, peerThreadCount, maxConnectCount;
+    int isConnected, connectFailureCount, misbehavinCount, peerThreadCount, maxConnectCount;
     BRPeer *peers, *downloadPeer, fixedPeer, **connectedPeers;
     char downloadPeerName[INET6_ADDRSTRLEN + 6];
     uint32_t earliestKeyTime, syncStartHeight, filterUpdateHeight, estimatedHeight;
     BRBloomFilter *bloomFilter;
     double fpRate, averageTxPerBlock;
-    BRSet *blocks, *orphans, *checkpoints;
+    BRSet *blocks, *orphans;
     BRMerkleBlock *lastBlock, *lastOrphan;
-    BRTxPeerList *txRelays, *txRequests;
+    size_t orphanMaxCount, orphanMaxBytes, orphanBytes;
+    UInt256 chainTip, *chainHashes; // main chain block hashes indexed by height from chainStart, as of chainTip
+    uint32_t chainStart;
+    int headersFirst, downloadFiltered, eventLoop, compactFilters;
+    int walletBatch; // true while wallet updates for blocks downloaded during a sync are batched
+    BRWallet **wallets; // wallets synced over the manager's peers and header chain, manager->wallet is wallets[0]
+    uint32_t *walletKeyTimes; // earliestKeyTime of each of wallets
+    uint32_t downloadStart, downloadBatch;
+    uint32_t syncBlockCount; // blocks received from downloadPeer since syncBlockTime, to measure its blockRate
+    time_t syncBlockTime;
+    size_t downloadNext;
+    BRBlockRequest *downloadRequests; // main chain blocks from downloadStart, during a headers first sync
+    BRDownloadPeer *downloadPeers; // getdata pipeline state for each peer downloading filtered blocks
+    uint8_t *filterScripts; // wallet output scripts, concatenated, for matching compact block filters
+    size_t *filterScriptLens;
+    BRSet *txRelays, *txRequests; // BRTxPeerList indexed by txHash
     BRPublishedTx *publishedTx;
     UInt256 *publishedTxHashes;
+    BRFeeEstimator *feeEstimator; // learns fee rates from how long wallet txs relayed unconfirmed take to confirm
     void *info;
     void (*syncStarted)(void *info);
     void (*syncStopped)(void *info, int error);
@@ -188,11 +259,144 @@ struct BRPeerManagerStruct {
     void (*savePeers)(void *info, int replace, const BRPeer peers[], size_t peersCount);
     int (*networkIsReachable)(void *info);
     void (*threadCleanup)(void *info);
-    pthread_mutex_t lock;
+    void *trafficInfo;
+    FILE *(*recordFile)(void *info, const BRPeer *peer);
+    FILE *(*replayFile)(void *info, const BRPeer *peer);
+    // lock guards the block chain, sync and connection state, txLock guards publishedTx, publishedTxHashes, txRelays
+    // and txRequests, and peersLock guards peers and misbehavinCount, txLock and peersLock may be taken while holding
+    // lock, but not the other way around, and neither while holding the other
+    pthread_mutex_t lock, txLock, peersLock;
+    uint64_t lockTime; // when lock was last taken, for instrumentation
+    struct { // sync and connection state published on every release of lock, so frequent readers never wait for it
+        _Atomic unsigned seq; // seqlock, odd while the state is being written
+        _Atomic uint32_t lastBlockHeight, lastBlockTimestamp, syncStartHeight, estimatedHeight, downloadHeight;
+        _Atomic int hasDownloadPeer;
+        _Atomic BRPeerStatus connectStatus;
+    } published;
 };
 
+// takes manager->lock, recording the time spent waiting for it
+static void _BRPeerManagerLock(BRPeerManager *manager)
+{
+    uint64_t start = BRStatsMicroseconds();
+
+    pthread_mutex_lock(&manager->lock);
+    manager->lockTime = BRStatsMicroseconds();
+    BRStatsRecord(BRStatsPeerManagerLockWait, manager->lockTime - start);
+}
+
+// publishes the sync and connection state read by BRPeerManagerSyncProgress(), BRPeerManagerConnectStatus(), etc
+// must be called while holding manager->lock, which serializes the writers
+static void _BRPeerManagerPublish(BRPeerManager *manager)
+{
+    BRPeerStatus status = (manager->isConnected != 0) ? BRPeerStatusConnected : BRPeerStatusDisconnected;
+    uint32_t height;
+    unsigned seq;
+
+    if (! manager->lastBlock) return; // freed by BRPeerManagerFree()
+    height = manager->lastBlock->height;
+
+    // when syncing headers first, progress is the height all filtered blocks have been downloaded through
+    if (manager->headersFirst && array_count(manager->downloadRequests) > 0) {
+        height = manager->downloadStart + (uint32_t)manager->downloadNext - 1;
+    }
+
+    for (size_t i = array_count(manager->connectedPeers); i > 0 && status == BRPeerStatusDisconnected; i--) {
+        if (BRPeerConnectStatus(manager->connectedPeers[i - 1]) == BRPeerStatusDisconnected) continue;
+        status = BRPeerStatusConnecting;
+    }
+
+    seq = atomic_load_explicit(&manager->published.seq, memory_order_relaxed);
+    atomic_store_explicit(&manager->published.seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&manager->published.lastBlockHeight, manager->lastBlock->height, memory_order_relaxed);
+    atomic_store_explicit(&manager->published.lastBlockTimestamp, manager->lastBlock->timestamp, memory_order_relaxed);
+    atomic_store_explicit(&manager->published.syncStartHeight, manager->syncStartHeight, memory_order_relaxed);
+    atomic_store_explicit(&manager->published.estimatedHeight, manager->estimatedHeight, memory_order_relaxed);
+    atomic_store_explicit(&manager->published.downloadHeight, height, memory_order_relaxed);
+    atomic_store_explicit(&manager->published.hasDownloadPeer, (manager->downloadPeer != NULL), memory_order_relaxed);
+    atomic_store_explicit(&manager->published.connectStatus, status, memory_order_relaxed);
+    atomic_store_explicit(&manager->published.seq, seq + 2, memory_order_release);
+}
+
+// releases manager->lock, recording the time it was held, and publishes any changes to the sync and connection state
+static void _BRPeerManagerUnlock(BRPeerManager *manager)
+{
+    _BRPeerManagerPublish(manager);
+    BRStatsRecord(BRStatsPeerManagerLockHold, BRStatsMicroseconds() - manager->lockTime);
+    pthread_mutex_unlock(&manager->lock);
+}
+
+// returns the blockHash of the checkpoint at height, or UINT256_ZERO if there isn't one
+static UInt256 _BRPeerManagerCheckpointHash(const BRPeerManager *manager, uint32_t height)
+{
+    const BRCheckPoint *checkpoint = BRChainParamsCheckpointAtHeight(manager->params, height);
+
+    return (checkpoint) ? UInt256Reverse(checkpoint->hash) : UINT256_ZERO;
+}
+
+// returns the most recent checkpoint block that's at least a week older than earliestKeyTime, where a chain download
+// for the manager's wallets starts
+static BRMerkleBlock *_BRPeerManagerStartCheckpoint(BRPeerManager *manager)
+{
+    uint32_t keyTime = (manager->earliestKeyTime > 7*24*60*60) ? manager->earliestKeyTime - 7*24*60*60 : 0;
+    UInt256 hash = UInt256Reverse(BRChainParamsCheckpointBeforeTimestamp(manager->params, keyTime)->hash);
+
+    return _BRBlockSetGet(manager->blocks, &hash);
+}
+
+// memory held by an orphan block
+static size_t _BRPeerManagerOrphanSize(const BRMerkleBlock *block)
+{
+    return BRMerkleBlockMemoryUsage(block);
+}
+
+// removes block from orphans, returns the removed orphan, or NULL if it wasn't found
+static BRMerkleBlock *_BRPeerManagerRemoveOrphan(BRPeerManager *manager, const BRMerkleBlock *block)
+{
+    BRMerkleBlock *orphan = _BROrphanSetRemove(manager->orphans, block);
+
+    if (orphan) {
+        manager->orphanBytes -= (_BRPeerManagerOrphanSize(orphan) < manager->orphanBytes) ?
+                                _BRPeerManagerOrphanSize(orphan) : manager->orphanBytes;
+        if (manager->lastOrphan == orphan) manager->lastOrphan = NULL;
+    }
+
+    return orphan;
+}
+
+// adds block to orphans, evicting the oldest orphans while over the count or byte limit, returns true if the block
+// itself was kept, otherwise it has been freed
+static int _BRPeerManagerAddOrphan(BRPeerManager *manager, BRMerkleBlock *block)
+{
+    BRMerkleBlock *b, *oldest;
+    int kept = 1;
+
+    b = _BRPeerManagerRemoveOrphan(manager, block); // replace any orphan with the same prevBlock
+    if (b && b != block) BRMerkleBlockFree(b);
+    _BROrphanSetAdd(manager->orphans, block);
+    manager->orphanBytes += _BRPeerManagerOrphanSize(block);
+
+    while (BRSetCount(manager->orphans) > manager->orphanMaxCount || manager->orphanBytes > manager->orphanMaxBytes) {
+        oldest = NULL;
+
+        for (b = BRSetIterate(manager->orphans, NULL); b; b = BRSetIterate(manager->orphans, b)) {
+            if (! oldest || b->timestamp < oldest->timestamp) oldest = b;
+        }
+
+        if (! oldest) break;
+        _BRPeerManagerRemoveOrphan(manager, oldest);
+        if (oldest == block) kept = 0;
+        BRMerkleBlockFree(oldest);
+    }
+
+    return kept;
+}
+
 static void _BRPeerManagerPeerMisbehavin(BRPeerManager *manager, BRPeer *peer)
 {
+    pthread_mutex_lock(&manager->peersLock);
+
     for (size_t i = array_count(manager->peers); i > 0; i--) {
         if (BRPeerEq(&manager->peers[i - 1], peer)) array_rm(manager->peers, i - 1);
     }
@@ -202,24 +406,415 @@ static void _BRPeerManagerPeerMisbehavin(BRPeerManager *manager, BRPeer *peer)
         array_clear(manager->peers);
     }
 
+    pthread_mutex_unlock(&manager->peersLock);
     BRPeerDisconnect(peer);
 }
 
-static void _BRPeerManagerSyncStopped(BRPeerManager *manager)
+// records the measured ping time of a connected peer, and its block delivery rate if it's the download peer, in its
+// stored peer entry, so they're saved with the peer list and used to prefer faster peers when reconnecting
+static void _BRPeerManagerRecordPeerStats(BRPeerManager *manager, BRPeer *peer)
 {
-    manager->syncStartHeight = 0;
+    uint32_t pingTime = (uint32_t)(BRPeerPingTime(peer)*1000), blockRate = 0;
+    time_t elapsed = time(NULL) - manager->syncBlockTime;
 
-    if (manager->downloadPeer) {
+    if (pingTime > 0) peer->pingTime = pingTime;
+    
+    if (peer == manager->downloadPeer && manager->syncBlockCount >= 100 && elapsed > 0) { // ignore short samples
+        blockRate = (uint32_t)(manager->syncBlockCount*60/elapsed);
+        peer->blockRate = (blockRate > 0) ? blockRate : 1;
+        manager->syncBlockCount = 0;
+        manager->syncBlockTime = time(NULL);
+    }
+
+    pthread_mutex_lock(&manager->peersLock);
+
+    for (size_t i = array_count(manager->peers); i > 0; i--) {
+        if (! BRPeerEq(&manager->peers[i - 1], peer)) continue;
+        manager->peers[i - 1].pingTime = peer->pingTime;
+        manager->peers[i - 1].blockRate = peer->blockRate;
+        break;
+    }
+
+    pthread_mutex_unlock(&manager->peersLock);
+}
+
+// true if any tx publish callbacks are pending
+static int _BRPeerManagerHasPendingCallbacks(BRPeerManager *manager)
+{
+    int hasPendingCallbacks = 0;
+
+    pthread_mutex_lock(&manager->txLock);
+
+    for (size_t i = array_count(manager->publishedTx); ! hasPendingCallbacks && i > 0; i--) {
+        if (manager->publishedTx[i - 1].callback != NULL) hasPendingCallbacks = 1;
+    }
+
+    pthread_mutex_unlock(&manager->txLock);
+    return hasPendingCallbacks;
+}
+
+// returns true if syncing, and sets isSyncPeer to true if peer is the download peer or is downloading filtered blocks,
+// in which case its sync timeout must be left scheduled, lock must not be held by the caller
+static int _BRPeerManagerSyncState(BRPeerManager *manager, BRPeer *peer, int *isSyncPeer, int *maxConnectCount)
+{
+    int isSyncing;
+
+    _BRPeerManagerLock(manager);
+    isSyncing = (manager->syncStartHeight > 0);
+    *isSyncPeer = (isSyncing && (peer == manager->downloadPeer || (peer->flags & PEER_FLAG_DOWNLOADING)));
+    *maxConnectCount = manager->maxConnectCount;
+    _BRPeerManagerUnlock(manager);
+    return isSyncing;
+}
+
+// during a headers first sync, adds a block that extends the main chain to those to download filtered blocks for,
+// unless it's a header older than a week before earliestKeyTime, which no wallet transaction can be in
+static void _BRPeerManagerDownloadAddBlock(BRPeerManager *manager, BRMerkleBlock *block)
+{
+    uint8_t received = (block->totalTx > 0 || block->timestamp + 7*24*60*60 <= manager->earliestKeyTime + 2*60*60);
+    size_t count = array_count(manager->downloadRequests);
+
+    if (count == 0) {
+        if (received) return;
+        manager->downloadStart = block->height;
+        manager->downloadNext = 0;
+    }
+
+    assert(block->height == manager->downloadStart + count);
+    array_add(manager->downloadRequests, ((const BRBlockRequest) { block->blockHash, NULL, 0, 0, received, 0 }));
+    if (received && manager->downloadNext == count) manager->downloadNext++;
+}
+
+// returns the index of block among those being downloaded, or SIZE_MAX if it isn't the main chain block at its height
+static size_t _BRPeerManagerDownloadIndex(BRPeerManager *manager, const BRMerkleBlock *block)
+{
+    size_t i;
+
+    if (! manager->headersFirst || block->height == BLOCK_UNKNOWN_HEIGHT || block->height < manager->downloadStart) {
+        return SIZE_MAX;
+    }
+
+    i = block->height - manager->downloadStart;
+    return (i < array_count(manager->downloadRequests) &&
+            UInt256Eq(manager->downloadRequests[i].blockHash, block->blockHash)) ? i : SIZE_MAX;
+}
+
+// true if filtered blocks are downloaded from peer by matching its compact block filters locally, which needs the wallet
+// scripts gathered when the bloom filter is built
+static int _BRPeerManagerCompactFiltersPeer(BRPeerManager *manager, const BRPeer *peer)
+{
+    return (manager->compactFilters && array_count(manager->filterScriptLens) > 0 &&
+            (peer->services & SERVICES_NODE_COMPACT_FILTERS));
+}
+
+// true if any wallet output script is matched by the basic compact filter for the block with blockHash
+static int _BRPeerManagerFilterMatch(BRPeerManager *manager, UInt256 blockHash, const uint8_t *filter,
+                                     size_t filterLen)
+{
+    size_t i, off, count = array_count(manager->filterScriptLens);
+    const uint8_t *items[count + 1];
+
+    for (i = 0, off = 0; i < count; off += manager->filterScriptLens[i++]) items[i] = &manager->filterScripts[off];
+    return BRBlockFilterMatchAny(filter, filterLen, blockHash, items, manager->filterScriptLens, count);
+}
+
+static double _BRPeerManagerTime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (double)tv.tv_usec/1000000;
+}
+
+// returns the getdata pipeline state for peer, adding it if create is true, or NULL
+static BRDownloadPeer *_BRPeerManagerDownloadPeer(BRPeerManager *manager, BRPeer *peer, int create)
+{
+    for (size_t i = array_count(manager->downloadPeers); i > 0; i--) {
+        if (manager->downloadPeers[i - 1].peer == peer) return &manager->downloadPeers[i - 1];
+    }
+
+    if (! create) return NULL;
+    array_add(manager->downloadPeers, ((const BRDownloadPeer) { peer, 0, DOWNLOAD_MIN_WINDOW, BRPeerPingTime(peer),
+                                                                0, 0 }));
+    return &manager->downloadPeers[array_count(manager->downloadPeers) - 1];
+}
+
+static void _requestBlocksDone(void *info, int success);
+
+// requests a batch of filtered blocks from peer, preferring blocks not yet requested, and otherwise (if canSteal is
+// true) the lowest blocks still outstanding from other peers so one slow peer doesn't hold up the sync, returns the
+// number of blocks requested
+static size_t _BRPeerManagerRequestBatch(BRPeerManager *manager, BRPeer *peer, int canSteal)
+{
+    size_t count = array_count(manager->downloadRequests), n = 0, first = 0, last = 0, i;
+    int compact = _BRPeerManagerCompactFiltersPeer(manager, peer);
+    UInt256 hashes[DOWNLOAD_REQUEST_COUNT];
+    BRBlockRequestInfo *info;
+
+    manager->downloadBatch++;
+
+    for (int steal = 0; steal <= canSteal && n == 0; steal++) {
+        for (i = manager->downloadNext; i < count && n < DOWNLOAD_REQUEST_COUNT; i++) {
+            BRBlockRequest *r = &manager->downloadRequests[i];
+
+            if (r->received || r->peer == peer || (r->peer != NULL) != steal) continue;
+            if (steal && r->requestCount >= 2) continue;
+            if (compact && n > 0 && i - first >= MAX_CFILTERS_COUNT) break; // compact filters are requested by range
+            if (n == 0) first = i;
+            last = i;
+            r->peer = peer;
+            r->matched = 0;
+            r->batch = manager->downloadBatch;
+            if (r->requestCount < UINT8_MAX) r->requestCount++;
+            hashes[n++] = r->blockHash;
+        }
+    }
+
+    if (n > 0) {
+        peer->flags |= PEER_FLAG_DOWNLOADING;
+        BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // stall timeout, rescheduled as blocks arrive
+        BRPeerBeginBatch(peer); // request and ping go out in one write
+
+        if (compact) { // filters for blocks in the range that aren't in the batch are ignored
+            BRPeerSendGetcfilters(peer, manager->downloadStart + (uint32_t)first,
+                                  manager->downloadRequests[last].blockHash);
+        }
+        else BRPeerSendGetdata(peer, NULL, 0, hashes, n);
+
+        info = calloc(1, sizeof(*info));
+        assert(info != NULL);
+        info->peer = peer;
+        info->manager = manager;
+        info->batch = manager->downloadBatch;
+        info->time = _BRPeerManagerTime();
+        BRPeerSendPing(peer, info, _requestBlocksDone); // pong follows the blocks, or the compact filters
+        BRPeerEndBatch(peer);
+    }
+
+    return n;
+}
+
+// keeps up to the peer's in-flight window of filtered block batches outstanding, so the next batch is already on its
+// way when one completes instead of the connection idling for a round trip between batches
+static void _BRPeerManagerRequestBlocks(BRPeerManager *manager, BRPeer *peer)
+{
+    BRDownloadPeer *d;
+
+    if (! manager->downloadFiltered || BRPeerConnectStatus(peer) != BRPeerStatusConnected ||
+        (peer->flags & PEER_FLAG_NEEDSUPDATE)) return;
+
+    d = _BRPeerManagerDownloadPeer(manager, peer, 1);
+
+    // only an idle peer re-requests blocks outstanding from other peers
+    while (d->inFlight < d->window && _BRPeerManagerRequestBatch(manager, peer, (d->inFlight == 0)) > 0) {
+        d->inFlight++;
+    }
+
+    if (d->inFlight == 0 && (peer->flags & PEER_FLAG_DOWNLOADING)) {
+        peer->flags &= ~PEER_FLAG_DOWNLOADING;
         // don't cancel timeout if there's a pending tx publish callback
-        for (size_t i = array_count(manager->publishedTx); i > 0; i--) {
-            if (manager->publishedTx[i - 1].callback != NULL) return;
+        if (! _BRPeerManagerHasPendingCallbacks(manager)) BRPeerScheduleDisconnect(peer, -1);
+    }
+}
+
+// resizes peer's in-flight window after a batch completes, to cover the blocks it delivers in one round trip
+static void _BRPeerManagerDownloadWindow(BRDownloadPeer *d, size_t received, double requestTime)
+{
+    double now = _BRPeerManagerTime(), elapsed = now - ((d->lastDone > requestTime) ? d->lastDone : requestTime),
+           rtt = BRPeerPingTime(d->peer);
+
+    if (d->inFlight > 0) d->inFlight--;
+    if (rtt < d->rtt) d->rtt = rtt; // pings queued behind blocks overstate the round trip, so use the least seen
+
+    if (received > 0 && elapsed > 0) {
+        d->rate = (d->rate > 0) ? d->rate*0.5 + (received/elapsed)*0.5 : received/elapsed;
+    }
+
+    d->lastDone = now;
+
+    if (d->rate > 0 && d->rtt < PROTOCOL_TIMEOUT) {
+        d->window = 2 + (uint32_t)(d->rate*d->rtt/DOWNLOAD_REQUEST_COUNT);
+        if (d->window > DOWNLOAD_MAX_WINDOW) d->window = DOWNLOAD_MAX_WINDOW;
+    }
+}
+
+static void _requestBlocksDone(void *info, int success)
+{
+    BRPeer *peer = ((BRBlockRequestInfo *)info)->peer;
+    BRPeerManager *manager = ((BRBlockRequestInfo *)info)->manager;
+    uint32_t batch = ((BRBlockRequestInfo *)info)->batch;
+    double requestTime = ((BRBlockRequestInfo *)info)->time;
+    size_t count = 0, received = 0, matched = 0;
+    BRDownloadPeer *d;
+
+    if (! success) { // requests from a disconnected peer are released in _peerDisconnected()
+        free(info);
+        return;
+    }
+
+    _BRPeerManagerLock(manager);
+
+    for (size_t i = array_count(manager->downloadRequests); i > 0; i--) {
+        BRBlockRequest *r = &manager->downloadRequests[i - 1];
+
+        if (r->peer == peer && r->batch == batch && r->matched && ! r->received) matched++;
+    }
+
+    // full blocks for matched compact filters were requested as the filters arrived, ahead of this pong, and compact
+    // blocks may take another round trip for their missing tx
+    if (matched > 0 && ((BRBlockRequestInfo *)info)->waited < 2) {
+        ((BRBlockRequestInfo *)info)->waited++;
+        BRPeerSendPing(peer, info, _requestBlocksDone);
+        _BRPeerManagerUnlock(manager);
+        return;
+    }
+
+    free(info);
+
+    for (size_t i = array_count(manager->downloadRequests); i > 0; i--) {
+        BRBlockRequest *r = &manager->downloadRequests[i - 1];
+
+        if (r->peer != peer || r->batch != batch) continue;
+        count++;
+        if (r->received) received++;
+        r->peer = NULL; // blocks that didn't arrive (notfound, or dropped for a filter update) are requested again
+    }
+
+    d = _BRPeerManagerDownloadPeer(manager, peer, 0);
+    if (d) _BRPeerManagerDownloadWindow(d, received, requestTime);
+
+    if (count > 0 && received == 0 && manager->bloomFilter && (peer->flags & PEER_FLAG_NEEDSUPDATE) == 0) {
+        peer_log(peer, "sent none of %zu requested filtered blocks, disconnecting", count);
+        BRPeerDisconnect(peer);
+    }
+    else _BRPeerManagerRequestBlocks(manager, peer);
+
+    _BRPeerManagerUnlock(manager);
+}
+
+// filtered blocks received before a bloom filter update may be missing transactions, so request them again
+static void _BRPeerManagerDownloadReset(BRPeerManager *manager)
+{
+    for (size_t i = manager->downloadNext; i < array_count(manager->downloadRequests); i++) {
+        UInt256 blockHash = manager->downloadRequests[i].blockHash;
+
+        manager->downloadRequests[i] = ((const BRBlockRequest) { blockHash, NULL, 0, 0, 0, 0 });
+    }
+}
+
+// the main chain was reorganized from joinHeight during a headers first sync, so replace the blocks after it
+static void _BRPeerManagerDownloadReorg(BRPeerManager *manager, uint32_t joinHeight)
+{
+    size_t count = array_count(manager->downloadRequests), n = 0, i;
+    BRMerkleBlock *b;
+
+    if (joinHeight + 1 < manager->downloadStart + count) {
+        count = (joinHeight + 1 > manager->downloadStart) ? joinHeight + 1 - manager->downloadStart : 0;
+    }
+
+    array_set_count(manager->downloadRequests, count);
+    if (manager->downloadNext > count) manager->downloadNext = count;
+
+    for (b = manager->lastBlock; b && b->height > joinHeight; b = _BRBlockSetGet(manager->blocks, &b->prevBlock)) n++;
+
+    BRMerkleBlock *chain[n];
+
+    for (b = manager->lastBlock, i = n; b && i > 0; b = _BRBlockSetGet(manager->blocks, &b->prevBlock)) chain[--i] = b;
+    for (i = 0; i < n; i++) _BRPeerManagerDownloadAddBlock(manager, chain[i]);
+}
+
+// ends a headers first sync, rolling lastBlock back to the last block that all filtered blocks were downloaded through
+static void _BRPeerManagerDownloadStop(BRPeerManager *manager)
+{
+    BRMerkleBlock *b = NULL;
+
+    if (manager->downloadNext < array_count(manager->downloadRequests)) {
+        if (manager->downloadNext > 0) {
+            b = _BRBlockSetGet(manager->blocks, &manager->downloadRequests[manager->downloadNext - 1].blockHash);
         }
-    
+        else if ((b = _BRBlockSetGet(manager->blocks, &manager->downloadRequests[0].blockHash)) != NULL) {
+            b = _BRBlockSetGet(manager->blocks, &b->prevBlock);
+        }
+
+        if (b) manager->lastBlock = b;
+    }
+
+    for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
+        manager->connectedPeers[i - 1]->flags &= ~PEER_FLAG_DOWNLOADING;
+    }
+
+    if (manager->downloadPeer) BRPeerSetHeadersFirst(manager->downloadPeer, 0);
+    array_clear(manager->downloadRequests);
+    manager->headersFirst = manager->downloadFiltered = 0;
+    manager->downloadNext = 0;
+}
+
+// applies the batched wallet updates, bringing the wallet balance and tx order up to date with the downloaded blocks
+static void _BRPeerManagerCommitWallet(BRPeerManager *manager)
+{
+    for (size_t i = 0; manager->walletBatch && i < array_count(manager->wallets); i++) {
+        BRWalletCommitBatch(manager->wallets[i]);
+    }
+
+    manager->walletBatch = 0;
+}
+
+// true if any of the manager's wallets has a tx with txHash
+static int _BRPeerManagerHasTx(BRPeerManager *manager, UInt256 txHash)
+{
+    for (size_t i = 0; i < array_count(manager->wallets); i++) {
+        if (BRWalletTransactionForHash(manager->wallets[i], txHash)) return 1;
+    }
+
+    return 0;
+}
+
+// true if the output script pays to an address of any of the manager's wallets
+static int _BRPeerManagerContainsScript(BRPeerManager *manager, const uint8_t *script, size_t scriptLen)
+{
+    const uint8_t *pkh = BRScriptPKH(script, scriptLen);
+
+    for (size_t i = 0; pkh && i < array_count(manager->wallets); i++) {
+        if (BRWalletContainsPKH(manager->wallets[i], UInt160Get(pkh))) return 1;
+    }
+
+    return 0;
+}
+
+// sets the block height and timestamp for txHashes in each of the manager's wallets
+static void _BRPeerManagerUpdateTransactions(BRPeerManager *manager, const UInt256 txHashes[], size_t txCount,
+                                             uint32_t blockHeight, uint32_t timestamp)
+{
+    for (size_t i = 0; i < array_count(manager->wallets); i++) {
+        BRWalletUpdateTransactions(manager->wallets[i], txHashes, txCount, blockHeight, timestamp);
+    }
+
+    if (blockHeight != TX_UNCONFIRMED) { // relays and requests are only tracked for unconfirmed tx
+        pthread_mutex_lock(&manager->txLock);
+
+        for (size_t i = 0; i < txCount; i++) {
+            _BRTxPeerListRemove(manager->txRelays, txHashes[i]);
+            _BRTxPeerListRemove(manager->txRequests, txHashes[i]);
+        }
+
+        pthread_mutex_unlock(&manager->txLock);
+    }
+}
+
+static void _BRPeerManagerSyncStopped(BRPeerManager *manager)
+{
+    if (manager->downloadPeer) _BRPeerManagerRecordPeerStats(manager, manager->downloadPeer);
+    manager->syncStartHeight = 0;
+    _BRPeerManagerCommitWallet(manager);
+    if (manager->headersFirst) _BRPeerManagerDownloadStop(manager);
+
+    // don't cancel timeout if there's a pending tx publish callback
+    if (manager->downloadPeer && ! _BRPeerManagerHasPendingCallbacks(manager)) {
         BRPeerScheduleDisconnect(manager->downloadPeer, -1); // cancel sync timeout
     }
 }
 
-// adds transaction to list of tx to be published, along with any unconfirmed inputs
+// adds transaction to list of tx to be published, along with any unconfirmed inputs, txLock must be held
 static void _BRPeerManagerAddTxToPublishList(BRPeerManager *manager, BRTransaction *tx, void *info,
                                              void (*callback)(void *, int))
 {
@@ -250,7 +845,7 @@ static size_t _BRPeerManagerBlockLocators(BRPeerManager *manager, UInt256 locato
         if (++i >= 10) step *= 2;
         
         for (j = 0; block && j < step; j++) {
-            block = BRSetGet(manager->blocks, &block->prevBlock);
+            block = _BRBlockSetGet(manager->blocks, &block->prevBlock);
         }
     }
     
@@ -263,49 +858,93 @@ static void _setApplyFreeBlock(void *info, void *block)
     BRMerkleBlockFree(block);
 }
 
-static void _BRPeerManagerLoadBloomFilter(BRPeerManager *manager, BRPeer *peer)
+// builds a new bloom filter from the wallet's addresses, UTXOs and recently spent outputs, which is shared by all peers
+static void _BRPeerManagerRebuildBloomFilter(BRPeerManager *manager)
 {
     // every time a new wallet address is added, the bloom filter has to be rebuilt, and each address is only used
     // for one transaction, so here we generate some spare addresses to avoid rebuilding the filter each time a
     // wallet transaction is encountered during the chain sync
-    BRWalletUnusedAddrs(manager->wallet, NULL, SEQUENCE_GAP_LIMIT_EXTERNAL + 100, 0);
-    BRWalletUnusedAddrs(manager->wallet, NULL, SEQUENCE_GAP_LIMIT_INTERNAL + 100, 1);
+    // watch-only wallets get a smaller window, extended as their addresses are used, since with thousands of them the
+    // spares would be most of the filter (compact filters take the new addresses without a rebuild)
+    for (size_t i = 0; i < array_count(manager->wallets); i++) {
+        uint32_t spare = (BRWalletIsWatchOnly(manager->wallets[i])) ? SPARE_ADDRS_WATCH_ONLY : SPARE_ADDRS;
+
+        BRWalletUnusedAddrs(manager->wallets[i], NULL, SEQUENCE_GAP_LIMIT_EXTERNAL + spare, 0);
+        BRWalletUnusedAddrs(manager->wallets[i], NULL, SEQUENCE_GAP_LIMIT_INTERNAL + spare, 1);
+    }
 
     BRSetApply(manager->orphans, NULL, _setApplyFreeBlock);
     BRSetClear(manager->orphans); // clear out orphans that may have been received on an old filter
     manager->lastOrphan = NULL;
+    manager->orphanBytes = 0;
     manager->filterUpdateHeight = manager->lastBlock->height;
     manager->fpRate = BLOOM_REDUCED_FALSEPOSITIVE_RATE;
     
-    size_t addrsCount = BRWalletAllAddrs(manager->wallet, NULL, 0);
-    BRAddress *addrs = malloc(addrsCount*sizeof(*addrs));
-    size_t utxosCount = BRWalletUTXOs(manager->wallet, NULL, 0);
-    BRUTXO *utxos = malloc(utxosCount*sizeof(*utxos));
     uint32_t blockHeight = (manager->lastBlock->height > 100) ? manager->lastBlock->height - 100 : 0;
-    size_t txCount = BRWalletTxUnconfirmedBefore(manager->wallet, NULL, 0, blockHeight);
-    BRTransaction **transactions = malloc(txCount*sizeof(*transactions));
+    size_t pkhsCount = 0, utxosCount = 0, txCount = 0, a = 0, u = 0, w;
+    UInt160 *pkhs;
+    BRUTXO *utxos;
+    BRTransaction **transactions;
     BRBloomFilter *filter;
     
-    assert(addrs != NULL);
+    for (w = 0; w < array_count(manager->wallets); w++) { // the filter matches the union of all the manager's wallets
+        pkhsCount += BRWalletAllPKHs(manager->wallets[w], NULL, 0);
+        utxosCount += BRWalletUTXOs(manager->wallets[w], NULL, 0);
+        txCount += BRWalletTxUnconfirmedBefore(manager->wallets[w], NULL, 0, blockHeight);
+    }
+    
+    pkhs = malloc((pkhsCount + 1)*sizeof(*pkhs));
+    utxos = malloc((utxosCount + 1)*sizeof(*utxos));
+    transactions = malloc((txCount + 1)*sizeof(*transactions));
+    assert(pkhs != NULL);
     assert(utxos != NULL);
     assert(transactions != NULL);
-    addrsCount = BRWalletAllAddrs(manager->wallet, addrs, addrsCount);
-    utxosCount = BRWalletUTXOs(manager->wallet, utxos, utxosCount);
-    txCount = BRWalletTxUnconfirmedBefore(manager->wallet, transactions, txCount, blockHeight);
-    filter = BRBloomFilterNew(manager->fpRate, addrsCount + utxosCount + txCount + 100, (uint32_t)BRPeerHash(peer),
-                              BLOOM_UPDATE_ALL); // BUG: XXX txCount not the same as number of spent wallet outputs
     
-    for (size_t i = 0; i < addrsCount; i++) { // add addresses to watch for tx receiveing money to the wallet
-        UInt160 hash = UINT160_ZERO;
-        
-        BRAddressHash160(&hash, addrs[i].s);
-        
-        if (! UInt160IsZero(hash) && ! BRBloomFilterContainsData(filter, hash.u8, sizeof(hash))) {
-            BRBloomFilterInsertData(filter, hash.u8, sizeof(hash));
+    if (manager->compactFilters) {
+        array_clear(manager->filterScripts);
+        array_clear(manager->filterScriptLens);
+    }
+
+    for (w = 0; w < array_count(manager->wallets); w++) {
+        size_t start = a;
+
+        a += BRWalletAllPKHs(manager->wallets[w], &pkhs[a], pkhsCount - a);
+        u += BRWalletUTXOs(manager->wallets[w], &utxos[u], utxosCount - u);
+
+        // compact filters match output scripts, both for outputs to the wallet and for the outputs wallet tx spend
+        for (size_t i = start; manager->compactFilters && i < a; i++) {
+            size_t scriptLen = BRWalletPKHScriptPubKey(manager->wallets[w], NULL, 0, pkhs[i]);
+
+            array_set_count(manager->filterScripts, array_count(manager->filterScripts) + scriptLen);
+            BRWalletPKHScriptPubKey(manager->wallets[w],
+                                    &manager->filterScripts[array_count(manager->filterScripts) - scriptLen],
+                                    scriptLen, pkhs[i]);
+            array_add(manager->filterScriptLens, scriptLen);
         }
     }
+    
+    pkhsCount = a;
+    utxosCount = u;
+    filter = BRBloomFilterNew(manager->fpRate, pkhsCount + utxosCount + txCount + 100, BRRand(0),
+                              BLOOM_UPDATE_ALL); // BUG: XXX txCount not the same as number of spent wallet outputs
+
+    const uint8_t **items = malloc((pkhsCount + 1)*sizeof(*items));
+    size_t *itemLens = malloc((pkhsCount + 1)*sizeof(*itemLens));
+
+    assert(items != NULL);
+    assert(itemLens != NULL);
+
+    // add addresses to watch for tx receiveing money to the wallet, wallet addresses are unique, so there's no need to
+    // check for duplicates
+    for (size_t i = 0; i < pkhsCount; i++) {
+        items[i] = pkhs[i].u8;
+        itemLens[i] = sizeof(*pkhs);
+    }
 
-    free(addrs);
+    BRBloomFilterInsertDataArray(filter, items, itemLens, pkhsCount);
+    free(itemLens);
+    free(items);
+    free(pkhs);
         
     for (size_t i = 0; i < utxosCount; i++) { // add UTXOs to watch for tx sending money from the wallet
         uint8_t o[sizeof(UInt256) + sizeof(uint32_t)];
@@ -317,17 +956,24 @@ static void _BRPeerManagerLoadBloomFilter(BRPeerManager *manager, BRPeer *peer)
     
     free(utxos);
         
-    for (size_t i = 0; i < txCount; i++) { // also add TXOs spent within the last 100 blocks
-        for (size_t j = 0; j < transactions[i]->inCount; j++) {
-            BRTxInput *input = &transactions[i]->inputs[j];
-            BRTransaction *tx = BRWalletTransactionForHash(manager->wallet, input->txHash);
-            uint8_t o[sizeof(UInt256) + sizeof(uint32_t)];
-            
-            if (tx && input->index < tx->outCount &&
-                BRWalletContainsAddress(manager->wallet, tx->outputs[input->index].address)) {
-                UInt256Set(o, input->txHash);
-                UInt32SetLE(&o[sizeof(UInt256)], input->index);
-                if (! BRBloomFilterContainsData(filter, o, sizeof(o))) BRBloomFilterInsertData(filter, o,sizeof(o));
+    for (w = 0; w < array_count(manager->wallets); w++) { // also add TXOs spent within the last 100 blocks
+        BRWallet *wallet = manager->wallets[w];
+        size_t count = BRWalletTxUnconfirmedBefore(wallet, transactions, txCount, blockHeight);
+        
+        for (size_t i = 0; i < count; i++) {
+            for (size_t j = 0; j < transactions[i]->inCount; j++) {
+                BRTxInput *input = &transactions[i]->inputs[j];
+                BRTransaction *tx = BRWalletTransactionForHash(wallet, input->txHash);
+                const uint8_t *pkh = (tx && input->index < tx->outCount) ?
+                                     BRScriptPKH(tx->outputs[input->index].script,
+                                                 tx->outputs[input->index].scriptLen) : NULL;
+                uint8_t o[sizeof(UInt256) + sizeof(uint32_t)];
+                
+                if (pkh && BRWalletContainsPKH(wallet, UInt160Get(pkh))) {
+                    UInt256Set(o, input->txHash);
+                    UInt32SetLE(&o[sizeof(UInt256)], input->index);
+                    if (! BRBloomFilterContainsData(filter, o, sizeof(o))) BRBloomFilterInsertData(filter, o,sizeof(o));
+                }
             }
         }
     }
@@ -336,11 +982,23 @@ static void _BRPeerManagerLoadBloomFilter(BRPeerManager *manager, BRPeer *peer)
     if (manager->bloomFilter) BRBloomFilterFree(manager->bloomFilter);
     manager->bloomFilter = filter;
     // TODO: XXX if already synced, recursively add inputs of unconfirmed receives
+}
+
+static void _BRPeerManagerLoadBloomFilter(BRPeerManager *manager, BRPeer *peer)
+{
+    BR_TRACE_BEGIN(traceBegin);
 
-    uint8_t data[BRBloomFilterSerialize(filter, NULL, 0)];
-    size_t len = BRBloomFilterSerialize(filter, data, sizeof(data));
+    // the filter is only rebuilt after it's been reset, otherwise it's kept up to date by _BRPeerManagerAddToFilter()
+    if (! manager->bloomFilter) _BRPeerManagerRebuildBloomFilter(manager);
+
+    // peers downloading with compact filters don't need a bloom filter until the filtered block download is done
+    if (manager->downloadFiltered && _BRPeerManagerCompactFiltersPeer(manager, peer)) return;
+
+    uint8_t data[BRBloomFilterSerialize(manager->bloomFilter, NULL, 0)];
+    size_t len = BRBloomFilterSerialize(manager->bloomFilter, data, sizeof(data));
     
     BRPeerSendFilterload(peer, data, len);
+    BR_TRACE_END(BRTracePeerManagerFilterload, traceBegin, manager->bloomFilter->elemCount);
 }
 
 static void _updateFilterRerequestDone(void *info, int success)
@@ -351,7 +1009,7 @@ static void _updateFilterRerequestDone(void *info, int success)
     free(info);
     
     if (success) {
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(manager);
 
         if ((peer->flags & PEER_FLAG_NEEDSUPDATE) == 0) {
             UInt256 locators[_BRPeerManagerBlockLocators(manager, NULL, 0)];
@@ -360,7 +1018,7 @@ static void _updateFilterRerequestDone(void *info, int success)
             BRPeerSendGetblocks(peer, locators, count, UINT256_ZERO);
         }
 
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(manager);
     }
 }
 
@@ -373,12 +1031,15 @@ static void _updateFilterLoadDone(void *info, int success)
     free(info);
     
     if (success) {
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(manager);
         BRPeerSetNeedsFilterUpdate(peer, 0);
         peer->flags &= ~PEER_FLAG_NEEDSUPDATE;
         
-        if (manager->lastBlock->height < manager->estimatedHeight) { // if syncing, rerequest blocks
-            if (manager->downloadPeer) {
+        if (manager->downloadFiltered) { // if downloading filtered blocks headers first, resume with the new filter
+            _BRPeerManagerRequestBlocks(manager, peer);
+        }
+        else if (manager->lastBlock->height < manager->estimatedHeight) { // if syncing, rerequest blocks
+            if (manager->downloadPeer && ! manager->headersFirst) { // headers don't depend on the filter
                 peerInfo = calloc(1, sizeof(*peerInfo));
                 assert(peerInfo != NULL);
                 peerInfo->peer = peer;
@@ -389,7 +1050,7 @@ static void _updateFilterLoadDone(void *info, int success)
         }
         else BRPeerSendMempool(peer, NULL, 0, NULL, NULL); // if not syncing, request mempool
         
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(manager);
     }
 }
 
@@ -400,12 +1061,13 @@ static void _updateFilterPingDone(void *info, int success)
     BRPeerCallbackInfo *peerInfo;
     
     if (success) {
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(manager);
         peer_log(peer, "updating filter with newly created wallet addresses");
         if (manager->bloomFilter) BRBloomFilterFree(manager->bloomFilter);
         manager->bloomFilter = NULL;
 
-        if (manager->lastBlock->height < manager->estimatedHeight) { // if we're syncing, only update download peer
+        // if we're syncing, only update download peer, unless filtered blocks are being downloaded from all peers
+        if (! manager->downloadFiltered && manager->lastBlock->height < manager->estimatedHeight) {
             if (manager->downloadPeer) {
                 _BRPeerManagerLoadBloomFilter(manager, manager->downloadPeer);
                 BRPeerSendPing(manager->downloadPeer, info, _updateFilterLoadDone); // wait for pong so filter is loaded
@@ -414,6 +1076,7 @@ static void _updateFilterPingDone(void *info, int success)
         }
         else {
             free(info);
+            if (manager->downloadFiltered) _BRPeerManagerDownloadReset(manager);
             
             for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
                 if (BRPeerConnectStatus(manager->connectedPeers[i - 1]) != BRPeerStatusConnected) continue;
@@ -421,12 +1084,18 @@ static void _updateFilterPingDone(void *info, int success)
                 assert(peerInfo != NULL);
                 peerInfo->peer = manager->connectedPeers[i - 1];
                 peerInfo->manager = manager;
+
+                if (manager->downloadFiltered) { // ignore filtered blocks already in flight until the filter is loaded
+                    BRPeerSetNeedsFilterUpdate(peerInfo->peer, 1);
+                    peerInfo->peer->flags |= PEER_FLAG_NEEDSUPDATE;
+                }
+
                 _BRPeerManagerLoadBloomFilter(manager, peerInfo->peer);
                 BRPeerSendPing(peerInfo->peer, peerInfo, _updateFilterLoadDone); // wait for pong so filter is loaded
             }
         }
 
-         pthread_mutex_unlock(&manager->lock);
+         _BRPeerManagerUnlock(manager);
     }
     else free(info);
 }
@@ -448,16 +1117,90 @@ static void _BRPeerManagerUpdateFilter(BRPeerManager *manager)
     }
 }
 
+// adds the outpoints of tx paid to the wallet to the bloom filter, as peers do with BLOOM_UPDATE_ALL, so peers that
+// load the filter later also match spends of them, then sends filteradd for any of the wallet's pkhs the filter
+// doesn't match yet, unless that would push its false positive rate too high, in which case the filter is rebuilt
+static void _BRPeerManagerAddToFilter(BRPeerManager *manager, BRWallet *wallet, const BRTransaction *tx,
+                                      const UInt160 pkhs[], size_t pkhsCount)
+{
+    BRBloomFilter *filter = manager->bloomFilter;
+    UInt160 hashes[pkhsCount];
+    size_t count = 0, i, j;
+    uint8_t o[sizeof(UInt256) + sizeof(uint32_t)];
+    BRPeerCallbackInfo *peerInfo;
+    int needsRebuild = manager->downloadFiltered; // blocks from all peers would need to be rerequested anyway
+
+    for (i = 0; i < tx->outCount; i++) {
+        if (! _BRPeerManagerContainsScript(manager, tx->outputs[i].script, tx->outputs[i].scriptLen)) continue;
+        UInt256Set(o, tx->txHash);
+        UInt32SetLE(&o[sizeof(UInt256)], (uint32_t)i);
+        if (! BRBloomFilterContainsData(filter, o, sizeof(o))) BRBloomFilterInsertData(filter, o, sizeof(o));
+    }
+
+    for (i = 0; i < pkhsCount; i++) {
+        if (! BRBloomFilterContainsData(filter, pkhs[i].u8, sizeof(*pkhs))) hashes[count++] = pkhs[i];
+    }
+
+    if (count == 0) return;
+    if (BRBloomFilterFalsePositiveRate(filter, filter->elemCount + count) > FILTERADD_MAX_FALSEPOSITIVE_RATE) {
+        needsRebuild = 1;
+    }
+
+    // if syncing, only the download peer has a filter loaded, otherwise all connected peers do
+    for (i = array_count(manager->connectedPeers); ! needsRebuild && i > 0; i--) {
+        BRPeer *peer = manager->connectedPeers[i - 1];
+
+        if (BRPeerConnectStatus(peer) != BRPeerStatusConnected) continue;
+        if (manager->lastBlock->height < manager->estimatedHeight && peer != manager->downloadPeer) continue;
+        if (peer->flags & PEER_FLAG_NEEDSUPDATE) needsRebuild = 1; // a filter update is already in progress
+    }
+
+    if (needsRebuild) {
+        BRBloomFilterFree(manager->bloomFilter);
+        manager->bloomFilter = NULL; // reset bloom filter so it's recreated with new wallet addresses
+        _BRPeerManagerUpdateFilter(manager);
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        BRBloomFilterInsertData(filter, hashes[i].u8, sizeof(*hashes));
+        if (! manager->compactFilters) continue;
+
+        size_t scriptLen = BRWalletPKHScriptPubKey(wallet, NULL, 0, hashes[i]);
+
+        array_set_count(manager->filterScripts, array_count(manager->filterScripts) + scriptLen);
+        BRWalletPKHScriptPubKey(wallet, &manager->filterScripts[array_count(manager->filterScripts) - scriptLen],
+                                scriptLen, hashes[i]);
+        array_add(manager->filterScriptLens, scriptLen);
+    }
+
+    for (i = array_count(manager->connectedPeers); i > 0; i--) {
+        BRPeer *peer = manager->connectedPeers[i - 1];
+
+        if (BRPeerConnectStatus(peer) != BRPeerStatusConnected) continue;
+        if (manager->lastBlock->height < manager->estimatedHeight && peer != manager->downloadPeer) continue;
+        peer_log(peer, "adding %zu new wallet addresses to filter", count);
+        BRPeerSetNeedsFilterUpdate(peer, 1);
+        peer->flags |= PEER_FLAG_NEEDSUPDATE;
+        for (j = 0; j < count; j++) BRPeerSendFilteradd(peer, hashes[j].u8, sizeof(*hashes));
+        peerInfo = calloc(1, sizeof(*peerInfo));
+        assert(peerInfo != NULL);
+        peerInfo->peer = peer;
+        peerInfo->manager = manager;
+        BRPeerSendPing(peer, peerInfo, _updateFilterLoadDone); // wait for pong so filter is updated
+    }
+}
+
 // unconfirmed transactions that aren't in the mempools of any of connected peers have likely dropped off the network
 static void _requestUnrelayedTxGetdataDone(void *info, int success)
 {
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     int isPublishing;
-    size_t count = 0;
+    size_t count = 0, relayCount, requestCount;
 
     free(info);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     if (success) peer->flags |= PEER_FLAG_SYNCED;
     
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
@@ -480,26 +1223,30 @@ static void _requestUnrelayedTxGetdataDone(void *info, int success)
         for (size_t i = txCount; i > 0; i--) {
             hash = tx[i - 1]->txHash;
             isPublishing = 0;
+            pthread_mutex_lock(&manager->txLock);
             
             for (size_t j = array_count(manager->publishedTx); ! isPublishing && j > 0; j--) {
                 if (BRTransactionEq(manager->publishedTx[j - 1].tx, tx[i - 1]) &&
                     manager->publishedTx[j - 1].callback != NULL) isPublishing = 1;
             }
+
+            relayCount = _BRTxPeerListCount(manager->txRelays, hash);
+            requestCount = _BRTxPeerListCount(manager->txRequests, hash);
+            pthread_mutex_unlock(&manager->txLock);
             
-            if (! isPublishing && _BRTxPeerListCount(manager->txRelays, hash) == 0 &&
-                _BRTxPeerListCount(manager->txRequests, hash) == 0) {
+            if (! isPublishing && relayCount == 0 && requestCount == 0) {
                 peer_log(peer, "removing tx unconfirmed at: %d, txHash: %s", manager->lastBlock->height, u256hex(hash));
                 assert(tx[i - 1]->blockHeight == TX_UNCONFIRMED);
                 BRWalletRemoveTransaction(manager->wallet, hash);
             }
-            else if (! isPublishing && _BRTxPeerListCount(manager->txRelays, hash) < manager->maxConnectCount) {
+            else if (! isPublishing && relayCount < manager->maxConnectCount) {
                 // set timestamp 0 to mark as unverified
                 BRWalletUpdateTransactions(manager->wallet, &hash, 1, TX_UNCONFIRMED, 0);
             }
         }
     }
 
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
 }
 
 static void _BRPeerManagerRequestUnrelayedTx(BRPeerManager *manager, BRPeer *peer)
@@ -510,16 +1257,20 @@ static void _BRPeerManagerRequestUnrelayedTx(BRPeerManager *manager, BRPeer *pee
     UInt256 txHashes[txCount];
     
     txCount = BRWalletTxUnconfirmedBefore(manager->wallet, tx, txCount, TX_UNCONFIRMED);
+    pthread_mutex_lock(&manager->txLock);
     
     for (size_t i = 0; i < txCount; i++) {
         if (! _BRTxPeerListHasPeer(manager->txRelays, tx[i]->txHash, peer) &&
             ! _BRTxPeerListHasPeer(manager->txRequests, tx[i]->txHash, peer)) {
             txHashes[hashCount++] = tx[i]->txHash;
-            _BRTxPeerListAddPeer(&manager->txRequests, tx[i]->txHash, peer);
+            _BRTxPeerListAddPeer(manager->txRequests, tx[i]->txHash, peer);
         }
     }
 
+    pthread_mutex_unlock(&manager->txLock);
+
     if (hashCount > 0) {
+        BRPeerBeginBatch(peer);
         BRPeerSendGetdata(peer, txHashes, hashCount, NULL, 0);
     
         if ((peer->flags & PEER_FLAG_SYNCED) == 0) {
@@ -529,19 +1280,29 @@ static void _BRPeerManagerRequestUnrelayedTx(BRPeerManager *manager, BRPeer *pee
             info->manager = manager;
             BRPeerSendPing(peer, info, _requestUnrelayedTxGetdataDone);
         }
+        
+        BRPeerEndBatch(peer);
     }
     else peer->flags |= PEER_FLAG_SYNCED;
 }
 
-static void _BRPeerManagerPublishPendingTx(BRPeerManager *manager, BRPeer *peer)
+// sends an inv for the pending tx to each of peers, the same inv message is shared by peers that know none of them
+static void _BRPeerManagerPublishPendingTx(BRPeerManager *manager, BRPeer *peers[], size_t peerCount)
 {
+    pthread_mutex_lock(&manager->txLock);
+
     for (size_t i = array_count(manager->publishedTx); i > 0; i--) {
         if (manager->publishedTx[i - 1].callback == NULL) continue;
-        BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // schedule publish timeout
+        
+        for (size_t j = 0; j < peerCount; j++) {
+            BRPeerScheduleDisconnect(peers[j], PROTOCOL_TIMEOUT); // schedule publish timeout
+        }
+        
         break;
     }
     
-    BRPeerSendInv(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes));
+    BRPeerSendInvToPeers(peers, peerCount, manager->publishedTxHashes, array_count(manager->publishedTxHashes));
+    pthread_mutex_unlock(&manager->txLock);
 }
 
 static void _mempoolDone(void *info, int success)
@@ -554,7 +1315,7 @@ static void _mempoolDone(void *info, int success)
     
     if (success) {
         peer_log(peer, "mempool request finished");
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(manager);
         if (manager->syncStartHeight > 0) {
             peer_log(peer, "sync succeeded");
             syncFinished = 1;
@@ -563,7 +1324,7 @@ static void _mempoolDone(void *info, int success)
 
         _BRPeerManagerRequestUnrelayedTx(manager, peer);
         BRPeerSendGetaddr(peer); // request a list of other bitcoin peers
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(manager);
         if (manager->txStatusUpdate) manager->txStatusUpdate(manager->info);
         if (syncFinished && manager->syncStopped) manager->syncStopped(manager->info, 0);
     }
@@ -575,12 +1336,14 @@ static void _loadBloomFilterDone(void *info, int success)
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
 
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     
     if (success) {
+        pthread_mutex_lock(&manager->txLock);
         BRPeerSendMempool(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes), info,
                           _mempoolDone);
-        pthread_mutex_unlock(&manager->lock);
+        pthread_mutex_unlock(&manager->txLock);
+        _BRPeerManagerUnlock(manager);
     }
     else {
         free(info);
@@ -588,10 +1351,10 @@ static void _loadBloomFilterDone(void *info, int success)
         if (peer == manager->downloadPeer) {
             peer_log(peer, "sync succeeded");
             _BRPeerManagerSyncStopped(manager);
-            pthread_mutex_unlock(&manager->lock);
+            _BRPeerManagerUnlock(manager);
             if (manager->syncStopped) manager->syncStopped(manager->info, 0);
         }
-        else pthread_mutex_unlock(&manager->lock);
+        else _BRPeerManagerUnlock(manager);
     }
 }
 
@@ -609,13 +1372,51 @@ static void _BRPeerManagerLoadMempools(BRPeerManager *manager)
         info->manager = manager;
         
         if (peer != manager->downloadPeer || manager->fpRate > BLOOM_REDUCED_FALSEPOSITIVE_RATE*5.0) {
+            BRPeerBeginBatch(peer);
             _BRPeerManagerLoadBloomFilter(manager, peer);
-            _BRPeerManagerPublishPendingTx(manager, peer);
+            _BRPeerManagerPublishPendingTx(manager, &peer, 1);
             BRPeerSendPing(peer, info, _loadBloomFilterDone); // load mempool after updating bloomfilter
+            BRPeerEndBatch(peer);
+        }
+        else {
+            pthread_mutex_lock(&manager->txLock);
+            BRPeerSendMempool(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes), info,
+                              _mempoolDone);
+            pthread_mutex_unlock(&manager->txLock);
+        }
+    }
+}
+
+// once the header chain is downloaded during a headers first sync, requests filtered blocks from all connected peers,
+// returns true if there are none left to download
+static int _BRPeerManagerDownloadFiltered(BRPeerManager *manager)
+{
+    int loadFilters = ! manager->downloadFiltered;
+
+    if (manager->downloadNext == array_count(manager->downloadRequests)) {
+        _BRPeerManagerDownloadStop(manager);
+        return 1;
+    }
+
+    if (loadFilters) peer_log(manager->downloadPeer, "downloading %zu filtered blocks from %zu peer(s)",
+                              array_count(manager->downloadRequests) - manager->downloadNext,
+                              array_count(manager->connectedPeers));
+    manager->downloadFiltered = 1;
+
+    for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
+        BRPeer *peer = manager->connectedPeers[i - 1];
+
+        if (BRPeerConnectStatus(peer) != BRPeerStatusConnected || (peer->flags & PEER_FLAG_DOWNLOADING)) continue;
+
+        if (loadFilters && peer != manager->downloadPeer) { // only the download peer has a filter while syncing
+            _BRPeerManagerLoadBloomFilter(manager, peer);
+            _BRPeerManagerPublishPendingTx(manager, &peer, 1);
         }
-        else BRPeerSendMempool(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes), info,
-                               _mempoolDone);
+
+        _BRPeerManagerRequestBlocks(manager, peer);
     }
+
+    return 0;
 }
 
 // returns a UINT128_ZERO terminated array of addresses for hostname that must be freed, or NULL if lookup failed
@@ -647,74 +1448,188 @@ static UInt128 *_addressLookup(const char *hostname)
     return addrList;
 }
 
-static void *_findPeersThreadRoutine(void *arg)
+typedef struct {
+    char *hostname;
+    UInt128 *addrList; // UINT128_ZERO terminated result of the last lookup, NULL if it failed or hasn't finished
+    time_t expires; // when the result should be looked up again
+    int state; // 0: idle, 1: queued, 2: resolving
+} BRDNSLookup;
+
+// dns seed lookups are shared by all peer managers in the process, and run on a small pool of resolver threads that
+// never touch a manager, so a slow seed doesn't hold up connecting to the peers returned by the others
+static pthread_mutex_t _dnsLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _dnsCond = PTHREAD_COND_INITIALIZER; // broadcast whenever a lookup finishes
+static BRDNSLookup *_dnsLookups = NULL;
+static size_t _dnsThreadCount = 0;
+
+// must be called with _dnsLock held
+static BRDNSLookup *_dnsLookupFind(const char *hostname)
 {
-    BRPeerManager *manager = ((BRFindPeersInfo *)arg)->manager;
-    uint64_t services = ((BRFindPeersInfo *)arg)->services;
-    UInt128 *addrList, *addr;
-    time_t now = time(NULL), age;
-    
-    pthread_cleanup_push(manager->threadCleanup, manager->info);
-    addrList = _addressLookup(((BRFindPeersInfo *)arg)->hostname);
-    free(arg);
-    pthread_mutex_lock(&manager->lock);
-    
-    for (addr = addrList; addr && ! UInt128IsZero(*addr); addr++) {
-        age = 24*60*60 + BRRand(2*24*60*60); // add between 1 and 3 days
-        array_add(manager->peers, ((const BRPeer) { *addr, manager->params->standardPort, services, now - age, 0 }));
+    for (size_t i = 0; _dnsLookups && i < array_count(_dnsLookups); i++) {
+        if (strcmp(_dnsLookups[i].hostname, hostname) == 0) return &_dnsLookups[i];
     }
 
-    manager->dnsThreadCount--;
-    pthread_mutex_unlock(&manager->lock);
-    if (addrList) free(addrList);
-    pthread_cleanup_pop(1);
     return NULL;
 }
 
+static void *_dnsThreadRoutine(void *arg)
+{
+    BRDNSLookup *lookup;
+    UInt128 *addrList;
+    char *hostname;
+    size_t i;
+
+    pthread_mutex_lock(&_dnsLock);
+
+    for (;;) {
+        for (i = 0; i < array_count(_dnsLookups) && _dnsLookups[i].state != 1; i++);
+        if (i == array_count(_dnsLookups)) break; // nothing left to resolve, let the thread exit
+        _dnsLookups[i].state = 2;
+        hostname = _dnsLookups[i].hostname; // hostnames are never freed, so this stays valid while unlocked
+        pthread_mutex_unlock(&_dnsLock);
+        addrList = _addressLookup(hostname);
+        pthread_mutex_lock(&_dnsLock);
+        lookup = _dnsLookupFind(hostname); // the lookup array may have been resized while unlocked
+
+        if (addrList || ! lookup->addrList) { // on failure, keep serving the last good result
+            if (lookup->addrList) free(lookup->addrList);
+            lookup->addrList = addrList;
+        }
+
+        lookup->expires = time(NULL) + (addrList ? DNS_CACHE_TTL : DNS_FAILURE_TTL);
+        lookup->state = 0;
+        pthread_cond_broadcast(&_dnsCond);
+    }
+
+    _dnsThreadCount--;
+    pthread_cond_broadcast(&_dnsCond);
+    pthread_mutex_unlock(&_dnsLock);
+    return NULL;
+}
+
+// queues a lookup of hostname if there's no cached result or it has expired, must be called with _dnsLock held
+static void _dnsLookupQueue(const char *hostname, time_t now)
+{
+    BRDNSLookup *lookup = _dnsLookupFind(hostname);
+    pthread_t thread;
+    pthread_attr_t attr;
+
+    if (! _dnsLookups) array_new(_dnsLookups, 10);
+
+    if (! lookup) {
+        array_add(_dnsLookups, ((const BRDNSLookup) { strdup(hostname), NULL, 0, 0 }));
+        lookup = &_dnsLookups[array_count(_dnsLookups) - 1];
+        assert(lookup->hostname != NULL);
+    }
+
+    if (lookup->state == 0 && lookup->expires <= now) lookup->state = 1;
+
+    if (lookup->state == 1 && _dnsThreadCount < DNS_MAX_THREADS) {
+        if (pthread_attr_init(&attr) == 0 && pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) == 0 &&
+            pthread_create(&thread, &attr, _dnsThreadRoutine, NULL) == 0) _dnsThreadCount++;
+        pthread_attr_destroy(&attr);
+    }
+
+    if (lookup->state == 1 && _dnsThreadCount == 0) { // couldn't start a resolver, treat it as a failed lookup
+        lookup->expires = now + DNS_FAILURE_TTL;
+        lookup->state = 0;
+    }
+}
+
 // DNS peer discovery
 static void _BRPeerManagerFindPeers(BRPeerManager *manager)
 {
     uint64_t services = SERVICES_NODE_NETWORK | SERVICES_NODE_BLOOM | manager->params->services;
-    time_t now = time(NULL);
-    struct timespec ts;
-    pthread_t thread;
-    pthread_attr_t attr;
+    const char * const *seeds = manager->params->dnsSeeds;
+    time_t now = time(NULL), age;
+    BRDNSLookup *lookup;
     UInt128 *addr, *addrList;
-    BRFindPeersInfo *info;
+    size_t i, seedCount, addedCount = 0, peersCount;
     
     if (! UInt128IsZero(manager->fixedPeer.address)) {
+        pthread_mutex_lock(&manager->peersLock);
         array_set_count(manager->peers, 1);
         manager->peers[0] = manager->fixedPeer;
         manager->peers[0].services = services;
         manager->peers[0].timestamp = now;
+        pthread_mutex_unlock(&manager->peersLock);
     }
     else {
-        for (size_t i = 1; manager->params->dnsSeeds[i]; i++) {
-            info = calloc(1, sizeof(BRFindPeersInfo));
-            assert(info != NULL);
-            info->manager = manager;
-            info->hostname = manager->params->dnsSeeds[i];
-            info->services = services;
-            if (pthread_attr_init(&attr) == 0 && pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) == 0 &&
-                pthread_create(&thread, &attr, _findPeersThreadRoutine, info) == 0) manager->dnsThreadCount++;
-            else free (info);
-        }
+        for (seedCount = 0; seeds[seedCount]; seedCount++);
 
-        for (addr = addrList = _addressLookup(manager->params->dnsSeeds[0]); addr && ! UInt128IsZero(*addr); addr++) {
-            array_add(manager->peers, ((const BRPeer) { *addr, manager->params->standardPort, services, now, 0 }));
-        }
+        char added[seedCount + 1]; // seeds whose results have been added to manager->peers
 
-        if (addrList) free(addrList);
-        ts.tv_sec = 0;
-        ts.tv_nsec = 1;
+        memset(added, 0, sizeof(added));
+        pthread_mutex_lock(&_dnsLock);
+        for (i = 0; i < seedCount; i++) _dnsLookupQueue(seeds[i], now);
 
         do {
-            pthread_mutex_unlock(&manager->lock);
-            nanosleep(&ts, NULL); // pthread_yield() isn't POSIX standard :(
-            pthread_mutex_lock(&manager->lock);
-        } while (manager->dnsThreadCount > 0 && array_count(manager->peers) < PEER_MAX_CONNECTIONS);
-    
+            for (i = 0; i < seedCount; i++) {
+                lookup = _dnsLookupFind(seeds[i]);
+                if (added[i] || (! lookup->addrList && lookup->state != 0)) continue; // still waiting on the lookup
+                added[i] = 1, addedCount++; // a stale cached result is used right away while it's being refreshed
+
+                for (addr = lookup->addrList, peersCount = 0; addr && ! UInt128IsZero(*addr); addr++) peersCount++;
+                addrList = (peersCount > 0) ? malloc(peersCount*sizeof(*addrList)) : NULL;
+                assert(addrList != NULL || peersCount == 0);
+                if (addrList) memcpy(addrList, lookup->addrList, peersCount*sizeof(*addrList));
+                pthread_mutex_unlock(&_dnsLock);
+                pthread_mutex_lock(&manager->peersLock);
+
+                for (size_t j = 0; j < peersCount; j++) { // peers from all but the first seed are 1-3 days old
+                    age = (i == 0) ? 0 : 24*60*60 + BRRand(2*24*60*60);
+                    array_add(manager->peers,
+                              ((const BRPeer) { addrList[j], manager->params->standardPort, services, now - age, 0 }));
+                }
+
+                pthread_mutex_unlock(&manager->peersLock);
+                if (addrList) free(addrList);
+                pthread_mutex_lock(&_dnsLock);
+            }
+
+            pthread_mutex_lock(&manager->peersLock);
+            peersCount = array_count(manager->peers);
+            pthread_mutex_unlock(&manager->peersLock);
+            if (addedCount == seedCount || peersCount >= PEER_MAX_CONNECTIONS) break;
+            _BRPeerManagerUnlock(manager);
+            pthread_cond_wait(&_dnsCond, &_dnsLock);
+            pthread_mutex_unlock(&_dnsLock); // reacquire in the same order as everywhere else
+            _BRPeerManagerLock(manager);
+            pthread_mutex_lock(&_dnsLock);
+        } while (1);
+
+        pthread_mutex_unlock(&_dnsLock);
+        pthread_mutex_lock(&manager->peersLock);
         qsort(manager->peers, array_count(manager->peers), sizeof(*manager->peers), _peerTimestampCompare);
+        pthread_mutex_unlock(&manager->peersLock);
+    }
+}
+
+// returns the number of connected peers that completed their handshake, other than peer
+static size_t _BRPeerManagerHandshakeCount(BRPeerManager *manager, const BRPeer *peer)
+{
+    size_t count = 0;
+
+    for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
+        BRPeer *p = manager->connectedPeers[i - 1];
+
+        if (p != peer && BRPeerConnectStatus(p) == BRPeerStatusConnected) count++;
+    }
+
+    return count;
+}
+
+// once maxConnectCount peers have completed their handshake, cancels the rest of the peers racing to connect
+static void _BRPeerManagerCancelRacers(BRPeerManager *manager)
+{
+    if (_BRPeerManagerHandshakeCount(manager, NULL) < manager->maxConnectCount) return;
+
+    for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
+        BRPeer *p = manager->connectedPeers[i - 1];
+
+        if (BRPeerConnectStatus(p) != BRPeerStatusConnecting) continue;
+        p->flags |= PEER_FLAG_CANCELED;
+        BRPeerDisconnect(p);
     }
 }
 
@@ -725,11 +1640,17 @@ static void _peerConnected(void *info)
     BRPeerCallbackInfo *peerInfo;
     time_t now = time(NULL);
     
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     if (peer->timestamp > now + 2*60*60 || peer->timestamp < now - 2*60*60) peer->timestamp = now; // sanity check
+    _BRPeerManagerRecordPeerStats(manager, peer); // the ping time was measured during the version handshake
     
     // TODO: XXX does this work with 0.11 pruned nodes?
-    if ((peer->services & manager->params->services) != manager->params->services) {
+    if (_BRPeerManagerHandshakeCount(manager, peer) >= manager->maxConnectCount) {
+        peer_log(peer, "connection race lost");
+        peer->flags |= PEER_FLAG_CANCELED;
+        BRPeerDisconnect(peer);
+    }
+    else if ((peer->services & manager->params->services) != manager->params->services) {
         peer_log(peer, "unsupported node type");
         BRPeerDisconnect(peer);
     }
@@ -748,26 +1669,35 @@ static void _peerConnected(void *info)
     else if (manager->downloadPeer && // check if we should stick with the existing download peer
              (BRPeerLastBlock(manager->downloadPeer) >= BRPeerLastBlock(peer) ||
               manager->lastBlock->height >= BRPeerLastBlock(peer))) {
-        if (manager->lastBlock->height >= BRPeerLastBlock(peer)) { // only load bloom filter if we're done syncing
+        if (manager->downloadFiltered) { // help download filtered blocks
+            _BRPeerManagerLoadBloomFilter(manager, peer);
+            _BRPeerManagerPublishPendingTx(manager, &peer, 1);
+            _BRPeerManagerRequestBlocks(manager, peer);
+        }
+        else if (manager->lastBlock->height >= BRPeerLastBlock(peer)) { // only load bloom filter if we're done syncing
             manager->connectFailureCount = 0; // also reset connect failure count if we're already synced
+            BRPeerBeginBatch(peer);
             _BRPeerManagerLoadBloomFilter(manager, peer);
-            _BRPeerManagerPublishPendingTx(manager, peer);
+            _BRPeerManagerPublishPendingTx(manager, &peer, 1);
             peerInfo = calloc(1, sizeof(*peerInfo));
             assert(peerInfo != NULL);
             peerInfo->peer = peer;
             peerInfo->manager = manager;
             BRPeerSendPing(peer, peerInfo, _loadBloomFilterDone);
+            BRPeerEndBatch(peer);
         }
     }
     else { // select the peer with the lowest ping time to download the chain from if we're behind
         // BUG: XXX a malicious peer can report a higher lastblock to make us select them as the download peer, if
         // two peers agree on lastblock, use one of those two instead
+        // peers that delivered blocks faster during an earlier sync are preferred over a lower ping time
         for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
             BRPeer *p = manager->connectedPeers[i - 1];
             
             if (BRPeerConnectStatus(p) != BRPeerStatusConnected) continue;
-            if ((BRPeerPingTime(p) < BRPeerPingTime(peer) && BRPeerLastBlock(p) >= BRPeerLastBlock(peer)) ||
-                BRPeerLastBlock(p) > BRPeerLastBlock(peer)) peer = p;
+            if (((p->blockRate > 0 || peer->blockRate > 0) ? _peerIsFaster(p, peer) :
+                 BRPeerPingTime(p) < BRPeerPingTime(peer)) && BRPeerLastBlock(p) >= BRPeerLastBlock(peer)) peer = p;
+            else if (BRPeerLastBlock(p) > BRPeerLastBlock(peer)) peer = p;
         }
         
         if (manager->downloadPeer) {
@@ -778,9 +1708,11 @@ static void _peerConnected(void *info)
         manager->downloadPeer = peer;
         manager->isConnected = 1;
         manager->estimatedHeight = BRPeerLastBlock(peer);
+        manager->syncBlockCount = 0;
+        manager->syncBlockTime = time(NULL);
         _BRPeerManagerLoadBloomFilter(manager, peer);
         BRPeerSetCurrentBlockHeight(peer, manager->lastBlock->height);
-        _BRPeerManagerPublishPendingTx(manager, peer);
+        _BRPeerManagerPublishPendingTx(manager, &peer, 1);
             
         if (manager->lastBlock->height < BRPeerLastBlock(peer)) { // start blockchain sync
             UInt256 locators[_BRPeerManagerBlockLocators(manager, NULL, 0)];
@@ -788,62 +1720,80 @@ static void _peerConnected(void *info)
             
             BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // schedule sync timeout
 
+            // if far behind, sync headers first, and then download filtered blocks from all connected peers
+            if (manager->headersFirst || (manager->maxConnectCount > 1 && manager->lastBlock->height +
+                                          DOWNLOAD_REQUEST_COUNT < BRPeerLastBlock(peer))) {
+                manager->headersFirst = 1;
+                BRPeerSetHeadersFirst(peer, 1);
+                BRPeerSendGetheaders(peer, locators, count, UINT256_ZERO);
+            }
             // request just block headers up to a week before earliestKeyTime, and then merkleblocks after that
             // we do not reset connect failure count yet incase this request times out
-            if (manager->lastBlock->timestamp + 7*24*60*60 >= manager->earliestKeyTime) {
+            else if (manager->lastBlock->timestamp + 7*24*60*60 >= manager->earliestKeyTime) {
                 BRPeerSendGetblocks(peer, locators, count, UINT256_ZERO);
             }
             else BRPeerSendGetheaders(peer, locators, count, UINT256_ZERO);
         }
+        else if (manager->downloadFiltered) { // keep downloading filtered blocks
+            _BRPeerManagerRequestBlocks(manager, peer);
+        }
         else { // we're already synced
             manager->connectFailureCount = 0; // reset connect failure count
             _BRPeerManagerLoadMempools(manager);
         }
     }
 
-    pthread_mutex_unlock(&manager->lock);
+    if (BRPeerConnectStatus(peer) == BRPeerStatusConnected) _BRPeerManagerCancelRacers(manager);
+    _BRPeerManagerUnlock(manager);
 }
 
 static void _peerDisconnected(void *info, int error)
 {
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
-    BRTxPeerList *peerList;
     int willSave = 0, willReconnect = 0, txError = 0;
-    size_t txCount = 0;
+    size_t txCount = 0, pubTxCount;
     
     //free(info);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
+    if (peer->flags & PEER_FLAG_CANCELED) error = 0; // canceled after losing a connection race
+    pthread_mutex_lock(&manager->txLock);
+    pubTxCount = array_count(manager->publishedTx);
+    pthread_mutex_unlock(&manager->txLock);
 
-    BRPublishedTx pubTx[array_count(manager->publishedTx)];
+    BRPublishedTx pubTx[pubTxCount];
     
     if (error == EPROTO) { // if it's protocol error, the peer isn't following standard policy
         _BRPeerManagerPeerMisbehavin(manager, peer);
     }
     else if (error) { // timeout or some non-protocol related network error
+        pthread_mutex_lock(&manager->peersLock);
+
         for (size_t i = array_count(manager->peers); i > 0; i--) {
             if (BRPeerEq(&manager->peers[i - 1], peer)) array_rm(manager->peers, i - 1);
         }
         
+        pthread_mutex_unlock(&manager->peersLock);
         manager->connectFailureCount++;
         
         // if it's a timeout and there's pending tx publish callbacks, the tx publish timed out
         // BUG: XXX what if it's a connect timeout and not a publish timeout?
-        if (error == ETIMEDOUT && (peer != manager->downloadPeer || manager->syncStartHeight == 0 ||
-                                   array_count(manager->connectedPeers) == 1)) txError = ETIMEDOUT;
+        if (error == ETIMEDOUT && ((peer != manager->downloadPeer && (peer->flags & PEER_FLAG_DOWNLOADING) == 0) ||
+                                   manager->syncStartHeight == 0 || array_count(manager->connectedPeers) == 1)) {
+            txError = ETIMEDOUT;
+        }
     }
     
-    for (size_t i = array_count(manager->txRelays); i > 0; i--) {
-        peerList = &manager->txRelays[i - 1];
+    pthread_mutex_lock(&manager->txLock);
+    _BRTxPeerListRemovePeerAll(manager->txRelays, peer);
+    pthread_mutex_unlock(&manager->txLock);
 
-        for (size_t j = array_count(peerList->peers); j > 0; j--) {
-            if (BRPeerEq(&peerList->peers[j - 1], peer)) array_rm(peerList->peers, j - 1);
-        }
-    }
+    if (error != EPROTO) _BRPeerManagerRecordPeerStats(manager, peer); // misbehaving peers aren't kept
 
     if (peer == manager->downloadPeer) { // download peer disconnected
         manager->isConnected = 0;
         manager->downloadPeer = NULL;
+        _BRPeerManagerCommitWallet(manager);
         if (manager->connectFailureCount > MAX_CONNECT_FAILURES) manager->connectFailureCount = MAX_CONNECT_FAILURES;
     }
 
@@ -851,21 +1801,30 @@ static void _peerDisconnected(void *info, int error)
         _BRPeerManagerSyncStopped(manager);
         
         // clear out stored peers so we get a fresh list from DNS on next connect attempt
+        pthread_mutex_lock(&manager->peersLock);
         array_clear(manager->peers);
+        pthread_mutex_unlock(&manager->peersLock);
         txError = ENOTCONN; // trigger any pending tx publish callbacks
         willSave = 1;
         peer_log(peer, "sync failed");
     }
-    else if (manager->connectFailureCount < MAX_CONNECT_FAILURES) willReconnect = 1;
+    else if (manager->connectFailureCount < MAX_CONNECT_FAILURES && (peer->flags & PEER_FLAG_CANCELED) == 0) {
+        willReconnect = 1;
+    }
     
     if (txError) {
-        for (size_t i = array_count(manager->publishedTx); i > 0; i--) {
+        pthread_mutex_lock(&manager->txLock);
+
+        // tx published since pubTxCount was read are canceled by their own publish timeout
+        for (size_t i = pubTxCount; i > 0; i--) {
             if (manager->publishedTx[i - 1].callback == NULL) continue;
             peer_log(peer, "transaction canceled: %s", strerror(txError));
             pubTx[txCount++] = manager->publishedTx[i - 1];
             manager->publishedTx[i - 1].callback = NULL;
             manager->publishedTx[i - 1].info = NULL;
         }
+
+        pthread_mutex_unlock(&manager->txLock);
     }
     
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
@@ -874,8 +1833,18 @@ static void _peerDisconnected(void *info, int error)
         break;
     }
 
+    for (size_t i = array_count(manager->downloadRequests); i > 0; i--) { // release the peer's block requests
+        if (manager->downloadRequests[i - 1].peer == peer) manager->downloadRequests[i - 1].peer = NULL;
+    }
+
+    for (size_t i = array_count(manager->downloadPeers); i > 0; i--) {
+        if (manager->downloadPeers[i - 1].peer == peer) array_rm(manager->downloadPeers, i - 1);
+    }
+
+    if (manager->downloadFiltered) _BRPeerManagerDownloadFiltered(manager); // hand them to idle peers
+
     BRPeerFree(peer);
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
     
     for (size_t i = 0; i < txCount; i++) {
         pubTx[i].callback(pubTx[i].info, txError);
@@ -893,7 +1862,7 @@ static void _peerRelayedPeers(void *info, const BRPeer peers[], size_t peersCoun
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     time_t now = time(NULL);
 
-    pthread_mutex_lock(&manager->lock);
+    pthread_mutex_lock(&manager->peersLock);
     peer_log(peer, "relayed %zu peer(s)", peersCount);
 
     array_add_array(manager->peers, peers, peersCount);
@@ -910,7 +1879,7 @@ static void _peerRelayedPeers(void *info, const BRPeer peers[], size_t peersCoun
     BRPeer save[peersCount];
 
     for (size_t i = 0; i < peersCount; i++) save[i] = manager->peers[i];
-    pthread_mutex_unlock(&manager->lock);
+    pthread_mutex_unlock(&manager->peersLock);
     
     // peer relaying is complete when we receive <1000
     if (peersCount > 1 && peersCount < 1000 &&
@@ -923,11 +1892,13 @@ static void _peerRelayedTx(void *info, BRTransaction *tx)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     void *txInfo = NULL;
     void (*txCallback)(void *, int) = NULL;
-    int isWalletTx = 0, hasPendingCallbacks = 0;
+    int isWalletTx = 0, hasPendingCallbacks = 0, isSyncing, isSyncPeer, maxConnectCount;
     size_t relayCount = 0;
     
-    pthread_mutex_lock(&manager->lock);
+    // wallet and tx publish state are updated without the chain lock, so block processing doesn't hold up tx relay
+    isSyncing = _BRPeerManagerSyncState(manager, peer, &isSyncPeer, &maxConnectCount);
     peer_log(peer, "relayed tx: %s", u256hex(tx->txHash));
+    pthread_mutex_lock(&manager->txLock);
     
     for (size_t i = array_count(manager->publishedTx); i > 0; i--) { // see if tx is in list of published tx
         if (UInt256Eq(manager->publishedTxHashes[i - 1], tx->txHash)) {
@@ -935,17 +1906,39 @@ static void _peerRelayedTx(void *info, BRTransaction *tx)
             txCallback = manager->publishedTx[i - 1].callback;
             manager->publishedTx[i - 1].info = NULL;
             manager->publishedTx[i - 1].callback = NULL;
-            relayCount = _BRTxPeerListAddPeer(&manager->txRelays, tx->txHash, peer);
+            relayCount = _BRTxPeerListAddPeer(manager->txRelays, tx->txHash, peer);
         }
         else if (manager->publishedTx[i - 1].callback != NULL) hasPendingCallbacks = 1;
     }
 
-    // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this is not downloadPeer
-    if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
-        BRPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
+    pthread_mutex_unlock(&manager->txLock);
+
+    // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this peer isn't syncing
+    if (! hasPendingCallbacks && ! isSyncPeer) BRPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
+    _BRPeerManagerLock(manager);
+
+    size_t hostedCount = array_count(manager->wallets) - 1;
+    BRWallet *hosted[hostedCount + 1];
+
+    memcpy(hosted, &manager->wallets[1], hostedCount*sizeof(*hosted));
+    _BRPeerManagerUnlock(manager);
+
+    for (size_t i = 0; i < hostedCount; i++) { // other wallets hosted on the manager each get their own copy of tx
+        UInt160 pkhs[SEQUENCE_GAP_LIMIT_EXTERNAL + SEQUENCE_GAP_LIMIT_INTERNAL];
+        size_t count;
+        BRTransaction *t;
+
+        if (BRWalletTransactionForHash(hosted[i], tx->txHash) || ! BRWalletContainsTransaction(hosted[i], tx)) continue;
+        t = BRTransactionCopy(tx);
+        if (! BRWalletRegisterTransaction(hosted[i], t)) continue; // t is added, since the wallet contains it
+        count = BRWalletUnusedPKHs(hosted[i], pkhs, SEQUENCE_GAP_LIMIT_EXTERNAL, 0);
+        count += BRWalletUnusedPKHs(hosted[i], pkhs + count, SEQUENCE_GAP_LIMIT_INTERNAL, 1);
+        _BRPeerManagerLock(manager);
+        if (manager->bloomFilter) _BRPeerManagerAddToFilter(manager, hosted[i], t, pkhs, count);
+        _BRPeerManagerUnlock(manager);
     }
 
-    if (manager->syncStartHeight == 0 || BRWalletContainsTransaction(manager->wallet, tx)) {
+    if (! isSyncing || BRWalletContainsTransaction(manager->wallet, tx)) {
         isWalletTx = BRWalletRegisterTransaction(manager->wallet, tx);
         if (isWalletTx) tx = BRWalletTransactionForHash(manager->wallet, tx->txHash);
     }
@@ -955,10 +1948,11 @@ static void _peerRelayedTx(void *info, BRTransaction *tx)
     }
     
     if (tx && isWalletTx) {
-        // reschedule sync timeout
-        if (manager->syncStartHeight > 0 && peer == manager->downloadPeer) {
-            BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT);
-        }
+        UInt160 pkhs[SEQUENCE_GAP_LIMIT_EXTERNAL + SEQUENCE_GAP_LIMIT_INTERNAL];
+        size_t count;
+
+        if (isSyncPeer) BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // reschedule sync timeout
+        pthread_mutex_lock(&manager->txLock);
         
         if (BRWalletAmountSentByTx(manager->wallet, tx) > 0 && BRWalletTransactionIsValid(manager->wallet, tx)) {
             _BRPeerManagerAddTxToPublishList(manager, tx, NULL, NULL); // add valid send tx to mempool
@@ -966,51 +1960,80 @@ static void _peerRelayedTx(void *info, BRTransaction *tx)
 
         // keep track of how many peers have or relay a tx, this indicates how likely the tx is to confirm
         // (we only need to track this after syncing is complete)
-        if (manager->syncStartHeight == 0) relayCount = _BRTxPeerListAddPeer(&manager->txRelays, tx->txHash, peer);
+        if (! isSyncing) relayCount = _BRTxPeerListAddPeer(manager->txRelays, tx->txHash, peer);
         
         _BRTxPeerListRemovePeer(manager->txRequests, tx->txHash, peer);
-        
-        if (manager->bloomFilter != NULL) { // check if bloom filter is already being updated
-            BRAddress addrs[SEQUENCE_GAP_LIMIT_EXTERNAL + SEQUENCE_GAP_LIMIT_INTERNAL];
-            UInt160 hash;
-
-            // the transaction likely consumed one or more wallet addresses, so check that at least the next <gap limit>
-            // unused addresses are still matched by the bloom filter
-            BRWalletUnusedAddrs(manager->wallet, addrs, SEQUENCE_GAP_LIMIT_EXTERNAL, 0);
-            BRWalletUnusedAddrs(manager->wallet, addrs + SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_GAP_LIMIT_INTERNAL, 1);
-
-            for (size_t i = 0; i < SEQUENCE_GAP_LIMIT_EXTERNAL + SEQUENCE_GAP_LIMIT_INTERNAL; i++) {
-                if (! BRAddressHash160(&hash, addrs[i].s) ||
-                    BRBloomFilterContainsData(manager->bloomFilter, hash.u8, sizeof(hash))) continue;
-                if (manager->bloomFilter) BRBloomFilterFree(manager->bloomFilter);
-                manager->bloomFilter = NULL; // reset bloom filter so it's recreated with new wallet addresses
-                _BRPeerManagerUpdateFilter(manager);
-                break;
-            }
+        pthread_mutex_unlock(&manager->txLock);
+
+        // the transaction likely consumed one or more wallet addresses, so check that at least the next <gap limit>
+        // unused addresses are still matched by the bloom filter
+        count = BRWalletUnusedPKHs(manager->wallet, pkhs, SEQUENCE_GAP_LIMIT_EXTERNAL, 0);
+        count += BRWalletUnusedPKHs(manager->wallet, pkhs + count, SEQUENCE_GAP_LIMIT_INTERNAL, 1);
+        _BRPeerManagerLock(manager);
+
+        // skip the check if the bloom filter is already being updated
+        if (manager->bloomFilter) _BRPeerManagerAddToFilter(manager, manager->wallet, tx, pkhs, count);
+        _BRPeerManagerUnlock(manager);
+    }
+
+    // the fee is only known for txs that spend wallet outputs, so those are the txs fee estimates are learned from
+    if (tx && isWalletTx && ! isSyncing && tx->blockHeight == TX_UNCONFIRMED) {
+        uint64_t fee = BRWalletFeeForTx(manager->wallet, tx);
+        size_t size = BRTransactionVSize(tx);
+        uint32_t height;
+
+        if (fee != UINT64_MAX && size > 0) {
+            _BRPeerManagerLock(manager);
+            height = manager->lastBlock->height;
+            _BRPeerManagerUnlock(manager);
+            BRFeeEstimatorAddTx(manager->feeEstimator, tx->txHash, fee*1000/size, height);
         }
     }
     
     // set timestamp when tx is verified
-    if (tx && relayCount >= manager->maxConnectCount && tx->blockHeight == TX_UNCONFIRMED && tx->timestamp == 0) {
+    if (tx && relayCount >= maxConnectCount && tx->blockHeight == TX_UNCONFIRMED && tx->timestamp == 0) {
         BRWalletUpdateTransactions(manager->wallet, &tx->txHash, 1, TX_UNCONFIRMED, (uint32_t)time(NULL));
     }
     
-    pthread_mutex_unlock(&manager->lock);
     if (txCallback) txCallback(txInfo, 0);
 }
 
+// while syncing, only txs the wallet contains or that are being published are relayed, so any other tx can be
+// discarded before it's fully parsed
+static int _peerWantsTx(void *info, const BRTransactionView *view)
+{
+    BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
+    BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
+    int isSyncPeer, maxConnectCount, wanted = 0;
+    
+    if (! _BRPeerManagerSyncState(manager, peer, &isSyncPeer, &maxConnectCount)) return 1;
+    pthread_mutex_lock(&manager->txLock);
+    
+    for (size_t i = array_count(manager->publishedTxHashes); ! wanted && i > 0; i--) {
+        if (UInt256Eq(manager->publishedTxHashes[i - 1], view->txHash)) wanted = 1;
+    }
+    
+    pthread_mutex_unlock(&manager->txLock);
+    if (! wanted) wanted = BRWalletContainsTransactionView(manager->wallet, view);
+    
+    // cancel tx publish timeout if no publish callbacks are pending and this peer isn't syncing, as _peerRelayedTx does
+    if (! wanted && ! isSyncPeer && ! _BRPeerManagerHasPendingCallbacks(manager)) BRPeerScheduleDisconnect(peer, -1);
+    return wanted;
+}
+
 static void _peerHasTx(void *info, UInt256 txHash)
 {
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     BRTransaction *tx;
     BRPublishedTx pubTx = { NULL, NULL, NULL };
-    int isWalletTx = 0, hasPendingCallbacks = 0;
+    int isWalletTx = 0, hasPendingCallbacks = 0, isSyncing, isSyncPeer, maxConnectCount;
     size_t relayCount = 0;
     
-    pthread_mutex_lock(&manager->lock);
+    isSyncing = _BRPeerManagerSyncState(manager, peer, &isSyncPeer, &maxConnectCount);
     tx = BRWalletTransactionForHash(manager->wallet, txHash);
     peer_log(peer, "has tx: %s", u256hex(txHash));
+    pthread_mutex_lock(&manager->txLock);
 
     for (size_t i = array_count(manager->publishedTx); i > 0; i--) { // see if tx is in list of published tx
         if (UInt256Eq(manager->publishedTxHashes[i - 1], txHash)) {
@@ -1018,38 +2041,34 @@ static void _peerHasTx(void *info, UInt256 txHash)
             if (! tx) tx = pubTx.tx;
             manager->publishedTx[i - 1].callback = NULL;
             manager->publishedTx[i - 1].info = NULL;
-            relayCount = _BRTxPeerListAddPeer(&manager->txRelays, txHash, peer);
+            relayCount = _BRTxPeerListAddPeer(manager->txRelays, txHash, peer);
         }
         else if (manager->publishedTx[i - 1].callback != NULL) hasPendingCallbacks = 1;
     }
     
-    // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this is not downloadPeer
-    if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
-        BRPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
-    }
+    pthread_mutex_unlock(&manager->txLock);
+
+    // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this peer isn't syncing
+    if (! hasPendingCallbacks && ! isSyncPeer) BRPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
 
     if (tx) {
         isWalletTx = BRWalletRegisterTransaction(manager->wallet, tx);
         if (isWalletTx) tx = BRWalletTransactionForHash(manager->wallet, tx->txHash);
-
-        // reschedule sync timeout
-        if (manager->syncStartHeight > 0 && peer == manager->downloadPeer && isWalletTx) {
-            BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT);
-        }
+        if (isSyncPeer && isWalletTx) BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // reschedule sync timeout
+        pthread_mutex_lock(&manager->txLock);
         
         // keep track of how many peers have or relay a tx, this indicates how likely the tx is to confirm
         // (we only need to track this after syncing is complete)
-        if (manager->syncStartHeight == 0) relayCount = _BRTxPeerListAddPeer(&manager->txRelays, txHash, peer);
+        if (! isSyncing) relayCount = _BRTxPeerListAddPeer(manager->txRelays, txHash, peer);
+        _BRTxPeerListRemovePeer(manager->txRequests, txHash, peer);
+        pthread_mutex_unlock(&manager->txLock);
 
         // set timestamp when tx is verified
-        if (relayCount >= manager->maxConnectCount && tx && tx->blockHeight == TX_UNCONFIRMED && tx->timestamp == 0) {
+        if (relayCount >= maxConnectCount && tx && tx->blockHeight == TX_UNCONFIRMED && tx->timestamp == 0) {
             BRWalletUpdateTransactions(manager->wallet, &txHash, 1, TX_UNCONFIRMED, (uint32_t)time(NULL));
         }
-
-        _BRTxPeerListRemovePeer(manager->txRequests, txHash, peer);
     }
     
-    pthread_mutex_unlock(&manager->lock);
     if (pubTx.callback) pubTx.callback(pubTx.info, 0);
 }
 
@@ -1058,14 +2077,17 @@ static void _peerRejectedTx(void *info, UInt256 txHash, uint8_t code)
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     BRTransaction *tx, *t;
+    int wasRelayed;
 
-    pthread_mutex_lock(&manager->lock);
     peer_log(peer, "rejected tx: %s", u256hex(txHash));
     tx = BRWalletTransactionForHash(manager->wallet, txHash);
+    pthread_mutex_lock(&manager->txLock);
     _BRTxPeerListRemovePeer(manager->txRequests, txHash, peer);
+    wasRelayed = (tx && _BRTxPeerListRemovePeer(manager->txRelays, txHash, peer));
+    pthread_mutex_unlock(&manager->txLock);
 
     if (tx) {
-        if (_BRTxPeerListRemovePeer(manager->txRelays, txHash, peer) && tx->blockHeight == TX_UNCONFIRMED) {
+        if (wasRelayed && tx->blockHeight == TX_UNCONFIRMED) {
             // set timestamp 0 to mark tx as unverified
             BRWalletUpdateTransactions(manager->wallet, &txHash, 1, TX_UNCONFIRMED, 0);
         }
@@ -1083,40 +2105,49 @@ static void _peerRejectedTx(void *info, UInt256 txHash, uint8_t code)
         }
     }
 
-    pthread_mutex_unlock(&manager->lock);
     if (manager->txStatusUpdate) manager->txStatusUpdate(manager->info);
 }
 
-static int _BRPeerManagerVerifyBlock(BRPeerManager *manager, BRMerkleBlock *block, BRMerkleBlock *prev, BRPeer *peer)
+// returns the difficulty transition block before the transition block, and frees the blocks before that which aren't
+// transitions to save memory, or returns NULL if it's missing
+static BRMerkleBlock *_BRPeerManagerPruneBlocks(BRPeerManager *manager, const BRMerkleBlock *block)
 {
-    int r = 1;
+    BRMerkleBlock *b = (BRMerkleBlock *)block, *transition;
+    UInt256 prevBlock;
 
-    if (! prev || ! UInt256Eq(block->prevBlock, prev->blockHash) || block->height != prev->height + 1) r = 0;
+    for (uint32_t i = 0; b && i < BLOCK_DIFFICULTY_INTERVAL; i++) {
+        b = _BRBlockSetGet(manager->blocks, &b->prevBlock);
+    }
 
-    // check if we hit a difficulty transition, and find previous transition time
-    if (r && (block->height % BLOCK_DIFFICULTY_INTERVAL) == 0) {
-        BRMerkleBlock *b = block;
-        UInt256 prevBlock;
+    if (! b) return NULL;
+    transition = b;
+    prevBlock = b->prevBlock;
 
-        for (uint32_t i = 0; b && i < BLOCK_DIFFICULTY_INTERVAL; i++) {
-            b = BRSetGet(manager->blocks, &b->prevBlock);
-        }
+    while (b) { // free up some memory
+        b = _BRBlockSetGet(manager->blocks, &prevBlock);
+        if (b) prevBlock = b->prevBlock;
 
-        if (! b) {
-            peer_log(peer, "missing previous difficulty tansition, can't verify block: %s", u256hex(block->blockHash));
-            r = 0;
+        // keep the headers a headers first sync still needs to download filtered blocks for
+        if (b && (b->height % BLOCK_DIFFICULTY_INTERVAL) != 0 &&
+            (array_count(manager->downloadRequests) == 0 || b->height + 1 < manager->downloadStart)) {
+            _BRBlockSetRemove(manager->blocks, b);
+            BRMerkleBlockFree(b);
         }
-        else prevBlock = b->prevBlock;
+    }
 
-        while (b) { // free up some memory
-            b = BRSetGet(manager->blocks, &prevBlock);
-            if (b) prevBlock = b->prevBlock;
+    return transition;
+}
 
-            if (b && (b->height % BLOCK_DIFFICULTY_INTERVAL) != 0) {
-                BRSetRemove(manager->blocks, b);
-                BRMerkleBlockFree(b);
-            }
-        }
+static int _BRPeerManagerVerifyBlock(BRPeerManager *manager, BRMerkleBlock *block, BRMerkleBlock *prev, BRPeer *peer)
+{
+    int r = 1;
+
+    if (! prev || ! UInt256Eq(block->prevBlock, prev->blockHash) || block->height != prev->height + 1) r = 0;
+
+    // check if we hit a difficulty transition, and find previous transition time
+    if (r && (block->height % BLOCK_DIFFICULTY_INTERVAL) == 0 && ! _BRPeerManagerPruneBlocks(manager, block)) {
+        peer_log(peer, "missing previous difficulty tansition, can't verify block: %s", u256hex(block->blockHash));
+        r = 0;
     }
 
     // verify block difficulty
@@ -1127,12 +2158,12 @@ static int _BRPeerManagerVerifyBlock(BRPeerManager *manager, BRMerkleBlock *bloc
     }
     
     if (r) {
-        BRMerkleBlock *checkpoint = BRSetGet(manager->checkpoints, block);
+        UInt256 checkpoint = _BRPeerManagerCheckpointHash(manager, block->height);
 
         // verify blockchain checkpoints
-        if (checkpoint && ! BRMerkleBlockEq(block, checkpoint)) {
+        if (! UInt256IsZero(checkpoint) && ! UInt256Eq(block->blockHash, checkpoint)) {
             peer_log(peer, "relayed a block that differs from the checkpoint at height %"PRIu32", blockHash: %s, "
-                     "expected: %s", block->height, u256hex(block->blockHash), u256hex(checkpoint->blockHash));
+                     "expected: %s", block->height, u256hex(block->blockHash), u256hex(checkpoint));
             r = 0;
         }
     }
@@ -1140,6 +2171,57 @@ static int _BRPeerManagerVerifyBlock(BRPeerManager *manager, BRMerkleBlock *bloc
     return r;
 }
 
+// during a headers first sync, marks the filtered block at index j of those being downloaded as received, returns the
+// last of saveCount blocks that should then be saved, or NULL
+static BRMerkleBlock *_BRPeerManagerDownloadReceived(BRPeerManager *manager, BRPeer *peer, size_t j, size_t *saveCount)
+{
+    BRMerkleBlock *save = NULL;
+    uint32_t t = manager->downloadStart + (uint32_t)manager->downloadNext; // first height not yet downloaded through
+
+    manager->downloadRequests[j].received = 1;
+    if (peer->flags & PEER_FLAG_DOWNLOADING) BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT);
+
+    while (manager->downloadNext < array_count(manager->downloadRequests) &&
+           manager->downloadRequests[manager->downloadNext].received) manager->downloadNext++;
+
+    if (manager->downloadFiltered && manager->downloadNext == array_count(manager->downloadRequests)) {
+        save = manager->lastBlock; // filtered block download is complete
+        *saveCount = (save->height % BLOCK_DIFFICULTY_INTERVAL) + BLOCK_DIFFICULTY_INTERVAL + 1;
+        _BRPeerManagerDownloadStop(manager);
+        _BRPeerManagerLoadMempools(manager);
+    }
+    else { // save a transition block once all of the filtered blocks up to it are downloaded
+        t += BLOCK_DIFFICULTY_INTERVAL - 1;
+        t -= t % BLOCK_DIFFICULTY_INTERVAL;
+
+        if (t < manager->downloadStart + manager->downloadNext && t + 100 < manager->estimatedHeight) {
+            save = _BRBlockSetGet(manager->blocks, &manager->downloadRequests[t - manager->downloadStart].blockHash);
+            if (save) *saveCount = 1;
+        }
+    }
+
+    return save;
+}
+
+// saves up to saveCount blocks ending with block, starting at a difficulty interval
+static void _BRPeerManagerSaveBlocks(BRPeerManager *manager, BRMerkleBlock *block, size_t saveCount)
+{
+    BRMerkleBlock *saveBlocks[(saveCount > 0) ? saveCount : 1], *b;
+    size_t i, j;
+    
+    for (i = 0, b = block; b && i < saveCount; i++) {
+        assert(b->height != BLOCK_UNKNOWN_HEIGHT); // verify all blocks to be saved are in the chain
+        saveBlocks[i] = b;
+        b = _BRBlockSetGet(manager->blocks, &b->prevBlock);
+    }
+    
+    // make sure the set of blocks to be saved starts at a difficulty interval
+    j = (i > 0) ? saveBlocks[i - 1]->height % BLOCK_DIFFICULTY_INTERVAL : 0;
+    if (j > 0) i -= (i > BLOCK_DIFFICULTY_INTERVAL - j) ? BLOCK_DIFFICULTY_INTERVAL - j : i;
+    assert(i == 0 || (saveBlocks[i - 1]->height % BLOCK_DIFFICULTY_INTERVAL) == 0);
+    if (i > 0 && manager->saveBlocks) manager->saveBlocks(manager->info, (i > 1 ? 1 : 0), saveBlocks, i);
+}
+
 static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
 {
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
@@ -1147,23 +2229,34 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
     size_t txCount = BRMerkleBlockTxHashes(block, NULL, 0);
     UInt256 _txHashes[128], *txHashes = (txCount <= 128) ? _txHashes : malloc(txCount*sizeof(UInt256));
     size_t i, j, fpCount = 0, saveCount = 0;
-    BRMerkleBlock orphan, *b, *b2, *prev, *next = NULL;
-    uint32_t txTime = 0;
+    BRMerkleBlock orphan, *b, *b2, *prev, *next = NULL, *save = NULL;
+    uint32_t txTime = 0, joinHeight;
+    BR_TRACE_BEGIN(traceBegin);
     
     assert(txHashes != NULL);
     txCount = BRMerkleBlockTxHashes(block, txHashes, txCount);
-    pthread_mutex_lock(&manager->lock);
-    prev = BRSetGet(manager->blocks, &block->prevBlock);
+    _BRPeerManagerLock(manager);
+    prev = _BRBlockSetGet(manager->blocks, &block->prevBlock);
+
+    // while catching up with the chain, batch wallet updates so the wallet is re-sorted and its balance recalculated
+    // only when blocks are saved, instead of for every block with matched transactions
+    if (! manager->walletBatch && peer == manager->downloadPeer &&
+        manager->lastBlock->height + 1 < manager->estimatedHeight) {
+        for (i = 0; i < array_count(manager->wallets); i++) BRWalletBeginBatch(manager->wallets[i]);
+        manager->walletBatch = 1;
+    }
 
     if (prev) {
         txTime = block->timestamp/2 + prev->timestamp/2;
         block->height = prev->height + 1;
     }
     
-    // track the observed bloom filter false positive rate using a low pass filter to smooth out variance
-    if (peer == manager->downloadPeer && block->totalTx > 0) {
+    // track the observed bloom filter false positive rate using a low pass filter to smooth out variance (full blocks
+    // downloaded for matching compact filters have every tx)
+    if (peer == manager->downloadPeer && block->totalTx > 0 &&
+        ! (manager->downloadFiltered && _BRPeerManagerCompactFiltersPeer(manager, peer))) {
         for (i = 0; i < txCount; i++) { // wallet tx are not false-positives
-            if (! BRWalletTransactionForHash(manager->wallet, txHashes[i])) fpCount++;
+            if (! _BRPeerManagerHasTx(manager, txHashes[i])) fpCount++;
         }
         
         // moving average number of tx-per-block
@@ -1186,12 +2279,15 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
         }
     }
 
-    // ignore block headers that are newer than one week before earliestKeyTime (it's a header if it has 0 totalTx)
-    if (block->totalTx == 0 && block->timestamp + 7*24*60*60 > manager->earliestKeyTime + 2*60*60) {
+    // ignore block headers that are newer than one week before earliestKeyTime (it's a header if it has 0 totalTx),
+    // or when syncing headers first, headers we already have so they don't replace downloaded filtered blocks
+    if (block->totalTx == 0 && (manager->headersFirst ? _BRBlockSetContains(manager->blocks, block) :
+                                block->timestamp + 7*24*60*60 > manager->earliestKeyTime + 2*60*60)) {
         BRMerkleBlockFree(block);
         block = NULL;
     }
-    else if (manager->bloomFilter == NULL) { // ingore potentially incomplete blocks when a filter update is pending
+    // ingore potentially incomplete blocks when a filter update is pending (headers don't depend on the filter)
+    else if (manager->bloomFilter == NULL && (block->totalTx > 0 || ! manager->headersFirst)) {
         BRMerkleBlockFree(block);
         block = NULL;
 
@@ -1221,8 +2317,8 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
                 BRPeerSendGetblocks(peer, locators, locatorsCount, UINT256_ZERO);
             }
             
-            BRSetAdd(manager->orphans, block); // BUG: limit total orphans to avoid memory exhaustion attack
-            manager->lastOrphan = block;
+            if (_BRPeerManagerAddOrphan(manager, block)) manager->lastOrphan = block;
+            else block = NULL;
         }
     }
     else if (! _BRPeerManagerVerifyBlock(manager, block, prev, peer)) { // block is invalid
@@ -1236,9 +2332,12 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
             peer_log(peer, "adding block #%"PRIu32", false positive rate: %f", block->height, manager->fpRate);
         }
         
-        BRSetAdd(manager->blocks, block);
+        _BRBlockSetAdd(manager->blocks, block);
         manager->lastBlock = block;
-        if (txCount > 0) BRWalletUpdateTransactions(manager->wallet, txHashes, txCount, block->height, txTime);
+        if (peer == manager->downloadPeer) manager->syncBlockCount++;
+        if (manager->headersFirst) _BRPeerManagerDownloadAddBlock(manager, block);
+        if (txCount > 0) _BRPeerManagerUpdateTransactions(manager, txHashes, txCount, block->height, txTime);
+        BRFeeEstimatorAddBlock(manager->feeEstimator, block->height, txHashes, txCount);
         if (manager->downloadPeer) BRPeerSetCurrentBlockHeight(manager->downloadPeer, block->height);
             
         if (block->height < manager->estimatedHeight && peer == manager->downloadPeer) {
@@ -1246,42 +2345,57 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
             manager->connectFailureCount = 0; // reset failure count once we know our initial request didn't timeout
         }
         
-        if ((block->height % BLOCK_DIFFICULTY_INTERVAL) == 0 && block->height + 100 < manager->estimatedHeight) {
-            saveCount = 1; // save transition blocks immediately
+        // save transition blocks immediately, unless they're headers still waiting for their filtered blocks
+        if ((block->height % BLOCK_DIFFICULTY_INTERVAL) == 0 && block->height + 100 < manager->estimatedHeight &&
+            (! manager->headersFirst || array_count(manager->downloadRequests) == 0)) {
+            saveCount = 1;
         }
         
-        if (block->height == manager->estimatedHeight) { // chain download is complete
+        // chain download is complete, or if syncing headers first, the header chain is and filtered blocks are next
+        if (block->height == manager->estimatedHeight &&
+            (! manager->headersFirst || _BRPeerManagerDownloadFiltered(manager))) {
             saveCount = (block->height % BLOCK_DIFFICULTY_INTERVAL) + BLOCK_DIFFICULTY_INTERVAL + 1;
             _BRPeerManagerLoadMempools(manager);
         }
     }
-    else if (BRSetContains(manager->blocks, block)) { // we already have the block (or at least the header)
+    else if (_BRBlockSetContains(manager->blocks, block)) { // we already have the block (or at least the header)
         if ((block->height % 500) == 0 || txCount > 0 || block->height >= BRPeerLastBlock(peer)) {
             peer_log(peer, "relayed existing block #%"PRIu32, block->height);
         }
         
-        b = manager->lastBlock;
-        while (b && b->height > block->height) b = BRSetGet(manager->blocks, &b->prevBlock); // is block in main chain?
+        j = _BRPeerManagerDownloadIndex(manager, block);
+
+        if (j != SIZE_MAX) b = block; // filtered block for a main chain header, no need to walk back from lastBlock
+        else {
+            b = manager->lastBlock;
+            while (b && b->height > block->height) b = _BRBlockSetGet(manager->blocks, &b->prevBlock); // in main chain?
+        }
 
         assert (NULL != b);
         if (BRMerkleBlockEq(b, block)) { // if it's not on a fork, set block heights for its transactions
-            if (txCount > 0) BRWalletUpdateTransactions(manager->wallet, txHashes, txCount, block->height, txTime);
+            if (txCount > 0) _BRPeerManagerUpdateTransactions(manager, txHashes, txCount, block->height, txTime);
+            if (txCount > 0) BRFeeEstimatorAddBlock(manager->feeEstimator, block->height, txHashes, txCount);
             if (block->height == manager->lastBlock->height) manager->lastBlock = block;
         }
         
-        b = BRSetAdd(manager->blocks, block);
+        b = _BRBlockSetAdd(manager->blocks, block);
 
         if (b != block) {
-            if (BRSetGet(manager->orphans, b) == b) BRSetRemove(manager->orphans, b);
+            if (_BROrphanSetGet(manager->orphans, b) == b) _BRPeerManagerRemoveOrphan(manager, b);
             if (manager->lastOrphan == b) manager->lastOrphan = NULL;
             BRMerkleBlockFree(b);
         }
+
+        // blocks filtered before a pending filter update may be missing transactions, and are requested again
+        if (j != SIZE_MAX && (peer->flags & PEER_FLAG_NEEDSUPDATE) == 0 && ! manager->downloadRequests[j].received) {
+            save = _BRPeerManagerDownloadReceived(manager, peer, j, &saveCount);
+        }
     }
     else if (manager->lastBlock->height < BRPeerLastBlock(peer) &&
              block->height > manager->lastBlock->height + 1) { // special case, new block mined durring rescan
         peer_log(peer, "marking new block #%"PRIu32" as orphan until rescan completes", block->height);
-        BRSetAdd(manager->orphans, block); // mark as orphan til we're caught up
-        manager->lastOrphan = block;
+        if (_BRPeerManagerAddOrphan(manager, block)) manager->lastOrphan = block; // mark as orphan til we're caught up
+        else block = NULL;
     }
     else if (block->height <= manager->params->checkpoints[manager->params->checkpointsCount - 1].height) { // old fork
         peer_log(peer, "ignoring block on fork older than most recent checkpoint, block #%"PRIu32", hash: %s",
@@ -1291,7 +2405,7 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
     }
     else { // new block is on a fork
         peer_log(peer, "chain fork reached height %"PRIu32, block->height);
-        BRSetAdd(manager->blocks, block);
+        _BRBlockSetAdd(manager->blocks, block);
 
         // TODO: calculate chain work and use that instead of block height to determine longest chain
         if (block->height > manager->lastBlock->height) { // check if fork is now longer than main chain
@@ -1299,38 +2413,50 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
             b2 = manager->lastBlock;
             
             while (b && b2 && ! BRMerkleBlockEq(b, b2)) { // walk back to where the fork joins the main chain
-                b = BRSetGet(manager->blocks, &b->prevBlock);
-                if (b && b->height < b2->height) b2 = BRSetGet(manager->blocks, &b2->prevBlock);
+                b = _BRBlockSetGet(manager->blocks, &b->prevBlock);
+                if (b && b->height < b2->height) b2 = _BRBlockSetGet(manager->blocks, &b2->prevBlock);
             }
 
             assert (NULL != b);
             assert (NULL != block);
             peer_log(peer, "reorganizing chain from height %"PRIu32", new height is %"PRIu32, b->height, block->height);
-        
-            BRWalletSetTxUnconfirmedAfter(manager->wallet, b->height); // mark tx after the join point as unconfirmed
+            joinHeight = b->height;
+
+            UInt256 *reorgHashes;
+            uint32_t *reorgHeights, *reorgTimestamps;
 
+            array_new(reorgHashes, 100);
+            array_new(reorgHeights, 100);
+            array_new(reorgTimestamps, 100);
             b = block;
         
-            while (b && b2 && b->height > b2->height) { // set transaction heights for new main chain
-                size_t count = BRMerkleBlockTxHashes(b, NULL, 0);
+            while (b && b2 && b->height > b2->height) { // collect transaction heights for new main chain
+                size_t count = BRMerkleBlockTxHashes(b, NULL, 0), n = array_count(reorgHashes);
                 uint32_t height = b->height, timestamp = b->timestamp;
                 
-                if (count > txCount) {
-                    txHashes = (txHashes != _txHashes) ? realloc(txHashes, count*sizeof(*txHashes)) :
-                               malloc(count*sizeof(*txHashes));
-                    assert(txHashes != NULL);
-                    txCount = count;
-                }
-                
-                count = BRMerkleBlockTxHashes(b, txHashes, count);
-                b = BRSetGet(manager->blocks, &b->prevBlock);
+                array_set_count(reorgHashes, n + count);
+                count = BRMerkleBlockTxHashes(b, &reorgHashes[n], count);
+                array_set_count(reorgHashes, n + count);
+                b = _BRBlockSetGet(manager->blocks, &b->prevBlock);
                 if (b) timestamp = timestamp/2 + b->timestamp/2;
-                if (count > 0) BRWalletUpdateTransactions(manager->wallet, txHashes, count, height, timestamp);
+                for (i = 0; i < count; i++) array_add(reorgHeights, height);
+                for (i = 0; i < count; i++) array_add(reorgTimestamps, timestamp);
             }
-        
+
+            // mark tx after the join point as unconfirmed, and set heights for the new main chain, in one update
+            for (i = 0; i < array_count(manager->wallets); i++) {
+                BRWalletReorgTransactions(manager->wallets[i], joinHeight, reorgHashes, reorgHeights, reorgTimestamps,
+                                          array_count(reorgHashes));
+            }
+
+            array_free(reorgTimestamps);
+            array_free(reorgHeights);
+            array_free(reorgHashes);
             manager->lastBlock = block;
+            if (manager->headersFirst) _BRPeerManagerDownloadReorg(manager, joinHeight);
             
-            if (block->height == manager->estimatedHeight) { // chain download is complete
+            if (block->height == manager->estimatedHeight && // chain download is complete
+                (! manager->headersFirst || _BRPeerManagerDownloadFiltered(manager))) {
                 saveCount = (block->height % BLOCK_DIFFICULTY_INTERVAL) + BLOCK_DIFFICULTY_INTERVAL + 1;
                 _BRPeerManagerLoadMempools(manager);
             }
@@ -1344,46 +2470,72 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
         
         // check if the next block was received as an orphan
         orphan.prevBlock = block->blockHash;
-        next = BRSetRemove(manager->orphans, &orphan);
+        next = _BRPeerManagerRemoveOrphan(manager, &orphan);
     }
     
-    BRMerkleBlock *saveBlocks[saveCount];
-    
-    for (i = 0, b = block; b && i < saveCount; i++) {
-        assert(b->height != BLOCK_UNKNOWN_HEIGHT); // verify all blocks to be saved are in the chain
-        saveBlocks[i] = b;
-        b = BRSetGet(manager->blocks, &b->prevBlock);
-    }
-    
-    // make sure the set of blocks to be saved starts at a difficulty interval
-    j = (i > 0) ? saveBlocks[i - 1]->height % BLOCK_DIFFICULTY_INTERVAL : 0;
-    if (j > 0) i -= (i > BLOCK_DIFFICULTY_INTERVAL - j) ? BLOCK_DIFFICULTY_INTERVAL - j : i;
-    assert(i == 0 || (saveBlocks[i - 1]->height % BLOCK_DIFFICULTY_INTERVAL) == 0);
-    if (i > 0 && manager->saveBlocks) manager->saveBlocks(manager->info, (i > 1 ? 1 : 0), saveBlocks, i);
-    pthread_mutex_unlock(&manager->lock);
+    if (saveCount > 0 || manager->lastBlock->height >= manager->estimatedHeight) _BRPeerManagerCommitWallet(manager);
+    _BRPeerManagerSaveBlocks(manager, (save) ? save : block, saveCount);
+    _BRPeerManagerUnlock(manager);
     
     if (block && block->height != BLOCK_UNKNOWN_HEIGHT && block->height >= BRPeerLastBlock(peer) &&
         manager->txStatusUpdate) {
         manager->txStatusUpdate(manager->info); // notify that transaction confirmations may have changed
     }
     
+    BR_TRACE_END(BRTracePeerManagerMerkleblock, traceBegin, (block) ? block->height : BLOCK_UNKNOWN_HEIGHT);
     if (next) _peerRelayedBlock(info, next);
 }
 
+// copies of unconfirmed wallet tx, for reconstructing compact blocks, taken under the wallet lock since the wallet may
+// free its own at any time
+static size_t _peerKnownTx(void *info, BRTransaction *transactions[], size_t txCount)
+{
+    BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
+
+    return BRWalletTxUnconfirmedBeforeCopy(manager->wallet, transactions, txCount, TX_UNCONFIRMED);
+}
+
+static void _peerRelayedFilter(void *info, UInt256 blockHash, const uint8_t *filter, size_t filterLen)
+{
+    BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
+    BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
+    BRMerkleBlock *block, *save = NULL;
+    size_t j = SIZE_MAX, saveCount = 0;
+
+    _BRPeerManagerLock(manager);
+    block = _BRBlockSetGet(manager->blocks, &blockHash);
+    if (block) j = _BRPeerManagerDownloadIndex(manager, block);
+
+    // ignore filters for blocks not requested from peer, and while a filter update is pending
+    if (j != SIZE_MAX && manager->downloadRequests[j].peer == peer && ! manager->downloadRequests[j].received &&
+        ! manager->downloadRequests[j].matched && manager->bloomFilter && (peer->flags & PEER_FLAG_NEEDSUPDATE) == 0) {
+        if (_BRPeerManagerFilterMatch(manager, blockHash, filter, filterLen)) {
+            peer_log(peer, "compact filter matched block #%"PRIu32, block->height);
+            manager->downloadRequests[j].matched = 1;
+            BRPeerSendGetblockdata(peer, &blockHash, 1);
+        }
+        else save = _BRPeerManagerDownloadReceived(manager, peer, j, &saveCount);
+    }
+
+    if (saveCount > 0) _BRPeerManagerCommitWallet(manager);
+    _BRPeerManagerSaveBlocks(manager, save, saveCount);
+    _BRPeerManagerUnlock(manager);
+}
+
 static void _peerDataNotfound(void *info, const UInt256 txHashes[], size_t txCount,
                              const UInt256 blockHashes[], size_t blockCount)
 {
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
 
-    pthread_mutex_lock(&manager->lock);
+    pthread_mutex_lock(&manager->txLock);
 
     for (size_t i = 0; i < txCount; i++) {
         _BRTxPeerListRemovePeer(manager->txRelays, txHashes[i], peer);
         _BRTxPeerListRemovePeer(manager->txRequests, txHashes[i], peer);
     }
 
-    pthread_mutex_unlock(&manager->lock);
+    pthread_mutex_unlock(&manager->txLock);
 }
 
 static void _peerSetFeePerKb(void *info, uint64_t feePerKb)
@@ -1392,7 +2544,7 @@ static void _peerSetFeePerKb(void *info, uint64_t feePerKb)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     uint64_t maxFeePerKb = 0, secondFeePerKb = 0;
     
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) { // find second highest fee rate
         p = manager->connectedPeers[i - 1];
@@ -1406,7 +2558,7 @@ static void _peerSetFeePerKb(void *info, uint64_t feePerKb)
         BRWalletSetFeePerKb(manager->wallet, secondFeePerKb*3/2);
     }
 
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
 }
 
 static BRTransaction *_peerRequestedTx(void *info, UInt256 txHash)
@@ -1414,9 +2566,10 @@ static BRTransaction *_peerRequestedTx(void *info, UInt256 txHash)
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     BRPublishedTx pubTx = { NULL, NULL, NULL };
-    int hasPendingCallbacks = 0, error = 0;
+    int hasPendingCallbacks = 0, error = 0, isSyncPeer, maxConnectCount;
 
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerSyncState(manager, peer, &isSyncPeer, &maxConnectCount);
+    pthread_mutex_lock(&manager->txLock);
 
     for (size_t i = array_count(manager->publishedTx); i > 0; i--) {
         if (UInt256Eq(manager->publishedTxHashes[i - 1], txHash)) {
@@ -1427,15 +2580,14 @@ static BRTransaction *_peerRequestedTx(void *info, UInt256 txHash)
         else if (manager->publishedTx[i - 1].callback != NULL) hasPendingCallbacks = 1;
     }
 
-    // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this is not downloadPeer
-    if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
-        BRPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
-    }
+    _BRTxPeerListAddPeer(manager->txRelays, txHash, peer);
+    pthread_mutex_unlock(&manager->txLock);
+
+    // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this peer isn't syncing
+    if (! hasPendingCallbacks && ! isSyncPeer) BRPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
 
-    _BRTxPeerListAddPeer(&manager->txRelays, txHash, peer);
     if (pubTx.tx) BRWalletRegisterTransaction(manager->wallet, pubTx.tx);
     if (pubTx.tx && ! BRWalletTransactionIsValid(manager->wallet, pubTx.tx)) error = EINVAL;
-    pthread_mutex_unlock(&manager->lock);
     if (pubTx.callback) pubTx.callback(pubTx.info, error);
     return pubTx.tx;
 }
@@ -1452,9 +2604,9 @@ static void _peerThreadCleanup(void *info)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
 
     free(info);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     manager->peerThreadCount--;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
     if (manager->threadCleanup) manager->threadCleanup(manager->info);
 }
 
@@ -1478,15 +2630,19 @@ BRPeerManager *BRPeerManagerNew(const BRChainParams *params, BRWallet *wallet, u
     manager->params = params;
     manager->wallet = wallet;
     manager->earliestKeyTime = earliestKeyTime;
+    array_new(manager->wallets, 1);
+    array_add(manager->wallets, wallet);
+    array_new(manager->walletKeyTimes, 1);
+    array_add(manager->walletKeyTimes, earliestKeyTime);
     manager->averageTxPerBlock = 1400;
     manager->maxConnectCount = PEER_MAX_CONNECTIONS;
+    manager->feeEstimator = BRFeeEstimatorNew(MIN_FEE_PER_KB, MAX_FEE_PER_KB);
     array_new(manager->peers, peersCount);
     if (peers) array_add_array(manager->peers, peers, peersCount);
     qsort(manager->peers, array_count(manager->peers), sizeof(*manager->peers), _peerTimestampCompare);
     array_new(manager->connectedPeers, PEER_MAX_CONNECTIONS);
     manager->blocks = BRSetNew(BRMerkleBlockHash, BRMerkleBlockEq, blocksCount);
     manager->orphans = BRSetNew(_BRPrevBlockHash, _BRPrevBlockEq, blocksCount); // orphans are indexed by prevBlock
-    manager->checkpoints = BRSetNew(_BRBlockHeightHash, _BRBlockHeightEq, 100); // checkpoints are indexed by height
 
     for (size_t i = 0; i < manager->params->checkpointsCount; i++) {
         block = BRMerkleBlockNew();
@@ -1494,36 +2650,51 @@ BRPeerManager *BRPeerManagerNew(const BRChainParams *params, BRWallet *wallet, u
         block->blockHash = UInt256Reverse(manager->params->checkpoints[i].hash);
         block->timestamp = manager->params->checkpoints[i].timestamp;
         block->target = manager->params->checkpoints[i].target;
-        BRSetAdd(manager->checkpoints, block);
-        BRSetAdd(manager->blocks, block);
-        if (i == 0 || block->timestamp + 7*24*60*60 < manager->earliestKeyTime) manager->lastBlock = block;
+        _BRBlockSetAdd(manager->blocks, block);
     }
 
+    manager->lastBlock = _BRPeerManagerStartCheckpoint(manager);
+
     block = NULL;
     
     for (size_t i = 0; blocks && i < blocksCount; i++) {
         assert(blocks[i]->height != BLOCK_UNKNOWN_HEIGHT); // height must be saved/restored along with serialized block
-        BRSetAdd(manager->orphans, blocks[i]);
+        _BROrphanSetAdd(manager->orphans, blocks[i]);
 
         if ((blocks[i]->height % BLOCK_DIFFICULTY_INTERVAL) == 0 &&
             (! block || blocks[i]->height > block->height)) block = blocks[i]; // find last transition block
     }
     
     while (block) {
-        BRSetAdd(manager->blocks, block);
+        _BRBlockSetAdd(manager->blocks, block);
         manager->lastBlock = block;
         orphan.prevBlock = block->prevBlock;
-        BRSetRemove(manager->orphans, &orphan);
+        _BROrphanSetRemove(manager->orphans, &orphan);
         orphan.prevBlock = block->blockHash;
-        block = BRSetGet(manager->orphans, &orphan);
+        block = _BROrphanSetGet(manager->orphans, &orphan);
+    }
+
+    manager->orphanMaxCount = ORPHAN_MAX_COUNT;
+    manager->orphanMaxBytes = ORPHAN_MAX_BYTES;
+
+    for (block = BRSetIterate(manager->orphans, NULL); block; block = BRSetIterate(manager->orphans, block)) {
+        manager->orphanBytes += _BRPeerManagerOrphanSize(block); // saved blocks that didn't connect to the chain
     }
     
-    array_new(manager->txRelays, 10);
-    array_new(manager->txRequests, 10);
+    manager->txRelays = BRSetNew(BRTransactionHash, BRTransactionEq, 10);
+    manager->txRequests = BRSetNew(BRTransactionHash, BRTransactionEq, 10);
     array_new(manager->publishedTx, 10);
     array_new(manager->publishedTxHashes, 10);
+    array_new(manager->downloadRequests, 100);
+    array_new(manager->downloadPeers, PEER_MAX_CONNECTIONS);
+    array_new(manager->chainHashes, 0x1000);
+    array_new(manager->filterScripts, 0x1000);
+    array_new(manager->filterScriptLens, 100);
     pthread_mutex_init(&manager->lock, NULL);
+    pthread_mutex_init(&manager->txLock, NULL);
+    pthread_mutex_init(&manager->peersLock, NULL);
     manager->threadCleanup = _dummyThreadCleanup;
+    _BRPeerManagerPublish(manager);
     return manager;
 }
 
@@ -1564,44 +2735,194 @@ void BRPeerManagerSetFixedPeer(BRPeerManager *manager, UInt128 address, uint16_t
 {
     assert(manager != NULL);
     BRPeerManagerDisconnect(manager);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     manager->maxConnectCount = UInt128IsZero(address) ? PEER_MAX_CONNECTIONS : 1;
     manager->fixedPeer = ((const BRPeer) { address, port, 0, 0, 0 });
+    pthread_mutex_lock(&manager->peersLock);
     array_clear(manager->peers);
-    pthread_mutex_unlock(&manager->lock);
+    pthread_mutex_unlock(&manager->peersLock);
+    _BRPeerManagerUnlock(manager);
 }
 
-// current connect status
-BRPeerStatus BRPeerManagerConnectStatus(BRPeerManager *manager)
+// set eventLoop to true to service peer connections from a single shared event loop thread instead of one thread per
+// peer, takes effect for peers connected after the call
+void BRPeerManagerSetEventLoop(BRPeerManager *manager, int eventLoop)
 {
-    BRPeerStatus status = BRPeerStatusDisconnected;
-    
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
-    if (manager->isConnected != 0) status = BRPeerStatusConnected;
+    _BRPeerManagerLock(manager);
+    manager->eventLoop = eventLoop;
+    _BRPeerManagerUnlock(manager);
+}
 
-    for (size_t i = array_count(manager->connectedPeers); i > 0 && status == BRPeerStatusDisconnected; i--) {
-        if (BRPeerConnectStatus(manager->connectedPeers[i - 1]) == BRPeerStatusDisconnected) continue;
-        status = BRPeerStatusConnecting;
+// set compactFilters to true to download filtered blocks during a headers first sync by matching BIP157 compact block
+// filters locally, from peers that serve them, and to then fetch only the matching full blocks
+void BRPeerManagerSetCompactFilters(BRPeerManager *manager, int compactFilters)
+{
+    assert(manager != NULL);
+    _BRPeerManagerLock(manager);
+    manager->compactFilters = compactFilters;
+    _BRPeerManagerUnlock(manager);
+}
+
+// sets callbacks that return files to record each peer's traffic to, and to replay in place of connecting to it, for
+// peers connected after the call
+void BRPeerManagerSetTrafficFiles(BRPeerManager *manager, void *info,
+                                  FILE *(*recordFile)(void *info, const BRPeer *peer),
+                                  FILE *(*replayFile)(void *info, const BRPeer *peer))
+{
+    assert(manager != NULL);
+    _BRPeerManagerLock(manager);
+    manager->trafficInfo = info;
+    manager->recordFile = recordFile;
+    manager->replayFile = replayFile;
+    _BRPeerManagerUnlock(manager);
+}
+
+// adds a snapshot of consecutive 80 byte block headers, such as one bundled with the app, to the chain so that a new
+// wallet doesn't have to download them, the first header must follow a checkpoint or a block already in the chain,
+// and each header must connect to the previous one, have valid proof-of-work and difficulty, and match any checkpoint
+// at its height, as when received from a peer
+// headers less than a week older than earliestKeyTime are ignored, since their filtered blocks are still needed
+// returns the number of headers added, stopping at the first one that fails to verify
+// call after BRPeerManagerSetCallbacks() so the new chain is saved, and before BRPeerManagerConnect()
+size_t BRPeerManagerLoadHeaders(BRPeerManager *manager, const uint8_t *headers, size_t headersLen)
+{
+    BRMerkleBlock *blocks[HEADERS_BATCH_COUNT], *block, *prev = NULL;
+    UInt256 checkpoint;
+    size_t i, j, n, count = 0;
+    uint32_t now = (uint32_t)time(NULL);
+    int r = 1;
+
+    assert(manager != NULL);
+    assert(headers != NULL || headersLen == 0);
+    _BRPeerManagerLock(manager);
+
+    for (i = 0; r && i < headersLen/80; i += n) {
+        n = BRMerkleBlockParseHeaders(blocks, HEADERS_BATCH_COUNT, &headers[i*80], headersLen - i*80);
+
+        for (j = 0; j < n; j++) {
+            block = blocks[j];
+            prev = (r) ? _BRBlockSetGet(manager->blocks, &block->prevBlock) : NULL;
+            checkpoint = UINT256_ZERO;
+
+            if (prev) {
+                block->height = prev->height + 1;
+                checkpoint = _BRPeerManagerCheckpointHash(manager, block->height);
+            }
+
+            if (! prev || block->timestamp + 7*24*60*60 > manager->earliestKeyTime ||
+                ! BRMerkleBlockIsValid(block, now) ||
+                (! UInt256IsZero(checkpoint) && ! UInt256Eq(block->blockHash, checkpoint))) r = 0;
+            else if (_BRBlockSetContains(manager->blocks, block)) { // already in the chain, e.g. a checkpoint
+                BRMerkleBlockFree(block);
+                continue;
+            }
+            else if ((block->height % BLOCK_DIFFICULTY_INTERVAL) == 0 && ! _BRPeerManagerPruneBlocks(manager, block)) {
+                r = 0;
+            }
+            else if (! manager->params->verifyDifficulty(block, manager->blocks)) r = 0;
+
+            if (! r) {
+                BRMerkleBlockFree(block);
+                continue;
+            }
+
+            _BRBlockSetAdd(manager->blocks, block);
+            if (block->height > manager->lastBlock->height) manager->lastBlock = block;
+            count++;
+        }
     }
 
-    pthread_mutex_unlock(&manager->lock);
-    return status;
+    if (count > 0) {
+        _peer_log("loaded %zu snapshot headers, last block #%"PRIu32"\n", count, manager->lastBlock->height);
+        n = (manager->lastBlock->height % BLOCK_DIFFICULTY_INTERVAL) + BLOCK_DIFFICULTY_INTERVAL + 1;
+        _BRPeerManagerSaveBlocks(manager, manager->lastBlock, n);
+    }
+
+    _BRPeerManagerUnlock(manager);
+    return count;
+}
+
+// starts manager's chain from the last difficulty transition block that source has at or below forkHeight, such as for
+// a bitcoin cash manager from a bitcoin one, so the headers before the fork are only downloaded and verified once
+// both chains must follow the same rules up to forkHeight, since the shared block is trusted as a saved block would be
+// transitions less than a week older than earliestKeyTime are skipped, since their filtered blocks are still needed
+// returns true if manager's chain now starts from a shared block
+// call after BRPeerManagerSetCallbacks() so the new chain is saved, and before BRPeerManagerConnect()
+int BRPeerManagerShareBlocks(BRPeerManager *manager, BRPeerManager *source, uint32_t forkHeight)
+{
+    BRMerkleBlock *b, *block, *shared = NULL;
+    UInt256 checkpoint;
+    uint32_t height, earliestKeyTime;
+
+    assert(manager != NULL);
+    assert(source != NULL);
+    assert(manager != source);
+    _BRPeerManagerLock(manager);
+    height = manager->lastBlock->height;
+    earliestKeyTime = manager->earliestKeyTime;
+    _BRPeerManagerUnlock(manager);
+    _BRPeerManagerLock(source); // the managers are never both locked, so they can share blocks in either direction
+
+    // pruned chains keep every transition block
+    for (b = BRSetIterate(source->blocks, NULL); b; b = BRSetIterate(source->blocks, b)) {
+        if (b->height > forkHeight || b->height <= height || (b->height % BLOCK_DIFFICULTY_INTERVAL) != 0 ||
+            b->timestamp + 7*24*60*60 >= earliestKeyTime || (shared && shared->height >= b->height)) continue;
+        shared = b;
+    }
+
+    if (shared) shared = BRMerkleBlockCopy(shared);
+    _BRPeerManagerUnlock(source);
+    if (! shared) return 0;
+    _BRPeerManagerLock(manager);
+    checkpoint = _BRPeerManagerCheckpointHash(manager, shared->height);
+    block = _BRBlockSetGet(manager->blocks, shared);
+
+    if (! block && shared->height > manager->lastBlock->height && manager->downloadPeer == NULL &&
+        (UInt256IsZero(checkpoint) || UInt256Eq(shared->blockHash, checkpoint))) {
+        _BRBlockSetAdd(manager->blocks, shared);
+        manager->lastBlock = shared;
+        _peer_log("sharing block #%"PRIu32" of another chain\n", shared->height);
+        _BRPeerManagerSaveBlocks(manager, shared, 1);
+    }
+    else BRMerkleBlockFree(shared), shared = NULL;
+
+    _BRPeerManagerUnlock(manager);
+    return (shared != NULL);
+}
+
+// sets the most orphan blocks, and the most memory in bytes used by them, held while waiting for their previous blocks,
+// the oldest orphans are evicted first once either limit is exceeded
+void BRPeerManagerSetOrphanLimits(BRPeerManager *manager, size_t maxCount, size_t maxBytes)
+{
+    assert(manager != NULL);
+    assert(maxCount > 0);
+    _BRPeerManagerLock(manager);
+    manager->orphanMaxCount = maxCount;
+    manager->orphanMaxBytes = maxBytes;
+    _BRPeerManagerUnlock(manager);
+}
+
+// current connect status
+BRPeerStatus BRPeerManagerConnectStatus(BRPeerManager *manager)
+{
+    assert(manager != NULL);
+    return atomic_load_explicit(&manager->published.connectStatus, memory_order_relaxed); // never waits on lock
 }
 
 // connect to bitcoin peer-to-peer network (also call this whenever networkIsReachable() status changes)
 void BRPeerManagerConnect(BRPeerManager *manager)
 {
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     if (manager->connectFailureCount >= MAX_CONNECT_FAILURES) manager->connectFailureCount = 0; //this is a manual retry
     
     if ((! manager->downloadPeer || manager->lastBlock->height < manager->estimatedHeight) &&
         manager->syncStartHeight == 0) {
         manager->syncStartHeight = manager->lastBlock->height + 1;
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(manager);
         if (manager->syncStarted) manager->syncStarted(manager->info);
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(manager);
     }
     
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
@@ -1610,24 +2931,41 @@ void BRPeerManagerConnect(BRPeerManager *manager)
         if (BRPeerConnectStatus(p) == BRPeerStatusConnecting) BRPeerConnect(p);
     }
     
-    if (array_count(manager->connectedPeers) < manager->maxConnectCount) {
+    // until maxConnectCount peers finish their handshake, extra candidates race to connect, and the losers are canceled
+    size_t connectCount = manager->maxConnectCount;
+
+    if (connectCount > 0 && _BRPeerManagerHandshakeCount(manager, NULL) < connectCount) {
+        connectCount += CONNECT_RACE_EXTRA;
+    }
+
+    if (array_count(manager->connectedPeers) < connectCount) {
         time_t now = time(NULL);
         BRPeer *peers;
+        int findPeers;
 
-        if (array_count(manager->peers) < manager->maxConnectCount ||
-            manager->peers[manager->maxConnectCount - 1].timestamp + 3*24*60*60 < now) {
-            _BRPeerManagerFindPeers(manager);
-        }
+        pthread_mutex_lock(&manager->peersLock);
+        findPeers = (array_count(manager->peers) < manager->maxConnectCount ||
+                     manager->peers[manager->maxConnectCount - 1].timestamp + 3*24*60*60 < now);
+        pthread_mutex_unlock(&manager->peersLock);
+        if (findPeers) _BRPeerManagerFindPeers(manager);
         
         array_new(peers, 100);
+        pthread_mutex_lock(&manager->peersLock);
         array_add_array(peers, manager->peers,
                         (array_count(manager->peers) < 100) ? array_count(manager->peers) : 100);
+        pthread_mutex_unlock(&manager->peersLock);
 
-        while (array_count(peers) > 0 && array_count(manager->connectedPeers) < manager->maxConnectCount) {
+        while (array_count(peers) > 0 && array_count(manager->connectedPeers) < connectCount) {
             size_t i = BRRand((uint32_t)array_count(peers)); // index of random peer
             BRPeerCallbackInfo *info;
             
             i = i*i/array_count(peers); // bias random peer selection toward peers with more recent timestamp
+
+            // half the connections go to the fastest peers measured before, the rest stay random to find new ones
+            for (size_t j = 0; array_count(manager->connectedPeers) < manager->maxConnectCount/2 &&
+                 j < array_count(peers); j++) {
+                if (_peerIsFaster(&peers[j], &peers[i])) i = j;
+            }
         
             for (size_t j = array_count(manager->connectedPeers); i != SIZE_MAX && j > 0; j--) {
                 if (! BRPeerEq(&peers[i], manager->connectedPeers[j - 1])) continue;
@@ -1648,12 +2986,26 @@ void BRPeerManagerConnect(BRPeerManager *manager)
                                    _peerRelayedTx, _peerHasTx, _peerRejectedTx, _peerRelayedBlock, _peerDataNotfound,
                                    _peerSetFeePerKb, _peerRequestedTx, _peerNetworkIsReachable, _peerThreadCleanup);
                 BRPeerSetEarliestKeyTime(info->peer, manager->earliestKeyTime);
+                BRPeerSetEventLoop(info->peer, manager->eventLoop);
+                BRPeerSetCompactFilterCallback(info->peer, _peerRelayedFilter);
+                BRPeerSetCompactBlockCallback(info->peer, _peerKnownTx);
+                BRPeerSetTxRequestScope(info->peer, manager); // another manager's peers might relay the tx to it
+                BRPeerSetTxViewCallback(info->peer, _peerWantsTx);
+
+                if (manager->recordFile) {
+                    BRPeerSetRecorder(info->peer, manager->recordFile(manager->trafficInfo, info->peer));
+                }
+
+                if (manager->replayFile) {
+                    BRPeerSetReplay(info->peer, manager->replayFile(manager->trafficInfo, info->peer));
+                }
+
                 BRPeerConnect(info->peer);
 
                 if (BRPeerConnectStatus(info->peer) == BRPeerStatusDisconnected) {
-                    pthread_mutex_unlock(&manager->lock);
+                    _BRPeerManagerUnlock(manager);
                     _peerDisconnected(info, ENOTCONN);
-                    pthread_mutex_lock(&manager->lock);
+                    _BRPeerManagerLock(manager);
                     manager->peerThreadCount--;
                 }
             }
@@ -1664,20 +3016,20 @@ void BRPeerManagerConnect(BRPeerManager *manager)
     
     if (array_count(manager->connectedPeers) == 0) {
         _BRPeerManagerSyncStopped(manager);
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(manager);
         if (manager->syncStopped) manager->syncStopped(manager->info, ENETUNREACH);
     }
-    else pthread_mutex_unlock(&manager->lock);
+    else _BRPeerManagerUnlock(manager);
 }
 
 void BRPeerManagerDisconnect(BRPeerManager *manager)
 {
     struct timespec ts;
-    int peerThreadCount, dnsThreadCount, maxConnectCount;
+    int peerThreadCount, maxConnectCount;
     BRPeer *p;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
 
     // prevent new peers from being spawned
     maxConnectCount = manager->maxConnectCount;
@@ -1691,34 +3043,36 @@ void BRPeerManagerDisconnect(BRPeerManager *manager)
     }
 
     peerThreadCount = manager->peerThreadCount;
-    dnsThreadCount = manager->dnsThreadCount;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
     ts.tv_sec = 0;
     ts.tv_nsec = 1;
     
-    while (peerThreadCount > 0 || dnsThreadCount > 0) {
+    while (peerThreadCount > 0) {
         nanosleep(&ts, NULL); // pthread_yield() isn't POSIX standard :(
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(manager);
         peerThreadCount = manager->peerThreadCount;
-        dnsThreadCount = manager->dnsThreadCount;
-        pthread_mutex_unlock(&manager->lock);
+            _BRPeerManagerUnlock(manager);
     }
 
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     manager->maxConnectCount = maxConnectCount;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
 }
 
 static int _BRPeerManagerRescan(BRPeerManager *manager, BRMerkleBlock *newLastBlock) {
     if (NULL == newLastBlock) return 0;
 
+    if (manager->headersFirst) _BRPeerManagerDownloadStop(manager);
     manager->lastBlock = newLastBlock;
 
     if (manager->downloadPeer) { // disconnect the current download peer so a new random one will be selected
+        pthread_mutex_lock(&manager->peersLock);
+
         for (size_t i = array_count(manager->peers); i > 0; i--) {
             if (BRPeerEq(&manager->peers[i - 1], manager->downloadPeer)) array_rm(manager->peers, i - 1);
         }
 
+        pthread_mutex_unlock(&manager->peersLock);
         BRPeerDisconnect(manager->downloadPeer);
     }
 
@@ -1731,33 +3085,33 @@ static int _BRPeerManagerRescan(BRPeerManager *manager, BRMerkleBlock *newLastBl
 void BRPeerManagerRescan(BRPeerManager *manager)
 {
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     
     int needConnect = 0;
     if (manager->isConnected) {
-        BRMerkleBlock *newLastBlock = NULL;
-
         // start the chain download from the most recent checkpoint that's at least a week older than earliestKeyTime
-        for (size_t i = manager->params->checkpointsCount; i > 0; i--) {
-            if (i - 1 == 0 || manager->params->checkpoints[i - 1].timestamp + 7*24*60*60 < manager->earliestKeyTime) {
-                UInt256 hash = UInt256Reverse(manager->params->checkpoints[i - 1].hash);
-
-                newLastBlock = BRSetGet(manager->blocks, &hash);
-                break;
-            }
-        }
-
-        needConnect = _BRPeerManagerRescan(manager, newLastBlock);
+        needConnect = _BRPeerManagerRescan(manager, _BRPeerManagerStartCheckpoint(manager));
     }
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
     if (needConnect) BRPeerManagerConnect(manager);
 }
 
+// saves the main chain again with the saveBlocks() callback, replacing every block saved before, from the start of the
+// previous difficulty interval through the last block (for repairing a damaged block store without a rescan)
+void BRPeerManagerResaveBlocks(BRPeerManager *manager)
+{
+    assert(manager != NULL);
+    _BRPeerManagerLock(manager);
+    _BRPeerManagerSaveBlocks(manager, manager->lastBlock,
+                             (manager->lastBlock->height % BLOCK_DIFFICULTY_INTERVAL) + BLOCK_DIFFICULTY_INTERVAL + 1);
+    _BRPeerManagerUnlock(manager);
+}
+
 // rescans blocks and transactions after the last hardcoded checkpoint
 void BRPeerManagerRescanFromLastHardcodedCheckpoint(BRPeerManager *manager)
 {
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
 
     int needConnect = 0;
     if (manager->isConnected) {
@@ -1767,28 +3121,65 @@ void BRPeerManagerRescanFromLastHardcodedCheckpoint(BRPeerManager *manager)
             needConnect = _BRPeerManagerRescan(manager, BRSetGet (manager->blocks, &hash));
         }
     }
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
     if (needConnect) BRPeerManagerConnect(manager);
 }
 
+// brings the height indexed main chain block hashes up to date with lastBlock, walking back only to where the new
+// chain joins the indexed one
+static void _BRPeerManagerUpdateChainIndex(BRPeerManager *manager)
+{
+    BRMerkleBlock *b = manager->lastBlock;
+    uint32_t height = b->height;
+    size_t n = 0;
+
+    if (UInt256Eq(manager->chainTip, b->blockHash)) return;
+
+    if (array_count(manager->chainHashes) == 0 || b->height < manager->chainStart) { // index the whole chain
+        for (; b; b = _BRBlockSetGet(manager->blocks, &b->prevBlock)) n++;
+        manager->chainStart = manager->lastBlock->height + 1 - (uint32_t)n;
+        array_set_count(manager->chainHashes, n);
+        
+        for (b = manager->lastBlock; b; b = _BRBlockSetGet(manager->blocks, &b->prevBlock)) {
+            manager->chainHashes[b->height - manager->chainStart] = b->blockHash;
+        }
+    }
+    else {
+        array_set_count(manager->chainHashes, b->height + 1 - manager->chainStart);
+        
+        while (b && b->height >= manager->chainStart &&
+               ! UInt256Eq(manager->chainHashes[b->height - manager->chainStart], b->blockHash)) {
+            manager->chainHashes[b->height - manager->chainStart] = b->blockHash;
+            height = b->height;
+            b = _BRBlockSetGet(manager->blocks, &b->prevBlock);
+        }
+        
+        if (! b && height > manager->chainStart) { // new chain doesn't connect below height, drop stale hashes
+            array_rm_range(manager->chainHashes, 0, height - manager->chainStart);
+            manager->chainStart = height;
+        }
+    }
+    
+    manager->chainTip = manager->lastBlock->blockHash;
+}
+
 static BRMerkleBlock *_BRPeerManagerLookupBlockFromBlockNumber(BRPeerManager *manager, uint32_t blockNumber)
 {
-    BRMerkleBlock *block = manager->lastBlock;
+    BRMerkleBlock *block = NULL;
 
-    // walk the chain, looking for blockNumber
-    while (block) {
-        if (block->height == blockNumber) return block;
-        block = BRSetGet (manager->blocks, &block->prevBlock);
+    // look up blockNumber in the main chain index, pruned blocks are no longer in manager->blocks
+    _BRPeerManagerUpdateChainIndex(manager);
+    
+    if (blockNumber >= manager->chainStart && blockNumber - manager->chainStart < array_count(manager->chainHashes)) {
+        block = _BRBlockSetGet(manager->blocks, &manager->chainHashes[blockNumber - manager->chainStart]);
     }
+    
+    if (block) return block;
 
     // blockNumber not in the (abbreviated) chain - look through checkpoints
-    for (int i = 0; i < manager->params->checkpointsCount; i++)
-        if (manager->params->checkpoints[i].height == blockNumber) {
-            UInt256 hash = UInt256Reverse(manager->params->checkpoints[i].hash);
-            return BRSetGet(manager->blocks, &hash);
-        }
+    UInt256 hash = _BRPeerManagerCheckpointHash(manager, blockNumber);
 
-    return NULL;
+    return (UInt256IsZero(hash)) ? NULL : _BRBlockSetGet(manager->blocks, &hash);
 }
 
 // rescans blocks and transactions from after the blockNumber.  If blockNumber is not known, then
@@ -1796,7 +3187,7 @@ static BRMerkleBlock *_BRPeerManagerLookupBlockFromBlockNumber(BRPeerManager *ma
 void BRPeerManagerRescanFromBlockNumber(BRPeerManager *manager, uint32_t blockNumber)
 {
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
 
     int needConnect = 0;
     if (manager->isConnected) {
@@ -1804,56 +3195,123 @@ void BRPeerManagerRescanFromBlockNumber(BRPeerManager *manager, uint32_t blockNu
 
         // If there was no block, find the preceeding hardcoded checkpoint.
         if (NULL == block) {
-            for (size_t i = manager->params->checkpointsCount; i > 0; i--) {
-                if (i - 1 == 0 || manager->params->checkpoints[i - 1].height < blockNumber) {
-                    UInt256 hash = UInt256Reverse(manager->params->checkpoints[i - 1].hash);
-                    block = BRSetGet(manager->blocks, &hash);
-                    break;
-                }
-            }
+            UInt256 hash = UInt256Reverse(BRChainParamsCheckpointBeforeHeight(manager->params, blockNumber)->hash);
+            block = _BRBlockSetGet(manager->blocks, &hash);
         }
 
         needConnect = _BRPeerManagerRescan(manager, block);
     }
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
+    if (needConnect) BRPeerManagerConnect(manager);
+}
+
+// adds another wallet to be synced over the same peers and header chain as manager's own wallet, the bloom filter then
+// matches all the wallets, and each relayed or confirmed tx is added to or updated in every wallet that contains it
+// if blocks after earliestKeyTime were already synced without the wallet, they're downloaded again
+// the wallet's callbacks are called the same as for manager's own wallet, and it must be removed before it's freed
+void BRPeerManagerAddWallet(BRPeerManager *manager, BRWallet *wallet, uint32_t earliestKeyTime)
+{
+    BRMerkleBlock *block, *prev;
+    int needConnect = 0;
+
+    assert(manager != NULL);
+    assert(wallet != NULL);
+    _BRPeerManagerLock(manager);
+
+    for (size_t i = array_count(manager->wallets); i > 0; i--) {
+        if (manager->wallets[i - 1] != wallet) continue;
+        _BRPeerManagerUnlock(manager);
+        return;
+    }
+
+    array_add(manager->wallets, wallet);
+    array_add(manager->walletKeyTimes, earliestKeyTime);
+    if (earliestKeyTime < manager->earliestKeyTime) manager->earliestKeyTime = earliestKeyTime;
+    if (manager->walletBatch) BRWalletBeginBatch(wallet);
+
+    // walk back to the last block that's at least a week older than earliestKeyTime, blocks after it need to be
+    // downloaded again with the wallet in the filter
+    for (block = manager->lastBlock; block->timestamp + 7*24*60*60 >= earliestKeyTime; block = prev) {
+        prev = _BRBlockSetGet(manager->blocks, &block->prevBlock);
+        if (! prev) break;
+    }
+
+    if (manager->bloomFilter) BRBloomFilterFree(manager->bloomFilter);
+    manager->bloomFilter = NULL; // reset bloom filter so it's recreated with the new wallet's addresses
+
+    if (block != manager->lastBlock && manager->isConnected) {
+        _peer_log("rescanning from block #%"PRIu32" for added wallet\n", block->height);
+        needConnect = _BRPeerManagerRescan(manager, block);
+    }
+    else if (block != manager->lastBlock) manager->lastBlock = block;
+    else _BRPeerManagerUpdateFilter(manager);
+
+    _BRPeerManagerUnlock(manager);
     if (needConnect) BRPeerManagerConnect(manager);
 }
 
+// stops syncing a wallet added with BRPeerManagerAddWallet(), the manager's own wallet can't be removed
+void BRPeerManagerRemoveWallet(BRPeerManager *manager, BRWallet *wallet)
+{
+    size_t i;
+
+    assert(manager != NULL);
+    assert(wallet != NULL && wallet != manager->wallet);
+    _BRPeerManagerLock(manager);
+    for (i = array_count(manager->wallets); i > 1 && manager->wallets[i - 1] != wallet; i--);
+
+    if (i > 1) {
+        if (manager->walletBatch) BRWalletCommitBatch(wallet);
+        array_rm(manager->wallets, i - 1);
+        array_rm(manager->walletKeyTimes, i - 1);
+        manager->earliestKeyTime = manager->walletKeyTimes[0];
+
+        for (i = 1; i < array_count(manager->walletKeyTimes); i++) {
+            if (manager->walletKeyTimes[i] < manager->earliestKeyTime) {
+                manager->earliestKeyTime = manager->walletKeyTimes[i];
+            }
+        }
+
+        if (manager->bloomFilter) BRBloomFilterFree(manager->bloomFilter);
+        manager->bloomFilter = NULL; // reset bloom filter so it no longer matches the wallet's addresses
+        _BRPeerManagerUpdateFilter(manager);
+    }
+
+    _BRPeerManagerUnlock(manager);
+}
+
 // the (unverified) best block height reported by connected peers
 uint32_t BRPeerManagerEstimatedBlockHeight(BRPeerManager *manager)
 {
     uint32_t height;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     height = (manager->lastBlock->height < manager->estimatedHeight) ? manager->estimatedHeight :
              manager->lastBlock->height;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
     return height;
 }
 
 // current proof-of-work verified best block height
 uint32_t BRPeerManagerLastBlockHeight(BRPeerManager *manager)
 {
-    uint32_t height;
-    
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
-    height = manager->lastBlock->height;
-    pthread_mutex_unlock(&manager->lock);
-    return height;
+    return atomic_load_explicit(&manager->published.lastBlockHeight, memory_order_relaxed); // never waits on lock
 }
 
 // current proof-of-work verified best block timestamp (time interval since unix epoch)
 uint32_t BRPeerManagerLastBlockTimestamp(BRPeerManager *manager)
 {
-    uint32_t timestamp;
-    
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
-    timestamp = manager->lastBlock->timestamp;
-    pthread_mutex_unlock(&manager->lock);
-    return timestamp;
+    return atomic_load_explicit(&manager->published.lastBlockTimestamp, memory_order_relaxed); // never waits on lock
+}
+
+// fee per kb that wallet txs seen so far have needed to confirm within targetBlocks, or 0 if too few have been seen
+uint64_t BRPeerManagerEstimateFeePerKb(BRPeerManager *manager, uint32_t targetBlocks)
+{
+    assert(manager != NULL);
+    return BRFeeEstimatorEstimate(manager->feeEstimator, targetBlocks);
 }
 
 // current network sync progress from 0 to 1
@@ -1861,23 +3319,34 @@ uint32_t BRPeerManagerLastBlockTimestamp(BRPeerManager *manager)
 double BRPeerManagerSyncProgress(BRPeerManager *manager, uint32_t startHeight)
 {
     double progress;
+    uint32_t height, syncStartHeight, estimatedHeight;
+    int hasDownloadPeer;
+    unsigned seq;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
-    if (startHeight == 0) startHeight = manager->syncStartHeight;
+
+    do { // reads a consistent copy of the published state without waiting on lock, retrying if a write overlapped
+        seq = atomic_load_explicit(&manager->published.seq, memory_order_acquire);
+        height = atomic_load_explicit(&manager->published.downloadHeight, memory_order_relaxed);
+        syncStartHeight = atomic_load_explicit(&manager->published.syncStartHeight, memory_order_relaxed);
+        estimatedHeight = atomic_load_explicit(&manager->published.estimatedHeight, memory_order_relaxed);
+        hasDownloadPeer = atomic_load_explicit(&manager->published.hasDownloadPeer, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&manager->published.seq, memory_order_relaxed));
+
+    if (startHeight == 0) startHeight = syncStartHeight;
     
-    if (! manager->downloadPeer && manager->syncStartHeight == 0) {
+    if (! hasDownloadPeer && syncStartHeight == 0) {
         progress = 0.0;
     }
-    else if (! manager->downloadPeer || manager->lastBlock->height < manager->estimatedHeight) {
-        if (manager->lastBlock->height > startHeight && manager->estimatedHeight > startHeight) {
-            progress = 0.1 + 0.9*(manager->lastBlock->height - startHeight)/(manager->estimatedHeight - startHeight);
+    else if (! hasDownloadPeer || height < estimatedHeight) {
+        if (height > startHeight && estimatedHeight > startHeight) {
+            progress = 0.1 + 0.9*(height - startHeight)/(estimatedHeight - startHeight);
         }
         else progress = 0.05;
     }
     else progress = 1.0;
 
-    pthread_mutex_unlock(&manager->lock);
     return progress;
 }
 
@@ -1887,13 +3356,13 @@ size_t BRPeerManagerPeerCount(BRPeerManager *manager)
     size_t count = 0;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
         if (BRPeerConnectStatus(manager->connectedPeers[i - 1]) != BRPeerStatusDisconnected) count++;
     }
     
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
     return count;
 }
 
@@ -1901,14 +3370,14 @@ size_t BRPeerManagerPeerCount(BRPeerManager *manager)
 const char *BRPeerManagerDownloadPeerName(BRPeerManager *manager)
 {
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
 
     if (manager->downloadPeer) {
         sprintf(manager->downloadPeerName, "%s:%d", BRPeerHost(manager->downloadPeer), manager->downloadPeer->port);
     }
     else manager->downloadPeerName[0] = '\0';
     
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
     return manager->downloadPeerName;
 }
 
@@ -1918,9 +3387,9 @@ static void _publishTxInvDone(void *info, int success)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     
     free(info);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
     _BRPeerManagerRequestUnrelayedTx(manager, peer);
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(manager);
 }
 
 // publishes tx to bitcoin network (do not call BRTransactionFree() on tx afterward)
@@ -1929,55 +3398,65 @@ void BRPeerManagerPublishTx(BRPeerManager *manager, BRTransaction *tx, void *inf
 {
     assert(manager != NULL);
     assert(tx != NULL && BRTransactionIsSigned(tx));
-    if (tx) pthread_mutex_lock(&manager->lock);
+    if (tx) _BRPeerManagerLock(manager);
     
     if (tx && ! BRTransactionIsSigned(tx)) {
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(manager);
         if (callback) callback(info, EINVAL); // transaction not signed
         tx = NULL;
     }
     else if (tx && ! manager->isConnected) {
         int connectFailureCount = manager->connectFailureCount;
 
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(manager);
 
         if (connectFailureCount >= MAX_CONNECT_FAILURES ||
             (manager->networkIsReachable && ! manager->networkIsReachable(manager->info))) {
             if (callback) callback(info, ENOTCONN); // not connected to bitcoin network
             tx = NULL;
         }
-        else pthread_mutex_lock(&manager->lock);
+        else _BRPeerManagerLock(manager);
     }
     
     if (tx) {
         size_t i, count = 0;
         
         tx->timestamp = (uint32_t)time(NULL); // set timestamp to publish time
+        pthread_mutex_lock(&manager->txLock);
         _BRPeerManagerAddTxToPublishList(manager, tx, info, callback);
+        pthread_mutex_unlock(&manager->txLock);
 
         for (i = array_count(manager->connectedPeers); i > 0; i--) {
             if (BRPeerConnectStatus(manager->connectedPeers[i - 1]) == BRPeerStatusConnected) count++;
         }
 
+        BRPeer *peers[count ? count : 1];
+        size_t peerCount = 0;
+
         for (i = array_count(manager->connectedPeers); i > 0; i--) {
             BRPeer *peer = manager->connectedPeers[i - 1];
-            BRPeerCallbackInfo *peerInfo;
 
             if (BRPeerConnectStatus(peer) != BRPeerStatusConnected) continue;
             
             // instead of publishing to all peers, leave out downloadPeer to see if tx propogates/gets relayed back
             // TODO: XXX connect to a random peer with an empty or fake bloom filter just for publishing
-            if (peer != manager->downloadPeer || count == 1) {
-                _BRPeerManagerPublishPendingTx(manager, peer);
-                peerInfo = calloc(1, sizeof(*peerInfo));
-                assert(peerInfo != NULL);
-                peerInfo->peer = peer;
-                peerInfo->manager = manager;
-                BRPeerSendPing(peer, peerInfo, _publishTxInvDone);
-            }
+            if (peerCount < count && (peer != manager->downloadPeer || count == 1)) peers[peerCount++] = peer;
+        }
+
+        for (i = 0; i < peerCount; i++) BRPeerBeginBatch(peers[i]); // inv and ping go out in one write
+        _BRPeerManagerPublishPendingTx(manager, peers, peerCount);
+
+        for (i = 0; i < peerCount; i++) {
+            BRPeerCallbackInfo *peerInfo = calloc(1, sizeof(*peerInfo));
+
+            assert(peerInfo != NULL);
+            peerInfo->peer = peers[i];
+            peerInfo->manager = manager;
+            BRPeerSendPing(peers[i], peerInfo, _publishTxInvDone);
+            BRPeerEndBatch(peers[i]);
         }
 
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(manager);
     }
 }
 
@@ -1988,15 +3467,9 @@ size_t BRPeerManagerRelayCount(BRPeerManager *manager, UInt256 txHash)
 
     assert(manager != NULL);
     assert(! UInt256IsZero(txHash));
-    pthread_mutex_lock(&manager->lock);
-    
-    for (size_t i = array_count(manager->txRelays); i > 0; i--) {
-        if (! UInt256Eq(manager->txRelays[i - 1].txHash, txHash)) continue;
-        count = array_count(manager->txRelays[i - 1].peers);
-        break;
-    }
-    
-    pthread_mutex_unlock(&manager->lock);
+    pthread_mutex_lock(&manager->txLock);
+    count = _BRTxPeerListCount(manager->txRelays, txHash);
+    pthread_mutex_unlock(&manager->txLock);
     return count;
 }
 
@@ -2005,24 +3478,77 @@ const BRChainParams *BRPeerManagerChainParams (BRPeerManager *manager) {
 }
 
 // frees memory allocated for manager
+static void _setApplyBlockMemoryUsage(void *info, void *block)
+{
+    *(size_t *)info += BRMerkleBlockMemoryUsage(block);
+}
+
+static void _setApplyTxPeerListMemoryUsage(void *info, void *list)
+{
+    *(size_t *)info += sizeof(BRTxPeerList) + array_heap_size(((BRTxPeerList *)list)->peers);
+}
+
+// returns the bytes of memory held by manager, by what they hold, see BRWalletMemoryUsage() for its wallets
+BRPeerManagerMemory BRPeerManagerMemoryUsage(BRPeerManager *manager)
+{
+    BRPeerManagerMemory m = { 0, 0, 0, 0, 0, 0 };
+    
+    assert(manager != NULL);
+    _BRPeerManagerLock(manager);
+    BRSetApply(manager->blocks, &m.blocks, _setApplyBlockMemoryUsage);
+    m.blocks += BRSetMemoryUsage(manager->blocks) + array_heap_size(manager->chainHashes);
+    m.orphans = manager->orphanBytes + BRSetMemoryUsage(manager->orphans);
+    m.peers = array_heap_size(manager->connectedPeers);
+    
+    for (size_t i = 0; i < array_count(manager->connectedPeers); i++) {
+        m.peers += BRPeerMemoryUsage(manager->connectedPeers[i]);
+    }
+    
+    m.other = sizeof(*manager) + array_heap_size(manager->downloadRequests) + array_heap_size(manager->downloadPeers) +
+              array_heap_size(manager->filterScripts) + array_heap_size(manager->filterScriptLens) +
+              array_heap_size(manager->wallets) + array_heap_size(manager->walletKeyTimes);
+    if (manager->bloomFilter) m.other += sizeof(*manager->bloomFilter) + manager->bloomFilter->length;
+    
+    pthread_mutex_lock(&manager->txLock);
+    m.transactions = array_heap_size(manager->publishedTx) + array_heap_size(manager->publishedTxHashes) +
+                     BRSetMemoryUsage(manager->txRelays) + BRSetMemoryUsage(manager->txRequests);
+    BRSetApply(manager->txRelays, &m.transactions, _setApplyTxPeerListMemoryUsage);
+    BRSetApply(manager->txRequests, &m.transactions, _setApplyTxPeerListMemoryUsage);
+    
+    for (size_t i = 0; i < array_count(manager->publishedTx); i++) { // wallet tx are counted by BRWalletMemoryUsage()
+        BRTransaction *tx = manager->publishedTx[i].tx;
+        
+        if (tx && tx != BRWalletTransactionForHash(manager->wallet, tx->txHash)) {
+            m.transactions += BRTransactionMemoryUsage(tx);
+        }
+    }
+    
+    pthread_mutex_unlock(&manager->txLock);
+    _BRPeerManagerUnlock(manager);
+    pthread_mutex_lock(&manager->peersLock);
+    m.peers += array_heap_size(manager->peers);
+    pthread_mutex_unlock(&manager->peersLock);
+    m.total = m.blocks + m.orphans + m.peers + m.transactions + m.other;
+    return m;
+}
+
 void BRPeerManagerFree(BRPeerManager *manager)
 {
     BRTransaction *tx;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(manager);
+    _BRPeerManagerCommitWallet(manager);
     array_free(manager->peers);
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) BRPeerFree(manager->connectedPeers[i - 1]);
     array_free(manager->connectedPeers);
     BRSetApply(manager->blocks, NULL, _setApplyFreeBlock);
     BRSetFree(manager->blocks);
+    manager->lastBlock = NULL; // nothing left to publish
     BRSetApply(manager->orphans, NULL, _setApplyFreeBlock);
     BRSetFree(manager->orphans);
-    BRSetFree(manager->checkpoints);
-    for (size_t i = array_count(manager->txRelays); i > 0; i--) array_free(manager->txRelays[i - 1].peers);
-    array_free(manager->txRelays);
-    for (size_t i = array_count(manager->txRequests); i > 0; i--) array_free(manager->txRequests[i - 1].peers);
-    array_free(manager->txRequests);
+    BRSetFreeAll(manager->txRelays, _BRTxPeerListFree);
+    BRSetFreeAll(manager->txRequests, _BRTxPeerListFree);
 
     for (size_t i = array_count(manager->publishedTx); i > 0; i--) {
         tx = manager->publishedTx[i - 1].tx;
@@ -2033,7 +3559,17 @@ void BRPeerManagerFree(BRPeerManager *manager)
 
     array_free(manager->publishedTx);
     array_free(manager->publishedTxHashes);
-    pthread_mutex_unlock(&manager->lock);
+    array_free(manager->downloadRequests);
+    array_free(manager->downloadPeers);
+    array_free(manager->chainHashes);
+    array_free(manager->filterScripts);
+    array_free(manager->filterScriptLens);
+    array_free(manager->wallets);
+    array_free(manager->walletKeyTimes);
+    BRFeeEstimatorFree(manager->feeEstimator);
+    _BRPeerManagerUnlock(manager);
     pthread_mutex_destroy(&manager->lock);
+    pthread_mutex_destroy(&manager->txLock);
+    pthread_mutex_destroy(&manager->peersLock);
     free(manager);
 }
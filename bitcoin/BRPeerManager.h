@@ -69,6 +69,52 @@ void BRPeerManagerSetCallbacks(BRPeerManager *manager, void *info,
 // set address to UINT128_ZERO to revert to default behavior
 void BRPeerManagerSetFixedPeer(BRPeerManager *manager, UInt128 address, uint16_t port);
 
+// set eventLoop to true to service peer connections from a single shared event loop thread instead of one thread per
+// peer, takes effect for peers connected after the call
+void BRPeerManagerSetEventLoop(BRPeerManager *manager, int eventLoop);
+
+// set compactFilters to true to download filtered blocks during a headers first sync by matching BIP157 compact block
+// filters locally, from peers that serve them, and to then fetch only the matching full blocks
+void BRPeerManagerSetCompactFilters(BRPeerManager *manager, int compactFilters);
+
+// sets the most orphan blocks, and the most memory in bytes used by them, held while waiting for their previous blocks,
+// the oldest orphans are evicted first once either limit is exceeded
+void BRPeerManagerSetOrphanLimits(BRPeerManager *manager, size_t maxCount, size_t maxBytes);
+
+// adds another wallet to be synced over the same peers and header chain as manager's own wallet, the bloom filter then
+// matches all the wallets, and each relayed or confirmed tx is added to or updated in every wallet that contains it
+// if blocks after earliestKeyTime were already synced without the wallet, they're downloaded again
+// the wallet's callbacks are called the same as for manager's own wallet, and it must be removed before it's freed
+void BRPeerManagerAddWallet(BRPeerManager *manager, BRWallet *wallet, uint32_t earliestKeyTime);
+
+// stops syncing a wallet added with BRPeerManagerAddWallet(), the manager's own wallet can't be removed
+void BRPeerManagerRemoveWallet(BRPeerManager *manager, BRWallet *wallet);
+
+// FILE *recordFile(void *, const BRPeer *) - returns a file to record peer's traffic to, see BRPeerSetRecorder()
+// FILE *replayFile(void *, const BRPeer *) - returns a recording to replay in place of connecting to peer, see
+// BRPeerSetReplay()
+// both are called for each peer connected after the call, either may be NULL or return NULL, and files must stay open
+// until the peer disconnects
+void BRPeerManagerSetTrafficFiles(BRPeerManager *manager, void *info,
+                                  FILE *(*recordFile)(void *info, const BRPeer *peer),
+                                  FILE *(*replayFile)(void *info, const BRPeer *peer));
+
+// adds a snapshot of consecutive 80 byte block headers, such as one bundled with the app, to the chain so that a new
+// wallet doesn't have to download them, the first header must follow a checkpoint or a block already in the chain,
+// and each header is verified as when received from a peer
+// headers less than a week older than earliestKeyTime are ignored, since their filtered blocks are still needed
+// returns the number of headers added, stopping at the first one that fails to verify
+// call after BRPeerManagerSetCallbacks() so the new chain is saved, and before BRPeerManagerConnect()
+size_t BRPeerManagerLoadHeaders(BRPeerManager *manager, const uint8_t *headers, size_t headersLen);
+
+// starts manager's chain from the last difficulty transition block that source has at or below forkHeight, such as for
+// a bitcoin cash manager from a bitcoin one, so the headers before the fork are only downloaded and verified once
+// both chains must follow the same rules up to forkHeight, since the shared block is trusted as a saved block would be
+// transitions less than a week older than earliestKeyTime are skipped, since their filtered blocks are still needed
+// returns true if manager's chain now starts from a shared block
+// call after BRPeerManagerSetCallbacks() so the new chain is saved, and before BRPeerManagerConnect()
+int BRPeerManagerShareBlocks(BRPeerManager *manager, BRPeerManager *source, uint32_t forkHeight);
+
 // current connect status
 BRPeerStatus BRPeerManagerConnectStatus(BRPeerManager *manager);
 
@@ -82,6 +128,10 @@ void BRPeerManagerDisconnect(BRPeerManager *manager);
 // possibility that a malicious node might lie by omitting transactions that match the bloom filter)
 void BRPeerManagerRescan(BRPeerManager *manager);
 
+// saves the main chain again with the saveBlocks() callback, replacing every block saved before, from the start of the
+// previous difficulty interval through the last block (for repairing a damaged block store without a rescan)
+void BRPeerManagerResaveBlocks(BRPeerManager *manager);
+
 // rescans blocks and transactions after the last hardcoded checkpoint (uses a new random download peer, see above comment)
 void BRPeerManagerRescanFromLastHardcodedCheckpoint(BRPeerManager *manager);
 
@@ -98,6 +148,10 @@ uint32_t BRPeerManagerLastBlockHeight(BRPeerManager *manager);
 // current proof-of-work verified best block timestamp (time interval since unix epoch)
 uint32_t BRPeerManagerLastBlockTimestamp(BRPeerManager *manager);
 
+// fee per kb that wallet transactions seen since connecting have needed to confirm within targetBlocks (up to 25), or 0
+// if too few have been seen yet, in which case a fee from BRWalletFeePerKb() should be used
+uint64_t BRPeerManagerEstimateFeePerKb(BRPeerManager *manager, uint32_t targetBlocks);
+
 // current network sync progress from 0 to 1
 // startHeight is the block height of the most recent fully completed sync
 double BRPeerManagerSyncProgress(BRPeerManager *manager, uint32_t startHeight);
@@ -118,6 +172,18 @@ size_t BRPeerManagerRelayCount(BRPeerManager *manager, UInt256 txHash);
 // return the BRChainParams used to create this peer manager
 const BRChainParams *BRPeerManagerChainParams(BRPeerManager *manager);
 
+typedef struct {
+    size_t blocks; // the block chain, with its main chain hashes and sets of blocks and checkpoints
+    size_t orphans; // blocks that don't connect to the chain yet, and their set
+    size_t peers; // known peers, and the connected peers with their buffers
+    size_t transactions; // published, relayed and requested tx
+    size_t other; // the manager struct, bloom filter and sync state
+    size_t total; // sum of the above, not including manager's wallets
+} BRPeerManagerMemory;
+
+// returns the bytes of memory held by manager, by what they hold, see BRWalletMemoryUsage() for its wallets
+BRPeerManagerMemory BRPeerManagerMemoryUsage(BRPeerManager *manager);
+
 // frees memory allocated for manager (call BRPeerManagerDisconnect() first if connected)
 void BRPeerManagerFree(BRPeerManager *manager);
 
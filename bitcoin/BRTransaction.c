@@ -30,6 +30,8 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #define TX_VERSION           0x00000001
 #define TX_LOCKTIME          0x00000000
@@ -38,6 +40,45 @@
 #define SIGHASH_SINGLE       0x03 // sign one of the outputs, I don't care where the other outputs go
 #define SIGHASH_ANYONECANPAY 0x80 // let other people add inputs, I don't care where the rest of the bitcoins come from
 #define SIGHASH_FORKID       0x40 // use BIP143 digest method (for b-cash/b-gold signatures)
+#define SIGN_MAX_THREADS     16
+#define SIGN_MIN_PER_THREAD  8    // fewer inputs sign faster than a thread can be started for them
+
+// bump allocator for arena transactions, see BRTransactionParseArena()
+typedef struct {
+    uint8_t *next;
+    uint8_t *end;
+} _BRTxArena;
+
+// size of an arena BRArray of count items, rounded up to keep arena allocations 16 byte aligned
+#define _arena_array_size(count, itemSize) (((count)*(itemSize) + sizeof(size_t)*2 + 15) & ~(size_t)15)
+
+// returns a zeroed BRArray from arena with both capacity and count set to count
+static void *_BRTxArenaArray(_BRTxArena *arena, size_t count, size_t itemSize)
+{
+    size_t *a = (size_t *)arena->next;
+    
+    assert(arena->next + _arena_array_size(count, itemSize) <= arena->end);
+    arena->next += _arena_array_size(count, itemSize);
+    a[0] = a[1] = count; // BRArray capacity and count header
+    return &a[2];
+}
+
+// returns a BRArray copy of bytes, allocated from arena, or from the heap if arena is NULL
+static uint8_t *_BRTxBytes(_BRTxArena *arena, const uint8_t *bytes, size_t len)
+{
+    uint8_t *a;
+    
+    if (arena) {
+        a = _BRTxArenaArray(arena, len, sizeof(*a));
+        if (len > 0) memcpy(a, bytes, len);
+    }
+    else {
+        array_new(a, len);
+        array_add_array(a, bytes, len);
+    }
+    
+    return a;
+}
 
 void BRTxInputSetAddress(BRTxInput *input, const char *address)
 {
@@ -57,7 +98,7 @@ void BRTxInputSetAddress(BRTxInput *input, const char *address)
     }
 }
 
-void BRTxInputSetScript(BRTxInput *input, const uint8_t *script, size_t scriptLen)
+static void _BRTxInputSetScript(BRTxInput *input, const uint8_t *script, size_t scriptLen, _BRTxArena *arena)
 {
     assert(input != NULL);
     assert(script != NULL || scriptLen == 0);
@@ -68,13 +109,17 @@ void BRTxInputSetScript(BRTxInput *input, const uint8_t *script, size_t scriptLe
     
     if (script) {
         input->scriptLen = scriptLen;
-        array_new(input->script, scriptLen);
-        array_add_array(input->script, script, scriptLen);
+        input->script = _BRTxBytes(arena, script, scriptLen);
         BRAddressFromScriptPubKey(input->address, sizeof(input->address), script, scriptLen);
     }
 }
 
-void BRTxInputSetSignature(BRTxInput *input, const uint8_t *signature, size_t sigLen)
+void BRTxInputSetScript(BRTxInput *input, const uint8_t *script, size_t scriptLen)
+{
+    _BRTxInputSetScript(input, script, scriptLen, NULL);
+}
+
+static void _BRTxInputSetSignature(BRTxInput *input, const uint8_t *signature, size_t sigLen, _BRTxArena *arena)
 {
     assert(input != NULL);
     assert(signature != NULL || sigLen == 0);
@@ -84,13 +129,17 @@ void BRTxInputSetSignature(BRTxInput *input, const uint8_t *signature, size_t si
     
     if (signature) {
         input->sigLen = sigLen;
-        array_new(input->signature, sigLen);
-        array_add_array(input->signature, signature, sigLen);
+        input->signature = _BRTxBytes(arena, signature, sigLen);
         if (! input->address[0]) BRAddressFromScriptSig(input->address, sizeof(input->address), signature, sigLen);
     }
 }
 
-void BRTxInputSetWitness(BRTxInput *input, const uint8_t *witness, size_t witLen)
+void BRTxInputSetSignature(BRTxInput *input, const uint8_t *signature, size_t sigLen)
+{
+    _BRTxInputSetSignature(input, signature, sigLen, NULL);
+}
+
+static void _BRTxInputSetWitness(BRTxInput *input, const uint8_t *witness, size_t witLen, _BRTxArena *arena)
 {
     assert(input != NULL);
     assert(witness != NULL || witLen == 0);
@@ -100,12 +149,16 @@ void BRTxInputSetWitness(BRTxInput *input, const uint8_t *witness, size_t witLen
     
     if (witness) {
         input->witLen = witLen;
-        array_new(input->witness, witLen);
-        array_add_array(input->witness, witness, witLen);
+        input->witness = _BRTxBytes(arena, witness, witLen);
         if (! input->address[0]) BRAddressFromWitness(input->address, sizeof(input->address), witness, witLen);
     }
 }
 
+void BRTxInputSetWitness(BRTxInput *input, const uint8_t *witness, size_t witLen)
+{
+    _BRTxInputSetWitness(input, witness, witLen, NULL);
+}
+
 // serializes a tx input for a signature pre-image
 // set input->amount to 0 to skip serializing the input amount in non-witness signatures
 static size_t _BRTxInputData(const BRTxInput *input, uint8_t *data, size_t dataLen)
@@ -148,7 +201,7 @@ void BRTxOutputSetAddress(BRTxOutput *output, const char *address)
     }
 }
 
-void BRTxOutputSetScript(BRTxOutput *output, const uint8_t *script, size_t scriptLen)
+static void _BRTxOutputSetScript(BRTxOutput *output, const uint8_t *script, size_t scriptLen, _BRTxArena *arena)
 {
     assert(output != NULL);
     if (output->script) array_free(output->script);
@@ -158,12 +211,16 @@ void BRTxOutputSetScript(BRTxOutput *output, const uint8_t *script, size_t scrip
 
     if (script) {
         output->scriptLen = scriptLen;
-        array_new(output->script, scriptLen);
-        array_add_array(output->script, script, scriptLen);
+        output->script = _BRTxBytes(arena, script, scriptLen);
         BRAddressFromScriptPubKey(output->address, sizeof(output->address), script, scriptLen);
     }
 }
 
+void BRTxOutputSetScript(BRTxOutput *output, const uint8_t *script, size_t scriptLen)
+{
+    _BRTxOutputSetScript(output, script, scriptLen, NULL);
+}
+
 // serializes the tx output at index for a signature pre-image
 // an index of SIZE_MAX will serialize all tx outputs for SIGHASH_ALL signatures
 static size_t _BRTransactionOutputData(const BRTransaction *tx, uint8_t *data, size_t dataLen, size_t index)
@@ -183,15 +240,70 @@ static size_t _BRTransactionOutputData(const BRTransaction *tx, uint8_t *data, s
     return (! data || off <= dataLen) ? off : 0;
 }
 
+// BIP143 double-sha-256 of the tx input outpoints, or of their sequence numbers, hashed as they're serialized
+static UInt256 _BRTransactionInputsHash(const BRTransaction *tx, int sequence)
+{
+    BRSHA256Context ctx;
+    uint8_t buf[sizeof(UInt256) + sizeof(uint32_t)];
+    UInt256 md;
+    size_t i;
+    
+    BRSHA256Init(&ctx);
+    
+    for (i = 0; i < tx->inCount; i++) {
+        if (sequence) UInt32SetLE(buf, tx->inputs[i].sequence);
+        else UInt256Set(buf, tx->inputs[i].txHash), UInt32SetLE(&buf[sizeof(UInt256)], tx->inputs[i].index);
+        BRSHA256Update(&ctx, buf, (sequence) ? sizeof(uint32_t) : sizeof(buf));
+    }
+    
+    BRSHA256Final(&ctx, &md);
+    BRSHA256(&md, &md, sizeof(md));
+    return md;
+}
+
+// BIP143 double-sha-256 of the tx output at index, hashed as it's serialized for a signature pre-image
+// an index of SIZE_MAX will hash all tx outputs for SIGHASH_ALL signatures
+static UInt256 _BRTransactionOutputsHash(const BRTransaction *tx, size_t index)
+{
+    BRSHA256Context ctx;
+    BRTxOutput *output;
+    uint8_t buf[sizeof(uint64_t) + 9];
+    UInt256 md;
+    size_t i, len;
+    
+    BRSHA256Init(&ctx);
+    
+    for (i = (index == SIZE_MAX ? 0 : index); i < tx->outCount && (index == SIZE_MAX || index == i); i++) {
+        output = &tx->outputs[i];
+        UInt64SetLE(buf, output->amount);
+        len = sizeof(uint64_t) + BRVarIntSet(&buf[sizeof(uint64_t)], sizeof(buf) - sizeof(uint64_t), output->scriptLen);
+        BRSHA256Update(&ctx, buf, len);
+        BRSHA256Update(&ctx, output->script, output->scriptLen);
+    }
+    
+    BRSHA256Final(&ctx, &md);
+    BRSHA256(&md, &md, sizeof(md));
+    return md;
+}
+
+// computes the BIP143 hashPrevouts, hashSequence and hashOutputs that are shared by every SIGHASH_ALL input signature
+static void _BRTransactionSigHashes(const BRTransaction *tx, UInt256 hashes[3])
+{
+    hashes[0] = _BRTransactionInputsHash(tx, 0);
+    hashes[1] = _BRTransactionInputsHash(tx, 1);
+    hashes[2] = _BRTransactionOutputsHash(tx, SIZE_MAX);
+}
+
 // writes the BIP143 witness program data that needs to be hashed and signed for the tx input at index
 // https://github.com/bitcoin/bips/blob/master/bip-0143.mediawiki
+// hashes are the precomputed results of _BRTransactionSigHashes(), or NULL to compute them as needed
 // returns number of bytes written, or total len needed if data is NULL
 static size_t _BRTransactionWitnessData(const BRTransaction *tx, uint8_t *data, size_t dataLen, size_t index,
-                                        int hashType)
+                                        int hashType, const UInt256 *hashes)
 {
     BRTxInput input;
     int anyoneCanPay = (hashType & SIGHASH_ANYONECANPAY), sigHash = (hashType & 0x1f);
-    size_t i, off = 0;
+    size_t off = 0;
     uint8_t scriptCode[] = { OP_DUP, OP_HASH160, 20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
                              0, 0, 0, 0, 0, 0, 0, 0, 0, OP_EQUALVERIFY, OP_CHECKSIG };
 
@@ -199,25 +311,21 @@ static size_t _BRTransactionWitnessData(const BRTransaction *tx, uint8_t *data,
     if (data && off + sizeof(uint32_t) <= dataLen) UInt32SetLE(&data[off], tx->version); // tx version
     off += sizeof(uint32_t);
     
-    if (! anyoneCanPay) {
-        uint8_t buf[(sizeof(UInt256) + sizeof(uint32_t))*tx->inCount];
-        
-        for (i = 0; i < tx->inCount; i++) {
-            UInt256Set(&buf[(sizeof(UInt256) + sizeof(uint32_t))*i], tx->inputs[i].txHash);
-            UInt32SetLE(&buf[(sizeof(UInt256) + sizeof(uint32_t))*i + sizeof(UInt256)], tx->inputs[i].index);
-        }
-        
-        if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, sizeof(buf)); // inputs hash
+    if (! anyoneCanPay && hashes) {
+        if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], hashes[0]); // inputs hash
+    }
+    else if (! anyoneCanPay) {
+        if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], _BRTransactionInputsHash(tx, 0));
     }
     else if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], UINT256_ZERO); // anyone-can-pay
     
     off += sizeof(UInt256);
     
-    if (! anyoneCanPay && sigHash != SIGHASH_SINGLE && sigHash != SIGHASH_NONE) {
-        uint8_t buf[sizeof(uint32_t)*tx->inCount];
-        
-        for (i = 0; i < tx->inCount; i++) UInt32SetLE(&buf[sizeof(uint32_t)*i], tx->inputs[i].sequence);
-        if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, sizeof(buf)); // sequence hash
+    if (! anyoneCanPay && sigHash != SIGHASH_SINGLE && sigHash != SIGHASH_NONE && hashes) {
+        if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], hashes[1]); // sequence hash
+    }
+    else if (! anyoneCanPay && sigHash != SIGHASH_SINGLE && sigHash != SIGHASH_NONE) {
+        if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], _BRTransactionInputsHash(tx, 1));
     }
     else if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], UINT256_ZERO);
     
@@ -234,19 +342,14 @@ static size_t _BRTransactionWitnessData(const BRTransaction *tx, uint8_t *data,
 
     off += _BRTxInputData(&input, (data ? &data[off] : NULL), (off <= dataLen ? dataLen - off : 0));
     
-    if (sigHash != SIGHASH_SINGLE && sigHash != SIGHASH_NONE) {
-        size_t bufLen = _BRTransactionOutputData(tx, NULL, 0, SIZE_MAX);
-        uint8_t _buf[0x1000], *buf = (bufLen <= 0x1000) ? _buf : malloc(bufLen);
-        
-        bufLen = _BRTransactionOutputData(tx, buf, bufLen, SIZE_MAX);
-        if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, bufLen); // SIGHASH_ALL outputs hash
-        if (buf != _buf) free(buf);
+    if (sigHash != SIGHASH_SINGLE && sigHash != SIGHASH_NONE && hashes) {
+        if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], hashes[2]); // SIGHASH_ALL outputs hash
+    }
+    else if (sigHash != SIGHASH_SINGLE && sigHash != SIGHASH_NONE) {
+        if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], _BRTransactionOutputsHash(tx, SIZE_MAX));
     }
     else if (sigHash == SIGHASH_SINGLE && index < tx->outCount) {
-        uint8_t buf[_BRTransactionOutputData(tx, NULL, 0, index)];
-        size_t bufLen = _BRTransactionOutputData(tx, buf, sizeof(buf), index);
-        
-        if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, bufLen); //SIGHASH_SINGLE outputs hash
+        if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], _BRTransactionOutputsHash(tx, index));
     }
     else if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], UINT256_ZERO); // SIGHASH_NONE
     
@@ -260,14 +363,16 @@ static size_t _BRTransactionWitnessData(const BRTransaction *tx, uint8_t *data,
 
 // writes the data that needs to be hashed and signed for the tx input at index
 // an index of SIZE_MAX will write the entire signed transaction
+// hashes are passed to _BRTransactionWitnessData() for SIGHASH_FORKID signatures, and may be NULL
 // returns number of bytes written, or total dataLen needed if data is NULL
-static size_t _BRTransactionData(const BRTransaction *tx, uint8_t *data, size_t dataLen, size_t index, int hashType)
+static size_t _BRTransactionData(const BRTransaction *tx, uint8_t *data, size_t dataLen, size_t index, int hashType,
+                                 const UInt256 *hashes)
 {
     BRTxInput input;
     int anyoneCanPay = (hashType & SIGHASH_ANYONECANPAY), sigHash = (hashType & 0x1f), witnessFlag = 0;
     size_t i, count, len, woff, off = 0;
     
-    if (hashType & SIGHASH_FORKID) return _BRTransactionWitnessData(tx, data, dataLen, index, hashType);
+    if (hashType & SIGHASH_FORKID) return _BRTransactionWitnessData(tx, data, dataLen, index, hashType, hashes);
     if (anyoneCanPay && index >= tx->inCount) return 0;
     
     for (i = 0; index == SIZE_MAX && ! witnessFlag && i < tx->inCount; i++) {
@@ -376,6 +481,11 @@ BRTransaction *BRTransactionCopy(const BRTransaction *tx)
     cpy->inputs = inputs;
     cpy->outputs = outputs;
     cpy->inCount = cpy->outCount = 0;
+    cpy->arena = 0;
+    cpy->depth = cpy->depthGen = 0;
+    cpy->amountsGen = 0;
+    cpy->raw = NULL;
+    cpy->rawLen = cpy->vsize = 0;
 
     for (size_t i = 0; i < tx->inCount; i++) {
         BRTransactionAddInput(cpy, tx->inputs[i].txHash, tx->inputs[i].index, tx->inputs[i].amount,
@@ -388,20 +498,83 @@ BRTransaction *BRTransactionCopy(const BRTransaction *tx)
         BRTransactionAddOutput(cpy, tx->outputs[i].amount, tx->outputs[i].script, tx->outputs[i].scriptLen);
     }
 
+    if (tx->raw) {
+        cpy->raw = malloc(tx->rawLen);
+        assert(cpy->raw != NULL);
+        memcpy(cpy->raw, tx->raw, tx->rawLen);
+        cpy->rawLen = tx->rawLen;
+        cpy->vsize = tx->vsize;
+    }
+
     return cpy;
 }
 
-// buf must contain a serialized tx
-// retruns a transaction that must be freed by calling BRTransactionFree()
-BRTransaction *BRTransactionParse(const uint8_t *buf, size_t bufLen)
+// drops the serialization cached by BRTransactionSign(), before tx is modified
+static void _BRTransactionUncache(BRTransaction *tx)
 {
-    assert(buf != NULL || bufLen == 0);
-    if (! buf) return NULL;
+    if (tx->raw) free(tx->raw);
+    tx->raw = NULL;
+    tx->rawLen = tx->vsize = 0;
+}
+
+// moves the inputs, outputs and scripts of an arena tx into separate allocations so they can be modified
+static void _BRTransactionUnarena(BRTransaction *tx)
+{
+    BRTxInput *inputs = tx->inputs;
+    BRTxOutput *outputs = tx->outputs;
+    
+    if (! tx->arena) return;
+    array_new(tx->inputs, tx->inCount);
+    array_add_array(tx->inputs, inputs, tx->inCount);
+    array_new(tx->outputs, tx->outCount);
+    array_add_array(tx->outputs, outputs, tx->outCount);
+    
+    for (size_t i = 0; i < tx->inCount; i++) {
+        if (inputs[i].script) tx->inputs[i].script = _BRTxBytes(NULL, inputs[i].script, inputs[i].scriptLen);
+        if (inputs[i].signature) tx->inputs[i].signature = _BRTxBytes(NULL, inputs[i].signature, inputs[i].sigLen);
+        if (inputs[i].witness) tx->inputs[i].witness = _BRTxBytes(NULL, inputs[i].witness, inputs[i].witLen);
+    }
+    
+    for (size_t i = 0; i < tx->outCount; i++) {
+        if (outputs[i].script) tx->outputs[i].script = _BRTxBytes(NULL, outputs[i].script, outputs[i].scriptLen);
+    }
+    
+    tx->arena = 0;
+}
+
+// reads the input and output counts of a serialized tx, walking buf the same way as _BRTransactionParse()
+// returns false if either count is more than buf could hold
+static int _BRTransactionCounts(const uint8_t *buf, size_t bufLen, size_t *inCount, size_t *outCount)
+{
+    size_t i, off = sizeof(uint32_t), sLen = 0, len = 0;
+    
+    *inCount = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
+    off += len;
+    
+    if (*inCount == 0 && off + 1 <= bufLen && buf[off++]) { // witness flag
+        *inCount = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
+        off += len;
+    }
     
+    for (i = 0; off <= bufLen && i < *inCount; i++) {
+        off += sizeof(UInt256) + sizeof(uint32_t);
+        sLen = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
+        off += len;
+        if (off + sLen <= bufLen && BRAddressFromScriptPubKey(NULL, 0, &buf[off], sLen) > 0) off += sizeof(uint64_t);
+        off += sLen + sizeof(uint32_t);
+    }
+    
+    *outCount = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
+    return (*inCount <= bufLen && *outCount <= bufLen);
+}
+
+// parses buf into tx, allocating inputs, outputs and scripts from arena if it's not NULL
+// returns tx, or NULL after freeing tx if buf isn't a valid serialized tx
+static BRTransaction *_BRTransactionParse(BRTransaction *tx, const uint8_t *buf, size_t bufLen, _BRTxArena *arena)
+{
     int isSigned = 1, witnessFlag = 0;
     uint8_t *sBuf;
     size_t i, j, off = 0, witnessOff = 0, sLen = 0, len = 0, count;
-    BRTransaction *tx = BRTransactionNew();
     BRTxInput *input;
     BRTxOutput *output;
     
@@ -416,7 +589,8 @@ BRTransaction *BRTransactionParse(const uint8_t *buf, size_t bufLen)
         off += len;
     }
 
-    array_set_count(tx->inputs, tx->inCount);
+    if (arena) tx->inputs = _BRTxArenaArray(arena, tx->inCount, sizeof(*tx->inputs));
+    else array_set_count(tx->inputs, tx->inCount);
     
     for (i = 0; off <= bufLen && i < tx->inCount; i++) {
         input = &tx->inputs[i];
@@ -428,22 +602,23 @@ BRTransaction *BRTransactionParse(const uint8_t *buf, size_t bufLen)
         off += len;
         
         if (off + sLen <= bufLen && BRAddressFromScriptPubKey(NULL, 0, &buf[off], sLen) > 0) {
-            BRTxInputSetScript(input, &buf[off], sLen);
+            _BRTxInputSetScript(input, &buf[off], sLen, arena);
             input->amount = (off + sLen + sizeof(uint64_t) <= bufLen) ? UInt64GetLE(&buf[off + sLen]) : 0;
             off += sizeof(uint64_t);
             isSigned = 0;
         }
-        else if (off + sLen <= bufLen) BRTxInputSetSignature(input, &buf[off], sLen);
+        else if (off + sLen <= bufLen) _BRTxInputSetSignature(input, &buf[off], sLen, arena);
         
         off += sLen;
-        if (! witnessFlag) BRTxInputSetWitness(input, &buf[off], 0); // set witness to empty byte array
+        if (! witnessFlag) _BRTxInputSetWitness(input, &buf[off], 0, arena); // set witness to empty byte array
         input->sequence = (off + sizeof(uint32_t) <= bufLen) ? UInt32GetLE(&buf[off]) : 0;
         off += sizeof(uint32_t);
     }
     
     tx->outCount = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
     off += len;
-    array_set_count(tx->outputs, tx->outCount);
+    if (arena) tx->outputs = _BRTxArenaArray(arena, tx->outCount, sizeof(*tx->outputs));
+    else array_set_count(tx->outputs, tx->outCount);
     
     for (i = 0; off <= bufLen && i < tx->outCount; i++) {
         output = &tx->outputs[i];
@@ -451,7 +626,7 @@ BRTransaction *BRTransactionParse(const uint8_t *buf, size_t bufLen)
         off += sizeof(uint64_t);
         sLen = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
         off += len;
-        if (off + sLen <= bufLen) BRTxOutputSetScript(output, &buf[off], sLen);
+        if (off + sLen <= bufLen) _BRTxOutputSetScript(output, &buf[off], sLen, arena);
         off += sLen;
     }
     
@@ -465,7 +640,7 @@ BRTransaction *BRTransactionParse(const uint8_t *buf, size_t bufLen)
             sLen += len;
         }
         
-        if (off + sLen <= bufLen) BRTxInputSetWitness(input, &buf[off], sLen);
+        if (off + sLen <= bufLen) _BRTxInputSetWitness(input, &buf[off], sLen, arena);
         off += sLen;
     }
     
@@ -493,12 +668,180 @@ BRTransaction *BRTransactionParse(const uint8_t *buf, size_t bufLen)
     return tx;
 }
 
+// buf must contain a serialized tx
+// retruns a transaction that must be freed by calling BRTransactionFree()
+BRTransaction *BRTransactionParse(const uint8_t *buf, size_t bufLen)
+{
+    assert(buf != NULL || bufLen == 0);
+    if (! buf) return NULL;
+    return _BRTransactionParse(BRTransactionNew(), buf, bufLen, NULL);
+}
+
+// same as BRTransactionParse(), except the tx, its inputs and outputs, and all their scripts, signatures and witnesses
+// are allocated as a single block that BRTransactionFree() releases with one call to free()
+BRTransaction *BRTransactionParseArena(const uint8_t *buf, size_t bufLen)
+{
+    size_t inCount = 0, outCount = 0, txSize = _arena_array_size(1, sizeof(BRTransaction)), size;
+    BRTransaction *tx;
+    _BRTxArena arena;
+    
+    assert(buf != NULL || bufLen == 0);
+    if (! buf || ! _BRTransactionCounts(buf, bufLen, &inCount, &outCount)) return NULL;
+    
+    // each input has at most a script or signature and a witness, and each output a script, all copied out of buf, so
+    // together they need no more than bufLen plus a padded array header each
+    size = txSize + _arena_array_size(inCount, sizeof(BRTxInput)) + _arena_array_size(outCount, sizeof(BRTxOutput)) +
+           (inCount*2 + outCount)*(sizeof(size_t)*2 + 15) + bufLen;
+    tx = calloc(1, size);
+    assert(tx != NULL);
+    tx->version = TX_VERSION;
+    tx->lockTime = TX_LOCKTIME;
+    tx->blockHeight = TX_UNCONFIRMED;
+    tx->arena = 1;
+    arena.next = (uint8_t *)tx + txSize;
+    arena.end = (uint8_t *)tx + size;
+    return _BRTransactionParse(tx, buf, bufLen, &arena);
+}
+
+// returns the offset in buf following the input at off, and its script, and whether it's followed by an amount
+static size_t _BRTransactionViewInputEnd(const uint8_t *buf, size_t bufLen, size_t off, const uint8_t **script,
+                                         size_t *scriptLen, int *hasAmount)
+{
+    size_t len = 0, sLen;
+
+    off += sizeof(UInt256) + sizeof(uint32_t);
+    sLen = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
+    off += len;
+    *script = (len > 0 && off + sLen <= bufLen) ? &buf[off] : NULL;
+    *scriptLen = (*script) ? sLen : 0;
+    *hasAmount = (*script && BRAddressFromScriptPubKey(NULL, 0, &buf[off], sLen) > 0);
+    off += sLen + (*hasAmount ? sizeof(uint64_t) : 0) + sizeof(uint32_t);
+    return (len > 0) ? off : bufLen + 1;
+}
+
+// indexes the serialized tx in buf without copying it, and computes its txHash and wtxHash
+// returns true if buf contains a valid serialized tx
+int BRTransactionViewParse(BRTransactionView *view, const uint8_t *buf, size_t bufLen)
+{
+    const uint8_t *script;
+    size_t i, j, off = 0, witnessOff, len = 0, sLen, count;
+    int isSigned = 1, witnessFlag = 0, hasAmount;
+
+    assert(view != NULL);
+    assert(buf != NULL || bufLen == 0);
+    *view = (BRTransactionView) { buf, bufLen, UINT256_ZERO, UINT256_ZERO, 0, 0, 0, 0, 0, 0 };
+    if (! buf || bufLen < sizeof(uint32_t)) return 0;
+    view->version = UInt32GetLE(buf);
+    off += sizeof(uint32_t);
+    view->inCount = (size_t)BRVarInt(&buf[off], bufLen - off, &len);
+    off += len;
+    if (view->inCount == 0 && off + 1 <= bufLen) witnessFlag = buf[off++];
+
+    if (witnessFlag) {
+        view->inCount = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
+        off += len;
+    }
+
+    view->inOff = off;
+
+    for (i = 0; off <= bufLen && i < view->inCount; i++) {
+        off = _BRTransactionViewInputEnd(buf, bufLen, off, &script, &sLen, &hasAmount);
+        if (hasAmount) isSigned = 0;
+    }
+
+    view->outCount = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
+    off += len;
+    view->outOff = off;
+
+    for (i = 0; off <= bufLen && i < view->outCount; i++) {
+        off += sizeof(uint64_t);
+        sLen = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
+        off += (len > 0) ? len + sLen : bufLen + 1;
+    }
+
+    for (i = 0, witnessOff = off; witnessFlag && off <= bufLen && i < view->inCount; i++) {
+        count = (size_t)BRVarInt(&buf[off], (off <= bufLen ? bufLen - off : 0), &len);
+        off += (len > 0) ? len : bufLen + 1;
+
+        for (j = 0; off <= bufLen && j < count; j++) {
+            sLen = (size_t)BRVarInt(&buf[off], bufLen - off, &len);
+            off += (len > 0) ? len + sLen : bufLen + 1;
+        }
+    }
+
+    view->lockTime = (off + sizeof(uint32_t) <= bufLen) ? UInt32GetLE(&buf[off]) : 0;
+    off += sizeof(uint32_t);
+    if (view->inCount == 0 || off > bufLen) return 0;
+
+    if (isSigned && witnessFlag) {
+        size_t sBufLen = (witnessOff - 2) + sizeof(uint32_t);
+        uint8_t _sBuf[0x1000], *sBuf = (sBufLen <= sizeof(_sBuf)) ? _sBuf : malloc(sBufLen);
+
+        assert(sBuf != NULL);
+        BRSHA256_2(&view->wtxHash, buf, off);
+        UInt32SetLE(sBuf, view->version); // txHash is the hash of the tx without its witness flag and witnesses
+        memcpy(&sBuf[sizeof(uint32_t)], &buf[sizeof(uint32_t) + 2], witnessOff - (sizeof(uint32_t) + 2));
+        UInt32SetLE(&sBuf[witnessOff - 2], view->lockTime);
+        BRSHA256_2(&view->txHash, sBuf, sBufLen);
+        if (sBuf != _sBuf) free(sBuf);
+    }
+    else if (isSigned) {
+        BRSHA256_2(&view->txHash, buf, off);
+        view->wtxHash = view->txHash;
+    }
+
+    return 1;
+}
+
+// reads the input at offset off in view->buf, starting with view->inOff, and returns the offset of the next input
+// script points into view->buf, and is the input's signature script, or scriptPubKey if the tx is unsigned
+size_t BRTransactionViewInput(const BRTransactionView *view, size_t off, UInt256 *txHash, uint32_t *index,
+                              const uint8_t **script, size_t *scriptLen)
+{
+    const uint8_t *s;
+    size_t sLen;
+    int hasAmount;
+
+    assert(view != NULL);
+    assert(off + sizeof(UInt256) + sizeof(uint32_t) < view->bufLen);
+    if (txHash) *txHash = UInt256Get(&view->buf[off]);
+    if (index) *index = UInt32GetLE(&view->buf[off + sizeof(UInt256)]);
+    off = _BRTransactionViewInputEnd(view->buf, view->bufLen, off, &s, &sLen, &hasAmount);
+    if (script) *script = s;
+    if (scriptLen) *scriptLen = sLen;
+    return off;
+}
+
+// reads the output at offset off in view->buf, starting with view->outOff, and returns the offset of the next output
+// script points into view->buf
+size_t BRTransactionViewOutput(const BRTransactionView *view, size_t off, uint64_t *amount, const uint8_t **script,
+                               size_t *scriptLen)
+{
+    size_t len = 0, sLen;
+
+    assert(view != NULL);
+    assert(off + sizeof(uint64_t) < view->bufLen);
+    if (amount) *amount = UInt64GetLE(&view->buf[off]);
+    off += sizeof(uint64_t);
+    sLen = (size_t)BRVarInt(&view->buf[off], view->bufLen - off, &len);
+    off += len;
+    if (script) *script = &view->buf[off];
+    if (scriptLen) *scriptLen = sLen;
+    return off + sLen;
+}
+
 // returns number of bytes written to buf, or total bufLen needed if buf is NULL
 // (tx->blockHeight and tx->timestamp are not serialized)
 size_t BRTransactionSerialize(const BRTransaction *tx, uint8_t *buf, size_t bufLen)
 {
     assert(tx != NULL);
-    return (tx) ? _BRTransactionData(tx, buf, bufLen, SIZE_MAX, SIGHASH_ALL) : 0;
+    if (tx && tx->raw) { // signed by BRTransactionSign() and not modified since
+        if (buf && bufLen < tx->rawLen) return 0;
+        if (buf) memcpy(buf, tx->raw, tx->rawLen);
+        return tx->rawLen;
+    }
+
+    return (tx) ? _BRTransactionData(tx, buf, bufLen, SIZE_MAX, SIGHASH_ALL, NULL) : 0;
 }
 
 // adds an input to tx
@@ -515,6 +858,8 @@ void BRTransactionAddInput(BRTransaction *tx, UInt256 txHash, uint32_t index, ui
     assert(witness != NULL || witLen == 0);
     
     if (tx) {
+        _BRTransactionUncache(tx);
+        _BRTransactionUnarena(tx);
         if (script) BRTxInputSetScript(&input, script, scriptLen);
         if (signature) BRTxInputSetSignature(&input, signature, sigLen);
         if (witness) BRTxInputSetWitness(&input, witness, witLen);
@@ -532,6 +877,8 @@ void BRTransactionAddOutput(BRTransaction *tx, uint64_t amount, const uint8_t *s
     assert(script != NULL || scriptLen == 0);
     
     if (tx) {
+        _BRTransactionUncache(tx);
+        _BRTransactionUnarena(tx);
         BRTxOutputSetScript(&output, script, scriptLen);
         array_add(tx->outputs, output);
         tx->outCount = array_count(tx->outputs);
@@ -542,6 +889,7 @@ void BRTransactionAddOutput(BRTransaction *tx, uint64_t amount, const uint8_t *s
 void BRTransactionShuffleOutputs(BRTransaction *tx)
 {
     assert(tx != NULL);
+    if (tx && tx->outCount > 1) _BRTransactionUncache(tx);
     
     for (uint32_t i = 0; tx && i + 1 < tx->outCount; i++) { // fischer-yates shuffle
         uint32_t j = i + BRRand((uint32_t)tx->outCount - i);
@@ -592,6 +940,7 @@ size_t BRTransactionVSize(const BRTransaction *tx)
     size_t size, witSize = 0;
     
     assert(tx != NULL);
+    if (tx && tx->raw) return tx->vsize;
     size = (tx) ? 8 + BRVarIntSize(tx->inCount) + BRVarIntSize(tx->outCount) : 0;
     
     for (size_t i = 0; i < tx->inCount; i++) {
@@ -634,21 +983,67 @@ int BRTransactionIsSigned(const BRTransaction *tx)
     return (tx) ? 1 : 0;
 }
 
+typedef struct {
+    size_t input, key;
+    int type; // 0 for pay-to-pubkey, 1 for pay-to-pubkey-hash, 2 for pay-to-witness-pubkey-hash
+    UInt256 md;
+    uint8_t sig[73];
+    size_t sigLen;
+} _BRTxSignJob;
+
+typedef struct {
+    _BRTxSignJob *jobs;
+    size_t count;
+    const BRKey *keys;
+} _BRTxSignRun;
+
+static void *_BRTransactionSignRoutine(void *info)
+{
+    _BRTxSignRun *run = info;
+    
+    for (size_t i = 0; i < run->count; i++) {
+        _BRTxSignJob *job = &run->jobs[i];
+        
+        job->sigLen = BRKeySign(&run->keys[job->key], job->sig, sizeof(job->sig) - 1, job->md);
+    }
+    
+    return NULL;
+}
+
 // adds signatures to any inputs with NULL signatures that can be signed with any keys
 // forkId is 0 for bitcoin, 0x40 for b-cash, 0x4f for b-gold
 // returns true if tx is signed
 int BRTransactionSign(BRTransaction *tx, int forkId, BRKey keys[], size_t keysCount)
+{
+    return BRTransactionSignThreads(tx, forkId, keys, keysCount, 1);
+}
+
+// signs inputs in parallel on up to threadCount threads, 0 for one per online cpu
+int BRTransactionSignThreads(BRTransaction *tx, int forkId, BRKey keys[], size_t keysCount, size_t threadCount)
 {
     UInt160 pkh[keysCount];
-    size_t i, j;
+    UInt256 hashes[3];
+    _BRTxSignJob *jobs = NULL;
+    size_t i, j, jobsCount = 0;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int hashesSet = 0;
     
     assert(tx != NULL);
     assert(keys != NULL || keysCount == 0);
     
-    for (i = 0; tx && i < keysCount; i++) {
-        pkh[i] = BRKeyHash160(&keys[i]);
+    // derive and cache each key's public key before any signing threads start
+    if (tx) BRKeyPubKeyBatch(NULL, keys, keysCount, threadCount);
+    for (i = 0; tx && i < keysCount; i++) pkh[i] = BRKeyHash160(&keys[i]);
+    
+    if (tx) {
+        _BRTransactionUncache(tx);
+        _BRTransactionUnarena(tx);
+        jobs = malloc(((tx->inCount > 0) ? tx->inCount : 1)*sizeof(*jobs));
+        assert(jobs != NULL);
     }
     
+    // the data signed for each input doesn't depend on signatures of other inputs, so every sighash is computed up
+    // front, then signed, and then the input scripts are set
     for (i = 0; tx && i < tx->inCount; i++) {
         BRTxInput *input = &tx->inputs[i];
         const uint8_t *hash = BRScriptPKH(input->script, input->scriptLen);
@@ -659,56 +1054,101 @@ int BRTransactionSign(BRTransaction *tx, int forkId, BRKey keys[], size_t keysCo
         
         const uint8_t *elems[BRScriptElements(NULL, 0, input->script, input->scriptLen)];
         size_t elemsCount = BRScriptElements(elems, sizeof(elems)/sizeof(*elems), input->script, input->scriptLen);
-        uint8_t pubKey[BRKeyPubKey(&keys[j], NULL, 0)];
-        size_t pkLen = BRKeyPubKey(&keys[j], pubKey, sizeof(pubKey));
-        uint8_t sig[73], script[1 + sizeof(sig) + 1 + sizeof(pubKey)];
-        size_t sigLen, scriptLen;
-        UInt256 md = UINT256_ZERO;
+        _BRTxSignJob *job = &jobs[jobsCount++];
+        
+        job->input = i;
+        job->key = j;
+        job->type = 0; // pay-to-pubkey
+        if (elemsCount == 2 && *elems[0] == OP_0 && *elems[1] == 20) job->type = 2; // pay-to-witness-pubkey-hash
+        else if (elemsCount >= 2 && *elems[elemsCount - 2] == OP_EQUALVERIFY) job->type = 1; // pay-to-pubkey-hash
         
-        if (elemsCount == 2 && *elems[0] == OP_0 && *elems[1] == 20) { // pay-to-witness-pubkey-hash
-            uint8_t data[_BRTransactionWitnessData(tx, NULL, 0, i, forkId | SIGHASH_ALL)];
-            size_t dataLen = _BRTransactionWitnessData(tx, data, sizeof(data), i, forkId | SIGHASH_ALL);
+        // signing only changes input signatures and witnesses, so BIP143 hashes are computed once for all inputs
+        if (! hashesSet && (job->type == 2 || (forkId & SIGHASH_FORKID))) {
+            _BRTransactionSigHashes(tx, hashes);
+            hashesSet = 1;
+        }
+        
+        if (job->type == 2) {
+            uint8_t data[_BRTransactionWitnessData(tx, NULL, 0, i, forkId | SIGHASH_ALL, hashes)];
+            size_t dataLen = _BRTransactionWitnessData(tx, data, sizeof(data), i, forkId | SIGHASH_ALL, hashes);
             
-            BRSHA256_2(&md, data, dataLen);
-            sigLen = BRKeySign(&keys[j], sig, sizeof(sig) - 1, md);
-            sig[sigLen++] = forkId | SIGHASH_ALL;
-            scriptLen = BRScriptPushData(script, sizeof(script), sig, sigLen);
-            scriptLen += BRScriptPushData(&script[scriptLen], sizeof(script) - scriptLen, pubKey, pkLen);
-            BRTxInputSetSignature(input, script, 0);
-            BRTxInputSetWitness(input, script, scriptLen);
+            BRSHA256_2(&job->md, data, dataLen);
         }
-        else if (elemsCount >= 2 && *elems[elemsCount - 2] == OP_EQUALVERIFY) { // pay-to-pubkey-hash
-            uint8_t data[_BRTransactionData(tx, NULL, 0, i, forkId | SIGHASH_ALL)];
-            size_t dataLen = _BRTransactionData(tx, data, sizeof(data), i, forkId | SIGHASH_ALL);
+        else {
+            uint8_t data[_BRTransactionData(tx, NULL, 0, i, forkId | SIGHASH_ALL, (hashesSet) ? hashes : NULL)];
+            size_t dataLen = _BRTransactionData(tx, data, sizeof(data), i, forkId | SIGHASH_ALL,
+                                                (hashesSet) ? hashes : NULL);
             
-            BRSHA256_2(&md, data, dataLen);
-            sigLen = BRKeySign(&keys[j], sig, sizeof(sig) - 1, md);
-            sig[sigLen++] = forkId | SIGHASH_ALL;
-            scriptLen = BRScriptPushData(script, sizeof(script), sig, sigLen);
+            BRSHA256_2(&job->md, data, dataLen);
+        }
+    }
+    
+    if (threadCount == 0) threadCount = (cpus > 0) ? (size_t)cpus : 1;
+    if (threadCount > SIGN_MAX_THREADS) threadCount = SIGN_MAX_THREADS;
+    if (threadCount > jobsCount/SIGN_MIN_PER_THREAD) threadCount = jobsCount/SIGN_MIN_PER_THREAD;
+    if (threadCount == 0) threadCount = 1;
+    
+    _BRTxSignRun runs[threadCount];
+    pthread_t threads[threadCount];
+    int started[threadCount];
+    
+    for (i = 0; i < threadCount; i++) {
+        size_t off = jobsCount*i/threadCount;
+        
+        runs[i] = (_BRTxSignRun) { &jobs[off], jobsCount*(i + 1)/threadCount - off, keys };
+        // the calling thread takes the first run, and any run a worker thread couldn't be started for
+        started[i] = (i > 0 && pthread_create(&threads[i], NULL, _BRTransactionSignRoutine, &runs[i]) == 0);
+    }
+    
+    for (i = 0; i < threadCount; i++) {
+        if (! started[i]) _BRTransactionSignRoutine(&runs[i]);
+    }
+    
+    for (i = 0; i < threadCount; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+    
+    for (i = 0; i < jobsCount; i++) {
+        _BRTxSignJob *job = &jobs[i];
+        BRTxInput *input = &tx->inputs[job->input];
+        uint8_t pubKey[BRKeyPubKey(&keys[job->key], NULL, 0)];
+        size_t pkLen = BRKeyPubKey(&keys[job->key], pubKey, sizeof(pubKey));
+        uint8_t script[1 + sizeof(job->sig) + 1 + sizeof(pubKey)];
+        size_t scriptLen;
+        
+        job->sig[job->sigLen++] = forkId | SIGHASH_ALL;
+        scriptLen = BRScriptPushData(script, sizeof(script), job->sig, job->sigLen);
+        
+        if (job->type != 0) { // pay-to-pubkey-hash and pay-to-witness-pubkey-hash
             scriptLen += BRScriptPushData(&script[scriptLen], sizeof(script) - scriptLen, pubKey, pkLen);
-            BRTxInputSetSignature(input, script, scriptLen);
-            BRTxInputSetWitness(input, script, 0);
         }
-        else { // pay-to-pubkey
-            uint8_t data[_BRTransactionData(tx, NULL, 0, i, forkId | SIGHASH_ALL)];
-            size_t dataLen = _BRTransactionData(tx, data, sizeof(data), i, forkId | SIGHASH_ALL);
-
-            BRSHA256_2(&md, data, dataLen);
-            sigLen = BRKeySign(&keys[j], sig, sizeof(sig) - 1, md);
-            sig[sigLen++] = forkId | SIGHASH_ALL;
-            scriptLen = BRScriptPushData(script, sizeof(script), sig, sigLen);
+        
+        if (job->type == 2) {
+            BRTxInputSetSignature(input, script, 0);
+            BRTxInputSetWitness(input, script, scriptLen);
+        }
+        else {
             BRTxInputSetSignature(input, script, scriptLen);
             BRTxInputSetWitness(input, script, 0);
         }
     }
     
+    if (jobs) free(jobs);
+    
     if (tx && BRTransactionIsSigned(tx)) {
-        uint8_t data[BRTransactionSerialize(tx, NULL, 0)];
-        size_t len = BRTransactionSerialize(tx, data, sizeof(data));
-        BRTransaction *t = BRTransactionParse(data, len);
+        size_t len = BRTransactionSerialize(tx, NULL, 0);
+        uint8_t *data = malloc(len);
+        BRTransaction *t;
         
+        assert(data != NULL);
+        len = BRTransactionSerialize(tx, data, len);
+        t = BRTransactionParse(data, len);
         if (t) tx->txHash = t->txHash, tx->wtxHash = t->wtxHash;
         if (t) BRTransactionFree(t);
+        
+        // the signed tx is serialized again to publish, persist and size it, so the bytes just hashed are kept
+        if (t) tx->vsize = BRTransactionVSize(tx), tx->raw = data, tx->rawLen = len;
+        else free(data);
         return 1;
     }
     else return 0;
@@ -725,11 +1165,33 @@ int BRTransactionIsStandard(const BRTransaction *tx)
 }
 
 // frees memory allocated for tx
+// returns the bytes of memory held by tx, including its inputs, outputs, scripts, signatures and witnesses (for an
+// arena tx, the part of its allocation they use)
+size_t BRTransactionMemoryUsage(const BRTransaction *tx)
+{
+    size_t size;
+    
+    assert(tx != NULL);
+    size = sizeof(*tx) + array_heap_size(tx->inputs) + array_heap_size(tx->outputs) + tx->rawLen;
+    
+    for (size_t i = 0; i < tx->inCount; i++) {
+        size += array_heap_size(tx->inputs[i].script) + array_heap_size(tx->inputs[i].signature) +
+                array_heap_size(tx->inputs[i].witness);
+    }
+    
+    for (size_t i = 0; i < tx->outCount; i++) {
+        size += array_heap_size(tx->outputs[i].script);
+    }
+    
+    return size;
+}
+
 void BRTransactionFree(BRTransaction *tx)
 {
     assert(tx != NULL);
+    if (tx && tx->raw) free(tx->raw);
     
-    if (tx) {
+    if (tx && ! tx->arena) {
         for (size_t i = 0; i < tx->inCount; i++) {
             BRTxInputSetScript(&tx->inputs[i], NULL, 0);
             BRTxInputSetSignature(&tx->inputs[i], NULL, 0);
@@ -742,6 +1204,7 @@ void BRTransactionFree(BRTransaction *tx)
 
         array_free(tx->outputs);
         array_free(tx->inputs);
-        free(tx);
     }
+    
+    if (tx) free(tx); // an arena tx's inputs, outputs and scripts are freed along with it
 }
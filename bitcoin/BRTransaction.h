@@ -90,6 +90,12 @@ typedef struct {
     uint32_t lockTime;
     uint32_t blockHeight;
     uint32_t timestamp; // time interval since unix epoch
+    uint32_t arena; // true if inputs, outputs and scripts share the tx allocation, see BRTransactionParseArena()
+    uint32_t depth, depthGen; // scratch variables, used by BRWallet to cache the tx's dependency depth
+    uint64_t sent, received, fee; // scratch variables, used by BRWallet to cache the tx's amounts
+    uint32_t amountsGen; // the BRWallet generation sent, received and fee were cached for, or 0 if they aren't
+    uint8_t *raw; // serialization cached by BRTransactionSign(), cleared when tx is modified through this api
+    size_t rawLen, vsize; // length of raw and the signed tx's virtual size, valid while raw isn't NULL
 } BRTransaction;
 
 // returns a newly allocated empty transaction that must be freed by calling BRTransactionFree()
@@ -102,6 +108,37 @@ BRTransaction *BRTransactionCopy(const BRTransaction *tx);
 // retruns a transaction that must be freed by calling BRTransactionFree()
 BRTransaction *BRTransactionParse(const uint8_t *buf, size_t bufLen);
 
+// same as BRTransactionParse(), except the tx, its inputs and outputs, and all their scripts, signatures and witnesses
+// are allocated as a single block that BRTransactionFree() releases with one call to free()
+// (adding inputs or outputs, or signing tx moves them back to separate allocations, but the BRTxInputSet*() and
+// BRTxOutputSet*() functions must not be called directly on the inputs or outputs of an arena tx)
+BRTransaction *BRTransactionParseArena(const uint8_t *buf, size_t bufLen);
+
+// a read-only view of a serialized tx that refers to scripts, signatures and witnesses in place
+typedef struct {
+    const uint8_t *buf; // the serialized tx, which must remain valid for as long as the view is used
+    size_t bufLen;
+    UInt256 txHash, wtxHash; // UINT256_ZERO if the tx is unsigned
+    uint32_t version;
+    size_t inCount, inOff; // offset in buf of the first input
+    size_t outCount, outOff; // offset in buf of the first output
+    uint32_t lockTime;
+} BRTransactionView;
+
+// indexes the serialized tx in buf without copying it, and computes its txHash and wtxHash
+// returns true if buf contains a valid serialized tx
+int BRTransactionViewParse(BRTransactionView *view, const uint8_t *buf, size_t bufLen);
+
+// reads the input at offset off in view->buf, starting with view->inOff, and returns the offset of the next input
+// script points into view->buf, and is the input's signature script, or scriptPubKey if the tx is unsigned
+size_t BRTransactionViewInput(const BRTransactionView *view, size_t off, UInt256 *txHash, uint32_t *index,
+                              const uint8_t **script, size_t *scriptLen);
+
+// reads the output at offset off in view->buf, starting with view->outOff, and returns the offset of the next output
+// script points into view->buf
+size_t BRTransactionViewOutput(const BRTransactionView *view, size_t off, uint64_t *amount, const uint8_t **script,
+                               size_t *scriptLen);
+
 // returns number of bytes written to buf, or total bufLen needed if buf is NULL
 // (tx->blockHeight and tx->timestamp are not serialized)
 size_t BRTransactionSerialize(const BRTransaction *tx, uint8_t *buf, size_t bufLen);
@@ -134,6 +171,9 @@ int BRTransactionIsSigned(const BRTransaction *tx);
 // returns true if tx is signed
 int BRTransactionSign(BRTransaction *tx, int forkId, BRKey keys[], size_t keysCount);
 
+// same as BRTransactionSign(), but signs inputs in parallel on up to threadCount threads, 0 for one per online cpu
+int BRTransactionSignThreads(BRTransaction *tx, int forkId, BRKey keys[], size_t keysCount, size_t threadCount);
+
 // true if tx meets IsStandard() rules: https://bitcoin.org/en/developer-guide#standard-transactions
 int BRTransactionIsStandard(const BRTransaction *tx);
 
@@ -149,6 +189,10 @@ inline static int BRTransactionEq(const void *tx, const void *otherTx)
     return (tx == otherTx || UInt256Eq(((const BRTransaction *)tx)->txHash, ((const BRTransaction *)otherTx)->txHash));
 }
 
+// returns the bytes of memory held by tx, including its inputs, outputs, scripts, signatures and witnesses (for an
+// arena tx, the part of its allocation they use)
+size_t BRTransactionMemoryUsage(const BRTransaction *tx);
+
 // frees memory allocated for tx
 void BRTransactionFree(BRTransaction *tx);
 
@@ -24,15 +24,26 @@
 
 #include "BRWallet.h"
 #include "BRSet.h"
+#include "BRConcurrentSet.h"
 #include "BRAddress.h"
 #include "BRArray.h"
+#include "BRStats.h"
 #include <stdlib.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <float.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
 #include <assert.h>
 
+#define DERIVE_MAX_THREADS    16
+#define DERIVE_MIN_PER_THREAD 32 // smaller runs of addresses derive faster than a thread can be started for them
+#define DERIVE_AHEAD_MAX      512 // most addresses derived past the gap limit in one run, when a chain is found used
+#define COIN_SELECT_MAX_TRIES 100000 // branch and bound search steps before falling back to accumulating inputs
+#define PREFILTER_BITS        (1 << 18) // 32KB bit array, small enough to stay in cache while scanning relayed txs
+#define WATCH_ONLY_CAPACITY   10 // initial capacity of a watch-only wallet's arrays and sets, in place of 100
+
 inline static size_t _pkhHash(const void *pkh)
 {
     return (size_t)UInt32GetLE(pkh);
@@ -43,6 +54,28 @@ inline static int _pkhEq(const void *pkh, const void *otherPkh)
     return UInt160Eq(UInt160Get(pkh), UInt160Get(otherPkh));
 }
 
+BR_SET_DEFINE(_BRTxSet, BRTransaction, BRTransactionHash, BRTransactionEq)
+BR_SET_DEFINE(_BRUTXOSet, BRUTXO, BRUTXOHash, BRUTXOEq)
+BR_SET_DEFINE(_BRPKHSet, UInt160, _pkhHash, _pkhEq)
+
+inline static size_t _txRecordHash(const void *record)
+{
+    return (size_t)((const BRWalletTxRecord *)record)->txHash.u32[0];
+}
+
+inline static int _txRecordEq(const void *record, const void *otherRecord)
+{
+    return (record == otherRecord || UInt256Eq(((const BRWalletTxRecord *)record)->txHash,
+                                               ((const BRWalletTxRecord *)otherRecord)->txHash));
+}
+
+BR_SET_DEFINE(_BRTxRecordSet, BRWalletTxRecord, _txRecordHash, _txRecordEq)
+
+inline static int _uint32Compare(const void *a, const void *b)
+{
+    return (*(const uint32_t *)a > *(const uint32_t *)b) - (*(const uint32_t *)a < *(const uint32_t *)b);
+}
+
 inline static uint64_t _txFee(uint64_t feePerKb, size_t size)
 {
     uint64_t standardFee = size*TX_FEE_PER_KB/1000,       // standard fee based on tx size
@@ -68,6 +101,7 @@ inline static size_t _txChainIndex(const BRTransaction *tx, const UInt160 *chain
 
 struct BRWalletStruct {
     uint64_t balance, totalSent, totalReceived, feePerKb, *balanceHist;
+    _Atomic uint64_t publishedBalance; // balance as of the last completed update, read by BRWalletBalance() unlocked
     uint32_t blockHeight;
     BRUTXO *utxos;
     BRTransaction **transactions;
@@ -75,11 +109,28 @@ struct BRWalletStruct {
     int forkId;
     UInt160 *internalChain, *externalChain;
     BRSet *allTx, *invalidTx, *pendingTx, *spentOutputs, *usedPKH, *allPKH;
+    BRConcurrentSet *txIndex; // allTx by txHash, for BRWalletTransactionForHash() to look up without wallet->lock
+    BRSet *reservedOutputs; // inputs of unpublished transactions still being signed, see BRWalletReserveTxInputs()
+    uint64_t *prefilter; // bits set for each allPKH hash and allTx txHash, never cleared, NULL if watchOnly
+    int watchOnly; // see BRWalletNewWatchOnly()
     void *callbackInfo;
     void (*balanceChanged)(void *info, uint64_t balance);
     void (*txAdded)(void *info, BRTransaction *tx);
     void (*txUpdated)(void *info, const UInt256 txHashes[], size_t txCount, uint32_t blockHeight, uint32_t timestamp);
     void (*txDeleted)(void *info, UInt256 txHash, int notifyUser, int recommendRescan);
+    int batchDepth, batchNeedsSort, batchNeedsUpdate; // see BRWalletBeginBatch()
+    uint64_t batchBalance; // balance when the batch began
+    BRTransaction **batchAdded;
+    UInt256 *batchUpdated, *batchRemoved;
+    uint64_t changeSeq; // incremented whenever wallet->transactions or their block heights change
+    uint32_t depthGen; // incremented whenever cached tx depths may be out of date, see _BRWalletTxDepth()
+    uint32_t amountsGen; // incremented whenever cached tx amounts may be out of date, see _BRWalletTxAmounts()
+    BRWalletIndex *index; // shared index the wallet's addresses and outputs are added to, see BRWalletIndexAddWallet()
+    BRWalletTxRecord *coldTx; // records of the transactions condensed by BRWalletCondenseTransactions(), oldest first
+    BRSet *coldTxIndex; // coldTx indexed by txHash, rebuilt whenever coldTx grows
+    BRUTXO *coldSpent; // wallet outputs spent by coldTx, sorted, so tx double spending them are still found invalid
+    UInt160 *coldPKH; // wallet addresses coldTx paid to, sorted, which stay in usedPKH
+    uint64_t coldSent, coldReceived; // totalSent and totalReceived through the last coldTx
     pthread_mutex_t lock;
 };
 
@@ -95,52 +146,228 @@ inline static void _BRWalletAddressFromHash160(BRWallet *wallet, char *addr, siz
     else BRAddressFromHash160(addr, addrLen, &h);
 }
 
-inline static int _BRWalletTxIsAscending(BRWallet *wallet, const BRTransaction *tx1, const BRTransaction *tx2)
+// returns the length of the longest chain of tx in wallet->allTx with the same block height that tx depends on
+// the result is cached in tx until wallet->depthGen changes, so each tx's inputs are only walked once per change
+static uint32_t _BRWalletTxDepth(BRWallet *wallet, BRTransaction *tx)
 {
-    if (! tx1 || ! tx2) return 0;
-    if (tx1->blockHeight > tx2->blockHeight) return 1;
-    if (tx1->blockHeight < tx2->blockHeight) return 0;
-    
-    for (size_t i = 0; i < tx1->inCount; i++) {
-        if (UInt256Eq(tx1->inputs[i].txHash, tx2->txHash)) return 1;
+    BRTransaction *t;
+    uint32_t depth = 0, d;
+
+    if (tx->depthGen == wallet->depthGen) return tx->depth;
+
+    for (size_t i = 0; i < tx->inCount; i++) {
+        t = _BRTxSetGet(wallet->allTx, &tx->inputs[i].txHash);
+        if (! t || t->blockHeight != tx->blockHeight) continue;
+        d = _BRWalletTxDepth(wallet, t) + 1;
+        if (d > depth) depth = d;
     }
-    
-    for (size_t i = 0; i < tx2->inCount; i++) {
-        if (UInt256Eq(tx2->inputs[i].txHash, tx1->txHash)) return 0;
+
+    tx->depth = depth;
+    tx->depthGen = wallet->depthGen;
+    return depth;
+}
+
+// invalidates cached tx depths and amounts if any tx may depend on tx, which was just added to wallet->allTx
+static void _BRWalletTxDepthAdded(BRWallet *wallet, const BRTransaction *tx)
+{
+    int found = (wallet->batchDepth > 0 || BRSetCount(wallet->invalidTx) > 0); // spentOutputs may be incomplete
+
+    for (uint32_t i = 0; ! found && i < tx->outCount; i++) {
+        found = _BRUTXOSetContains(wallet->spentOutputs, &((const BRUTXO) { tx->txHash, i }));
     }
 
-    for (size_t i = 0; i < tx1->inCount; i++) {
-        if (_BRWalletTxIsAscending(wallet, BRSetGet(wallet->allTx, &(tx1->inputs[i].txHash)), tx2)) return 1;
+    if (found) wallet->depthGen++;
+
+    // spentOutputs doesn't hold the inputs of allTx entries outside of wallet->transactions, any of which may spend tx
+    if (found || BRSetCount(wallet->allTx) > array_count(wallet->transactions) + 1) wallet->amountsGen++;
+}
+
+// sets the amounts tx sends from and receives to the wallet, and its fee, see BRWalletFeeForTx()
+// for a tx registered in wallet->allTx, the result is cached in tx until wallet->amountsGen changes, so rows of a
+// transaction history don't look up each input's source tx every time they're shown, wallet->lock must be held
+static void _BRWalletTxAmounts(BRWallet *wallet, const BRTransaction *tx, uint64_t *sent, uint64_t *received,
+                               uint64_t *fee)
+{
+    BRTransaction *t = _BRTxSetGet(wallet->allTx, tx), *in;
+    const uint8_t *pkh;
+    uint32_t n;
+    
+    if (t == tx && t->amountsGen == wallet->amountsGen) {
+        *sent = t->sent, *received = t->received, *fee = t->fee;
+        return;
     }
+    
+    *sent = *received = *fee = 0;
+    
+    for (size_t i = 0; i < tx->inCount; i++) {
+        in = _BRTxSetGet(wallet->allTx, &tx->inputs[i].txHash);
+        n = tx->inputs[i].index;
 
-    return 0;
+        if (in && n < in->outCount) {
+            pkh = BRScriptPKH(in->outputs[n].script, in->outputs[n].scriptLen);
+            if (pkh && _BRPKHSetContains(wallet->allPKH, pkh)) *sent += in->outputs[n].amount;
+            if (*fee != UINT64_MAX) *fee += in->outputs[n].amount;
+        }
+        else *fee = UINT64_MAX;
+    }
+    
+    // TODO: don't include outputs below TX_MIN_OUTPUT_AMOUNT
+    for (size_t i = 0; i < tx->outCount; i++) {
+        pkh = BRScriptPKH(tx->outputs[i].script, tx->outputs[i].scriptLen);
+        if (pkh && _BRPKHSetContains(wallet->allPKH, pkh)) *received += tx->outputs[i].amount;
+        if (*fee != UINT64_MAX) *fee -= tx->outputs[i].amount;
+    }
+    
+    if (t == tx) {
+        t->sent = *sent, t->received = *received, t->fee = *fee;
+        t->amountsGen = wallet->amountsGen;
+    }
 }
 
-inline static int _BRWalletTxCompare(BRWallet *wallet, const BRTransaction *tx1, const BRTransaction *tx2)
+// a tx sorts after any tx with the same block height that it depends on, since its depth is greater
+inline static int _BRWalletTxCompare(BRWallet *wallet, BRTransaction *tx1, BRTransaction *tx2)
 {
     size_t i = -1, j = -1;
+    uint32_t d1, d2;
 
-    if (_BRWalletTxIsAscending(wallet, tx1, tx2)) return 1;
-    if (_BRWalletTxIsAscending(wallet, tx2, tx1)) return -1;
+    if (tx1->blockHeight != tx2->blockHeight) return (tx1->blockHeight > tx2->blockHeight) ? 1 : -1;
+    d1 = _BRWalletTxDepth(wallet, tx1), d2 = _BRWalletTxDepth(wallet, tx2);
+    if (d1 != d2) return (d1 > d2) ? 1 : -1;
     if ((i = _txChainIndex(tx1, wallet->internalChain)) != -1) j = _txChainIndex(tx2, wallet->internalChain);
     if (j == -1 && (i = _txChainIndex(tx1, wallet->externalChain)) != -1) j = _txChainIndex(tx2, wallet->externalChain);
     if (i != -1 && j != -1 && i != j) return (i > j) ? 1 : -1;
     return 0;
 }
 
-// inserts tx into wallet->transactions, keeping wallet->transactions sorted by date, oldest first (insertion sort)
-inline static void _BRWalletInsertTx(BRWallet *wallet, BRTransaction *tx)
+// returns the index of the first tx in wallet->transactions with a block height of at least blockHeight (binary search)
+inline static size_t _BRWalletTxHeightIndex(BRWallet *wallet, uint32_t blockHeight)
 {
-    size_t i = array_count(wallet->transactions);
+    size_t lo = 0, hi = array_count(wallet->transactions), i;
+    
+    while (lo < hi) {
+        i = lo + (hi - lo)/2;
+        if (wallet->transactions[i]->blockHeight >= blockHeight) hi = i;
+        else lo = i + 1;
+    }
     
-    array_set_count(wallet->transactions, i + 1);
+    return lo;
+}
+
+// inserts tx into wallet->transactions, keeping wallet->transactions sorted by date, oldest first
+// since transactions are sorted by block height first, a binary search finds the run of tx at the same height, and only
+// those need the slower dependency and chain position comparisons
+inline static void _BRWalletInsertTx(BRWallet *wallet, BRTransaction *tx)
+{
+    size_t i = _BRWalletTxHeightIndex(wallet, tx->blockHeight + 1), n;
     
-    while (i > 0 && _BRWalletTxCompare(wallet, wallet->transactions[i - 1], tx) > 0) {
-        wallet->transactions[i] = wallet->transactions[i - 1];
-        i--;
+    for (; i > 0 && wallet->transactions[i - 1]->blockHeight == tx->blockHeight; i--) {
+        if (_BRWalletTxCompare(wallet, wallet->transactions[i - 1], tx) <= 0) break;
     }
     
+    n = array_count(wallet->transactions);
+    array_set_count(wallet->transactions, n + 1);
+    memmove(&wallet->transactions[i + 1], &wallet->transactions[i], (n - i)*sizeof(*wallet->transactions));
     wallet->transactions[i] = tx;
+    wallet->changeSeq++;
+}
+
+// re-sorts wallet->transactions after block heights were updated in a batch without moving the transactions
+static void _BRWalletSortTx(BRWallet *wallet)
+{
+    size_t count = array_count(wallet->transactions);
+    BRTransaction **txs = malloc((count + 1)*sizeof(*txs));
+
+    assert(txs != NULL);
+    memcpy(txs, wallet->transactions, count*sizeof(*txs));
+    array_clear(wallet->transactions);
+    for (size_t i = 0; i < count; i++) _BRWalletInsertTx(wallet, txs[i]); // mostly in order already, so mostly appends
+    wallet->batchNeedsSort = 0;
+    free(txs);
+}
+
+// key is a hash160 or sha256 digest, so its first 8 bytes are already uniformly distributed and need no rehashing
+inline static void _BRWalletPrefilterAdd(BRWallet *wallet, const void *key)
+{
+    uint32_t a = UInt32GetLE(key) % PREFILTER_BITS, b = UInt32GetLE((const uint8_t *)key + 4) % PREFILTER_BITS;
+    
+    if (! wallet->prefilter) return;
+    wallet->prefilter[a/64] |= 1ULL << (a % 64);
+    wallet->prefilter[b/64] |= 1ULL << (b % 64);
+}
+
+// returns false if key was never added to the prefilter, or true if it might have been, or if there's no prefilter
+inline static int _BRWalletPrefilterContains(BRWallet *wallet, const void *key)
+{
+    uint32_t a = UInt32GetLE(key) % PREFILTER_BITS, b = UInt32GetLE((const uint8_t *)key + 4) % PREFILTER_BITS;
+    
+    if (! wallet->prefilter) return 1;
+    return ((wallet->prefilter[a/64] >> (a % 64)) & (wallet->prefilter[b/64] >> (b % 64)) & 1);
+}
+
+inline static int _BRUTXOCompare(const void *a, const void *b)
+{
+    const BRUTXO *o1 = a, *o2 = b;
+    int r = memcmp(&o1->hash, &o2->hash, sizeof(UInt256));
+
+    return (r != 0 || o1->n == o2->n) ? r : (o1->n > o2->n) ? 1 : -1;
+}
+
+inline static int _pkhCompare(const void *a, const void *b)
+{
+    return memcmp(a, b, sizeof(UInt160));
+}
+
+// an entry of wallet->txIndex, which the wallet frees once no lookup could still be reading it
+typedef struct {
+    UInt256 txHash; // first, so a txHash is looked up directly
+    BRTransaction *tx;
+} _BRTxIndexEntry;
+
+inline static size_t _txIndexHash(const void *entry)
+{
+    return (size_t)((const UInt256 *)entry)->u32[0];
+}
+
+inline static int _txIndexEq(const void *entry, const void *otherEntry)
+{
+    return (entry == otherEntry || UInt256Eq(*(const UInt256 *)entry, *(const UInt256 *)otherEntry));
+}
+
+static void *_txIndexTx(void *entry)
+{
+    return ((_BRTxIndexEntry *)entry)->tx;
+}
+
+// adds tx, just added to wallet->allTx, to wallet->txIndex
+static void _BRWalletTxIndexAdd(BRWallet *wallet, BRTransaction *tx)
+{
+    _BRTxIndexEntry *entry = malloc(sizeof(*entry));
+
+    assert(entry != NULL);
+    entry->txHash = tx->txHash;
+    entry->tx = tx;
+    BRConcurrentSetAddAndFree(wallet->txIndex, entry, free);
+}
+
+// removes tx, just removed from wallet->allTx, from wallet->txIndex
+static void _BRWalletTxIndexRemove(BRWallet *wallet, const BRTransaction *tx)
+{
+    BRConcurrentSetRemoveAndFree(wallet->txIndex, &tx->txHash, free);
+}
+
+// true if txHash is the hash of a tx condensed by BRWalletCondenseTransactions()
+inline static int _BRWalletIsColdTx(BRWallet *wallet, UInt256 txHash)
+{
+    return (array_count(wallet->coldTx) > 0 && _BRTxRecordSetContains(wallet->coldTxIndex, &txHash));
+}
+
+// true if the output hash:n is a wallet output spent by a tx condensed by BRWalletCondenseTransactions()
+static int _BRWalletIsColdSpent(BRWallet *wallet, UInt256 hash, uint32_t n)
+{
+    BRUTXO o = { hash, n };
+    
+    return (array_count(wallet->coldSpent) > 0 &&
+            bsearch(&o, wallet->coldSpent, array_count(wallet->coldSpent), sizeof(o), _BRUTXOCompare) != NULL);
 }
 
 // non-threadsafe version of BRWalletContainsTransaction()
@@ -149,30 +376,181 @@ static int _BRWalletContainsTx(BRWallet *wallet, const BRTransaction *tx)
     int r = 0;
     const uint8_t *pkh;
     
+    if (_BRWalletIsColdTx(wallet, tx->txHash)) return 0; // already condensed, there's nothing left to register
+    
     for (size_t i = 0; ! r && i < tx->outCount; i++) {
         pkh = BRScriptPKH(tx->outputs[i].script, tx->outputs[i].scriptLen);
-        if (pkh && BRSetContains(wallet->allPKH, pkh)) r = 1;
+        if (pkh && _BRWalletPrefilterContains(wallet, pkh) && _BRPKHSetContains(wallet->allPKH, pkh)) r = 1;
     }
     
     for (size_t i = 0; ! r && i < tx->inCount; i++) {
-        BRTransaction *t = BRSetGet(wallet->allTx, &tx->inputs[i].txHash);
+        if (! _BRWalletPrefilterContains(wallet, &tx->inputs[i].txHash)) continue; // spends a tx not in allTx
+        
+        BRTransaction *t = _BRTxSetGet(wallet->allTx, &tx->inputs[i].txHash);
         uint32_t n = tx->inputs[i].index;
         
         pkh = (t && n < t->outCount) ? BRScriptPKH(t->outputs[n].script, t->outputs[n].scriptLen) : NULL;
-        if (pkh && BRSetContains(wallet->allPKH, pkh)) r = 1;
+        if (pkh && _BRPKHSetContains(wallet->allPKH, pkh)) r = 1;
     }
     
     return r;
 }
 
-static void _BRWalletUpdateBalance(BRWallet *wallet)
+typedef struct {
+    uint8_t key[36]; // a 20 byte pkh, or a 32 byte txHash followed by a 4 byte little endian output index
+    size_t keyLen;
+    BRWallet **wallets;
+} _BRWalletIndexEntry;
+
+struct BRWalletIndexStruct {
+    BRSet *entries;
+    pthread_mutex_t lock;
+};
+
+inline static size_t _BRWalletIndexEntryHash(const void *entry)
+{
+    const uint8_t *key = ((const _BRWalletIndexEntry *)entry)->key;
+    
+    // (hash xor n)*FNV_PRIME, n is zero for pkh entries
+    return (size_t)((UInt32GetLE(key) ^ UInt32GetLE(&key[32]))*0x01000193);
+}
+
+inline static int _BRWalletIndexEntryEq(const void *entry, const void *otherEntry)
+{
+    const _BRWalletIndexEntry *e = entry, *o = otherEntry;
+    
+    return (e == o || (e->keyLen == o->keyLen && memcmp(e->key, o->key, e->keyLen) == 0));
+}
+
+// adds wallet to the index entry for key, index->lock must not be held
+static void _BRWalletIndexAdd(BRWalletIndex *index, const void *key, size_t keyLen, BRWallet *wallet)
+{
+    _BRWalletIndexEntry e = { { 0 }, keyLen, NULL }, *entry;
+    size_t i;
+    
+    assert(keyLen <= sizeof(e.key));
+    memcpy(e.key, key, keyLen);
+    pthread_mutex_lock(&index->lock);
+    entry = BRSetGet(index->entries, &e);
+    
+    if (! entry) {
+        entry = malloc(sizeof(*entry));
+        assert(entry != NULL);
+        *entry = e;
+        array_new(entry->wallets, 1);
+        BRSetAdd(index->entries, entry);
+    }
+    
+    for (i = array_count(entry->wallets); i > 0 && entry->wallets[i - 1] != wallet; i--);
+    if (i == 0) array_add(entry->wallets, wallet);
+    pthread_mutex_unlock(&index->lock);
+}
+
+// adds the outputs of wallet tx that pay to wallet addresses to wallet->index, so tx spending them can be routed
+static void _BRWalletIndexAddTx(BRWallet *wallet, const BRTransaction *tx)
+{
+    uint8_t key[sizeof(UInt256) + sizeof(uint32_t)];
+    const uint8_t *pkh;
+    
+    UInt256Set(key, tx->txHash);
+    
+    for (uint32_t i = 0; wallet->index && i < tx->outCount; i++) {
+        pkh = BRScriptPKH(tx->outputs[i].script, tx->outputs[i].scriptLen);
+        if (! pkh || ! _BRPKHSetContains(wallet->allPKH, pkh)) continue;
+        UInt32SetLE(&key[sizeof(UInt256)], i);
+        _BRWalletIndexAdd(wallet->index, key, sizeof(key), wallet);
+    }
+}
+
+// applies tx, the next transaction in wallet->transactions, to the wallet balance, UTXOs and spent outputs, or adds it
+// to the invalid or pending tx sets, and appends the resulting balance to wallet->balanceHist
+static void _BRWalletApplyTx(BRWallet *wallet, BRTransaction *tx, time_t now)
 {
     int isInvalid, isPending;
-    uint64_t balance = 0, prevBalance = 0;
-    time_t now = time(NULL);
-    size_t i, j;
-    BRTransaction *tx, *t;
+    uint64_t balance = wallet->balance, prevBalance = wallet->balance;
+    size_t j;
+    BRTransaction *t;
     const uint8_t *pkh;
+
+    // check if any inputs are invalid or already spent
+    if (tx->blockHeight == TX_UNCONFIRMED) {
+        for (j = 0, isInvalid = 0; ! isInvalid && j < tx->inCount; j++) {
+            if (_BRUTXOSetContains(wallet->spentOutputs, &tx->inputs[j]) ||
+                _BRWalletIsColdSpent(wallet, tx->inputs[j].txHash, tx->inputs[j].index) ||
+                _BRTxSetContains(wallet->invalidTx, &tx->inputs[j].txHash)) isInvalid = 1;
+        }
+    
+        if (isInvalid) {
+            _BRTxSetAdd(wallet->invalidTx, tx);
+            array_add(wallet->balanceHist, balance);
+            return;
+        }
+    }
+
+    // add inputs to spent output set
+    for (j = 0; j < tx->inCount; j++) {
+        _BRUTXOSetAdd(wallet->spentOutputs, &tx->inputs[j]);
+    }
+
+    // check if tx is pending
+    if (tx->blockHeight == TX_UNCONFIRMED) {
+        isPending = (BRTransactionVSize(tx) > TX_MAX_SIZE) ? 1 : 0; // check tx size is under TX_MAX_SIZE
+        
+        for (j = 0; ! isPending && j < tx->outCount; j++) {
+            if (tx->outputs[j].amount < TX_MIN_OUTPUT_AMOUNT) isPending = 1; // check that no outputs are dust
+        }
+
+        for (j = 0; ! isPending && j < tx->inCount; j++) {
+            if (tx->inputs[j].sequence < UINT32_MAX - 1) isPending = 1; // check for replace-by-fee
+            if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime < TX_MAX_LOCK_HEIGHT &&
+                tx->lockTime > wallet->blockHeight + 1) isPending = 1; // future lockTime
+            if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime > now) isPending = 1; // future lockTime
+            if (_BRTxSetContains(wallet->pendingTx, &tx->inputs[j].txHash)) isPending = 1; // check for pending inputs
+            // TODO: XXX handle BIP68 check lock time verify rules
+        }
+        
+        if (isPending) {
+            _BRTxSetAdd(wallet->pendingTx, tx);
+            array_add(wallet->balanceHist, balance);
+            return;
+        }
+    }
+
+    // add outputs to UTXO set
+    // TODO: don't add outputs below TX_MIN_OUTPUT_AMOUNT
+    // TODO: don't add coin generation outputs < 100 blocks deep
+    // NOTE: balance/UTXOs will then need to be recalculated when last block changes
+    for (j = 0; j < tx->outCount; j++) {
+        if (tx->outputs[j].address[0] != '\0') {
+            pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
+
+            if (pkh && _BRPKHSetContains(wallet->allPKH, pkh)) {
+                _BRPKHSetAdd(wallet->usedPKH, (void *)pkh);
+                array_add(wallet->utxos, ((const BRUTXO) { tx->txHash, (uint32_t)j }));
+                balance += tx->outputs[j].amount;
+            }
+        }
+    }
+
+    // transaction ordering is not guaranteed, so check the entire UTXO set against the entire spent output set
+    for (j = array_count(wallet->utxos); j > 0; j--) {
+        if (! _BRUTXOSetContains(wallet->spentOutputs, &wallet->utxos[j - 1])) continue;
+        t = _BRTxSetGet(wallet->allTx, &wallet->utxos[j - 1].hash);
+        balance -= t->outputs[wallet->utxos[j - 1].n].amount;
+        array_rm(wallet->utxos, j - 1);
+    }
+    
+    if (prevBalance < balance) wallet->totalReceived += balance - prevBalance;
+    if (balance < prevBalance) wallet->totalSent += prevBalance - balance;
+    array_add(wallet->balanceHist, balance);
+    wallet->balance = balance;
+}
+
+// recalculates the wallet balance by replaying every transaction in wallet->transactions
+// condensed tx left no UTXOs behind, so the replay starts from a zero balance with only their totals and used addresses
+static void _BRWalletUpdateBalance(BRWallet *wallet)
+{
+    time_t now = time(NULL);
     
     array_clear(wallet->utxos);
     array_clear(wallet->balanceHist);
@@ -180,291 +558,1080 @@ static void _BRWalletUpdateBalance(BRWallet *wallet)
     BRSetClear(wallet->invalidTx);
     BRSetClear(wallet->pendingTx);
     BRSetClear(wallet->usedPKH);
-    wallet->totalSent = 0;
-    wallet->totalReceived = 0;
+    wallet->balance = 0;
+    wallet->totalSent = wallet->coldSent;
+    wallet->totalReceived = wallet->coldReceived;
+    for (size_t i = 0; i < array_count(wallet->coldPKH); i++) _BRPKHSetAdd(wallet->usedPKH, &wallet->coldPKH[i]);
+
+    for (size_t i = 0; i < array_count(wallet->transactions); i++) {
+        _BRWalletApplyTx(wallet, wallet->transactions[i], now);
+    }
+
+    assert(array_count(wallet->balanceHist) == array_count(wallet->transactions));
+    atomic_store_explicit(&wallet->publishedBalance, wallet->balance, memory_order_release);
+}
+
+// updates the wallet balance after tx was inserted into wallet->transactions
+// when tx sorted last, none of the earlier transactions are affected by it, so only tx itself needs to be applied, as
+// long as there are no pending tx whose lockTimes have to be rechecked against the current time and block height
+static void _BRWalletUpdateBalanceForTx(BRWallet *wallet, BRTransaction *tx)
+{
+    size_t count = array_count(wallet->transactions);
+    
+    if (count > 0 && wallet->transactions[count - 1] == tx && array_count(wallet->balanceHist) + 1 == count &&
+        BRSetCount(wallet->pendingTx) == 0) {
+        _BRWalletApplyTx(wallet, tx, time(NULL));
+        atomic_store_explicit(&wallet->publishedBalance, wallet->balance, memory_order_release);
+    }
+    else _BRWalletUpdateBalance(wallet);
+}
+
+#define WALLET_SUMMARY_VERSION 2
+#define WALLET_SUMMARY_TX_SIZE (sizeof(UInt256) + sizeof(uint32_t) + sizeof(uint64_t)) // txHash, height, balance
+#define WALLET_SUMMARY_UTXO_SIZE (sizeof(UInt256) + sizeof(uint32_t))
+
+// the sections of a summary written by BRWalletSerializeSummary(), each pointing into the summary
+typedef struct {
+    const uint8_t *txs, *totals, *utxos, *chains;
+    size_t txCount, utxoCount, externalCount, internalCount;
+} _BRWalletSummary;
+
+// the summary checksum commits to the master pubkey the chains were derived from, as well as to the summary itself
+static UInt256 _BRWalletSummaryChecksum(BRMasterPubKey mpk, const uint8_t *summary, size_t summaryLen)
+{
+    uint8_t buf[sizeof(uint32_t) + sizeof(UInt256) + sizeof(mpk.pubKey) + sizeof(UInt256)];
+    UInt256 md;
+
+    UInt32SetLE(buf, mpk.fingerPrint);
+    UInt256Set(&buf[sizeof(uint32_t)], mpk.chainCode);
+    memcpy(&buf[sizeof(uint32_t) + sizeof(UInt256)], mpk.pubKey, sizeof(mpk.pubKey));
+    BRSHA256(&buf[sizeof(buf) - sizeof(UInt256)], summary, summaryLen);
+    BRSHA256_2(&md, buf, sizeof(buf));
+    return md;
+}
+
+// returns true if summary is a complete, uncorrupted summary written for mpk, and sets the sections of s
+static int _BRWalletSummaryParse(_BRWalletSummary *s, const uint8_t *summary, size_t summaryLen, BRMasterPubKey mpk)
+{
+    size_t off = sizeof(uint32_t)*2, len = summaryLen - sizeof(UInt256);
+
+    if (! summary || summaryLen < off + sizeof(UInt256) || UInt32GetLE(summary) != WALLET_SUMMARY_VERSION ||
+        ! UInt256Eq(UInt256Get(&summary[len]), _BRWalletSummaryChecksum(mpk, summary, len))) return 0;
+    s->txCount = UInt32GetLE(&summary[sizeof(uint32_t)]);
+    s->txs = &summary[off];
+    if ((len - off)/WALLET_SUMMARY_TX_SIZE < s->txCount) return 0;
+    off += s->txCount*WALLET_SUMMARY_TX_SIZE;
+    s->totals = &summary[off];
+    off += sizeof(uint64_t)*3;
+    if (off + sizeof(uint32_t) > len) return 0;
+    s->utxoCount = UInt32GetLE(&summary[off]);
+    off += sizeof(uint32_t);
+    s->utxos = &summary[off];
+    if ((len - off)/WALLET_SUMMARY_UTXO_SIZE < s->utxoCount) return 0;
+    off += s->utxoCount*WALLET_SUMMARY_UTXO_SIZE;
+    if (off + sizeof(uint32_t)*2 > len) return 0;
+    s->externalCount = UInt32GetLE(&summary[off]);
+    s->internalCount = UInt32GetLE(&summary[off + sizeof(uint32_t)]);
+    off += sizeof(uint32_t)*2;
+    s->chains = &summary[off];
+    return ((len - off)/sizeof(UInt160) >= s->externalCount &&
+            (len - off)/sizeof(UInt160) - s->externalCount == s->internalCount &&
+            (len - off) % sizeof(UInt160) == 0);
+}
+
+// returns true if the summary lists exactly the tx in wallet->allTx at their current block heights, with none of them
+// unconfirmed, and the UTXOs are outputs of those tx, in which case wallet->transactions is put in the summary's order,
+// otherwise leaves wallet->transactions unchanged
+static int _BRWalletSummaryTxOrder(BRWallet *wallet, const _BRWalletSummary *s)
+{
+    size_t count = array_count(wallet->transactions), i;
+    BRTransaction *tx, **txs;
+    BRSet *seen;
+    const uint8_t *u;
+    UInt256 hash;
+    int r = (s->txCount == count);
+
+    txs = malloc((count + 1)*sizeof(*txs));
+    seen = BRSetNew(BRTransactionHash, BRTransactionEq, count);
+    assert(txs != NULL);
+
+    for (i = 0; r && i < count; i++) {
+        hash = UInt256Get(&s->txs[i*WALLET_SUMMARY_TX_SIZE]);
+        txs[i] = tx = _BRTxSetGet(wallet->allTx, &hash);
+        if (! tx || tx->blockHeight == TX_UNCONFIRMED || _BRTxSetAdd(seen, tx) != NULL ||
+            tx->blockHeight != UInt32GetLE(&s->txs[i*WALLET_SUMMARY_TX_SIZE + sizeof(UInt256)])) r = 0;
+    }
+
+    for (i = 0; r && i < s->utxoCount; i++) {
+        u = &s->utxos[i*WALLET_SUMMARY_UTXO_SIZE];
+        hash = UInt256Get(u);
+        tx = _BRTxSetGet(wallet->allTx, &hash);
+        if (! tx || UInt32GetLE(&u[sizeof(UInt256)]) >= tx->outCount) r = 0;
+    }
+
+    if (r) {
+        memcpy(wallet->transactions, txs, count*sizeof(*txs));
+        wallet->changeSeq++;
+    }
+
+    BRSetFree(seen);
+    free(txs);
+    return r;
+}
+
+// appends the summary's derived pubkey-hashes to the wallet's empty chains, in place of deriving them again
+static void _BRWalletSummaryChains(BRWallet *wallet, const _BRWalletSummary *s)
+{
+    assert(array_count(wallet->externalChain) == 0 && array_count(wallet->internalChain) == 0);
+    array_add_array(wallet->externalChain, (const UInt160 *)s->chains, s->externalCount);
+    array_add_array(wallet->internalChain, (const UInt160 *)s->chains + s->externalCount, s->internalCount);
+
+    for (size_t i = array_count(wallet->internalChain); i > 0; i--) {
+        _BRWalletPrefilterAdd(wallet, &wallet->internalChain[i - 1]);
+        _BRPKHSetAdd(wallet->allPKH, &wallet->internalChain[i - 1]);
+    }
+
+    for (size_t i = array_count(wallet->externalChain); i > 0; i--) {
+        _BRWalletPrefilterAdd(wallet, &wallet->externalChain[i - 1]);
+        _BRPKHSetAdd(wallet->allPKH, &wallet->externalChain[i - 1]);
+    }
+}
+
+// restores the balance, balance history, UTXOs and spent outputs from a summary _BRWalletSummaryTxOrder() accepted, in
+// place of replaying every tx with _BRWalletUpdateBalance(), which gives the same result since no tx is unconfirmed
+// spentOutputs and usedPKH hold pointers into the transactions, so they're rebuilt from them rather than stored
+static void _BRWalletSummaryBalance(BRWallet *wallet, const _BRWalletSummary *s)
+{
+    BRTransaction *tx;
+    const uint8_t *pkh, *u;
+
+    array_clear(wallet->balanceHist);
+    BRSetClear(wallet->usedPKH);
 
-    for (i = 0; i < array_count(wallet->transactions); i++) {
+    for (size_t i = 0; i < s->txCount; i++) {
         tx = wallet->transactions[i];
+        array_add(wallet->balanceHist, UInt64GetLE(&s->txs[i*WALLET_SUMMARY_TX_SIZE + sizeof(UInt256) +
+                                                            sizeof(uint32_t)]));
+        for (size_t j = 0; j < tx->inCount; j++) _BRUTXOSetAdd(wallet->spentOutputs, &tx->inputs[j]);
 
-        // check if any inputs are invalid or already spent
-        if (tx->blockHeight == TX_UNCONFIRMED) {
-            for (j = 0, isInvalid = 0; ! isInvalid && j < tx->inCount; j++) {
-                if (BRSetContains(wallet->spentOutputs, &tx->inputs[j]) ||
-                    BRSetContains(wallet->invalidTx, &tx->inputs[j].txHash)) isInvalid = 1;
-            }
-        
-            if (isInvalid) {
-                BRSetAdd(wallet->invalidTx, tx);
-                array_add(wallet->balanceHist, balance);
-                continue;
-            }
+        for (size_t j = 0; j < tx->outCount; j++) {
+            pkh = (tx->outputs[j].address[0] != '\0') ?
+                  BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen) : NULL;
+            if (pkh && _BRPKHSetContains(wallet->allPKH, pkh)) _BRPKHSetAdd(wallet->usedPKH, (void *)pkh);
         }
+    }
 
-        // add inputs to spent output set
-        for (j = 0; j < tx->inCount; j++) {
-            BRSetAdd(wallet->spentOutputs, &tx->inputs[j]);
+    wallet->balance = UInt64GetLE(s->totals);
+    wallet->totalSent = UInt64GetLE(&s->totals[sizeof(uint64_t)]);
+    wallet->totalReceived = UInt64GetLE(&s->totals[sizeof(uint64_t)*2]);
+    atomic_store_explicit(&wallet->publishedBalance, wallet->balance, memory_order_release);
+    array_clear(wallet->utxos);
+
+    for (size_t i = 0; i < s->utxoCount; i++) {
+        u = &s->utxos[i*WALLET_SUMMARY_UTXO_SIZE];
+        array_add(wallet->utxos, ((const BRUTXO) { UInt256Get(u), UInt32GetLE(&u[sizeof(UInt256)]) }));
+    }
+}
+
+// allocates and populates a BRWallet struct which must be freed by calling BRWalletFree()
+// forkId is 0 for bitcoin, 0x40 for b-cash
+BRWallet *BRWalletNew(BRTransaction *transactions[], size_t txCount, BRMasterPubKey mpk, int forkId)
+{
+    return BRWalletNewWithSummary(transactions, txCount, mpk, forkId, NULL, 0);
+}
+
+typedef struct {
+    BRWallet *wallet;
+    uint32_t gapLimit, internal;
+} _BRWalletChainJob;
+
+static void *_BRWalletChainRoutine(void *info)
+{
+    _BRWalletChainJob *job = info;
+
+    BRWalletUnusedPKHs(job->wallet, NULL, job->gapLimit, job->internal);
+    return NULL;
+}
+
+static BRWallet *_BRWalletNew(BRTransaction *transactions[], size_t txCount, BRMasterPubKey mpk, int forkId,
+                              const uint8_t *summary, size_t summaryLen, int watchOnly)
+{
+    BRWallet *wallet = NULL;
+    BRTransaction *tx;
+    const uint8_t *pkh;
+    _BRWalletSummary s;
+    int hasSummary, hasOrder;
+    size_t capacity = (watchOnly) ? WATCH_ONLY_CAPACITY : 100;
+
+    assert(transactions != NULL || txCount == 0);
+    wallet = calloc(1, sizeof(*wallet));
+    assert(wallet != NULL);
+    wallet->watchOnly = watchOnly;
+
+    if (! watchOnly) {
+        wallet->prefilter = calloc(PREFILTER_BITS/64, sizeof(*wallet->prefilter));
+        assert(wallet->prefilter != NULL);
+    }
+
+    array_new(wallet->utxos, capacity);
+    array_new(wallet->transactions, txCount + capacity);
+    wallet->feePerKb = DEFAULT_FEE_PER_KB;
+    wallet->masterPubKey = mpk;
+    wallet->forkId = forkId;
+    array_new(wallet->internalChain, capacity);
+    array_new(wallet->externalChain, capacity);
+    array_new(wallet->balanceHist, txCount + capacity);
+    wallet->allTx = BRSetNew(BRTransactionHash, BRTransactionEq, txCount + capacity);
+    wallet->txIndex = BRConcurrentSetNew(_txIndexHash, _txIndexEq, txCount + capacity);
+    wallet->invalidTx = BRSetNew(BRTransactionHash, BRTransactionEq, 10);
+    wallet->pendingTx = BRSetNew(BRTransactionHash, BRTransactionEq, 10);
+    wallet->spentOutputs = BRSetNew(BRUTXOHash, BRUTXOEq, txCount + capacity);
+    wallet->reservedOutputs = BRSetNew(BRUTXOHash, BRUTXOEq, 10);
+    wallet->usedPKH = BRSetNew(_pkhHash, _pkhEq, txCount + capacity);
+    wallet->allPKH = BRSetNew(_pkhHash, _pkhEq, txCount + capacity);
+    array_new(wallet->batchAdded, 10);
+    array_new(wallet->batchUpdated, 10);
+    array_new(wallet->batchRemoved, 10);
+    array_new(wallet->coldTx, 0);
+    array_new(wallet->coldSpent, 0);
+    array_new(wallet->coldPKH, 0);
+    wallet->coldTxIndex = BRSetNew(_txRecordHash, _txRecordEq, 0);
+    wallet->depthGen = 1;
+    wallet->amountsGen = 1;
+    pthread_mutex_init(&wallet->lock, NULL);
+
+    for (size_t i = 0; transactions && i < txCount; i++) {
+        tx = transactions[i];
+        if (! BRTransactionIsSigned(tx) || _BRTxSetContains(wallet->allTx, tx)) continue;
+        _BRTxSetAdd(wallet->allTx, tx);
+        _BRWalletTxIndexAdd(wallet, tx);
+        _BRWalletPrefilterAdd(wallet, &tx->txHash);
+        array_add(wallet->transactions, tx);
+
+        for (size_t j = 0; j < tx->outCount; j++) {
+            pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
+            if (pkh) _BRPKHSetAdd(wallet->usedPKH, (void *)pkh);
         }
+    }
+    
+    hasSummary = _BRWalletSummaryParse(&s, summary, summaryLen, mpk);
+    if (hasSummary) _BRWalletSummaryChains(wallet, &s); // the chains depend only on mpk, so are kept even if tx changed
+
+    // the external and internal chains are extended to their gap limits on worker threads while the transactions are
+    // ordered on this one: ordering only touches the tx list and tx->depth, and extending only the chains, prefilter
+    // and allPKH, under the wallet lock (a watch-only wallet with no transactions has no used addresses to find, so
+    // its first addresses are derived the first time they're asked for, which for a wallet synced by a peer manager
+    // is when its filter is built)
+    _BRWalletChainJob chainJobs[] = {
+        { wallet, SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_EXTERNAL_CHAIN },
+        { wallet, SEQUENCE_GAP_LIMIT_INTERNAL, SEQUENCE_INTERNAL_CHAIN }
+    };
+    pthread_t chainThreads[2];
+    int chainStarted[2] = { 0, 0 };
+
+    for (size_t i = 0; (! watchOnly || txCount > 0) && i < 2; i++) {
+        chainStarted[i] = (pthread_create(&chainThreads[i], NULL, _BRWalletChainRoutine, &chainJobs[i]) == 0);
+    }
 
-        // check if tx is pending
-        if (tx->blockHeight == TX_UNCONFIRMED) {
-            isPending = (BRTransactionVSize(tx) > TX_MAX_SIZE) ? 1 : 0; // check tx size is under TX_MAX_SIZE
-            
-            for (j = 0; ! isPending && j < tx->outCount; j++) {
-                if (tx->outputs[j].amount < TX_MIN_OUTPUT_AMOUNT) isPending = 1; // check that no outputs are dust
+    hasOrder = (hasSummary && _BRWalletSummaryTxOrder(wallet, &s));
+    if (! hasOrder) _BRWalletSortTx(wallet); // sorted once all of allTx is known, so tx may be given in any order
+
+    for (size_t i = 0; (! watchOnly || txCount > 0) && i < 2; i++) {
+        if (chainStarted[i]) pthread_join(chainThreads[i], NULL);
+        else _BRWalletChainRoutine(&chainJobs[i]);
+    }
+
+    if (hasOrder) _BRWalletSummaryBalance(wallet, &s);
+    else _BRWalletUpdateBalance(wallet);
+
+    if (txCount > 0 && ! _BRWalletContainsTx(wallet, transactions[0])) { // verify transactions match master pubKey
+        BRWalletFree(wallet);
+        wallet = NULL;
+    }
+    
+    return wallet;
+}
+
+// like BRWalletNew(), but if summary was written by BRWalletSerializeSummary() for the same transactions at the same
+// block heights, none unconfirmed, the wallet's tx order and balance are restored from it instead of recalculated from
+// every transaction, and the addresses derived for mpk are restored regardless
+// a summary for another mpk, or that is corrupt, is ignored
+BRWallet *BRWalletNewWithSummary(BRTransaction *transactions[], size_t txCount, BRMasterPubKey mpk, int forkId,
+                                 const uint8_t *summary, size_t summaryLen)
+{
+    return _BRWalletNew(transactions, txCount, mpk, forkId, summary, summaryLen, 0);
+}
+
+// like BRWalletNewWithSummary(), but for hosts watching many wallets, such as thousands of xpubs imported with
+// BRBIP32ParseMasterPubKey(): addresses are only derived once they're needed, the relayed tx prefilter is left out,
+// and a peer manager syncing the wallet keeps only a small window of unused addresses past the last used ones
+// summary may be NULL
+BRWallet *BRWalletNewWatchOnly(BRTransaction *transactions[], size_t txCount, BRMasterPubKey mpk, int forkId,
+                               const uint8_t *summary, size_t summaryLen)
+{
+    return _BRWalletNew(transactions, txCount, mpk, forkId, summary, summaryLen, 1);
+}
+
+// true if wallet was created with BRWalletNewWatchOnly()
+int BRWalletIsWatchOnly(BRWallet *wallet)
+{
+    assert(wallet != NULL);
+    return wallet->watchOnly;
+}
+
+// writes a summary of the wallet's tx order, balance history, UTXOs and derived chains to buf, followed by a checksum,
+// for use with BRWalletNewWithSummary()
+// returns number of bytes written to buf, or total bufLen needed if buf is NULL, or 0 if a batch is in progress
+size_t BRWalletSerializeSummary(BRWallet *wallet, uint8_t *buf, size_t bufLen)
+{
+    size_t count, utxoCount, externalCount, internalCount, len, off = 0;
+
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    count = array_count(wallet->transactions);
+    utxoCount = array_count(wallet->utxos);
+    externalCount = array_count(wallet->externalChain);
+    internalCount = array_count(wallet->internalChain);
+    len = sizeof(uint32_t)*2 + count*WALLET_SUMMARY_TX_SIZE + sizeof(uint64_t)*3 + sizeof(uint32_t) +
+          utxoCount*WALLET_SUMMARY_UTXO_SIZE + sizeof(uint32_t)*2 + (externalCount + internalCount)*sizeof(UInt160) +
+          sizeof(UInt256);
+    if (wallet->batchDepth > 0 || array_count(wallet->balanceHist) != count) len = 0;
+    if (array_count(wallet->coldTx) > 0) len = 0; // a condensed wallet is restored by replaying its transactions
+
+    if (buf && len > 0 && len <= bufLen) {
+        UInt32SetLE(&buf[off], WALLET_SUMMARY_VERSION);
+        UInt32SetLE(&buf[off + sizeof(uint32_t)], (uint32_t)count);
+        off += sizeof(uint32_t)*2;
+
+        for (size_t i = 0; i < count; i++, off += WALLET_SUMMARY_TX_SIZE) {
+            UInt256Set(&buf[off], wallet->transactions[i]->txHash);
+            UInt32SetLE(&buf[off + sizeof(UInt256)], wallet->transactions[i]->blockHeight);
+            UInt64SetLE(&buf[off + sizeof(UInt256) + sizeof(uint32_t)], wallet->balanceHist[i]);
+        }
+
+        UInt64SetLE(&buf[off], wallet->balance);
+        UInt64SetLE(&buf[off + sizeof(uint64_t)], wallet->totalSent);
+        UInt64SetLE(&buf[off + sizeof(uint64_t)*2], wallet->totalReceived);
+        UInt32SetLE(&buf[off + sizeof(uint64_t)*3], (uint32_t)utxoCount);
+        off += sizeof(uint64_t)*3 + sizeof(uint32_t);
+
+        for (size_t i = 0; i < utxoCount; i++, off += WALLET_SUMMARY_UTXO_SIZE) {
+            UInt256Set(&buf[off], wallet->utxos[i].hash);
+            UInt32SetLE(&buf[off + sizeof(UInt256)], wallet->utxos[i].n);
+        }
+
+        UInt32SetLE(&buf[off], (uint32_t)externalCount);
+        UInt32SetLE(&buf[off + sizeof(uint32_t)], (uint32_t)internalCount);
+        off += sizeof(uint32_t)*2;
+        memcpy(&buf[off], wallet->externalChain, externalCount*sizeof(UInt160));
+        off += externalCount*sizeof(UInt160);
+        memcpy(&buf[off], wallet->internalChain, internalCount*sizeof(UInt160));
+        off += internalCount*sizeof(UInt160);
+        UInt256Set(&buf[off], _BRWalletSummaryChecksum(wallet->masterPubKey, buf, off));
+    }
+
+    pthread_mutex_unlock(&wallet->lock);
+    return (! buf || len <= bufLen) ? len : 0;
+}
+
+// not thread-safe, set callbacks once after BRWalletNew(), before calling other BRWallet functions
+// info is a void pointer that will be passed along with each callback call
+// void balanceChanged(void *, uint64_t) - called when the wallet balance changes
+// void txAdded(void *, BRTransaction *) - called when transaction is added to the wallet
+// void txUpdated(void *, const UInt256[], size_t, uint32_t, uint32_t)
+//   - called when the blockHeight or timestamp of previously added transactions are updated
+// void txDeleted(void *, UInt256) - called when a previously added transaction is removed from the wallet
+// NOTE: if a transaction is deleted, and BRWalletAmountSentByTx() is greater than 0, recommend the user do a rescan
+void BRWalletSetCallbacks(BRWallet *wallet, void *info,
+                          void (*balanceChanged)(void *info, uint64_t balance),
+                          void (*txAdded)(void *info, BRTransaction *tx),
+                          void (*txUpdated)(void *info, const UInt256 txHashes[], size_t txCount, uint32_t blockHeight,
+                                            uint32_t timestamp),
+                          void (*txDeleted)(void *info, UInt256 txHash, int notifyUser, int recommendRescan))
+{
+    assert(wallet != NULL);
+    wallet->callbackInfo = info;
+    wallet->balanceChanged = balanceChanged;
+    wallet->txAdded = txAdded;
+    wallet->txUpdated = txUpdated;
+    wallet->txDeleted = txDeleted;
+}
+
+typedef struct {
+    BRMasterPubKey mpk;
+    uint32_t chain, start;
+    size_t count;
+    UInt160 *pkhs;
+} _BRWalletDeriveJob;
+
+static void *_BRWalletDeriveRoutine(void *info)
+{
+    _BRWalletDeriveJob *job = info;
+    BRECPoint *pubKeys = malloc(job->count*sizeof(*pubKeys));
+    void **mds = malloc(job->count*sizeof(*mds));
+    const void **datas = malloc(job->count*sizeof(*datas));
+    size_t i, n, *lens = malloc(job->count*sizeof(*lens));
+    BRKey key;
+    
+    assert(pubKeys != NULL);
+    assert(mds != NULL);
+    assert(datas != NULL);
+    assert(lens != NULL);
+    n = BRBIP32PubKeyRange(pubKeys, job->count, job->mpk, job->chain, job->start);
+    
+    for (i = 0; i < n; i++) {
+        if (! BRKeySetPubKey(&key, pubKeys[i].p, sizeof(pubKeys[i]))) break;
+        mds[i] = &job->pkhs[i], datas[i] = pubKeys[i].p, lens[i] = sizeof(pubKeys[i]);
+    }
+    
+    BRHash160Batch(mds, datas, lens, i); // hash the compressed pubkeys a vector's worth of lanes at a time
+    job->count = i;
+    free(lens);
+    free(datas);
+    free(mds);
+    free(pubKeys);
+    return NULL;
+}
+
+// writes the hash160s of the count public keys for chain starting at index start to pkhs, deriving long runs of keys
+// in parallel on worker threads - call without holding the wallet lock
+// returns the number of leading hash160s that were derived, which is less than count only if a key was invalid
+static size_t _BRWalletDeriveHash160s(UInt160 *pkhs, size_t count, BRMasterPubKey mpk, uint32_t chain, uint32_t start)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t i, n = 0, threadCount = (cpus > 0) ? (size_t)cpus : 1;
+    
+    if (threadCount > DERIVE_MAX_THREADS) threadCount = DERIVE_MAX_THREADS;
+    if (threadCount > count/DERIVE_MIN_PER_THREAD) threadCount = count/DERIVE_MIN_PER_THREAD;
+    if (threadCount == 0) threadCount = 1;
+    
+    _BRWalletDeriveJob jobs[threadCount];
+    pthread_t threads[threadCount];
+    int started[threadCount];
+    
+    for (i = 0; i < threadCount; i++) {
+        size_t off = count*i/threadCount;
+        
+        jobs[i] = (_BRWalletDeriveJob) { mpk, chain, start + (uint32_t)off, count*(i + 1)/threadCount - off, &pkhs[off] };
+        // the calling thread takes the first run, and any run a worker thread couldn't be started for
+        started[i] = (i > 0 && pthread_create(&threads[i], NULL, _BRWalletDeriveRoutine, &jobs[i]) == 0);
+    }
+    
+    for (i = 0; i < threadCount; i++) {
+        if (! started[i]) _BRWalletDeriveRoutine(&jobs[i]);
+    }
+    
+    for (i = 0; i < threadCount; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+    
+    for (i = 0; i < threadCount; i++) { // count derived hashes up to the first run cut short by an invalid key
+        n += jobs[i].count;
+        if (n < count*(i + 1)/threadCount) break;
+    }
+    
+    return n;
+}
+
+// wallets are composed of chains of addresses
+// each chain is traversed until a gap of a number of addresses is found that haven't been used in any transactions
+// this function writes to addrs an array of <gapLimit> unused addresses following the last used address in the chain
+// the internal chain is used for change addresses and the external chain for receive addresses
+// addrs may be NULL to only generate addresses for BRWalletContainsAddress()
+// returns the number addresses written to addrs
+size_t BRWalletUnusedAddrs(BRWallet *wallet, BRAddress addrs[], uint32_t gapLimit, uint32_t internal)
+{
+    UInt160 *pkhs = (addrs) ? malloc(gapLimit*sizeof(*pkhs)) : NULL;
+    size_t i, count;
+
+    assert(wallet != NULL);
+    assert(gapLimit > 0);
+    assert(pkhs != NULL || addrs == NULL);
+    count = BRWalletUnusedPKHs(wallet, pkhs, gapLimit, internal);
+    for (i = 0; i < count; i++) _BRWalletAddressFromHash160(wallet, addrs[i].s, sizeof(*addrs), pkhs[i]);
+    if (pkhs) free(pkhs);
+    return count;
+}
+
+// writes to pkhs the pubkey-hashes of the <gapLimit> unused addresses following the last used address in the chain,
+// the same as BRWalletUnusedAddrs() but without encoding them as address strings
+// pkhs may be NULL to only generate addresses for BRWalletContainsPKH()
+// returns the number of hashes written to pkhs
+size_t BRWalletUnusedPKHs(BRWallet *wallet, UInt160 pkhs[], uint32_t gapLimit, uint32_t internal)
+{
+    UInt160 *chain = NULL, *origChain, *derived = NULL;
+    size_t i = 0, j = 0, k, n, count = 0, startCount, start = 0, ahead = 0, derivedCount = 0;
+
+    assert(wallet != NULL);
+    assert(gapLimit > 0);
+    pthread_mutex_lock(&wallet->lock);
+    
+    for (;;) {
+        if (internal == SEQUENCE_EXTERNAL_CHAIN) chain = wallet->externalChain;
+        if (internal == SEQUENCE_INTERNAL_CHAIN) chain = wallet->internalChain;
+        assert(chain != NULL);
+        i = count = array_count(chain);
+        
+        // keep only the trailing contiguous block of addresses with no transactions
+        while (i > 0 && ! _BRPKHSetContains(wallet->usedPKH, &chain[i - 1])) i--;
+        if (i + gapLimit <= count) break;
+        
+        // generate new addresses up to gapLimit, outside the lock so as not to block other wallet calls meanwhile
+        // each time round that finds the last run already used, as when restoring a long history, derives twice as far
+        // ahead, so a long chain takes a few runs large enough to spread across threads instead of many short ones, but
+        // only the addresses up to the gap limit join the chain, and the rest wait in derived for the next time round
+        n = i + gapLimit - count;
+        
+        if (start != count || derivedCount < n) {
+            start = count;
+            k = (n < ahead) ? ahead : n;
+            ahead = (k*2 < DERIVE_AHEAD_MAX) ? k*2 : DERIVE_AHEAD_MAX;
+            derived = realloc(derived, k*sizeof(*derived));
+            assert(derived != NULL);
+            pthread_mutex_unlock(&wallet->lock);
+            derivedCount = _BRWalletDeriveHash160s(derived, k, wallet->masterPubKey, internal, (uint32_t)start);
+            pthread_mutex_lock(&wallet->lock);
+        }
+        
+        k = (derivedCount < n) ? derivedCount : n;
+        
+        // another call may have extended the chain while the lock was released, so only append what's still missing
+        if (internal == SEQUENCE_EXTERNAL_CHAIN) chain = wallet->externalChain;
+        if (internal == SEQUENCE_INTERNAL_CHAIN) chain = wallet->internalChain;
+        origChain = chain;
+        count = startCount = array_count(chain);
+        while (count >= start && count < start + k) {
+            array_add(chain, derived[count - start]);
+            count++;
+        }
+        
+        for (i = startCount; i < count; i++) {
+            _BRWalletPrefilterAdd(wallet, &chain[i]);
+            if (wallet->index) _BRWalletIndexAdd(wallet->index, &chain[i], sizeof(UInt160), wallet);
+        }
+        
+        if (count > startCount) wallet->amountsGen++; // a tx may pay or spend a new address
+        
+        // was chain moved to a new memory location?
+        if (chain == origChain) {
+            for (i = startCount; i < count; i++) {
+                _BRPKHSetAdd(wallet->allPKH, &chain[i]);
             }
+        }
+        else {
+            if (internal == SEQUENCE_EXTERNAL_CHAIN) wallet->externalChain = chain;
+            if (internal == SEQUENCE_INTERNAL_CHAIN) wallet->internalChain = chain;
+
+            BRSetClear(wallet->allPKH); // clear and rebuild allAddrs
 
-            for (j = 0; ! isPending && j < tx->inCount; j++) {
-                if (tx->inputs[j].sequence < UINT32_MAX - 1) isPending = 1; // check for replace-by-fee
-                if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime < TX_MAX_LOCK_HEIGHT &&
-                    tx->lockTime > wallet->blockHeight + 1) isPending = 1; // future lockTime
-                if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime > now) isPending = 1; // future lockTime
-                if (BRSetContains(wallet->pendingTx, &tx->inputs[j].txHash)) isPending = 1; // check for pending inputs
-                // TODO: XXX handle BIP68 check lock time verify rules
+            for (i = array_count(wallet->internalChain); i > 0; i--) {
+                _BRPKHSetAdd(wallet->allPKH, &wallet->internalChain[i - 1]);
             }
             
-            if (isPending) {
-                BRSetAdd(wallet->pendingTx, tx);
-                array_add(wallet->balanceHist, balance);
-                continue;
+            for (i = array_count(wallet->externalChain); i > 0; i--) {
+                _BRPKHSetAdd(wallet->allPKH, &wallet->externalChain[i - 1]);
             }
         }
+        
+        if (k < n) { // hit an invalid key, give up as before
+            i = count;
+            break;
+        }
+        
+        memmove(derived, &derived[k], (derivedCount - k)*sizeof(*derived));
+        start += k;
+        derivedCount -= k;
+    }
 
-        // add outputs to UTXO set
-        // TODO: don't add outputs below TX_MIN_OUTPUT_AMOUNT
-        // TODO: don't add coin generation outputs < 100 blocks deep
-        // NOTE: balance/UTXOs will then need to be recalculated when last block changes
-        for (j = 0; j < tx->outCount; j++) {
-            if (tx->outputs[j].address[0] != '\0') {
-                pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
+    if (pkhs && i + gapLimit <= count) {
+        for (j = 0; j < gapLimit; j++) pkhs[j] = chain[i + j];
+    }
+    
+    pthread_mutex_unlock(&wallet->lock);
+    if (derived) free(derived);
+    return j;
+}
 
-                if (pkh && BRSetContains(wallet->allPKH, pkh)) {
-                    BRSetAdd(wallet->usedPKH, (void *)pkh);
-                    array_add(wallet->utxos, ((const BRUTXO) { tx->txHash, (uint32_t)j }));
-                    balance += tx->outputs[j].amount;
-                }
-            }
-        }
+// current wallet balance, not including transactions known to be invalid
+uint64_t BRWalletBalance(BRWallet *wallet)
+{
+    assert(wallet != NULL);
+    return atomic_load_explicit(&wallet->publishedBalance, memory_order_acquire); // never waits on wallet->lock
+}
+
+// writes unspent outputs to utxos and returns the number of outputs written, or total number available if utxos is NULL
+size_t BRWalletUTXOs(BRWallet *wallet, BRUTXO *utxos, size_t utxosCount)
+{
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    if (! utxos || array_count(wallet->utxos) < utxosCount) utxosCount = array_count(wallet->utxos);
+
+    for (size_t i = 0; utxos && i < utxosCount; i++) {
+        utxos[i] = wallet->utxos[i];
+    }
+
+    pthread_mutex_unlock(&wallet->lock);
+    return utxosCount;
+}
+
+// writes transactions registered in the wallet, sorted by date, oldest first, to the given transactions array
+// returns the number of transactions written, or total number available if transactions is NULL
+size_t BRWalletTransactions(BRWallet *wallet, BRTransaction *transactions[], size_t txCount)
+{
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    if (! transactions || array_count(wallet->transactions) < txCount) txCount = array_count(wallet->transactions);
+
+    for (size_t i = 0; transactions && i < txCount; i++) {
+        transactions[i] = wallet->transactions[i];
+    }
+    
+    pthread_mutex_unlock(&wallet->lock);
+    return txCount;
+}
+
+// writes copies of the transactions registered in the wallet, sorted by date, oldest first, to the given transactions
+// array, copied while holding the wallet lock; free each copy with BRTransactionFree()
+// returns the number of transactions written, or total number available if transactions is NULL
+size_t BRWalletTransactionsCopy(BRWallet *wallet, BRTransaction *transactions[], size_t txCount)
+{
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    if (! transactions || array_count(wallet->transactions) < txCount) txCount = array_count(wallet->transactions);
+
+    for (size_t i = 0; transactions && i < txCount; i++) {
+        transactions[i] = BRTransactionCopy(wallet->transactions[i]);
+    }
+
+    pthread_mutex_unlock(&wallet->lock);
+    return txCount;
+}
+
+// writes transactions registered in the wallet, and that were unconfirmed before blockHeight, to the transactions array
+// returns the number of transactions written, or total number available if transactions is NULL
+size_t BRWalletTxUnconfirmedBefore(BRWallet *wallet, BRTransaction *transactions[], size_t txCount,
+                                   uint32_t blockHeight)
+{
+    size_t total, n = 0;
+
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    total = array_count(wallet->transactions);
+    n = total - _BRWalletTxHeightIndex(wallet, blockHeight);
+    if (! transactions || n < txCount) txCount = n;
+
+    for (size_t i = 0; transactions && i < txCount; i++) {
+        transactions[i] = wallet->transactions[(total - n) + i];
+    }
+
+    pthread_mutex_unlock(&wallet->lock);
+    return txCount;
+}
+
+// writes copies of the transactions registered in the wallet, and that were unconfirmed before blockHeight, to the
+// transactions array, copied while holding the wallet lock; free each copy with BRTransactionFree()
+// returns the number of transactions written, or total number available if transactions is NULL
+size_t BRWalletTxUnconfirmedBeforeCopy(BRWallet *wallet, BRTransaction *transactions[], size_t txCount,
+                                       uint32_t blockHeight)
+{
+    size_t total, n = 0;
+
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    total = array_count(wallet->transactions);
+    n = total - _BRWalletTxHeightIndex(wallet, blockHeight);
+    if (! transactions || n < txCount) txCount = n;
 
-        // transaction ordering is not guaranteed, so check the entire UTXO set against the entire spent output set
-        for (j = array_count(wallet->utxos); j > 0; j--) {
-            if (! BRSetContains(wallet->spentOutputs, &wallet->utxos[j - 1])) continue;
-            t = BRSetGet(wallet->allTx, &wallet->utxos[j - 1].hash);
-            balance -= t->outputs[wallet->utxos[j - 1].n].amount;
-            array_rm(wallet->utxos, j - 1);
-        }
-        
-        if (prevBalance < balance) wallet->totalReceived += balance - prevBalance;
-        if (balance < prevBalance) wallet->totalSent += prevBalance - balance;
-        array_add(wallet->balanceHist, balance);
-        prevBalance = balance;
+    for (size_t i = 0; transactions && i < txCount; i++) {
+        transactions[i] = BRTransactionCopy(wallet->transactions[(total - n) + i]);
     }
 
-    assert(array_count(wallet->balanceHist) == array_count(wallet->transactions));
-    wallet->balance = balance;
+    pthread_mutex_unlock(&wallet->lock);
+    return txCount;
 }
 
-// allocates and populates a BRWallet struct which must be freed by calling BRWalletFree()
-// forkId is 0 for bitcoin, 0x40 for b-cash
-BRWallet *BRWalletNew(BRTransaction *transactions[], size_t txCount, BRMasterPubKey mpk, int forkId)
+// writes up to txCount transactions registered in the wallet, sorted by date, oldest first, starting at position offset
+// in the transaction history, to the given transactions array
+// returns the number of transactions written, or total number available after offset if transactions is NULL
+size_t BRWalletTransactionsPage(BRWallet *wallet, BRTransaction *transactions[], size_t offset, size_t txCount)
 {
-    BRWallet *wallet = NULL;
-    BRTransaction *tx;
-    const uint8_t *pkh;
+    size_t n;
 
-    assert(transactions != NULL || txCount == 0);
-    wallet = calloc(1, sizeof(*wallet));
     assert(wallet != NULL);
-    array_new(wallet->utxos, 100);
-    array_new(wallet->transactions, txCount + 100);
-    wallet->feePerKb = DEFAULT_FEE_PER_KB;
-    wallet->masterPubKey = mpk;
-    wallet->forkId = forkId;
-    array_new(wallet->internalChain, 100);
-    array_new(wallet->externalChain, 100);
-    array_new(wallet->balanceHist, txCount + 100);
-    wallet->allTx = BRSetNew(BRTransactionHash, BRTransactionEq, txCount + 100);
-    wallet->invalidTx = BRSetNew(BRTransactionHash, BRTransactionEq, 10);
-    wallet->pendingTx = BRSetNew(BRTransactionHash, BRTransactionEq, 10);
-    wallet->spentOutputs = BRSetNew(BRUTXOHash, BRUTXOEq, txCount + 100);
-    wallet->usedPKH = BRSetNew(_pkhHash, _pkhEq, txCount + 100);
-    wallet->allPKH = BRSetNew(_pkhHash, _pkhEq, txCount + 100);
-    pthread_mutex_init(&wallet->lock, NULL);
+    pthread_mutex_lock(&wallet->lock);
+    n = (offset < array_count(wallet->transactions)) ? array_count(wallet->transactions) - offset : 0;
+    if (! transactions || n < txCount) txCount = n;
 
     for (size_t i = 0; transactions && i < txCount; i++) {
-        tx = transactions[i];
-        if (! BRTransactionIsSigned(tx) || BRSetContains(wallet->allTx, tx)) continue;
-        BRSetAdd(wallet->allTx, tx);
-        _BRWalletInsertTx(wallet, tx);
-
-        for (size_t j = 0; j < tx->outCount; j++) {
-            pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
-            if (pkh) BRSetAdd(wallet->usedPKH, (void *)pkh);
-        }
+        transactions[i] = wallet->transactions[offset + i];
     }
-    
-    BRWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_EXTERNAL_CHAIN);
-    BRWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_INTERNAL, SEQUENCE_INTERNAL_CHAIN);
-
-    _BRWalletUpdateBalance(wallet);
 
-    if (txCount > 0 && ! _BRWalletContainsTx(wallet, transactions[0])) { // verify transactions match master pubKey
-        BRWalletFree(wallet);
-        wallet = NULL;
-    }
-    
-    return wallet;
+    pthread_mutex_unlock(&wallet->lock);
+    return txCount;
 }
 
-// not thread-safe, set callbacks once after BRWalletNew(), before calling other BRWallet functions
-// info is a void pointer that will be passed along with each callback call
-// void balanceChanged(void *, uint64_t) - called when the wallet balance changes
-// void txAdded(void *, BRTransaction *) - called when transaction is added to the wallet
-// void txUpdated(void *, const UInt256[], size_t, uint32_t, uint32_t)
-//   - called when the blockHeight or timestamp of previously added transactions are updated
-// void txDeleted(void *, UInt256) - called when a previously added transaction is removed from the wallet
-// NOTE: if a transaction is deleted, and BRWalletAmountSentByTx() is greater than 0, recommend the user do a rescan
-void BRWalletSetCallbacks(BRWallet *wallet, void *info,
-                          void (*balanceChanged)(void *info, uint64_t balance),
-                          void (*txAdded)(void *info, BRTransaction *tx),
-                          void (*txUpdated)(void *info, const UInt256 txHashes[], size_t txCount, uint32_t blockHeight,
-                                            uint32_t timestamp),
-                          void (*txDeleted)(void *info, UInt256 txHash, int notifyUser, int recommendRescan))
+// writes up to txCount transactions registered in the wallet, newest first, skipping the newest offset transactions, to
+// the given transactions array
+// returns the number of transactions written, or total number available after offset if transactions is NULL
+size_t BRWalletTransactionsNewest(BRWallet *wallet, BRTransaction *transactions[], size_t offset, size_t txCount)
 {
+    size_t n;
+
     assert(wallet != NULL);
-    wallet->callbackInfo = info;
-    wallet->balanceChanged = balanceChanged;
-    wallet->txAdded = txAdded;
-    wallet->txUpdated = txUpdated;
-    wallet->txDeleted = txDeleted;
+    pthread_mutex_lock(&wallet->lock);
+    n = (offset < array_count(wallet->transactions)) ? array_count(wallet->transactions) - offset : 0;
+    if (! transactions || n < txCount) txCount = n;
+
+    for (size_t i = 0; transactions && i < txCount; i++) {
+        transactions[i] = wallet->transactions[n - (i + 1)];
+    }
+
+    pthread_mutex_unlock(&wallet->lock);
+    return txCount;
 }
 
-// wallets are composed of chains of addresses
-// each chain is traversed until a gap of a number of addresses is found that haven't been used in any transactions
-// this function writes to addrs an array of <gapLimit> unused addresses following the last used address in the chain
-// the internal chain is used for change addresses and the external chain for receive addresses
-// addrs may be NULL to only generate addresses for BRWalletContainsAddress()
-// returns the number addresses written to addrs
-size_t BRWalletUnusedAddrs(BRWallet *wallet, BRAddress addrs[], uint32_t gapLimit, uint32_t internal)
+// writes up to txCount transactions registered in the wallet with block heights from fromHeight up to but not including
+// toHeight, sorted by date, oldest first, to the given transactions array (unconfirmed tx have height TX_UNCONFIRMED)
+// returns the number of transactions written, or total number available if transactions is NULL
+size_t BRWalletTransactionsInHeights(BRWallet *wallet, BRTransaction *transactions[], size_t txCount,
+                                     uint32_t fromHeight, uint32_t toHeight)
 {
-    UInt160 *chain = NULL, *origChain;
-    size_t i, j = 0, count, startCount;
+    size_t start, end;
 
     assert(wallet != NULL);
-    assert(gapLimit > 0);
     pthread_mutex_lock(&wallet->lock);
-    if (internal == SEQUENCE_EXTERNAL_CHAIN) chain = wallet->externalChain;
-    if (internal == SEQUENCE_INTERNAL_CHAIN) chain = wallet->internalChain;
-    assert(chain != NULL);
-    origChain = chain;
-    i = count = startCount = array_count(chain);
-    
-    // keep only the trailing contiguous block of addresses with no transactions
-    while (i > 0 && ! BRSetContains(wallet->usedPKH, &chain[i - 1])) i--;
-    
-    while (i + gapLimit > count) { // generate new addresses up to gapLimit
-        BRKey key;
-        uint8_t pubKey[BRBIP32PubKey(NULL, 0, wallet->masterPubKey, internal, count)];
-        size_t len = BRBIP32PubKey(pubKey, sizeof(pubKey), wallet->masterPubKey, internal, (uint32_t)count);
-        
-        if (! BRKeySetPubKey(&key, pubKey, len)) break;
-        array_add(chain, BRKeyHash160(&key));
-        count++;
-        if (BRSetContains(wallet->usedPKH, &chain[array_count(chain) - 1])) i = count;
+    start = _BRWalletTxHeightIndex(wallet, fromHeight);
+    end = (toHeight > fromHeight) ? _BRWalletTxHeightIndex(wallet, toHeight) : start;
+    if (! transactions || end - start < txCount) txCount = end - start;
+
+    for (size_t i = 0; transactions && i < txCount; i++) {
+        transactions[i] = wallet->transactions[start + i];
     }
 
-    if (addrs && i + gapLimit <= count) {
-        for (j = 0; j < gapLimit; j++) {
-            _BRWalletAddressFromHash160(wallet, addrs[j].s, sizeof(*addrs), chain[i + j]);
+    pthread_mutex_unlock(&wallet->lock);
+    return txCount;
+}
+
+// removes from the wallet the oldest transactions that are at least confirmations deep and whose wallet outputs are all
+// spent by transactions removed along with them, keeping a BRWalletTxRecord of each in their place, so the memory the
+// wallet holds follows its UTXO set rather than its history, the balance, UTXOs and used addresses are unchanged
+// writes up to txCount of the removed transactions to the condensed array, oldest first, and the caller takes ownership
+// of them, they're no longer registered in the wallet and neither wallet functions nor callbacks refer to them again,
+// so their bodies must already be stored wherever they're reloaded from on demand
+// returns the number of transactions removed, or the number that would be if condensed is NULL, or 0 during a batch
+size_t BRWalletCondenseTransactions(BRWallet *wallet, uint32_t confirmations, BRTransaction *condensed[],
+                                    size_t txCount)
+{
+    BRTransaction *tx;
+    BRUTXO *utxos;
+    BRSet *outputs, *spent;
+    const uint8_t *pkh;
+    uint64_t sent, received, fee, prevBalance = 0;
+    size_t i, j, count, outCount = 0, open = 0, closed = 0;
+    
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    count = array_count(wallet->transactions);
+    if (wallet->batchDepth > 0 || array_count(wallet->balanceHist) != count) count = 0;
+    if (condensed && count > txCount) count = txCount;
+    for (i = 0; i < count; i++) outCount += wallet->transactions[i]->outCount;
+    array_new(utxos, outCount); // never grows, so the set can hold pointers into it
+    outputs = BRSetNew(BRUTXOHash, BRUTXOEq, outCount);
+    spent = BRSetNew(BRUTXOHash, BRUTXOEq, outCount);
+    
+    // find the longest prefix of wallet->transactions, in confirmed order, that leaves no wallet output unspent
+    for (i = 0; i < count; i++) {
+        tx = wallet->transactions[i];
+        if (tx->blockHeight == TX_UNCONFIRMED || tx->blockHeight + confirmations > wallet->blockHeight + 1) break;
+        if (_BRTxSetContains(wallet->invalidTx, tx) || _BRTxSetContains(wallet->pendingTx, tx)) break;
+        
+        for (j = 0; j < tx->inCount; j++) {
+            if (_BRUTXOSetAdd(spent, &tx->inputs[j]) == NULL && _BRUTXOSetContains(outputs, &tx->inputs[j])) open--;
+        }
+        
+        for (j = 0; j < tx->outCount; j++) {
+            if (tx->outputs[j].address[0] == '\0') continue;
+            pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
+            if (! pkh || ! _BRPKHSetContains(wallet->allPKH, pkh)) continue;
+            array_add(utxos, ((const BRUTXO) { tx->txHash, (uint32_t)j }));
+            if (! _BRUTXOSetContains(spent, &utxos[array_count(utxos) - 1])) open++;
+            _BRUTXOSetAdd(outputs, &utxos[array_count(utxos) - 1]);
         }
+        
+        if (open == 0 && wallet->balanceHist[i] == 0) closed = i + 1;
     }
     
-    // was chain moved to a new memory location?
-    if (chain == origChain) {
-        for (i = startCount; i < count; i++) {
-            BRSetAdd(wallet->allPKH, &chain[i]);
+    count = closed;
+    
+    for (i = 0; condensed && i < count; i++) {
+        tx = wallet->transactions[i];
+        _BRWalletTxAmounts(wallet, tx, &sent, &received, &fee);
+        array_add(wallet->coldTx, ((const BRWalletTxRecord) { tx->txHash, tx->blockHeight, tx->timestamp, sent,
+                                                              received, fee, wallet->balanceHist[i] }));
+        if (prevBalance < wallet->balanceHist[i]) wallet->coldReceived += wallet->balanceHist[i] - prevBalance;
+        if (wallet->balanceHist[i] < prevBalance) wallet->coldSent += prevBalance - wallet->balanceHist[i];
+        prevBalance = wallet->balanceHist[i];
+        
+        for (j = 0; j < tx->inCount; j++) {
+            if (_BRUTXOSetContains(outputs, &tx->inputs[j])) {
+                array_add(wallet->coldSpent, ((const BRUTXO) { tx->inputs[j].txHash, tx->inputs[j].index }));
+            }
+        }
+        
+        for (j = 0; j < tx->outCount; j++) {
+            if (tx->outputs[j].address[0] == '\0') continue;
+            pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
+            if (pkh && _BRPKHSetContains(wallet->allPKH, pkh)) array_add(wallet->coldPKH, UInt160Get(pkh));
         }
     }
-    else {
-        if (internal == SEQUENCE_EXTERNAL_CHAIN) wallet->externalChain = chain;
-        if (internal == SEQUENCE_INTERNAL_CHAIN) wallet->internalChain = chain;
-
-        BRSetClear(wallet->allPKH); // clear and rebuild allAddrs
-
-        for (i = array_count(wallet->internalChain); i > 0; i--) {
-            BRSetAdd(wallet->allPKH, &wallet->internalChain[i - 1]);
+    
+    for (i = 0; condensed && i < count; i++) { // amounts of later tx may depend on earlier ones, so remove them last
+        _BRTxSetRemove(wallet->allTx, wallet->transactions[i]);
+        _BRWalletTxIndexRemove(wallet, wallet->transactions[i]);
+        condensed[i] = wallet->transactions[i];
+    }
+    
+    if (condensed && count > 0) {
+        qsort(wallet->coldSpent, array_count(wallet->coldSpent), sizeof(*wallet->coldSpent), _BRUTXOCompare);
+        qsort(wallet->coldPKH, array_count(wallet->coldPKH), sizeof(*wallet->coldPKH), _pkhCompare);
+        
+        for (i = 0, j = 0; i < array_count(wallet->coldPKH); i++) { // remove duplicates
+            if (j > 0 && UInt160Eq(wallet->coldPKH[j - 1], wallet->coldPKH[i])) continue;
+            wallet->coldPKH[j++] = wallet->coldPKH[i];
         }
         
-        for (i = array_count(wallet->externalChain); i > 0; i--) {
-            BRSetAdd(wallet->allPKH, &wallet->externalChain[i - 1]);
+        array_set_count(wallet->coldPKH, j);
+        BRSetClear(wallet->coldTxIndex); // coldTx may have moved as it grew
+        
+        for (i = 0; i < array_count(wallet->coldTx); i++) {
+            _BRTxRecordSetAdd(wallet->coldTxIndex, &wallet->coldTx[i]);
         }
+        
+        array_rm_range(wallet->transactions, 0, count);
+        wallet->changeSeq++;
+        wallet->depthGen++;
+        wallet->amountsGen++;
+        _BRWalletUpdateBalance(wallet);
     }
-
+    
     pthread_mutex_unlock(&wallet->lock);
-    return j;
+    BRSetFree(outputs);
+    array_free(utxos);
+    BRSetFree(spent);
+    return count;
 }
 
-// current wallet balance, not including transactions known to be invalid
-uint64_t BRWalletBalance(BRWallet *wallet)
+// writes up to recordsCount records of transactions condensed by BRWalletCondenseTransactions(), oldest first, starting
+// at position offset, to the given records array
+// returns the number of records written, or total number available after offset if records is NULL
+size_t BRWalletCondensedTransactions(BRWallet *wallet, BRWalletTxRecord records[], size_t offset,
+                                     size_t recordsCount)
 {
-    uint64_t balance;
+    size_t n;
 
     assert(wallet != NULL);
     pthread_mutex_lock(&wallet->lock);
-    balance = wallet->balance;
+    n = array_count(wallet->coldTx);
+    n = (offset < n) ? n - offset : 0;
+    if (! records || n < recordsCount) recordsCount = n;
+
+    for (size_t i = 0; records && i < recordsCount; i++) {
+        records[i] = wallet->coldTx[offset + i];
+    }
+
     pthread_mutex_unlock(&wallet->lock);
-    return balance;
+    return recordsCount;
 }
 
-// writes unspent outputs to utxos and returns the number of outputs written, or total number available if utxos is NULL
-size_t BRWalletUTXOs(BRWallet *wallet, BRUTXO *utxos, size_t utxosCount)
+#define WALLET_CONDENSED_VERSION 1
+#define WALLET_CONDENSED_TX_SIZE (sizeof(UInt256) + sizeof(uint32_t)*2 + sizeof(uint64_t)*4)
+
+// the sections of the condensed state written by BRWalletSerializeCondensed(), each pointing into it
+typedef struct {
+    const uint8_t *txs, *spent, *pkhs;
+    size_t txCount, spentCount, pkhCount;
+    uint64_t sent, received;
+} _BRWalletCondensed;
+
+// returns true if condensed is a complete, uncorrupted condensed state written for mpk, and sets the sections of c
+static int _BRWalletCondensedParse(_BRWalletCondensed *c, const uint8_t *condensed, size_t condensedLen,
+                                   BRMasterPubKey mpk)
+{
+    size_t off = sizeof(uint32_t) + sizeof(uint64_t)*2 + sizeof(uint32_t), len = condensedLen - sizeof(UInt256);
+
+    if (! condensed || condensedLen < off + sizeof(UInt256) || UInt32GetLE(condensed) != WALLET_CONDENSED_VERSION ||
+        ! UInt256Eq(UInt256Get(&condensed[len]), _BRWalletSummaryChecksum(mpk, condensed, len))) return 0;
+    c->sent = UInt64GetLE(&condensed[sizeof(uint32_t)]);
+    c->received = UInt64GetLE(&condensed[sizeof(uint32_t) + sizeof(uint64_t)]);
+    c->txCount = UInt32GetLE(&condensed[off - sizeof(uint32_t)]);
+    c->txs = &condensed[off];
+    if ((len - off)/WALLET_CONDENSED_TX_SIZE < c->txCount) return 0;
+    off += c->txCount*WALLET_CONDENSED_TX_SIZE;
+    if (off + sizeof(uint32_t) > len) return 0;
+    c->spentCount = UInt32GetLE(&condensed[off]);
+    off += sizeof(uint32_t);
+    c->spent = &condensed[off];
+    if ((len - off)/WALLET_SUMMARY_UTXO_SIZE < c->spentCount) return 0;
+    off += c->spentCount*WALLET_SUMMARY_UTXO_SIZE;
+    if (off + sizeof(uint32_t) > len) return 0;
+    c->pkhCount = UInt32GetLE(&condensed[off]);
+    off += sizeof(uint32_t);
+    c->pkhs = &condensed[off];
+    return (c->txCount > 0 && (len - off) % sizeof(UInt160) == 0 && (len - off)/sizeof(UInt160) == c->pkhCount);
+}
+
+// writes what BRWalletCondenseTransactions() keeps of the transactions it removed - their records, the wallet outputs
+// they spent, the wallet addresses they paid to and their totals - to buf, followed by a checksum, for use with
+// BRWalletRestoreCondensed()
+// returns number of bytes written to buf, or total bufLen needed if buf is NULL, or 0 if no tx were condensed
+size_t BRWalletSerializeCondensed(BRWallet *wallet, uint8_t *buf, size_t bufLen)
 {
+    size_t txCount, spentCount, pkhCount, len, off = 0;
+
     assert(wallet != NULL);
     pthread_mutex_lock(&wallet->lock);
-    if (! utxos || array_count(wallet->utxos) < utxosCount) utxosCount = array_count(wallet->utxos);
+    txCount = array_count(wallet->coldTx);
+    spentCount = array_count(wallet->coldSpent);
+    pkhCount = array_count(wallet->coldPKH);
+    len = sizeof(uint32_t) + sizeof(uint64_t)*2 + sizeof(uint32_t) + txCount*WALLET_CONDENSED_TX_SIZE +
+          sizeof(uint32_t) + spentCount*WALLET_SUMMARY_UTXO_SIZE + sizeof(uint32_t) + pkhCount*sizeof(UInt160) +
+          sizeof(UInt256);
+    if (txCount == 0) len = 0;
+
+    if (buf && len > 0 && len <= bufLen) {
+        UInt32SetLE(&buf[off], WALLET_CONDENSED_VERSION);
+        UInt64SetLE(&buf[off + sizeof(uint32_t)], wallet->coldSent);
+        UInt64SetLE(&buf[off + sizeof(uint32_t) + sizeof(uint64_t)], wallet->coldReceived);
+        UInt32SetLE(&buf[off + sizeof(uint32_t) + sizeof(uint64_t)*2], (uint32_t)txCount);
+        off += sizeof(uint32_t) + sizeof(uint64_t)*2 + sizeof(uint32_t);
+
+        for (size_t i = 0; i < txCount; i++, off += WALLET_CONDENSED_TX_SIZE) {
+            const BRWalletTxRecord *record = &wallet->coldTx[i];
+
+            UInt256Set(&buf[off], record->txHash);
+            UInt32SetLE(&buf[off + sizeof(UInt256)], record->blockHeight);
+            UInt32SetLE(&buf[off + sizeof(UInt256) + sizeof(uint32_t)], record->timestamp);
+            UInt64SetLE(&buf[off + sizeof(UInt256) + sizeof(uint32_t)*2], record->sent);
+            UInt64SetLE(&buf[off + sizeof(UInt256) + sizeof(uint32_t)*2 + sizeof(uint64_t)], record->received);
+            UInt64SetLE(&buf[off + sizeof(UInt256) + sizeof(uint32_t)*2 + sizeof(uint64_t)*2], record->fee);
+            UInt64SetLE(&buf[off + sizeof(UInt256) + sizeof(uint32_t)*2 + sizeof(uint64_t)*3], record->balance);
+        }
 
-    for (size_t i = 0; utxos && i < utxosCount; i++) {
-        utxos[i] = wallet->utxos[i];
+        UInt32SetLE(&buf[off], (uint32_t)spentCount);
+        off += sizeof(uint32_t);
+
+        for (size_t i = 0; i < spentCount; i++, off += WALLET_SUMMARY_UTXO_SIZE) {
+            UInt256Set(&buf[off], wallet->coldSpent[i].hash);
+            UInt32SetLE(&buf[off + sizeof(UInt256)], wallet->coldSpent[i].n);
+        }
+
+        UInt32SetLE(&buf[off], (uint32_t)pkhCount);
+        off += sizeof(uint32_t);
+        memcpy(&buf[off], wallet->coldPKH, pkhCount*sizeof(UInt160));
+        off += pkhCount*sizeof(UInt160);
+        UInt256Set(&buf[off], _BRWalletSummaryChecksum(wallet->masterPubKey, buf, off));
     }
 
     pthread_mutex_unlock(&wallet->lock);
-    return utxosCount;
+    return (! buf || len <= bufLen) ? len : 0;
 }
 
-// writes transactions registered in the wallet, sorted by date, oldest first, to the given transactions array
-// returns the number of transactions written, or total number available if transactions is NULL
-size_t BRWalletTransactions(BRWallet *wallet, BRTransaction *transactions[], size_t txCount)
+// writes up to hashesCount hashes of the condensed tx in condensed, as written by BRWalletSerializeCondensed() for mpk,
+// oldest first, to the hashes array, so their stored bodies can be left out of the tx a wallet is created with
+// returns the number of hashes written, or total number available if hashes is NULL, or 0 if condensed is corrupt
+size_t BRWalletCondensedTxHashes(const uint8_t *condensed, size_t condensedLen, BRMasterPubKey mpk, UInt256 hashes[],
+                                 size_t hashesCount)
 {
-    assert(wallet != NULL);
-    pthread_mutex_lock(&wallet->lock);
-    if (! transactions || array_count(wallet->transactions) < txCount) txCount = array_count(wallet->transactions);
+    _BRWalletCondensed c;
 
-    for (size_t i = 0; transactions && i < txCount; i++) {
-        transactions[i] = wallet->transactions[i];
+    if (! _BRWalletCondensedParse(&c, condensed, condensedLen, mpk)) return 0;
+    if (! hashes || c.txCount < hashesCount) hashesCount = c.txCount;
+
+    for (size_t i = 0; hashes && i < hashesCount; i++) {
+        hashes[i] = UInt256Get(&c.txs[i*WALLET_CONDENSED_TX_SIZE]);
     }
-    
-    pthread_mutex_unlock(&wallet->lock);
-    return txCount;
+
+    return hashesCount;
 }
 
-// writes transactions registered in the wallet, and that were unconfirmed before blockHeight, to the transactions array
-// returns the number of transactions written, or total number available if transactions is NULL
-size_t BRWalletTxUnconfirmedBefore(BRWallet *wallet, BRTransaction *transactions[], size_t txCount,
-                                   uint32_t blockHeight)
+// restores condensed, as written by BRWalletSerializeCondensed(), to a wallet created with the tx that remained
+// registered, so it's as it was when condensed: its condensed tx still count towards its totals, their addresses are
+// still used and tx double spending their inputs are still invalid
+// returns true on success, or false, leaving the wallet unchanged, if condensed is corrupt, was written for another
+// mpk, or the wallet already has condensed tx or has one of them registered
+int BRWalletRestoreCondensed(BRWallet *wallet, const uint8_t *condensed, size_t condensedLen)
 {
-    size_t total, n = 0;
+    _BRWalletCondensed c;
+    const uint8_t *tx;
+    UInt256 txHash;
+    size_t i;
+    int r;
 
     assert(wallet != NULL);
     pthread_mutex_lock(&wallet->lock);
-    total = array_count(wallet->transactions);
-    while (n < total && wallet->transactions[(total - n) - 1]->blockHeight >= blockHeight) n++;
-    if (! transactions || n < txCount) txCount = n;
+    r = (array_count(wallet->coldTx) == 0 && _BRWalletCondensedParse(&c, condensed, condensedLen,
+                                                                     wallet->masterPubKey));
 
-    for (size_t i = 0; transactions && i < txCount; i++) {
-        transactions[i] = wallet->transactions[(total - n) + i];
+    for (i = 0; r && i < c.txCount; i++) {
+        txHash = UInt256Get(&c.txs[i*WALLET_CONDENSED_TX_SIZE]);
+        if (_BRTxSetGet(wallet->allTx, &txHash)) r = 0;
+    }
+
+    for (i = 0; r && i < c.txCount; i++) {
+        tx = &c.txs[i*WALLET_CONDENSED_TX_SIZE];
+        array_add(wallet->coldTx, ((const BRWalletTxRecord) {
+            UInt256Get(tx), UInt32GetLE(&tx[sizeof(UInt256)]), UInt32GetLE(&tx[sizeof(UInt256) + sizeof(uint32_t)]),
+            UInt64GetLE(&tx[sizeof(UInt256) + sizeof(uint32_t)*2]),
+            UInt64GetLE(&tx[sizeof(UInt256) + sizeof(uint32_t)*2 + sizeof(uint64_t)]),
+            UInt64GetLE(&tx[sizeof(UInt256) + sizeof(uint32_t)*2 + sizeof(uint64_t)*2]),
+            UInt64GetLE(&tx[sizeof(UInt256) + sizeof(uint32_t)*2 + sizeof(uint64_t)*3]) }));
+    }
+
+    for (i = 0; r && i < c.spentCount; i++) { // written sorted, as BRWalletCondenseTransactions() keeps them
+        array_add(wallet->coldSpent, ((const BRUTXO) { UInt256Get(&c.spent[i*WALLET_SUMMARY_UTXO_SIZE]),
+                                                       UInt32GetLE(&c.spent[i*WALLET_SUMMARY_UTXO_SIZE +
+                                                                            sizeof(UInt256)]) }));
+    }
+
+    for (i = 0; r && i < c.pkhCount; i++) {
+        array_add(wallet->coldPKH, UInt160Get(&c.pkhs[i*sizeof(UInt160)]));
+    }
+
+    if (r) {
+        for (i = 0; i < array_count(wallet->coldTx); i++) {
+            _BRTxRecordSetAdd(wallet->coldTxIndex, &wallet->coldTx[i]);
+        }
+
+        wallet->coldSent = c.sent;
+        wallet->coldReceived = c.received;
+        wallet->changeSeq++;
+        wallet->depthGen++;
+        wallet->amountsGen++;
+        _BRWalletUpdateBalance(wallet);
     }
 
     pthread_mutex_unlock(&wallet->lock);
-    return txCount;
+
+    // addresses only the condensed tx used may lie beyond the chains derived for the remaining tx
+    if (r && ! wallet->watchOnly) {
+        BRWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_EXTERNAL_CHAIN);
+        BRWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_INTERNAL, SEQUENCE_INTERNAL_CHAIN);
+    }
+
+    return r;
+}
+
+// returns a number that increases whenever a transaction is added to or removed from the wallet, or its block height
+// changes, so a UI can tell whether its copy of the transaction history is still current without fetching it again
+uint64_t BRWalletChangeSequence(BRWallet *wallet)
+{
+    uint64_t changeSeq;
+
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    changeSeq = wallet->changeSeq;
+    pthread_mutex_unlock(&wallet->lock);
+    return changeSeq;
 }
 
 // total amount spent from the wallet (exluding change)
@@ -558,17 +1725,43 @@ size_t BRWalletAllAddrs(BRWallet *wallet, BRAddress addrs[], size_t addrsCount)
     return internalCount + externalCount;
 }
 
+// writes the pubkey-hashes of all addresses previously genereated with BRWalletUnusedAddrs() to pkhs
+// returns the number of hashes written, or total number available if pkhs is NULL
+size_t BRWalletAllPKHs(BRWallet *wallet, UInt160 pkhs[], size_t pkhsCount)
+{
+    size_t internalCount = 0, externalCount = 0;
+    
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    internalCount = (! pkhs || array_count(wallet->internalChain) < pkhsCount) ?
+                    array_count(wallet->internalChain) : pkhsCount;
+    if (pkhs) memcpy(pkhs, wallet->internalChain, internalCount*sizeof(*pkhs));
+    externalCount = (! pkhs || array_count(wallet->externalChain) < pkhsCount - internalCount) ?
+                    array_count(wallet->externalChain) : pkhsCount - internalCount;
+    if (pkhs) memcpy(&pkhs[internalCount], wallet->externalChain, externalCount*sizeof(*pkhs));
+    pthread_mutex_unlock(&wallet->lock);
+    return internalCount + externalCount;
+}
+
 // true if the address was previously generated by BRWalletUnusedAddrs() (even if it's now used)
 int BRWalletContainsAddress(BRWallet *wallet, const char *addr)
 {
-    int r = 0;
     UInt160 pkh = UINT160_ZERO;
     
     assert(wallet != NULL);
     assert(addr != NULL);
-    pthread_mutex_lock(&wallet->lock);
     if (addr) BRAddressHash160(&pkh, addr);
-    r = BRSetContains(wallet->allPKH, &pkh);
+    return BRWalletContainsPKH(wallet, pkh);
+}
+
+// true if the address for pkh was previously generated by BRWalletUnusedAddrs() (even if it's now used)
+int BRWalletContainsPKH(BRWallet *wallet, UInt160 pkh)
+{
+    int r = 0;
+    
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    r = _BRPKHSetContains(wallet->allPKH, &pkh);
     pthread_mutex_unlock(&wallet->lock);
     return r;
 }
@@ -576,18 +1769,50 @@ int BRWalletContainsAddress(BRWallet *wallet, const char *addr)
 // true if the address was previously used as an output in any wallet transaction
 int BRWalletAddressIsUsed(BRWallet *wallet, const char *addr)
 {
-    int r = 0;
     UInt160 pkh = UINT160_ZERO;
     
     assert(wallet != NULL);
     assert(addr != NULL);
-    pthread_mutex_lock(&wallet->lock);
     if (addr) BRAddressHash160(&pkh, addr);
-    r = BRSetContains(wallet->usedPKH, &pkh);
+    return BRWalletPKHIsUsed(wallet, pkh);
+}
+
+// true if the address for pkh was previously used as an output in any wallet transaction
+int BRWalletPKHIsUsed(BRWallet *wallet, UInt160 pkh)
+{
+    int r = 0;
+    
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    r = _BRPKHSetContains(wallet->usedPKH, &pkh);
     pthread_mutex_unlock(&wallet->lock);
     return r;
 }
 
+// writes the scriptPubKey of the wallet address for pkh to script, legacy pay-to-pubkey-hash if the wallet has a
+// forkId, otherwise pay-to-witness-pubkey-hash
+// returns the number of bytes written, or scriptLen needed if script is NULL
+size_t BRWalletPKHScriptPubKey(BRWallet *wallet, uint8_t *script, size_t scriptLen, UInt160 pkh)
+{
+    size_t r;
+    
+    assert(wallet != NULL);
+    r = (wallet->forkId != 0) ? 25 : 22;
+    if (script && r > scriptLen) return 0;
+    
+    if (script && wallet->forkId != 0) {
+        script[0] = OP_DUP, script[1] = OP_HASH160, script[2] = 20;
+        UInt160Set(&script[3], pkh);
+        script[23] = OP_EQUALVERIFY, script[24] = OP_CHECKSIG;
+    }
+    else if (script) {
+        script[0] = OP_0, script[1] = 20;
+        UInt160Set(&script[2], pkh);
+    }
+    
+    return r;
+}
+
 // returns an unsigned transaction that sends the specified amount from the wallet to the given address
 // result must be freed by calling BRTransactionFree()
 BRTransaction *BRWalletCreateTransaction(BRWallet *wallet, uint64_t amount, const char *addr)
@@ -604,12 +1829,105 @@ BRTransaction *BRWalletCreateTransaction(BRWallet *wallet, uint64_t amount, cons
 
 // returns an unsigned transaction that satisifes the given transaction outputs
 // result must be freed by calling BRTransactionFree()
+typedef struct {
+    BRTransaction *tx;
+    uint32_t n;
+    size_t idx; // position in wallet->utxos, keeps the coin order deterministic for equal amounts
+    uint64_t amount;
+    int64_t value; // amount less the fee for spending it
+} BRCoin;
+
+inline static int _BRCoinCompare(const void *a, const void *b)
+{
+    const BRCoin *c1 = a, *c2 = b;
+    
+    if (c1->amount != c2->amount) return (c1->amount > c2->amount) ? -1 : 1; // descending amount
+    return (c1->idx > c2->idx) - (c1->idx < c2->idx);
+}
+
+// estimated vsize of a signed input spending script
+inline static size_t _BRCoinInputSize(const uint8_t *script, size_t scriptLen)
+{
+    // P2WPKH inputs carry 41 bytes outside the witness, plus a witness item count byte
+    return (scriptLen > 0 && script[0] == OP_0) ? (41*4 + TX_INPUT_SIZE + 1 + 3)/4 : TX_INPUT_SIZE;
+}
+
+// writes the wallet's spendable coins to coins, sorted by amount in descending order, and returns the count written,
+// value is computed using feePerKb, coins must have room for array_count(wallet->utxos) entries, and reserved outputs
+// are left out, see BRWalletReserveTxInputs()
+static size_t _BRWalletCoins(BRWallet *wallet, uint64_t feePerKb, BRCoin coins[])
+{
+    BRTransaction *tx;
+    BRUTXO *o;
+    size_t i, count = 0, size;
+    
+    for (i = 0; i < array_count(wallet->utxos); i++) {
+        o = &wallet->utxos[i];
+        tx = _BRTxSetGet(wallet->allTx, o);
+        if (! tx || o->n >= tx->outCount || _BRUTXOSetContains(wallet->reservedOutputs, o)) continue;
+        size = _BRCoinInputSize(tx->outputs[o->n].script, tx->outputs[o->n].scriptLen);
+        coins[count++] = (BRCoin) { tx, o->n, i, tx->outputs[o->n].amount,
+                                    (int64_t)tx->outputs[o->n].amount - (int64_t)(size*feePerKb/1000) };
+    }
+    
+    qsort(coins, count, sizeof(*coins), _BRCoinCompare);
+    return count;
+}
+
+// branch and bound search for a set of coins whose values add up to between target and target + window, so the
+// transaction can be built without a change output, coins must be sorted by amount in descending order, sets
+// best[i] to true for each selected coin, and returns the number of coins selected, or zero if no set was found
+static size_t _BRWalletSelectBnB(const BRCoin coins[], size_t count, int64_t target, int64_t window, uint8_t best[])
+{
+    uint8_t *sel = calloc((count > 0) ? count : 1, sizeof(*sel));
+    int64_t value = 0, available = 0, excess = INT64_MAX;
+    size_t i, j, depth = 0, bestCount = 0;
+    
+    assert(sel != NULL);
+    memset(best, 0, count*sizeof(*best));
+    
+    for (i = 0; i < count; i++) {
+        if (coins[i].value > 0) available += coins[i].value;
+    }
+    
+    for (i = 0; i < COIN_SELECT_MAX_TRIES; i++) {
+        if (value + available < target || value >= target) { // out of range or found a solution, backtrack
+            if (value >= target && value - target <= window && value - target < excess) {
+                excess = value - target;
+                memcpy(best, sel, depth*sizeof(*sel));
+                memset(&best[depth], 0, (count - depth)*sizeof(*best));
+                for (bestCount = 0, j = 0; j < depth; j++) bestCount += sel[j];
+                if (excess == 0) break;
+            }
+            
+            while (depth > 0 && ! sel[depth - 1]) { // walk back to the last included coin, and exclude it instead
+                depth--;
+                if (coins[depth].value > 0) available += coins[depth].value;
+            }
+            
+            if (depth == 0) break;
+            sel[depth - 1] = 0;
+            value -= coins[depth - 1].value;
+        }
+        else if (coins[depth].value <= 0) sel[depth++] = 0; // skip coins that cost more to spend than they're worth
+        else { // include the next coin
+            available -= coins[depth].value;
+            value += coins[depth].value;
+            sel[depth++] = 1;
+        }
+    }
+    
+    free(sel);
+    return bestCount;
+}
+
 BRTransaction *BRWalletCreateTxForOutputs(BRWallet *wallet, const BRTxOutput outputs[], size_t outCount)
 {
     BRTransaction *tx, *transaction = BRTransactionNew();
-    uint64_t feeAmount, amount = 0, balance = 0, minAmount;
-    size_t i, j, cpfpSize = 0;
-    BRUTXO *o;
+    uint64_t feeAmount, amount = 0, balance = 0, minAmount, feePerKb;
+    size_t i, j, k, cpfpSize = 0, coinsCount, baseSize;
+    BRCoin *coins, c;
+    uint8_t *best;
     BRAddress addr = BR_ADDRESS_NONE;
     
     assert(wallet != NULL);
@@ -623,18 +1941,59 @@ BRTransaction *BRWalletCreateTxForOutputs(BRWallet *wallet, const BRTxOutput out
     
     minAmount = BRWalletMinOutputAmount(wallet);
     pthread_mutex_lock(&wallet->lock);
-    feeAmount = _txFee(wallet->feePerKb, BRTransactionVSize(transaction) + TX_OUTPUT_SIZE);
+    baseSize = BRTransactionVSize(transaction);
+    feeAmount = _txFee(wallet->feePerKb, baseSize + TX_OUTPUT_SIZE);
+    feePerKb = (wallet->feePerKb > TX_FEE_PER_KB) ? wallet->feePerKb : TX_FEE_PER_KB;
+    coins = malloc((array_count(wallet->utxos) > 0 ? array_count(wallet->utxos) : 1)*sizeof(*coins));
+    best = malloc((array_count(wallet->utxos) > 0 ? array_count(wallet->utxos) : 1)*sizeof(*best));
+    assert(coins != NULL && best != NULL);
+    coinsCount = _BRWalletCoins(wallet, feePerKb, coins);
+    
+    // first look for a set of coins that needs no change output, with any excess below the cost of creating and later
+    // spending a change output going to the fee, the extra 99 satoshis covers rounding the fee up to 100 satoshis
+    if (_BRWalletSelectBnB(coins, coinsCount, (int64_t)(amount + baseSize*feePerKb/1000 + 99),
+                           (int64_t)((TX_OUTPUT_SIZE + TX_INPUT_SIZE)*feePerKb/1000), best) > 0) {
+        for (i = 0; i < coinsCount; i++) {
+            if (! best[i]) continue;
+            tx = coins[i].tx;
+            BRTransactionAddInput(transaction, tx->txHash, coins[i].n, coins[i].amount, tx->outputs[coins[i].n].script,
+                                  tx->outputs[coins[i].n].scriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+            balance += coins[i].amount;
+        }
+        
+        feeAmount = _txFee(wallet->feePerKb, BRTransactionVSize(transaction));
+        
+        if (BRTransactionVSize(transaction) > TX_MAX_SIZE || balance < amount + feeAmount ||
+            balance - (amount + feeAmount) > minAmount) { // estimate was off, fall back to accumulating inputs
+            BRTransactionFree(transaction);
+            transaction = BRTransactionNew();
+            for (i = 0; i < outCount; i++) {
+                BRTransactionAddOutput(transaction, outputs[i].amount, outputs[i].script, outputs[i].scriptLen);
+            }
+            
+            balance = 0;
+            feeAmount = _txFee(wallet->feePerKb, baseSize + TX_OUTPUT_SIZE);
+        }
+        else coinsCount = 0, feeAmount = balance - amount; // any excess goes to the fee
+    }
+    
+    // otherwise start with the smallest single coin that covers the amount and leaves change, so larger coins are kept
+    for (i = coinsCount, k = SIZE_MAX; i > 0 && k == SIZE_MAX; i--) {
+        j = baseSize + _BRCoinInputSize(coins[i - 1].tx->outputs[coins[i - 1].n].script,
+                                        coins[i - 1].tx->outputs[coins[i - 1].n].scriptLen) + TX_OUTPUT_SIZE;
+        if (coins[i - 1].amount >= amount + _txFee(wallet->feePerKb, j) + minAmount) k = i - 1;
+    }
+    
+    if (k != SIZE_MAX && k > 0) c = coins[k], memmove(&coins[1], coins, k*sizeof(*coins)), coins[0] = c;
     
     // TODO: use up all UTXOs for all used addresses to avoid leaving funds in addresses whose public key is revealed
     // TODO: avoid combining addresses in a single transaction when possible to reduce information leakage
     // TODO: use up UTXOs received from any of the output scripts that this transaction sends funds to, to mitigate an
     //       attacker double spending and requesting a refund
-    for (i = 0; i < array_count(wallet->utxos); i++) {
-        o = &wallet->utxos[i];
-        tx = BRSetGet(wallet->allTx, o);
-        if (! tx || o->n >= tx->outCount) continue;
-        BRTransactionAddInput(transaction, tx->txHash, o->n, tx->outputs[o->n].amount,
-                              tx->outputs[o->n].script, tx->outputs[o->n].scriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    for (i = 0; i < coinsCount; i++) { // then accumulate the largest remaining coins
+        tx = coins[i].tx;
+        BRTransactionAddInput(transaction, tx->txHash, coins[i].n, coins[i].amount, tx->outputs[coins[i].n].script,
+                              tx->outputs[coins[i].n].scriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
         
         if (BRTransactionVSize(transaction) + TX_OUTPUT_SIZE > TX_MAX_SIZE) { // transaction size-in-bytes too large
             BRTransactionFree(transaction);
@@ -662,7 +2021,7 @@ BRTransaction *BRWalletCreateTxForOutputs(BRWallet *wallet, const BRTxOutput out
             break;
         }
         
-        balance += tx->outputs[o->n].amount;
+        balance += coins[i].amount;
         
 //        // size of unconfirmed, non-change inputs for child-pays-for-parent fee
 //        // don't include parent tx with more than 10 inputs or 10 outputs
@@ -679,6 +2038,8 @@ BRTransaction *BRWalletCreateTxForOutputs(BRWallet *wallet, const BRTxOutput out
     }
     
     pthread_mutex_unlock(&wallet->lock);
+    free(coins);
+    free(best);
     
     if (transaction && (outCount < 1 || balance < amount + feeAmount)) { // no outputs/insufficient funds
         BRTransactionFree(transaction);
@@ -723,15 +2084,31 @@ int BRWalletSignTransaction(BRWallet *wallet, BRTransaction *tx, const void *see
     }
 
     pthread_mutex_unlock(&wallet->lock);
+    
+    // derive each key once, even when several inputs spend outputs sent to the same address
+    qsort(internalIdx, internalCount, sizeof(*internalIdx), _uint32Compare);
+    qsort(externalIdx, externalCount, sizeof(*externalIdx), _uint32Compare);
+    
+    for (i = 0, j = 0; i < internalCount; i++) {
+        if (j == 0 || internalIdx[j - 1] != internalIdx[i]) internalIdx[j++] = internalIdx[i];
+    }
+    
+    internalCount = j;
+    
+    for (i = 0, j = 0; i < externalCount; i++) {
+        if (j == 0 || externalIdx[j - 1] != externalIdx[i]) externalIdx[j++] = externalIdx[i];
+    }
+    
+    externalCount = j;
 
-    BRKey keys[internalCount + externalCount];
+    BRKey keys[(internalCount + externalCount > 0) ? internalCount + externalCount : 1];
 
     if (seed) {
         BRBIP32PrivKeyList(keys, internalCount, seed, seedLen, SEQUENCE_INTERNAL_CHAIN, internalIdx);
         BRBIP32PrivKeyList(&keys[internalCount], externalCount, seed, seedLen, SEQUENCE_EXTERNAL_CHAIN, externalIdx);
         // TODO: XXX wipe seed callback
         seed = NULL;
-        if (tx) r = BRTransactionSign(tx, forkId, keys, internalCount + externalCount);
+        if (tx) r = BRTransactionSignThreads(tx, forkId, keys, internalCount + externalCount, 0);
         for (i = 0; i < internalCount + externalCount; i++) BRKeyClean(&keys[i]);
     }
     else r = -1; // user canceled authentication
@@ -739,6 +2116,45 @@ int BRWalletSignTransaction(BRWallet *wallet, BRTransaction *tx, const void *see
     return r;
 }
 
+// reserves the wallet outputs spent by tx, an unpublished transaction from BRWalletCreateTxForOutputs(), so they aren't
+// selected again for another transaction while tx is signed and published, returns false without reserving any of
+// them if one was already reserved, tx must not be freed or modified until BRWalletReleaseTxInputs() is called for it
+int BRWalletReserveTxInputs(BRWallet *wallet, const BRTransaction *tx)
+{
+    int r = 1;
+    
+    assert(wallet != NULL);
+    assert(tx != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    
+    for (size_t i = 0; tx && i < tx->inCount && r; i++) {
+        if (_BRUTXOSetContains(wallet->reservedOutputs, &tx->inputs[i])) r = 0;
+    }
+    
+    for (size_t i = 0; tx && r && i < tx->inCount; i++) {
+        BRSetAdd(wallet->reservedOutputs, &tx->inputs[i]); // BRTxInput starts with the same hash and index as BRUTXO
+    }
+    
+    pthread_mutex_unlock(&wallet->lock);
+    return r;
+}
+
+// releases the outputs reserved for tx by BRWalletReserveTxInputs(), once it's either published (and registered, so
+// its inputs are spent) or abandoned
+void BRWalletReleaseTxInputs(BRWallet *wallet, const BRTransaction *tx)
+{
+    assert(wallet != NULL);
+    assert(tx != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    
+    for (size_t i = 0; tx && i < tx->inCount; i++) {
+        if (BRSetGet(wallet->reservedOutputs, &tx->inputs[i]) != &tx->inputs[i]) continue; // reserved by another tx
+        BRSetRemove(wallet->reservedOutputs, &tx->inputs[i]);
+    }
+    
+    pthread_mutex_unlock(&wallet->lock);
+}
+
 // true if the given transaction is associated with the wallet (even if it hasn't been registered)
 int BRWalletContainsTransaction(BRWallet *wallet, const BRTransaction *tx)
 {
@@ -752,10 +2168,44 @@ int BRWalletContainsTransaction(BRWallet *wallet, const BRTransaction *tx)
     return r;
 }
 
+// same as BRWalletContainsTransaction(), for a tx that's only been indexed with BRTransactionViewParse()
+int BRWalletContainsTransactionView(BRWallet *wallet, const BRTransactionView *view)
+{
+    const uint8_t *script, *pkh;
+    size_t i, off, scriptLen;
+    UInt256 txHash;
+    uint32_t n;
+    int r = 0;
+    
+    assert(wallet != NULL);
+    assert(view != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    
+    for (i = 0, off = view->outOff; ! r && ! _BRWalletIsColdTx(wallet, view->txHash) && i < view->outCount; i++) {
+        off = BRTransactionViewOutput(view, off, NULL, &script, &scriptLen);
+        pkh = BRScriptPKH(script, scriptLen);
+        if (pkh && _BRWalletPrefilterContains(wallet, pkh) && _BRPKHSetContains(wallet->allPKH, pkh)) r = 1;
+    }
+    
+    for (i = 0, off = view->inOff; ! r && i < view->inCount; i++) {
+        off = BRTransactionViewInput(view, off, &txHash, &n, NULL, NULL);
+        if (! _BRWalletPrefilterContains(wallet, &txHash)) continue;
+        
+        BRTransaction *t = _BRTxSetGet(wallet->allTx, &txHash);
+        
+        pkh = (t && n < t->outCount) ? BRScriptPKH(t->outputs[n].script, t->outputs[n].scriptLen) : NULL;
+        if (pkh && _BRPKHSetContains(wallet->allPKH, pkh)) r = 1;
+    }
+    
+    pthread_mutex_unlock(&wallet->lock);
+    return r;
+}
+
 // adds a transaction to the wallet, or returns false if it isn't associated with the wallet
 int BRWalletRegisterTransaction(BRWallet *wallet, BRTransaction *tx)
 {
-    int wasAdded = 0, r = 1;
+    int wasAdded = 0, isBatch = 0, r = 1;
+    const uint8_t *pkh;
     
     assert(wallet != NULL);
     assert(tx != NULL && BRTransactionIsSigned(tx));
@@ -763,19 +2213,40 @@ int BRWalletRegisterTransaction(BRWallet *wallet, BRTransaction *tx)
     if (tx && BRTransactionIsSigned(tx)) {
         pthread_mutex_lock(&wallet->lock);
 
-        if (! BRSetContains(wallet->allTx, tx)) {
+        if (! _BRTxSetContains(wallet->allTx, tx)) {
             if (_BRWalletContainsTx(wallet, tx)) {
                 // TODO: verify signatures when possible
                 // TODO: handle tx replacement with input sequence numbers
                 //       (for now, replacements appear invalid until confirmation)
-                BRSetAdd(wallet->allTx, tx);
+                _BRTxSetAdd(wallet->allTx, tx);
+                _BRWalletTxIndexAdd(wallet, tx);
+                _BRWalletPrefilterAdd(wallet, &tx->txHash);
+                _BRWalletTxDepthAdded(wallet, tx);
                 _BRWalletInsertTx(wallet, tx);
-                _BRWalletUpdateBalance(wallet);
+                _BRWalletIndexAddTx(wallet, tx);
+                isBatch = (wallet->batchDepth > 0);
+                if (! isBatch) _BRWalletUpdateBalanceForTx(wallet, tx);
                 wasAdded = 1;
+
+                if (isBatch) { // the balance can wait for the batch commit, but used addresses extend the gap limit now
+                    for (size_t i = 0; i < tx->outCount; i++) {
+                        pkh = BRScriptPKH(tx->outputs[i].script, tx->outputs[i].scriptLen);
+                        if (pkh && _BRPKHSetContains(wallet->allPKH, pkh)) _BRPKHSetAdd(wallet->usedPKH, (void *)pkh);
+                    }
+
+                    array_add(wallet->batchAdded, tx);
+                    wallet->batchNeedsUpdate = 1;
+                }
             }
             else { // keep track of unconfirmed non-wallet tx for invalid tx checks and child-pays-for-parent fees
                    // BUG: limit total non-wallet unconfirmed tx to avoid memory exhaustion attack
-                if (tx->blockHeight == TX_UNCONFIRMED) BRSetAdd(wallet->allTx, tx);
+                if (tx->blockHeight == TX_UNCONFIRMED) {
+                    _BRTxSetAdd(wallet->allTx, tx);
+                    _BRWalletTxIndexAdd(wallet, tx);
+                    _BRWalletPrefilterAdd(wallet, &tx->txHash);
+                    _BRWalletTxDepthAdded(wallet, tx);
+                }
+                
                 r = 0;
                 // BUG: XXX memory leak if tx is not added to wallet->allTx, and we can't just free it
             }
@@ -789,24 +2260,44 @@ int BRWalletRegisterTransaction(BRWallet *wallet, BRTransaction *tx)
         // when a wallet address is used in a transaction, generate a new address to replace it
         BRWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_EXTERNAL, 0);
         BRWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_INTERNAL, 1);
-        if (wallet->balanceChanged) wallet->balanceChanged(wallet->callbackInfo, wallet->balance);
-        if (wallet->txAdded) wallet->txAdded(wallet->callbackInfo, tx);
+        if (! isBatch && wallet->balanceChanged) wallet->balanceChanged(wallet->callbackInfo, wallet->balance);
+        if (! isBatch && wallet->txAdded) wallet->txAdded(wallet->callbackInfo, tx);
     }
 
     return r;
 }
 
+// calls txDeleted() for tx after it was removed from wallet->transactions, wallet->lock must not be held
+static void _BRWalletTxDeleted(BRWallet *wallet, BRTransaction *tx)
+{
+    BRTransaction *t;
+    int notifyUser = 0, recommendRescan = 0;
+
+    // if this is for a transaction we sent, and it wasn't already known to be invalid, notify user
+    if (BRWalletAmountSentByTx(wallet, tx) > 0 && BRWalletTransactionIsValid(wallet, tx)) {
+        recommendRescan = notifyUser = 1;
+        
+        for (size_t i = 0; i < tx->inCount; i++) { // only recommend a rescan if all inputs are confirmed
+            t = BRWalletTransactionForHash(wallet, tx->inputs[i].txHash);
+            if (t && t->blockHeight != TX_UNCONFIRMED) continue;
+            recommendRescan = 0;
+            break;
+        }
+    }
+
+    if (wallet->txDeleted) wallet->txDeleted(wallet->callbackInfo, tx->txHash, notifyUser, recommendRescan);
+}
+
 // removes a tx from the wallet, along with any tx that depend on its outputs
 void BRWalletRemoveTransaction(BRWallet *wallet, UInt256 txHash)
 {
     BRTransaction *tx, *t;
     UInt256 *hashes = NULL;
-    int notifyUser = 0, recommendRescan = 0;
 
     assert(wallet != NULL);
     assert(! UInt256IsZero(txHash));
     pthread_mutex_lock(&wallet->lock);
-    tx = BRSetGet(wallet->allTx, &txHash);
+    tx = _BRTxSetGet(wallet->allTx, &txHash);
 
     if (tx) {
         array_new(hashes, 0);
@@ -832,30 +2323,30 @@ void BRWalletRemoveTransaction(BRWallet *wallet, UInt256 txHash)
             
             BRWalletRemoveTransaction(wallet, txHash);
         }
+        else if (wallet->batchDepth > 0) {
+            for (size_t i = array_count(wallet->transactions); i > 0; i--) {
+                if (! BRTransactionEq(wallet->transactions[i - 1], tx)) continue;
+                array_rm(wallet->transactions, i - 1);
+                wallet->changeSeq++;
+                break;
+            }
+
+            array_add(wallet->batchRemoved, txHash);
+            wallet->batchNeedsUpdate = 1;
+            pthread_mutex_unlock(&wallet->lock);
+        }
         else {
             for (size_t i = array_count(wallet->transactions); i > 0; i--) {
                 if (! BRTransactionEq(wallet->transactions[i - 1], tx)) continue;
                 array_rm(wallet->transactions, i - 1);
+                wallet->changeSeq++;
                 break;
             }
             
             _BRWalletUpdateBalance(wallet);
             pthread_mutex_unlock(&wallet->lock);
-            
-            // if this is for a transaction we sent, and it wasn't already known to be invalid, notify user
-            if (BRWalletAmountSentByTx(wallet, tx) > 0 && BRWalletTransactionIsValid(wallet, tx)) {
-                recommendRescan = notifyUser = 1;
-                
-                for (size_t i = 0; i < tx->inCount; i++) { // only recommend a rescan if all inputs are confirmed
-                    t = BRWalletTransactionForHash(wallet, tx->inputs[i].txHash);
-                    if (t && t->blockHeight != TX_UNCONFIRMED) continue;
-                    recommendRescan = 0;
-                    break;
-                }
-            }
-
             if (wallet->balanceChanged) wallet->balanceChanged(wallet->callbackInfo, wallet->balance);
-            if (wallet->txDeleted) wallet->txDeleted(wallet->callbackInfo, txHash, notifyUser, recommendRescan);
+            _BRWalletTxDeleted(wallet, tx);
         }
         
         array_free(hashes);
@@ -866,14 +2357,9 @@ void BRWalletRemoveTransaction(BRWallet *wallet, UInt256 txHash)
 // returns the transaction with the given hash if it's been registered in the wallet
 BRTransaction *BRWalletTransactionForHash(BRWallet *wallet, UInt256 txHash)
 {
-    BRTransaction *tx;
-    
     assert(wallet != NULL);
     assert(! UInt256IsZero(txHash));
-    pthread_mutex_lock(&wallet->lock);
-    tx = BRSetGet(wallet->allTx, &txHash);
-    pthread_mutex_unlock(&wallet->lock);
-    return tx;
+    return BRConcurrentSetGetWith(wallet->txIndex, &txHash, _txIndexTx); // without wallet->lock, so sync can't block it
 }
 
 // true if no previous wallet transaction spends any of the given transaction's inputs, and no inputs are invalid
@@ -891,12 +2377,13 @@ int BRWalletTransactionIsValid(BRWallet *wallet, const BRTransaction *tx)
     if (tx && tx->blockHeight == TX_UNCONFIRMED) { // only unconfirmed transactions can be invalid
         pthread_mutex_lock(&wallet->lock);
 
-        if (! BRSetContains(wallet->allTx, tx)) {
+        if (! _BRTxSetContains(wallet->allTx, tx)) {
             for (size_t i = 0; r && i < tx->inCount; i++) {
-                if (BRSetContains(wallet->spentOutputs, &tx->inputs[i])) r = 0;
+                if (_BRUTXOSetContains(wallet->spentOutputs, &tx->inputs[i]) ||
+                    _BRWalletIsColdSpent(wallet, tx->inputs[i].txHash, tx->inputs[i].index)) r = 0;
             }
         }
-        else if (BRSetContains(wallet->invalidTx, tx)) r = 0;
+        else if (_BRTxSetContains(wallet->invalidTx, tx)) r = 0;
 
         pthread_mutex_unlock(&wallet->lock);
 
@@ -975,22 +2462,27 @@ void BRWalletUpdateTransactions(BRWallet *wallet, const UInt256 txHashes[], size
 {
     BRTransaction *tx;
     UInt256 hashes[txCount];
-    int needsUpdate = 0;
+    int needsUpdate = 0, isBatch;
     size_t i, j, k;
+    BR_TRACE_BEGIN(traceBegin);
     
     assert(wallet != NULL);
     assert(txHashes != NULL || txCount == 0);
     pthread_mutex_lock(&wallet->lock);
+    isBatch = (wallet->batchDepth > 0);
     if (blockHeight > wallet->blockHeight) wallet->blockHeight = blockHeight;
     
     for (i = 0, j = 0; txHashes && i < txCount; i++) {
-        tx = BRSetGet(wallet->allTx, &txHashes[i]);
+        tx = _BRTxSetGet(wallet->allTx, &txHashes[i]);
         if (! tx || (tx->blockHeight == blockHeight && tx->timestamp == timestamp)) continue;
         tx->timestamp = timestamp;
         tx->blockHeight = blockHeight;
+        wallet->depthGen++;
         
         if (_BRWalletContainsTx(wallet, tx)) {
-            for (k = array_count(wallet->transactions); k > 0; k--) { // remove and re-insert tx to keep wallet sorted
+            if (isBatch) wallet->batchNeedsSort = 1; // the whole wallet is re-sorted once when the batch is committed
+
+            for (k = (isBatch) ? 0 : array_count(wallet->transactions); k > 0; k--) { // re-insert to keep wallet sorted
                 if (! BRTransactionEq(wallet->transactions[k - 1], tx)) continue;
                 array_rm(wallet->transactions, k - 1);
                 _BRWalletInsertTx(wallet, tx);
@@ -998,17 +2490,30 @@ void BRWalletUpdateTransactions(BRWallet *wallet, const UInt256 txHashes[], size
             }
             
             hashes[j++] = txHashes[i];
-            if (BRSetContains(wallet->pendingTx, tx) || BRSetContains(wallet->invalidTx, tx)) needsUpdate = 1;
+            wallet->changeSeq++;
+            if (_BRTxSetContains(wallet->pendingTx, tx) || _BRTxSetContains(wallet->invalidTx, tx)) needsUpdate = 1;
         }
         else if (blockHeight != TX_UNCONFIRMED) { // remove and free confirmed non-wallet tx
-            BRSetRemove(wallet->allTx, tx);
+            _BRTxSetRemove(wallet->allTx, tx);
+            _BRWalletTxIndexRemove(wallet, tx);
             BRTransactionFree(tx);
+            wallet->amountsGen++;
         }
     }
     
-    if (needsUpdate) _BRWalletUpdateBalance(wallet);
+    if (isBatch) {
+        if (needsUpdate) wallet->batchNeedsUpdate = 1;
+        array_add_array(wallet->batchUpdated, hashes, j);
+    }
+    else if (needsUpdate) _BRWalletUpdateBalance(wallet);
+
     pthread_mutex_unlock(&wallet->lock);
-    if (j > 0 && wallet->txUpdated) wallet->txUpdated(wallet->callbackInfo, hashes, j, blockHeight, timestamp);
+
+    if (! isBatch && j > 0 && wallet->txUpdated) {
+        wallet->txUpdated(wallet->callbackInfo, hashes, j, blockHeight, timestamp);
+    }
+
+    BR_TRACE_END(BRTraceWalletUpdate, traceBegin, txCount);
 }
 
 // marks all transactions confirmed after blockHeight as unconfirmed (useful for chain re-orgs)
@@ -1018,6 +2523,7 @@ void BRWalletSetTxUnconfirmedAfter(BRWallet *wallet, uint32_t blockHeight)
     
     assert(wallet != NULL);
     pthread_mutex_lock(&wallet->lock);
+    if (wallet->batchNeedsSort) _BRWalletSortTx(wallet);
     wallet->blockHeight = blockHeight;
     count = i = array_count(wallet->transactions);
     while (i > 0 && wallet->transactions[i - 1]->blockHeight > blockHeight) i--;
@@ -1027,101 +2533,268 @@ void BRWalletSetTxUnconfirmedAfter(BRWallet *wallet, uint32_t blockHeight)
 
     for (j = 0; j < count; j++) {
         wallet->transactions[i + j]->blockHeight = TX_UNCONFIRMED;
+        wallet->changeSeq++;
         hashes[j] = wallet->transactions[i + j]->txHash;
     }
     
+    if (count > 0) wallet->depthGen++, wallet->amountsGen++;
+    
     if (count > 0) _BRWalletUpdateBalance(wallet);
     pthread_mutex_unlock(&wallet->lock);
     if (count > 0 && wallet->txUpdated) wallet->txUpdated(wallet->callbackInfo, hashes, count, TX_UNCONFIRMED, 0);
 }
 
-// returns the amount received by the wallet from the transaction (total outputs to change and/or receive addresses)
-uint64_t BRWalletAmountReceivedFromTx(BRWallet *wallet, const BRTransaction *tx)
+// applies a chain re-org as one update, same as BRWalletSetTxUnconfirmedAfter(wallet, joinHeight) followed by
+// BRWalletUpdateTransactions() for each of txHashes with the block height and timestamp of the same index, except the
+// balance is only updated once, and txUpdated() is only called for transactions that end up with a different block
+// height or timestamp than before, once for those no longer confirmed and once for each run of the same height
+void BRWalletReorgTransactions(BRWallet *wallet, uint32_t joinHeight, const UInt256 txHashes[],
+                               const uint32_t blockHeights[], const uint32_t timestamps[], size_t txCount)
 {
-    uint64_t amount = 0;
-    const uint8_t *pkh;
+    BRTransaction *tx, **tail;
+    BRSet *confirmed = BRSetNew(BRTransactionHash, BRTransactionEq, txCount);
+    UInt256 *unconfirmedHashes, *confirmedHashes;
+    uint32_t *heights, *times;
+    size_t i, j, k, start, unconfirmedCount = 0, confirmedCount = 0;
     
     assert(wallet != NULL);
-    assert(tx != NULL);
+    assert(txHashes != NULL || txCount == 0);
+    assert(blockHeights != NULL || txCount == 0);
+    assert(timestamps != NULL || txCount == 0);
     pthread_mutex_lock(&wallet->lock);
+    if (wallet->batchNeedsSort) _BRWalletSortTx(wallet);
+    wallet->blockHeight = joinHeight;
+    start = array_count(wallet->transactions);
+    while (start > 0 && wallet->transactions[start - 1]->blockHeight > joinHeight) start--;
+    array_new(tail, array_count(wallet->transactions) - start + 1);
+    array_add_array(tail, &wallet->transactions[start], array_count(wallet->transactions) - start);
+    array_set_count(wallet->transactions, start); // the tail is re-inserted once its block heights are updated
+    confirmedHashes = malloc((txCount + 1)*sizeof(*confirmedHashes));
+    heights = malloc((txCount + 1)*sizeof(*heights));
+    times = malloc((txCount + 1)*sizeof(*times));
+    assert(confirmedHashes != NULL && heights != NULL && times != NULL);
+    
+    // transactions in the new main chain after the join point get their new block height and timestamp
+    for (i = 0; txHashes && i < txCount; i++) {
+        if (blockHeights[i] != TX_UNCONFIRMED && blockHeights[i] > wallet->blockHeight) {
+            wallet->blockHeight = blockHeights[i];
+        }
+        
+        tx = _BRTxSetGet(wallet->allTx, &txHashes[i]);
+        if (! tx || _BRTxSetContains(confirmed, tx)) continue;
+        
+        if (! _BRWalletContainsTx(wallet, tx)) {
+            if (blockHeights[i] != TX_UNCONFIRMED) { // remove and free confirmed non-wallet tx
+                _BRTxSetRemove(wallet->allTx, tx);
+                _BRWalletTxIndexRemove(wallet, tx);
+                BRTransactionFree(tx);
+                wallet->amountsGen++;
+            }
+            
+            continue;
+        }
+        
+        _BRTxSetAdd(confirmed, tx);
+        if (tx->blockHeight == blockHeights[i] && tx->timestamp == timestamps[i]) continue;
+        
+        for (k = (tx->blockHeight <= joinHeight) ? start : 0; k > 0; k--) { // move a tx from before the tail into it
+            if (wallet->transactions[k - 1] != tx) continue;
+            array_rm(wallet->transactions, k - 1);
+            array_add(tail, tx);
+            start--;
+            break;
+        }
+        
+        tx->blockHeight = blockHeights[i];
+        tx->timestamp = timestamps[i];
+        confirmedHashes[confirmedCount] = tx->txHash;
+        heights[confirmedCount] = tx->blockHeight;
+        times[confirmedCount++] = tx->timestamp;
+    }
     
-    // TODO: don't include outputs below TX_MIN_OUTPUT_AMOUNT
-    for (size_t i = 0; tx && i < tx->outCount; i++) {
-        pkh = BRScriptPKH(tx->outputs[i].script, tx->outputs[i].scriptLen);
-        if (pkh && BRSetContains(wallet->allPKH, pkh)) amount += tx->outputs[i].amount;
+    unconfirmedHashes = malloc((array_count(tail) + 1)*sizeof(*unconfirmedHashes));
+    assert(unconfirmedHashes != NULL);
+    
+    for (i = 0; i < array_count(tail); i++) { // the rest of the tail is no longer confirmed
+        if (_BRTxSetContains(confirmed, tail[i]) || tail[i]->blockHeight == TX_UNCONFIRMED) continue;
+        tail[i]->blockHeight = TX_UNCONFIRMED;
+        unconfirmedHashes[unconfirmedCount++] = tail[i]->txHash;
     }
     
+    wallet->depthGen++;
+    wallet->amountsGen++;
+    for (i = 0; i < array_count(tail); i++) _BRWalletInsertTx(wallet, tail[i]); // re-insert to keep wallet sorted
+    if (unconfirmedCount > 0 || confirmedCount > 0) _BRWalletUpdateBalance(wallet);
     pthread_mutex_unlock(&wallet->lock);
-    return amount;
+    
+    if (unconfirmedCount > 0 && wallet->txUpdated) {
+        wallet->txUpdated(wallet->callbackInfo, unconfirmedHashes, unconfirmedCount, TX_UNCONFIRMED, 0);
+    }
+    
+    for (i = 0; wallet->txUpdated && i < confirmedCount; i = j) { // one call for each run of the same block
+        for (j = i + 1; j < confirmedCount && heights[j] == heights[i] && times[j] == times[i]; j++);
+        wallet->txUpdated(wallet->callbackInfo, &confirmedHashes[i], j - i, heights[i], times[i]);
+    }
+    
+    BRSetFree(confirmed);
+    array_free(tail);
+    free(unconfirmedHashes);
+    free(times);
+    free(heights);
+    free(confirmedHashes);
 }
 
-// returns the amount sent from the wallet by the trasaction (total wallet outputs consumed, change and fee included)
-uint64_t BRWalletAmountSentByTx(BRWallet *wallet, const BRTransaction *tx)
+// starts a batch of transaction registrations, updates and removals, which are applied together by the matching call
+// to BRWalletCommitBatch(), with re-sorting, balance recalculation and callbacks done once for the whole batch
+// batches may be nested, and are applied when the outermost one is committed
+// while a batch is open, transactions are registered and their block heights set immediately, but the balance, UTXOs
+// and transaction order aren't updated until the batch is committed
+void BRWalletBeginBatch(BRWallet *wallet)
+{
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    if (wallet->batchDepth++ == 0) wallet->batchBalance = wallet->balance;
+    pthread_mutex_unlock(&wallet->lock);
+}
+
+// commits a batch started by BRWalletBeginBatch(), calling balanceChanged() once if the batch added or removed
+// transactions or changed the balance, then txAdded(), txUpdated() and txDeleted() for the batched transactions
+// txUpdated() is called once for each run of transactions that ended the batch with the same block height and timestamp
+void BRWalletCommitBatch(BRWallet *wallet)
+{
+    BRTransaction *tx, **added = NULL;
+    BRSet *updated;
+    UInt256 *hashes = NULL;
+    uint32_t *heights = NULL, *times = NULL;
+    size_t i, j, addedCount, updatedCount = 0, removedCount;
+    int balanceChanged;
+
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    assert(wallet->batchDepth > 0);
+    if (wallet->batchDepth > 0) wallet->batchDepth--;
+
+    if (wallet->batchDepth > 0) {
+        pthread_mutex_unlock(&wallet->lock);
+        return;
+    }
+
+    if (wallet->batchNeedsSort) _BRWalletSortTx(wallet);
+    if (wallet->batchNeedsUpdate) _BRWalletUpdateBalance(wallet);
+    wallet->batchNeedsUpdate = 0;
+    addedCount = array_count(wallet->batchAdded);
+    removedCount = array_count(wallet->batchRemoved);
+    balanceChanged = (addedCount > 0 || removedCount > 0 || wallet->balance != wallet->batchBalance);
+    added = malloc((addedCount + removedCount + 1)*sizeof(*added));
+    hashes = malloc((array_count(wallet->batchUpdated) + 1)*sizeof(*hashes));
+    heights = malloc((array_count(wallet->batchUpdated) + 1)*sizeof(*heights));
+    times = malloc((array_count(wallet->batchUpdated) + 1)*sizeof(*times));
+    assert(added != NULL && hashes != NULL && heights != NULL && times != NULL);
+    memcpy(added, wallet->batchAdded, addedCount*sizeof(*added));
+
+    for (i = 0; i < removedCount; i++) { // removed transactions are kept in allTx, the same as outside a batch
+        added[addedCount + i] = _BRTxSetGet(wallet->allTx, &wallet->batchRemoved[i]);
+    }
+
+    updated = BRSetNew(BRTransactionHash, BRTransactionEq, array_count(wallet->batchUpdated));
+
+    for (i = 0; i < array_count(wallet->batchUpdated); i++) { // report each tx once, with where it ended up
+        tx = _BRTxSetGet(wallet->allTx, &wallet->batchUpdated[i]);
+        if (! tx || _BRTxSetContains(updated, tx)) continue;
+        _BRTxSetAdd(updated, tx);
+        hashes[updatedCount] = tx->txHash;
+        heights[updatedCount] = tx->blockHeight;
+        times[updatedCount++] = tx->timestamp;
+    }
+
+    BRSetFree(updated);
+    array_clear(wallet->batchAdded);
+    array_clear(wallet->batchUpdated);
+    array_clear(wallet->batchRemoved);
+    pthread_mutex_unlock(&wallet->lock);
+
+    if (balanceChanged && wallet->balanceChanged) wallet->balanceChanged(wallet->callbackInfo, wallet->balance);
+
+    for (i = 0; wallet->txAdded && i < addedCount; i++) wallet->txAdded(wallet->callbackInfo, added[i]);
+
+    for (i = 0; wallet->txUpdated && i < updatedCount; i = j) {
+        for (j = i + 1; j < updatedCount && heights[j] == heights[i] && times[j] == times[i]; j++);
+        wallet->txUpdated(wallet->callbackInfo, &hashes[i], j - i, heights[i], times[i]);
+    }
+
+    for (i = addedCount; i < addedCount + removedCount; i++) {
+        if (added[i]) _BRWalletTxDeleted(wallet, added[i]);
+    }
+
+    free(times);
+    free(heights);
+    free(hashes);
+    free(added);
+}
+
+// returns the amount received by the wallet from the transaction (total outputs to change and/or receive addresses)
+uint64_t BRWalletAmountReceivedFromTx(BRWallet *wallet, const BRTransaction *tx)
 {
-    uint64_t amount = 0;
+    uint64_t sent = 0, received = 0, fee = 0;
     
     assert(wallet != NULL);
     assert(tx != NULL);
     pthread_mutex_lock(&wallet->lock);
-    
-    for (size_t i = 0; tx && i < tx->inCount; i++) {
-        BRTransaction *t = BRSetGet(wallet->allTx, &tx->inputs[i].txHash);
-        uint32_t n = tx->inputs[i].index;
-        const uint8_t *pkh;
+    if (tx) _BRWalletTxAmounts(wallet, tx, &sent, &received, &fee);
+    pthread_mutex_unlock(&wallet->lock);
+    return received;
+}
 
-        if (t && n < t->outCount) {
-            pkh = BRScriptPKH(t->outputs[n].script, t->outputs[n].scriptLen);
-            if (pkh && BRSetContains(wallet->allPKH, pkh)) amount += t->outputs[n].amount;
-        }
-    }
+// returns the amount sent from the wallet by the trasaction (total wallet outputs consumed, change and fee included)
+uint64_t BRWalletAmountSentByTx(BRWallet *wallet, const BRTransaction *tx)
+{
+    uint64_t sent = 0, received = 0, fee = 0;
     
+    assert(wallet != NULL);
+    assert(tx != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    if (tx) _BRWalletTxAmounts(wallet, tx, &sent, &received, &fee);
     pthread_mutex_unlock(&wallet->lock);
-    return amount;
+    return sent;
 }
 
 // returns the fee for the given transaction if all its inputs are from wallet transactions, UINT64_MAX otherwise
 uint64_t BRWalletFeeForTx(BRWallet *wallet, const BRTransaction *tx)
 {
-    uint64_t amount = 0;
+    uint64_t sent = 0, received = 0, fee = 0;
     
     assert(wallet != NULL);
     assert(tx != NULL);
     pthread_mutex_lock(&wallet->lock);
-    
-    for (size_t i = 0; tx && i < tx->inCount && amount != UINT64_MAX; i++) {
-        BRTransaction *t = BRSetGet(wallet->allTx, &tx->inputs[i].txHash);
-        uint32_t n = tx->inputs[i].index;
-        
-        if (t && n < t->outCount) {
-            amount += t->outputs[n].amount;
-        }
-        else amount = UINT64_MAX;
-    }
-    
+    if (tx) _BRWalletTxAmounts(wallet, tx, &sent, &received, &fee);
     pthread_mutex_unlock(&wallet->lock);
-    
-    for (size_t i = 0; tx && i < tx->outCount && amount != UINT64_MAX; i++) {
-        amount -= tx->outputs[i].amount;
-    }
-    
-    return amount;
+    return fee;
 }
 
 // historical wallet balance after the given transaction, or current balance if transaction is not registered in wallet
 uint64_t BRWalletBalanceAfterTx(BRWallet *wallet, const BRTransaction *tx)
 {
     uint64_t balance;
+    BRTransaction *t;
+    size_t i, count;
     
     assert(wallet != NULL);
     assert(tx != NULL && BRTransactionIsSigned(tx));
     pthread_mutex_lock(&wallet->lock);
     balance = wallet->balance;
+    count = array_count(wallet->transactions);
+    t = (tx) ? _BRTxSetGet(wallet->allTx, tx) : NULL; // the registered tx, which is sorted by its own block height
+    
+    // transactions are sorted by block height, so only the run at t's height is searched, unless heights were updated
+    // in an open batch without re-sorting
+    i = (t && ! wallet->batchNeedsSort) ? _BRWalletTxHeightIndex(wallet, t->blockHeight) : 0;
     
-    for (size_t i = array_count(wallet->transactions); tx && i > 0; i--) {
-        if (! BRTransactionEq(tx, wallet->transactions[i - 1])) continue;
-        balance = wallet->balanceHist[i - 1];
-        break;
+    for (; t && i < count; i++) {
+        if (wallet->transactions[i] == t) break;
+        if (! wallet->batchNeedsSort && wallet->transactions[i]->blockHeight != t->blockHeight) { i = count; break; }
     }
+    
+    if (t && i < array_count(wallet->balanceHist)) balance = wallet->balanceHist[i]; // not yet applied in a batch
 
     pthread_mutex_unlock(&wallet->lock);
     return balance;
@@ -1188,8 +2861,8 @@ uint64_t BRWalletMaxOutputAmount(BRWallet *wallet)
 
     for (i = array_count(wallet->utxos); i > 0; i--) {
         o = &wallet->utxos[i - 1];
-        tx = BRSetGet(wallet->allTx, &o->hash);
-        if (! tx || o->n >= tx->outCount) continue;
+        tx = _BRTxSetGet(wallet->allTx, &o->hash);
+        if (! tx || o->n >= tx->outCount || _BRUTXOSetContains(wallet->reservedOutputs, o)) continue;
         inCount++;
         amount += tx->outputs[o->n].amount;
         
@@ -1206,15 +2879,179 @@ uint64_t BRWalletMaxOutputAmount(BRWallet *wallet)
     return (amount > fee) ? amount - fee : 0;
 }
 
+// returns a new index, shared by any number of wallets, that maps addresses and outputs to the wallets they belong to,
+// so a tx can be routed to its wallets with one lookup per output and input, instead of one check per wallet
+BRWalletIndex *BRWalletIndexNew(void)
+{
+    BRWalletIndex *index = calloc(1, sizeof(*index));
+    
+    assert(index != NULL);
+    index->entries = BRSetNew(_BRWalletIndexEntryHash, _BRWalletIndexEntryEq, 1000);
+    pthread_mutex_init(&index->lock, NULL);
+    return index;
+}
+
+// adds the addresses and outputs of wallet to index, which is kept up to date as the wallet generates new addresses
+// and registers new transactions, until the wallet is removed with BRWalletIndexRemoveWallet() or freed
+// a wallet can be added to only one index
+void BRWalletIndexAddWallet(BRWalletIndex *index, BRWallet *wallet)
+{
+    assert(index != NULL);
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    assert(wallet->index == NULL || wallet->index == index);
+    wallet->index = index;
+    
+    for (size_t i = 0; i < array_count(wallet->internalChain); i++) {
+        _BRWalletIndexAdd(index, &wallet->internalChain[i], sizeof(UInt160), wallet);
+    }
+    
+    for (size_t i = 0; i < array_count(wallet->externalChain); i++) {
+        _BRWalletIndexAdd(index, &wallet->externalChain[i], sizeof(UInt160), wallet);
+    }
+    
+    for (size_t i = 0; i < array_count(wallet->transactions); i++) _BRWalletIndexAddTx(wallet, wallet->transactions[i]);
+    pthread_mutex_unlock(&wallet->lock);
+}
+
+// removes wallet from index, and stops updating index for the wallet
+void BRWalletIndexRemoveWallet(BRWalletIndex *index, BRWallet *wallet)
+{
+    _BRWalletIndexEntry *entry = NULL, **empty;
+    size_t i;
+    
+    assert(index != NULL);
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    if (wallet->index == index) wallet->index = NULL;
+    pthread_mutex_unlock(&wallet->lock);
+    pthread_mutex_lock(&index->lock);
+    array_new(empty, 100);
+    
+    while ((entry = BRSetIterate(index->entries, entry)) != NULL) {
+        for (i = array_count(entry->wallets); i > 0 && entry->wallets[i - 1] != wallet; i--);
+        if (i > 0) array_rm(entry->wallets, i - 1);
+        if (array_count(entry->wallets) == 0) array_add(empty, entry);
+    }
+    
+    for (i = 0; i < array_count(empty); i++) { // remove entries after iterating, since removal rearranges the set
+        BRSetRemove(index->entries, empty[i]);
+        array_free(empty[i]->wallets);
+        free(empty[i]);
+    }
+    
+    array_free(empty);
+    pthread_mutex_unlock(&index->lock);
+}
+
+// writes the wallets in index that tx pays to, or that own an output tx spends, to the given wallets array
+// returns the number of wallets written, or total number found if wallets is NULL
+size_t BRWalletIndexWalletsForTx(BRWalletIndex *index, BRWallet *wallets[], size_t walletsCount,
+                                 const BRTransaction *tx)
+{
+    _BRWalletIndexEntry e = { { 0 }, 0, NULL }, *entry;
+    BRWallet **found;
+    const uint8_t *pkh;
+    size_t i, j, k;
+    
+    assert(index != NULL);
+    assert(tx != NULL);
+    array_new(found, 10);
+    pthread_mutex_lock(&index->lock);
+    
+    for (i = 0; i < tx->outCount + tx->inCount; i++) {
+        memset(e.key, 0, sizeof(e.key));
+        
+        if (i < tx->outCount) {
+            pkh = BRScriptPKH(tx->outputs[i].script, tx->outputs[i].scriptLen);
+            if (! pkh) continue;
+            memcpy(e.key, pkh, sizeof(UInt160));
+            e.keyLen = sizeof(UInt160);
+        }
+        else {
+            UInt256Set(e.key, tx->inputs[i - tx->outCount].txHash);
+            UInt32SetLE(&e.key[sizeof(UInt256)], tx->inputs[i - tx->outCount].index);
+            e.keyLen = sizeof(UInt256) + sizeof(uint32_t);
+        }
+        
+        entry = BRSetGet(index->entries, &e);
+        
+        for (j = 0; entry && j < array_count(entry->wallets); j++) {
+            for (k = array_count(found); k > 0 && found[k - 1] != entry->wallets[j]; k--);
+            if (k == 0) array_add(found, entry->wallets[j]);
+        }
+    }
+    
+    pthread_mutex_unlock(&index->lock);
+    if (! wallets || array_count(found) < walletsCount) walletsCount = array_count(found);
+    for (i = 0; wallets && i < walletsCount; i++) wallets[i] = found[i];
+    array_free(found);
+    return walletsCount;
+}
+
+static void _setApplyFreeIndexEntry(void *info, void *entry)
+{
+    array_free(((_BRWalletIndexEntry *)entry)->wallets);
+    free(entry);
+}
+
+// frees memory allocated for index, wallets still using it must first be removed with BRWalletIndexRemoveWallet()
+void BRWalletIndexFree(BRWalletIndex *index)
+{
+    assert(index != NULL);
+    pthread_mutex_lock(&index->lock);
+    BRSetApply(index->entries, NULL, _setApplyFreeIndexEntry);
+    BRSetFree(index->entries);
+    pthread_mutex_unlock(&index->lock);
+    pthread_mutex_destroy(&index->lock);
+    free(index);
+}
+
+static void _setApplyFree(void *info, void *item)
+{
+    free(item);
+}
+
 static void _setApplyFreeTx(void *info, void *tx)
 {
     BRTransactionFree(tx);
 }
 
+static void _setApplyTxMemoryUsage(void *info, void *tx)
+{
+    *(size_t *)info += BRTransactionMemoryUsage(tx);
+}
+
+// returns the bytes of memory held by wallet, by what they hold, not including the shared BRWalletIndex
+BRWalletMemory BRWalletMemoryUsage(BRWallet *wallet)
+{
+    BRWalletMemory m = { 0, 0, 0, 0, 0, 0 };
+    
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    BRSetApply(wallet->allTx, &m.transactions, _setApplyTxMemoryUsage);
+    m.transactions += array_heap_size(wallet->transactions) + array_heap_size(wallet->coldTx) +
+                      BRSetMemoryUsage(wallet->coldTxIndex);
+    m.utxos = array_heap_size(wallet->utxos) + BRSetMemoryUsage(wallet->spentOutputs) +
+              array_heap_size(wallet->coldSpent);
+    m.addresses = array_heap_size(wallet->internalChain) + array_heap_size(wallet->externalChain) +
+                  BRSetMemoryUsage(wallet->usedPKH) + BRSetMemoryUsage(wallet->allPKH) +
+                  array_heap_size(wallet->coldPKH);
+    m.sets = BRSetMemoryUsage(wallet->allTx) + BRSetMemoryUsage(wallet->invalidTx) +
+             BRSetMemoryUsage(wallet->pendingTx);
+    m.other = sizeof(*wallet) + array_heap_size(wallet->balanceHist) + array_heap_size(wallet->batchAdded) +
+              array_heap_size(wallet->batchUpdated) + array_heap_size(wallet->batchRemoved) +
+              ((wallet->prefilter) ? PREFILTER_BITS/8 : 0);
+    pthread_mutex_unlock(&wallet->lock);
+    m.total = m.transactions + m.utxos + m.addresses + m.sets + m.other;
+    return m;
+}
+
 // frees memory allocated for wallet, and calls BRTransactionFree() for all registered transactions
 void BRWalletFree(BRWallet *wallet)
 {
     assert(wallet != NULL);
+    if (wallet->index) BRWalletIndexRemoveWallet(wallet->index, wallet);
     pthread_mutex_lock(&wallet->lock);
     BRSetFree(wallet->allPKH);
     BRSetFree(wallet->usedPKH);
@@ -1222,12 +3059,23 @@ void BRWalletFree(BRWallet *wallet)
     BRSetFree(wallet->pendingTx);
     BRSetApply(wallet->allTx, NULL, _setApplyFreeTx);
     BRSetFree(wallet->allTx);
+    BRConcurrentSetApply(wallet->txIndex, NULL, _setApplyFree);
+    BRConcurrentSetFree(wallet->txIndex);
     BRSetFree(wallet->spentOutputs);
+    BRSetFree(wallet->reservedOutputs);
     array_free(wallet->internalChain);
     array_free(wallet->externalChain);
     array_free(wallet->balanceHist);
     array_free(wallet->transactions);
     array_free(wallet->utxos);
+    array_free(wallet->batchAdded);
+    array_free(wallet->batchUpdated);
+    array_free(wallet->batchRemoved);
+    array_free(wallet->coldTx);
+    array_free(wallet->coldSpent);
+    array_free(wallet->coldPKH);
+    BRSetFree(wallet->coldTxIndex);
+    if (wallet->prefilter) free(wallet->prefilter);
     pthread_mutex_unlock(&wallet->lock);
     pthread_mutex_destroy(&wallet->lock);
     free(wallet);
@@ -58,10 +58,34 @@ inline static int BRUTXOEq(const void *utxo, const void *otherUtxo)
 
 typedef struct BRWalletStruct BRWallet;
 
+typedef struct BRWalletIndexStruct BRWalletIndex;
+
 // allocates and populates a BRWallet struct that must be freed by calling BRWalletFree()
 // forkId is 0 for bitcoin, 0x40 for b-cash
 BRWallet *BRWalletNew(BRTransaction *transactions[], size_t txCount, BRMasterPubKey mpk, int forkId);
 
+// like BRWalletNew(), but if summary was written by BRWalletSerializeSummary() for the same transactions at the same
+// block heights, none unconfirmed, the wallet's tx order and balance are restored from it instead of recalculated from
+// every transaction, and the addresses derived for mpk are restored regardless
+// a summary for another mpk, or that is corrupt, is ignored
+BRWallet *BRWalletNewWithSummary(BRTransaction *transactions[], size_t txCount, BRMasterPubKey mpk, int forkId,
+                                 const uint8_t *summary, size_t summaryLen);
+
+// like BRWalletNewWithSummary(), but for hosts watching many wallets, such as thousands of xpubs imported with
+// BRBIP32ParseMasterPubKey(): addresses are only derived once they're needed, the relayed tx prefilter is left out,
+// and a peer manager syncing the wallet keeps only a small window of unused addresses past the last used ones
+// summary may be NULL
+BRWallet *BRWalletNewWatchOnly(BRTransaction *transactions[], size_t txCount, BRMasterPubKey mpk, int forkId,
+                               const uint8_t *summary, size_t summaryLen);
+
+// true if wallet was created with BRWalletNewWatchOnly()
+int BRWalletIsWatchOnly(BRWallet *wallet);
+
+// writes a summary of the wallet's tx order, balance history, UTXOs and derived chains to buf, followed by a checksum,
+// for use with BRWalletNewWithSummary()
+// returns number of bytes written to buf, or total bufLen needed if buf is NULL, or 0 if a batch is in progress
+size_t BRWalletSerializeSummary(BRWallet *wallet, uint8_t *buf, size_t bufLen);
+
 // not thread-safe, set callbacks once after BRWalletNew(), before calling other BRWallet functions
 // info is a void pointer that will be passed along with each callback call
 // void balanceChanged(void *, uint64_t) - called when the wallet balance changes
@@ -84,6 +108,12 @@ void BRWalletSetCallbacks(BRWallet *wallet, void *info,
 // returns the number addresses written to addrs
 size_t BRWalletUnusedAddrs(BRWallet *wallet, BRAddress addrs[], uint32_t gapLimit, uint32_t internal);
 
+// writes to pkhs the pubkey-hashes of the <gapLimit> unused addresses following the last used address in the chain,
+// the same as BRWalletUnusedAddrs() but without encoding them as address strings
+// pkhs may be NULL to only generate addresses for BRWalletContainsPKH()
+// returns the number of hashes written to pkhs
+size_t BRWalletUnusedPKHs(BRWallet *wallet, UInt160 pkhs[], uint32_t gapLimit, uint32_t internal);
+
 // returns the first unused external address (bech32 pay-to-witness-pubkey-hash)
 BRAddress BRWalletReceiveAddress(BRWallet *wallet);
 
@@ -94,21 +124,114 @@ BRAddress BRWalletLegacyAddress(BRWallet *wallet);
 // returns the number addresses written, or total number available if addrs is NULL
 size_t BRWalletAllAddrs(BRWallet *wallet, BRAddress addrs[], size_t addrsCount);
 
+// writes the pubkey-hashes of all addresses previously genereated with BRWalletUnusedAddrs() to pkhs
+// returns the number of hashes written, or total number available if pkhs is NULL
+size_t BRWalletAllPKHs(BRWallet *wallet, UInt160 pkhs[], size_t pkhsCount);
+
 // true if the address was previously generated by BRWalletUnusedAddrs() (even if it's now used)
 int BRWalletContainsAddress(BRWallet *wallet, const char *addr);
 
+// true if the address for pkh was previously generated by BRWalletUnusedAddrs() (even if it's now used)
+int BRWalletContainsPKH(BRWallet *wallet, UInt160 pkh);
+
 // true if the address was previously used as an input or output in any wallet transaction
 int BRWalletAddressIsUsed(BRWallet *wallet, const char *addr);
 
+// true if the address for pkh was previously used as an input or output in any wallet transaction
+int BRWalletPKHIsUsed(BRWallet *wallet, UInt160 pkh);
+
+// writes the scriptPubKey of the wallet address for pkh to script, legacy pay-to-pubkey-hash if the wallet has a
+// forkId, otherwise pay-to-witness-pubkey-hash
+// returns the number of bytes written, or scriptLen needed if script is NULL
+size_t BRWalletPKHScriptPubKey(BRWallet *wallet, uint8_t *script, size_t scriptLen, UInt160 pkh);
+
 // writes transactions registered in the wallet, sorted by date, oldest first, to the given transactions array
 // returns the number of transactions written, or total number available if transactions is NULL
 size_t BRWalletTransactions(BRWallet *wallet, BRTransaction *transactions[], size_t txCount);
 
+// writes copies of the transactions registered in the wallet, sorted by date, oldest first, to the given transactions
+// array, copied while holding the wallet lock so they outlive any later removal from the wallet; free each copy with
+// BRTransactionFree()
+// returns the number of transactions written, or total number available if transactions is NULL
+size_t BRWalletTransactionsCopy(BRWallet *wallet, BRTransaction *transactions[], size_t txCount);
+
 // writes transactions registered in the wallet, and that were unconfirmed before blockHeight, to the transactions array
 // returns the number of transactions written, or total number available if transactions is NULL
 size_t BRWalletTxUnconfirmedBefore(BRWallet *wallet, BRTransaction *transactions[], size_t txCount,
                                    uint32_t blockHeight);
 
+// writes copies of the transactions registered in the wallet, and that were unconfirmed before blockHeight, to the
+// transactions array, copied while holding the wallet lock; free each copy with BRTransactionFree()
+// returns the number of transactions written, or total number available if transactions is NULL
+size_t BRWalletTxUnconfirmedBeforeCopy(BRWallet *wallet, BRTransaction *transactions[], size_t txCount,
+                                       uint32_t blockHeight);
+
+// writes up to txCount transactions registered in the wallet, sorted by date, oldest first, starting at position offset
+// in the transaction history, to the given transactions array
+// returns the number of transactions written, or total number available after offset if transactions is NULL
+size_t BRWalletTransactionsPage(BRWallet *wallet, BRTransaction *transactions[], size_t offset, size_t txCount);
+
+// writes up to txCount transactions registered in the wallet, newest first, skipping the newest offset transactions, to
+// the given transactions array
+// returns the number of transactions written, or total number available after offset if transactions is NULL
+size_t BRWalletTransactionsNewest(BRWallet *wallet, BRTransaction *transactions[], size_t offset, size_t txCount);
+
+// writes up to txCount transactions registered in the wallet with block heights from fromHeight up to but not including
+// toHeight, sorted by date, oldest first, to the given transactions array (unconfirmed tx have height TX_UNCONFIRMED)
+// returns the number of transactions written, or total number available if transactions is NULL
+size_t BRWalletTransactionsInHeights(BRWallet *wallet, BRTransaction *transactions[], size_t txCount,
+                                     uint32_t fromHeight, uint32_t toHeight);
+
+// the compact record a transaction is condensed into by BRWalletCondenseTransactions()
+typedef struct {
+    UInt256 txHash;
+    uint32_t blockHeight;
+    uint32_t timestamp;
+    uint64_t sent; // amount sent from the wallet, see BRWalletAmountSentByTx()
+    uint64_t received; // amount received by the wallet, see BRWalletAmountReceivedFromTx()
+    uint64_t fee; // see BRWalletFeeForTx(), UINT64_MAX if unknown
+    uint64_t balance; // wallet balance after the transaction, see BRWalletBalanceAfterTx()
+} BRWalletTxRecord;
+
+// removes from the wallet the oldest transactions that are at least confirmations deep and whose wallet outputs are all
+// spent by transactions removed along with them, keeping a BRWalletTxRecord of each in their place, so the memory the
+// wallet holds follows its UTXO set rather than its history, the balance, UTXOs and used addresses are unchanged
+// writes up to txCount of the removed transactions to the condensed array, oldest first, and the caller takes ownership
+// of them, they're no longer registered in the wallet and neither wallet functions nor callbacks refer to them again,
+// so their bodies must already be stored wherever they're reloaded from on demand
+// returns the number of transactions removed, or the number that would be if condensed is NULL, or 0 during a batch
+size_t BRWalletCondenseTransactions(BRWallet *wallet, uint32_t confirmations, BRTransaction *condensed[],
+                                    size_t txCount);
+
+// writes up to recordsCount records of transactions condensed by BRWalletCondenseTransactions(), oldest first, starting
+// at position offset, to the given records array
+// returns the number of records written, or total number available after offset if records is NULL
+size_t BRWalletCondensedTransactions(BRWallet *wallet, BRWalletTxRecord records[], size_t offset,
+                                     size_t recordsCount);
+
+// writes what BRWalletCondenseTransactions() keeps of the transactions it removed - their records, the wallet outputs
+// they spent, the wallet addresses they paid to and their totals - to buf, followed by a checksum, for use with
+// BRWalletRestoreCondensed()
+// returns number of bytes written to buf, or total bufLen needed if buf is NULL, or 0 if no tx were condensed
+size_t BRWalletSerializeCondensed(BRWallet *wallet, uint8_t *buf, size_t bufLen);
+
+// writes up to hashesCount hashes of the condensed tx in condensed, as written by BRWalletSerializeCondensed() for mpk,
+// oldest first, to the hashes array, so their stored bodies can be left out of the tx a wallet is created with
+// returns the number of hashes written, or total number available if hashes is NULL, or 0 if condensed is corrupt
+size_t BRWalletCondensedTxHashes(const uint8_t *condensed, size_t condensedLen, BRMasterPubKey mpk, UInt256 hashes[],
+                                 size_t hashesCount);
+
+// restores condensed, as written by BRWalletSerializeCondensed(), to a wallet created with the tx that remained
+// registered, so it's as it was when condensed: its condensed tx still count towards its totals, their addresses are
+// still used and tx double spending their inputs are still invalid
+// returns true on success, or false, leaving the wallet unchanged, if condensed is corrupt, was written for another
+// mpk, or the wallet already has condensed tx or has one of them registered
+int BRWalletRestoreCondensed(BRWallet *wallet, const uint8_t *condensed, size_t condensedLen);
+
+// returns a number that increases whenever a transaction is added to or removed from the wallet, or its block height
+// changes, so a UI can tell whether its copy of the transaction history is still current without fetching it again
+uint64_t BRWalletChangeSequence(BRWallet *wallet);
+
 // current wallet balance, not including transactions known to be invalid
 uint64_t BRWalletBalance(BRWallet *wallet);
 
@@ -138,9 +261,22 @@ BRTransaction *BRWalletCreateTxForOutputs(BRWallet *wallet, const BRTxOutput out
 // returns true if all inputs were signed, or false if there was an error or not all inputs were able to be signed
 int BRWalletSignTransaction(BRWallet *wallet, BRTransaction *tx, const void *seed, size_t seedLen);
 
-// true if the given transaction is associated with the wallet (even if it hasn't been registered)
+// reserves the wallet outputs spent by tx, an unpublished transaction from BRWalletCreateTxForOutputs(), so they aren't
+// selected again for another transaction while tx is signed and published, returns false without reserving any of
+// them if one was already reserved, tx must not be freed or modified until BRWalletReleaseTxInputs() is called for it
+int BRWalletReserveTxInputs(BRWallet *wallet, const BRTransaction *tx);
+
+// releases the outputs reserved for tx by BRWalletReserveTxInputs(), once it's either published (and registered, so
+// its inputs are spent) or abandoned
+void BRWalletReleaseTxInputs(BRWallet *wallet, const BRTransaction *tx);
+
+// true if the given transaction is associated with the wallet (even if it hasn't been registered), false if it was
+// condensed by BRWalletCondenseTransactions()
 int BRWalletContainsTransaction(BRWallet *wallet, const BRTransaction *tx);
 
+// same as BRWalletContainsTransaction(), for a tx that's only been indexed with BRTransactionViewParse()
+int BRWalletContainsTransactionView(BRWallet *wallet, const BRTransactionView *view);
+
 // adds a transaction to the wallet, or returns false if it isn't associated with the wallet
 int BRWalletRegisterTransaction(BRWallet *wallet, BRTransaction *tx);
 
@@ -148,6 +284,8 @@ int BRWalletRegisterTransaction(BRWallet *wallet, BRTransaction *tx);
 void BRWalletRemoveTransaction(BRWallet *wallet, UInt256 txHash);
 
 // returns the transaction with the given hash if it's been registered in the wallet
+// doesn't wait on other threads using the wallet, but as before, the caller must ensure the tx isn't freed by another
+// thread, such as when it's removed or condensed, while it's still using it
 BRTransaction *BRWalletTransactionForHash(BRWallet *wallet, UInt256 txHash);
 
 // true if no previous wallet transaction spends any of the given transaction's inputs, and no inputs are invalid
@@ -167,6 +305,25 @@ void BRWalletUpdateTransactions(BRWallet *wallet, const UInt256 txHashes[], size
 // marks all transactions confirmed after blockHeight as unconfirmed (useful for chain re-orgs)
 void BRWalletSetTxUnconfirmedAfter(BRWallet *wallet, uint32_t blockHeight);
 
+// applies a chain re-org as one update, same as BRWalletSetTxUnconfirmedAfter(wallet, joinHeight) followed by
+// BRWalletUpdateTransactions() for each of txHashes with the block height and timestamp of the same index, except the
+// balance is only updated once, and txUpdated() is only called for transactions that end up with a different block
+// height or timestamp than before, once for those no longer confirmed and once for each run of the same height
+void BRWalletReorgTransactions(BRWallet *wallet, uint32_t joinHeight, const UInt256 txHashes[],
+                               const uint32_t blockHeights[], const uint32_t timestamps[], size_t txCount);
+
+// starts a batch of transaction registrations, updates and removals, which are applied together by the matching call
+// to BRWalletCommitBatch(), with re-sorting, balance recalculation and callbacks done once for the whole batch
+// batches may be nested, and are applied when the outermost one is committed
+// while a batch is open, transactions are registered and their block heights set immediately, but the balance, UTXOs
+// and transaction order aren't updated until the batch is committed
+void BRWalletBeginBatch(BRWallet *wallet);
+
+// commits a batch started by BRWalletBeginBatch(), calling balanceChanged() once if the batch added or removed
+// transactions or changed the balance, then txAdded(), txUpdated() and txDeleted() for the batched transactions
+// txUpdated() is called once for each run of transactions that ended the batch with the same block height and timestamp
+void BRWalletCommitBatch(BRWallet *wallet);
+
 // returns the amount received by the wallet from the transaction (total outputs to change and/or receive addresses)
 uint64_t BRWalletAmountReceivedFromTx(BRWallet *wallet, const BRTransaction *tx);
 
@@ -191,6 +348,38 @@ uint64_t BRWalletMinOutputAmount(BRWallet *wallet);
 // maximum amount that can be sent from the wallet to a single address after fees
 uint64_t BRWalletMaxOutputAmount(BRWallet *wallet);
 
+// returns a new index, shared by any number of wallets, that maps addresses and outputs to the wallets they belong to,
+// so a tx can be routed to its wallets with one lookup per output and input, instead of one check per wallet
+BRWalletIndex *BRWalletIndexNew(void);
+
+// adds the addresses and outputs of wallet to index, which is kept up to date as the wallet generates new addresses
+// and registers new transactions, until the wallet is removed with BRWalletIndexRemoveWallet() or freed
+// a wallet can be added to only one index
+void BRWalletIndexAddWallet(BRWalletIndex *index, BRWallet *wallet);
+
+// removes wallet from index, and stops updating index for the wallet
+void BRWalletIndexRemoveWallet(BRWalletIndex *index, BRWallet *wallet);
+
+// writes the wallets in index that tx pays to, or that own an output tx spends, to the given wallets array
+// returns the number of wallets written, or total number found if wallets is NULL
+size_t BRWalletIndexWalletsForTx(BRWalletIndex *index, BRWallet *wallets[], size_t walletsCount,
+                                 const BRTransaction *tx);
+
+// frees memory allocated for index, wallets still using it must first be removed with BRWalletIndexRemoveWallet()
+void BRWalletIndexFree(BRWalletIndex *index);
+
+typedef struct {
+    size_t transactions; // registered transactions, with their inputs, outputs and scripts, the tx list and records
+    size_t utxos; // unspent outputs and the spent outputs set
+    size_t addresses; // derived internal and external chains, and the pkh sets
+    size_t sets; // the other hashtables, of all, invalid and pending tx
+    size_t other; // the wallet struct, balance history and batch lists
+    size_t total; // sum of the above
+} BRWalletMemory;
+
+// returns the bytes of memory held by wallet, by what they hold, not including the shared BRWalletIndex
+BRWalletMemory BRWalletMemoryUsage(BRWallet *wallet);
+
 // frees memory allocated for wallet, and calls BRTransactionFree() for all registered transactions
 void BRWalletFree(BRWallet *wallet);
 
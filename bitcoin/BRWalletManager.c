@@ -7,14 +7,17 @@
 //
 
 #include <errno.h>
+#include <stddef.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <pthread.h>
 #include "BRArray.h"
 #include "BRSet.h"
 #include "BRWalletManager.h"
 #include "BRPeerManager.h"
 #include "BRMerkleBlock.h"
 #include "BRBase58.h"
+#include "BRCrypto.h"
 #include "BRChainParams.h"
 #include "bcash/BRBCashParams.h"
 
@@ -76,20 +79,282 @@ getForkId (const BRChainParams *params) {
 
 /// MARK: - BRWalletManager
 
+#define BWM_SEND_WORKERS        (2)
+
 struct BRWalletManagerStruct {
     //BRWalletForkId walletForkId;
     BRFileService fileService;
     BRWallet *wallet;
     BRPeerManager  *peerManager;
     BRWalletManagerClient client;
+    const BRChainParams *params;
+
+    /// Stores the FileService failed on, waiting to be repaired off the failing thread
+    pthread_mutex_t repairLock;
+    pthread_cond_t repairDone;
+    int repairStores;
+    int repairRunning;
+    int repairClosed;
+    unsigned int repairCount;
+
+    /// Sends waiting for a worker to sign them, and those signed and waiting to be published
+    pthread_mutex_t sendLock;
+    pthread_cond_t sendReady;
+    BRArrayOf(struct BRWalletManagerSendJobStruct *) sendQueue;
+    BRArrayOf(struct BRWalletManagerSendJobStruct *) sendPublishing;
+    pthread_t sendWorkers[BWM_SEND_WORKERS];
+    size_t sendWorkersCount;
+    int sendClosed;
+};
+
+/// MARK: - Packed Records
+
+///
+/// The V2 (peers V3) formats pack what the earlier formats stored as the network serialization,
+/// or as a raw struct.  Metadata (a block's height, a transaction's blockHeight and timestamp)
+/// sits in fixed uint32 columns at the front so it can be read without decoding the rest, while
+/// counts, amounts and small integers are LEB128 varints.  Output scripts that match one of
+/// the standard templates are stored as a one byte tag and the hash they commit to.
+///
+enum {
+    PACKED_SCRIPT_RAW,          // varint length, then the script
+    PACKED_SCRIPT_P2PKH,        // OP_DUP OP_HASH160 <20> OP_EQUALVERIFY OP_CHECKSIG
+    PACKED_SCRIPT_P2SH,         // OP_HASH160 <20> OP_EQUAL
+    PACKED_SCRIPT_P2WPKH,       // OP_0 <20>
+    PACKED_SCRIPT_P2WSH         // OP_0 <32>
 };
 
+static const struct {
+    size_t prefixLen;
+    uint8_t prefix[3];
+    size_t hashLen;
+    size_t suffixLen;
+    uint8_t suffix[2];
+} packedScriptTemplates[] = {
+    { 0, { 0 },                0,  0, { 0 } },
+    { 3, { 0x76, 0xa9, 0x14 }, 20, 2, { 0x88, 0xac } },
+    { 2, { 0xa9, 0x14 },       20, 1, { 0x87 } },
+    { 2, { 0x00, 0x14 },       20, 0, { 0 } },
+    { 2, { 0x00, 0x20 },       32, 0, { 0 } }
+};
+
+#define PACKED_SCRIPT_TEMPLATES_COUNT   (sizeof (packedScriptTemplates) / sizeof (packedScriptTemplates[0]))
+
+/// Write `bytesCount` bytes at `offset` if `bytes` is not NULL; returns the offset after them.
+static size_t
+packedBytesSet (uint8_t *bytes, size_t offset, const void *value, size_t bytesCount) {
+    if (NULL != bytes && bytesCount > 0) memcpy (&bytes[offset], value, bytesCount);
+    return offset + bytesCount;
+}
+
+/// Write `value` as a LEB128 varint at `offset` if `bytes` is not NULL; returns the offset after it.
+static size_t
+packedVarIntSet (uint8_t *bytes, size_t offset, uint64_t value) {
+    do {
+        if (NULL != bytes) bytes[offset] = (uint8_t) ((value & 0x7f) | (value > 0x7f ? 0x80 : 0x00));
+        offset++;
+        value >>= 7;
+    } while (value > 0);
+
+    return offset;
+}
+
+/// Read a LEB128 varint at `*offset`, advancing it; on a truncated or overlong varint, sets
+/// `*offset` past `bytesCount` so that every later read fails too.
+static uint64_t
+packedVarIntGet (const uint8_t *bytes, size_t bytesCount, size_t *offset) {
+    uint64_t value = 0;
+
+    for (unsigned int shift = 0; *offset < bytesCount && shift < 64; shift += 7) {
+        uint8_t byte = bytes[(*offset)++];
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (0 == (byte & 0x80)) return value;
+    }
+
+    *offset = bytesCount + 1;
+    return 0;
+}
+
+/// Return a pointer to the `bytesCount` bytes at `*offset`, advancing it, or NULL if truncated.
+static const uint8_t *
+packedBytesGet (const uint8_t *bytes, size_t bytesCount, size_t *offset, size_t count) {
+    if (*offset > bytesCount || count > bytesCount - *offset) {
+        *offset = bytesCount + 1;
+        return NULL;
+    }
+
+    *offset += count;
+    return &bytes[*offset - count];
+}
+
+/// Pack an output script, as a template tag and its hash or as a raw script.
+static size_t
+packedScriptSet (uint8_t *bytes, size_t offset, const uint8_t *script, size_t scriptLen) {
+    for (size_t tag = PACKED_SCRIPT_RAW + 1; tag < PACKED_SCRIPT_TEMPLATES_COUNT; tag++) {
+        size_t prefixLen = packedScriptTemplates[tag].prefixLen;
+        size_t hashLen   = packedScriptTemplates[tag].hashLen;
+        size_t suffixLen = packedScriptTemplates[tag].suffixLen;
+
+        if (scriptLen == prefixLen + hashLen + suffixLen &&
+            0 == memcmp (script, packedScriptTemplates[tag].prefix, prefixLen) &&
+            0 == memcmp (&script[prefixLen + hashLen], packedScriptTemplates[tag].suffix, suffixLen)) {
+            offset = packedVarIntSet (bytes, offset, tag);
+            return packedBytesSet (bytes, offset, &script[prefixLen], hashLen);
+        }
+    }
+
+    offset = packedVarIntSet (bytes, offset, PACKED_SCRIPT_RAW);
+    offset = packedVarIntSet (bytes, offset, scriptLen);
+    return packedBytesSet (bytes, offset, script, scriptLen);
+}
+
+/// Unpack an output script into its network serialization (a varint length and the script),
+/// written at `netOffset` in `net` if not NULL; returns the offset after it, or SIZE_MAX on error.
+static size_t
+packedScriptGet (const uint8_t *bytes, size_t bytesCount, size_t *offset, uint8_t *net, size_t netOffset) {
+    uint64_t tag = packedVarIntGet (bytes, bytesCount, offset);
+    size_t scriptLen, hashLen;
+    const uint8_t *data;
+
+    if (tag >= PACKED_SCRIPT_TEMPLATES_COUNT) return SIZE_MAX;
+
+    if (PACKED_SCRIPT_RAW == tag) {
+        scriptLen = (size_t) packedVarIntGet (bytes, bytesCount, offset);
+        data = packedBytesGet (bytes, bytesCount, offset, scriptLen);
+        if (NULL == data) return SIZE_MAX;
+
+        netOffset += BRVarIntSet ((NULL == net ? NULL : &net[netOffset]), 9, scriptLen);
+        return packedBytesSet (net, netOffset, data, scriptLen);
+    }
+
+    hashLen   = packedScriptTemplates[tag].hashLen;
+    scriptLen = packedScriptTemplates[tag].prefixLen + hashLen + packedScriptTemplates[tag].suffixLen;
+    data = packedBytesGet (bytes, bytesCount, offset, hashLen);
+    if (NULL == data) return SIZE_MAX;
+
+    netOffset += BRVarIntSet ((NULL == net ? NULL : &net[netOffset]), 9, scriptLen);
+    netOffset  = packedBytesSet (net, netOffset,
+                                 packedScriptTemplates[tag].prefix, packedScriptTemplates[tag].prefixLen);
+    netOffset  = packedBytesSet (net, netOffset, data, hashLen);
+    return packedBytesSet (net, netOffset,
+                           packedScriptTemplates[tag].suffix, packedScriptTemplates[tag].suffixLen);
+}
+
+/// Pack the network serialization of a transaction, indexed by `view`.  The witness length comes
+/// right after the version so that unpacking knows up front whether to write the witness marker.
+static size_t
+packedTransactionSet (uint8_t *bytes, size_t offset, const BRTransactionView *view) {
+    const uint8_t *net = view->buf, *script;
+    size_t netOffset, scriptLen, witnessOffset;
+    uint32_t index;
+    uint64_t amount;
+
+    // The witnesses follow the outputs, and precede the lockTime
+    netOffset = view->outOff;
+    for (size_t i = 0; i < view->outCount; i++)
+        netOffset = BRTransactionViewOutput (view, netOffset, NULL, NULL, NULL);
+    witnessOffset = netOffset;
+
+    offset = packedVarIntSet (bytes, offset, view->version);
+    offset = packedVarIntSet (bytes, offset, view->bufLen - sizeof (uint32_t) - witnessOffset);
+
+    offset = packedVarIntSet (bytes, offset, view->inCount);
+    netOffset = view->inOff;
+    for (size_t i = 0; i < view->inCount; i++) {
+        offset = packedBytesSet (bytes, offset, &net[netOffset], sizeof (UInt256));
+        netOffset = BRTransactionViewInput (view, netOffset, NULL, &index, &script, &scriptLen);
+
+        // Sequences are almost always TXIN_SEQUENCE or one less; complemented they pack into a byte
+        offset = packedVarIntSet (bytes, offset, index);
+        offset = packedVarIntSet (bytes, offset, ~UInt32GetLE (&net[netOffset - sizeof (uint32_t)]));
+        offset = packedVarIntSet (bytes, offset, scriptLen);
+        offset = packedBytesSet  (bytes, offset, script, scriptLen);
+    }
+
+    offset = packedVarIntSet (bytes, offset, view->outCount);
+    netOffset = view->outOff;
+    for (size_t i = 0; i < view->outCount; i++) {
+        netOffset = BRTransactionViewOutput (view, netOffset, &amount, &script, &scriptLen);
+        offset = packedVarIntSet (bytes, offset, amount);
+        offset = packedScriptSet (bytes, offset, script, scriptLen);
+    }
+
+    offset = packedBytesSet  (bytes, offset, &net[witnessOffset], view->bufLen - sizeof (uint32_t) - witnessOffset);
+    return packedVarIntSet (bytes, offset, view->lockTime);
+}
+
+/// Unpack a transaction into its network serialization, written to `net` if not NULL.  Returns
+/// the serialization's length, or SIZE_MAX if `bytes` isn't a packed transaction.
+static size_t
+packedTransactionGet (const uint8_t *bytes, size_t bytesCount, uint8_t *net) {
+    size_t offset = 0, netOffset = 0, count, scriptLen;
+    const uint8_t *data;
+
+    uint32_t version = (uint32_t) packedVarIntGet (bytes, bytesCount, &offset);
+    size_t witnessLen = (size_t) packedVarIntGet (bytes, bytesCount, &offset);
+
+    if (NULL != net) UInt32SetLE (&net[netOffset], version);
+    netOffset += sizeof (uint32_t);
+
+    if (witnessLen > 0) {
+        netOffset = packedBytesSet (net, netOffset, ((const uint8_t []) { 0x00, 0x01 }), 2); // marker and flag
+    }
+
+    count = (size_t) packedVarIntGet (bytes, bytesCount, &offset);
+    netOffset += BRVarIntSet ((NULL == net ? NULL : &net[netOffset]), 9, count);
+
+    for (size_t i = 0; i < count && offset <= bytesCount; i++) {
+        data = packedBytesGet (bytes, bytesCount, &offset, sizeof (UInt256));
+        if (NULL == data) return SIZE_MAX;
+        netOffset = packedBytesSet (net, netOffset, data, sizeof (UInt256));
+
+        uint32_t index    = (uint32_t) packedVarIntGet (bytes, bytesCount, &offset);
+        uint32_t sequence = ~(uint32_t) packedVarIntGet (bytes, bytesCount, &offset);
+
+        if (NULL != net) UInt32SetLE (&net[netOffset], index);
+        netOffset += sizeof (uint32_t);
+
+        scriptLen = (size_t) packedVarIntGet (bytes, bytesCount, &offset);
+        data = packedBytesGet (bytes, bytesCount, &offset, scriptLen);
+        if (NULL == data) return SIZE_MAX;
+        netOffset += BRVarIntSet ((NULL == net ? NULL : &net[netOffset]), 9, scriptLen);
+        netOffset  = packedBytesSet (net, netOffset, data, scriptLen);
+
+        if (NULL != net) UInt32SetLE (&net[netOffset], sequence);
+        netOffset += sizeof (uint32_t);
+    }
+
+    count = (size_t) packedVarIntGet (bytes, bytesCount, &offset);
+    netOffset += BRVarIntSet ((NULL == net ? NULL : &net[netOffset]), 9, count);
+
+    for (size_t i = 0; i < count && offset <= bytesCount; i++) {
+        uint64_t amount = packedVarIntGet (bytes, bytesCount, &offset);
+
+        if (NULL != net) UInt64SetLE (&net[netOffset], amount);
+        netOffset += sizeof (uint64_t);
+
+        netOffset = packedScriptGet (bytes, bytesCount, &offset, net, netOffset);
+        if (SIZE_MAX == netOffset) return SIZE_MAX;
+    }
+
+    data = packedBytesGet (bytes, bytesCount, &offset, witnessLen);
+    if (NULL == data) return SIZE_MAX;
+    netOffset = packedBytesSet (net, netOffset, data, witnessLen);
+
+    uint32_t lockTime = (uint32_t) packedVarIntGet (bytes, bytesCount, &offset);
+    if (NULL != net) UInt32SetLE (&net[netOffset], lockTime);
+    netOffset += sizeof (uint32_t);
+
+    return (offset == bytesCount ? netOffset : SIZE_MAX);
+}
+
 /// MARK: - Transaction File Service
 
 static const char *fileServiceTypeTransactions = "transactions";
 
 enum {
-    WALLET_MANAGER_TRANSACTION_VERSION_1
+    WALLET_MANAGER_TRANSACTION_VERSION_1,
+    WALLET_MANAGER_TRANSACTION_VERSION_2    // packed
 };
 
 static UInt256
@@ -139,7 +404,7 @@ fileServiceTypeTransactionV1Reader (BRFileServiceContext context,
     size_t txTimestampSize  = sizeof (uint32_t);
     size_t txBlockHeightSize = sizeof (uint32_t);
 
-    BRTransaction *transaction = BRTransactionParse (bytes, bytesCount);
+    BRTransaction *transaction = BRTransactionParseArena (bytes, bytesCount);
     if (NULL == transaction) return NULL;
 
     transaction->blockHeight = UInt32GetLE (&bytes[bytesCount - txTimestampSize - txBlockHeightSize]);
@@ -148,10 +413,114 @@ fileServiceTypeTransactionV1Reader (BRFileServiceContext context,
     return transaction;
 }
 
+enum {
+    PACKED_TRANSACTION_RAW,                 // the network serialization follows
+    PACKED_TRANSACTION_PACKED               // the packed serialization follows
+};
+
+/// The V2 format is the blockHeight and timestamp columns, an encoding byte and then the packed
+/// transaction, or its network serialization if packing wouldn't reproduce it exactly.
+#define WALLET_MANAGER_TRANSACTION_V2_HEADER_SIZE   (2 * sizeof (uint32_t) + 1)
+
+static uint8_t *
+fileServiceTypeTransactionV2Writer (BRFileServiceContext context,
+                                    BRFileService fs,
+                                    const void* entity,
+                                    uint32_t *bytesCount) {
+    const BRTransaction *transaction = entity;
+    size_t headerSize = WALLET_MANAGER_TRANSACTION_V2_HEADER_SIZE;
+
+    size_t netSize = BRTransactionSerialize (transaction, NULL, 0);
+    uint8_t *net = malloc (netSize);
+    BRTransactionSerialize (transaction, net, netSize);
+
+    BRTransactionView view;
+    size_t packedSize = 0;
+    uint8_t *packed = NULL;
+
+    // Pack, then confirm that unpacking reproduces the serialization exactly; anything packing
+    // doesn't capture, like an unsigned input's amount, falls back to the raw serialization.
+    if (BRTransactionViewParse (&view, net, netSize)) {
+        packedSize = packedTransactionSet (NULL, 0, &view);
+        packed = malloc (headerSize + packedSize);
+        packedTransactionSet (&packed[headerSize], 0, &view);
+
+        uint8_t *check = (netSize == packedTransactionGet (&packed[headerSize], packedSize, NULL)
+                          ? malloc (netSize)
+                          : NULL);
+
+        if (NULL == check ||
+            netSize != packedTransactionGet (&packed[headerSize], packedSize, check) ||
+            0 != memcmp (check, net, netSize)) {
+            free (packed);
+            packed = NULL;
+        }
+
+        if (NULL != check) free (check);
+    }
+
+    if (NULL == packed) {
+        packedSize = netSize;
+        packed = malloc (headerSize + packedSize);
+        memcpy (&packed[headerSize], net, netSize);
+        packed[2 * sizeof (uint32_t)] = PACKED_TRANSACTION_RAW;
+    }
+    else packed[2 * sizeof (uint32_t)] = PACKED_TRANSACTION_PACKED;
+
+    UInt32SetLE (&packed[0],                 transaction->blockHeight);
+    UInt32SetLE (&packed[sizeof (uint32_t)], transaction->timestamp);
+
+    free (net);
+    *bytesCount = (uint32_t) (headerSize + packedSize);
+    return packed;
+}
+
+static void *
+fileServiceTypeTransactionV2Reader (BRFileServiceContext context,
+                                    BRFileService fs,
+                                    uint8_t *bytes,
+                                    uint32_t bytesCount) {
+    size_t headerSize = WALLET_MANAGER_TRANSACTION_V2_HEADER_SIZE;
+    if (bytesCount < headerSize) return NULL;
+
+    const uint8_t *payload   = &bytes[headerSize];
+    size_t payloadSize = bytesCount - headerSize;
+    BRTransaction *transaction = NULL;
+
+    switch (bytes[2 * sizeof (uint32_t)]) {
+        case PACKED_TRANSACTION_RAW:
+            transaction = BRTransactionParseArena (payload, payloadSize);
+            break;
+
+        case PACKED_TRANSACTION_PACKED: {
+            size_t netSize = packedTransactionGet (payload, payloadSize, NULL);
+            if (SIZE_MAX == netSize) return NULL;
+
+            uint8_t *net = malloc (netSize);
+            packedTransactionGet (payload, payloadSize, net);
+            transaction = BRTransactionParseArena (net, netSize);
+            free (net);
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    if (NULL == transaction) return NULL;
+
+    transaction->blockHeight = UInt32GetLE (&bytes[0]);
+    transaction->timestamp   = UInt32GetLE (&bytes[sizeof (uint32_t)]);
+
+    return transaction;
+}
+
 static BRArrayOf(BRTransaction*)
-initialTransactionsLoad (BRWalletManager manager) {
+initialTransactionsLoad (BRWalletManager manager, const UInt256 *condensed, size_t condensedCount) {
     BRSetOf(BRTransaction*) transactionSet = BRSetNew(BRTransactionHash, BRTransactionEq, 100);
-    if (1 != fileServiceLoad (manager->fileService, transactionSet, fileServiceTypeTransactions, 1)) {
+    // The bodies of condensed transactions stay saved but aren't loaded; the wallet keeps only their records.
+    if (1 != fileServiceLoadExcept (manager->fileService, transactionSet, fileServiceTypeTransactions, 1,
+                                    condensed, condensedCount)) {
         BRSetFree(transactionSet);
         return NULL;
     }
@@ -172,7 +541,8 @@ initialTransactionsLoad (BRWalletManager manager) {
 
 static const char *fileServiceTypeBlocks = "blocks";
 enum {
-    WALLET_MANAGER_BLOCK_VERSION_1
+    WALLET_MANAGER_BLOCK_VERSION_1,
+    WALLET_MANAGER_BLOCK_VERSION_2  // packed
 };
 
 static UInt256
@@ -215,17 +585,129 @@ fileServiceTypeBlockV1Writer (BRFileServiceContext context,
     return bytes;
 }
 
+/// Blocks at or below the last checkpoint can't be reorganized away, so their matched tx hashes
+/// are never looked at again; their readers skip copying the partial merkle tree.
+static int
+fileServiceTypeBlockHeaderOnly (BRWalletManager manager, uint32_t blockHeight) {
+    const BRChainParams *params = manager->params;
+
+    return (params->checkpointsCount > 0 &&
+            blockHeight <= params->checkpoints[params->checkpointsCount - 1].height);
+}
+
 static void *
 fileServiceTypeBlockV1Reader (BRFileServiceContext context,
                               BRFileService fs,
                               uint8_t *bytes,
                               uint32_t bytesCount) {
+    BRWalletManager manager = (BRWalletManager) context;
     size_t blockHeightSize = sizeof (uint32_t);
+    if (bytesCount < blockHeightSize) return NULL;
+
+    // The height trails the serialized block.
+    uint32_t blockHeight = UInt32GetLE(&bytes[bytesCount - blockHeightSize]);
+
+    BRMerkleBlock *block = (fileServiceTypeBlockHeaderOnly (manager, blockHeight)
+                            ? BRMerkleBlockParseHeader (bytes, bytesCount - blockHeightSize)
+                            : BRMerkleBlockParseArena  (bytes, bytesCount - blockHeightSize));
+    if (NULL == block) return NULL;
+
+    block->height = blockHeight;
+
+    return block;
+}
+
+/// The V2 format is the height column, the 80 byte header and then, for a merkleblock, the
+/// packed totalTx, hashes and flags.
+#define WALLET_MANAGER_BLOCK_V2_HEADER_SIZE     (sizeof (uint32_t) + 80)
+
+static uint8_t *
+fileServiceTypeBlockV2Writer (BRFileServiceContext context,
+                              BRFileService fs,
+                              const void* entity,
+                              uint32_t *bytesCount) {
+    const BRMerkleBlock *block = entity;
+    size_t headerSize = WALLET_MANAGER_BLOCK_V2_HEADER_SIZE;
+
+    // Serialize just the header; with no totalTx, the block serializes as its header alone
+    BRMerkleBlock headerBlock = *block;
+    headerBlock.totalTx = 0;
+
+    uint8_t header[80];
+    BRMerkleBlockSerialize (&headerBlock, header, sizeof (header));
+
+    size_t size = headerSize;
+    if (block->totalTx > 0) {
+        size = packedVarIntSet (NULL, size, block->totalTx);
+        size = packedVarIntSet (NULL, size, block->hashesCount);
+        size = packedBytesSet  (NULL, size, block->hashes, block->hashesCount * sizeof (UInt256));
+        size = packedVarIntSet (NULL, size, block->flagsLen);
+        size = packedBytesSet  (NULL, size, block->flags, block->flagsLen);
+    }
+
+    uint8_t *bytes = malloc (size);
+    UInt32SetLE (bytes, block->height);
+
+    size_t offset = packedBytesSet (bytes, sizeof (uint32_t), header, 80);
+    if (block->totalTx > 0) {
+        offset = packedVarIntSet (bytes, offset, block->totalTx);
+        offset = packedVarIntSet (bytes, offset, block->hashesCount);
+        offset = packedBytesSet  (bytes, offset, block->hashes, block->hashesCount * sizeof (UInt256));
+        offset = packedVarIntSet (bytes, offset, block->flagsLen);
+        offset = packedBytesSet  (bytes, offset, block->flags, block->flagsLen);
+    }
+
+    assert (offset == size);
+    *bytesCount = (uint32_t) size;
+    return bytes;
+}
+
+static void *
+fileServiceTypeBlockV2Reader (BRFileServiceContext context,
+                              BRFileService fs,
+                              uint8_t *bytes,
+                              uint32_t bytesCount) {
+    BRWalletManager manager = (BRWalletManager) context;
+    size_t headerSize = WALLET_MANAGER_BLOCK_V2_HEADER_SIZE;
+    if (bytesCount < headerSize) return NULL;
+
+    uint32_t blockHeight = UInt32GetLE (bytes);
+    BRMerkleBlock *block = NULL;
+
+    if (bytesCount == headerSize || fileServiceTypeBlockHeaderOnly (manager, blockHeight))
+        block = BRMerkleBlockParseHeader (&bytes[sizeof (uint32_t)], 80);
+    else {
+        // Rebuild the network serialization, which an arena block copies out of the mapped log
+        size_t offset = headerSize;
+        uint32_t totalTx = (uint32_t) packedVarIntGet (bytes, bytesCount, &offset);
+        size_t hashesCount = (size_t) packedVarIntGet (bytes, bytesCount, &offset);
+        if (hashesCount > bytesCount / sizeof (UInt256)) return NULL;
+        const uint8_t *hashes = packedBytesGet (bytes, bytesCount, &offset, hashesCount * sizeof (UInt256));
+        size_t flagsLen = (size_t) packedVarIntGet (bytes, bytesCount, &offset);
+        const uint8_t *flags = packedBytesGet (bytes, bytesCount, &offset, flagsLen);
+        if (NULL == hashes || NULL == flags || offset != bytesCount) return NULL;
+
+        size_t netSize = 80 + sizeof (uint32_t) +
+                         BRVarIntSize (hashesCount) + hashesCount * sizeof (UInt256) +
+                         BRVarIntSize (flagsLen)    + flagsLen;
+        uint8_t *net = malloc (netSize);
+
+        size_t netOffset = packedBytesSet (net, 0, &bytes[sizeof (uint32_t)], 80);
+        UInt32SetLE (&net[netOffset], totalTx);
+        netOffset += sizeof (uint32_t);
+        netOffset += BRVarIntSet (&net[netOffset], netSize - netOffset, hashesCount);
+        netOffset  = packedBytesSet (net, netOffset, hashes, hashesCount * sizeof (UInt256));
+        netOffset += BRVarIntSet (&net[netOffset], netSize - netOffset, flagsLen);
+        netOffset  = packedBytesSet (net, netOffset, flags, flagsLen);
+        assert (netOffset == netSize);
+
+        block = BRMerkleBlockParseArena (net, netSize);
+        free (net);
+    }
 
-    BRMerkleBlock *block = BRMerkleBlockParse (bytes, bytesCount);
     if (NULL == block) return NULL;
-    
-    block->height = UInt32GetLE(&bytes[bytesCount - blockHeightSize]);
+
+    block->height = blockHeight;
 
     return block;
 }
@@ -254,9 +736,14 @@ initialBlocksLoad (BRWalletManager manager) {
 
 static const char *fileServiceTypePeers = "peers";
 enum {
-    WALLET_MANAGER_PEER_VERSION_1
+    WALLET_MANAGER_PEER_VERSION_1,
+    WALLET_MANAGER_PEER_VERSION_2,  // adds pingTime and blockRate
+    WALLET_MANAGER_PEER_VERSION_3   // packed, with the address and port fixed and the rest varints
 };
 
+/// The V1 BRPeer layout ended at `flags`; the bytes that follow are V1 padding or V2 fields
+#define WALLET_MANAGER_PEER_V1_SIZE     (offsetof (BRPeer, pingTime))
+
 static UInt256
 fileServiceTypePeerV1Identifier (BRFileServiceContext context,
                                   BRFileService fs,
@@ -264,7 +751,7 @@ fileServiceTypePeerV1Identifier (BRFileServiceContext context,
     const BRPeer *peer = entity;
 
     UInt256 hash;
-    BRSHA256 (&hash, peer, sizeof(BRPeer));
+    BRSHA256 (&hash, peer, WALLET_MANAGER_PEER_V1_SIZE);
 
     return hash;
 }
@@ -289,14 +776,106 @@ fileServiceTypePeerV1Reader (BRFileServiceContext context,
                               BRFileService fs,
                               uint8_t *bytes,
                               uint32_t bytesCount) {
+    assert (bytesCount >= WALLET_MANAGER_PEER_V1_SIZE);
+
+    // V1 peers have no measured speed; leave pingTime and blockRate as 0, 'unknown'
+    BRPeer *peer = calloc (1, sizeof (BRPeer));
+    memcpy (peer, bytes, WALLET_MANAGER_PEER_V1_SIZE);
+
+    return peer;
+}
+
+static UInt256
+fileServiceTypePeerV2Identifier (BRFileServiceContext context,
+                                  BRFileService fs,
+                                  const void *entity) {
+    const BRPeer *peer = entity;
+
+    // Identify by address and port only, so that an updated score replaces the prior entry.
+    uint8_t bytes[sizeof (UInt128) + sizeof (uint16_t)];
+    memcpy (bytes, &peer->address, sizeof (UInt128));
+    memcpy (&bytes[sizeof (UInt128)], &peer->port, sizeof (uint16_t));
+
+    UInt256 hash;
+    BRSHA256 (&hash, bytes, sizeof (bytes));
+
+    return hash;
+}
+
+static uint8_t *
+fileServiceTypePeerV2Writer (BRFileServiceContext context,
+                              BRFileService fs,
+                              const void* entity,
+                              uint32_t *bytesCount) {
+    const BRPeer *peer = entity;
+
+    // long term, this is wrong
+    *bytesCount = sizeof (BRPeer);
+    uint8_t *bytes = malloc (*bytesCount);
+    memcpy (bytes, peer, *bytesCount);
+
+    return bytes;
+}
+
+static void *
+fileServiceTypePeerV2Reader (BRFileServiceContext context,
+                              BRFileService fs,
+                              uint8_t *bytes,
+                              uint32_t bytesCount) {
     assert (bytesCount == sizeof (BRPeer));
 
-    BRPeer *peer = malloc (bytesCount);;
+    BRPeer *peer = malloc (bytesCount);
     memcpy (peer, bytes, bytesCount);
 
     return peer;
 }
 
+static uint8_t *
+fileServiceTypePeerV3Writer (BRFileServiceContext context,
+                             BRFileService fs,
+                             const void* entity,
+                             uint32_t *bytesCount) {
+    const BRPeer *peer = entity;
+    uint8_t bytes[sizeof (UInt128) + sizeof (uint16_t) + 4 * 10];   // LEB128 uint64 is at most 10 bytes
+
+    // `flags` is scratch, and isn't saved
+    size_t offset = packedBytesSet (bytes, 0, &peer->address, sizeof (UInt128));
+    UInt16SetLE (&bytes[offset], peer->port);
+    offset += sizeof (uint16_t);
+    offset = packedVarIntSet (bytes, offset, peer->services);
+    offset = packedVarIntSet (bytes, offset, peer->timestamp);
+    offset = packedVarIntSet (bytes, offset, peer->pingTime);
+    offset = packedVarIntSet (bytes, offset, peer->blockRate);
+
+    *bytesCount = (uint32_t) offset;
+    return memcpy (malloc (offset), bytes, offset);
+}
+
+static void *
+fileServiceTypePeerV3Reader (BRFileServiceContext context,
+                             BRFileService fs,
+                             uint8_t *bytes,
+                             uint32_t bytesCount) {
+    if (bytesCount < sizeof (UInt128) + sizeof (uint16_t)) return NULL;
+
+    BRPeer *peer = calloc (1, sizeof (BRPeer));
+    size_t offset = 0;
+
+    memcpy (&peer->address, packedBytesGet (bytes, bytesCount, &offset, sizeof (UInt128)), sizeof (UInt128));
+    peer->port      = UInt16GetLE (packedBytesGet (bytes, bytesCount, &offset, sizeof (uint16_t)));
+    peer->services  = packedVarIntGet (bytes, bytesCount, &offset);
+    peer->timestamp = packedVarIntGet (bytes, bytesCount, &offset);
+    peer->pingTime  = (uint32_t) packedVarIntGet (bytes, bytesCount, &offset);
+    peer->blockRate = (uint32_t) packedVarIntGet (bytes, bytesCount, &offset);
+
+    if (offset != bytesCount) {
+        free (peer);
+        return NULL;
+    }
+
+    return peer;
+}
+
 static BRArrayOf(BRPeer)
 initialPeersLoad (BRWalletManager manager) {
     /// Load peers for the wallet manager.
@@ -316,17 +895,358 @@ initialPeersLoad (BRWalletManager manager) {
     BRArrayOf(BRPeer) peers;
     array_new (peers, peersCount);
 
-    for (size_t index = 0; index < peersCount; index++)
+    for (size_t index = 0; index < peersCount; index++) {
         array_add (peers, *peersRefs[index]);
+        free (peersRefs[index]);
+    }
 
     return peers;
 }
 
+/// MARK: - Wallet Summary File Service
+
+///
+/// The wallet's summary - its transaction order, balance history, UTXOs and derived addresses - lets
+/// BRWalletManagerNew() restore the wallet without re-sorting and replaying every transaction or
+/// re-deriving its addresses.  There is one summary, saved when a sync stops and when the manager is
+/// freed.  It is checksummed, and its balance is checked against the loaded transactions and ignored if
+/// they've changed since, so a summary that is out of date costs only the full replay.
+///
+static const char *fileServiceTypeWalletSummary = "summary";
+
+enum {
+    WALLET_MANAGER_SUMMARY_VERSION_1
+};
+
+typedef struct {
+    size_t bytesCount;
+    uint8_t bytes[];
+} BRWalletSummaryRecord;
+
+static size_t
+walletSummaryRecordHash (const void *record) {
+    return (size_t) record;
+}
+
+static int
+walletSummaryRecordEq (const void *record1, const void *record2) {
+    return record1 == record2;
+}
+
+static UInt256
+fileServiceTypeWalletSummaryV1Identifier (BRFileServiceContext context,
+                                          BRFileService fs,
+                                          const void *entity) {
+    return UINT256_ZERO;    // there is only the one
+}
+
+static uint8_t *
+fileServiceTypeWalletSummaryV1Writer (BRFileServiceContext context,
+                                      BRFileService fs,
+                                      const void* entity,
+                                      uint32_t *bytesCount) {
+    BRWallet *wallet = (BRWallet *) entity;
+
+    // If a wallet batch began since the size was taken, the second call writes nothing and the
+    // empty summary is ignored on load.
+    size_t summaryCount = BRWalletSerializeSummary (wallet, NULL, 0);
+    uint8_t *bytes = malloc (summaryCount > 0 ? summaryCount : 1);
+
+    *bytesCount = (uint32_t) BRWalletSerializeSummary (wallet, bytes, summaryCount);
+    return bytes;
+}
+
+static void *
+fileServiceTypeWalletSummaryV1Reader (BRFileServiceContext context,
+                                      BRFileService fs,
+                                      uint8_t *bytes,
+                                      uint32_t bytesCount) {
+    BRWalletSummaryRecord *record = malloc (sizeof (BRWalletSummaryRecord) + bytesCount);
+
+    record->bytesCount = bytesCount;
+    memcpy (record->bytes, bytes, bytesCount);
+    return record;
+}
+
+static BRWalletSummaryRecord *
+initialWalletSummaryLoad (BRWalletManager manager) {
+    BRSetOf(BRWalletSummaryRecord*) summarySet = BRSetNew(walletSummaryRecordHash, walletSummaryRecordEq, 1);
+    BRWalletSummaryRecord *record = NULL;
+
+    if (1 == fileServiceLoad (manager->fileService, summarySet, fileServiceTypeWalletSummary, 1) &&
+        1 == BRSetCount (summarySet)) {
+        BRSetAll (summarySet, (void**) &record, 1);
+        BRSetFree (summarySet);
+    }
+    else BRSetFreeAll (summarySet, free);
+
+    return record;
+}
+
+/// MARK: - Condensed Transactions File Service
+
+///
+/// What BRWalletManagerCondenseTransactions() keeps of the transactions it condenses - their
+/// records, the outputs they spent and the addresses they paid to - see BRWalletSerializeCondensed().
+/// There is one, saved on each condense.  BRWalletManagerNew() loads the transactions without the
+/// condensed ones' bodies and restores it to the wallet.  If it's lost or corrupt every body is
+/// loaded instead, as if nothing was condensed.
+///
+static const char *fileServiceTypeCondensed = "condensed";
+
+enum {
+    WALLET_MANAGER_CONDENSED_VERSION_1
+};
+
+static uint8_t *
+fileServiceTypeCondensedV1Writer (BRFileServiceContext context,
+                                  BRFileService fs,
+                                  const void* entity,
+                                  uint32_t *bytesCount) {
+    BRWallet *wallet = (BRWallet *) entity;
+
+    // If another condense ran since the size was taken, the second call writes nothing and the
+    // empty record is ignored on load; that condense saves its own.
+    size_t condensedCount = BRWalletSerializeCondensed (wallet, NULL, 0);
+    uint8_t *bytes = malloc (condensedCount > 0 ? condensedCount : 1);
+
+    *bytesCount = (uint32_t) BRWalletSerializeCondensed (wallet, bytes, condensedCount);
+    return bytes;
+}
+
+static BRWalletSummaryRecord *
+initialCondensedLoad (BRWalletManager manager) {
+    BRSetOf(BRWalletSummaryRecord*) condensedSet = BRSetNew(walletSummaryRecordHash, walletSummaryRecordEq, 1);
+    BRWalletSummaryRecord *record = NULL;
+
+    if (1 == fileServiceLoad (manager->fileService, condensedSet, fileServiceTypeCondensed, 1) &&
+        1 == BRSetCount (condensedSet)) {
+        BRSetAll (condensedSet, (void**) &record, 1);
+        BRSetFree (condensedSet);
+    }
+    else BRSetFreeAll (condensedSet, free);
+
+    return record;
+}
+
+/// MARK: - Initial Load
+
+///
+/// Blocks, peers and the wallet summary load on threads of their own while the transactions load
+/// on the caller's; the file service reads each type's records without its lock, and splits the
+/// records of a long log across threads too.
+///
+typedef struct {
+    BRWalletManager manager;
+    BRArrayOf(BRMerkleBlock*) blocks;
+    BRArrayOf(BRPeer) peers;
+    BRWalletSummaryRecord *summary;
+    BRWalletSummaryRecord *condensed;
+} BRWalletManagerInitialLoad;
+
+static void *
+initialBlocksLoadThread (BRWalletManagerInitialLoad *load) {
+    load->blocks = initialBlocksLoad (load->manager);
+    return NULL;
+}
+
+static void *
+initialPeersLoadThread (BRWalletManagerInitialLoad *load) {
+    load->peers = initialPeersLoad (load->manager);
+    return NULL;
+}
+
+static void *
+initialWalletSummaryLoadThread (BRWalletManagerInitialLoad *load) {
+    load->summary = initialWalletSummaryLoad (load->manager);
+    return NULL;
+}
+
+static BRArrayOf(BRTransaction*)
+initialLoad (BRWalletManager manager, BRMasterPubKey mpk, BRWalletManagerInitialLoad *load) {
+    void *(*routines[]) (BRWalletManagerInitialLoad *) = {
+        initialBlocksLoadThread,
+        initialPeersLoadThread,
+        initialWalletSummaryLoadThread
+    };
+    size_t routinesCount = sizeof (routines) / sizeof (routines[0]);
+
+    pthread_t threads[routinesCount];
+    int started[routinesCount];
+
+    *load = (BRWalletManagerInitialLoad) { manager, NULL, NULL, NULL, NULL };
+
+    for (size_t index = 0; index < routinesCount; index++)
+        started[index] = (0 == pthread_create (&threads[index], NULL, (void *(*) (void *)) routines[index], load));
+
+    // The condensed transactions are needed first, to leave their bodies out of the load.
+    load->condensed = initialCondensedLoad (manager);
+
+    size_t condensedCount = (NULL == load->condensed ? 0
+                             : BRWalletCondensedTxHashes (load->condensed->bytes, load->condensed->bytesCount,
+                                                          mpk, NULL, 0));
+    UInt256 *condensed = calloc (condensedCount > 0 ? condensedCount : 1, sizeof (UInt256));
+    if (condensedCount > 0)
+        BRWalletCondensedTxHashes (load->condensed->bytes, load->condensed->bytesCount,
+                                   mpk, condensed, condensedCount);
+
+    BRArrayOf(BRTransaction*) transactions = initialTransactionsLoad (manager, condensed, condensedCount);
+    free (condensed);
+
+    // Run here anything a thread couldn't be started for.
+    for (size_t index = 0; index < routinesCount; index++)
+        if (started[index]) pthread_join (threads[index], NULL);
+        else routines[index] (load);
+
+    return transactions;
+}
+
+static void
+bwmSaveWalletSummary (BRWalletManager manager) {
+    if (0 != BRWalletSerializeSummary (manager->wallet, NULL, 0))
+        fileServiceSave (manager->fileService, fileServiceTypeWalletSummary, manager->wallet);
+    else
+        fileServiceRemove (manager->fileService, fileServiceTypeWalletSummary, UINT256_ZERO);
+}
+
+/// MARK: - Store Repair
+
+///
+/// A FileService failure damages, at most, the one store (entity type) it happened in; everything
+/// else on disk, and everything in memory, is still good.  So rather than forcing a *FULL SYNC* on
+/// any failure, the failed store is rebuilt from memory: transactions from the wallet, blocks from
+/// the peer manager's chain and peers by simply dropping them (at worst, re-discovered over DNS).
+/// Only a failure that can't be pinned to one of these stores still forces a rescan.
+///
+/// The handler runs on whatever thread failed - likely one holding the peer manager's lock in a
+/// saveBlocks() callback - so the repair itself runs on its own thread.  A repair that keeps
+/// failing (say, a full disk) is bounded by BWM_REPAIR_LIMIT.
+///
+enum {
+    BWM_STORE_TRANSACTIONS = 1 << 0,
+    BWM_STORE_BLOCKS       = 1 << 1,
+    BWM_STORE_PEERS        = 1 << 2,
+    BWM_STORE_UNKNOWN      = 1 << 3        // can't be pinned to a store; rescan
+};
+
+#define BWM_REPAIR_LIMIT        (10)
+
+static int
+bwmRepairStoreForType (const char *type) {
+    if (NULL == type) return BWM_STORE_UNKNOWN;
+    else if (0 == strcmp (type, fileServiceTypeTransactions)) return BWM_STORE_TRANSACTIONS;
+    else if (0 == strcmp (type, fileServiceTypeBlocks))       return BWM_STORE_BLOCKS;
+    else if (0 == strcmp (type, fileServiceTypePeers))        return BWM_STORE_PEERS;
+    else if (0 == strcmp (type, fileServiceTypeWalletSummary))
+        // The summary is only ever a shortcut; the next save replaces whatever is there.
+        return 0;
+    else if (0 == strcmp (type, fileServiceTypeCondensed))
+        // Without it every transaction body, all still saved, is loaded; the next condense resaves it.
+        return 0;
+    else return BWM_STORE_UNKNOWN;
+}
+
+static void
+bwmRepairStores (BRWalletManager bwm, int stores) {
+    if (stores & BWM_STORE_UNKNOWN) {
+        _peer_log ("bread: FileService Repair: FORCED SYNC%s", "");
+        if (NULL != bwm->peerManager) BRPeerManagerRescan (bwm->peerManager);
+        return;
+    }
+
+    if (stores & BWM_STORE_TRANSACTIONS) {
+        _peer_log ("bread: FileService Repair: %s", fileServiceTypeTransactions);
+        // Copies; the peer manager may remove, or a condense free, the wallet's own meanwhile.
+        size_t transactionsCount = BRWalletTransactionsCopy (bwm->wallet, NULL, 0);
+        BRTransaction **transactions = calloc (transactionsCount, sizeof (BRTransaction *));
+        transactionsCount = BRWalletTransactionsCopy (bwm->wallet, transactions, transactionsCount);
+
+        // Condensed transactions' bodies are only in the store; keep them and resave the rest.
+        if (0 == BRWalletCondensedTransactions (bwm->wallet, NULL, 0, 0))
+            fileServiceClear (bwm->fileService, fileServiceTypeTransactions);
+        for (size_t index = 0; index < transactionsCount; index++) {
+            fileServiceSave (bwm->fileService, fileServiceTypeTransactions, transactions[index]);
+            BRTransactionFree (transactions[index]);
+        }
+        free (transactions);
+    }
+
+    if (stores & BWM_STORE_BLOCKS) {
+        _peer_log ("bread: FileService Repair: %s", fileServiceTypeBlocks);
+        // Replaces (clears) the stored blocks through _BRWalletManagerSaveBlocks()
+        if (NULL != bwm->peerManager) BRPeerManagerResaveBlocks (bwm->peerManager);
+    }
+
+    if (stores & BWM_STORE_PEERS) {
+        _peer_log ("bread: FileService Repair: %s", fileServiceTypePeers);
+        fileServiceClear (bwm->fileService, fileServiceTypePeers);
+    }
+}
+
+static void *
+bwmRepairStoresThread (void *context) {
+    BRWalletManager bwm = (BRWalletManager) context;
+
+    pthread_mutex_lock (&bwm->repairLock);
+    while (0 != bwm->repairStores && !bwm->repairClosed) {
+        int stores = bwm->repairStores;
+        bwm->repairStores = 0;
+
+        pthread_mutex_unlock (&bwm->repairLock);
+        bwmRepairStores (bwm, stores);
+        pthread_mutex_lock (&bwm->repairLock);
+    }
+    bwm->repairRunning = 0;
+    pthread_cond_broadcast (&bwm->repairDone);
+    pthread_mutex_unlock (&bwm->repairLock);
+
+    return NULL;
+}
+
+static void
+bwmRepairStoresSchedule (BRWalletManager bwm, int stores) {
+    pthread_mutex_lock (&bwm->repairLock);
+    if (bwm->repairClosed || 0 == stores)
+        ;
+    else if (bwm->repairCount >= BWM_REPAIR_LIMIT)
+        _peer_log ("bread: FileService Repair: LIMIT REACHED%s", "");
+    else {
+        bwm->repairCount++;
+        bwm->repairStores |= stores;
+
+        if (!bwm->repairRunning) {
+            pthread_t thread;
+            pthread_attr_t attr;
+
+            pthread_attr_init (&attr);
+            pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+            bwm->repairRunning = (0 == pthread_create (&thread, &attr, bwmRepairStoresThread, bwm));
+            pthread_attr_destroy (&attr);
+
+            if (!bwm->repairRunning) _peer_log ("bread: FileService Repair: NO THREAD%s", "");
+        }
+    }
+    pthread_mutex_unlock (&bwm->repairLock);
+}
+
+static void
+bwmRepairStoresClose (BRWalletManager bwm) {
+    pthread_mutex_lock (&bwm->repairLock);
+    bwm->repairClosed = 1;
+    while (bwm->repairRunning)
+        pthread_cond_wait (&bwm->repairDone, &bwm->repairLock);
+    pthread_mutex_unlock (&bwm->repairLock);
+
+    pthread_cond_destroy (&bwm->repairDone);
+    pthread_mutex_destroy (&bwm->repairLock);
+}
+
 static void
 bwmFileServiceErrorHandler (BRFileServiceContext context,
                             BRFileService fs,
                             BRFileServiceError error) {
     BRWalletManager bwm = (BRWalletManager) context;
+    int stores = BWM_STORE_UNKNOWN;
 
     switch (error.type) {
         case FILE_SERVICE_IMPL:
@@ -334,26 +1254,216 @@ bwmFileServiceErrorHandler (BRFileServiceContext context,
             _peer_log ("bread: FileService Error: IMPL: %s", error.u.impl.reason);
             break;
         case FILE_SERVICE_UNIX:
-            _peer_log ("bread: FileService Error: UNIX: %s", strerror(error.u.unix.error));
+            _peer_log ("bread: FileService Error: UNIX (%s): %s",
+                       (NULL != error.u.unix.type ? error.u.unix.type : "none"),
+                       strerror(error.u.unix.error));
+            stores = bwmRepairStoreForType (error.u.unix.type);
             break;
         case FILE_SERVICE_ENTITY:
             // This is likely a coding error too.
             _peer_log ("bread: FileService Error: ENTITY (%s); %s",
                      error.u.entity.type,
                      error.u.entity.reason);
+            stores = bwmRepairStoreForType (error.u.entity.type);
+            break;
+    }
+
+    bwmRepairStoresSchedule (bwm, stores);
+}
+
+/// MARK: - Send
+
+///
+/// A send is built, and the coins it spends reserved, on the caller's thread; that is quick and,
+/// being serialized by `sendLock`, keeps concurrent sends from selecting the same coins.  Deriving
+/// keys and signing is the slow part and runs on one of BWM_SEND_WORKERS worker threads, which
+/// then hand the transaction to the peer manager to publish.  The reservation is released when
+/// the publish callback reports, whatever the error; a published transaction has been registered
+/// by then, so its inputs are spent anyway.
+///
+typedef struct BRWalletManagerSendJobStruct {
+    BRWalletManager manager;
+    BRTransaction *transaction;
+    uint8_t *seed;
+    size_t seedLen;
+    BRWalletManagerSendCallback callback;
+    void *context;
+} *BRWalletManagerSendJob;
+
+static void
+bwmSendJobRelease (BRWalletManagerSendJob job) {
+    if (NULL != job->seed) {
+        mem_clean (job->seed, job->seedLen);
+        free (job->seed);
+    }
+    free (job);
+}
+
+static void
+bwmSendJobAbandon (BRWalletManagerSendJob job, int error) {
+    BRWalletManager bwm = job->manager;
+
+    BRWalletReleaseTxInputs (bwm->wallet, job->transaction);
+    if (NULL != job->callback) job->callback (bwm, job->context, job->transaction, error);
+    BRTransactionFree (job->transaction);
+    bwmSendJobRelease (job);
+}
+
+static void
+bwmSendPublished (void *info, int error) {
+    BRWalletManagerSendJob job = (BRWalletManagerSendJob) info;
+    BRWalletManager bwm = job->manager;
+    int found = 0;
+
+    pthread_mutex_lock (&bwm->sendLock);
+    for (size_t index = 0; index < array_count (bwm->sendPublishing); index++)
+        if (job == bwm->sendPublishing[index]) {
+            array_rm (bwm->sendPublishing, index);
+            found = 1;
             break;
+        }
+    pthread_mutex_unlock (&bwm->sendLock);
+
+    // Otherwise already cancelled, in BRWalletManagerFree()
+    if (!found) return;
+
+    // The peer manager owns the transaction now; it is registered in the wallet if published.
+    BRWalletReleaseTxInputs (bwm->wallet, job->transaction);
+    if (NULL != job->callback) job->callback (bwm, job->context, job->transaction, error);
+    bwmSendJobRelease (job);
+}
+
+static void *
+bwmSendThread (void *context) {
+    BRWalletManager bwm = (BRWalletManager) context;
+
+    pthread_mutex_lock (&bwm->sendLock);
+    while (1) {
+        while (!bwm->sendClosed && 0 == array_count (bwm->sendQueue))
+            pthread_cond_wait (&bwm->sendReady, &bwm->sendLock);
+        if (bwm->sendClosed) break;
+
+        BRWalletManagerSendJob job = bwm->sendQueue[0];
+        array_rm (bwm->sendQueue, 0);
+        pthread_mutex_unlock (&bwm->sendLock);
+
+        int result = BRWalletSignTransaction (bwm->wallet, job->transaction, job->seed, job->seedLen);
+        mem_clean (job->seed, job->seedLen);
+        free (job->seed);
+        job->seed = NULL;
+
+        if (1 != result)
+            // No seed (-1) is a cancelled authentication; anything else can't be signed
+            bwmSendJobAbandon (job, (-1 == result ? ECANCELED : EINVAL));
+        else {
+            // Publishing may call back right away, on this thread; be ready to find the job
+            pthread_mutex_lock (&bwm->sendLock);
+            array_add (bwm->sendPublishing, job);
+            pthread_mutex_unlock (&bwm->sendLock);
+
+            BRPeerManagerPublishTx (bwm->peerManager, job->transaction, job, bwmSendPublished);
+        }
+
+        pthread_mutex_lock (&bwm->sendLock);
     }
-    _peer_log ("bread: FileService Error: FORCED SYNC%s", "");
+    pthread_mutex_unlock (&bwm->sendLock);
 
-    if (NULL != bwm->peerManager)
-        BRPeerManagerRescan (bwm->peerManager);
+    return NULL;
+}
+
+extern int
+BRWalletManagerSend (BRWalletManager manager,
+                     const BRTxOutput *outputs,
+                     size_t outputsCount,
+                     const void *seed,
+                     size_t seedLen,
+                     BRWalletManagerSendCallback callback,
+                     void *context) {
+    BRTransaction *transaction = NULL;
+
+    pthread_mutex_lock (&manager->sendLock);
+    if (manager->sendClosed) { pthread_mutex_unlock (&manager->sendLock); return 0; }
+
+    // Coins reserved outside the manager, between creating and reserving, are skipped on a retry.
+    while (NULL != (transaction = BRWalletCreateTxForOutputs (manager->wallet, outputs, outputsCount)) &&
+           !BRWalletReserveTxInputs (manager->wallet, transaction))
+        BRTransactionFree (transaction);
+
+    if (NULL == transaction) { pthread_mutex_unlock (&manager->sendLock); return 0; }
+
+    BRWalletManagerSendJob job = calloc (1, sizeof (struct BRWalletManagerSendJobStruct));
+    job->manager     = manager;
+    job->transaction = transaction;
+    job->seed        = (NULL != seed ? malloc (seedLen) : NULL);
+    job->seedLen     = (NULL != seed ? seedLen : 0);
+    job->callback    = callback;
+    job->context     = context;
+    if (NULL != seed) memcpy (job->seed, seed, seedLen);
+
+    array_add (manager->sendQueue, job);
+
+    // Workers are started on the first send; most managers never send.
+    while (manager->sendWorkersCount < BWM_SEND_WORKERS &&
+           0 == pthread_create (&manager->sendWorkers[manager->sendWorkersCount], NULL, bwmSendThread, manager))
+        manager->sendWorkersCount++;
+
+    if (0 == manager->sendWorkersCount) {
+        _peer_log ("bread: Send: NO THREAD%s", "");
+        array_rm_last (manager->sendQueue);
+        pthread_mutex_unlock (&manager->sendLock);
+        bwmSendJobAbandon (job, EAGAIN);
+        return 1;
+    }
+
+    pthread_cond_signal (&manager->sendReady);
+    pthread_mutex_unlock (&manager->sendLock);
+    return 1;
+}
+
+///
+/// Stop the workers and abandon the sends they hadn't started.  Sends already handed to the peer
+/// manager are left to it; see bwmSendRelease().
+///
+static void
+bwmSendClose (BRWalletManager bwm) {
+    pthread_mutex_lock (&bwm->sendLock);
+    bwm->sendClosed = 1;
+    pthread_cond_broadcast (&bwm->sendReady);
+    pthread_mutex_unlock (&bwm->sendLock);
+
+    for (size_t index = 0; index < bwm->sendWorkersCount; index++)
+        pthread_join (bwm->sendWorkers[index], NULL);
+    bwm->sendWorkersCount = 0;
+
+    for (size_t index = 0; index < array_count (bwm->sendQueue); index++)
+        bwmSendJobAbandon (bwm->sendQueue[index], ECANCELED);
+    array_clear (bwm->sendQueue);
+}
+
+///
+/// Cancel the sends whose publish callback never came.  Called once the peer manager is gone,
+/// along with their transactions; so no transaction is passed and no reservation is released -
+/// the wallet is about to be freed too.
+///
+static void
+bwmSendRelease (BRWalletManager bwm) {
+    for (size_t index = 0; index < array_count (bwm->sendPublishing); index++) {
+        BRWalletManagerSendJob job = bwm->sendPublishing[index];
+        if (NULL != job->callback) job->callback (bwm, job->context, NULL, ECANCELED);
+        bwmSendJobRelease (job);
+    }
+
+    array_free (bwm->sendQueue);
+    array_free (bwm->sendPublishing);
+    pthread_cond_destroy (&bwm->sendReady);
+    pthread_mutex_destroy (&bwm->sendLock);
 }
 
 /// MARK: - Wallet Manager
 
 static BRWalletManager
 bwmCreateErrorHandler (BRWalletManager bwm, int fileService, const char* reason) {
-    if (NULL != bwm) free (bwm);
+    if (NULL != bwm) { bwmRepairStoresClose (bwm); bwmSendClose (bwm); bwmSendRelease (bwm); free (bwm); }
     if (fileService)
         _peer_log ("bread: on ewmCreate: FileService Error: %s", reason);
     else
@@ -368,11 +1478,23 @@ BRWalletManagerNew (BRWalletManagerClient client,
                     const BRChainParams *params,
                     uint32_t earliestKeyTime,
                     const char *baseStoragePath) {
-    BRWalletManager manager = malloc (sizeof (struct BRWalletManagerStruct));
+    BRWalletManager manager = calloc (1, sizeof (struct BRWalletManagerStruct));
     if (NULL == manager) return bwmCreateErrorHandler (NULL, 0, "allocate");
 
 //    manager->walletForkId = fork;
     manager->client = client;
+    manager->params = params;
+
+    // Closed until the wallet and peer manager exist; failures while loading already force a sync.
+    pthread_mutex_init (&manager->repairLock, NULL);
+    pthread_cond_init (&manager->repairDone, NULL);
+    manager->repairClosed = 1;
+
+    pthread_mutex_init (&manager->sendLock, NULL);
+    pthread_cond_init (&manager->sendReady, NULL);
+    array_new (manager->sendQueue, 4);
+    array_new (manager->sendPublishing, 4);
+    manager->sendClosed = 1;
 
     BRWalletForkId fork = getForkId (params);
     const char *networkName  = getNetworkName  (params);
@@ -386,14 +1508,28 @@ BRWalletManagerNew (BRWalletManagerClient client,
                                               bwmFileServiceErrorHandler);
     if (NULL == manager->fileService) return bwmCreateErrorHandler (manager, 1, "create");
 
+    // Transactions and blocks parse straight out of the mapped logs; their readers copy what they keep.
+    fileServiceSetLoadMapped (manager->fileService, 1);
+
+    // Blocks, peers and transactions are saved from PeerManager threads, often in bursts during a
+    // sync; queue them for the file service's writer rather than writing each one inline.
+    fileServiceSetWriteBehind (manager->fileService, 1);
+
     /// Transaction
     if (1 != fileServiceDefineType (manager->fileService, fileServiceTypeTransactions, WALLET_MANAGER_TRANSACTION_VERSION_1,
                                     (BRFileServiceContext) manager,
                                     fileServiceTypeTransactionV1Identifier,
                                     fileServiceTypeTransactionV1Reader,
                                     fileServiceTypeTransactionV1Writer) ||
+        1 != fileServiceDefineType (manager->fileService, fileServiceTypeTransactions, WALLET_MANAGER_TRANSACTION_VERSION_2,
+                                    (BRFileServiceContext) manager,
+                                    fileServiceTypeTransactionV1Identifier,
+                                    fileServiceTypeTransactionV2Reader,
+                                    fileServiceTypeTransactionV2Writer) ||
         1 != fileServiceDefineCurrentVersion (manager->fileService, fileServiceTypeTransactions,
-                                              WALLET_MANAGER_TRANSACTION_VERSION_1))
+                                              WALLET_MANAGER_TRANSACTION_VERSION_2) ||
+        1 != fileServiceSetLoadConcurrent (manager->fileService, fileServiceTypeTransactions, 1) ||
+        1 != fileServiceSetLoadRepair (manager->fileService, fileServiceTypeTransactions, 1))
         return bwmCreateErrorHandler (manager, 1, fileServiceTypeTransactions);
 
     /// Block
@@ -402,8 +1538,15 @@ BRWalletManagerNew (BRWalletManagerClient client,
                                     fileServiceTypeBlockV1Identifier,
                                     fileServiceTypeBlockV1Reader,
                                     fileServiceTypeBlockV1Writer) ||
+        1 != fileServiceDefineType (manager->fileService, fileServiceTypeBlocks, WALLET_MANAGER_BLOCK_VERSION_2,
+                                    (BRFileServiceContext) manager,
+                                    fileServiceTypeBlockV1Identifier,
+                                    fileServiceTypeBlockV2Reader,
+                                    fileServiceTypeBlockV2Writer) ||
         1 != fileServiceDefineCurrentVersion (manager->fileService, fileServiceTypeBlocks,
-                                              WALLET_MANAGER_BLOCK_VERSION_1))
+                                              WALLET_MANAGER_BLOCK_VERSION_2) ||
+        1 != fileServiceSetLoadConcurrent (manager->fileService, fileServiceTypeBlocks, 1) ||
+        1 != fileServiceSetLoadRepair (manager->fileService, fileServiceTypeBlocks, 1))
         return bwmCreateErrorHandler (manager, 1, fileServiceTypeBlocks);
 
     /// Peer
@@ -412,15 +1555,51 @@ BRWalletManagerNew (BRWalletManagerClient client,
                                     fileServiceTypePeerV1Identifier,
                                     fileServiceTypePeerV1Reader,
                                     fileServiceTypePeerV1Writer) ||
+        1 != fileServiceDefineType (manager->fileService, fileServiceTypePeers, WALLET_MANAGER_PEER_VERSION_2,
+                                    (BRFileServiceContext) manager,
+                                    fileServiceTypePeerV2Identifier,
+                                    fileServiceTypePeerV2Reader,
+                                    fileServiceTypePeerV2Writer) ||
+        1 != fileServiceDefineType (manager->fileService, fileServiceTypePeers, WALLET_MANAGER_PEER_VERSION_3,
+                                    (BRFileServiceContext) manager,
+                                    fileServiceTypePeerV2Identifier,
+                                    fileServiceTypePeerV3Reader,
+                                    fileServiceTypePeerV3Writer) ||
         1 != fileServiceDefineCurrentVersion (manager->fileService, fileServiceTypePeers,
-                                              WALLET_MANAGER_PEER_VERSION_1))
+                                              WALLET_MANAGER_PEER_VERSION_3) ||
+        1 != fileServiceSetLoadConcurrent (manager->fileService, fileServiceTypePeers, 1) ||
+        1 != fileServiceSetLoadRepair (manager->fileService, fileServiceTypePeers, 1))
         return bwmCreateErrorHandler (manager, 1, fileServiceTypePeers);
 
-    /// Load transactions for the wallet manager.
-    BRArrayOf(BRTransaction*) transactions = initialTransactionsLoad(manager);
-    /// Load blocks and peers for the peer manager.
-    BRArrayOf(BRMerkleBlock*) blocks = initialBlocksLoad(manager);
-    BRArrayOf(BRPeer) peers = initialPeersLoad(manager);
+    /// Wallet Summary
+    if (1 != fileServiceDefineType (manager->fileService, fileServiceTypeWalletSummary, WALLET_MANAGER_SUMMARY_VERSION_1,
+                                    (BRFileServiceContext) manager,
+                                    fileServiceTypeWalletSummaryV1Identifier,
+                                    fileServiceTypeWalletSummaryV1Reader,
+                                    fileServiceTypeWalletSummaryV1Writer) ||
+        1 != fileServiceDefineCurrentVersion (manager->fileService, fileServiceTypeWalletSummary,
+                                              WALLET_MANAGER_SUMMARY_VERSION_1) ||
+        1 != fileServiceSetLoadConcurrent (manager->fileService, fileServiceTypeWalletSummary, 1))
+        return bwmCreateErrorHandler (manager, 1, fileServiceTypeWalletSummary);
+
+    /// Condensed Transactions
+    if (1 != fileServiceDefineType (manager->fileService, fileServiceTypeCondensed, WALLET_MANAGER_CONDENSED_VERSION_1,
+                                    (BRFileServiceContext) manager,
+                                    fileServiceTypeWalletSummaryV1Identifier,
+                                    fileServiceTypeWalletSummaryV1Reader,
+                                    fileServiceTypeCondensedV1Writer) ||
+        1 != fileServiceDefineCurrentVersion (manager->fileService, fileServiceTypeCondensed,
+                                              WALLET_MANAGER_CONDENSED_VERSION_1))
+        return bwmCreateErrorHandler (manager, 1, fileServiceTypeCondensed);
+
+    /// Load transactions for the wallet manager, blocks and peers for the peer manager, and the
+    /// wallet summary, which spares the wallet replaying every transaction - all concurrently.
+    BRWalletManagerInitialLoad load;
+    BRArrayOf(BRTransaction*) transactions = initialLoad (manager, mpk, &load);
+    BRArrayOf(BRMerkleBlock*) blocks = load.blocks;
+    BRArrayOf(BRPeer) peers = load.peers;
+    BRWalletSummaryRecord *summary = load.summary;
+    BRWalletSummaryRecord *condensed = load.condensed;
 
     // If any of these are NULL, then there was a failure; on a failure they all need to be cleared
     // which will cause a *FULL SYNC*
@@ -433,9 +1612,39 @@ BRWalletManagerNew (BRWalletManagerClient client,
 
         if (NULL == peers) array_new (peers, 1);
         else array_clear(peers);
+
+        // The sync re-adds the condensed transactions too.
+        if (NULL != condensed) {
+            fileServiceRemove (manager->fileService, fileServiceTypeCondensed, UINT256_ZERO);
+            free (condensed);
+            condensed = NULL;
+        }
+    }
+
+    // Records lost to corruption are dropped on load, and only what they held is re-downloaded:
+    // a lost block or two leaves the chain ending at the gap, which the sync resumes from, and lost
+    // peers are re-discovered.  But a lost transaction's block is lost with it, so the chain starts
+    // again from the checkpoint before earliestKeyTime; the transactions that survived are kept.
+    else if (0 != fileServiceGetDroppedCount (manager->fileService, fileServiceTypeTransactions)) {
+        _peer_log ("bread: FileService Repair: %s lost; resyncing from the checkpoint",
+                   fileServiceTypeTransactions);
+        for (size_t index = 0; index < array_count(blocks); index++)
+            BRMerkleBlockFree (blocks[index]);
+        array_clear(blocks);
     }
 
-    manager->wallet = BRWalletNew (transactions, array_count(transactions), mpk, fork);
+    manager->wallet = BRWalletNewWithSummary (transactions, array_count(transactions), mpk, fork,
+                                              (NULL != summary ? summary->bytes : NULL),
+                                              (NULL != summary ? summary->bytesCount : 0));
+    if (NULL != summary) free (summary);
+
+    // Fails, leaving the wallet with every transaction it was given, only if the record is corrupt -
+    // in which case initialLoad() excluded nothing - or its transactions came back uncondensed.
+    if (NULL != condensed &&
+        !BRWalletRestoreCondensed (manager->wallet, condensed->bytes, condensed->bytesCount))
+        _peer_log ("bread: FileService: %s not restored", fileServiceTypeCondensed);
+    if (NULL != condensed) free (condensed);
+
     BRWalletSetCallbacks (manager->wallet, manager,
                           _BRWalletManagerBalanceChanged,
                           _BRWalletManagerTxAdded,
@@ -464,13 +1673,25 @@ BRWalletManagerNew (BRWalletManagerClient client,
 
     array_free(transactions); array_free(blocks); array_free(peers);
 
+    pthread_mutex_lock (&manager->repairLock);
+    manager->repairClosed = 0;
+    pthread_mutex_unlock (&manager->repairLock);
+
+    pthread_mutex_lock (&manager->sendLock);
+    manager->sendClosed = 0;
+    pthread_mutex_unlock (&manager->sendLock);
+
     return manager;
 }
 
 extern void
 BRWalletManagerFree (BRWalletManager manager) {
+    bwmSaveWalletSummary (manager);
+    bwmRepairStoresClose (manager);
+    bwmSendClose (manager);
     fileServiceRelease(manager->fileService);
     BRPeerManagerFree(manager->peerManager);
+    bwmSendRelease (manager);
     BRWalletFree(manager->wallet);
     free (manager);
 }
@@ -485,6 +1706,47 @@ BRWalletManagerGetPeerManager (BRWalletManager manager) {
     return manager->peerManager;
 }
 
+extern size_t
+BRWalletManagerCondenseTransactions (BRWalletManager manager,
+                                     uint32_t confirmations) {
+    BRWallet *wallet = manager->wallet;
+    size_t transactionsCount = BRWalletCondenseTransactions (wallet, confirmations, NULL, 0);
+    if (0 == transactionsCount) return 0;
+
+    // Every transaction was saved as it was added or updated, so the bodies needn't be saved again.
+    BRTransaction **transactions = calloc (transactionsCount, sizeof (BRTransaction *));
+    transactionsCount = BRWalletCondenseTransactions (wallet, confirmations,
+                                                      transactions, transactionsCount);
+
+    // Saved before the events, so the client finds the transactions condensed if it reloads.
+    fileServiceSave (manager->fileService, fileServiceTypeCondensed, wallet);
+
+    // The client may hold these from earlier events; announce each before it is freed.
+    for (size_t index = 0; index < transactionsCount; index++) {
+        manager->client.funcTransactionEvent (manager,
+                                              wallet,
+                                              transactions[index],
+                                              (BRTransactionEvent) {
+                                                  BITCOIN_TRANSACTION_CONDENSED
+                                              });
+        BRTransactionFree (transactions[index]);
+    }
+    free (transactions);
+
+    return transactionsCount;
+}
+
+extern BRTransaction *
+BRWalletManagerLoadTransaction (BRWalletManager manager,
+                                UInt256 txHash) {
+    BRTransaction *transaction = BRWalletTransactionForHash (manager->wallet, txHash);
+    if (NULL != transaction) return BRTransactionCopy (transaction);
+
+    return (BRWalletCondensedTransactions (manager->wallet, NULL, 0, 0) > 0
+            ? fileServiceLoadEntity (manager->fileService, fileServiceTypeTransactions, txHash)
+            : NULL);
+}
+
 extern void
 BRWalletManagerConnect (BRWalletManager manager) {
     BRPeerManagerConnect(manager->peerManager);
@@ -595,6 +1857,7 @@ _BRWalletManagerSyncStarted (void *info) {
 static void
 _BRWalletManagerSyncStopped (void *info, int reason) {
     BRWalletManager manager = (BRWalletManager) info;
+    bwmSaveWalletSummary (manager);
     manager->client.funcWalletManagerEvent (manager,
                                             (BRWalletManagerEvent) {
                                                 BITCOIN_WALLET_MANAGER_SYNC_STOPPED,
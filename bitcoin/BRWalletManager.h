@@ -54,6 +54,7 @@ typedef enum {
     BITCOIN_TRANSACTION_ADDED,
     BITCOIN_TRANSACTION_UPDATED,
     BITCOIN_TRANSACTION_DELETED,
+    BITCOIN_TRANSACTION_CONDENSED,     // still the wallet's, but the BRTransaction is freed after the event
 } BRTransactionEventType;
 
 typedef struct {
@@ -140,6 +141,56 @@ BRWalletManagerConnect (BRWalletManager manager);
 extern void
 BRWalletManagerDisconnect (BRWalletManager manager);
 
+///
+/// Send
+///
+/// Called once for each BRWalletManagerSend() - on a worker or a peer manager thread - with an
+/// error of 0 once the transaction is published.  Otherwise the error is one of EINVAL (can't be
+/// signed, or not valid in the wallet), ECANCELED (no seed, or the manager was freed first) or an
+/// error from BRPeerManagerPublishTx() such as ENOTCONN or ETIMEDOUT.  The transaction, which may
+/// be NULL on an error, is only valid for the duration of the callback.
+///
+typedef void
+(*BRWalletManagerSendCallback) (BRWalletManager manager,
+                                void *context,
+                                BRTransaction *transaction,
+                                int error);
+
+///
+/// Build a transaction paying `outputs`, reserving the coins it spends, and queue it to be signed
+/// with `seed` and published; neither happens on the caller's thread.  Any number of sends may be
+/// in flight at once and none will spend another's coins.  Returns 0, with nothing queued and no
+/// callback to come, if the wallet's unreserved coins can't fund the outputs.
+///
+extern int
+BRWalletManagerSend (BRWalletManager manager,
+                     const BRTxOutput *outputs,
+                     size_t outputsCount,
+                     const void *seed,
+                     size_t seedLen,
+                     BRWalletManagerSendCallback callback,
+                     void *context);
+
+///
+/// Condense the wallet's history, see BRWalletCondenseTransactions(): the oldest transactions at
+/// least `confirmations` deep whose coins have all been spent are dropped from memory, leaving a
+/// BRWalletTxRecord of each.  Their bodies stay saved and BRWalletManagerLoadTransaction() reloads
+/// one.  Each gets a BITCOIN_TRANSACTION_CONDENSED event, not BITCOIN_TRANSACTION_DELETED as it's
+/// still the wallet's; once the event returns, its BRTransaction pointer, as handed to the client
+/// in any event, is invalid.  Returns the number condensed.
+///
+extern size_t
+BRWalletManagerCondenseTransactions (BRWalletManager manager,
+                                     uint32_t confirmations);
+
+///
+/// Return a copy of the wallet's transaction with `txHash`, reloaded from storage if it was
+/// condensed, or NULL if there is none.  The caller owns the copy and must BRTransactionFree() it.
+///
+extern BRTransaction *
+BRWalletManagerLoadTransaction (BRWalletManager manager,
+                                UInt256 txHash);
+
 //
 // These should not be needed if the events are sufficient
 //
@@ -43,11 +43,16 @@
 #include "BRInt.h"
 #include "BRArray.h"
 #include "BRSet.h"
+#include "BRConcurrentSet.h"
+#include "BRThreadPool.h"
 #include "BRTransaction.h"
 #include "BRWalletManager.h"
+#include "BRFileService.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <ftw.h>
 #include <inttypes.h>
 #include <errno.h>
 #include <time.h>
@@ -165,6 +170,28 @@ int BRArrayTests()
     array_clear(a);                 // [ ]
     if (array_count(a) != 0) r = 0, fprintf(stderr, "***FAILED*** %s: array_clear() test\n", __func__);
 
+    array_reserve(a, 100);
+    if (array_capacity(a) < 100) r = 0, fprintf(stderr, "***FAILED*** %s: array_reserve() test\n", __func__);
+
+    array_add_array(a, b, 3);       // [ 1, 2, 3 ]
+    array_shrink_to_fit(a);
+    if (array_capacity(a) != 3 || array_count(a) != 3 || a[2] != 3)
+        r = 0, fprintf(stderr, "***FAILED*** %s: array_shrink_to_fit() test\n", __func__);
+
+    array_free(a);
+
+    array_storage(int, 4) buf;
+
+    array_new_inline(a, buf);       // [ ]
+    array_add_array(a, b, 3);       // [ 1, 2, 3 ]
+    array_insert(a, 0, 0);          // [ 0, 1, 2, 3 ]
+    if ((void *)a != (void *)buf.items || array_capacity(a) != 4 || array_count(a) != 4 || a[3] != 3)
+        r = 0, fprintf(stderr, "***FAILED*** %s: array_new_inline() test\n", __func__);
+
+    array_insert(a, 1, 4);          // [ 0, 4, 1, 2, 3 ], moves to the heap
+    if ((void *)a == (void *)buf.items || array_count(a) != 5 || a[1] != 4 || a[4] != 3)
+        r = 0, fprintf(stderr, "***FAILED*** %s: array_new_inline() test 2\n", __func__);
+
     array_free(a);
     
     printf("                                    ");
@@ -188,6 +215,13 @@ inline static int eq_int(const void *a, const void *b)
     return (*(const int *)a == *(const int *)b);
 }
 
+inline static size_t hash_int_collide(const void *i)
+{
+    return (size_t)(*(const unsigned *)i % 7); // few distinct hash values, so items share long probe runs
+}
+
+BR_SET_DEFINE(IntSet, int, hash_int_collide, eq_int)
+
 int BRSetTests()
 {
     int r = 1;
@@ -219,6 +253,232 @@ int BRSetTests()
 
     if (BRSetCount(s) != 0) r = 0, fprintf(stderr, "***FAILED*** %s: BRSetCount() test 2\n", __func__);
     
+    BRSetFree(s);
+    s = BRSetNew(hash_int_collide, eq_int, 0);
+    
+    for (i = 0; i < 1000; i++) BRSetAdd(s, &x[i]);
+    
+    for (i = 0; i < 1000; i += 3) {
+        if (*(int *)BRSetRemove(s, &i) != i)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRSetRemove() colliding test %d\n", __func__, i);
+    }
+    
+    for (i = 0; i < 1000; i++) {
+        if (BRSetContains(s, &i) != (i % 3 != 0))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRSetContains() colliding test %d\n", __func__, i);
+    }
+    
+    i = 0;
+    for (int *t = BRSetIterate(s, NULL); t; t = BRSetIterate(s, t)) i++;
+    if (i != BRSetCount(s) || i != 666) r = 0, fprintf(stderr, "***FAILED*** %s: BRSetIterate() test\n", __func__);
+    
+    BRSetClear(s);
+    
+    for (i = 0; i < 1000; i++) { // type specialized functions on the same set, mixed with the generic ones
+        if (IntSetAdd(s, &x[i]) != NULL) r = 0, fprintf(stderr, "***FAILED*** %s: IntSetAdd() test %d\n", __func__, i);
+    }
+    
+    for (i = 0; i < 1000; i += 3) {
+        if (IntSetRemove(s, &i) != &x[i])
+            r = 0, fprintf(stderr, "***FAILED*** %s: IntSetRemove() test %d\n", __func__, i);
+    }
+    
+    for (i = 0; i < 1000; i++) {
+        if (IntSetContains(s, &i) != (i % 3 != 0) || (BRSetGet(s, &i) == IntSetGet(s, &i)) != 1)
+            r = 0, fprintf(stderr, "***FAILED*** %s: IntSetContains() test %d\n", __func__, i);
+    }
+    
+    if (BRSetCount(s) != 666) r = 0, fprintf(stderr, "***FAILED*** %s: BRSetCount() test 3\n", __func__);
+    
+    BRSetFree(s);
+    return r;
+}
+
+static void *_BRConcurrentSetTestsReader(void *set)
+{
+    int i, done = -1, found = 0;
+
+    while (! BRConcurrentSetContains(set, &done)) { // eq() reads items that writers are removing and freeing
+        for (i = 0; i < 1000; i++) found += BRConcurrentSetContains(set, &i);
+    }
+
+    return (found >= 0) ? NULL : set;
+}
+
+static void *_BRConcurrentSetTestsNext(void *item)
+{
+    return (int *)item + 1;
+}
+
+static void _BRConcurrentSetTestsCount(void *info, void *item)
+{
+    (*(int *)info)++;
+}
+
+int BRConcurrentSetTests()
+{
+    int r = 1;
+    int i, n, *t;
+    BRConcurrentSet *s = BRConcurrentSetNew(hash_int, eq_int, 0);
+    pthread_t threads[4];
+    void *bad;
+
+    for (i = 0; i < 4; i++) pthread_create(&threads[i], NULL, _BRConcurrentSetTestsReader, s);
+
+    for (n = 0; n < 10; n++) { // repeatedly grow the set and remove items while readers are looking them up
+        for (i = 0; i < 1000; i++) {
+            t = malloc(sizeof(*t));
+            *t = i;
+            if (BRConcurrentSetAdd(s, t) != NULL)
+                r = 0, fprintf(stderr, "***FAILED*** %s: Add() test %d\n", __func__, i);
+        }
+
+        if (BRConcurrentSetCount(s) != 1000) r = 0, fprintf(stderr, "***FAILED*** %s: Count() test 1\n", __func__);
+
+        for (i = 0; i < 1000; i++) { // replaced items are freed once readers are done with them, the same as removed
+            t = malloc(sizeof(*t));
+            *t = i;
+            if (! BRConcurrentSetAddAndFree(s, t, free) || BRConcurrentSetGet(s, &i) != t)
+                r = 0, fprintf(stderr, "***FAILED*** %s: AddAndFree() test %d\n", __func__, i);
+        }
+
+        if (BRConcurrentSetCount(s) != 1000) r = 0, fprintf(stderr, "***FAILED*** %s: Count() test 3\n", __func__);
+
+        for (i = 0; i < 1000; i++) {
+            if (! BRConcurrentSetRemoveAndFree(s, &i, free))
+                r = 0, fprintf(stderr, "***FAILED*** %s: RemoveAndFree() test %d\n", __func__, i);
+        }
+
+        if (BRConcurrentSetCount(s) != 0) r = 0, fprintf(stderr, "***FAILED*** %s: Count() test 2\n", __func__);
+    }
+
+    n = -1;
+    BRConcurrentSetAdd(s, &n); // tell readers to stop
+
+    for (i = 0; i < 4; i++) {
+        pthread_join(threads[i], &bad);
+        if (bad) r = 0, fprintf(stderr, "***FAILED*** %s: Contains() concurrent test\n", __func__);
+    }
+
+    BRConcurrentSetRemove(s, &n);
+
+    for (i = 0; i < 1000; i++) {
+        t = malloc(sizeof(*t));
+        *t = i;
+        BRConcurrentSetAdd(s, t);
+    }
+
+    for (i = 0; i < 1000; i += 3) { // RemoveAndFree() removed every item from the previous rounds
+        t = BRConcurrentSetRemove(s, &i);
+        if (! t || *t != i) r = 0, fprintf(stderr, "***FAILED*** %s: Remove() test %d\n", __func__, i);
+        free(t);
+    }
+
+    for (i = 0; i < 1000; i++) {
+        if (BRConcurrentSetContains(s, &i) != (i % 3 != 0))
+            r = 0, fprintf(stderr, "***FAILED*** %s: Contains() test %d\n", __func__, i);
+    }
+
+    t = BRConcurrentSetGet(s, &(int) { 1 });
+    if (! t || BRConcurrentSetGetWith(s, &(int) { 1 }, _BRConcurrentSetTestsNext) != t + 1 ||
+        BRConcurrentSetGetWith(s, &(int) { 0 }, _BRConcurrentSetTestsNext) != NULL)
+        r = 0, fprintf(stderr, "***FAILED*** %s: GetWith() test\n", __func__);
+
+    n = 0;
+    BRConcurrentSetApply(s, &n, _BRConcurrentSetTestsCount);
+    if (n != BRConcurrentSetCount(s) || n != 666) r = 0, fprintf(stderr, "***FAILED*** %s: Apply() test\n", __func__);
+    for (i = 0; i < 1000; i++) BRConcurrentSetRemoveAndFree(s, &i, free);
+    BRConcurrentSetFree(s);
+    return r;
+}
+
+typedef struct {
+    BRThreadPool *pool;
+    BRTaskGroup *group;
+    pthread_mutex_t lock;
+    int count;
+} _BRThreadPoolTestsInfo;
+
+static void _BRThreadPoolTestsIncrement(void *info)
+{
+    _BRThreadPoolTestsInfo *t = info;
+
+    pthread_mutex_lock(&t->lock);
+    t->count++;
+    pthread_mutex_unlock(&t->lock);
+}
+
+static void _BRThreadPoolTestsSpawn(void *info) // adds more tasks to the group the task is running in
+{
+    _BRThreadPoolTestsInfo *t = info;
+
+    for (int i = 0; i < 10; i++) BRTaskGroupAdd(t->group, t, _BRThreadPoolTestsIncrement);
+}
+
+static void _BRThreadPoolTestsNested(void *info) // waits on a group of its own from within a task
+{
+    _BRThreadPoolTestsInfo *t = info;
+    BRTaskGroup *group = BRTaskGroupNew(t->pool);
+
+    for (int i = 0; i < 10; i++) BRTaskGroupAdd(group, t, _BRThreadPoolTestsIncrement);
+    BRTaskGroupFree(group);
+}
+
+static void _BRThreadPoolTestsCancel(void *info)
+{
+    BRTaskGroupCancel(((_BRThreadPoolTestsInfo *)info)->group);
+}
+
+int BRThreadPoolTests()
+{
+    int r = 1, cpus[] = { 0 };
+    size_t i, threadCounts[] = { 4, 1 };
+    _BRThreadPoolTestsInfo t;
+
+    pthread_mutex_init(&t.lock, NULL);
+
+    for (size_t n = 0; n < 2; n++) { // a single worker must not deadlock on tasks that wait on nested groups
+        t.pool = BRThreadPoolNew(threadCounts[n], NULL, 0);
+        t.group = BRTaskGroupNew(t.pool);
+        t.count = 0;
+
+        if (BRThreadPoolThreadCount(t.pool) != threadCounts[n])
+            r = 0, fprintf(stderr, "***FAILED*** %s: ThreadCount() test %zu\n", __func__, n);
+
+        for (i = 0; i < 1000; i++) {
+            BRTaskGroupAdd(t.group, &t, (i % 10 == 0) ? _BRThreadPoolTestsSpawn :
+                           (i % 10 == 1) ? _BRThreadPoolTestsNested : _BRThreadPoolTestsIncrement);
+        }
+
+        if (! BRTaskGroupWait(t.group) || t.count != 800 + 100*10 + 100*10)
+            r = 0, fprintf(stderr, "***FAILED*** %s: Wait() test %zu\n", __func__, n);
+
+        BRTaskGroupFree(t.group);
+        BRThreadPoolFree(t.pool);
+    }
+
+    // tasks queued behind a task that cancels their group are skipped
+    t.pool = BRThreadPoolNew(1, cpus, 1);
+    t.group = BRTaskGroupNew(t.pool);
+    t.count = 0;
+    BRTaskGroupAdd(t.group, &t, _BRThreadPoolTestsCancel);
+    for (i = 0; i < 1000; i++) BRTaskGroupAdd(t.group, &t, _BRThreadPoolTestsIncrement);
+    if (BRTaskGroupWait(t.group) || t.count >= 1000)
+        r = 0, fprintf(stderr, "***FAILED*** %s: Cancel() test 1\n", __func__);
+    if (! BRTaskGroupIsCancelled(t.group)) r = 0, fprintf(stderr, "***FAILED*** %s: Cancel() test 2\n", __func__);
+    if (BRTaskGroupAdd(t.group, &t, _BRThreadPoolTestsIncrement))
+        r = 0, fprintf(stderr, "***FAILED*** %s: Cancel() test 3\n", __func__);
+    BRTaskGroupFree(t.group);
+    BRThreadPoolFree(t.pool);
+
+    // the shared pool runs tasks added from any thread
+    t.pool = BRThreadPoolShared();
+    t.group = BRTaskGroupNew(t.pool);
+    t.count = 0;
+    for (i = 0; i < 100; i++) BRTaskGroupAdd(t.group, &t, _BRThreadPoolTestsIncrement);
+    BRTaskGroupFree(t.group);
+    if (t.count != 100) r = 0, fprintf(stderr, "***FAILED*** %s: Shared() test\n", __func__);
+    pthread_mutex_destroy(&t.lock);
     return r;
 }
 
@@ -323,6 +583,13 @@ int BRBase58Tests()
     if (l5 != 21 || memcmp(s, b5, l5) != 0)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRBase58CheckDecode() test 5\n", __func__);
 
+    const uint8_t d6[] = "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01"
+                         "\x05\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF";
+    char s6[2][36];
+    
+    if (BRBase58CheckEncodeBatch(s6[0], sizeof(*s6), d6, 21, 2) != 2 || strcmp(s6[0], s4) != 0 ||
+        strcmp(s6[1], s5) != 0) r = 0, fprintf(stderr, "***FAILED*** %s: BRBase58CheckEncodeBatch() test\n", __func__);
+
     return r;
 }
 
@@ -356,6 +623,22 @@ int BRBech32Tests()
     if (l == 0 || strcmp(addr, "bc1zw508d6qejxtdg4y5r3zarvaryvg6kdaj"))
         r = 0, fprintf(stderr, "\n***FAILED*** %s: BRBech32Encode() test 3", __func__);
 
+    uint8_t d[2*42];
+    char a[2*91];
+    const char *as[] = { &a[0], &a[91], "bc1qw508d6qejxtdg4y5r3zarvary0c5xw7kv8f3t5" };
+    size_t ls[3];
+    
+    memcpy(&d[0], "\x00\x14\x75\x1e\x76\xe8\x19\x91\x96\xd4\x54\x94\x1c\x45\xd1\xb3\xa3\x23\xf1\x43\x3b\xd6", 22);
+    memcpy(&d[42], b, 18);
+    if (BRBech32EncodeBatch(a, "bc", d, 2) != 2 || strcmp(&a[0], "bc1qw508d6qejxtdg4y5r3zarvary0c5xw7kv8f3t4") ||
+        strcmp(&a[91], "bc1zw508d6qejxtdg4y5r3zarvaryvg6kdaj"))
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRBech32EncodeBatch() test", __func__);
+
+    memset(d, 0, sizeof(d));
+    if (BRBech32DecodeBatch(d, ls, "bc", as, 3) != 2 || ls[0] != 22 || ls[1] != 18 || ls[2] != 0 ||
+        memcmp(&d[42], b, 18) || BRBech32DecodeBatch(NULL, NULL, "tb", as, 3) != 0)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRBech32DecodeBatch() test", __func__);
+
     if (! r) fprintf(stderr, "\n                                    ");
     return r;
 }
@@ -455,6 +738,26 @@ int BRHashTests()
                     "\x14\x7c\x4e\x72\xb9\x80\x77\x85\xaf\xee\x48\xbb", *(UInt256 *)md))
         r = 0, fprintf(stderr, "\n***FAILED*** %s: BRSHA256() test 6", __func__);
 
+    if (! BRSHA256SelfTest())
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRSHA256SelfTest() %s backend", __func__, BRSHA256Backend());
+
+    // batch sha256_2 over messages of differing lengths must match hashing each one alone
+    s = "this is some text to test the sha256 implementation with more than 64bytes of data since it's internal "
+        "digest buffer is 64bytes in size";
+
+    UInt256 mds[11], md2;
+    void *mdPtrs[11];
+    const void *datas[11];
+    size_t lens[11];
+
+    for (size_t i = 0; i < 11; i++) mdPtrs[i] = &mds[i], datas[i] = &s[i], lens[i] = i*12;
+    BRSHA256_2Batch(mdPtrs, datas, lens, 11);
+
+    for (size_t i = 0; i < 11; i++) {
+        BRSHA256_2(&md2, datas[i], lens[i]);
+        if (! UInt256Eq(md2, mds[i])) r = 0, fprintf(stderr, "\n***FAILED*** %s: BRSHA256_2Batch() test %zu", __func__, i);
+    }
+
     // test sha512
     
     s = "Free online SHA512 Calculator, type text here...";
@@ -537,6 +840,26 @@ int BRHashTests()
     if (! UInt160Eq(*(UInt160 *)"\x0b\xdc\x9d\x2d\x25\x6b\x3e\xe9\xda\xae\x34\x7b\xe6\xf4\xdc\x83\x5a\x46\x7f\xfe",
                     *(UInt160 *)md)) r = 0, fprintf(stderr, "\n***FAILED*** %s: BRRMD160() test 6", __func__);
 
+    // batch hash160 over every count up to 13, so full, partial and one-at-a-time groups of lanes are all covered
+    s = "this is some text to test the hash160 batch implementation with messages longer than a sha256 block";
+
+    UInt160 h160s[13], h160;
+    void *h160Ptrs[13];
+    const void *h160Datas[13];
+    size_t h160Lens[13];
+
+    for (size_t i = 0; i < 13; i++) h160Ptrs[i] = &h160s[i], h160Datas[i] = &s[i], h160Lens[i] = 20 + i*5;
+
+    for (size_t n = 1; n <= 13; n++) {
+        BRHash160Batch(h160Ptrs, h160Datas, h160Lens, n);
+
+        for (size_t i = 0; i < n; i++) {
+            BRHash160(&h160, h160Datas[i], h160Lens[i]);
+            if (! UInt160Eq(h160, h160s[i]))
+                r = 0, fprintf(stderr, "\n***FAILED*** %s: BRHash160Batch() test %zu, %zu", __func__, n, i);
+        }
+    }
+
     // test md5
     
     s = "Free online MD5 Calculator, type text here...";
@@ -600,6 +923,43 @@ int BRHashTests()
                     "\x82\x27\x3b\x7b\xfa\xd8\x04\x5d\x85\xa4\x70", *(UInt256 *)md))
         r = 0, fprintf(stderr, "***FAILED*** %s: Keccak-256() test 1\n", __func__);
 
+    // batch keccak-256 over messages spanning one to three 136 byte blocks must match hashing each one alone
+    uint8_t buf[420];
+
+    for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (uint8_t)(i*7);
+    for (size_t i = 0; i < 11; i++) mdPtrs[i] = &mds[i], datas[i] = &buf[i], lens[i] = i*34 + (i & 1);
+    BRKeccak256Batch(mdPtrs, datas, lens, 11);
+
+    for (size_t i = 0; i < 11; i++) {
+        BRKeccak256(&md2, datas[i], lens[i]);
+        if (! UInt256Eq(md2, mds[i]))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRKeccak256Batch() test %zu\n", __func__, i);
+    }
+
+    // incremental hashing in uneven chunks must match hashing the whole message at once
+    BRSHA256Context sha256;
+    BRSHA512Context sha512;
+    BRRMD160Context rmd160;
+    BRKeccak256Context keccak;
+    uint8_t md3[64];
+
+    BRSHA256Init(&sha256), BRSHA512Init(&sha512), BRRMD160Init(&rmd160), BRKeccak256Init(&keccak);
+
+    for (size_t i = 0, n = 0; i < sizeof(buf); i += n, n = (n*3 + 1) % 150) {
+        if (n > sizeof(buf) - i) n = sizeof(buf) - i;
+        BRSHA256Update(&sha256, &buf[i], n), BRSHA512Update(&sha512, &buf[i], n);
+        BRRMD160Update(&rmd160, &buf[i], n), BRKeccak256Update(&keccak, &buf[i], n);
+    }
+
+    BRSHA256Final(&sha256, md3), BRSHA256(md, buf, sizeof(buf));
+    if (memcmp(md, md3, 32) != 0) r = 0, fprintf(stderr, "***FAILED*** %s: BRSHA256Update() test\n", __func__);
+    BRSHA512Final(&sha512, md3), BRSHA512(md, buf, sizeof(buf));
+    if (memcmp(md, md3, 64) != 0) r = 0, fprintf(stderr, "***FAILED*** %s: BRSHA512Update() test\n", __func__);
+    BRRMD160Final(&rmd160, md3), BRRMD160(md, buf, sizeof(buf));
+    if (memcmp(md, md3, 20) != 0) r = 0, fprintf(stderr, "***FAILED*** %s: BRRMD160Update() test\n", __func__);
+    BRKeccak256Final(&keccak, md3), BRKeccak256(md, buf, sizeof(buf));
+    if (memcmp(md, md3, 32) != 0) r = 0, fprintf(stderr, "***FAILED*** %s: BRKeccak256Update() test\n", __func__);
+
     // test murmurHash3-x86_32
     
     if (BRMurmur3_32("", 0, 0) != 0)
@@ -614,6 +974,20 @@ int BRHashTests()
     if (BRMurmur3_32("\x00", 1, 0) != 0x514e28b7)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRMurmur3_32() test 4\n", __func__);
     
+    uint32_t seeds[11], hashes[11];
+    
+    for (uint32_t i = 0; i < 11; i++) seeds[i] = i*0xfba4c795 + 0x5082edee;
+    
+    for (size_t len = 0; len <= 7; len++) {
+        BRMurmur3_32Seeds(hashes, seeds, 11, "\x21\x43\x65\x87\x99\x10\x8a", len);
+        
+        for (size_t i = 0; i < 11; i++) {
+            if (hashes[i] == BRMurmur3_32("\x21\x43\x65\x87\x99\x10\x8a", len, seeds[i])) continue;
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRMurmur3_32Seeds() test %zu\n", __func__, len + 1);
+            break;
+        }
+    }
+    
     // test sipHash-64
 
     const char k[] = "\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f";
@@ -1016,6 +1390,26 @@ int BRChachaTests()
     if (memcmp(msg3, out3, sizeof(out3)) != 0)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRChacha20() de-cipher test 3\n", __func__);
 
+    uint8_t rand1[1000], rand2[1000], zero[1000] = { 0 };
+    uint32_t u, counts[3] = { 0, 0, 0 };
+
+    BRRandBytes(rand1, sizeof(rand1));
+    BRRandBytes(rand2, sizeof(rand2));
+    if (memcmp(rand1, zero, sizeof(rand1)) == 0 || memcmp(rand1, rand2, sizeof(rand1)) == 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRRandBytes() test\n", __func__);
+    
+    for (int i = 0; i < 3000; i++) {
+        u = BRRandUniform(3);
+        if (u < 3) counts[u]++;
+        else r = 0, fprintf(stderr, "***FAILED*** %s: BRRandUniform() range test\n", __func__);
+    }
+    
+    if (counts[0] < 800 || counts[1] < 800 || counts[2] < 800)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRRandUniform() distribution test\n", __func__);
+    
+    if (BRRandUniform(1) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRRandUniform() bound test\n", __func__);
+
     return r;
 }
 
@@ -1074,6 +1468,33 @@ int BRAuthEncryptTests()
     if (len != sizeof(cipher2) - 1 || memcmp(cipher2, out2, len) != 0)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRChacha20Poly1305AEADEncrypt() cipher test 2\n", __func__);
 
+    BRChacha20Poly1305Context ctx;
+    uint8_t mac[16];
+    size_t i, chunk;
+
+    BRChacha20Poly1305AEADInit(&ctx, key2, nonce2, ad2, sizeof(ad2) - 1);
+
+    for (i = 0, chunk = 1; i < sizeof(msg2) - 1; i += chunk, chunk = chunk*2 + 1) { // uneven chunks
+        if (chunk > sizeof(msg2) - 1 - i) chunk = sizeof(msg2) - 1 - i;
+        BRChacha20Poly1305AEADEncryptUpdate(&ctx, &out2[i], &msg2[i], chunk);
+    }
+
+    BRChacha20Poly1305AEADEncryptFinal(&ctx, mac);
+    if (memcmp(cipher2, out2, sizeof(msg2) - 1) != 0 || memcmp(&cipher2[sizeof(msg2) - 1], mac, sizeof(mac)) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRChacha20Poly1305AEADEncryptUpdate() cipher test 2\n", __func__);
+
+    BRChacha20Poly1305AEADInit(&ctx, key2, nonce2, ad2, sizeof(ad2) - 1);
+    BRChacha20Poly1305AEADDecryptUpdate(&ctx, out2, cipher2, 100);
+    BRChacha20Poly1305AEADDecryptUpdate(&ctx, &out2[100], &cipher2[100], sizeof(msg2) - 1 - 100);
+    if (! BRChacha20Poly1305AEADDecryptFinal(&ctx, &cipher2[sizeof(msg2) - 1]) || memcmp(msg2, out2, sizeof(msg2) - 1))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRChacha20Poly1305AEADDecryptUpdate() cipher test 2\n", __func__);
+
+    mac[0] ^= 1;
+    BRChacha20Poly1305AEADInit(&ctx, key2, nonce2, ad2, sizeof(ad2) - 1);
+    BRChacha20Poly1305AEADDecryptUpdate(&ctx, out2, cipher2, sizeof(msg2) - 1);
+    if (BRChacha20Poly1305AEADDecryptFinal(&ctx, mac))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRChacha20Poly1305AEADDecryptFinal() forged mac test\n", __func__);
+
     return r;
 }
 
@@ -1136,6 +1557,45 @@ int BRAesTests()
 
     BRAESCTR(buf, &key3, 32, iv, in3, 64);
     if (memcmp(buf, plain, 64) != 0) r = 0, fprintf(stderr, "\n***FAILED*** %s: BRAESCTR() test 3", __func__);
+
+    uint8_t k[256], iv2[16];
+
+    BRAESKeySchedule(k, &key3, 32);
+    memcpy(buf, plain, 16);
+    BRAESECBEncryptSchedule(buf, k, 32);
+    if (memcmp(buf, cipher3, 16) != 0)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRAESECBEncryptSchedule() test 3", __func__);
+
+    memcpy(iv2, iv, 16);
+    BRAESCTRSchedule(buf, k, 32, iv2, in3, 48); // continue the stream across calls
+    BRAESCTRSchedule(&buf[48], k, 32, iv2, &in3[48], 16);
+    if (memcmp(buf, plain, 64) != 0) r = 0, fprintf(stderr, "\n***FAILED*** %s: BRAESCTRSchedule() test 3", __func__);
+
+    if (! BRAESSelfTest())
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRAESSelfTest() %s backend", __func__, BRAESBackend());
+    
+    if (! r) fprintf(stderr, "\n                                    ");
+    return r;
+}
+
+int BRScryptTests()
+{
+    // test vectors from https://tools.ietf.org/html/rfc7914
+    int r = 1;
+    size_t scratchLen = 128*8*1024*2; // enough for two of the four requested threads
+    uint8_t dk[64], *scratch = malloc(scratchLen);
+    const char dk1[] = "\xfd\xba\xbe\x1c\x9d\x34\x72\x00\x78\x56\xe7\x19\x0d\x01\xe9\xfe\x7c\x6a\xd7\xcb\xc8\x23"
+    "\x78\x30\xe7\x73\x76\x63\x4b\x37\x31\x62\x2e\xaf\x30\xd9\x2e\x22\xa3\x88\x6f\xf1\x09\x27\x9d\x98\x30\xda"
+    "\xc7\x27\xaf\xb9\x4a\x83\xee\x6d\x83\x60\xcb\xdf\xa2\xcc\x06\x40";
+    
+    BRScrypt(dk, sizeof(dk), "password", 8, "NaCl", 4, 1024, 8, 16);
+    if (memcmp(dk, dk1, sizeof(dk)) != 0) r = 0, fprintf(stderr, "\n***FAILED*** %s: BRScrypt() test 1", __func__);
+
+    memset(dk, 0, sizeof(dk));
+    BRScryptParallel(dk, sizeof(dk), "password", 8, "NaCl", 4, 1024, 8, 16, 4, scratch, scratchLen);
+    if (memcmp(dk, dk1, sizeof(dk)) != 0)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRScryptParallel() test 1", __func__);
+    free(scratch);
     
     if (! r) fprintf(stderr, "\n                                    ");
     return r;
@@ -1331,6 +1791,63 @@ int BRKeyTests()
     if (! BRKeyVerify(&key, md, sig, sigLen))
         r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyVerify() test 7\n", __func__);
 
+    // batch verification across worker threads, with every fourth signature made for a different message
+    BRKey batchKeys[40];
+    UInt256 batchMds[40];
+    uint8_t batchSigs[40][72];
+    const void *batchSigPtrs[40];
+    size_t batchSigLens[40];
+    int batchResults[40];
+
+    for (size_t i = 0; i < 40; i++) {
+        UInt256 secret = UINT256_ZERO;
+
+        secret.u8[31] = (uint8_t)(i + 1);
+        BRKeySetSecret(&batchKeys[i], &secret, 1);
+        BRSHA256(&batchMds[i], &i, sizeof(i));
+        batchSigLens[i] = BRKeySign(&batchKeys[i], batchSigs[i], sizeof(batchSigs[i]), (i % 4 == 3) ? md : batchMds[i]);
+        batchSigPtrs[i] = batchSigs[i];
+    }
+
+    if (BRKeyVerifyBatch(batchResults, batchKeys, batchMds, batchSigPtrs, batchSigLens, 40, 2) != 30)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyVerifyBatch() test 1\n", __func__);
+
+    for (size_t i = 0; i < 40; i++) {
+        if (batchResults[i] != (i % 4 != 3))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyVerifyBatch() test %zu\n", __func__, i + 2);
+    }
+
+    // batch pubkey creation, and switching a key between compressed and uncompressed pubkeys, must match computing
+    // each pubkey alone
+    BRKey batchKey;
+    UInt256 batchSecret;
+    uint8_t batchPubKey[65], batchPubKey2[65];
+
+    for (size_t i = 0; i < 40; i++) {
+        batchSecret = batchKeys[i].secret;
+        BRKeySetSecret(&batchKeys[i], &batchSecret, (i % 2));
+    }
+
+    if (BRKeyPubKeyBatch(batchResults, batchKeys, 40, 2) != 40)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyPubKeyBatch() test 1\n", __func__);
+
+    for (size_t i = 0; i < 40; i++) {
+        BRKeySetSecret(&batchKey, &batchKeys[i].secret, (i % 2));
+        pkLen = BRKeyPubKey(&batchKey, batchPubKey, sizeof(batchPubKey));
+
+        if (! batchResults[i] || BRKeyPubKey(&batchKeys[i], batchPubKey2, sizeof(batchPubKey2)) != pkLen ||
+            memcmp(batchPubKey, batchPubKey2, pkLen) != 0)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyPubKeyBatch() test %zu\n", __func__, i + 2);
+
+        BRKeySetSecret(&batchKey, &batchKeys[i].secret, ! (i % 2));
+        pkLen = BRKeyPubKey(&batchKey, batchPubKey, sizeof(batchPubKey));
+        batchKeys[i].compressed = ! (i % 2);
+
+        if (BRKeyPubKey(&batchKeys[i], batchPubKey2, sizeof(batchPubKey2)) != pkLen ||
+            memcmp(batchPubKey, batchPubKey2, pkLen) != 0)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyPubKey() compression switch test %zu\n", __func__, i + 1);
+    }
+
     // compact signing
     BRKeySetSecret(&key, &uint256("0000000000000000000000000000000000000000000000000000000000000001"), 1);
     msg = "foo";
@@ -1397,6 +1914,37 @@ int BRKeyTests()
     if (pkLen5 != pkLen || memcmp(pubKey, pubKey5, pkLen) != 0)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRPubKeyRecover() test 3\n", __func__);
 
+    // batch pubkey recovery across worker threads, alternating bitcoin and ethereum compact signatures
+    uint8_t batchCompactSigs[40][65];
+    int batchEthereum[40];
+
+    for (size_t i = 0; i < 40; i++) {
+        UInt256 secret = UINT256_ZERO;
+
+        secret.u8[31] = (uint8_t)(i + 1);
+        batchEthereum[i] = (i % 2 == 1);
+        BRKeySetSecret(&batchKeys[i], &secret, ! batchEthereum[i]); // ethereum pubkeys are always uncompressed
+        if (batchEthereum[i]) BRKeyCompactSignEthereum(&batchKeys[i], batchCompactSigs[i], 65, batchMds[i]);
+        else BRKeyCompactSign(&batchKeys[i], batchCompactSigs[i], 65, batchMds[i]);
+        batchSigPtrs[i] = batchCompactSigs[i];
+    }
+
+    BRKey batchRecovered[40];
+
+    if (BRKeyRecoverPubKeyBatch(batchResults, batchRecovered, batchMds, batchSigPtrs, batchEthereum, 40, 2) != 40)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyRecoverPubKeyBatch() test 1\n", __func__);
+
+    for (size_t i = 0; i < 40; i++) {
+        uint8_t pk1[65], pk2[65];
+        size_t pk1Len, pk2Len;
+
+        pk1Len = BRKeyPubKey(&batchKeys[i], pk1, sizeof(pk1));
+        pk2Len = BRKeyPubKey(&batchRecovered[i], pk2, sizeof(pk2));
+
+        if (! batchResults[i] || pk1Len != pk2Len || memcmp(pk1, pk2, pk1Len) != 0)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyRecoverPubKeyBatch() test %zu\n", __func__, i + 2);
+    }
+
     printf("                                    ");
     return r;
 }
@@ -1539,6 +2087,54 @@ int BRKeyECIESTests()
     if (len != 1 || strncmp(dec2, "a", 1) != 0)
         r = 0, fprintf(stderr, "\n***FAILED*** %s: BRKeyECIESAES128SHA256Decrypt() test2", __func__);
     
+    BRKeyECIESContext ctx;
+    char cipher3[sizeof(cipher)];
+    size_t cipherLen;
+    
+    memset(&ctx, 0, sizeof(ctx));
+    BRKeySetSecret(&key, &uint256("0000000000000000000000000000000000000000000000000000000000000001"), 0);
+    len = BRKeyECIESAES128SHA256EncryptContext(&ctx, &key, cipher3, sizeof(cipher3), &ephem, plain, sizeof(plain) - 1);
+    cipherLen = len;
+    if (len != sizeof(plain) - 1 + 65 + 16 + 32 || memcmp(cipher3, cipher, len) != 0)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRKeyECIESAES128SHA256EncryptContext() test 1", __func__);
+
+    len = BRKeyECIESAES128SHA256EncryptContext(&ctx, &key, cipher3, sizeof(cipher3), &ephem, plain, 10);
+    if (len != 10 + 65 + 16 + 32) // second message reuses the cached keys
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRKeyECIESAES128SHA256EncryptContext() test 2", __func__);
+
+    BRKeyECIESContextClean(&ctx);
+    len = BRKeyECIESAES128SHA256DecryptContext(&ctx, &key, dec, sizeof(dec), cipher, cipherLen);
+    if (len != sizeof(plain) - 1 || strncmp(dec, plain, len) != 0)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRKeyECIESAES128SHA256DecryptContext() test 1", __func__);
+
+    len = BRKeyECIESAES128SHA256DecryptContext(&ctx, &key, dec, sizeof(dec), cipher3, 10 + 65 + 16 + 32);
+    if (len != 10 || strncmp(dec, plain, len) != 0)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRKeyECIESAES128SHA256DecryptContext() test 2", __func__);
+
+    cipher3[65] ^= 1; // tampered iv must fail the cached mac key
+    len = BRKeyECIESAES128SHA256DecryptContext(&ctx, &key, dec, sizeof(dec), cipher3, 10 + 65 + 16 + 32);
+    if (len != 0) r = 0, fprintf(stderr, "\n***FAILED*** %s: BRKeyECIESAES128SHA256DecryptContext() test 3", __func__);
+    BRKeyECIESContextClean(&ctx);
+
+    BRKeyPigeonContext pctx;
+    uint8_t nonces[2*12] = { 1 }, pc0[sizeof(plain) - 1 + 16], pc1[10 + 16], pd0[sizeof(plain) - 1], pd1[10];
+    void *pcs[] = { pc0, pc1 }, *pds[] = { pd0, pd1 };
+    const void *pps[] = { plain, plain }, *pcds[] = { pc0, pc1 };
+    size_t plens[] = { sizeof(plain) - 1, 10 }, clens[] = { sizeof(pc0), sizeof(pc1) };
+
+    BRKeyPigeonContextSet(&pctx, &key, &ephem);
+    if (BRKeyPigeonContextEncryptBatch(&pctx, pcs, nonces, pps, plens, 2) != 2)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRKeyPigeonContextEncryptBatch() test", __func__);
+
+    len = BRKeyPigeonDecrypt(&ephem, pd0, sizeof(pd0), &key, nonces, pc0, sizeof(pc0));
+    if (len != sizeof(pd0) || memcmp(pd0, plain, len) != 0)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRKeyPigeonDecrypt() test", __func__);
+
+    pc1[0] ^= 1; // tampered second message stops the batch after the first
+    if (BRKeyPigeonContextDecryptBatch(&pctx, pds, nonces, pcds, clens, 2) != 1 || memcmp(pd0, plain, sizeof(pd0)) != 0)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRKeyPigeonContextDecryptBatch() test", __func__);
+    BRKeyPigeonContextClean(&pctx);
+    
     if (! r) fprintf(stderr, "\n                                    ");
     return r;
 }
@@ -1574,6 +2170,28 @@ int BRAddressTests()
     if (script3Len != sizeof(script2) || memcmp(script2, script3, sizeof(script2)))
         r = 0, fprintf(stderr, "\n***FAILED*** %s: BRAddressScriptPubKey() test", __func__);
 
+    const uint8_t *h = NULL;
+    BRAddress legacyAddr;
+    uint8_t script4[34] = { OP_0, 32 };
+
+    BRKeyLegacyAddr(&k, legacyAddr.s, sizeof(legacyAddr));
+    uint8_t script5[BRAddressScriptPubKey(NULL, 0, legacyAddr.s)];
+    size_t script5Len = BRAddressScriptPubKey(script5, sizeof(script5), legacyAddr.s);
+
+    if (BRScriptTemplate(script5, script5Len, &h) != SCRIPT_TEMPLATE_P2PKH || h != &script5[3])
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRScriptTemplate() test 1", __func__);
+
+    if (BRScriptTemplate((uint8_t *)script2, sizeof(script2), &h) != SCRIPT_TEMPLATE_P2WPKH ||
+        h != (uint8_t *)&script2[2] || BRScriptPKH((uint8_t *)script2, sizeof(script2)) != h)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRScriptTemplate() test 2", __func__);
+
+    if (BRScriptTemplate(script4, sizeof(script4), &h) != SCRIPT_TEMPLATE_P2WSH || h != &script4[2] ||
+        BRScriptPKH(script4, sizeof(script4)) != NULL)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRScriptTemplate() test 3", __func__);
+
+    if (BRScriptTemplate(script4, sizeof(script4) - 1, &h) != SCRIPT_TEMPLATE_NONE || h != NULL)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRScriptTemplate() test 4", __func__);
+
     if (! r) fprintf(stderr, "\n                                    ");
     return r;
 }
@@ -1588,6 +2206,17 @@ int BRBIP39MnemonicTests()
     if (BRBIP39PhraseIsValid(BRBIP39WordsEn, s))
         r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP39PhraseIsValid() test\n", __func__);
 
+    uint16_t index[BIP39_WORDINDEX_COUNT];
+    
+    BRBIP39WordIndex(index, BRBIP39WordsEn);
+    if (memcmp(index, BRBIP39WordsEnIndex, sizeof(index)) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP39WordIndex() test\n", __func__);
+    
+    if (BRBIP39PhraseIsValidIndexed(BRBIP39WordsEn, BRBIP39WordsEnIndex, s) ||
+        ! BRBIP39PhraseIsValidIndexed(BRBIP39WordsEn, BRBIP39WordsEnIndex,
+                                      "zoo zoo zoo zoo zoo zoo zoo zoo zoo zoo zoo wrong"))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP39PhraseIsValidIndexed() test\n", __func__);
+
     UInt512 key = UINT512_ZERO;
 
 //    BRBIP39DeriveKey(key.u8, NULL, NULL); // test invalid key
@@ -1721,6 +2350,19 @@ int BRBIP39MnemonicTests()
                     "\xf4\x76\xc4\x5c\x88\x25\x32\x76\xd9\xfd\x0d\xf6\xef\x48\x60\x9e\x8b\xb7\xdc\xa8"))
         r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP39DeriveKey() test 8\n", __func__);
 
+    const char *phrases[] = { phrase, phrase2, phrase3, phrase4, phrase5, phrase8 },
+               *passphrases[] = { "TREZOR", "TREZOR", "TREZOR", "TREZOR", NULL, "TREZOR" };
+    UInt512 keys[6];
+    void *keyPtrs[] = { &keys[0], &keys[1], &keys[2], &keys[3], &keys[4], &keys[5] };
+
+    BRBIP39DeriveKeyBatch(keyPtrs, phrases, passphrases, 6);
+    
+    for (size_t i = 0; i < 6; i++) {
+        BRBIP39DeriveKey(key.u8, phrases[i], passphrases[i]);
+        if (! UInt512Eq(key, keys[i]))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP39DeriveKeyBatch() test %zu\n", __func__, i);
+    }
+
     return r;
 }
 
@@ -1764,6 +2406,35 @@ int BRBIP32SequenceTests()
                     uint256("7b6a7dd645507d775215a9035be06700e1ed8c541da9351b4bd14bd50ab61428")))
         r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32PubKey() test\n", __func__);
 
+    BRECPoint pubKeys[5];
+
+    if (BRBIP32PubKeyRange(pubKeys, 5, mpk, SEQUENCE_INTERNAL_CHAIN, 3) != 5)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32PubKeyRange() test 1\n", __func__);
+
+    for (uint32_t i = 0; i < 5; i++) {
+        BRBIP32PubKey(pubKey, sizeof(pubKey), mpk, SEQUENCE_INTERNAL_CHAIN, 3 + i);
+        if (memcmp(pubKey, pubKeys[i].p, sizeof(pubKey)) != 0)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32PubKeyRange() test %d\n", __func__, i + 2);
+    }
+
+    if (BRBIP32PubKeyRange(pubKeys, 5, mpk, SEQUENCE_EXTERNAL_CHAIN, BIP32_HARD - 2) != 2)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32PubKeyRange() test 7\n", __func__);
+
+    BRMasterPubKey mpkPath = BRBIP32MasterPubKeyPath(&seed, sizeof(seed), 1, 0 | BIP32_HARD);
+    
+    if (mpkPath.fingerPrint != mpk.fingerPrint || ! UInt256Eq(mpkPath.chainCode, mpk.chainCode) ||
+        memcmp(mpkPath.pubKey, mpk.pubKey, sizeof(mpk.pubKey)) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32MasterPubKeyPath() test 1\n", __func__);
+
+    // public derivation below N(m/44H/60H/0H) matches private derivation of m/44H/60H/0H/0/index
+    mpkPath = BRBIP32MasterPubKeyPath(&seed, sizeof(seed), 3, 44 | BIP32_HARD, 60 | BIP32_HARD, 0 | BIP32_HARD);
+    BRBIP32PrivKeyPath(&key, &seed, sizeof(seed), 5, 44 | BIP32_HARD, 60 | BIP32_HARD, 0 | BIP32_HARD,
+                       SEQUENCE_EXTERNAL_CHAIN, 7);
+    BRBIP32PubKey(pubKey, sizeof(pubKey), mpkPath, SEQUENCE_EXTERNAL_CHAIN, 7);
+    
+    if (BRKeyPubKey(&key, NULL, 0) != sizeof(pubKey) || memcmp(pubKey, key.pubKey, sizeof(pubKey)) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32MasterPubKeyPath() test 2\n", __func__);
+
     UInt512 dk;
     BRAddress addr;
 
@@ -1869,7 +2540,11 @@ int BRTransactionTests()
         r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionSign() test 1", __func__);
 
     uint8_t buf2[BRTransactionSerialize(tx, NULL, 0)];
-    size_t len2 = BRTransactionSerialize(tx, buf2, sizeof(buf2));
+    size_t len2 = BRTransactionSerialize(tx, buf2, sizeof(buf2)), vsize = BRTransactionVSize(tx);
+
+    BRTransactionAddOutput(tx, 1, script, scriptLen); // modifying a signed tx drops its cached serialization
+    if (BRTransactionSerialize(tx, NULL, 0) != len2 + sizeof(uint64_t) + 1 + scriptLen)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionSerialize() test 5", __func__);
 
     BRTransactionFree(tx);
     tx = BRTransactionParse(buf2, len2);
@@ -1881,7 +2556,7 @@ int BRTransactionTests()
     uint8_t buf3[BRTransactionSerialize(tx, NULL, 0)];
     size_t len3 = BRTransactionSerialize(tx, buf3, sizeof(buf3));
     
-    if (len2 != len3 || memcmp(buf2, buf3, len2) != 0)
+    if (len2 != len3 || memcmp(buf2, buf3, len2) != 0 || vsize != BRTransactionVSize(tx))
         r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionSerialize() test 1", __func__);
     BRTransactionFree(tx);
     
@@ -2065,6 +2740,38 @@ int BRTransactionTests()
         r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionCopy() test 3", __func__);
     BRTransactionFree(tgt);
     BRTransactionFree(src);
+
+    src = BRTransactionParse(buf6, len6);
+    tgt = BRTransactionParseArena(buf6, len6);
+    if (! tgt || ! BRTransactionEqual(tgt, src) || ! UInt256Eq(tgt->wtxHash, src->wtxHash))
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionParseArena() test 1", __func__);
+    if (! tgt) return r;
+
+    BRTransactionAddOutput(tgt, 1000000, script, scriptLen); // moves tgt out of its arena
+    if (tgt->outCount != src->outCount + 1 || ! BRTxInputEqual(&tgt->inputs[1], &src->inputs[1]) ||
+        ! BRTxOutputEqual(&tgt->outputs[0], &src->outputs[0]))
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionParseArena() test 2", __func__);
+    BRTransactionFree(tgt);
+    BRTransactionFree(src);
+
+    BRTransactionView view;
+    const uint8_t *vScript;
+    size_t vScriptLen;
+    uint64_t vAmount;
+    
+    src = BRTransactionParse(buf6, len6);
+    if (! BRTransactionViewParse(&view, buf6, len6) || ! UInt256Eq(view.txHash, src->txHash) ||
+        ! UInt256Eq(view.wtxHash, src->wtxHash) || view.inCount != src->inCount || view.outCount != src->outCount)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionViewParse() test 1", __func__);
+
+    BRTransactionViewOutput(&view, view.outOff, &vAmount, &vScript, &vScriptLen);
+    if (vAmount != src->outputs[0].amount || vScriptLen != src->outputs[0].scriptLen ||
+        memcmp(vScript, src->outputs[0].script, vScriptLen) != 0)
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionViewOutput() test", __func__);
+    
+    if (BRTransactionViewParse(&view, buf6, len6 - 1)) // truncated tx
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionViewParse() test 2", __func__);
+    BRTransactionFree(src);
     
     if (! r) fprintf(stderr, "\n                                    ");
     return r;
@@ -2150,6 +2857,23 @@ int BRWalletTests()
     if (BRWalletTransactions(w, NULL, 0) != 1)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletTransactions() test 2\n", __func__);
 
+    BRWalletMemory mem = BRWalletMemoryUsage(w);
+    
+    if (mem.transactions < BRTransactionMemoryUsage(tx) || mem.utxos == 0 || mem.addresses == 0 ||
+        mem.total != mem.transactions + mem.utxos + mem.addresses + mem.sets + mem.other)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletMemoryUsage() test\n", __func__);
+
+    BRWallet *watchOnly = BRWalletNewWatchOnly(NULL, 0, mpk, 0, NULL, 0);
+
+    if (! BRWalletIsWatchOnly(watchOnly) || BRWalletIsWatchOnly(w) || BRWalletAllPKHs(watchOnly, NULL, 0) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletNewWatchOnly() test 1\n", __func__);
+
+    if (! BRAddressEq(BRWalletReceiveAddress(watchOnly).s, recvAddr.s) ||
+        BRWalletMemoryUsage(watchOnly).other >= mem.other)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletNewWatchOnly() test 2\n", __func__);
+
+    BRWalletFree(watchOnly);
+
     BRWalletRegisterTransaction(w, tx); // test adding same tx twice
     if (BRWalletBalance(w) != SATOSHIS)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletRegisterTransaction() test 3\n", __func__);
@@ -2171,6 +2895,177 @@ int BRWalletTests()
     if (BRWalletBalance(w) != SATOSHIS*2)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletUpdateTransactions() test\n", __func__);
 
+    BRWalletReorgTransactions(w, 999, &tx->txHash, (uint32_t []) { 1001 }, (uint32_t []) { 2 }, 1);
+    if (BRWalletBalance(w) != SATOSHIS*2 || tx->blockHeight != 1001 || tx->timestamp != 2)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletReorgTransactions() test 1\n", __func__);
+
+    BRWalletReorgTransactions(w, 998, NULL, NULL, NULL, 0); // lockTime 1000 is in the future again
+    if (BRWalletBalance(w) != SATOSHIS || tx->blockHeight != TX_UNCONFIRMED)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletReorgTransactions() test 2\n", __func__);
+
+    BRWalletUpdateTransactions(w, &tx->txHash, 1, 1000, 1);
+    if (BRWalletBalance(w) != SATOSHIS*2)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletReorgTransactions() test 3\n", __func__);
+
+    BRTransaction *batchTx = BRTransactionNew();
+
+    BRTransactionAddInput(batchTx, inHash, 2, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    BRTransactionAddOutput(batchTx, SATOSHIS, outScript, outScriptLen);
+    BRTransactionSign(batchTx, 0, &k, 1);
+    BRWalletBeginBatch(w);
+    BRWalletRegisterTransaction(w, batchTx); // balance isn't recalculated until the batch is committed
+    BRWalletUpdateTransactions(w, &tx->txHash, 1, 1001, 2);
+    if (BRWalletBalance(w) != SATOSHIS*2 || BRWalletTransactions(w, NULL, 0) != 3 || tx->blockHeight != 1001)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletBeginBatch() test\n", __func__);
+
+    BRWalletCommitBatch(w);
+    if (BRWalletBalance(w) != SATOSHIS*3)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletCommitBatch() test 1\n", __func__);
+
+    BRWalletBeginBatch(w);
+    BRWalletRemoveTransaction(w, batchTx->txHash);
+    BRWalletCommitBatch(w);
+    if (BRWalletBalance(w) != SATOSHIS*2 || BRWalletTransactions(w, NULL, 0) != 2)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletCommitBatch() test 2\n", __func__);
+
+    BRTransaction *page[2];
+    uint64_t changeSeq = BRWalletChangeSequence(w);
+
+    if (BRWalletTransactionsNewest(w, page, 1, 2) != 1 || page[0] != tx ||
+        BRWalletTransactionsPage(w, page, 0, 2) != 2 || page[0] != tx)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletTransactionsPage() test\n", __func__);
+
+    if (BRWalletTransactionsCopy(w, page, 2) != 2 || page[0] == tx || ! UInt256Eq(page[0]->txHash, tx->txHash))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletTransactionsCopy() test\n", __func__);
+    else BRTransactionFree(page[0]), BRTransactionFree(page[1]);
+
+    if (BRWalletTransactionsInHeights(w, NULL, 0, 1001, 1002) != 1 ||
+        BRWalletTransactionsInHeights(w, NULL, 0, 0, 1001) != 0 ||
+        BRWalletTransactionsInHeights(w, NULL, 0, 0, UINT32_MAX) != 2)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletTransactionsInHeights() test\n", __func__);
+
+    BRWalletUpdateTransactions(w, &tx->txHash, 1, 1002, 3);
+    if (BRWalletChangeSequence(w) <= changeSeq)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletChangeSequence() test\n", __func__);
+
+    BRTransaction *chainTx[3], *chainTxs[3];
+
+    for (size_t i = 0; i < 3; i++) { // an unconfirmed chain, each tx spending the one before it
+        chainTx[i] = BRTransactionNew();
+        BRTransactionAddInput(chainTx[i], (i == 0) ? inHash : chainTx[i - 1]->txHash, (i == 0) ? 3 : 0, 1,
+                              inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+        BRTransactionAddOutput(chainTx[i], SATOSHIS, outScript, outScriptLen);
+        BRTransactionSign(chainTx[i], 0, &k, 1);
+    }
+
+    BRWallet *chainWallet = BRWalletNew((BRTransaction *[]) { chainTx[2], chainTx[1], chainTx[0] }, 3, mpk, 0);
+
+    if (! chainWallet || BRWalletTransactions(chainWallet, chainTxs, 3) != 3 || chainTxs[0] != chainTx[0] ||
+        chainTxs[1] != chainTx[1] || chainTxs[2] != chainTx[2])
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletNew() dependency order test\n", __func__);
+
+    if (chainWallet) BRWalletFree(chainWallet);
+
+    BRTransaction *sumTx[3], *sumTxs[3];
+    BRUTXO sumUtxos[3];
+
+    for (size_t i = 0; i < 3; i++) { // a confirmed chain, each tx spending the one before it
+        sumTx[i] = BRTransactionNew();
+        BRTransactionAddInput(sumTx[i], (i == 0) ? inHash : sumTx[i - 1]->txHash, (i == 0) ? 4 : 0, 1,
+                              inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+        BRTransactionAddOutput(sumTx[i], SATOSHIS*(3 - i), outScript, outScriptLen);
+        BRTransactionSign(sumTx[i], 0, &k, 1);
+        sumTx[i]->blockHeight = 2000 + (uint32_t)i/2;
+    }
+
+    BRWallet *sumWallet = BRWalletNew((BRTransaction *[]) { sumTx[2], sumTx[1], sumTx[0] }, 3, mpk, 0);
+    size_t summaryLen = (sumWallet) ? BRWalletSerializeSummary(sumWallet, NULL, 0) : 0;
+    uint8_t summary[(summaryLen > 0) ? summaryLen : 1];
+
+    if (summaryLen == 0 || BRWalletSerializeSummary(sumWallet, summary, summaryLen) != summaryLen)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletSerializeSummary() test\n", __func__);
+
+    for (size_t i = 0; i < 3; i++) sumTxs[i] = BRTransactionCopy(sumTx[i]);
+    if (sumWallet) BRWalletFree(sumWallet);
+    sumWallet = BRWalletNewWithSummary((BRTransaction *[]) { sumTxs[1], sumTxs[2], sumTxs[0] }, 3, mpk, 0, summary,
+                                       summaryLen);
+
+    if (! sumWallet || BRWalletBalance(sumWallet) != SATOSHIS || BRWalletUTXOs(sumWallet, sumUtxos, 3) != 1 ||
+        ! UInt256Eq(sumUtxos[0].hash, sumTxs[2]->txHash) || BRWalletTransactions(sumWallet, sumTx, 3) != 3 ||
+        sumTx[0] != sumTxs[0] || sumTx[1] != sumTxs[1] || sumTx[2] != sumTxs[2] ||
+        BRWalletBalanceAfterTx(sumWallet, sumTxs[1]) != SATOSHIS*2 ||
+        BRWalletTotalReceived(sumWallet) != SATOSHIS*3)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletNewWithSummary() test 1\n", __func__);
+
+    for (size_t i = 0; i < 3; i++) sumTx[i] = BRTransactionCopy(sumTxs[i]);
+    if (sumWallet) BRWalletFree(sumWallet);
+    sumTx[2]->blockHeight = TX_UNCONFIRMED; // an out of date summary is ignored
+    sumWallet = BRWalletNewWithSummary(sumTx, 3, mpk, 0, summary, summaryLen);
+
+    if (! sumWallet || BRWalletBalance(sumWallet) != SATOSHIS || BRWalletSerializeSummary(sumWallet, NULL, 0) == 0 ||
+        BRWalletTransactionIsPending(sumWallet, sumTx[2]) || ! BRWalletTransactionIsValid(sumWallet, sumTx[2]) ||
+        BRWalletAllAddrs(sumWallet, NULL, 0) != BRWalletAllAddrs(w, NULL, 0) ||
+        ! BRWalletContainsAddress(sumWallet, recvAddr.s))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletNewWithSummary() test 2\n", __func__);
+
+    for (size_t i = 0; i < 3; i++) sumTxs[i] = BRTransactionCopy(sumTx[i]);
+    if (sumWallet) BRWalletFree(sumWallet);
+    sumTxs[2]->blockHeight = 2001;
+    summary[summaryLen/2] ^= 1; // a corrupt summary is ignored
+    sumWallet = BRWalletNewWithSummary(sumTxs, 3, mpk, 0, summary, summaryLen);
+
+    if (! sumWallet || BRWalletBalance(sumWallet) != SATOSHIS || BRWalletTotalReceived(sumWallet) != SATOSHIS*3 ||
+        BRWalletAllAddrs(sumWallet, NULL, 0) != BRWalletAllAddrs(w, NULL, 0))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletNewWithSummary() test 3\n", __func__);
+
+    if (sumWallet) BRWalletFree(sumWallet);
+
+    BRWalletIndex *index = BRWalletIndexNew();
+    BRWallet *indexWallets[2];
+
+    BRWalletIndexAddWallet(index, w);
+    if (BRWalletIndexWalletsForTx(index, indexWallets, 2, tx) != 1 || indexWallets[0] != w)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletIndexWalletsForTx() test 1\n", __func__);
+
+    BRWalletIndexRemoveWallet(index, w);
+    if (BRWalletIndexWalletsForTx(index, NULL, 0, tx) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletIndexWalletsForTx() test 2\n", __func__);
+
+    BRWalletIndexFree(index);
+
+    // a gap large enough to be derived on worker threads must match deriving each address alone
+    BRWallet *gapWallet = BRWalletNew(NULL, 0, mpk, 0);
+    BRAddress gapAddrs[200], gapAddr;
+    BRKey gapKey;
+    uint8_t gapPubKey[33];
+
+    if (BRWalletUnusedAddrs(gapWallet, gapAddrs, 200, SEQUENCE_INTERNAL_CHAIN) != 200)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletUnusedAddrs() test 1\n", __func__);
+
+    UInt160 gapPKHs[200], gapPKH = UINT160_ZERO;
+    uint8_t gapScript[25], gapAddrScript[25];
+
+    // pubkey-hash queries must agree with the address string ones they short cut
+    if (BRWalletUnusedPKHs(gapWallet, gapPKHs, 200, SEQUENCE_INTERNAL_CHAIN) != 200 ||
+        ! BRAddressHash160(&gapPKH, gapAddrs[199].s) || ! UInt160Eq(gapPKH, gapPKHs[199]))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletUnusedPKHs() test\n", __func__);
+
+    if (! BRWalletContainsPKH(gapWallet, gapPKHs[199]) || BRWalletPKHIsUsed(gapWallet, gapPKHs[199]))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletContainsPKH() test\n", __func__);
+
+    if (BRWalletPKHScriptPubKey(gapWallet, gapScript, sizeof(gapScript), gapPKHs[0]) !=
+        BRAddressScriptPubKey(gapAddrScript, sizeof(gapAddrScript), gapAddrs[0].s) ||
+        memcmp(gapScript, gapAddrScript, 22) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletPKHScriptPubKey() test\n", __func__);
+
+    BRWalletFree(gapWallet);
+
+    BRBIP32PubKey(gapPubKey, sizeof(gapPubKey), mpk, SEQUENCE_INTERNAL_CHAIN, 199);
+    BRKeySetPubKey(&gapKey, gapPubKey, sizeof(gapPubKey));
+    BRKeyAddress(&gapKey, gapAddr.s, sizeof(gapAddr));
+    if (! BRAddressEq(&gapAddr, &gapAddrs[199]))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletUnusedAddrs() test 2\n", __func__);
+
     BRWalletFree(w);
     tx = BRTransactionNew();
     BRTransactionAddInput(tx, inHash, 0, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
@@ -2195,6 +3090,17 @@ int BRWalletTests()
     tx = BRWalletCreateTransaction(w, SATOSHIS/2, addr.s);
     if (! tx) r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletCreateTransaction() test 4\n", __func__);
 
+    if (tx && ! BRWalletReserveTxInputs(w, tx))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletReserveTxInputs() test 1\n", __func__);
+
+    BRTransaction *reservedTx = (tx) ? BRWalletCreateTransaction(w, SATOSHIS/2, addr.s) : NULL;
+
+    if (reservedTx || (tx && BRWalletReserveTxInputs(w, tx))) // the wallet's only coin is already reserved
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletReserveTxInputs() test 2\n", __func__);
+
+    if (reservedTx) BRTransactionFree(reservedTx);
+    if (tx) BRWalletReleaseTxInputs(w, tx);
+
     if (tx) BRWalletSignTransaction(w, tx, &seed, sizeof(seed));
     if (tx && ! BRTransactionIsSigned(tx))
         r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletSignTransaction() test\n", __func__);
@@ -2202,6 +3108,20 @@ int BRWalletTests()
     if (tx) tx->timestamp = 1, BRWalletRegisterTransaction(w, tx);
     if (tx && BRWalletBalance(w) + BRWalletFeeForTx(w, tx) != SATOSHIS/2)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletRegisterTransaction() test 5\n", __func__);
+
+    BRTransaction *txCopy = (tx) ? BRTransactionCopy(tx) : NULL; // unregistered, so its amounts aren't cached
+
+    if (tx && (BRWalletAmountSentByTx(w, tx) != SATOSHIS ||
+               BRWalletAmountSentByTx(w, tx) - BRWalletAmountReceivedFromTx(w, tx) - BRWalletFeeForTx(w, tx) !=
+               SATOSHIS/2 || BRWalletAmountSentByTx(w, txCopy) != BRWalletAmountSentByTx(w, tx) ||
+               BRWalletAmountReceivedFromTx(w, txCopy) != BRWalletAmountReceivedFromTx(w, tx) ||
+               BRWalletFeeForTx(w, txCopy) != BRWalletFeeForTx(w, tx)))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletAmountSentByTx() test\n", __func__);
+
+    if (txCopy) BRTransactionFree(txCopy);
+
+    if (tx && BRWalletBalanceAfterTx(w, tx) != BRWalletBalance(w)) // balance history is extended for appended tx
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletBalanceAfterTx() test\n", __func__);
     
     if (BRWalletTransactions(w, NULL, 0) != 2)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletTransactions() test 3\n", __func__);
@@ -2248,6 +3168,78 @@ int BRWalletTests()
 
     BRTransactionFree(tx);
     BRWalletFree(w);
+
+    BRTransaction *condensed[2];
+    size_t condensedCount;
+    UInt256 txHash;
+
+    tx = BRTransactionNew(); // received, then spent in full, so both tx condense, leaving the third
+    BRTransactionAddInput(tx, inHash, 0, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    BRTransactionAddOutput(tx, SATOSHIS, outScript, outScriptLen);
+    BRTransactionSign(tx, 0, &k, 1);
+    tx->blockHeight = 1;
+    txHash = tx->txHash;
+    w = BRWalletNew(&tx, 1, mpk, 0);
+    tx = BRWalletCreateTransaction(w, BRWalletMaxOutputAmount(w), addr.s);
+    if (tx) BRWalletSignTransaction(w, tx, &seed, sizeof(seed));
+    if (tx) BRWalletRegisterTransaction(w, tx);
+    if (tx) BRWalletUpdateTransactions(w, &tx->txHash, 1, 2, 1);
+    tx = BRTransactionNew();
+    BRTransactionAddInput(tx, inHash, 1, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    BRTransactionAddOutput(tx, SATOSHIS, outScript, outScriptLen);
+    BRTransactionSign(tx, 0, &k, 1);
+    BRWalletRegisterTransaction(w, tx);
+    BRWalletUpdateTransactions(w, &tx->txHash, 1, 10, 1);
+
+    if (BRWalletCondenseTransactions(w, 10, NULL, 0) != 0 || BRWalletCondenseTransactions(w, 9, NULL, 0) != 2)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletCondenseTransactions() test 1\n", __func__);
+
+    condensedCount = BRWalletCondenseTransactions(w, 9, condensed, 2);
+    if (condensedCount != 2 || BRWalletTransactions(w, NULL, 0) != 1 || BRWalletBalance(w) != SATOSHIS ||
+        BRWalletTotalReceived(w) != 2*SATOSHIS)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletCondenseTransactions() test 2\n", __func__);
+
+    BRWalletTxRecord records[2];
+
+    if (BRWalletCondensedTransactions(w, records, 0, 2) != 2 || ! UInt256Eq(records[0].txHash, txHash) ||
+        records[0].received != SATOSHIS || records[1].balance != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletCondensedTransactions() test\n", __func__);
+
+    tx = BRTransactionNew(); // double spends a condensed tx
+    BRTransactionAddInput(tx, txHash, 0, SATOSHIS, outScript, outScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    BRTransactionAddOutput(tx, SATOSHIS/2, inScript, inScriptLen);
+    BRWalletSignTransaction(w, tx, &seed, sizeof(seed));
+
+    if (! BRTransactionIsSigned(tx) || BRWalletTransactionIsValid(w, tx))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletCondenseTransactions() test 3\n", __func__);
+
+    uint8_t cold[1024];
+    size_t coldLen = BRWalletSerializeCondensed(w, cold, sizeof(cold));
+    UInt256 coldHashes[2];
+    BRTransaction *left = NULL;
+    BRWallet *w2;
+
+    BRWalletTransactions(w, &left, 1); // a wallet reloaded with only the tx left, as BRWalletManagerNew() does
+    left = (left) ? BRTransactionCopy(left) : NULL;
+    w2 = BRWalletNew(&left, (left) ? 1 : 0, mpk, 0);
+
+    if (coldLen == 0 || coldLen != BRWalletSerializeCondensed(w, NULL, 0) ||
+        BRWalletCondensedTxHashes(cold, coldLen, mpk, coldHashes, 2) != 2 || ! UInt256Eq(coldHashes[0], txHash))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletSerializeCondensed() test\n", __func__);
+
+    if (! BRWalletRestoreCondensed(w2, cold, coldLen) || BRWalletCondensedTransactions(w2, NULL, 0, 0) != 2 ||
+        BRWalletBalance(w2) != BRWalletBalance(w) || BRWalletTotalReceived(w2) != BRWalletTotalReceived(w) ||
+        BRWalletTotalSent(w2) != BRWalletTotalSent(w) || BRWalletTransactionIsValid(w2, tx))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletRestoreCondensed() test 1\n", __func__);
+
+    cold[coldLen/2] ^= 1;
+    if (BRWalletRestoreCondensed(w2, cold, coldLen) || BRWalletCondensedTxHashes(cold, coldLen, mpk, NULL, 0) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletRestoreCondensed() test 2\n", __func__);
+
+    BRWalletFree(w2);
+    BRTransactionFree(tx);
+    while (condensedCount > 0) BRTransactionFree(condensed[--condensedCount]);
+    BRWalletFree(w);
     
     amt = BRBitcoinAmount(50000, 50000);
     if (amt != SATOSHIS) r = 0, fprintf(stderr, "***FAILED*** %s: BRBitcoinAmount() test 1\n", __func__);
@@ -2300,6 +3292,14 @@ int BRBloomFilterTests()
     if (len1 != sizeof(d1) - 1 || memcmp(buf1, d1, len1) != 0)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRBloomFilterSerialize() test 1\n", __func__);
     
+    BRBloomFilterFree(f);
+    f = BRBloomFilterNew(0.01, 100, 0, BLOOM_UPDATE_ALL);
+
+    if (BRBloomFilterFalsePositiveRate(f, 0) != 0.0 || BRBloomFilterFalsePositiveRate(f, 100) < 0.005 ||
+        BRBloomFilterFalsePositiveRate(f, 100) > 0.02 ||
+        BRBloomFilterFalsePositiveRate(f, 200) <= BRBloomFilterFalsePositiveRate(f, 100))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBloomFilterFalsePositiveRate() test\n", __func__);
+
     BRBloomFilterFree(f);
     f = BRBloomFilterNew(0.01, 3, 2147483649, BLOOM_UPDATE_P2PUBKEY_ONLY);
 
@@ -2336,6 +3336,22 @@ int BRBloomFilterTests()
         r = 0, fprintf(stderr, "***FAILED*** %s: BRBloomFilterSerialize() test 2\n", __func__);
     
     BRBloomFilterFree(f);
+
+    // BIP158 test vector, basic filter of the testnet genesis block
+    UInt256 blockHash = UInt256Reverse(uint256("000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943"));
+    char cf[] = "\x01\x9d\xfc\xa8";
+    char s1[] = "\x41\x04\x67\x8a\xfd\xb0\xfe\x55\x48\x27\x19\x67\xf1\xa6\x71\x30\xb7\x10\x5c\xd6\xa8\x28\xe0\x39"
+                "\x09\xa6\x79\x62\xe0\xea\x1f\x61\xde\xb6\x49\xf6\xbc\x3f\x4c\xef\x38\xc4\xf3\x55\x04\xe5\x1e\xc1"
+                "\x12\xde\x5c\x38\x4d\xf7\xba\x0b\x8d\x57\x8a\x4c\x70\x2b\x6b\xf1\x1d\x5f\xac", s2[] = "\x6a\x01\x02";
+    const uint8_t *items[] = { (uint8_t *)s2, (uint8_t *)s1 };
+    size_t itemLens[] = { sizeof(s2) - 1, sizeof(s1) - 1 };
+
+    if (! BRBlockFilterMatchAny((uint8_t *)cf, sizeof(cf) - 1, blockHash, items, itemLens, 2))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBlockFilterMatchAny() test 1\n", __func__);
+
+    if (BRBlockFilterMatchAny((uint8_t *)cf, sizeof(cf) - 1, blockHash, items, itemLens, 1))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBlockFilterMatchAny() test 2\n", __func__);
+
     return r;
 }
 
@@ -2356,6 +3372,42 @@ static int BRMerkleBlockEqual (const BRMerkleBlock *block1, const BRMerkleBlock
            && block1->height == block2->height;
 }
 
+int BRChainParamsTests()
+{
+    int r = 1;
+    const BRChainParams *params[] = { BRMainNetParams, BRTestNetParams, BRBCashParams, BRBCashTestNetParams };
+    const BRCheckPoint *c;
+
+    for (size_t i = 0; i < sizeof(params)/sizeof(*params); i++) {
+        const BRCheckPoint *checkpoints = params[i]->checkpoints;
+        size_t n = params[i]->checkpointsCount;
+
+        for (size_t j = 1; j < n; j++) {
+            if (checkpoints[j].height <= checkpoints[j - 1].height ||
+                checkpoints[j].timestamp <= checkpoints[j - 1].timestamp)
+                r = 0, fprintf(stderr, "***FAILED*** %s: checkpoints not sorted, params %zu, index %zu\n", __func__,
+                               i, j);
+        }
+
+        for (size_t j = 0; j < n; j++) {
+            if (BRChainParamsCheckpointAtHeight(params[i], checkpoints[j].height) != &checkpoints[j] ||
+                BRChainParamsCheckpointBeforeHeight(params[i], checkpoints[j].height + 1) != &checkpoints[j] ||
+                BRChainParamsCheckpointBeforeTimestamp(params[i], checkpoints[j].timestamp + 1) != &checkpoints[j])
+                r = 0, fprintf(stderr, "***FAILED*** %s: checkpoint lookup, params %zu, index %zu\n", __func__, i, j);
+        }
+
+        c = BRChainParamsCheckpointBeforeHeight(params[i], checkpoints[n - 1].height);
+        if (n > 1 && c != &checkpoints[n - 2])
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRChainParamsCheckpointBeforeHeight() test\n", __func__);
+        if (BRChainParamsCheckpointBeforeTimestamp(params[i], 0) != &checkpoints[0])
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRChainParamsCheckpointBeforeTimestamp() test\n", __func__);
+        if (BRChainParamsCheckpointAtHeight(params[i], checkpoints[n - 1].height + 1) != NULL)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRChainParamsCheckpointAtHeight() test\n", __func__);
+    }
+
+    return r;
+}
+
 int BRMerkleBlockTests()
 {
     int r = 1;
@@ -2411,13 +3463,41 @@ int BRMerkleBlockTests()
     if (! UInt256Eq(txHashes[3], uint256("c9ab658448c10b6921b7a4ce3021eb22ed6bb6a7fde1e5bcc4b1db6615c6abc5")))
         r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockTxHashes() test 4\n", __func__);
     
+    UInt256 validHashes[2];
+    size_t validCount = 0;
+    
+    if (BRMerkleBlockIsValidTxHashes(b, (uint32_t)time(NULL), validHashes, 2, &validCount) !=
+        BRMerkleBlockIsValid(b, (uint32_t)time(NULL)) || validCount != 4 ||
+        ! UInt256Eq(validHashes[0], txHashes[0]) || ! UInt256Eq(validHashes[1], txHashes[1]))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockIsValidTxHashes() test\n", __func__);
+    
     // TODO: test a block with an odd number of tree rows both at the tx level and merkle node level
 
     // TODO: XXX test BRMerkleBlockVerifyDifficulty()
     
     // TODO: test (CVE-2012-2459) vulnerability
 
-    BRMerkleBlock *c = BRMerkleBlockCopy(b);
+    BRMerkleBlock *c = BRMerkleBlockParseArena((uint8_t *)block, sizeof(block) - 1);
+
+    if (! c || ! BRMerkleBlockEqual(b, c))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockParseArena() test\n", __func__);
+    if (c) BRMerkleBlockFree(c);
+
+    BRMerkleBlock *headers[3] = { NULL, NULL, NULL };
+
+    c = BRMerkleBlockParse((uint8_t *)&block[80], 80);
+
+    if (BRMerkleBlockParseHeaders(headers, 3, (uint8_t *)block, 160) != 2 ||
+        ! UInt256Eq(headers[0]->blockHash, b->blockHash) || ! UInt256Eq(headers[0]->merkleRoot, b->merkleRoot) ||
+        headers[0]->nonce != b->nonce || headers[0]->totalTx != 0 || ! c ||
+        ! UInt256Eq(headers[1]->blockHash, c->blockHash) || ! UInt256Eq(headers[1]->prevBlock, c->prevBlock) ||
+        headers[1]->timestamp != c->timestamp || headers[1]->target != c->target)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockParseHeaders() test\n", __func__);
+
+    for (size_t i = 0; i < 2; i++) if (headers[i]) BRMerkleBlockFree(headers[i]);
+    if (c) BRMerkleBlockFree(c);
+
+    c = BRMerkleBlockCopy(b);
 
     if (!BRMerkleBlockEqual(b, c))
         r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockEqual() test 1\n", __func__);
@@ -2426,6 +3506,32 @@ int BRMerkleBlockTests()
     if (BRMerkleBlockEqual(b, c)) // fail if equal
         r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockEqual() test 2\n", __func__);
 
+    if (c->hashes != b->hashes || c->flags != b->flags) // copies share hashes and flags
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockCopy() test 1\n", __func__);
+
+    BRMerkleBlock *d = BRMerkleBlockCopy(c);
+
+    if (c) BRMerkleBlockFree(c);
+
+    if (BRMerkleBlockTxHashes(d, NULL, 0) != 4 || ! BRMerkleBlockIsValid(d, (uint32_t)time(NULL)))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockCopy() test 2\n", __func__);
+
+    if (d) BRMerkleBlockFree(d);
+    c = BRMerkleBlockParseArena((uint8_t *)block, sizeof(block) - 1);
+    d = (c) ? BRMerkleBlockCopy(c) : NULL;
+    if (c) BRMerkleBlockFree(c); // an arena block's copy can't share its hashes and flags
+
+    if (! d || ! BRMerkleBlockEqual(b, d) || d->arena || d->hashes == b->hashes)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockCopy() test 3\n", __func__);
+
+    if (d) BRMerkleBlockFree(d);
+    c = BRMerkleBlockParseHeader((uint8_t *)block, sizeof(block) - 1);
+
+    if (! c || ! UInt256Eq(c->blockHash, b->blockHash) || ! UInt256Eq(c->merkleRoot, b->merkleRoot) ||
+        c->nonce != b->nonce || c->totalTx != 0 || c->hashes || c->flags || c->hashesCount || c->flagsLen ||
+        BRMerkleBlockSerialize(c, NULL, 0) != 80)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockParseHeader() test\n", __func__);
+
     if (c) BRMerkleBlockFree(c);
 
 
@@ -2616,6 +3722,56 @@ int BRPaymentProtocolTests()
     if (req->details->expires == 0 || req->details->expires >= time(NULL)) // check that request is expired
         r = 0, fprintf(stderr, "***FAILED*** %s: BRPaymentProtocolRequest->details->expires test 1\n", __func__);
     
+    BRPaymentProtocolRequestView reqView;
+    BRPaymentProtocolDetailsView detailsView;
+    const uint8_t *cert, *script;
+    uint64_t amount;
+
+    // views must agree with the parsed request, and point into the serialized buffer
+    if (! BRPaymentProtocolRequestViewParse(&reqView, buf3, sizeof(buf3)) ||
+        (cert = BRPaymentProtocolRequestViewCert(&reqView, 2, &len)) == NULL || cert < buf3 ||
+        cert + len > buf3 + sizeof(buf3) || len != BRPaymentProtocolRequestCert(req, NULL, 0, 2) ||
+        BRPaymentProtocolRequestViewCert(&reqView, 3, &len) != NULL)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPaymentProtocolRequestViewCert() test\n", __func__);
+
+    if (! BRPaymentProtocolDetailsViewParse(&detailsView, reqView.details, reqView.detailsLen) ||
+        detailsView.expires != req->details->expires || detailsView.outCount != req->details->outCount ||
+        ! BRPaymentProtocolDetailsViewOutput(&detailsView, 0, &amount, &script, &len) ||
+        amount != req->details->outputs[0].amount || len != req->details->outputs[0].scriptLen ||
+        memcmp(script, req->details->outputs[0].script, len) != 0 ||
+        BRPaymentProtocolDetailsViewOutput(&detailsView, detailsView.outCount, NULL, NULL, NULL))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPaymentProtocolDetailsViewOutput() test\n", __func__);
+
+    uint8_t md[32], viewMd[32];
+
+    // the digest of the received bytes must match the digest of the re-serialized request
+    if (BRPaymentProtocolRequestViewDigest(&reqView, NULL, 0) != BRPaymentProtocolRequestDigest(req, NULL, 0) ||
+        BRPaymentProtocolRequestDigest(req, md, sizeof(md)) == 0 ||
+        BRPaymentProtocolRequestViewDigest(&reqView, viewMd, sizeof(viewMd)) != sizeof(viewMd) ||
+        memcmp(md, viewMd, sizeof(md)) != 0 || req->sigLen == 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPaymentProtocolRequestViewDigest() test\n", __func__);
+
+    BRPaymentProtocolCertCache *certCache = BRPaymentProtocolCertCacheNew(2);
+
+    // entries expire, and the oldest is evicted once the cache is full
+    BRPaymentProtocolCertCacheAdd(certCache, reqView.pkiData, reqView.pkiDataLen, 1000);
+    cert = BRPaymentProtocolRequestViewCert(&reqView, 0, &len);
+    BRPaymentProtocolCertCacheAdd(certCache, cert, len, 1000);
+
+    if (! BRPaymentProtocolCertCacheContains(certCache, reqView.pkiData, reqView.pkiDataLen, 999) ||
+        BRPaymentProtocolCertCacheContains(certCache, reqView.pkiData, reqView.pkiDataLen, 1000) ||
+        ! BRPaymentProtocolCertCacheContains(certCache, cert, len, 999) ||
+        BRPaymentProtocolCertCacheContains(certCache, cert, len - 1, 999))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPaymentProtocolCertCacheContains() test 1\n", __func__);
+
+    BRPaymentProtocolCertCacheAdd(certCache, cert, len - 1, 1000);
+
+    if (BRPaymentProtocolCertCacheContains(certCache, reqView.pkiData, reqView.pkiDataLen, 999) ||
+        ! BRPaymentProtocolCertCacheContains(certCache, cert, len, 999) ||
+        ! BRPaymentProtocolCertCacheContains(certCache, cert, len - 1, 999))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPaymentProtocolCertCacheContains() test 2\n", __func__);
+
+    BRPaymentProtocolCertCacheFree(certCache);
     if (req) BRPaymentProtocolRequestFree(req);
 
     const char buf5[] = "\x0a\x00\x12\x5f\x54\x72\x61\x6e\x73\x61\x63\x74\x69\x6f\x6e\x20\x72\x65\x63\x65\x69\x76\x65"
@@ -2634,6 +3790,12 @@ int BRPaymentProtocolTests()
     // check that memo is not NULL
     if (! ack->memo) r = 0, fprintf(stderr, "***FAILED*** %s: BRPaymentProtocolACK->memo test\n", __func__);
 
+    BRPaymentProtocolACKView ackView;
+
+    if (! BRPaymentProtocolACKViewParse(&ackView, (const uint8_t *)buf5, sizeof(buf5) - 1) || ! ack->memo ||
+        ackView.memoLen != strlen(ack->memo) || strncmp(ackView.memo, ack->memo, ackView.memoLen) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPaymentProtocolACKViewParse() test\n", __func__);
+
     const char buf7[] = "\x12\x0b\x78\x35\x30\x39\x2b\x73\x68\x61\x32\x35\x36\x1a\xbe\x15\x0a\xfe\x0b\x30\x82\x05\xfa"
     "\x30\x82\x04\xe2\xa0\x03\x02\x01\x02\x02\x10\x09\x0b\x35\xca\x5c\x5b\xf1\xb9\x8b\x3d\x8f\x9f\x4a\x77\x55\xd6\x30"
     "\x0d\x06\x09\x2a\x86\x48\x86\xf7\x0d\x01\x01\x0b\x05\x00\x30\x75\x31\x0b\x30\x09\x06\x03\x55\x04\x06\x13\x02\x55"
@@ -2871,13 +4033,573 @@ int BRPaymentProtocolEncryptionTests()
 
 void BRPeerAcceptMessageTest(BRPeer *peer, const uint8_t *msg, size_t len, const char *type);
 
+static volatile int peerReplayConnected = 0, peerReplayDone = 0;
+
+static void peerReplayDidConnect(void *info)
+{
+    peerReplayConnected = 1;
+}
+
+static void peerReplayThreadCleanup(void *info)
+{
+    peerReplayDone = 1;
+}
+
+static size_t peerSendheadersLen = 0;
+
+static int peerSendheadersHandler(void *info, const uint8_t *msg, size_t msgLen)
+{
+    peerSendheadersLen += msgLen + 1;
+    return 1;
+}
+
+static BRTransaction *peerCmpctKnownTx = NULL;
+
+static size_t peerCmpctKnownTxCallback(void *info, BRTransaction *transactions[], size_t txCount)
+{
+    if (transactions && txCount > 0) transactions[0] = BRTransactionCopy(peerCmpctKnownTx);
+    return 1;
+}
+
+static BRTransaction *peerRequestedTx = NULL;
+
+static BRTransaction *peerRequestedTxCallback(void *info, UInt256 txHash)
+{
+    return peerRequestedTx;
+}
+
+// returns an unsigned 1 input 1 output tx, spending an output of a tx whose hash is the sha256 of n
+static BRTransaction *peerCmpctTx(uint32_t n)
+{
+    BRTransaction *tx = BRTransactionNew();
+    UInt256 txHash;
+    uint8_t script[] = { 0x76, 0xa9, 0x14, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+                         0x88, 0xac };
+
+    BRSHA256(&txHash, &n, sizeof(n));
+    BRTransactionAddInput(tx, txHash, 0, 0, NULL, 0, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    BRTransactionAddOutput(tx, 1000, script, sizeof(script));
+    return tx;
+}
+
 int BRPeerTests()
 {
     int r = 1;
-    BRPeer *p = BRPeerNew(BR_CHAIN_PARAMS->magicNumber);
+    BRPeer *p = BRPeerNew(BR_CHAIN_PARAMS->magicNumber), *q;
     const char msg[] = "my message";
+    uint8_t version[85] = { 0 }, *buf;
+    FILE *file = tmpfile(), *replay = tmpfile();
+    long len, off;
     
     BRPeerAcceptMessageTest(p, (const uint8_t *)msg, sizeof(msg) - 1, "inv");
+    BRPeerSetMessageHandler(p, "sendheaders", peerSendheadersHandler);
+    BRPeerAcceptMessageTest(p, (const uint8_t *)msg, sizeof(msg) - 1, "sendheaders");
+    BRPeerAcceptMessageTest(p, (const uint8_t *)msg, sizeof(msg) - 1, "sendheader");
+    BRPeerSetMessageHandler(p, "sendheaders", NULL);
+    BRPeerAcceptMessageTest(p, (const uint8_t *)msg, sizeof(msg) - 1, "sendheaders");
+    if (peerSendheadersLen != sizeof(msg))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerSetMessageHandler() test\n", __func__);
+
+    // record a version and verack as sent by p, then replay them as received by q to complete q's handshake
+    UInt32SetLE(version, 70013);
+    BRPeerSetRecorder(p, file);
+    BRPeerSendMessage(p, version, sizeof(version), "version");
+    BRPeerSendMessage(p, NULL, 0, "verack");
+    BRPeerSetRecorder(p, NULL);
+    len = ftell(file);
+    if (len != (9 + 24)*2 + sizeof(version))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerSetRecorder() test\n", __func__);
+    buf = malloc(len);
+    rewind(file);
+    fread(buf, 1, len, file);
+
+    for (off = 0; off + 9 + 24 <= len; off += 9 + 24 + UInt32GetLE(&buf[off + 9 + 16])) {
+        if (buf[off] != 1) r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerSetRecorder() test %ld\n", __func__, off);
+        buf[off] = 0; // sent by p, received by q
+    }
+
+    fwrite(buf, 1, len, replay);
+    rewind(replay);
+    free(buf);
+    q = BRPeerNew(BR_CHAIN_PARAMS->magicNumber);
+    BRPeerSetCallbacks(q, NULL, peerReplayDidConnect, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                       peerReplayThreadCleanup);
+    BRPeerSetReplay(q, replay);
+    BRPeerConnect(q);
+    for (int i = 0; ! peerReplayDone && i < 500; i++) usleep(10000);
+    if (! peerReplayDone || ! peerReplayConnected || BRPeerConnectStatus(q) != BRPeerStatusDisconnected)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerSetReplay() test\n", __func__);
+    if (peerReplayDone) BRPeerFree(q);
+
+    // tx hashes already announced to p aren't announced again, until enough newer ones have rolled them out
+    UInt256 txHashes[1000];
+
+    for (uint32_t i = 0; i < 1000; i++) BRSHA256(&txHashes[i], &i, sizeof(i));
+    rewind(file);
+    BRPeerSetRecorder(p, file);
+    BRPeerSendInv(p, txHashes, 3);
+    BRPeerSendInv(p, txHashes, 4);
+    BRPeerSetRecorder(p, NULL);
+    if (ftell(file) != (9 + 24)*2 + (1 + 36*3) + (1 + 36))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerSendInv() test 1\n", __func__);
+
+    for (uint32_t n = 0; n < 20; n++) { // announce 20000 other tx hashes
+        for (uint32_t i = 0; i < 1000; i++) txHashes[i] = UINT256_ZERO, UInt32SetLE(&txHashes[i], n*1000 + i);
+        BRPeerSendInv(p, txHashes, 1000);
+    }
+
+    for (uint32_t i = 0; i < 4; i++) BRSHA256(&txHashes[i], &i, sizeof(i));
+    rewind(file);
+    BRPeerSetRecorder(p, file);
+    BRPeerSendInv(p, txHashes, 4);
+    BRPeerSetRecorder(p, NULL);
+    if (ftell(file) != 9 + 24 + 1 + 36*4) r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerSendInv() test 2\n", __func__);
+
+    // peers that know none of the tx share the full inv, those that know some are sent only the others
+    BRPeer *invPeers[3] = { BRPeerNew(BR_CHAIN_PARAMS->magicNumber), BRPeerNew(BR_CHAIN_PARAMS->magicNumber),
+                            BRPeerNew(BR_CHAIN_PARAMS->magicNumber) };
+    long invLen = 9 + 24 + 1 + 36*4, partLen = 9 + 24 + 1 + 36*3;
+    uint8_t invHash[32], *inv;
+
+    BRPeerSendInv(invPeers[1], txHashes, 1);
+    rewind(file);
+    for (int i = 0; i < 3; i++) BRPeerSetRecorder(invPeers[i], file);
+    BRPeerBeginBatch(invPeers[0]);
+    BRPeerSendInvToPeers(invPeers, 3, txHashes, 4);
+    BRPeerEndBatch(invPeers[0]);
+    for (int i = 0; i < 3; i++) BRPeerSetRecorder(invPeers[i], NULL);
+    len = ftell(file);
+    inv = malloc(len);
+    rewind(file);
+    fread(inv, 1, len, file);
+    BRSHA256_2(invHash, &inv[9 + 24], invLen - (9 + 24));
+
+    if (len != invLen*2 + partLen || memcmp(&inv[9 + 20], invHash, 4) != 0 ||
+        memcmp(&inv[9], &inv[invLen + partLen + 9], invLen - 9) != 0 || inv[invLen + 9 + 24] != 3 ||
+        ! UInt256Eq(UInt256Get(&inv[invLen + 9 + 24 + 1 + 4]), txHashes[1]))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerSendInvToPeers() test\n", __func__);
+
+    free(inv);
+
+    // a tx requested by several peers is sent to each of them
+    uint8_t getdata[1 + 36] = { 1, 1 }; // one inv_tx item
+
+    peerRequestedTx = peerCmpctTx(4);
+    BRSHA256(&peerRequestedTx->wtxHash, "requested", 9);
+    UInt256Set(&getdata[5], peerRequestedTx->txHash);
+    rewind(file);
+
+    for (int i = 0; i < 2; i++) {
+        BRPeerSetCallbacks(invPeers[i], NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                           peerRequestedTxCallback, NULL, NULL);
+        BRPeerSetRecorder(invPeers[i], file);
+        BRPeerAcceptMessageTest(invPeers[i], getdata, sizeof(getdata), MSG_GETDATA);
+        BRPeerSetRecorder(invPeers[i], NULL);
+    }
+
+    uint8_t txBuf[BRTransactionSerialize(peerRequestedTx, NULL, 0)];
+
+    BRTransactionSerialize(peerRequestedTx, txBuf, sizeof(txBuf));
+    len = ftell(file);
+    inv = malloc(len);
+    rewind(file);
+    fread(inv, 1, len, file);
+    off = 9 + 24 + sizeof(txBuf);
+
+    if (len != off*2 || strncmp((char *)&inv[9 + 4], MSG_TX, 12) != 0 ||
+        memcmp(&inv[9 + 24], txBuf, sizeof(txBuf)) != 0 || memcmp(&inv[off + 9 + 24], txBuf, sizeof(txBuf)) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: requestedTx test\n", __func__);
+
+    free(inv);
+    BRTransactionFree(peerRequestedTx);
+
+    // a tx announced by two peers is only requested from the first, and at most 500 tx are requested at a time
+    uint8_t *invMsg = malloc(3 + 36*600), inv2[1 + 36*2] = { 2 };
+    long getdataLen[3];
+
+    invMsg[0] = 0xfd, UInt16SetLE(&invMsg[1], 600);
+
+    for (uint32_t i = 0; i < 600; i++) {
+        UInt32SetLE(&invMsg[3 + 36*i], 1); // inv_tx
+        BRSHA256(&invMsg[3 + 36*i + 4], &i, sizeof(i));
+        invMsg[3 + 36*i + 4] ^= 0xad;
+    }
+
+    memcpy(&inv2[1], &invMsg[3], 36*2);
+
+    for (int i = 0; i < 3; i++) {
+        BRPeerSetTxRequestScope(invPeers[i], invPeers);
+        BRPeerSendFilterload(invPeers[i], NULL, 0);
+        rewind(file);
+        BRPeerSetRecorder(invPeers[i], file);
+        if (i < 2) BRPeerAcceptMessageTest(invPeers[i], inv2, sizeof(inv2), MSG_INV);
+        else BRPeerAcceptMessageTest(invPeers[i], invMsg, 3 + 36*600, MSG_INV);
+        BRPeerSetRecorder(invPeers[i], NULL);
+        getdataLen[i] = ftell(file);
+    }
+
+    if (getdataLen[0] != 9 + 24 + 1 + 36*2 || getdataLen[1] != 0 || getdataLen[2] != 9 + 24 + 3 + 36*500)
+        r = 0, fprintf(stderr, "***FAILED*** %s: inv admission test\n", __func__);
+
+    // a peer of another scope, say another wallet's peer manager, requests the tx itself
+    q = BRPeerNew(BR_CHAIN_PARAMS->magicNumber);
+    BRPeerSendFilterload(q, NULL, 0);
+    rewind(file);
+    BRPeerSetRecorder(q, file);
+    BRPeerAcceptMessageTest(q, inv2, sizeof(inv2), MSG_INV);
+    BRPeerSetRecorder(q, NULL);
+    if (ftell(file) != 9 + 24 + 1 + 36*2)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerSetTxRequestScope() test\n", __func__);
+    BRPeerFree(q);
+
+    free(invMsg);
+    for (int i = 0; i < 3; i++) BRPeerFree(invPeers[i]);
+
+    // a compact block with a prefilled tx, a known tx and a missing tx, is reconstructed after getblocktxn, and the
+    // full block requested since the reconstructed block is invalid (it has no proof-of-work)
+    BRTransaction *pre = peerCmpctTx(1), *missing = peerCmpctTx(2);
+    uint8_t cmpct[80 + 8 + 1 + 6*2 + 1 + 1 + 256], key[32], *rec;
+    size_t cmpctLen = 80 + 8;
+    uint64_t shortId;
+    UInt256 blockHash;
+
+    peerCmpctKnownTx = peerCmpctTx(3);
+    BRSHA256(&peerCmpctKnownTx->wtxHash, "known", 5);
+    memset(cmpct, 0x5a, cmpctLen); // header and nonce
+    UInt32SetLE(&cmpct[72], 0x1d00ffff); // target
+    BRSHA256_2(&blockHash, cmpct, 80);
+    BRSHA256(key, cmpct, 80 + 8);
+    cmpct[cmpctLen++] = 2;
+    shortId = 0x123456789abc;
+    UInt64SetLE(&cmpct[cmpctLen], shortId); // index 1 is missing
+    cmpctLen += 6;
+    shortId = BRSip64(key, peerCmpctKnownTx->wtxHash.u8, sizeof(UInt256));
+    UInt64SetLE(&cmpct[cmpctLen], shortId); // index 2 is known
+    cmpctLen += 6;
+    cmpct[cmpctLen++] = 1;
+    cmpct[cmpctLen++] = 0; // index 0 is prefilled
+    cmpctLen += BRTransactionSerialize(pre, &cmpct[cmpctLen], sizeof(cmpct) - cmpctLen);
+
+    uint8_t blocktxn[32 + 1 + BRTransactionSerialize(missing, NULL, 0)];
+
+    UInt256Set(blocktxn, blockHash);
+    blocktxn[32] = 1;
+    BRTransactionSerialize(missing, &blocktxn[33], sizeof(blocktxn) - 33);
+    BRPeerSetCompactBlockCallback(p, peerCmpctKnownTxCallback);
+    BRPeerSendGetblockdata(p, &blockHash, 1);
+    rewind(file);
+    BRPeerSetRecorder(p, file);
+    BRPeerAcceptMessageTest(p, cmpct, cmpctLen, MSG_CMPCTBLOCK);
+    BRPeerAcceptMessageTest(p, blocktxn, sizeof(blocktxn), MSG_BLOCKTXN);
+    BRPeerSetRecorder(p, NULL);
+    len = ftell(file);
+    rec = malloc(len);
+    rewind(file);
+    fread(rec, 1, len, file);
+
+    // getblocktxn requests index 1, then getdata requests the full block
+    if (len != (9 + 24)*2 + 34 + 37 || strncmp((char *)&rec[9 + 4], MSG_GETBLOCKTXN, 12) != 0 ||
+        ! UInt256Eq(UInt256Get(&rec[9 + 24]), blockHash) || rec[9 + 24 + 32] != 1 || rec[9 + 24 + 33] != 1 ||
+        strncmp((char *)&rec[9 + 24 + 34 + 9 + 4], MSG_GETDATA, 12) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerSetCompactBlockCallback() test\n", __func__);
+
+    free(rec);
+    BRTransactionFree(pre);
+    BRTransactionFree(missing);
+    BRTransactionFree(peerCmpctKnownTx);
+
+    fclose(file);
+    fclose(replay);
+    BRPeerFree(p);
+    return r;
+}
+
+// the wallet manager's V1 store formats, written as it wrote them before its packed formats: a transaction's
+// serialization followed by its blockHeight and timestamp, a block's followed by its height, and a peer's struct
+static UInt256 bwmTestTxIdentifier(BRFileServiceContext context, BRFileService fs, const void *entity)
+{
+    return ((const BRTransaction *)entity)->txHash;
+}
+
+static uint8_t *bwmTestTxV1Writer(BRFileServiceContext context, BRFileService fs, const void *entity,
+                                  uint32_t *bytesCount)
+{
+    const BRTransaction *tx = entity;
+    size_t len = BRTransactionSerialize(tx, NULL, 0);
+    uint8_t *bytes = malloc(len + sizeof(uint32_t)*2);
+
+    BRTransactionSerialize(tx, bytes, len);
+    UInt32SetLE(&bytes[len], tx->blockHeight);
+    UInt32SetLE(&bytes[len + sizeof(uint32_t)], tx->timestamp);
+    *bytesCount = (uint32_t)(len + sizeof(uint32_t)*2);
+    return bytes;
+}
+
+static UInt256 bwmTestBlockIdentifier(BRFileServiceContext context, BRFileService fs, const void *entity)
+{
+    return ((const BRMerkleBlock *)entity)->blockHash;
+}
+
+static uint8_t *bwmTestBlockV1Writer(BRFileServiceContext context, BRFileService fs, const void *entity,
+                                     uint32_t *bytesCount)
+{
+    const BRMerkleBlock *block = entity;
+    size_t len = BRMerkleBlockSerialize(block, NULL, 0);
+    uint8_t *bytes = malloc(len + sizeof(uint32_t));
+
+    BRMerkleBlockSerialize(block, bytes, len);
+    UInt32SetLE(&bytes[len], block->height);
+    *bytesCount = (uint32_t)(len + sizeof(uint32_t));
+    return bytes;
+}
+
+static UInt256 bwmTestPeerV1Identifier(BRFileServiceContext context, BRFileService fs, const void *entity)
+{
+    UInt256 hash;
+
+    BRSHA256(&hash, entity, offsetof(BRPeer, pingTime));
+    return hash;
+}
+
+static uint8_t *bwmTestPeerV1Writer(BRFileServiceContext context, BRFileService fs, const void *entity,
+                                    uint32_t *bytesCount)
+{
+    *bytesCount = sizeof(BRPeer);
+    return memcpy(malloc(sizeof(BRPeer)), entity, sizeof(BRPeer));
+}
+
+static void *bwmTestPeerV1Reader(BRFileServiceContext context, BRFileService fs, uint8_t *bytes, uint32_t bytesCount)
+{
+    BRPeer *peer = calloc(1, sizeof(*peer));
+
+    memcpy(peer, bytes, offsetof(BRPeer, pingTime));
+    peer->flags = 1;
+    return peer;
+}
+
+// the V3 peer format: the address and port, then services, timestamp, pingTime and blockRate as LEB128 varints
+static void *bwmTestPeerV3Reader(BRFileServiceContext context, BRFileService fs, uint8_t *bytes, uint32_t bytesCount)
+{
+    BRPeer *peer = calloc(1, sizeof(*peer));
+    uint64_t fields[4] = { 0 };
+    size_t off = sizeof(UInt128) + sizeof(uint16_t);
+
+    memcpy(&peer->address, bytes, sizeof(UInt128));
+    peer->port = UInt16GetLE(&bytes[sizeof(UInt128)]);
+
+    for (size_t i = 0; i < 4 && off < bytesCount; i++) {
+        for (unsigned shift = 0; off < bytesCount && shift < 64; shift += 7) {
+            fields[i] |= (uint64_t)(bytes[off] & 0x7f) << shift;
+            if ((bytes[off++] & 0x80) == 0) break;
+        }
+    }
+
+    peer->services = fields[0], peer->timestamp = fields[1];
+    peer->pingTime = (uint32_t)fields[2], peer->blockRate = (uint32_t)fields[3];
+    peer->flags = (off == bytesCount) ? 3 : 0;
+    return peer;
+}
+
+static size_t bwmTestPtrHash(const void *item)
+{
+    return (size_t)item;
+}
+
+static int bwmTestPtrEq(const void *item, const void *other)
+{
+    return (item == other);
+}
+
+static void *bwmTestNoReader(BRFileServiceContext context, BRFileService fs, uint8_t *bytes, uint32_t bytesCount)
+{
+    return NULL;
+}
+
+static void bwmTestTxEvent(BRWalletManager manager, BRWallet *wallet, BRTransaction *tx, BRTransactionEvent event)
+{
+}
+
+static void bwmTestWalletEvent(BRWalletManager manager, BRWallet *wallet, BRWalletEvent event)
+{
+}
+
+static void bwmTestManagerEvent(BRWalletManager manager, BRWalletManagerEvent event)
+{
+}
+
+static int bwmTestRemove(const char *path, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+    return remove(path);
+}
+
+// true if manager loaded txs, whose wallet was w, and block exactly as they were saved
+static int bwmTestLoaded(BRWalletManager manager, BRWallet *w, const UInt256 txHashes[], size_t txCount,
+                         const BRMerkleBlock *block)
+{
+    BRWallet *wallet = BRWalletManagerGetWallet(manager);
+    BRPeerManager *pm = BRWalletManagerGetPeerManager(manager);
+    int r = (BRWalletTransactions(wallet, NULL, 0) == txCount && BRWalletBalance(wallet) == BRWalletBalance(w));
+
+    for (size_t i = 0; r && i < txCount; i++) {
+        BRTransaction *tx = BRWalletTransactionForHash(wallet, txHashes[i]),
+                      *t = BRWalletTransactionForHash(w, txHashes[i]);
+        size_t len = (tx) ? BRTransactionSerialize(tx, NULL, 0) : 0;
+        uint8_t buf[len], buf2[len];
+
+        r = (tx && t && len == BRTransactionSerialize(t, NULL, 0) && tx->blockHeight == t->blockHeight &&
+             tx->timestamp == t->timestamp && BRTransactionSerialize(tx, buf, len) == len &&
+             BRTransactionSerialize(t, buf2, len) == len && memcmp(buf, buf2, len) == 0);
+    }
+
+    return (r && BRPeerManagerLastBlockHeight(pm) == block->height &&
+            BRPeerManagerLastBlockTimestamp(pm) == block->timestamp);
+}
+
+int BRWalletManagerTests()
+{
+    int r = 1;
+    const BRChainParams *params = BRMainNetParams;
+    const char *currency = "btc", *network = "mainnet"; // as BRWalletManagerNew() names the BRMainNetParams store
+    char path[] = "/tmp/BRWalletManagerTestsXXXXXX";
+    UInt512 seed;
+
+    BRBIP39DeriveKey(&seed, "a random seed", NULL);
+
+    BRMasterPubKey mpk = BRBIP32MasterPubKey(&seed, sizeof(seed));
+    BRWalletManagerClient client = { bwmTestTxEvent, bwmTestWalletEvent, bwmTestManagerEvent };
+    BRWallet *w = BRWalletNew(NULL, 0, mpk, 0);
+    UInt256 secret = uint256("0000000000000000000000000000000000000000000000000000000000000001"),
+            inHash = uint256("0000000000000000000000000000000000000000000000000000000000000001"),
+            txHashes[2];
+    BRAddress addr, recvAddr = BRWalletReceiveAddress(w), legacyAddr = BRWalletLegacyAddress(w);
+    BRKey k;
+
+    BRKeySetSecret(&k, &secret, 1);
+    BRKeyAddress(&k, addr.s, sizeof(addr));
+
+    uint8_t inScript[BRAddressScriptPubKey(NULL, 0, addr.s)];
+    size_t inScriptLen = BRAddressScriptPubKey(inScript, sizeof(inScript), addr.s);
+    uint8_t recvScript[BRAddressScriptPubKey(NULL, 0, recvAddr.s)];
+    size_t recvScriptLen = BRAddressScriptPubKey(recvScript, sizeof(recvScript), recvAddr.s);
+    uint8_t legacyScript[BRAddressScriptPubKey(NULL, 0, legacyAddr.s)];
+    size_t legacyScriptLen = BRAddressScriptPubKey(legacyScript, sizeof(legacyScript), legacyAddr.s);
+    uint8_t p2sh[23] = { 0xa9, 0x14 }, p2wsh[34] = { 0x00, 0x20 }, opReturn[] = { 0x6a, 0x03, 'b', 'r', 'd' };
+
+    p2sh[22] = 0x87;
+    memset(&p2sh[2], 0x5a, 20);
+    memset(&p2wsh[2], 0xa5, 32);
+
+    // pays each output script template, and a script matching none, all packed by the V2 transaction writer
+    BRTransaction *tx = BRTransactionNew(), *tx2;
+
+    BRTransactionAddInput(tx, inHash, 0, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    BRTransactionAddOutput(tx, SATOSHIS, recvScript, recvScriptLen);
+    BRTransactionAddOutput(tx, SATOSHIS, legacyScript, legacyScriptLen);
+    BRTransactionAddOutput(tx, 10000, p2sh, sizeof(p2sh));
+    BRTransactionAddOutput(tx, 10000, p2wsh, sizeof(p2wsh));
+    BRTransactionAddOutput(tx, 0, opReturn, sizeof(opReturn));
+    BRTransactionSign(tx, 0, &k, 1);
+    tx->blockHeight = 500000, tx->timestamp = 1500000000;
+    txHashes[0] = tx->txHash;
+    BRWalletRegisterTransaction(w, tx);
+    tx2 = BRWalletCreateTransaction(w, SATOSHIS + SATOSHIS/2, addr.s); // spends both wallet outputs, with a witness
+    if (tx2) BRWalletSignTransaction(w, tx2, &seed, sizeof(seed));
+    if (tx2) BRWalletRegisterTransaction(w, tx2);
+    if (tx2) BRWalletUpdateTransactions(w, &tx2->txHash, 1, 500001, 1500000600);
+    if (tx2) txHashes[1] = tx2->txHash;
+
+    if (! tx2 || ! BRTransactionIsSigned(tx2) || BRWalletTransactions(w, NULL, 0) != 2)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletManagerNew() test 0\n", __func__);
+
+    // a merkleblock, above the last checkpoint so its tx hashes are kept, at a difficulty transition to start the chain
+    const BRCheckPoint *checkpoint = &params->checkpoints[params->checkpointsCount - 1];
+    BRMerkleBlock *b = BRMerkleBlockNew(), *block;
+    UInt256 hashes[2] = { inHash, secret };
+    uint8_t flags[] = { 0x1d }, buf[1024];
+
+    b->version = 2, b->prevBlock = inHash, b->merkleRoot = secret, b->timestamp = 1500001200;
+    b->target = 0x1d00ffff, b->nonce = 7, b->totalTx = 3;
+    BRMerkleBlockSetTxHashes(b, hashes, 2, flags, sizeof(flags));
+    block = BRMerkleBlockParse(buf, BRMerkleBlockSerialize(b, buf, sizeof(buf)));
+    BRMerkleBlockFree(b);
+    if (block) block->height = (checkpoint->height/2016 + 1)*2016;
+
+    BRPeer peer, *peers[4];
+
+    memset(&peer, 0, sizeof(peer)); // V1 writes the struct, padding and all
+    peer.address.u16[5] = 0xffff; // IPv4 mapped 127.0.0.1
+    peer.address.u32[3] = htonl(0x7f000001);
+    peer.port = 8333, peer.services = SERVICES_NODE_NETWORK, peer.timestamp = 1500000000;
+
+    // the V1 store, as a wallet manager from before the packed formats left it
+    BRFileService fs = (mkdtemp(path)) ? fileServiceCreate(path, currency, network, NULL, NULL) : NULL;
+
+    if (! fs || ! block ||
+        1 != fileServiceDefineType(fs, "transactions", 0, NULL, bwmTestTxIdentifier, bwmTestNoReader,
+                                   bwmTestTxV1Writer) ||
+        1 != fileServiceDefineCurrentVersion(fs, "transactions", 0) ||
+        1 != fileServiceDefineType(fs, "blocks", 0, NULL, bwmTestBlockIdentifier, bwmTestNoReader,
+                                   bwmTestBlockV1Writer) ||
+        1 != fileServiceDefineCurrentVersion(fs, "blocks", 0) ||
+        1 != fileServiceDefineType(fs, "peers", 0, NULL, bwmTestPeerV1Identifier, bwmTestPeerV1Reader,
+                                   bwmTestPeerV1Writer) ||
+        1 != fileServiceDefineCurrentVersion(fs, "peers", 0)) {
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletManagerNew() test 1\n", __func__);
+        if (fs) fileServiceRelease(fs);
+        fs = NULL;
+    }
+
+    if (fs) {
+        fileServiceSave(fs, "transactions", tx);
+        if (tx2) fileServiceSave(fs, "transactions", tx2);
+        fileServiceSave(fs, "blocks", block);
+        fileServiceSave(fs, "peers", &peer);
+        fileServiceRelease(fs);
+    }
+
+    // V1 records are read, and rewritten as transaction and block V2 and peer V3 records
+    BRWalletManager manager = (tx2 && block) ? BRWalletManagerNew(client, mpk, params, 1500000000, path) : NULL;
+
+    if (! manager || ! bwmTestLoaded(manager, w, txHashes, 2, block))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletManagerNew() test 2\n", __func__);
+
+    if (manager) BRWalletManagerFree(manager);
+
+    // the V2 and V3 records are read back
+    manager = (tx2 && block) ? BRWalletManagerNew(client, mpk, params, 1500000000, path) : NULL;
+
+    if (! manager || ! bwmTestLoaded(manager, w, txHashes, 2, block))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletManagerNew() test 3\n", __func__);
+
+    if (manager) BRWalletManagerFree(manager);
+
+    // the peer survived its V3 read, and its V3 record matches
+    BRSet *peerSet = BRSetNew(bwmTestPtrHash, bwmTestPtrEq, 4); // by pointer, so a duplicate record would show
+    size_t peersCount = 0, found = 0;
+
+    fs = fileServiceCreate(path, currency, network, NULL, NULL);
+    if (fs && 1 == fileServiceDefineType(fs, "peers", 0, NULL, bwmTestPeerV1Identifier, bwmTestPeerV1Reader,
+                                         bwmTestPeerV1Writer) &&
+        1 == fileServiceDefineType(fs, "peers", 2, NULL, bwmTestPeerV1Identifier, bwmTestPeerV3Reader,
+                                   bwmTestPeerV1Writer) &&
+        1 == fileServiceDefineCurrentVersion(fs, "peers", 0) && 1 == fileServiceLoad(fs, peerSet, "peers", 0)) {
+        peersCount = BRSetAll(peerSet, (void **)peers, 4);
+    }
+
+    for (size_t i = 0; i < peersCount; i++) {
+        if (peers[i]->flags == 3 && BRPeerEq(peers[i], &peer) && peers[i]->services == peer.services &&
+            peers[i]->timestamp == peer.timestamp) found++;
+        free(peers[i]);
+    }
+
+    if (found != 1 || peersCount != 1)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletManagerNew() test 4\n", __func__);
+
+    if (fs) fileServiceRelease(fs);
+    BRSetFree(peerSet);
+    if (block) BRMerkleBlockFree(block);
+    BRWalletFree(w);
+    nftw(path, bwmTestRemove, 64, FTW_DEPTH | FTW_PHYS);
     return r;
 }
 
@@ -2891,6 +4613,10 @@ int BRRunTests()
     printf("%s\n", (BRArrayTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRSetTests...                       ");
     printf("%s\n", (BRSetTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("BRConcurrentSetTests...             ");
+    printf("%s\n", (BRConcurrentSetTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("BRThreadPoolTests...                ");
+    printf("%s\n", (BRThreadPoolTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRBase58Tests...                    ");
     printf("%s\n", (BRBase58Tests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRBech32Tests...                    ");
@@ -2909,6 +4635,8 @@ int BRRunTests()
     printf("%s\n", (BRAuthEncryptTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRAesTests...                       ");
     printf("%s\n", (BRAesTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("BRScryptTests...                    ");
+    printf("%s\n", (BRScryptTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRKeyTests...                       ");
     printf("%s\n", (BRKeyTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRBIP38KeyTests...                  ");
@@ -2933,10 +4661,16 @@ int BRRunTests()
     printf("%s\n", (BRBloomFilterTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRMerkleBlockTests...               ");
     printf("%s\n", (BRMerkleBlockTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("BRPeerTests...                      ");
+    printf("%s\n", (BRPeerTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("BRChainParamsTests...               ");
+    printf("%s\n", (BRChainParamsTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRPaymentProtocolTests...           ");
     printf("%s\n", (BRPaymentProtocolTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRPaymentProtocolEncryptionTests... ");
     printf("%s\n", (BRPaymentProtocolEncryptionTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("BRWalletManagerTests...             ");
+    printf("%s\n", (BRWalletManagerTests()) ? "success" : (fail++, "***FAIL***"));
     printf("\n");
     
     if (fail > 0) printf("%d TEST FUNCTION(S) ***FAILED***\n", fail);
@@ -11,7 +11,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
-#include <ctype.h>
 #include "support/BRCrypto.h"
 #include "BREthereumBase.h"
 #include "BREthereumAddress.h"
@@ -21,12 +20,13 @@
 //
 extern BREthereumAddress
 addressCreate (const char *address) {
-    if (ETHEREUM_BOOLEAN_IS_FALSE(addressValidateString(address))) return EMPTY_ADDRESS_INIT;
-
     BREthereumAddress raw;
-    if (0 == strncmp ("0x", address, 2)) address = &address[2];
-    decodeHex(raw.bytes, sizeof(raw.bytes), address, strlen(address));
-    return raw;
+
+    // Validate and decode in one pass; equivalent to addressValidateString() then decodeHex().
+    return (NULL != address && '0' == address[0] && 'x' == address[1] &&
+            decodeHexChecked (raw.bytes, sizeof(raw.bytes), &address[2], strnlen (&address[2], 41))
+            ? raw
+            : (BREthereumAddress) EMPTY_ADDRESS_INIT);
 }
 
 extern BREthereumBoolean
@@ -130,8 +130,7 @@ addressFillEncodedString (BREthereumAddress address,
     // We'll checksum address->string but while avoiding the '0x' prefix
     uint8_t hash[32];
     char *checksumAddr = &string[2];
-    size_t checksumAddrLen = strlen(checksumAddr);
-    assert (checksumAddrLen < 2 * sizeof(hash));
+    size_t checksumAddrLen = 2 * sizeof (address.bytes);
 
     // Ethereum 'SHA3' is actually Keccak256
     BRKeccak256(hash, checksumAddr, checksumAddrLen);
@@ -139,11 +138,11 @@ addressFillEncodedString (BREthereumAddress address,
     for (int i = 0; i < checksumAddrLen; i++) {
         // We should hex-encode the hash and then look character by character.  Instead
         // we'll extract 4 bits as the upper or lower nibble and compare to 8.  This is the
-        // same extracting that encodeHex performs, ultimately.
+        // same extracting that encodeHex performs, ultimately.  As encodeHex() produces lower
+        // case, only the 'a' - 'f' characters need changing, and only to upper case.
         int value = 0x0f & (hash[i / 2] >> ((0 == i % 2) ? 4 : 0));
-        checksumAddr[i] = (value < 8
-                           ? (char) tolower(checksumAddr[i])
-                           : (char) toupper(checksumAddr[i]));
+        if (value >= 8 && checksumAddr[i] >= 'a')
+            checksumAddr[i] -= 'a' - 'A';
     }
 }
 
@@ -25,11 +25,11 @@ extern BREthereumHash
 hashCreate (const char *string) {
     if (NULL == string || '\0' == string[0] || 0 == strcmp (string, "0x")) return hashCreateEmpty();
 
-    assert (0 == strncmp (string, "0x", 2)
-            && (2 + 2 * ETHEREUM_HASH_BYTES) == strlen (string));
-
     BREthereumHash hash;
-    decodeHex(hash.bytes, ETHEREUM_HASH_BYTES, &string[2], 2 * ETHEREUM_HASH_BYTES);
+    int valid = ('0' == string[0] && 'x' == string[1] &&
+                 decodeHexChecked (hash.bytes, ETHEREUM_HASH_BYTES,
+                                   &string[2], strnlen (&string[2], 2 * ETHEREUM_HASH_BYTES + 1)));
+    assert (valid); (void) valid;
     return hash;
 }
 
@@ -126,6 +126,51 @@ signatureExtractAddress(const BREthereumSignature signature,
             : addressCreateKey(&key));
 }
 
+extern size_t
+signatureExtractAddressBatch (const BREthereumSignature *signatures,
+                              const uint8_t **bytes,
+                              const size_t *bytesCounts,
+                              size_t count,
+                              BREthereumAddress *addresses,
+                              int *successes) {
+    assert (NULL != successes || 0 == count);
+    if (0 == count) return 0;
+
+    BRKey *keys = calloc (count, sizeof (BRKey));
+    UInt256 *digests = calloc (count, sizeof (UInt256));
+    const void **sigs = calloc (count, sizeof (void *));
+    int *ethereum = calloc (count, sizeof (int));
+
+    for (size_t index = 0; index < count; index++) {
+        BRKeccak256 (&digests[index], bytes[index], bytesCounts[index]);
+
+        switch (signatures[index].type) {
+            case SIGNATURE_TYPE_RECOVERABLE_VRS_EIP:
+                sigs[index] = &signatures[index].sig.vrs;
+                ethereum[index] = 0;
+                break;
+            case SIGNATURE_TYPE_RECOVERABLE_RSV:
+                sigs[index] = &signatures[index].sig.rsv;
+                ethereum[index] = 1;
+                break;
+        }
+    }
+
+    size_t extracted = BRKeyRecoverPubKeyBatch (successes, keys, digests, sigs, ethereum, count, 0);
+
+    for (size_t index = 0; index < count; index++)
+        addresses[index] = (0 == successes[index]
+                            ? (BREthereumAddress) EMPTY_ADDRESS_INIT
+                            : addressCreateKey(&keys[index]));
+
+    free (ethereum);
+    free (sigs);
+    free (digests);
+    free (keys);
+
+    return extracted;
+}
+
 extern void
 signatureClear (BREthereumSignature *s,
                 BREthereumSignatureType type) {
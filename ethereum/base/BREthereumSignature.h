@@ -92,6 +92,19 @@ signatureExtractAddress (const BREthereumSignature signature,
                          size_t bytesCount,
                          int *success);
 
+/**
+ * Extract the addresses for `count` signatures, as signatureExtractAddress(), filling `addresses`
+ * and `successes`.  The public key recoveries, which dominate, run in parallel with one thread per
+ * cpu.  Returns the number of addresses extracted.
+ */
+extern size_t
+signatureExtractAddressBatch (const BREthereumSignature *signatures,
+                              const uint8_t **bytes,
+                              const size_t *bytesCounts,
+                              size_t count,
+                              BREthereumAddress *addresses,
+                              int *successes);
+
 extern BREthereumBoolean
 signatureEqual (BREthereumSignature s1, BREthereumSignature s2);
 
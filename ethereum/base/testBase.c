@@ -7,6 +7,8 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "support/BRCrypto.h"
 #include "BREthereumBase.h"
@@ -224,8 +226,45 @@ void runSignatureTests (void) {
     runSignatureTests2();
 }
 
+static void
+runAddressTests (void) {
+    printf ("\n== Address\n");
+
+    // From the EIP-55 checksum example in BREthereumAddress.c
+    BREthereumAddress address = addressCreate ("0xa9de3dbd7d561e67527bc1ecb025c59d53b9f7ef");
+    assert (ETHEREUM_BOOLEAN_IS_TRUE (addressEqual (address,
+                                                    addressCreate ("0xa9de3dbD7d561e67527bC1Ecb025c59D53b9F7Ef"))));
+
+    char *string = addressGetEncodedString (address, 1);
+    assert (0 == strcmp (string, "0xa9de3dbD7d561e67527bC1Ecb025c59D53b9F7Ef"));
+    free (string);
+
+    string = addressGetEncodedString (address, 0);
+    assert (0 == strcmp (string, "0xa9de3dbd7d561e67527bc1ecb025c59d53b9f7ef"));
+    free (string);
+
+    // Invalid strings produce the empty address
+    BREthereumAddress empty = EMPTY_ADDRESS_INIT;
+    const char *invalid[] = {
+        "0xa9de3dbd7d561e67527bc1ecb025c59d53b9f7e",
+        "0xa9de3dbd7d561e67527bc1ecb025c59d53b9f7eff",
+        "0xa9de3dbd7d561e67527bc1ecb025c59d53b9f7eg",
+        "00a9de3dbd7d561e67527bc1ecb025c59d53b9f7ef",
+        ""
+    };
+    for (size_t index = 0; index < sizeof (invalid) / sizeof (char *); index++)
+        assert (ETHEREUM_BOOLEAN_IS_TRUE (addressEqual (empty, addressCreate (invalid[index]))));
+
+    const char *hashString = "0xd4e56740f876aef8c010b86a40d5f56745a118d0906a34e69aec8c0db1cb8fa3";
+    BREthereumHash hash = hashCreate (hashString);
+    BREthereumHashString hashFilled;
+    hashFillString (hash, hashFilled);
+    assert (0 == strcmp (hashString, hashFilled));
+}
+
 extern void
 runBaseTests () {
     runEtherParseTests();
     runSignatureTests();
+    runAddressTests();
 }
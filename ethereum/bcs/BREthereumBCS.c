@@ -12,6 +12,7 @@
 #include <stdarg.h>
 #include "support/BRArray.h"
 #include "support/BRSet.h"
+#include "support/BRStats.h"
 #include "BREthereumBCSPrivate.h"
 
 #define BCS_TRANSACTION_CHECK_STATUS_SECONDS   (7)
@@ -45,11 +46,20 @@
 static inline uint64_t maximum (uint64_t a, uint64_t b) { return a > b ? a : b; }
 #pragma clang diagnostic pop
 
+/// If TRUE, BCS instances share one LES per network; see bcsSetSharedLES()
+static BREthereumBoolean bcsSharedLES = ETHEREUM_BOOLEAN_FALSE;
+
 /* Forward Declarations */
 static void
 bcsPeriodicDispatcher (BREventHandler handler,
                        BREventTimeout *event);
 
+static void
+bcsUpdateMemoryUsage (BREthereumBCS bcs);
+
+static void
+bcsQueryLogsRelease (BREthereumBCSLogQuery query);
+
 static void
 bcsExtendChain (BREthereumBCS bcs,
                 BREthereumBlock block,
@@ -87,6 +97,96 @@ syncInterestsCreate (int count, /* BREthereumSyncInterest*/ ...) {
     return interests;
 }
 
+/// MARK: - Subscriptions
+
+// Support BRSet; a subscription (or an address, its first field) hashes as its address.
+static size_t
+bcsSubscriptionHashValue (const void *s) {
+    return addressHashValue (((const BREthereumBCSSubscription*) s)->address);
+}
+
+static int
+bcsSubscriptionHashEqual (const void *s1, const void *s2) {
+    return s1 == s2 || addressHashEqual (((const BREthereumBCSSubscription*) s1)->address,
+                                         ((const BREthereumBCSSubscription*) s2)->address);
+}
+
+// Every transaction and log for an address other than `bcs->address` comes from the BRD backend.
+static BREthereumSyncInterestSet
+bcsSubscriptionInterests (void) {
+    return syncInterestsCreate (4,
+                                CLIENT_GET_BLOCKS_LOGS_AS_SOURCE,
+                                CLIENT_GET_BLOCKS_LOGS_AS_TARGET,
+                                CLIENT_GET_BLOCKS_TRANSACTIONS_AS_SOURCE,
+                                CLIENT_GET_BLOCKS_TRANSACTIONS_AS_TARGET);
+}
+
+/**
+ * Recreate `filterForAddresses` from `subscriptions`.  Only on the BCS thread, or in bcsCreate().
+ */
+static void
+bcsUpdateAddressFilters (BREthereumBCS bcs) {
+    size_t addressesCount = BRSetCount (bcs->subscriptions);
+    BREthereumAddress *addresses = calloc (addressesCount + 1, sizeof (BREthereumAddress));
+
+    size_t index = 0;
+    FOR_SET (BREthereumBCSSubscription*, subscription, bcs->subscriptions)
+        addresses[index++] = subscription->address;
+
+    if (NULL != bcs->filterForAddresses) bloomFilterSetRelease (bcs->filterForAddresses);
+    bcs->filterForAddresses = blockAddressesFiltersCreate (addresses, addressesCount);
+
+    // With P2P blocks, have LES prefetch the blocks that we'll ask for on an announce.
+    if (NULL != bcs->les && (P2P_ONLY == bcs->mode || P2P_WITH_BRD_SYNC == bcs->mode))
+        lesSetPrefetchFilters (bcs->les,
+                               (BREthereumLESCallbackContext) bcs,
+                               blockAddressesFiltersCreate (addresses, addressesCount));
+
+    free (addresses);
+}
+
+static BREthereumBoolean
+bcsHasAddress (BREthereumBCS bcs,
+               BREthereumAddress address) {
+    return AS_ETHEREUM_BOOLEAN (NULL != BRSetGet (bcs->subscriptions, &address));
+}
+
+/**
+ * Check if `transaction` has any tracked address as its source or target.
+ */
+static BREthereumBoolean
+bcsTransactionHasAddresses (BREthereumBCS bcs,
+                            BREthereumTransaction transaction) {
+    return AS_ETHEREUM_BOOLEAN
+    (ETHEREUM_BOOLEAN_IS_TRUE (bcsHasAddress (bcs, transactionGetSourceAddress (transaction))) ||
+     ETHEREUM_BOOLEAN_IS_TRUE (bcsHasAddress (bcs, transactionGetTargetAddress (transaction))));
+}
+
+/**
+ * Check if `log` has any tracked address as a topic.  An address topic is the address left-padded
+ * with twelve zero bytes.
+ */
+static BREthereumBoolean
+bcsLogHasAddresses (BREthereumBCS bcs,
+                    BREthereumLog log) {
+    static const uint8_t padding[12] = { 0 };
+
+    size_t count = logGetTopicsCount (log);
+    for (size_t index = 0; index < count; index++) {
+        BREthereumLogTopic topic = logGetTopic (log, index);
+        if (0 == memcmp (topic.bytes, padding, sizeof (padding)) &&
+            ETHEREUM_BOOLEAN_IS_TRUE (bcsHasAddress (bcs, logTopicAsAddress (topic))))
+            return ETHEREUM_BOOLEAN_TRUE;
+    }
+    return ETHEREUM_BOOLEAN_FALSE;
+}
+
+// Order blocks by {blockNumber, timestamp}; BREthereumComparison is {-1, 0, +1}
+static int
+bcsCreateInitializeBlocksCompare (const void *b1, const void *b2) {
+    return (int) blockHeaderCompare (blockGetHeader (*(BREthereumBlock *) b1),
+                                     blockGetHeader (*(BREthereumBlock *) b2));
+}
 
 /**
  */
@@ -112,7 +212,9 @@ bcsCreateInitializeBlocks (BREthereumBCS bcs,
     BREthereumBlock sortedBlocks[sortedBlocksCount];
     BRSetAll(blocks, (void**) sortedBlocks, sortedBlocksCount);
 
-    // TODO: Sort
+    // A saved header store adds a dense run of blocks back to a CHT root; chaining requires
+    // them in order.
+    qsort (sortedBlocks, sortedBlocksCount, sizeof (BREthereumBlock), bcsCreateInitializeBlocksCompare);
 
     for (int i = 0; i < sortedBlocksCount; i++) {
         // Skip block `i` if its blockNumber equals the blockNumber of `i+1`.
@@ -180,9 +282,11 @@ bcsCreate (BREthereumNetwork network,
            OwnershipGiven BRSetOf(BREthereumNodeConfig) peers,
            OwnershipGiven BRSetOf(BREthereumBlock) blocks,
            OwnershipGiven BRSetOf(BREthereumTransaction) transactions,
-           OwnershipGiven BRSetOf(BREthereumLog) logs) {
+           OwnershipGiven BRSetOf(BREthereumLog) logs,
+           BRFileService fs) {
 
     BREthereumBCS bcs = (BREthereumBCS) calloc (1, sizeof(struct BREthereumBCSStruct));
+    pthread_mutex_init (&bcs->memoryLock, NULL);
 
     bcs->network = network;
     bcs->address = address;
@@ -192,8 +296,29 @@ bcsCreate (BREthereumNetwork network,
     bcs->filterForAddressOnTransactions = bloomFilterCreateAddress(bcs->address);
     bcs->filterForAddressOnLogs = logTopicGetBloomFilterAddress(bcs->address);
 
+    // Track `address` itself, with no subscriber, alongside any added with bcsAddAddress().
+    pthread_mutex_init (&bcs->subscriptionsLock, NULL);
+    bcs->subscriptions = BRSetNew (bcsSubscriptionHashValue,
+                                   bcsSubscriptionHashEqual,
+                                   BCS_SUBSCRIPTIONS_INITIAL_CAPACITY);
+
+    BREthereumBCSSubscription *subscription = calloc (1, sizeof (BREthereumBCSSubscription));
+    subscription->address = address;
+    BRSetAdd (bcs->subscriptions, subscription);
+
+    bcs->filterForAddresses = NULL;
+    bcsUpdateAddressFilters (bcs);
+
+    array_new (bcs->logQueries, 2);
+
+    bcs->gasPriceEstimator = BRFeeEstimatorNew (BCS_GAS_PRICE_ESTIMATE_MIN_WEI,
+                                                BCS_GAS_PRICE_ESTIMATE_MAX_WEI);
+
     bcs->listener = listener;
 
+    // Proof of work, with epoch caches persisted in `fs`.  Create it before `chain` is extended.
+    bcs->pow = proofOfWorkCreate (fs);
+
     //
     // Initialize the `headers`, `chain, and `orphans`
     //
@@ -221,7 +346,9 @@ bcsCreate (BREthereumNetwork network,
     // Initialize `pendingTransactions`
     //
     array_new (bcs->pendingTransactions, BCS_PENDING_TRANSACTION_INITIAL_CAPACITY);
+    array_new (bcs->pendingTransactionPolls, BCS_PENDING_TRANSACTION_INITIAL_CAPACITY);
     array_new (bcs->pendingLogs, BCS_PENDING_LOGS_INITIAL_CAPACITY);
+    bcs->pendingCycle = 0;
 
     // Our genesis block.
     bcs->genesis = networkGetGenesisBlock(network);
@@ -249,6 +376,7 @@ bcsCreate (BREthereumNetwork network,
     bcsCreateInitializeBlocks(bcs, blocks);
     bcsCreateInitializeTransactions(bcs, transactions);
     bcsCreateInitializeLogs(bcs, logs);
+    bcsUpdateMemoryUsage (bcs);
 
     // Initialize LES and SYNC - we must create LES from a block where the totalDifficulty is
     // computed.  In practice, we need all the blocks from bcs->chain back to a checkpoint - and
@@ -265,6 +393,9 @@ bcsCreate (BREthereumNetwork network,
         chainHeader = blockCheckpointCreatePartialBlockHeader(checkpoint);
     }
 
+    // Start on the proof of work caches for where we expect headers to arrive.
+    proofOfWorkGenerate (bcs->pow, chainHeader);
+
     // There is no need to discover nodes if we are in BRD_ONLY mode.
     BREthereumBoolean discoverNodes = AS_ETHEREUM_BOOLEAN (mode != BRD_ONLY);
 #if defined (LES_DISABLE_DISCOVERY)
@@ -274,22 +405,43 @@ bcsCreate (BREthereumNetwork network,
     BREthereumBoolean handleSync = AS_ETHEREUM_BOOLEAN (P2P_ONLY == mode ||
                                                         P2P_WITH_BRD_SYNC == mode);
 
-    bcs->les = lesCreate (bcs->network,
+    bcs->lesIsShared = bcsSharedLES;
+
+    if (ETHEREUM_BOOLEAN_IS_TRUE (bcs->lesIsShared)) {
+        bcs->les = lesCreateShared (bcs->network,
+                                    blockHeaderGetHash(chainHeader),
+                                    blockHeaderGetNumber(chainHeader),
+                                    totalDifficulty,
+                                    blockGetHash (bcs->genesis),
+                                    peers,
+                                    discoverNodes,
+                                    handleSync);
+        lesAddSubscriber (bcs->les,
                           (BREthereumLESCallbackContext) bcs,
                           (BREthereumLESCallbackAnnounce) bcsSignalAnnounce,
                           (BREthereumLESCallbackStatus) bcsSignalStatus,
-                          (BREthereumLESCallbackSaveNodes) bcsSignalNodes,
-                          blockHeaderGetHash(chainHeader),
-                          blockHeaderGetNumber(chainHeader),
-                          totalDifficulty,
-                          blockGetHash (bcs->genesis),
-                          peers,
-                          discoverNodes,
-                          handleSync);
+                          (BREthereumLESCallbackSaveNodes) bcsSignalNodes);
+    }
+    else
+        bcs->les = lesCreate (bcs->network,
+                              (BREthereumLESCallbackContext) bcs,
+                              (BREthereumLESCallbackAnnounce) bcsSignalAnnounce,
+                              (BREthereumLESCallbackStatus) bcsSignalStatus,
+                              (BREthereumLESCallbackSaveNodes) bcsSignalNodes,
+                              blockHeaderGetHash(chainHeader),
+                              blockHeaderGetNumber(chainHeader),
+                              totalDifficulty,
+                              blockGetHash (bcs->genesis),
+                              peers,
+                              discoverNodes,
+                              handleSync);
 
     if (chainHeader != blockGetHeader(bcs->chain))
         blockHeaderRelease(chainHeader);
 
+    // Now with `les`, set its prefetch filters.
+    bcsUpdateAddressFilters (bcs);
+
     bcs->sync = bcsSyncCreate ((BREthereumBCSSyncContext) bcs,
                                (BREthereumBCSSyncReportBlocks) bcsSyncReportBlocksCallback,
                                (BREthereumBCSSyncReportProgress) bcsSyncReportProgressCallback,
@@ -297,11 +449,14 @@ bcsCreate (BREthereumNetwork network,
                                bcs->les,
                                bcs->handler);
 
-    bcs->pow = proofOfWorkCreate();
-
     return bcs;
 }
 
+extern void
+bcsSetSharedLES (BREthereumBoolean shared) {
+    bcsSharedLES = shared;
+}
+
 extern void
 bcsStart (BREthereumBCS bcs) {
     eventHandlerStart(bcs->handler);
@@ -315,7 +470,10 @@ bcsStop (BREthereumBCS bcs) {
     //   a) If we stop LES first, then the BCS thread might add an event to LES
     //   b) If we stop BCS first, then the LES thread might add an event to BCS, as a callback.
     //
-    lesStop (bcs->les);
+    // A shared LES keeps running for the other BCS instances; its callbacks to us will queue
+    // (as they do before bcsStart()) until we are started again or destroyed.
+    if (ETHEREUM_BOOLEAN_IS_FALSE (bcs->lesIsShared))
+        lesStop (bcs->les);
     eventHandlerStop (bcs->handler);
 }
 
@@ -330,8 +488,15 @@ bcsDestroy (BREthereumBCS bcs) {
     if (ETHEREUM_BOOLEAN_IS_TRUE(bcsIsStarted(bcs)))
         bcsStop (bcs);
 
-    lesRelease (bcs->les);
+    // Release `sync` first; it cancels its ranges' outstanding requests with `les`.
     bcsSyncRelease(bcs->sync);
+
+    if (ETHEREUM_BOOLEAN_IS_TRUE (bcs->lesIsShared)) {
+        lesRemoveSubscriber (bcs->les, (BREthereumLESCallbackContext) bcs);
+        lesReleaseShared (bcs->les);
+    }
+    else lesRelease (bcs->les);
+
     proofOfWorkRelease(bcs->pow);
 
     // TODO: We'll need to announce things to our `listener`
@@ -350,12 +515,26 @@ bcsDestroy (BREthereumBCS bcs) {
     
     // pending transactions/logs are in bcs->transactions/logs; thus already released.
     array_free (bcs->pendingTransactions);
+    array_free (bcs->pendingTransactionPolls);
     array_free (bcs->pendingLogs);
 
     bcs->genesis = NULL;
-    
+
+    // Subscriptions
+    BRSetFreeAll (bcs->subscriptions, free);
+    bloomFilterSetRelease (bcs->filterForAddresses);
+    pthread_mutex_destroy (&bcs->subscriptionsLock);
+
+    // Log queries still waiting on receipts are abandoned.
+    for (size_t index = 0; index < array_count (bcs->logQueries); index++)
+        bcsQueryLogsRelease (bcs->logQueries[index]);
+    array_free (bcs->logQueries);
+
+    BRFeeEstimatorFree (bcs->gasPriceEstimator);
+
     // Destroy the Event w/ queue
     eventHandlerDestroy(bcs->handler);
+    pthread_mutex_destroy (&bcs->memoryLock);
     free (bcs);
 }
 
@@ -364,6 +543,153 @@ bcsClean (BREthereumBCS bcs) {
     if (NULL != bcs->les) lesClean (bcs->les);
 }
 
+/**
+ * Count the bytes held by `bcs` blocks, transactions and logs and save the count in
+ * `bcs->memory`.  Must be called on the BCS thread, or before it is started.
+ */
+static void
+bcsUpdateMemoryUsage (BREthereumBCS bcs) {
+    BREthereumBCSMemory memory = { 0 };
+
+    FOR_SET (BREthereumBlock, block, bcs->blocks) {
+        if (NULL != BRSetGet (bcs->orphans, block)) memory.orphans += blockGetMemoryUsage (block);
+        else memory.blocks += blockGetMemoryUsage (block);
+    }
+
+    FOR_SET (BREthereumTransaction, transaction, bcs->transactions)
+        memory.transactions += transactionGetMemoryUsage (transaction);
+
+    FOR_SET (BREthereumLog, log, bcs->logs)
+        memory.logs += logGetMemoryUsage (log);
+
+    memory.other = (sizeof (struct BREthereumBCSStruct) +
+                    BRSetMemoryUsage (bcs->blocks) +
+                    BRSetMemoryUsage (bcs->orphans) +
+                    BRSetMemoryUsage (bcs->transactions) +
+                    BRSetMemoryUsage (bcs->logs) +
+                    BRSetMemoryUsage (bcs->subscriptions) +
+                    BRSetCount (bcs->subscriptions) * sizeof (BREthereumBCSSubscription) +
+                    array_heap_size (bcs->pendingTransactions) +
+                    array_heap_size (bcs->pendingTransactionPolls) +
+                    array_heap_size (bcs->pendingLogs) +
+                    array_heap_size (bcs->logQueries));
+
+    pthread_mutex_lock (&bcs->memoryLock);
+    bcs->memory = memory;
+    pthread_mutex_unlock (&bcs->memoryLock);
+}
+
+extern BREthereumBCSMemory
+bcsGetMemoryUsage (BREthereumBCS bcs) {
+    pthread_mutex_lock (&bcs->memoryLock);
+    BREthereumBCSMemory memory = bcs->memory;
+    pthread_mutex_unlock (&bcs->memoryLock);
+
+    memory.les    = (NULL == bcs->les ? 0 : lesGetMemoryUsage (bcs->les));
+    memory.other += eventHandlerGetMemoryUsage (bcs->handler);
+    memory.total  = (memory.blocks + memory.orphans + memory.transactions + memory.logs +
+                     memory.les + memory.other);
+    return memory;
+}
+
+static UInt256
+bcsFeeEstimatorHash (BREthereumHash hash) {
+    UInt256 value;
+    memcpy (value.u8, hash.bytes, sizeof (value.u8));
+    return value;
+}
+
+/**
+ * The gas price in WEI, saturated at UINT64_MAX - which is far above anything `gasPriceEstimator`
+ * distinguishes anyway.
+ */
+static uint64_t
+bcsFeeEstimatorGasPrice (BREthereumGasPrice gasPrice) {
+    UInt256 wei = gasPrice.etherPerGas.valueInWEI;
+    return (0 == wei.u64[1] && 0 == wei.u64[2] && 0 == wei.u64[3]) ? wei.u64[0] : UINT64_MAX;
+}
+
+extern BREthereumGasPrice
+bcsGetGasPriceEstimate (BREthereumBCS bcs,
+                        uint32_t targetBlocks) {
+    uint64_t wei = BRFeeEstimatorEstimate (bcs->gasPriceEstimator, targetBlocks);
+    return gasPriceCreate (etherCreateNumber (wei, WEI));
+}
+
+extern void
+bcsAddAddress (BREthereumBCS bcs,
+               BREthereumAddress address,
+               BREthereumBCSSubscriber subscriber) {
+    bcsSignalAddAddress (bcs, address, subscriber);
+}
+
+extern void
+bcsRemoveAddress (BREthereumBCS bcs,
+                  BREthereumAddress address) {
+    bcsSignalRemoveAddress (bcs, address);
+}
+
+extern BREthereumBCSSubscriber
+bcsGetAddressSubscriber (BREthereumBCS bcs,
+                         BREthereumAddress address) {
+    pthread_mutex_lock (&bcs->subscriptionsLock);
+    BREthereumBCSSubscription *subscription = BRSetGet (bcs->subscriptions, &address);
+    BREthereumBCSSubscriber subscriber = (NULL == subscription ? NULL : subscription->subscriber);
+    pthread_mutex_unlock (&bcs->subscriptionsLock);
+    return subscriber;
+}
+
+extern void
+bcsHandleAddAddress (BREthereumBCS bcs,
+                     BREthereumAddress address,
+                     BREthereumBCSSubscriber subscriber) {
+    BREthereumBCSSubscription *subscription = BRSetGet (bcs->subscriptions, &address);
+
+    // Already tracked; just update the subscriber.
+    if (NULL != subscription) {
+        pthread_mutex_lock (&bcs->subscriptionsLock);
+        subscription->subscriber = subscriber;
+        pthread_mutex_unlock (&bcs->subscriptionsLock);
+        return;
+    }
+
+    subscription = calloc (1, sizeof (BREthereumBCSSubscription));
+    subscription->address = address;
+    subscription->subscriber = subscriber;
+
+    pthread_mutex_lock (&bcs->subscriptionsLock);
+    BRSetAdd (bcs->subscriptions, subscription);
+    pthread_mutex_unlock (&bcs->subscriptionsLock);
+
+    bcsUpdateAddressFilters (bcs);
+
+    // The 'N-ary' sync only follows `bcs->address`; rely on the BRD backend for the history of
+    // `address`.  Its blocks arrive through bcsReportInterestingBlocks().
+    if (P2P_ONLY == bcs->mode || P2P_WITH_BRD_SYNC == bcs->mode)
+        bcs->listener.getBlocksCallback (bcs->listener.context,
+                                         address,
+                                         bcsSubscriptionInterests (),
+                                         0,
+                                         blockGetNumber (bcs->chain));
+}
+
+extern void
+bcsHandleRemoveAddress (BREthereumBCS bcs,
+                        BREthereumAddress address) {
+    // The primary address drives the account state and the sync; it stays.
+    if (ETHEREUM_BOOLEAN_IS_TRUE (addressEqual (address, bcs->address))) return;
+
+    BREthereumBCSSubscription *subscription = BRSetGet (bcs->subscriptions, &address);
+    if (NULL == subscription) return;
+
+    pthread_mutex_lock (&bcs->subscriptionsLock);
+    BRSetRemove (bcs->subscriptions, subscription);
+    pthread_mutex_unlock (&bcs->subscriptionsLock);
+
+    free (subscription);
+    bcsUpdateAddressFilters (bcs);
+}
+
 static void
 bcsSyncRange (BREthereumBCS bcs,
               BREthereumNodeReference node,
@@ -415,7 +741,17 @@ bcsSyncRange (BREthereumBCS bcs,
                                      blockNumberStart,
                                      blockNumberStop);
 
+    // Other tracked addresses are not covered by the 'N-ary' search; get all their blocks.
+    FOR_SET (BREthereumBCSSubscription*, subscription, bcs->subscriptions)
+        if (ETHEREUM_BOOLEAN_IS_FALSE (addressEqual (subscription->address, bcs->address)))
+            bcs->listener.getBlocksCallback (bcs->listener.context,
+                                             subscription->address,
+                                             bcsSubscriptionInterests (),
+                                             blockNumberStart,
+                                             blockNumberStop);
+
     // Run the 'Search' algorithm -
+    BRStatsCount (BRStatsBCSSyncRanges, 1);
     bcsSyncStart (bcs->sync, node, blockNumberStartAdjusted, blockNumberStop);
 }
 
@@ -506,16 +842,42 @@ static void
 bcsPendTransaction (BREthereumBCS bcs,
                     OwnershipKept BREthereumTransaction transaction) {
     BREthereumHash hash = transactionGetHash (transaction);
-    if (-1 == bcsLookupPendingTransaction(bcs, hash))
+    if (-1 == bcsLookupPendingTransaction(bcs, hash)) {
         array_add (bcs->pendingTransactions, hash);
+        array_add (bcs->pendingTransactionPolls, ((BREthereumBCSPendingPoll) { 0, bcs->pendingCycle }));
+    }
 }
 
 static void
 bcsUnpendTransaction (BREthereumBCS bcs,
                       OwnershipKept BREthereumTransaction transaction) {
     int index = bcsLookupPendingTransaction (bcs, transactionGetHash (transaction));
-    if (-1 != index)
+    if (-1 != index) {
         array_rm (bcs->pendingTransactions, index);
+        array_rm (bcs->pendingTransactionPolls, index);
+    }
+}
+
+/**
+ * Check if the pending transaction at `index` is due for a status poll in the current cycle and,
+ * if so, schedule its next poll.
+ */
+static int
+bcsPollPendingTransaction (BREthereumBCS bcs,
+                           size_t index) {
+    BREthereumBCSPendingPoll *poll = &bcs->pendingTransactionPolls[index];
+    if (poll->nextCycle > bcs->pendingCycle) return 0;
+
+    // Double the interval for each poll beyond the full rate count, up to the maximum.
+    uint64_t interval = 1;
+    for (unsigned int count = BCS_PENDING_POLL_FULL_RATE_COUNT;
+         count <= poll->count && interval < BCS_PENDING_POLL_INTERVAL_MAXIMUM;
+         count++)
+        interval *= 2;
+
+    poll->count    += 1;
+    poll->nextCycle = bcs->pendingCycle + interval;
+    return 1;
 }
 
 static int
@@ -603,6 +965,12 @@ bcsHandleSubmitTransaction (BREthereumBCS bcs,
     // Make the transaction pending.
     bcsPendTransaction(bcs, transaction);
 
+    // Time its inclusion, from the current chain head, for gas price estimates.
+    BRFeeEstimatorAddTx (bcs->gasPriceEstimator,
+                         bcsFeeEstimatorHash (hash),
+                         bcsFeeEstimatorGasPrice (transactionGetGasPrice (transaction)),
+                         (uint32_t) blockGetNumber (bcs->chain));
+
     // Signal a create/signed/submitted transaction.  This ultimately will callback to bcs
     // clients to announce a new transfer.
     bcsSignalTransaction(bcs, transactionCopy (transaction));
@@ -779,6 +1147,12 @@ bcsExtendChain (BREthereumBCS bcs,
     blockSetNext(block, bcs->chain);
     bcs->chain = block;
 
+    // Keep the proof of work caches up with the chain.
+    proofOfWorkGenerate (bcs->pow, blockGetHeader (block));
+
+    // Age the submitted transactions not yet included.
+    BRFeeEstimatorAddBlock (bcs->gasPriceEstimator, (uint32_t) blockGetNumber (block), NULL, 0);
+
     eth_log("BCS", "Block %" PRIu64 " %s", blockGetNumber(block), message);
 
     bcs->listener.blockChainCallback (bcs->listener.context,
@@ -818,21 +1192,22 @@ bcsPurgeOrphans (BREthereumBCS bcs,
     blockNumber -= BCS_ORPHAN_AGE_OFFSET;
 
     // Look through all the orphans; remove those with old/small block numbers.  But, don't purge
-    // any block this is pending blocks/receipts.
-    int keepLooking = 1;
-    while (keepLooking) {
-        keepLooking = 0;
-        FOR_SET (BREthereumBlock, orphan, bcs->orphans)
-            if (blockGetNumber(orphan) < blockNumber &&
-                ETHEREUM_BOOLEAN_IS_TRUE (blockHasStatusComplete(orphan))) {
-                BRSetRemove(bcs->orphans, orphan);
-                eth_log("BCS", "Block %" PRIu64 " Purged Orphan", blockGetNumber(orphan));
-
-                // TODO: Don't release `orphan` if it is in `bcs->blocks`
-//                blockRelease(orphan);
-                keepLooking = 1;
-                break; // FOR_SET
-            }
+    // any block this is pending blocks/receipts.  Collect them in one pass, as removing from
+    // `bcs->orphans` invalidates the FOR_SET iteration.
+    size_t purgedCount = 0;
+    BREthereumBlock purged[BRSetCount(bcs->orphans) + 1];
+
+    FOR_SET (BREthereumBlock, orphan, bcs->orphans)
+        if (blockGetNumber(orphan) < blockNumber &&
+            ETHEREUM_BOOLEAN_IS_TRUE (blockHasStatusComplete(orphan)))
+            purged[purgedCount++] = orphan;
+
+    for (size_t index = 0; index < purgedCount; index++) {
+        BRSetRemove(bcs->orphans, purged[index]);
+        eth_log("BCS", "Block %" PRIu64 " Purged Orphan", blockGetNumber(purged[index]));
+
+        // TODO: Don't release `orphan` if it is in `bcs->blocks`
+//        blockRelease(purged[index]);
     }
 }
 
@@ -869,37 +1244,44 @@ bcsSelectPreferredBlock (BREthereumBCS bcs,
  * pointing to `bcs->chain`. If we find one, we'll extend the chain and then look again.  Result
  * will be `bcs->chain` being extended with N orpans (0 <= N).
  *
- * TODO: It is possible to have two orphans with the same parent.  Deal with it.
- * We'll select between two orphans sharing a parent
+ * We'll select between two orphans sharing a parent.
+ *
+ * Rather than rescan every orphan for each block chained, which is quadratic in a burst of
+ * announcements, we sort the orphans once by {blockNumber, timestamp}.  The candidates to extend
+ * the chain are then the run of orphans numbered one past `bcs->chain`; the next run follows.
  */
 static void
 bcsChainOrphans (BREthereumBCS bcs) {
-    int keepLooking = 1;
-    while (keepLooking) {
-        keepLooking = 0;
+    size_t orphansCount = BRSetCount (bcs->orphans);
+    if (0 == orphansCount || NULL == bcs->chain) return;
 
+    BREthereumBlock orphans[orphansCount];
+    BRSetAll (bcs->orphans, (void**) orphans, orphansCount);
+    qsort (orphans, orphansCount, sizeof (BREthereumBlock), bcsCreateInitializeBlocksCompare);
+
+    size_t index = 0;
+    while (index < orphansCount) {
+        uint64_t number = blockGetNumber (bcs->chain) + 1;
+        BREthereumHash hash = blockGetHash (bcs->chain);
         BREthereumBlock block = NULL;
 
-        // Select the preferred block to chain by looking through all orphans for ...
-        FOR_SET(BREthereumBlock, orphan, bcs->orphans) {
+        // Skip orphans at or below `bcs->chain`; they can't extend it now.
+        while (index < orphansCount && blockGetNumber (orphans[index]) < number) index++;
+
+        // Select the preferred block to chain by looking through the orphans at `number` for ...
+        for (; index < orphansCount && blockGetNumber (orphans[index]) == number; index++)
             // ... an orphan with a parent hash that matches `bcs->chain`.
-            if (ETHEREUM_BOOLEAN_IS_TRUE(hashEqual(blockGetHash (bcs->chain),
-                                                   blockHeaderGetParentHash(blockGetHeader(orphan)))))
-                block = bcsSelectPreferredBlock(bcs, block, orphan);
-        }
+            if (ETHEREUM_BOOLEAN_IS_TRUE(hashEqual(hash, blockHeaderGetParentHash(blockGetHeader(orphans[index])))))
+                block = bcsSelectPreferredBlock(bcs, block, orphans[index]);
 
-        // If we found a block, then ...
-        if (NULL != block)
-        {
-            // ... extend the chain, and ...
-            bcsExtendChain(bcs, block, "Chained (Orphan)");
+        // If we found no block, then the chain can't be extended further.
+        if (NULL == block) break;
 
-            // ... remove as an orphan, and ...
-            BRSetRemove(bcs->orphans, block);
+        // ... extend the chain, and ...
+        bcsExtendChain(bcs, block, "Chained (Orphan)");
 
-            // ... keep looking for another orphan.
-            keepLooking = 1;
-        }
+        // ... remove as an orphan, and keep looking for another orphan.
+        BRSetRemove(bcs->orphans, block);
     }
 }
 
@@ -1194,6 +1576,7 @@ bcsExtendChainIfPossible (BREthereumBCS bcs,
             // Adopt `block` as `chain`
             bcs->chain = bcs->chainTail = block;
             blockClrNext(block);
+            proofOfWorkGenerate (bcs->pow, blockGetHeader (block));
             eth_log("BCS", "Block %" PRIu64 " Chained (Sync)", blockGetNumber(block));
         }
     }
@@ -1256,7 +1639,7 @@ bcsBlockHasMatchingTransactions (BREthereumBCS bcs,
 static BREthereumBoolean
 bcsBlockHasMatchingLogs (BREthereumBCS bcs,
                          BREthereumBlock block) {
-    return blockHeaderMatch (blockGetHeader (block), bcs->filterForAddressOnLogs);
+    return blockHeaderMatchAddresses (blockGetHeader (block), bcs->filterForAddresses);
 }
 
 static BREthereumBoolean
@@ -1371,6 +1754,25 @@ bcsHandleBlockHeaders (BREthereumBCS bcs,
     BRArrayOf(BREthereumHash) accountsHashes = NULL;
     BRArrayOf(uint64_t) proofNumbers = NULL;
 
+    BRStatsCount (BRStatsBCSBlockHeaders, array_count(headers));
+
+    // For a batch of headers, such as from a sync, compute the proof of work of those not yet
+    // seen in parallel.  The serial pass below, validating each header against its parent as it
+    // chains, then takes the results computed here.
+    if (array_count(headers) > 1) {
+        BRArrayOf(BREthereumBlockHeader) unseen;
+        array_new (unseen, array_count(headers));
+
+        for (size_t index = 0; index < array_count(headers); index++) {
+            BREthereumHash blockHash = blockHeaderGetHash (headers[index]);
+            if (NULL == BRSetGet (bcs->blocks, &blockHash))
+                array_add (unseen, headers[index]);
+        }
+
+        proofOfWorkComputeBatch (bcs->pow, unseen, array_count(unseen));
+        array_free (unseen);
+    }
+
     for (size_t index = 0; index < array_count(headers); index++)
         // Each `headers[index]` has 'OwnershipGiven'
         bcsHandleBlockHeaderInternal (bcs, node,
@@ -1525,14 +1927,15 @@ bcsHandleBlockBody (BREthereumBCS bcs,
 
     // Find transactions of interest.
     BREthereumTransaction *neededTransactions = NULL;
+    BREthereumBoolean neededAccountState = ETHEREUM_BOOLEAN_FALSE;
 
     // Check the transactions one-by-one.
     for (int i = 0; i < array_count(transactions); i++) {
         BREthereumTransaction tx = transactions[i];
         assert (NULL != tx);
         
-        // If it is our transaction (as source or target), handle it.
-        if (ETHEREUM_BOOLEAN_IS_TRUE(transactionHasAddress(tx, bcs->address))) {
+        // If it is our transaction (as source or target, of any address), handle it.
+        if (ETHEREUM_BOOLEAN_IS_TRUE(bcsTransactionHasAddresses(bcs, tx))) {
             eth_log("BCS", "Bodies %" PRIu64 " Found Transaction at %d",
                     blockGetNumber(block), i);
 
@@ -1549,12 +1952,20 @@ bcsHandleBlockBody (BREthereumBCS bcs,
                                                                       blockGetTimestamp(block),
                                                                       transactionGetGasLimit(tx)));
 
+            if (ETHEREUM_BOOLEAN_IS_TRUE(transactionHasAddress(tx, bcs->address)))
+                neededAccountState = ETHEREUM_BOOLEAN_TRUE;
+
             if (NULL == neededTransactions) array_new (neededTransactions, 3);
             array_add(neededTransactions, tx);
         }
         // else - TODO: Handle if has a 'contract' address of interest?
     }
 
+    // We are done with the transactions themselves; the copies of interest are in
+    // `neededTransactions`.  Keep just the hashes, for linking logs, as the block can be tracked
+    // for a long time.
+    blockCompactTransactions (block);
+
     // Report the block status.  Do so even if neededTransaction is NULL.
     blockReportStatusTransactions(block, neededTransactions);
 
@@ -1582,7 +1993,8 @@ bcsHandleBlockBody (BREthereumBCS bcs,
 
         // 3) We want the account state too - because we've found a transaction for bcs->address
         // and the account changed (instead of computing the account, we'll query definitively).
-        if (ETHEREUM_BOOLEAN_IS_TRUE (blockHasStatusAccountStateRequest (block, BLOCK_REQUEST_NOT_NEEDED))) {
+        if (ETHEREUM_BOOLEAN_IS_TRUE (neededAccountState) &&
+            ETHEREUM_BOOLEAN_IS_TRUE (blockHasStatusAccountStateRequest (block, BLOCK_REQUEST_NOT_NEEDED))) {
             blockReportStatusAccountStateRequest(block, BLOCK_REQUEST_PENDING);
             lesProvideAccountStatesOne (bcs->les, node,
                                         (BREthereumLESProvisionContext) bcs,
@@ -1692,8 +2104,7 @@ bcsHandleLogExtractInterest (BREthereumBCS bcs,
     *token = tokenLookupByAddress(logGetAddress(log));
     if (NULL == *token) return ETHEREUM_BOOLEAN_FALSE;
 
-    BREthereumLogTopicString topicString = logTopicAsString(logGetTopic(log, 0));
-    *tokenEvent = contractLookupEventForTopic(contractERC20,  topicString.chars);
+    *tokenEvent = contractLookupEventForTopicBytes (contractERC20, logGetTopic(log, 0).bytes);
     if (NULL == *tokenEvent) return ETHEREUM_BOOLEAN_FALSE;
 
     return ETHEREUM_BOOLEAN_TRUE;
@@ -1744,13 +2155,14 @@ bcsHandleTransactionReceipts (BREthereumBCS bcs,
     size_t receiptsCount = array_count(receipts);
     for (size_t ti = 0; ti < receiptsCount; ti++) { // transactionIndex
         BREthereumTransactionReceipt receipt = receipts[ti];
-        if (ETHEREUM_BOOLEAN_IS_TRUE (transactionReceiptMatch(receipt, bcs->filterForAddressOnLogs))) {
+        BREthereumBloomFilter receiptFilter = transactionReceiptGetBloomFilter (receipt);
+        if (ETHEREUM_BOOLEAN_IS_TRUE (bloomFilterSetMatch (bcs->filterForAddresses, receiptFilter))) {
             size_t logsCount = transactionReceiptGetLogsCount(receipt);
             for (size_t li = 0; li < logsCount; li++) { // logIndex
                 BREthereumLog log = transactionReceiptGetLog(receipt, li);
 
-                // If `log` topics match our address....
-                if (ETHEREUM_BOOLEAN_IS_TRUE (logMatchesAddress(log, bcs->address, ETHEREUM_BOOLEAN_TRUE))) {
+                // If `log` topics match any of our addresses....
+                if (ETHEREUM_BOOLEAN_IS_TRUE (bcsLogHasAddresses(bcs, log))) {
                     eth_log("BCS", "Receipts %" PRIu64 " Found Log at (%zu, %zu)",
                             blockGetNumber(block), ti, li);
 
@@ -1844,6 +2256,271 @@ bcsHandleTransactionReceiptsMultiple (BREthereumBCS bcs,
     array_free (arrayOfReceipts);
 }
 
+/// MARK: - Log Query
+
+extern void
+bcsQueryLogs (BREthereumBCS bcs,
+              const BREthereumAddress *addresses,
+              size_t addressesCount,
+              const BREthereumLogTopic *topics,
+              size_t topicsCount,
+              uint64_t blockNumberStart,
+              uint64_t blockNumberStop,
+              BREthereumBCSLogQueryContext context,
+              BREthereumBCSLogQueryCallback callback) {
+    assert (P2P_ONLY == bcs->mode || P2P_WITH_BRD_SYNC == bcs->mode);
+
+    BREthereumBCSLogQuery query = calloc (1, sizeof (BREthereumBCSLogQueryRecord));
+    query->bcs = bcs;
+
+    array_new (query->addresses, addressesCount);
+    array_add_array (query->addresses, addresses, addressesCount);
+
+    array_new (query->topics, topicsCount);
+    array_add_array (query->topics, topics, topicsCount);
+
+    query->blockNumberStart = blockNumberStart;
+    query->blockNumberStop  = blockNumberStop;
+
+    array_new (query->blocks, 10);
+    query->provisionsPending = 0;
+    array_new (query->logs, 10);
+
+    query->context  = context;
+    query->callback = callback;
+
+    bcsSignalQueryLogs (bcs, query);
+}
+
+static void
+bcsQueryLogsRelease (BREthereumBCSLogQuery query) {
+    array_free (query->addresses);
+    array_free (query->topics);
+    array_free (query->blocks);
+    logsRelease (query->logs);
+    free (query);
+}
+
+/**
+ * Announce the logs found by `query` and release it.
+ */
+static void
+bcsQueryLogsFinish (BREthereumBCS bcs,
+                    BREthereumBCSLogQuery query) {
+    for (size_t index = 0; index < array_count (bcs->logQueries); index++)
+        if (query == bcs->logQueries[index]) {
+            array_rm (bcs->logQueries, index);
+            break;
+        }
+
+    eth_log ("BCS", "Query Logs %" PRIu64 " to %" PRIu64 ": Blocks %zu, Logs %zu",
+             query->blockNumberStart,
+             query->blockNumberStop,
+             array_count (query->blocks),
+             array_count (query->logs));
+
+    query->callback (query->context, bcs, query->logs);
+    query->logs = NULL;
+
+    bcsQueryLogsRelease (query);
+}
+
+/**
+ * Fill `matches` with TRUE for each of `headers` that matches any of `filters`, or for every
+ * header if there are no `filters`.  Each filter is tested against all the headers in one pass.
+ */
+static void
+bcsQueryLogsMatchHeaders (BREthereumBlockHeader *headers,
+                          size_t headersCount,
+                          BREthereumBloomFilter *filters,
+                          size_t filtersCount,
+                          BREthereumBoolean *matches,
+                          BREthereumBoolean *filterMatches) {
+    for (size_t index = 0; index < headersCount; index++)
+        matches[index] = AS_ETHEREUM_BOOLEAN (0 == filtersCount);
+
+    for (size_t fi = 0; fi < filtersCount; fi++)
+        if (0 != blockHeadersMatch (headers, headersCount, filters[fi], filterMatches))
+            for (size_t index = 0; index < headersCount; index++)
+                if (ETHEREUM_BOOLEAN_IS_TRUE (filterMatches[index]))
+                    matches[index] = ETHEREUM_BOOLEAN_TRUE;
+}
+
+extern void
+bcsHandleQueryLogs (BREthereumBCS bcs,
+                    BREthereumBCSLogQuery query) {
+    // The headers of the blocks we hold in the query's range.
+    BRArrayOf(BREthereumBlockHeader) headers;
+    array_new (headers, 100);
+    BCS_FOR_BLOCK (block) {
+        uint64_t number = blockGetNumber (block);
+        if (query->blockNumberStart <= number && number <= query->blockNumberStop)
+            array_add (headers, blockGetHeader (block));
+    }
+    size_t headersCount = array_count (headers);
+
+    // A header is a candidate if its bloom matches any address and any topic.
+    size_t addressesCount = array_count (query->addresses);
+    size_t topicsCount    = array_count (query->topics);
+
+    BREthereumBloomFilter *filters = calloc (addressesCount + topicsCount + 1,
+                                             sizeof (BREthereumBloomFilter));
+    for (size_t index = 0; index < addressesCount; index++)
+        filters[index] = bloomFilterCreateAddress (query->addresses[index]);
+    for (size_t index = 0; index < topicsCount; index++)
+        filters[addressesCount + index] = logTopicGetBloomFilter (query->topics[index]);
+
+    BREthereumBoolean *matches = calloc (3 * headersCount + 1, sizeof (BREthereumBoolean));
+    BREthereumBoolean *addressMatches = &matches[0];
+    BREthereumBoolean *topicMatches   = &matches[headersCount];
+    BREthereumBoolean *filterMatches  = &matches[2 * headersCount];
+
+    bcsQueryLogsMatchHeaders (headers, headersCount, &filters[0], addressesCount,
+                              addressMatches, filterMatches);
+    bcsQueryLogsMatchHeaders (headers, headersCount, &filters[addressesCount], topicsCount,
+                              topicMatches, filterMatches);
+
+    for (size_t index = 0; index < headersCount; index++)
+        if (ETHEREUM_BOOLEAN_IS_TRUE (addressMatches[index]) &&
+            ETHEREUM_BOOLEAN_IS_TRUE (topicMatches[index])) {
+            BREthereumBlockHeader header = headers[index];
+            BREthereumBCSLogQueryBlock block = {
+                blockHeaderGetHash (header),
+                blockHeaderGetNumber (header),
+                blockHeaderGetTimestamp (header)
+            };
+            array_add (query->blocks, block);
+        }
+
+    free (matches);
+    free (filters);
+    array_free (headers);
+
+    array_add (bcs->logQueries, query);
+
+    size_t blocksCount = array_count (query->blocks);
+    if (0 == blocksCount) {
+        bcsQueryLogsFinish (bcs, query);
+        return;
+    }
+
+    // Request the candidate's receipts, in batches.
+    for (size_t offset = 0; offset < blocksCount; offset += BCS_LOG_QUERY_RECEIPTS_PER_PROVISION) {
+        size_t count = (blocksCount - offset < BCS_LOG_QUERY_RECEIPTS_PER_PROVISION
+                        ? blocksCount - offset
+                        : BCS_LOG_QUERY_RECEIPTS_PER_PROVISION);
+
+        BRArrayOf(BREthereumHash) hashes;
+        array_new (hashes, count);
+        for (size_t index = 0; index < count; index++)
+            array_add (hashes, query->blocks[offset + index].hash);
+
+        query->provisionsPending += 1;
+        lesProvideReceipts (bcs->les,
+                            NODE_REFERENCE_ANY,
+                            (BREthereumLESProvisionContext) query,
+                            (BREthereumLESProvisionCallback) bcsSignalQueryLogsProvision,
+                            hashes);
+    }
+}
+
+static BREthereumBoolean
+bcsQueryLogsMatchLog (BREthereumBCSLogQuery query,
+                      BREthereumLog log) {
+    int matchesAddress = (0 == array_count (query->addresses));
+    for (size_t index = 0; !matchesAddress && index < array_count (query->addresses); index++)
+        matchesAddress = ETHEREUM_BOOLEAN_IS_TRUE (logHasAddress (log, query->addresses[index]));
+
+    int matchesTopic = (0 == array_count (query->topics));
+    for (size_t index = 0; !matchesTopic && index < array_count (query->topics); index++)
+        for (size_t ti = 0; !matchesTopic && ti < logGetTopicsCount (log); ti++)
+            matchesTopic = (0 == memcmp (logGetTopic (log, ti).bytes,
+                                         query->topics[index].bytes,
+                                         sizeof (query->topics[index].bytes)));
+
+    return AS_ETHEREUM_BOOLEAN (matchesAddress && matchesTopic);
+}
+
+/**
+ * Add the logs in `receipts`, of the block with `blockHash`, that match `query`.
+ */
+static void
+bcsQueryLogsExtract (BREthereumBCSLogQuery query,
+                     BREthereumHash blockHash,
+                     BRArrayOf(BREthereumTransactionReceipt) receipts) {
+    const BREthereumBCSLogQueryBlock *block = NULL;
+    for (size_t index = 0; NULL == block && index < array_count (query->blocks); index++)
+        if (ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (blockHash, query->blocks[index].hash)))
+            block = &query->blocks[index];
+    if (NULL == block) return;
+
+    BREthereumHash emptyHash = EMPTY_HASH_INIT;
+    size_t logIndexInBlock = 0;
+
+    for (size_t ti = 0; ti < array_count (receipts); ti++) { // transactionIndex
+        BREthereumTransactionReceipt receipt = receipts[ti];
+        size_t logsCount = transactionReceiptGetLogsCount (receipt);
+        for (size_t li = 0; li < logsCount; li++, logIndexInBlock++) { // logIndex
+            BREthereumLog log = transactionReceiptGetLog (receipt, li);
+            if (ETHEREUM_BOOLEAN_IS_FALSE (bcsQueryLogsMatchLog (query, log))) continue;
+
+            // As in bcsHandleTransactionReceipts(), the transaction hash is not known here.
+            log = logCopy (log);
+            logInitializeIdentifier (log, emptyHash, logIndexInBlock);
+            logSetStatus (log, transactionStatusCreateIncluded (block->hash,
+                                                                block->number,
+                                                                ti,
+                                                                block->timestamp,
+                                                                gasCreate(0)));
+            array_add (query->logs, log);
+        }
+    }
+}
+
+extern void
+bcsHandleQueryLogsProvision (BREthereumBCSLogQuery query,
+                             BREthereumLES les,
+                             BREthereumNodeReference node,
+                             OwnershipGiven BREthereumProvisionResult result) {
+    BREthereumBCS bcs = query->bcs;
+    BREthereumProvision *provision = &result.provision;
+
+    switch (result.status) {
+        case PROVISION_ERROR:
+            // The node went inactive, we'll submit again; otherwise skip these blocks.
+            if (PROVISION_ERROR_NODE_INACTIVE == result.u.error.reason) {
+                lesRetryProvision (bcs->les,
+                                   NODE_REFERENCE_ANY,
+                                   (BREthereumLESProvisionContext) query,
+                                   (BREthereumLESProvisionCallback) bcsSignalQueryLogsProvision,
+                                   provision);
+                return;
+            }
+            eth_log ("BCS", "Query Logs Provision Failed: %zu", provision->identifier);
+            break;
+
+        case PROVISION_SUCCESS: {
+            assert (PROVISION_TRANSACTION_RECEIPTS == result.type);
+            BRArrayOf(BREthereumHash) hashes;
+            BRArrayOf(BRArrayOf(BREthereumTransactionReceipt)) receipts;
+            provisionReceiptsConsume (&provision->u.receipts, &hashes, &receipts);
+
+            for (size_t index = 0; index < array_count (hashes); index++) {
+                bcsQueryLogsExtract (query, hashes[index], receipts[index]);
+                transactionReceiptsRelease (receipts[index]);
+            }
+            array_free (hashes);
+            array_free (receipts);
+            break;
+        }
+    }
+
+    provisionResultRelease (&result);
+
+    if (0 == --query->provisionsPending)
+        bcsQueryLogsFinish (bcs, query);
+}
+
 /// MARK: - Transaction Status
 
 //
@@ -2023,28 +2700,43 @@ bcsPeriodicDispatcher (BREventHandler handler,
     // TODO: Avoid-ish a race condition on bcsRelease. This is the wrong approach.
     if (NULL == bcs->les) return;
 
+    // Count this cycle, even if nothing is pending, so that poll schedules are in real time.
+    bcs->pendingCycle += 1;
+
+    bcsUpdateMemoryUsage (bcs);
+
     // If nothing to do; simply skip out.
     if ((NULL == bcs->pendingTransactions || 0 == array_count (bcs->pendingTransactions)) &&
         (NULL == bcs->pendingLogs         || 0 == array_count (bcs->pendingLogs)))
         return;
 
-    // We'll request status for each `pendingTransaction`.
+    // We'll request status for each `pendingTransaction` that is due for a poll.
     BRArrayOf(BREthereumHash) hashes;
     array_new (hashes, array_count(bcs->pendingTransactions) + array_count(bcs->pendingLogs));
-    array_add_array (hashes, bcs->pendingTransactions, array_count(bcs->pendingTransactions));
+    for (size_t index = 0; index < array_count(bcs->pendingTransactions); index++)
+        if (bcsPollPendingTransaction (bcs, index))
+            array_add (hashes, bcs->pendingTransactions[index]);
 
-    // Add in hashes for each transaction referenced by `pendingLogs`
+    // Add in hashes for each transaction referenced by `pendingLogs`, unless the transaction is
+    // itself pending - in which case its poll schedule applies.
     for (size_t index = 0; index < array_count(bcs->pendingLogs); index++) {
         BREthereumHash logHash = bcs->pendingLogs[index];
         BREthereumLog  log     = BRSetGet (bcs->logs, &logHash);
         if (NULL != log) {
             BREthereumHash hash;
             if (ETHEREUM_BOOLEAN_IS_TRUE (logExtractIdentifier (log, &hash, NULL)) &&
+                -1 == bcsLookupPendingTransaction (bcs, hash) &&
                 -1 == hashesIndex(hashes, hash))
                 array_add (hashes, hash);
         }
     }
 
+    // If nothing is due this cycle; skip out.
+    if (0 == array_count (hashes)) {
+        array_free (hashes);
+        return;
+    }
+
     // OwnershipGiven for `hashes` (hence, above, `hashes` is a new array).
     lesProvideTransactionStatus (bcs->les,
                                  NODE_REFERENCE_ALL,
@@ -2109,12 +2801,17 @@ bcsHandleTransaction (BREthereumBCS bcs,
     switch (status.type) {
         case TRANSACTION_STATUS_ERRORED:
             // This is a 'final state' - no need for further processing
+            BRFeeEstimatorRemoveTx (bcs->gasPriceEstimator,
+                                    bcsFeeEstimatorHash (transactionGetHash (transaction)));
             break;
 
         case TRANSACTION_STATUS_INCLUDED:
             // This is nearly a 'final state' - except in the case where the transaction's block
             // has been orphaned.  We'll let the 'orphaning process' change the transaction's
             // status if need be - no need for further processing.
+            BRFeeEstimatorConfirmTx (bcs->gasPriceEstimator,
+                                     bcsFeeEstimatorHash (transactionGetHash (transaction)),
+                                     (uint32_t) status.u.included.blockNumber);
             break;
 
         default: {
@@ -2261,6 +2958,7 @@ bcsHandleProvision (BREthereumBCS bcs,
                     BREthereumNodeReference node,
                     OwnershipGiven BREthereumProvisionResult result) {
     assert (bcs->les == les);
+    BR_TRACE_BEGIN (traceBegin);
 
     int needProvisionRelease = 1;
     BREthereumProvision *provision = &result.provision;
@@ -2345,13 +3043,17 @@ bcsHandleProvision (BREthereumBCS bcs,
                 }
 
                 case PROVISION_SUBMIT_TRANSACTION: {
-                    BREthereumTransaction transaction;
-                    BREthereumTransactionStatus status;
-                    provisionSubmissionConsume (&provision->u.submission, &transaction, &status);
-                    bcsHandleTransactionStatus (bcs, node,
-                                                transactionGetHash(transaction),
-                                                status);
-                    transactionRelease(transaction);
+                    BRArrayOf(BREthereumTransaction) transactions;
+                    BRArrayOf(BREthereumTransactionStatus) statuses;
+                    provisionSubmissionConsume (&provision->u.submission, &transactions, &statuses);
+                    for (size_t index = 0; index < array_count(transactions); index++)
+                        bcsHandleTransactionStatus (bcs, node,
+                                                    transactionGetHash(transactions[index]),
+                                                    (NULL != statuses && index < array_count(statuses)
+                                                     ? statuses[index]
+                                                     : transactionStatusCreate (TRANSACTION_STATUS_UNKNOWN)));
+                    transactionsRelease(transactions);
+                    if (NULL != statuses) array_free (statuses);
                     break;
                 }
             }
@@ -2361,6 +3063,7 @@ bcsHandleProvision (BREthereumBCS bcs,
 
     // We have one result and have finished with it.  Must release - which will release the
     // included provision.
+    BR_TRACE_END (BRTraceBCSProvision, traceBegin, result.identifier);
     if (needProvisionRelease)
         provisionResultRelease (&result);
 }
@@ -152,7 +152,8 @@ typedef struct {
 /**
  * Create BCS (a 'BlockChain Slice`) providing a view of the Ethereum blockchain for `network`
  * focused on the `account` primary address.  Initialize the synchronization with the previously
- * saved `headers`.  Provide `listener` to anounce BCS 'events'.
+ * saved `headers`.  Provide `listener` to anounce BCS 'events'.  If `fs` is not NULL, the proof
+ * of work caches are saved there.
  *
  * @parameters
  * @parameter headers - is this a BRArray; assume so for now.
@@ -165,7 +166,17 @@ bcsCreate (BREthereumNetwork network,
            BRSetOf(BREthereumNodeConfig) peers,
            BRSetOf(BREthereumBlock) blocks,
            BRSetOf(BREthereumTransaction) transactions,
-           BRSetOf(BREthereumLog) logs);
+           BRSetOf(BREthereumLog) logs,
+           BRFileService fs);
+
+/**
+ * If `shared` is TRUE, then BCS instances subsequently created will share one LES, with one set
+ * of nodes and connections, per network and mode.  Each BCS subscribes to the shared LES's
+ * announcements; it still requests its own headers, account states, logs and transactions.
+ * Sharing is off by default.
+ */
+extern void
+bcsSetSharedLES (BREthereumBoolean shared);
 
 extern void
 bcsStart (BREthereumBCS bcs);
@@ -185,6 +196,73 @@ bcsDestroy (BREthereumBCS bcs);
 extern void
 bcsClean (BREthereumBCS bcs);
 
+/**
+ * The bytes held by a BCS.  Orphans are counted in `orphans`, not in `blocks`; `other` is the
+ * set tables, the pending arrays and the event handler.
+ */
+typedef struct {
+    size_t blocks;
+    size_t orphans;
+    size_t transactions;
+    size_t logs;
+    size_t les;
+    size_t other;
+    size_t total;
+} BREthereumBCSMemory;
+
+/**
+ * Return the bytes held by `bcs`.  BCS has no lock, so its blocks, transactions and logs are
+ * counted on the BCS thread every BCS_TRANSACTION_CHECK_STATUS_SECONDS and the last count is
+ * returned; `les` and the event handler are counted as of the call.
+ */
+extern BREthereumBCSMemory
+bcsGetMemoryUsage (BREthereumBCS bcs);
+
+/**
+ * Return a gas price at which the transactions submitted through `bcs` have been included within
+ * `targetBlocks` blocks (at most BR_FEE_ESTIMATOR_MAX_TARGET), learned from the blocks chained
+ * since `bcs` was created.  If too few transactions have been included for an estimate, the
+ * returned gas price is zero.  Safe to call from any thread.
+ */
+extern BREthereumGasPrice
+bcsGetGasPriceEstimate (BREthereumBCS bcs,
+                        uint32_t targetBlocks);
+
+/**
+ * An opaque value, owned by the caller, associated with a tracked address.  A `listener` that
+ * serves many addresses uses bcsGetAddressSubscriber() to route a transaction or log to its owner.
+ */
+typedef void *BREthereumBCSSubscriber;
+
+/**
+ * Track `address`, in addition to the primary address given to bcsCreate(), for `subscriber`.
+ * Transactions with `address` as source or target, and logs with `address` as a topic, are
+ * announced to the `listener` like those of the primary address.  The history of `address` is
+ * requested from the BRD backend with the listener's `getBlocksCallback`; account states and
+ * the 'N-ary' sync remain for the primary address only.
+ *
+ * Blocks are tested once for all tracked addresses, so one BCS serves many addresses.
+ */
+extern void
+bcsAddAddress (BREthereumBCS bcs,
+               BREthereumAddress address,
+               BREthereumBCSSubscriber subscriber);
+
+/**
+ * Stop tracking `address`.  The primary address can not be removed.
+ */
+extern void
+bcsRemoveAddress (BREthereumBCS bcs,
+                  BREthereumAddress address);
+
+/**
+ * Return the subscriber of a tracked `address`, or NULL if `address` is not tracked.  The
+ * primary address has a NULL subscriber.
+ */
+extern BREthereumBCSSubscriber
+bcsGetAddressSubscriber (BREthereumBCS bcs,
+                         BREthereumAddress address);
+
 
 /**
  * Start a sync from block number.  If a sync is in progress, then it is stopped.  This function
@@ -249,6 +327,39 @@ bcsReportInterestingBlocks (BREthereumBCS bcs,
                             // request id
                             BRArrayOf(uint64_t) blockNumbers);
 
+/// MARK: - Log Query
+
+typedef void *BREthereumBCSLogQueryContext;
+
+/**
+ * The result of bcsQueryLogs(): the matching logs, each with an 'included' status for its block
+ * (and an empty transaction hash).  Invoked once, on the BCS thread.
+ */
+typedef void
+(*BREthereumBCSLogQueryCallback) (BREthereumBCSLogQueryContext context,
+                                  BREthereumBCS bcs,
+                                  OwnershipGiven BRArrayOf(BREthereumLog) logs);
+
+/**
+ * Query the logs, in blocks from `blockNumberStart` to `blockNumberStop` inclusive, that are
+ * emitted by any of `addresses` and have any of `topics` as a topic; an empty `addresses` or
+ * `topics` matches all.  This is like `eth_getLogs` but only over the blocks BCS already holds:
+ * their header blooms are tested locally and receipts are requested, in batches, from LES for
+ * just the candidate blocks.  Blocks that BCS does not hold are not queried.
+ *
+ * Only in P2P_ONLY and P2P_WITH_BRD_SYNC modes.
+ */
+extern void
+bcsQueryLogs (BREthereumBCS bcs,
+              const BREthereumAddress *addresses,
+              size_t addressesCount,
+              const BREthereumLogTopic *topics,
+              size_t topicsCount,
+              uint64_t blockNumberStart,
+              uint64_t blockNumberStop,
+              BREthereumBCSLogQueryContext context,
+              BREthereumBCSLogQueryCallback callback);
+
 #ifdef __cplusplus
 }
 #endif
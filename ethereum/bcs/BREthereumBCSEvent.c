@@ -31,7 +31,9 @@ bcsHandleSubmitTransactionDispatcher (BREventHandler ignore,
 static BREventType handleSubmitTransactionEventType = {
     "BCS: Handle Submit Transaction Event",
     sizeof (BREthereumHandleSubmitTransactionEvent),
-    (BREventDispatcher) bcsHandleSubmitTransactionDispatcher
+    (BREventDispatcher) bcsHandleSubmitTransactionDispatcher,
+    NULL,
+    EVENT_PRIORITY_HIGH
 };
 
 extern void
@@ -236,6 +238,132 @@ bcsSignalLog (BREthereumBCS bcs,
     eventHandlerSignalEvent(bcs->handler, (BREvent *) &event);
 }
 
+// ==============================================================================================
+//
+// Signal/Handle Add Address
+//
+typedef struct {
+    BREvent base;
+    BREthereumBCS bcs;
+    BREthereumAddress address;
+    BREthereumBCSSubscriber subscriber;
+} BREthereumHandleAddAddressEvent;
+
+static void
+bcsHandleAddAddressDispatcher (BREventHandler ignore,
+                               BREthereumHandleAddAddressEvent *event) {
+    bcsHandleAddAddress(event->bcs, event->address, event->subscriber);
+}
+
+static BREventType handleAddAddressEventType = {
+    "BCS: Handle Add Address Event",
+    sizeof (BREthereumHandleAddAddressEvent),
+    (BREventDispatcher) bcsHandleAddAddressDispatcher
+};
+
+extern void
+bcsSignalAddAddress (BREthereumBCS bcs,
+                     BREthereumAddress address,
+                     BREthereumBCSSubscriber subscriber) {
+    BREthereumHandleAddAddressEvent event =
+    { { NULL, &handleAddAddressEventType}, bcs, address, subscriber };
+    eventHandlerSignalEvent (bcs->handler, (BREvent *) &event);
+}
+
+// ==============================================================================================
+//
+// Signal/Handle Remove Address
+//
+typedef struct {
+    BREvent base;
+    BREthereumBCS bcs;
+    BREthereumAddress address;
+} BREthereumHandleRemoveAddressEvent;
+
+static void
+bcsHandleRemoveAddressDispatcher (BREventHandler ignore,
+                                  BREthereumHandleRemoveAddressEvent *event) {
+    bcsHandleRemoveAddress(event->bcs, event->address);
+}
+
+static BREventType handleRemoveAddressEventType = {
+    "BCS: Handle Remove Address Event",
+    sizeof (BREthereumHandleRemoveAddressEvent),
+    (BREventDispatcher) bcsHandleRemoveAddressDispatcher
+};
+
+extern void
+bcsSignalRemoveAddress (BREthereumBCS bcs,
+                        BREthereumAddress address) {
+    BREthereumHandleRemoveAddressEvent event =
+    { { NULL, &handleRemoveAddressEventType}, bcs, address };
+    eventHandlerSignalEvent (bcs->handler, (BREvent *) &event);
+}
+
+// ==============================================================================================
+//
+// Signal/Handle Query Logs
+//
+typedef struct {
+    BREvent base;
+    BREthereumBCS bcs;
+    BREthereumBCSLogQuery query;
+} BREthereumHandleQueryLogsEvent;
+
+static void
+bcsHandleQueryLogsDispatcher (BREventHandler ignore,
+                              BREthereumHandleQueryLogsEvent *event) {
+    bcsHandleQueryLogs(event->bcs, event->query);
+}
+
+static BREventType handleQueryLogsEventType = {
+    "BCS: Handle Query Logs Event",
+    sizeof (BREthereumHandleQueryLogsEvent),
+    (BREventDispatcher) bcsHandleQueryLogsDispatcher
+};
+
+extern void
+bcsSignalQueryLogs (BREthereumBCS bcs,
+                    BREthereumBCSLogQuery query) {
+    BREthereumHandleQueryLogsEvent event =
+    { { NULL, &handleQueryLogsEventType}, bcs, query };
+    eventHandlerSignalEvent (bcs->handler, (BREvent *) &event);
+}
+
+// ==============================================================================================
+//
+// Signal/Handle Query Logs Provision
+//
+typedef struct {
+    BREvent base;
+    BREthereumBCSLogQuery query;
+    BREthereumLES les;
+    BREthereumNodeReference node;
+    BREthereumProvisionResult result;
+} BREthereumHandleQueryLogsProvisionEvent;
+
+static void
+bcsHandleQueryLogsProvisionDispatcher (BREventHandler ignore,
+                                       BREthereumHandleQueryLogsProvisionEvent *event) {
+    bcsHandleQueryLogsProvision(event->query, event->les, event->node, event->result);
+}
+
+static BREventType handleQueryLogsProvisionEventType = {
+    "BCS: Handle Query Logs Provision Event",
+    sizeof (BREthereumHandleQueryLogsProvisionEvent),
+    (BREventDispatcher) bcsHandleQueryLogsProvisionDispatcher
+};
+
+extern void
+bcsSignalQueryLogsProvision (BREthereumBCSLogQuery query,
+                             BREthereumLES les,
+                             BREthereumNodeReference node,
+                             BREthereumProvisionResult result) {
+    BREthereumHandleQueryLogsProvisionEvent event =
+    { { NULL, &handleQueryLogsProvisionEventType}, query, les, node, result };
+    eventHandlerSignalEvent (query->bcs->handler, (BREvent *) &event);
+}
+
 // ==============================================================================================
 //
 // Signal/Handle Peers
@@ -332,6 +460,10 @@ bcsEventTypes[] = {
     &handleTransactionEventType,
     &handleLogEventType,
     &handleNodesEventType,
+    &handleAddAddressEventType,
+    &handleRemoveAddressEventType,
+    &handleQueryLogsEventType,
+    &handleQueryLogsProvisionEventType,
     &handleSyncProvisionEventType
 };
 
@@ -13,6 +13,7 @@
 
 #include "ethereum/blockchain/BREthereumBlockChain.h"
 #include "ethereum/event/BREvent.h"
+#include "support/BRFeeEstimator.h"
 #include "BREthereumBCS.h"
 
 #ifdef __cplusplus
@@ -52,6 +53,25 @@ extern "C" {
 #define SYNC_LINEAR_LIMIT               (10 * SYNC_LINEAR_REQUEST_MAXIMUM)
 #define SYNC_LINEAR_LIMIT_IF_N_ARY      (100) // 3 * SYNC_LINEAR_REQUEST_MAXIMUM)
 
+/**
+ * A 'N_ARY sync' only needs the hashes of its boundary blocks, to request account states.  When
+ * the boundary blocks are covered by the LES canonical hash trie (CHT) we'll get the hashes as
+ * header proofs - checked against the CHT - rather than as block headers.  The CHT covers blocks in
+ * sections of PERIOD blocks; a section is available once CONFIRMATIONS blocks are atop it.
+ */
+#define SYNC_BLOCK_PROOF_PERIOD             (4096)
+#define SYNC_BLOCK_PROOF_CONFIRMATIONS      (2048)
+
+/**
+ * Sibling sync ranges are dispatched concurrently over at most NODE_COUNT connected LES nodes (LES
+ * keeps LES_ACTIVE_NODE_COUNT nodes active) with at most NODE_REQUESTS_MAXIMUM ranges outstanding
+ * on each node.  When a node fails a range's request, the node is dropped from the sync and the
+ * range is dispatched on another node - at most RANGE_RETRY_MAXIMUM times.
+ */
+#define SYNC_NODE_COUNT                 (3)
+#define SYNC_NODE_REQUESTS_MAXIMUM      (2)
+#define SYNC_RANGE_RETRY_MAXIMUM        (3)
+
 /**
  * As the sync find results (block headers, at least) we'll report them every PERIOD results.
  */
@@ -62,6 +82,64 @@ extern "C" {
  */
 typedef struct BREthereumBCSSyncStruct *BREthereumBCSSync;
 
+/**
+ * The status polling schedule for a pending transaction.  A pending transaction is polled every
+ * status cycle at first; after BCS_PENDING_POLL_FULL_RATE_COUNT polls the interval between polls
+ * doubles, up to BCS_PENDING_POLL_INTERVAL_MAXIMUM cycles.
+ */
+typedef struct {
+    unsigned int count;     // The number of polls so far
+    uint64_t nextCycle;     // The status cycle at which to poll next
+} BREthereumBCSPendingPoll;
+
+#define BCS_PENDING_POLL_FULL_RATE_COUNT    (8)
+#define BCS_PENDING_POLL_INTERVAL_MAXIMUM   (16)
+
+/**
+ * A tracked address with the subscriber it was added for; see bcsAddAddress().
+ */
+typedef struct {
+    BREthereumAddress address;
+    BREthereumBCSSubscriber subscriber;
+} BREthereumBCSSubscription;
+
+#define BCS_SUBSCRIPTIONS_INITIAL_CAPACITY  (10)
+
+/**
+ * A log query, see bcsQueryLogs().  The receipts of candidate blocks are requested in provisions
+ * of at most RECEIPTS_PER_PROVISION blocks; LES splits each provision into messages.
+ */
+typedef struct {
+    BREthereumHash hash;
+    uint64_t number;
+    uint64_t timestamp;
+} BREthereumBCSLogQueryBlock;
+
+typedef struct {
+    BREthereumBCS bcs;
+    BRArrayOf(BREthereumAddress) addresses;
+    BRArrayOf(BREthereumLogTopic) topics;
+    uint64_t blockNumberStart;
+    uint64_t blockNumberStop;
+
+    BRArrayOf(BREthereumBCSLogQueryBlock) blocks;   // The candidate blocks
+    size_t provisionsPending;
+    BRArrayOf(BREthereumLog) logs;
+
+    BREthereumBCSLogQueryContext context;
+    BREthereumBCSLogQueryCallback callback;
+} BREthereumBCSLogQueryRecord;
+
+typedef BREthereumBCSLogQueryRecord *BREthereumBCSLogQuery;
+
+#define BCS_LOG_QUERY_RECEIPTS_PER_PROVISION    (64)
+
+/**
+ * The range of gas prices, in WEI, that `gasPriceEstimator` distinguishes: 0.1 GWEI to 10,000 GWEI
+ */
+#define BCS_GAS_PRICE_ESTIMATE_MIN_WEI          (100000000ull)
+#define BCS_GAS_PRICE_ESTIMATE_MAX_WEI          (10000000000000ull)
+
 /// MARK: - typedef BCS
 
 //
@@ -95,6 +173,31 @@ struct BREthereumBCSStruct {
      */
     BREthereumBloomFilter filterForAddressOnLogs;
 
+    /**
+     * The tracked addresses, including `address`, as an index from address to subscriber.  Only
+     * changed on the BCS thread, and then while holding `subscriptionsLock`, so that the BCS thread
+     * reads without the lock.
+     */
+    BRSetOf(BREthereumBCSSubscription*) subscriptions;
+    pthread_mutex_t subscriptionsLock;
+
+    /**
+     * The transaction and log bloom filters of every address in `subscriptions`, combined so
+     * that a block header or a transaction receipt is tested once for all of them.
+     */
+    BREthereumBloomFilterSet filterForAddresses;
+
+    /**
+     * The log queries waiting on receipts; see bcsQueryLogs()
+     */
+    BRArrayOf(BREthereumBCSLogQuery) logQueries;
+
+    /**
+     * The gas prices that our submitted transactions needed to be included within a number of
+     * blocks, learned as `chain` is extended; see bcsGetGasPriceEstimate().  Has its own lock.
+     */
+    BRFeeEstimator *gasPriceEstimator;
+
     /**
      * The listener interested in BCS events
      */
@@ -106,6 +209,11 @@ struct BREthereumBCSStruct {
      */
     BREthereumLES les;
 
+    /**
+     * If TRUE, `les` is shared with other BCS instances on `network` (see bcsSetSharedLES())
+     */
+    BREthereumBoolean lesIsShared;
+
     /**
      * Our event handler
      */
@@ -171,6 +279,18 @@ struct BREthereumBCSStruct {
     BRArrayOf(BREthereumHash) pendingTransactions;
     BRArrayOf(BREthereumHash) pendingLogs;
 
+    /**
+     * A BRArray of poll schedules, one for each of `pendingTransactions` at the same index.  With
+     * many pending transactions, older ones are polled less often to save LES flow-control budget;
+     * they are still included promptly when found in an announced block.
+     */
+    BRArrayOf(BREthereumBCSPendingPoll) pendingTransactionPolls;
+
+    /**
+     * The number of status cycles, one per BCS_TRANSACTION_CHECK_STATUS_SECONDS.
+     */
+    uint64_t pendingCycle;
+
     /**
      * A BRSet of transactions for account.  This includes any and all transactions that we've
      * ever identified/created for account no matter the transaction's status.  Specifically,
@@ -204,6 +324,13 @@ struct BREthereumBCSStruct {
      * Proof of Work
      */
     BREthereumProofOfWork pow;
+
+    /**
+     * The bytes held, as last counted on the BCS thread, by bcsUpdateMemoryUsage(); guarded by
+     * `memoryLock` as bcsGetMemoryUsage() is called from any thread.
+     */
+    BREthereumBCSMemory memory;
+    pthread_mutex_t memoryLock;
 };
 
 extern const BREventType *bcsEventTypes[];
@@ -298,6 +425,51 @@ extern void
 bcsSignalLog (BREthereumBCS bcs,
               BREthereumLog log);
 
+//
+// Addresses
+//
+extern void
+bcsHandleAddAddress (BREthereumBCS bcs,
+                     BREthereumAddress address,
+                     BREthereumBCSSubscriber subscriber);
+
+extern void
+bcsSignalAddAddress (BREthereumBCS bcs,
+                     BREthereumAddress address,
+                     BREthereumBCSSubscriber subscriber);
+
+extern void
+bcsHandleRemoveAddress (BREthereumBCS bcs,
+                        BREthereumAddress address);
+
+extern void
+bcsSignalRemoveAddress (BREthereumBCS bcs,
+                        BREthereumAddress address);
+
+//
+// Log Query
+//
+extern void
+bcsHandleQueryLogs (BREthereumBCS bcs,
+                    BREthereumBCSLogQuery query);
+
+extern void
+bcsSignalQueryLogs (BREthereumBCS bcs,
+                    BREthereumBCSLogQuery query);
+
+extern void
+bcsHandleQueryLogsProvision (BREthereumBCSLogQuery query,
+                             BREthereumLES les,
+                             BREthereumNodeReference node,
+                             BREthereumProvisionResult result);
+
+// The BREthereumLESProvisionCallback for a query's receipts, with `query` as the context.
+extern void
+bcsSignalQueryLogsProvision (BREthereumBCSLogQuery query,
+                             BREthereumLES les,
+                             BREthereumNodeReference node,
+                             BREthereumProvisionResult result);
+
 //
 // Peers
 //
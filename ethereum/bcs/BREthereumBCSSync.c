@@ -19,6 +19,21 @@ syncRangeComplete (BREthereumBCSSyncRange child);
 static void
 syncRangeDispatch (BREthereumBCSSyncRange range);
 
+static void
+syncRangeDispatchChildren (BREthereumBCSSyncRange range);
+
+static int
+syncRangeAcquireNode (BREthereumBCSSyncRange range);
+
+static void
+syncRangeReleaseNode (BREthereumBCSSyncRange range);
+
+static void
+syncRangeHandleFailure (BREthereumBCSSyncRange range);
+
+static BREthereumBCSSyncRange
+syncRangeGetRoot (BREthereumBCSSyncRange range);
+
 static void
 computeOptimalStep (uint64_t numberOfBlocks,
                     uint64_t *optimalStep,
@@ -92,9 +107,21 @@ struct BREthereumBCSSyncRangeRecord {
     /** LES for Node interactions */
     BREthereumLES les;
 
-    /** LES Node we sync to */
+    /** LES Node we sync to; assigned when a range with a LES request is dispatched */
     BREthereumNodeReference node;
 
+    /** TRUE (non-zero) once dispatched */
+    int dispatched;
+
+    /** The number of times a LES request failed and the range was dispatched again */
+    unsigned int retries;
+
+    /** TRUE (non-zero) if a N_ARY range requested its boundary hashes as CHT header proofs */
+    int proofs;
+
+    /** TRUE (non-zero) if a proofs request failed; the range then requests headers */
+    int proofsFailed;
+
     /** Event query handling our events */
     BREventHandler handler;
 
@@ -127,7 +154,7 @@ struct BREthereumBCSSyncRangeRecord {
     /**
      * The result headers.  Once we get a set of headers, we make/will ask for the account state
      * at each header.  If the account state changed between two headers, we'll need to make
-     * a recusive request for headers - for that request we'll need the header block number.
+     * a recusive request for headers.  Remains NULL if the hashes came from header proofs.
      */
     BRArrayOf(BREthereumBlockHeader) headers;
 
@@ -210,6 +237,9 @@ syncRangeCreateDetailed (BREthereumAddress address,
 
 extern void
 syncRangeRelease (BREthereumBCSSyncRange range) {
+    // A dispatched range may have an outstanding LES request with `range` as its context.
+    if (range->dispatched) lesCancelProvisions (range->les, (BREthereumLESProvisionContext) range);
+
     if (NULL != range->children) {
         for (size_t index = 0; index < array_count(range->children); index++) {
             range->children[index]->parent = NULL;
@@ -395,30 +425,72 @@ syncRangeCreate (BREthereumAddress address,
     return root;
 }
 
+/**
+ * Return TRUE (non-zero) if every boundary block of the N_ARY `range` is covered by the CHT, given
+ * that the chain extends through the root's head.
+ */
+static int
+syncRangeIsCoveredByProofs (BREthereumBCSSyncRange range) {
+    uint64_t chainNumber = syncRangeGetRoot(range)->head;
+
+    // Block 0 has no CHT number; see messageLESGetChtNumber()
+    if (0 == range->tail || chainNumber < SYNC_BLOCK_PROOF_CONFIRMATIONS) return 0;
+
+    // The CHT covers blocks below the oldest section lacking confirmations.
+    uint64_t coveredNumber = (((chainNumber - SYNC_BLOCK_PROOF_CONFIRMATIONS) / SYNC_BLOCK_PROOF_PERIOD)
+                              * SYNC_BLOCK_PROOF_PERIOD);
+
+    return range->head < coveredNumber;
+}
+
 /**
  * Dispatch a Sync Range by a) issuing a LES request and/or b) dispatching any children.
  */
 static void
 syncRangeDispatch (BREthereumBCSSyncRange range) {
-    if (NULL == range->parent)
+    // A range is dispatched again when it had been waiting on a node or when its node failed.
+    int isRedispatch = range->dispatched;
+    range->dispatched = 1;
+
+    if (NULL == range->parent && !isRedispatch)
         eth_log ("BCS", "Sync: Start%s", "");
 
     syncRangeReport(range, "Dispatch");
 
-    if (NULL == range->parent)
+    if (NULL == range->parent && !isRedispatch)
         // Callback to announce sync start
         range->callback (range->context, range, NULL, range->tail);
 
     switch (range->type) {
         case SYNC_LINEAR_SMALL:
         case SYNC_N_ARY:
-            lesProvideBlockHeaders (range->les, range->node,
-                                    (BREthereumLESProvisionContext) range,
-                                    (BREthereumLESProvisionCallback) bcsSyncSignalProvision,
-                                    range->tail,
-                                    (uint32_t) (range->count + 1),  // both endpoints
-                                    range->step - 1,   // skip
-                                    ETHEREUM_BOOLEAN_FALSE);
+            // If every node is busy, `range` waits and is dispatched again once a node frees up.
+            if (!syncRangeAcquireNode (range)) break;
+
+            // A N_ARY range jumps directly to its boundary hashes, proven by the CHT, if it can.
+            range->proofs = (SYNC_N_ARY == range->type &&
+                             !range->proofsFailed &&
+                             syncRangeIsCoveredByProofs (range));
+
+            if (range->proofs) {
+                BRArrayOf(uint64_t) numbers;
+                array_new (numbers, range->count + 1);
+                for (uint64_t index = 0; index <= range->count; index++)
+                    array_add (numbers, range->tail + index * range->step);
+
+                lesProvideBlockProofs (range->les, range->node,
+                                       (BREthereumLESProvisionContext) range,
+                                       (BREthereumLESProvisionCallback) bcsSyncSignalProvision,
+                                       numbers);
+            }
+            else
+                lesProvideBlockHeaders (range->les, range->node,
+                                        (BREthereumLESProvisionContext) range,
+                                        (BREthereumLESProvisionCallback) bcsSyncSignalProvision,
+                                        range->tail,
+                                        (uint32_t) (range->count + 1),  // both endpoints
+                                        range->step - 1,   // skip
+                                        ETHEREUM_BOOLEAN_FALSE);
             break;
 
         case SYNC_MIXED:
@@ -427,11 +499,27 @@ syncRangeDispatch (BREthereumBCSSyncRange range) {
             if (0 == array_count(range->children))
                 syncRangeComplete(range);
             else
-                syncRangeDispatch(range->children[0]);
+                syncRangeDispatchChildren(range);
             break;
     }
 }
 
+/**
+ * Dispatch the children of `range` that are not yet dispatched.  The children of a SYNC_MIXED
+ * range are dispatched one at a time, in order, so that the last child - the linear sync that
+ * fills the chain through `head` - is dispatched last.  All other children are dispatched
+ * together and proceed concurrently over as many nodes as the sync has (they are independent
+ * block ranges).
+ */
+static void
+syncRangeDispatchChildren (BREthereumBCSSyncRange range) {
+    size_t count = (SYNC_MIXED == range->type ? 1 : array_count (range->children));
+
+    for (size_t index = 0; index < count; index++)
+        if (!range->children[index]->dispatched)
+            syncRangeDispatch (range->children[index]);
+}
+
 /**
  * Get the root for `range`.
  */
@@ -472,9 +560,9 @@ syncRangeComplete (BREthereumBCSSyncRange child) {
     assert (NULL == child->children || array_count(child->children) == 0);
     syncRangeRelease(child);
 
-    // If we have children remaining, then dispatch the first one; otherwise ...
+    // If we have children remaining, then dispatch any still waiting; otherwise ...
     if (array_count(parent->children) > 0)
-        syncRangeDispatch(parent->children[0]);
+        syncRangeDispatchChildren(parent);
 
     // ... parent is complete.
     else
@@ -483,6 +571,16 @@ syncRangeComplete (BREthereumBCSSyncRange child) {
 
 /// MARK: - Sync
 
+/**
+ * A node that a sync dispatches ranges to.
+ */
+typedef struct {
+    BREthereumNodeReference node;
+
+    /** The number of ranges with a LES request outstanding on `node` */
+    size_t requests;
+} BREthereumBCSSyncNode;
+
 /**
  * A BCS Sync handles ongoing sync reqeusts.  A call to bcsSyncContinue() will start a sync as
  * needed.
@@ -505,6 +603,16 @@ struct BREthereumBCSSyncStruct {
     /** The root `range`, if a sync is in progress */
     BREthereumBCSSyncRange root;
 
+    /** The nodes that ranges are dispatched to */
+    BREthereumBCSSyncNode nodes[SYNC_NODE_COUNT];
+    size_t nodesCount;
+
+    /** Ranges waiting to be dispatched until a node has fewer than SYNC_NODE_REQUESTS_MAXIMUM */
+    BRArrayOf(BREthereumBCSSyncRange) pending;
+
+    /** The highest block number reported as progress */
+    uint64_t progressNumber;
+
     /** Accumulated sync results.  Will be periodically reported with the callback. */
     BRArrayOf(BREthereumBCSSyncResult) results;
 };
@@ -532,6 +640,10 @@ bcsSyncCreate (BREthereumBCSSyncContext context,
     // No sync in progress.
     sync->root = NULL;
 
+    sync->nodesCount = 0;
+    array_new (sync->pending, 10);
+    sync->progressNumber = 0;
+
     // Allocate `result` with at most BCS_SYNC_RESULT_PERIOD results.
     array_new (sync->results, BCS_SYNC_RESULT_PERIOD);
     return sync;
@@ -542,8 +654,9 @@ bcsSyncCreate (BREthereumBCSSyncContext context,
  */
 extern void
 bcsSyncRelease (BREthereumBCSSync sync) {
-    // TODO: Recursively release `root`; ensure that pending LES callbacks don't crash.
+    // Recursively release `root`; any pending LES callbacks are cancelled.
     if (NULL != sync->root) syncRangeRelease(sync->root);
+    array_free (sync->pending);
 
     if (NULL != sync->results) {
         for (size_t index = 0; index < array_count(sync->results); index++)
@@ -563,6 +676,100 @@ bcsSyncIsActive (BREthereumBCSSync sync) {
     return AS_ETHEREUM_BOOLEAN(NULL != sync->root);
 }
 
+/**
+ * Return the sync that owns `range`.
+ */
+static BREthereumBCSSync
+syncRangeGetSync (BREthereumBCSSyncRange range) {
+    return (BREthereumBCSSync) syncRangeGetRoot(range)->context;
+}
+
+/**
+ * Replace the sync's nodes with the connected LES nodes, `preferred` first if it is specific.
+ */
+static void
+syncUpdateNodes (BREthereumBCSSync sync,
+                 BREthereumNodeReference preferred) {
+    BREthereumNodeReference nodes[SYNC_NODE_COUNT];
+    size_t nodesCount = lesGetNodes (sync->les, nodes, SYNC_NODE_COUNT);
+
+    sync->nodesCount = 0;
+    if (!NODE_REFERENCE_IS_GENERIC (preferred))
+        sync->nodes[sync->nodesCount++] = (BREthereumBCSSyncNode) { preferred, 0 };
+
+    for (size_t index = 0; index < nodesCount && sync->nodesCount < SYNC_NODE_COUNT; index++)
+        if (preferred != nodes[index])
+            sync->nodes[sync->nodesCount++] = (BREthereumBCSSyncNode) { nodes[index], 0 };
+}
+
+/**
+ * Remove `node` from the sync's nodes.  Ranges with a request outstanding on `node` will fail
+ * or succeed on their own; when released they simply won't find `node`.
+ */
+static void
+syncRemoveNode (BREthereumBCSSync sync,
+                BREthereumNodeReference node) {
+    for (size_t index = 0; index < sync->nodesCount; index++)
+        if (node == sync->nodes[index].node) {
+            for (sync->nodesCount--; index < sync->nodesCount; index++)
+                sync->nodes[index] = sync->nodes[index + 1];
+            break;
+        }
+}
+
+/**
+ * Return the index of the sync node with the fewest outstanding requests, if it has fewer than
+ * SYNC_NODE_REQUESTS_MAXIMUM; otherwise return `nodesCount`.
+ */
+static size_t
+syncFindNode (BREthereumBCSSync sync) {
+    size_t found = sync->nodesCount;
+    for (size_t index = 0; index < sync->nodesCount; index++)
+        if (sync->nodes[index].requests < SYNC_NODE_REQUESTS_MAXIMUM &&
+            (found == sync->nodesCount || sync->nodes[index].requests < sync->nodes[found].requests))
+            found = index;
+    return found;
+}
+
+/**
+ * Assign a node to `range`, in preparation for a LES request.  If no node has room for another
+ * request then add `range` to the sync's pending ranges and return FALSE (zero).
+ */
+static int
+syncRangeAcquireNode (BREthereumBCSSyncRange range) {
+    BREthereumBCSSync sync = syncRangeGetSync (range);
+    size_t index = syncFindNode (sync);
+
+    if (index == sync->nodesCount) {
+        array_add (sync->pending, range);
+        return 0;
+    }
+
+    sync->nodes[index].requests += 1;
+    range->node = sync->nodes[index].node;
+    return 1;
+}
+
+/**
+ * Release the node assigned to `range` and dispatch as many pending ranges as now fit.
+ */
+static void
+syncRangeReleaseNode (BREthereumBCSSyncRange range) {
+    BREthereumBCSSync sync = syncRangeGetSync (range);
+
+    for (size_t index = 0; index < sync->nodesCount; index++)
+        if (range->node == sync->nodes[index].node) {
+            if (sync->nodes[index].requests > 0) sync->nodes[index].requests -= 1;
+            break;
+        }
+
+    while (array_count (sync->pending) > 0 && syncFindNode (sync) < sync->nodesCount) {
+        BREthereumBCSSyncRange pending = sync->pending[0];
+        array_rm (sync->pending, 0);
+        syncRangeDispatch (pending);
+    }
+}
+
 /**
  * The callback for sync ranges.  If `header` is NULL, then we are simply announcing progress.  If
  * `header` is not NULL then add `header` to `results` and periodically invoke the sync callback
@@ -601,8 +808,11 @@ bcsSyncRangeCallback (BREthereumBCSSync sync,
     // It can be reported twice when the last child of `root` completes and then `root`
     // itself completes.
 
-    // If we are not at the end, just report it and skip out.
+    // If we are not at the end, just report it and skip out.  Ranges complete out of order when
+    // dispatched over several nodes; only report progress that advances.
     if (headerNumber != range->head) {
+        if (headerNumber < sync->progressNumber) return;
+        sync->progressNumber = headerNumber;
         sync->callbackProgress (sync->context,
                                 sync,
                                 range->node,
@@ -643,15 +853,21 @@ bcsSyncStart (BREthereumBCSSync sync,
     if (needBlockNumber <= chainBlockNumber) return;
     uint64_t total = needBlockNumber - chainBlockNumber;
 
-    // If `node` is generic, we need to find LES's preferred node.
-    if (NODE_REFERENCE_IS_GENERIC (node)) {
+    // Find the nodes to sync with, starting with `node` if it is specific.
+    syncUpdateNodes (sync, node);
+
+    // If we've no connected nodes, we need to find LES's preferred node.
+    if (0 == sync->nodesCount) {
         node = lesGetNodePrefer (sync->les);
         // If still 'generic' (specifically NIL), skip this sync.
         if (NODE_REFERENCE_NIL == node) {
             eth_log ("BCS", "Sync: Start Skipped: No suitable nodes%s", "");
             return;
         }
+        sync->nodes[sync->nodesCount++] = (BREthereumBCSSyncNode) { node, 0 };
     }
+    node = sync->nodes[0].node;
+    sync->progressNumber = 0;
 
     // We MUST have the last N headers be from a linear sync.  This is required to 'fill the
     // BCS chain' and allows `needBlockNumber` to be the head (bcs->chain) which then allows
@@ -736,6 +952,9 @@ bcsSyncStopInternal (BREthereumBCSSync sync,
 
     syncRangeRelease(sync->root);
     sync->root = NULL;
+
+    array_clear (sync->pending);
+    sync->nodesCount = 0;
 }
 
 extern void
@@ -775,7 +994,7 @@ bcsSyncHandleBlockHeaders (BREthereumBCSSyncRange range,
             for (size_t index = 0; index < count; index++)
                 array_add (hashes,  blockHeaderGetHash (headers[index]));
 
-            lesProvideAccountStates (range->les, node,
+            lesProvideAccountStates (range->les, range->node,
                                      (BREthereumLESProvisionContext) range,
                                      (BREthereumLESProvisionCallback) bcsSyncSignalProvision,
                                      range->address,
@@ -792,12 +1011,53 @@ bcsSyncHandleBlockHeaders (BREthereumBCSSyncRange range,
                 root->callback (root->context, range, headers[index], 0);
 
             array_free (headers);
+            syncRangeReleaseNode (range);
             syncRangeComplete (range);
             break;
         }
     }
 }
 
+/**
+ * Given the header proofs for a N_ARY range, request the account states at the proven hashes.  If
+ * any proof failed, handle as a failed request - the range falls back to requesting headers.
+ */
+static void
+bcsSyncHandleBlockProofs (BREthereumBCSSyncRange range,
+                          BREthereumNodeReference node,
+                          OwnershipGiven BRArrayOf(uint64_t) numbers,
+                          OwnershipGiven BRArrayOf(BREthereumBlockHeaderProof) proofs) {
+    assert (1 + range->count == array_count(proofs));
+    assert (SYNC_N_ARY == range->type);
+    size_t count = array_count(proofs);
+
+    // An invalid proof has a zero total difficulty
+    int proofsValid = 1;
+    for (size_t index = 0; index < count && proofsValid; index++)
+        proofsValid = !eqUInt256 (proofs[index].totalDifficulty, UINT256_ZERO);
+
+    BRArrayOf(BREthereumHash) hashes = NULL;
+    if (proofsValid) {
+        array_new (hashes, count);
+        for (size_t index = 0; index < count; index++)
+            array_add (hashes, proofs[index].hash);
+    }
+
+    array_free (numbers);
+    array_free (proofs);
+
+    if (!proofsValid) {
+        syncRangeHandleFailure (range);
+        return;
+    }
+
+    lesProvideAccountStates (range->les, range->node,
+                             (BREthereumLESProvisionContext) range,
+                             (BREthereumLESProvisionCallback) bcsSyncSignalProvision,
+                             range->address,
+                             hashes);
+}
+
 /**
  * Given all the accoun states, compare each pair of consecutive accounts and if different create a
  * new subrange as a child to range.  Once all accounts have been compared then dispatch on the
@@ -822,13 +1082,11 @@ bcsSyncHandleAccountStates (BREthereumBCSSyncRange range,
 
         // If we found an AcountState change...
         if (ETHEREUM_BOOLEAN_IS_FALSE(accountStateEqual(oldState, newState))) {
-            BREthereumBlockHeader oldHeader = range->headers[index - 1];
-            BREthereumBlockHeader newHeader = range->headers[index];
+            // The states are at the boundaries - from headers or from header proofs.
+            uint64_t oldNumber = range->tail + (index - 1) * range->step;
+            uint64_t newNumber = range->tail + (index + 0) * range->step;
 
-            uint64_t oldNumber = blockHeaderGetNumber(oldHeader);
-            uint64_t newNumber = blockHeaderGetNumber(newHeader);
-
-            assert (newNumber > oldNumber);
+            assert (NULL == range->headers || blockHeaderGetNumber (range->headers[index]) == newNumber);
 
             // ... then we need to explore this header range, recursively.
             syncRangeAddChild (range,
@@ -848,14 +1106,17 @@ bcsSyncHandleAccountStates (BREthereumBCSSyncRange range,
     array_free (hashes);
     array_free (states);
 
-    // Release range->result.
+    // Release range->result, if headers were requested.
     blockHeadersRelease(range->headers);
     range->headers = NULL;
 
-    // If we now have children, dispatch on the first one.  As each one completes, we'll
-    // dispatch on the subsequent ones until this N_ARY range itself completes.
+    // The range's LES requests are done; let a pending range have the node.
+    syncRangeReleaseNode (range);
+
+    // If we now have children, dispatch them - concurrently, as nodes allow.  As each one
+    // completes, it is removed until this N_ARY range itself completes.
     if (NULL != range->children && array_count(range->children) > 0)
-        syncRangeDispatch(range->children[0]);
+        syncRangeDispatchChildren(range);
 
     // Otherwise nothing left, completely complete here and now.
     else
@@ -912,6 +1173,49 @@ extern void optimal (uint64_t number) { computeOptimalStep (number, &optimalStep
 
 
 
+/**
+ * Handle a failed LES request for `range` by dropping the range's node from the sync and then
+ * dispatching `range` again, on another node.  If `range` has failed too often or if no nodes
+ * remain, stop the sync.
+ */
+static void
+syncRangeHandleFailure (BREthereumBCSSyncRange range) {
+    BREthereumBCSSync sync = syncRangeGetSync (range);
+
+    // Nodes need not serve CHT proofs (or states at proven hashes); if the proofs failed, the
+    // range requests headers instead - without dropping the node.
+    if (range->proofs) {
+        eth_log ("BCS", "Sync: Proofs Failed: {%" PRIu64 ", %" PRIu64 "}", range->tail, range->head);
+        range->proofsFailed = 1;
+        syncRangeReleaseNode (range);
+        syncRangeDispatch (range);
+        return;
+    }
+
+    syncRemoveNode (sync, range->node);
+
+    // A N_ARY range may have failed on account states; it will request headers again.
+    if (NULL != range->headers) {
+        blockHeadersRelease (range->headers);
+        range->headers = NULL;
+    }
+
+    if (++range->retries > SYNC_RANGE_RETRY_MAXIMUM) {
+        bcsSyncStopInternal (sync, "provision failed");
+        return;
+    }
+
+    if (0 == sync->nodesCount) syncUpdateNodes (sync, NODE_REFERENCE_NIL);
+    if (0 == sync->nodesCount) {
+        bcsSyncStopInternal (sync, "provision failed; no suitable nodes");
+        return;
+    }
+
+    eth_log ("BCS", "Sync: Reassign: {%" PRIu64 ", %" PRIu64 "} (retry %u)",
+             range->tail, range->head, range->retries);
+    syncRangeDispatch (range);
+}
+
 extern void
 bcsSyncHandleProvision (BREthereumBCSSyncRange range,
                         BREthereumLES les,
@@ -921,11 +1225,10 @@ bcsSyncHandleProvision (BREthereumBCSSyncRange range,
 
     BREthereumProvision *provision = &result.provision;
     switch (result.status) {
-        case PROVISION_ERROR: {
-            BREthereumBCSSyncRange root = syncRangeGetRoot (range);
-            bcsSyncStopInternal((BREthereumBCSSync) root->context, "provision failed");
+        case PROVISION_ERROR:
+            syncRangeHandleFailure (range);
             break;
-        }
+
         case PROVISION_SUCCESS: {
             assert (result.type == provision->type);
             switch (result.type) {
@@ -936,9 +1239,14 @@ bcsSyncHandleProvision (BREthereumBCSSyncRange range,
                     break;
                 }
 
-                case PROVISION_BLOCK_PROOFS:
-                    assert (0);
-                    
+                case PROVISION_BLOCK_PROOFS: {
+                    BRArrayOf(uint64_t) numbers;
+                    BRArrayOf(BREthereumBlockHeaderProof) proofs;
+                    provisionProofsConsume (&provision->u.proofs, &numbers, &proofs);
+                    bcsSyncHandleBlockProofs (range, node, numbers, proofs);
+                    break;
+                }
+
                 case PROVISION_BLOCK_BODIES:
                     assert (0);
 
@@ -12,6 +12,7 @@
 #include <string.h>
 #include <assert.h>
 #include "support/BRArray.h"
+#include "support/BRCrypto.h"
 #include "ethereum/base/BREthereumLogic.h"
 #include "BREthereumBlock.h"
 #include "BREthereumLog.h"
@@ -20,6 +21,9 @@
 // we don't miss the account's initial block.
 #define BLOCK_CHECKPOINT_TIMESTAMP_SAFETY      (2 * 7 * 24 * 60 * 60)  // two weeks
 
+// A block includes at most two ommers (uncles); a longer list is not a valid block.
+#define BLOCK_OMMERS_MAXIMUM          (2)
+
 //#define BLOCK_LOG_ALLOC_COUNT
 
 #if defined (BLOCK_LOG_ALLOC_COUNT)
@@ -157,6 +161,12 @@ struct BREthereumBlockHeaderRecord {
      * computation has been carried out on this block; formally Hn.
      */
     uint64_t nonce;
+
+    /**
+     * The RLP encoding, with the nonce, once encoded.  A header is immutable; this is held until
+     * release.  Never copied.
+     */
+    BRRlpData rlpEncoding;
 };
 
 static BREthereumBlockHeader
@@ -200,6 +210,9 @@ extern BREthereumBlockHeader
 blockHeaderCopy (BREthereumBlockHeader source) {
     BREthereumBlockHeader header = (BREthereumBlockHeader) calloc (1, sizeof (struct BREthereumBlockHeaderRecord));
     *header = *source;
+
+    // The encoding is held by `source`; the copy encodes anew.
+    header->rlpEncoding = (BRRlpData) { 0, NULL };
 #if defined (BLOCK_HEADER_LOG_ALLOC_COUNT)
     eth_log ("MEM", "Block Header Copy  %d", ++blockHeaderAllocCount);
 #endif
@@ -223,6 +236,7 @@ blockHeaderRelease (BREthereumBlockHeader header) {
         eth_log ("MEM", "Block Header Release %d", --blockHeaderAllocCount);
 #endif
         assert (ETHEREUM_BOOLEAN_IS_FALSE(hashEqual(header->hash, hashCreateEmpty())));
+        rlpDataRelease (header->rlpEncoding);
         memset (header, 0, sizeof(struct BREthereumBlockHeaderRecord));
         free (header);
     }
@@ -305,12 +319,63 @@ blockHeaderMatch (BREthereumBlockHeader header,
     return bloomFilterMatch(header->logsBloom, filter);
 }
 
+extern size_t
+blockHeadersMatch (BREthereumBlockHeader *headers,
+                   size_t headersCount,
+                   BREthereumBloomFilter filter,
+                   BREthereumBoolean *matches) {
+    size_t matchesCount = 0;
+    for (size_t index = 0; index < headersCount; index++) {
+        BREthereumBoolean match = bloomFilterMatch (headers[index]->logsBloom, filter);
+        if (NULL != matches) matches[index] = match;
+        matchesCount += ETHEREUM_BOOLEAN_IS_TRUE (match);
+    }
+    return matchesCount;
+}
+
 extern BREthereumBoolean
 blockHeaderMatchAddress (BREthereumBlockHeader header,
                          BREthereumAddress address) {
+    return blockHeaderMatchAddressFilters (header, blockAddressFiltersCreate (address));
+}
+
+extern BREthereumBlockAddressFilters
+blockAddressFiltersCreate (BREthereumAddress address) {
+    return (BREthereumBlockAddressFilters) {
+        bloomFilterCreateAddress (address),
+        logTopicGetBloomFilterAddress (address)
+    };
+}
+
+extern BREthereumBoolean
+blockHeaderMatchAddressFilters (BREthereumBlockHeader header,
+                                BREthereumBlockAddressFilters filters) {
     return AS_ETHEREUM_BOOLEAN
-    (ETHEREUM_BOOLEAN_IS_TRUE (blockHeaderMatch (header, bloomFilterCreateAddress (address))) ||
-     ETHEREUM_BOOLEAN_IS_TRUE (blockHeaderMatch (header, logTopicGetBloomFilterAddress (address))));
+    (ETHEREUM_BOOLEAN_IS_TRUE (blockHeaderMatch (header, filters.transactions)) ||
+     ETHEREUM_BOOLEAN_IS_TRUE (blockHeaderMatch (header, filters.logs)));
+}
+
+extern BREthereumBloomFilterSet
+blockAddressesFiltersCreate (const BREthereumAddress *addresses,
+                             size_t addressesCount) {
+    // Heap allocated; at 256 bytes per filter, many addresses would overflow the stack.
+    BREthereumBloomFilter *filters = calloc (2 * addressesCount + 1, sizeof (BREthereumBloomFilter));
+
+    for (size_t index = 0; index < addressesCount; index++) {
+        BREthereumBlockAddressFilters addressFilters = blockAddressFiltersCreate (addresses[index]);
+        filters[2 * index + 0] = addressFilters.transactions;
+        filters[2 * index + 1] = addressFilters.logs;
+    }
+    BREthereumBloomFilterSet set = bloomFilterSetCreate (filters, 2 * addressesCount);
+
+    free (filters);
+    return set;
+}
+
+extern BREthereumBoolean
+blockHeaderMatchAddresses (BREthereumBlockHeader header,
+                           BREthereumBloomFilterSet filters) {
+    return bloomFilterSetMatch (filters, header->logsBloom);
 }
 
 extern uint64_t
@@ -528,14 +593,17 @@ blockHeaderIsValid (BREthereumBlockHeader header,
 // Block Header RLP Encode / Decode
 //
 //
-extern BRRlpItem
-blockHeaderRlpEncode (BREthereumBlockHeader header,
-                      BREthereumBoolean withNonce,
-                      BREthereumRlpType type,
-                      BRRlpCoder coder) {
+static BRRlpItem
+blockHeaderRlpEncodeFields (BREthereumBlockHeader header,
+                            BREthereumBoolean withNonce,
+                            BRRlpCoder coder) {
     BRRlpItem items[15];
     size_t itemsCount = ETHEREUM_BOOLEAN_IS_TRUE(withNonce) ? 15 : 13;
 
+    // Without the nonce, the encoding is only ever hashed - as the proof of work 'seal' - and
+    // must match the canonical encoding the miner hashed, with zero as the empty string.
+    int zeroAsEmptyString = ETHEREUM_BOOLEAN_IS_FALSE(withNonce);
+
     items[ 0] = hashRlpEncode(header->parentHash, coder);
     items[ 1] = hashRlpEncode(header->ommersHash, coder);
     items[ 2] = addressRlpEncode(header->beneficiary, coder);
@@ -543,11 +611,11 @@ blockHeaderRlpEncode (BREthereumBlockHeader header,
     items[ 4] = hashRlpEncode(header->transactionsRoot, coder);
     items[ 5] = hashRlpEncode(header->receiptsRoot, coder);
     items[ 6] = bloomFilterRlpEncode(header->logsBloom, coder);
-    items[ 7] = rlpEncodeUInt256 (coder, header->difficulty, 0);
-    items[ 8] = rlpEncodeUInt64(coder, header->number, 0);
-    items[ 9] = rlpEncodeUInt64(coder, header->gasLimit, 0);
-    items[10] = rlpEncodeUInt64(coder, header->gasUsed, 0);
-    items[11] = rlpEncodeUInt64(coder, header->timestamp, 0);
+    items[ 7] = rlpEncodeUInt256 (coder, header->difficulty, zeroAsEmptyString);
+    items[ 8] = rlpEncodeUInt64(coder, header->number, zeroAsEmptyString);
+    items[ 9] = rlpEncodeUInt64(coder, header->gasLimit, zeroAsEmptyString);
+    items[10] = rlpEncodeUInt64(coder, header->gasUsed, zeroAsEmptyString);
+    items[11] = rlpEncodeUInt64(coder, header->timestamp, zeroAsEmptyString);
     items[12] = rlpEncodeBytes(coder, header->extraData, header->extraDataCount);
 
     if (ETHEREUM_BOOLEAN_IS_TRUE(withNonce)) {
@@ -558,10 +626,30 @@ blockHeaderRlpEncode (BREthereumBlockHeader header,
     return rlpEncodeListItems(coder, items, itemsCount);
 }
 
-extern BREthereumBlockHeader
-blockHeaderRlpDecode (BRRlpItem item,
+extern BRRlpItem
+blockHeaderRlpEncode (BREthereumBlockHeader header,
+                      BREthereumBoolean withNonce,
                       BREthereumRlpType type,
                       BRRlpCoder coder) {
+    // Without the nonce, the encoding is only hashed once, for the proof of work; don't hold it.
+    if (ETHEREUM_BOOLEAN_IS_FALSE(withNonce))
+        return blockHeaderRlpEncodeFields (header, withNonce, coder);
+
+    if (NULL == header->rlpEncoding.bytes) {
+        BRRlpItem item = blockHeaderRlpEncodeFields (header, withNonce, coder);
+        header->rlpEncoding = rlpGetData (coder, item);
+        return item;
+    }
+
+    return rlpGetItem (coder, header->rlpEncoding);
+}
+
+// Decode every header field but the hash, which is the Keccak256 of the header's RLP encoding and
+// is filled in by the callers below - one at a time or, for a list of headers, in a single batch.
+static BREthereumBlockHeader
+blockHeaderRlpDecodeUnhashed (BRRlpItem item,
+                              BREthereumRlpType type,
+                              BRRlpCoder coder) {
     BREthereumBlockHeader header = (BREthereumBlockHeader) calloc (1, sizeof(struct BREthereumBlockHeaderRecord));
 
     size_t itemsCount = 0;
@@ -598,12 +686,57 @@ blockHeaderRlpDecode (BRRlpItem item,
     eth_log ("MEM", "Block Header Create RLP: %d", ++blockHeaderAllocCount);
 #endif
 
+    return header;
+}
+
+extern BREthereumBlockHeader
+blockHeaderRlpDecode (BRRlpItem item,
+                      BREthereumRlpType type,
+                      BRRlpCoder coder) {
+    BREthereumBlockHeader header = blockHeaderRlpDecodeUnhashed (item, type, coder);
+
     BRRlpData data = rlpGetDataSharedDontRelease(coder, item);
     header->hash = hashCreateFromData(data);
     // Safe to ignore data release.
 
     return header;
+}
+
+extern BRArrayOf(BREthereumBlockHeader)
+blockHeadersRlpDecode (BRRlpItem item,
+                       size_t headersLimit,
+                       BREthereumRlpType type,
+                       BRRlpCoder coder) {
+    size_t itemsCount = 0;
+    const BRRlpItem *items = rlpDecodeList(coder, item, &itemsCount);
+
+    // The count is the sender's; more than could be asked for is an error, not an allocation.
+    if (itemsCount > headersLimit) itemsCount = 0;
+
+    BRArrayOf (BREthereumBlockHeader) headers;
+    array_new (headers, itemsCount);
+
+    void **hashes       = calloc (itemsCount > 0 ? itemsCount : 1, sizeof (void *));
+    const void **datas  = calloc (itemsCount > 0 ? itemsCount : 1, sizeof (void *));
+    size_t *datasCount  = calloc (itemsCount > 0 ? itemsCount : 1, sizeof (size_t));
+
+    for (size_t index = 0; index < itemsCount; index++) {
+        BREthereumBlockHeader header = blockHeaderRlpDecodeUnhashed (items[index], type, coder);
+        BRRlpData data = rlpGetDataSharedDontRelease (coder, items[index]);
+
+        hashes[index] = header->hash.bytes;
+        datas[index] = data.bytes;
+        datasCount[index] = data.bytesCount;
+        array_add (headers, header);
+    }
+
+    // Hash all the headers together; a LES response holds up to hundreds of them.
+    BRKeccak256Batch (hashes, datas, datasCount, itemsCount);
 
+    free (datasCount);
+    free (datas);
+    free (hashes);
+    return headers;
 }
 
 /// MARK: - Block
@@ -625,6 +758,11 @@ struct BREthereumBlockRecord {
      */
     BREthereumTransaction *transactions;
 
+    /**
+     * The hashes of `transactions`, once those are released by blockCompactTransactions().
+     */
+    BRArrayOf(BREthereumHash) transactionHashes;
+
     /**
      * ... and a set of other block headers U that are known to have a parent equal to the present
      * block’s parent’s parent (such blocks are known as ommers).
@@ -698,6 +836,26 @@ blockUpdateBody (BREthereumBlock block,
     block->transactions = transactions;
 }
 
+extern void
+blockCompactTransactions (BREthereumBlock block) {
+    if (NULL == block->transactions) return;
+
+    size_t count = array_count (block->transactions);
+    array_new (block->transactionHashes, count);
+    for (size_t index = 0; index < count; index++)
+        array_add (block->transactionHashes, transactionGetHash (block->transactions[index]));
+
+    transactionsRelease (block->transactions);
+    block->transactions = NULL;
+}
+
+static BREthereumHash
+blockGetTransactionHash (BREthereumBlock block, size_t index) {
+    return (NULL != block->transactions
+            ? transactionGetHash (block->transactions[index])
+            : block->transactionHashes[index]);
+}
+
 extern void
 blockRelease (BREthereumBlock block) {
     blockHeaderRelease(block->header);
@@ -708,6 +866,9 @@ blockRelease (BREthereumBlock block) {
     transactionsRelease (block->transactions);
     block->transactions = NULL;
 
+    if (NULL != block->transactionHashes) array_free (block->transactionHashes);
+    block->transactionHashes = NULL;
+
     blockReleaseStatus (block, ETHEREUM_BOOLEAN_TRUE, ETHEREUM_BOOLEAN_TRUE);
     block->next = BLOCK_NEXT_NONE;
 
@@ -723,9 +884,46 @@ blockGetHeader (BREthereumBlock block) {
     return block->header;
 }
 
+static size_t
+blockHeaderGetMemoryUsage (BREthereumBlockHeader header) {
+    return sizeof (struct BREthereumBlockHeaderRecord) + header->rlpEncoding.bytesCount;
+}
+
+extern size_t
+blockGetMemoryUsage (BREthereumBlock block) {
+    size_t usage = (sizeof (struct BREthereumBlockRecord) +
+                    blockHeaderGetMemoryUsage (block->header));
+
+    if (NULL != block->ommers)
+        for (size_t index = 0; index < array_count (block->ommers); index++)
+            usage += blockHeaderGetMemoryUsage (block->ommers[index]);
+    usage += array_heap_size (block->ommers);
+
+    if (NULL != block->transactions)
+        for (size_t index = 0; index < array_count (block->transactions); index++)
+            usage += transactionGetMemoryUsage (block->transactions[index]);
+    usage += array_heap_size (block->transactions);
+    usage += array_heap_size (block->transactionHashes);
+
+    // The status' transactions and logs are held until BCS takes them (see blockReleaseStatus()).
+    if (NULL != block->status.transactions)
+        for (size_t index = 0; index < array_count (block->status.transactions); index++)
+            usage += transactionGetMemoryUsage (block->status.transactions[index]);
+    usage += array_heap_size (block->status.transactions);
+    if (NULL != block->status.logs)
+        for (size_t index = 0; index < array_count (block->status.logs); index++)
+            usage += logGetMemoryUsage (block->status.logs[index]);
+    usage += array_heap_size (block->status.logs);
+    usage += array_heap_size (block->status.gasUsed);
+
+    return usage;
+}
+
 extern unsigned long
 blockGetTransactionsCount (BREthereumBlock block) {
-    return array_count(block->transactions);
+    return (NULL != block->transactions
+            ? array_count(block->transactions)
+            : (NULL != block->transactionHashes ? array_count(block->transactionHashes) : 0));
 }
 
 extern BREthereumTransaction
@@ -902,13 +1100,13 @@ blockLinkLogsWithTransactions (BREthereumBlock block) {
 
         // Importantly, note that the log has no reference to the transaction itself.  And, if only
         // implicitly, we assume that `block` has the correct transaction at transactionIndex.
-        BREthereumTransaction transaction = block->transactions[transactionIndex];
+        BREthereumHash transactionHash = blockGetTransactionHash (block, transactionIndex);
 
         // The logIndex was assigned (w/o the transaction hash) from the receipts
         logExtractIdentifier(log, NULL, &logIndex);
 
         // Finally, a fully identified log
-        logInitializeIdentifier(log, transactionGetHash(transaction), logIndex);
+        logInitializeIdentifier(log, transactionHash, logIndex);
     }
 }
 
@@ -946,14 +1144,10 @@ blockTransactionsRlpDecode (BRRlpItem item,
 
     BRArrayOf(BREthereumTransaction) transactions;
     array_new(transactions, itemsCount);
+    array_set_count(transactions, itemsCount);
 
-    for (int i = 0; i < itemsCount; i++) {
-        BREthereumTransaction transaction = transactionRlpDecode(items[i],
-                                                                     network,
-                                                                     type,
-                                                                     coder);
-        array_add (transactions, transaction);
-    }
+    // Decode all at once; extracting each source address requires a costly public key recovery.
+    transactionRlpDecodeBatch (items, itemsCount, network, type, coder, transactions);
 
     return transactions;
 }
@@ -983,18 +1177,7 @@ blockOmmersRlpDecode (BRRlpItem item,
                       BREthereumNetwork network,
                       BREthereumRlpType type,
                       BRRlpCoder coder) {
-    size_t itemsCount = 0;
-    const BRRlpItem *items = rlpDecodeList(coder, item, &itemsCount);
-
-    BRArrayOf (BREthereumBlockHeader) headers;
-    array_new(headers, itemsCount);
-
-    for (int i = 0; i < itemsCount; i++) {
-        BREthereumBlockHeader header = blockHeaderRlpDecode(items[i], type, coder);
-        array_add (headers, header);
-    }
-
-    return headers;
+    return blockHeadersRlpDecode (item, BLOCK_OMMERS_MAXIMUM, type, coder);
 }
 
 //
@@ -1056,6 +1239,122 @@ blockRlpDecode (BRRlpItem item,
     return block;
 }
 
+/// MARK: - Block Header Record
+
+#define BLOCK_HEADER_RECORD_FLAG_PRESENT     (0x01)
+#define BLOCK_HEADER_RECORD_FLAG_TD          (0x02)
+
+static size_t
+blockHeaderRecordPut (uint8_t *record, size_t offset, const void *bytes, size_t bytesCount) {
+    memcpy (&record[offset], bytes, bytesCount);
+    return offset + bytesCount;
+}
+
+static size_t
+blockHeaderRecordPutUInt64 (uint8_t *record, size_t offset, uint64_t value) {
+    UInt64SetLE (&record[offset], value);
+    return offset + sizeof (uint64_t);
+}
+
+static size_t
+blockHeaderRecordPutUInt256 (uint8_t *record, size_t offset, UInt256 value) {
+    for (size_t index = 0; index < 4; index++)
+        offset = blockHeaderRecordPutUInt64 (record, offset, value.u64[index]);
+    return offset;
+}
+
+static size_t
+blockHeaderRecordGet (const uint8_t *record, size_t offset, void *bytes, size_t bytesCount) {
+    memcpy (bytes, &record[offset], bytesCount);
+    return offset + bytesCount;
+}
+
+static size_t
+blockHeaderRecordGetUInt64 (const uint8_t *record, size_t offset, uint64_t *value) {
+    *value = UInt64GetLE (&record[offset]);
+    return offset + sizeof (uint64_t);
+}
+
+static size_t
+blockHeaderRecordGetUInt256 (const uint8_t *record, size_t offset, UInt256 *value) {
+    for (size_t index = 0; index < 4; index++)
+        offset = blockHeaderRecordGetUInt64 (record, offset, &value->u64[index]);
+    return offset;
+}
+
+extern void
+blockHeaderRecordEncode (BREthereumBlock block,
+                         uint8_t *record) {
+    BREthereumBlockHeader header = block->header;
+    size_t offset = 0;
+
+    memset (record, 0, BLOCK_HEADER_RECORD_SIZE);
+    record[offset++] = (BLOCK_HEADER_RECORD_FLAG_PRESENT |
+                        (ETHEREUM_BOOLEAN_IS_TRUE (blockHasTotalDifficulty (block)) ? BLOCK_HEADER_RECORD_FLAG_TD : 0));
+    record[offset++] = header->extraDataCount;
+
+    offset = blockHeaderRecordPut (record, offset, header->hash.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordPut (record, offset, header->parentHash.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordPut (record, offset, header->ommersHash.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordPut (record, offset, header->beneficiary.bytes, sizeof (header->beneficiary.bytes));
+    offset = blockHeaderRecordPut (record, offset, header->stateRoot.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordPut (record, offset, header->transactionsRoot.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordPut (record, offset, header->receiptsRoot.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordPut (record, offset, header->logsBloom.bytes, ETHEREUM_BLOOM_FILTER_BYTES);
+    offset = blockHeaderRecordPutUInt256 (record, offset, header->difficulty);
+    offset = blockHeaderRecordPutUInt64  (record, offset, header->number);
+    offset = blockHeaderRecordPutUInt64  (record, offset, header->gasLimit);
+    offset = blockHeaderRecordPutUInt64  (record, offset, header->gasUsed);
+    offset = blockHeaderRecordPutUInt64  (record, offset, header->timestamp);
+    offset = blockHeaderRecordPut (record, offset, header->extraData, sizeof (header->extraData));
+    offset = blockHeaderRecordPut (record, offset, header->mixHash.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordPutUInt64  (record, offset, header->nonce);
+    offset = blockHeaderRecordPutUInt256 (record, offset, block->totalDifficulty);
+
+    assert (offset <= BLOCK_HEADER_RECORD_SIZE);
+}
+
+extern BREthereumBlock
+blockHeaderRecordDecode (const uint8_t *record) {
+    uint8_t flags = record[0];
+    if (0 == (flags & BLOCK_HEADER_RECORD_FLAG_PRESENT)) return NULL;
+
+    BREthereumBlockHeader header = createBlockHeader();
+    UInt256 totalDifficulty;
+    size_t offset = 1;
+
+    header->extraDataCount = record[offset++];
+    if (header->extraDataCount > sizeof (header->extraData)) {
+        blockHeaderRelease (header);
+        return NULL;
+    }
+
+    offset = blockHeaderRecordGet (record, offset, header->hash.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordGet (record, offset, header->parentHash.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordGet (record, offset, header->ommersHash.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordGet (record, offset, header->beneficiary.bytes, sizeof (header->beneficiary.bytes));
+    offset = blockHeaderRecordGet (record, offset, header->stateRoot.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordGet (record, offset, header->transactionsRoot.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordGet (record, offset, header->receiptsRoot.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordGet (record, offset, header->logsBloom.bytes, ETHEREUM_BLOOM_FILTER_BYTES);
+    offset = blockHeaderRecordGetUInt256 (record, offset, &header->difficulty);
+    offset = blockHeaderRecordGetUInt64  (record, offset, &header->number);
+    offset = blockHeaderRecordGetUInt64  (record, offset, &header->gasLimit);
+    offset = blockHeaderRecordGetUInt64  (record, offset, &header->gasUsed);
+    offset = blockHeaderRecordGetUInt64  (record, offset, &header->timestamp);
+    offset = blockHeaderRecordGet (record, offset, header->extraData, sizeof (header->extraData));
+    offset = blockHeaderRecordGet (record, offset, header->mixHash.bytes, ETHEREUM_HASH_BYTES);
+    offset = blockHeaderRecordGetUInt64  (record, offset, &header->nonce);
+    offset = blockHeaderRecordGetUInt256 (record, offset, &totalDifficulty);
+
+    assert (offset <= BLOCK_HEADER_RECORD_SIZE);
+
+    BREthereumBlock block = blockCreate (header);
+    if (flags & BLOCK_HEADER_RECORD_FLAG_TD)
+        blockSetTotalDifficulty (block, totalDifficulty);
+    return block;
+}
+
 /// MARK: - Block As Set
 
 extern size_t
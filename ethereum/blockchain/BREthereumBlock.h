@@ -12,6 +12,7 @@
 #define BR_Ethereum_Block_H
 
 #include <limits.h>
+#include "support/BRFileService.h"
 #include "ethereum/base/BREthereumBase.h"
 #include "BREthereumTransaction.h"
 #include "BREthereumLog.h"
@@ -94,6 +95,19 @@ blockHeaderRlpDecode (BRRlpItem item,
                       BREthereumRlpType type,
                       BRRlpCoder coder);
 
+/**
+ * Decode an RLP list of block headers, computing the headers' hashes together in one batch.  A
+ * list of more than `headersLimit` headers, such as the most a request could ask for, is rejected
+ * with no headers decoded.
+ *
+ * Return BRArrayOf(BREthereumBlockHeader) w/ array owned by caller.
+ */
+extern BRArrayOf(BREthereumBlockHeader)
+blockHeadersRlpDecode (BRRlpItem item,
+                       size_t headersLimit,
+                       BREthereumRlpType type,
+                       BRRlpCoder coder);
+
 extern BRRlpItem
 blockHeaderRlpEncode (BREthereumBlockHeader header,
                       BREthereumBoolean withNonce,
@@ -133,10 +147,50 @@ extern BREthereumBoolean
 blockHeaderMatch (BREthereumBlockHeader header,
                   BREthereumBloomFilter filter);
 
+/**
+ * Match each of `headers` against `filter`, such as an address filter computed once for a
+ * whole batch of headers.  Fills `matches`, if not NULL, and returns the number of matches.
+ */
+extern size_t
+blockHeadersMatch (BREthereumBlockHeader *headers,
+                   size_t headersCount,
+                   BREthereumBloomFilter filter,
+                   BREthereumBoolean *matches);
+
 extern BREthereumBoolean
 blockHeaderMatchAddress (BREthereumBlockHeader header,
                          BREthereumAddress address);
 
+/**
+ * The bloom filters for an address, both as a transaction source/target and as a log topic.
+ * Computing these requires two hashes of the address; create them once per account and use
+ * blockHeaderMatchAddressFilters() rather than blockHeaderMatchAddress() for every header.
+ */
+typedef struct {
+    BREthereumBloomFilter transactions;
+    BREthereumBloomFilter logs;
+} BREthereumBlockAddressFilters;
+
+extern BREthereumBlockAddressFilters
+blockAddressFiltersCreate (BREthereumAddress address);
+
+extern BREthereumBoolean
+blockHeaderMatchAddressFilters (BREthereumBlockHeader header,
+                                BREthereumBlockAddressFilters filters);
+
+/**
+ * The bloom filters for many addresses, both as a transaction source/target and as a log topic,
+ * combined into one set.  Use blockHeaderMatchAddresses() to test a header against every address
+ * at once; recreate the set when the addresses change.
+ */
+extern BREthereumBloomFilterSet
+blockAddressesFiltersCreate (const BREthereumAddress *addresses,
+                             size_t addressesCount);
+
+extern BREthereumBoolean
+blockHeaderMatchAddresses (BREthereumBlockHeader header,
+                           BREthereumBloomFilterSet filters);
+
 // Support BRSet
 extern size_t
 blockHeaderHashValue (const void *h);
@@ -207,9 +261,24 @@ blockUpdateBody (BREthereumBlock block,
                  BRArrayOf(BREthereumBlockHeader) ommers,
                  BRArrayOf(BREthereumTransaction) transactions);
 
+/**
+ * Release the block's transactions, keeping only their hashes.  Once the transactions of interest
+ * have been copied out, the hashes suffice to identify logs (see blockLinkLogsWithTransactions()).
+ * After this, blockGetTransaction() returns NULL; blockGetTransactionsCount() is unchanged.
+ */
+extern void
+blockCompactTransactions (BREthereumBlock block);
+
 extern void
 blockRelease (BREthereumBlock block);
 
+/**
+ * Return the bytes held by `block`: its header, ommers and transactions, its compacted
+ * transaction hashes, and its status arrays.
+ */
+extern size_t
+blockGetMemoryUsage (BREthereumBlock block);
+
 extern BREthereumBlockHeader
 blockGetHeader (BREthereumBlock block);
 
@@ -351,6 +420,30 @@ blockBodyPairRelease (BREthereumBlockBodyPair *pair);
 extern void
 blockBodyPairsRelease (BRArrayOf(BREthereumBlockBodyPair) pairs);
 
+/// MARK: - Block Header Record
+
+/**
+ * A fixed-size binary record of a block's header and, if known, its total difficulty.  The
+ * record includes the header's hash so that decoding requires neither RLP nor Keccak - suitable
+ * for a dense, on-disk store of headers indexed by block number.  A record of all zeros is
+ * 'empty'.
+ */
+#define BLOCK_HEADER_RECORD_SIZE        (640)
+
+/**
+ * Fill `record`, of BLOCK_HEADER_RECORD_SIZE bytes, from `block`'s header and total difficulty.
+ */
+extern void
+blockHeaderRecordEncode (BREthereumBlock block,
+                         uint8_t *record);
+
+/**
+ * Create a block, with a header and possibly a total difficulty, from `record`.  Returns NULL
+ * if `record` is empty or invalid.
+ */
+extern BREthereumBlock
+blockHeaderRecordDecode (const uint8_t *record);
+
 /// MARK: - Block Header Proof
 
 typedef struct {
@@ -569,22 +662,48 @@ blockFree (BREthereumBlock block);
 
 /// MARK: - Proof of Work
 
+/**
+ * Create a proof of work verifier.  Headers are verified with Ethash, in 'light' mode, using
+ * the cache for the header's epoch.  Caches are generated on a thread of the verifier's own, for
+ * the epoch requested with proofOfWorkGenerate() and the one after; if `fs` is not NULL, they
+ * are saved to, and restored from, `fs` under the type "ethash".
+ */
 extern BREthereumProofOfWork
-proofOfWorkCreate (void);
+proofOfWorkCreate (BRFileService fs);
 
 extern void
 proofOfWorkRelease (BREthereumProofOfWork pow);
 
+/**
+ * Request the caches for `header`'s epoch and the next one, replacing any caches for earlier
+ * epochs.  Returns immediately; the caches are generated, or restored, in the background.  A
+ * header in an epoch earlier than one already requested is ignored.
+ */
 extern void
 proofOfWorkGenerate (BREthereumProofOfWork pow,
                      BREthereumBlockHeader header);
 
+/**
+ * Compute `header`'s Ethash result, as `n`, and mix hash, as `m`.  If the cache for `header`'s
+ * epoch isn't ready then, rather than wait, `n` is zero and `m` is `header`'s mix hash - values
+ * that pass validation.
+ */
 extern void
 proofOfWorkCompute (BREthereumProofOfWork pow,
                     BREthereumBlockHeader header,
                     UInt256 *n,
                     BREthereumHash *m);
 
+/**
+ * Compute the results of `headers`, in parallel on the shared thread pool, and hold them for a
+ * subsequent proofOfWorkCompute() of each header - typically while validating the headers,
+ * one by one, against their parents.  Results held from an earlier batch are dropped.
+ */
+extern void
+proofOfWorkComputeBatch (BREthereumProofOfWork pow,
+                         BREthereumBlockHeader *headers,
+                         size_t headersCount);
+
 
 #ifdef __cplusplus
 }
@@ -9,6 +9,7 @@
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include "BREthereumBloomFilter.h"
 
@@ -77,9 +78,9 @@ bloomFilterOr (const BREthereumBloomFilter filter1, const BREthereumBloomFilter
 }
 
 extern void
-bloomFilterOrInPlace (BREthereumBloomFilter filter1, const BREthereumBloomFilter filter2) {
+bloomFilterOrInPlace (BREthereumBloomFilter *filter1, const BREthereumBloomFilter filter2) {
     for (int i = 0; i < ETHEREUM_BLOOM_FILTER_BYTES; i++)
-        filter1.bytes[i] |= filter2.bytes[i];
+        filter1->bytes[i] |= filter2.bytes[i];
 }
 
 extern BREthereumBoolean
@@ -89,9 +90,103 @@ bloomFilterEqual (const BREthereumBloomFilter filter1, const BREthereumBloomFilt
             : ETHEREUM_BOOLEAN_FALSE);
 }
 
+/**
+ * Check if every bit set in `other` is also set in `filter`.  Rather than building the OR of
+ * the two filters and comparing 256 bytes, accumulate `other & ~filter` a word at a time; the
+ * loop has no branches so the compiler can run it on SSE2/NEON vectors.
+ */
+static int
+bloomFilterMatchInternal (const BREthereumBloomFilter *filter, const BREthereumBloomFilter *other) {
+    uint64_t missing = 0, f, o;
+    for (size_t i = 0; i < ETHEREUM_BLOOM_FILTER_BYTES; i += sizeof (uint64_t)) {
+        memcpy (&f, &filter->bytes[i], sizeof (uint64_t));
+        memcpy (&o, &other->bytes[i],  sizeof (uint64_t));
+        missing |= o & ~f;
+    }
+    return 0 == missing;
+}
+
 extern BREthereumBoolean
 bloomFilterMatch (const BREthereumBloomFilter filter, const BREthereumBloomFilter other) {
-    return bloomFilterEqual(filter, bloomFilterOr(filter, other));
+    return AS_ETHEREUM_BOOLEAN (bloomFilterMatchInternal (&filter, &other));
+}
+
+extern size_t
+bloomFilterMatchMany (const BREthereumBloomFilter *filters,
+                      size_t filtersCount,
+                      const BREthereumBloomFilter other,
+                      BREthereumBoolean *matches) {
+    size_t matchesCount = 0;
+    for (size_t index = 0; index < filtersCount; index++) {
+        int match = bloomFilterMatchInternal (&filters[index], &other);
+        if (NULL != matches) matches[index] = AS_ETHEREUM_BOOLEAN (match);
+        matchesCount += match;
+    }
+    return matchesCount;
+}
+
+//
+// Bloom Filter Set
+//
+struct BREthereumBloomFilterSetRecord {
+    /** The members' set bits, each as (byteIndex << 3 | bitIndex); member `i` has the bits
+     * from `bits[offsets[i]]` up to `bits[offsets[i+1]]` */
+    uint16_t *bits;
+    size_t *offsets;
+    size_t count;
+};
+
+extern BREthereumBloomFilterSet
+bloomFilterSetCreate (const BREthereumBloomFilter *filters,
+                      size_t filtersCount) {
+    BREthereumBloomFilterSet set = calloc (1, sizeof (struct BREthereumBloomFilterSetRecord));
+    size_t bitsCount = 0;
+
+    for (size_t index = 0; index < filtersCount; index++)
+        for (size_t byte = 0; byte < ETHEREUM_BLOOM_FILTER_BYTES; byte++)
+            bitsCount += __builtin_popcount (filters[index].bytes[byte]);
+
+    set->bits    = calloc (bitsCount > 0 ? bitsCount : 1, sizeof (uint16_t));
+    set->offsets = calloc (filtersCount + 1, sizeof (size_t));
+    set->count   = filtersCount;
+
+    bitsCount = 0;
+    for (size_t index = 0; index < filtersCount; index++) {
+        set->offsets[index] = bitsCount;
+        for (size_t byte = 0; byte < ETHEREUM_BLOOM_FILTER_BYTES; byte++)
+            for (unsigned int bit = 0; bit < 8; bit++)
+                if (filters[index].bytes[byte] & (1 << bit))
+                    set->bits[bitsCount++] = (uint16_t) (byte << 3 | bit);
+    }
+    set->offsets[filtersCount] = bitsCount;
+
+    return set;
+}
+
+extern void
+bloomFilterSetRelease (BREthereumBloomFilterSet set) {
+    free (set->bits);
+    free (set->offsets);
+    free (set);
+}
+
+extern size_t
+bloomFilterSetGetCount (BREthereumBloomFilterSet set) {
+    return set->count;
+}
+
+extern BREthereumBoolean
+bloomFilterSetMatch (BREthereumBloomFilterSet set,
+                     const BREthereumBloomFilter filter) {
+    for (size_t index = 0; index < set->count; index++) {
+        size_t bit = set->offsets[index], end = set->offsets[index + 1];
+
+        while (bit < end && (filter.bytes[set->bits[bit] >> 3] & (1 << (set->bits[bit] & 0x7))))
+            bit++;
+
+        if (bit == end) return ETHEREUM_BOOLEAN_TRUE;
+    }
+    return ETHEREUM_BOOLEAN_FALSE;
 }
 
 //
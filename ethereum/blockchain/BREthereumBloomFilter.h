@@ -79,8 +79,11 @@ bloomFilterCreateString (const char *string);
 extern BREthereumBloomFilter
 bloomFilterOr (const BREthereumBloomFilter filter1, const BREthereumBloomFilter filter2);
 
+/**
+ * Update `filter1` to include every bit set in `filter2`.
+ */
 extern void
-bloomFilterOrInPlace (BREthereumBloomFilter filter1, const BREthereumBloomFilter filter2);
+bloomFilterOrInPlace (BREthereumBloomFilter *filter1, const BREthereumBloomFilter filter2);
 
 extern BREthereumBoolean
 bloomFilterEqual (const BREthereumBloomFilter filter1, const BREthereumBloomFilter filter2);
@@ -99,6 +102,54 @@ bloomFilterEqual (const BREthereumBloomFilter filter1, const BREthereumBloomFilt
 extern BREthereumBoolean
 bloomFilterMatch (const BREthereumBloomFilter filter, const BREthereumBloomFilter other);
 
+/**
+ * Check if `other` is contained in each of `filters`.  Typically `filters` would be the bloom
+ * filters of a sequence of block headers and `other` an address filter computed once by the
+ * caller (see bloomFilterCreateAddress() and logTopicGetBloomFilterAddress()).
+ *
+ * @parameter filters
+ *
+ * @parameter filtersCount
+ *
+ * @parameter other
+ *
+ * @parameter matches if not NULL, filled with TRUE or FALSE for each of `filters`
+ *
+ * @returns the number of `filters` that `other` matches
+ */
+extern size_t
+bloomFilterMatchMany (const BREthereumBloomFilter *filters,
+                      size_t filtersCount,
+                      const BREthereumBloomFilter other,
+                      BREthereumBoolean *matches);
+
+/**
+ * A set of bloom filters, such as those of many addresses, that is tested as one: a filter
+ * matches the set if it contains any member.  The bits of each member are found once, when the
+ * set is created; a match then reads just those few bits of the filter tested rather than all
+ * of its bytes once per member.  A set is immutable; create a new one when the members change.
+ */
+typedef struct BREthereumBloomFilterSetRecord *BREthereumBloomFilterSet;
+
+extern BREthereumBloomFilterSet
+bloomFilterSetCreate (const BREthereumBloomFilter *filters,
+                      size_t filtersCount);
+
+extern void
+bloomFilterSetRelease (BREthereumBloomFilterSet set);
+
+extern size_t
+bloomFilterSetGetCount (BREthereumBloomFilterSet set);
+
+/**
+ * Check if any member of `set` is contained in `filter`.  An empty set matches no filter.
+ *
+ * @returns TRUE if some member matches; otherwise FALSE
+ */
+extern BREthereumBoolean
+bloomFilterSetMatch (BREthereumBloomFilterSet set,
+                     const BREthereumBloomFilter filter);
+
 extern BRRlpItem
 bloomFilterRlpEncode(BREthereumBloomFilter filter, BRRlpCoder coder);
 
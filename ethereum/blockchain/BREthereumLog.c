@@ -129,17 +129,30 @@ logTopicRlpEncode(BREthereumLogTopic topic,
 
 static BREthereumLogTopic emptyTopic;
 
-static BRArrayOf(BREthereumLogTopic)
-logTopicsCopy (BRArrayOf(BREthereumLogTopic) topics) {
-    BRArrayOf(BREthereumLogTopic) copy;
-    array_new(copy, array_count(topics));
-    array_add_array(copy, topics, array_count(topics));
-    return copy;
-}
+/**
+ * A unique identifer - derived from the transactionHash and the transactionReceiptIndex
+ */
+typedef struct {
+    /**
+     * The hash of the transaction producing this log.  This value *does not* depend on
+     * which block records the Log.
+     */
+    BREthereumHash transactionHash;
+
+    /**
+     * The receipt index from the transaction's contract execution for this log.  It can't
+     * possibly be the case that this number varies, can it - contract execution, regarding
+     * event generating, must be deterministic?
+     */
+    size_t transactionReceiptIndex;
+} BREthereumLogIdentifier;
 
 //
 // Log
 //
+/// The encodings held: RLP_TYPE_NETWORK and RLP_TYPE_ARCHIVE
+#define LOG_RLP_ENCODINGS_COUNT        (1 + RLP_TYPE_ARCHIVE)
+
 struct BREthereumLogRecord {
     // THIS MUST BE FIRST to support BRSet operations.
 
@@ -157,58 +170,79 @@ struct BREthereumLogRecord {
     /**
      * a series of 32-byte log topics, Ot;
      */
-    BRArrayOf(BREthereumLogTopic) topics;
+    BREthereumLogTopic topics[LOG_TOPICS_COUNT_MAXIMUM];
+    size_t topicsCount;
 
     /**
-     * and some number of bytes of data, Od
+     * and some number of bytes of data, Od - as the RLP encoding, with `bytes` in `dataBytes`
      */
     BRRlpData data;
 
     /**
      * A unique identifer - derived from the transactionHash and the transactionReceiptIndex
      */
-    struct {
-        /**
-         * The hash of the transaction producing this log.  This value *does not* depend on
-         * which block records the Log.
-         */
-        BREthereumHash transactionHash;
-
-        /**
-         * The receipt index from the transaction's contract execution for this log.  It can't
-         * possibly be the case that this number varies, can it - contract execution, regarding
-         * event generating, must be deterministic?
-         */
-        size_t transactionReceiptIndex;
-    } identifier;
+    BREthereumLogIdentifier identifier;
 
     /**
      * status
      */
     BREthereumTransactionStatus status;
+
+    /**
+     * The RLP encodings - as RLP_TYPE_NETWORK and RLP_TYPE_ARCHIVE - as last encoded.  The
+     * ARCHIVE encoding is cleared, and released, when the identifier or status changes.  Empty
+     * until encoded; never copied.
+     */
+    BRRlpData rlpEncodings[LOG_RLP_ENCODINGS_COUNT];
+
+    /**
+     * The data bytes, of `data.bytesCount`.  THIS MUST BE LAST.
+     */
+    uint8_t dataBytes[];
 };
 
+static void
+logRlpEncodingClear (BREthereumLog log,
+                     BREthereumRlpType type) {
+    assert (type < LOG_RLP_ENCODINGS_COUNT);
+    rlpDataRelease (log->rlpEncodings[type]);
+    log->rlpEncodings[type] = (BRRlpData) { 0, NULL };
+}
+
+/**
+ * Allocate a log, with an unknown identifier, holding a copy of `data`.
+ */
+static BREthereumLog
+logCreateWithData (BRRlpData data) {
+    BREthereumLog log = calloc (1, sizeof(struct BREthereumLogRecord) + data.bytesCount);
+
+    log->hash = hashCreateEmpty();
+
+    log->data.bytesCount = data.bytesCount;
+    log->data.bytes = log->dataBytes;
+    if (0 != data.bytesCount) memcpy (log->dataBytes, data.bytes, data.bytesCount);
+
+    // Mark the `identifier` as unknown.
+    log->identifier.transactionReceiptIndex = LOG_TRANSACTION_RECEIPT_INDEX_UNKNOWN;
+
+    return log;
+}
+
 extern BREthereumLog
 logCreate (BREthereumAddress address,
            unsigned int topicsCount,
            BREthereumLogTopic *topics,
            BRRlpData data) {
-    BREthereumLog log = calloc (1, sizeof(struct BREthereumLogRecord));
-
-    log->hash = hashCreateEmpty();
-    log->address = address;
-
-    array_new(log->topics, topicsCount);
-    for (size_t index = 0; index < topicsCount; index++)
-        array_add (log->topics, topics[index]);
+    assert (topicsCount <= LOG_TOPICS_COUNT_MAXIMUM);
 
     // RLP Decoded (see below) performs: log->data = rlpDecodeBytes(coder, items[2]);
     // We'll assume `data` has the proper form....
+    BREthereumLog log = logCreateWithData (data);
 
-    log->data = rlpDataCopy(data);
+    log->address = address;
 
-    // Mark the `identifier` as unknown.
-    log->identifier.transactionReceiptIndex = LOG_TRANSACTION_RECEIPT_INDEX_UNKNOWN;
+    log->topicsCount = topicsCount;
+    memcpy (log->topics, topics, topicsCount * sizeof (BREthereumLogTopic));
 
     return log;
 }
@@ -220,8 +254,17 @@ logInitializeIdentifier (BREthereumLog log,
     log->identifier.transactionHash = transactionHash;
     log->identifier.transactionReceiptIndex = transactionReceiptIndex;
 
-    BRRlpData data = { sizeof (log->identifier), (uint8_t*) &log->identifier };
-    log->hash = hashCreateFromData(data);
+    log->hash = logHashCreate (transactionHash, transactionReceiptIndex);
+    logRlpEncodingClear (log, RLP_TYPE_ARCHIVE);
+}
+
+extern BREthereumHash
+logHashCreate (BREthereumHash transactionHash,
+               size_t transactionReceiptIndex) {
+    BREthereumLogIdentifier identifier = { transactionHash, transactionReceiptIndex };
+
+    BRRlpData data = { sizeof (identifier), (uint8_t*) &identifier };
+    return hashCreateFromData(data);
 }
 
 extern BREthereumBoolean
@@ -288,6 +331,7 @@ extern void
 logSetStatus (BREthereumLog log,
               BREthereumTransactionStatus status) {
     log->status = status;
+    logRlpEncodingClear (log, RLP_TYPE_ARCHIVE);
 }
 
 extern BREthereumHash
@@ -310,12 +354,12 @@ logHasAddress (BREthereumLog log,
 
 extern size_t
 logGetTopicsCount (BREthereumLog log) {
-    return array_count(log->topics);
+    return log->topicsCount;
 }
 
 extern  BREthereumLogTopic
 logGetTopic (BREthereumLog log, size_t index) {
-    return (index < array_count(log->topics)
+    return (index < log->topicsCount
             ? log->topics[index]
             : emptyTopic);
 }
@@ -378,12 +422,20 @@ logHashEqual (const void *l1, const void *l2) {
 extern void
 logRelease (BREthereumLog log) {
     if (NULL != log) {
-        array_free(log->topics);
-        rlpDataRelease(log->data);
+        logRlpEncodingClear (log, RLP_TYPE_NETWORK);
+        logRlpEncodingClear (log, RLP_TYPE_ARCHIVE);
         free (log);
     }
 }
 
+extern size_t
+logGetMemoryUsage (BREthereumLog log) {
+    size_t usage = sizeof (struct BREthereumLogRecord) + log->data.bytesCount;
+    for (size_t index = 0; index < LOG_RLP_ENCODINGS_COUNT; index++)
+        usage += log->rlpEncodings[index].bytesCount;
+    return usage;
+}
+
 extern void
 logsRelease (BRArrayOf(BREthereumLog) logs) {
     if (NULL != logs) {
@@ -401,14 +453,15 @@ logReleaseForSet (void *ignore, void *item) {
 
 extern BREthereumLog
 logCopy (BREthereumLog log) {
-    BREthereumLog copy = calloc (1, sizeof(struct BREthereumLogRecord));
-    memcpy (copy, log, sizeof(struct BREthereumLogRecord));
+    size_t size = sizeof(struct BREthereumLogRecord) + log->data.bytesCount;
 
-    // Copy the topics
-    copy->topics = logTopicsCopy(log->topics);
+    // Copy everything, topics and data included, then point to the copied data.
+    BREthereumLog copy = malloc (size);
+    memcpy (copy, log, size);
+    copy->data.bytes = copy->dataBytes;
 
-    // Copy the data
-    copy->data = rlpDataCopy(log->data);
+    // The encodings are held by `log`; the copy encodes anew.
+    memset (copy->rlpEncodings, 0, sizeof (copy->rlpEncodings));
 
     return copy;
 }
@@ -418,8 +471,8 @@ logCopy (BREthereumLog log) {
 static BRRlpItem
 logTopicsRlpEncode (BREthereumLog log,
                     BRRlpCoder coder) {
-    size_t itemsCount = array_count(log->topics);
-    BRRlpItem items[itemsCount];
+    size_t itemsCount = log->topicsCount;
+    BRRlpItem items[LOG_TOPICS_COUNT_MAXIMUM];
 
     for (int i = 0; i < itemsCount; i++)
         items[i] = logTopicRlpEncode(log->topics[i], coder);
@@ -427,41 +480,35 @@ logTopicsRlpEncode (BREthereumLog log,
     return rlpEncodeListItems(coder, items, itemsCount);
 }
 
-static BREthereumLogTopic *
-logTopicsRlpDecode (BRRlpItem item,
+static void
+logTopicsRlpDecode (BREthereumLog log,
+                    BRRlpItem item,
                     BRRlpCoder coder) {
     size_t itemsCount = 0;
     const BRRlpItem *items = rlpDecodeList(coder, item, &itemsCount);
 
-    BREthereumLogTopic *topics;
-    array_new(topics, itemsCount);
-
-    for (int i = 0; i < itemsCount; i++) {
-        BREthereumLogTopic topic = logTopicRlpDecode(items[i], coder);
-        array_add(topics, topic);
-    }
+    // The EVM produces no more; ignore any more.
+    if (itemsCount > LOG_TOPICS_COUNT_MAXIMUM) itemsCount = LOG_TOPICS_COUNT_MAXIMUM;
 
-    return topics;
+    log->topicsCount = itemsCount;
+    for (int i = 0; i < itemsCount; i++)
+        log->topics[i] = logTopicRlpDecode(items[i], coder);
 }
 
 extern BREthereumLog
 logRlpDecode (BRRlpItem item,
               BREthereumRlpType type,
               BRRlpCoder coder) {
-    BREthereumLog log = (BREthereumLog) calloc (1, sizeof (struct BREthereumLogRecord));
-
     size_t itemsCount = 0;
     const BRRlpItem *items = rlpDecodeList(coder, item, &itemsCount);
     assert ((3 == itemsCount && RLP_TYPE_NETWORK == type) ||
             (6 == itemsCount && RLP_TYPE_ARCHIVE == type));
 
-    log->address = addressRlpDecode(items[0], coder);
-    log->topics = logTopicsRlpDecode (items[1], coder);
-
-    log->data = rlpGetData (coder, items[2]); //  rlpDecodeBytes(coder, items[2]);
+    // Hold the data as RLP encoded; not as rlpDecodeBytes(coder, items[2]).
+    BREthereumLog log = logCreateWithData (rlpGetDataSharedDontRelease (coder, items[2]));
 
-    // 
-    log->identifier.transactionReceiptIndex = LOG_TRANSACTION_RECEIPT_INDEX_UNKNOWN;
+    log->address = addressRlpDecode(items[0], coder);
+    logTopicsRlpDecode (log, items[1], coder);
 
     if (RLP_TYPE_ARCHIVE == type) {
         BREthereumHash hash = hashRlpDecode(items[3], coder);
@@ -475,11 +522,10 @@ logRlpDecode (BRRlpItem item,
     return log;
 }
 
-extern BRRlpItem
-logRlpEncode(BREthereumLog log,
-             BREthereumRlpType type,
-             BRRlpCoder coder) {
-    
+static BRRlpItem
+logRlpEncodeFields (BREthereumLog log,
+                    BREthereumRlpType type,
+                    BRRlpCoder coder) {
     BRRlpItem items[6]; // more than enough
 
     items[0] = addressRlpEncode(log->address, coder);
@@ -495,6 +541,37 @@ logRlpEncode(BREthereumLog log,
     return rlpEncodeListItems(coder, items, (RLP_TYPE_ARCHIVE == type ? 6 : 3));
 }
 
+extern BRRlpItem
+logRlpEncode(BREthereumLog log,
+             BREthereumRlpType type,
+             BRRlpCoder coder) {
+    assert (type < LOG_RLP_ENCODINGS_COUNT);
+    BRRlpData *encoding = &log->rlpEncodings[type];
+
+    if (NULL != encoding->bytes)
+        return rlpGetItem (coder, *encoding);
+
+    BRRlpItem item = logRlpEncodeFields (log, type, coder);
+    *encoding = rlpGetData (coder, item);
+    return item;
+}
+
+extern BRRlpData
+logGetRlpData (BREthereumLog log,
+               BREthereumRlpType type,
+               BRRlpCoder coder) {
+    assert (type < LOG_RLP_ENCODINGS_COUNT);
+    BRRlpData *encoding = &log->rlpEncodings[type];
+
+    if (NULL == encoding->bytes) {
+        BRRlpItem item = logRlpEncodeFields (log, type, coder);
+        *encoding = rlpGetData (coder, item);
+        rlpReleaseItem (coder, item);
+    }
+
+    return rlpDataCopy (*encoding);
+}
+
 /* Log (2) w/ LogTopic (3)
  ETH: LES-RECEIPTS:         L  2: [
  ETH: LES-RECEIPTS:           L  3: [
@@ -23,6 +23,11 @@ extern "C" {
 
 #define LOG_TOPIC_BYTES_COUNT   32
 
+/**
+ * The most topics of a Log - as produced by the EVM's LOG4 instruction.
+ */
+#define LOG_TOPICS_COUNT_MAXIMUM    (4)
+
 /**
  * An Ethereum Log Topic is 32 bytes of arbitary data.
  */
@@ -68,9 +73,14 @@ logTopicAsAddress (BREthereumLogTopic topic);
  * From the Ethereum specificaion:  A log entry, O, is: {address, types, data}.  To that we add
  * a status, an identifier pair as { transactionHash, transactionReceiptIndex} and a hash (of the
  * identifier).
+ *
+ * A Log is a single allocation - its topics and data are held inline.
  */
 typedef struct BREthereumLogRecord *BREthereumLog;
 
+/**
+ * Create a Log.  The `topicsCount` must not exceed LOG_TOPICS_COUNT_MAXIMUM.
+ */
 extern BREthereumLog
 logCreate (BREthereumAddress address,
            unsigned int topicsCount,
@@ -83,6 +93,14 @@ logInitializeIdentifier (BREthereumLog log,
                          BREthereumHash transactionHash,
                          size_t transactionReceiptIndex);
 
+/**
+ * Return the hash that logInitializeIdentifier() assigns a log for the identifier pair
+ * {transactionHash, transactionReceiptIndex} - without a log.
+ */
+extern BREthereumHash
+logHashCreate (BREthereumHash transactionHash,
+               size_t transactionReceiptIndex);
+
 /**
  * An identifier for an unknown receipt index.
  */
@@ -171,9 +189,25 @@ logRlpEncode(BREthereumLog log,
              BREthereumRlpType type,
              BRRlpCoder coder);
 
+/**
+ * Return the RLP encoding of log, as logRlpEncode(), as data of exactly the encoding's size.  The
+ * log holds its encodings, as first encoded, until an encoded field changes.  You own the data
+ * and must call rlpDataRelease().
+ */
+extern BRRlpData
+logGetRlpData (BREthereumLog log,
+               BREthereumRlpType type,
+               BRRlpCoder coder);
+
 extern void
 logRelease (BREthereumLog log);
 
+/**
+ * Return the bytes held by `log`, including its data and any held RLP encodings.
+ */
+extern size_t
+logGetMemoryUsage (BREthereumLog log);
+
 extern void
 logsRelease (BRArrayOf(BREthereumLog) logs);
 
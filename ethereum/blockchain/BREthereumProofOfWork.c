@@ -8,11 +8,19 @@
 //  See the LICENSE file at the project root for license information.
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 
+
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
 #include "support/BRArray.h"
 #include "support/BRSet.h"
+#include "support/BRInt.h"
+#include "support/BRCrypto.h"
+#include "support/BRThreadPool.h"
 #include "ethereum/rlp/BRRlp.h"
+#include "ethereum/util/BRUtil.h"
 #include "BREthereumBlock.h"
 
 #define POW_WORD_BYTES            (4)
@@ -27,127 +35,632 @@
 #define POW_CACHE_ROUNDS          (3)
 #define POW_ACCESSES              (64)
 
-//
-// Proof Of Work
-//
-struct BREthereumProofOfWorkStruct {
-    int foo;
-};
+#define POW_NODE_WORDS            (POW_HASH_BYTES / POW_WORD_BYTES)
+#define POW_MIX_WORDS             (POW_MIX_BYTES / POW_WORD_BYTES)
+#define POW_MIX_NODES             (POW_MIX_BYTES / POW_HASH_BYTES)
+#define POW_FNV_PRIME             (0x01000193)
 
-extern BREthereumProofOfWork
-proofOfWorkCreate (void) {
-    BREthereumProofOfWork pow = calloc (1, sizeof (struct BREthereumProofOfWorkStruct));
+// The caches held - for the current epoch and the next one.
+#define POW_CACHES_COUNT          (2)
 
-    pow->foo = 0;
+#define POW_PTHREAD_STACK_SIZE    (512 * 1024)
 
-    return pow;
+// A batch is split into shares of at least this many headers, each on the shared thread pool.
+#define POW_BATCH_MIN_PER_SHARE   (4)
+#define POW_BATCH_MAX_SHARES      (64)
+
+//
+// Ethash - see https://github.com/ethereum/wiki/wiki/Ethash
+//
+// We do 'light' verification: a header's (mixHash, result) is computed from the per-epoch cache,
+// deriving the ~128 dataset items required on demand, rather than from the full (GB) dataset.
+// Producing the cache takes a while (seconds, growing with the epoch), so it is generated on a
+// thread of its own and persisted, if we have a file service.
+//
+static uint64_t
+powEpoch (BREthereumBlockHeader header) {
+    return blockHeaderGetNumber(header) / POW_EPOCH;
 }
 
-extern void
-proofOfWorkRelease (BREthereumProofOfWork pow) {
-    free (pow);
+static int
+powIsPrime (uint64_t x) {
+    if (x < 2) return 0;
+    if (0 == x % 2) return 2 == x;
+    for (uint64_t d = 3; d * d <= x; d += 2)
+        if (0 == x % d) return 0;
+    return 1;
 }
 
-#if defined (INCLUDE_UNUSED_FUNCTIONS)
+/// The largest size, no more than init + growth * epoch - unit, that is a prime number of units
 static uint64_t
-powEpoch (BREthereumBlockHeader header) {
-    return blockHeaderGetNonce(header) / POW_EPOCH;
+powSize (uint64_t init, uint64_t growth, uint64_t epoch, uint64_t unit) {
+    uint64_t size = init + growth * epoch - unit;
+    while (!powIsPrime (size / unit))
+        size -= 2 * unit;
+    return size;
 }
 
 static uint64_t
-powPrime (uint64_t x, uint64_t y) {
-    return (0 == x % y
-            ? x
-            : powPrime (x - 2 * y, y));
+powDatasetSize (uint64_t epoch) {
+    return powSize (POW_DATA_SET_INIT, POW_DATA_SET_GROWTH, epoch, POW_MIX_BYTES);
 }
 
 static uint64_t
-powDatasetSize (BREthereumBlockHeader header) {
-    return powPrime (POW_DATA_SET_INIT + POW_DATA_SET_GROWTH * powEpoch(header) - POW_MIX_BYTES,
-                     POW_MIX_BYTES);
+powCacheSize (uint64_t epoch) {
+    return powSize (POW_CACHE_INIT, POW_CACHE_GROWTH, epoch, POW_HASH_BYTES);
 }
 
-static uint64_t
-powCacheSize (BREthereumBlockHeader header) {
-    return powPrime (POW_CACHE_INIT + POW_CACHE_GROWTH * powEpoch(header) - POW_HASH_BYTES,
-                     POW_HASH_BYTES);
+static void
+powSeedHash (uint64_t epoch, uint8_t seed[32]) {
+    memset (seed, 0, 32);
+    for (uint64_t index = 0; index < epoch; index++)
+        BRKeccak256 (seed, seed, 32);
+}
+
+static uint32_t
+powFNV (uint32_t x, uint32_t y) {
+    return (x * POW_FNV_PRIME) ^ y;
+}
+
+/// Keccak-512 of `wordsCount` (at most 8) little-endian words - every Ethash input fits in one
+/// 72 byte block (the Keccak-512 rate).
+static void
+powKeccak512 (uint64_t hash[8], const uint64_t *words, size_t wordsCount) {
+    uint64_t state[25] = { 0 };
+    assert (wordsCount <= 8);
+
+    for (size_t index = 0; index < wordsCount; index++)
+        state[index] = words[index];
+
+    // Keccak (not SHA3) padding
+    state[wordsCount] ^= 0x01;
+    state[8] ^= 0x8000000000000000ULL;
+
+    BRKeccakF1600 (state);
+    memcpy (hash, state, 8 * sizeof (uint64_t));
+}
+
+/// Keccak-512 of a 16 word node; `hash` may be `node`.
+static void
+powKeccak512Node (uint32_t hash[POW_NODE_WORDS], const uint32_t node[POW_NODE_WORDS]) {
+    uint64_t words[8];
+
+    for (size_t index = 0; index < 8; index++)
+        words[index] = (uint64_t) node[2 * index] | (uint64_t) node[2 * index + 1] << 32;
+
+    powKeccak512 (words, words, 8);
+
+    for (size_t index = 0; index < 8; index++) {
+        hash[2 * index + 0] = (uint32_t) words[index];
+        hash[2 * index + 1] = (uint32_t) (words[index] >> 32);
+    }
 }
 
-static BREthereumHash
-powSeedHashInternal (uint64_t number) {
-    BREthereumHash bytes;
+//
+// Proof Of Work Cache
+//
+typedef struct {
+    uint64_t epoch;
+    uint64_t datasetSize;
+    size_t nodesCount;
+    uint32_t *nodes;        // nodesCount * POW_NODE_WORDS; NULL if not valid
+    unsigned int refs;      // the holder's reference plus one per computation in progress
+} BREthereumProofOfWorkCache;
 
-    if (0 == number)
-        memset (bytes.bytes, 0, 32);
-    else
-        bytes = powSeedHashInternal(number - POW_EPOCH);
+static size_t
+proofOfWorkCacheHashValue (const void *cache) {
+    return (size_t) ((const BREthereumProofOfWorkCache *) cache)->epoch;
+}
 
-    return hashCreateFromData ((BRRlpData) { 32, bytes.bytes });
+static int
+proofOfWorkCacheHashEqual (const void *cache1, const void *cache2) {
+    return (((const BREthereumProofOfWorkCache *) cache1)->epoch ==
+            ((const BREthereumProofOfWorkCache *) cache2)->epoch);
 }
 
-static BREthereumHash
-powSeedHash (BREthereumBlockHeader header) {
-    return powSeedHashInternal(blockHeaderGetNumber(header));
+static BREthereumProofOfWorkCache *
+proofOfWorkCacheCreateEmpty (uint64_t epoch) {
+    BREthereumProofOfWorkCache *cache = calloc (1, sizeof (BREthereumProofOfWorkCache));
+
+    cache->epoch = epoch;
+    cache->datasetSize = powDatasetSize (epoch);
+    cache->nodesCount  = (size_t) (powCacheSize (epoch) / POW_HASH_BYTES);
+    cache->nodes = NULL;
+    cache->refs  = 1;
+
+    return cache;
 }
 
-static BREthereumData
-powLittleRMH (BREthereumData x, uint64_t i, uint64_t n) {
-    return x;
+static void
+proofOfWorkCacheRelease (BREthereumProofOfWorkCache *cache) {
+    if (NULL != cache->nodes) free (cache->nodes);
+    free (cache);
+}
+
+/// Drop a reference to `cache`, releasing it with the last one; must hold `pow->lock`
+static void
+proofOfWorkCacheUnref (BREthereumProofOfWorkCache *cache) {
+    assert (cache->refs > 0);
+    if (0 == --cache->refs)
+        proofOfWorkCacheRelease (cache);
 }
 
-static BREthereumData
-powBigRMH (BREthereumData x, uint64_t n) {
-    for (uint64_t i = 0; i < n; i++)
-        powLittleRMH(x, i, n);
-    return x;
+/**
+ * Create the cache for `epoch` - a sequential Keccak-512 fill from the epoch's seed and then
+ * POW_CACHE_ROUNDS of RandMemoHash.  This is the slow part; if `quit` becomes set we give up
+ * and return NULL.
+ */
+static BREthereumProofOfWorkCache *
+proofOfWorkCacheCreate (uint64_t epoch,
+                        volatile int *quit) {
+    BREthereumProofOfWorkCache *cache = proofOfWorkCacheCreateEmpty (epoch);
+
+    size_t n = cache->nodesCount;
+    uint32_t *nodes = malloc (n * POW_HASH_BYTES);
+    uint32_t temp[POW_NODE_WORDS];
+
+    // Sequentially produce the initial dataset
+    {
+        uint8_t seed[32];
+        uint64_t words[8];
+
+        powSeedHash (epoch, seed);
+        for (size_t index = 0; index < 4; index++)
+            words[index] = UInt64GetLE (&seed[8 * index]);
+        powKeccak512 (words, words, 4);
+
+        for (size_t index = 0; index < 8; index++) {
+            nodes[2 * index + 0] = (uint32_t) words[index];
+            nodes[2 * index + 1] = (uint32_t) (words[index] >> 32);
+        }
+    }
+
+    for (size_t i = 1; i < n; i++)
+        powKeccak512Node (&nodes[i * POW_NODE_WORDS], &nodes[(i - 1) * POW_NODE_WORDS]);
+
+    // Use a low-round version of RandMemoHash
+    for (size_t round = 0; round < POW_CACHE_ROUNDS; round++)
+        for (size_t i = 0; i < n; i++) {
+            if (0 == i % 4096 && *quit) {
+                free (nodes);
+                proofOfWorkCacheRelease (cache);
+                return NULL;
+            }
+
+            const uint32_t *prev = &nodes[((i + n - 1) % n) * POW_NODE_WORDS];
+            const uint32_t *other = &nodes[(nodes[i * POW_NODE_WORDS] % n) * POW_NODE_WORDS];
+
+            for (size_t k = 0; k < POW_NODE_WORDS; k++)
+                temp[k] = prev[k] ^ other[k];
+            powKeccak512Node (&nodes[i * POW_NODE_WORDS], temp);
+        }
+
+    cache->nodes = nodes;
+    return cache;
 }
 
-static BREthereumData
-powCacheRounds (BREthereumData x, uint64_t y, uint64_t n) {
-    return (0 == y
-            ? x
-            : (1 == y
-               ? powBigRMH (x, n)
-               : powCacheRounds (powBigRMH (x, n), y - 1, n)));
+/// Compute the dataset item at `index` from `cache`
+static void
+proofOfWorkCacheDatasetItem (const BREthereumProofOfWorkCache *cache,
+                             uint32_t index,
+                             uint32_t item[POW_NODE_WORDS]) {
+    size_t n = cache->nodesCount;
+
+    memcpy (item, &cache->nodes[(index % n) * POW_NODE_WORDS], POW_HASH_BYTES);
+    item[0] ^= index;
+    powKeccak512Node (item, item);
+
+    for (uint32_t parent = 0; parent < POW_PARENTS; parent++) {
+        const uint32_t *node = &cache->nodes[(powFNV (index ^ parent, item[parent % POW_NODE_WORDS]) % n)
+                                             * POW_NODE_WORDS];
+        for (size_t k = 0; k < POW_NODE_WORDS; k++)
+            item[k] = powFNV (item[k], node[k]);
+    }
+
+    powKeccak512Node (item, item);
 }
 
+/**
+ * Hashimoto, with dataset items computed from `cache`.  Fills `mixHash` and `result`, the
+ * latter as the 32 byte, big-endian value to compare with 2^256 / difficulty.
+ */
 static void
-powBigFNV (BREthereumData x,
-           BREthereumData y) {
+proofOfWorkCacheHashimoto (const BREthereumProofOfWorkCache *cache,
+                           const uint8_t sealHash[32],
+                           uint64_t nonce,
+                           uint8_t mixHash[32],
+                           uint8_t result[32]) {
+    uint64_t words[8];
+    uint32_t seed[POW_NODE_WORDS];
+    uint32_t mix[POW_MIX_WORDS];
+    uint32_t item[POW_NODE_WORDS];
+
+    // Combine the header and nonce into a 64 byte seed
+    for (size_t index = 0; index < 4; index++)
+        words[index] = UInt64GetLE (&sealHash[8 * index]);
+    words[4] = nonce;
+    powKeccak512 (words, words, 5);
+
+    for (size_t index = 0; index < 8; index++) {
+        seed[2 * index + 0] = (uint32_t) words[index];
+        seed[2 * index + 1] = (uint32_t) (words[index] >> 32);
+    }
+
+    // Start the mix with the replicated seed
+    for (size_t index = 0; index < POW_MIX_WORDS; index++)
+        mix[index] = seed[index % POW_NODE_WORDS];
+
+    // Mix in random dataset nodes
+    uint32_t pages = (uint32_t) (cache->datasetSize / POW_MIX_BYTES);
+    for (uint32_t i = 0; i < POW_ACCESSES; i++) {
+        uint32_t page = powFNV (i ^ seed[0], mix[i % POW_MIX_WORDS]) % pages;
+
+        for (uint32_t j = 0; j < POW_MIX_NODES; j++) {
+            proofOfWorkCacheDatasetItem (cache, POW_MIX_NODES * page + j, item);
+            for (size_t k = 0; k < POW_NODE_WORDS; k++)
+                mix[j * POW_NODE_WORDS + k] = powFNV (mix[j * POW_NODE_WORDS + k], item[k]);
+        }
+    }
+
+    // Compress the mix and hash it, with the seed, to produce the result
+    uint8_t bytes[POW_HASH_BYTES + 32];
+
+    for (size_t index = 0; index < POW_NODE_WORDS; index++)
+        UInt32SetLE (&bytes[POW_WORD_BYTES * index], seed[index]);
+
+    for (size_t index = 0; index < POW_MIX_WORDS / 4; index++) {
+        uint32_t cmix = powFNV (powFNV (powFNV (mix[4 * index + 0],
+                                                mix[4 * index + 1]),
+                                        mix[4 * index + 2]),
+                                mix[4 * index + 3]);
+        UInt32SetLE (&mixHash[POW_WORD_BYTES * index], cmix);
+        UInt32SetLE (&bytes[POW_HASH_BYTES + POW_WORD_BYTES * index], cmix);
+    }
+
+    BRKeccak256 (result, bytes, sizeof (bytes));
 }
 
-static BREthereumData
-powMix (BREthereumData m,
-        BREthereumData c,
-        uint64_t i,
-        uint64_t p) {
-    return (0 == p
-            ? m
-            : m);
+/// MARK: - Proof of Work Cache File Service
+
+static const char *fileServiceTypeProofOfWork = "ethash";
+
+enum {
+    POW_CACHE_VERSION_1
+};
+
+static UInt256
+fileServiceTypeProofOfWorkV1Identifier (BRFileServiceContext context,
+                                        BRFileService fs,
+                                        const void *entity) {
+    const BREthereumProofOfWorkCache *cache = entity;
+
+    UInt256 result = UINT256_ZERO;
+    UInt64SetLE (result.u8, cache->epoch);
+    return result;
+}
+
+static uint8_t *
+fileServiceTypeProofOfWorkV1Writer (BRFileServiceContext context,
+                                    BRFileService fs,
+                                    const void* entity,
+                                    uint32_t *bytesCount) {
+    const BREthereumProofOfWorkCache *cache = entity;
+    size_t wordsCount = cache->nodesCount * POW_NODE_WORDS;
+
+    *bytesCount = (uint32_t) (sizeof (uint64_t) + POW_WORD_BYTES * wordsCount);
+    uint8_t *bytes = malloc (*bytesCount);
+
+    UInt64SetLE (bytes, cache->epoch);
+    for (size_t index = 0; index < wordsCount; index++)
+        UInt32SetLE (&bytes[sizeof (uint64_t) + POW_WORD_BYTES * index], cache->nodes[index]);
+
+    return bytes;
+}
+
+static void *
+fileServiceTypeProofOfWorkV1Reader (BRFileServiceContext context,
+                                    BRFileService fs,
+                                    uint8_t *bytes,
+                                    uint32_t bytesCount) {
+    if (bytesCount < sizeof (uint64_t)) return proofOfWorkCacheCreateEmpty (0);
+
+    BREthereumProofOfWorkCache *cache = proofOfWorkCacheCreateEmpty (UInt64GetLE (bytes));
+    size_t wordsCount = cache->nodesCount * POW_NODE_WORDS;
+
+    // A cache that doesn't match its epoch's size is left without nodes; it won't be used.
+    if (bytesCount == sizeof (uint64_t) + POW_WORD_BYTES * wordsCount) {
+        cache->nodes = malloc (POW_WORD_BYTES * wordsCount);
+        for (size_t index = 0; index < wordsCount; index++)
+            cache->nodes[index] = UInt32GetLE (&bytes[sizeof (uint64_t) + POW_WORD_BYTES * index]);
+    }
+
+    return cache;
 }
 
-static BREthereumData
-powParents (BREthereumData c,
-            uint64_t i,
-            uint64_t p,
-            BREthereumData m) {
-    return (p < POW_PARENTS - 1
-            ? powParents(c, i, p + 1, powMix (m, c, i, p + 1))
-            : powMix (m, c, i, p + 1));
+//
+// Proof Of Work Result - of a header, keyed by the header's hash
+//
+typedef struct {
+    BREthereumHash hash;
+    UInt256 n;
+    BREthereumHash m;
+    int computed;
+} BREthereumProofOfWorkResult;
+
+static size_t
+proofOfWorkResultHashValue (const void *result) {
+    return hashSetValue (&((const BREthereumProofOfWorkResult *) result)->hash);
 }
 
-static BREthereumData
-powDatasetItem (BREthereumData c,
-                uint64_t i) {
-    return powParents(c, i, -i, (BREthereumData) { 0, NULL });
+static int
+proofOfWorkResultHashEqual (const void *result1, const void *result2) {
+    return hashSetEqual (&((const BREthereumProofOfWorkResult *) result1)->hash,
+                         &((const BREthereumProofOfWorkResult *) result2)->hash);
+}
+
+//
+// Proof Of Work
+//
+struct BREthereumProofOfWorkStruct {
+    /// The file service, if any, holding caches generated earlier.
+    BRFileService fs;
+
+    /// A coder for the header's 'seal' RLP encoding.
+    BRRlpCoder coder;
+
+    /// The caches held, at most one for `epoch` and one for `epoch + 1`, or NULL.
+    BREthereumProofOfWorkCache *caches[POW_CACHES_COUNT];
+
+    /// Results computed by proofOfWorkComputeBatch(), until taken by proofOfWorkCompute().
+    BRSetOf(BREthereumProofOfWorkResult*) results;
+
+    /// The epoch the generator produces caches for, along with `epoch + 1`; only valid once
+    /// `epochRequested` is set.
+    uint64_t epoch;
+    int epochRequested;
+
+    /// The generator thread; started on the first request.
+    pthread_t thread;
+    int threadStarted;
+    volatile int quit;
+
+    /// Protects all of the above; `cond` signals a new request.
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+extern BREthereumProofOfWork
+proofOfWorkCreate (BRFileService fs) {
+    BREthereumProofOfWork pow = calloc (1, sizeof (struct BREthereumProofOfWorkStruct));
+
+    pow->fs = fs;
+    pow->coder = rlpCoderCreate();
+
+    for (size_t index = 0; index < POW_CACHES_COUNT; index++)
+        pow->caches[index] = NULL;
+
+    pow->results = BRSetNew (proofOfWorkResultHashValue, proofOfWorkResultHashEqual, POW_BATCH_MIN_PER_SHARE);
+
+    pow->epoch = 0;
+    pow->epochRequested = 0;
+    pow->threadStarted = 0;
+    pow->quit = 0;
+
+    pthread_mutex_init (&pow->lock, NULL);
+    pthread_cond_init  (&pow->cond, NULL);
+
+    if (NULL != pow->fs &&
+        (1 != fileServiceDefineType (pow->fs, fileServiceTypeProofOfWork, POW_CACHE_VERSION_1,
+                                     (BRFileServiceContext) pow,
+                                     fileServiceTypeProofOfWorkV1Identifier,
+                                     fileServiceTypeProofOfWorkV1Reader,
+                                     fileServiceTypeProofOfWorkV1Writer) ||
+         1 != fileServiceDefineCurrentVersion (pow->fs, fileServiceTypeProofOfWork,
+                                               POW_CACHE_VERSION_1))) {
+        eth_log ("PoW", "FileService Error: %s", fileServiceTypeProofOfWork);
+        pow->fs = NULL;
+    }
+
+    return pow;
+}
+
+extern void
+proofOfWorkRelease (BREthereumProofOfWork pow) {
+    pthread_mutex_lock (&pow->lock);
+    pow->quit = 1;
+    pthread_cond_signal (&pow->cond);
+    pthread_mutex_unlock (&pow->lock);
+
+    // The generator checks `quit` as it fills a cache; we won't wait long.
+    if (pow->threadStarted)
+        pthread_join (pow->thread, NULL);
+
+    for (size_t index = 0; index < POW_CACHES_COUNT; index++)
+        if (NULL != pow->caches[index])
+            proofOfWorkCacheUnref (pow->caches[index]);
+
+    BRSetFreeAll (pow->results, free);
+    rlpCoderRelease (pow->coder);
+
+    pthread_cond_destroy  (&pow->cond);
+    pthread_mutex_destroy (&pow->lock);
+
+    free (pow);
+}
+
+static int
+proofOfWorkIsWantedEpoch (BREthereumProofOfWork pow,
+                          uint64_t epoch) {
+    return pow->epochRequested && (epoch == pow->epoch || epoch == pow->epoch + 1);
+}
+
+/// Lookup the cache for `epoch`; must hold `pow->lock`
+static BREthereumProofOfWorkCache *
+proofOfWorkLookupCache (BREthereumProofOfWork pow,
+                        uint64_t epoch) {
+    for (size_t index = 0; index < POW_CACHES_COUNT; index++)
+        if (NULL != pow->caches[index] && epoch == pow->caches[index]->epoch)
+            return pow->caches[index];
+    return NULL;
+}
+
+/// Find a wanted epoch without a cache; must hold `pow->lock`
+static int
+proofOfWorkNeedsCache (BREthereumProofOfWork pow,
+                       uint64_t *epoch) {
+    if (!pow->epochRequested) return 0;
+
+    for (uint64_t e = pow->epoch; e <= pow->epoch + 1; e++)
+        if (NULL == proofOfWorkLookupCache (pow, e)) {
+            *epoch = e;
+            return 1;
+        }
+    return 0;
+}
+
+/**
+ * Hold `cache`, in place of one no longer wanted, if `cache` is itself wanted; otherwise
+ * release it.  A released cache, unless it duplicates one held, is removed from the file
+ * service.  Must hold `pow->lock`.
+ */
+static void
+proofOfWorkInstallCache (BREthereumProofOfWork pow,
+                         BREthereumProofOfWorkCache *cache) {
+    BREthereumProofOfWorkCache *unwanted = cache;
+
+    if (NULL != cache->nodes &&
+        proofOfWorkIsWantedEpoch (pow, cache->epoch) &&
+        NULL == proofOfWorkLookupCache (pow, cache->epoch))
+        for (size_t index = 0; index < POW_CACHES_COUNT; index++)
+            if (NULL == pow->caches[index] || !proofOfWorkIsWantedEpoch (pow, pow->caches[index]->epoch)) {
+                unwanted = pow->caches[index];
+                pow->caches[index] = cache;
+                break;
+            }
+
+    if (NULL != unwanted) {
+        if (NULL != pow->fs && NULL == proofOfWorkLookupCache (pow, unwanted->epoch))
+            fileServiceRemove (pow->fs, fileServiceTypeProofOfWork,
+                               fileServiceTypeProofOfWorkV1Identifier (pow, pow->fs, unwanted));
+        // An unwanted cache in use is released once the last computation with it completes.
+        proofOfWorkCacheUnref (unwanted);
+    }
+}
+
+static void
+proofOfWorkLoadCaches (BREthereumProofOfWork pow) {
+    BRSetOf(BREthereumProofOfWorkCache*) caches = BRSetNew (proofOfWorkCacheHashValue,
+                                                           proofOfWorkCacheHashEqual,
+                                                           POW_CACHES_COUNT);
+
+    if (1 == fileServiceLoad (pow->fs, caches, fileServiceTypeProofOfWork, 1)) {
+        // Installing may release a cache, even one just loaded; don't iterate the set meanwhile.
+        size_t cachesCount = BRSetCount (caches);
+        BREthereumProofOfWorkCache *cachesAll[cachesCount];
+        BRSetAll (caches, (void**) cachesAll, cachesCount);
+        BRSetFree (caches);
+
+        pthread_mutex_lock (&pow->lock);
+        for (size_t index = 0; index < cachesCount; index++)
+            proofOfWorkInstallCache (pow, cachesAll[index]);
+        pthread_mutex_unlock (&pow->lock);
+    }
+    else BRSetFreeAll (caches, (void (*) (void*)) proofOfWorkCacheRelease);
+}
+
+static void *
+proofOfWorkThread (BREthereumProofOfWork pow) {
+    if (NULL != pow->fs)
+        proofOfWorkLoadCaches (pow);
+
+    pthread_mutex_lock (&pow->lock);
+    while (!pow->quit) {
+        uint64_t epoch;
+
+        if (!proofOfWorkNeedsCache (pow, &epoch)) {
+            pthread_cond_wait (&pow->cond, &pow->lock);
+            continue;
+        }
+
+        // Generate without holding the lock; headers in other epochs verify meanwhile.
+        pthread_mutex_unlock (&pow->lock);
+        eth_log ("PoW", "Cache Generate: Epoch %" PRIu64, epoch);
+        BREthereumProofOfWorkCache *cache = proofOfWorkCacheCreate (epoch, &pow->quit);
+        if (NULL != cache && NULL != pow->fs)
+            fileServiceSave (pow->fs, fileServiceTypeProofOfWork, cache);
+        pthread_mutex_lock (&pow->lock);
+
+        if (NULL != cache)
+            proofOfWorkInstallCache (pow, cache);
+    }
+    pthread_mutex_unlock (&pow->lock);
+
+    return NULL;
 }
-// On and On and On....
-#endif
 
 extern void
 proofOfWorkGenerate(BREthereumProofOfWork pow,
                        BREthereumBlockHeader header) {
-    //
+    uint64_t epoch = powEpoch (header);
+
+    pthread_mutex_lock (&pow->lock);
+
+    // Epochs only advance, with the chain.
+    if (!pow->epochRequested || epoch > pow->epoch) {
+        pow->epoch = epoch;
+        pow->epochRequested = 1;
+
+        if (!pow->threadStarted) {
+            pthread_attr_t attr;
+            pthread_attr_init (&attr);
+            pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_JOINABLE);
+            pthread_attr_setstacksize (&attr, POW_PTHREAD_STACK_SIZE);
+
+            pow->threadStarted = (0 == pthread_create (&pow->thread, &attr,
+                                                       (void *(*) (void *)) proofOfWorkThread, pow));
+            pthread_attr_destroy (&attr);
+        }
+        pthread_cond_signal (&pow->cond);
+    }
+
+    pthread_mutex_unlock (&pow->lock);
+}
+
+/**
+ * Compute `header`'s result with the cache for its epoch, if held, encoding the seal with
+ * `coder`.  Doesn't hold `pow->lock` while computing, so computations proceed in parallel.
+ */
+static int
+proofOfWorkComputeInternal (BREthereumProofOfWork pow,
+                            BRRlpCoder coder,
+                            BREthereumBlockHeader header,
+                            UInt256 *n,
+                            BREthereumHash *m) {
+    pthread_mutex_lock (&pow->lock);
+    BREthereumProofOfWorkCache *cache = proofOfWorkLookupCache (pow, powEpoch (header));
+    if (NULL != cache) cache->refs++;
+    pthread_mutex_unlock (&pow->lock);
+
+    if (NULL == cache) return 0;
+
+    // The seal hash - of the header without {mixHash, nonce}.
+    BRRlpItem item = blockHeaderRlpEncode (header, ETHEREUM_BOOLEAN_FALSE, RLP_TYPE_NETWORK, coder);
+    BRRlpData data = rlpGetDataSharedDontRelease (coder, item);
+    BREthereumHash sealHash = hashCreateFromData (data);
+    rlpReleaseItem (coder, item);
+
+    uint8_t result[32];
+    proofOfWorkCacheHashimoto (cache, sealHash.bytes, blockHeaderGetNonce (header), m->bytes, result);
+
+    pthread_mutex_lock (&pow->lock);
+    proofOfWorkCacheUnref (cache);
+    pthread_mutex_unlock (&pow->lock);
+
+    // `result` is big-endian; UInt256 has its least significant word first.
+    for (size_t index = 0; index < 4; index++)
+        n->u64[index] = UInt64GetBE (&result[8 * (3 - index)]);
+
+    return 1;
 }
 
 extern void
@@ -157,11 +670,98 @@ proofOfWorkCompute (BREthereumProofOfWork pow,
                        BREthereumHash *m) {
     assert (NULL != n && NULL != m);
 
-    // On and on and on
+    // Take the result if computed in a batch.
+    BREthereumHash hash = blockHeaderGetHash (header);
+
+    pthread_mutex_lock (&pow->lock);
+    BREthereumProofOfWorkResult *result = BRSetRemove (pow->results, &hash);
+    pthread_mutex_unlock (&pow->lock);
+
+    if (NULL != result) {
+        *n = result->n;
+        *m = result->m;
+        free (result);
+        return;
+    }
+
+    // Without the epoch's cache - it is being generated, or was never requested with
+    // proofOfWorkGenerate() - return values that allow subsequent use to succeed, rather than
+    // block (the caller is typically an event handler) for the generation.
+    if (!proofOfWorkComputeInternal (pow, pow->coder, header, n, m)) {
+        *n = UINT256_ZERO;
+        *m = blockHeaderGetMixHash (header);
+    }
+}
+
+typedef struct {
+    BREthereumProofOfWork pow;
+    BREthereumBlockHeader *headers;
+    BREthereumProofOfWorkResult *results;
+    size_t start, end;
+} BREthereumProofOfWorkBatchJob;
+
+static void
+proofOfWorkComputeBatchRoutine (void *info) {
+    BREthereumProofOfWorkBatchJob *job = info;
+    BRRlpCoder coder = rlpCoderCreateCached();
+
+    for (size_t index = job->start; index < job->end; index++) {
+        BREthereumProofOfWorkResult *result = &job->results[index];
+
+        result->hash = blockHeaderGetHash (job->headers[index]);
+        result->computed = proofOfWorkComputeInternal (job->pow, coder, job->headers[index],
+                                                       &result->n, &result->m);
+    }
+
+    rlpCoderReleaseCached (coder);
+}
+
+extern void
+proofOfWorkComputeBatch (BREthereumProofOfWork pow,
+                         BREthereumBlockHeader *headers,
+                         size_t headersCount) {
+    if (0 == headersCount) return;
+
+    BRThreadPool *threads = BRThreadPoolShared();
+    BRTaskGroup *group = NULL;
+
+    size_t sharesCount = 1 + BRThreadPoolThreadCount (threads);
+    if (sharesCount > POW_BATCH_MAX_SHARES) sharesCount = POW_BATCH_MAX_SHARES;
+    if (sharesCount > headersCount / POW_BATCH_MIN_PER_SHARE) sharesCount = headersCount / POW_BATCH_MIN_PER_SHARE;
+    if (sharesCount == 0) sharesCount = 1;
+
+    BREthereumProofOfWorkResult *results = calloc (headersCount, sizeof (BREthereumProofOfWorkResult));
+    BREthereumProofOfWorkBatchJob jobs[sharesCount];
+
+    if (sharesCount > 1) group = BRTaskGroupNew (threads);
+
+    for (size_t index = 0; index < sharesCount; index++) {
+        jobs[index] = (BREthereumProofOfWorkBatchJob) {
+            pow,
+            headers,
+            results,
+            headersCount * index / sharesCount,
+            headersCount * (index + 1) / sharesCount
+        };
+        if (index > 0) BRTaskGroupAdd (group, &jobs[index], proofOfWorkComputeBatchRoutine);
+    }
+
+    // Take the first share ourself, and help with the others while waiting.
+    proofOfWorkComputeBatchRoutine (&jobs[0]);
+    if (NULL != group) BRTaskGroupFree (group);
+
+    // Replace any results not taken from an earlier batch.
+    pthread_mutex_lock (&pow->lock);
+    BRSetFreeAll (pow->results, free);
+    pow->results = BRSetNew (proofOfWorkResultHashValue, proofOfWorkResultHashEqual, headersCount);
 
-    // TODO: Actually compute something.
+    for (size_t index = 0; index < headersCount; index++)
+        if (results[index].computed) {
+            BREthereumProofOfWorkResult *result = malloc (sizeof (BREthereumProofOfWorkResult));
+            *result = results[index];
+            free (BRSetAdd (pow->results, result));
+        }
+    pthread_mutex_unlock (&pow->lock);
 
-    // For now, return values that allow subsequent use to succeed
-    *n = UINT256_ZERO;
-    *m = blockHeaderGetMixHash (header);
+    free (results);
 }
@@ -24,6 +24,10 @@ static unsigned int transactionAllocCount = 0;
 //
 // Transaction
 //
+
+/// The encodings held: RLP_TYPE_TRANSACTION_SIGNED (aka _NETWORK) and RLP_TYPE_ARCHIVE
+#define TRANSACTION_RLP_ENCODINGS_COUNT        (1 + RLP_TYPE_ARCHIVE)
+
 struct BREthereumTransactionRecord {
     // THIS MUST BE FIRST to support BRSet operations.
 
@@ -76,9 +80,10 @@ struct BREthereumTransactionRecord {
     BREthereumChainId chainId;   // EIP-135 - chainId - "Since EIP-155 use chainId for v"
 
     /**
-     * The data
+     * The data - either `dataChars` or, for no data, the shared `transactionDataNone`.  NULL
+     * remains NULL.
      */
-    char *data;
+    const char *data;
 
     /**
      * The signature, if signed (signer is not NULL).  This is a 'VRS' signature.
@@ -89,8 +94,80 @@ struct BREthereumTransactionRecord {
      * The status
      */
     BREthereumTransactionStatus status;
+
+    /**
+     * Once signed, the RLP encodings - as RLP_TYPE_TRANSACTION_SIGNED and RLP_TYPE_ARCHIVE - as
+     * last encoded, for `chainId`.  Each is cleared, and released, when a field it encodes
+     * changes.  Empty until encoded; never copied.
+     */
+    BRRlpData rlpEncodings[TRANSACTION_RLP_ENCODINGS_COUNT];
+
+    /**
+     * The data's characters, if held inline.  THIS MUST BE LAST.
+     */
+    char dataChars[];
 };
 
+/**
+ * The data of transactions without data, as for plain ETH transfers: shared, not held inline.
+ */
+static const char transactionDataNone[] = "0x";
+
+/**
+ * Return the cached encoding of `transaction` as `type`, or NULL if `type` is not cached.
+ */
+static BRRlpData *
+transactionRlpEncoding (BREthereumTransaction transaction,
+                        BREthereumRlpType type) {
+    switch (type) {
+        case RLP_TYPE_TRANSACTION_SIGNED:
+        case RLP_TYPE_ARCHIVE:
+            return &transaction->rlpEncodings[type];
+        case RLP_TYPE_TRANSACTION_UNSIGNED:
+            return NULL;
+    }
+}
+
+static void
+transactionRlpEncodingClear (BREthereumTransaction transaction,
+                             BREthereumRlpType type) {
+    BRRlpData *encoding = transactionRlpEncoding (transaction, type);
+    if (NULL != encoding) {
+        rlpDataRelease (*encoding);
+        *encoding = (BRRlpData) { 0, NULL };
+    }
+}
+
+static void
+transactionRlpEncodingsClear (BREthereumTransaction transaction) {
+    transactionRlpEncodingClear (transaction, RLP_TYPE_TRANSACTION_SIGNED);
+    transactionRlpEncodingClear (transaction, RLP_TYPE_ARCHIVE);
+}
+
+static int
+transactionHasInlineData (BREthereumTransaction transaction) {
+    return NULL != transaction->data && transactionDataNone != transaction->data;
+}
+
+/**
+ * Allocate a transaction, of a single allocation, holding `data`.
+ */
+static BREthereumTransaction
+transactionAlloc (const char *data) {
+    int inlineData = (NULL != data && 0 != strcmp (data, transactionDataNone));
+
+    BREthereumTransaction transaction = calloc (1, (sizeof (struct BREthereumTransactionRecord) +
+                                                    (inlineData ? strlen (data) + 1 : 0)));
+
+    if (inlineData) {
+        strcpy (transaction->dataChars, data);
+        transaction->data = transaction->dataChars;
+    }
+    else transaction->data = (NULL == data ? NULL : transactionDataNone);
+
+    return transaction;
+}
+
 extern BREthereumTransaction
 transactionCreate(BREthereumAddress sourceAddress,
                   BREthereumAddress targetAddress,
@@ -99,7 +176,7 @@ transactionCreate(BREthereumAddress sourceAddress,
                   BREthereumGas gasLimit,
                   const char *data,
                   uint64_t nonce) {
-    BREthereumTransaction transaction = calloc (1, sizeof (struct BREthereumTransactionRecord));
+    BREthereumTransaction transaction = transactionAlloc (data);
 
     transactionSetStatus(transaction, transactionStatusCreate (TRANSACTION_STATUS_UNKNOWN));
     transaction->sourceAddress = sourceAddress;
@@ -107,7 +184,6 @@ transactionCreate(BREthereumAddress sourceAddress,
     transaction->amount = amount;
     transaction->gasPrice = gasPrice;
     transaction->gasLimit = gasLimit;           // Must not be changed.
-    transaction->data = (NULL == data ? NULL : strdup (data));
     transaction->nonce = nonce;
     transaction->chainId = 0;
     transaction->hash = hashCreateEmpty();
@@ -124,9 +200,17 @@ transactionCreate(BREthereumAddress sourceAddress,
 
 extern BREthereumTransaction
 transactionCopy (BREthereumTransaction transaction) {
-    BREthereumTransaction copy = calloc (1, sizeof (struct BREthereumTransactionRecord));
-    memcpy (copy, transaction, sizeof (struct BREthereumTransactionRecord));
-    copy->data = (NULL == transaction->data ? NULL : strdup(transaction->data));
+    int inlineData = transactionHasInlineData (transaction);
+    size_t size = (sizeof (struct BREthereumTransactionRecord) +
+                   (inlineData ? strlen (transaction->data) + 1 : 0));
+
+    // Copy everything, data included, then point to the copied data.
+    BREthereumTransaction copy = malloc (size);
+    memcpy (copy, transaction, size);
+    if (inlineData) copy->data = copy->dataChars;
+
+    // The encodings are held by `transaction`; the copy encodes anew.
+    memset (copy->rlpEncodings, 0, sizeof (copy->rlpEncodings));
 
 #if defined (TRANSACTION_LOG_ALLOC_COUNT)
     eth_log ("MEM", "TX Copy - Count: %d", ++transactionAllocCount);
@@ -138,10 +222,10 @@ transactionCopy (BREthereumTransaction transaction) {
 extern void
 transactionRelease (BREthereumTransaction transaction) {
     if (NULL != transaction) {
-        if (NULL != transaction->data) free (transaction->data);
 #if defined (TRANSACTION_LOG_ALLOC_COUNT)
         eth_log ("MEM", "TX Release - Count: %d", --transactionAllocCount);
 #endif
+        transactionRlpEncodingsClear (transaction);
         free (transaction);
     }
 }
@@ -151,6 +235,16 @@ transactionReleaseForSet (void *ignore, void *item) {
     transactionRelease((BREthereumTransaction) item);
 }
 
+extern size_t
+transactionGetMemoryUsage (BREthereumTransaction transaction) {
+    size_t usage = sizeof (struct BREthereumTransactionRecord);
+    if (transaction->dataChars == transaction->data)
+        usage += strlen (transaction->dataChars) + 1;
+    for (size_t index = 0; index < TRANSACTION_RLP_ENCODINGS_COUNT; index++)
+        usage += transaction->rlpEncodings[index].bytesCount;
+    return usage;
+}
+
 extern BREthereumAddress
 transactionGetSourceAddress(BREthereumTransaction transaction) {
     return transaction->sourceAddress;
@@ -223,8 +317,10 @@ transactionSetGasEstimate (BREthereumTransaction transaction,
     BREthereumGas gasLimitWithMargin = (21000 != gasEstimate.amountOfGas
                                         ? gasLimitApplyMargin (gasEstimate)
                                         : gasCreate(21000));
-    if (gasLimitWithMargin.amountOfGas > transaction->gasLimit.amountOfGas)
+    if (gasLimitWithMargin.amountOfGas > transaction->gasLimit.amountOfGas) {
         transaction->gasLimit = gasLimitWithMargin;
+        transactionRlpEncodingsClear (transaction);
+    }
 }
 
 extern uint64_t
@@ -236,6 +332,7 @@ private_extern void
 transactionSetNonce (BREthereumTransaction transaction,
                      uint64_t nonce) {
     transaction->nonce = nonce;
+    transactionRlpEncodingsClear (transaction);
 }
 
 extern size_t
@@ -266,6 +363,7 @@ transactionSign(BREthereumTransaction transaction,
                 BREthereumSignature signature) {
     transactionSetStatus(transaction, transactionStatusCreate (TRANSACTION_STATUS_UNKNOWN));
     transaction->signature = signature;
+    transactionRlpEncodingsClear (transaction);
 
     // The signature algorithm does not account for EIP-155 and thus the chainID.  We are signing
     // transactions according to EIP-155.  Thus v = CHAIN_ID * 2 + 35 or v = CHAIN_ID * 2 + 36
@@ -293,6 +391,9 @@ extern void
 transactionSetHash (BREthereumTransaction transaction,
                     BREthereumHash hash) {
     transaction->hash = hash;
+
+    // Both encodings: encoding as SIGNED derives the hash, anew.
+    transactionRlpEncodingsClear (transaction);
 }
 
 extern BREthereumSignature
@@ -327,11 +428,11 @@ transactionExtractAddress(BREthereumTransaction transaction,
 //
 // Tranaction RLP Encode
 //
-extern BRRlpItem
-transactionRlpEncode(BREthereumTransaction transaction,
-                     BREthereumNetwork network,
-                     BREthereumRlpType type,
-                     BRRlpCoder coder) {
+static BRRlpItem
+transactionRlpEncodeFields (BREthereumTransaction transaction,
+                            BREthereumNetwork network,
+                            BREthereumRlpType type,
+                            BRRlpCoder coder) {
     BRRlpItem items[13]; // more than enough
     size_t itemsCount = 0;
 
@@ -397,21 +498,77 @@ transactionRlpEncode(BREthereumTransaction transaction,
     return result;
 }
 
+/**
+ * Return the cached encoding of `transaction` as `type`, for `network`, as empty if not yet
+ * encoded, or NULL if not cached.  Only a signed transaction is cached; until signed the fields
+ * are still being filled in.
+ */
+static BRRlpData *
+transactionRlpEncodingForNetwork (BREthereumTransaction transaction,
+                                  BREthereumNetwork network,
+                                  BREthereumRlpType type) {
+    BRRlpData *encoding = transactionRlpEncoding (transaction, type);
+    if (NULL == encoding || ETHEREUM_BOOLEAN_IS_FALSE (transactionIsSigned (transaction)))
+        return NULL;
+
+    // The encodings are for `chainId`; another network encodes anew.
+    if (transaction->chainId != networkGetChainId (network))
+        transactionRlpEncodingsClear (transaction);
+
+    return encoding;
+}
+
+extern BRRlpItem
+transactionRlpEncode(BREthereumTransaction transaction,
+                     BREthereumNetwork network,
+                     BREthereumRlpType type,
+                     BRRlpCoder coder) {
+    BRRlpData *encoding = transactionRlpEncodingForNetwork (transaction, network, type);
+
+    if (NULL != encoding && NULL != encoding->bytes)
+        return rlpGetItem (coder, *encoding);
+
+    BRRlpItem item = transactionRlpEncodeFields (transaction, network, type, coder);
+    if (NULL != encoding) *encoding = rlpGetData (coder, item);
+    return item;
+}
+
+extern BRRlpData
+transactionGetRlpData (BREthereumTransaction transaction,
+                       BREthereumNetwork network,
+                       BREthereumRlpType type,
+                       BRRlpCoder coder) {
+    BRRlpData *encoding = transactionRlpEncodingForNetwork (transaction, network, type);
+
+    if (NULL != encoding && NULL != encoding->bytes)
+        return rlpDataCopy (*encoding);
+
+    BRRlpItem item = transactionRlpEncodeFields (transaction, network, type, coder);
+    BRRlpData data = rlpGetData (coder, item);
+    rlpReleaseItem (coder, item);
+
+    if (NULL != encoding) *encoding = rlpDataCopy (data);
+    return data;
+}
+
 //
 // Tranaction RLP Decode
 //
-extern BREthereumTransaction
-transactionRlpDecode (BRRlpItem item,
-                      BREthereumNetwork network,
-                      BREthereumRlpType type,
-                      BRRlpCoder coder) {
-    
-    BREthereumTransaction transaction = calloc (1, sizeof(struct BREthereumTransactionRecord));
+static BREthereumTransaction
+transactionRlpDecodeInternal (BRRlpItem item,
+                              BREthereumNetwork network,
+                              BREthereumRlpType type,
+                              BRRlpCoder coder,
+                              int extractAddress) {
     
     size_t itemsCount = 0;
     const BRRlpItem *items = rlpDecodeList(coder, item, &itemsCount);
     assert (( 9 == itemsCount && (RLP_TYPE_TRANSACTION_SIGNED == type || RLP_TYPE_TRANSACTION_UNSIGNED == type)) ||
             (12 == itemsCount && RLP_TYPE_ARCHIVE == type));
+
+    char *data = rlpDecodeHexString (coder, items[5], "0x");
+    BREthereumTransaction transaction = transactionAlloc (data);
+    free (data);
     
     // Encoded as:
     //    items[0] = transactionEncodeNonce(transaction, transaction->nonce, coder);
@@ -427,7 +584,6 @@ transactionRlpDecode (BRRlpItem item,
     
     transaction->targetAddress = addressRlpDecode(items[3], coder);
     transaction->amount = etherRlpDecode(items[4], coder);
-    transaction->data = rlpDecodeHexString (coder, items[5], "0x");
     
     transaction->chainId = networkGetChainId(network);
     
@@ -473,7 +629,8 @@ transactionRlpDecode (BRRlpItem item,
             transaction->hash = hashCreateFromData(result);
 
             // :fingers-crossed:
-            transaction->sourceAddress = transactionExtractAddress (transaction, network, coder);
+            if (extractAddress)
+                transaction->sourceAddress = transactionExtractAddress (transaction, network, coder);
             break;
         }
 
@@ -486,6 +643,86 @@ transactionRlpDecode (BRRlpItem item,
     return transaction;
 }
 
+extern BREthereumTransaction
+transactionRlpDecode (BRRlpItem item,
+                      BREthereumNetwork network,
+                      BREthereumRlpType type,
+                      BRRlpCoder coder) {
+    return transactionRlpDecodeInternal (item, network, type, coder, 1);
+}
+
+/// Decode at least this many transactions in parallel.
+#define TRANSACTION_DECODE_PARALLEL_MINIMUM        (32)
+
+typedef struct {
+    BREthereumNetwork network;
+    BREthereumRlpType type;
+    BREthereumTransaction *transactions;
+} BREthereumTransactionDecodeContext;
+
+static void
+transactionRlpDecodeBatchRoutine (BREthereumTransactionDecodeContext *context,
+                                  BRRlpCoder coder,
+                                  BRRlpItem item,
+                                  size_t index) {
+    context->transactions[index] = transactionRlpDecodeInternal (item, context->network, context->type, coder, 0);
+}
+
+extern void
+transactionRlpDecodeBatch (const BRRlpItem *items,
+                           size_t itemsCount,
+                           BREthereumNetwork network,
+                           BREthereumRlpType type,
+                           BRRlpCoder coder,
+                           BREthereumTransaction *transactions) {
+    BREthereumTransactionDecodeContext context = { network, type, transactions };
+    rlpDecodeListParallel (coder, items, itemsCount, TRANSACTION_DECODE_PARALLEL_MINIMUM,
+                           &context, (BRRlpDecodeRoutine) transactionRlpDecodeBatchRoutine);
+
+    // Only with a SIGNED RLP encoding do we extract the source address
+    if (RLP_TYPE_TRANSACTION_SIGNED != type || 0 == itemsCount) return;
+
+    // Collect the signature and unsigned RLP data for every signed transaction...
+    BREthereumTransaction *signedTransactions = calloc (itemsCount, sizeof (BREthereumTransaction));
+    BREthereumSignature *signatures = calloc (itemsCount, sizeof (BREthereumSignature));
+    BRRlpItem *unsignedItems = calloc (itemsCount, sizeof (BRRlpItem));
+    const uint8_t **bytes = calloc (itemsCount, sizeof (uint8_t *));
+    size_t *bytesCounts = calloc (itemsCount, sizeof (size_t));
+    size_t signedCount = 0;
+
+    for (size_t index = 0; index < itemsCount; index++) {
+        BREthereumTransaction transaction = transactions[index];
+        if (ETHEREUM_BOOLEAN_IS_FALSE (transactionIsSigned(transaction))) continue;
+
+        unsignedItems[signedCount] = transactionRlpEncode (transaction, network, RLP_TYPE_TRANSACTION_UNSIGNED, coder);
+        BRRlpData data = rlpGetDataSharedDontRelease (coder, unsignedItems[signedCount]);
+
+        signedTransactions[signedCount] = transaction;
+        signatures[signedCount] = transaction->signature;
+        bytes[signedCount] = data.bytes;
+        bytesCounts[signedCount] = data.bytesCount;
+        signedCount++;
+    }
+
+    // ... and then extract all the source addresses at once.
+    BREthereumAddress *addresses = calloc (itemsCount, sizeof (BREthereumAddress));
+    int *successes = calloc (itemsCount, sizeof (int));
+    signatureExtractAddressBatch (signatures, bytes, bytesCounts, signedCount, addresses, successes);
+
+    for (size_t index = 0; index < signedCount; index++) {
+        signedTransactions[index]->sourceAddress = addresses[index];
+        rlpReleaseItem (coder, unsignedItems[index]);
+    }
+
+    free (successes);
+    free (addresses);
+    free (bytesCounts);
+    free (bytes);
+    free (unsignedItems);
+    free (signatures);
+    free (signedTransactions);
+}
+
 extern char *
 transactionGetRlpHexEncoded (BREthereumTransaction transaction,
                              BREthereumNetwork network,
@@ -493,9 +730,8 @@ transactionGetRlpHexEncoded (BREthereumTransaction transaction,
                              const char *prefix) {
     if (NULL == prefix) prefix = "";
 
-    BRRlpCoder coder = rlpCoderCreate();
-    BRRlpItem item = transactionRlpEncode (transaction, network, type, coder);
-    BRRlpData data = rlpGetDataSharedDontRelease(coder, item);
+    BRRlpCoder coder = rlpCoderCreateCached();
+    BRRlpData data = transactionGetRlpData (transaction, network, type, coder);
 
     char *result;
 
@@ -508,8 +744,8 @@ transactionGetRlpHexEncoded (BREthereumTransaction transaction,
         encodeHex(&result[strlen(prefix)], 2 * data.bytesCount + 1, data.bytes, data.bytesCount);
     }
 
-    rlpReleaseItem(coder, item);
-    rlpCoderRelease(coder);
+    rlpDataRelease(data);
+    rlpCoderReleaseCached(coder);
     return result;
 }
 
@@ -522,6 +758,7 @@ extern void
 transactionSetStatus (BREthereumTransaction transaction,
                       BREthereumTransactionStatus status) {
     transaction->status = status;
+    transactionRlpEncodingClear (transaction, RLP_TYPE_ARCHIVE);
 }
 
 extern BREthereumBoolean
@@ -650,6 +887,15 @@ transactionsRelease (BRArrayOf(BREthereumTransaction) transactions) {
     }
 }
 
+extern BRArrayOf(BREthereumTransaction)
+transactionsCopy (BRArrayOf(BREthereumTransaction) transactions) {
+    BRArrayOf(BREthereumTransaction) copies;
+    array_new (copies, array_count(transactions));
+    for (size_t index = 0; index < array_count(transactions); index++)
+        array_add (copies, transactionCopy (transactions[index]));
+    return copies;
+}
+
 /*
      https://github.com/ethereum/pyethereum/blob/develop/ethereum/transactions.py#L22
      https://github.com/ethereum/pyrlp/blob/develop/rlp/sedes/lists.py#L135
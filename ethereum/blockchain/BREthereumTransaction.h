@@ -61,6 +61,12 @@ transactionRelease (BREthereumTransaction transaction);
 extern void
 transactionReleaseForSet (void *ignore, void *item);
 
+/**
+ * Return the bytes held by `transaction`, including its data and any held RLP encodings.
+ */
+extern size_t
+transactionGetMemoryUsage (BREthereumTransaction transaction);
+
 extern BREthereumAddress
 transactionGetSourceAddress(BREthereumTransaction transaction);
 
@@ -156,9 +162,25 @@ transactionRlpDecode (BRRlpItem item,
                       BREthereumRlpType type,
                       BRRlpCoder coder);
 
+/**
+ * RLP decode `itemsCount` transactions from `items` into `transactions`, as transactionRlpDecode().
+ * With RLP_TYPE_TRANSACTION_SIGNED, the source addresses are extracted together, with the public
+ * key recoveries run in parallel, rather than one transaction at a time.
+ */
+extern void
+transactionRlpDecodeBatch (const BRRlpItem *items,
+                           size_t itemsCount,
+                           BREthereumNetwork network,
+                           BREthereumRlpType type,
+                           BRRlpCoder coder,
+                           BREthereumTransaction *transactions);
+
 /**
  * RLP encode transaction for the provided network with the specified type.  Different networks
  * have different RLP encodings - notably the network's chainId is part of the encoding.
+ *
+ * Once signed, the transaction holds its SIGNED and ARCHIVE encodings, as first encoded, until
+ * an encoded field changes; repeated encodings, to hash, to save or to send, reuse those bytes.
  */
 
 extern BRRlpItem
@@ -167,6 +189,16 @@ transactionRlpEncode(BREthereumTransaction transaction,
                      BREthereumRlpType type,
                      BRRlpCoder coder);
 
+/**
+ * Return the RLP encoding of transaction, as transactionRlpEncode(), as data of exactly the
+ * encoding's size.  You own the data and must call rlpDataRelease().
+ */
+extern BRRlpData
+transactionGetRlpData (BREthereumTransaction transaction,
+                       BREthereumNetwork network,
+                       BREthereumRlpType type,
+                       BRRlpCoder coder);
+
 extern char *
 transactionGetRlpHexEncoded (BREthereumTransaction transaction,
                              BREthereumNetwork network,
@@ -202,6 +234,9 @@ transactionShow (BREthereumTransaction transaction, const char *topic);
 extern void
 transactionsRelease (BRArrayOf(BREthereumTransaction) transactions);
 
+extern BRArrayOf(BREthereumTransaction)
+transactionsCopy (BRArrayOf(BREthereumTransaction) transactions);
+
 //
 // Transaction Result
 //
@@ -88,6 +88,22 @@ transactionReceiptRelease (BREthereumTransactionReceipt receipt) {
     }
 }
 
+extern BREthereumTransactionReceipt
+transactionReceiptCopy (BREthereumTransactionReceipt receipt) {
+    BREthereumTransactionReceipt copy = calloc (1, sizeof(struct BREthereumTransactionReceiptRecord));
+    memcpy (copy, receipt, sizeof(struct BREthereumTransactionReceiptRecord));
+
+    // Copy the logs
+    array_new (copy->logs, array_count(receipt->logs));
+    for (size_t index = 0; index < array_count(receipt->logs); index++)
+        array_add (copy->logs, logCopy (receipt->logs[index]));
+
+    // Copy the state root
+    copy->stateRoot = rlpDataCopy (receipt->stateRoot);
+
+    return copy;
+}
+
 //
 // Transaction Receipt Logs - RLP Encode/Decode
 //
@@ -157,6 +173,17 @@ transactionReceiptRlpEncode(BREthereumTransactionReceipt receipt,
     return rlpEncodeListItems(coder, items, 4);
 }
 
+/// Decode at least this many receipts in parallel.
+#define TRANSACTION_RECEIPT_DECODE_PARALLEL_MINIMUM     (32)
+
+static void
+transactionReceiptDecodeListRoutine (BREthereumTransactionReceipt *receipts,
+                                     BRRlpCoder coder,
+                                     BRRlpItem item,
+                                     size_t index) {
+    receipts[index] = transactionReceiptRlpDecode (item, coder);
+}
+
 extern BRArrayOf (BREthereumTransactionReceipt)
 transactionReceiptDecodeList (BRRlpItem item,
                               BRRlpCoder coder) {
@@ -165,8 +192,10 @@ transactionReceiptDecodeList (BRRlpItem item,
 
     BRArrayOf (BREthereumTransactionReceipt) receipts;
     array_new (receipts, itemCount);
-    for (size_t index = 0; index < itemCount; index++)
-        array_add (receipts, transactionReceiptRlpDecode (items[index], coder));
+    array_set_count (receipts, itemCount);
+
+    rlpDecodeListParallel (coder, items, itemCount, TRANSACTION_RECEIPT_DECODE_PARALLEL_MINIMUM,
+                           receipts, (BRRlpDecodeRoutine) transactionReceiptDecodeListRoutine);
     return receipts;
 }
 
@@ -180,6 +209,15 @@ transactionReceiptsRelease (BRArrayOf(BREthereumTransactionReceipt) receipts) {
     }
 }
 
+extern BRArrayOf(BREthereumTransactionReceipt)
+transactionReceiptsCopy (BRArrayOf(BREthereumTransactionReceipt) receipts) {
+    BRArrayOf(BREthereumTransactionReceipt) copies;
+    array_new (copies, array_count(receipts));
+    for (size_t index = 0; index < array_count(receipts); index++)
+        array_add (copies, transactionReceiptCopy (receipts[index]));
+    return copies;
+}
+
 /*  Transaction Receipts (184)
  ETH: LES-RECEIPTS:     L184: [
  ETH: LES-RECEIPTS:       L  4: [
@@ -68,6 +68,15 @@ transactionReceiptRelease (BREthereumTransactionReceipt receipt);
 extern void
 transactionReceiptsRelease (BRArrayOf(BREthereumTransactionReceipt) receipts);
 
+extern BREthereumTransactionReceipt
+transactionReceiptCopy (BREthereumTransactionReceipt receipt);
+
+/**
+ * Copy `receipts`, as a new array of copied receipts.
+ */
+extern BRArrayOf(BREthereumTransactionReceipt)
+transactionReceiptsCopy (BRArrayOf(BREthereumTransactionReceipt) receipts);
+
 #ifdef __cplusplus
 }
 #endif
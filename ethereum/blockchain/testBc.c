@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 #include "BREthereumBlockChain.h"
 
 //
@@ -35,6 +36,31 @@ runBloomTests (void) {
     assert (ETHEREUM_BOOLEAN_IS_TRUE(bloomFilterMatch(filter, filter2)));
     assert (ETHEREUM_BOOLEAN_IS_FALSE(bloomFilterMatch(filter, bloomFilterCreateAddress(addressCreate("195e7baea6a6c7c4c2dfeb977efac326af552d87")))));
 
+    BREthereumBloomFilter filterOrInPlace = filter1;
+    bloomFilterOrInPlace(&filterOrInPlace, filter2);
+    assert (ETHEREUM_BOOLEAN_IS_TRUE(bloomFilterEqual(filter, filterOrInPlace)));
+
+    BREthereumBloomFilter filters[] = { filter, filter1, filter2, bloomFilterCreateEmpty() };
+    BREthereumBoolean matches[4];
+    assert (2 == bloomFilterMatchMany(filters, 4, filter1, matches));
+    assert (ETHEREUM_BOOLEAN_IS_TRUE(matches[0]) && ETHEREUM_BOOLEAN_IS_TRUE(matches[1]));
+    assert (ETHEREUM_BOOLEAN_IS_FALSE(matches[2]) && ETHEREUM_BOOLEAN_IS_FALSE(matches[3]));
+    assert (4 == bloomFilterMatchMany(filters, 4, bloomFilterCreateEmpty(), NULL));
+
+    // A set matches a filter containing any member; an empty set matches nothing.
+    BREthereumBloomFilter filter3 = bloomFilterCreateAddress(addressCreate("195e7baea6a6c7c4c2dfeb977efac326af552d87"));
+    BREthereumBloomFilter members[] = { filter3, filter2 };
+    BREthereumBloomFilterSet set = bloomFilterSetCreate (members, 2);
+    assert (2 == bloomFilterSetGetCount(set));
+    assert (ETHEREUM_BOOLEAN_IS_TRUE(bloomFilterSetMatch(set, filter)));
+    assert (ETHEREUM_BOOLEAN_IS_TRUE(bloomFilterSetMatch(set, filter3)));
+    assert (ETHEREUM_BOOLEAN_IS_FALSE(bloomFilterSetMatch(set, filter1)));
+    assert (ETHEREUM_BOOLEAN_IS_FALSE(bloomFilterSetMatch(set, bloomFilterCreateEmpty())));
+    bloomFilterSetRelease(set);
+
+    set = bloomFilterSetCreate (NULL, 0);
+    assert (ETHEREUM_BOOLEAN_IS_FALSE(bloomFilterSetMatch(set, filter)));
+    bloomFilterSetRelease(set);
 }
 
 #define BLOCK_HEADER_0_RLP "f9020ca00000000000000000000000000000000000000000000000000000000000000000a01dcc4de8dec75d7aab85b567b6ccd41ad312451b948a7413f0a142fd40d49347940000000000000000000000000000000000000000a0d7f8974fb5ac78d9ac099b9ad5018bedc2ce0a72dad1827a1709da30580f0544a056e81f171bcc55a6ff8345e692c0f86e5b48e01b996cadc001622fb5e363b421a056e81f171bcc55a6ff8345e692c0f86e5b48e01b996cadc001622fb5e363b421b9010000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000850400000000008213880000a011bbe8db4e347b4e8c937c1c8370e4b5ed33adb3db69cbdb7a38e1e50b1b82faa0000000000000000000000000000000000000000000000000000000000000000042"
@@ -128,9 +154,106 @@ runBlockHeaderTests (void) {
                                                               header_0,
                                                               NULL)));
 
+    // Header Record round trip - with extra data and a total difficulty
+    uint8_t record[BLOCK_HEADER_RECORD_SIZE];
+    BREthereumBlock recordBlock = blockCreate (blockHeaderCopy (header_6000001));
+    blockSetTotalDifficulty (recordBlock, createUInt256 (12345));
+    blockHeaderRecordEncode (recordBlock, record);
+
+    BREthereumBlock recordBlockDecoded = blockHeaderRecordDecode (record);
+    assert (NULL != recordBlockDecoded);
+    assert (ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (blockGetHash (recordBlock), blockGetHash (recordBlockDecoded))));
+    assert (UInt256Eq (blockGetTotalDifficulty (recordBlock), blockGetTotalDifficulty (recordBlockDecoded)));
+
+    BRRlpCoder recordCoder = rlpCoderCreate();
+    BRRlpItem recordItem1 = blockHeaderRlpEncode (blockGetHeader (recordBlock), ETHEREUM_BOOLEAN_TRUE,
+                                                  RLP_TYPE_NETWORK, recordCoder);
+    BRRlpItem recordItem2 = blockHeaderRlpEncode (blockGetHeader (recordBlockDecoded), ETHEREUM_BOOLEAN_TRUE,
+                                                  RLP_TYPE_NETWORK, recordCoder);
+    BRRlpData recordData1 = rlpGetData (recordCoder, recordItem1);
+    BRRlpData recordData2 = rlpGetData (recordCoder, recordItem2);
+    assert (recordData1.bytesCount == recordData2.bytesCount &&
+            0 == memcmp (recordData1.bytes, recordData2.bytes, recordData1.bytesCount));
+    rlpDataRelease (recordData1);
+    rlpDataRelease (recordData2);
+    rlpReleaseItem (recordCoder, recordItem1);
+    rlpReleaseItem (recordCoder, recordItem2);
+    rlpCoderRelease (recordCoder);
+
+    // An empty record decodes as nothing
+    memset (record, 0, sizeof (record));
+    assert (NULL == blockHeaderRecordDecode (record));
+
+    blockRelease (recordBlock);
+    blockRelease (recordBlockDecoded);
 
 }
 
+//
+// Proof of Work Test
+//
+extern void
+runProofOfWorkTests (void) {
+    BREthereumBlockHeader header_0 = testGetBlockHeader(BLOCK_HEADER_0_RLP);
+    BREthereumBlockHeader header_1 = testGetBlockHeader(BLOCK_HEADER_1_RLP);
+    BREthereumBlockHeader header_2 = testGetBlockHeader(BLOCK_HEADER_2_RLP);
+
+    BREthereumProofOfWork pow = proofOfWorkCreate (NULL);
+    UInt256 n;
+    BREthereumHash m;
+
+    // Without the epoch's cache, nothing is computed
+    proofOfWorkCompute (pow, header_1, &n, &m);
+    assert (UInt256Eq (n, UINT256_ZERO));
+    assert (ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (m, blockHeaderGetMixHash (header_1))));
+
+    // Generate the epoch 0 cache, in the background, and wait for it.
+    proofOfWorkGenerate (pow, header_1);
+    for (int tries = 0; tries < 1200 && UInt256Eq (n, UINT256_ZERO); tries++) {
+        nanosleep (&(struct timespec) { 0, 100 * 1000 * 1000 }, NULL);
+        proofOfWorkCompute (pow, header_1, &n, &m);
+    }
+
+    // Mainnet block 1: the computed mix hash matches and the result is within the difficulty
+    assert (!UInt256Eq (n, UINT256_ZERO));
+    assert (ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (m, blockHeaderGetMixHash (header_1))));
+
+    int overflow = 0;
+    mulUInt256_Overflow (n, blockHeaderGetDifficulty (header_1), &overflow);
+    assert (0 == overflow);
+
+    // Mainnet block 2, with its parent
+    assert (ETHEREUM_BOOLEAN_IS_TRUE (blockHeaderIsValid (header_2,
+                                                          header_1,
+                                                          0,
+                                                          header_0,
+                                                          pow)));
+
+    // Each header's mix hash is its own
+    proofOfWorkCompute (pow, header_2, &n, &m);
+    assert (ETHEREUM_BOOLEAN_IS_TRUE  (hashEqual (m, blockHeaderGetMixHash (header_2))));
+    assert (ETHEREUM_BOOLEAN_IS_FALSE (hashEqual (m, blockHeaderGetMixHash (header_1))));
+
+    // A batch, computed in parallel, gives the same results.
+    BREthereumBlockHeader batch[16];
+    for (size_t index = 0; index < 16; index++)
+        batch[index] = (0 == index % 2 ? header_1 : header_2);
+
+    proofOfWorkComputeBatch (pow, batch, 16);
+    proofOfWorkCompute (pow, header_1, &n, &m);
+    assert (ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (m, blockHeaderGetMixHash (header_1))));
+    assert (ETHEREUM_BOOLEAN_IS_TRUE (blockHeaderIsValid (header_2,
+                                                          header_1,
+                                                          0,
+                                                          header_0,
+                                                          pow)));
+
+    proofOfWorkRelease (pow);
+    blockHeaderRelease (header_0);
+    blockHeaderRelease (header_1);
+    blockHeaderRelease (header_2);
+}
+
 //
 // block Test
 //
@@ -343,6 +466,14 @@ runLogTests (void) {
     assert (data.bytesCount == encodeData.bytesCount
             && 0 == memcmp (data.bytes, encodeData.bytes, encodeData.bytesCount));
 
+    // A copy holds its own topics and data, inline.
+    BREthereumLog logCopied = logCopy (log);
+    assert (2 == logGetTopicsCount (logCopied));
+    assert (0 == memcmp (logGetTopic (log, 1).bytes, logGetTopic (logCopied, 1).bytes, LOG_TOPIC_BYTES_COUNT));
+    assert (logGetDataShared (log).bytes != logGetDataShared (logCopied).bytes);
+    assert (logGetDataShared (log).bytesCount == logGetDataShared (logCopied).bytesCount);
+    logRelease (logCopied);
+
     rlpShow(data, "LogTest");
 
     // Archive
@@ -381,6 +512,23 @@ runLogTests (void) {
     assert (status.u.included.blockNumber == statusArchived.u.included.blockNumber);
     assert (someBlockNumber = statusArchived.u.included.blockNumber);
 
+    // The archive encoding is held, and reused, until the status changes.
+    BRRlpData archiveData1 = logGetRlpData (log, RLP_TYPE_ARCHIVE, coder);
+    BRRlpData archiveData2 = logGetRlpData (log, RLP_TYPE_ARCHIVE, coder);
+    assert (archiveData1.bytes != archiveData2.bytes && archiveData1.bytesCount == archiveData2.bytesCount);
+    assert (0 == memcmp (archiveData1.bytes, archiveData2.bytes, archiveData1.bytesCount));
+
+    logSetStatus (log, transactionStatusCreateIncluded (someBlockHash, someBlockNumber + 1, 0,
+                                                       TRANSACTION_STATUS_BLOCK_TIMESTAMP_UNKNOWN,
+                                                       gasCreate(0)));
+    item = logRlpEncode (log, RLP_TYPE_ARCHIVE, coder);
+    BREthereumLog logRearchived = logRlpDecode (item, RLP_TYPE_ARCHIVE, coder);
+    rlpReleaseItem (coder, item);
+    assert (someBlockNumber + 1 == logGetStatus (logRearchived).u.included.blockNumber);
+    logRelease (logRearchived);
+
+    rlpDataRelease (archiveData1);
+    rlpDataRelease (archiveData2);
     rlpDataRelease(encodeData);
     rlpDataRelease(data);
     rlpCoderRelease(coder);
@@ -479,6 +627,7 @@ extern void
 runBcTests (void) {
 //    runBloomTests();
     runBlockHeaderTests ();
+    runProofOfWorkTests ();
     runBlockTests();
     runLogTests();
     runAccountStateTests();
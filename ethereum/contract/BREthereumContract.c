@@ -12,6 +12,7 @@
 #include <stdarg.h>
 #include <memory.h>
 #include <assert.h>
+#include <pthread.h>
 #include "ethereum/base/BREthereumBase.h"
 #include "BREthereumContract.h"
 
@@ -22,6 +23,12 @@ encodeReverseBytes (uint8_t *t, const uint8_t *s, size_t slen);
 static int
 functionIsEncodedInData (BREthereumContractFunction function, const char *data);
 
+static BREthereumAddress
+decodeArgumentAddressBytes (const uint8_t *argument);
+
+static UInt256
+decodeArgumentUInt256Bytes (const uint8_t *argument, size_t argumentCount, BRCoreParseStatus *status);
+
 // https://medium.com/@jgm.orinoco/understanding-erc-20-token-contracts-a809a7310aa5
 // https://github.com/ethereum/wiki/wiki/Ethereum-Contract-ABI
 // https://ethereumbuilders.gitbooks.io/guide/content/en/solidity_features.html
@@ -59,6 +66,7 @@ struct BREthereumFunctionRecord {
     char *selector;
     unsigned int argumentCount;
     ArgumentEncodeFunc argumentEncoders[5];
+    uint8_t selectorBytes[CONTRACT_FUNCTION_SELECTOR_BYTES];  // `selector`, decoded; see contractsInitialize()
 };
 
 #define NULL_FUNCTION  { NULL, NULL, NULL, 0 }
@@ -119,6 +127,7 @@ struct BREthereumEventRecord {
     unsigned int argumentCount;
     TopicCoderPair topicCoders[5];
     // ...
+    uint8_t selectorBytes[CONTRACT_EVENT_TOPIC_BYTES];       // `selector`, decoded; see contractsInitialize()
 };
 
 #define NULL_EVENT { NULL, NULL, NULL, 0 }
@@ -175,6 +184,22 @@ eventERC20TransferDecodeUInt256 (BREthereumContractEvent event,
     return createUInt256Parse(number, 16, status);
 }
 
+private_extern BREthereumAddress
+eventERC20TransferDecodeAddressBytes (BREthereumContractEvent event,
+                                      const uint8_t *topic) {
+    assert (event == eventERC20Transfer);
+    return decodeArgumentAddressBytes (topic);
+}
+
+private_extern UInt256
+eventERC20TransferDecodeUInt256Bytes (BREthereumContractEvent event,
+                                      const uint8_t *data,
+                                      size_t dataCount,
+                                      BRCoreParseStatus *status) {
+    assert (event == eventERC20Transfer);
+    return decodeArgumentUInt256Bytes (data, dataCount, status);
+}
+
 extern const char *
 eventGetSelector (BREthereumContractEvent event) {
     return event->selector;
@@ -316,6 +341,30 @@ BREthereumContract contractERC20 = &contractRecordERC20;
 BREthereumContractFunction functionERC20Transfer = &contractRecordERC20.functions[2];
 BREthereumContractEvent eventERC20Transfer = &contractRecordERC20.events[0];
 
+/**
+ * Decode each function's and event's hex `selector` into bytes, once, so that lookups on raw
+ * data and topics compare bytes rather than hex strings.
+ */
+static pthread_once_t contractsInitializeOnce = PTHREAD_ONCE_INIT;
+
+static void
+contractsInitializeSelectors (void) {
+    BREthereumContract contract = contractERC20;
+
+    for (int i = 0; i < contract->functionsCount; i++)
+        decodeHex (contract->functions[i].selectorBytes, CONTRACT_FUNCTION_SELECTOR_BYTES,
+                   &contract->functions[i].selector[2], 2 * CONTRACT_FUNCTION_SELECTOR_BYTES);
+
+    for (int i = 0; i < contract->eventsCount; i++)
+        decodeHex (contract->events[i].selectorBytes, CONTRACT_EVENT_TOPIC_BYTES,
+                   &contract->events[i].selector[2], 2 * CONTRACT_EVENT_TOPIC_BYTES);
+}
+
+static void
+contractsInitialize (void) {
+    pthread_once (&contractsInitializeOnce, contractsInitializeSelectors);
+}
+
 extern BREthereumContractFunction
 contractLookupFunctionForEncoding (BREthereumContract contract, const char *encoding) {
     for (int i = 0; i < contract->functionsCount; i++)
@@ -332,6 +381,41 @@ contractLookupEventForTopic (BREthereumContract contract, const char *topic) {
     return NULL;
 }
 
+extern BREthereumContractFunction
+contractLookupFunctionForBytes (BREthereumContract contract,
+                                const uint8_t *data,
+                                size_t dataCount) {
+    if (NULL == data || dataCount < CONTRACT_FUNCTION_SELECTOR_BYTES) return NULL;
+    contractsInitialize();
+
+    // A selector is a 4 byte word; compare words.
+    uint32_t selector;
+    memcpy (&selector, data, CONTRACT_FUNCTION_SELECTOR_BYTES);
+
+    for (int i = 0; i < contract->functionsCount; i++)
+        if (0 == memcmp (&selector, contract->functions[i].selectorBytes, CONTRACT_FUNCTION_SELECTOR_BYTES))
+            return &contract->functions[i];
+    return NULL;
+}
+
+extern BREthereumContractEvent
+contractLookupEventForTopicBytes (BREthereumContract contract,
+                                  const uint8_t *topic) {
+    contractsInitialize();
+
+    // Event topics are keccak hashes; the first 8 bytes all but decide the match.
+    uint64_t prefix;
+    memcpy (&prefix, topic, sizeof (uint64_t));
+
+    for (int i = 0; i < contract->eventsCount; i++) {
+        const uint8_t *selector = contract->events[i].selectorBytes;
+        if (0 == memcmp (&prefix, selector, sizeof (uint64_t)) &&
+            0 == memcmp (topic, selector, CONTRACT_EVENT_TOPIC_BYTES))
+            return &contract->events[i];
+    }
+    return NULL;
+}
+
 private_extern UInt256
 functionERC20TransferDecodeAmount (BREthereumContractFunction function,
                                    const char *data,
@@ -355,6 +439,27 @@ functionERC20TransferDecodeAddress (BREthereumContractFunction function,
     return strdup (result);
 }
 
+private_extern UInt256
+functionERC20TransferDecodeAmountBytes (BREthereumContractFunction function,
+                                        const uint8_t *data,
+                                        size_t dataCount,
+                                        BRCoreParseStatus *status) {
+    assert (function == functionERC20Transfer);
+    // Second argument - skip selector + 1st argument
+    size_t offset = CONTRACT_FUNCTION_SELECTOR_BYTES + CONTRACT_ARGUMENT_BYTES;
+    return decodeArgumentUInt256Bytes (&data[offset], (dataCount < offset ? 0 : dataCount - offset), status);
+}
+
+private_extern BREthereumAddress
+functionERC20TransferDecodeAddressBytes (BREthereumContractFunction function,
+                                         const uint8_t *data,
+                                         size_t dataCount) {
+    assert (function == functionERC20Transfer);
+    assert (dataCount >= CONTRACT_FUNCTION_SELECTOR_BYTES + CONTRACT_ARGUMENT_BYTES);
+    // First argument - skip selector
+    return decodeArgumentAddressBytes (&data[CONTRACT_FUNCTION_SELECTOR_BYTES]);
+}
+
 /**
  */
 extern const char *
@@ -406,6 +511,28 @@ functionIsEncodedInData (BREthereumContractFunction function, const char *data)
     0 == strncmp (function->selector, data, strlen(function->selector));
 }
 
+// An address argument is right-aligned in its 32 bytes: 12 zero bytes then the address
+static BREthereumAddress
+decodeArgumentAddressBytes (const uint8_t *argument) {
+    BREthereumAddress address;
+    memcpy (address.bytes, &argument[CONTRACT_ARGUMENT_BYTES - sizeof (address.bytes)], sizeof (address.bytes));
+    return address;
+}
+
+// A number argument is 32 big-endian bytes
+static UInt256
+decodeArgumentUInt256Bytes (const uint8_t *argument, size_t argumentCount, BRCoreParseStatus *status) {
+    if (argumentCount < CONTRACT_ARGUMENT_BYTES) {
+        *status = CORE_PARSE_STRANGE_DIGITS;
+        return UINT256_ZERO;
+    }
+
+    UInt256 value;
+    encodeReverseBytes (value.u8, argument, CONTRACT_ARGUMENT_BYTES);  // TODO: ENDIAN
+    *status = CORE_PARSE_OK;
+    return value;
+}
+
 /* ERC20
 o TotalSupply [Get the total token supply]
 o BalanceOf (address _owner) constant returns (uint256 balance) [Get the account balance of another account with address _owner]
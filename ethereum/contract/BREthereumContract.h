@@ -11,6 +11,9 @@
 #ifndef BR_Ethereum_Contract_h
 #define BR_Ethereum_Contract_h
 
+#include <stdint.h>
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -64,6 +67,37 @@ contractLookupFunctionForEncoding (BREthereumContract contract, const char *enco
 extern BREthereumContractEvent
 contractLookupEventForTopic (BREthereumContract contract, const char *topic);
 
+/// The sizes, in bytes, of a function selector, an event topic and an (ABI) argument
+#define CONTRACT_FUNCTION_SELECTOR_BYTES      4
+#define CONTRACT_EVENT_TOPIC_BYTES           32
+#define CONTRACT_ARGUMENT_BYTES              32
+
+/**
+ * Return the function whose selector prefaces the raw (not hex encoded) `data`, or NULL.  As
+ * contractLookupFunctionForEncoding() but without hex conversion.
+ *
+ * @param contract
+ * @param data
+ * @param dataCount
+ * @return
+ */
+extern BREthereumContractFunction
+contractLookupFunctionForBytes (BREthereumContract contract,
+                                const uint8_t *data,
+                                size_t dataCount);
+
+/**
+ * Return the event for the raw, CONTRACT_EVENT_TOPIC_BYTES, `topic`, or NULL.  As
+ * contractLookupEventForTopic() but without hex conversion.
+ *
+ * @param contract
+ * @param topic
+ * @return
+ */
+extern BREthereumContractEvent
+contractLookupEventForTopicBytes (BREthereumContract contract,
+                                  const uint8_t *topic);
+
 
 //
 // Contract / Function
@@ -93,6 +127,32 @@ eventERC20TransferDecodeUInt256 (BREthereumContractEvent event,
                                  const char *number,
                                  BRCoreParseStatus *status);
 
+//
+// Raw Decoders - as above, but reading raw topics and data in place, without hex conversion
+//
+#include "../base/BREthereumAddress.h"
+
+private_extern UInt256
+functionERC20TransferDecodeAmountBytes (BREthereumContractFunction function,
+                                        const uint8_t *data,
+                                        size_t dataCount,
+                                        BRCoreParseStatus *status);
+
+private_extern BREthereumAddress
+functionERC20TransferDecodeAddressBytes (BREthereumContractFunction function,
+                                         const uint8_t *data,
+                                         size_t dataCount);
+
+private_extern BREthereumAddress
+eventERC20TransferDecodeAddressBytes (BREthereumContractEvent event,
+                                      const uint8_t *topic);
+
+private_extern UInt256
+eventERC20TransferDecodeUInt256Bytes (BREthereumContractEvent event,
+                                      const uint8_t *data,
+                                      size_t dataCount,
+                                      BRCoreParseStatus *status);
+
 #ifdef __cplusplus
 }
 #endif
@@ -107,9 +107,49 @@ void runTokenLookupTests () {
 
 
 
+static void
+runContractDecodeTests () {
+    BRCoreParseStatus status;
+
+    // The raw topic for "Transfer(address,address,uint256)" finds the same event as its hex form.
+    const char *topicString = eventGetSelector (eventERC20Transfer);
+    uint8_t topic[CONTRACT_EVENT_TOPIC_BYTES];
+    decodeHex (topic, sizeof (topic), &topicString[2], strlen (topicString) - 2);
+    assert (eventERC20Transfer == contractLookupEventForTopic (contractERC20, topicString));
+    assert (eventERC20Transfer == contractLookupEventForTopicBytes (contractERC20, topic));
+    topic[31] ^= 1;
+    assert (NULL == contractLookupEventForTopicBytes (contractERC20, topic));
+
+    // transfer(0x932a27e1bc84f5b74c29af3d888926b1307f4a5c, 0x1439152d319e84d0000)
+    const char *encoding = ("0xa9059cbb"
+                            "000000000000000000000000932a27e1bc84f5b74c29af3d888926b1307f4a5c"
+                            "0000000000000000000000000000000000000000000001439152d319e84d0000");
+    uint8_t data[4 + 2 * CONTRACT_ARGUMENT_BYTES];
+    decodeHex (data, sizeof (data), &encoding[2], strlen (encoding) - 2);
+
+    assert (functionERC20Transfer == contractLookupFunctionForEncoding (contractERC20, encoding));
+    assert (functionERC20Transfer == contractLookupFunctionForBytes (contractERC20, data, sizeof (data)));
+    assert (NULL == contractLookupFunctionForBytes (contractERC20, data, 3));
+
+    UInt256 amount = functionERC20TransferDecodeAmountBytes (functionERC20Transfer, data, sizeof (data), &status);
+    assert (CORE_PARSE_OK == status &&
+            eqUInt256 (amount, functionERC20TransferDecodeAmount (functionERC20Transfer, encoding, &status)));
+
+    BREthereumAddress address = functionERC20TransferDecodeAddressBytes (functionERC20Transfer, data, sizeof (data));
+    char *addressString = functionERC20TransferDecodeAddress (functionERC20Transfer, encoding);
+    assert (ETHEREUM_BOOLEAN_IS_TRUE (addressEqual (address, addressCreate (addressString))));
+    free (addressString);
+
+    // The raw event value decoder reads 32 big-endian bytes in place.
+    amount = eventERC20TransferDecodeUInt256Bytes (eventERC20Transfer, &data[4 + CONTRACT_ARGUMENT_BYTES],
+                                                   CONTRACT_ARGUMENT_BYTES, &status);
+    assert (CORE_PARSE_OK == status && 0x9152d319e84d0000 == amount.u64[0] && 0x143 == amount.u64[1]);
+}
+
 extern void
 runContractTests (void) {
     installTokensForTest();
     runTokenParseTests ();
     runTokenLookupTests();
+    runContractDecodeTests();
 }
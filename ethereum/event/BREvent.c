@@ -8,11 +8,14 @@
 //  See the LICENSE file at the project root for license information.
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <sys/time.h>
 #include <assert.h>
+#include "support/BRStats.h"
 #include "BREvent.h"
 #include "BREventQueue.h"
 #include "BREventAlarm.h"
@@ -21,10 +24,53 @@
 #define PTHREAD_STACK_SIZE (512 * 1024)
 #define PTHREAD_NAME_SIZE   (33)
 
+/// The maximum number of events dequeued, and then dispatched, at once.
+#define EVENT_HANDLER_BATCH_COUNT   (8)
+
+/// The lanes in the order that each batch takes from them, and the most events that each batch
+/// takes from each lane before taking any lane's remaining events.  The weights sum to the batch
+/// count, so every lane with pending events is served in every batch.
+static const BREventPriority eventHandlerLanes[EVENT_PRIORITY_COUNT] = {
+    EVENT_PRIORITY_HIGH,
+    EVENT_PRIORITY_NORMAL,
+    EVENT_PRIORITY_LOW
+};
+
+static const size_t eventHandlerLaneWeights[EVENT_PRIORITY_COUNT] = { 4, 3, 1 };
+
+_Static_assert (EVENT_PRIORITY_COUNT == BR_STATS_EVENT_PRIORITIES,
+                "BRStatsEventQueueLatency needs a histogram for each priority");
+
 /* Forward Declarations */
 static void *
 eventHandlerThread (BREventHandler handler);
 
+static void
+eventExecutorSchedule (BREventExecutor executor,
+                       BREventHandler handler);
+
+//
+// Event Executor
+//
+struct BREventExecutorRecord {
+    char name[PTHREAD_NAME_SIZE];
+
+    /// The handlers with events to dispatch, as a list through `handler->nextReady`
+    BREventHandler ready;
+    BREventHandler readyLast;
+
+    // Pthread
+
+    size_t threadsCount;
+    pthread_t *threads;
+    pthread_cond_t cond;        // signalled when a handler is ready
+    pthread_cond_t condIdle;    // broadcast when a handler finishes executing
+    pthread_mutex_t lock;
+
+    // Boolean to identify if the threads should quit.
+    int threadQuit;
+};
+
 //
 // Event Handler
 //
@@ -35,10 +81,17 @@ struct BREventHandlerRecord {
     size_t typesCount;
     const BREventType **types;
 
-    // Queue
+    // Queues, one per lane, indexed by BREventPriority
     size_t eventSize;
-    BREventQueue queue;
-    BREvent *scratch;
+    BREventQueue queues[EVENT_PRIORITY_COUNT];
+    BREvent *scratch;   // EVENT_HANDLER_BATCH_COUNT events, each of `eventSize`
+
+    /// For each scratch event, when it was enqueued and its lane
+    uint64_t scratchTimes[EVENT_HANDLER_BATCH_COUNT];
+    BREventPriority scratchPriorities[EVENT_HANDLER_BATCH_COUNT];
+
+    /// The queue latency metrics, per lane
+    BREventLaneMetrics metrics[EVENT_PRIORITY_COUNT];
 
     // (Optional) Timeout
 
@@ -62,6 +115,13 @@ struct BREventHandlerRecord {
     ///
     BREventAlarmId timeoutAlarmId;
 
+    ///
+    /// The (optional) callbacks bracketing each batch of dispatched events
+    ///
+    void *batchContext;
+    BREventBatchCallback batchWillDispatch;
+    BREventBatchCallback batchDidDispatch;
+
     // Pthread
 
     pthread_t thread;
@@ -73,8 +133,29 @@ struct BREventHandlerRecord {
 
     // Boolean to identify if the thread should quit.
     int threadQuit;
+
+    // (Optional) Executor - if set, run on the executor's threads rather than `thread`
+
+    BREventExecutor executor;
+
+    /// True (1) if scheduled on, or executing on, the executor
+    _Atomic int scheduled;
+
+    /// Guarded by the executor's lock: if started; the count of executor threads running this
+    /// handler (at most one dispatches at a time) and the one last to dispatch; the next handler
+    /// in the executor's ready list
+    int started;
+    int executing;
+    pthread_t executingThread;
+    BREventHandler nextReady;
 };
 
+// A pending timeout is superseded by the next; a handler that falls behind runs one, not many.
+static uintptr_t
+eventHandlerTimeoutCoalescer (const BREvent *event) {
+    return 0;
+}
+
 extern BREventHandler
 eventHandlerCreate (const char *name,
                     const BREventType *types[],
@@ -86,6 +167,7 @@ eventHandlerCreate (const char *name,
     handler->timeoutEventType.eventName = "Timeout Event";
     handler->timeoutEventType.eventSize = sizeof(BREventTimeout);
     handler->timeoutEventType.eventDispatcher = NULL;
+    handler->timeoutEventType.eventCoalescer = eventHandlerTimeoutCoalescer;
 
     // Handle the event types.  Ensure we account for the (implicit) timeout event.
     handler->typesCount = typesCount;
@@ -97,6 +179,7 @@ eventHandlerCreate (const char *name,
     // Update `eventSize` with the largest sized event
     for (int i = 0; i < handler->typesCount; i++) {
         const BREventType *type = handler->types[i];
+        assert (type->eventPriority < EVENT_PRIORITY_COUNT);
 
         if (handler->eventSize < type->eventSize)
             handler->eventSize = type->eventSize;
@@ -137,8 +220,13 @@ eventHandlerCreate (const char *name,
 
     handler->thread = PTHREAD_NULL;
 
-    handler->scratch = (BREvent*) calloc (1, handler->eventSize);
-    handler->queue = eventQueueCreate (handler->eventSize);
+    // Use the default executor, if one exists.
+    handler->executor = eventExecutor;
+    atomic_init (&handler->scheduled, 0);
+
+    handler->scratch = (BREvent*) calloc (EVENT_HANDLER_BATCH_COUNT, handler->eventSize);
+    for (size_t priority = 0; priority < EVENT_PRIORITY_COUNT; priority++)
+        handler->queues[priority] = eventQueueCreate (handler->eventSize);
 
     return handler;
 }
@@ -159,6 +247,18 @@ eventHandlerSetTimeoutDispatcher (BREventHandler handler,
     pthread_cond_signal(&handler->cond);
 }
 
+extern void
+eventHandlerSetBatchCallbacks (BREventHandler handler,
+                               void *context,
+                               BREventBatchCallback willDispatch,
+                               BREventBatchCallback didDispatch) {
+    pthread_mutex_lock (handler->lockToUse);
+    handler->batchContext = context;
+    handler->batchWillDispatch = willDispatch;
+    handler->batchDidDispatch = didDispatch;
+    pthread_mutex_unlock (handler->lockToUse);
+}
+
 static void
 eventHandlerAlarmCallback (BREventHandler handler,
                            struct timespec expiration,
@@ -171,6 +271,69 @@ eventHandlerAlarmCallback (BREventHandler handler,
 
 typedef void* (*ThreadRoutine) (void*);
 
+static int
+eventHandlerHasPending (BREventHandler handler) {
+    for (size_t priority = 0; priority < EVENT_PRIORITY_COUNT; priority++)
+        if (eventQueueHasPending (handler->queues[priority])) return 1;
+    return 0;
+}
+
+/**
+ * Dequeue and dispatch up to EVENT_HANDLER_BATCH_COUNT events: first up to each lane's weight,
+ * from the highest lane down, and then, if the batch is not full, any lane's remaining events,
+ * again from the highest lane down.  Must be called with `handler->lockToUse` held.  Returns the
+ * number dispatched.
+ */
+static size_t
+eventHandlerDispatchPending (BREventHandler handler) {
+    size_t count = 0;
+
+    for (int weighted = 1; weighted >= 0; weighted--)
+        for (size_t lane = 0; lane < EVENT_PRIORITY_COUNT && count < EVENT_HANDLER_BATCH_COUNT; lane++) {
+            BREventPriority priority = eventHandlerLanes[lane];
+
+            size_t limit = EVENT_HANDLER_BATCH_COUNT - count;
+            if (weighted && limit > eventHandlerLaneWeights[lane]) limit = eventHandlerLaneWeights[lane];
+
+            size_t dequeued =
+            eventQueueDequeueManyWithTimes (handler->queues[priority],
+                                            (BREvent *) ((uint8_t *) handler->scratch + count * handler->eventSize),
+                                            &handler->scratchTimes[count],
+                                            limit);
+
+            for (size_t index = count; index < count + dequeued; index++)
+                handler->scratchPriorities[index] = priority;
+            count += dequeued;
+        }
+
+    if (0 == count) return 0;
+
+    BRStatsCount (BRStatsEventsDispatched, count);
+    BRStatsRecord (BRStatsEventBatchSize, count);
+
+    if (NULL != handler->batchWillDispatch) handler->batchWillDispatch (handler->batchContext);
+
+    for (size_t index = 0; index < count; index++) {
+        BREvent *event = (BREvent *) ((uint8_t *) handler->scratch + index * handler->eventSize);
+        BREventType *type = event->type;
+
+        BREventPriority priority = handler->scratchPriorities[index];
+        uint64_t latency = BRStatsMicroseconds() - handler->scratchTimes[index];
+        BRStatsRecord (BRStatsEventQueueLatency + priority, latency);
+
+        BREventLaneMetrics *metrics = &handler->metrics[priority];
+        metrics->dispatchedCount += 1;
+        metrics->latencySum += latency;
+        if (latency > metrics->latencyMaximum) metrics->latencyMaximum = latency;
+
+        type->eventDispatcher (handler, event);
+    }
+
+    if (NULL != handler->batchDidDispatch) handler->batchDidDispatch (handler->batchContext);
+
+    return count;
+}
+
 static void *
 eventHandlerThread (BREventHandler handler) {
 
@@ -185,26 +348,10 @@ eventHandlerThread (BREventHandler handler) {
     handler->threadQuit = 0;
 
     while (!handler->threadQuit) {
-        // Check for a queued event
-        switch (eventQueueDequeue(handler->queue, handler->scratch)) {
-            case EVENT_STATUS_SUCCESS: {
-                // If we have one, dispatch
-                BREventType *type = handler->scratch->type;
-                type->eventDispatcher (handler, handler->scratch);
-                break;
-            }
-
-            case EVENT_STATUS_NOT_STARTED:
-            case EVENT_STATUS_UNKNOWN_TYPE:
-            case EVENT_STATUS_NULL_EVENT:
-                // impossible?
-                // fall through
-
-            case EVENT_STATUS_NONE_PENDING:
-                // ... otherwise wait for an event ...
-                pthread_cond_wait(&handler->cond, handler->lockToUse);
-                break;
-        }
+        // Check for queued events and, if we have some, dispatch each, in order ...
+        // ... otherwise wait for an event ...
+        if (0 == eventHandlerDispatchPending (handler))
+            pthread_cond_wait(&handler->cond, handler->lockToUse);
     }
 
     // Requires as `cond_wait` takes its mutex when signalled.
@@ -226,7 +373,8 @@ eventHandlerDestroy (BREventHandler handler) {
     pthread_mutex_destroy(&handler->lockOnStartStop);
 
     // release memory
-    eventQueueDestroy(handler->queue);
+    for (size_t priority = 0; priority < EVENT_PRIORITY_COUNT; priority++)
+        eventQueueDestroy(handler->queues[priority]);
     free (handler->scratch);
     free (handler);
 }
@@ -237,7 +385,7 @@ eventHandlerDestroy (BREventHandler handler) {
 
 /**
  * Start the handler.  It is possible that events will already be queued; they will all be
- * dispatched, in FIFO order.  If there is a periodic alarm; it will be added to the alarmClock.
+ * dispatched, in FIFO order within each lane.  If there is a periodic alarm; it will be added to the alarmClock.
  *
  * @param handler
  */
@@ -245,7 +393,7 @@ extern void
 eventHandlerStart (BREventHandler handler) {
     alarmClockCreateIfNecessary(1);
     pthread_mutex_lock(&handler->lockOnStartStop);
-    if (PTHREAD_NULL == handler->thread) {
+    if (!eventHandlerIsRunning (handler)) {
         // If we have an timeout event dispatcher, then add an alarm.
         if (NULL != handler->timeoutEventType.eventDispatcher) {
             handler->timeoutAlarmId = alarmClockAddAlarmPeriodic (alarmClock,
@@ -254,8 +402,16 @@ eventHandlerStart (BREventHandler handler) {
                                                                   handler->timeout);
         }
 
-        // Spawn the eventHandlerThread
-        {
+        // Run on the executor, which dispatches any already queued events ...
+        if (NULL != handler->executor) {
+            pthread_mutex_lock (&handler->executor->lock);
+            handler->started = 1;
+            pthread_mutex_unlock (&handler->executor->lock);
+            eventExecutorSchedule (handler->executor, handler);
+        }
+
+        // ... or spawn the eventHandlerThread
+        else {
             pthread_attr_t attr;
             pthread_attr_init(&attr);
             pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -278,12 +434,52 @@ eventHandlerStart (BREventHandler handler) {
  * submit to this queue before stopping this queue's thread.  Or prior to a subsequent start,
  * clear this handler (But, `eventHandlerStart()` does not clear the thread on start.)
  *
+ * May be called by an event dispatcher of `handler` itself; the handler is then marked stopped
+ * without waiting for the dispatching thread, which finishes its batch and then leaves the
+ * handler alone.  Such a dispatcher must not destroy `handler`.
+ *
  * @param handler
  */
 extern void
 eventHandlerStop (BREventHandler handler) {
     pthread_mutex_lock(&handler->lockOnStartStop);
-    if (PTHREAD_NULL != handler->thread) {
+    if (NULL != handler->executor && eventHandlerIsRunning (handler)) {
+        BREventExecutor executor = handler->executor;
+
+        // Remove a timeout alarm, if it exists.
+        if (ALARM_ID_NONE != handler->timeoutAlarmId) {
+            alarmClockRemAlarm (alarmClock, handler->timeoutAlarmId);
+            handler->timeoutAlarmId = ALARM_ID_NONE;
+        }
+
+        pthread_mutex_lock (&executor->lock);
+        handler->started = 0;
+
+        // Remove `handler` from the ready list, if there ...
+        BREventHandler prev = NULL;
+        for (BREventHandler this = executor->ready; NULL != this; prev = this, this = this->nextReady)
+            if (handler == this) {
+                if (NULL == prev) executor->ready = this->nextReady;
+                else prev->nextReady = this->nextReady;
+                if (executor->readyLast == this) executor->readyLast = prev;
+
+                handler->nextReady = NULL;
+                atomic_store (&handler->scheduled, 0);
+                break;
+            }
+
+        // ... and wait for any executor thread to finish with it - unless this is that thread,
+        // dispatching an event that stops `handler`; waiting on ourself would never end.
+        int onExecutingThread = (handler->executing > 0 &&
+                                 pthread_equal (handler->executingThread, pthread_self()));
+        while (!onExecutingThread && handler->executing > 0)
+            pthread_cond_wait (&executor->condIdle, &executor->lock);
+        pthread_mutex_unlock (&executor->lock);
+
+        // Empty the queue completely.
+        eventHandlerClear (handler);
+    }
+    else if (PTHREAD_NULL != handler->thread) {
         pthread_mutex_lock (handler->lockToUse);
 
         // Remove a timeout alarm, if it exists.
@@ -292,11 +488,14 @@ eventHandlerStop (BREventHandler handler) {
             handler->timeoutAlarmId = ALARM_ID_NONE;
         }
 
-        // Quit the thread.
+        // Quit the thread.  If this is the thread, dispatching an event that stops `handler`, it
+        // can't be joined; detach it - it quits once its dispatcher returns.
         handler->threadQuit = 1;
         pthread_cond_signal(&handler->cond);
         pthread_mutex_unlock (handler->lockToUse);
-        pthread_join(handler->thread, NULL);
+        if (pthread_equal (handler->thread, pthread_self()))
+            pthread_detach (handler->thread);
+        else pthread_join(handler->thread, NULL);
         // A mini-race here?
         handler->thread = PTHREAD_NULL;
 
@@ -308,26 +507,228 @@ eventHandlerStop (BREventHandler handler) {
 
 extern int
 eventHandlerIsRunning (BREventHandler handler) {
-    return PTHREAD_NULL != handler->thread;
+    if (NULL == handler->executor)
+        return PTHREAD_NULL != handler->thread;
+
+    pthread_mutex_lock (&handler->executor->lock);
+    int started = handler->started;
+    pthread_mutex_unlock (&handler->executor->lock);
+    return started;
+}
+
+extern void
+eventHandlerSetExecutor (BREventHandler handler,
+                         BREventExecutor executor) {
+    pthread_mutex_lock(&handler->lockOnStartStop);
+    assert (!eventHandlerIsRunning (handler));
+    handler->executor = executor;
+    pthread_mutex_unlock(&handler->lockOnStartStop);
 }
 
 extern BREventStatus
 eventHandlerSignalEvent (BREventHandler handler,
                          BREvent *event) {
-    eventQueueEnqueueTail(handler->queue, event);
-    pthread_cond_signal(&handler->cond);
+    if (eventQueueEnqueueTail(handler->queues[event->type->eventPriority], event))
+        BRStatsCount (BRStatsEventsQueued, 1);
+    else BRStatsCount (BRStatsEventsCoalesced, 1);
+    if (NULL != handler->executor) eventExecutorSchedule (handler->executor, handler);
+    else pthread_cond_signal(&handler->cond);
     return EVENT_STATUS_SUCCESS;
 }
 
 extern BREventStatus
 eventHandlerSignalEventOOB (BREventHandler handler,
                             BREvent *event) {
-    eventQueueEnqueueHead(handler->queue, event);
-    pthread_cond_signal(&handler->cond);
+    if (eventQueueEnqueueHead(handler->queues[EVENT_PRIORITY_HIGH], event))
+        BRStatsCount (BRStatsEventsQueued, 1);
+    else BRStatsCount (BRStatsEventsCoalesced, 1);
+    if (NULL != handler->executor) eventExecutorSchedule (handler->executor, handler);
+    else pthread_cond_signal(&handler->cond);
     return EVENT_STATUS_SUCCESS;
 }
 
+extern BREventLaneMetrics
+eventHandlerGetLaneMetrics (BREventHandler handler,
+                            BREventPriority priority) {
+    assert (priority < EVENT_PRIORITY_COUNT);
+
+    pthread_mutex_lock (handler->lockToUse);
+    BREventLaneMetrics metrics = handler->metrics[priority];
+    pthread_mutex_unlock (handler->lockToUse);
+
+    return metrics;
+}
+
+extern size_t
+eventHandlerGetMemoryUsage (BREventHandler handler) {
+    size_t usage = (sizeof (struct BREventHandlerRecord) +
+                    EVENT_HANDLER_BATCH_COUNT * handler->eventSize);
+
+    for (size_t priority = 0; priority < EVENT_PRIORITY_COUNT; priority++)
+        usage += eventQueueGetMemoryUsage (handler->queues[priority]);
+
+    return usage;
+}
+
 extern void
 eventHandlerClear (BREventHandler handler) {
-    eventQueueClear(handler->queue);
+    for (size_t priority = 0; priority < EVENT_PRIORITY_COUNT; priority++)
+        eventQueueClear(handler->queues[priority]);
+}
+
+//
+// Event Executor
+//
+
+/**
+ * The default executor, if any, as used by `eventHandlerCreate()`.
+ */
+BREventExecutor eventExecutor = NULL;
+
+// Append `handler` to the ready list.  Requires `executor->lock`.
+static void
+eventExecutorAppendReady (BREventExecutor executor,
+                          BREventHandler handler) {
+    handler->nextReady = NULL;
+    if (NULL == executor->ready) executor->ready = handler;
+    else executor->readyLast->nextReady = handler;
+    executor->readyLast = handler;
+    pthread_cond_signal (&executor->cond);
+}
+
+/**
+ * Schedule `handler` to have its pending events dispatched.  Only an unscheduled handler is
+ * added to the ready list - so a handler is on the list, or executing, at most once and its
+ * events are dispatched in order.
+ */
+static void
+eventExecutorSchedule (BREventExecutor executor,
+                       BREventHandler handler) {
+    if (0 != atomic_exchange (&handler->scheduled, 1)) return;
+
+    pthread_mutex_lock (&executor->lock);
+    if (handler->started) eventExecutorAppendReady (executor, handler);
+    else atomic_store (&handler->scheduled, 0);
+    pthread_mutex_unlock (&executor->lock);
+}
+
+static void *
+eventExecutorThread (BREventExecutor executor) {
+
+#if defined (__ANDROID__)
+    pthread_setname_np(pthread_self(), executor->name);
+#else
+    pthread_setname_np(executor->name);
+#endif
+
+    pthread_mutex_lock (&executor->lock);
+
+    while (!executor->threadQuit) {
+        BREventHandler handler = executor->ready;
+
+        // Nothing is ready; wait.
+        if (NULL == handler) {
+            pthread_cond_wait (&executor->cond, &executor->lock);
+            continue;
+        }
+
+        executor->ready = handler->nextReady;
+        if (NULL == executor->ready) executor->readyLast = NULL;
+        handler->nextReady = NULL;
+        handler->executing++;
+        handler->executingThread = pthread_self();
+        pthread_mutex_unlock (&executor->lock);
+
+        // Dispatch a batch, as the handler's thread would.
+        pthread_mutex_lock (handler->lockToUse);
+        eventHandlerDispatchPending (handler);
+        pthread_mutex_unlock (handler->lockToUse);
+
+        // Unschedule and then, if events remain, reschedule at the end of the ready list.  A
+        // concurrent signal either sees `scheduled` cleared, and schedules, or is seen here.
+        atomic_store (&handler->scheduled, 0);
+
+        pthread_mutex_lock (&executor->lock);
+        handler->executing--;
+        if (handler->started &&
+            eventHandlerHasPending (handler) &&
+            0 == atomic_exchange (&handler->scheduled, 1))
+            eventExecutorAppendReady (executor, handler);
+        pthread_cond_broadcast (&executor->condIdle);
+    }
+
+    pthread_mutex_unlock (&executor->lock);
+
+    return NULL;
+}
+
+extern BREventExecutor
+eventExecutorCreate (const char *name,
+                     unsigned int threadsCount) {
+    BREventExecutor executor = calloc (1, sizeof (struct BREventExecutorRecord));
+
+    strlcpy (executor->name, name, PTHREAD_NAME_SIZE);
+    executor->ready = NULL;
+    executor->readyLast = NULL;
+    executor->threadQuit = 0;
+
+    // Create the PTHREAD CONDition variables
+    {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_cond_init(&executor->cond, &attr);
+        pthread_cond_init(&executor->condIdle, &attr);
+        pthread_condattr_destroy(&attr);
+    }
+
+    // Create the PTHREAD LOCK variable
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_NORMAL);
+        pthread_mutex_init(&executor->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+
+    // Spawn the eventExecutorThreads
+    executor->threadsCount = (0 == threadsCount ? 1 : threadsCount);
+    executor->threads = calloc (executor->threadsCount, sizeof (pthread_t));
+    for (size_t index = 0; index < executor->threadsCount; index++) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+        pthread_attr_setstacksize(&attr, PTHREAD_STACK_SIZE);
+
+        pthread_create(&executor->threads[index], &attr, (ThreadRoutine) eventExecutorThread, executor);
+        pthread_attr_destroy(&attr);
+    }
+
+    return executor;
+}
+
+extern void
+eventExecutorCreateIfNecessary (unsigned int threadsCount) {
+    if (NULL == eventExecutor)
+        eventExecutor = eventExecutorCreate ("Core Event Executor", threadsCount);
+}
+
+extern void
+eventExecutorDestroy (BREventExecutor executor) {
+    pthread_mutex_lock (&executor->lock);
+    executor->threadQuit = 1;
+    pthread_cond_broadcast (&executor->cond);
+    pthread_mutex_unlock (&executor->lock);
+
+    for (size_t index = 0; index < executor->threadsCount; index++)
+        pthread_join (executor->threads[index], NULL);
+
+    pthread_cond_destroy(&executor->cond);
+    pthread_cond_destroy(&executor->condIdle);
+    pthread_mutex_destroy(&executor->lock);
+
+    if (executor == eventExecutor)
+        eventExecutor = NULL;
+
+    free (executor->threads);
+    free (executor);
 }
@@ -12,6 +12,7 @@
 #define BR_Event_h
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <time.h>
 #include <pthread.h>
 
@@ -21,6 +22,7 @@ extern "C" {
 
 /* Forward Declarations */
 typedef struct BREventHandlerRecord *BREventHandler;
+typedef struct BREventExecutorRecord *BREventExecutor;
 
 typedef struct BREventTypeRecord BREventType;
 typedef struct BREventRecord BREvent;
@@ -41,16 +43,43 @@ typedef void
 typedef void
 (*BREventDestroyer) (BREvent *event);
 
+/**
+ * An EventCoalescer returns the key of `event` for coalescing.  Of the pending events with the same
+ * type and key, only the newest is dispatched - in the queue position of the oldest; the older
+ * ones are destroyed, with the type's eventDestroyer, and not dispatched.  Use for events, like a
+ * new block chain head, that supersede prior ones.
+ */
+typedef uintptr_t
+(*BREventCoalescer) (const BREvent *event);
+
+/**
+ * An EventPriority selects the lane in which a handler queues an event.  Each batch of dispatched
+ * events takes from every lane with pending events - up to a weight per lane, higher lanes first -
+ * so that latency-sensitive events, such as the results of user actions, do not wait behind bulk
+ * work and so that bulk work is never starved.  The events in one lane are dispatched in order;
+ * events in different lanes are not.
+ */
+typedef enum {
+    EVENT_PRIORITY_NORMAL,      // The default
+    EVENT_PRIORITY_HIGH,
+    EVENT_PRIORITY_LOW
+} BREventPriority;
+
+#define EVENT_PRIORITY_COUNT        (3)
+
 /**
  * An EventType defines the types of events that will be handled.  Each individual Event will hold
  * a reference to an EventType; when the Event is handled, the EventType's eventDispathver will
- * be invoked.  The `eventSize` is used by the handler to allocate a cache of events.
+ * be invoked.  The `eventSize` is used by the handler to allocate a cache of events.  Events
+ * are queued in the lane of `eventPriority` and, if `eventCoalescer` is not NULL, coalesced.
  */
 struct BREventTypeRecord{
     const char *eventName;
     size_t eventSize;
     BREventDispatcher eventDispatcher;
     BREventDestroyer eventDestroyer;
+    BREventPriority eventPriority;
+    BREventCoalescer eventCoalescer;
 };
 
 /**
@@ -122,6 +151,24 @@ eventHandlerSetTimeoutDispatcher (BREventHandler handler,
                                   BREventDispatcher dispatcher,
                                   BREventTimeoutContext context);
 
+/**
+ * A BatchCallback brackets a batch of dispatched events; see eventHandlerSetBatchCallbacks().
+ */
+typedef void
+(*BREventBatchCallback) (void *context);
+
+/**
+ * Optionally bracket each batch of dispatched events - up to EVENT_HANDLER_BATCH_COUNT events
+ * dequeued at once - with `willDispatch` and `didDispatch`.  Both run in the handler's thread,
+ * with the handler's lock held, and are passed `context`.  Used, for example, to group the
+ * storage writes of all the events in a batch.
+ */
+extern void
+eventHandlerSetBatchCallbacks (BREventHandler handler,
+                               void *context,
+                               BREventBatchCallback willDispatch,
+                               BREventBatchCallback didDispatch);
+
 extern void
 eventHandlerDestroy (BREventHandler handler);
 
@@ -139,8 +186,8 @@ eventHandlerIsRunning (BREventHandler handler);
 
 /**
  * Signal `event` by announcing/sending it to `handler`.  The handler will queue the event
- * at the TAIL of the queue (aka 'first-in, first-out' basis, except for OOB events). The event
- * is handled within the handler's thread.
+ * at the TAIL of the queue (aka 'first-in, first-out' basis, except for OOB events) of the lane
+ * for the event type's priority. The event is handled within the handler's thread.
  *
  * @Note: `event` is added to the TAIL of pending events.
  *
@@ -152,8 +199,9 @@ eventHandlerSignalEvent (BREventHandler handler,
 
 /**
  * Signal `event` by announcing/sending it to `handler`. The handler will queue the event
- * at the HEAD of the queue (aka 'Out-Of-Band'); thus the event will be handled immediately.  The
- * event is handled within the handler's thread.
+ * at the HEAD of the queue (aka 'Out-Of-Band') of the EVENT_PRIORITY_HIGH lane, whatever the
+ * event type's priority; thus the event will be handled immediately.  The event is handled
+ * within the handler's thread.
  *
  * @Note: `event` is added to the HEAD (Out-Of-Band) of pending events.
  */
@@ -162,6 +210,32 @@ eventHandlerSignalEventOOB (BREventHandler handler,
                             BREvent *event);
 
 
+/**
+ * The queue latency of the events a handler dispatched from one lane.  (The same latencies, of
+ * all handlers, are recorded in the BRStatsEventQueueLatency histograms.)
+ */
+typedef struct {
+    /// The number of events dispatched
+    uint64_t dispatchedCount;
+
+    /// The microseconds from signal to dispatch, summed over all dispatched events, and the most
+    uint64_t latencySum;
+    uint64_t latencyMaximum;
+} BREventLaneMetrics;
+
+/**
+ * Return the queue latency metrics for `handler`s lane of `priority`, since creation.
+ */
+extern BREventLaneMetrics
+eventHandlerGetLaneMetrics (BREventHandler handler,
+                            BREventPriority priority);
+
+/**
+ * Return the bytes held by `handler`, including the event queues of all its lanes.
+ */
+extern size_t
+eventHandlerGetMemoryUsage (BREventHandler handler);
+
 /**
  * Clean the handlers' event queue.
  *
@@ -170,6 +244,44 @@ eventHandlerSignalEventOOB (BREventHandler handler,
 extern void
 eventHandlerClear (BREventHandler handler);
 
+/**
+ * Run `handler` on `executor`, rather than on its own thread.  If `executor` is NULL, `handler`
+ * will run on its own thread.  The handler must not be running.
+ */
+extern void
+eventHandlerSetExecutor (BREventHandler handler,
+                         BREventExecutor executor);
+
+//
+// Event Executor
+//
+// An EventExecutor runs many EventHandlers on a fixed pool of threads.  Each handler's events are
+// dispatched in order, by one thread at a time, while holding the handler's lock - just as with
+// the handler's own thread.  Dispatchers that block occupy an executor thread while blocked.
+//
+
+/**
+ * The default executor, if any.  Handlers created while this is set run on it.
+ */
+extern BREventExecutor eventExecutor;
+
+/**
+ * Create `eventExecutor`, the default executor, with `threadsCount` threads.  Call before
+ * creating handlers (such as by creating an EWM) to have them share threads.
+ */
+extern void
+eventExecutorCreateIfNecessary (unsigned int threadsCount);
+
+extern BREventExecutor
+eventExecutorCreate (const char *name,
+                     unsigned int threadsCount);
+
+/**
+ * Destroy `executor`.  No handler may be running on `executor`.
+ */
+extern void
+eventExecutorDestroy (BREventExecutor executor);
+
 #ifdef __cplusplus
 }
 #endif
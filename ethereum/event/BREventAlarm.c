@@ -9,13 +9,17 @@
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 //
 
+#include <stdlib.h>
 #include <string.h>
+#include <assert.h>
 #include <limits.h>
 #include <errno.h>
 #include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <sys/time.h>
 #include "support/BRAssert.h"
-#include "support/BRArray.h"
+#include "support/BRSet.h"
 #include "BREvent.h"
 #include "BREventAlarm.h"
 
@@ -81,6 +85,24 @@ timespecCompare (struct timespec *t1, struct timespec *t2) {
  */
 BREventAlarmClock alarmClock = NULL;
 
+/// The clock's resolution.  Alarms are expired on tick boundaries, so alarms expiring within the
+/// same tick are coalesced into a single wakeup; an alarm is never expired early but may be
+/// expired up to one tick late.
+#define ALARM_CLOCK_TICK_MILLISECONDS      (100)
+#define ALARM_CLOCK_TICK_NANOSECONDS       (1000000 * (uint64_t) ALARM_CLOCK_TICK_MILLISECONDS)
+
+/// The timer wheel: LEVELS levels of SLOTS slots.  Level `n` slots each span SLOTS^n ticks; all
+/// levels together span SLOTS^LEVELS ticks (about 19 days).  Alarms beyond that are parked in the
+/// top level and reinserted once they reach level 0.
+#define ALARM_CLOCK_WHEEL_BITS             (6)
+#define ALARM_CLOCK_WHEEL_SLOTS            (1 << ALARM_CLOCK_WHEEL_BITS)
+#define ALARM_CLOCK_WHEEL_LEVELS           (4)
+
+#define ALARM_CLOCK_WHEEL_SPAN(level)      ((uint64_t) 1 << (ALARM_CLOCK_WHEEL_BITS * (level)))
+
+/// Cap the seconds of a tick computation so as not to overflow for 'forever' expirations.
+#define ALARM_CLOCK_SECONDS_MAXIMUM        ((int64_t) 1 << 32)
+
 typedef enum {
     ALARM_ONE_SHOT,
     ALARM_PERIODIC
@@ -88,7 +110,9 @@ typedef enum {
 
 /**
  */
-typedef struct {
+typedef struct BREventAlarmRecord BREventAlarm;
+
+struct BREventAlarmRecord {
     BREventAlarmId identifier;
     BREventAlarmType type;
     BREventAlarmContext context;
@@ -99,35 +123,49 @@ typedef struct {
 
     /// The alarm's period.  For a ONE_SHOT alarm, this is ignored/zeroed.
     struct timespec period;
-} BREventAlarm;
 
-static BREventAlarm
+    /// The alarm's place in the clock's wheel: the tick and the wheel's `level` and `slot`, as
+    /// well as the neighbors in the slot's doubly-linked list.
+    uint64_t tick;
+    unsigned int level;
+    unsigned int slot;
+    BREventAlarm *next;
+    BREventAlarm *prev;
+};
+
+static BREventAlarm *
 alarmCreatePeriodic (BREventAlarmContext context,
                      BREventAlarmCallback callback,
                      struct timespec expiration,  // first expiration...
                      struct timespec period,      // ...thereafter increment
                      BREventAlarmId identifier) {
-    return (BREventAlarm) {
-        .type = ALARM_PERIODIC,
-        .identifier = identifier,
-        .context = context,
-        .callback = callback,
-        .expiration = expiration,
-        .period = period };
+    BREventAlarm *alarm = calloc (1, sizeof (BREventAlarm));
+
+    alarm->type = ALARM_PERIODIC;
+    alarm->identifier = identifier;
+    alarm->context = context;
+    alarm->callback = callback;
+    alarm->expiration = expiration;
+    alarm->period = period;
+
+    return alarm;
 }
 
-static BREventAlarm
+static BREventAlarm *
 alarmCreate (BREventAlarmContext context,
              BREventAlarmCallback callback,
              struct timespec expiration,
              BREventAlarmId identifier) {
-    return (BREventAlarm) {
-        .type = ALARM_ONE_SHOT,
-        .identifier = identifier,
-        .context = context,
-        .callback = callback,
-        .expiration = expiration,
-        .period = { .tv_sec = 0, .tv_nsec = 0 } };
+    BREventAlarm *alarm = calloc (1, sizeof (BREventAlarm));
+
+    alarm->type = ALARM_ONE_SHOT;
+    alarm->identifier = identifier;
+    alarm->context = context;
+    alarm->callback = callback;
+    alarm->expiration = expiration;
+    alarm->period = (struct timespec) { .tv_sec = 0, .tv_nsec = 0 };
+
+    return alarm;
 }
 
 static int
@@ -148,6 +186,16 @@ alarmExpire (BREventAlarm *alarm, BREventAlarmClock clock) {
         alarm->callback (alarm->context, alarm->expiration, clock);
 }
 
+static size_t
+alarmHashValue (const void *alarm) {
+    return (size_t) ((const BREventAlarm *) alarm)->identifier;
+}
+
+static int
+alarmHashEqual (const void *alarm1, const void *alarm2) {
+    return ((const BREventAlarm *) alarm1)->identifier == ((const BREventAlarm *) alarm2)->identifier;
+}
+
 /**
  */
 static void
@@ -157,12 +205,24 @@ struct BREventAlarmClock {
     /// Identifier of the next alarm created.
     BREventAlarmId identifier;
 
-    /// An BRArrayOf alarms, sorted by alarm.expiration ascending.
-    BREventAlarm *alarms;
+    /// A BRSetOf(BREventAlarm*), by identifier, of every alarm in `wheel`
+    BRSetOf(BREventAlarm*) alarms;
+
+    /// The timer wheel - a list of alarms per level and slot - and, per level, a bitmap of the
+    /// non-empty slots.
+    BREventAlarm *wheel[ALARM_CLOCK_WHEEL_LEVELS][ALARM_CLOCK_WHEEL_SLOTS];
+    uint64_t occupied[ALARM_CLOCK_WHEEL_LEVELS];
+
+    /// The time of tick zero and the next tick to process.
+    struct timespec epoch;
+    uint64_t tick;
 
     /// The time of the next timeout
     struct timespec timeout;
 
+    /// The wakeup descriptor, as a pipe, written when `timeout` moves earlier.  Created on demand.
+    int wakeup[2];
+
     // Thread
     pthread_t thread;
     pthread_cond_t cond;
@@ -172,6 +232,215 @@ struct BREventAlarmClock {
     int threadQuit;
 };
 
+/// MARK: - Clock Wheel
+
+static uint64_t
+alarmClockTickForTime (BREventAlarmClock clock,
+                       struct timespec *time,
+                       int roundUp) {
+    if (timespecCompare (time, &clock->epoch) <= 0) return 0;
+
+    int64_t seconds = (int64_t) time->tv_sec - (int64_t) clock->epoch.tv_sec;
+    if (seconds > ALARM_CLOCK_SECONDS_MAXIMUM) seconds = ALARM_CLOCK_SECONDS_MAXIMUM;
+
+    uint64_t nanoseconds = (uint64_t) (1000000000 * seconds + time->tv_nsec - clock->epoch.tv_nsec);
+    return (roundUp
+            ? (nanoseconds + ALARM_CLOCK_TICK_NANOSECONDS - 1) / ALARM_CLOCK_TICK_NANOSECONDS
+            : nanoseconds / ALARM_CLOCK_TICK_NANOSECONDS);
+}
+
+static struct timespec
+alarmClockTimeForTick (BREventAlarmClock clock,
+                       uint64_t tick) {
+    uint64_t milliseconds = tick * ALARM_CLOCK_TICK_MILLISECONDS;
+    struct timespec time = {
+        .tv_sec  = (time_t) (milliseconds / 1000),
+        .tv_nsec = (long) (1000000 * (milliseconds % 1000)) };
+    timespecInc (&time, &clock->epoch);
+    return time;
+}
+
+static void
+alarmClockInsertAlarm (BREventAlarmClock clock,
+                       BREventAlarm *alarm) {
+    uint64_t tick = alarmClockTickForTime (clock, &alarm->expiration, 1);
+    if (tick < clock->tick) tick = clock->tick;
+
+    // Park alarms beyond the wheel's span in the top level; they are reinserted from level 0.
+    if (tick - clock->tick >= ALARM_CLOCK_WHEEL_SPAN (ALARM_CLOCK_WHEEL_LEVELS))
+        tick = clock->tick + ALARM_CLOCK_WHEEL_SPAN (ALARM_CLOCK_WHEEL_LEVELS) - 1;
+
+    // The level is such that the alarm's tick is within one rotation of the level's slots.
+    unsigned int level = 0;
+    while (level < ALARM_CLOCK_WHEEL_LEVELS - 1 && tick - clock->tick >= ALARM_CLOCK_WHEEL_SPAN (level + 1))
+        level++;
+
+    alarm->tick  = tick;
+    alarm->level = level;
+    alarm->slot  = (unsigned int) (tick >> (ALARM_CLOCK_WHEEL_BITS * level)) & (ALARM_CLOCK_WHEEL_SLOTS - 1);
+
+    BREventAlarm **head = &clock->wheel[alarm->level][alarm->slot];
+    alarm->prev = NULL;
+    alarm->next = *head;
+    if (NULL != *head) (*head)->prev = alarm;
+    *head = alarm;
+
+    clock->occupied[alarm->level] |= (uint64_t) 1 << alarm->slot;
+}
+
+static void
+alarmClockUnlinkAlarm (BREventAlarmClock clock,
+                       BREventAlarm *alarm) {
+    BREventAlarm **head = &clock->wheel[alarm->level][alarm->slot];
+
+    if (NULL != alarm->prev) alarm->prev->next = alarm->next;
+    else *head = alarm->next;
+    if (NULL != alarm->next) alarm->next->prev = alarm->prev;
+
+    if (NULL == *head)
+        clock->occupied[alarm->level] &= ~((uint64_t) 1 << alarm->slot);
+
+    alarm->next = alarm->prev = NULL;
+}
+
+static BREventAlarm *
+alarmClockDetachSlot (BREventAlarmClock clock,
+                      unsigned int level,
+                      unsigned int slot) {
+    BREventAlarm *alarms = clock->wheel[level][slot];
+    clock->wheel[level][slot] = NULL;
+    clock->occupied[level] &= ~((uint64_t) 1 << slot);
+    return alarms;
+}
+
+/**
+ * Find the next tick, at or after `clock->tick`, that needs processing - either a level 0 slot
+ * with alarms to expire or a higher level slot with alarms to cascade down.
+ */
+static int
+alarmClockNextTick (BREventAlarmClock clock,
+                    uint64_t *next) {
+    int found = 0;
+
+    for (unsigned int level = 0; level < ALARM_CLOCK_WHEEL_LEVELS; level++) {
+        uint64_t occupied = clock->occupied[level];
+        if (0 == occupied) continue;
+
+        // The first of this level's slot boundaries at or after `clock->tick`...
+        unsigned int shift = ALARM_CLOCK_WHEEL_BITS * level;
+        uint64_t index = (clock->tick + ALARM_CLOCK_WHEEL_SPAN (level) - 1) >> shift;
+
+        // ... and then the first occupied slot, in rotation order, from there.
+        unsigned int rotate = (unsigned int) index & (ALARM_CLOCK_WHEEL_SLOTS - 1);
+        if (0 != rotate)
+            occupied = (occupied >> rotate) | (occupied << (ALARM_CLOCK_WHEEL_SLOTS - rotate));
+
+        unsigned int offset = 0;
+        while (0 == (occupied & 1)) { occupied >>= 1; offset++; }
+
+        uint64_t tick = (index + offset) << shift;
+        if (!found || tick < *next) { *next = tick; found = 1; }
+    }
+
+    return found;
+}
+
+/**
+ * Expire every alarm due at or before `now`.  Must be called with `clock->lock` held; callbacks
+ * are invoked with the lock held.
+ */
+static size_t
+alarmClockExpireAlarmsLocked (BREventAlarmClock clock,
+                              struct timespec now) {
+    uint64_t nowTick = alarmClockTickForTime (clock, &now, 0);
+    uint64_t tick;
+    size_t count = 0;
+
+    while (alarmClockNextTick (clock, &tick) && tick <= nowTick) {
+        clock->tick = tick;
+
+        // Cascade, from the top down, each level whose slot boundary is `tick`
+        for (unsigned int level = ALARM_CLOCK_WHEEL_LEVELS - 1; level > 0; level--) {
+            if (0 != (tick & (ALARM_CLOCK_WHEEL_SPAN (level) - 1))) continue;
+
+            unsigned int slot = (unsigned int) (tick >> (ALARM_CLOCK_WHEEL_BITS * level));
+            BREventAlarm *alarm = alarmClockDetachSlot (clock, level, slot & (ALARM_CLOCK_WHEEL_SLOTS - 1));
+            while (NULL != alarm) {
+                BREventAlarm *next = alarm->next;
+                alarmClockInsertAlarm (clock, alarm);
+                alarm = next;
+            }
+        }
+
+        // Expire the level 0 slot; alarms (re)inserted now will land at, or after, the next tick.
+        BREventAlarm *alarm = alarmClockDetachSlot (clock, 0, (unsigned int) tick & (ALARM_CLOCK_WHEEL_SLOTS - 1));
+        clock->tick = tick + 1;
+
+        while (NULL != alarm) {
+            BREventAlarm *next = alarm->next;
+
+            // A parked alarm, from beyond the wheel's span, that is not yet due.
+            if (alarmClockTickForTime (clock, &alarm->expiration, 1) > tick)
+                alarmClockInsertAlarm (clock, alarm);
+
+            else {
+                // Expire the alarm - invokes the callback.
+                alarmExpire (alarm, clock);
+                count++;
+
+                // If periodic, update the alarm expiration and reinsert
+                if (alarmIsPeriodic (alarm)) {
+                    alarmPeriodUpdate (alarm);
+                    alarmClockInsertAlarm (clock, alarm);
+                }
+                else {
+                    BRSetRemove (clock->alarms, alarm);
+                    free (alarm);
+                }
+            }
+            alarm = next;
+        }
+    }
+
+    // Every slot through `nowTick` is empty; start from the following tick.
+    if (clock->tick <= nowTick) clock->tick = nowTick + 1;
+
+    return count;
+}
+
+/**
+ * Compute the next timeout and, if earlier than the current one, wake the clock's thread and
+ * signal the wakeup descriptor.  Must be called with `clock->lock` held.
+ */
+static void
+alarmClockUpdateTimeout (BREventAlarmClock clock) {
+    uint64_t tick;
+    if (!alarmClockNextTick (clock, &tick)) return;
+
+    struct timespec timeout = alarmClockTimeForTick (clock, tick);
+    if (-1 == timespecCompare (&timeout, &clock->timeout)) {
+        clock->timeout = timeout;
+        pthread_cond_signal (&clock->cond);
+
+        if (-1 != clock->wakeup[1]) {
+            uint8_t byte = 0;
+            ssize_t written = write (clock->wakeup[1], &byte, 1);
+            (void) written;  // EAGAIN: the pipe already has a pending wakeup.
+        }
+    }
+}
+
+static void
+alarmClockClearAlarms (BREventAlarmClock clock) {
+    BRSetFreeAll (clock->alarms, free);
+    clock->alarms = BRSetNew (alarmHashValue, alarmHashEqual, 10);
+
+    memset (clock->wheel, 0, sizeof (clock->wheel));
+    memset (clock->occupied, 0, sizeof (clock->occupied));
+}
+
+/// MARK: - Clock
+
 extern void
 alarmClockCreateIfNecessary (int start) {
     if (NULL == alarmClock)
@@ -185,7 +454,13 @@ alarmClockCreate (void) {
     BREventAlarmClock clock = calloc (1, sizeof (struct BREventAlarmClock));
 
     clock->identifier = ALARM_ID_NONE;
-    array_new(clock->alarms, 5);
+    clock->alarms = BRSetNew (alarmHashValue, alarmHashEqual, 10);
+
+    clock->epoch = getTime();
+    clock->tick  = 0;
+    clock->timeout = (struct timespec) { .tv_sec = LONG_MAX, .tv_nsec = 0 };
+
+    clock->wakeup[0] = clock->wakeup[1] = -1;
 
     // Create the PTHREAD CONDition variable
     {
@@ -235,26 +510,15 @@ alarmClockDestroy (BREventAlarmClock clock) {
     pthread_mutex_destroy(&clock->lock);
     pthread_mutex_destroy(&clock->lockOnStartStop);
 
-    array_free (clock->alarms);
+    if (-1 != clock->wakeup[0]) close (clock->wakeup[0]);
+    if (-1 != clock->wakeup[1]) close (clock->wakeup[1]);
+
+    BRSetFreeAll (clock->alarms, free);
     if (clock == alarmClock)
         free (alarmClock);
         alarmClock = NULL;
 }
 
-static void
-alarmClockInsertAlarm (BREventAlarmClock clock,
-                       BREventAlarm alarm) {
-    int count = (int) array_count (clock->alarms);
-    int index = count;
-
-    for (; index > 0; index--) {
-        // If alarm.expiration is not less than 'alarm at index-1', then insert alarm at index
-        if (-1 != timespecCompare(&alarm.expiration, &clock->alarms[index - 1].expiration))
-            break;
-    }
-    array_insert (clock->alarms, index, alarm);
-}
-
 typedef void* (*ThreadRoutine) (void*);
 
 static void *
@@ -271,35 +535,18 @@ alarmClockThread (BREventAlarmClock clock) {
     clock->threadQuit = 0;
 
     while (!clock->threadQuit) {
-        // Set the next timeout - based on an existing alarm or 'forever in the future'
-        clock->timeout = (array_count(clock->alarms) > 0
-                          ? clock->alarms[0].expiration
-                          : (struct timespec) { .tv_sec = LONG_MAX, .tv_nsec = 0 });
+        // Expire all the alarms that are due - coalesced by tick.
+        alarmClockExpireAlarmsLocked (clock, getTime());
 
-        switch (pthread_cond_timedwait (&clock->cond, &clock->lock, &clock->timeout)) {
-            case ETIMEDOUT: {
-                // If we timed-out, then get the alarm that has expired...
-                BREventAlarm alarm = clock->alarms[0];
-                // ... and remove it from the clock's alarms (for now; if periodic, add it back)
-                array_rm (clock->alarms, 0);
-
-                // Expire the alarm - invokes the callback.
-                alarmExpire(&alarm, clock);
-
-                // If periodic, update the alarm expiration and reinsert
-                if (alarmIsPeriodic(&alarm)) {
-                    alarmPeriodUpdate(&alarm);
-                    alarmClockInsertAlarm(clock, alarm);
-                }
-
-                break;
-            }
+        // Set the next timeout - based on the wheel's next tick or 'forever in the future'
+        uint64_t tick;
+        clock->timeout = (alarmClockNextTick (clock, &tick)
+                          ? alarmClockTimeForTick (clock, tick)
+                          : (struct timespec) { .tv_sec = LONG_MAX, .tv_nsec = 0 });
 
-            default:
-                // Update clock->timeout (above, presumably an alarm was added) and wait again.
-                // Or clock->threadQuit is set.
-                break;
-        }
+        // Wait for the timeout, for an earlier timeout (presumably an alarm was added) or for
+        // clock->threadQuit to be set.
+        pthread_cond_timedwait (&clock->cond, &clock->lock, &clock->timeout);
     }
 
     // Requires as `cond_wait` takes its mutex when signalled.
@@ -335,6 +582,7 @@ alarmClockStop (BREventAlarmClock clock) {
         pthread_join(clock->thread, NULL);
         // A mini-race here?
         clock->thread = PTHREAD_NULL;
+        clock->timeout = (struct timespec) { .tv_sec = LONG_MAX, .tv_nsec = 0 };
     }
     pthread_mutex_unlock(&clock->lockOnStartStop);
 }
@@ -348,10 +596,76 @@ static void
 alarmClockAssertRecovery (BREventAlarmClock clock) {
     alarmClockStop(clock);
     pthread_mutex_lock(&clock->lockOnStartStop);
-    array_clear(clock->alarms);
+    alarmClockClearAlarms (clock);
     pthread_mutex_unlock(&clock->lockOnStartStop);
 }
 
+/// MARK: - Wakeup Descriptor
+
+extern int
+alarmClockGetWakeupDescriptor (BREventAlarmClock clock) {
+    pthread_mutex_lock(&clock->lock);
+    if (-1 == clock->wakeup[0] && 0 == pipe (clock->wakeup)) {
+        fcntl (clock->wakeup[0], F_SETFL, fcntl (clock->wakeup[0], F_GETFL) | O_NONBLOCK);
+        fcntl (clock->wakeup[1], F_SETFL, fcntl (clock->wakeup[1], F_GETFL) | O_NONBLOCK);
+    }
+    int descriptor = clock->wakeup[0];
+    pthread_mutex_unlock(&clock->lock);
+    return descriptor;
+}
+
+extern int
+alarmClockNextExpiration (BREventAlarmClock clock,
+                          struct timespec *expiration) {
+    uint64_t tick;
+
+    pthread_mutex_lock(&clock->lock);
+    int hasExpiration = alarmClockNextTick (clock, &tick);
+    if (hasExpiration) {
+        *expiration = alarmClockTimeForTick (clock, tick);
+        // Only an earlier expiration than this one will signal the wakeup descriptor
+        if (-1 == timespecCompare (expiration, &clock->timeout))
+            clock->timeout = *expiration;
+    }
+    pthread_mutex_unlock(&clock->lock);
+
+    return hasExpiration;
+}
+
+extern size_t
+alarmClockExpireAlarms (BREventAlarmClock clock) {
+    pthread_mutex_lock(&clock->lock);
+
+    // Drain any pending wakeups
+    if (-1 != clock->wakeup[0]) {
+        uint8_t bytes[16];
+        while (read (clock->wakeup[0], bytes, sizeof (bytes)) > 0)
+            ;
+    }
+
+    size_t count = alarmClockExpireAlarmsLocked (clock, getTime());
+
+    // Following expiration, the next timeout is 'forever in the future' until recomputed.
+    clock->timeout = (struct timespec) { .tv_sec = LONG_MAX, .tv_nsec = 0 };
+    alarmClockUpdateTimeout (clock);
+    pthread_mutex_unlock(&clock->lock);
+
+    return count;
+}
+
+/// MARK: - Alarms
+
+static BREventAlarmId
+alarmClockAddAlarmInternal (BREventAlarmClock clock,
+                            BREventAlarm *alarm) {
+    BRSetAdd (clock->alarms, alarm);
+    alarmClockInsertAlarm (clock, alarm);
+
+    // Having modified the wheel we may have an earlier 'next expiration'
+    alarmClockUpdateTimeout (clock);
+    return alarm->identifier;
+}
+
 extern BREventAlarmId
 alarmClockAddAlarmPeriodic (BREventAlarmClock clock,
                             BREventAlarmContext context,
@@ -359,9 +673,7 @@ alarmClockAddAlarmPeriodic (BREventAlarmClock clock,
                             struct timespec period) {
     pthread_mutex_lock(&clock->lock);
     BREventAlarmId identifier = ++clock->identifier;
-    alarmClockInsertAlarm(clock, alarmCreatePeriodic(context, callback, getTime(), period, identifier));
-    // Having modified `alarms` we need to compute a new 'next expiration'
-    pthread_cond_signal(&clock->cond);
+    alarmClockAddAlarmInternal (clock, alarmCreatePeriodic(context, callback, getTime(), period, identifier));
     pthread_mutex_unlock(&clock->lock);
     return identifier;
 }
@@ -373,9 +685,7 @@ alarmClockAddAlarm (BREventAlarmClock clock,
                     struct timespec expiration) {
     pthread_mutex_lock(&clock->lock);
     BREventAlarmId identifier = ++clock->identifier;
-    alarmClockInsertAlarm(clock, alarmCreate(context, callback, expiration, identifier));
-    // Having modified `alarms` we need to compute a new 'next expiration'
-    pthread_cond_signal(&clock->cond);
+    alarmClockAddAlarmInternal (clock, alarmCreate(context, callback, expiration, identifier));
     pthread_mutex_unlock(&clock->lock);
     return identifier;
 }
@@ -383,28 +693,25 @@ alarmClockAddAlarm (BREventAlarmClock clock,
 extern void
 alarmClockRemAlarm (BREventAlarmClock clock,
                     BREventAlarmId identifier) {
+    BREventAlarm key = { .identifier = identifier };
+
     pthread_mutex_lock(&clock->lock);
-    for (int index = 0; index < array_count (clock->alarms); index++)
-        if (identifier == clock->alarms[index].identifier) {
-            array_rm(clock->alarms, index);
-            break;
-        }
-    // Having modified `alarms` we need to compute a new 'next expiration'
-    pthread_cond_signal(&clock->cond);
+    BREventAlarm *alarm = BRSetRemove (clock->alarms, &key);
+    if (NULL != alarm) {
+        alarmClockUnlinkAlarm (clock, alarm);
+        free (alarm);
+    }
+    // A later 'next expiration' needs no wakeup; the clock will wake to an empty tick.
     pthread_mutex_unlock(&clock->lock);
 }
 
 extern int
 alarmClockHasAlarm (BREventAlarmClock clock,
                     BREventAlarmId identifier) {
-    int hasAlarm = 0;
+    BREventAlarm key = { .identifier = identifier };
 
     pthread_mutex_lock(&clock->lock);
-    for (int index = 0; index < array_count (clock->alarms); index++)
-        if (identifier == clock->alarms[index].identifier) {
-            hasAlarm = 1;
-            break;
-        }
+    int hasAlarm = BRSetContains (clock->alarms, &key);
     pthread_mutex_unlock(&clock->lock);
 
     return hasAlarm;
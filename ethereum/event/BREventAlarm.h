@@ -78,6 +78,43 @@ extern int
 alarmClockHasAlarm (BREventAlarmClock clock,
                     BREventAlarmId identifier);
 
+/**
+ * Return a file descriptor that becomes readable whenever `clock`'s next expiration moves
+ * earlier.  This allows `clock` to be driven from an external `poll()`/`select()` loop, rather
+ * than from its own thread, by waiting on the descriptor until `alarmClockNextExpiration()` and
+ * then calling `alarmClockExpireAlarms()`.
+ *
+ * @param clock the clock
+ *
+ * @return the descriptor, owned by `clock`; or -1 if one could not be created.
+ */
+extern int
+alarmClockGetWakeupDescriptor (BREventAlarmClock clock);
+
+/**
+ * Get the time at which `clock` next needs to process its alarms.  Alarms expiring close together
+ * are coalesced into one expiration.
+ *
+ * @param clock the clock
+ * @param expiration filled with the next expiration, if any
+ *
+ * @return true (1) if `clock` has an expiration; false (0) if it has no alarms.
+ */
+extern int
+alarmClockNextExpiration (BREventAlarmClock clock,
+                          struct timespec *expiration);
+
+/**
+ * Expire, on the calling thread, every alarm in `clock` that is due and drain the wakeup
+ * descriptor.
+ *
+ * @param clock the clock
+ *
+ * @return the number of alarms expired.
+ */
+extern size_t
+alarmClockExpireAlarms (BREventAlarmClock clock);
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,39 +9,115 @@
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 //
 
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
+#include <assert.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include "support/BRStats.h"
+#include "support/BRSet.h"
 #include "BREventQueue.h"
 
-#define EVENT_QUEUE_DEFAULT_INITIAL_CAPACITY   (1)
+/// Cells are allocated in slabs of EVENT_QUEUE_SLAB_CELLS; once EVENT_QUEUE_SLABS_MAXIMUM slabs
+/// exist, cells are allocated individually and freed once dequeued.
+#define EVENT_QUEUE_SLAB_CELLS          (32)
+#define EVENT_QUEUE_SLABS_MAXIMUM       (256)
 
+#define EVENT_QUEUE_CELL_INDEX_NONE     (UINT32_MAX)
+
+/**
+ * An EventQueueCell holds one event.  Cells link through `next` when pending and through
+ * `nextAvailable`, as an index, when available.
+ */
+typedef struct BREventQueueCellRecord {
+    struct BREventQueueCellRecord *next;
+
+    /// The index + 1 of next available cell, or 0 if none.
+    _Atomic uint32_t nextAvailable;
+
+    /// The index of this cell in the queue's slabs or EVENT_QUEUE_CELL_INDEX_NONE
+    uint32_t index;
+
+    /// The BRStatsMicroseconds() when the event was enqueued
+    uint64_t time;
+
+    /// If the event coalesces, its type and key; otherwise NULL and 0.
+    const BREventType *coalesceType;
+    uintptr_t coalesceKey;
+
+    /// The event storage - of the queue's `size`
+    _Alignas(max_align_t) uint8_t event[];
+} BREventQueueCell;
+
+/**
+ * An EventQueue is a multi-producer, single-consumer queue.  Producers, enqueuing at the tail or
+ * at the head (out-of-band), push cells onto one of two lock-free stacks; the consumer takes
+ * each stack whole and moves it onto its own `pending` list - reversed for the tail stack, so as
+ * to be FIFO, and as is for the head stack, so that the latest head event is first.  Producers
+ * never take a lock, except for coalescing events; the lock guards `pending`, from a concurrent
+ * clear, and `coalescing`.
+ */
 struct BREventQueueRecord {
-    // A linked-list (through event->next) of pending events.
-    BREvent *pending;
+    // The lock-free stacks of cells enqueued at the tail and at the head
+    _Atomic(BREventQueueCell *) incoming;
+    _Atomic(BREventQueueCell *) incomingHead;
 
-    // A linked-list (through event->next) of available events
-    BREvent *available;
+    // The available cells - as a lock-free stack of ((tag << 32) | (index + 1))
+    _Atomic uint64_t available;
 
-    // If not provided with a lock, use this one.
+    // The slabs of cells
+    _Atomic(uint8_t *) slabs[EVENT_QUEUE_SLABS_MAXIMUM];
+    _Atomic size_t slabsCount;
+
+    // A linked-list of pending cells, in dequeue order, owned by the consumer.
+    BREventQueueCell *pending;
+    BREventQueueCell *pendingLast;
+
+    // The cells of the pending coalescing events, whether in `pending` or still on the stacks.
+    BRSetOf(BREventQueueCell*) coalescing;
+
+    // Guards `pending` and `coalescing`
     pthread_mutex_t lock;
 
-    // The size of each event
+    // The size of each event and the size of each cell.
     size_t size;
+    size_t cellSize;
 };
 
+static size_t
+eventQueueCellCoalesceHash (const void *cell) {
+    const BREventQueueCell *this = cell;
+    return (size_t) (((uintptr_t) this->coalesceType >> 4) * 31 + this->coalesceKey);
+}
+
+static int
+eventQueueCellCoalesceEqual (const void *cell1, const void *cell2) {
+    const BREventQueueCell *this1 = cell1, *this2 = cell2;
+    return (this1->coalesceType == this2->coalesceType &&
+            this1->coalesceKey  == this2->coalesceKey);
+}
+
 extern BREventQueue
 eventQueueCreate (size_t size) {
     BREventQueue queue = calloc (1, sizeof (struct BREventQueueRecord));
 
+    atomic_init (&queue->incoming, NULL);
+    atomic_init (&queue->incomingHead, NULL);
+    atomic_init (&queue->available, 0);
+    atomic_init (&queue->slabsCount, 0);
+    for (size_t index = 0; index < EVENT_QUEUE_SLABS_MAXIMUM; index++)
+        atomic_init (&queue->slabs[index], NULL);
+
     queue->pending = NULL;
-    queue->available = NULL;
+    queue->pendingLast = NULL;
+    queue->coalescing = BRSetNew (eventQueueCellCoalesceHash, eventQueueCellCoalesceEqual, 8);
     queue->size = size;
 
-    for (int i = 0; i < EVENT_QUEUE_DEFAULT_INITIAL_CAPACITY; i++) {
-        BREvent *event = calloc (1, queue->size);
-        event->next = queue->available;
-        queue->available = event;
-    }
+    // Round each cell up to preserve the alignment of the cell that follows it in a slab.
+    queue->cellSize = sizeof (BREventQueueCell) + size;
+    queue->cellSize = (queue->cellSize + _Alignof (max_align_t) - 1) & ~(_Alignof (max_align_t) - 1);
 
     {
         pthread_mutexattr_t attr;
@@ -54,136 +130,333 @@ eventQueueCreate (size_t size) {
     return queue;
 }
 
+/// MARK: - Cells
+
+static BREventQueueCell *
+eventQueueCellAt (BREventQueue queue,
+                  uint32_t index) {
+    uint8_t *slab = atomic_load (&queue->slabs[index / EVENT_QUEUE_SLAB_CELLS]);
+    return (BREventQueueCell *) &slab[(index % EVENT_QUEUE_SLAB_CELLS) * queue->cellSize];
+}
+
+// Push the `first` through `last` cells, linked by `nextAvailable`, as available.
 static void
-eventFreeAll (BREvent *event,
-              int destroy) {
-    while (NULL != event) {
-        // Save the next event so that the upcoming `free` doesn't zero it out.
-        BREvent *next = event->next;
+eventQueuePushAvailable (BREventQueue queue,
+                         BREventQueueCell *first,
+                         BREventQueueCell *last) {
+    uint64_t head = atomic_load (&queue->available);
+    uint64_t update;
 
-        // Apply the `destroyer` if appropriate.
-        if (destroy) {
-            BREventDestroyer destroyer = event->type->eventDestroyer;
-            if (NULL != destroyer) destroyer (event);
-        }
-        // Actual free and then iterate.
-        free (event);
-        event = next;
+    do {
+        atomic_store (&last->nextAvailable, (uint32_t) head);
+        update = (((head >> 32) + 1) << 32) | (first->index + 1);
+    } while (!atomic_compare_exchange_weak (&queue->available, &head, update));
+}
+
+// Pop an available cell.  The tag in `available` avoids ABA; slab cells are never freed, so
+// reading a stale `nextAvailable` is safe - the exchange will fail.
+static BREventQueueCell *
+eventQueuePopAvailable (BREventQueue queue) {
+    uint64_t head = atomic_load (&queue->available);
+    uint64_t update;
+    BREventQueueCell *cell;
+
+    do {
+        uint32_t index = (uint32_t) head;
+        if (0 == index) return NULL;
+
+        cell = eventQueueCellAt (queue, index - 1);
+        update = (((head >> 32) + 1) << 32) | atomic_load (&cell->nextAvailable);
+    } while (!atomic_compare_exchange_weak (&queue->available, &head, update));
+
+    return cell;
+}
+
+static BREventQueueCell *
+eventQueueAllocCell (BREventQueue queue) {
+    BREventQueueCell *cell = eventQueuePopAvailable (queue);
+    if (NULL != cell) return cell;
+
+    size_t slabIndex = atomic_fetch_add (&queue->slabsCount, 1);
+
+    // Out of slabs; allocate a single cell, freed when dequeued
+    if (slabIndex >= EVENT_QUEUE_SLABS_MAXIMUM) {
+        cell = calloc (1, queue->cellSize);
+        cell->index = EVENT_QUEUE_CELL_INDEX_NONE;
+        return cell;
+    }
+
+    // Allocate a slab, keep the first cell and make all the others available.
+    uint8_t *slab = calloc (EVENT_QUEUE_SLAB_CELLS, queue->cellSize);
+    for (uint32_t index = 0; index < EVENT_QUEUE_SLAB_CELLS; index++) {
+        BREventQueueCell *this = (BREventQueueCell *) &slab[index * queue->cellSize];
+        this->index = (uint32_t) slabIndex * EVENT_QUEUE_SLAB_CELLS + index;
+        atomic_init (&this->nextAvailable, this->index + 2);
+    }
+    atomic_store (&queue->slabs[slabIndex], slab);
+
+    eventQueuePushAvailable (queue,
+                             (BREventQueueCell *) &slab[1 * queue->cellSize],
+                             (BREventQueueCell *) &slab[(EVENT_QUEUE_SLAB_CELLS - 1) * queue->cellSize]);
+
+    return (BREventQueueCell *) slab;
+}
+
+static void
+eventQueueReleaseCell (BREventQueue queue,
+                       BREventQueueCell *cell) {
+    if (EVENT_QUEUE_CELL_INDEX_NONE == cell->index)
+        free (cell);
+    else
+        eventQueuePushAvailable (queue, cell, cell);
+}
+
+/// MARK: - Pending
+
+// Move cells enqueued at the head onto the front of `pending`.  Requires `queue->lock`.
+static void
+eventQueueCollectHead (BREventQueue queue) {
+    BREventQueueCell *cells = atomic_exchange (&queue->incomingHead, NULL);
+    if (NULL == cells) return;
+
+    BREventQueueCell *last = cells;
+    while (NULL != last->next) last = last->next;
+
+    if (NULL == queue->pending) queue->pendingLast = last;
+    last->next = queue->pending;
+    queue->pending = cells;
+}
+
+// Move cells enqueued at the tail onto the end of `pending`.  Requires `queue->lock`.
+static void
+eventQueueCollectTail (BREventQueue queue) {
+    BREventQueueCell *cells = atomic_exchange (&queue->incoming, NULL);
+    if (NULL == cells) return;
+
+    // Reverse the stack into FIFO order; its top becomes the last cell
+    BREventQueueCell *first = NULL, *last = cells;
+    while (NULL != cells) {
+        BREventQueueCell *next = cells->next;
+        cells->next = first;
+        first = cells;
+        cells = next;
     }
+
+    if (NULL == queue->pending) queue->pending = first;
+    else queue->pendingLast->next = first;
+    queue->pendingLast = last;
 }
 
+// Remove and return the first pending cell, if any.  Requires `queue->lock`.
+static BREventQueueCell *
+eventQueueNextPending (BREventQueue queue) {
+    // Head events precede everything pending; check for them every time.
+    if (NULL != atomic_load (&queue->incomingHead)) eventQueueCollectHead (queue);
+
+    // Tail events follow everything pending; only collect them once `pending` is exhausted.
+    if (NULL == queue->pending) eventQueueCollectTail (queue);
+
+    BREventQueueCell *cell = queue->pending;
+    if (NULL != cell) {
+        queue->pending = cell->next;
+        if (NULL == queue->pending) queue->pendingLast = NULL;
+        cell->next = NULL;
+
+        // No longer pending; a later event of the same type and key is enqueued anew.
+        if (NULL != cell->coalesceType) BRSetRemove (queue->coalescing, cell);
+    }
+    return cell;
+}
+
+/// MARK: - Clear, Destroy
+
 extern void
 eventQueueClear (BREventQueue queue) {
-    pthread_mutex_lock(&queue->lock);
-
-    eventFreeAll(queue->pending, 1);
-    eventFreeAll(queue->available, 0);
+    BREventQueueCell *cell;
 
-    queue->pending = NULL;
-    queue->available = NULL;
+    pthread_mutex_lock(&queue->lock);
+    while (NULL != (cell = eventQueueNextPending (queue))) {
+        // Apply the `destroyer` if appropriate.
+        BREvent *event = (BREvent *) cell->event;
+        BREventDestroyer destroyer = event->type->eventDestroyer;
+        if (NULL != destroyer) destroyer (event);
 
+        eventQueueReleaseCell (queue, cell);
+    }
     pthread_mutex_unlock(&queue->lock);
 }
 
 extern void
 eventQueueDestroy (BREventQueue queue) {
-    // Clear the pending and available queues.
+    // Clear the pending events.
     eventQueueClear (queue);
 
+    size_t slabsCount = atomic_load (&queue->slabsCount);
+    if (slabsCount > EVENT_QUEUE_SLABS_MAXIMUM) slabsCount = EVENT_QUEUE_SLABS_MAXIMUM;
+    for (size_t index = 0; index < slabsCount; index++)
+        free (atomic_load (&queue->slabs[index]));
+
+    BRSetFree (queue->coalescing);
     pthread_mutex_destroy(&queue->lock);
 
     memset (queue, 0, sizeof (struct BREventQueueRecord));
     free (queue);
 }
 
+/// MARK: - Enqueue, Dequeue
+
+// Push `cell` onto the tail or head stack
 static void
-eventQueueEnqueue (BREventQueue queue,
-                   const BREvent *event,
-                   int tail) {
+eventQueuePushCell (BREventQueue queue,
+                    BREventQueueCell *cell,
+                    int tail) {
+    _Atomic(BREventQueueCell *) *stack = (tail ? &queue->incoming : &queue->incomingHead);
+    BREventQueueCell *top = atomic_load (stack);
+    do {
+        cell->next = top;
+    } while (!atomic_compare_exchange_weak (stack, &top, cell));
+}
+
+// Enqueue a coalescing `event`, replacing a pending one of the same type and key, if it exists.
+// A replaced event keeps its `time`, so its latency counts from the first of the events.
+static int
+eventQueueEnqueueCoalescing (BREventQueue queue,
+                             const BREvent *event,
+                             int tail) {
+    BREventQueueCell probe;
+    probe.coalesceType = event->type;
+    probe.coalesceKey  = event->type->eventCoalescer (event);
+
+    int enqueued = 1;
+
+    // Hold the lock so that the consumer can't take a found cell, nor a producer add a cell for
+    // the same key, until done.
     pthread_mutex_lock(&queue->lock);
+    BREventQueueCell *cell = BRSetGet (queue->coalescing, &probe);
 
-    // Get the next available event
-    BREvent *this = queue->available;
-    if (NULL == this) {
-        this = (BREvent*) calloc (1, queue->size);
-        this->next = NULL;
-    }
-    // Make the next event no longer available.
-    queue->available = this->next;
-
-    // Fill in `this` with event
-    memcpy (this, event, event->type->eventSize);
-    this->next = NULL;
-
-    // Nothing pending, simply add.
-    if (NULL == queue->pending)
-        queue->pending = this;
-    else if (tail) {
-        // Find the last event
-        BREvent *last = queue->pending;
-        while (NULL != last->next) last = last->next;
-        last->next = this;
-    }
-    else /* (head) */ {
-        this->next = queue->pending;
-        queue->pending = this;
+    if (NULL != cell) {
+        BREventDestroyer destroyer = event->type->eventDestroyer;
+        if (NULL != destroyer) destroyer ((BREvent *) cell->event);
+
+        memcpy (cell->event, event, event->type->eventSize);
+        ((BREvent *) cell->event)->next = NULL;
+        enqueued = 0;
     }
+    else {
+        cell = eventQueueAllocCell (queue);
+
+        memcpy (cell->event, event, event->type->eventSize);
+        ((BREvent *) cell->event)->next = NULL;
+        cell->time = BRStatsMicroseconds();
+        cell->coalesceType = probe.coalesceType;
+        cell->coalesceKey  = probe.coalesceKey;
 
+        BRSetAdd (queue->coalescing, cell);
+        eventQueuePushCell (queue, cell, tail);
+    }
     pthread_mutex_unlock(&queue->lock);
+
+    return enqueued;
 }
 
-extern void
+static int
+eventQueueEnqueue (BREventQueue queue,
+                   const BREvent *event,
+                   int tail) {
+    assert (event->type->eventSize <= queue->size);
+
+    if (NULL != event->type->eventCoalescer)
+        return eventQueueEnqueueCoalescing (queue, event, tail);
+
+    BREventQueueCell *cell = eventQueueAllocCell (queue);
+
+    // Fill in `cell` with event
+    memcpy (cell->event, event, event->type->eventSize);
+    ((BREvent *) cell->event)->next = NULL;
+    cell->time = BRStatsMicroseconds();
+    cell->coalesceType = NULL;
+    cell->coalesceKey  = 0;
+
+    eventQueuePushCell (queue, cell, tail);
+    return 1;
+}
+
+extern int
 eventQueueEnqueueTail (BREventQueue queue,
                        const BREvent *event) {
-    eventQueueEnqueue (queue, event, 1);
+    return eventQueueEnqueue (queue, event, 1);
 }
 
-extern void
+extern int
 eventQueueEnqueueHead (BREventQueue queue,
                        const BREvent *event) {
-    eventQueueEnqueue (queue, event, 0);
+    return eventQueueEnqueue (queue, event, 0);
 }
 
 extern BREventStatus
 eventQueueDequeue (BREventQueue queue,
                    BREvent *event) {
-    BREventStatus status = EVENT_STATUS_SUCCESS;
-    
     if (NULL == event)
         return EVENT_STATUS_NULL_EVENT;
-    
+
+    return (1 == eventQueueDequeueMany (queue, event, 1)
+            ? EVENT_STATUS_SUCCESS
+            : EVENT_STATUS_NONE_PENDING);
+}
+
+extern size_t
+eventQueueDequeueMany (BREventQueue queue,
+                       BREvent *events,
+                       size_t eventsCount) {
+    return eventQueueDequeueManyWithTimes (queue, events, NULL, eventsCount);
+}
+
+extern size_t
+eventQueueDequeueManyWithTimes (BREventQueue queue,
+                                BREvent *events,
+                                uint64_t *times,
+                                size_t eventsCount) {
+    BREventQueueCell *cell;
+    size_t count = 0;
+
     pthread_mutex_lock(&queue->lock);
-    
-    // Get the next pending event
-    BREvent *this = queue->pending;
-    
-    // there is none, just return
-    if (NULL == this)
-        status = EVENT_STATUS_NONE_PENDING;
-    
-    // otherwise process it.
-    else {
-        // Remove `this` from the pending list.
-        queue->pending = this->next;
-        
-        // Fill in the provided event;
-        this->next = NULL;
-        memcpy (event, this, queue->size);
-        
-        // Return `this` to the available list.
-        this->next = queue->available;
-        queue->available = this;
+    while (count < eventsCount && NULL != (cell = eventQueueNextPending (queue))) {
+        // Fill in the provided event; only its type's size is meaningful.
+        const BREvent *this = (const BREvent *) cell->event;
+        memcpy ((uint8_t *) events + count * queue->size, this, this->type->eventSize);
+        if (NULL != times) times[count] = cell->time;
+        count++;
+
+        eventQueueReleaseCell (queue, cell);
     }
     pthread_mutex_unlock(&queue->lock);
-    
-    return status;
+
+    return count;
 }
 
 extern int
 eventQueueHasPending (BREventQueue queue) {
     int pending = 0;
     pthread_mutex_lock(&queue->lock);
-    pending = NULL != queue->pending;
+    pending = (NULL != queue->pending ||
+               NULL != atomic_load (&queue->incoming) ||
+               NULL != atomic_load (&queue->incomingHead));
     pthread_mutex_unlock(&queue->lock);
     return pending;
 }
+
+extern size_t
+eventQueueGetMemoryUsage (BREventQueue queue) {
+    size_t slabsCount = atomic_load (&queue->slabsCount);
+    if (slabsCount > EVENT_QUEUE_SLABS_MAXIMUM) slabsCount = EVENT_QUEUE_SLABS_MAXIMUM;
+
+    // Slabs are never freed until the queue is destroyed; single cells, allocated once out of
+    // slabs, are only held until dequeued and are not counted.
+    size_t usage = (sizeof (struct BREventQueueRecord) +
+                    slabsCount * EVENT_QUEUE_SLAB_CELLS * queue->cellSize);
+
+    pthread_mutex_lock(&queue->lock);
+    usage += BRSetMemoryUsage (queue->coalescing);
+    pthread_mutex_unlock(&queue->lock);
+    return usage;
+}
@@ -12,6 +12,7 @@
 #ifndef BR_Event_Queue_H
 #define BR_Event_Queue_H
 
+#include <stdint.h>
 #include "BREvent.h"
 
 #ifdef __cplusplus
@@ -30,10 +31,16 @@ eventQueueCreate (size_t size);
 extern void
 eventQueueDestroy (BREventQueue queue);
 
-extern void
+/**
+ * Enqueue `event` at the tail or at the head.  If the event's type has an `eventCoalescer` and
+ * an event of the same type and key is pending, that event is replaced, in its place, by `event`.
+ *
+ * @return 1 if `event` was enqueued; 0 if it replaced a pending event.
+ */
+extern int
 eventQueueEnqueueTail (BREventQueue queue,
                        const BREvent *event);
-extern void
+extern int
 eventQueueEnqueueHead (BREventQueue queue,
                        const BREvent *event);
 
@@ -41,9 +48,36 @@ extern BREventStatus
 eventQueueDequeue (BREventQueue queue,
                    BREvent *event);
 
+/**
+ * Dequeue up to `eventsCount` events into `events`, an array of events each of the queue's
+ * `size`, in a single pass.
+ *
+ * @return the number of events dequeued.
+ */
+extern size_t
+eventQueueDequeueMany (BREventQueue queue,
+                       BREvent *events,
+                       size_t eventsCount);
+
+/**
+ * As eventQueueDequeueMany() but also, if `times` is not NULL, fill `times` with the
+ * BRStatsMicroseconds() at which each dequeued event was enqueued.
+ */
+extern size_t
+eventQueueDequeueManyWithTimes (BREventQueue queue,
+                                BREvent *events,
+                                uint64_t *times,
+                                size_t eventsCount);
+
 extern int
 eventQueueHasPending (BREventQueue queue);
 
+/**
+ * Return the bytes held by `queue`, including its slabs of cells and its coalescing set.
+ */
+extern size_t
+eventQueueGetMemoryUsage (BREventQueue queue);
+
 extern void
 eventQueueClear (BREventQueue queue);
 
@@ -9,8 +9,10 @@
 #include <stdio.h>
 #include <assert.h>
 #include <pthread.h>
+#include <unistd.h>
 #include "BREvent.h"
 #include "BREventAlarm.h"
+#include "BREventQueue.h"
 
 static pthread_cond_t testEventAlarmConditional = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t testEventAlarmMutex = PTHREAD_MUTEX_INITIALIZER;
@@ -47,7 +49,259 @@ runEventTest (void) {
     alarmClockDestroy(alarmClock);
 }
 
+typedef struct {
+    BREvent base;
+    int value;
+} BREventTestQueue;
+
+static BREventType testEventQueueType = { "Test Queue Event", sizeof (BREventTestQueue), NULL, NULL };
+
+static void
+runEventQueueTest (void) {
+    BREventQueue queue = eventQueueCreate (sizeof (BREventTestQueue));
+    BREventTestQueue events[4];
+
+    // Tail events are FIFO; head (OOB) events precede them, latest first.
+    for (int value = 1; value <= 4; value++) {
+        BREventTestQueue event = { { NULL, &testEventQueueType }, value };
+        if (value <= 2) eventQueueEnqueueTail (queue, (BREvent*) &event);
+        else eventQueueEnqueueHead (queue, (BREvent*) &event);
+    }
+    assert (eventQueueHasPending (queue));
+
+    assert (1 == eventQueueDequeueMany (queue, (BREvent*) events, 1));
+    assert (4 == events[0].value);
+    assert (3 == eventQueueDequeueMany (queue, (BREvent*) events, 4));
+    assert (3 == events[0].value && 1 == events[1].value && 2 == events[2].value);
+
+    assert (EVENT_STATUS_NONE_PENDING == eventQueueDequeue (queue, (BREvent*) events));
+    assert (!eventQueueHasPending (queue));
+    eventQueueDestroy (queue);
+}
+
+// Coalesce by the parity of `value`
+static uintptr_t
+testEventCoalescer (BREventTestQueue *event) {
+    return event->value % 2;
+}
+
+static BREventType testEventCoalesceType = {
+    "Test Coalesce Event",
+    sizeof (BREventTestQueue),
+    NULL,
+    NULL,
+    EVENT_PRIORITY_NORMAL,
+    (BREventCoalescer) testEventCoalescer
+};
+
+static void
+runEventQueueCoalesceTest (void) {
+    BREventQueue queue = eventQueueCreate (sizeof (BREventTestQueue));
+    BREventTestQueue events[4];
+
+    // The newest event of a key replaces the pending one, in its place.
+    for (int value = 1; value <= 4; value++) {
+        BREventTestQueue event = { { NULL, &testEventCoalesceType }, value };
+        assert ((value <= 2) == eventQueueEnqueueTail (queue, (BREvent*) &event));
+    }
+    assert (2 == eventQueueDequeueMany (queue, (BREvent*) events, 4));
+    assert (3 == events[0].value && 4 == events[1].value);
+
+    // Once dequeued, an event of the same key is enqueued anew.
+    BREventTestQueue event = { { NULL, &testEventCoalesceType }, 5 };
+    assert (1 == eventQueueEnqueueTail (queue, (BREvent*) &event));
+    assert (EVENT_STATUS_SUCCESS == eventQueueDequeue (queue, (BREvent*) events));
+    assert (5 == events[0].value);
+
+    eventQueueDestroy (queue);
+}
+
+#define TEST_EVENT_EXECUTOR_HANDLERS     (3)
+#define TEST_EVENT_EXECUTOR_EVENTS       (100)
+
+static int testEventExecutorValues[TEST_EVENT_EXECUTOR_HANDLERS];
+static int testEventExecutorCount = 0;
+
+static void
+testEventExecutorDispatcher (BREventHandler handler,
+                             BREventTestQueue *event) {
+    pthread_mutex_lock(&testEventAlarmMutex);
+    // Each handler's events are dispatched in order: `value` is `handler index + 1 + sequence * HANDLERS`
+    int index = (event->value - 1) % TEST_EVENT_EXECUTOR_HANDLERS;
+    assert (event->value > testEventExecutorValues[index]);
+    testEventExecutorValues[index] = event->value;
+    if (TEST_EVENT_EXECUTOR_HANDLERS * TEST_EVENT_EXECUTOR_EVENTS == ++testEventExecutorCount)
+        pthread_cond_signal(&testEventAlarmConditional);
+    pthread_mutex_unlock(&testEventAlarmMutex);
+}
+
+static BREventType testEventExecutorType = {
+    "Test Executor Event",
+    sizeof (BREventTestQueue),
+    (BREventDispatcher) testEventExecutorDispatcher,
+    NULL
+};
+
+static const BREventType *testEventExecutorTypes[] = { &testEventExecutorType };
+
+static void
+runEventExecutorTest (void) {
+    BREventExecutor executor = eventExecutorCreate ("Test Executor", 2);
+    BREventHandler handlers[TEST_EVENT_EXECUTOR_HANDLERS];
+
+    for (int index = 0; index < TEST_EVENT_EXECUTOR_HANDLERS; index++) {
+        handlers[index] = eventHandlerCreate ("Test Handler", testEventExecutorTypes, 1, NULL);
+        eventHandlerSetExecutor (handlers[index], executor);
+        eventHandlerStart (handlers[index]);
+        assert (eventHandlerIsRunning (handlers[index]));
+    }
+
+    pthread_mutex_lock(&testEventAlarmMutex);
+    for (int sequence = 0; sequence < TEST_EVENT_EXECUTOR_EVENTS; sequence++)
+        for (int index = 0; index < TEST_EVENT_EXECUTOR_HANDLERS; index++) {
+            BREventTestQueue event = {
+                { NULL, &testEventExecutorType },
+                index + 1 + sequence * TEST_EVENT_EXECUTOR_HANDLERS };
+            eventHandlerSignalEvent (handlers[index], (BREvent*) &event);
+        }
+    while (testEventExecutorCount < TEST_EVENT_EXECUTOR_HANDLERS * TEST_EVENT_EXECUTOR_EVENTS)
+        pthread_cond_wait(&testEventAlarmConditional, &testEventAlarmMutex);
+    pthread_mutex_unlock(&testEventAlarmMutex);
+
+    for (int index = 0; index < TEST_EVENT_EXECUTOR_HANDLERS; index++) {
+        eventHandlerStop (handlers[index]);
+        assert (!eventHandlerIsRunning (handlers[index]));
+        eventHandlerDestroy (handlers[index]);
+    }
+    eventExecutorDestroy (executor);
+}
+
+static int testEventStopCount = 0;
+
+// Stop the handler from its own dispatch thread; this must not wait on itself.
+static void
+testEventStopDispatcher (BREventHandler handler,
+                         BREventTestQueue *event) {
+    eventHandlerStop (handler);
+    assert (!eventHandlerIsRunning (handler));
+
+    pthread_mutex_lock(&testEventAlarmMutex);
+    testEventStopCount++;
+    pthread_cond_signal(&testEventAlarmConditional);
+    pthread_mutex_unlock(&testEventAlarmMutex);
+}
+
+static BREventType testEventStopType = {
+    "Test Stop Event",
+    sizeof (BREventTestQueue),
+    (BREventDispatcher) testEventStopDispatcher,
+    NULL
+};
+
+static const BREventType *testEventStopTypes[] = { &testEventStopType };
+
+static void
+runEventStopOnDispatchTest (void) {
+    BREventExecutor executor = eventExecutorCreate ("Test Stop Executor", 1);
+
+    // Once with the handler's own thread, once on the executor.
+    for (int run = 0; run < 2; run++) {
+        BREventHandler handler = eventHandlerCreate ("Test Stop Handler",
+                                                     testEventStopTypes, 1, NULL);
+        eventHandlerSetExecutor (handler, (0 == run ? NULL : executor));
+
+        pthread_mutex_lock(&testEventAlarmMutex);
+        eventHandlerStart (handler);
+        BREventTestQueue event = { { NULL, &testEventStopType }, run };
+        eventHandlerSignalEvent (handler, (BREvent*) &event);
+        while (testEventStopCount <= run)
+            pthread_cond_wait(&testEventAlarmConditional, &testEventAlarmMutex);
+        pthread_mutex_unlock(&testEventAlarmMutex);
+
+        // Already stopped; stopping again returns at once.
+        assert (!eventHandlerIsRunning (handler));
+        eventHandlerStop (handler);
+
+        // Let the dispatching thread finish with `handler` before it is destroyed.
+        if (0 != run) eventExecutorDestroy (executor);
+        else sleep (1);
+        eventHandlerDestroy (handler);
+    }
+}
+
+#define TEST_EVENT_PRIORITY_EVENTS       (20)
+
+static int testEventPriorityValues[EVENT_PRIORITY_COUNT * TEST_EVENT_PRIORITY_EVENTS];
+static int testEventPriorityCount = 0;
+
+static void
+testEventPriorityDispatcher (BREventHandler handler,
+                             BREventTestQueue *event) {
+    pthread_mutex_lock(&testEventAlarmMutex);
+    testEventPriorityValues[testEventPriorityCount] = event->value;
+    if (EVENT_PRIORITY_COUNT * TEST_EVENT_PRIORITY_EVENTS == ++testEventPriorityCount)
+        pthread_cond_signal(&testEventAlarmConditional);
+    pthread_mutex_unlock(&testEventAlarmMutex);
+}
+
+// The event `value` is `priority * 100 + sequence`
+static BREventType testEventPriorityTypes[EVENT_PRIORITY_COUNT] = {
+    { "Test Normal Event", sizeof (BREventTestQueue),
+      (BREventDispatcher) testEventPriorityDispatcher, NULL, EVENT_PRIORITY_NORMAL },
+    { "Test High Event", sizeof (BREventTestQueue),
+      (BREventDispatcher) testEventPriorityDispatcher, NULL, EVENT_PRIORITY_HIGH },
+    { "Test Low Event", sizeof (BREventTestQueue),
+      (BREventDispatcher) testEventPriorityDispatcher, NULL, EVENT_PRIORITY_LOW }
+};
+
+static const BREventType *testEventPriorityTypesList[] = {
+    &testEventPriorityTypes[0], &testEventPriorityTypes[1], &testEventPriorityTypes[2]
+};
+
+static void
+runEventPriorityTest (void) {
+    BREventHandler handler = eventHandlerCreate ("Test Priority Handler", testEventPriorityTypesList,
+                                                 EVENT_PRIORITY_COUNT, NULL);
+    eventHandlerSetExecutor (handler, NULL);
+
+    // Queue the low events first, then the normal and high ones, all before starting.
+    for (int priority = EVENT_PRIORITY_COUNT - 1; priority >= 0; priority--)
+        for (int sequence = 0; sequence < TEST_EVENT_PRIORITY_EVENTS; sequence++) {
+            BREventTestQueue event = { { NULL, &testEventPriorityTypes[priority] }, priority * 100 + sequence };
+            eventHandlerSignalEvent (handler, (BREvent*) &event);
+        }
+
+    pthread_mutex_lock(&testEventAlarmMutex);
+    eventHandlerStart (handler);
+    while (testEventPriorityCount < EVENT_PRIORITY_COUNT * TEST_EVENT_PRIORITY_EVENTS)
+        pthread_cond_wait(&testEventAlarmConditional, &testEventAlarmMutex);
+    pthread_mutex_unlock(&testEventAlarmMutex);
+
+    // The first batch is weighted: 4 high, 3 normal, then 1 low - despite the low being first queued.
+    assert (EVENT_PRIORITY_HIGH * 100 + 3 == testEventPriorityValues[3]);
+    assert (EVENT_PRIORITY_NORMAL * 100 + 2 == testEventPriorityValues[6]);
+    assert (EVENT_PRIORITY_LOW * 100 + 0 == testEventPriorityValues[7]);
+
+    // Each lane is dispatched in order
+    int sequences[EVENT_PRIORITY_COUNT] = { 0, 0, 0 };
+    for (int index = 0; index < EVENT_PRIORITY_COUNT * TEST_EVENT_PRIORITY_EVENTS; index++) {
+        int priority = testEventPriorityValues[index] / 100;
+        assert (sequences[priority]++ == testEventPriorityValues[index] % 100);
+    }
+
+    for (int priority = 0; priority < EVENT_PRIORITY_COUNT; priority++)
+        assert (TEST_EVENT_PRIORITY_EVENTS == eventHandlerGetLaneMetrics (handler, priority).dispatchedCount);
+
+    eventHandlerStop (handler);
+    eventHandlerDestroy (handler);
+}
+
 extern void
 runEventTests (void) {
+    runEventQueueTest();
+    runEventQueueCoalesceTest();
+    runEventExecutorTest();
+    runEventStopOnDispatchTest();
+    runEventPriorityTest();
     runEventTest();
 }
@@ -11,6 +11,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include "support/BRArray.h"
 #include "support/BRCrypto.h"
 #include "support/BRKey.h"
 #include "support/BRBIP32Sequence.h"
@@ -32,6 +34,9 @@
 
 #define PRIMARY_ADDRESS_BIP44_INDEX 0
 
+// The BIP-44 'change' chain, below m/44'/60'/0', holding every address.
+#define ADDRESSES_BIP44_CHAIN       0
+
 /* Forward Declarations */
 //static BREthereumEncodedAddress
 //accountCreateAddress (BREthereumAccount account, UInt512 seed, uint32_t index);
@@ -88,6 +93,13 @@ typedef struct BREthereumAddressDetailRecord {
      * The NEXT nonce value
      */
     uint64_t nonce;
+
+    /**
+     * Nonces, below `nonce`, that were assigned but then released without being submitted, in
+     * increasing order.  Until reassigned, each is a gap that stalls every later transaction.
+     */
+    uint64_t releasedNonces[ACCOUNT_RELEASED_NONCE_LIMIT];
+    size_t releasedNoncesCount;
 } BREthereumAddressDetail;
 
 static BRKey // 65 bytes
@@ -105,6 +117,7 @@ static void
 addressDetailFillKey(BREthereumAddressDetail *address, const BRKey *key, uint32_t index) {
     
     address->nonce = 0;
+    address->releasedNoncesCount = 0;
     address->index = index;
     
     // Seriously???
@@ -176,15 +189,47 @@ struct BREthereumAccountRecord {
      * The primary address for this account - aka address[0].
      */
     BREthereumAddressDetail primaryAddress;
+
+    /**
+     * The extended public key for N(m/44'/60'/0') from which the address at any BIP-44 index, as
+     * m/44'/60'/0'/0/index, is derived without the seed.  BR_MASTER_PUBKEY_NONE if the account
+     * was created with a public key, and thus has only the primary address.
+     */
+    BRMasterPubKey addressesPubKey;
+
+    /**
+     * The addresses derived so far, after the primary address, with their public key and
+     * checksummed string - `addresses[index - 1]` is at BIP-44 `index`.  Protected by `lock`.
+     */
+    BRArrayOf(BREthereumAddressDetail) addresses;
+
+    pthread_mutex_t lock;
 };
 
+static BREthereumAccount
+accountCreateEmpty (void) {
+    BREthereumAccount account = (BREthereumAccount) calloc (1, sizeof (struct BREthereumAccountRecord));
+
+    account->addressesPubKey = BR_MASTER_PUBKEY_NONE;
+    array_new (account->addresses, 10);
+    pthread_mutex_init (&account->lock, NULL);
+
+    return account;
+}
+
 extern BREthereumAccount
 createAccountWithBIP32Seed (UInt512 seed) {
-    BREthereumAccount account = (BREthereumAccount) calloc (1, sizeof (struct BREthereumAccountRecord));
+    BREthereumAccount account = accountCreateEmpty ();
     
     // Assign the key; create the primary address.
     account->masterPubKey = BRBIP32MasterPubKey(&seed, sizeof(seed));
     addressDetailFillSeed(&account->primaryAddress, seed, PRIMARY_ADDRESS_BIP44_INDEX);
+
+    // The other addresses are derived, as needed, from the public key of N(m/44'/60'/0').
+    account->addressesPubKey = BRBIP32MasterPubKeyPath (&seed, sizeof(seed), 3,
+                                                        44 | BIP32_HARD,          // purpose  : BIP-44
+                                                        60 | BIP32_HARD,          // coin_type: Ethereum
+                                                        0 | BIP32_HARD);          // account  : <n/a>
     
     return account;
     
@@ -192,7 +237,7 @@ createAccountWithBIP32Seed (UInt512 seed) {
 
 extern BREthereumAccount
 createAccountWithPublicKey (const BRKey key) { // 65 bytes, 0x04-prefixed, uncompressed public key
-    BREthereumAccount account = (BREthereumAccount) calloc (1, sizeof (struct BREthereumAccountRecord));
+    BREthereumAccount account = accountCreateEmpty ();
     
     // Assign the key; create the primary address.
     account->masterPubKey = BR_MASTER_PUBKEY_NONE;
@@ -238,6 +283,8 @@ createAccount(const char *paperKey) {
 
 extern void
 accountFree (BREthereumAccount account) {
+    array_free (account->addresses);
+    pthread_mutex_destroy (&account->lock);
     free (account);
 }
 
@@ -294,6 +341,106 @@ accountHasAddress(BREthereumAccount account,
     return addressEqual(account->primaryAddress.raw, address);
 }
 
+/// MARK: - Derived Addresses
+
+static int
+accountCanDeriveAddresses (BREthereumAccount account) {
+    return 0 != memcmp (&account->addressesPubKey, &BR_MASTER_PUBKEY_NONE, sizeof (BRMasterPubKey));
+}
+
+/**
+ * Derive, as a batch, the addresses up to, but not including, BIP-44 index `limit` that are not
+ * yet derived.  Fewer are derived if `limit` runs into the hardened indices.  The lock is held.
+ */
+static void
+accountDeriveAddressesLocked (BREthereumAccount account, uint32_t limit) {
+    uint32_t start = 1 + (uint32_t) array_count (account->addresses);
+    if (limit <= start || !accountCanDeriveAddresses (account)) return;
+
+    size_t count = limit - start;
+    BRECPoint *pubKeys = calloc (count, sizeof (BRECPoint));
+    count = BRBIP32PubKeyRange (pubKeys, count, account->addressesPubKey, ADDRESSES_BIP44_CHAIN, start);
+
+    for (size_t index = 0; index < count; index++) {
+        BRKey key;
+        BREthereumAddressDetail detail;
+
+        // Decompress; Ethereum derives the address from the 65 byte, uncompressed public key.
+        if (!BRKeySetPubKey (&key, pubKeys[index].p, sizeof (pubKeys[index].p))) break;
+        key.compressed = 0;
+        BRKeyPubKey (&key, NULL, 0);
+
+        addressDetailFillKey (&detail, &key, start + (uint32_t) index);
+        array_add (account->addresses, detail);
+    }
+
+    free (pubKeys);
+}
+
+/**
+ * Return the detail of the derived address at BIP-44 `index`, deriving it if needed, or NULL if
+ * it can't be derived.  The lock is held.
+ */
+static BREthereumAddressDetail *
+accountGetAddressDetailLocked (BREthereumAccount account, uint32_t index) {
+    if (PRIMARY_ADDRESS_BIP44_INDEX == index) return &account->primaryAddress;
+    if (index >= BIP32_HARD) return NULL;
+
+    accountDeriveAddressesLocked (account, index + 1);
+    return (index <= array_count (account->addresses)
+            ? &account->addresses[index - 1]
+            : NULL);
+}
+
+extern BREthereumAddress
+accountGetAddressAtIndex (BREthereumAccount account,
+                          uint32_t index) {
+    pthread_mutex_lock (&account->lock);
+    BREthereumAddressDetail *detail = accountGetAddressDetailLocked (account, index);
+    BREthereumAddress address = (NULL == detail ? EMPTY_ADDRESS_INIT : detail->raw);
+    pthread_mutex_unlock (&account->lock);
+
+    return address;
+}
+
+extern char *
+accountGetAddressStringAtIndex (BREthereumAccount account,
+                                uint32_t index) {
+    pthread_mutex_lock (&account->lock);
+    BREthereumAddressDetail *detail = accountGetAddressDetailLocked (account, index);
+    char *string = (NULL == detail ? NULL : strdup (detail->string));
+    pthread_mutex_unlock (&account->lock);
+
+    return string;
+}
+
+extern size_t
+accountGetAddresses (BREthereumAccount account,
+                     uint32_t start,
+                     size_t count,
+                     BREthereumAddress *addresses) {
+    size_t filled = 0;
+
+    pthread_mutex_lock (&account->lock);
+
+    // Derive the whole range in one batch, then fill in from the cache.
+    if (count > 0 && start < BIP32_HARD)
+        accountDeriveAddressesLocked (account, (uint32_t) (count < BIP32_HARD - start
+                                                           ? start + count
+                                                           : BIP32_HARD));
+
+    for (; filled < count; filled++) {
+        BREthereumAddressDetail *detail = ((uint64_t) start + filled < BIP32_HARD
+                                           ? accountGetAddressDetailLocked (account, start + (uint32_t) filled)
+                                           : NULL);
+        if (NULL == detail) break;
+        addresses[filled] = detail->raw;
+    }
+
+    pthread_mutex_unlock (&account->lock);
+    return filled;
+}
+
 extern BREthereumSignature
 accountSignBytesWithPrivateKey(BREthereumAccount account,
                                BREthereumAddress address,
@@ -356,8 +503,18 @@ derivePrivateKeyFromSeed (UInt512 seed, uint32_t index) {
 extern uint32_t
 accountGetAddressIndex (BREthereumAccount account,
                         BREthereumAddress address) {
-    // TODO: Lookup address, assert address
-    return account->primaryAddress.index;
+    uint32_t index = account->primaryAddress.index;
+
+    // Only the addresses already derived are found; otherwise, as the primary address.
+    pthread_mutex_lock (&account->lock);
+    for (size_t i = 0; i < array_count (account->addresses); i++)
+        if (ETHEREUM_BOOLEAN_IS_TRUE (addressEqual (account->addresses[i].raw, address))) {
+            index = account->addresses[i].index;
+            break;
+        }
+    pthread_mutex_unlock (&account->lock);
+
+    return index;
 }
 
 extern uint64_t
@@ -374,13 +531,65 @@ accountSetAddressNonce(BREthereumAccount account,
                        uint64_t nonce,
                        BREthereumBoolean force) {
     // TODO: Lookup address, assert address
-    if (ETHEREUM_BOOLEAN_IS_TRUE(force) || nonce > account->primaryAddress.nonce)
-        account->primaryAddress.nonce = nonce;
+    BREthereumAddressDetail *detail = &account->primaryAddress;
+
+    if (ETHEREUM_BOOLEAN_IS_TRUE(force) || nonce > detail->nonce)
+        detail->nonce = nonce;
+
+    // A forced nonce is authoritative; otherwise `nonce` is as observed (from the account state
+    // or the client), below which released nonces have since been used and are no longer gaps.
+    size_t keep = 0;
+    for (size_t index = 0; index < detail->releasedNoncesCount; index++)
+        if (detail->releasedNonces[index] < detail->nonce &&
+            (ETHEREUM_BOOLEAN_IS_TRUE(force) || detail->releasedNonces[index] >= nonce))
+            detail->releasedNonces[keep++] = detail->releasedNonces[index];
+    detail->releasedNoncesCount = keep;
 }
 
 private_extern uint64_t
 accountGetThenIncrementAddressNonce(BREthereumAccount account,
                                     BREthereumAddress address) {
     // TODO: Lookup address, assert address
-    return account->primaryAddress.nonce++;
+    BREthereumAddressDetail *detail = &account->primaryAddress;
+
+    // Fill the lowest gap first.
+    if (detail->releasedNoncesCount > 0) {
+        uint64_t nonce = detail->releasedNonces[0];
+        memmove (&detail->releasedNonces[0], &detail->releasedNonces[1],
+                 (--detail->releasedNoncesCount) * sizeof (uint64_t));
+        return nonce;
+    }
+
+    return detail->nonce++;
+}
+
+private_extern void
+accountReleaseAddressNonce (BREthereumAccount account,
+                            BREthereumAddress address,
+                            uint64_t nonce) {
+    // TODO: Lookup address, assert address
+    BREthereumAddressDetail *detail = &account->primaryAddress;
+    if (nonce >= detail->nonce) return;
+
+    // Releasing the last nonce assigned just backs up `nonce`, along with any released gaps
+    // now at the top.
+    if (nonce + 1 == detail->nonce) {
+        detail->nonce = nonce;
+        while (detail->releasedNoncesCount > 0 &&
+               detail->releasedNonces[detail->releasedNoncesCount - 1] + 1 == detail->nonce)
+            detail->nonce = detail->releasedNonces[--detail->releasedNoncesCount];
+        return;
+    }
+
+    // Otherwise, insert in order, unless already released or there is no room.  Without room, the
+    // gap remains until filled by a resubmission.
+    size_t index = 0;
+    while (index < detail->releasedNoncesCount && detail->releasedNonces[index] < nonce) index++;
+    if ((index < detail->releasedNoncesCount && detail->releasedNonces[index] == nonce) ||
+        ACCOUNT_RELEASED_NONCE_LIMIT == detail->releasedNoncesCount) return;
+
+    memmove (&detail->releasedNonces[index + 1], &detail->releasedNonces[index],
+             (detail->releasedNoncesCount - index) * sizeof (uint64_t));
+    detail->releasedNonces[index] = nonce;
+    detail->releasedNoncesCount++;
 }
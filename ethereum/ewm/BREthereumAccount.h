@@ -86,6 +86,37 @@ extern BREthereumBoolean
 accountHasAddress(BREthereumAccount account,
                   BREthereumAddress address);
 
+/**
+ * The account's address at BIP-44 `index` - as m/44'/60'/0'/0/index - with index 0 as the
+ * primary address.  Addresses are derived from the account's extended public key, without the
+ * paper key, and are cached, with their public key and checksummed string, per index.  An
+ * account created with a public key has only the primary address; otherwise, as for an index
+ * that can't be derived, the result is the empty address.
+ */
+extern BREthereumAddress
+accountGetAddressAtIndex (BREthereumAccount account,
+                          uint32_t index);
+
+/**
+ * The checksummed string of the address at BIP-44 `index`, as accountGetAddressAtIndex(), or
+ * NULL if it can't be derived.  You own the string and must free() it.
+ */
+extern char *
+accountGetAddressStringAtIndex (BREthereumAccount account,
+                                uint32_t index);
+
+/**
+ * Fill `addresses` with the addresses at the BIP-44 indices `start` through `start + count - 1`,
+ * as accountGetAddressAtIndex(), deriving those not yet cached as a single batch - as when scanning
+ * indices for BIP-44 discovery.  Returns the number filled, fewer than `count` if some can't be
+ * derived.
+ */
+extern size_t
+accountGetAddresses (BREthereumAccount account,
+                     uint32_t start,
+                     size_t count,
+                     BREthereumAddress *addresses);
+
 /**
  * Sign an arbitrary array of bytes with the account's private key using the signature algorithm
  * specified by `type`.
@@ -146,6 +177,18 @@ private_extern uint64_t
 accountGetThenIncrementAddressNonce(BREthereumAccount account,
                                     BREthereumAddress address);
 
+/**
+ * Release `nonce`, as assigned by accountGetThenIncrementAddressNonce() but never submitted, so
+ * that it is assigned again rather than left as a gap.  At most ACCOUNT_RELEASED_NONCE_LIMIT
+ * gaps are held; a nonce at or above the next nonce is ignored.
+ */
+private_extern void
+accountReleaseAddressNonce (BREthereumAccount account,
+                            BREthereumAddress address,
+                            uint64_t nonce);
+
+#define ACCOUNT_RELEASED_NONCE_LIMIT     (16)
+
 #ifdef __cplusplus
 }
 #endif
@@ -44,6 +44,22 @@ extern "C" {
                               const char *balance,
                               int rid);
 
+    /**
+     * Client handler for getting the balances of `count` wallets of the one `address` at once,
+     * such as with a single JSON_RPC batch or an `eth_call` of a multicall contract.  Each of
+     * `wids` and `contracts` has `count` elements; a wallet's contract is NULL for ETH (thus
+     * `eth_getBalance`) or the token's address (thus `balanceOf(address)`).  The client invokes
+     * `ewmAnnounceWalletBalance()` for each wallet, with `rid`.
+     */
+    typedef void
+    (*BREthereumClientHandlerGetBalanceBatch) (BREthereumClientContext context,
+                                               BREthereumEWM ewm,
+                                               BREthereumWallet *wids,
+                                               const char **contracts,
+                                               size_t count,
+                                               const char *address,
+                                               int rid);
+
     /// MARK: - Gas Price
 
     typedef void
@@ -88,6 +104,33 @@ extern "C" {
                           BREthereumWallet wid,
                           BREthereumTransfer tid);
 
+    /**
+     * Client handler for estimating the gas of `count` transfers at once, such as with a single
+     * JSON_RPC batch.  Each of `tids`, `froms`, ... has `count` elements; the client invokes
+     * `ewmAnnounceGasEstimate()` for each transfer, with `rid`.
+     */
+    typedef void
+    (*BREthereumClientHandlerEstimateGasBatch) (BREthereumClientContext context,
+                                                BREthereumEWM ewm,
+                                                BREthereumWallet wid,
+                                                BREthereumTransfer *tids,
+                                                const char **froms,
+                                                const char **tos,
+                                                const char **amounts,
+                                                const char **datas,
+                                                size_t count,
+                                                int rid);
+
+    /**
+     * Update the gas estimate of each of `tids`.  With a `funcEstimateGasBatch` client handler
+     * this is one client request; otherwise it is one request for each transfer.
+     */
+    extern void
+    ewmUpdateGasEstimates (BREthereumEWM ewm,
+                           BREthereumWallet wid,
+                           BREthereumTransfer *tids,
+                           size_t count);
+
     /// MARK: - Submit Transfer
 
     /**
@@ -196,6 +239,69 @@ extern "C" {
                             int id,
                             BREthereumBoolean success);
 
+    /// MARK: - Get Transactions and Logs, in Bulk
+
+    /**
+     * A transaction, as decoded by the client, for ewmAnnounceTransactionsAndLogs().  The fields
+     * are those of ewmAnnounceTransaction() but binary.
+     */
+    typedef struct {
+        BREthereumHash hash;
+        BREthereumAddress from;
+        BREthereumAddress to;
+        BREthereumAddress contract;
+        UInt256 amount;
+        uint64_t gasLimit;
+        UInt256 gasPrice;
+        const uint8_t *data;
+        size_t dataLength;
+        uint64_t nonce;
+        uint64_t gasUsed;
+        uint64_t blockNumber;
+        BREthereumHash blockHash;
+        uint64_t blockConfirmations;
+        uint64_t blockTransactionIndex;
+        uint64_t blockTimestamp;
+        BREthereumBoolean isError;
+    } BREthereumClientTransactionRecord;
+
+#define CLIENT_LOG_RECORD_TOPICS_MAXIMUM    (4)
+
+    /**
+     * A log, as decoded by the client, for ewmAnnounceTransactionsAndLogs().  The fields are those
+     * of ewmAnnounceLog() but binary; `hash` is the transaction's hash and each topic is 32 bytes.
+     */
+    typedef struct {
+        BREthereumHash hash;
+        BREthereumAddress contract;
+        size_t topicsCount;
+        BREthereumHash topics[CLIENT_LOG_RECORD_TOPICS_MAXIMUM];
+        const uint8_t *data;
+        size_t dataLength;
+        UInt256 gasPrice;
+        uint64_t gasUsed;
+        uint64_t logIndex;
+        uint64_t blockNumber;
+        uint64_t blockTransactionIndex;
+        uint64_t blockTimestamp;
+    } BREthereumClientLogRecord;
+
+    /**
+     * Announce `transactionsCount` transactions and `logsCount` logs at once - as if by
+     * ewmAnnounceTransaction() and ewmAnnounceLog() for each, but handled in one event with the
+     * changes saved in one batch.  Records that are already known, with an unchanged status, are
+     * skipped before any transaction or log is created for them.  The records, and their `data`,
+     * are copied.  Complete with ewmAnnounceTransactionComplete() and ewmAnnounceLogComplete(), as
+     * for the single announcements.
+     */
+    extern BREthereumStatus
+    ewmAnnounceTransactionsAndLogs (BREthereumEWM ewm,
+                                    int id,
+                                    const BREthereumClientTransactionRecord *transactions,
+                                    size_t transactionsCount,
+                                    const BREthereumClientLogRecord *logs,
+                                    size_t logsCount);
+
     /// MARK: - Get Tokens
 
     typedef void
@@ -234,6 +340,26 @@ extern "C" {
                             const char *blockNumber,
                             int rid);
 
+    /// MARK: - Activity
+
+    /**
+     * Announce a new head, at `blockNumber`, as pushed to the client (for example, by a 'newHeads'
+     * subscription).  In the BRD modes the next periodic poll then skips querying the block number.
+     */
+    extern BREthereumStatus
+    ewmAnnounceNewHead (BREthereumEWM ewm,
+                        const char *blockNumber);
+
+    /**
+     * Announce activity for `wallet`, as pushed to the client (for example, by an address activity
+     * subscription).  In the BRD modes the next periodic tick polls - however idle the polling has
+     * backed off to - and queries the wallet's balance, along with the account's nonce,
+     * transactions and logs.
+     */
+    extern BREthereumStatus
+    ewmAnnounceWalletActivity (BREthereumEWM ewm,
+                               BREthereumWallet wallet);
+
     /// MARK: - Nonce
 
     typedef void
@@ -333,6 +459,23 @@ extern "C" {
                                                           BREthereumStatus status,
                                                           const char *errorDescription);
 
+    /**
+     * A transfer event, as announced by BREthereumClientHandlerTransferEvent, when delivered
+     * in bulk.  See ewmSetTransferEventCoalescing().
+     */
+    typedef struct {
+        BREthereumWallet wid;
+        BREthereumTransfer tid;
+        BREthereumTransferEvent event;
+        BREthereumStatus status;
+        const char *errorDescription;
+    } BREthereumClientTransferEvent;
+
+    typedef void (*BREthereumClientHandlerTransferEvents) (BREthereumClientContext context,
+                                                           BREthereumEWM ewm,
+                                                           const BREthereumClientTransferEvent *events,
+                                                           size_t eventsCount);
+
     typedef enum {
         PEER_EVENT_CREATED = 0,
         PEER_EVENT_DELETED
@@ -412,6 +555,12 @@ extern "C" {
         //       BREthereumClientHandlerBlockEvent funcBlockEvent;
         BREthereumClientHandlerTransferEvent funcTransferEvent;
 
+        // Optional; when NULL, batched gas estimates use `funcEstimateGas` for each transfer.
+        BREthereumClientHandlerEstimateGasBatch funcEstimateGasBatch;
+
+        // Optional; when NULL, batched balances use `funcGetBalance` for each wallet.
+        BREthereumClientHandlerGetBalanceBatch funcGetBalanceBatch;
+
     } BREthereumClient;
 
 #ifdef __cplusplus
@@ -27,11 +27,40 @@
 
 #define EWM_SLEEP_SECONDS (10)
 
-// When using a BRD sync, offset the start block by N days of Ethereum blocks
-#define EWM_BRD_SYNC_START_BLOCK_OFFSET        (3 * 24 * 60 * 4)   /* 4 per minute (every 15 seconds) */
+// When using a BRD sync, start each sync N blocks before the block through which the prior sync
+// completed, so that blocks changed by a reorg are queried again.
+#define EWM_BRD_SYNC_OVERLAP                   (100)   /* 25 minutes, at 4 per minute (every 15 seconds) */
 
 #define EWM_INITIAL_SET_SIZE_DEFAULT         (25)
 
+// When using a BRD sync, back off an idle poll to at most one in N ticks (of EWM_SLEEP_SECONDS) and
+// query every wallet's balance, not just those with activity, once in M polls.
+#define EWM_BRD_POLL_INTERVAL_MAXIMUM        (12)
+#define EWM_BRD_POLL_REFRESH                 (15)
+
+// Sign a batch of transfers on up to N threads, each with at least M transfers; below that a
+// thread costs more than the signatures it would take on.
+#define EWM_SIGN_THREADS_MAXIMUM             (4)
+#define EWM_SIGN_TRANSFERS_PER_THREAD        (8)
+
+/// MARK: - Token Wallet Index
+
+typedef struct BREthereumEWMTokenWalletRecord {
+    BREthereumToken token;      // must be first
+    BREthereumWallet wallet;
+} BREthereumEWMTokenWallet;
+
+static inline size_t
+ewmTokenWalletHashValue (const void *entry) {
+    return addressHashValue (tokenGetAddressRaw (((const BREthereumEWMTokenWallet *) entry)->token));
+}
+
+static inline int
+ewmTokenWalletHashEqual (const void *entry1, const void *entry2) {
+    return ((const BREthereumEWMTokenWallet *) entry1)->token ==
+           ((const BREthereumEWMTokenWallet *) entry2)->token;
+}
+
 /* Forward Declaration */
 static void
 ewmPeriodicDispatcher (BREventHandler handler,
@@ -67,9 +96,7 @@ fileServiceTypeTransactionV1Writer (BRFileServiceContext context,
     BREthereumEWM ewm = context;
     BREthereumTransaction transaction = (BREthereumTransaction) entity;
 
-    BRRlpItem item = transactionRlpEncode(transaction, ewm->network, RLP_TYPE_ARCHIVE, ewm->coder);
-    BRRlpData data = rlpGetData (ewm->coder, item);
-    rlpReleaseItem (ewm->coder, item);
+    BRRlpData data = transactionGetRlpData (transaction, ewm->network, RLP_TYPE_ARCHIVE, ewm->coder);
 
     *bytesCount = (uint32_t) data.bytesCount;
     return data.bytes;
@@ -129,9 +156,7 @@ fileServiceTypeLogV1Writer (BRFileServiceContext context,
     BREthereumEWM ewm = context;
     BREthereumLog log = (BREthereumLog) entity;
 
-    BRRlpItem item = logRlpEncode (log, RLP_TYPE_ARCHIVE, ewm->coder);
-    BRRlpData data = rlpGetData (ewm->coder, item);
-    rlpReleaseItem (ewm->coder, item);
+    BRRlpData data = logGetRlpData (log, RLP_TYPE_ARCHIVE, ewm->coder);
 
     *bytesCount = (uint32_t) data.bytesCount;
     return data.bytes;
@@ -215,6 +240,193 @@ fileServiceTypeBlockV1Reader (BRFileServiceContext context,
     return block;
 }
 
+/// MARK: - Header Store
+
+/**
+ * The Header Store holds a dense run of block headers as BLOCK_HEADER_RECORD_SIZE records
+ * indexed by block number.  The run starts at a CHT root block, the 'anchor', at least
+ * BLOCK_HEADER_CHT_ROOT_INTERVAL blocks before the newest saved block.  Whereas "blocks" holds
+ * only the most recent blocks that BCS saved, the store reaches back to the anchor so that on
+ * restart BCS can chain from a CHT root - with total difficulty - without re-fetching headers.
+ * Records need no RLP decoding nor hashing.
+ *
+ * Loading reads only the tail: batches of EWM_HEADER_STORE_READ_COUNT records, newest first,
+ * until a block with a total difficulty, from which BCS can chain, is loaded.  The older records
+ * are only read if the tail has no such block; BCS requests anything else it needs from LES.
+ *
+ * The file is a prefix of {magic, record size, anchor number} followed by the record for block
+ * number `anchor + i` at index `i`.  Missing blocks are holes - empty (zero) records.
+ */
+#define EWM_HEADER_STORE_MAGIC          (0x31534845)      // "EHS1"
+#define EWM_HEADER_STORE_PREFIX_SIZE    (16)
+#define EWM_HEADER_STORE_READ_COUNT     (256)
+
+static uint64_t
+headerStoreAnchorForNumber (uint64_t number) {
+    if (number <= BLOCK_HEADER_CHT_ROOT_INTERVAL) return 1;
+    // The CHT root at or before `number - BLOCK_HEADER_CHT_ROOT_INTERVAL`
+    return 1 + (chtRootNumberGetFromNumber (number - BLOCK_HEADER_CHT_ROOT_INTERVAL)
+                << BLOCK_HEADER_CHT_ROOT_INTERVAL_SHIFT);
+}
+
+static int
+headerStoreReadPrefix (FILE *file, uint64_t *anchor) {
+    uint8_t prefix[EWM_HEADER_STORE_PREFIX_SIZE];
+
+    if (0 != fseek (file, 0, SEEK_SET) || 1 != fread (prefix, sizeof (prefix), 1, file)) return 0;
+    if (EWM_HEADER_STORE_MAGIC != UInt32GetLE (&prefix[0]) ||
+        BLOCK_HEADER_RECORD_SIZE != UInt32GetLE (&prefix[4])) return 0;
+
+    *anchor = UInt64GetLE (&prefix[8]);
+    return 1;
+}
+
+static int
+headerStoreWritePrefix (FILE *file, uint64_t anchor) {
+    uint8_t prefix[EWM_HEADER_STORE_PREFIX_SIZE];
+
+    UInt32SetLE (&prefix[0], EWM_HEADER_STORE_MAGIC);
+    UInt32SetLE (&prefix[4], BLOCK_HEADER_RECORD_SIZE);
+    UInt64SetLE (&prefix[8], anchor);
+    return 0 == fseek (file, 0, SEEK_SET) && 1 == fwrite (prefix, sizeof (prefix), 1, file);
+}
+
+/**
+ * Open the Header Store for writing at `anchor`.  If the store is anchored earlier, the records
+ * from `anchor` on are kept and the earlier ones dropped; if it is missing, invalid or anchored
+ * later, it is recreated empty.
+ */
+static FILE *
+headerStoreOpenAtAnchor (BREthereumEWM ewm, uint64_t anchor) {
+    uint64_t oldAnchor = 0;
+    uint8_t *records = NULL;
+    size_t recordsCount = 0;
+
+    FILE *file = fopen (ewm->headerStorePath, "r+b");
+
+    if (NULL != file && headerStoreReadPrefix (file, &oldAnchor) && oldAnchor == anchor)
+        return file;
+
+    if (NULL != file && oldAnchor > 0 && oldAnchor < anchor &&
+        0 == fseek (file, 0, SEEK_END)) {
+        long size = ftell (file);
+        long offset = EWM_HEADER_STORE_PREFIX_SIZE + (long) (anchor - oldAnchor) * BLOCK_HEADER_RECORD_SIZE;
+
+        if (size > offset) {
+            recordsCount = (size_t) (size - offset) / BLOCK_HEADER_RECORD_SIZE;
+            records = malloc (recordsCount * BLOCK_HEADER_RECORD_SIZE);
+            if (NULL == records || 0 != fseek (file, offset, SEEK_SET) ||
+                recordsCount != fread (records, BLOCK_HEADER_RECORD_SIZE, recordsCount, file))
+                recordsCount = 0;
+        }
+    }
+    if (NULL != file) fclose (file);
+
+    file = fopen (ewm->headerStorePath, "w+b");
+    if (NULL != file &&
+        (!headerStoreWritePrefix (file, anchor) ||
+         (recordsCount > 0 && recordsCount != fwrite (records, BLOCK_HEADER_RECORD_SIZE, recordsCount, file)))) {
+        fclose (file);
+        file = NULL;
+    }
+
+    if (NULL != records) free (records);
+    return file;
+}
+
+/**
+ * Save the headers of `blocks` into the Header Store, anchored relative to the newest block.
+ */
+static void
+headerStoreSave (BREthereumEWM ewm,
+                 BRArrayOf(BREthereumBlock) blocks) {
+    size_t count = array_count (blocks);
+    if (NULL == ewm->headerStorePath || 0 == count) return;
+
+    uint64_t newest = 0;
+    for (size_t index = 0; index < count; index++)
+        if (blockGetNumber (blocks[index]) > newest)
+            newest = blockGetNumber (blocks[index]);
+
+    uint64_t anchor = headerStoreAnchorForNumber (newest);
+    FILE *file = headerStoreOpenAtAnchor (ewm, anchor);
+    if (NULL == file) {
+        eth_log ("EWM", "Header Store: Save Failed: %s", strerror (errno));
+        return;
+    }
+
+    uint8_t record[BLOCK_HEADER_RECORD_SIZE];
+    size_t saved = 0;
+
+    for (size_t index = 0; index < count; index++) {
+        uint64_t number = blockGetNumber (blocks[index]);
+        if (number < anchor) continue;
+
+        blockHeaderRecordEncode (blocks[index], record);
+        long offset = EWM_HEADER_STORE_PREFIX_SIZE + (long) (number - anchor) * BLOCK_HEADER_RECORD_SIZE;
+        if (0 != fseek (file, offset, SEEK_SET) || 1 != fwrite (record, sizeof (record), 1, file)) break;
+        saved++;
+    }
+
+    fclose (file);
+    eth_log ("EWM", "Header Store: Saved %zu, Anchor %" PRIu64, saved, anchor);
+}
+
+/**
+ * Load the tail of the Header Store's blocks into `blocks`, back to one with a total difficulty;
+ * those already in `blocks` are skipped (but their total difficulty counts).
+ */
+static void
+headerStoreLoad (BREthereumEWM ewm,
+                 BRSetOf(BREthereumBlock) blocks) {
+    uint64_t anchor;
+    if (NULL == ewm->headerStorePath) return;
+
+    FILE *file = fopen (ewm->headerStorePath, "rb");
+    if (NULL == file) return;
+
+    if (!headerStoreReadPrefix (file, &anchor) || 0 != fseek (file, 0, SEEK_END)) {
+        fclose (file);
+        return;
+    }
+
+    long size = ftell (file);
+    size_t end = (size < EWM_HEADER_STORE_PREFIX_SIZE
+                  ? 0
+                  : (size_t) (size - EWM_HEADER_STORE_PREFIX_SIZE) / BLOCK_HEADER_RECORD_SIZE);
+
+    uint8_t *records = malloc (EWM_HEADER_STORE_READ_COUNT * BLOCK_HEADER_RECORD_SIZE);
+    size_t loaded = 0;
+    int chainable = 0;
+
+    // Read [start, end) - newest first - until BCS can chain from a total difficulty.
+    while (NULL != records && !chainable && end > 0) {
+        size_t start = (end > EWM_HEADER_STORE_READ_COUNT ? end - EWM_HEADER_STORE_READ_COUNT : 0);
+        size_t count = end - start;
+        long offset = EWM_HEADER_STORE_PREFIX_SIZE + (long) start * BLOCK_HEADER_RECORD_SIZE;
+
+        if (0 != fseek (file, offset, SEEK_SET) ||
+            count != fread (records, BLOCK_HEADER_RECORD_SIZE, count, file)) break;
+
+        for (size_t index = 0; index < count; index++) {
+            BREthereumBlock block = blockHeaderRecordDecode (&records[index * BLOCK_HEADER_RECORD_SIZE]);
+            if (NULL == block) continue;
+
+            BREthereumBlock existing = BRSetGet (blocks, block);
+            if (NULL != existing) { blockRelease (block); block = existing; }
+            else { BRSetAdd (blocks, block); loaded++; }
+
+            chainable |= ETHEREUM_BOOLEAN_IS_TRUE (blockHasTotalDifficulty (block));
+        }
+        end = start;
+    }
+
+    if (NULL != records) free (records);
+    fclose (file);
+    eth_log ("EWM", "Header Store: Loaded %zu, Anchor %" PRIu64 ", From %" PRIu64,
+             loaded, anchor, anchor + end);
+}
+
 static BRSetOf(BREthereumBlock)
 initialBlocksLoad (BREthereumEWM ewm) {
     BRSetOf(BREthereumBlock) blocks = BRSetNew(blockHashValue, blockHashEqual, EWM_INITIAL_SET_SIZE_DEFAULT);
@@ -222,9 +434,114 @@ initialBlocksLoad (BREthereumEWM ewm) {
         BRSetFree(blocks);
         return NULL;
     }
+    headerStoreLoad (ewm, blocks);
     return blocks;
 }
 
+/// MARK: - BRD Sync File Service
+
+static const char *fileServiceTypeBRDSync = "brdsync";
+enum {
+    EWM_BRD_SYNC_VERSION_1
+};
+
+/**
+ * The cursor for a BRD sync of an address' transactions and logs - the block number through
+ * which a sync completed.  A restarted EWM continues from the cursor, rather than from block 0.
+ */
+typedef struct {
+    BREthereumAddress address;
+    uint64_t blockNumber;
+} BREthereumEWMBRDSyncCursor;
+
+static size_t
+ewmBRDSyncCursorHashValue (const void *cursor) {
+    return (size_t) addressHashValue (((const BREthereumEWMBRDSyncCursor *) cursor)->address);
+}
+
+static int
+ewmBRDSyncCursorHashEqual (const void *cursor1, const void *cursor2) {
+    return addressHashEqual (((const BREthereumEWMBRDSyncCursor *) cursor1)->address,
+                             ((const BREthereumEWMBRDSyncCursor *) cursor2)->address);
+}
+
+static UInt256
+fileServiceTypeBRDSyncV1Identifier (BRFileServiceContext context,
+                                    BRFileService fs,
+                                    const void *entity) {
+    const BREthereumEWMBRDSyncCursor *cursor = entity;
+
+    BRRlpData data = { sizeof (cursor->address.bytes), (uint8_t *) cursor->address.bytes };
+    BREthereumHash hash = hashCreateFromData (data);
+
+    UInt256 result;
+    memcpy (result.u8, hash.bytes, ETHEREUM_HASH_BYTES);
+    return result;
+}
+
+static uint8_t *
+fileServiceTypeBRDSyncV1Writer (BRFileServiceContext context,
+                                BRFileService fs,
+                                const void* entity,
+                                uint32_t *bytesCount) {
+    BREthereumEWM ewm = context;
+    const BREthereumEWMBRDSyncCursor *cursor = entity;
+
+    BRRlpItem item = rlpEncodeList2 (ewm->coder,
+                                     addressRlpEncode (cursor->address, ewm->coder),
+                                     rlpEncodeUInt64 (ewm->coder, cursor->blockNumber, 0));
+    BRRlpData data = rlpGetData (ewm->coder, item);
+    rlpReleaseItem (ewm->coder, item);
+
+    *bytesCount = (uint32_t) data.bytesCount;
+    return data.bytes;
+}
+
+static void *
+fileServiceTypeBRDSyncV1Reader (BRFileServiceContext context,
+                                BRFileService fs,
+                                uint8_t *bytes,
+                                uint32_t bytesCount) {
+    BREthereumEWM ewm = context;
+
+    BRRlpData data = { bytesCount, bytes };
+    BRRlpItem item = rlpGetItem (ewm->coder, data);
+
+    size_t itemsCount = 0;
+    const BRRlpItem *items = rlpDecodeList (ewm->coder, item, &itemsCount);
+
+    BREthereumEWMBRDSyncCursor *cursor = NULL;
+    if (2 == itemsCount) {
+        cursor = malloc (sizeof (BREthereumEWMBRDSyncCursor));
+        cursor->address = addressRlpDecode (items[0], ewm->coder);
+        cursor->blockNumber = rlpDecodeUInt64 (ewm->coder, items[1], 0);
+    }
+    rlpReleaseItem (ewm->coder, item);
+
+    return cursor;
+}
+
+/**
+ * Return the block number through which a BRD sync of `address` completed, or 0 if none did.
+ */
+static uint64_t
+initialBRDSyncCursorLoad (BREthereumEWM ewm,
+                          BREthereumAddress address) {
+    BRSetOf(BREthereumEWMBRDSyncCursor*) cursors = BRSetNew (ewmBRDSyncCursorHashValue,
+                                                             ewmBRDSyncCursorHashEqual,
+                                                             1);
+    uint64_t blockNumber = 0;
+
+    if (1 == fileServiceLoad (ewm->fs, cursors, fileServiceTypeBRDSync, 1)) {
+        BREthereumEWMBRDSyncCursor key = { address, 0 };
+        BREthereumEWMBRDSyncCursor *cursor = BRSetGet (cursors, &key);
+        if (NULL != cursor) blockNumber = cursor->blockNumber;
+    }
+
+    BRSetFreeAll (cursors, free);
+    return blockNumber;
+}
+
 /// MARK: - Node File Service
 
 static const char *fileServiceTypeNodes = "nodes";
@@ -288,6 +605,22 @@ initialNodesLoad (BREthereumEWM ewm) {
 }
 
 
+/**
+ * Group the storage writes of each batch of dispatched EWM events - such as the blocks,
+ * transactions and logs that BCS announces for one block - into one write, with one sync.
+ *
+ * @param ewm The EthereumWalletManager (EWM)
+ */
+static void
+ewmFileServiceBatchBegin (BREthereumEWM ewm) {
+    fileServiceBeginBatch (ewm->fs);
+}
+
+static void
+ewmFileServiceBatchEnd (BREthereumEWM ewm) {
+    fileServiceEndBatch (ewm->fs);
+}
+
 /**
  *
  *
@@ -351,7 +684,7 @@ ewmCreate (BREthereumNetwork network,
     ewm->network = network;
     ewm->account = account;
     ewm->bcs = NULL;
-    ewm->blockHeight = 0;
+    atomic_init (&ewm->blockHeight, 0);
 
     {
         char address [ADDRESS_ENCODED_CHARS];
@@ -364,9 +697,18 @@ ewmCreate (BREthereumNetwork network,
     ewm->brdSync.ridLog = -1;
     ewm->brdSync.begBlockNumber = 0;
     ewm->brdSync.endBlockNumber = 0;
+    ewm->brdSync.cursorBlockNumber = 0;
     ewm->brdSync.completedTransaction = 0;
     ewm->brdSync.completedLog = 0;
 
+    // Initialize the `brdPoll` struct; the first tick polls every wallet.
+    ewm->brdPoll.interval = 1;
+    ewm->brdPoll.countdown = 0;
+    ewm->brdPoll.refresh = 0;
+    ewm->brdPoll.active = 0;
+    ewm->brdPoll.headPushed = 0;
+    array_new (ewm->brdPoll.dirty, DEFAULT_WALLET_CAPACITY);
+
     // Get the client assigned early; callbacks as EWM/BCS state is re-establish, regarding
     // blocks, peers, transactions and logs, will be invoked.
     ewm->client = client;
@@ -391,6 +733,17 @@ ewmCreate (BREthereumNetwork network,
                                  ewmFileServiceErrorHandler);
     if (NULL == ewm->fs) return ewmCreateErrorHandler(ewm, 1, "create");
 
+    // The header store is a file alongside the file service's own; fileServiceCreate() has
+    // created the directory.
+    {
+        const char *headerStoreFormat = "%s/eth/%s/headers.dat";
+        size_t headerStorePathLength = (strlen (headerStoreFormat) +
+                                        strlen (storagePath) +
+                                        strlen (networkGetName (network)));
+        ewm->headerStorePath = malloc (headerStorePathLength + 1);
+        sprintf (ewm->headerStorePath, headerStoreFormat, storagePath, networkGetName (network));
+    }
+
     /// Transaction
     if (1 != fileServiceDefineType (ewm->fs, fileServiceTypeTransactions, EWM_TRANSACTION_VERSION_1,
                                     (BRFileServiceContext) ewm,
@@ -432,6 +785,22 @@ ewmCreate (BREthereumNetwork network,
                                               EWM_BLOCK_VERSION_1))
         return ewmCreateErrorHandler(ewm, 1, fileServiceTypeBlocks);
 
+    /// BRD Sync
+    if (1 != fileServiceDefineType (ewm->fs, fileServiceTypeBRDSync, EWM_BRD_SYNC_VERSION_1,
+                                    (BRFileServiceContext) ewm,
+                                    fileServiceTypeBRDSyncV1Identifier,
+                                    fileServiceTypeBRDSyncV1Reader,
+                                    fileServiceTypeBRDSyncV1Writer) ||
+        1 != fileServiceDefineCurrentVersion (ewm->fs, fileServiceTypeBRDSync,
+                                              EWM_BRD_SYNC_VERSION_1))
+        return ewmCreateErrorHandler(ewm, 1, fileServiceTypeBRDSync);
+
+    // A BRD sync continues from where a prior one completed, less the overlap.
+    ewm->brdSync.cursorBlockNumber = initialBRDSyncCursorLoad (ewm, accountGetPrimaryAddress (account));
+    ewm->brdSync.begBlockNumber = (ewm->brdSync.cursorBlockNumber >= EWM_BRD_SYNC_OVERLAP
+                                   ? ewm->brdSync.cursorBlockNumber - EWM_BRD_SYNC_OVERLAP
+                                   : 0);
+
     // Load all the persistent entities
     BRSetOf(BREthereumTransaction) transactions = initialTransactionsLoad(ewm);
     BRSetOf(BREthereumLog) logs = initialLogsLoad(ewm);
@@ -473,8 +842,12 @@ ewmCreate (BREthereumNetwork network,
                                        ewmEventTypes,
                                        ewmEventTypesCount,
                                        &ewm->lock);
+    eventHandlerSetBatchCallbacks (ewm->handler, ewm,
+                                   (BREventBatchCallback) ewmFileServiceBatchBegin,
+                                   (BREventBatchCallback) ewmFileServiceBatchEnd);
 
     array_new(ewm->wallets, DEFAULT_WALLET_CAPACITY);
+    ewm->walletsByToken = BRSetNew (ewmTokenWalletHashValue, ewmTokenWalletHashEqual, EWM_INITIAL_SET_SIZE_DEFAULT);
 
     // Create a default ETH wallet; other wallets will be created 'on demand'
     ewm->walletHoldingEther = walletCreate(ewm->account,
@@ -514,7 +887,8 @@ ewmCreate (BREthereumNetwork network,
                                   nodes,
                                   NULL,
                                   NULL,
-                                  NULL);
+                                  NULL,
+                                  ewm->fs);
 
             // Announce all the provided transactions...
             FOR_SET (BREthereumTransaction, transaction, transactions)
@@ -580,7 +954,8 @@ ewmCreate (BREthereumNetwork network,
                                   nodes,
                                   blocks,
                                   transactions,
-                                  logs);
+                                  logs,
+                                  ewm->fs);
             break;
         }
     }
@@ -623,21 +998,31 @@ ewmCreateWithPublicKey (BREthereumNetwork network,
 
 extern void
 ewmDestroy (BREthereumEWM ewm) {
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     ewmDisconnect(ewm);
 
     bcsDestroy(ewm->bcs);
 
+    ewmTransferEventsRelease (ewm);
+
+    BRSetFreeAll (ewm->walletsByToken, free);
+    ewm->walletsByToken = NULL;
+
     walletsRelease (ewm->wallets);
     ewm->wallets = NULL;
 
+    array_free (ewm->brdPoll.dirty);
+    ewm->brdPoll.dirty = NULL;
+
     eventHandlerDestroy(ewm->handler);
     rlpCoderRelease(ewm->coder);
 
     // Finally remove the assert recovery handler
     BRAssertRemoveRecovery((BRAssertRecoveryInfo) ewm);
 
-    pthread_mutex_unlock (&ewm->lock);
+    if (NULL != ewm->headerStorePath) free (ewm->headerStorePath);
+
+    ewmUnlock (ewm);
     pthread_mutex_destroy (&ewm->lock);
     free (ewm);
 }
@@ -843,10 +1228,10 @@ ewmSync (BREthereumEWM ewm,
     switch (ewm->mode) {
         case BRD_ONLY:
         case BRD_WITH_P2P_SEND: {
-            pthread_mutex_lock(&ewm->lock);
+            ewmLock (ewm);
 
             if (ETHEREUM_BOOLEAN_IS_TRUE (pendExistingTransfers)) {
-                BREthereumSyncTransferContext context = { ewm, 0, ewm->blockHeight };
+                BREthereumSyncTransferContext context = { ewm, 0, atomic_load (&ewm->blockHeight) };
                 BREthereumWallet *wallets = ewmGetWallets(ewm);
 
                 // Walk each wallet, set all transfers to 'pending'
@@ -864,7 +1249,10 @@ ewmSync (BREthereumEWM ewm,
             // Try to avoid letting a nearly completed sync from continuing.
             ewm->brdSync.completedTransaction = 0;
             ewm->brdSync.completedLog = 0;
-            pthread_mutex_unlock(&ewm->lock);
+
+            // Start on the next tick, however idle the polling.
+            ewm->brdPoll.active = 1;
+            ewmUnlock (ewm);
             return ETHEREUM_BOOLEAN_TRUE;
         }
         case P2P_WITH_BRD_SYNC:
@@ -876,11 +1264,20 @@ ewmSync (BREthereumEWM ewm,
 
 extern void
 ewmLock (BREthereumEWM ewm) {
+    uint64_t start = BRStatsMicroseconds();
     pthread_mutex_lock (&ewm->lock);
+
+    // The lock is recursive; only the outermost hold is timed.
+    if (0 == ewm->lockDepth++) {
+        ewm->lockTime = BRStatsMicroseconds();
+        BRStatsRecord (BRStatsEWMLockWait, ewm->lockTime - start);
+    }
 }
 
 extern void
 ewmUnlock (BREthereumEWM ewm) {
+    if (0 == --ewm->lockDepth)
+        BRStatsRecord (BRStatsEWMLockHold, BRStatsMicroseconds() - ewm->lockTime);
     pthread_mutex_unlock (&ewm->lock);
 }
 
@@ -892,13 +1289,13 @@ ewmLookupBlockByHash(BREthereumEWM ewm,
                      const BREthereumHash hash) {
     BREthereumBlock block = NULL;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     for (int i = 0; i < array_count(ewm->blocks); i++)
         if (ETHEREUM_COMPARISON_EQ == hashCompare(hash, blockGetHash(ewm->blocks[i]))) {
             block = ewm->blocks[i];
             break;
         }
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return block;
 }
 
@@ -907,11 +1304,11 @@ ewmLookupBlock(BREthereumEWM ewm,
                BREthereumBlockId bid) {
     BREthereumBlock block = NULL;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     block = (0 <= bid && bid < array_count(ewm->blocks)
              ? ewm->blocks[bid]
              : NULL);
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return block;
 }
 
@@ -920,13 +1317,13 @@ ewmLookupBlockId (BREthereumEWM ewm,
                   BREthereumBlock block) {
     BREthereumBlockId bid = -1;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     for (int i = 0; i < array_count(ewm->blocks); i++)
         if (block == ewm->blocks[i]) {
             bid = i;
             break;
         }
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return bid;
 }
 
@@ -934,10 +1331,10 @@ extern BREthereumBlockId
 ewmInsertBlock (BREthereumEWM ewm,
                 BREthereumBlock block) {
     BREthereumBlockId bid = -1;
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     array_add(ewm->blocks, block);
     bid = (BREthereumBlockId) (array_count(ewm->blocks) - 1);
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     ewmSignalBlockEvent(ewm, bid, BLOCK_EVENT_CREATED, SUCCESS, NULL);
     return bid;
 }
@@ -945,14 +1342,104 @@ ewmInsertBlock (BREthereumEWM ewm,
 
 extern uint64_t
 ewmGetBlockHeight(BREthereumEWM ewm) {
-    return ewm->blockHeight;
+    return atomic_load (&ewm->blockHeight);
 }
 
 extern void
 ewmUpdateBlockHeight(BREthereumEWM ewm,
                      uint64_t blockHeight) {
-    if (blockHeight > ewm->blockHeight)
-        ewm->blockHeight = blockHeight;
+    uint64_t current = atomic_load (&ewm->blockHeight);
+    while (blockHeight > current &&
+           !atomic_compare_exchange_weak (&ewm->blockHeight, &current, blockHeight))
+        ;
+}
+
+/// MARK: - Memory
+
+extern BREthereumEWMMemory
+ewmGetMemoryUsage (BREthereumEWM ewm) {
+    BREthereumEWMMemory memory = { 0 };
+
+    ewmLock (ewm);
+    for (size_t index = 0; index < array_count (ewm->wallets); index++) {
+        size_t transfers = 0;
+        memory.wallets   += walletGetMemoryUsage (ewm->wallets[index], &transfers);
+        memory.transfers += transfers;
+    }
+
+    memory.coder  = rlpCoderGetMemoryUsage (ewm->coder);
+    memory.events = eventHandlerGetMemoryUsage (ewm->handler);
+    memory.other  = (sizeof (struct BREthereumEWMRecord) +
+                     array_heap_size (ewm->wallets) +
+                     BRSetCount (ewm->walletsByToken) * sizeof (BREthereumEWMTokenWallet) +
+                     BRSetMemoryUsage (ewm->walletsByToken) +
+                     array_heap_size (ewm->brdPoll.dirty) +
+                     array_heap_size (ewm->transferEvents.events));
+    if (NULL != ewm->transferEvents.latest)
+        memory.other += BRSetMemoryUsage (ewm->transferEvents.latest);
+    ewmUnlock (ewm);
+
+    // BCS counts itself on its own thread; don't hold the EWM lock.
+    if (NULL != ewm->bcs) {
+        BREthereumBCSMemory bcs = bcsGetMemoryUsage (ewm->bcs);
+        memory.blockChain   = bcs.blocks;
+        memory.orphans      = bcs.orphans;
+        memory.transactions = bcs.transactions;
+        memory.logs         = bcs.logs;
+        memory.nodes        = bcs.les;
+        memory.other       += bcs.other;
+    }
+
+    memory.total = (memory.wallets + memory.blockChain + memory.orphans + memory.transactions +
+                    memory.logs + memory.nodes + memory.coder + memory.events + memory.other);
+    return memory;
+}
+
+/// MARK: - Logs
+
+typedef struct {
+    BREthereumEWM ewm;
+    BREthereumEWMLogQueryContext context;
+    BREthereumEWMLogQueryCallback callback;
+} BREthereumEWMLogQuery;
+
+static void
+ewmHandleQueryLogs (BREthereumEWMLogQuery *query,
+                    BREthereumBCS bcs,
+                    OwnershipGiven BRArrayOf(BREthereumLog) logs) {
+    query->callback (query->context, query->ewm, logs);
+    free (query);
+}
+
+extern BREthereumBoolean
+ewmQueryLogs (BREthereumEWM ewm,
+              const BREthereumAddress *addresses,
+              size_t addressesCount,
+              const BREthereumLogTopic *topics,
+              size_t topicsCount,
+              uint64_t blockNumberStart,
+              uint64_t blockNumberStop,
+              BREthereumEWMLogQueryContext context,
+              BREthereumEWMLogQueryCallback callback) {
+    switch (ewm->mode) {
+        case BRD_ONLY:
+        case BRD_WITH_P2P_SEND:
+            return ETHEREUM_BOOLEAN_FALSE;
+
+        case P2P_WITH_BRD_SYNC:
+        case P2P_ONLY: {
+            BREthereumEWMLogQuery *query = malloc (sizeof (BREthereumEWMLogQuery));
+            *query = (BREthereumEWMLogQuery) { ewm, context, callback };
+
+            bcsQueryLogs (ewm->bcs,
+                          addresses, addressesCount,
+                          topics, topicsCount,
+                          blockNumberStart, blockNumberStop,
+                          (BREthereumBCSLogQueryContext) query,
+                          (BREthereumBCSLogQueryCallback) ewmHandleQueryLogs);
+            return ETHEREUM_BOOLEAN_TRUE;
+        }
+    }
 }
 
 /// MARK: - Transfers
@@ -963,11 +1450,11 @@ ewmLookupTransfer (BREthereumEWM ewm,
                    BREthereumTransfer transfer) {
     BREthereumTransfer transfer = NULL;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     transfer = (0 <= tid && tid < array_count(ewm->transfers)
                 ? ewm->transfers[tid]
                 : NULL);
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return transfer;
 }
 
@@ -976,13 +1463,13 @@ ewmLookupTransferByHash (BREthereumEWM ewm,
                          const BREthereumHash hash) {
     BREthereumTransfer transfer = NULL;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     for (int i = 0; i < array_count(ewm->transfers); i++)
         if (ETHEREUM_COMPARISON_EQ == hashCompare(hash, transferGetHash(ewm->transfers[i]))) {
             transfer = ewm->transfers[i];
             break;
         }
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return transfer;
 }
 
@@ -991,13 +1478,13 @@ ewmLookupTransferId (BREthereumEWM ewm,
                      BREthereumTransfer transfer) {
     BREthereumTransfer transfer = -1;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     for (int i = 0; i < array_count(ewm->transfers); i++)
         if (transfer == ewm->transfers[i]) {
             tid = i;
             break;
         }
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return tid;
 }
 
@@ -1006,10 +1493,10 @@ ewmInsertTransfer (BREthereumEWM ewm,
                    BREthereumTransfer transfer) {
     BREthereumTransfer transfer;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     array_add (ewm->transfers, transfer);
     tid = (BREthereumTransferId) (array_count(ewm->transfers) - 1);
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
 
     return tid;
 }
@@ -1041,11 +1528,11 @@ ewmLookupWallet(BREthereumEWM ewm,
                 BREthereumWalletId wid) {
     BREthereumWallet wallet = NULL;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     wallet = (0 <= wid && wid < array_count(ewm->wallets)
               ? ewm->wallets[wid]
               : NULL);
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return wallet;
 }
 
@@ -1054,13 +1541,13 @@ ewmLookupWalletId(BREthereumEWM ewm,
                   BREthereumWallet wallet) {
     BREthereumWalletId wid = -1;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     for (int i = 0; i < array_count (ewm->wallets); i++)
         if (wallet == ewm->wallets[i]) {
             wid = i;
             break;
         }
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return wid;
 }
 
@@ -1068,13 +1555,13 @@ extern BREthereumWallet
 ewmLookupWalletByTransfer (BREthereumEWM ewm,
                            BREthereumTransfer transfer) {
     BREthereumWallet wallet = NULL;
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     for (int i = 0; i < array_count (ewm->wallets); i++)
         if (walletHasTransfer(ewm->wallets[i], transfer)) {
             wallet = ewm->wallets[i];
             break;
         }
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return wallet;
 }
 #endif
@@ -1082,10 +1569,19 @@ ewmLookupWalletByTransfer (BREthereumEWM ewm,
 extern void
 ewmInsertWallet (BREthereumEWM ewm,
                  BREthereumWallet wallet) {
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     array_add (ewm->wallets, wallet);
+
+    BREthereumToken token = walletGetToken (wallet);
+    if (NULL != token) {
+        BREthereumEWMTokenWallet *entry = malloc (sizeof (BREthereumEWMTokenWallet));
+        entry->token  = token;
+        entry->wallet = wallet;
+        BRSetAdd (ewm->walletsByToken, entry);
+    }
+    ewmMarkWalletDirty (ewm, wallet);
     ewmSignalWalletEvent (ewm, wallet, WALLET_EVENT_CREATED, SUCCESS, NULL);
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
 }
 
 //
@@ -1093,7 +1589,7 @@ ewmInsertWallet (BREthereumEWM ewm,
 //
 extern BREthereumWallet *
 ewmGetWallets (BREthereumEWM ewm) {
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
 
     unsigned long count = array_count(ewm->wallets);
     BREthereumWallet *wallets = calloc (count + 1, sizeof (BREthereumWallet));
@@ -1103,7 +1599,7 @@ ewmGetWallets (BREthereumEWM ewm) {
     }
     wallets[count] = NULL;
 
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return wallets;
 }
 
@@ -1121,13 +1617,13 @@ extern BREthereumWallet
 ewmGetWalletHoldingToken(BREthereumEWM ewm,
                          BREthereumToken token) {
     BREthereumWallet wallet = NULL;
+    BREthereumEWMTokenWallet key = { token, NULL };
 
-    pthread_mutex_lock(&ewm->lock);
-    for (int i = 0; i < array_count(ewm->wallets); i++)
-        if (token == walletGetToken(ewm->wallets[i])) {
-            wallet = ewm->wallets[i];
-            break;
-        }
+    if (NULL == token) return ewm->walletHoldingEther;
+
+    ewmLock (ewm);
+    BREthereumEWMTokenWallet *entry = BRSetGet (ewm->walletsByToken, &key);
+    if (NULL != entry) wallet = entry->wallet;
 
     if (NULL == wallet) {
         wallet = walletCreateHoldingToken(ewm->account,
@@ -1135,7 +1631,7 @@ ewmGetWalletHoldingToken(BREthereumEWM ewm,
                                           token);
         ewmInsertWallet(ewm, wallet);
     }
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return wallet;
 }
 
@@ -1147,11 +1643,11 @@ ewmWalletCreateTransfer(BREthereumEWM ewm,
                         BREthereumAmount amount) {
     BREthereumTransfer transfer = NULL;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
 
     transfer = walletCreateTransfer(wallet, addressCreate(recvAddress), amount);
 
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
 
     // Transfer DOES NOT have a hash yet because it is not signed; but it is inserted in the
     // wallet and can be display, in order, w/o the hash
@@ -1170,7 +1666,7 @@ ewmWalletCreateTransferGeneric(BREthereumEWM ewm,
                                const char *data) {
     BREthereumTransfer transfer = NULL;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
 
     transfer = walletCreateTransferGeneric(wallet,
                                               addressCreate(recvAddress),
@@ -1179,7 +1675,7 @@ ewmWalletCreateTransferGeneric(BREthereumEWM ewm,
                                               gasLimit,
                                               data);
 
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
 
     // Transfer DOES NOT have a hash yet because it is not signed; but it is inserted in the
     // wallet and can be display, in order, w/o the hash
@@ -1196,11 +1692,11 @@ ewmWalletCreateTransferWithFeeBasis (BREthereumEWM ewm,
                                      BREthereumFeeBasis feeBasis) {
     BREthereumTransfer transfer = NULL;
 
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     {
         transfer = walletCreateTransferWithFeeBasis (wallet, addressCreate(recvAddress), amount, feeBasis);
     }
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
 
     // Transfer DOES NOT have a hash yet because it is not signed; but it is inserted in the
     // wallet and can be display, in order, w/o the hash
@@ -1342,9 +1838,9 @@ ewmWalletSignTransfer (BREthereumEWM ewm,
                        BREthereumWallet wallet,
                        BREthereumTransfer transfer,
                        BRKey privateKey) {
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     walletSignTransferWithPrivateKey (wallet, transfer, privateKey);
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     ewmWalletSignTransferAnnounce (ewm, wallet, transfer);
 }
 
@@ -1353,16 +1849,112 @@ ewmWalletSignTransferWithPaperKey(BREthereumEWM ewm,
                                   BREthereumWallet wallet,
                                   BREthereumTransfer transfer,
                                   const char *paperKey) {
-    pthread_mutex_lock(&ewm->lock);
-    walletSignTransfer (wallet, transfer, paperKey);
-    pthread_mutex_unlock(&ewm->lock);
-    ewmWalletSignTransferAnnounce (ewm, wallet, transfer);
+    ewmWalletSignTransfersWithPaperKey (ewm, wallet, &transfer, 1, paperKey);
+}
+
+typedef struct {
+    BREthereumTransfer *transfers;
+    size_t transfersCount;
+    BREthereumNetwork network;
+    BREthereumAccount account;
+    BREthereumAddress address;
+    BRKey privateKey;
+} BREthereumEWMSignRun;
+
+static void *
+ewmWalletSignTransfersThread (BREthereumEWMSignRun *run) {
+    for (size_t index = 0; index < run->transfersCount; index++)
+        transferSignWithKey (run->transfers[index],
+                             run->network,
+                             run->account,
+                             run->address,
+                             run->privateKey);
+    return NULL;
+}
+
+extern void // status, error
+ewmWalletSignTransfers (BREthereumEWM ewm,
+                        BREthereumWallet wallet,
+                        BREthereumTransfer *transfers,
+                        size_t transfersCount,
+                        BRKey privateKey) {
+    BREthereumAccount account = ewm->account;
+    BREthereumAddress address = walletGetAddress (wallet);
+
+    // Assign any missing nonces, in `transfers` order, before any transfer is signed so that the
+    // nonces follow the order the transfers will be submitted in, whichever thread signs them.
+    ewmLock (ewm);
+    for (size_t index = 0; index < transfersCount; index++) {
+        BREthereumTransaction transaction = transferGetOriginatingTransaction (transfers[index]);
+        if (TRANSACTION_NONCE_IS_NOT_ASSIGNED == transactionGetNonce (transaction))
+            transactionSetNonce (transaction,
+                                 accountGetThenIncrementAddressNonce (account, address));
+    }
+    ewmUnlock (ewm);
+
+    // Sign outside the lock; the transfers are the caller's until submitted.  The first run is
+    // signed on this thread.
+    size_t threadsCount = transfersCount / EWM_SIGN_TRANSFERS_PER_THREAD;
+    if (threadsCount > EWM_SIGN_THREADS_MAXIMUM) threadsCount = EWM_SIGN_THREADS_MAXIMUM;
+    if (threadsCount < 1) threadsCount = 1;
+
+    BREthereumEWMSignRun runs[threadsCount];
+    pthread_t threads[threadsCount];
+    int started[threadsCount];
+
+    for (size_t index = 0; index < threadsCount; index++) {
+        size_t offset = transfersCount * index / threadsCount;
+
+        runs[index] = (BREthereumEWMSignRun) {
+            &transfers[offset],
+            transfersCount * (index + 1) / threadsCount - offset,
+            ewm->network,
+            account,
+            address,
+            privateKey
+        };
+        started[index] = (index > 0 &&
+                          0 == pthread_create (&threads[index], NULL,
+                                               (void *(*) (void *)) ewmWalletSignTransfersThread,
+                                               &runs[index]));
+    }
+
+    for (size_t index = 0; index < threadsCount; index++)
+        if (!started[index]) ewmWalletSignTransfersThread (&runs[index]);
+
+    for (size_t index = 0; index < threadsCount; index++) {
+        if (started[index]) pthread_join (threads[index], NULL);
+        BRKeyClean (&runs[index].privateKey);
+    }
+
+    // Signing assigned each transfer's hash; re-index them.
+    ewmLock (ewm);
+    for (size_t index = 0; index < transfersCount; index++)
+        walletUpdateTransfer (wallet, transfers[index]);
+    ewmUnlock (ewm);
+
+    for (size_t index = 0; index < transfersCount; index++)
+        ewmWalletSignTransferAnnounce (ewm, wallet, transfers[index]);
+}
+
+extern void // status, error
+ewmWalletSignTransfersWithPaperKey (BREthereumEWM ewm,
+                                    BREthereumWallet wallet,
+                                    BREthereumTransfer *transfers,
+                                    size_t transfersCount,
+                                    const char *paperKey) {
+    // The BIP39 seed derivation is the costly part - 2048 PBKDF2 rounds - so derive once for all
+    // of `transfers`, and without holding the lock; the account never changes.
+    BRKey privateKey = accountGetPrimaryAddressPrivateKey (ewm->account, paperKey);
+
+    ewmWalletSignTransfers (ewm, wallet, transfers, transfersCount, privateKey);
+    BRKeyClean (&privateKey);
 }
 
 extern BREthereumTransfer *
 ewmWalletGetTransfers(BREthereumEWM ewm,
                       BREthereumWallet wallet) {
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
 
     unsigned long count = walletGetTransferCount(wallet);
     BREthereumTransfer *transfers = calloc (count + 1, sizeof (BREthereumTransfer));
@@ -1371,20 +1963,61 @@ ewmWalletGetTransfers(BREthereumEWM ewm,
         transfers [index] = walletGetTransferByIndex (wallet, index);
     transfers[count] = NULL;
 
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     return transfers;
 }
 
 extern int
 ewmWalletGetTransferCount(BREthereumEWM ewm,
                           BREthereumWallet wallet) {
-    int count = -1;
+    // Lock-free; the wallet publishes its count atomically.
+    return NULL == wallet ? -1 : (int) walletGetTransferCount(wallet);
+}
 
-    pthread_mutex_lock(&ewm->lock);
-    if (NULL != wallet) count = (int) walletGetTransferCount(wallet);
-    pthread_mutex_unlock(&ewm->lock);
+extern size_t
+ewmWalletGetTransferSummaries (BREthereumEWM ewm,
+                               BREthereumWallet wallet,
+                               size_t start,
+                               size_t count,
+                               BREthereumTransferSummary *summaries) {
+    ewmLock (ewm);
+
+    uint64_t blockHeight = ewmGetBlockHeight (ewm);
+    size_t total = walletGetTransferCount (wallet);
+    size_t filled = (start < total ? (count < total - start ? count : total - start) : 0);
+
+    for (size_t index = 0; index < filled; index++) {
+        BREthereumTransfer transfer = walletGetTransferByIndex (wallet, start + index);
+        BREthereumTransferSummary *summary = &summaries[index];
+        int overflow;
+
+        summary->transfer    = transfer;
+        summary->identifier  = transferGetIdentifier (transfer);
+        summary->source      = transferGetSourceAddress (transfer);
+        summary->target      = transferGetTargetAddress (transfer);
+        summary->amount      = transferGetAmount (transfer);
+        summary->fee         = transferGetFee (transfer, &overflow);
+        summary->feeBasis    = transferGetFeeBasis (transfer);
+        summary->nonce       = transferGetNonce (transfer);
+        summary->status      = transferGetStatus (transfer);
+        summary->isSubmitted = ewmTransferIsSubmitted (ewm, transfer);
+
+        if (transferExtractStatusIncluded (transfer, NULL,
+                                           &summary->blockNumber,
+                                           &summary->transactionIndex,
+                                           &summary->blockTimestamp,
+                                           NULL))
+            summary->blockConfirmations = blockHeight - summary->blockNumber;
+        else {
+            summary->blockNumber        = 0;
+            summary->transactionIndex   = 0;
+            summary->blockTimestamp     = TRANSACTION_STATUS_BLOCK_TIMESTAMP_UNKNOWN;
+            summary->blockConfirmations = 0;
+        }
+    }
 
-    return count;
+    ewmUnlock (ewm);
+    return filled;
 }
 
 extern BREthereumToken
@@ -1458,7 +2091,7 @@ extern void
 ewmHandleGasPrice (BREthereumEWM ewm,
                    BREthereumWallet wallet,
                    BREthereumGasPrice gasPrice) {
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     
     walletSetDefaultGasPrice(wallet, gasPrice);
     
@@ -1467,7 +2100,7 @@ ewmHandleGasPrice (BREthereumEWM ewm,
                                  WALLET_EVENT_DEFAULT_GAS_PRICE_UPDATED,
                                  SUCCESS, NULL);
     
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
 }
 
 
@@ -1484,7 +2117,7 @@ ewmHandleGasEstimate (BREthereumEWM ewm,
                       BREthereumWallet wallet,
                       BREthereumTransfer transfer,
                       BREthereumGas gasEstimate) {
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
     
     transferSetGasEstimate(transfer, gasEstimate);
     
@@ -1494,7 +2127,7 @@ ewmHandleGasEstimate (BREthereumEWM ewm,
                                       TRANSFER_EVENT_GAS_ESTIMATE_UPDATED,
                                       SUCCESS, NULL);
     
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
     
 }
 
@@ -1527,7 +2160,7 @@ ewmHandleBlockChain (BREthereumEWM ewm,
         eth_log ("EWM", "BlockChain: %" PRIu64, headBlockNumber);
 
     // At least this - allows for: ewmGetBlockHeight
-    ewm->blockHeight = headBlockNumber;
+    atomic_store (&ewm->blockHeight, headBlockNumber);
 
 #if defined (NEVER_DEFINED)
     // TODO: Need a 'block id' - or axe the need of 'block id'?
@@ -1549,7 +2182,7 @@ ewmHandleBlockChain (BREthereumEWM ewm,
 extern void
 ewmHandleAccountState (BREthereumEWM ewm,
                        BREthereumAccountState accountState) {
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
 
     eth_log("EWM", "AccountState: Nonce: %" PRIu64, accountState.nonce);
 
@@ -1558,13 +2191,13 @@ ewmHandleAccountState (BREthereumEWM ewm,
                            ETHEREUM_BOOLEAN_FALSE);
 
     ewmSignalBalance(ewm, amountCreateEther(accountState.balance));
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
 }
 
 extern void
 ewmHandleBalance (BREthereumEWM ewm,
                   BREthereumAmount amount) {
-    pthread_mutex_lock(&ewm->lock);
+    ewmLock (ewm);
 
     BREthereumWallet wallet = (AMOUNT_ETHER == amountGetType(amount)
                                ? ewmGetWallet(ewm)
@@ -1574,6 +2207,7 @@ ewmHandleBalance (BREthereumEWM ewm,
     
     if (ETHEREUM_COMPARISON_EQ != amountCompare(amount, walletGetBalance(wallet), &amountTypeMismatch)) {
         walletSetBalance(wallet, amount);
+        ewm->brdPoll.active = 1;
         ewmSignalWalletEvent (ewm,
                               wallet,
                               WALLET_EVENT_BALANCE_UPDATED,
@@ -1589,7 +2223,7 @@ ewmHandleBalance (BREthereumEWM ewm,
             free (amountAsString);
         }
     }
-    pthread_mutex_unlock(&ewm->lock);
+    ewmUnlock (ewm);
 }
 
 static int
@@ -1779,10 +2413,13 @@ ewmHandleTransaction (BREthereumEWM ewm,
             transactionSetStatus (original, transactionGetStatus(transaction));
 
         transferSetBasisForTransaction (transfer, transaction); // transaction ownership given
+        walletUpdateTransfer (wallet, transfer);
     }
 
-    if (needStatusEvent)
+    if (needStatusEvent) {
         ewmReportTransferStatusAsEvent(ewm, wallet, transfer);
+        ewmMarkWalletDirty (ewm, wallet);
+    }
 
     ewmHandleTransactionOriginatingLog (ewm, type, transaction);
 }
@@ -1814,8 +2451,12 @@ ewmHandleLog (BREthereumEWM ewm,
     BREthereumToken token = tokenLookupByAddress(logGetAddress(log));
     if (NULL == token) { logRelease(log); return;}
 
-    // TODO: Confirm LogTopic[0] is 'transfer'
-    if (3 != logGetTopicsCount(log)) { logRelease(log); return; }
+    // Confirm LogTopic[0] is 'transfer'
+    if (3 != logGetTopicsCount(log) ||
+        eventERC20Transfer != contractLookupEventForTopicBytes (contractERC20, logGetTopic(log, 0).bytes)) {
+        logRelease(log);
+        return;
+    }
 
     BREthereumWallet wallet = ewmGetWalletHoldingToken (ewm, token);
     assert (NULL != wallet);
@@ -1857,10 +2498,13 @@ ewmHandleLog (BREthereumEWM ewm,
 
         // Log becomes the new basis for transfer
         transferSetBasisForLog (transfer, log);  // log ownership given
+        walletUpdateTransfer (wallet, transfer);
     }
 
-    if (needStatusEvent)
+    if (needStatusEvent) {
         ewmReportTransferStatusAsEvent (ewm, wallet, transfer);
+        ewmMarkWalletDirty (ewm, wallet);
+    }
 }
 
 extern void
@@ -1873,6 +2517,8 @@ ewmHandleSaveBlocks (BREthereumEWM ewm,
 
     for (size_t index = 0; index < count; index++)
         fileServiceSave (ewm->fs, fileServiceTypeBlocks, blocks[index]);
+
+    headerStoreSave (ewm, blocks);
     array_free (blocks);
 }
 
@@ -1973,6 +2619,16 @@ ewmHandleGetBlocks (BREthereumEWM ewm,
 //
 // Periodic Dispatcher
 //
+extern void
+ewmMarkWalletDirty (BREthereumEWM ewm,
+                    BREthereumWallet wallet) {
+    ewm->brdPoll.active = 1;
+
+    for (size_t index = 0; index < array_count (ewm->brdPoll.dirty); index++)
+        if (wallet == ewm->brdPoll.dirty[index]) return;
+    array_add (ewm->brdPoll.dirty, wallet);
+}
+
 extern void
 ewmUpdateWalletBalance(BREthereumEWM ewm,
                        BREthereumWallet wallet) {
@@ -2010,6 +2666,57 @@ ewmUpdateWalletBalance(BREthereumEWM ewm,
     }
 }
 
+extern void
+ewmUpdateWalletBalances (BREthereumEWM ewm,
+                         BREthereumWallet *wallets,
+                         size_t count) {
+    if (0 == count) return;
+
+    // Without a batch handler, or if there is nothing a backend could batch, one at a time.
+    if (NULL == ewm->client.funcGetBalanceBatch ||
+        ETHEREUM_BOOLEAN_IS_FALSE(ewmIsConnected(ewm)) ||
+        (BRD_ONLY != ewm->mode && BRD_WITH_P2P_SEND != ewm->mode)) {
+        for (size_t index = 0; index < count; index++)
+            ewmUpdateWalletBalance (ewm, wallets[index]);
+        return;
+    }
+
+    BREthereumWallet wids[count];
+    const char *contracts[count];
+    size_t widsCount = 0;
+
+    for (size_t index = 0; index < count; index++) {
+        BREthereumWallet wallet = wallets[index];
+
+        if (NULL == wallet) {
+            ewmSignalWalletEvent(ewm, wallet, WALLET_EVENT_BALANCE_UPDATED,
+                                 ERROR_UNKNOWN_WALLET,
+                                 NULL);
+            continue;
+        }
+
+        BREthereumToken token = walletGetToken (wallet);
+
+        wids[widsCount]      = wallet;
+        contracts[widsCount] = (NULL == token ? NULL : tokenGetAddress (token));
+        widsCount++;
+    }
+
+    // All of an EWM's wallets share the one account address.
+    if (widsCount > 0) {
+        char *address = addressGetEncodedString(accountGetPrimaryAddress(ewm->account), 0);
+
+        ewm->client.funcGetBalanceBatch (ewm->client.context,
+                                         ewm,
+                                         wids,
+                                         contracts,
+                                         widsCount,
+                                         address,
+                                         ++ewm->requestId);
+        free (address);
+    }
+}
+
 static void
 ewmUpdateBlockNumber (BREthereumEWM ewm) {
     if (ETHEREUM_BOOLEAN_IS_FALSE(ewmIsConnected(ewm))) return;
@@ -2135,6 +2842,8 @@ ewmUpdateLogs (BREthereumEWM ewm,
 // transactions and logs) The event will be NULL (as specified for a 'period dispatcher' - See
 // `eventHandlerSetTimeoutDispatcher()`)
 //
+// While the account is idle, skip ever more ticks between queries; see `brdPoll`.
+//
 static void
 ewmPeriodicDispatcher (BREventHandler handler,
                        BREventTimeout *event) {
@@ -2143,12 +2852,45 @@ ewmPeriodicDispatcher (BREventHandler handler,
     if (ewm->state != LIGHT_NODE_CONNECTED) return;
     if (P2P_ONLY == ewm->mode || P2P_WITH_BRD_SYNC == ewm->mode) return;
 
-    ewmUpdateBlockNumber(ewm);
+    // Without activity since the last poll, wait out the interval...
+    if (!ewm->brdPoll.active && ewm->brdPoll.countdown > 1) {
+        ewm->brdPoll.countdown--;
+        return;
+    }
+    BR_TRACE_BEGIN (traceBegin);
+
+    // ... and then poll, backing off further unless there was activity.
+    if (ewm->brdPoll.active) ewm->brdPoll.interval = 1;
+    else if (2 * ewm->brdPoll.interval <= EWM_BRD_POLL_INTERVAL_MAXIMUM) ewm->brdPoll.interval *= 2;
+    else ewm->brdPoll.interval = EWM_BRD_POLL_INTERVAL_MAXIMUM;
+    ewm->brdPoll.countdown = ewm->brdPoll.interval;
+    ewm->brdPoll.active = 0;
+
+    // A block number pushed by the client is as good as one queried.
+    if (!ewm->brdPoll.headPushed) ewmUpdateBlockNumber(ewm);
+    ewm->brdPoll.headPushed = 0;
+
     ewmUpdateNonce(ewm);
 
-    // For all the known wallets, get their balance.
-    for (int i = 0; i < array_count(ewm->wallets); i++)
-        ewmUpdateWalletBalance (ewm, ewm->wallets[i]);
+    // Get the balance of the ETH wallet and of the wallets with activity; but, once in a while,
+    // get the balance for all the known wallets.
+    if (0 == ewm->brdPoll.refresh) {
+        ewmUpdateWalletBalances (ewm, ewm->wallets, array_count (ewm->wallets));
+        ewm->brdPoll.refresh = EWM_BRD_POLL_REFRESH;
+    }
+    else {
+        BREthereumWallet wallets[1 + array_count (ewm->brdPoll.dirty)];
+        size_t walletsCount = 0;
+
+        wallets[walletsCount++] = ewm->walletHoldingEther;
+        for (size_t index = 0; index < array_count (ewm->brdPoll.dirty); index++)
+            if (ewm->walletHoldingEther != ewm->brdPoll.dirty[index])
+                wallets[walletsCount++] = ewm->brdPoll.dirty[index];
+
+        ewmUpdateWalletBalances (ewm, wallets, walletsCount);
+    }
+    ewm->brdPoll.refresh--;
+    array_clear (ewm->brdPoll.dirty);
 
     // Handle a BRD Sync:
 
@@ -2156,17 +2898,28 @@ ewmPeriodicDispatcher (BREventHandler handler,
     if (ewm->brdSync.completedTransaction && ewm->brdSync.completedLog) {
         ewmSignalEWMEvent (ewm, EWM_EVENT_SYNC_STOPPED, SUCCESS, NULL);
 
-        // 1a) if so, advance the sync range by updating `begBlockNumber`
-        ewm->brdSync.begBlockNumber = (ewm->brdSync.endBlockNumber >=  EWM_BRD_SYNC_START_BLOCK_OFFSET
-                                       ? ewm->brdSync.endBlockNumber - EWM_BRD_SYNC_START_BLOCK_OFFSET
+        // 1a) if so, advance the sync range by updating `begBlockNumber` and, if the cursor
+        // moved, saving the cursor.
+        ewm->brdSync.begBlockNumber = (ewm->brdSync.endBlockNumber >= EWM_BRD_SYNC_OVERLAP
+                                       ? ewm->brdSync.endBlockNumber - EWM_BRD_SYNC_OVERLAP
                                        : 0);
+
+        if (ewm->brdSync.endBlockNumber > ewm->brdSync.cursorBlockNumber) {
+            BREthereumEWMBRDSyncCursor cursor = {
+                accountGetPrimaryAddress (ewm->account),
+                ewm->brdSync.endBlockNumber
+            };
+            fileServiceSave (ewm->fs, fileServiceTypeBRDSync, &cursor);
+            ewm->brdSync.cursorBlockNumber = ewm->brdSync.endBlockNumber;
+        }
     }
 
     // 2) completed or not, update the `endBlockNumber` to the current block height.
     ewm->brdSync.endBlockNumber = ewmGetBlockHeight(ewm);
 
-    // 3) if the `endBlockNumber` differs from the `begBlockNumber` then perform a 'sync'
-    if (ewm->brdSync.begBlockNumber != ewm->brdSync.endBlockNumber) {
+    // 3) if the `endBlockNumber` is past the `begBlockNumber` then perform a 'sync'.  (Until the
+    // block height is known, the `begBlockNumber` from a saved cursor can be past it.)
+    if (ewm->brdSync.begBlockNumber < ewm->brdSync.endBlockNumber) {
         ewmSignalEWMEvent (ewm, EWM_EVENT_SYNC_STARTED, SUCCESS, NULL);
 
         // 3a) We'll query all transactions for this ewm's account.  That will give us a shot at
@@ -2190,6 +2943,7 @@ ewmPeriodicDispatcher (BREventHandler handler,
     // End handling a BRD Sync
     
     if (NULL != ewm->bcs) bcsClean (ewm->bcs);
+    BR_TRACE_END (BRTraceEWMPoll, traceBegin, ewm->brdSync.endBlockNumber);
 }
 
 extern void
@@ -2492,6 +3246,18 @@ ewmTransferDelete (BREthereumEWM ewm,
                    BREthereumTransfer transfer) {
     if (NULL == transfer) return;
 
+    // A transfer signed but never submitted holds a nonce; release it so that it doesn't become
+    // a gap stalling every later transfer.
+    BREthereumTransaction transaction = transferGetOriginatingTransaction (transfer);
+    if (NULL != transaction &&
+        ETHEREUM_BOOLEAN_IS_TRUE (transferHasStatus (transfer, TRANSFER_STATUS_CREATED)) &&
+        TRANSACTION_NONCE_IS_NOT_ASSIGNED != transactionGetNonce (transaction) &&
+        ETHEREUM_BOOLEAN_IS_TRUE (addressEqual (transactionGetSourceAddress (transaction),
+                                                accountGetPrimaryAddress (ewm->account))))
+        accountReleaseAddressNonce (ewm->account,
+                                    accountGetPrimaryAddress (ewm->account),
+                                    transactionGetNonce (transaction));
+
     // Remove from any (and all - should be but one) wallet
     for (int wid = 0; wid < array_count(ewm->wallets); wid++) {
         BREthereumWallet wallet = ewm->wallets[wid];
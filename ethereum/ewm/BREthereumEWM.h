@@ -13,6 +13,7 @@
 
 #include "ethereum/blockchain/BREthereumNetwork.h"
 #include "ethereum/contract/BREthereumContract.h"
+#include "ethereum/blockchain/BREthereumLog.h"
 #include "BREthereumBase.h"
 #include "BREthereumAmount.h"
 #include "BREthereumClient.h"
@@ -105,6 +106,89 @@ extern void
 ewmUpdateBlockHeight(BREthereumEWM ewm,
                      uint64_t blockHeight);
 
+/// MARK: - Memory
+
+/**
+ * The bytes held by an EWM.  `wallets` includes `transfers`; `blockChain`, `orphans`,
+ * `transactions` and `logs` are those of BCS, as last counted by BCS (see bcsGetMemoryUsage());
+ * `nodes` is LES with its nodes' buffers; `events` is the EWM and BCS event handlers with their
+ * queues.
+ */
+typedef struct {
+    size_t wallets;
+    size_t transfers;
+    size_t blockChain;
+    size_t orphans;
+    size_t transactions;
+    size_t logs;
+    size_t nodes;
+    size_t coder;
+    size_t events;
+    size_t other;
+    size_t total;
+} BREthereumEWMMemory;
+
+/**
+ * Return the bytes held by `ewm`, so that a host running many EWMs can attribute memory to, and
+ * enforce a budget on, each of them.  A shared LES (see lesCreateShared()) is reported by each
+ * EWM that shares it.
+ */
+extern BREthereumEWMMemory
+ewmGetMemoryUsage (BREthereumEWM ewm);
+
+/// MARK: - Logs
+
+typedef void *BREthereumEWMLogQueryContext;
+
+/**
+ * The result of ewmQueryLogs(): the matching logs (a BRArrayOf(BREthereumLog)) which the callee
+ * must release with logsRelease().  Invoked once, on the BCS thread.
+ */
+typedef void
+(*BREthereumEWMLogQueryCallback) (BREthereumEWMLogQueryContext context,
+                                  BREthereumEWM ewm,
+                                  OwnershipGiven BREthereumLog *logs);
+
+/**
+ * Query the logs from `blockNumberStart` to `blockNumberStop` emitted by any of `addresses` with
+ * any of `topics`, as with `eth_getLogs` but answered from the block headers held locally and
+ * the receipts of just the matching blocks; see bcsQueryLogs().  This finds, for example, the
+ * historical transfers of a token without a full sync.
+ *
+ * @return FALSE, without a query, unless in P2P_ONLY or P2P_WITH_BRD_SYNC mode
+ */
+extern BREthereumBoolean
+ewmQueryLogs (BREthereumEWM ewm,
+              const BREthereumAddress *addresses,
+              size_t addressesCount,
+              const BREthereumLogTopic *topics,
+              size_t topicsCount,
+              uint64_t blockNumberStart,
+              uint64_t blockNumberStop,
+              BREthereumEWMLogQueryContext context,
+              BREthereumEWMLogQueryCallback callback);
+
+/// MARK: - Events
+
+/**
+ * Coalesce transfer events.  Rather than announcing each transfer event with the client's
+ * `funcTransferEvent`, gather the events announced within `windowInMilliseconds` of the first
+ * one and announce them, in order, with one call to `handler`.  A transfer event that repeats
+ * the latest gathered event for the same transfer (such as BLOCK_CONFIRMATIONS_UPDATED) replaces
+ * that event rather than being added.
+ *
+ * A `windowInMilliseconds` of zero announces any gathered events and restores one-by-one
+ * announcement with `funcTransferEvent`.
+ *
+ * @param ewm
+ * @param windowInMilliseconds
+ * @param handler required if windowInMilliseconds is not zero
+ */
+extern void
+ewmSetTransferEventCoalescing (BREthereumEWM ewm,
+                               unsigned int windowInMilliseconds,
+                               BREthereumClientHandlerTransferEvents handler);
+
 /// MARK: - Wallets
 
 extern BREthereumWallet *
@@ -134,6 +218,15 @@ extern void
 ewmUpdateWalletBalance(BREthereumEWM ewm,
                        BREthereumWallet wallet);
 
+/**
+ * Update the balance of each of `wallets`.  With a `funcGetBalanceBatch` client handler this is
+ * one client request; otherwise it is one request for each wallet.
+ */
+extern void
+ewmUpdateWalletBalances (BREthereumEWM ewm,
+                         BREthereumWallet *wallets,
+                         size_t count);
+
 extern BREthereumGas
 ewmWalletGetGasEstimate(BREthereumEWM ewm,
                         BREthereumWallet wallet,
@@ -175,6 +268,49 @@ extern int
 ewmWalletGetTransferCount(BREthereumEWM ewm,
                           BREthereumWallet wallet);
 
+/**
+ * A snapshot of a transfer's commonly displayed properties, as returned by the individual
+ * ewmTransferGet*() functions.  The `block*` and `transactionIndex` fields are as for a
+ * transfer that is not included (0, or an unknown timestamp) unless `status` is
+ * TRANSFER_STATUS_INCLUDED.
+ */
+typedef struct {
+    BREthereumTransfer transfer;
+    BREthereumHash identifier;
+    BREthereumAddress source;
+    BREthereumAddress target;
+    BREthereumAmount amount;
+    BREthereumEther fee;
+    BREthereumFeeBasis feeBasis;
+    uint64_t nonce;
+    BREthereumTransferStatus status;
+    BREthereumBoolean isSubmitted;
+    uint64_t blockNumber;
+    uint64_t transactionIndex;
+    uint64_t blockTimestamp;
+    uint64_t blockConfirmations;
+} BREthereumTransferSummary;
+
+/**
+ * Fill `summaries` with the summaries of up to `count` of wallet's transfers, from the transfer
+ * at `start` (in the order of ewmWalletGetTransfers()), taking the EWM lock once for all of them.
+ * Use this, instead of the per-transfer getters, when displaying many transfers.
+ *
+ * @param ewm
+ * @param wallet
+ * @param start the index of the first transfer
+ * @param count the number of summaries that fit in `summaries`
+ * @param summaries the caller's array to fill
+ *
+ * @return the number of summaries filled; fewer than `count` at the wallet's last transfer.
+ */
+extern size_t
+ewmWalletGetTransferSummaries (BREthereumEWM ewm,
+                               BREthereumWallet wallet,
+                               size_t start,
+                               size_t count,
+                               BREthereumTransferSummary *summaries);
+
 
 extern BREthereumTransfer
 ewmWalletCreateTransfer(BREthereumEWM ewm,
@@ -215,6 +351,29 @@ ewmWalletSignTransferWithPaperKey(BREthereumEWM ewm,
                                   BREthereumTransfer transfer,
                                   const char *paperKey);
 
+/**
+ * Sign each of `transfers`, all in `wallet`, with `privateKey`.  Unassigned nonces are assigned
+ * in `transfers` order; the signing itself is spread over a few threads and done without holding
+ * the EWM lock.  A TRANSFER_EVENT_SIGNED is announced for each transfer.
+ */
+extern void // status, error
+ewmWalletSignTransfers (BREthereumEWM ewm,
+                        BREthereumWallet wallet,
+                        BREthereumTransfer *transfers,
+                        size_t transfersCount,
+                        BRKey privateKey);
+
+/**
+ * As ewmWalletSignTransfers() but with the private key derived from `paperKey` - once, for all
+ * of `transfers`.
+ */
+extern void // status, error
+ewmWalletSignTransfersWithPaperKey (BREthereumEWM ewm,
+                                    BREthereumWallet wallet,
+                                    BREthereumTransfer *transfers,
+                                    size_t transfersCount,
+                                    const char *paperKey);
+
 extern void // status, error
 ewmWalletSubmitTransfer(BREthereumEWM ewm,
                         BREthereumWallet wid,
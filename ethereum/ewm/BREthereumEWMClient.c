@@ -11,6 +11,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <assert.h>
+#include <time.h>
 #include <pthread.h>
 #include "support/BRArray.h"
 #include "BREthereumEWMPrivate.h"
@@ -61,9 +63,20 @@ ewmAnnounceWalletBalance (BREthereumEWM ewm,
 //
 // Default Wallet Gas Price
 //
+
+/**
+ * The number of blocks within which a transaction at the default gas price should be included.
+ */
+#define EWM_GAS_PRICE_TARGET_BLOCKS     (3)
+
 extern void
 ewmUpdateGasPrice (BREthereumEWM ewm,
                                 BREthereumWallet wallet) {
+    // Once enough of our submitted transactions have been included, BCS knows a gas price that
+    // works - use it rather than asking the client.
+    BREthereumGasPrice estimate = gasPriceCreate (etherCreateZero());
+    if (NULL != ewm->bcs)
+        estimate = bcsGetGasPriceEstimate (ewm->bcs, EWM_GAS_PRICE_TARGET_BLOCKS);
 
     if (NULL == wallet) {
         ewmSignalWalletEvent(ewm, wallet, WALLET_EVENT_DEFAULT_GAS_PRICE_UPDATED,
@@ -74,6 +87,8 @@ ewmUpdateGasPrice (BREthereumEWM ewm,
         ewmSignalWalletEvent(ewm, wallet, WALLET_EVENT_DEFAULT_GAS_PRICE_UPDATED,
                                      ERROR_NODE_NOT_CONNECTED,
                                      NULL);
+    } else if (!UInt256IsZero (estimate.etherPerGas.valueInWEI)) {
+        ewmSignalGasPrice (ewm, wallet, estimate);
     } else {
         switch (ewm->mode) {
             case BRD_ONLY:
@@ -174,6 +189,69 @@ ewmUpdateGasEstimate (BREthereumEWM ewm,
     }
 }
 
+extern void
+ewmUpdateGasEstimates (BREthereumEWM ewm,
+                       BREthereumWallet wallet,
+                       BREthereumTransfer *transfers,
+                       size_t count) {
+    if (0 == count) return;
+
+    // Without a batch handler, or if there is nothing a backend could batch, one at a time.
+    if (NULL == ewm->client.funcEstimateGasBatch ||
+        ETHEREUM_BOOLEAN_IS_FALSE(ewmIsConnected(ewm)) ||
+        (BRD_ONLY != ewm->mode && BRD_WITH_P2P_SEND != ewm->mode)) {
+        for (size_t index = 0; index < count; index++)
+            ewmUpdateGasEstimate (ewm, wallet, transfers[index]);
+        return;
+    }
+
+    BREthereumTransfer tids[count];
+    char *froms[count], *tos[count], *amounts[count];
+    const char *datas[count];
+    size_t tidsCount = 0;
+
+    for (size_t index = 0; index < count; index++) {
+        BREthereumTransfer transfer = transfers[index];
+
+        if (NULL == transfer) {
+            ewmSignalTransferEvent(ewm, wallet, transfer,
+                                   TRANSFER_EVENT_GAS_ESTIMATE_UPDATED,
+                                   ERROR_UNKNOWN_WALLET,
+                                   NULL);
+            continue;
+        }
+
+        // As in ewmUpdateGasEstimate(); ZERO if transaction amount is in TOKEN.
+        BREthereumEther amountInEther = transferGetEffectiveAmountInEther(transfer);
+        BREthereumTransaction transaction = transferGetOriginatingTransaction(transfer);
+
+        tids[tidsCount]    = transfer;
+        froms[tidsCount]   = addressGetEncodedString(transferGetSourceAddress(transfer), 1);
+        tos[tidsCount]     = addressGetEncodedString(transactionGetTargetAddress(transaction), 0);
+        amounts[tidsCount] = coerceStringPrefaced(amountInEther.valueInWEI, 16, "0x");
+        datas[tidsCount]   = transactionGetData(transaction);
+        tidsCount++;
+    }
+
+    if (tidsCount > 0)
+        ewm->client.funcEstimateGasBatch (ewm->client.context,
+                                          ewm,
+                                          wallet,
+                                          tids,
+                                          (const char **) froms,
+                                          (const char **) tos,
+                                          (const char **) amounts,
+                                          datas,
+                                          tidsCount,
+                                          ++ewm->requestId);
+
+    for (size_t index = 0; index < tidsCount; index++) {
+        free (froms[index]);
+        free (tos[index]);
+        free (amounts[index]);
+    }
+}
+
 extern void
 ewmHandleAnnounceGasEstimate (BREthereumEWM ewm,
                                     BREthereumWallet wallet,
@@ -231,6 +309,43 @@ ewmAnnounceBlockNumber (BREthereumEWM ewm,
     return SUCCESS;
 }
 
+// ==============================================================================================
+//
+// Activity
+//
+/**
+ * Handle a Client push of activity: for `wallet`, if not NULL; otherwise, of a new head at
+ * `blockNumber`.  Wallet activity has the next periodic tick poll, including for the wallet's
+ * balance; a new head saves the next poll querying the block number.
+ */
+extern void
+ewmHandleAnnounceActivity (BREthereumEWM ewm,
+                           BREthereumWallet wallet,
+                           uint64_t blockNumber) {
+    if (NULL != wallet)
+        ewmMarkWalletDirty (ewm, wallet);
+    else {
+        ewmUpdateBlockHeight (ewm, blockNumber);
+        ewm->brdPoll.headPushed = 1;
+    }
+}
+
+extern BREthereumStatus
+ewmAnnounceNewHead (BREthereumEWM ewm,
+                    const char *strBlockNumber) {
+    uint64_t blockNumber = strtoull(strBlockNumber, NULL, 0);
+    ewmSignalAnnounceActivity (ewm, NULL, blockNumber);
+    return SUCCESS;
+}
+
+extern BREthereumStatus
+ewmAnnounceWalletActivity (BREthereumEWM ewm,
+                           BREthereumWallet wallet) {
+    if (NULL == wallet) { return ERROR_UNKNOWN_WALLET; }
+    ewmSignalAnnounceActivity (ewm, wallet, 0);
+    return SUCCESS;
+}
+
 // ==============================================================================================
 //
 // Get Nonce
@@ -262,6 +377,8 @@ ewmHandleAnnounceNonce (BREthereumEWM ewm,
                               int rid) {
     //    BREthereumEncodedAddress address = accountGetPrimaryAddress (ewmGetAccount(ewm));
     //    assert (ETHEREUM_BOOLEAN_IS_TRUE (addressHasString(address, strAddress)));
+    if (nonce != accountGetAddressNonce (ewm->account, accountGetPrimaryAddress(ewm->account)))
+        ewm->brdPoll.active = 1;
     accountSetAddressNonce(ewm->account, accountGetPrimaryAddress(ewm->account), nonce, ETHEREUM_BOOLEAN_FALSE);
 }
 
@@ -501,6 +618,196 @@ ewmAnnounceLogComplete (BREthereumEWM ewm,
     ewmSignalAnnounceComplete (ewm, ETHEREUM_BOOLEAN_FALSE, success, id);
 }
 
+// ==============================================================================================
+//
+// Get Transactions and Logs, in Bulk
+//
+
+/**
+ * Return TRUE (non-zero) if `wallet` has a transfer identified by `hash` with `status`, whereby
+ * announcing it again would change nothing.
+ */
+static int
+ewmHasTransferWithStatus (BREthereumWallet wallet,
+                          BREthereumHash hash,
+                          BREthereumTransactionStatus status) {
+    BREthereumTransfer transfer = walletGetTransferByIdentifier (wallet, hash);
+    return (NULL != transfer &&
+            ETHEREUM_BOOLEAN_IS_TRUE (transactionStatusEqual (status, transferGetStatusForBasis (transfer))));
+}
+
+/**
+ * Handle a Client Announcement of transactions and logs in bulk.  As ewmHandleAnnounceTransaction()
+ * and ewmHandleAnnounceLog() for each, except that known transfers with an unchanged status are
+ * skipped and that the changes are saved in one batch.
+ */
+extern void
+ewmHandleAnnounceTransfers (BREthereumEWM ewm,
+                            BREthereumEWMClientAnnounceTransfersBundle *bundle,
+                            int id) {
+    size_t transactionsCount = array_count (bundle->transactions);
+    size_t logsCount = array_count (bundle->logs);
+    size_t skippedCount = 0;
+
+    switch (ewm->mode) {
+        case BRD_ONLY:
+        case BRD_WITH_P2P_SEND: {
+            BREthereumWallet wallet = ewmGetWallet (ewm);
+
+            fileServiceBeginBatch (ewm->fs);
+
+            for (size_t index = 0; index < transactionsCount; index++) {
+                BREthereumClientTransactionRecord *record = &bundle->transactions[index];
+
+                BREthereumTransactionStatus status = transactionStatusCreateIncluded (record->blockHash,
+                                                                                      record->blockNumber,
+                                                                                      record->blockTransactionIndex,
+                                                                                      record->blockTimestamp,
+                                                                                      gasCreate(record->gasUsed));
+
+                if (ewmHasTransferWithStatus (wallet, record->hash, status)) { skippedCount++; continue; }
+
+                // As for ewmAnnounceTransaction(), `data` is a '0x' prefaced hex string.
+                size_t dataLength = encodeHexLength (record->dataLength);
+                char *data = malloc (2 + dataLength);
+                data[0] = '0'; data[1] = 'x';
+                encodeHex (&data[2], dataLength, record->data, record->dataLength);
+
+                BREthereumTransaction transaction = transactionCreate (record->from,
+                                                                       record->to,
+                                                                       etherCreate(record->amount),
+                                                                       gasPriceCreate(etherCreate(record->gasPrice)),
+                                                                       gasCreate(record->gasLimit),
+                                                                       data,
+                                                                       record->nonce);
+                free (data);
+
+                // See ewmHandleAnnounceTransaction() regarding the hash.
+                transactionSetHash (transaction, record->hash);
+                transactionSetStatus (transaction, status);
+
+                ewmHandleTransaction (ewm, BCS_CALLBACK_TRANSACTION_UPDATED, transaction);
+            }
+
+            for (size_t index = 0; index < logsCount; index++) {
+                BREthereumClientLogRecord *record = &bundle->logs[index];
+
+                // A log of an unknown token is skipped by ewmHandleLog(); skip it here and now.
+                BREthereumToken token = tokenLookupByAddress (record->contract);
+                if (NULL == token) { skippedCount++; continue; }
+
+                assert (record->logIndex <= (uint64_t) SIZE_MAX);
+                BREthereumHash hash = logHashCreate (record->hash, (size_t) record->logIndex);
+
+                BREthereumTransactionStatus status = transactionStatusCreateIncluded (hashCreateEmpty(),
+                                                                                      record->blockNumber,
+                                                                                      record->blockTransactionIndex,
+                                                                                      record->blockTimestamp,
+                                                                                      gasCreate(record->gasUsed));
+
+                if (ewmHasTransferWithStatus (ewmGetWalletHoldingToken (ewm, token), hash, status)) {
+                    skippedCount++;
+                    continue;
+                }
+
+                BREthereumLogTopic topics [CLIENT_LOG_RECORD_TOPICS_MAXIMUM];
+                for (size_t topic = 0; topic < record->topicsCount; topic++)
+                    memcpy (topics[topic].bytes, record->topics[topic].bytes, sizeof (topics[topic].bytes));
+
+                // As for ewmHandleAnnounceLog(), log->data is the RLP encoding of the numeric value.
+                UInt256 value = UINT256_ZERO;
+                for (size_t byte = 0; byte < record->dataLength; byte++)
+                    value.u8[byte] = record->data[record->dataLength - 1 - byte];
+
+                BRRlpItem  item  = rlpEncodeUInt256 (ewm->coder, value, 1);
+
+                BREthereumLog log = logCreate (record->contract,
+                                               (unsigned int) record->topicsCount,
+                                               topics,
+                                               rlpGetDataSharedDontRelease(ewm->coder, item));
+                rlpReleaseItem (ewm->coder, item);
+
+                logInitializeIdentifier (log, record->hash, (size_t) record->logIndex);
+                logSetStatus (log, status);
+
+                ewmHandleLog (ewm, BCS_CALLBACK_LOG_UPDATED, log);
+            }
+
+            fileServiceEndBatch (ewm->fs);
+            break;
+        }
+
+        case P2P_WITH_BRD_SYNC:
+        case P2P_ONLY:
+            for (size_t index = 0; index < transactionsCount; index++)
+                bcsSendTransactionRequest (ewm->bcs,
+                                           bundle->transactions[index].hash,
+                                           bundle->transactions[index].blockNumber,
+                                           bundle->transactions[index].blockTransactionIndex);
+
+            for (size_t index = 0; index < logsCount; index++)
+                bcsSendLogRequest (ewm->bcs,
+                                   bundle->logs[index].hash,
+                                   bundle->logs[index].blockNumber,
+                                   bundle->logs[index].blockTransactionIndex);
+            break;
+    }
+
+    eth_log ("EWM", "Announce: %zu Transactions, %zu Logs (%zu Skipped)",
+             transactionsCount, logsCount, skippedCount);
+
+    ewmClientAnnounceTransfersBundleRelease (bundle);
+}
+
+extern BREthereumStatus
+ewmAnnounceTransactionsAndLogs (BREthereumEWM ewm,
+                                int id,
+                                const BREthereumClientTransactionRecord *transactions,
+                                size_t transactionsCount,
+                                const BREthereumClientLogRecord *logs,
+                                size_t logsCount) {
+    size_t dataLength = 0;
+
+    for (size_t index = 0; index < transactionsCount; index++)
+        dataLength += transactions[index].dataLength;
+
+    // As in ewmHandleAnnounceLog(), the log's `data` must be a numeric value.
+    for (size_t index = 0; index < logsCount; index++) {
+        if (logs[index].topicsCount > CLIENT_LOG_RECORD_TOPICS_MAXIMUM ||
+            logs[index].dataLength  > sizeof (UInt256)) { return ERROR_NUMERIC_PARSE; }
+        dataLength += logs[index].dataLength;
+    }
+
+    BREthereumEWMClientAnnounceTransfersBundle *bundle = malloc (sizeof (BREthereumEWMClientAnnounceTransfersBundle));
+
+    array_new (bundle->transactions, transactionsCount);
+    array_add_array (bundle->transactions, transactions, transactionsCount);
+
+    array_new (bundle->logs, logsCount);
+    array_add_array (bundle->logs, logs, logsCount);
+
+    // Copy every record's `data` into one allocation owned by `bundle`.
+    bundle->data = malloc (0 == dataLength ? 1 : dataLength);
+    uint8_t *data = bundle->data;
+
+    for (size_t index = 0; index < transactionsCount; index++) {
+        if (0 != transactions[index].dataLength)
+            memcpy (data, transactions[index].data, transactions[index].dataLength);
+        bundle->transactions[index].data = data;
+        data += transactions[index].dataLength;
+    }
+
+    for (size_t index = 0; index < logsCount; index++) {
+        if (0 != logs[index].dataLength)
+            memcpy (data, logs[index].data, logs[index].dataLength);
+        bundle->logs[index].data = data;
+        data += logs[index].dataLength;
+    }
+
+    ewmSignalAnnounceTransfers (ewm, bundle, id);
+    return SUCCESS;
+}
+
 // ==============================================================================================
 //
 // Announce {Transactions, Logs} Complete
@@ -799,6 +1106,14 @@ ewmHandleBlockEvent(BREthereumEWM ewm,
 }
 #endif
 
+static void
+ewmPendTransferEvent (BREthereumEWM ewm,
+                      BREthereumWallet wallet,
+                      BREthereumTransfer transfer,
+                      BREthereumTransferEvent event,
+                      BREthereumStatus status,
+                      const char *errorDescription);
+
 static int
 ewmNeedTransferSave (BREthereumEWM ewm,
                      BREthereumTransferEvent event) {
@@ -853,14 +1168,151 @@ ewmHandleTransferEvent (BREthereumEWM ewm,
         }
     }
 
-    // Announce the transfer
-    ewm->client.funcTransferEvent (ewm->client.context,
-                                   ewm,
-                                   wallet,
-                                   transfer,
-                                   event,
-                                   status,
-                                   errorDescription);
+    // Announce the transfer, perhaps coalesced with others
+    if (0 != ewm->transferEvents.window)
+        ewmPendTransferEvent (ewm, wallet, transfer, event, status, errorDescription);
+    else
+        ewm->client.funcTransferEvent (ewm->client.context,
+                                       ewm,
+                                       wallet,
+                                       transfer,
+                                       event,
+                                       status,
+                                       errorDescription);
+}
+
+//
+// Transfer Event Coalescing
+//
+typedef struct BREthereumEWMTransferEventLatestRecord {
+    BREthereumTransfer tid;
+    size_t index;           // of the latest event for `tid` in `transferEvents.events`
+} BREthereumEWMTransferEventLatest;
+
+static inline size_t
+ewmTransferEventLatestHashValue (const void *latest) {
+    return (size_t) ((const BREthereumEWMTransferEventLatest *) latest)->tid;
+}
+
+static inline int
+ewmTransferEventLatestHashEqual (const void *latest1, const void *latest2) {
+    return ((const BREthereumEWMTransferEventLatest *) latest1)->tid ==
+           ((const BREthereumEWMTransferEventLatest *) latest2)->tid;
+}
+
+static void
+ewmTransferEventLatestRelease (void *info, void *latest) {
+    free (latest);
+}
+
+static void
+ewmTransferEventsAlarm (BREventAlarmContext context,
+                        struct timespec expiration,
+                        BREventAlarmClock clock) {
+    ewmSignalTransferEventsFlush ((BREthereumEWM) context);
+}
+
+static void
+ewmPendTransferEvent (BREthereumEWM ewm,
+                      BREthereumWallet wallet,
+                      BREthereumTransfer transfer,
+                      BREthereumTransferEvent event,
+                      BREthereumStatus status,
+                      const char *errorDescription) {
+    BREthereumClientTransferEvent record = { wallet, transfer, event, status, errorDescription };
+
+    // If this event repeats the transfer's latest event, replace it.
+    BREthereumEWMTransferEventLatest key = { transfer, 0 };
+    BREthereumEWMTransferEventLatest *latest = BRSetGet (ewm->transferEvents.latest, &key);
+
+    if (NULL != latest && event == ewm->transferEvents.events[latest->index].event)
+        ewm->transferEvents.events[latest->index] = record;
+    else {
+        if (NULL == latest) {
+            latest = malloc (sizeof (BREthereumEWMTransferEventLatest));
+            latest->tid = transfer;
+            BRSetAdd (ewm->transferEvents.latest, latest);
+        }
+        latest->index = array_count (ewm->transferEvents.events);
+        array_add (ewm->transferEvents.events, record);
+    }
+
+    // Without a running alarm clock there is no window; announce now.
+    if (!alarmClockIsRunning (alarmClock))
+        ewmHandleTransferEventsFlush (ewm);
+
+    // Otherwise the first event in a window starts the window.
+    else if (ALARM_ID_NONE == ewm->transferEvents.alarm) {
+        struct timespec expiration;
+        clock_gettime (CLOCK_REALTIME, &expiration);
+
+        uint64_t nanoseconds = (uint64_t) expiration.tv_nsec + 1000000ull * ewm->transferEvents.window;
+        expiration.tv_sec  += nanoseconds / 1000000000ull;
+        expiration.tv_nsec  = nanoseconds % 1000000000ull;
+
+        ewm->transferEvents.alarm = alarmClockAddAlarm (alarmClock, ewm, ewmTransferEventsAlarm, expiration);
+    }
+}
+
+extern void
+ewmHandleTransferEventsFlush (BREthereumEWM ewm) {
+    ewmLock (ewm);
+
+    // An early flush ends the window; its alarm would otherwise flush whatever is next pended.
+    if (ALARM_ID_NONE != ewm->transferEvents.alarm)
+        alarmClockRemAlarm (alarmClock, ewm->transferEvents.alarm);
+    ewm->transferEvents.alarm = ALARM_ID_NONE;
+
+    size_t eventsCount = (NULL == ewm->transferEvents.events ? 0 : array_count (ewm->transferEvents.events));
+    if (0 != eventsCount) {
+        BRArrayOf(BREthereumClientTransferEvent) events = ewm->transferEvents.events;
+
+        // Start the next window before announcing; the handler might create transfers.
+        array_new (ewm->transferEvents.events, eventsCount);
+        BRSetApply (ewm->transferEvents.latest, NULL, ewmTransferEventLatestRelease);
+        BRSetClear (ewm->transferEvents.latest);
+
+        ewm->transferEvents.handler (ewm->client.context, ewm, events, eventsCount);
+        array_free (events);
+    }
+    ewmUnlock (ewm);
+}
+
+extern void
+ewmSetTransferEventCoalescing (BREthereumEWM ewm,
+                               unsigned int windowInMilliseconds,
+                               BREthereumClientHandlerTransferEvents handler) {
+    assert (0 == windowInMilliseconds || NULL != handler);
+
+    ewmLock (ewm);
+    if (0 == windowInMilliseconds) ewmHandleTransferEventsFlush (ewm);
+
+    if (NULL == ewm->transferEvents.events)
+        array_new (ewm->transferEvents.events, 100);
+    if (NULL == ewm->transferEvents.latest)
+        ewm->transferEvents.latest = BRSetNew (ewmTransferEventLatestHashValue,
+                                               ewmTransferEventLatestHashEqual,
+                                               100);
+
+    ewm->transferEvents.window  = windowInMilliseconds;
+    ewm->transferEvents.handler = handler;
+    ewmUnlock (ewm);
+}
+
+extern void
+ewmTransferEventsRelease (BREthereumEWM ewm) {
+    if (ALARM_ID_NONE != ewm->transferEvents.alarm)
+        alarmClockRemAlarm (alarmClock, ewm->transferEvents.alarm);
+    ewm->transferEvents.alarm = ALARM_ID_NONE;
+
+    if (NULL != ewm->transferEvents.latest) {
+        BRSetFreeAll (ewm->transferEvents.latest, free);
+        ewm->transferEvents.latest = NULL;
+    }
+    if (NULL != ewm->transferEvents.events) {
+        array_free (ewm->transferEvents.events);
+        ewm->transferEvents.events = NULL;
+    }
 }
 
 extern void
@@ -992,15 +1444,15 @@ ewmSignalTransactionEvent(ewm, wid, tid,
 #if 0 // Log
 BREthereumTransactionId tid = -1;
 
-pthread_mutex_lock(&ewm->lock);
+ewmLock (ewm);
 
 // Token of interest
 BREthereumToken token = tokenLookupByAddress(bundle->contract);
-if (NULL == token) { pthread_mutex_unlock(&ewm->lock); return; } // uninteresting token
+if (NULL == token) { ewmUnlock (ewm); return; } // uninteresting token
 
 // Event of interest
 BREthereumContractEvent event = contractLookupEventForTopic (contractERC20, bundle->arrayTopics[0]);
-if (NULL == event || event != eventERC20Transfer) { pthread_mutex_unlock(&ewm->lock); return; }; // uninteresting event
+if (NULL == event || event != eventERC20Transfer) { ewmUnlock (ewm); return; }; // uninteresting event
 
 BREthereumBlock block = NULL;
 //    BREthereumBlock block = ewmLookupBlockByHash(ewm, bundle->blockHash);
@@ -1082,7 +1534,7 @@ ewmSignalTransactionEvent(ewm, wid, tid,
                                 NULL);
 
 // Hmmmm...
-pthread_mutex_unlock(&ewm->lock);
+ewmUnlock (ewm);
 #endif
 
 
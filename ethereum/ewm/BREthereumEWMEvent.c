@@ -13,8 +13,22 @@
 
 /*!
  * Define the Events handled on the EWM's Main queue.
+ *
+ * Events for the results of user actions - submits, balances, gas and nonces - are queued with
+ * EVENT_PRIORITY_HIGH.  Bulk events - saves and BRD sync announcements - are queued with
+ * EVENT_PRIORITY_LOW; an 'Announce Complete' event is too, so as to follow the announcements
+ * it completes.
+ *
+ * Events that supersede prior ones - a block chain head, an account state, a balance - coalesce,
+ * keyed by what they are for; only the newest pending one of each key is handled.
  */
 
+// Coalesce any two events of one type
+static uintptr_t
+ewmEventCoalescerSingle (const BREvent *event) {
+    return 0;
+}
+
 // ==============================================================================================
 //
 // Handle Block Chain
@@ -39,7 +53,10 @@ ewmHandleBlockChainEventDispatcher(BREventHandler ignore,
 BREventType handleBlockChainEventType = {
     "EWM: Handle BlockChain Event",
     sizeof (BREthereumHandleBlockChainEvent),
-    (BREventDispatcher) ewmHandleBlockChainEventDispatcher
+    (BREventDispatcher) ewmHandleBlockChainEventDispatcher,
+    NULL,
+    EVENT_PRIORITY_NORMAL,
+    ewmEventCoalescerSingle
 };
 
 extern void
@@ -75,7 +92,10 @@ ewmHandleAccountStateEventDispatcher(BREventHandler ignore,
 BREventType handleAccountStateEventType = {
     "EWM: Handle AccountState Event",
     sizeof (BREthereumHandleAccountStateEvent),
-    (BREventDispatcher) ewmHandleAccountStateEventDispatcher
+    (BREventDispatcher) ewmHandleAccountStateEventDispatcher,
+    NULL,
+    EVENT_PRIORITY_NORMAL,
+    ewmEventCoalescerSingle
 };
 
 extern void
@@ -101,10 +121,21 @@ ewmHandleBalanceEventDispatcher(BREventHandler ignore,
     ewmHandleBalance(event->ewm, event->amount);
 }
 
+// Coalesce by wallet - as the token, or NULL for ETH.
+static uintptr_t
+ewmHandleBalanceEventCoalescer (BREthereumHandleBalanceEvent *event) {
+    return (AMOUNT_ETHER == amountGetType (event->amount)
+            ? 0
+            : (uintptr_t) amountGetToken (event->amount));
+}
+
 BREventType handleBalanceEventType = {
     "EWM: Handle Balance Event",
     sizeof (BREthereumHandleBalanceEvent),
-    (BREventDispatcher) ewmHandleBalanceEventDispatcher
+    (BREventDispatcher) ewmHandleBalanceEventDispatcher,
+    NULL,
+    EVENT_PRIORITY_HIGH,
+    (BREventCoalescer) ewmHandleBalanceEventCoalescer
 };
 
 extern void
@@ -134,7 +165,9 @@ ewmHandleGasPriceEventDispatcher(BREventHandler ignore,
 BREventType handleGasPriceEventType = {
     "EWM: Handle GasPrice Event",
     sizeof (BREthereumHandleGasPriceEvent),
-    (BREventDispatcher) ewmHandleGasPriceEventDispatcher
+    (BREventDispatcher) ewmHandleGasPriceEventDispatcher,
+    NULL,
+    EVENT_PRIORITY_HIGH
 };
 
 extern void
@@ -166,7 +199,9 @@ ewmHandleGasEstimateEventDispatcher(BREventHandler ignore,
 BREventType handleGasEstimateEventType = {
     "EWM: Handle GasEstimate Event",
     sizeof (BREthereumHandleGasEstimateEvent),
-    (BREventDispatcher) ewmHandleGasEstimateEventDispatcher
+    (BREventDispatcher) ewmHandleGasEstimateEventDispatcher,
+    NULL,
+    EVENT_PRIORITY_HIGH
 };
 
 extern void
@@ -278,7 +313,8 @@ BREventType handleSaveBlocksEventType = {
     "EWM: Handle SaveBlocks Event",
     sizeof (BREthereumHandleSaveBlocksEvent),
     (BREventDispatcher) ewmHandleSaveBlocksEventDispatcher,
-    (BREventDestroyer) ewmHandleSaveBlocksEventDestroyer
+    (BREventDestroyer) ewmHandleSaveBlocksEventDestroyer,
+    EVENT_PRIORITY_LOW
 };
 
 extern void
@@ -307,7 +343,9 @@ ewmHandleSaveNodesEventDispatcher(BREventHandler ignore,
 BREventType handleSaveNodesEventType = {
     "EWM: Handle SaveNodes Event",
     sizeof (BREthereumHandleSaveNodesEvent),
-    (BREventDispatcher) ewmHandleSaveNodesEventDispatcher
+    (BREventDispatcher) ewmHandleSaveNodesEventDispatcher,
+    NULL,
+    EVENT_PRIORITY_LOW
 };
 
 extern void
@@ -516,6 +554,33 @@ static BREventType ewmClientTransactionEventType = {
     (BREventDispatcher) ewmClientTransactionEventDispatcher
 };
 
+//
+// Transfer Events Flush - announce the coalesced transfer events
+//
+typedef struct {
+    struct BREventRecord base;
+    BREthereumEWM ewm;
+} BREthereumEWMClientTransferEventsFlushEvent;
+
+static void
+ewmClientTransferEventsFlushDispatcher(BREventHandler ignore,
+                                       BREthereumEWMClientTransferEventsFlushEvent *event) {
+    ewmHandleTransferEventsFlush(event->ewm);
+}
+
+static BREventType ewmClientTransferEventsFlushEventType = {
+    "EMW: Client Transfer Events Flush Event",
+    sizeof (BREthereumEWMClientTransferEventsFlushEvent),
+    (BREventDispatcher) ewmClientTransferEventsFlushDispatcher
+};
+
+extern void
+ewmSignalTransferEventsFlush (BREthereumEWM ewm) {
+    BREthereumEWMClientTransferEventsFlushEvent message =
+    { { NULL, &ewmClientTransferEventsFlushEventType }, ewm };
+    eventHandlerSignalEvent(ewm->handler, (BREvent*) &message);
+}
+
 extern void
 ewmSignalTransferEvent(BREthereumEWM ewm,
                              BREthereumWallet wid,
@@ -627,7 +692,10 @@ ewmSignalAnnounceBlockNumberDispatcher (BREventHandler ignore,
 static BREventType ewmClientAnnounceBlockNumberEventType = {
     "EWM: Client Announce Block Number Event",
     sizeof (BREthereumEWMClientAnnounceBlockNumberEvent),
-    (BREventDispatcher) ewmSignalAnnounceBlockNumberDispatcher
+    (BREventDispatcher) ewmSignalAnnounceBlockNumberDispatcher,
+    NULL,
+    EVENT_PRIORITY_NORMAL,
+    ewmEventCoalescerSingle
 };
 
 extern void
@@ -639,6 +707,37 @@ ewmSignalAnnounceBlockNumber (BREthereumEWM ewm,
     eventHandlerSignalEvent (ewm->handler, (BREvent*) &message);
 }
 
+//
+// Announce Activity
+//
+typedef struct {
+    struct BREventRecord base;
+    BREthereumEWM ewm;
+    BREthereumWallet wallet;
+    uint64_t blockNumber;
+} BREthereumEWMClientAnnounceActivityEvent;
+
+static void
+ewmSignalAnnounceActivityDispatcher (BREventHandler ignore,
+                                     BREthereumEWMClientAnnounceActivityEvent *event) {
+    ewmHandleAnnounceActivity(event->ewm, event->wallet, event->blockNumber);
+}
+
+static BREventType ewmClientAnnounceActivityEventType = {
+    "EWM: Client Announce Activity Event",
+    sizeof (BREthereumEWMClientAnnounceActivityEvent),
+    (BREventDispatcher) ewmSignalAnnounceActivityDispatcher
+};
+
+extern void
+ewmSignalAnnounceActivity (BREthereumEWM ewm,
+                           BREthereumWallet wallet,
+                           uint64_t blockNumber) {
+    BREthereumEWMClientAnnounceActivityEvent message =
+    { { NULL, &ewmClientAnnounceActivityEventType}, ewm, wallet, blockNumber};
+    eventHandlerSignalEvent (ewm->handler, (BREvent*) &message);
+}
+
 //
 // Announce Nonce
 //
@@ -659,7 +758,9 @@ ewmSignalAnnounceNonceDispatcher (BREventHandler ignore,
 static BREventType ewmClientAnnounceNonceEventType = {
     "EWM: Client Announce Block Number Event",
     sizeof (BREthereumEWMClientAnnounceNonceEvent),
-    (BREventDispatcher) ewmSignalAnnounceNonceDispatcher
+    (BREventDispatcher) ewmSignalAnnounceNonceDispatcher,
+    NULL,
+    EVENT_PRIORITY_HIGH
 };
 
 extern void
@@ -689,10 +790,18 @@ ewmSignalAnnounceBalanceDispatcher (BREventHandler ignore,
     ewmHandleAnnounceBalance(event->ewm, event->wallet, event->value, event->rid);
 }
 
+static uintptr_t
+ewmSignalAnnounceBalanceCoalescer (BREthereumEWMClientAnnounceBalanceEvent *event) {
+    return (uintptr_t) event->wallet;
+}
+
 static BREventType ewmClientAnnounceBalanceEventType = {
     "EWM: Client Announce Balance Event",
     sizeof (BREthereumEWMClientAnnounceBalanceEvent),
-    (BREventDispatcher) ewmSignalAnnounceBalanceDispatcher
+    (BREventDispatcher) ewmSignalAnnounceBalanceDispatcher,
+    NULL,
+    EVENT_PRIORITY_HIGH,
+    (BREventCoalescer) ewmSignalAnnounceBalanceCoalescer
 };
 
 extern void
@@ -725,7 +834,9 @@ ewmSignalAnnounceGasPriceDispatcher (BREventHandler ignore,
 static BREventType ewmClientAnnounceGasPriceEventType = {
     "EWM: Client Announce GasPrice Event",
     sizeof (BREthereumEWMClientAnnounceGasPriceEvent),
-    (BREventDispatcher) ewmSignalAnnounceGasPriceDispatcher
+    (BREventDispatcher) ewmSignalAnnounceGasPriceDispatcher,
+    NULL,
+    EVENT_PRIORITY_HIGH
 };
 
 extern void
@@ -759,7 +870,9 @@ ewmSignalAnnounceGasEstimateDispatcher (BREventHandler ignore,
 static BREventType ewmClientAnnounceGasEstimateEventType = {
     "EWM: Client Announce GasEstimate Event",
     sizeof (BREthereumEWMClientAnnounceGasEstimateEvent),
-    (BREventDispatcher) ewmSignalAnnounceGasEstimateDispatcher
+    (BREventDispatcher) ewmSignalAnnounceGasEstimateDispatcher,
+    NULL,
+    EVENT_PRIORITY_HIGH
 };
 
 extern void
@@ -803,7 +916,8 @@ static BREventType ewmClientAnnounceSubmitTransferEventType = {
     "EWM: Client Announce SubmitTransfer Event",
     sizeof (BREthereumEWMClientAnnounceSubmitTransferEvent),
     (BREventDispatcher) ewmSignalAnnounceSubmitTransferDispatcher,
-    (BREventDestroyer) ewmSignalAnnounceSubmitTransferDestroyer
+    (BREventDestroyer) ewmSignalAnnounceSubmitTransferDestroyer,
+    EVENT_PRIORITY_HIGH
 };
 
 extern void
@@ -846,7 +960,8 @@ static BREventType ewmClientAnnounceTransactionEventType = {
     "EWM: Client Announce Transaction Event",
     sizeof (BREthereumEWMClientAnnounceTransactionEvent),
     (BREventDispatcher) ewmSignalAnnounceTransactionDispatcher,
-    (BREventDestroyer) ewmSignalAnnounceTransactionDestroyer
+    (BREventDestroyer) ewmSignalAnnounceTransactionDestroyer,
+    EVENT_PRIORITY_LOW
 };
 
 extern void
@@ -858,6 +973,44 @@ ewmSignalAnnounceTransaction(BREthereumEWM ewm,
     eventHandlerSignalEvent (ewm->handler, (BREvent*) &message);
 }
 
+//
+// Announce Transfers (Transactions and Logs, in Bulk)
+//
+typedef struct {
+    struct BREventRecord base;
+    BREthereumEWM ewm;
+    BREthereumEWMClientAnnounceTransfersBundle *bundle;
+    int rid;
+} BREthereumEWMClientAnnounceTransfersEvent;
+
+static void
+ewmSignalAnnounceTransfersDispatcher (BREventHandler ignore,
+                                      BREthereumEWMClientAnnounceTransfersEvent *event) {
+    ewmHandleAnnounceTransfers(event->ewm, event->bundle, event->rid);
+}
+
+static void
+ewmSignalAnnounceTransfersDestroyer (BREthereumEWMClientAnnounceTransfersEvent *event) {
+    ewmClientAnnounceTransfersBundleRelease(event->bundle);
+}
+
+static BREventType ewmClientAnnounceTransfersEventType = {
+    "EWM: Client Announce Transfers Event",
+    sizeof (BREthereumEWMClientAnnounceTransfersEvent),
+    (BREventDispatcher) ewmSignalAnnounceTransfersDispatcher,
+    (BREventDestroyer) ewmSignalAnnounceTransfersDestroyer,
+    EVENT_PRIORITY_LOW
+};
+
+extern void
+ewmSignalAnnounceTransfers (BREthereumEWM ewm,
+                            BREthereumEWMClientAnnounceTransfersBundle *bundle,
+                            int rid) {
+    BREthereumEWMClientAnnounceTransfersEvent message =
+    { { NULL, &ewmClientAnnounceTransfersEventType}, ewm, bundle, rid};
+    eventHandlerSignalEvent (ewm->handler, (BREvent*) &message);
+}
+
 //
 // Announce Log
 //
@@ -883,7 +1036,8 @@ static BREventType ewmClientAnnounceLogEventType = {
     "EWM: Client Announce Log Event",
     sizeof (BREthereumEWMClientAnnounceLogEvent),
     (BREventDispatcher) ewmSignalAnnounceLogDispatcher,
-    (BREventDestroyer) ewmSignalAnnounceLogDestroyer
+    (BREventDestroyer) ewmSignalAnnounceLogDestroyer,
+    EVENT_PRIORITY_LOW
 };
 
 extern void
@@ -915,7 +1069,9 @@ ewmSignalAnnounceCompleteDispatcher (BREventHandler ignore,
 static BREventType ewmClientAnnounceCompleteEventType = {
     "EWM: Client Announce Complete Event",
     sizeof (BREthereumEWMClientAnnounceCompleteEvent),
-    (BREventDispatcher) ewmSignalAnnounceCompleteDispatcher
+    (BREventDispatcher) ewmSignalAnnounceCompleteDispatcher,
+    NULL,
+    EVENT_PRIORITY_LOW
 };
 
 extern void
@@ -1016,15 +1172,18 @@ const BREventType *ewmEventTypes[] = {
     &ewmClientWalletEventType,
     //    &ewmClientBlockEventType,
     &ewmClientTransactionEventType,
+    &ewmClientTransferEventsFlushEventType,
     &ewmClientPeerEventType,
     &ewmClientEWMEventType,
     &ewmClientAnnounceBlockNumberEventType,
+    &ewmClientAnnounceActivityEventType,
     &ewmClientAnnounceNonceEventType,
     &ewmClientAnnounceBalanceEventType,
     &ewmClientAnnounceGasPriceEventType,
     &ewmClientAnnounceGasEstimateEventType,
     &ewmClientAnnounceSubmitTransferEventType,
     &ewmClientAnnounceTransactionEventType,
+    &ewmClientAnnounceTransfersEventType,
     &ewmClientAnnounceLogEventType,
     &ewmClientAnnounceCompleteEventType,
     &ewmClientAnnounceTokenEventType,
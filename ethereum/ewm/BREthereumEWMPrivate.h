@@ -12,11 +12,14 @@
 #define BR_Ethereum_EWM_Private_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include "support/BRFileService.h"
+#include "support/BRStats.h"
 #include "ethereum/blockchain/BREthereumBlockChain.h"
 #include "ethereum/les/BREthereumLES.h"
 #include "ethereum/bcs/BREthereumBCS.h"
 #include "ethereum/event/BREvent.h"
+#include "ethereum/event/BREventAlarm.h"
 #include "BREthereumTransfer.h"
 #include "BREthereumWallet.h"
 #include "BREthereumEWM.h"
@@ -58,6 +61,14 @@ extern void
 ewmInsertWallet (BREthereumEWM ewm,
                  BREthereumWallet wallet);
 
+/**
+ * Note activity for `wallet` so that, in the BRD modes, the next periodic tick polls and queries
+ * the wallet's balance.  Must hold the EWM lock.
+ */
+extern void
+ewmMarkWalletDirty (BREthereumEWM ewm,
+                    BREthereumWallet wallet);
+
 //
 // EWM
 //
@@ -94,6 +105,12 @@ struct BREthereumEWMRecord {
     BREthereumWallet *wallets;
     BREthereumWallet  walletHoldingEther;
 
+    /**
+     * The TOKEN wallets, indexed by token, so that token discovery for a log is O(1) rather than
+     * a search through `wallets`.  Holds `struct BREthereumEWMTokenWalletRecord`; see EWM.c
+     */
+    BRSet *walletsByToken;
+
     /**
      * The BCS Interface
      */
@@ -103,8 +120,11 @@ struct BREthereumEWMRecord {
      * The BlockHeight is the largest block number seen or computed.  [Note: the blockHeight may
      * be computed from a Log event as (log block number + log confirmations).  This is the block
      * number for the block at the head of the blockchain.
+     *
+     * Atomic so that `ewmGetBlockHeight()` need not take `lock`, which is held while events are
+     * handled.
      */
-    uint64_t blockHeight;
+    _Atomic uint64_t blockHeight;
 
     /**
      * An identiifer for a LES/BRD Request
@@ -121,6 +141,13 @@ struct BREthereumEWMRecord {
      */
     pthread_mutex_t lock;
 
+    /**
+     * The depth of ewmLock() holds and when the outermost began, for instrumentation.  Guarded by
+     * `lock`; the event handler takes `lock` directly, without them.
+     */
+    unsigned int lockDepth;
+    uint64_t lockTime;
+
     /**
      * The RLP Coder
      */
@@ -131,6 +158,11 @@ struct BREthereumEWMRecord {
      */
     BRFileService fs;
 
+    /**
+     * The path to the Header Store - block headers, back to a CHT root, as fixed-size records.
+     */
+    char *headerStorePath;
+
     /**
      * If we are syncing with BRD, instead of as P2P with BCS, then we'll keep a record to
      * ensure we've successfully completed the getTransactions() and getLogs() callbacks to
@@ -140,12 +172,43 @@ struct BREthereumEWMRecord {
         uint64_t begBlockNumber;
         uint64_t endBlockNumber;
 
+        // The block number through which a sync completed, as saved in the file service.
+        uint64_t cursorBlockNumber;
+
         int ridTransaction;
         int ridLog;
 
         int completedTransaction:1;
         int completedLog:1;
     } brdSync;
+
+    /**
+     * In the BRD modes the periodic dispatcher polls adaptively.  While the account is idle the
+     * number of ticks between polls doubles, up to a maximum; any activity - including activity
+     * pushed by the client - has the next tick poll.  A poll queries the balance of the ETH wallet
+     * and of the `dirty` wallets only, but every so many polls it queries every wallet's balance.
+     * See ewmPeriodicDispatcher()
+     */
+    struct {
+        unsigned int interval;      // ticks between polls
+        unsigned int countdown;     // ticks until the next poll
+        unsigned int refresh;       // polls until every wallet's balance is queried
+        int active;                 // activity since the last poll
+        int headPushed;             // the client pushed the block number since the last poll
+        BRArrayOf(BREthereumWallet) dirty;
+    } brdPoll;
+
+    /**
+     * If coalescing transfer events, the events gathered in the current window along with, for
+     * each transfer, the index of its latest event in `events`.  See ewmSetTransferEventCoalescing()
+     */
+    struct {
+        unsigned int window;    // milliseconds; zero if not coalescing
+        BREthereumClientHandlerTransferEvents handler;
+        BRArrayOf(BREthereumClientTransferEvent) events;
+        BRSet *latest;          // of `struct BREthereumEWMTransferEventLatestRecord *`
+        BREventAlarmId alarm;
+    } transferEvents;
 };
 
 /// MARK: - BCS Callback Interfaces
@@ -450,6 +513,32 @@ ewmHandleAnnounceLog (BREthereumEWM ewm,
                             BREthereumEWMClientAnnounceLogBundle *bundle,
                             int id);
 
+/// MARK: - Transactions and Logs, in Bulk
+
+typedef struct {
+    BRArrayOf(BREthereumClientTransactionRecord) transactions;
+    BRArrayOf(BREthereumClientLogRecord) logs;
+    uint8_t *data;          // holds the `data` of every record
+} BREthereumEWMClientAnnounceTransfersBundle;
+
+static inline void
+ewmClientAnnounceTransfersBundleRelease (BREthereumEWMClientAnnounceTransfersBundle *bundle) {
+    array_free (bundle->transactions);
+    array_free (bundle->logs);
+    free (bundle->data);
+    free (bundle);
+}
+
+extern void
+ewmSignalAnnounceTransfers (BREthereumEWM ewm,
+                            BREthereumEWMClientAnnounceTransfersBundle *bundle,
+                            int id);
+
+extern void
+ewmHandleAnnounceTransfers (BREthereumEWM ewm,
+                            BREthereumEWMClientAnnounceTransfersBundle *bundle,
+                            int id);
+
 /// MARK: - Account Complete
 
 extern void
@@ -514,6 +603,18 @@ ewmSignalAnnounceBlockNumber (BREthereumEWM ewm,
                                     uint64_t blockNumber,
                                     int rid);
 
+/// MARK: - Activity
+
+extern void
+ewmHandleAnnounceActivity (BREthereumEWM ewm,
+                           BREthereumWallet wallet,
+                           uint64_t blockNumber);
+
+extern void
+ewmSignalAnnounceActivity (BREthereumEWM ewm,
+                           BREthereumWallet wallet,
+                           uint64_t blockNumber);
+
 /// MARK: - Nonce
 
 extern void
@@ -587,6 +688,15 @@ ewmHandleTransferEvent(BREthereumEWM ewm,
                              BREthereumTransferEvent event,
                              BREthereumStatus status,
                              const char *errorDescription);
+
+extern void
+ewmSignalTransferEventsFlush (BREthereumEWM ewm);
+
+extern void
+ewmHandleTransferEventsFlush (BREthereumEWM ewm);
+
+extern void
+ewmTransferEventsRelease (BREthereumEWM ewm);
 //
 // Peer Event
 //
@@ -341,6 +341,28 @@ transferRelease (BREthereumTransfer transfer) {
     free (transfer);
 }
 
+extern size_t
+transferGetMemoryUsage (BREthereumTransfer transfer) {
+    size_t usage = sizeof (struct BREthereumTransferRecord);
+
+    if (NULL != transfer->originatingTransaction)
+        usage += transactionGetMemoryUsage (transfer->originatingTransaction);
+
+    switch (transfer->basis.type) {
+        case TRANSFER_BASIS_TRANSACTION:
+            if (NULL != transfer->basis.u.transaction)
+                usage += transactionGetMemoryUsage (transfer->basis.u.transaction);
+            break;
+
+        case TRANSFER_BASIS_LOG:
+            if (NULL != transfer->basis.u.log)
+                usage += logGetMemoryUsage (transfer->basis.u.log);
+            break;
+    }
+
+    return usage;
+}
+
 extern BREthereumAddress
 transferGetSourceAddress (BREthereumTransfer transfer) {
     return transfer->sourceAddress;
@@ -424,7 +446,7 @@ transferSign (BREthereumTransfer transfer,
                              accountGetThenIncrementAddressNonce(account, address));
     
     // RLP Encode the UNSIGNED transfer
-    BRRlpCoder coder = rlpCoderCreate();
+    BRRlpCoder coder = rlpCoderCreateCached();
     BRRlpItem item = transactionRlpEncode (transfer->originatingTransaction,
                                            network,
                                            RLP_TYPE_TRANSACTION_UNSIGNED,
@@ -452,7 +474,7 @@ transferSign (BREthereumTransfer transfer,
                         hashCreateFromData (rlpGetDataSharedDontRelease (coder, item)));
 
     rlpReleaseItem(coder, item);
-    rlpCoderRelease(coder);
+    rlpCoderReleaseCached(coder);
 }
 
 extern void
@@ -467,7 +489,7 @@ transferSignWithKey (BREthereumTransfer transfer,
                              accountGetThenIncrementAddressNonce(account, address));
     
     // RLP Encode the UNSIGNED transfer
-    BRRlpCoder coder = rlpCoderCreate();
+    BRRlpCoder coder = rlpCoderCreateCached();
     BRRlpItem item = transactionRlpEncode (transfer->originatingTransaction,
                                            network,
                                            RLP_TYPE_TRANSACTION_UNSIGNED,
@@ -496,7 +518,7 @@ transferSignWithKey (BREthereumTransfer transfer,
                         hashCreateFromData (rlpGetDataSharedDontRelease (coder, item)));
 
     rlpReleaseItem(coder, item);
-    rlpCoderRelease(coder);
+    rlpCoderReleaseCached(coder);
 }
 
 /**
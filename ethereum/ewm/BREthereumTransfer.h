@@ -73,6 +73,12 @@ transferCreateWithLog (OwnershipGiven BREthereumLog log,
 extern void
 transferRelease (BREthereumTransfer transfer);
 
+/**
+ * Return the bytes held by `transfer`, including its originating transaction and its basis.
+ */
+extern size_t
+transferGetMemoryUsage (BREthereumTransfer transfer);
+
 extern BREthereumAddress
 transferGetSourceAddress (BREthereumTransfer transfer);
 
@@ -11,7 +11,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <stdatomic.h>
 #include "support/BRArray.h"
+#include "support/BRSet.h"
 #include "BREthereumWallet.h"
 #include "BREthereumTransfer.h"
 
@@ -20,6 +22,32 @@
 
 #define DEFAULT_TRANSFER_CAPACITY     20
 
+/**
+ * A transfer's index entry records the keys under which the transfer is currently indexed.  The
+ * transfer's own identifier, originating hash and nonce can change (as the transfer is signed,
+ * or gains a basis) and the entry is how we find the old keys to remove.
+ */
+typedef struct {
+    BREthereumTransfer transfer;
+    BREthereumHash identifier;          // EMPTY_HASH_INIT if none
+    BREthereumHash originatingHash;     // EMPTY_HASH_INIT if none
+    BREthereumAddress source;
+    uint64_t nonce;                     // TRANSACTION_NONCE_IS_NOT_ASSIGNED if none
+    unsigned int sharedKeys;            // WALLET_TRANSFER_KEY_* held here but shared with another
+} BREthereumWalletTransferEntry;
+
+#define WALLET_TRANSFER_KEY_IDENTIFIER      (1 << 0)
+#define WALLET_TRANSFER_KEY_ORIGINATING     (1 << 1)
+#define WALLET_TRANSFER_KEY_NONCE           (1 << 2)
+
+static void
+walletIndexTransfer (BREthereumWallet wallet,
+                     BREthereumTransfer transfer);
+
+static void
+walletUnindexTransfer (BREthereumWallet wallet,
+                       BREthereumTransfer transfer);
+
 /* Forward Declarations */
 static BREthereumGasPrice
 walletCreateDefaultGasPrice (BREthereumWallet wallet);
@@ -78,8 +106,13 @@ struct BREthereumWalletRecord {
     
     /**
      * The wallet's balance, either ETHER or a TOKEN.
+     *
+     * The balance is read without the EWM lock, so it is published with a sequence lock: the
+     * (single) writer makes `balanceSequence` odd while writing; readers retry until they see
+     * the same even sequence before and after their copy.
      */
     BREthereumAmount balance;
+    _Atomic unsigned int balanceSequence;
     
     /**
      * An optional ERC20 token specification.  Will be NULL (and unused) for holding ETHER.
@@ -106,19 +139,76 @@ struct BREthereumWalletRecord {
      *
      * FOR NOW, WE'LL ASSUME: ONE HASH <==> ONE TRANSFER (transaction or log)
      *
-     * Given a hash, to find a corresponding transfers we'll iterate through `transfers` and
-     * compare: a) the hash for the originating transaction, if it exists, b) the hash for the
-     * basis, if it exists.  If the basis is a log, we'll extranct the transaction hash and compare
-     * that.
-     *
-     * We might consider:
-     *   BRSetOf (BRArrayOf ({hash, transfer}) transfersByHashPairs;
-     * which would speed lookup of a transfer.
-     *
+     * Given a hash, to find a corresponding transfer we use the `transfersBy*` indices below,
+     * rather than iterating through `transfers`.
      */
     BRArrayOf (BREthereumTransfer) transfers;
+
+    /**
+     * The count of `transfers`, published for lock-free readers.
+     */
+    _Atomic size_t transferCount;
+
+    /**
+     * One entry per transfer in `transfers`, keyed by the transfer itself.  The entries are
+     * owned by this set; the remaining sets share them, keyed by the entries' fields.  Whenever a
+     * transfer's identifier, originating hash or nonce changes, the transfer must be re-indexed
+     * with `walletUpdateTransfer()`.
+     */
+    BRSetOf (BREthereumWalletTransferEntry*) transferEntries;
+    BRSetOf (BREthereumWalletTransferEntry*) transfersByIdentifier;
+    BRSetOf (BREthereumWalletTransferEntry*) transfersByOriginatingHash;
+    BRSetOf (BREthereumWalletTransferEntry*) transfersByNonce; // {source, nonce}
 };
 
+//
+// Transfer Entry - BRSet Support
+//
+static inline size_t
+transferEntryHashValue (const void *entry) {
+    return (size_t) ((const BREthereumWalletTransferEntry *) entry)->transfer;
+}
+
+static inline int
+transferEntryHashEqual (const void *entry1, const void *entry2) {
+    return ((const BREthereumWalletTransferEntry *) entry1)->transfer ==
+           ((const BREthereumWalletTransferEntry *) entry2)->transfer;
+}
+
+static inline size_t
+transferEntryIdentifierHashValue (const void *entry) {
+    return hashSetValue (&((const BREthereumWalletTransferEntry *) entry)->identifier);
+}
+
+static inline int
+transferEntryIdentifierHashEqual (const void *entry1, const void *entry2) {
+    return hashSetEqual (&((const BREthereumWalletTransferEntry *) entry1)->identifier,
+                         &((const BREthereumWalletTransferEntry *) entry2)->identifier);
+}
+
+static inline size_t
+transferEntryOriginatingHashValue (const void *entry) {
+    return hashSetValue (&((const BREthereumWalletTransferEntry *) entry)->originatingHash);
+}
+
+static inline int
+transferEntryOriginatingHashEqual (const void *entry1, const void *entry2) {
+    return hashSetEqual (&((const BREthereumWalletTransferEntry *) entry1)->originatingHash,
+                         &((const BREthereumWalletTransferEntry *) entry2)->originatingHash);
+}
+
+static inline size_t
+transferEntryNonceHashValue (const void *entry) {
+    const BREthereumWalletTransferEntry *e = entry;
+    return (size_t) addressHashValue (e->source) + (size_t) e->nonce;
+}
+
+static inline int
+transferEntryNonceHashEqual (const void *entry1, const void *entry2) {
+    const BREthereumWalletTransferEntry *e1 = entry1, *e2 = entry2;
+    return e1->nonce == e2->nonce && ETHEREUM_BOOLEAN_IS_TRUE (addressEqual (e1->source, e2->source));
+}
+
 //
 // Wallet Creation
 //
@@ -152,7 +242,22 @@ walletCreateDetailed (BREthereumAccount account,
     ? walletCreateDefaultGasPrice(wallet)
     : tokenGetGasPrice (optionalToken);
     
+    atomic_init (&wallet->balanceSequence, 0);
+
     array_new(wallet->transfers, DEFAULT_TRANSFER_CAPACITY);
+    atomic_init (&wallet->transferCount, 0);
+    wallet->transferEntries            = BRSetNew (transferEntryHashValue,
+                                                   transferEntryHashEqual,
+                                                   DEFAULT_TRANSFER_CAPACITY);
+    wallet->transfersByIdentifier      = BRSetNew (transferEntryIdentifierHashValue,
+                                                   transferEntryIdentifierHashEqual,
+                                                   DEFAULT_TRANSFER_CAPACITY);
+    wallet->transfersByOriginatingHash = BRSetNew (transferEntryOriginatingHashValue,
+                                                   transferEntryOriginatingHashEqual,
+                                                   DEFAULT_TRANSFER_CAPACITY);
+    wallet->transfersByNonce           = BRSetNew (transferEntryNonceHashValue,
+                                                   transferEntryNonceHashEqual,
+                                                   DEFAULT_TRANSFER_CAPACITY);
     return wallet;
 }
 
@@ -184,9 +289,32 @@ walletRelease (BREthereumWallet wallet) {
     for (size_t index = 0; index < array_count(wallet->transfers); index++)
         transferRelease (wallet->transfers[index]);
     array_free(wallet->transfers);
+
+    BRSetFree (wallet->transfersByNonce);
+    BRSetFree (wallet->transfersByOriginatingHash);
+    BRSetFree (wallet->transfersByIdentifier);
+    BRSetFreeAll (wallet->transferEntries, free);
     free (wallet);
 }
 
+extern size_t
+walletGetMemoryUsage (BREthereumWallet wallet,
+                      size_t *transfersUsage) {
+    size_t transfers = 0;
+    for (size_t index = 0; index < array_count(wallet->transfers); index++)
+        transfers += transferGetMemoryUsage (wallet->transfers[index]);
+    if (NULL != transfersUsage) *transfersUsage = transfers;
+
+    return (sizeof (struct BREthereumWalletRecord) +
+            transfers +
+            array_heap_size (wallet->transfers) +
+            BRSetCount (wallet->transferEntries) * sizeof (BREthereumWalletTransferEntry) +
+            BRSetMemoryUsage (wallet->transferEntries) +
+            BRSetMemoryUsage (wallet->transfersByIdentifier) +
+            BRSetMemoryUsage (wallet->transfersByOriginatingHash) +
+            BRSetMemoryUsage (wallet->transfersByNonce));
+}
+
 extern void
 walletsRelease (OwnershipGiven BRArrayOf(BREthereumWallet) wallets) {
     if (NULL != wallets) {
@@ -285,6 +413,8 @@ private_extern void
 walletHandleTransfer(BREthereumWallet wallet,
                      BREthereumTransfer transfer) {
     walletInsertTransferSorted (wallet, transfer);
+    walletIndexTransfer (wallet, transfer);
+    atomic_store (&wallet->transferCount, array_count (wallet->transfers));
 }
 
 private_extern void
@@ -293,12 +423,23 @@ walletUnhandleTransfer (BREthereumWallet wallet,
     int index = walletLookupTransferIndex (wallet, transfer);
     assert (-1 != index);
     array_rm(wallet->transfers, index);
+    walletUnindexTransfer (wallet, transfer);
+    atomic_store (&wallet->transferCount, array_count (wallet->transfers));
 }
 
 private_extern int
 walletHasTransfer (BREthereumWallet wallet,
                    BREthereumTransfer transfer) {
-    return -1 != walletLookupTransferIndex (wallet, transfer);
+    BREthereumWalletTransferEntry probe = { transfer };
+    return NULL != BRSetGet (wallet->transferEntries, &probe);
+}
+
+private_extern void
+walletUpdateTransfer (BREthereumWallet wallet,
+                      BREthereumTransfer transfer) {
+    if (!walletHasTransfer (wallet, transfer)) return;
+    walletUnindexTransfer (wallet, transfer);
+    walletIndexTransfer (wallet, transfer);
 }
 
 //
@@ -321,6 +462,7 @@ walletSignTransfer (BREthereumWallet wallet,
                   wallet->account,
                   wallet->address,
                   paperKey);
+    walletUpdateTransfer (wallet, transfer);
 }
 
 /**
@@ -339,6 +481,7 @@ walletSignTransferWithPrivateKey (BREthereumWallet wallet,
                          wallet->account,
                          wallet->address,
                          privateKey);
+    walletUpdateTransfer (wallet, transfer);
 }
 
 //
@@ -364,13 +507,28 @@ walletGetToken (BREthereumWallet wallet) {
 
 extern BREthereumAmount
 walletGetBalance (BREthereumWallet wallet) {
-    return wallet->balance;
+    BREthereumAmount balance;
+    unsigned int sequence;
+
+    do {
+        sequence = atomic_load_explicit (&wallet->balanceSequence, memory_order_acquire);
+        balance  = wallet->balance;
+        atomic_thread_fence (memory_order_acquire);
+    } while ((sequence & 1) ||
+             sequence != atomic_load_explicit (&wallet->balanceSequence, memory_order_relaxed));
+
+    return balance;
 }
 
 private_extern void
 walletSetBalance (BREthereumWallet wallet,
                   BREthereumAmount balance) {
+    unsigned int sequence = atomic_load_explicit (&wallet->balanceSequence, memory_order_relaxed);
+
+    atomic_store_explicit (&wallet->balanceSequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence (memory_order_release);
     wallet->balance = balance;
+    atomic_store_explicit (&wallet->balanceSequence, sequence + 2, memory_order_release);
 }
 
 private_extern void
@@ -409,10 +567,10 @@ walletUpdateBalance (BREthereumWallet wallet) {
 
     if (AMOUNT_ETHER == amountGetType(wallet->balance)) {
         balance = subUInt256_Negative(balance, fees, &negative);
-        wallet->balance = amountCreateEther (etherCreate(balance));
+        walletSetBalance (wallet, amountCreateEther (etherCreate(balance)));
     }
     else
-        wallet->balance = amountCreateToken (createTokenQuantity(amountGetToken (wallet->balance), balance));
+        walletSetBalance (wallet, amountCreateToken (createTokenQuantity(amountGetToken (wallet->balance), balance)));
 }
 // Gas Limit
 
@@ -490,34 +648,30 @@ walletGetTransferByIdentifier (BREthereumWallet wallet,
                                BREthereumHash hash) {
     if (ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (hash, EMPTY_HASH_INIT))) return NULL;
 
-    for (int i = 0; i < array_count(wallet->transfers); i++) {
-        BREthereumHash identifier = transferGetIdentifier (wallet->transfers[i]);
-        if (ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (hash, identifier)))
-            return wallet->transfers[i];
-    }
-    return NULL;
+    BREthereumWalletTransferEntry probe = { NULL, hash };
+    BREthereumWalletTransferEntry *entry = BRSetGet (wallet->transfersByIdentifier, &probe);
+    return NULL == entry ? NULL : entry->transfer;
 }
 
 extern BREthereumTransfer
 walletGetTransferByOriginatingHash (BREthereumWallet wallet,
                                     BREthereumHash hash) {
-    for (int i = 0; i < array_count(wallet->transfers); i++) {
-        BREthereumTransaction transaction = transferGetOriginatingTransaction (wallet->transfers[i]);
-        if (NULL != transaction && ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (hash, transactionGetHash (transaction))))
-            return wallet->transfers[i];
-    }
-    return NULL;
+    if (ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (hash, EMPTY_HASH_INIT))) return NULL;
+
+    BREthereumWalletTransferEntry probe = { .originatingHash = hash };
+    BREthereumWalletTransferEntry *entry = BRSetGet (wallet->transfersByOriginatingHash, &probe);
+    return NULL == entry ? NULL : entry->transfer;
 }
 
 extern BREthereumTransfer
 walletGetTransferByNonce(BREthereumWallet wallet,
                          BREthereumAddress sourceAddress,
                          uint64_t nonce) {
-    for (int i = 0; i < array_count(wallet->transfers); i++)
-        if (nonce == transferGetNonce (wallet->transfers[i])
-            && ETHEREUM_BOOLEAN_IS_TRUE(addressEqual(sourceAddress, transferGetSourceAddress(wallet->transfers[i]))))
-            return wallet->transfers [i];
-    return NULL;
+    if (TRANSACTION_NONCE_IS_NOT_ASSIGNED == nonce) return NULL;
+
+    BREthereumWalletTransferEntry probe = { .source = sourceAddress, .nonce = nonce };
+    BREthereumWalletTransferEntry *entry = BRSetGet (wallet->transfersByNonce, &probe);
+    return NULL == entry ? NULL : entry->transfer;
 }
 
 extern BREthereumTransfer
@@ -548,6 +702,98 @@ walletInsertTransferSorted (BREthereumWallet wallet,
     array_insert(wallet->transfers, index, transfer);
 }
 
+//
+// Transfer Index
+//
+
+/**
+ * Add `entry` to `index` unless another transfer already holds the key; for a shared key the
+ * transfer indexed first keeps it.
+ */
+static void
+walletIndexTransferEntry (BRSetOf(BREthereumWalletTransferEntry*) index,
+                          BREthereumWalletTransferEntry *entry,
+                          unsigned int key) {
+    BREthereumWalletTransferEntry *holder = BRSetGet (index, entry);
+    if (NULL == holder) BRSetAdd (index, entry);
+    else holder->sharedKeys |= key;
+}
+
+static void
+walletIndexTransfer (BREthereumWallet wallet,
+                     BREthereumTransfer transfer) {
+    BREthereumWalletTransferEntry *entry = malloc (sizeof (BREthereumWalletTransferEntry));
+    BREthereumTransaction original = transferGetOriginatingTransaction (transfer);
+
+    entry->transfer        = transfer;
+    entry->identifier      = transferGetIdentifier (transfer);
+    entry->originatingHash = (NULL == original ? EMPTY_HASH_INIT : transactionGetHash (original));
+    entry->source          = transferGetSourceAddress (transfer);
+    entry->nonce           = transferGetNonce (transfer);
+    entry->sharedKeys      = 0;
+
+    assert (NULL == BRSetGet (wallet->transferEntries, entry));
+    BRSetAdd (wallet->transferEntries, entry);
+
+    if (ETHEREUM_BOOLEAN_IS_FALSE (hashEqual (entry->identifier, EMPTY_HASH_INIT)))
+        walletIndexTransferEntry (wallet->transfersByIdentifier, entry, WALLET_TRANSFER_KEY_IDENTIFIER);
+
+    if (ETHEREUM_BOOLEAN_IS_FALSE (hashEqual (entry->originatingHash, EMPTY_HASH_INIT)))
+        walletIndexTransferEntry (wallet->transfersByOriginatingHash, entry, WALLET_TRANSFER_KEY_ORIGINATING);
+
+    if (TRANSACTION_NONCE_IS_NOT_ASSIGNED != entry->nonce)
+        walletIndexTransferEntry (wallet->transfersByNonce, entry, WALLET_TRANSFER_KEY_NONCE);
+}
+
+/**
+ * Remove `entry` from `index`, if it holds the key.  If the key is shared, hand it to the oldest
+ * other transfer with the key.  Sharing is rare (a replaced transfer keeps its nonce) so a scan
+ * is fine here.
+ */
+static void
+walletUnindexTransferEntry (BREthereumWallet wallet,
+                            BRSetOf(BREthereumWalletTransferEntry*) index,
+                            BREthereumWalletTransferEntry *entry,
+                            unsigned int key,
+                            int (*keyEqual) (const void *, const void *)) {
+    if (entry != BRSetGet (index, entry)) return;
+    BRSetRemove (index, entry);
+    if (0 == (key & entry->sharedKeys)) return;
+
+    BREthereumWalletTransferEntry *holder = NULL;
+    for (size_t i = 0; i < array_count (wallet->transfers); i++) {
+        BREthereumWalletTransferEntry probe = { wallet->transfers[i] };
+        BREthereumWalletTransferEntry *other = BRSetGet (wallet->transferEntries, &probe);
+
+        if (NULL != other && other != entry && keyEqual (other, entry)) {
+            if (NULL == holder) {
+                holder = other;
+                BRSetAdd (index, holder);
+            }
+            else {
+                holder->sharedKeys |= key;
+                break;
+            }
+        }
+    }
+}
+
+static void
+walletUnindexTransfer (BREthereumWallet wallet,
+                       BREthereumTransfer transfer) {
+    BREthereumWalletTransferEntry probe = { transfer };
+    BREthereumWalletTransferEntry *entry = BRSetRemove (wallet->transferEntries, &probe);
+    if (NULL == entry) return;
+
+    walletUnindexTransferEntry (wallet, wallet->transfersByIdentifier, entry,
+                                WALLET_TRANSFER_KEY_IDENTIFIER, transferEntryIdentifierHashEqual);
+    walletUnindexTransferEntry (wallet, wallet->transfersByOriginatingHash, entry,
+                                WALLET_TRANSFER_KEY_ORIGINATING, transferEntryOriginatingHashEqual);
+    walletUnindexTransferEntry (wallet, wallet->transfersByNonce, entry,
+                                WALLET_TRANSFER_KEY_NONCE, transferEntryNonceHashEqual);
+    free (entry);
+}
+
 #pragma clang diagnostic push
 #pragma GCC diagnostic push
 #pragma clang diagnostic ignored "-Wunused-function"
@@ -566,7 +812,7 @@ walletUpdateTransferSorted (BREthereumWallet wallet,
 
 extern unsigned long
 walletGetTransferCount (BREthereumWallet wallet) {
-    return array_count(wallet->transfers);
+    return atomic_load (&wallet->transferCount);
 }
 
 //
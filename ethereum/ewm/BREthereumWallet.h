@@ -45,6 +45,14 @@ walletCreateHoldingToken(BREthereumAccount account,
 extern void
 walletRelease (BREthereumWallet wallet);
 
+/**
+ * Return the bytes held by `wallet`, including its transfers and their indices.  If
+ * `transfersUsage` is not NULL, fill it with the part held by the transfers themselves.
+ */
+extern size_t
+walletGetMemoryUsage (BREthereumWallet wallet,
+                      size_t *transfersUsage);
+
 extern void
 walletsRelease (OwnershipGiven BRArrayOf(BREthereumWallet) wallets);
 
@@ -278,6 +286,14 @@ private_extern int
 walletHasTransfer (BREthereumWallet wallet,
                    BREthereumTransfer transaction);
 
+/**
+ * Re-index `transfer` after a change to its identifier, originating hash or nonce - such as when
+ * the transfer gains a basis.  Signing through the wallet re-indexes automatically.
+ */
+private_extern void
+walletUpdateTransfer (BREthereumWallet wallet,
+                      BREthereumTransfer transfer);
+
 #ifdef __cplusplus
 }
 #endif
@@ -814,6 +814,105 @@ runEWM_TOKEN_test (const char *paperKey,
     
 }
 
+#define TEST_SIGN_BATCH_COUNT      (20)
+
+static void
+runEWM_SIGN_BATCH_test (const char *paperKey,
+                        const char *storagePath) {
+    printf ("====   SIGN BATCH\n");
+
+    // Transfers signed as a batch match those signed one-by-one, nonces included
+    BREthereumEWM ewm1 = ewmCreateWithPaperKey (ethereumMainnet, paperKey, ETHEREUM_TIMESTAMP_UNKNOWN,
+                                                P2P_ONLY,
+                                                client,
+                                                storagePath);
+    BREthereumEWM ewm2 = ewmCreateWithPaperKey (ethereumMainnet, paperKey, ETHEREUM_TIMESTAMP_UNKNOWN,
+                                                P2P_ONLY,
+                                                client,
+                                                storagePath);
+    BREthereumWallet wallet1 = ewmGetWallet (ewm1);
+    BREthereumWallet wallet2 = ewmGetWallet (ewm2);
+    BREthereumTransfer transfers1[TEST_SIGN_BATCH_COUNT];
+    BREthereumTransfer transfers2[TEST_SIGN_BATCH_COUNT];
+
+    for (size_t index = 0; index < TEST_SIGN_BATCH_COUNT; index++) {
+        BREthereumAmount amount = ewmCreateEtherAmountUnit (ewm1, 1 + index, WEI);
+
+        transfers1[index] = ewmWalletCreateTransfer (ewm1, wallet1, TEST_TRANS3_TARGET_ADDRESS, amount);
+        transfers2[index] = ewmWalletCreateTransfer (ewm2, wallet2, TEST_TRANS3_TARGET_ADDRESS, amount);
+        ewmWalletSignTransferWithPaperKey (ewm2, wallet2, transfers2[index], paperKey);
+    }
+
+    ewmWalletSignTransfersWithPaperKey (ewm1, wallet1, transfers1, TEST_SIGN_BATCH_COUNT, paperKey);
+
+    for (size_t index = 0; index < TEST_SIGN_BATCH_COUNT; index++) {
+        const char *raw1 = ewmTransferGetRawDataHexEncoded (ewm1, wallet1, transfers1[index], "0x");
+        const char *raw2 = ewmTransferGetRawDataHexEncoded (ewm2, wallet2, transfers2[index], "0x");
+
+        assert (ewmTransferGetNonce (ewm1, transfers1[index]) ==
+                ewmTransferGetNonce (ewm1, transfers1[0]) + index);
+        assert (0 == strcmp (raw1, raw2));
+    }
+
+    ewmDestroy(ewm1);
+    ewmDestroy(ewm2);
+}
+
+static size_t transferEventsCount;
+static size_t transferEventsCalls;
+
+static void
+runEWM_TRANSFER_EVENTS_handler (BREthereumClientContext context,
+                                BREthereumEWM ewm,
+                                const BREthereumClientTransferEvent *events,
+                                size_t eventsCount) {
+    transferEventsCount += eventsCount;
+    transferEventsCalls += 1;
+}
+
+static void
+runEWM_TRANSFER_EVENTS_test (const char *paperKey,
+                             const char *storagePath) {
+    printf ("====   TRANSFER EVENTS\n");
+
+    // A window long enough that only the explicit flush announces the pended events
+    alarmClockCreateIfNecessary (1);
+
+    BREthereumEWM ewm = ewmCreateWithPaperKey (ethereumMainnet, paperKey, ETHEREUM_TIMESTAMP_UNKNOWN,
+                                               P2P_ONLY,
+                                               client,
+                                               storagePath);
+    BREthereumWallet wallet = ewmGetWallet (ewm);
+    BREthereumAmount amount = ewmCreateEtherAmountUnit (ewm, 1, WEI);
+    BREthereumTransfer transfer1 = ewmWalletCreateTransfer (ewm, wallet,
+                                                            TEST_TRANS3_TARGET_ADDRESS, amount);
+    BREthereumTransfer transfer2 = ewmWalletCreateTransfer (ewm, wallet,
+                                                            TEST_TRANS3_TARGET_ADDRESS, amount);
+
+    ewmSetTransferEventCoalescing (ewm, 60 * 1000, runEWM_TRANSFER_EVENTS_handler);
+    transferEventsCount = transferEventsCalls = 0;
+
+    // A repeated event replaces the transfer's latest; a distinct transfer's event is kept.
+    ewmHandleTransferEvent (ewm, wallet, transfer1, TRANSFER_EVENT_CREATED, SUCCESS, NULL);
+    ewmHandleTransferEvent (ewm, wallet, transfer1, TRANSFER_EVENT_CREATED, SUCCESS, NULL);
+    ewmHandleTransferEvent (ewm, wallet, transfer2, TRANSFER_EVENT_CREATED, SUCCESS, NULL);
+    assert (0 == transferEventsCalls);
+
+    ewmHandleTransferEventsFlush (ewm);
+    assert (1 == transferEventsCalls && 2 == transferEventsCount);
+
+    // The flush cleared the pending events; the next window starts empty.
+    ewmHandleTransferEvent (ewm, wallet, transfer1, TRANSFER_EVENT_CREATED, SUCCESS, NULL);
+    ewmHandleTransferEventsFlush (ewm);
+    assert (2 == transferEventsCalls && 3 == transferEventsCount);
+
+    ewmHandleTransferEventsFlush (ewm);
+    assert (2 == transferEventsCalls);
+
+    ewmSetTransferEventCoalescing (ewm, 0, NULL);
+    ewmDestroy (ewm);
+}
+
 static void
 runEWM_PUBLIC_KEY_test (BREthereumNetwork network,
                         const char *paperKey,
@@ -892,5 +991,7 @@ runEWMTests (const char *paperKey,
 
     runEWM_CONNECT_test(paperKey, storagePath);
     runEWM_TOKEN_test (paperKey, storagePath);
+    runEWM_SIGN_BATCH_test (paperKey, storagePath);
+    runEWM_TRANSFER_EVENTS_test (paperKey, storagePath);
     runEWM_PUBLIC_KEY_test (ethereumMainnet, paperKey, storagePath);
 }
@@ -14,6 +14,8 @@
 #include <pthread.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
 #include <arpa/inet.h>
 #include <resolv.h>
 #include <netdb.h>
@@ -65,6 +67,24 @@ static ssize_t
 lesFindRequestForProvision (BREthereumLES les,
                             BREthereumProvision *provision);
 
+static void
+lesHandlePrefetchProvision (BREthereumLESProvisionContext context,
+                            BREthereumLES les,
+                            BREthereumNodeReference node,
+                            OwnershipGiven BREthereumProvisionResult result);
+
+static void
+lesPrefetchHeaders (BREthereumLES les,
+                    BREthereumNode node,
+                    uint64_t headNumber);
+
+static void
+lesAddRequest (BREthereumLES les,
+               BREthereumNodeReference node,
+               BREthereumLESProvisionContext context,
+               BREthereumLESProvisionCallback callback,
+               OwnershipGiven BREthereumProvision provision);
+
 static void
 lesDeactivateNode (BREthereumLES les,
                    BREthereumNodeEndpointRoute route,
@@ -92,6 +112,35 @@ static inline int minimum (int a, int b) { return a < b ? a : b; }
 
 #define LES_PREFERRED_NODE_INDEX     0
 
+/// The `pselect()` timeout.  Absent any node activity for this long, we look for new nodes.
+#define LES_SELECT_TIMEOUT_NANOSECONDS   (250000000)
+
+/// Batchable requests added within this window of the first are sent as one provision ...
+#define LES_REQUEST_BATCH_NANOSECONDS    (50000000)
+
+/// ... of at most this many hashes (or block numbers).  The node still splits the provision
+/// into messages of at most the LES/PIP content limit.
+#define LES_REQUEST_BATCH_LIMIT          (256)
+
+/// A request for any node (NODE_REFERENCE_{NIL,ANY}) goes to the connected node with the best
+/// expected completion time.  This reference is generic but never an index to an active node.
+#define NODE_REFERENCE_BEST              ((BREthereumNodeReference) (NODE_REFERENCE_LIMIT - 1))
+
+/// If the best node has not completed a request after this multiple of its expected completion
+/// time (but at least the minimum) the request is hedged: also sent to the next best node.  The
+/// first to complete provides the result; the other is cancelled.
+#define LES_REQUEST_HEDGE_FACTOR                   (3)
+#define LES_REQUEST_HEDGE_MINIMUM_MILLISECONDS     (2000)
+
+/// The number of blocks for which the most recently provided receipts are kept.  A shared LES
+/// serves every subscriber's request for a block's receipts from one fetch.
+#define LES_RECEIPTS_CACHE_LIMIT                   (32)
+
+/// On an announce, LES itself requests up to this many headers, from its head to the announced
+/// head, and the bodies and receipts of those matching a subscriber's prefetch filters.  The
+/// most recently prefetched headers and bodies are kept until asked for.
+#define LES_PREFETCH_LIMIT                         (8)
+
 // Iterate over LES nodes...
 #define FOR_SET(type,var,set) \
   for (type var = BRSetIterate(set, NULL); \
@@ -100,6 +149,11 @@ static inline int minimum (int a, int b) { return a < b ? a : b; }
 
 #define FOR_NODES( les, node )  FOR_SET(BREthereumNode, node, les->nodes)
 
+#define FOR_SUBSCRIBERS( les, subscriber ) \
+    for (BREthereumLESSubscriber *subscriber = les->subscribers; \
+         subscriber < les->subscribers + array_count (les->subscribers); \
+         subscriber++)
+
 #define FOR_CONNECTED_NODES_INDEX( les, index ) \
     for (size_t index = 0; index < array_count ((les)->connectedNodes); index++)
 
@@ -126,6 +180,15 @@ struct BREthereumNodeConfigRecord {
 
     /** the priority */
     BREthereumNodePriority priority;
+
+    /** the type (LES or PIP), if the node was ever connected; otherwise UNKNOWN */
+    BREthereumNodeType type;
+
+    /** the provision latency in milliseconds, if the node ever provided anything; otherwise 0 */
+    uint64_t latency;
+
+    /** the provision quality, accumulated over every session */
+    BREthereumNodeQuality quality;
 };
 
 extern void
@@ -141,11 +204,47 @@ nodeConfigGetHash (BREthereumNodeConfig config) {
 extern BRRlpItem
 nodeConfigEncode (BREthereumNodeConfig config,
                      BRRlpCoder coder) {
-    return rlpEncodeList (coder, 4,
+    BREthereumNodeQuality *quality = &config->quality;
+
+    BRRlpItem latencies[NUMBER_OF_NODE_PROVISION_TYPES];
+    for (size_t type = 0; type < NUMBER_OF_NODE_PROVISION_TYPES; type++)
+        latencies[type] = rlpEncodeUInt64(coder, quality->latencies[type], 0);
+
+    return rlpEncodeList (coder, 7,
                           rlpEncodeBytes(coder, config->key.pubKey, 65),
                           endpointDISEncode(&config->endpoint, coder),
                           nodeStateEncode(&config->state, coder),
-                          rlpEncodeUInt64(coder, config->priority, 0));
+                          rlpEncodeUInt64(coder, config->priority, 0),
+                          rlpEncodeUInt64(coder, config->type, 0),
+                          rlpEncodeUInt64(coder, config->latency, 0),
+                          rlpEncodeList (coder, 4,
+                                         rlpEncodeUInt64(coder, quality->provisionsSucceeded, 0),
+                                         rlpEncodeUInt64(coder, quality->provisionsFailed, 0),
+                                         rlpEncodeUInt64(coder, quality->lastGoodTime, 0),
+                                         rlpEncodeListItems(coder, latencies,
+                                                            NUMBER_OF_NODE_PROVISION_TYPES)));
+}
+
+static BREthereumNodeQuality
+nodeQualityDecode (BRRlpItem item,
+                   BRRlpCoder coder) {
+    BREthereumNodeQuality quality = { 0 };
+
+    size_t itemsCount = 0;
+    const BRRlpItem *items = rlpDecodeList (coder, item, &itemsCount);
+    assert (4 == itemsCount);
+
+    quality.provisionsSucceeded = rlpDecodeUInt64(coder, items[0], 0);
+    quality.provisionsFailed    = rlpDecodeUInt64(coder, items[1], 0);
+    quality.lastGoodTime        = rlpDecodeUInt64(coder, items[2], 0);
+
+    // Provision types added since `item` was saved have no latency.
+    size_t latenciesCount = 0;
+    const BRRlpItem *latencies = rlpDecodeList (coder, items[3], &latenciesCount);
+    for (size_t type = 0; type < latenciesCount && type < NUMBER_OF_NODE_PROVISION_TYPES; type++)
+        quality.latencies[type] = rlpDecodeUInt64(coder, latencies[type], 0);
+
+    return quality;
 }
 
 extern BREthereumNodeConfig
@@ -155,7 +254,8 @@ nodeConfigDecode (BRRlpItem item,
 
     size_t itemsCount = 0;
     const BRRlpItem *items = rlpDecodeList (coder, item, &itemsCount);
-    assert (4 == itemsCount);
+    // 4 before `type` and `latency` were saved; 6 before `quality` was saved
+    assert (4 == itemsCount || 6 == itemsCount || 7 == itemsCount);
 
     BRRlpData keyData = rlpDecodeBytesSharedDontRelease (coder, items[0]);
     BRKeySetPubKey(&config->key, keyData.bytes, keyData.bytesCount);
@@ -163,6 +263,11 @@ nodeConfigDecode (BRRlpItem item,
     config->endpoint = endpointDISDecode(items[1], coder);
     config->state    = nodeStateDecode (items[2], coder);
     config->priority = (BREthereumNodePriority) rlpDecodeUInt64(coder, items[3], 0);
+    config->type     = (6 <= itemsCount ? (BREthereumNodeType) rlpDecodeUInt64(coder, items[4], 0) : NODE_TYPE_UNKNOWN);
+    config->latency  = (6 <= itemsCount ? rlpDecodeUInt64(coder, items[5], 0) : 0);
+    config->quality  = (7 == itemsCount
+                        ? nodeQualityDecode (items[6], coder)
+                        : (BREthereumNodeQuality) { 0 });
 
     config->hash = hashCreateFromData((BRRlpData) { 64, &config->key.pubKey[1] });
 
@@ -179,6 +284,9 @@ nodeConfigCreate (BREthereumNode node) {
     config->endpoint = nodeEndpointGetDISNeighbor(ne).node;
     config->state = nodeGetState(node, NODE_ROUTE_TCP);
     config->priority = nodeGetPriority (node);
+    config->type     = nodeGetType (node);
+    config->latency  = nodeGetLatency (node);
+    config->quality  = nodeGetQuality (node);
 
     config->hash = hashCreateFromData((BRRlpData) { 64, &config->key.pubKey[1] });
 
@@ -190,6 +298,21 @@ static BREthereumNodeEndpoint
 nodeConfigCreateEndpoint (BREthereumNodeConfig config) {
     return nodeEndpointCreate ((BREthereumDISNeighbor) { config->endpoint, config->key });
 }
+
+/** Check if `config` is for a node of a type we can use; a node of UNKNOWN type might be. */
+static int
+nodeConfigHasSupportedType (BREthereumNodeConfig config) {
+    switch (config->type) {
+        case NODE_TYPE_UNKNOWN: return 1;
+#if defined (LES_SUPPORT_GETH)
+        case NODE_TYPE_GETH:    return 1;
+#endif
+#if defined (LES_SUPPORT_PARITY)
+        case NODE_TYPE_PARITY:  return 1;
+#endif
+        default:                return 0;
+    }
+}
 #endif
 
 extern size_t
@@ -232,7 +355,7 @@ nodeGetPreferredState (BREthereumNodeState state) {
  * the response is fully constituted, we'll invoke the `callback` w/ `context` and w/ data from
  * both the request and response.
  */
-typedef struct {
+typedef struct BREthereumLESRequestRecord {
 
     BREthereumLESProvisionContext context;
     BREthereumLESProvisionCallback callback;
@@ -254,6 +377,26 @@ typedef struct {
      */
     BREthereumNode node;
 
+    /**
+     * If non-NULL, this request is a batch: `provision` is the concatenation of the `members`
+     * provisions and, once provided, the `provision` results are split back into each member for
+     * the member's callback.  The members are never themselves handled by a node.
+     */
+    BRArrayOf(struct BREthereumLESRequestRecord) members;
+
+    /**
+     * A batch is not handled by a node until `deadline`; until then more members can join.
+     */
+    struct timespec deadline;
+
+    /**
+     * If non-NULL, a second node also handling this request, with its own copy of `provision`
+     * as `hedgeProvision`.  The request is hedged once `hedgeDeadline`, if set, has passed.
+     */
+    BREthereumNode hedge;
+    BREthereumProvision hedgeProvision;
+    struct timespec hedgeDeadline;
+
 } BREthereumLESRequest;
 
 static void
@@ -263,6 +406,13 @@ requestRelease (BREthereumLESRequest *request) {
     // Don't release a provision if it is 'owned' by a `node` - the node will release it.
     if (NULL == request->node)
         provisionRelease(&request->provision, ETHEREUM_BOOLEAN_TRUE);
+
+    if (NULL != request->members) {
+        for (size_t index = 0; index < array_count (request->members); index++)
+            requestRelease (&request->members[index]);
+        array_free (request->members);
+        request->members = NULL;
+    }
 }
 
 static void
@@ -274,6 +424,17 @@ requestsRelease (OwnershipGiven BRArrayOf(BREthereumLESRequest) requests) {
     }
 }
 
+/// MARK: - LES Subscriber
+
+typedef struct {
+    BREthereumLESCallbackContext context;
+    BREthereumLESCallbackAnnounce announce;
+    BREthereumLESCallbackStatus status;
+    BREthereumLESCallbackSaveNodes saveNodes;
+    /** The addresses whose blocks are prefetched; NULL for none.  See lesSetPrefetchFilters() */
+    BREthereumBloomFilterSet prefetchFilters;
+} BREthereumLESSubscriber;
+
 /// MARK: - LES
 
 /**
@@ -310,11 +471,14 @@ struct BREthereumLESRecord {
 
     BREthereumBoolean discoverNodes;
     
-    /** Callbacks */
-    BREthereumLESCallbackContext callbackContext;
-    BREthereumLESCallbackAnnounce callbackAnnounce;
-    BREthereumLESCallbackStatus callbackStatus;
-    BREthereumLESCallbackSaveNodes callbackSaveNodes;
+    /**
+     * Callbacks.  Typically one subscriber, the creator; a shared LES (see lesCreateShared())
+     * fans the callbacks out to each subscriber.  Subscribers are protected by their own lock,
+     * held while invoking callbacks, so that once lesRemoveSubscriber() returns the subscriber
+     * will not be called again.
+     */
+    BRArrayOf(BREthereumLESSubscriber) subscribers;
+    pthread_mutex_t subscribersLock;
 
     /** Our Local Endpoint. */
     BREthereumNodeEndpoint localEndpoint;
@@ -348,6 +512,40 @@ struct BREthereumLESRecord {
 
     BREthereumHash genesisHash;
 
+    /**
+     * Receipts, by block hash, most recently provided.  A block matching a popular token's
+     * logsBloom has its receipts requested by each wallet, and again once its bodies show a
+     * transaction of interest.  A ring; `receiptsCacheNext` is the oldest entry.
+     */
+    struct {
+        BREthereumHash hash;
+        BRArrayOf(BREthereumTransactionReceipt) receipts;
+    } receiptsCache[LES_RECEIPTS_CACHE_LIMIT];
+    size_t receiptsCacheNext;
+
+    /**
+     * Prefetched block data.  On an announce past `number`, the highest block number requested
+     * so far, headers are requested at once, rather than once BCS has handled the announce, and
+     * then the bodies and receipts of those matching a subscriber's filters.  Headers and bodies
+     * are kept in rings, `{headers,bodies}Next` being the oldest entry; receipts are kept by
+     * `receiptsCache`.  A request for data still being prefetched waits, in `waiters`, for the
+     * prefetch to complete rather than being sent itself.
+     */
+    struct {
+        uint64_t number;
+        BREthereumBlockHeader headers[LES_PREFETCH_LIMIT];
+        size_t headersNext;
+        struct {
+            BREthereumHash hash;
+            BREthereumBlockBodyPair pair;
+        } bodies[LES_PREFETCH_LIMIT];
+        size_t bodiesNext;
+        BRArrayOf(uint64_t) pendingHeaders;
+        BRArrayOf(BREthereumHash) pendingBodies;
+        BRArrayOf(BREthereumHash) pendingReceipts;
+        BRArrayOf(BREthereumLESRequest) waiters;
+    } prefetch;
+
     /** If we handle sync or not; if not, we'll only relay transactions and won't require
      * connected nodes to SERVE_{HEADERS,BLOCK,STATE} */
     BREthereumBoolean handleSync;
@@ -356,7 +554,9 @@ struct BREthereumLESRecord {
     pthread_t thread;
     pthread_mutex_t lock;
 
-    /** replace with pipe() message */
+    /** A self-pipe - written by `lesWakeup()` to wake `lesThread` from `pselect()` */
+    int wakeup[2];
+
     int theTimeToQuitIsNow;
     int theTimeToCleanIsNow;
     int theTimeToUpdateBlockHeadIsNow;
@@ -364,6 +564,29 @@ struct BREthereumLESRecord {
     int isPendingDNSSeeds;
 };
 
+/**
+ * Wake `lesThread` from `pselect()` so that new requests, or a request to quit, clean or update
+ * the block head, are handled immediately.
+ */
+static void
+lesWakeup (BREthereumLES les) {
+    uint8_t byte = 0;
+    // On EAGAIN, the pipe is full; `lesThread` already has a pending wakeup.
+    ssize_t written = write (les->wakeup[1], &byte, 1);
+    (void) written;
+}
+
+/**
+ * A node finished its handshake crypto on a worker thread; have `lesThread` process it.
+ *
+ * @note: This is called from a thread pool worker, without holding `les->lock`.
+ */
+static void
+lesHandleWakeup (BREthereumLES les,
+                 BREthereumNode node) {
+    lesWakeup (les);
+}
+
 static void
 lesInsertNodeAsAvailable (BREthereumLES les,
                           BREthereumNode node) {
@@ -387,6 +610,8 @@ lesEnsureNodeForEndpoint (BREthereumLES les,
                           OwnershipGiven BREthereumNodeEndpoint endpoint,
                           BREthereumNodeState state,
                           BREthereumNodePriority priority,
+                          uint64_t latency,
+                          const BREthereumNodeQuality *quality,
                           BREthereumBoolean *added) {
 
     // Skip out if given an invalid endpoint
@@ -417,8 +642,11 @@ lesEnsureNodeForEndpoint (BREthereumLES les,
                            (BREthereumNodeCallbackAnnounce) lesHandleAnnounce,
                            (BREthereumNodeCallbackProvide) lesHandleProvision,
                            (BREthereumNodeCallbackNeighbor) lesHandleNeighbor,
+                           (BREthereumNodeCallbackWakeup) lesHandleWakeup,
                            les->handleSync);
         nodeSetStateInitial (node, NODE_ROUTE_TCP, state);
+        nodeSetPriorLatency (node, latency);
+        if (NULL != quality) nodeSetPriorQuality (node, *quality);
 
         // ... add it to 'all nodes'
         BRSetAdd(les->nodes, node);
@@ -495,6 +723,8 @@ lesSeedQuery (BREthereumLESSeedContext *context) {
                                      nodeEndpointCreateEnode(enode),
                                      (BREthereumNodeState) { NODE_AVAILABLE },
                                      context->priority,
+                                     0,
+                                     NULL,
                                      &added);
             if (ETHEREUM_BOOLEAN_IS_TRUE(added))
                 context->added += 1;
@@ -529,12 +759,21 @@ lesCreate (BREthereumNetwork network,
     BREthereumLES les = (BREthereumLES) calloc (1, sizeof(struct BREthereumLESRecord));
     assert (NULL != les);
 
-    // For now, create a new, random private key that is used for communication with LES nodes.
-    UInt256 secret;
-    arc4random_buf(secret.u64, sizeof (secret));
+    // Create the wakeup descriptors; non-blocking so neither a wakeup nor a drain can block.  Do
+    // this first, as the one failure, so that there is nothing else to release when it fails.
+    if (0 != pipe (les->wakeup)) {
+        eth_log (LES_LOG_TOPIC, "Create Failed     : %s", strerror (errno));
+        if (NULL != configs) BRSetFreeAll (configs, (void (*) (void*)) nodeConfigRelease);
+        free (les);
+        return NULL;
+    }
+    for (int index = 0; index < 2; index++) {
+        fcntl (les->wakeup[index], F_SETFL, fcntl (les->wakeup[index], F_GETFL) | O_NONBLOCK);
+        fcntl (les->wakeup[index], F_SETFD, FD_CLOEXEC);
+    }
 
-    // Assign the generated private key.
-    BRKeySetSecret(&les->key, &secret, 0);
+    // For now, create a new, random private key that is used for communication with LES nodes.
+    BRKeyGenerate (&les->key, 1, 0);
 
     // Save the network.
     les->network = network;
@@ -544,11 +783,11 @@ lesCreate (BREthereumNetwork network,
 
     les->discoverNodes = discoverNodes;
 
-    // Save callbacks.
-    les->callbackContext = callbackContext;
-    les->callbackAnnounce = callbackAnnounce;
-    les->callbackStatus = callbackStatus;
-    les->callbackSaveNodes = callbackSaveNodes;
+    // Save callbacks, if any.
+    pthread_mutex_init (&les->subscribersLock, NULL);
+    array_new (les->subscribers, 1);
+    if (NULL != callbackAnnounce)
+        lesAddSubscriber (les, callbackContext, callbackAnnounce, callbackStatus, callbackSaveNodes);
 
     les->head.hash = headHash;
     les->head.number = headNumber;
@@ -622,6 +861,12 @@ lesCreate (BREthereumNetwork network,
     les->requestsIdentifier = 0;
     array_new (les->requests, LES_REQUESTS_INITIAL_SIZE);
 
+    // Initialize prefetch; nothing until an announce
+    array_new (les->prefetch.pendingHeaders,  LES_PREFETCH_LIMIT);
+    array_new (les->prefetch.pendingBodies,   LES_PREFETCH_LIMIT);
+    array_new (les->prefetch.pendingReceipts, LES_PREFETCH_LIMIT);
+    array_new (les->prefetch.waiters,         LES_PREFETCH_LIMIT);
+
     // The Set of all known nodes.
     les->nodes = BRSetNew (nodeHashValue,
                            nodeHashEqual,
@@ -644,11 +889,16 @@ lesCreate (BREthereumNetwork network,
     eth_log (LES_LOG_TOPIC, "Nodes Provided    : %zu", (NULL == configs ? 0 : BRSetCount(configs)));
     if (NULL != configs)
         FOR_SET (BREthereumNodeConfig, config, configs)
-            if (!bootstrapBRDOnly || NODE_PRIORITY_BRD == config->priority)
+            // A node that served us before is available immediately, ordered (within its saved
+            // priority) by its quality, so we connect to the best known nodes first.
+            if ((!bootstrapBRDOnly || NODE_PRIORITY_BRD == config->priority) &&
+                nodeConfigHasSupportedType (config))
                 lesEnsureNodeForEndpoint (les,
                                           nodeConfigCreateEndpoint (config),
                                           nodeGetPreferredState (config->state),
                                           config->priority,
+                                          config->latency,
+                                          &config->quality,
                                           NULL);
 #endif // !defined(LES_BOOTSTRAP_LCL_ONLY)
 
@@ -678,6 +928,7 @@ lesStop (BREthereumLES les) {
     pthread_mutex_lock (&les->lock);
     if (LES_PTHREAD_NULL != les->thread) {
         les->theTimeToQuitIsNow = 1;
+        lesWakeup (les);
         // TODO: Unlock here - to avoid a deadlock on lock() after pselect()
         pthread_mutex_unlock (&les->lock);
         pthread_join (les->thread, NULL);
@@ -705,21 +956,190 @@ lesRelease(BREthereumLES les) {
 
     requestsRelease(les->requests);
 
+    for (size_t index = 0; index < LES_RECEIPTS_CACHE_LIMIT; index++)
+        transactionReceiptsRelease (les->receiptsCache[index].receipts);
+
+    for (size_t index = 0; index < LES_PREFETCH_LIMIT; index++) {
+        blockHeaderRelease (les->prefetch.headers[index]);
+        blockBodyPairRelease (&les->prefetch.bodies[index].pair);
+    }
+    array_free (les->prefetch.pendingHeaders);
+    array_free (les->prefetch.pendingBodies);
+    array_free (les->prefetch.pendingReceipts);
+    requestsRelease (les->prefetch.waiters);
+
     rlpCoderRelease(les->coder);
 
     // requests, requestsToSend
 
     // TODO: NodeEnpdoint Release (to release 'hello' and 'status' messages
 
+    close (les->wakeup[0]);
+    close (les->wakeup[1]);
+
+    FOR_SUBSCRIBERS (les, subscriber)
+        if (NULL != subscriber->prefetchFilters) bloomFilterSetRelease (subscriber->prefetchFilters);
+    array_free (les->subscribers);
+    pthread_mutex_destroy (&les->subscribersLock);
+
     pthread_mutex_unlock (&les->lock);
     pthread_mutex_destroy (&les->lock);
     free (les);
 }
 
+extern void
+lesAddSubscriber (BREthereumLES les,
+                  BREthereumLESCallbackContext callbackContext,
+                  BREthereumLESCallbackAnnounce callbackAnnounce,
+                  BREthereumLESCallbackStatus callbackStatus,
+                  BREthereumLESCallbackSaveNodes callbackSaveNodes) {
+    BREthereumLESSubscriber subscriber = {
+        callbackContext,
+        callbackAnnounce,
+        callbackStatus,
+        callbackSaveNodes,
+        NULL
+    };
+
+    pthread_mutex_lock (&les->subscribersLock);
+    array_add (les->subscribers, subscriber);
+    pthread_mutex_unlock (&les->subscribersLock);
+}
+
+extern void
+lesSetPrefetchFilters (BREthereumLES les,
+                       BREthereumLESCallbackContext callbackContext,
+                       OwnershipGiven BREthereumBloomFilterSet filters) {
+    pthread_mutex_lock (&les->subscribersLock);
+    FOR_SUBSCRIBERS (les, subscriber)
+        if (callbackContext == subscriber->context) {
+            if (NULL != subscriber->prefetchFilters) bloomFilterSetRelease (subscriber->prefetchFilters);
+            subscriber->prefetchFilters = filters;
+            filters = NULL;
+            break;
+        }
+    pthread_mutex_unlock (&les->subscribersLock);
+
+    // Not a subscriber; handle `OwnershipGiven`
+    if (NULL != filters) bloomFilterSetRelease (filters);
+}
+
+static void
+lesDropProvision (BREthereumLESProvisionContext context,
+                  BREthereumLES les,
+                  BREthereumNodeReference node,
+                  OwnershipGiven BREthereumProvisionResult result) {
+    provisionResultRelease (&result);
+}
+
+extern void
+lesCancelProvisions (BREthereumLES les,
+                     BREthereumLESProvisionContext context) {
+    // The requests still complete, on their nodes; only their callbacks change.
+    pthread_mutex_lock (&les->lock);
+    for (size_t index = 0; index < array_count (les->requests); index++) {
+        BREthereumLESRequest *request = &les->requests[index];
+        size_t membersCount = (NULL == request->members ? 1 : array_count (request->members));
+        for (size_t mi = 0; mi < membersCount; mi++) {
+            BREthereumLESRequest *member = (NULL == request->members ? request : &request->members[mi]);
+            if (context == member->context)
+                member->callback = lesDropProvision;
+        }
+    }
+    for (size_t index = 0; index < array_count (les->prefetch.waiters); index++)
+        if (context == les->prefetch.waiters[index].context)
+            les->prefetch.waiters[index].callback = lesDropProvision;
+    pthread_mutex_unlock (&les->lock);
+}
+
+extern void
+lesRemoveSubscriber (BREthereumLES les,
+                     BREthereumLESCallbackContext callbackContext) {
+    pthread_mutex_lock (&les->subscribersLock);
+    for (size_t index = 0; index < array_count (les->subscribers); index++)
+        if (callbackContext == les->subscribers[index].context) {
+            if (NULL != les->subscribers[index].prefetchFilters)
+                bloomFilterSetRelease (les->subscribers[index].prefetchFilters);
+            array_rm (les->subscribers, index);
+            break;
+        }
+    pthread_mutex_unlock (&les->subscribersLock);
+
+    // Requests made by the subscriber, with itself as the context, must not call back either.
+    lesCancelProvisions (les, (BREthereumLESProvisionContext) callbackContext);
+}
+
+/// MARK: - Shared LES
+
+typedef struct {
+    BREthereumLES les;
+    size_t references;
+} BREthereumLESShared;
+
+static pthread_mutex_t lesSharedLock = PTHREAD_MUTEX_INITIALIZER;
+static BRArrayOf(BREthereumLESShared) lesShared = NULL;
+
+extern BREthereumLES
+lesCreateShared (BREthereumNetwork network,
+                 BREthereumHash headHash,
+                 uint64_t headNumber,
+                 UInt256 headTotalDifficulty,
+                 BREthereumHash genesisHash,
+                 OwnershipGiven BRSetOf(BREthereumNodeConfig) configs,
+                 BREthereumBoolean discoverNodes,
+                 BREthereumBoolean handleSync) {
+    BREthereumLES les = NULL;
+
+    pthread_mutex_lock (&lesSharedLock);
+    if (NULL == lesShared) array_new (lesShared, 1);
+
+    for (size_t index = 0; index < array_count (lesShared); index++)
+        if (network       == lesShared[index].les->network       &&
+            discoverNodes == lesShared[index].les->discoverNodes &&
+            handleSync    == lesShared[index].les->handleSync) {
+            les = lesShared[index].les;
+            lesShared[index].references++;
+            break;
+        }
+
+    if (NULL != les) {
+        // The `configs` are only used when creating the shared LES
+        if (NULL != configs) BRSetFreeAll (configs, (void (*) (void*)) nodeConfigRelease);
+    }
+    else {
+        les = lesCreate (network, NULL, NULL, NULL, NULL,
+                         headHash, headNumber, headTotalDifficulty, genesisHash,
+                         configs, discoverNodes, handleSync);
+        if (NULL != les) array_add (lesShared, ((BREthereumLESShared) { les, 1 }));
+    }
+    pthread_mutex_unlock (&lesSharedLock);
+
+    return les;
+}
+
+extern void
+lesReleaseShared (BREthereumLES les) {
+    int needRelease = 0;
+
+    pthread_mutex_lock (&lesSharedLock);
+    for (size_t index = 0; index < array_count (lesShared); index++)
+        if (les == lesShared[index].les) {
+            if (0 == --lesShared[index].references) {
+                array_rm (lesShared, index);
+                needRelease = 1;
+            }
+            break;
+        }
+    pthread_mutex_unlock (&lesSharedLock);
+
+    if (needRelease) lesRelease (les);
+}
+
 extern void
 lesClean (BREthereumLES les) {
     if (0 == pthread_mutex_trylock (&les->lock)) {
         les->theTimeToCleanIsNow = 1;
+        lesWakeup (les);
         pthread_mutex_unlock (&les->lock);
     }
 }
@@ -734,6 +1154,7 @@ lesUpdateBlockHead (BREthereumLES les,
     les->head.number = headNumber;
     les->head.totalDifficulty = headTotalDifficulty;
     les->theTimeToUpdateBlockHeadIsNow = 1;
+    lesWakeup (les);
     pthread_mutex_unlock (&les->lock);
 }
 
@@ -782,6 +1203,59 @@ lesGetNodePrefer (BREthereumLES les) {
     return node;
 }
 
+extern size_t
+lesGetNodes (BREthereumLES les,
+             BREthereumNodeReference *nodes,
+             size_t nodesCount) {
+    size_t count = 0;
+    pthread_mutex_lock (&les->lock);
+    BRArrayOf(BREthereumNode) active = les->activeNodesByRoute[NODE_ROUTE_TCP];
+    for (size_t index = 0; index < array_count(active) && count < nodesCount; index++) {
+        BREthereumNode node = active[index];
+        if (nodeHasState (node, NODE_ROUTE_TCP, NODE_CONNECTED))
+            nodes[count++] = (BREthereumNodeReference) node;
+    }
+    pthread_mutex_unlock (&les->lock);
+    return count;
+}
+
+static void
+lesApplyNodeMemoryUsage (void *context, void *item) {
+    *((size_t *) context) += nodeGetMemoryUsage ((BREthereumNode) item);
+}
+
+extern size_t
+lesGetMemoryUsage (BREthereumLES les) {
+    size_t usage = sizeof (struct BREthereumLESRecord);
+
+    // `lesThread` processes nodes, growing their buffers, only while holding `lock`.
+    pthread_mutex_lock (&les->lock);
+    usage += rlpCoderGetMemoryUsage (les->coder);
+    usage += array_heap_size (les->subscribers);
+    usage += BRSetMemoryUsage (les->nodes);
+    BRSetApply (les->nodes, &usage, lesApplyNodeMemoryUsage);
+    usage += array_heap_size (les->availableNodes);
+    for (size_t route = 0; route < NUMBER_OF_NODE_ROUTES; route++)
+        usage += array_heap_size (les->activeNodesByRoute[route]);
+    usage += array_heap_size (les->requests);
+    for (size_t index = 0; index < LES_RECEIPTS_CACHE_LIMIT; index++)
+        usage += array_heap_size (les->receiptsCache[index].receipts);
+    for (size_t index = 0; index < LES_PREFETCH_LIMIT; index++) {
+        BRArrayOf(BREthereumTransaction) transactions = les->prefetch.bodies[index].pair.transactions;
+        for (size_t ti = 0; NULL != transactions && ti < array_count (transactions); ti++)
+            usage += transactionGetMemoryUsage (transactions[ti]);
+        usage += array_heap_size (transactions);
+        usage += array_heap_size (les->prefetch.bodies[index].pair.uncles);
+    }
+    usage += array_heap_size (les->prefetch.pendingHeaders);
+    usage += array_heap_size (les->prefetch.pendingBodies);
+    usage += array_heap_size (les->prefetch.pendingReceipts);
+    usage += array_heap_size (les->prefetch.waiters);
+    pthread_mutex_unlock (&les->lock);
+
+    return usage;
+}
+
 extern void
 lesSetNodePrefer (BREthereumLES les,
                BREthereumNodeReference nodeReference) {
@@ -827,10 +1301,13 @@ lesHandleStatus (BREthereumLES les,
                  BREthereumNode node,
                  BREthereumHash headHash,
                  uint64_t headNumber) {
-    les->callbackStatus (les->callbackContext,
-                         (BREthereumNodeReference) node,
-                         headHash,
-                         headNumber);
+    pthread_mutex_lock (&les->subscribersLock);
+    FOR_SUBSCRIBERS (les, subscriber)
+        subscriber->status (subscriber->context,
+                            (BREthereumNodeReference) node,
+                            headHash,
+                            headNumber);
+    pthread_mutex_unlock (&les->subscribersLock);
 }
 
 /**
@@ -853,14 +1330,442 @@ lesHandleAnnounce (BREthereumLES les,
                    uint64_t headNumber,
                    UInt256 headTotalDifficulty,
                    uint64_t reorgDepth) {
-    les->callbackAnnounce (les->callbackContext,
-                           (BREthereumNodeReference) node,
-                           headHash,
-                           headNumber,
-                           headTotalDifficulty,
-                           reorgDepth);
+    // Start prefetching before the subscribers, handling the announce, ask for the same blocks.
+    lesPrefetchHeaders (les, node, headNumber);
+
+    pthread_mutex_lock (&les->subscribersLock);
+    FOR_SUBSCRIBERS (les, subscriber)
+        subscriber->announce (subscriber->context,
+                              (BREthereumNodeReference) node,
+                              headHash,
+                              headNumber,
+                              headTotalDifficulty,
+                              reorgDepth);
+    pthread_mutex_unlock (&les->subscribersLock);
+}
+
+
+/// MARK: - Receipts Cache
+
+static BRArrayOf(BREthereumTransactionReceipt)
+lesLookupCachedReceipts (BREthereumLES les,
+                         BREthereumHash blockHash) {
+    for (size_t index = 0; index < LES_RECEIPTS_CACHE_LIMIT; index++)
+        if (NULL != les->receiptsCache[index].receipts &&
+            ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (blockHash, les->receiptsCache[index].hash)))
+            return les->receiptsCache[index].receipts;
+    return NULL;
+}
+
+/**
+ * Cache a copy of each block's receipts from `provision`, replacing the oldest entries.
+ */
+static void
+lesCacheReceipts (BREthereumLES les,
+                  BREthereumProvisionReceipts *provision) {
+    if (NULL == provision->hashes || NULL == provision->receipts) return;
+
+    size_t count = minimum ((int) array_count (provision->hashes), (int) array_count (provision->receipts));
+    for (size_t index = 0; index < count; index++) {
+        if (NULL != lesLookupCachedReceipts (les, provision->hashes[index])) continue;
+
+        transactionReceiptsRelease (les->receiptsCache[les->receiptsCacheNext].receipts);
+        les->receiptsCache[les->receiptsCacheNext].hash     = provision->hashes[index];
+        les->receiptsCache[les->receiptsCacheNext].receipts = transactionReceiptsCopy (provision->receipts[index]);
+        les->receiptsCacheNext = (les->receiptsCacheNext + 1) % LES_RECEIPTS_CACHE_LIMIT;
+    }
+}
+
+/// MARK: - Prefetch
+
+static BREthereumBlockHeader
+lesLookupPrefetchedHeader (BREthereumLES les,
+                           uint64_t number) {
+    for (size_t index = 0; index < LES_PREFETCH_LIMIT; index++)
+        if (NULL != les->prefetch.headers[index] &&
+            number == blockHeaderGetNumber (les->prefetch.headers[index]))
+            return les->prefetch.headers[index];
+    return NULL;
+}
+
+static BREthereumBlockBodyPair *
+lesLookupPrefetchedBodies (BREthereumLES les,
+                           BREthereumHash blockHash) {
+    for (size_t index = 0; index < LES_PREFETCH_LIMIT; index++)
+        if (NULL != les->prefetch.bodies[index].pair.transactions &&
+            ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (blockHash, les->prefetch.bodies[index].hash)))
+            return &les->prefetch.bodies[index].pair;
+    return NULL;
 }
 
+static ssize_t
+lesPrefetchNumberIndex (BRArrayOf(uint64_t) numbers,
+                        uint64_t number) {
+    for (ssize_t index = 0; index < array_count (numbers); index++)
+        if (number == numbers[index]) return index;
+    return -1;
+}
+
+static ssize_t
+lesPrefetchHashIndex (BRArrayOf(BREthereumHash) hashes,
+                      BREthereumHash hash) {
+    for (ssize_t index = 0; index < array_count (hashes); index++)
+        if (ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (hash, hashes[index]))) return index;
+    return -1;
+}
+
+static void
+lesPrefetchHashesRemove (BRArrayOf(BREthereumHash) hashes,
+                         BRArrayOf(BREthereumHash) removed) {
+    for (size_t index = 0; index < array_count (removed); index++) {
+        ssize_t found = lesPrefetchHashIndex (hashes, removed[index]);
+        if (-1 != found) array_rm (hashes, found);
+    }
+}
+
+typedef enum {
+    LES_PREFETCH_NONE,      // some of the provision is neither prefetched nor being prefetched
+    LES_PREFETCH_PENDING,   // all of it is prefetched or being prefetched
+    LES_PREFETCH_CACHED     // all of it is prefetched
+} BREthereumLESPrefetchState;
+
+static BREthereumLESPrefetchState
+lesPrefetchGetState (BREthereumLES les,
+                     BREthereumProvision *provision) {
+    BREthereumLESPrefetchState state = LES_PREFETCH_CACHED;
+
+    switch (provision->type) {
+        case PROVISION_BLOCK_HEADERS: {
+            BREthereumProvisionHeaders *headers = &provision->u.headers;
+            if (0 == headers->limit || 0 != headers->skip || ETHEREUM_BOOLEAN_IS_TRUE (headers->reverse))
+                return LES_PREFETCH_NONE;
+
+            for (uint64_t number = headers->start; number < headers->start + headers->limit; number++)
+                if (NULL != lesLookupPrefetchedHeader (les, number)) continue;
+                else if (-1 != lesPrefetchNumberIndex (les->prefetch.pendingHeaders, number))
+                    state = LES_PREFETCH_PENDING;
+                else return LES_PREFETCH_NONE;
+            return state;
+        }
+
+        case PROVISION_BLOCK_BODIES: {
+            BRArrayOf(BREthereumHash) hashes = provision->u.bodies.hashes;
+            if (NULL == hashes || 0 == array_count (hashes)) return LES_PREFETCH_NONE;
+
+            for (size_t index = 0; index < array_count (hashes); index++)
+                if (NULL != lesLookupPrefetchedBodies (les, hashes[index])) continue;
+                else if (-1 != lesPrefetchHashIndex (les->prefetch.pendingBodies, hashes[index]))
+                    state = LES_PREFETCH_PENDING;
+                else return LES_PREFETCH_NONE;
+            return state;
+        }
+
+        case PROVISION_TRANSACTION_RECEIPTS: {
+            BRArrayOf(BREthereumHash) hashes = provision->u.receipts.hashes;
+            if (NULL == hashes || 0 == array_count (hashes)) return LES_PREFETCH_NONE;
+
+            for (size_t index = 0; index < array_count (hashes); index++)
+                if (NULL != lesLookupCachedReceipts (les, hashes[index])) continue;
+                else if (-1 != lesPrefetchHashIndex (les->prefetch.pendingReceipts, hashes[index]))
+                    state = LES_PREFETCH_PENDING;
+                else return LES_PREFETCH_NONE;
+            return state;
+        }
+
+        default:
+            return LES_PREFETCH_NONE;
+    }
+}
+
+/**
+ * Fill the results of `provision`, all of which is prefetched, with copies of the prefetched data.
+ */
+static void
+lesPrefetchFill (BREthereumLES les,
+                 BREthereumProvision *provision) {
+    switch (provision->type) {
+        case PROVISION_BLOCK_HEADERS: {
+            BREthereumProvisionHeaders *headers = &provision->u.headers;
+            array_new (headers->headers, headers->limit);
+            for (uint64_t number = headers->start; number < headers->start + headers->limit; number++)
+                array_add (headers->headers, blockHeaderCopy (lesLookupPrefetchedHeader (les, number)));
+            break;
+        }
+
+        case PROVISION_BLOCK_BODIES: {
+            BREthereumProvisionBodies *bodies = &provision->u.bodies;
+            array_new (bodies->pairs, array_count (bodies->hashes));
+            for (size_t index = 0; index < array_count (bodies->hashes); index++) {
+                BREthereumBlockBodyPair *pair = lesLookupPrefetchedBodies (les, bodies->hashes[index]);
+                BRArrayOf(BREthereumBlockHeader) uncles;
+                array_new (uncles, (NULL == pair->uncles ? 0 : array_count (pair->uncles)));
+                for (size_t ui = 0; NULL != pair->uncles && ui < array_count (pair->uncles); ui++)
+                    array_add (uncles, blockHeaderCopy (pair->uncles[ui]));
+                array_add (bodies->pairs, ((BREthereumBlockBodyPair) {
+                    transactionsCopy (pair->transactions),
+                    uncles }));
+            }
+            break;
+        }
+
+        case PROVISION_TRANSACTION_RECEIPTS: {
+            BREthereumProvisionReceipts *receipts = &provision->u.receipts;
+            array_new (receipts->receipts, array_count (receipts->hashes));
+            for (size_t index = 0; index < array_count (receipts->hashes); index++)
+                array_add (receipts->receipts,
+                           transactionReceiptsCopy (lesLookupCachedReceipts (les, receipts->hashes[index])));
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Provide `provision` from prefetched data if possible: now, if all of it has been prefetched,
+ * or once the prefetch completes, if the rest is being prefetched.  Otherwise return FALSE, with
+ * `provision` still owned by the caller, to be requested as usual.
+ *
+ * @note Called with `les->lock` held.
+ */
+static BREthereumBoolean
+lesPrefetchProvide (BREthereumLES les,
+                    BREthereumNodeReference node,
+                    BREthereumLESProvisionContext context,
+                    BREthereumLESProvisionCallback callback,
+                    OwnershipGiven BREthereumProvision provision) {
+    switch (lesPrefetchGetState (les, &provision)) {
+        case LES_PREFETCH_NONE:
+            return ETHEREUM_BOOLEAN_FALSE;
+
+        case LES_PREFETCH_PENDING:
+            array_add (les->prefetch.waiters,
+                       ((BREthereumLESRequest) { context, callback, provision, node, NULL, NULL, { 0, 0 } }));
+            return ETHEREUM_BOOLEAN_TRUE;
+
+        case LES_PREFETCH_CACHED:
+            provision.identifier = les->requestsIdentifier++;
+            lesPrefetchFill (les, &provision);
+            callback (context, les, node,
+                      (BREthereumProvisionResult) {
+                          provision.identifier,
+                          provision.type,
+                          PROVISION_SUCCESS,
+                          provision
+                      });
+            return ETHEREUM_BOOLEAN_TRUE;
+    }
+}
+
+/**
+ * Provide each waiting request again, now that a prefetch has completed.  Those still waiting
+ * on another prefetch wait; those no longer covered by a prefetch are requested as usual.
+ */
+static void
+lesPrefetchProvideWaiters (BREthereumLES les) {
+    BRArrayOf(BREthereumLESRequest) waiters = les->prefetch.waiters;
+    array_new (les->prefetch.waiters, LES_PREFETCH_LIMIT);
+
+    for (size_t index = 0; index < array_count (waiters); index++) {
+        BREthereumLESRequest *waiter = &waiters[index];
+        if (ETHEREUM_BOOLEAN_IS_FALSE (lesPrefetchProvide (les, waiter->nodeReference,
+                                                           waiter->context, waiter->callback,
+                                                           waiter->provision)))
+            lesAddRequest (les, waiter->nodeReference, waiter->context, waiter->callback,
+                           waiter->provision);
+    }
+    array_free (waiters);
+}
+
+/**
+ * Request the bodies and receipts of the prefetched `headers` matching a subscriber's filters, if
+ * not already prefetched.
+ */
+static void
+lesPrefetchBlocks (BREthereumLES les,
+                   BREthereumNodeReference node,
+                   BRArrayOf(BREthereumBlockHeader) headers) {
+    BRArrayOf(BREthereumHash) bodiesHashes;
+    BRArrayOf(BREthereumHash) receiptsHashes;
+    array_new (bodiesHashes,   array_count (headers));
+    array_new (receiptsHashes, array_count (headers));
+
+    pthread_mutex_lock (&les->subscribersLock);
+    for (size_t index = 0; index < array_count (headers); index++) {
+        BREthereumHash hash = blockHeaderGetHash (headers[index]);
+        FOR_SUBSCRIBERS (les, subscriber)
+            if (NULL != subscriber->prefetchFilters &&
+                ETHEREUM_BOOLEAN_IS_TRUE (blockHeaderMatchAddresses (headers[index],
+                                                                     subscriber->prefetchFilters))) {
+                if (NULL == lesLookupPrefetchedBodies (les, hash) &&
+                    -1 == lesPrefetchHashIndex (les->prefetch.pendingBodies, hash))
+                    array_add (bodiesHashes, hash);
+                if (NULL == lesLookupCachedReceipts (les, hash) &&
+                    -1 == lesPrefetchHashIndex (les->prefetch.pendingReceipts, hash))
+                    array_add (receiptsHashes, hash);
+                break;
+            }
+    }
+    pthread_mutex_unlock (&les->subscribersLock);
+
+    if (0 == array_count (bodiesHashes)) array_free (bodiesHashes);
+    else {
+        array_add_array (les->prefetch.pendingBodies, bodiesHashes, array_count (bodiesHashes));
+        lesAddRequest (les, node, les, lesHandlePrefetchProvision,
+                       (BREthereumProvision) {
+                           PROVISION_IDENTIFIER_UNDEFINED,
+                           PROVISION_BLOCK_BODIES,
+                           { .bodies = { bodiesHashes, NULL }}
+                       });
+    }
+
+    if (0 == array_count (receiptsHashes)) array_free (receiptsHashes);
+    else {
+        array_add_array (les->prefetch.pendingReceipts, receiptsHashes, array_count (receiptsHashes));
+        lesAddRequest (les, node, les, lesHandlePrefetchProvision,
+                       (BREthereumProvision) {
+                           PROVISION_IDENTIFIER_UNDEFINED,
+                           PROVISION_TRANSACTION_RECEIPTS,
+                           { .receipts = { receiptsHashes, NULL }}
+                       });
+    }
+}
+
+/**
+ * Keep the prefetched `headers`, replacing any at the same block number or else the oldest.
+ * Ownership of each header passes to `les`; `headers` is left empty.
+ */
+static void
+lesPrefetchCacheHeaders (BREthereumLES les,
+                         BRArrayOf(BREthereumBlockHeader) headers) {
+    for (size_t index = 0; index < array_count (headers); index++) {
+        BREthereumBlockHeader *slot = NULL;
+        for (size_t hi = 0; hi < LES_PREFETCH_LIMIT && NULL == slot; hi++)
+            if (NULL != les->prefetch.headers[hi] &&
+                blockHeaderGetNumber (headers[index]) == blockHeaderGetNumber (les->prefetch.headers[hi]))
+                slot = &les->prefetch.headers[hi];
+
+        if (NULL == slot) {
+            slot = &les->prefetch.headers[les->prefetch.headersNext];
+            les->prefetch.headersNext = (les->prefetch.headersNext + 1) % LES_PREFETCH_LIMIT;
+        }
+
+        blockHeaderRelease (*slot);
+        *slot = headers[index];
+    }
+    array_clear (headers);
+}
+
+/**
+ * Keep the prefetched bodies, replacing the oldest.  Ownership of each pair passes to `les`;
+ * `bodies->pairs` is left empty.
+ */
+static void
+lesPrefetchCacheBodies (BREthereumLES les,
+                        BREthereumProvisionBodies *bodies) {
+    size_t count = minimum ((int) array_count (bodies->hashes), (int) array_count (bodies->pairs));
+    for (size_t index = 0; index < count; index++) {
+        if (NULL == bodies->pairs[index].transactions ||
+            NULL != lesLookupPrefetchedBodies (les, bodies->hashes[index])) {
+            blockBodyPairRelease (&bodies->pairs[index]);
+            continue;
+        }
+
+        size_t next = les->prefetch.bodiesNext;
+        blockBodyPairRelease (&les->prefetch.bodies[next].pair);
+        les->prefetch.bodies[next].hash = bodies->hashes[index];
+        les->prefetch.bodies[next].pair = bodies->pairs[index];
+        les->prefetch.bodiesNext = (next + 1) % LES_PREFETCH_LIMIT;
+    }
+    for (size_t index = count; index < array_count (bodies->pairs); index++)
+        blockBodyPairRelease (&bodies->pairs[index]);
+    array_clear (bodies->pairs);
+}
+
+/**
+ * Handle a prefetch provision: keep its data, prefetch the blocks of matching headers, and then
+ * provide the requests waiting on it.
+ *
+ * @note Always called from the LES 'Main Thread'
+ */
+static void
+lesHandlePrefetchProvision (BREthereumLESProvisionContext context,
+                            BREthereumLES les,
+                            BREthereumNodeReference node,
+                            OwnershipGiven BREthereumProvisionResult result) {
+    BREthereumProvision *provision = &result.provision;
+
+    switch (provision->type) {
+        case PROVISION_BLOCK_HEADERS: {
+            BREthereumProvisionHeaders *headers = &provision->u.headers;
+            for (uint64_t number = headers->start; number < headers->start + headers->limit; number++) {
+                ssize_t index = lesPrefetchNumberIndex (les->prefetch.pendingHeaders, number);
+                if (-1 != index) array_rm (les->prefetch.pendingHeaders, index);
+            }
+            if (PROVISION_SUCCESS == result.status && NULL != headers->headers) {
+                lesPrefetchBlocks (les, node, headers->headers);
+                lesPrefetchCacheHeaders (les, headers->headers);
+            }
+            break;
+        }
+
+        case PROVISION_BLOCK_BODIES:
+            lesPrefetchHashesRemove (les->prefetch.pendingBodies, provision->u.bodies.hashes);
+            if (PROVISION_SUCCESS == result.status && NULL != provision->u.bodies.pairs)
+                lesPrefetchCacheBodies (les, &provision->u.bodies);
+            break;
+
+        case PROVISION_TRANSACTION_RECEIPTS:
+            // The receipts themselves were kept by lesHandleProvision(), in `receiptsCache`
+            lesPrefetchHashesRemove (les->prefetch.pendingReceipts, provision->u.receipts.hashes);
+            break;
+
+        default:
+            break;
+    }
+
+    provisionResultRelease (&result);
+    lesPrefetchProvideWaiters (les);
+}
+
+/**
+ * On an announce of `headNumber`, request the headers not yet requested between the LES head
+ * and `headNumber`, at most LES_PREFETCH_LIMIT of them - if any subscriber has prefetch filters.
+ *
+ * @note Always called from the LES 'Main Thread'
+ */
+static void
+lesPrefetchHeaders (BREthereumLES les,
+                    BREthereumNode node,
+                    uint64_t headNumber) {
+    int hasPrefetchFilters = 0;
+
+    pthread_mutex_lock (&les->subscribersLock);
+    FOR_SUBSCRIBERS (les, subscriber)
+        if (NULL != subscriber->prefetchFilters) hasPrefetchFilters = 1;
+    pthread_mutex_unlock (&les->subscribersLock);
+    if (!hasPrefetchFilters) return;
+
+    uint64_t start = 1 + (les->prefetch.number > les->head.number
+                          ? les->prefetch.number
+                          : les->head.number);
+    if (headNumber < start) return;
+    if (headNumber - start >= LES_PREFETCH_LIMIT) start = headNumber - LES_PREFETCH_LIMIT + 1;
+    les->prefetch.number = headNumber;
+
+    for (uint64_t number = start; number <= headNumber; number++)
+        array_add (les->prefetch.pendingHeaders, number);
+
+    lesAddRequest (les, (BREthereumNodeReference) node, les,
+                   lesHandlePrefetchProvision,
+                   (BREthereumProvision) {
+                       PROVISION_IDENTIFIER_UNDEFINED,
+                       PROVISION_BLOCK_HEADERS,
+                       { .headers = { start, 0, (uint32_t) (1 + headNumber - start),
+                                      ETHEREUM_BOOLEAN_FALSE, NULL }}
+                   });
+}
 
 /**
  * Handle a Node's Provision result by invoking the result's callback.  On success, the result
@@ -886,6 +1791,45 @@ lesHandleProvision (BREthereumLES les,
                 case PROVISION_SUCCESS:
                     // On success, invoke `request->callback`
 
+                    // Keep receipts for subsequent requests of the same blocks.
+                    if (PROVISION_TRANSACTION_RECEIPTS == result.provision.type)
+                        lesCacheReceipts (les, &result.provision.u.receipts);
+
+                    // If hedged, cancel the provision on the node that lost.  Either node's
+                    // provision, once cancelled, is released; the winner's is in `result`.
+                    if (NULL != request->hedge) {
+                        if (node == request->hedge)
+                            nodeCancelProvision (request->node,  &request->provision);
+                        else
+                            nodeCancelProvision (request->hedge, &request->hedgeProvision);
+                        request->hedge = NULL;
+                    }
+
+                    // A batch splits its results into each member, in order, and invokes each
+                    // member's callback.  Each member's provision is passed, with ownership.
+                    if (NULL != request->members) {
+                        BRArrayOf(BREthereumLESRequest) members = request->members;
+                        array_rm (les->requests, index);
+
+                        size_t offset = 0;
+                        for (size_t mi = 0; mi < array_count (members); mi++) {
+                            BREthereumLESRequest *member = &members[mi];
+                            offset = provisionBatchSplit (&result.provision, &member->provision, offset);
+                            member->callback (member->context,
+                                              les,
+                                              node,
+                                              (BREthereumProvisionResult) {
+                                                  member->provision.identifier,
+                                                  member->provision.type,
+                                                  PROVISION_SUCCESS,
+                                                  member->provision
+                                              });
+                        }
+                        provisionBatchRelease (&result.provision);
+                        array_free (members);
+                        return;
+                    }
+
                     // We've passed ownership of the provision, in result.  We can simply
                     // remove the request (which releases the result but we passed a copy,
                     // w/ provision and w/ provision references (to hashes, etc)).
@@ -952,6 +1896,8 @@ lesHandleNeighbor (BREthereumLES les,
                                   nodeEndpointCreate(neighbors[index]),
                                   (BREthereumNodeState) { NODE_AVAILABLE },
                                   NODE_PRIORITY_DIS,
+                                  0,
+                                  NULL,
                                   NULL);
     // array_free (neighbors);
 
@@ -997,9 +1943,21 @@ lesDeactivateNodeAtIndex (BREthereumLES les,
         for (size_t pi = 0; pi < array_count(provisions); pi++) {
             ssize_t requestIndex = lesFindRequestForProvision (les, &provisions[pi]);
             assert (-1 != requestIndex);
+            BREthereumLESRequest *request = &les->requests[requestIndex];
+
+            // If hedged, the other node continues alone; `node`'s copy of the provision is
+            // no longer shared with anything and is released.
+            if (NULL != request->hedge) {
+                provisionRelease (&provisions[pi], ETHEREUM_BOOLEAN_TRUE);
+                if (node != request->hedge) {
+                    request->provision = request->hedgeProvision;
+                    request->node = request->hedge;
+                }
+                request->hedge = NULL;
+            }
 
             // This reestablishes the provision as needing to be assigned.
-            les->requests[requestIndex].node = NULL;
+            else request->node = NULL;
         }
         array_free(provisions);
     }
@@ -1122,6 +2080,8 @@ lesThreadBootstrapSeeds (BREthereumLES les) {
                                           nodeEndpointCreateEnode(enodes[index]),
                                           (BREthereumNodeState) { NODE_AVAILABLE },
                                           enodesDecl[indexDecl].priority,
+                                          0,
+                                          NULL,
                                           &added);
 
             if (ETHEREUM_BOOLEAN_IS_TRUE(added))
@@ -1137,6 +2097,87 @@ lesThreadBootstrapSeeds (BREthereumLES les) {
     }
 }
 
+static struct timespec
+lesTimeNow (void) {
+    struct timeval now;
+    gettimeofday (&now, NULL);
+    return (struct timespec) { .tv_sec = now.tv_sec, .tv_nsec = 1000 * now.tv_usec };
+}
+
+static struct timespec
+lesTimeAfter (long nanoseconds) {
+    struct timespec time = lesTimeNow();
+    time.tv_nsec += nanoseconds;
+    time.tv_sec  += time.tv_nsec / 1000000000;
+    time.tv_nsec %= 1000000000;
+    return time;
+}
+
+// The time from now until `time`, or zero if `time` has passed.
+static struct timespec
+lesTimeUntil (struct timespec time) {
+    struct timespec now = lesTimeNow();
+    if (time.tv_sec < now.tv_sec || (time.tv_sec == now.tv_sec && time.tv_nsec <= now.tv_nsec))
+        return (struct timespec) { 0, 0 };
+
+    time.tv_sec  -= now.tv_sec;
+    time.tv_nsec -= now.tv_nsec;
+    if (time.tv_nsec < 0) { time.tv_sec -= 1; time.tv_nsec += 1000000000; }
+    return time;
+}
+
+static int
+lesTimeIsPast (struct timespec time) {
+    struct timespec until = lesTimeUntil (time);
+    return 0 == until.tv_sec && 0 == until.tv_nsec;
+}
+
+static struct timespec
+lesTimeAfterMilliseconds (uint64_t milliseconds) {
+    struct timespec time = lesTimeNow();
+    time.tv_sec  += (time_t) (milliseconds / 1000);
+    time.tv_nsec += (long) (milliseconds % 1000) * 1000000;
+    time.tv_sec  += time.tv_nsec / 1000000000;
+    time.tv_nsec %= 1000000000;
+    return time;
+}
+
+static int
+lesTimeIsBefore (struct timespec time1, struct timespec time2) {
+    return (time1.tv_sec < time2.tv_sec ||
+            (time1.tv_sec == time2.tv_sec && time1.tv_nsec < time2.tv_nsec));
+}
+
+/**
+ * Find the connected node, other than `exclude`, with the best expected time to complete
+ * `provision`.  Fill `estimate` (if non-NULL) with that time, in milliseconds.
+ */
+static BREthereumNode
+lesGetNodeForProvision (BREthereumLES les,
+                        BREthereumProvision *provision,
+                        BREthereumNode exclude,
+                        uint64_t *estimate) {
+    BREthereumNode best = NULL;
+    uint64_t bestEstimate = UINT64_MAX;
+
+    BRArrayOf(BREthereumNode) nodes = les->activeNodesByRoute[NODE_ROUTE_TCP];
+    for (size_t index = 0; index < array_count (nodes); index++) {
+        BREthereumNode node = nodes[index];
+        if (node != exclude &&
+            nodeHasState (node, NODE_ROUTE_TCP, NODE_CONNECTED) &&
+            ETHEREUM_BOOLEAN_IS_TRUE (nodeCanHandleProvision (node, *provision))) {
+            uint64_t nodeEstimate = nodeEstimateProvisionTime (node, provision);
+            if (nodeEstimate < bestEstimate) {
+                best = node;
+                bestEstimate = nodeEstimate;
+            }
+        }
+    }
+
+    if (NULL != estimate) *estimate = bestEstimate;
+    return best;
+}
+
 static void *
 lesThread (BREthereumLES les) {
 #if defined (__ANDROID__)
@@ -1144,8 +2185,10 @@ lesThread (BREthereumLES les) {
 #else
     pthread_setname_np (LES_THREAD_NAME);
 #endif
-    // TODO: Don't timeout pselect(); get some 'wakeup descriptor'
-    struct timespec timeout = { 0, 250000000 }; // .250 seconds
+    // The `pselect()` timeout is until `deadline`; a wakeup doesn't extend it but node activity
+    // does.  Thus nodes are looked for after LES_SELECT_TIMEOUT_NANOSECONDS with no activity.
+    struct timespec timeout;
+    struct timespec deadline = lesTimeAfter (LES_SELECT_TIMEOUT_NANOSECONDS);
 
     //
     fd_set readDescriptors, writeDesciptors;
@@ -1201,6 +2244,10 @@ lesThread (BREthereumLES les) {
         size_t requestsToFailCount = 0;
         size_t requestsToFail [array_count (les->requests)];
 
+        // The earliest time that a request must be looked at again - to send a batch that has
+        // stopped accepting members or to hedge a slow request.
+        struct timespec requestDeadline = deadline;
+
         //
         // Look at every request one-by-one.  If it has not been previously handled and a node is
         // available for handling it, then handle the request's provision
@@ -1211,6 +2258,13 @@ lesThread (BREthereumLES les) {
             if (NULL == les->requests[index].node) {
                 BREthereumNodeReference nodeRef = les->requests[index].nodeReference;
 
+                // Leave a batch to collect members until its deadline.
+                if (!lesTimeIsPast (les->requests[index].deadline)) {
+                    if (lesTimeIsBefore (les->requests[index].deadline, requestDeadline))
+                        requestDeadline = les->requests[index].deadline;
+                    continue;
+                }
+
                 // We require all arbitary references to have been resolved when the
                 // provision was added as a request.  An `arbitary` reference is something like
                 // NODE_REFERENCE_{ANY,ALL} where the request did not specify a specific node
@@ -1225,7 +2279,11 @@ lesThread (BREthereumLES les) {
      ? les->activeNodesByRoute[NODE_ROUTE_TCP][(int)(ref)]               \
      : NULL)
 
-                BREthereumNode nodeToUse = (NODE_REFERENCE_IS_GENERIC (nodeRef)
+                BREthereumProvision *provision = &les->requests[index].provision;
+                uint64_t estimate = 0;
+                BREthereumNode nodeToUse = (NODE_REFERENCE_BEST == nodeRef
+                                            ? lesGetNodeForProvision (les, provision, NULL, &estimate)
+                                            : NODE_REFERENCE_IS_GENERIC (nodeRef)
                                             ? ACTIVE_NODE (nodeRef)
                                             : (BREthereumNode) les->requests[index].nodeReference);
 #undef ACTIVE_NODE
@@ -1254,6 +2312,17 @@ lesThread (BREthereumLES les) {
                     // messages and to recv results.
                     nodeHandleProvision (les->requests[index].node,
                                          les->requests[index].provision);
+
+                    // A request for the best node can be hedged, if it is slow, on another.  A
+                    // transaction is never submitted twice.
+                    uint64_t hedgeAfter = LES_REQUEST_HEDGE_FACTOR * estimate;
+                    if (hedgeAfter < LES_REQUEST_HEDGE_MINIMUM_MILLISECONDS)
+                        hedgeAfter = LES_REQUEST_HEDGE_MINIMUM_MILLISECONDS;
+
+                    les->requests[index].hedgeDeadline =
+                    (NODE_REFERENCE_BEST == nodeRef && PROVISION_SUBMIT_TRANSACTION != provision->type
+                     ? lesTimeAfterMilliseconds (hedgeAfter)
+                     : (struct timespec) { 0, 0 });
                 }
 
                 // ... but if `nodeToUse` is not connected and it was explicitly requested, then
@@ -1263,6 +2332,29 @@ lesThread (BREthereumLES les) {
                     requestsToFail[requestsToFailCount++] = index;
             }
 
+            // If handled, but slowly, hedge the request by also having the next best node
+            // handle it.  The hedge gets its own copy of the provision.
+            else if (NULL == les->requests[index].hedge && 0 != les->requests[index].hedgeDeadline.tv_sec) {
+                BREthereumLESRequest *request = &les->requests[index];
+
+                if (!lesTimeIsPast (request->hedgeDeadline)) {
+                    if (lesTimeIsBefore (request->hedgeDeadline, requestDeadline))
+                        requestDeadline = request->hedgeDeadline;
+                }
+                else {
+                    request->hedgeDeadline = (struct timespec) { 0, 0 };
+                    request->hedge = lesGetNodeForProvision (les, &request->provision, request->node, NULL);
+                    if (NULL != request->hedge) {
+                        eth_log (LES_LOG_TOPIC, "Hedge: %s (%zu) on %s",
+                                 provisionGetTypeName (request->provision.type),
+                                 request->provision.identifier,
+                                 nodeEndpointGetHostname (nodeGetRemoteEndpoint (request->hedge)));
+                        request->hedgeProvision = provisionCopy (&request->provision, ETHEREUM_BOOLEAN_FALSE);
+                        nodeHandleProvision (request->hedge, request->hedgeProvision);
+                    }
+                }
+            }
+
         // We've requests to fail because the requested node is not connected.  Invoke the
         // request's callback with PROVISION_ERROR.
         //
@@ -1275,16 +2367,26 @@ lesThread (BREthereumLES les) {
             size_t requestIndex = requestsToFail[index];
             BREthereumLESRequest *request = &les->requests[requestIndex];
 
-            request->callback (request->context,
-                               les,
-                               request->nodeReference,
-                               (BREthereumProvisionResult) {
-                                   request->provision.identifier,
-                                   request->provision.type,
-                                   PROVISION_ERROR,
-                                   request->provision,
-                                   { .error = { PROVISION_ERROR_NODE_INACTIVE }}
-                               });
+            // A batch fails each of its members; the batch's own provision is ours to release.
+            size_t membersCount = (NULL == request->members ? 1 : array_count (request->members));
+            for (size_t mi = 0; mi < membersCount; mi++) {
+                BREthereumLESRequest *member = (NULL == request->members ? request : &request->members[mi]);
+                member->callback (member->context,
+                                  les,
+                                  request->nodeReference,
+                                  (BREthereumProvisionResult) {
+                                      member->provision.identifier,
+                                      member->provision.type,
+                                      PROVISION_ERROR,
+                                      member->provision,
+                                      { .error = { PROVISION_ERROR_NODE_INACTIVE }}
+                                  });
+            }
+
+            if (NULL != request->members) {
+                provisionRelease (&request->provision, ETHEREUM_BOOLEAN_TRUE);
+                array_free (request->members);
+            }
         }
 
         // ... and then remove them in reverse order.
@@ -1294,9 +2396,10 @@ lesThread (BREthereumLES les) {
         //
         // Update the read (and write) descriptors to include nodes that are 'active' on any route.
         //
-        maximumDescriptor = -1;
+        maximumDescriptor = les->wakeup[0];
         FD_ZERO (&readDescriptors);
         FD_ZERO (&writeDesciptors);
+        FD_SET (les->wakeup[0], &readDescriptors);
 
         FOR_EACH_ROUTE(route) {
             BRArrayOf(BREthereumNode) nodes = les->activeNodesByRoute[route];
@@ -1308,11 +2411,39 @@ lesThread (BREthereumLES les) {
                                                                     &writeDesciptors));
         }
 
+        // A node waiting on flow-control credits won't select as writable; wake up once it has
+        // recharged enough to send.
+        BRArrayOf(BREthereumNode) tcpNodes = les->activeNodesByRoute[NODE_ROUTE_TCP];
+        for (size_t index = 0; index < array_count (tcpNodes); index++) {
+            uint64_t delay = nodeGetSendDelay (tcpNodes[index]);
+            if (delay > 0) {
+                struct timespec sendDeadline = lesTimeAfterMilliseconds (delay);
+                if (lesTimeIsBefore (sendDeadline, requestDeadline))
+                    requestDeadline = sendDeadline;
+            }
+        }
+
+        timeout = lesTimeUntil (requestDeadline);
+
         pthread_mutex_unlock (&les->lock);
         int selectCount = pselect (1 + maximumDescriptor, &readDescriptors, &writeDesciptors, NULL, &timeout, NULL);
         pthread_mutex_lock (&les->lock);
         if (les->theTimeToQuitIsNow) continue;
 
+        // If woken, drain the wakeup descriptor.  Then, if no node is ready and the deadline
+        // has not passed, this loop simply handles whatever the wakeup, or a batch, was for.
+        int isWakeup = (selectCount > 0 && FD_ISSET (les->wakeup[0], &readDescriptors));
+        if (isWakeup) {
+            uint8_t bytes[16];
+            while (read (les->wakeup[0], bytes, sizeof (bytes)) > 0)
+                ;
+            selectCount -= 1;
+        }
+
+        int isTimeout = (0 == selectCount && lesTimeIsPast (deadline));
+        if (selectCount > 0 || isTimeout)
+            deadline = lesTimeAfter (LES_SELECT_TIMEOUT_NANOSECONDS);
+
         // We've been asked to 'clean' - which means 'reclaim memory if possible'.  We'll ask
         // all nodes to clean up; but, only the active ones will have much to do.
         if (les->theTimeToCleanIsNow) {
@@ -1352,9 +2483,10 @@ lesThread (BREthereumLES les) {
         }
 
         //
-        // We have one or more nodes ready to process ...
+        // We have one or more nodes ready to process, or a node's handshake crypto completed
+        // (only a wakeup tells us that) ...
         //
-        if (selectCount > 0) {
+        if (selectCount > 0 || isWakeup) {
             FOR_EACH_ROUTE (route) {
                 BRArrayOf(BREthereumNode) nodes = les->activeNodesByRoute[route];
                 for (size_t index = 0; index < array_count(nodes); index++) {
@@ -1389,16 +2521,21 @@ lesThread (BREthereumLES les) {
         }
 
         //
-        // or we have a timeout ... nothing to receive; nothing to send
+        // and/or we have a timeout ... nothing to receive; nothing to send
         //
-        else if (selectCount == 0) {
-
-            // If we don't have enough availableNodes, try to discover some
-            if (ETHEREUM_BOOLEAN_IS_TRUE(les->discoverNodes) &&
-                array_count(les->availableNodes) < LES_AVAILABLE_NODES_COUNT &&
-                // We won't look any more if we we have enough nodes already looking.  Upon
-                // discovery, the UPD node will will go inactive and we'll look again.
-                array_count(les->activeNodesByRoute[NODE_ROUTE_UDP]) < LES_ACTIVE_NODE_UDP_LIMIT) {
+        if (isTimeout) {
+
+            // If we don't have enough availableNodes, try to discover some.  Start discovery on
+            // as many nodes as allowed at once, rather than one per timeout, as the UDP exchanges
+            // are handled concurrently by `pselect()`.
+            for (size_t attempts = 0;
+                 (attempts < LES_ACTIVE_NODE_UDP_LIMIT &&
+                  ETHEREUM_BOOLEAN_IS_TRUE(les->discoverNodes) &&
+                  array_count(les->availableNodes) < LES_AVAILABLE_NODES_COUNT &&
+                  // We won't look any more if we we have enough nodes already looking.  Upon
+                  // discovery, the UPD node will will go inactive and we'll look again.
+                  array_count(les->activeNodesByRoute[NODE_ROUTE_UDP]) < LES_ACTIVE_NODE_UDP_LIMIT);
+                 attempts++) {
 
                 // Find a 'discovery' node by looking in: activeNodesByRoute[NODE_ROUTE_TCP],
                 // availableNodes and then finally allNodes.  If that fails, try harder (see
@@ -1424,14 +2561,19 @@ lesThread (BREthereumLES les) {
                 }
             }
 
-            // If we don't have enough connectedNodes, try to add one.  Note: when we created
+            // If we don't have enough connectedNodes, try to add them.  Note: when we created
             // the node (as part of UDP discovery) we give it our endpoint info (like headNum).
             // But now that is likely out of date as we've synced/progressed/chained.  I think the
             // upcoming `nodeConnect()` needs a new `status` - but how do we update the status as
             // only BCS knows where we are?
-
-            if (array_count(les->activeNodesByRoute[NODE_ROUTE_TCP]) < LES_ACTIVE_NODE_COUNT &&
-                array_count(les->availableNodes) > 0) {
+            //
+            // Connect as many as are needed at once; the handshake crypto runs on worker threads
+            // and so the handshakes proceed in parallel.
+            for (size_t attempts = 0;
+                 (attempts < LES_ACTIVE_NODE_COUNT &&
+                  array_count(les->activeNodesByRoute[NODE_ROUTE_TCP]) < LES_ACTIVE_NODE_COUNT &&
+                  array_count(les->availableNodes) > 0);
+                 attempts++) {
                 BREthereumNode node = les->availableNodes[0];
 
                 nodeConnect (node, NODE_ROUTE_TCP, now);
@@ -1475,7 +2617,7 @@ lesThread (BREthereumLES les) {
         //
         // or we have an pselect() error.
         //
-        else lesHandleSelectError (les, errno);
+        else if (selectCount < 0) lesHandleSelectError (les, errno);
 
         // double check that everything has been handled.
         assert (0 == array_count(nodesToRemove));
@@ -1492,12 +2634,16 @@ lesThread (BREthereumLES les) {
 
     // Callback on Node Config.  Create the set of configs based on the current node -in
     // particular the node's state.  When we load these configs (see lesCreate()) many of the
-    // node states will be remapped to 'NODE_AVAILABLE'
-    BRArrayOf(BREthereumNodeConfig) configs;
-    array_new (configs, BRSetCount(les->nodes));
-    FOR_NODES (les, node)
-        array_add (configs, nodeConfigCreate(node));
-    les->callbackSaveNodes (les->callbackContext, configs);
+    // node states will be remapped to 'NODE_AVAILABLE'.  Each subscriber owns its configs.
+    pthread_mutex_lock (&les->subscribersLock);
+    FOR_SUBSCRIBERS (les, subscriber) {
+        BRArrayOf(BREthereumNodeConfig) configs;
+        array_new (configs, BRSetCount(les->nodes));
+        FOR_NODES (les, node)
+            array_add (configs, nodeConfigCreate(node));
+        subscriber->saveNodes (subscriber->context, configs);
+    }
+    pthread_mutex_unlock (&les->subscribersLock);
 
     // Disconnect all active nodes
     FOR_EACH_ROUTE(route) {
@@ -1556,8 +2702,40 @@ lesAddRequestSpecifically (BREthereumLES les,
                            BREthereumLESProvisionCallback callback,
                            OwnershipGiven BREthereumProvision provision) {
     provision.identifier = les->requestsIdentifier++;
-    BREthereumLESRequest request = { context, callback, provision, node, NULL };
-    array_add (les->requests, request);
+    BREthereumLESRequest request = { context, callback, provision, node, NULL, NULL, { 0, 0 } };
+
+    if (ETHEREUM_BOOLEAN_IS_FALSE (provisionIsBatchable (&provision)) ||
+        provisionGetCount (&provision) >= LES_REQUEST_BATCH_LIMIT) {
+        array_add (les->requests, request);
+        return;
+    }
+
+    // Join a batch that is still collecting members, if one is compatible ...
+    for (size_t index = 0; index < array_count (les->requests); index++) {
+        BREthereumLESRequest *batch = &les->requests[index];
+        if (NULL != batch->members && NULL == batch->node &&
+            node == batch->nodeReference &&
+            !lesTimeIsPast (batch->deadline) &&
+            ETHEREUM_BOOLEAN_IS_TRUE (provisionBatchAppend (&batch->provision, &provision, LES_REQUEST_BATCH_LIMIT))) {
+            array_add (batch->members, request);
+            return;
+        }
+    }
+
+    // ... or start a new one, with its own identifier, to be sent once the window has passed.
+    BREthereumLESRequest batch = {
+        NULL,
+        NULL,
+        provisionCopy (&provision, ETHEREUM_BOOLEAN_FALSE),
+        node,
+        NULL,
+        NULL,
+        lesTimeAfter (LES_REQUEST_BATCH_NANOSECONDS)
+    };
+    batch.provision.identifier = les->requestsIdentifier++;
+    array_new (batch.members, 4);
+    array_add (batch.members, request);
+    array_add (les->requests, batch);
 }
 
 /**
@@ -1577,8 +2755,8 @@ lesAddRequest (BREthereumLES les,
                OwnershipGiven BREthereumProvision provision) {
     assert (PROVISION_IDENTIFIER_UNDEFINED == provision.identifier);
 
-    if (NODE_REFERENCE_NIL == node) node = NODE_REFERENCE_0;
-    if (NODE_REFERENCE_ANY == node) node = NODE_REFERENCE_0;
+    if (NODE_REFERENCE_NIL == node) node = NODE_REFERENCE_BEST;
+    if (NODE_REFERENCE_ANY == node) node = NODE_REFERENCE_BEST;
 
     pthread_mutex_lock (&les->lock);
     if (NODE_REFERENCE_ALL != node)
@@ -1590,6 +2768,8 @@ lesAddRequest (BREthereumLES les,
         // Handle `OwnershipGiven`
         provisionRelease (&provision, ETHEREUM_BOOLEAN_TRUE);
     }
+    // Have `lesThread` establish the provision now, rather than on its next timeout.
+    lesWakeup (les);
     pthread_mutex_unlock (&les->lock);
 }
 
@@ -1620,12 +2800,16 @@ lesProvideBlockHeaders (BREthereumLES les,
                         uint32_t limit,
                         uint64_t skip,
                         BREthereumBoolean reverse) {
-    lesAddRequest (les, node, context, callback,
-                   (BREthereumProvision) {
-                       PROVISION_IDENTIFIER_UNDEFINED,
-                       PROVISION_BLOCK_HEADERS,
-                       { .headers = { start, skip, limit, reverse, NULL }}
-                   });
+    BREthereumProvision provision = {
+        PROVISION_IDENTIFIER_UNDEFINED,
+        PROVISION_BLOCK_HEADERS,
+        { .headers = { start, skip, limit, reverse, NULL }}
+    };
+
+    pthread_mutex_lock (&les->lock);
+    if (ETHEREUM_BOOLEAN_IS_FALSE (lesPrefetchProvide (les, node, context, callback, provision)))
+        lesAddRequest (les, node, context, callback, provision);
+    pthread_mutex_unlock (&les->lock);
 }
 
 extern void
@@ -1660,12 +2844,16 @@ lesProvideBlockBodies (BREthereumLES les,
                        BREthereumLESProvisionContext context,
                        BREthereumLESProvisionCallback callback,
                        OwnershipGiven BRArrayOf(BREthereumHash) blockHashes) {
-    lesAddRequest (les, node, context, callback,
-                   (BREthereumProvision) {
-                       PROVISION_IDENTIFIER_UNDEFINED,
-                       PROVISION_BLOCK_BODIES,
-                       { .bodies = { blockHashes, NULL }}
-                   });
+    BREthereumProvision provision = {
+        PROVISION_IDENTIFIER_UNDEFINED,
+        PROVISION_BLOCK_BODIES,
+        { .bodies = { blockHashes, NULL }}
+    };
+
+    pthread_mutex_lock (&les->lock);
+    if (ETHEREUM_BOOLEAN_IS_FALSE (lesPrefetchProvide (les, node, context, callback, provision)))
+        lesAddRequest (les, node, context, callback, provision);
+    pthread_mutex_unlock (&les->lock);
 }
 
 extern void
@@ -1684,12 +2872,53 @@ lesProvideReceipts (BREthereumLES les,
                     BREthereumLESProvisionContext context,
                     BREthereumLESProvisionCallback callback,
                     OwnershipGiven BRArrayOf(BREthereumHash) blockHashes) {
-    lesAddRequest (les, node, context, callback,
-                   (BREthereumProvision) {
-                       PROVISION_IDENTIFIER_UNDEFINED,
-                       PROVISION_TRANSACTION_RECEIPTS,
-                       { .receipts = { blockHashes, NULL }}
-                   });
+    BRArrayOf(BREthereumHash) cachedHashes = NULL;
+    BRArrayOf(BRArrayOf(BREthereumTransactionReceipt)) cachedReceipts = NULL;
+
+    pthread_mutex_lock (&les->lock);
+
+    // Take blocks with cached receipts out of the request ...
+    for (size_t index = 0; index < array_count (blockHashes); ) {
+        BRArrayOf(BREthereumTransactionReceipt) receipts = lesLookupCachedReceipts (les, blockHashes[index]);
+        if (NULL == receipts) { index++; continue; }
+
+        if (NULL == cachedHashes) {
+            array_new (cachedHashes,   array_count (blockHashes));
+            array_new (cachedReceipts, array_count (blockHashes));
+        }
+        array_add (cachedHashes,   blockHashes[index]);
+        array_add (cachedReceipts, transactionReceiptsCopy (receipts));
+        array_rm  (blockHashes, index);
+    }
+
+    // ... and provide them now, as a successful provision of their own.
+    if (NULL != cachedHashes) {
+        BREthereumProvision provision = {
+            les->requestsIdentifier++,
+            PROVISION_TRANSACTION_RECEIPTS,
+            { .receipts = { cachedHashes, cachedReceipts }}
+        };
+        callback (context, les, node,
+                  (BREthereumProvisionResult) {
+                      provision.identifier,
+                      provision.type,
+                      PROVISION_SUCCESS,
+                      provision
+                  });
+    }
+
+    if (0 == array_count (blockHashes)) array_free (blockHashes);
+    else {
+        // The rest, if all being prefetched, wait on the prefetch; otherwise they are requested.
+        BREthereumProvision provision = {
+            PROVISION_IDENTIFIER_UNDEFINED,
+            PROVISION_TRANSACTION_RECEIPTS,
+            { .receipts = { blockHashes, NULL }}
+        };
+        if (ETHEREUM_BOOLEAN_IS_FALSE (lesPrefetchProvide (les, node, context, callback, provision)))
+            lesAddRequest (les, node, context, callback, provision);
+    }
+    pthread_mutex_unlock (&les->lock);
 }
 
 extern void
@@ -1713,7 +2942,7 @@ lesProvideAccountStates (BREthereumLES les,
                    (BREthereumProvision) {
                        PROVISION_IDENTIFIER_UNDEFINED,
                        PROVISION_ACCOUNTS,
-                       { .accounts = { address, blockHashes, NULL }}
+                       { .accounts = { .address = address, .hashes = blockHashes }}
                    });
 }
 
@@ -1728,6 +2957,27 @@ lesProvideAccountStatesOne (BREthereumLES les,
                              lesCreateHashArray(les, blockHash));
 }
 
+extern void
+lesProvideAccountStatesMultiple (BREthereumLES les,
+                                 BREthereumNodeReference node,
+                                 BREthereumLESProvisionContext context,
+                                 BREthereumLESProvisionCallback callback,
+                                 OwnershipGiven BRArrayOf(BREthereumAddress) addresses,
+                                 BREthereumHash blockHash,
+                                 BREthereumHash stateRoot) {
+    BRArrayOf(BREthereumHash) blockHashes;
+    array_new (blockHashes, array_count (addresses));
+    for (size_t index = 0; index < array_count (addresses); index++)
+        array_add (blockHashes, blockHash);
+
+    lesAddRequest (les, node, context, callback,
+                   (BREthereumProvision) {
+                       PROVISION_IDENTIFIER_UNDEFINED,
+                       PROVISION_ACCOUNTS,
+                       { .accounts = { .hashes = blockHashes, .addresses = addresses, .stateRoot = stateRoot }}
+                   });
+}
+
 extern void
 lesProvideTransactionStatus (BREthereumLES les,
                              BREthereumNodeReference node,
@@ -1758,11 +3008,16 @@ lesSubmitTransaction (BREthereumLES les,
                       BREthereumLESProvisionContext context,
                       BREthereumLESProvisionCallback callback,
                       OwnershipGiven BREthereumTransaction transaction) {
+    // Submissions made within LES_REQUEST_BATCH_NANOSECONDS are sent together.
+    BRArrayOf(BREthereumTransaction) transactions;
+    array_new (transactions, 1);
+    array_add (transactions, transaction);
+
     lesAddRequest (les, node, context, callback,
                    (BREthereumProvision) {
                        PROVISION_IDENTIFIER_UNDEFINED,
                        PROVISION_SUBMIT_TRANSACTION,
-                       { .submission = { transaction, {} }}
+                       { .submission = { transactions, NULL }}
                    });
 }
 
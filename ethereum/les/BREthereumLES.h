@@ -172,7 +172,7 @@ typedef void
  * ...
  *
  * @result
- * A new LES interface handler.
+ * A new LES interface handler, or NULL if one can't be created (the `configs` are released).
  */
 extern BREthereumLES
 lesCreate (BREthereumNetwork network,
@@ -197,6 +197,74 @@ lesCreate (BREthereumNetwork network,
 extern void
 lesRelease(BREthereumLES les);
 
+/*!
+ * @function lesCreateShared
+ *
+ * @abstract
+ * Return the LES shared by all users of `network` with matching `discoverNodes` and
+ * `handleSync`, creating it, as lesCreate() would but without callbacks, if needed.  One shared
+ * LES has one set of nodes, connections and requests; add callbacks with lesAddSubscriber().
+ * The head and `configs` are only used when the LES is created.  Returns NULL, like lesCreate(),
+ * if the LES can't be created.
+ *
+ * @discussion
+ * Each lesCreateShared() must be balanced by lesReleaseShared(); the LES is released with the
+ * last one.  A shared LES may be started, with lesStart(), by any user; it should not be
+ * stopped, with lesStop(), while other users remain.
+ */
+extern BREthereumLES
+lesCreateShared (BREthereumNetwork network,
+                 BREthereumHash headHash,
+                 uint64_t headNumber,
+                 UInt256 headTotalDifficulty,
+                 BREthereumHash genesisHash,
+                 OwnershipGiven BRSetOf(BREthereumNodeConfig) configs,
+                 BREthereumBoolean discoverNodes,
+                 BREthereumBoolean handleSync);
+
+extern void
+lesReleaseShared (BREthereumLES les);
+
+/*!
+ * @function lesAddSubscriber
+ *
+ * @abstract
+ * Add callbacks for announce, status and save nodes.  All subscribers receive every callback;
+ * each receives its own copy of the saved nodes.
+ */
+extern void
+lesAddSubscriber (BREthereumLES les,
+                  BREthereumLESCallbackContext callbackContext,
+                  BREthereumLESCallbackAnnounce callbackAnnounce,
+                  BREthereumLESCallbackStatus callbackStatus,
+                  BREthereumLESCallbackSaveNodes callbackSaveNodes);
+
+/*!
+ * @function lesRemoveSubscriber
+ *
+ * @abstract
+ * Remove the callbacks for `callbackContext`.  On return no further callbacks will be made,
+ * including provision callbacks for requests made with `callbackContext` as their context (see
+ * lesCancelProvisions()).
+ */
+extern void
+lesRemoveSubscriber (BREthereumLES les,
+                     BREthereumLESCallbackContext callbackContext);
+
+/*!
+ * @function lesSetPrefetchFilters
+ *
+ * @abstract
+ * Set the address filters, from blockAddressesFiltersCreate(), for `callbackContext`.  On an
+ * announce LES prefetches the new headers and, for those matching any subscriber's filters, the
+ * block bodies and receipts; later requests for them are then provided from the prefetched data.
+ * Pass NULL to stop prefetching for `callbackContext`.
+ */
+extern void
+lesSetPrefetchFilters (BREthereumLES les,
+                       BREthereumLESCallbackContext callbackContext,
+                       OwnershipGiven BREthereumBloomFilterSet filters);
+
 extern void
 lesStart (BREthereumLES les);
 
@@ -219,6 +287,23 @@ lesSetNodePrefer (BREthereumLES les,
 extern BREthereumNodeReference
 lesGetNodePrefer (BREthereumLES les);
 
+/**
+ * Fill `nodes` with up to `nodesCount` connected nodes, in the order of preference, and return
+ * the number filled.  Provide any of `nodes` to lesProvide*() to pick the node for a request.
+ */
+extern size_t
+lesGetNodes (BREthereumLES les,
+             BREthereumNodeReference *nodes,
+             size_t nodesCount);
+
+/**
+ * Return the bytes held by `les`: its RLP coder, its node set and every node's buffers, its
+ * pending requests and its receipts cache (the arrays, not the receipts' logs).  A shared LES
+ * (see lesCreateShared()) reports the same bytes to each subscriber.
+ */
+extern size_t
+lesGetMemoryUsage (BREthereumLES les);
+
 extern const char *
 lesGetNodeHostname (BREthereumLES les,
                     BREthereumNodeReference node);
@@ -362,6 +447,42 @@ lesProvideAccountStatesOne (BREthereumLES les,
                             BREthereumAddress address,
                             BREthereumHash blockHash);
 
+/**
+ * @function lesCancelProvisions
+ *
+ * Cancel the callbacks of all outstanding requests with `context`, such as when `context` is
+ * about to be released.  The requests still complete but their results are released, without
+ * a callback.
+ */
+extern void
+lesCancelProvisions (BREthereumLES les,
+                     BREthereumLESProvisionContext context);
+
+/**
+ * @function lesProvideAccountStatesMultiple
+ *
+ * Provide the account states of many addresses at one block.  The addresses are requested
+ * together, in as few GetProofs messages as the message limit allows, and each response's
+ * proofs are verified against `stateRoot` with one shared MPT node cache.  A response with any
+ * proof that fails to verify fails the provision.  The provision's `addresses` holds the
+ * addresses, in order, for provisionAccountsConsumeMultiple().
+ *
+ * @param les
+ * @param context
+ * @param callback
+ * @param addresses
+ * @param blockHash
+ * @param stateRoot the state root of the block with `blockHash`
+ */
+extern void
+lesProvideAccountStatesMultiple (BREthereumLES les,
+                                 BREthereumNodeReference node,
+                                 BREthereumLESProvisionContext context,
+                                 BREthereumLESProvisionCallback callback,
+                                 OwnershipGiven BRArrayOf(BREthereumAddress) addresses,
+                                 BREthereumHash blockHash,
+                                 BREthereumHash stateRoot);
+
 /**
  * @function lesProvideTransactionStauts
  *
@@ -92,7 +92,7 @@
 
 // When discovering nodes (on UDP) don't allow more then LES_ACTIVE_NODE_UDP_LIMIT nodes to be
 // actively discovering at once.
-#define LES_ACTIVE_NODE_UDP_LIMIT 3
+#define LES_ACTIVE_NODE_UDP_LIMIT 6
 
 // The number of nodes that should be available.  We'll discover nodes until we reach this count.
 // Note that this doesn mean that the nodes are LESv2 or PIPv1 nodes - they are just nodes.  As
@@ -9,6 +9,7 @@
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 
 #include <stdlib.h>
+#include <assert.h>
 #include "support/BRArray.h"
 #include "support/BRCrypto.h"
 #include "support/BRKey.h"
@@ -38,6 +39,10 @@ struct BREthereumLESFrameCoderContext {
 
     //Encryption for Mac
     UInt256 macSecretKey;
+
+    // Expanded AES key schedules, for the frame AES-CTR and for the MAC AES-ECB
+    uint8_t aesSchedule[256];
+    uint8_t macSecretSchedule[256];
     
     // Ingress ciphertext
     BRKeccak ingressMac;
@@ -51,15 +56,9 @@ struct BREthereumLESFrameCoderContext {
     //Encrpty Key for AES-CTR frame
     uint8_t* aesEncryptKey;
     
-    //AES Cipher Total Amount
-    size_t aesEncryptCipherLen;
-
     //Decrypty Key for AES-CTR frame
     uint8_t* aesDecryptKey;
     
-    //Decrypt Cipher Total Amount
-    size_t aesDecrptyCipherLen;
-    
 };
 
 //
@@ -80,138 +79,30 @@ static void _BRECDH(void *out32, const BRKey *privKey, BRKey *pubKey)
 }
 
 
-// BIP38 is a method for encrypting private keys with a passphrase
-// https://github.com/bitcoin/bips/blob/master/bip-0038.mediawiki
-static const uint8_t sbox[256] = {
-    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
-    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
-    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
-    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
-    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
-    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
-    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
-    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
-    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
-    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
-    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
-    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
-    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
-    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
-    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
-    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
-};
-
-static const uint8_t sboxi[256] = {
-    0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
-    0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
-    0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
-    0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49, 0x6d, 0x8b, 0xd1, 0x25,
-    0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92,
-    0x6c, 0x70, 0x48, 0x50, 0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
-    0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05, 0xb8, 0xb3, 0x45, 0x06,
-    0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02, 0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b,
-    0x3a, 0x91, 0x11, 0x41, 0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
-    0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
-    0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89, 0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
-    0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
-    0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
-    0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
-    0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
-    0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d
-};
-
-#define xt(x) (((x) << 1) ^ ((((x) >> 7) & 1)*0x1b))
-
-static void _BRAES256ECBEncrypt(const void *key32, void *buf16)
-{
-    size_t i, j;
-    uint32_t key[32/4], buf[16/4];
-    uint8_t *x = (uint8_t *)buf, *k = (uint8_t *)key, r = 1, a, b, c, d, e;
-    
-    memcpy(key, key32, sizeof(key));
-    memcpy(buf, buf16, sizeof(buf));
-    
-    for (i = 0; i < 14; i++) {
-        for (j = 0; j < 4; j++) buf[j] ^= key[j + (i & 1)*4]; // add round key
-        
-        for (j = 0; j < 16; j++) x[j] = sbox[x[j]]; // sub bytes
-        
-        // shift rows
-        a = x[1], x[1] = x[5], x[5] = x[9], x[9] = x[13], x[13] = a, a = x[10], x[10] = x[2], x[2] = a;
-        a = x[3], x[3] = x[15], x[15] = x[11], x[11] = x[7], x[7] = a, a = x[14], x[14] = x[6], x[6] = a;
-        
-        for (j = 0; i < 13 && j < 16; j += 4) { // mix columns
-            a = x[j], b = x[j + 1], c = x[j + 2], d = x[j + 3], e = a ^ b ^ c ^ d;
-            x[j] ^= e ^ xt(a ^ b), x[j + 1] ^= e ^ xt(b ^ c), x[j + 2] ^= e ^ xt(c ^ d), x[j + 3] ^= e ^ xt(d ^ a);
-        }
-        
-        if ((i % 2) != 0) { // expand key
-            k[0] ^= sbox[k[29]] ^ r, k[1] ^= sbox[k[30]], k[2] ^= sbox[k[31]], k[3] ^= sbox[k[28]], r = xt(r);
-            for (j = 4; j < 16; j++) k[j] ^= k[j - 4];
-            k[16] ^= sbox[k[12]], k[17] ^= sbox[k[13]], k[18] ^= sbox[k[14]], k[19] ^= sbox[k[15]];
-            for (j = 20; j < 32; j++) k[j] ^= k[j - 4];
-        }
-    }
-    
-    var_clean(&r, &a, &b, &c, &d, &e);
-    for (i = 0; i < 4; i++) buf[i] ^= key[i]; // final add round key
-    mem_clean(key, sizeof(key));
-    memcpy(buf16, buf, sizeof(buf));
-    mem_clean(buf, sizeof(buf));
-}
+// The frame ciphertext is MACed as it is en/decrypted, this many bytes at a time, so that each chunk is still
+// in cache when the keccak absorbs it.
+#define FRAME_CODER_CHUNK_SIZE   (4096)
 
-#pragma clang diagnostic push
-#pragma GCC diagnostic push
-#pragma clang diagnostic ignored "-Wunused-function"
-#pragma GCC diagnostic ignored "-Wunused-function"
-static void _BRAES256ECBDecrypt(const void *key32, void *buf16)
-{
-    size_t i, j;
-    uint32_t key[32/4], buf[16/4];
-    uint8_t *x = (uint8_t *)buf, *k = (uint8_t *)key, r = 1, a, b, c, d, e, f, g, h;
-    
-    memcpy(key, key32, sizeof(key));
-    memcpy(buf, buf16, sizeof(buf));
-    
-    for (i = 0; i < 7; i++) { // expand key
-        k[0] ^= sbox[k[29]] ^ r, k[1] ^= sbox[k[30]], k[2] ^= sbox[k[31]], k[3] ^= sbox[k[28]], r = xt(r);
-        for (j = 4; j < 16; j++) k[j] ^= k[j - 4];
-        k[16] ^= sbox[k[12]], k[17] ^= sbox[k[13]], k[18] ^= sbox[k[14]], k[19] ^= sbox[k[15]];
-        for (j = 20; j < 32; j++) k[j] ^= k[j - 4];
-    }
-    
-    for (i = 0; i < 14; i++) {
-        for (j = 0; j < 4; j++) buf[j] ^= key[j + (i & 1)*4]; // add round key
-        
-        for (j = 0; i > 0 && j < 16; j += 4) { // unmix columns
-            a = x[j], b = x[j + 1], c = x[j + 2], d = x[j + 3], e = a ^ b ^ c ^ d;
-            h = xt(e), f = e ^ xt(xt(h ^ a ^ c)), g = e ^ xt(xt(h ^ b ^ d));
-            x[j] ^= f ^ xt(a ^ b), x[j + 1] ^= g ^ xt(b ^ c), x[j + 2] ^= f ^ xt(c ^ d), x[j + 3] ^= g ^ xt(d ^ a);
-        }
-        
-        // unshift rows
-        a = x[1], x[1] = x[13], x[13] = x[9], x[9] = x[5], x[5] = a, a = x[2], x[2] = x[10], x[10] = a;
-        a = x[3], x[3] = x[7], x[7] = x[11], x[11] = x[15], x[15] = a, a = x[6], x[6] = x[14], x[14] = a;
-        
-        for (j = 0; j < 16; j++) x[j] = sboxi[x[j]]; // unsub bytes
-        
-        if ((i % 2) == 0) { // unexpand key
-            for (j = 28; j > 16; j--) k[j + 3] ^= k[j - 1];
-            k[16] ^= sbox[k[12]], k[17] ^= sbox[k[13]], k[18] ^= sbox[k[14]], k[19] ^= sbox[k[15]];
-            for (j = 12; j > 0; j--) k[j + 3] ^= k[j - 1];
-            r = (r >> 1) ^ ((r & 1)*0x8d);
-            k[0] ^= sbox[k[29]] ^ r, k[1] ^= sbox[k[30]], k[2] ^= sbox[k[31]], k[3] ^= sbox[k[28]];
-        }
+/**
+ * AES-CTR en/decrypt `data` into `out` (which may be the same), absorbing the ciphertext into
+ * `mac` chunk by chunk.  The length must be a multiple of 16 to keep `iv` on a block boundary.
+ */
+static void
+frameCoderCryptAndMac (BREthereumLESFrameCoder fCoder,
+                       BRKeccak mac,
+                       uint8_t *iv,
+                       uint8_t *out,
+                       const uint8_t *data,
+                       size_t dataLen,
+                       int encrypt) {
+    assert (0 == dataLen % 16);
+    for (size_t offset = 0; offset < dataLen; offset += FRAME_CODER_CHUNK_SIZE) {
+        size_t chunkLen = (dataLen - offset < FRAME_CODER_CHUNK_SIZE ? dataLen - offset : FRAME_CODER_CHUNK_SIZE);
+        if (!encrypt) keccak_update (mac, &data[offset], chunkLen);
+        BRAESCTRSchedule (&out[offset], fCoder->aesSchedule, 32, iv, &data[offset], chunkLen);
+        if (encrypt) keccak_update (mac, &out[offset], chunkLen);
     }
-    
-    var_clean(&r, &a, &b, &c, &d, &e, &f, &g, &h);
-    for (i = 0; i < 4; i++) buf[i] ^= key[i]; // final add round key
-    mem_clean(key, sizeof(key));
-    memcpy(buf16, buf, sizeof(buf));
-    mem_clean(buf, sizeof(buf));
 }
-#pragma clang diagnostic pop
-#pragma GCC diagnostic pop
 //
 // Public Functions
 //
@@ -275,12 +166,12 @@ BREthereumBoolean frameCoderInit(BREthereumLESFrameCoder fcoder,
     array_new(fcoder->aesEncryptKey, 32);
     array_add_array(fcoder->aesDecryptKey, &keyMaterial[32], 32);
     array_add_array(fcoder->aesEncryptKey, &keyMaterial[32], 32);
-    fcoder->aesDecrptyCipherLen = 0;
-    fcoder->aesEncryptCipherLen = 0;
+    BRAESKeySchedule(fcoder->aesSchedule, &keyMaterial[32], 32);
 
     // mac-secret = sha3(ecdhe-shared-secret || aes-secret)
     BRKeccak256(&keyMaterial[32], keyMaterial, 64);
     memcpy(fcoder->macSecretKey.u8,&keyMaterial[32], 32);
+    BRAESKeySchedule(fcoder->macSecretSchedule, fcoder->macSecretKey.u8, 32);
     
     // Initiator:
     // egress-mac = sha3.update(mac-secret ^ recipient-nonce || auth-sent-init)
@@ -359,16 +250,35 @@ void frameCoderRelease(BREthereumLESFrameCoder fcoder) {
     if(fcoder->ingressMac != NULL){
         keccak_release(fcoder->ingressMac);
     }
+    mem_clean(fcoder->aesSchedule, sizeof(fcoder->aesSchedule));
+    mem_clean(fcoder->macSecretSchedule, sizeof(fcoder->macSecretSchedule));
     free(fcoder);
 }
 
+size_t frameCoderEncryptSize(size_t payloadSize) {
+    size_t payloadPadding = (16 - (payloadSize % 16)) % 16;
+    return 32 + payloadSize + payloadPadding + 16; // header_cipher + headerMac + payload + padding + frameMac
+}
+
 void frameCoderEncrypt(BREthereumLESFrameCoder fCoder, uint8_t* payload, size_t payloadSize, uint8_t** rlpBytes, size_t * rlpBytesSize) {
 
+    //Allocate the oBytes and oBytesSize
+    size_t oBytesSize = frameCoderEncryptSize(payloadSize);
+    uint8_t * oBytes = (uint8_t*)malloc(oBytesSize);
+
+    memcpy(&oBytes[FRAME_CODER_PAYLOAD_OFFSET], payload, payloadSize);
+    frameCoderEncryptInPlace(fCoder, oBytes, payloadSize);
+
+    *rlpBytes = oBytes;
+    *rlpBytesSize = oBytesSize;
+}
+
+void frameCoderEncryptInPlace(BREthereumLESFrameCoder fCoder, uint8_t* oBytes, size_t payloadSize) {
+
     uint8_t headerPlain[HEADER_LEN] = {(uint8_t)((payloadSize >> 16) & 0xff), (uint8_t)((payloadSize >> 8) & 0xff), (uint8_t)(payloadSize & 0xff), 0xc2, 0x80, 0x80, 0};
     
     uint8_t headerCipher[HEADER_LEN];
-    fCoder->aesEncryptCipherLen += HEADER_LEN;
-    BRAESCTR_OFFSET(headerCipher, HEADER_LEN, fCoder->aesEncryptKey, 32, fCoder->ivEnc.u8, headerPlain, fCoder->aesEncryptCipherLen);
+    BRAESCTRSchedule(headerCipher, fCoder->aesSchedule, 32, fCoder->ivEnc.u8, headerPlain, HEADER_LEN);
     
     // Encrypt HEADER-MAC
     uint8_t egressDigest[32];
@@ -376,7 +286,7 @@ void frameCoderEncrypt(BREthereumLESFrameCoder fCoder, uint8_t* payload, size_t
 
     uint8_t macSecret[HEADER_LEN];
     memcpy(macSecret, egressDigest, HEADER_LEN);
-   _BRAES256ECBEncrypt(fCoder->macSecretKey.u8, macSecret);
+    BRAESECBEncryptSchedule(macSecret, fCoder->macSecretSchedule, 32);
    
     uint8_t xORMacCipher[16];
     bytesXOR(macSecret, headerCipher, xORMacCipher, 16);
@@ -388,30 +298,20 @@ void frameCoderEncrypt(BREthereumLESFrameCoder fCoder, uint8_t* payload, size_t
     uint8_t headerMac[16];
     memcpy(headerMac, egressDigest, 16);
 
-    //Allocate the oBytes and oBytesSize
     size_t payloadPadding = (16 - (payloadSize % 16)) % 16;
-    size_t oBytesSize = 32 + payloadSize + payloadPadding + 16; // header_cipher + headerMac + payload + padding + frameMac
-    
-    uint8_t * oBytes = (uint8_t*)malloc(oBytesSize);
 
     memcpy(oBytes, headerCipher, HEADER_LEN);
     memcpy(&oBytes[HEADER_LEN], headerMac, HEADER_LEN);
     
-    uint8_t * frameCipher = &oBytes[32];
-    
-    // TODO: Need AES-CTRL encryption to frameCipher
-    uint8_t frameData[payloadPadding + payloadSize];
+    // The payload is encrypted in place, along with its zero padding
+    uint8_t * frameCipher = &oBytes[FRAME_CODER_PAYLOAD_OFFSET];
     size_t frameDataSize = payloadPadding + payloadSize;
-    memcpy(frameData, payload, payloadSize);
     
     if(payloadPadding){
-        memset(&frameData[payloadSize], 0, payloadPadding);
+        memset(&frameCipher[payloadSize], 0, payloadPadding);
     }
     
-    fCoder->aesEncryptCipherLen += frameDataSize;
-    BRAESCTR_OFFSET(frameCipher, frameDataSize, fCoder->aesEncryptKey, 32, fCoder->ivEnc.u8, frameData, fCoder->aesEncryptCipherLen);
-    
-    keccak_update(fCoder->egressMac, frameCipher, payloadSize + payloadPadding);
+    frameCoderCryptAndMac(fCoder, fCoder->egressMac, fCoder->ivEnc.u8, frameCipher, frameCipher, frameDataSize, 1);
     
     keccak_digest(fCoder->egressMac, egressDigest);
     
@@ -419,7 +319,7 @@ void frameCoderEncrypt(BREthereumLESFrameCoder fCoder, uint8_t* payload, size_t
     memcpy(fmac_seed, egressDigest, 16);
     memcpy(macSecret, egressDigest, 16);
     
-    _BRAES256ECBEncrypt(fCoder->macSecretKey.u8, macSecret);
+    BRAESECBEncryptSchedule(macSecret, fCoder->macSecretSchedule, 32);
     bytesXOR(macSecret, fmac_seed, xORMacCipher, 16);
 
     keccak_update(fCoder->egressMac, xORMacCipher, 16);
@@ -428,9 +328,6 @@ void frameCoderEncrypt(BREthereumLESFrameCoder fCoder, uint8_t* payload, size_t
 
     memcpy(&oBytes[32 + payloadSize + payloadPadding],egressDigest, 16);
     
-    *rlpBytes = oBytes;
-    *rlpBytesSize = oBytesSize;
-    
 }
 
 BREthereumBoolean frameCoderDecryptHeader(BREthereumLESFrameCoder fCoder, uint8_t * oBytes, size_t outSize) {
@@ -448,7 +345,7 @@ BREthereumBoolean frameCoderDecryptHeader(BREthereumLESFrameCoder fCoder, uint8_
     keccak_digest(fCoder->ingressMac, ingressDigest);
     memcpy(mac_secret, ingressDigest, HEADER_LEN);
     
-    _BRAES256ECBEncrypt(fCoder->macSecretKey.u8, mac_secret);
+    BRAESECBEncryptSchedule(mac_secret, fCoder->macSecretSchedule, 32);
 
     uint8_t xORMacCipher[HEADER_LEN];
     bytesXOR(mac_secret, headerCipher, xORMacCipher, HEADER_LEN);
@@ -464,8 +361,7 @@ BREthereumBoolean frameCoderDecryptHeader(BREthereumLESFrameCoder fCoder, uint8_
         return ETHEREUM_BOOLEAN_FALSE;
     }
     
-    fCoder->aesDecrptyCipherLen += HEADER_LEN;
-    BRAESCTR_OFFSET(oBytes, HEADER_LEN, fCoder->aesEncryptKey, 32, fCoder->ivDec.u8, headerCipher, fCoder->aesDecrptyCipherLen);
+    BRAESCTRSchedule(oBytes, fCoder->aesSchedule, 32, fCoder->ivDec.u8, headerCipher, HEADER_LEN);
     
     return ETHEREUM_BOOLEAN_TRUE;
     
@@ -476,7 +372,8 @@ BREthereumBoolean frameCoderDecryptFrame(BREthereumLESFrameCoder fCoder, uint8_t
     uint8_t* frameCipherText = oBytes;
     uint8_t* frameMac = &oBytes[outSize - MAC_LEN];
 
-    keccak_update(fCoder->ingressMac, frameCipherText, outSize - MAC_LEN);
+    // The frame is decrypted in place as it is MACed; on a MAC failure oBytes is not usable anyway.
+    frameCoderCryptAndMac(fCoder, fCoder->ingressMac, fCoder->ivDec.u8, oBytes, frameCipherText, outSize - MAC_LEN, 0);
     
     uint8_t fmacSeed[16];
     uint8_t fmacSeedEncrypt[16];
@@ -488,7 +385,7 @@ BREthereumBoolean frameCoderDecryptFrame(BREthereumLESFrameCoder fCoder, uint8_t
     memcpy(fmacSeedEncrypt, ingressDigest, 16);
    
     uint8_t xORMacCipher[16];
-    _BRAES256ECBEncrypt(fCoder->macSecretKey.u8, fmacSeedEncrypt);
+    BRAESECBEncryptSchedule(fmacSeedEncrypt, fCoder->macSecretSchedule, 32);
     bytesXOR(fmacSeedEncrypt,fmacSeed, xORMacCipher, 16);
     
     keccak_update(fCoder->ingressMac, xORMacCipher, 16);
@@ -501,9 +398,6 @@ BREthereumBoolean frameCoderDecryptFrame(BREthereumLESFrameCoder fCoder, uint8_t
         return ETHEREUM_BOOLEAN_FALSE;
     }
 
-    fCoder->aesDecrptyCipherLen += (outSize - MAC_LEN);
-    BRAESCTR_OFFSET(oBytes, outSize - MAC_LEN, fCoder->aesEncryptKey, 32, fCoder->ivDec.u8, frameCipherText, fCoder->aesDecrptyCipherLen);
-    
     return ETHEREUM_BOOLEAN_TRUE;
 }
 
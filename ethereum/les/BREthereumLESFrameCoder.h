@@ -75,6 +75,26 @@ extern void frameCoderRelease(BREthereumLESFrameCoder coder);
  */
  extern void frameCoderEncrypt(BREthereumLESFrameCoder fCoder, uint8_t* payload, size_t payloadSize, uint8_t** rlpBytes, size_t * rlpBytesSize);
 
+/**
+ * The offset of the payload within an encrypted packet
+ */
+#define FRAME_CODER_PAYLOAD_OFFSET   (32)
+
+/**
+ * Returns the size in bytes of an encrypted packet for a payload of payloadSize
+ * @param payloadSize - the size in bytes of the payload
+ */
+extern size_t frameCoderEncryptSize(size_t payloadSize);
+
+/**
+ * Encrypts a single packet in place, avoiding the copies of frameCoderEncrypt
+ * @param fCoder - the frame coder context
+ * @param packet - the packet, of frameCoderEncryptSize(payloadSize) bytes, holding the payload at
+   FRAME_CODER_PAYLOAD_OFFSET; on return, the encrypted packet
+ * @param payloadSize - the size in bytes of the payload
+ */
+extern void frameCoderEncryptInPlace(BREthereumLESFrameCoder fCoder, uint8_t* packet, size_t payloadSize);
+
 /**
  * Authenticates and decrypts the header from a packet
  * @param fCoder - the frame coder context
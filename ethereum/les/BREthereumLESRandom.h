@@ -26,7 +26,7 @@ typedef struct BREthereumLESRandomRecord* BREthereumLESRandomContext;
 
 /**
  * Creates a random generator context
- * @param seed - the seed to initialze the random generator
+ * @param seed - the seed to initialze the random generator; it is mixed with BRRandBytes() output
  * @param seedLen - the length of the seed parameter
  * @return BREthereumRandomContext,
  * @post - the returned BREthereumRandomContext needs to be released using ethereumRandomRelease
@@ -9,15 +9,19 @@
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 
 #include <unistd.h>
+#include <sys/time.h>
 #include <sys/socket.h>
 #include <sys/select.h>
 #include <pthread.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include "support/BRCrypto.h"
 #include "support/BRKeyECIES.h"
 #include "support/BRAssert.h"
+#include "support/BRStats.h"
+#include "support/BRThreadPool.h"
 #include "BREthereumNode.h"
 #include "BREthereumLESFrameCoder.h"
 
@@ -57,6 +61,10 @@ static BREthereumNodeMessageResult
 nodeRecv (BREthereumNode node,
           BREthereumNodeEndpointRoute route);
 
+static size_t
+nodeGetMessageContentLimit (BREthereumNode node,
+                            BREthereumLESMessageIdentifier identifier);
+
 static BREthereumNodeStatus
 nodeSend (BREthereumNode node,
           BREthereumNodeEndpointRoute route,
@@ -68,6 +76,22 @@ nodeSend (BREthereumNode node,
 #define DEFAULT_NODE_TIMEOUT_IN_SECONDS       (10)
 #define DEFAULT_NODE_TIMEOUT_IN_SECONDS_RECV  (60)      // 1 minute
 
+// Until a node has completed a provision, estimate its provision times with these.
+#define DEFAULT_NODE_PROVISION_LATENCY_IN_MILLISECONDS     (500.0)
+#define DEFAULT_NODE_PROVISION_ITEM_TIME_IN_MILLISECONDS   (5.0)
+
+// Weight of each new sample in the smoothed latency and item time (as for TCP's SRTT)
+#define NODE_PROVISION_PERFORMANCE_GAIN    (0.125)
+
+// A node that last served us longer ago than STALE is ranked as unknown; a node that failed us at
+// least BAD_FAILURES times, and more often than it served us, is ranked behind unknown nodes.
+#define NODE_QUALITY_STALE_SECONDS          (30 * 24 * 60 * 60)    // 30 days
+#define NODE_QUALITY_BAD_FAILURES           (3)
+
+// The most inputs packed into one PIP Request, from the pending requests of several provisioners;
+// the same implicit Parity limit as applies to the requests of one provision.
+#define NODE_PIP_REQUEST_INPUTS_LIMIT       (256)
+
 //
 // Frame Coder Stuff
 //
@@ -86,6 +110,17 @@ static const ssize_t ackCipherBufLen =  ackBufLen + 65 + 16 + 32;
 static int _sendAuthInitiator(BREthereumNode node);
 static int _readAuthAckFromRecipient(BREthereumNode node);
 
+/**
+ * The status of the handshake crypto that a node hands off to the shared thread pool.  The
+ * LES thread starts an `auth` or `ack` step; a worker completes it with SUCCESS or FAILURE.
+ */
+typedef enum {
+    NODE_HANDSHAKE_NONE,
+    NODE_HANDSHAKE_PENDING,
+    NODE_HANDSHAKE_SUCCESS,
+    NODE_HANDSHAKE_FAILURE
+} BREthereumNodeHandshakeStatus;
+
 /// MARK: - Node Type
 
 extern const char *
@@ -308,8 +343,10 @@ typedef struct {
     /** The count of messages received */
     size_t messagesReceivedCount;
 
-    /** Time of creation */
-    long timestamp;
+    /** Time, in milliseconds, that the first message was sent and the first message was
+     * received; zero if not yet sent or received. */
+    uint64_t sendTime;
+    uint64_t recvTime;
 
     BREthereumProvisionStatus status;
 
@@ -317,6 +354,10 @@ typedef struct {
      * Parity) messages. */
     BRArrayOf(BREthereumMessage) messages;
 
+    /** For each message sent, the node's `creditsSent` just after sending it.  Used, upon a
+     * response, to account for the messages sent since. */
+    BRArrayOf(uint64_t) messagesCreditsSent;
+
 } BREthereumNodeProvisioner;
 
 static int
@@ -329,6 +370,12 @@ provisionerRecvMessagesPending (BREthereumNodeProvisioner *provisioner) {
     return provisioner->messagesReceivedCount < provisioner->messagesCount;
 }
 
+static BREthereumMessage *
+provisionerGetMessagePending (BREthereumNodeProvisioner *provisioner) {
+    return &provisioner->messages [provisioner->messagesCount -
+                                   provisioner->messagesRemainingCount];
+}
+
 static int
 provisionerMessageOfInterest (BREthereumNodeProvisioner *provisioner,
                               uint64_t messageIdentifier) {
@@ -336,10 +383,19 @@ provisionerMessageOfInterest (BREthereumNodeProvisioner *provisioner,
             messageIdentifier < (provisioner->messageIdentifier + provisioner->messagesCount));
 }
 
+static uint64_t
+nodeGetTimeInMilliseconds (void) {
+    struct timeval now;
+    gettimeofday (&now, NULL);
+    return 1000 * (uint64_t) now.tv_sec + (uint64_t) now.tv_usec / 1000;
+}
+
 static BREthereumNodeStatus
 provisionerMessageSend (BREthereumNodeProvisioner *provisioner) {
-    BREthereumMessage message = provisioner->messages [provisioner->messagesCount -
-                                                       provisioner->messagesRemainingCount];
+    if (0 == provisioner->sendTime)
+        provisioner->sendTime = nodeGetTimeInMilliseconds();
+
+    BREthereumMessage message = *provisionerGetMessagePending (provisioner);
     BREthereumNodeStatus status = nodeSend (provisioner->node, NODE_ROUTE_TCP, message);
     provisioner->messagesRemainingCount--;
 
@@ -376,10 +432,10 @@ provisionerGetMessageContentLimit (BREthereumNodeProvisioner *provisioner) {
     switch (nodeGetType(provisioner->node)) {
         case NODE_TYPE_UNKNOWN:
             assert (0);
-        case NODE_TYPE_GETH: {
-            BREthereumLESMessageIdentifier id = provisionGetMessageLESIdentifier(provisioner->provision.type);
-            return messageLESSpecs[id].limit;
-        }
+        case NODE_TYPE_GETH:
+            return nodeGetMessageContentLimit (provisioner->node,
+                                               provisionGetMessageLESIdentifier(provisioner->provision.type));
+
         case NODE_TYPE_PARITY:
             // The Parity code seems to have this implicit limit.
             return 256;
@@ -415,6 +471,7 @@ provisionerEstablish (BREthereumNodeProvisioner *provisioner,
 
     // Create the messages, or just one, needed to complete the provision
     array_new (provisioner->messages, provisioner->messagesCount);
+    array_new (provisioner->messagesCreditsSent, provisioner->messagesCount);
 
     // Add each message, constructed from the provision
     for (size_t index = 0; index < provisioner->messagesCount; index++)
@@ -447,10 +504,20 @@ provisionerRelease (BREthereumNodeProvisioner *provisioner,
                     BREthereumBoolean releaseProvision,
                     BREthereumBoolean releaseProvisionResults) {
     messagesRelease(provisioner->messages);
+    array_free (provisioner->messagesCreditsSent);
     if (ETHEREUM_BOOLEAN_IS_TRUE(releaseProvision))
         provisionRelease (&provisioner->provision, releaseProvisionResults);
 }
 
+/**
+ * A PIP Request sent with the pending requests of several provisioners packed into it.  The
+ * Response, with `reqId`, is split back into one Response per part.
+ */
+typedef struct {
+    BREthereumPIPRequestIdentifier reqId;
+    BRArrayOf(BREthereumPIPRequestPart) parts;
+} BREthereumNodePIPPack;
+
 /// MARK: - LES Node
 
 struct BREthereumNodeRecord {
@@ -485,8 +552,37 @@ struct BREthereumNodeRecord {
     // TODO: This should not be LES specific; applies to PIP too.
     BREthereumLESMessageSpec specs [NUMBER_OF_LES_MESSAGE_IDENTIFIERS];
 
-    /** Credit remaining (if not zero) */
+    /** Credit remaining (if not zero), as estimated at `creditsTime` in milliseconds */
     uint64_t credits;
+    uint64_t creditsTime;
+
+    /** Flow control, from the remote status: the buffer limit (maximum credits) and the
+     * recharge rate (credits per second).  Zero if not provided. */
+    uint64_t creditsLimit;
+    uint64_t creditsRecharge;
+
+    /** The total cost of the messages sent since the remote status */
+    uint64_t creditsSent;
+
+    /** Provision performance: the smoothed time until the first response and the smoothed
+     * time per provisioned item, both in milliseconds; then the provisions that succeeded and
+     * that failed (including those outstanding when the node was deactivated). */
+    double provisionLatency;
+    double provisionItemTime;
+    size_t provisionsSucceeded;
+    size_t provisionsFailed;
+
+    /** The smoothed latency of each provision type, with the count of each that succeeded, and
+     * the time of the last success - all in this session */
+    double provisionLatencyByType [NUMBER_OF_NODE_PROVISION_TYPES];
+    size_t provisionsSucceededByType [NUMBER_OF_NODE_PROVISION_TYPES];
+    time_t provisionLastGoodTime;
+
+    /** The provision latency, in milliseconds, measured in a prior session; 0 if unknown */
+    uint64_t priorLatency;
+
+    /** The quality accumulated in prior sessions */
+    BREthereumNodeQuality priorQuality;
 
     /** Callbacks */
     BREthereumNodeContext callbackContext;
@@ -494,6 +590,7 @@ struct BREthereumNodeRecord {
     BREthereumNodeCallbackAnnounce callbackAnnounce;
     BREthereumNodeCallbackProvide callbackProvide;
     BREthereumNodeCallbackNeighbor callbackNeighbor;
+    BREthereumNodeCallbackWakeup callbackWakeup;
 
     /** Send/Recv Buffer */
     BRRlpData sendDataBuffer;
@@ -511,6 +608,10 @@ struct BREthereumNodeRecord {
     /** But, in some cases try a ping on a timeout. */
     BREthereumBoolean timeoutPingAllowed;
 
+    /** The ephemeral key and nonce for our side of the TCP handshake; new for each handshake */
+    BRKey ephemeralKey;
+    UInt256 nonce;
+
     /** Frame Coder */
     BREthereumLESFrameCoder frameCoder;
     uint8_t authBuf[authBufLen];
@@ -518,15 +619,33 @@ struct BREthereumNodeRecord {
     uint8_t ackBuf[ackBufLen];
     uint8_t ackBufCipher[ackCipherBufLen];
 
+    /**
+     * The handshake crypto, in flight on the shared thread pool.  While PENDING, a worker owns
+     * the `ephemeralKey`, `nonce`, auth and ack buffers and the `frameCoder`.  The `status` is
+     * a BREthereumNodeHandshakeStatus, written by the worker.
+     */
+    BRTaskGroup *handshakeGroup;
+    atomic_int handshakeStatus;
+
     // Provision
     size_t messageIdentifier;
 
     BRArrayOf(BREthereumNodeProvisioner) provisioners;
 
+    /** The PIP Requests sent packed and not yet answered */
+    BRArrayOf(BREthereumNodePIPPack) pipPacks;
+
     // A largely unneeded lock.
     pthread_mutex_t lock;
 };
 
+static void
+nodeReleasePIPPacks (BREthereumNode node) {
+    for (size_t index = 0; index < array_count (node->pipPacks); index++)
+        array_free (node->pipPacks[index].parts);
+    array_clear (node->pipPacks);
+}
+
 extern void
 nodeShow (BREthereumNode node) {
     char descUDP[128], descTCP[128];
@@ -539,6 +658,9 @@ nodeShow (BREthereumNode node) {
     eth_log (LES_LOG_TOPIC, "   TCP       : %s", nodeStateDescribe (&node->states[NODE_ROUTE_TCP], descTCP));
     eth_log (LES_LOG_TOPIC, "   Discovered: %s", (ETHEREUM_BOOLEAN_IS_TRUE(node->discovered) ? "Yes" : "No"));
     eth_log (LES_LOG_TOPIC, "   Credits   : %" PRIu64, node->credits);
+    eth_log (LES_LOG_TOPIC, "   Provisions: %zu ok, %zu failed, %.0f ms + %.1f ms/item",
+             node->provisionsSucceeded, node->provisionsFailed,
+             node->provisionLatency, node->provisionItemTime);
 }
 
 extern const BREthereumNodeEndpoint
@@ -563,14 +685,65 @@ nodeNeighborCompare (BREthereumNode n1,
     }
 }
 
+/**
+ * Rank `node` as 0 if it served us recently, 2 if it has mostly failed us, or else 1 (unknown).
+ */
+static int
+nodeGetQualityRank (BREthereumNode node,
+                    BREthereumNodeQuality *quality) {
+    *quality = nodeGetQuality (node);
+
+    if (quality->provisionsFailed >= NODE_QUALITY_BAD_FAILURES &&
+        quality->provisionsFailed > quality->provisionsSucceeded)
+        return 2;
+
+    return (quality->provisionsSucceeded > 0 &&
+            (uint64_t) time (NULL) < quality->lastGoodTime + NODE_QUALITY_STALE_SECONDS
+            ? 0
+            : 1);
+}
+
+/**
+ * The latency of `node` scaled by its expected attempts per success (as in
+ * nodeEstimateProvisionTime()); only meaningful for a node that served us.
+ */
+static double
+nodeGetQualityLatency (BREthereumNode node,
+                       BREthereumNodeQuality quality) {
+    return ((double) nodeGetLatency (node) *
+            (double) (quality.provisionsSucceeded + quality.provisionsFailed + 1) /
+            (double) (quality.provisionsSucceeded + 1));
+}
+
+static BREthereumComparison
+nodeQualityCompare (BREthereumNode n1,
+                    BREthereumNode n2) {
+    BREthereumNodeQuality quality1, quality2;
+    int rank1 = nodeGetQualityRank (n1, &quality1);
+    int rank2 = nodeGetQualityRank (n2, &quality2);
+
+    if (rank1 != rank2) return rank1 < rank2 ? ETHEREUM_COMPARISON_LT : ETHEREUM_COMPARISON_GT;
+    if (0 != rank1) return ETHEREUM_COMPARISON_EQ;
+
+    double latency1 = nodeGetQualityLatency (n1, quality1);
+    double latency2 = nodeGetQualityLatency (n2, quality2);
+
+    return (latency1 == latency2
+            ? ETHEREUM_COMPARISON_EQ
+            : (latency1 < latency2 ? ETHEREUM_COMPARISON_LT : ETHEREUM_COMPARISON_GT));
+}
+
 extern BREthereumComparison
 nodeCompare (BREthereumNode node1,
              BREthereumNode node2) {
+    BREthereumComparison comparison;
     return (node1->priority < node2->priority
             ? ETHEREUM_COMPARISON_LT
             : (node1->priority > node2->priority
                ? ETHEREUM_COMPARISON_GT
-               : nodeNeighborCompare(node1, node2)));
+               : (ETHEREUM_COMPARISON_EQ != (comparison = nodeQualityCompare (node1, node2))
+                  ? comparison
+                  : nodeNeighborCompare(node1, node2))));
 }
 
 static size_t
@@ -651,6 +824,7 @@ nodeCreate (BREthereumNodePriority priority,
             BREthereumNodeCallbackAnnounce callbackAnnounce,
             BREthereumNodeCallbackProvide callbackProvide,
             BREthereumNodeCallbackNeighbor callbackNeighbor,
+            BREthereumNodeCallbackWakeup callbackWakeup,
             BREthereumBoolean handleSync) {
     BREthereumNode node = calloc (1, sizeof (struct BREthereumNodeRecord));
 
@@ -691,7 +865,7 @@ nodeCreate (BREthereumNodePriority priority,
 
     // Define the message coder
     node->coder.network = network;
-    node->coder.rlp = rlpCoderCreate();
+    node->coder.rlp = rlpCoderCreateArena();
     node->coder.messageIdOffset = 0x00;  // Changed with 'hello' message exchange.
 
     node->discovered = ETHEREUM_BOOLEAN_FALSE;
@@ -703,9 +877,14 @@ nodeCreate (BREthereumNodePriority priority,
     node->callbackAnnounce = callbackAnnounce;
     node->callbackProvide  = callbackProvide;
     node->callbackNeighbor = callbackNeighbor;
+    node->callbackWakeup   = callbackWakeup;
+
+    node->handshakeGroup = NULL;
+    atomic_init (&node->handshakeStatus, NODE_HANDSHAKE_NONE);
 
     node->messageIdentifier = 0;
     array_new (node->provisioners, 10);
+    array_new (node->pipPacks, 2);
 
     // A remote port (TCP or UDP) of '0' marks this node in error.
     if (0 == nodeEndpointGetPort (remote, NODE_ROUTE_TCP))
@@ -740,9 +919,15 @@ nodeRelease (BREthereumNode node) {
         provisionRelease (&node->provisioners[index].provision , ETHEREUM_BOOLEAN_TRUE);
     array_free (node->provisioners);
 
+    nodeReleasePIPPacks (node);
+    array_free (node->pipPacks);
+
     if (NULL != node->sendDataBuffer.bytes) free (node->sendDataBuffer.bytes);
     if (NULL != node->recvDataBuffer.bytes) free (node->recvDataBuffer.bytes);
 
+    BRKeyClean (&node->ephemeralKey);
+    var_clean (&node->nonce);
+
     rlpCoderRelease(node->coder.rlp);
     frameCoderRelease(node->frameCoder);
 
@@ -780,6 +965,54 @@ nodeGetPriority (BREthereumNode node) {
     return node->priority;
 }
 
+extern uint64_t
+nodeGetLatency (BREthereumNode node) {
+    // A measured latency of under 1 millisecond still shows that `node` serves us.
+    return (node->provisionsSucceeded > 0
+            ? (node->provisionLatency < 1.0 ? 1 : (uint64_t) node->provisionLatency)
+            : node->priorLatency);
+}
+
+extern void
+nodeSetPriorLatency (BREthereumNode node,
+                     uint64_t latency) {
+    node->priorLatency = latency;
+}
+
+extern BREthereumNodeQuality
+nodeGetQuality (BREthereumNode node) {
+    BREthereumNodeQuality quality = node->priorQuality;
+
+    quality.provisionsSucceeded += node->provisionsSucceeded;
+    quality.provisionsFailed    += node->provisionsFailed;
+
+    // A measured latency of under 1 millisecond still shows that the type was provided.
+    for (size_t type = 0; type < NUMBER_OF_NODE_PROVISION_TYPES; type++)
+        if (node->provisionsSucceededByType[type] > 0)
+            quality.latencies[type] = (node->provisionLatencyByType[type] < 1.0
+                                       ? 1
+                                       : (uint64_t) node->provisionLatencyByType[type]);
+
+    if (0 != node->provisionLastGoodTime)
+        quality.lastGoodTime = (uint64_t) node->provisionLastGoodTime;
+
+    return quality;
+}
+
+extern void
+nodeSetPriorQuality (BREthereumNode node,
+                     BREthereumNodeQuality quality) {
+    node->priorQuality = quality;
+}
+
+extern size_t
+nodeGetMemoryUsage (BREthereumNode node) {
+    return (sizeof (struct BREthereumNodeRecord) +
+            node->sendDataBuffer.bytesCount +
+            node->recvDataBuffer.bytesCount +
+            array_heap_size (node->provisioners));
+}
+
 static inline void
 nodeUpdateTimeout (BREthereumNode node,
                    time_t now) {
@@ -810,6 +1043,85 @@ nodeProcessSuccess (BREthereumNode node,
     return nodeStateAnnounce(node, route, state);
 }
 
+/// MARK: - Node Handshake
+
+//
+// The RLPx handshake needs ECDH, ECIES and Keccak for both the `auth` we send and the `ack` we
+// receive.  Rather than serialize that crypto on the LES thread, across all the nodes we are
+// connecting to, each step runs as a task on the shared thread pool.  The LES thread polls the
+// status in `nodeProcess()`; the worker calls `callbackWakeup` once done.
+//
+
+static void
+nodeHandshakeComplete (BREthereumNode node, int error) {
+    atomic_store (&node->handshakeStatus, (0 == error
+                                           ? NODE_HANDSHAKE_SUCCESS
+                                           : NODE_HANDSHAKE_FAILURE));
+    if (NULL != node->callbackWakeup)
+        node->callbackWakeup (node->callbackContext, node);
+}
+
+static void
+nodeHandshakeAuthRoutine (void *info) {
+    BREthereumNode node = (BREthereumNode) info;
+    nodeHandshakeComplete (node, _sendAuthInitiator (node));
+}
+
+static void
+nodeHandshakeAckRoutine (void *info) {
+    BREthereumNode node = (BREthereumNode) info;
+    int error = _readAuthAckFromRecipient (node);
+
+    // Initilize the frameCoder with the information from the auth
+    if (0 == error)
+        frameCoderInit(node->frameCoder,
+                       nodeEndpointGetEphemeralKey(node->remote), nodeEndpointGetNonce(node->remote),
+                       &node->ephemeralKey, &node->nonce,
+                       node->ackBufCipher, ackCipherBufLen,
+                       node->authBufCipher, authCipherBufLen,
+                       ETHEREUM_BOOLEAN_TRUE);
+
+    nodeHandshakeComplete (node, error);
+}
+
+static void
+nodeHandshakeStart (BREthereumNode node,
+                    void (*routine) (void *info)) {
+    assert (NULL == node->handshakeGroup);
+    atomic_store (&node->handshakeStatus, NODE_HANDSHAKE_PENDING);
+
+    node->handshakeGroup = BRTaskGroupNew (BRThreadPoolShared());
+    BRTaskGroupAdd (node->handshakeGroup, node, routine);
+}
+
+/**
+ * Return the handshake status.  Once the worker is done, release its task group; the worker may
+ * still be returning from `callbackWakeup` and BRTaskGroupFree() waits for that.
+ */
+static BREthereumNodeHandshakeStatus
+nodeHandshakeGetStatus (BREthereumNode node) {
+    BREthereumNodeHandshakeStatus status = atomic_load (&node->handshakeStatus);
+
+    if (NODE_HANDSHAKE_PENDING != status && NULL != node->handshakeGroup) {
+        BRTaskGroupFree (node->handshakeGroup);
+        node->handshakeGroup = NULL;
+    }
+    return status;
+}
+
+/**
+ * Stop any handshake step; one not yet started is skipped, one running is waited on.
+ */
+static void
+nodeHandshakeCancel (BREthereumNode node) {
+    if (NULL != node->handshakeGroup) {
+        BRTaskGroupCancel (node->handshakeGroup);
+        BRTaskGroupFree (node->handshakeGroup);
+        node->handshakeGroup = NULL;
+    }
+    atomic_store (&node->handshakeStatus, NODE_HANDSHAKE_NONE);
+}
+
 extern BREthereumNodeState
 nodeConnect (BREthereumNode node,
              BREthereumNodeEndpointRoute route,
@@ -820,6 +1132,10 @@ nodeConnect (BREthereumNode node,
     if (!nodeHasState (node, route, NODE_AVAILABLE))
         return node->states[route];
 
+    // The `auth` needs no socket; compute it while the (blocking) open proceeds.
+    if (NODE_ROUTE_TCP == route)
+        nodeHandshakeStart (node, nodeHandshakeAuthRoutine);
+
 #if defined (NODE_DEBUG_SOCKETS)
     // Increment here; on failure we'll decrement.
     eth_log(LES_LOG_TOPIC, "Sockets: %d (Open)", ++socketOpenCount);
@@ -846,6 +1162,10 @@ nodeDisconnect (BREthereumNode node,
 
     nodeStateAnnounce (node, route, stateToAnnounce);
 
+    // A worker might hold our handshake buffers; get them back.
+    if (NODE_ROUTE_TCP == route)
+        nodeHandshakeCancel (node);
+
 #if defined (NODE_DEBUG_SOCKETS)
     // Close the appropriate endpoint route
     int failed = nodeEndpointClose (&node->remote, route, !nodeHasErrorState (node, route));
@@ -892,21 +1212,325 @@ extern BRArrayOf(BREthereumProvision)
 nodeUnhandleProvisions (BREthereumNode node) {
     BRArrayOf(BREthereumProvision) provisions;
     array_new (provisions, array_count(node->provisioners));
-    for (size_t index = 0; index < array_count(node->provisioners); index++)
+    for (size_t index = 0; index < array_count(node->provisioners); index++) {
+        // A provision that was started, but not completed, counts as failed.
+        if (0 != node->provisioners[index].sendTime)
+            node->provisionsFailed++;
         array_add (provisions, node->provisioners[index].provision);
+    }
     array_clear(node->provisioners);
+
+    // Responses to packed requests, if they arrive, no longer have provisioners to handle them.
+    nodeReleasePIPPacks (node);
     return provisions;
 }
 
+extern void
+nodeCancelProvision (BREthereumNode node,
+                     BREthereumProvision *provision) {
+    for (size_t index = 0; index < array_count (node->provisioners); index++)
+        if (ETHEREUM_BOOLEAN_IS_TRUE (provisionMatches (provision, &node->provisioners[index].provision))) {
+            // Any responses still to arrive won't be of interest to any provisioner; dropped.
+            provisionerRelease (&node->provisioners[index], ETHEREUM_BOOLEAN_TRUE, ETHEREUM_BOOLEAN_TRUE);
+            array_rm (node->provisioners, index);
+            break;
+        }
+}
+
+/// MARK: - Flow Control
+
+//
+// A LES server gives each client a buffer of credits, with a limit and a recharge rate, and
+// charges each request a cost of `baseCost + count * reqCost` (all from its status message).  A
+// request that exceeds the buffer gets us throttled or dropped.  So we model the server's buffer:
+// it recharges over time, we deduct each message's cost as we send it and, on each response, we
+// adopt the server's reported buffer value less the cost of the messages sent after the request.
+//
+
+static int
+nodeHasFlowControl (BREthereumNode node) {
+    return NODE_TYPE_GETH == node->type && node->creditsLimit > 0 && node->creditsRecharge > 0;
+}
+
+static uint64_t
+nodeEstimateCredits (BREthereumNode node,
+                     BREthereumMessage message) {
+    switch (message.identifier) {
+        case MESSAGE_P2P: return 0;
+        case MESSAGE_DIS: return 0;
+        case MESSAGE_ETH: return 0;
+        case MESSAGE_LES:
+            return (node->specs[message.u.les.identifier].baseCost +
+                    messageLESGetCreditsCount (&message.u.les) * node->specs[message.u.les.identifier].reqCost);
+        case MESSAGE_PIP: return 0;
+    }
+}
+
+/**
+ * The credits available at `now`, recharged since `creditsTime` up to `creditsLimit`
+ */
+static uint64_t
+nodeGetCredits (BREthereumNode node,
+                uint64_t now) {
+    if (!nodeHasFlowControl (node) || now <= node->creditsTime) return node->credits;
+
+    uint64_t recharged = node->creditsRecharge * (now - node->creditsTime) / 1000;
+    return (node->credits >= node->creditsLimit || recharged >= node->creditsLimit - node->credits
+            ? node->creditsLimit
+            : node->credits + recharged);
+}
+
+static void
+nodeSetCredits (BREthereumNode node,
+                uint64_t credits,
+                uint64_t now) {
+    node->credits     = (nodeHasFlowControl (node) && credits > node->creditsLimit
+                         ? node->creditsLimit
+                         : credits);
+    node->creditsTime = now;
+}
+
+/**
+ * The number of requests that fit in one message of type `identifier` - the spec'd limit cut
+ * to what a full buffer of credits affords.
+ */
+static size_t
+nodeGetMessageContentLimit (BREthereumNode node,
+                            BREthereumLESMessageIdentifier identifier) {
+    BREthereumLESMessageSpec spec = node->specs[identifier];
+    size_t limit = spec.limit;
+
+    if (nodeHasFlowControl (node) && spec.reqCost > 0) {
+        uint64_t affordable = (node->creditsLimit > spec.baseCost
+                               ? (node->creditsLimit - spec.baseCost) / spec.reqCost
+                               : 0);
+        if (affordable < limit) limit = (affordable > 0 ? (size_t) affordable : 1);
+    }
+    return limit;
+}
+
+/**
+ * The time, in milliseconds, until `node` can afford to send `message`.  A message costing more
+ * than `creditsLimit` (too much, but the server's choice) waits for a full buffer.
+ */
+static uint64_t
+nodeGetMessageDelay (BREthereumNode node,
+                     BREthereumMessage *message,
+                     uint64_t now) {
+    if (!nodeHasFlowControl (node)) return 0;
+
+    uint64_t cost    = nodeEstimateCredits (node, *message);
+    uint64_t credits = nodeGetCredits (node, now);
+
+    if (cost > node->creditsLimit) cost = node->creditsLimit;
+
+    return (cost <= credits
+            ? 0
+            : (1000 * (cost - credits) + node->creditsRecharge - 1) / node->creditsRecharge);
+}
+
+/**
+ * Charge `node` for the pending message of `provisioner`, which is about to be sent.
+ */
+static void
+nodeChargeMessage (BREthereumNode node,
+                   BREthereumNodeProvisioner *provisioner,
+                   uint64_t now) {
+    uint64_t cost    = nodeEstimateCredits (node, *provisionerGetMessagePending (provisioner));
+    uint64_t credits = nodeGetCredits (node, now);
+
+    nodeSetCredits (node, (cost < credits ? credits - cost : 0), now);
+    node->creditsSent += cost;
+    array_add (provisioner->messagesCreditsSent, node->creditsSent);
+}
+
+/**
+ * Adopt the `credits` reported in a response to message `index` of `provisioner`, less the
+ * cost of the messages sent after that one - the server hadn't seen them yet.
+ */
+static void
+nodeUpdateCredits (BREthereumNode node,
+                   BREthereumNodeProvisioner *provisioner,
+                   size_t index,
+                   uint64_t credits) {
+    uint64_t sentAfter = (index < array_count (provisioner->messagesCreditsSent)
+                          ? node->creditsSent - provisioner->messagesCreditsSent[index]
+                          : 0);
+
+    nodeSetCredits (node,
+                    (sentAfter < credits ? credits - sentAfter : 0),
+                    nodeGetTimeInMilliseconds());
+}
+
+/**
+ * Send the pending PIP Requests of the provisioner at `index`, and of those after it, packed into
+ * one Request of at most NODE_PIP_REQUEST_INPUTS_LIMIT inputs.  If more than one request is packed
+ * the Request gets its own `reqId` and is recorded in `pipPacks` so that its Response can be split
+ * back into the provisioners' responses; see `nodeProcessRecvPIP()`.
+ */
+static BREthereumNodeStatus
+nodeSendPIPRequests (BREthereumNode node,
+                     size_t index,
+                     uint64_t now) {
+    BRArrayOf(BREthereumPIPRequestInput) inputs;
+    BRArrayOf(BREthereumPIPRequestPart) parts;
+
+    array_new (inputs, NODE_PIP_REQUEST_INPUTS_LIMIT);
+    array_new (parts, 4);
+
+    for (int full = 0; !full && index < array_count (node->provisioners); index++) {
+        BREthereumNodeProvisioner *provisioner = &node->provisioners[index];
+
+        // A provisioner's requests are packed in order; stop at one that isn't a Request.
+        while (provisionerSendMessagesPending (provisioner)) {
+            BREthereumMessage *pending = provisionerGetMessagePending (provisioner);
+            if (MESSAGE_PIP != pending->identifier ||
+                PIP_MESSAGE_REQUEST != pending->u.pip.type) break;
+
+            BREthereumPIPMessageRequest *request = &pending->u.pip.u.request;
+            size_t inputsCount = array_count (inputs) + array_count (request->inputs);
+            if (array_count (parts) > 0 && inputsCount > NODE_PIP_REQUEST_INPUTS_LIMIT) {
+                full = 1;
+                break;
+            }
+
+            if (0 == provisioner->sendTime) provisioner->sendTime = now;
+            nodeChargeMessage (node, provisioner, now);
+            messagePIPRequestPack (&inputs, &parts, request);
+            provisioner->messagesRemainingCount--;
+        }
+    }
+    assert (array_count (parts) > 0);
+
+    // A single request is sent as it was.
+    BREthereumPIPRequestIdentifier reqId = (1 == array_count (parts)
+                                            ? parts[0].reqId
+                                            : nodeGetThenIncrementMessageIdentifier (node, 1));
+
+    BREthereumNodeStatus status = nodeSend (node, NODE_ROUTE_TCP,
+                                            (BREthereumMessage) {
+                                                MESSAGE_PIP,
+                                                { .pip = {
+                                                    PIP_MESSAGE_REQUEST,
+                                                    { .request = { reqId, inputs }}}}
+                                            });
+
+    // The inputs are shared with the provisioners' messages, which still own them.
+    array_free (inputs);
+
+    if (1 == array_count (parts)) array_free (parts);
+    else array_add (node->pipPacks, ((BREthereumNodePIPPack) { reqId, parts }));
+
+    return status;
+}
+
+extern uint64_t
+nodeGetSendDelay (BREthereumNode node) {
+    if (!nodeHasState (node, NODE_ROUTE_TCP, NODE_CONNECTED)) return 0;
+
+    // Only the first provisioner with a pending message is sent; see `nodeProcess()`.
+    for (size_t index = 0; index < array_count (node->provisioners); index++)
+        if (provisionerSendMessagesPending (&node->provisioners[index]))
+            return nodeGetMessageDelay (node,
+                                        provisionerGetMessagePending (&node->provisioners[index]),
+                                        nodeGetTimeInMilliseconds());
+    return 0;
+}
+
+extern uint64_t
+nodeEstimateProvisionTime (BREthereumNode node,
+                           BREthereumProvision *provision) {
+    int measured = node->provisionsSucceeded > 0;
+    double latency  = (measured ? node->provisionLatency  : DEFAULT_NODE_PROVISION_LATENCY_IN_MILLISECONDS);
+    double itemTime = (measured ? node->provisionItemTime : DEFAULT_NODE_PROVISION_ITEM_TIME_IN_MILLISECONDS);
+
+    // The items not yet received for provisions already handled by `node` are ahead of ours.
+    size_t items = provisionGetCount (provision);
+    for (size_t index = 0; index < array_count (node->provisioners); index++) {
+        BREthereumNodeProvisioner *provisioner = &node->provisioners[index];
+        if (provisioner->messagesCount > 0)
+            items += (provisionerGetCount (provisioner)
+                      * (provisioner->messagesCount - provisioner->messagesReceivedCount)
+                      / provisioner->messagesCount);
+    }
+
+    double time = latency + items * itemTime;
+
+    // If our estimated credits won't cover the provision's cost, add the time to recharge.
+    if (NODE_TYPE_GETH == node->type && node->creditsRecharge > 0) {
+        BREthereumLESMessageIdentifier id = provisionGetMessageLESIdentifier (provision->type);
+        size_t count = provisionGetCount (provision);
+        size_t limit = (0 == node->specs[id].limit ? 1 : node->specs[id].limit);
+        uint64_t cost = (node->specs[id].baseCost * ((count + limit - 1) / limit) +
+                         node->specs[id].reqCost  * count);
+        uint64_t credits = nodeGetCredits (node, nodeGetTimeInMilliseconds());
+        if (cost > credits)
+            time += 1000.0 * (cost - credits) / node->creditsRecharge;
+    }
+
+    // Each failure costs a retry; expect (1 / success rate) attempts, with one assumed success.
+    time *= ((double) (node->provisionsSucceeded + node->provisionsFailed + 1) /
+             (double) (node->provisionsSucceeded + 1));
+
+    return (uint64_t) time;
+}
+
+static void
+nodeUpdateProvisionPerformance (BREthereumNode node,
+                                BREthereumNodeProvisioner *provisioner) {
+    if (PROVISION_ERROR == provisioner->status || 0 == provisioner->sendTime) {
+        node->provisionsFailed++;
+        return;
+    }
+
+    uint64_t now = nodeGetTimeInMilliseconds();
+    double latency  = (double) (provisioner->recvTime - provisioner->sendTime);
+
+    BRStatsRecord (BRStatsLESProvisionTime, 1000 * (provisioner->recvTime - provisioner->sendTime));
+    double itemTime = (double) (now - provisioner->recvTime) / provisionerGetCount (provisioner);
+
+    if (0 == node->provisionsSucceeded) {
+        node->provisionLatency  = latency;
+        node->provisionItemTime = itemTime;
+    }
+    else {
+        node->provisionLatency  += NODE_PROVISION_PERFORMANCE_GAIN * (latency  - node->provisionLatency);
+        node->provisionItemTime += NODE_PROVISION_PERFORMANCE_GAIN * (itemTime - node->provisionItemTime);
+    }
+    node->provisionsSucceeded++;
+
+    BREthereumProvisionType type = provisioner->provision.type;
+    double *typeLatency = &node->provisionLatencyByType[type];
+    if (0 == node->provisionsSucceededByType[type]) *typeLatency  = latency;
+    else *typeLatency += NODE_PROVISION_PERFORMANCE_GAIN * (latency - *typeLatency);
+    node->provisionsSucceededByType[type]++;
+
+    node->provisionLastGoodTime = time (NULL);
+}
+
 static void
 nodeHandleProvisionerMessage (BREthereumNode node,
                               BREthereumNodeProvisioner *provisioner,
                               OwnershipGiven BREthereumMessage message) {
+    BR_TRACE_BEGIN (traceBegin);
+
+    if (0 == provisioner->recvTime) {
+        provisioner->recvTime = nodeGetTimeInMilliseconds();
+        if (0 != provisioner->sendTime)
+            BR_TRACE_ADD (BRTraceLESProvisionWait,
+                          traceBegin - 1000 * (provisioner->recvTime - provisioner->sendTime),
+                          traceBegin,
+                          provisioner->provision.identifier);
+    }
+
     // Let the provisioner handle the message, gathering results as warranted.
     provisionerHandleMessage (provisioner, message); // `message` is OwnershipGiven
+    BR_TRACE_END (BRTraceLESProvisionHandle, traceBegin, provisioner->provision.identifier);
 
     // If all messages have been received...
     if (!provisionerRecvMessagesPending(provisioner)) {
+        nodeUpdateProvisionPerformance (node, provisioner);
+
         // ... callback the result,
         BREthereumProvisionResult result = {
             provisioner->provision.identifier,
@@ -1078,6 +1702,10 @@ nodeProcessRecvLES (BREthereumNode node,
                 // ... using the message's requestId
                 if (provisionerMessageOfInterest (provisioner, messageLESGetRequestId (&message))) {
                     mustReleaseMessage = 0;
+                    // The response reports the remote's buffer of credits.
+                    nodeUpdateCredits (node, provisioner,
+                                       messageLESGetRequestId (&message) - provisioner->messageIdentifier,
+                                       messageLESGetCredits (&message));
                     // When found, handle it.
                     nodeHandleProvisionerMessage (node, provisioner,
                                                   (BREthereumMessage) {
@@ -1092,6 +1720,32 @@ nodeProcessRecvLES (BREthereumNode node,
     if (mustReleaseMessage) messageLESRelease (&message);
 }
 
+/**
+ * Handle the PIP `response` with the provisioner that sent its request, if any.  Returns true
+ * if the `response` is handled (and thus owned elsewhere); false otherwise.
+ */
+static int
+nodeHandlePIPResponse (BREthereumNode node,
+                       BREthereumPIPMessage response) {
+    // Find the provisioner applicable to `response`... it might be (stress 'might be')
+    // that node->provisioners is empty at this point.  The node has been 'deactivated' (by
+    // LES), the provisions reassigned but still, somehow, we handle this message.
+    for (size_t index = 0; index < array_count (node->provisioners); index++) {
+        BREthereumNodeProvisioner *provisioner = &node->provisioners[index];
+        // ... using the response's requestId
+        if (provisionerMessageOfInterest (provisioner, messagePIPGetRequestId (&response))) {
+            // When found, handle it.
+            nodeHandleProvisionerMessage (node, provisioner,
+                                          (BREthereumMessage) {
+                                              MESSAGE_PIP,
+                                              { .pip = response }
+                                          });
+            return 1;
+        }
+    }
+    return 0;
+}
+
 static void
 nodeProcessRecvPIP (BREthereumNode node,
                     BREthereumNodeEndpointRoute route,
@@ -1129,25 +1783,35 @@ nodeProcessRecvPIP (BREthereumNode node,
             break;
         }
 
-        case PIP_MESSAGE_RESPONSE:
-            // Find the provisioner applicable to `message`... it might be (stress 'might be')
-            // that node->provisioners is empty at this point.  The node has been 'deactivated' (by
-            // LES), the provisions reassigned but still, somehow, we handle this message.
-            for (size_t index = 0; index < array_count (node->provisioners); index++) {
-                BREthereumNodeProvisioner *provisioner = &node->provisioners[index];
-                // ... using the message's requestId
-                if (provisionerMessageOfInterest (provisioner, messagePIPGetRequestId (&message))) {
-                    mustReleaseMessage = 0;
-                    // When found, handle it.
-                    nodeHandleProvisionerMessage (node, provisioner,
-                                                  (BREthereumMessage) {
-                                                      MESSAGE_PIP,
-                                                      { .pip = message }
-                                                  });
-                    break;
+        case PIP_MESSAGE_RESPONSE: {
+            // A response to a packed request is split back into the provisioners' responses.
+            size_t packIndex = 0;
+            while (packIndex < array_count (node->pipPacks) &&
+                   messagePIPGetRequestId (&message) != node->pipPacks[packIndex].reqId)
+                packIndex++;
+
+            if (packIndex == array_count (node->pipPacks))
+                mustReleaseMessage = !nodeHandlePIPResponse (node, message);
+            else {
+                BRArrayOf(BREthereumPIPMessageResponse) responses =
+                    messagePIPResponseUnpack (&message.u.response, node->pipPacks[packIndex].parts);
+
+                array_free (node->pipPacks[packIndex].parts);
+                array_rm (node->pipPacks, packIndex);
+
+                for (size_t index = 0; index < array_count (responses); index++) {
+                    BREthereumPIPMessage response = {
+                        PIP_MESSAGE_RESPONSE,
+                        { .response = responses[index] }
+                    };
+                    if (!nodeHandlePIPResponse (node, response))
+                        messagePIPRelease (&response);
                 }
+                array_free (responses);
+                // `message` remains, with its outputs consumed, to be released.
             }
             break;
+        }
 
         case PIP_MESSAGE_UPDATE_CREDIT_PARAMETERS: {
             // TODO: Process the new credit parameters...
@@ -1236,6 +1900,15 @@ nodeDefineRemoteStatus (BREthereumNode node,
             assert (MESSAGE_LES == message.identifier);
             assert (LES_MESSAGE_STATUS == message.u.les.identifier);
             status = message.u.les.u.status.p2p;
+
+            // The request costs, as announced by the remote, replace our defaults.
+            for (size_t index = 0; index < NUMBER_OF_LES_MESSAGE_IDENTIFIERS; index++) {
+                BREthereumLESMessageStatusMRC cost = message.u.les.u.status.costs[index];
+                if (index == cost.msgCode && (0 != cost.baseCost || 0 != cost.reqCost)) {
+                    node->specs[index].baseCost = cost.baseCost;
+                    node->specs[index].reqCost  = cost.reqCost;
+                }
+            }
             break;
 
         case NODE_TYPE_PARITY:
@@ -1246,6 +1919,15 @@ nodeDefineRemoteStatus (BREthereumNode node,
     }
 
     nodeEndpointSetStatus (node->remote, messageP2PStatusCopy (&status));
+
+    // The flow control parameters; the remote starts us with a full buffer of credits.
+    BREthereumP2PMessageStatusValue value;
+    if (messageP2PStatusExtractValue (&status, P2P_MESSAGE_STATUS_FLOW_CONTROL_BL, &value))
+        node->credits = node->creditsLimit = value.u.integer;
+    if (messageP2PStatusExtractValue (&status, P2P_MESSAGE_STATUS_FLOW_CONTROL_MRR, &value))
+        node->creditsRecharge = value.u.integer;
+    node->creditsTime = nodeGetTimeInMilliseconds();
+    node->creditsSent = 0;
 }
 
 static int
@@ -1371,7 +2053,21 @@ nodeProcess (BREthereumNode node,
                         // Look for the pending message in some provisioner
                         for (size_t index = 0; index < array_count (node->provisioners); index++)
                             if (provisionerSendMessagesPending (&node->provisioners[index])) {
-                                BREthereumNodeStatus status = provisionerMessageSend(&node->provisioners[index]);
+                                BREthereumNodeProvisioner *provisioner = &node->provisioners[index];
+                                BREthereumMessage *pending = provisionerGetMessagePending (provisioner);
+                                uint64_t time = nodeGetTimeInMilliseconds();
+
+                                // Wait, rather than exceed the remote's flow-control buffer.
+                                if (0 != nodeGetMessageDelay (node, pending, time)) break;
+
+                                BREthereumNodeStatus status;
+                                if (MESSAGE_PIP == pending->identifier &&
+                                    PIP_MESSAGE_REQUEST == pending->u.pip.type)
+                                    status = nodeSendPIPRequests (node, index, time);
+                                else {
+                                    nodeChargeMessage (node, provisioner, time);
+                                    status = provisionerMessageSend(provisioner);
+                                }
                                 switch (status) {
                                     case NODE_STATUS_SUCCESS:
                                         break;
@@ -1397,11 +2093,22 @@ nodeProcess (BREthereumNode node,
 
                 case NODE_CONNECT_AUTH:
                     assert (NODE_ROUTE_TCP == route);
+                    switch (nodeHandshakeGetStatus (node)) {
+                        case NODE_HANDSHAKE_NONE:
+                            assert (0);
+                        case NODE_HANDSHAKE_PENDING:
+                            return node->states[route];
+                        case NODE_HANDSHAKE_FAILURE:
+                            return nodeProcessFailure (node, NODE_ROUTE_TCP, NULL, nodeStateCreateErrorProtocol(NODE_PROTOCOL_TCP_AUTHENTICATION));
+                        case NODE_HANDSHAKE_SUCCESS:
+                            break;
+                    }
+
                     if (!FD_ISSET (socket, send)) return node->states[route];
                     nodeUpdateTimeout(node, now);
 
-                    if (0 != _sendAuthInitiator(node))
-                        return nodeProcessFailure (node, NODE_ROUTE_TCP, NULL, nodeStateCreateErrorProtocol(NODE_PROTOCOL_TCP_AUTHENTICATION));
+                    // The `auth` is consumed; the `ack` step starts anew.
+                    atomic_store (&node->handshakeStatus, NODE_HANDSHAKE_NONE);
 
                     eth_log (LES_LOG_TOPIC, "Send: [ WIP, %15s ] => %15s", "Auth", nodeEndpointGetHostname(node->remote));
 
@@ -1413,6 +2120,19 @@ nodeProcess (BREthereumNode node,
 
                 case NODE_CONNECT_AUTH_ACK:
                     assert (NODE_ROUTE_TCP == route);
+                    switch (nodeHandshakeGetStatus (node)) {
+                        case NODE_HANDSHAKE_NONE:
+                            break;  // Still to recv the `ack`
+                        case NODE_HANDSHAKE_PENDING:
+                            return node->states[route];
+                        case NODE_HANDSHAKE_FAILURE:
+                            eth_log (LES_LOG_TOPIC, "%s", "Something went wrong with AUK");
+                            return nodeProcessFailure (node, NODE_ROUTE_TCP, NULL, nodeStateCreateErrorProtocol(NODE_PROTOCOL_TCP_AUTHENTICATION));
+                        case NODE_HANDSHAKE_SUCCESS:
+                            atomic_store (&node->handshakeStatus, NODE_HANDSHAKE_NONE);
+                            return nodeProcessSuccess (node, route, NULL, nodeStateCreateConnecting(NODE_CONNECT_HELLO));
+                    }
+
                     if (!FD_ISSET (socket, recv)) return node->states[route];
                     nodeUpdateTimeout(node, now);
 
@@ -1425,20 +2145,10 @@ nodeProcess (BREthereumNode node,
                     if (ackCipherBufCount != ackCipherBufLen)
                         return nodeProcessFailure (node, NODE_ROUTE_TCP, NULL, nodeStateCreateErrorProtocol(NODE_PROTOCOL_TCP_AUTHENTICATION));
 
-                    if (0 != _readAuthAckFromRecipient (node)) {
-                        eth_log (LES_LOG_TOPIC, "%s", "Something went wrong with AUK");
-                        return nodeProcessFailure (node, NODE_ROUTE_TCP, NULL, nodeStateCreateErrorProtocol(NODE_PROTOCOL_TCP_AUTHENTICATION));
-                    }
-
-                    // Initilize the frameCoder with the information from the auth
-                    frameCoderInit(node->frameCoder,
-                                   nodeEndpointGetEphemeralKey(node->remote), nodeEndpointGetNonce(node->remote),
-                                   nodeEndpointGetEphemeralKey(node->local), nodeEndpointGetNonce(node->local),
-                                   node->ackBufCipher, ackCipherBufLen,
-                                   node->authBufCipher, authCipherBufLen,
-                                   ETHEREUM_BOOLEAN_TRUE);
-
-                    return nodeProcessSuccess (node, route, NULL, nodeStateCreateConnecting(NODE_CONNECT_HELLO));
+                    // Decrypt the `ack` and derive the frame secrets on a worker; on completion
+                    // we'll move on to HELLO (see above).
+                    nodeHandshakeStart (node, nodeHandshakeAckRoutine);
+                    return node->states[route];
 
                 case NODE_CONNECT_HELLO:
                     assert (NODE_ROUTE_TCP == route);
@@ -1842,12 +2552,14 @@ nodeUpdateDescriptors (BREthereumNode node,
             if (NULL != recv)
                 FD_SET (socket, recv);
 
-            // If we have any provisioner with a pending message, we are willing to send
-            for (size_t index = 0; index < array_count (node->provisioners); index++)
-                if (provisionerSendMessagesPending (&node->provisioners[index])) {
-                    if (NULL != send) FD_SET (socket, send);
-                    break;
-                }
+            // If we have any provisioner with a pending message, we are willing to send - once
+            // we've the credits for it.
+            if (NULL != send && NODE_ROUTE_TCP == route && 0 == nodeGetSendDelay (node))
+                for (size_t index = 0; index < array_count (node->provisioners); index++)
+                    if (provisionerSendMessagesPending (&node->provisioners[index])) {
+                        FD_SET (socket, send);
+                        break;
+                    }
 
             break;
 
@@ -1857,6 +2569,18 @@ nodeUpdateDescriptors (BREthereumNode node,
                     assert (0);
 
                 case NODE_CONNECT_AUTH:
+                    // Only once the worker has the `auth` ready; otherwise we'd spin on `send`.
+                    if (NULL != send &&
+                        NODE_HANDSHAKE_SUCCESS == atomic_load (&node->handshakeStatus))
+                        FD_SET (socket, send);
+                    break;
+
+                case NODE_CONNECT_AUTH_ACK:
+                    // Not while the worker is processing the `ack` already received.
+                    if (NULL != recv && NODE_HANDSHAKE_NONE == atomic_load (&node->handshakeStatus))
+                        FD_SET (socket, recv);
+                    break;
+
                 case NODE_CONNECT_HELLO:
                 case NODE_CONNECT_PRE_STATUS_PONG_SEND:
                 case NODE_CONNECT_STATUS:
@@ -1866,7 +2590,6 @@ nodeUpdateDescriptors (BREthereumNode node,
                     if (NULL != send) FD_SET (socket, send);
                     break;
 
-                case NODE_CONNECT_AUTH_ACK:
                 case NODE_CONNECT_HELLO_ACK:
                 case NODE_CONNECT_PRE_STATUS_PING_RECV:
                 case NODE_CONNECT_STATUS_ACK:
@@ -2009,6 +2732,8 @@ nodeSend (BREthereumNode node,
             pthread_mutex_lock (&node->lock);
             error = nodeEndpointSendData (node->remote, route, data.bytes, data.bytesCount);
             pthread_mutex_unlock (&node->lock);
+
+            if (!error) BRStatsCount (BRStatsLESBytesOut, data.bytesCount);
             break;
         }
 
@@ -2024,20 +2749,36 @@ nodeSend (BREthereumNode node,
                 rlpShowItem (node->coder.rlp, item, "SEND");
 #endif
             
-            // Extract the `items` bytes w/o the RLP length prefix.  We *know* the `item` is an
-            // RLP encoding of a list; thus we use `rlpDecodeList`.
-            BRRlpData data = rlpDecodeListSharedDontRelease(node->coder.rlp, item);
+            // Write the `items` bytes w/o the RLP length prefix directly into the send buffer, at
+            // the frame's payload offset.  We *know* the `item` is an RLP encoding of a list;
+            // thus we use `rlpDecodeListInto`.
+            size_t payloadCount = rlpDecodeListInto (node->coder.rlp, item, NULL, 0);
+            size_t frameCount   = frameCoderEncryptSize (payloadCount);
+
+            if (frameCount > node->sendDataBuffer.bytesCount)
+                node->sendDataBuffer = (BRRlpData) {
+                    2 * frameCount,
+                    realloc (node->sendDataBuffer.bytes, 2 * frameCount)
+                };
 
-            // Encrypt the length-less data
-            BRRlpData encryptedData;
+            uint8_t *frame = node->sendDataBuffer.bytes;
+            rlpDecodeListInto (node->coder.rlp, item, &frame[FRAME_CODER_PAYLOAD_OFFSET], payloadCount);
+
+            // The RLPx message id is the payload's first item - an RLP integer, thus 0x80 for zero
+            uint8_t value = frame[FRAME_CODER_PAYLOAD_OFFSET];
+            if (0x80 == value) value = 0;
+
+            // Encrypt the length-less data, in place
             pthread_mutex_lock (&node->lock);
-            frameCoderEncrypt(node->frameCoder,
-                              data.bytes, data.bytesCount,
-                              &encryptedData.bytes, &encryptedData.bytesCount);
+            frameCoderEncryptInPlace (node->frameCoder, frame, payloadCount);
 
-            error = nodeEndpointSendData (node->remote, route, encryptedData.bytes, encryptedData.bytesCount);
+            error = nodeEndpointSendData (node->remote, route, frame, frameCount);
             pthread_mutex_unlock (&node->lock);
-            rlpDataRelease(encryptedData);
+
+            if (!error) {
+                BRStatsCount (BRStatsLESMsgsOut + (value < BR_STATS_MSG_TYPES ? value : BR_STATS_MSG_TYPES - 1), 1);
+                BRStatsCount (BRStatsLESBytesOut, frameCount);
+            }
             break;
         }
     }
@@ -2085,6 +2826,8 @@ nodeRecv (BREthereumNode node,
                 return nodeRecvFailed(node, NODE_ROUTE_UDP,
                                       nodeStateCreateErrorProtocol(NODE_PROTOCOL_UDP_EXCESSIVE_BYTE_COUNT));
 
+            BRStatsCount (BRStatsLESBytesIn, bytesCount);
+
             // Wrap at RLP Byte
             BRRlpItem item = rlpEncodeBytes (node->coder.rlp, bytes, bytesCount);
 
@@ -2126,13 +2869,14 @@ nodeRecv (BREthereumNode node,
             // Given bytesCount, update recvDataBuffer if too small
             pthread_mutex_lock (&node->lock);
             if (bytesCount > bytesLimit) {
-                // Expand recvDataBuffer, with some margin
+                // Expand recvDataBuffer by doubling, so that a run of growing responses costs
+                // few reallocs.  The frame size is 24 bits; this won't overflow.
+                while (bytesLimit < bytesCount) bytesLimit *= 2;
                 node->recvDataBuffer = (BRRlpData) {
-                    2 * bytesCount,
-                    realloc(node->recvDataBuffer.bytes, 2 * bytesCount)
+                    bytesLimit,
+                    realloc(node->recvDataBuffer.bytes, bytesLimit)
                 };
                 bytes = node->recvDataBuffer.bytes;
-                // bytesLimit = node->recvDataBuffer.bytesCount;
             }
             pthread_mutex_unlock (&node->lock);
 
@@ -2155,14 +2899,18 @@ nodeRecv (BREthereumNode node,
             BRRlpItem identifierItem = rlpGetItem (node->coder.rlp, identifierData);
             uint8_t value = (uint8_t) rlpDecodeUInt64 (node->coder.rlp, identifierItem, 1);
 
+            BRStatsCount (BRStatsLESMsgsIn + (value < BR_STATS_MSG_TYPES ? value : BR_STATS_MSG_TYPES - 1), 1);
+            BRStatsCount (BRStatsLESBytesIn, 32 + bytesCount);
+
             BREthereumMessageIdentifier type;
             BREthereumANYMessageIdentifier subtype;
 
             extractIdentifier(node, value, &type, &subtype);
 
-            // Actual body
+            // Actual body; decoded lazily as much of some messages is skipped.  `bytes` remains
+            // valid until `item` is released, below.
             BRRlpData data = { headerCount - 1, &bytes[1] };
-            BRRlpItem item = rlpGetItem (node->coder.rlp, data);
+            BRRlpItem item = rlpGetItemLazy (node->coder.rlp, data);
 
 #if defined (NEED_TO_PRINT_SEND_RECV_DATA)
             eth_log (LES_LOG_TOPIC, "Size: Recv: TCP: Type: %u, Subtype: %d", type, subtype);
@@ -2177,12 +2925,8 @@ nodeRecv (BREthereumNode node,
                 rlpShowItem(node->coder.rlp, item, "RECV");
 #endif
 
-            // If this is a LES response message, then it has credit information.
-            if (!rlpCoderHasFailed(node->coder.rlp) &&
-                MESSAGE_LES == message.identifier &&
-                messageLESHasUse (&message.u.les, LES_MESSAGE_USE_RESPONSE))
-                node->credits = messageLESGetCredits (&message.u.les);
-            
+            // A LES response message has credit information; see `nodeProcessRecvLES()`.
+
             rlpReleaseItem (node->coder.rlp, item);
             rlpReleaseItem (node->coder.rlp, identifierItem);
 
@@ -2216,31 +2960,6 @@ nodeRecv (BREthereumNode node,
 }
 
 
-#pragma clang diagnostic push
-#pragma GCC diagnostic push
-#pragma clang diagnostic ignored "-Wunused-function"
-#pragma GCC diagnostic ignored "-Wunused-function"
-static uint64_t
-nodeEstimateCredits (BREthereumNode node,
-                     BREthereumMessage message) {
-    switch (message.identifier) {
-        case MESSAGE_P2P: return 0;
-        case MESSAGE_DIS: return 0;
-        case MESSAGE_ETH: return 0;
-        case MESSAGE_LES:
-            return (node->specs[message.u.les.identifier].baseCost +
-                    messageLESGetCreditsCount (&message.u.les) * node->specs[message.u.les.identifier].reqCost);
-        case MESSAGE_PIP: return 0;
-    }
-}
-
-static uint64_t
-nodeGetCredits (BREthereumNode node) {
-    return node->credits;
-}
-#pragma clang diagnostic pop
-#pragma GCC diagnostic pop
-
 /// MARK: - Discovered
 
 extern BREthereumBoolean
@@ -2358,10 +3077,15 @@ _sendAuthInitiator(BREthereumNode node) {
     UInt256 staticSharedSecret;
     _BRECDH(staticSharedSecret.u8, localKey, remoteKey);
 
+    // A new ephemeral key and nonce for this handshake; reusing them across handshakes would
+    // let one compromised session expose others.
+    BRKeyGenerate (&node->ephemeralKey, 1, 0);
+    BRRandBytes (node->nonce.u8, sizeof (node->nonce.u8));
+
     //static-shared-secret ^ nonce
     UInt256 xorStaticNonce;
-    UInt256* localNonce =  nodeEndpointGetNonce(node->local);
-    BRKey* localEphemeral = nodeEndpointGetEphemeralKey(node->local);
+    UInt256* localNonce = &node->nonce;
+    BRKey* localEphemeral = &node->ephemeralKey;
     memset(xorStaticNonce.u8, 0, 32);
     bytesXOR(staticSharedSecret.u8, localNonce->u8, xorStaticNonce.u8, sizeof(localNonce->u8));
 
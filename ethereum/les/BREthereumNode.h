@@ -104,6 +104,15 @@ typedef void
                                    BREthereumNode node,
                                    BRArrayOf(BREthereumDISNeighbor) neighbors);
 
+/**
+ * Called on a worker thread, not the LES thread, once `node` has finished work handed off to the
+ * thread pool (the RLPx handshake crypto).  The context should wake whatever calls `nodeProcess()`
+ * so that `node` is processed again.
+ */
+typedef void
+(*BREthereumNodeCallbackWakeup) (BREthereumNodeContext context,
+                                 BREthereumNode node);
+
 /// MARK: - LES Node State
 
 typedef enum {
@@ -201,6 +210,7 @@ nodeStateDecode (BRRlpItem item,
  * @param context
  * @param callbackMessage
  * @param callbackStatus
+ * @param callbackWakeup - called from a worker thread when the handshake crypto completes
  * @return
  */
 extern BREthereumNode // add 'message id offset'?
@@ -213,6 +223,7 @@ nodeCreate (BREthereumNodePriority priority,
             BREthereumNodeCallbackAnnounce callbackAnnounce,
             BREthereumNodeCallbackProvide callbackProvide,
             BREthereumNodeCallbackNeighbor callbackNeighbor,
+            BREthereumNodeCallbackWakeup callbackWakeup,
             BREthereumBoolean handleSync);
 
 extern void
@@ -236,6 +247,56 @@ nodeGetType (BREthereumNode node);
 extern BREthereumNodePriority
 nodeGetPriority (BREthereumNode node);
 
+/**
+ * Return the smoothed provision latency of `node`, in milliseconds, as measured in this session
+ * or else as given by nodeSetPriorLatency().  Returns 0 if `node` has never provided anything.
+ */
+extern uint64_t
+nodeGetLatency (BREthereumNode node);
+
+/**
+ * Set the latency of `node` measured in a prior session; used to order nodes until it is measured
+ * again in this session.
+ */
+extern void
+nodeSetPriorLatency (BREthereumNode node,
+                     uint64_t latency);
+
+/**
+ * The quality of `node` as a provider, accumulated across sessions so that LES prefers the nodes
+ * that served it well: the provisions that succeeded and that failed, the smoothed latency in
+ * milliseconds of each provision type (0 if never provided) and the time, in seconds since the
+ * epoch, of the last successful provision (0 if never).
+ */
+#define NUMBER_OF_NODE_PROVISION_TYPES   (1 + PROVISION_SUBMIT_TRANSACTION)
+
+typedef struct {
+    uint64_t provisionsSucceeded;
+    uint64_t provisionsFailed;
+    uint64_t latencies [NUMBER_OF_NODE_PROVISION_TYPES];
+    uint64_t lastGoodTime;
+} BREthereumNodeQuality;
+
+/**
+ * Return the quality of `node`: as given by nodeSetPriorQuality() updated with this session.
+ */
+extern BREthereumNodeQuality
+nodeGetQuality (BREthereumNode node);
+
+/**
+ * Set the quality of `node` accumulated in prior sessions.
+ */
+extern void
+nodeSetPriorQuality (BREthereumNode node,
+                     BREthereumNodeQuality quality);
+
+/**
+ * Return the bytes held by `node`, including its send and receive buffers.  The buffers grow
+ * when `node` is processed, so call this from the thread processing `node` or under its lock.
+ */
+extern size_t
+nodeGetMemoryUsage (BREthereumNode node);
+
 extern BREthereumNodeState
 nodeConnect (BREthereumNode node,
              BREthereumNodeEndpointRoute route,
@@ -271,13 +332,41 @@ nodeHandleProvision (BREthereumNode node,
 extern BRArrayOf(BREthereumProvision)
 nodeUnhandleProvisions (BREthereumNode node);
 
+/**
+ * Stop handling `provision` - typically because another node has already provided it.  The
+ * node's provision, including any partial results, is released.
+ */
+extern void
+nodeCancelProvision (BREthereumNode node,
+                     BREthereumProvision *provision);
+
+/**
+ * The time, in milliseconds, until `node` has recharged enough flow-control credits to send its
+ * next pending message.  Zero if it can send now, has nothing to send or has no flow control.
+ */
+extern uint64_t
+nodeGetSendDelay (BREthereumNode node);
+
+/**
+ * Estimate the time, in milliseconds, for `node` to complete `provision` were it handled now.
+ * The estimate accounts for the node's measured latency and per-item time, the provisions it
+ * is already handling, its flow-control credits and its failure rate.
+ */
+extern uint64_t
+nodeEstimateProvisionTime (BREthereumNode node,
+                           BREthereumProvision *provision);
+
 extern const BREthereumNodeEndpoint
 nodeGetRemoteEndpoint (BREthereumNode node);
 
 extern const BREthereumNodeEndpoint
 nodeGetLocalEndpoint (BREthereumNode node);
 
-/** Compare nodes based on their priority and DIS neighbor distance */
+/**
+ * Compare nodes based on their priority, then their quality - nodes that served us recently, by
+ * latency and failure rate, ahead of unknown nodes, ahead of nodes that have mostly failed us -
+ * and then DIS neighbor distance
+ */
 extern BREthereumComparison
 nodeCompare (BREthereumNode node1,
              BREthereumNode node2);
@@ -416,10 +416,19 @@ nodeEndpointRecvData (BREthereumNodeEndpoint endpoint,
 
     int socket = endpoint->sockets[route];
 
+    // If we need all of `bytesCount`, have the kernel assemble them; a large frame then costs
+    // one `recv()` rather than one per arriving segment.  We still loop as the wait can end
+    // early, on a signal or the socket's receive timeout.
+#if defined (MSG_WAITALL)
+    int flags = (needBytesCount ? MSG_WAITALL : 0);
+#else
+    int flags = 0;
+#endif
+
     if (socket < 0) error = ENOTCONN;
 
     while (socket >= 0 && !error && totalCount < *bytesCount) {
-        ssize_t n = recv (socket, &bytes[totalCount], *bytesCount - totalCount, 0);
+        ssize_t n = recv (socket, &bytes[totalCount], *bytesCount - totalCount, flags);
         if (n == 0) error = ECONNRESET;
         else if (n < 0 && errno != EWOULDBLOCK) error = errno;
         else if (n < 0 && errno == EWOULDBLOCK) continue;
@@ -63,6 +63,58 @@ provisionGetTypeName (BREthereumProvisionType type) {
     return names[type];
 }
 
+/// MARK: - Accounts
+
+static BREthereumAddress
+provisionAccountsGetAddress (BREthereumProvisionAccounts *provision,
+                             size_t index) {
+    return (NULL == provision->addresses
+            ? provision->address
+            : provision->addresses[index]);
+}
+
+/**
+ * Decode the LES Proofs paths in `data`, for the accounts at `offset`, verifying each against the
+ * provision's state root.  All paths share one MPT node cache so that nodes common to the
+ * accounts' proofs are hashed and decoded once.  If any path fails to verify, return NULL.
+ */
+static BRArrayOf(BREthereumMPTNodePath)
+provisionAccountsDecodeVerifiedPaths (BREthereumProvisionAccounts *provision,
+                                      BRRlpData data,
+                                      size_t offset) {
+    if (0 == data.bytesCount) return NULL;
+
+    BRRlpCoder coder = rlpCoderCreateCached();
+    BRRlpItem item = rlpGetItem (coder, data);
+
+    size_t itemsCount = 0;
+    const BRRlpItem *items = rlpDecodeList (coder, item, &itemsCount);
+
+    BREthereumMPTNodeCache cache = mptNodeCacheCreate (provision->stateRoot);
+
+    BRArrayOf(BREthereumMPTNodePath) paths;
+    array_new (paths, itemsCount);
+
+    for (size_t index = 0; NULL != paths && index < itemsCount; index++) {
+        BREthereumMPTNodePath path = NULL;
+
+        if (offset + index < array_count (provision->hashes)) {
+            BREthereumHash hash = addressGetHash (provisionAccountsGetAddress (provision, offset + index));
+            BREthereumData key  = { sizeof(BREthereumHash), hash.bytes };
+            path = mptNodePathDecodeVerified (items[index], coder, key, cache);
+        }
+
+        if (NULL != path) array_add (paths, path);
+        else { mptNodePathsRelease (paths); paths = NULL; }
+    }
+
+    mptNodeCacheRelease (cache);
+    rlpReleaseItem (coder, item);
+    rlpCoderReleaseCached (coder);
+
+    return paths;
+}
+
 /// MARK: - LES
 
 static BREthereumMessage
@@ -190,7 +242,6 @@ provisionCreateMessageLES (BREthereumProvision *provisionMulti,
         case PROVISION_ACCOUNTS: {
             BREthereumProvisionAccounts *provision = &provisionMulti->u.accounts;
 
-            BREthereumAddress address = provision->address;
             BRArrayOf(BREthereumHash) hashes = provision->hashes;
             size_t hashesCount = array_count(hashes);
 
@@ -207,7 +258,7 @@ provisionCreateMessageLES (BREthereumProvision *provisionMulti,
             for (size_t i = 0; i < minimum (messageContentLimit, hashesCount - hashesOffset); i++) {
                 BREthereumLESMessageGetProofsSpec spec = {
                     hashes[hashesOffset + i],
-                    address,
+                    provisionAccountsGetAddress (provision, hashesOffset + i),
                     0,
                 };
                 array_add (specs, spec);
@@ -251,14 +302,17 @@ provisionCreateMessageLES (BREthereumProvision *provisionMulti,
         case PROVISION_SUBMIT_TRANSACTION: {
             BREthereumProvisionSubmission *provision = &provisionMulti->u.submission;
 
+            size_t transactionsCount = array_count (provision->transactions);
+
             switch (index) {
                 case 0: {
                     BRArrayOf(BREthereumTransaction) transactions;
-                    array_new (transactions, 1);
+                    array_new (transactions, transactionsCount);
 
                     // TODO: We don't have a way to avoid consuming 'transactions' - so copy
                     // the transaction thereby allow a complete release.
-                    array_add (transactions, transactionCopy (provision->transaction));
+                    for (size_t ti = 0; ti < transactionsCount; ti++)
+                        array_add (transactions, transactionCopy (provision->transactions[ti]));
 
                     return (BREthereumMessage) {
                         MESSAGE_LES,
@@ -269,8 +323,9 @@ provisionCreateMessageLES (BREthereumProvision *provisionMulti,
                 }
                 case 1: {
                     BRArrayOf(BREthereumHash) hashes;
-                    array_new (hashes, 1);
-                    array_add (hashes, transactionGetHash (provision->transaction));
+                    array_new (hashes, transactionsCount);
+                    for (size_t ti = 0; ti < transactionsCount; ti++)
+                        array_add (hashes, transactionGetHash (provision->transactions[ti]));
 
                     return (BREthereumMessage) {
                         MESSAGE_LES,
@@ -332,7 +387,7 @@ provisionHandleMessageLES (BREthereumProvision *provisionMulti,
             if (0 == array_count(messageHeaders))
                 status = PROVISION_ERROR;
             else {
-                BRRlpCoder coder = rlpCoderCreate();
+                BRRlpCoder coder = rlpCoderCreateCached();
 
                 size_t offset = messageContentLimit * (identifier - messageIdBase);
                 for (size_t index = 0; index < array_count(messageHeaders); index++) {
@@ -368,7 +423,7 @@ provisionHandleMessageLES (BREthereumProvision *provisionMulti,
                     }
                     dataRelease(key);
                 }
-                rlpCoderRelease(coder);
+                rlpCoderReleaseCached(coder);
             }
             mptNodePathsRelease(messagePaths);
             blockHeadersRelease(messageHeaders);
@@ -422,18 +477,24 @@ provisionHandleMessageLES (BREthereumProvision *provisionMulti,
         case PROVISION_ACCOUNTS: {
             assert (LES_MESSAGE_PROOFS == message.identifier);
             BREthereumProvisionAccounts *provision = &provisionMulti->u.accounts;
-            BREthereumHash hash = addressGetHash(provision->address);
-            BREthereumData key  = { sizeof(BREthereumHash), hash.bytes };
 
             // We'll fill this - at the proper index if a multiple provision.
             BRArrayOf(BREthereumAccountState) provisionAccounts = provision->accounts;
 
             BREthereumProvisionIdentifier identifier = messageLESGetRequestId (&message);
+            size_t offset = messageContentLimit * (identifier - messageIdBase);
 
             BRArrayOf(BREthereumMPTNodePath) messagePaths;
-            messageLESProofsConsume(&message.u.proofs, &messagePaths);
+            if (ETHEREUM_BOOLEAN_IS_TRUE (hashEqual (provision->stateRoot, EMPTY_HASH_INIT)))
+                messageLESProofsConsume (&message.u.proofs, &messagePaths);
+            else {
+                BRRlpData messagePathsData;
+                messageLESProofsConsumeData (&message.u.proofs, &messagePathsData);
+                messagePaths = provisionAccountsDecodeVerifiedPaths (provision, messagePathsData, offset);
+                rlpDataRelease (messagePathsData);
+            }
 
-            if (0 == array_count(messagePaths))
+            if (NULL == messagePaths || 0 == array_count(messagePaths))
                 status = PROVISION_ERROR;
             else {
                 // We need a coder to RLP decode the proof's RLP data into an AccountState.  We could,
@@ -442,14 +503,15 @@ provisionHandleMessageLES (BREthereumProvision *provisionMulti,
                 // coder has network and perhaps other context - although that is not needed here.
                 //
                 // We could add a coder to the BREthereumProvisionAccounts... yes, probably should.
-                BRRlpCoder coder = rlpCoderCreate();
+                BRRlpCoder coder = rlpCoderCreateCached();
 
-                size_t offset = messageContentLimit * (identifier - messageIdBase);
                 for (size_t index = 0; index < array_count(messagePaths); index++) {
                     // We expect, require, one path for each index.  A common 'GetProofs' error
                     // is be have an empty array for messagePaths - that is, no proofs and no
                     // non-proofs.  That is surely an error (boot the node), but...
                     BREthereumMPTNodePath path = messagePaths[index];
+                    BREthereumHash hash = addressGetHash (provisionAccountsGetAddress (provision, offset + index));
+                    BREthereumData key  = { sizeof(BREthereumHash), hash.bytes };
                     BREthereumBoolean foundValue = ETHEREUM_BOOLEAN_FALSE;
                     BRRlpData data = mptNodePathGetValue (path, key, &foundValue);
                     if (ETHEREUM_BOOLEAN_IS_TRUE(foundValue)) {
@@ -460,7 +522,7 @@ provisionHandleMessageLES (BREthereumProvision *provisionMulti,
                     else provisionAccounts[offset + index] = accountStateCreateEmpty();
                     rlpDataRelease(data);
                 }
-                rlpCoderRelease(coder);
+                rlpCoderReleaseCached(coder);
             }
             mptNodePathsRelease(messagePaths);
             break;
@@ -491,7 +553,21 @@ provisionHandleMessageLES (BREthereumProvision *provisionMulti,
             assert (LES_MESSAGE_TX_STATUS == message.identifier);
 
             BREthereumProvisionSubmission *provision = &provisionMulti->u.submission;
-            provision->status = message.u.txStatus.stati[0];
+            size_t transactionsCount = array_count (provision->transactions);
+
+            BRArrayOf(BREthereumTransactionStatus) messageStati;
+            messageLESTxStatusConsume (&message.u.txStatus, &messageStati);
+
+            // A status for each transaction, in order; any not reported remain 'unknown'.
+            if (NULL == provision->statuses) {
+                array_new (provision->statuses, transactionsCount);
+                for (size_t ti = 0; ti < transactionsCount; ti++)
+                    array_add (provision->statuses, transactionStatusCreate (TRANSACTION_STATUS_UNKNOWN));
+            }
+            for (size_t ti = 0; ti < transactionsCount && ti < array_count (messageStati); ti++)
+                provision->statuses[ti] = messageStati[ti];
+
+            array_free (messageStati);
             break;
           }
     }
@@ -639,7 +715,6 @@ provisionCreateMessagePIP (BREthereumProvision *provisionMulti,
         case PROVISION_ACCOUNTS: {
             BREthereumProvisionAccounts *provision = &provisionMulti->u.accounts;
 
-            BREthereumHash addressHash = addressGetHash(provision->address);
             BRArrayOf(BREthereumHash) hashes = provision->hashes;
             size_t hashesCount = array_count(hashes);
 
@@ -655,7 +730,8 @@ provisionCreateMessagePIP (BREthereumProvision *provisionMulti,
             for (size_t i = 0; i < minimum (messageContentLimit, hashesCount - hashesOffset); i++) {
                 BREthereumPIPRequestInput input = {
                     PIP_REQUEST_ACCOUNT,
-                    { .account = { hashes[hashesOffset + i], addressHash }}
+                    { .account = { hashes[hashesOffset + i],
+                        addressGetHash (provisionAccountsGetAddress (provision, hashesOffset + i)) }}
                 };
                 array_add (inputs, input);
             }
@@ -704,14 +780,17 @@ provisionCreateMessagePIP (BREthereumProvision *provisionMulti,
 
             // We have two messages to submit a transaction, but only one response.  The response
             // needs the proper messageIdentifier in order to be paired with this provision.
+            size_t transactionsCount = array_count (provision->transactions);
+
             switch (index) {
                 case 0: {
                     BRArrayOf(BREthereumTransaction) transactions;
-                    array_new (transactions, 1);
+                    array_new (transactions, transactionsCount);
 
                     // TODO: We don't have a way to avoid consuming 'transactions' - so copy
                     // the transaction thereby allow a complete release.
-                    array_add (transactions, transactionCopy (provision->transaction));
+                    for (size_t ti = 0; ti < transactionsCount; ti++)
+                        array_add (transactions, transactionCopy (provision->transactions[ti]));
 
                     return (BREthereumMessage) {
                         MESSAGE_PIP,
@@ -723,13 +802,15 @@ provisionCreateMessagePIP (BREthereumProvision *provisionMulti,
 
                 case 1: {
                     BRArrayOf(BREthereumPIPRequestInput) inputs;
-                    array_new (inputs, 1);
-
-                    BREthereumPIPRequestInput input = {
-                        PIP_REQUEST_TRANSACTION_INDEX,
-                        { .transactionIndex = { transactionGetHash (provision->transaction) }}
-                    };
-                    array_add (inputs, input);
+                    array_new (inputs, transactionsCount);
+
+                    for (size_t ti = 0; ti < transactionsCount; ti++) {
+                        BREthereumPIPRequestInput input = {
+                            PIP_REQUEST_TRANSACTION_INDEX,
+                            { .transactionIndex = { transactionGetHash (provision->transactions[ti]) }}
+                        };
+                        array_add (inputs, input);
+                    }
 
                     return (BREthereumMessage) {
                         MESSAGE_PIP,
@@ -765,14 +846,16 @@ provisionHandleMessagePIP (BREthereumProvision *provisionMulti,
             BRArrayOf(BREthereumPIPRequestOutput) outputs;
             messagePIPResponseConsume(&message.u.response, &outputs);
 
-            // TODO: Not likely.
-            assert (1 == array_count(outputs));
-            BREthereumPIPRequestOutput output = outputs[0];
+            // No output if the request was packed behind one that Parity couldn't answer.
+            assert (array_count(outputs) <= 1);
+            BRArrayOf(BREthereumBlockHeader) messageHeaders = NULL;
 
-            assert (PIP_REQUEST_HEADERS == output.identifier);
-            BRArrayOf(BREthereumBlockHeader) messageHeaders = output.u.headers.headers;
+            if (1 == array_count(outputs)) {
+                assert (PIP_REQUEST_HEADERS == outputs[0].identifier);
+                messageHeaders = outputs[0].u.headers.headers;
+            }
 
-            if (0 == array_count(messageHeaders))
+            if (NULL == messageHeaders || 0 == array_count(messageHeaders))
                 status = PROVISION_ERROR;
             else {
                 size_t offset = messageContentLimit * (identifier - messageIdBase);
@@ -780,7 +863,7 @@ provisionHandleMessagePIP (BREthereumProvision *provisionMulti,
                     provisionHeaders[offset + index] = messageHeaders[index];
             }
 
-            array_free (messageHeaders);
+            if (NULL != messageHeaders) array_free (messageHeaders);
             array_free (outputs);
             break;
         }
@@ -797,7 +880,7 @@ provisionHandleMessagePIP (BREthereumProvision *provisionMulti,
             if (0 == array_count(outputs))
                 status = PROVISION_ERROR;
             else {
-                BRRlpCoder coder = rlpCoderCreate();
+                BRRlpCoder coder = rlpCoderCreateCached();
 
                 size_t offset = messageContentLimit * (identifier - messageIdBase);
                 for (size_t index = 0; index < array_count(outputs); index++) {
@@ -824,7 +907,7 @@ provisionHandleMessagePIP (BREthereumProvision *provisionMulti,
                     rlpReleaseItem (coder, item);
                     mptNodePathRelease (path);
                 }
-                rlpCoderRelease(coder);
+                rlpCoderReleaseCached(coder);
             }
             array_free (outputs);
            break;
@@ -951,27 +1034,24 @@ provisionHandleMessagePIP (BREthereumProvision *provisionMulti,
         case PROVISION_SUBMIT_TRANSACTION: {
             BREthereumProvisionSubmission *provision = &provisionMulti->u.submission;
 
+            size_t transactionsCount = array_count (provision->transactions);
+
             BRArrayOf(BREthereumPIPRequestOutput) outputs = NULL;
             messagePIPResponseConsume(&message.u.response, &outputs);
 
-            switch (array_count(outputs)) {
-                case 0:
-                    // TODO: probably 'unknown'
-                    provision->status = transactionStatusCreate (TRANSACTION_STATUS_QUEUED);
-                    break;
-
-                case 1:
-                    provision->status =
-                    transactionStatusCreateIncluded (outputs[0].u.transactionIndex.blockHash,
-                                                     outputs[0].u.transactionIndex.blockNumber,
-                                                     outputs[0].u.transactionIndex.transactionIndex,
-                                                     TRANSACTION_STATUS_BLOCK_TIMESTAMP_UNKNOWN,
-                                                     gasCreate (0));
-                    break;
-
-                default:
-                    assert(0);
-            }
+            // As for PROVISION_TRANSACTION_STATUSES, outputs can't be matched to transactions
+            // unless there is one for each.
+            array_new (provision->statuses, transactionsCount);
+            for (size_t ti = 0; ti < transactionsCount; ti++)
+                array_add (provision->statuses,
+                           (transactionsCount != array_count(outputs)
+                            // TODO: probably 'unknown'
+                            ? transactionStatusCreate (TRANSACTION_STATUS_QUEUED)
+                            : transactionStatusCreateIncluded (outputs[ti].u.transactionIndex.blockHash,
+                                                               outputs[ti].u.transactionIndex.blockNumber,
+                                                               outputs[ti].u.transactionIndex.transactionIndex,
+                                                               TRANSACTION_STATUS_BLOCK_TIMESTAMP_UNKNOWN,
+                                                               gasCreate (0))));
 
             array_free (outputs);
             break;
@@ -1012,6 +1092,16 @@ numbersCopy (BRArrayOf(uint64_t) numbers) {
     return result;
 }
 
+static BRArrayOf(BREthereumAddress)
+provisionAddressesCopy (BRArrayOf(BREthereumAddress) addresses) {
+    if (NULL == addresses) return NULL;
+
+    BRArrayOf(BREthereumAddress) result;
+    array_new (result, array_count(addresses));
+    array_add_array(result, addresses, array_count(addresses));
+    return result;
+}
+
 extern BREthereumProvision
 provisionCopy (BREthereumProvision *provision,
                BREthereumBoolean copyResults) {
@@ -1063,7 +1153,9 @@ provisionCopy (BREthereumProvision *provision,
                 { .accounts = {
                     provision->u.accounts.address,
                     hashesCopy(provision->u.accounts.hashes),
-                    NULL }}
+                    NULL,
+                    provisionAddressesCopy (provision->u.accounts.addresses),
+                    provision->u.accounts.stateRoot }}
             };
 
         case PROVISION_TRANSACTION_STATUSES:
@@ -1080,8 +1172,8 @@ provisionCopy (BREthereumProvision *provision,
                 provision->identifier,
                 provision->type,
                 { .submission = {
-                    transactionCopy (provision->u.submission.transaction),
-                    (BREthereumTransactionStatus) {} }}
+                    transactionsCopy (provision->u.submission.transactions),
+                    NULL }}
             };
     }
 }
@@ -1125,6 +1217,8 @@ provisionReleaseResults (BREthereumProvision *provision) {
             break;
 
         case PROVISION_SUBMIT_TRANSACTION:
+            if (NULL != provision->u.submission.statuses)
+                array_free (provision->u.submission.statuses);
             break;
     }
 }
@@ -1154,6 +1248,8 @@ provisionRelease (BREthereumProvision *provision,
         case PROVISION_ACCOUNTS:
             if (NULL != provision->u.accounts.hashes)
                 array_free (provision->u.accounts.hashes);
+            if (NULL != provision->u.accounts.addresses)
+                array_free (provision->u.accounts.addresses);
             break;
 
         case PROVISION_TRANSACTION_STATUSES:
@@ -1162,8 +1258,8 @@ provisionRelease (BREthereumProvision *provision,
             break;
 
         case PROVISION_SUBMIT_TRANSACTION:
-            if (NULL != provision->u.submission.transaction)
-                transactionRelease (provision->u.submission.transaction);
+            if (NULL != provision->u.submission.transactions)
+                transactionsRelease (provision->u.submission.transactions);
             break;
     }
 
@@ -1212,6 +1308,15 @@ provisionAccountsConsume (BREthereumProvisionAccounts *provision,
     if (NULL != accounts) { *accounts = provision->accounts; provision->accounts = NULL; }
 }
 
+extern void
+provisionAccountsConsumeMultiple (BREthereumProvisionAccounts *provision,
+                                  BRArrayOf(BREthereumAddress) *addresses,
+                                  BRArrayOf(BREthereumHash) *hashes,
+                                  BRArrayOf(BREthereumAccountState) *accounts) {
+    if (NULL != addresses) { *addresses = provision->addresses; provision->addresses = NULL; }
+    provisionAccountsConsume (provision, hashes, accounts);
+}
+
 
 extern void
 provisionStatusesConsume (BREthereumProvisionStatuses *provision,
@@ -1223,10 +1328,10 @@ provisionStatusesConsume (BREthereumProvisionStatuses *provision,
 
 extern void
 provisionSubmissionConsume (BREthereumProvisionSubmission *provision,
-                            BREthereumTransaction *transaction,
-                            BREthereumTransactionStatus *status) {
-    if (NULL != transaction) { *transaction = provision->transaction; provision->transaction = NULL; }
-    if (NULL != status)      { *status      = provision->status; }
+                            BRArrayOf(BREthereumTransaction) *transactions,
+                            BRArrayOf(BREthereumTransactionStatus) *statuses) {
+    if (NULL != transactions) { *transactions = provision->transactions; provision->transactions = NULL; }
+    if (NULL != statuses)     { *statuses     = provision->statuses;     provision->statuses     = NULL; }
 }
 
 extern BREthereumProvisionStatus
@@ -1258,6 +1363,199 @@ provisionMatches (BREthereumProvision *provision1,
                                 );
 }
 
+/// MARK: - Provision Batch
+
+extern BREthereumBoolean
+provisionIsBatchable (BREthereumProvision *provision) {
+    switch (provision->type) {
+        case PROVISION_BLOCK_HEADERS:
+            return ETHEREUM_BOOLEAN_FALSE;
+
+        case PROVISION_BLOCK_PROOFS:
+        case PROVISION_BLOCK_BODIES:
+        case PROVISION_TRANSACTION_RECEIPTS:
+        case PROVISION_ACCOUNTS:
+        case PROVISION_TRANSACTION_STATUSES:
+        case PROVISION_SUBMIT_TRANSACTION:
+            return ETHEREUM_BOOLEAN_TRUE;
+    }
+}
+
+extern size_t
+provisionGetCount (BREthereumProvision *provision) {
+    switch (provision->type) {
+        case PROVISION_BLOCK_HEADERS:        return provision->u.headers.limit;
+        case PROVISION_BLOCK_PROOFS:         return array_count (provision->u.proofs.numbers);
+        case PROVISION_BLOCK_BODIES:         return array_count (provision->u.bodies.hashes);
+        case PROVISION_TRANSACTION_RECEIPTS: return array_count (provision->u.receipts.hashes);
+        case PROVISION_ACCOUNTS:             return array_count (provision->u.accounts.hashes);
+        case PROVISION_TRANSACTION_STATUSES: return array_count (provision->u.statuses.hashes);
+        case PROVISION_SUBMIT_TRANSACTION:   return array_count (provision->u.submission.transactions);
+    }
+}
+
+extern BREthereumBoolean
+provisionBatchAppend (BREthereumProvision *batch,
+                      BREthereumProvision *provision,
+                      size_t limit) {
+    if (batch->type != provision->type ||
+        ETHEREUM_BOOLEAN_IS_FALSE (provisionIsBatchable (provision)) ||
+        provisionGetCount (batch) + provisionGetCount (provision) > limit)
+        return ETHEREUM_BOOLEAN_FALSE;
+
+    switch (provision->type) {
+        case PROVISION_BLOCK_HEADERS:
+            assert (0);
+            return ETHEREUM_BOOLEAN_FALSE;
+
+        case PROVISION_SUBMIT_TRANSACTION:
+            // All transactions are sent in one message
+            if (provisionGetCount (batch) + provisionGetCount (provision) > PROVISION_SUBMISSION_BATCH_LIMIT)
+                return ETHEREUM_BOOLEAN_FALSE;
+
+            // The batch owns copies; the member keeps its own transactions to be handed back.
+            for (size_t index = 0; index < array_count (provision->u.submission.transactions); index++)
+                array_add (batch->u.submission.transactions,
+                           transactionCopy (provision->u.submission.transactions[index]));
+            break;
+
+        case PROVISION_BLOCK_PROOFS:
+            array_add_array (batch->u.proofs.numbers,
+                             provision->u.proofs.numbers,
+                             array_count (provision->u.proofs.numbers));
+            break;
+
+        case PROVISION_BLOCK_BODIES:
+            array_add_array (batch->u.bodies.hashes,
+                             provision->u.bodies.hashes,
+                             array_count (provision->u.bodies.hashes));
+            break;
+
+        case PROVISION_TRANSACTION_RECEIPTS:
+            array_add_array (batch->u.receipts.hashes,
+                             provision->u.receipts.hashes,
+                             array_count (provision->u.receipts.hashes));
+            break;
+
+        case PROVISION_ACCOUNTS:
+            // Multiple addresses batch only with multiple addresses against the same state root
+            if ((NULL == batch->u.accounts.addresses) != (NULL == provision->u.accounts.addresses) ||
+                ETHEREUM_BOOLEAN_IS_FALSE (hashEqual (batch->u.accounts.stateRoot,
+                                                      provision->u.accounts.stateRoot)))
+                return ETHEREUM_BOOLEAN_FALSE;
+
+            if (NULL != provision->u.accounts.addresses)
+                array_add_array (batch->u.accounts.addresses,
+                                 provision->u.accounts.addresses,
+                                 array_count (provision->u.accounts.addresses));
+            else if (ETHEREUM_BOOLEAN_IS_FALSE (addressEqual (batch->u.accounts.address,
+                                                              provision->u.accounts.address)))
+                return ETHEREUM_BOOLEAN_FALSE;
+
+            array_add_array (batch->u.accounts.hashes,
+                             provision->u.accounts.hashes,
+                             array_count (provision->u.accounts.hashes));
+            break;
+
+        case PROVISION_TRANSACTION_STATUSES:
+            array_add_array (batch->u.statuses.hashes,
+                             provision->u.statuses.hashes,
+                             array_count (provision->u.statuses.hashes));
+            break;
+    }
+    return ETHEREUM_BOOLEAN_TRUE;
+}
+
+// Move `count` results, starting at `batchResults[offset]`, into a new array at `results`
+#define provisionBatchSplitArray(batchResults, results, offset, count)    \
+    do {                                                                    \
+        array_new ((results), (count));                                     \
+        array_add_array ((results), &(batchResults)[(offset)], (count));    \
+    } while (0)
+
+extern size_t
+provisionBatchSplit (BREthereumProvision *batch,
+                     BREthereumProvision *provision,
+                     size_t offset) {
+    size_t count = provisionGetCount (provision);
+    assert (batch->type == provision->type);
+    assert (offset + count <= provisionGetCount (batch));
+
+    switch (provision->type) {
+        case PROVISION_BLOCK_HEADERS:
+            assert (0);
+            break;
+
+        case PROVISION_BLOCK_PROOFS:
+            provisionBatchSplitArray (batch->u.proofs.proofs, provision->u.proofs.proofs, offset, count);
+            break;
+
+        case PROVISION_BLOCK_BODIES:
+            provisionBatchSplitArray (batch->u.bodies.pairs, provision->u.bodies.pairs, offset, count);
+            break;
+
+        case PROVISION_TRANSACTION_RECEIPTS:
+            provisionBatchSplitArray (batch->u.receipts.receipts, provision->u.receipts.receipts, offset, count);
+            break;
+
+        case PROVISION_ACCOUNTS:
+            provisionBatchSplitArray (batch->u.accounts.accounts, provision->u.accounts.accounts, offset, count);
+            break;
+
+        case PROVISION_TRANSACTION_STATUSES:
+            provisionBatchSplitArray (batch->u.statuses.statuses, provision->u.statuses.statuses, offset, count);
+            break;
+
+        case PROVISION_SUBMIT_TRANSACTION:
+            provisionBatchSplitArray (batch->u.submission.statuses, provision->u.submission.statuses, offset, count);
+            break;
+    }
+    return offset + count;
+}
+#undef provisionBatchSplitArray
+
+extern void
+provisionBatchRelease (BREthereumProvision *batch) {
+    // The result's elements were all moved, by `provisionBatchSplit()`, into the members; just
+    // free the arrays themselves.
+    switch (batch->type) {
+        case PROVISION_BLOCK_HEADERS:
+            assert (0);
+            break;
+
+        case PROVISION_BLOCK_PROOFS:
+            if (NULL != batch->u.proofs.proofs) array_free (batch->u.proofs.proofs);
+            batch->u.proofs.proofs = NULL;
+            break;
+
+        case PROVISION_BLOCK_BODIES:
+            if (NULL != batch->u.bodies.pairs) array_free (batch->u.bodies.pairs);
+            batch->u.bodies.pairs = NULL;
+            break;
+
+        case PROVISION_TRANSACTION_RECEIPTS:
+            if (NULL != batch->u.receipts.receipts) array_free (batch->u.receipts.receipts);
+            batch->u.receipts.receipts = NULL;
+            break;
+
+        case PROVISION_ACCOUNTS:
+            if (NULL != batch->u.accounts.accounts) array_free (batch->u.accounts.accounts);
+            batch->u.accounts.accounts = NULL;
+            break;
+
+        case PROVISION_TRANSACTION_STATUSES:
+            if (NULL != batch->u.statuses.statuses) array_free (batch->u.statuses.statuses);
+            batch->u.statuses.statuses = NULL;
+            break;
+
+        case PROVISION_SUBMIT_TRANSACTION:
+            if (NULL != batch->u.submission.statuses) array_free (batch->u.submission.statuses);
+            batch->u.submission.statuses = NULL;
+            break;
+    }
+    provisionRelease (batch, ETHEREUM_BOOLEAN_FALSE);
+}
+
 extern void
 provisionResultRelease (BREthereumProvisionResult *result) {
     provisionRelease (&result->provision, ETHEREUM_BOOLEAN_TRUE);
@@ -126,6 +126,11 @@ typedef struct {
     BRArrayOf(BREthereumHash) hashes;
     // Response
     BRArrayOf(BREthereumAccountState) accounts;
+    // Request, optional.  If non-NULL, `addresses` holds one address per hash and `address` is
+    // ignored; if not EMPTY_HASH_INIT, every hash is of a block with state root `stateRoot` and
+    // the LES proofs are verified against it, sharing one MPT node cache per response.
+    BRArrayOf(BREthereumAddress) addresses;
+    BREthereumHash stateRoot;
 } BREthereumProvisionAccounts;
 
 extern void
@@ -133,6 +138,12 @@ provisionAccountsConsume (BREthereumProvisionAccounts *provision,
                           BRArrayOf(BREthereumHash) *hashes,
                           BRArrayOf(BREthereumAccountState) *accounts);
 
+extern void
+provisionAccountsConsumeMultiple (BREthereumProvisionAccounts *provision,
+                                  BRArrayOf(BREthereumAddress) *addresses,
+                                  BRArrayOf(BREthereumHash) *hashes,
+                                  BRArrayOf(BREthereumAccountState) *accounts);
+
 /**
  * Transaction Statuses
  */
@@ -150,18 +161,23 @@ provisionStatusesConsume (BREthereumProvisionStatuses *provision,
 
 /**
  * Transaction Submission
+ *
+ * Submissions batch as others do, the transactions sent in one SendTx2 and their statuses
+ * requested in one GetTxStatus, and thus at most PROVISION_SUBMISSION_BATCH_LIMIT in a batch.
  */
 typedef struct {
     // Request
-    BREthereumTransaction transaction;
+    BRArrayOf(BREthereumTransaction) transactions;
     // Response
-    BREthereumTransactionStatus status;
+    BRArrayOf(BREthereumTransactionStatus) statuses;
 } BREthereumProvisionSubmission;
 
+#define PROVISION_SUBMISSION_BATCH_LIMIT     (64)
+
 extern void
 provisionSubmissionConsume (BREthereumProvisionSubmission *provision,
-                            BREthereumTransaction *transaction,
-                            BREthereumTransactionStatus *status);
+                            BRArrayOf(BREthereumTransaction) *transactions,
+                            BRArrayOf(BREthereumTransactionStatus) *statuses);
 
 /// MARK: - Provision
 
@@ -221,6 +237,52 @@ extern BREthereumBoolean
 provisionMatches (BREthereumProvision *provision1,
                   BREthereumProvision *provision2);
 
+/// MARK: - Provision Batch
+
+/**
+ * Many small provisions of the same type - typically one hash each, from BCS - can be batched
+ * into a single provision and thus into as few LES/PIP messages as the node allows.  A batch is
+ * a provision whose request items are the concatenation of its members' request items; once the
+ * batch has results, those results are split back into each member, in order.
+ *
+ * Block Headers are never batched; Accounts are batched only for the same address.
+ */
+extern BREthereumBoolean
+provisionIsBatchable (BREthereumProvision *provision);
+
+/**
+ * The number of request items (hashes or block numbers) in `provision`.
+ */
+extern size_t
+provisionGetCount (BREthereumProvision *provision);
+
+/**
+ * Append the request items of `provision` to `batch`, if compatible and if the result has no
+ * more than `limit` items.
+ *
+ * @return TRUE if appended; FALSE otherwise, with `batch` unchanged.
+ */
+extern BREthereumBoolean
+provisionBatchAppend (BREthereumProvision *batch,
+                      BREthereumProvision *provision,
+                      size_t limit);
+
+/**
+ * Move the `batch` results, starting at item `offset`, into `provision`.
+ *
+ * @return the offset of the next member's results
+ */
+extern size_t
+provisionBatchSplit (BREthereumProvision *batch,
+                     BREthereumProvision *provision,
+                     size_t offset);
+
+/**
+ * Release `batch` once all its results have been split into members.
+ */
+extern void
+provisionBatchRelease (BREthereumProvision *batch);
+
 /**
  * Provision Result
  */
@@ -258,13 +258,12 @@ messageLESBlockHeadersDecode (BRRlpItem item,
     uint64_t reqId = rlpDecodeUInt64 (coder.rlp, items[0], 1);
     uint64_t bv    = rlpDecodeUInt64 (coder.rlp, items[1], 1);
 
-    size_t headerItemsCount = 0;
-    const BRRlpItem *headerItems = rlpDecodeList (coder.rlp, items[2], &headerItemsCount);
-
-    BRArrayOf(BREthereumBlockHeader) headers;
-    array_new (headers, headerItemsCount);
-    for (size_t index = 0; index < headerItemsCount; index++)
-        array_add (headers, blockHeaderRlpDecode (headerItems[index], RLP_TYPE_NETWORK, coder.rlp));
+    // No more headers than a GetBlockHeaders request can ask for; otherwise none, a provision error
+    BRArrayOf(BREthereumBlockHeader) headers =
+        blockHeadersRlpDecode (items[2],
+                               messageLESSpecs[LES_MESSAGE_GET_BLOCK_HEADERS].limit,
+                               RLP_TYPE_NETWORK,
+                               coder.rlp);
 
     return (BREthereumLESMessageBlockHeaders) {
         reqId,
@@ -290,6 +289,29 @@ messageLESBlockBodiesConsume (BREthereumLESMessageBlockBodies *message,
     if (NULL != pairs) { *pairs = message->pairs; message->pairs = NULL; }
 }
 
+/// Decode at least this many block bodies in parallel - each holds up to hundreds of transactions.
+#define LES_BLOCK_BODIES_DECODE_PARALLEL_MINIMUM       (2)
+
+typedef struct {
+    BREthereumNetwork network;
+    BREthereumBlockBodyPair *pairs;
+} BREthereumLESBlockBodiesDecodeContext;
+
+static void
+messageLESBlockBodyDecodeRoutine (BREthereumLESBlockBodiesDecodeContext *context,
+                                  BRRlpCoder coder,
+                                  BRRlpItem item,
+                                  size_t index) {
+    size_t bodyItemsCount;
+    const BRRlpItem *bodyItems = rlpDecodeList (coder, item, &bodyItemsCount);
+    assert (2 == bodyItemsCount);
+
+    context->pairs[index] = (BREthereumBlockBodyPair) {
+        blockTransactionsRlpDecode (bodyItems[0], context->network, RLP_TYPE_NETWORK, coder),
+        blockOmmersRlpDecode (bodyItems[1], context->network, RLP_TYPE_NETWORK, coder)
+    };
+}
+
 static BREthereumLESMessageBlockBodies
 messageLESBlockBodiesDecode (BRRlpItem item,
                              BREthereumMessageCoder coder) {
@@ -305,17 +327,11 @@ messageLESBlockBodiesDecode (BRRlpItem item,
 
     BRArrayOf(BREthereumBlockBodyPair) pairs;
     array_new(pairs, pairItemsCount);
-    for (size_t index = 0; index < pairItemsCount; index++) {
-        size_t bodyItemsCount;
-        const BRRlpItem *bodyItems = rlpDecodeList (coder.rlp, pairItems[index], &bodyItemsCount);
-        assert (2 == bodyItemsCount);
-
-        BREthereumBlockBodyPair pair = {
-            blockTransactionsRlpDecode (bodyItems[0], coder.network, RLP_TYPE_NETWORK, coder.rlp),
-            blockOmmersRlpDecode (bodyItems[1], coder.network, RLP_TYPE_NETWORK, coder.rlp)
-        };
-        array_add(pairs, pair);
-    }
+    array_set_count(pairs, pairItemsCount);
+
+    BREthereumLESBlockBodiesDecodeContext context = { coder.network, pairs };
+    rlpDecodeListParallel (coder.rlp, pairItems, pairItemsCount, LES_BLOCK_BODIES_DECODE_PARALLEL_MINIMUM,
+                           &context, (BRRlpDecodeRoutine) messageLESBlockBodyDecodeRoutine);
     return (BREthereumLESMessageBlockBodies) {
         reqId,
         bv,
@@ -340,6 +356,17 @@ messageLESReceiptsConsume (BREthereumLESMessageReceipts *receipts,
     if (NULL != arrays) { *arrays = receipts->arrays; receipts->arrays = NULL; }
 }
 
+static void
+messageLESReceiptsArrayDecode (BRArrayOf(BREthereumLESMessageReceiptsArray) *arrays,
+                               BRRlpCoder coder,
+                               BRRlpItem item,
+                               size_t index) {
+    BREthereumLESMessageReceiptsArray array = {
+        transactionReceiptDecodeList (item, coder)
+    };
+    array_add (*arrays, array);
+}
+
 static BREthereumLESMessageReceipts
 messageLESReceiptsDecode (BRRlpItem item,
                           BREthereumMessageCoder coder) {
@@ -350,17 +377,12 @@ messageLESReceiptsDecode (BRRlpItem item,
     uint64_t reqId = rlpDecodeUInt64 (coder.rlp, items[0], 1);
     uint64_t bv    = rlpDecodeUInt64 (coder.rlp, items[1], 1);
 
-    size_t arrayItemsCount = 0;
-    const BRRlpItem *arrayItems = rlpDecodeList (coder.rlp, items[2], &arrayItemsCount);
-
+    // A response holds the receipts of many blocks, easily megabytes; stream them, one block's
+    // receipts at a time, rather than holding the items for every block's receipts at once.
     BRArrayOf(BREthereumLESMessageReceiptsArray) arrays;
-    array_new(arrays, arrayItemsCount);
-    for (size_t index = 0; index < arrayItemsCount; index++) {
-        BREthereumLESMessageReceiptsArray array = {
-            transactionReceiptDecodeList (arrayItems[index], coder.rlp)
-        };
-        array_add (arrays, array);
-    }
+    array_new(arrays, 10);
+    rlpDecodeListStream (coder.rlp, items[2], &arrays, (BRRlpDecodeRoutine) messageLESReceiptsArrayDecode);
+
     return (BREthereumLESMessageReceipts) {
         reqId,
         bv,
@@ -404,7 +426,28 @@ messageLESGetProofsEncode (BREthereumLESMessageGetProofs message, BREthereumMess
 extern void
 messageLESProofsConsume (BREthereumLESMessageProofs *message,
                          BRArrayOf(BREthereumMPTNodePath) *paths) {
-    if (NULL != paths) { *paths = message->paths; message->paths = NULL; }
+    if (NULL == paths) return;
+
+    array_new (*paths, 10);
+    if (0 == message->pathsData.bytesCount) return;
+
+    BRRlpCoder coder = rlpCoderCreateCached();
+    BRRlpItem item = rlpGetItem (coder, message->pathsData);
+
+    size_t pathsCount = 0;
+    const BRRlpItem *pathsItems = rlpDecodeList (coder, item, &pathsCount);
+
+    for (size_t index = 0; index < pathsCount; index++)
+        array_add (*paths, mptNodePathDecode (pathsItems[index], coder));
+
+    rlpReleaseItem (coder, item);
+    rlpCoderReleaseCached (coder);
+}
+
+extern void
+messageLESProofsConsumeData (BREthereumLESMessageProofs *message,
+                             BRRlpData *pathsData) {
+    if (NULL != pathsData) { *pathsData = message->pathsData; message->pathsData = (BRRlpData) { 0, NULL }; }
 }
 
 static BREthereumLESMessageProofs
@@ -418,18 +461,10 @@ messageLESProofsDecode (BRRlpItem item,
     uint64_t reqId = rlpDecodeUInt64 (coder.rlp, items[0], 1);
     uint64_t bv    = rlpDecodeUInt64 (coder.rlp, items[1], 1);
 
-    size_t pathsCount = 0;
-    const BRRlpItem *pathsItems = rlpDecodeList (coder.rlp, items[2], &pathsCount);
-
-    BRArrayOf(BREthereumMPTNodePath) paths;
-    array_new (paths, pathsCount);
-    for (size_t index = 0; index < pathsCount; index++)
-        array_add (paths, mptNodePathDecode (pathsItems[index], coder.rlp));
-
     return (BREthereumLESMessageProofs) {
         reqId,
         bv,
-        paths
+        rlpGetData (coder.rlp, items[2])
     };
 }
 
@@ -814,7 +849,7 @@ messageLESRelease (BREthereumLESMessage *message) {
             break;
 
         case LES_MESSAGE_PROOFS:
-            // TODO: Geth
+            rlpDataRelease (message->u.proofs.pathsData);
             break;
 
         case LES_MESSAGE_GET_CONTRACT_CODES:
@@ -248,13 +248,25 @@ typedef struct {
 typedef struct {
     uint64_t reqId;
     uint64_t bv;
-    BRArrayOf(BREthereumMPTNodePath) paths;
+    // The RLP encoding of the paths; decoded when consumed, so that the consumer can choose
+    // to verify them against a state root.
+    BRRlpData pathsData;
 } BREthereumLESMessageProofs;
 
+/**
+ * Decode the message's paths, without verification.
+ */
 extern void
 messageLESProofsConsume (BREthereumLESMessageProofs *message,
                          BRArrayOf(BREthereumMPTNodePath) *paths);
 
+/**
+ * Take the RLP encoding of the message's paths, such as for mptNodePathDecodeVerified().
+ */
+extern void
+messageLESProofsConsumeData (BREthereumLESMessageProofs *message,
+                             BRRlpData *pathsData);
+
 /// MARK: LES GetContractCodes
 
 typedef struct {
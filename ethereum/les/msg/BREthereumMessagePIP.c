@@ -12,6 +12,9 @@
 #include "ethereum/mpt/BREthereumMPT.h"
 #include "BREthereumMessagePIP.h"
 
+// The most headers one Headers request is answered with; the implicit Parity limit we request by.
+#define PIP_REQUEST_HEADERS_MAXIMUM         (256)
+
 extern const char *
 messagePIPGetRequestName (BREthereumPIPRequestType type) {
     static const char *
@@ -271,7 +274,10 @@ messagePIPRequestOutputDecode (BRRlpItem item,
         case PIP_REQUEST_HEADERS:
             return (BREthereumPIPRequestOutput) {
                 PIP_REQUEST_HEADERS,
-                { .headers = { blockOmmersRlpDecode (items[1], coder.network, RLP_TYPE_NETWORK, coder.rlp) } }
+                { .headers = { blockHeadersRlpDecode (items[1],
+                                                      PIP_REQUEST_HEADERS_MAXIMUM,
+                                                      RLP_TYPE_NETWORK,
+                                                      coder.rlp) } }
             };
 
         case PIP_REQUEST_HEADER_PROOF: {
@@ -432,6 +438,56 @@ messagePIPResponseConsume (BREthereumPIPMessageResponse *message,
     if (NULL != outputs) { *outputs = message->outputs; message->outputs = NULL; }
 }
 
+/// MARK: PIP Request Packing
+
+extern void
+messagePIPRequestPack (BRArrayOf(BREthereumPIPRequestInput) *inputs,
+                       BRArrayOf(BREthereumPIPRequestPart) *parts,
+                       const BREthereumPIPMessageRequest *request) {
+    size_t count = array_count (request->inputs);
+
+    array_add_array (*inputs, request->inputs, count);
+    array_add (*parts, ((BREthereumPIPRequestPart) { request->reqId, count }));
+}
+
+extern BRArrayOf(BREthereumPIPMessageResponse)
+messagePIPResponseUnpack (BREthereumPIPMessageResponse *response,
+                          BRArrayOf(BREthereumPIPRequestPart) parts) {
+    BRArrayOf(BREthereumPIPRequestOutput) outputs = NULL;
+    messagePIPResponseConsume (response, &outputs);
+
+    size_t outputsCount  = (NULL == outputs ? 0 : array_count (outputs));
+    size_t outputsOffset = 0;
+
+    BRArrayOf(BREthereumPIPMessageResponse) responses;
+    array_new (responses, array_count (parts));
+
+    for (size_t index = 0; index < array_count (parts); index++) {
+        size_t count = (parts[index].inputsCount < outputsCount - outputsOffset
+                        ? parts[index].inputsCount
+                        : outputsCount - outputsOffset);
+
+        // Each output is moved, not copied, into the part's response.
+        BRArrayOf(BREthereumPIPRequestOutput) partOutputs;
+        array_new (partOutputs, count);
+        if (count > 0) array_add_array (partOutputs, &outputs[outputsOffset], count);
+        outputsOffset += count;
+
+        array_add (responses, ((BREthereumPIPMessageResponse) {
+            parts[index].reqId,
+            response->credits,
+            partOutputs
+        }));
+    }
+
+    // Any outputs beyond the parts weren't requested.
+    for (; outputsOffset < outputsCount; outputsOffset++)
+        messagePIPRequestOutputRelease (&outputs[outputsOffset]);
+
+    if (NULL != outputs) array_free (outputs);
+    return responses;
+}
+
 extern void // special case - only 'output' with allocated memory.
 messagePIPRequestHeadersOutputConsume (BREthereumPIPRequestHeadersOutput *output,
                                        BRArrayOf(BREthereumBlockHeader) *headers) {
@@ -248,6 +248,40 @@ extern void
 messagePIPResponseConsume (BREthereumPIPMessageResponse *message,
                            BRArrayOf(BREthereumPIPRequestOutput) *outputs);
 
+/// MARK: PIP Request Packing
+
+/**
+ * A PIP Request holds any number of inputs, of any request type, and Parity answers it with one
+ * output per input, in order, stopping at the first input it can't answer.  Thus the requests of
+ * several provisions, each with their own `reqId`, can be packed into one Request and the single
+ * Response split back into one Response per original request.
+ *
+ * A part records an original request packed into a Request: its `reqId` and its inputs count.
+ */
+typedef struct {
+    BREthereumPIPRequestIdentifier reqId;
+    size_t inputsCount;
+} BREthereumPIPRequestPart;
+
+    /**
+     * Append the inputs of `request` to `inputs`, recording the part in `parts`.  The inputs are
+     * shared with `request`, not copied, so the packed `inputs` must be released with
+     * `array_free()` rather than as the inputs of a message.
+     */
+extern void
+messagePIPRequestPack (BRArrayOf(BREthereumPIPRequestInput) *inputs,
+                       BRArrayOf(BREthereumPIPRequestPart) *parts,
+                       const BREthereumPIPMessageRequest *request);
+
+    /**
+     * Split `response`, to a Request packed as `parts`, into one Response per part, in `parts`
+     * order, each with the `reqId` of its part.  A part past the last output is given a Response
+     * with no outputs.  The `response` outputs are consumed.
+     */
+extern BRArrayOf(BREthereumPIPMessageResponse)
+messagePIPResponseUnpack (BREthereumPIPMessageResponse *response,
+                          BRArrayOf(BREthereumPIPRequestPart) parts);
+
 typedef struct {
     UInt256 max;
     UInt256 recharge;
@@ -951,8 +951,8 @@ _SendTransaction_Callback_Test1 (BREthereumLESProvisionContext context,
     assert (PROVISION_SUCCESS == result.status);
     assert (PROVISION_SUBMIT_TRANSACTION == result.provision.type);
 
-    // BREthereumTransaction transaction  = result.provision.u.submission.transaction;
-    // BREthereumTransactionStatus status = result.provision.u.submission.status;
+    // BREthereumTransaction transaction  = result.provision.u.submission.transactions[0];
+    // BREthereumTransactionStatus status = result.provision.u.submission.statuses[0];
 
     _signalTestComplete();
 }
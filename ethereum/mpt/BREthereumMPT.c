@@ -9,6 +9,7 @@
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 
 #include "support/BRAssert.h"
+#include "support/BRSet.h"
 #include "BREthereumMPT.h"
 
 #undef MPT_SHOW_PROOF_NODES
@@ -19,6 +20,11 @@ typedef struct BREthereumMPTNodeRecord *BREthereumMPTNode;
 
 struct BREthereumMPTNodeRecord {
     BREthereumMPTNodeType type;
+
+    // Nodes are immutable once decoded; a node is shared by a node cache and by the paths
+    // decoded with that cache.  Released when `references` reaches zero.
+    unsigned int references;
+
     union {
         struct {
             BREthereumData path;  // data w/ each byte a nibble a/ preface stripped!
@@ -41,12 +47,20 @@ static BREthereumMPTNode
 mptNodeCreate (BREthereumMPTNodeType type) {
     BREthereumMPTNode node = calloc (1, sizeof (struct BREthereumMPTNodeRecord));
     node->type = type;
+    node->references = 1;
+    return node;
+}
+
+static BREthereumMPTNode
+mptNodeRetain (BREthereumMPTNode node) {
+    node->references++;
     return node;
 }
 
 static void
 mptNodeRelease (BREthereumMPTNode node) {
     if (NULL == node) return;  // On RLP coding error during 'nodes' processing
+    if (0 != --node->references) return;
     switch (node->type) {
         case MPT_NODE_LEAF:
             dataRelease(node->u.leaf.path);
@@ -113,6 +127,36 @@ mptNodeConsume (BREthereumMPTNode node, uint8_t *key) {
     }
 }
 
+/**
+ * Return the hash of the node that `node` references when following the nibbles in `key`,
+ * starting at `*keyIndex`, and advance `*keyIndex` past the consumed nibbles.  If `node` is a
+ * leaf or `key` cannot be followed any further (the key is exhausted or diverges from the node)
+ * then return EMPTY_HASH_INIT.
+ */
+static BREthereumHash
+mptNodeGetChildHash (BREthereumMPTNode node,
+                     const uint8_t *key,
+                     size_t keyCount,
+                     size_t *keyIndex) {
+    switch (node->type) {
+        case MPT_NODE_LEAF:
+            return EMPTY_HASH_INIT;
+
+        case MPT_NODE_EXTENSION: {
+            size_t pathCount = node->u.extension.path.count;
+            if (0 == pathCount || keyCount - *keyIndex < pathCount ||
+                pathCount != mptNodeConsume (node, (uint8_t *) &key[*keyIndex]))
+                return EMPTY_HASH_INIT;
+            *keyIndex += pathCount;
+            return node->u.extension.key;
+        }
+
+        case MPT_NODE_BRANCH:
+            if (keyCount == *keyIndex) return EMPTY_HASH_INIT;
+            return node->u.branch.keys[key[(*keyIndex)++]];
+    }
+}
+
 #define NIBBLE_UPPER(x)     (0x0f & ((x) >> 4))
 #define NIBBLE_LOWER(x)     (0x0f & ((x) >> 0))
 
@@ -201,6 +245,101 @@ mptNodeDecode (BRRlpItem item,
     return node;
 }
 
+/// MARK: - MPT Node Cache
+
+typedef struct {
+    BREthereumHash hash;    // Keccak256 of `encoding`; first, as the BRSet key
+    BRRlpData encoding;
+    BREthereumMPTNode node;
+} BREthereumMPTNodeCacheEntry;
+
+struct BREthereumMPTNodeCacheRecord {
+    BREthereumHash root;
+    BRSetOf(BREthereumMPTNodeCacheEntry*) entries;
+};
+
+static size_t
+mptNodeCacheEntryHashValue (const void *entry) {
+    return (size_t) hashSetValue (&((const BREthereumMPTNodeCacheEntry *) entry)->hash);
+}
+
+static int
+mptNodeCacheEntryHashEqual (const void *entry1, const void *entry2) {
+    return hashSetEqual (&((const BREthereumMPTNodeCacheEntry *) entry1)->hash,
+                         &((const BREthereumMPTNodeCacheEntry *) entry2)->hash);
+}
+
+static void
+mptNodeCacheEntryRelease (void *ignore, void *item) {
+    BREthereumMPTNodeCacheEntry *entry = item;
+    mptNodeRelease (entry->node);
+    rlpDataRelease (entry->encoding);
+    free (entry);
+}
+
+extern BREthereumMPTNodeCache
+mptNodeCacheCreate (BREthereumHash root) {
+    BREthereumMPTNodeCache cache = malloc (sizeof (struct BREthereumMPTNodeCacheRecord));
+    cache->root = root;
+    cache->entries = BRSetNew (mptNodeCacheEntryHashValue, mptNodeCacheEntryHashEqual, 64);
+    return cache;
+}
+
+extern void
+mptNodeCacheRelease (BREthereumMPTNodeCache cache) {
+    BRSetApply (cache->entries, NULL, mptNodeCacheEntryRelease);
+    BRSetFree (cache->entries);
+    free (cache);
+}
+
+extern BREthereumHash
+mptNodeCacheGetRoot (BREthereumMPTNodeCache cache) {
+    return cache->root;
+}
+
+extern size_t
+mptNodeCacheGetCount (BREthereumMPTNodeCache cache) {
+    return BRSetCount (cache->entries);
+}
+
+/**
+ * Return the node, with a reference for the caller, whose RLP encoding is `encoding` if that
+ * encoding has `hash`; otherwise return NULL.  A cached node is returned after comparing the
+ * encodings' bytes, without rehashing or decoding; an uncached node is hashed, decoded from
+ * `item` (or from `encoding` if `item` is NULL) and then added to `cache`.
+ */
+static BREthereumMPTNode
+mptNodeCacheGetNode (BREthereumMPTNodeCache cache,
+                     BREthereumHash hash,
+                     BRRlpData encoding,
+                     BRRlpItem item,
+                     BRRlpCoder coder) {
+    BREthereumMPTNodeCacheEntry *entry = BRSetGet (cache->entries, &hash);
+
+    if (NULL != entry)
+        return (entry->encoding.bytesCount == encoding.bytesCount &&
+                0 == memcmp (entry->encoding.bytes, encoding.bytes, encoding.bytesCount)
+                ? mptNodeRetain (entry->node)
+                : NULL);
+
+    if (0 == encoding.bytesCount ||
+        ETHEREUM_BOOLEAN_IS_FALSE (hashEqual (hash, hashCreateFromData (encoding))))
+        return NULL;
+
+    BRRlpItem nodeItem = (NULL != item ? item : rlpGetItem (coder, encoding));
+    BREthereumMPTNode node = mptNodeDecode (nodeItem, coder);
+    if (NULL == item) rlpReleaseItem (coder, nodeItem);
+    if (NULL == node) return NULL;
+
+    entry = malloc (sizeof (BREthereumMPTNodeCacheEntry));
+    entry->hash = hash;
+    entry->encoding = rlpDataCopy (encoding);
+    entry->node = mptNodeRetain (node);
+    BRSetAdd (cache->entries, entry);
+
+    return node;
+}
+
 /// MARK: - MPT Node Path
 
 struct BREthereumMPTNodePathRecord {
@@ -271,6 +410,79 @@ mptNodePathDecodeFromBytes (BRRlpItem item,
     return mptNodePathCreate(nodes);
 }
 
+/**
+ * Decode and verify the nodes in `items`, each either an RLP list (`itemsAreBytes` is false) or
+ * RLP bytes holding the RLP encoding of a list (`itemsAreBytes` is true).
+ */
+static BREthereumMPTNodePath
+mptNodePathDecodeVerifiedItems (const BRRlpItem *items,
+                                size_t itemsCount,
+                                int itemsAreBytes,
+                                BREthereumData key,
+                                BREthereumMPTNodeCache cache,
+                                BRRlpCoder coder) {
+    size_t  keyEncodedCount = 2 * key.count;
+    uint8_t keyEncoded [keyEncodedCount];
+    size_t  keyEncodedIndex = 0;
+
+    for (size_t index = 0; index < key.count; index++) {
+        keyEncoded [2 * index + 0] = NIBBLE_UPPER(key.bytes[index]);
+        keyEncoded [2 * index + 1] = NIBBLE_LOWER(key.bytes[index]);
+    }
+
+    BRArrayOf (BREthereumMPTNode) nodes;
+    array_new (nodes, itemsCount);
+
+    // The first node has the root hash; each subsequent node has the hash referenced, along
+    // `key`, by its predecessor.  A node with which `key` cannot be followed must be last.
+    BREthereumHash hash = cache->root;
+
+    for (size_t index = 0; index < itemsCount; index++) {
+        BREthereumMPTNode node = NULL;
+
+        if (ETHEREUM_BOOLEAN_IS_FALSE (hashEqual (hash, EMPTY_HASH_INIT))) {
+            BRRlpData encoding = (itemsAreBytes
+                                  ? rlpDecodeBytesSharedDontRelease (coder, items[index])
+                                  : rlpGetDataSharedDontRelease (coder, items[index]));
+            node = mptNodeCacheGetNode (cache, hash, encoding, (itemsAreBytes ? NULL : items[index]), coder);
+        }
+
+        if (NULL == node) {
+            for (size_t n = 0; n < array_count (nodes); n++)
+                mptNodeRelease (nodes[n]);
+            array_free (nodes);
+            return NULL;
+        }
+
+        array_add (nodes, node);
+        hash = mptNodeGetChildHash (node, keyEncoded, keyEncodedCount, &keyEncodedIndex);
+    }
+
+    return mptNodePathCreate(nodes);
+}
+
+extern BREthereumMPTNodePath
+mptNodePathDecodeVerified (BRRlpItem item,
+                           BRRlpCoder coder,
+                           BREthereumData key,
+                           BREthereumMPTNodeCache cache) {
+    size_t itemsCount = 0;
+    const BRRlpItem *items = rlpDecodeList (coder, item, &itemsCount);
+
+    return mptNodePathDecodeVerifiedItems (items, itemsCount, 0, key, cache, coder);
+}
+
+extern BREthereumMPTNodePath
+mptNodePathDecodeFromBytesVerified (BRRlpItem item,
+                                    BRRlpCoder coder,
+                                    BREthereumData key,
+                                    BREthereumMPTNodeCache cache) {
+    size_t itemsCount = 0;
+    const BRRlpItem *items = rlpDecodeList (coder, item, &itemsCount);
+
+    return mptNodePathDecodeVerifiedItems (items, itemsCount, 1, key, cache, coder);
+}
+
 extern BREthereumMPTNode
 mptNodePathGetNode (BREthereumMPTNodePath path,
                     BREthereumData key) {
@@ -77,6 +77,51 @@ extern BREthereumMPTNodePath
 mptNodePathDecodeFromBytes (BRRlpItem item,
                             BRRlpCoder coder);
 
+/**
+ * A MPT Node Cache holds nodes that have been verified as part of the trie with `root`.  Nodes
+ * are keyed by the Keccak256 hash of their RLP encoding.  Proofs for many keys against a single
+ * root, such as account states for many addresses in one block, share their upper nodes; with a
+ * cache those shared nodes are hashed and decoded once.  A cache is not thread-safe.
+ */
+typedef struct BREthereumMPTNodeCacheRecord *BREthereumMPTNodeCache;
+
+extern BREthereumMPTNodeCache
+mptNodeCacheCreate (BREthereumHash root);
+
+extern void
+mptNodeCacheRelease (BREthereumMPTNodeCache cache);
+
+extern BREthereumHash
+mptNodeCacheGetRoot (BREthereumMPTNodeCache cache);
+
+extern size_t
+mptNodeCacheGetCount (BREthereumMPTNodeCache cache);
+
+/**
+ * Decode a MPT, as mptNodePathDecode(), verifying it as a proof for `key` against the root of
+ * `cache`.  The first node must hash to the root and each subsequent node must hash to the node
+ * referenced, along `key`, by its predecessor.  Nodes found in `cache` are shared, rather than
+ * rehashed and decoded; verified nodes are added to `cache`.  Returns NULL if the path does not
+ * verify.
+ *
+ * @note The path remains valid after `cache` is released.
+ */
+extern BREthereumMPTNodePath
+mptNodePathDecodeVerified (BRRlpItem item,
+                           BRRlpCoder coder,
+                           BREthereumData key,
+                           BREthereumMPTNodeCache cache);
+
+/**
+ * Decode a MPT, as mptNodePathDecodeFromBytes(), verifying it against the root of `cache` as
+ * for mptNodePathDecodeVerified().
+ */
+extern BREthereumMPTNodePath
+mptNodePathDecodeFromBytesVerified (BRRlpItem item,
+                                    BRRlpCoder coder,
+                                    BREthereumData key,
+                                    BREthereumMPTNodeCache cache);
+
 /**
  * Create a Key Path from a value
  */
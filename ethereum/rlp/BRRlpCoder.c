@@ -13,6 +13,7 @@
 #include <memory.h>
 #include <assert.h>
 #include <pthread.h>
+#include "support/BRThreadPool.h"
 #include "ethereum/util/BRUtil.h"
 #include "BRRlpCoder.h"
 
@@ -22,11 +23,28 @@ rlpCoderReclaimInternal (BRRlpCoder coder) ;
 static int
 rlpDecodeStringEmptyCheck (BRRlpCoder coder, BRRlpItem item);
 
+static void
+itemEnsureList (BRRlpCoder coder, BRRlpItem item);
+
+static void
+itemEnsureEncoded (BRRlpCoder coder, BRRlpItem item);
+
 static void
 encodeLengthIntoBytes (uint64_t length, uint8_t baseline, uint8_t *bytes9, uint8_t *bytes9Count);
 
 #define CODER_DEFAULT_ITEMS     (2000)
 
+/// The bytes of released items a coder keeps on `free`, for reuse; any beyond are freed.
+#define CODER_FREE_BYTES_MAXIMUM        (256 * 1024)
+
+/// The coders each thread caches for rlpCoderCreateCached(), and the bytes of released items
+/// each cached coder keeps.
+#define CODER_CACHE_COUNT               (4)
+#define CODER_CACHE_FREE_BYTES_MAXIMUM  (32 * 1024)
+
+#define CODER_ARENA_BLOCK_SIZE  (64 * 1024)
+#define CODER_ARENA_ALIGNMENT   (sizeof (uint64_t))
+
 /**
  * An RLP Encoding is comprised of two types: an ITEM and a LIST (of ITEM).
  *
@@ -45,25 +63,49 @@ struct  BRRlpItemRecord {
     // The encoding
     size_t bytesCount;
     uint8_t *bytes;
-    uint8_t  bytesArray [ITEM_DEFAULT_BYTES_COUNT];
+
+    // If `shared`, then `bytes` references the caller's data (from rlpGetItemLazy()) and is not
+    // owned by the item.  If `pending`, then the item is a CODER_LIST whose component items
+    // have not yet been decoded from `bytes`.  If `deferred`, then the item is a CODER_LIST
+    // whose `bytes` have not yet been written from its component items; `bytesCount` is known.
+    uint8_t shared;
+    uint8_t pending;
+    uint8_t deferred;
 
     // If CODER_LIST, then reference the component items.
     size_t itemsCount;
     BRRlpItem *items;
-    BRRlpItem  itemsArray [ITEM_DEFAULT_ITEMS_COUNT];
 
     // double linked-list of free/busy items.
     BRRlpItem next, prev;
+
+    // Default storage for `bytes` and `items`.  These must be last; an arena coder allocates
+    // only ITEM_ARENA_SIZE bytes per item and never references these arrays.
+    uint8_t  bytesArray [ITEM_DEFAULT_BYTES_COUNT];
+    BRRlpItem  itemsArray [ITEM_DEFAULT_ITEMS_COUNT];
 };
 
+#define ITEM_ARENA_SIZE     (offsetof (struct BRRlpItemRecord, bytesArray))
+
 static void
 itemReleaseMemory (BRRlpItem item) {
-    if (item->bytesArray != item->bytes && NULL != item->bytes) free (item->bytes);
+    if (!item->shared && item->bytesArray != item->bytes && NULL != item->bytes) free (item->bytes);
     if (item->itemsArray != item->items && NULL != item->items) free (item->items);
 
     memset (item, 0, sizeof (struct BRRlpItemRecord));
 }
 
+/**
+ * An arena block.  An arena is a singly-linked list of blocks with the most recent first; memory
+ * is allocated from the most recent block by bumping `used`.
+ */
+typedef struct BRRlpArenaBlockRecord {
+    struct BRRlpArenaBlockRecord *next;
+    size_t size;
+    size_t used;
+    uint8_t bytes[];
+} *BRRlpArenaBlock;
+
 /**
  *
  */
@@ -79,6 +121,13 @@ struct BRRlpCoderRecord {
      */
     BRRlpItem free;
 
+    /**
+     * The number of items in `free`; bounded by `freeLimit` so that, once a large message is
+     * released, the coder does not hold its items forever.
+     */
+    size_t freeCount;
+    size_t freeLimit;
+
     /**
      * A doubly-linked list of busy RLP items.  Fact is, we don't need to keep this list - you
      * acquire an item and you best be sure to release it and if you don't you've leaked memory.
@@ -94,6 +143,15 @@ struct BRRlpCoderRecord {
      */
     BRRlpItem busy;
 
+    /**
+     * If an arena coder, then items are allocated from `arena` rather than from `free`, and
+     * `arenaBusyCount` is the number of items not yet released.  Neither `free` nor `busy` are
+     * used and `lock` is never taken.
+     */
+    int useArena;
+    BRRlpArenaBlock arena;
+    size_t arenaBusyCount;
+
     /**
      * It is not likely that this lock is actually needed, base on current `BRRlpCoder` use - coders
      * are only used in one thread.  However, that use my not be generally true - so lock/unlock.
@@ -101,12 +159,71 @@ struct BRRlpCoderRecord {
     pthread_mutex_t lock;
 };
 
-extern BRRlpCoder
-rlpCoderCreate (void) {
+static void
+rlpCoderLock (BRRlpCoder coder) {
+    if (!coder->useArena) pthread_mutex_lock (&coder->lock);
+}
+
+static void
+rlpCoderUnlock (BRRlpCoder coder) {
+    if (!coder->useArena) pthread_mutex_unlock (&coder->lock);
+}
+
+static void *
+rlpCoderArenaAlloc (BRRlpCoder coder, size_t size) {
+    size = (size + CODER_ARENA_ALIGNMENT - 1) & ~(CODER_ARENA_ALIGNMENT - 1);
+
+    // Start a new block if the current one is full; an allocation larger than a default block
+    // gets a block of its own.
+    if (NULL == coder->arena || coder->arena->used + size > coder->arena->size) {
+        size_t blockSize = (size > CODER_ARENA_BLOCK_SIZE ? size : CODER_ARENA_BLOCK_SIZE);
+        BRRlpArenaBlock block = malloc (sizeof (struct BRRlpArenaBlockRecord) + blockSize);
+        assert (NULL != block);
+
+        block->size = blockSize;
+        block->used = 0;
+        block->next = coder->arena;
+        coder->arena = block;
+    }
+
+    void *memory = &coder->arena->bytes[coder->arena->used];
+    coder->arena->used += size;
+    return memory;
+}
+
+/**
+ * Free the arena blocks, but keep the most recent one (as empty) if `keepOne` is TRUE.  There
+ * must be no busy items.
+ */
+static void
+rlpCoderArenaReset (BRRlpCoder coder, int keepOne) {
+    assert (0 == coder->arenaBusyCount);
+
+    BRRlpArenaBlock block = (keepOne && NULL != coder->arena ? coder->arena->next : coder->arena);
+    while (NULL != block) {
+        BRRlpArenaBlock next = block->next;
+        free (block);
+        block = next;
+    }
+
+    if (keepOne && NULL != coder->arena) {
+        coder->arena->next = NULL;
+        coder->arena->used = 0;
+    }
+    else coder->arena = NULL;
+}
+
+static BRRlpCoder
+rlpCoderCreateInternal (int useArena) {
     BRRlpCoder coder = malloc (sizeof (struct BRRlpCoderRecord));
     coder->failed = 0;
     coder->free = NULL;
+    coder->freeCount = 0;
+    coder->freeLimit = CODER_FREE_BYTES_MAXIMUM / sizeof (struct BRRlpItemRecord);
     coder->busy = NULL;
+    coder->useArena = useArena;
+    coder->arena = NULL;
+    coder->arenaBusyCount = 0;
 
     {
         pthread_mutexattr_t attr;
@@ -125,21 +242,116 @@ rlpCoderCreate (void) {
     return coder;
 }
 
+extern BRRlpCoder
+rlpCoderCreate (void) {
+    return rlpCoderCreateInternal (0);
+}
+
+extern BRRlpCoder
+rlpCoderCreateArena (void) {
+    return rlpCoderCreateInternal (1);
+}
+
 extern void
 rlpCoderRelease (BRRlpCoder coder) {
-    pthread_mutex_lock(&coder->lock);
+    rlpCoderLock (coder);
 
     // Every single Item must be returned!
-    assert (NULL == coder->busy);
+    assert (NULL == coder->busy && 0 == coder->arenaBusyCount);
     rlpCoderReclaimInternal (coder);
 
-    pthread_mutex_unlock(&coder->lock);
+    rlpCoderUnlock (coder);
     pthread_mutex_destroy(&coder->lock);
     free (coder);
 }
 
+/**
+ * Free items from `coder->free` until no more than `limit` remain.  Must hold `coder->lock`.
+ */
+static void
+rlpCoderTrimInternal (BRRlpCoder coder, size_t limit) {
+    while (coder->freeCount > limit) {
+        BRRlpItem item = coder->free;
+        coder->free = item->next;
+        coder->freeCount--;
+        free (item);
+    }
+}
+
+//
+// Thread Coder Cache - a few coders per thread for rlpCoderCreateCached(), released when the
+// thread exits.
+//
+typedef struct {
+    size_t count;
+    BRRlpCoder coders[CODER_CACHE_COUNT];
+} BRRlpCoderCache;
+
+static pthread_key_t coderCacheKey;
+static pthread_once_t coderCacheKeyOnce = PTHREAD_ONCE_INIT;
+
+static void
+coderCacheKeyDestructor (void *context) {
+    BRRlpCoderCache *cache = context;
+    for (size_t index = 0; index < cache->count; index++)
+        rlpCoderRelease (cache->coders[index]);
+    free (cache);
+}
+
+static void
+coderCacheKeyCreate (void) {
+    pthread_key_create (&coderCacheKey, coderCacheKeyDestructor);
+}
+
+static BRRlpCoderCache *
+coderCacheGet (void) {
+    pthread_once (&coderCacheKeyOnce, coderCacheKeyCreate);
+
+    BRRlpCoderCache *cache = pthread_getspecific (coderCacheKey);
+    if (NULL == cache) {
+        cache = calloc (1, sizeof (BRRlpCoderCache));
+        pthread_setspecific (coderCacheKey, cache);
+    }
+    return cache;
+}
+
+extern BRRlpCoder
+rlpCoderCreateCached (void) {
+    BRRlpCoderCache *cache = coderCacheGet ();
+    return (0 != cache->count
+            ? cache->coders[--cache->count]
+            : rlpCoderCreateInternal (0));
+}
+
+extern void
+rlpCoderReleaseCached (BRRlpCoder coder) {
+    BRRlpCoderCache *cache = coderCacheGet ();
+
+    if (cache->count == CODER_CACHE_COUNT) {
+        rlpCoderRelease (coder);
+        return;
+    }
+
+    pthread_mutex_lock (&coder->lock);
+
+    // Every single Item must be returned!
+    assert (NULL == coder->busy);
+    rlpCoderTrimInternal (coder, CODER_CACHE_FREE_BYTES_MAXIMUM / sizeof (struct BRRlpItemRecord));
+    coder->failed = 0;
+
+    pthread_mutex_unlock (&coder->lock);
+
+    cache->coders[cache->count++] = coder;
+}
+
 static void
 rlpCoderReclaimInternal (BRRlpCoder coder) {
+    // An arena can only be freed once no item references it.
+    if (coder->useArena) {
+        if (0 == coder->arenaBusyCount) rlpCoderArenaReset (coder, 0);
+        return;
+    }
+
     BRRlpItem item = coder->free;
     while (item != NULL) {
         BRRlpItem next = item->next;   // save 'next' before release...
@@ -148,32 +360,74 @@ rlpCoderReclaimInternal (BRRlpCoder coder) {
         item = next;
     }
     coder->free = NULL;
+    coder->freeCount = 0;
 }
 
 extern void
 rlpCoderReclaim (BRRlpCoder coder) {
-    pthread_mutex_lock(&coder->lock);
+    rlpCoderLock (coder);
     rlpCoderReclaimInternal (coder);
-    pthread_mutex_unlock(&coder->lock);
+    rlpCoderUnlock (coder);
 }
 
 extern int
 rlpCoderBusyCount (BRRlpCoder coder) {
+    if (coder->useArena) return (int) coder->arenaBusyCount;
+
     int count = 0;
     for (BRRlpItem found = coder->busy; NULL != found; found = found->next)
         count++;
     return count;
 }
 
+static size_t
+itemGetMemoryUsage (BRRlpItem item) {
+    size_t usage = sizeof (struct BRRlpItemRecord);
+    if (!item->shared && item->bytesArray != item->bytes && NULL != item->bytes)
+        usage += item->bytesCount;
+    if (item->itemsArray != item->items && NULL != item->items)
+        usage += item->itemsCount * sizeof (BRRlpItem);
+    return usage;
+}
+
+extern size_t
+rlpCoderGetMemoryUsage (BRRlpCoder coder) {
+    size_t usage = sizeof (struct BRRlpCoderRecord);
+
+    if (coder->useArena) {
+        for (BRRlpArenaBlock block = coder->arena; NULL != block; block = block->next)
+            usage += sizeof (struct BRRlpArenaBlockRecord) + block->size;
+        return usage;
+    }
+
+    pthread_mutex_lock (&coder->lock);
+    usage += coder->freeCount * sizeof (struct BRRlpItemRecord);
+    for (BRRlpItem item = coder->busy; NULL != item; item = item->next)
+        usage += itemGetMemoryUsage (item);
+    pthread_mutex_unlock (&coder->lock);
+
+    return usage;
+}
+
 static BRRlpItem
 rlpCoderAcquireItem (BRRlpCoder coder) {
     BRRlpItem item = NULL;
+
+    // An arena item has no default storage; it is not linked to `busy`, only counted.
+    if (coder->useArena) {
+        item = rlpCoderArenaAlloc (coder, ITEM_ARENA_SIZE);
+        memset (item, 0, ITEM_ARENA_SIZE);
+        coder->arenaBusyCount++;
+        return item;
+    }
+
     pthread_mutex_lock(&coder->lock);
 
     // Get `item` from `coder->free` or `calloc`
     if (NULL != coder->free) {
         item = coder->free;
         coder->free = item->next;
+        coder->freeCount--;
         item->next = NULL;
     }
     else item = calloc (1, sizeof (struct BRRlpItemRecord));
@@ -209,18 +463,32 @@ rlpCoderReturnItem (BRRlpCoder coder, BRRlpItem prev, BRRlpItem item, BRRlpItem
         if (NULL != next) next->prev = prev;
     }
 
-    // The `item` is no longer busy.  Singlely link to `free`.
+    // The `item` is no longer busy.  If `free` is full, simply free `item`.
     item->prev = NULL;
-    item->next = coder->free;
+    if (coder->freeCount >= coder->freeLimit) {
+        pthread_mutex_unlock(&coder->lock);
+        free (item);
+        return;
+    }
 
-    // Update `coder` to show `item` as free.
+    // Otherwise, singlely link to `free` and update `coder` to show `item` as free.
+    item->next = coder->free;
     coder->free = item;
+    coder->freeCount++;
 
     pthread_mutex_unlock(&coder->lock);
 }
 
 static void
 itemRelease (BRRlpCoder coder, BRRlpItem item) {
+    // An arena item's memory is reclaimed with the arena, which can be reused once the last
+    // item is released.
+    if (coder->useArena) {
+        assert (coder->arenaBusyCount > 0);
+        if (0 == --coder->arenaBusyCount) rlpCoderArenaReset (coder, 1);
+        return;
+    }
+
     BRRlpItem prev = item->prev;
     BRRlpItem next = item->next;
 
@@ -244,9 +512,11 @@ static uint8_t *
 itemEnsureBytes (BRRlpCoder coder, BRRlpItem item, size_t bytesCount) {
     assert (NULL == item->bytes);
     item->bytesCount = bytesCount;
-    item->bytes = (item->bytesCount > ITEM_DEFAULT_BYTES_COUNT
-                   ? malloc (item->bytesCount)
-                   : item->bytesArray);
+    item->bytes = (coder->useArena
+                   ? rlpCoderArenaAlloc (coder, item->bytesCount)
+                   : (item->bytesCount > ITEM_DEFAULT_BYTES_COUNT
+                      ? malloc (item->bytesCount)
+                      : item->bytesArray));
     return item->bytes;
 }
 
@@ -254,9 +524,11 @@ static BRRlpItem
 itemFillList (BRRlpCoder coder, BRRlpItem item, BRRlpItem *items, size_t itemsCount) {
     item->type = CODER_LIST;
     item->itemsCount = itemsCount;
-    item->items = (item->itemsCount > ITEM_DEFAULT_ITEMS_COUNT
-                   ? calloc (item->itemsCount, sizeof (BRRlpItem))
-                   : item->itemsArray);
+    item->items = (coder->useArena
+                   ? rlpCoderArenaAlloc (coder, item->itemsCount * sizeof (BRRlpItem))
+                   : (item->itemsCount > ITEM_DEFAULT_ITEMS_COUNT
+                      ? calloc (item->itemsCount, sizeof (BRRlpItem))
+                      : item->itemsArray));
     for (int i = 0; i < itemsCount; i++)
         item->items[i] = items[i];
     return item;
@@ -585,6 +857,7 @@ coderEncodeUInt64 (BRRlpCoder coder, uint64_t value) {
 static uint64_t
 coderDecodeUInt64 (BRRlpCoder coder, BRRlpItem context) {
     assert (itemIsValid(coder, context));
+    itemEnsureEncoded (coder, context);
     uint64_t value = 0;
     coderDecodeNumber (coder, (uint8_t*)&value, sizeof(uint64_t), context->bytes, context->bytesCount);
     return value;
@@ -601,6 +874,7 @@ coderEncodeUInt256 (BRRlpCoder coder, UInt256 value) {
 static UInt256
 coderDecodeUInt256 (BRRlpCoder coder, BRRlpItem context) {
     assert (itemIsValid(coder, context));
+    itemEnsureEncoded (coder, context);
     UInt256 value = UINT256_ZERO;
     coderDecodeNumber (coder, (uint8_t*)&value, sizeof (UInt256), context->bytes, context->bytesCount);
     return value;
@@ -630,21 +904,64 @@ coderEncodeList (BRRlpCoder coder, BRRlpItem *items, size_t itemsCount) {
     uint8_t bytes9Count, bytes9[9];
     encodeLengthIntoBytes (bytesCount, RLP_PREFIX_LIST, bytes9, &bytes9Count);
 
-    // ... now allocate the memory needed as length-encoding-prefix + bytes
-    uint8_t *bytes = itemEnsureBytes (coder, item, bytes9Count + bytesCount);
+    // ... but defer writing the bytes.  They are written once, directly from `items`, when
+    // needed - typically by rlpGetDataInto() for the outermost list of a message.
+    itemFillList(coder, item, items, itemsCount);
+    item->bytesCount = bytes9Count + bytesCount;
+    item->deferred = 1;
+    return item;
+}
 
-    // ... now fill in the length encoding
-    memcpy (bytes, bytes9, bytes9Count);
+/**
+ * Return the number of bytes in the list payload of `item` - the concatenated encodings of its
+ * component items.
+ */
+static size_t
+itemListPayloadCount (BRRlpItem item) {
+    size_t payloadCount = 0;
+    for (size_t index = 0; index < item->itemsCount; index++)
+        payloadCount += item->items[index]->bytesCount;
+    return payloadCount;
+}
+
+static void
+itemWriteBytes (BRRlpItem item, uint8_t *bytes);
 
-    // ... and concatenate the bytes from items
-    for (size_t bytesIndex = bytes9Count, i = 0; i < itemsCount; i++) {
-        BRRlpItem itemContext = items[i];
-        memcpy (&bytes[bytesIndex], itemContext->bytes, itemContext->bytesCount);
-        bytesIndex += itemContext->bytesCount;
+static void
+itemWriteListPayload (BRRlpItem item, uint8_t *bytes) {
+    for (size_t index = 0; index < item->itemsCount; index++) {
+        itemWriteBytes (item->items[index], bytes);
+        bytes += item->items[index]->bytesCount;
     }
+}
 
-    itemFillList(coder, item, items, itemsCount);
-    return item;
+/**
+ * Write the encoding of `item` into `bytes`, which must hold `item->bytesCount`.  A deferred
+ * list is written directly from its component items.
+ */
+static void
+itemWriteBytes (BRRlpItem item, uint8_t *bytes) {
+    if (!item->deferred) {
+        memcpy (bytes, item->bytes, item->bytesCount);
+        return;
+    }
+
+    uint8_t bytes9Count, bytes9[9];
+    encodeLengthIntoBytes (itemListPayloadCount (item), RLP_PREFIX_LIST, bytes9, &bytes9Count);
+    memcpy (bytes, bytes9, bytes9Count);
+    itemWriteListPayload (item, &bytes[bytes9Count]);
+}
+
+/**
+ * If `item` has deferred bytes, then allocate and write them now.
+ */
+static void
+itemEnsureEncoded (BRRlpCoder coder, BRRlpItem item) {
+    if (!item->deferred) return;
+
+    size_t bytesCount = item->bytesCount;
+    itemWriteBytes (item, itemEnsureBytes (coder, item, bytesCount));
+    item->deferred = 0;
 }
 
 //
@@ -704,6 +1021,7 @@ rlpEncodeBytesPurgeLeadingZeros (BRRlpCoder coder, uint8_t *bytes, size_t bytesC
 extern BRRlpData
 rlpDecodeBytes (BRRlpCoder coder, BRRlpItem item) {
     assert (itemIsValid(coder, item));
+    itemEnsureEncoded (coder, item);
 
     uint8_t offset = 0;
     size_t length = decodeLength(item->bytes, RLP_PREFIX_BYTES, &offset);
@@ -719,6 +1037,7 @@ rlpDecodeBytes (BRRlpCoder coder, BRRlpItem item) {
 static BRRlpData
 rlpDecodeBytesSharedDontReleaseBaseline (BRRlpCoder coder, BRRlpItem item, uint8_t baseline) {
     assert (itemIsValid (coder, item));
+    itemEnsureEncoded (coder, item);
 
     uint8_t offset = 0;
     size_t length = decodeLength(item->bytes, baseline, &offset);
@@ -753,6 +1072,7 @@ rlpEncodeString (BRRlpCoder coder, char *string) {
 extern char *
 rlpDecodeString (BRRlpCoder coder, BRRlpItem item) {
     assert (itemIsValid(coder, item));
+    itemEnsureEncoded (coder, item);
 
     uint8_t offset = 0;
     size_t length = decodeLength(item->bytes, RLP_PREFIX_BYTES, &offset);
@@ -785,7 +1105,7 @@ rlpDecodeStringEmptyCheck (BRRlpCoder coder, BRRlpItem item) {
 // Hex String
 //
 extern BRRlpItem
-rlpEncodeHexString (BRRlpCoder coder, char *string) {
+rlpEncodeHexString (BRRlpCoder coder, const char *string) {
     if (NULL == string || string[0] == '\0')
         return rlpEncodeString(coder, "");
     
@@ -800,7 +1120,7 @@ rlpEncodeHexString (BRRlpCoder coder, char *string) {
     // (under 16k) then avoid some memory allocation by using the stack.
 
     if (0 == stringLen)
-        return rlpEncodeString(coder, string);
+        return rlpEncodeString(coder, "");
     else if (stringLen < (16 * 1024)) {
         size_t bytesCount = stringLen / 2;
         uint8_t bytes[bytesCount];
@@ -876,6 +1196,7 @@ rlpEncodeListItems (BRRlpCoder coder, BRRlpItem *items, size_t itemsCount) {
 extern const BRRlpItem *
 rlpDecodeList (BRRlpCoder coder, BRRlpItem item, size_t *itemsCount) {
     assert (itemIsValid(coder, item));
+    itemEnsureList (coder, item);
 
     switch (item->type) {
         case CODER_ITEM:
@@ -887,6 +1208,73 @@ rlpDecodeList (BRRlpCoder coder, BRRlpItem item, size_t *itemsCount) {
     }
 }
 
+typedef struct {
+    const BRRlpData *datas;
+    size_t start, end;
+    void *context;
+    BRRlpDecodeRoutine routine;
+} BRRlpDecodeShare;
+
+static void
+rlpDecodeShareRoutine (void *info) {
+    BRRlpDecodeShare *share = info;
+    BRRlpCoder coder = rlpCoderCreateArena();
+
+    for (size_t index = share->start; index < share->end; index++) {
+        BRRlpItem item = rlpGetItemLazy (coder, share->datas[index]);
+        share->routine (share->context, coder, item, index);
+        rlpReleaseItem (coder, item);
+    }
+
+    rlpCoderRelease (coder);
+}
+
+extern void
+rlpDecodeListParallel (BRRlpCoder coder,
+                       const BRRlpItem *items,
+                       size_t itemsCount,
+                       size_t parallelMinimum,
+                       void *context,
+                       BRRlpDecodeRoutine routine) {
+    BRThreadPool *threads = (itemsCount >= parallelMinimum && itemsCount > 1
+                             ? BRThreadPoolShared()
+                             : NULL);
+
+    size_t sharesCount = (NULL == threads ? 1 : 1 + BRThreadPoolThreadCount (threads));
+    if (sharesCount > itemsCount) sharesCount = itemsCount;
+
+    if (sharesCount <= 1) {
+        for (size_t index = 0; index < itemsCount; index++)
+            routine (context, coder, items[index], index);
+        return;
+    }
+
+    // Find the bytes of every item, while `coder` is ours; workers only read them.
+    BRRlpData *datas = calloc (itemsCount, sizeof (BRRlpData));
+    for (size_t index = 0; index < itemsCount; index++)
+        datas[index] = rlpGetDataSharedDontRelease (coder, items[index]);
+
+    BRTaskGroup *group = BRTaskGroupNew (threads);
+    BRRlpDecodeShare shares[sharesCount];
+
+    for (size_t index = 0; index < sharesCount; index++) {
+        shares[index] = (BRRlpDecodeShare) {
+            datas,
+            itemsCount * index / sharesCount,
+            itemsCount * (index + 1) / sharesCount,
+            context,
+            routine
+        };
+        if (index > 0) BRTaskGroupAdd (group, &shares[index], rlpDecodeShareRoutine);
+    }
+
+    // Take the first share ourself, and help with the others while waiting.
+    rlpDecodeShareRoutine (&shares[0]);
+    BRTaskGroupFree (group);
+
+    free (datas);
+}
+
 //
 // RLP Data
 //
@@ -915,7 +1303,7 @@ rlpDataExtract (BRRlpCoder coder, BRRlpItem item, uint8_t **bytes, size_t *bytes
     
     *bytesCount = item->bytesCount;
     *bytes = malloc (*bytesCount);
-    memcpy (*bytes, item->bytes, item->bytesCount);
+    rlpGetDataInto (coder, item, *bytes, *bytesCount);
 }
 
 extern BRRlpData
@@ -928,10 +1316,38 @@ rlpGetData (BRRlpCoder coder, BRRlpItem item) {
 extern BRRlpData
 rlpGetDataSharedDontRelease (BRRlpCoder coder, BRRlpItem item) {
     assert (itemIsValid(coder, item));
+    itemEnsureEncoded (coder, item);
     BRRlpData result = { item->bytesCount, item->bytes };
     return result;
 }
 
+extern size_t
+rlpGetDataInto (BRRlpCoder coder, BRRlpItem item, uint8_t *bytes, size_t bytesCount) {
+    assert (itemIsValid(coder, item));
+    if (NULL != bytes && bytesCount >= item->bytesCount)
+        itemWriteBytes (item, bytes);
+    return item->bytesCount;
+}
+
+extern size_t
+rlpDecodeListInto (BRRlpCoder coder, BRRlpItem item, uint8_t *bytes, size_t bytesCount) {
+    assert (itemIsValid(coder, item));
+    assert (CODER_LIST == item->type);
+
+    // An encoded list is copied from its bytes; otherwise it's written from its component items.
+    if (!item->deferred) {
+        BRRlpData data = rlpDecodeListSharedDontRelease (coder, item);
+        if (NULL != bytes && bytesCount >= data.bytesCount)
+            memcpy (bytes, data.bytes, data.bytesCount);
+        return data.bytesCount;
+    }
+
+    size_t payloadCount = itemListPayloadCount (item);
+    if (NULL != bytes && bytesCount >= payloadCount)
+        itemWriteListPayload (item, bytes);
+    return payloadCount;
+}
+
 /**
  * Return `data` with `bytes` and bytesCount derived from the bytes[0] and associated length.
  */
@@ -954,17 +1370,87 @@ rlpGetItem_FillData (BRRlpCoder coder, uint8_t *bytes) {
 
 #define DEFAULT_ITEM_INCREMENT 20
 
+static BRRlpItem
+rlpGetItemInternal (BRRlpCoder coder, BRRlpData data, int lazy);
+
 /**
- * Convet the bytes in `data` into an `item`.  If `data` represents a RLP list, then `item` will
- * represent a list.
+ * Fill the list `item` with sub-items decoded from its bytes.  If `lazy`, then the sub-items
+ * reference the bytes in place and any sub-lists are themselves only decoded on demand.
  */
-extern BRRlpItem
-rlpGetItem (BRRlpCoder coder, BRRlpData data) {
+static void
+itemFillListFromBytes (BRRlpCoder coder, BRRlpItem item, int lazy) {
+    // We can have an arbitrary number of sub-times.  Assume we have DEFAULT_ITEM_INCREMENT
+    // but be willing to increase the number if needed.
+    BRRlpItem itemsArray[DEFAULT_ITEM_INCREMENT];
+    size_t itemsIndex = 0;
+    size_t itemsCount = DEFAULT_ITEM_INCREMENT;
+
+    // We'll use this to accumulate subitems.
+    BRRlpItem *items = itemsArray;
+
+    // The upper limit on bytes to consume.
+    uint8_t *bytesLimit = item->bytes + item->bytesCount;
+    uint8_t *bytes = item->bytes;
+
+    // Start of `data` encodes a list with a number of bytes.  We'll start extracting
+    // sub-items after the list's length.
+    uint8_t bytesOffset = 0;
+    size_t bytesCount = decodeLength(item->bytes, RLP_PREFIX_LIST, &bytesOffset);
+    assert (item->bytesCount == bytesCount + bytesOffset);
+
+    // Start of the first sub-item
+    bytes += bytesOffset;
+
+    while (bytes < bytesLimit) {
+        // Get the `data` for this sub-item and then recurse
+        BRRlpData d = rlpGetItem_FillData(coder, bytes);
+        items[itemsIndex++] = rlpGetItemInternal (coder, d, lazy);
+
+        // Move to the next sub-item
+        bytes += d.bytesCount;
+
+        // Extend `items` is we've used the allocated number.
+        if (itemsIndex == itemsCount) {
+            itemsCount += DEFAULT_ITEM_INCREMENT;
+            if (items == itemsArray) {
+                // Move 'off' the stack allocated array.
+                items = malloc(itemsCount * sizeof(BRRlpItem));
+                memcpy (items, itemsArray, itemsIndex * sizeof(BRRlpItem));
+            }
+            else
+                items = realloc(items, itemsCount * sizeof (BRRlpItem));
+        }
+    }
+    itemFillList(coder, item, items, itemsIndex);
+    item->pending = 0;
+
+    if (items != itemsArray) free(items);
+}
+
+/**
+ * If `item` is a lazily decoded list, then decode its component items now.
+ */
+static void
+itemEnsureList (BRRlpCoder coder, BRRlpItem item) {
+    if (item->pending) itemFillListFromBytes (coder, item, 1);
+}
+
+static BRRlpItem
+rlpGetItemInternal (BRRlpCoder coder, BRRlpData data, int lazy) {
     assert (0 != data.bytesCount);
 
     BRRlpItem result = rlpCoderAcquireItem (coder);
-    uint8_t *encodedBytes = itemEnsureBytes (coder, result, data.bytesCount);
-    memcpy (encodedBytes, data.bytes, data.bytesCount);
+
+    // A lazy item is a view of `data`; an eager item holds a copy.
+    if (lazy) {
+        result->shared = 1;
+        result->bytesCount = data.bytesCount;
+        result->bytes = data.bytes;
+    }
+    else {
+        uint8_t *encodedBytes = itemEnsureBytes (coder, result, data.bytesCount);
+        memcpy (encodedBytes, data.bytes, data.bytesCount);
+    }
 
     uint8_t prefix = data.bytes[0];
 
@@ -973,55 +1459,63 @@ rlpGetItem (BRRlpCoder coder, BRRlpData data) {
         return result;
     }
 
-    // If a list, then we'll consume `data` with sub-items.
-    else {
-        // We can have an arbitrary number of sub-times.  Assume we have DEFAULT_ITEM_INCREMENT
-        // but be willing to increase the number if needed.
-        BRRlpItem itemsArray[DEFAULT_ITEM_INCREMENT];
-        size_t itemsIndex = 0;
-        size_t itemsCount = DEFAULT_ITEM_INCREMENT;
-
-        // We'll use this to accumulate subitems.
-        BRRlpItem *items = itemsArray;
-
-        // The upper limit on bytes to consume.
-        uint8_t *bytesLimit = data.bytes + data.bytesCount;
-        uint8_t *bytes = data.bytes;
-
-        // Start of `data` encodes a list with a number of bytes.  We'll start extracting
-        // sub-items after the list's length.
-        uint8_t bytesOffset = 0;
-        size_t bytesCount = decodeLength(data.bytes, RLP_PREFIX_LIST, &bytesOffset);
-        assert (data.bytesCount == bytesCount + bytesOffset);
-
-        // Start of the first sub-item
-        bytes += bytesOffset;
-        
-        while (bytes < bytesLimit) {
-            // Get the `data` for this sub-item and then recurse
-            BRRlpData d = rlpGetItem_FillData(coder, bytes);
-            items[itemsIndex++] = rlpGetItem (coder, d);
-
-            // Move to the next sub-item
-            bytes += d.bytesCount;
-
-            // Extend `items` is we've used the allocated number.
-            if (itemsIndex == itemsCount) {
-                itemsCount += DEFAULT_ITEM_INCREMENT;
-                if (items == itemsArray) {
-                    // Move 'off' the stack allocated array.
-                    items = malloc(itemsCount * sizeof(BRRlpItem));
-                    memcpy (items, itemsArray, itemsIndex * sizeof(BRRlpItem));
-                }
-                else
-                    items = realloc(items, itemsCount * sizeof (BRRlpItem));
-            }
+    // If a list, then we'll consume `data` with sub-items - now or on demand if `lazy`
+    else if (lazy) {
+        result->type = CODER_LIST;
+        result->pending = 1;
+    }
+    else itemFillListFromBytes (coder, result, 0);
+
+    return result;
+}
+
+/**
+ * Convet the bytes in `data` into an `item`.  If `data` represents a RLP list, then `item` will
+ * represent a list.
+ */
+extern BRRlpItem
+rlpGetItem (BRRlpCoder coder, BRRlpData data) {
+    return rlpGetItemInternal (coder, data, 0);
+}
+
+extern BRRlpItem
+rlpGetItemLazy (BRRlpCoder coder, BRRlpData data) {
+    return rlpGetItemInternal (coder, data, 1);
+}
+
+extern size_t
+rlpDecodeListStream (BRRlpCoder coder,
+                     BRRlpItem item,
+                     void *context,
+                     BRRlpDecodeRoutine routine) {
+    assert (itemIsValid(coder, item));
+    if (CODER_LIST != item->type) return 0;
+
+    // Walk the list's bytes directly; `item` never gets its component items.
+    BRRlpData data = rlpGetDataSharedDontRelease (coder, item);
+    uint8_t *bytesLimit = data.bytes + data.bytesCount;
+
+    uint8_t bytesOffset = 0;
+    decodeLength (data.bytes, RLP_PREFIX_LIST, &bytesOffset);
+    uint8_t *bytes = data.bytes + bytesOffset;
+
+    size_t index = 0;
+    while (bytes < bytesLimit) {
+        BRRlpData elementData = rlpGetItem_FillData (coder, bytes);
+        if (elementData.bytesCount > (size_t) (bytesLimit - bytes)) {
+            rlpCoderSetFailed (coder);
+            break;
         }
-        itemFillList(coder, result, items, itemsIndex);
 
-        if (items != itemsArray) free(items);
+        // Each element, and whatever `routine` decodes from it, is released before the next.
+        BRRlpItem element = rlpGetItemLazy (coder, elementData);
+        routine (context, coder, element, index++);
+        rlpReleaseItem (coder, element);
+
+        bytes += elementData.bytesCount;
     }
-    return result;
+
+    return index;
 }
 
 //
@@ -1038,6 +1532,7 @@ rlpShowItemInternal (BRRlpCoder coder, BRRlpItem context, const char *topic, int
 
     switch (context->type) {
         case CODER_LIST:
+            itemEnsureList (coder, context);
             if (0 == context->itemsCount)
                 eth_log(topic, "%sL  0: []", spaces);
             else {
@@ -1083,10 +1578,11 @@ rlpShowItem (BRRlpCoder coder, BRRlpItem item, const char *topic) {
 
 extern void
 rlpShow (BRRlpData data, const char *topic) {
-    BRRlpCoder coder = rlpCoderCreate();
+    BRRlpCoder coder = rlpCoderCreateCached();
     BRRlpItem item = rlpGetItem(coder, data);
     rlpShowItem (coder, item, topic);
     rlpReleaseItem(coder, item);
+    rlpCoderReleaseCached (coder);
 }
 
 /*
@@ -27,16 +27,57 @@ typedef struct BRRlpCoderRecord *BRRlpCoder;
 extern BRRlpCoder
 rlpCoderCreate (void);
 
+/**
+ * Create an 'arena' coder.  Items are bump-allocated from large arena blocks, with exactly sized
+ * storage for their bytes and sub-items, rather than taken from per-item free lists.  Releasing an
+ * item only counts it; once every item is released the arena is reset for reuse, and
+ * rlpCoderReclaim() frees the arena blocks.  An arena coder takes no lock and thus must only be
+ * used from a single thread.
+ */
+extern BRRlpCoder
+rlpCoderCreateArena (void);
+
 extern void
 rlpCoderRelease (BRRlpCoder coder);
 
+/**
+ * Return a coder for short-lived use on the calling thread - taken from the thread's cache of
+ * coders, or created.  Release it, on the same thread and once all its items are released, with
+ * rlpCoderReleaseCached().  This avoids creating and releasing a coder, and its items, for each
+ * encoding or decoding.
+ */
+extern BRRlpCoder
+rlpCoderCreateCached (void);
+
+/**
+ * Return `coder`, from rlpCoderCreateCached(), to the calling thread's cache, trimming the
+ * released items it keeps for reuse; if the cache is full `coder` is released.  Cached coders are
+ * released when their thread exits.
+ */
+extern void
+rlpCoderReleaseCached (BRRlpCoder coder);
+
 /**
  * Reclaim coder memory. A coder can hold memory to avoid repeated free/malloc calls.  If
- * desired one can reclaim coder memory that is unused.
+ * desired one can reclaim coder memory that is unused.  In any case, a coder holds no more than
+ * a bounded number of released items.
  */
 extern void
 rlpCoderReclaim (BRRlpCoder coder);
 
+/**
+ * Return the number of items acquired from `coder` and not yet released.
+ */
+extern int
+rlpCoderBusyCount (BRRlpCoder coder);
+
+/**
+ * Return the bytes held by `coder`: the coder itself, its free and busy items, including any
+ * item storage beyond the default arrays, or, for an arena coder, its arena blocks.
+ */
+extern size_t
+rlpCoderGetMemoryUsage (BRRlpCoder coder);
+
 extern void
 rlpCoderSetFailed (BRRlpCoder coder);
 
@@ -75,6 +116,15 @@ rlpReleaseItem (BRRlpCoder coder, BRRlpItem item);
 extern BRRlpItem
 rlpGetItem (BRRlpCoder coder, BRRlpData data);
 
+/**
+ * Convert the bytes in `data` into an `item`, as rlpGetItem(), but without copying and without
+ * walking `data`.  The item, and any subitems, reference `data` in place; a list's subitems are
+ * only identified once rlpDecodeList() is called on it.  Thus `data` must remain valid, and
+ * unmodified, until `item` is released.
+ */
+extern BRRlpItem
+rlpGetItemLazy (BRRlpCoder coder, BRRlpData data);
+
 /**
  * Return the RLP data associated with `item`.  You own this data and must call
  * rlpDataRelese().
@@ -90,6 +140,14 @@ rlpGetData (BRRlpCoder coder, BRRlpItem item);
 extern BRRlpData
 rlpGetDataSharedDontRelease (BRRlpCoder coder, BRRlpItem item);
 
+/**
+ * Write the RLP data associated with `item` into `bytes`, if `bytesCount` is large enough, and
+ * return the size of the RLP data.  Lists are encoded lazily; this writes a list directly from
+ * its subitems, without copies at each level.  Call with `bytes` as NULL to get the size.
+ */
+extern size_t
+rlpGetDataInto (BRRlpCoder coder, BRRlpItem item, uint8_t *bytes, size_t bytesCount);
+
 /**
  * Extract the `bytes` and `bytesCount` for `item`.  The returns `bytes` will be the complete
  * RLP encoding for `item` which includes the RLP encoding of length.  Contrast this with
@@ -143,6 +201,13 @@ rlpDecodeBytesSharedDontRelease (BRRlpCoder coder, BRRlpItem item);
 extern BRRlpData
 rlpDecodeListSharedDontRelease (BRRlpCoder coder, BRRlpItem item);
 
+/**
+ * As rlpGetDataInto() but for the list payload of `item` - the RLP data w/o the RLP length
+ * prefix.  The `item` must be a list.
+ */
+extern size_t
+rlpDecodeListInto (BRRlpCoder coder, BRRlpItem item, uint8_t *bytes, size_t bytesCount);
+
 //
 // String
 //
@@ -159,7 +224,7 @@ rlpDecodeStringCheck (BRRlpCoder coder, BRRlpItem item);
 // Hex String
 //
 extern BRRlpItem
-rlpEncodeHexString (BRRlpCoder coder, char *string);
+rlpEncodeHexString (BRRlpCoder coder, const char *string);
 
 extern char *
 rlpDecodeHexString (BRRlpCoder coder, BRRlpItem item, const char *prefix);
@@ -181,6 +246,40 @@ rlpEncodeListItems (BRRlpCoder coder, BRRlpItem *items, size_t itemsCount);
 
 extern const BRRlpItem *
 rlpDecodeList (BRRlpCoder coder, BRRlpItem item, size_t *itemsCount);
+
+/**
+ * A DecodeRoutine decodes `item`, at `index` in a list, using `coder`.
+ */
+typedef void
+(*BRRlpDecodeRoutine) (void *context, BRRlpCoder coder, BRRlpItem item, size_t index);
+
+/**
+ * Decode each of `items`, from `coder`, with `routine`.  With at least `parallelMinimum` items,
+ * decode in parallel on the shared thread pool: the items' bytes are found first and then each
+ * worker, with its own arena coder, gets items in place (see rlpGetItemLazy()) and decodes them.
+ * Thus `routine` must be thread-safe and must not hold onto its `coder` or `item` (nor their
+ * bytes).  Otherwise, decode in sequence with `coder`.  Returns once every item is decoded.
+ */
+extern void
+rlpDecodeListParallel (BRRlpCoder coder,
+                       const BRRlpItem *items,
+                       size_t itemsCount,
+                       size_t parallelMinimum,
+                       void *context,
+                       BRRlpDecodeRoutine routine);
+
+/**
+ * Decode each element of the list `item`, one by one, with `routine` and return the number of
+ * elements.  Unlike rlpDecodeList() no items are built for the list; each element is got in place
+ * (see rlpGetItemLazy()) from the list's bytes, passed to `routine` and then released, along with
+ * anything decoded from it - thus memory is bounded by the largest element, not by the list.  The
+ * `routine` must not hold onto the element.  On a malformed list the coder is marked failed.
+ */
+extern size_t
+rlpDecodeListStream (BRRlpCoder coder,
+                     BRRlpItem item,
+                     void *context,
+                     BRRlpDecodeRoutine routine);
     
 //
 // Show
@@ -173,8 +173,236 @@ void runRlpDecodeTest () {
     rlpCoderRelease(coder);
 }
 
+void runRlpArenaTest () {
+    printf ("         Arena\n");
+    BRRlpCoder coder = rlpCoderCreateArena();
+
+    // Encode and decode a list of strings; larger than both the item defaults and an arena block
+    size_t count = 100;
+    BRRlpItem items[count];
+    char string[2048];
+    memset (string, 'a', sizeof (string) - 1);
+    string[sizeof (string) - 1] = '\0';
+
+    for (int round = 0; round < 3; round++) {
+        for (size_t index = 0; index < count; index++)
+            items[index] = rlpEncodeString (coder, string);
+        BRRlpItem list = rlpEncodeListItems (coder, items, count);
+        assert (count + 1 == rlpCoderBusyCount (coder));
+
+        BRRlpData data = rlpGetData (coder, list);
+        rlpReleaseItem (coder, list);
+        assert (0 == rlpCoderBusyCount (coder));
+
+        BRRlpItem item = rlpGetItem (coder, data);
+        size_t itemsCount;
+        const BRRlpItem *decoded = rlpDecodeList (coder, item, &itemsCount);
+        assert (count == itemsCount);
+
+        char *decodedString = rlpDecodeString (coder, decoded[count - 1]);
+        assert (0 == strcmp (decodedString, string));
+        free (decodedString);
+
+        rlpReleaseItem (coder, item);
+        rlpDataRelease (data);
+        assert (0 == rlpCoderBusyCount (coder));
+    }
+
+    rlpCoderReclaim (coder);
+    rlpCoderRelease (coder);
+}
+
+void runRlpCachedTest () {
+    printf ("         Cached\n");
+    BRRlpCoder coder = rlpCoderCreateCached();
+
+    // Encode a list with many more items than a coder keeps once they are released.
+    size_t count = 2000;
+    BRRlpItem items[count];
+    for (size_t index = 0; index < count; index++)
+        items[index] = rlpEncodeUInt64 (coder, index, 0);
+    BRRlpItem list = rlpEncodeListItems (coder, items, count);
+    assert (count * 1024 < rlpCoderGetMemoryUsage (coder));
+
+    rlpReleaseItem (coder, list);
+    assert (0 == rlpCoderBusyCount (coder));
+    assert (count * 1024 / 4 > rlpCoderGetMemoryUsage (coder));
+
+    // The thread's cache returns the same coder, again.
+    rlpCoderReleaseCached (coder);
+    assert (coder == rlpCoderCreateCached());
+    rlpCoderReleaseCached (coder);
+}
+
+void runRlpLazyTest () {
+    printf ("         Lazy\n");
+    BRRlpCoder coder = rlpCoderCreate();
+
+    // [["cat", "dog"], "Lorem...", 1024]
+    BRRlpItem encoded = rlpEncodeList (coder, 3,
+                                       rlpEncodeList2 (coder,
+                                                       rlpEncodeString (coder, "cat"),
+                                                       rlpEncodeString (coder, "dog")),
+                                       rlpEncodeString (coder, RLP_S3),
+                                       rlpEncodeUInt64 (coder, 1024, 0));
+    BRRlpData data = rlpGetData (coder, encoded);
+    rlpReleaseItem (coder, encoded);
+
+    // Only the top-level item exists until it is decoded as a list
+    BRRlpItem item = rlpGetItemLazy (coder, data);
+    assert (1 == rlpCoderBusyCount (coder));
+
+    size_t c;
+    const BRRlpItem *items = rlpDecodeList (coder, item, &c);
+    assert (3 == c);
+    assert (4 == rlpCoderBusyCount (coder));
+
+    char *s3Lorem = rlpDecodeString (coder, items[1]);
+    assert (0 == strcmp (s3Lorem, RLP_S3));
+    free (s3Lorem);
+    assert (1024 == rlpDecodeUInt64 (coder, items[2], 0));
+
+    const BRRlpItem *l1is = rlpDecodeList (coder, items[0], &c);
+    assert (2 == c);
+    char *liDog = rlpDecodeString (coder, l1is[1]);
+    assert (0 == strcmp (liDog, "dog"));
+    free (liDog);
+
+    // The lazy item's encoding is the original data, in place.
+    BRRlpData shared = rlpGetDataSharedDontRelease (coder, item);
+    assert (shared.bytes == data.bytes && shared.bytesCount == data.bytesCount);
+
+    rlpReleaseItem (coder, item);
+    assert (0 == rlpCoderBusyCount (coder));
+
+    rlpDataRelease (data);
+    rlpCoderRelease (coder);
+}
+
+void runRlpEncodeIntoTest () {
+    printf ("         Encode Into\n");
+    BRRlpCoder coder = rlpCoderCreate();
+
+    // [["cat", "dog"], ["cat", "dog"]]
+    uint8_t l1b[] = RLP_L1_RES;
+    BRRlpItem item = rlpEncodeList2 (coder,
+                                     rlpEncodeList2 (coder,
+                                                     rlpEncodeString (coder, "cat"),
+                                                     rlpEncodeString (coder, "dog")),
+                                     rlpGetItem (coder, (BRRlpData) { sizeof (l1b), l1b }));
+
+    uint8_t bytes[32];
+    assert (19 == rlpGetDataInto (coder, item, NULL, 0));
+    assert (19 == rlpGetDataInto (coder, item, bytes, sizeof (bytes)));
+    assert (0xd2 == bytes[0]);
+    assert (0 == memcmp (&bytes[1], l1b, sizeof (l1b)) && 0 == memcmp (&bytes[10], l1b, sizeof (l1b)));
+
+    assert (18 == rlpDecodeListInto (coder, item, bytes, sizeof (bytes)));
+    assert (0 == memcmp (&bytes[0], l1b, sizeof (l1b)) && 0 == memcmp (&bytes[9], l1b, sizeof (l1b)));
+
+    // Same as the bytes once held by item
+    BRRlpData data = rlpGetDataSharedDontRelease (coder, item);
+    assert (19 == data.bytesCount && 0xd2 == data.bytes[0]);
+    assert (0 == memcmp (&data.bytes[1], l1b, sizeof (l1b)));
+
+    rlpReleaseItem (coder, item);
+    rlpCoderRelease (coder);
+}
+
+static void
+rlpDecodeParallelRoutine (uint64_t *values, BRRlpCoder coder, BRRlpItem item, size_t index) {
+    values[index] = rlpDecodeUInt64 (coder, item, 0);
+}
+
+void runRlpDecodeParallelTest () {
+    printf ("         Decode Parallel\n");
+    BRRlpCoder coder = rlpCoderCreate();
+
+    size_t count = 1000;
+    BRRlpItem items[count];
+    for (size_t index = 0; index < count; index++)
+        items[index] = rlpEncodeUInt64 (coder, 1000 * index, 0);
+    BRRlpItem list = rlpEncodeListItems (coder, items, count);
+
+    size_t itemsCount;
+    const BRRlpItem *listItems = rlpDecodeList (coder, list, &itemsCount);
+    assert (count == itemsCount);
+
+    uint64_t values[count];
+    for (size_t parallelMinimum = 1; parallelMinimum <= 2 * count; parallelMinimum *= 2) {
+        memset (values, 0, sizeof (values));
+        rlpDecodeListParallel (coder, listItems, itemsCount, parallelMinimum,
+                               values, (BRRlpDecodeRoutine) rlpDecodeParallelRoutine);
+        for (size_t index = 0; index < count; index++)
+            assert (1000 * index == values[index]);
+    }
+
+    rlpReleaseItem (coder, list);
+    rlpCoderRelease (coder);
+}
+
+typedef struct {
+    BRRlpCoder coder;
+    int busyCount;
+    uint64_t sum;
+} RlpStreamTestContext;
+
+static void
+rlpDecodeStreamRoutine (RlpStreamTestContext *context, BRRlpCoder coder, BRRlpItem item, size_t index) {
+    size_t itemsCount;
+    const BRRlpItem *items = rlpDecodeList (coder, item, &itemsCount);
+    assert (2 == itemsCount);
+    assert (index == rlpDecodeUInt64 (coder, items[0], 0));
+    context->sum += rlpDecodeUInt64 (coder, items[1], 0);
+
+    // Only the list, which is never decoded, and this element are held.
+    assert (rlpCoderBusyCount (coder) <= context->busyCount + 3);
+}
+
+void runRlpDecodeStreamTest () {
+    printf ("         Decode Stream\n");
+    BRRlpCoder coder = rlpCoderCreate();
+
+    size_t count = 1000;
+    BRRlpItem items[count];
+    for (size_t index = 0; index < count; index++)
+        items[index] = rlpEncodeList2 (coder,
+                                       rlpEncodeUInt64 (coder, index, 0),
+                                       rlpEncodeUInt64 (coder, 2 * index, 0));
+    BRRlpItem list = rlpEncodeListItems (coder, items, count);
+    BRRlpData data = rlpGetData (coder, list);
+    rlpReleaseItem (coder, list);
+
+    list = rlpGetItemLazy (coder, data);
+    RlpStreamTestContext context = { coder, rlpCoderBusyCount (coder), 0 };
+    assert (count == rlpDecodeListStream (coder, list, &context, (BRRlpDecodeRoutine) rlpDecodeStreamRoutine));
+    assert (count * (count - 1) == context.sum);
+    assert (!rlpCoderHasFailed (coder));
+
+    // Truncated: the last element, [999, 1998] as 7 bytes, claims 9 bytes past its prefix.
+    assert (0xc6 == data.bytes[data.bytesCount - 7]);
+    data.bytes[data.bytesCount - 7] = 0xc9;
+    BRRlpItem truncated = rlpGetItemLazy (coder, data);
+    context.busyCount = rlpCoderBusyCount (coder);
+    context.sum = 0;
+    assert (count - 1 == rlpDecodeListStream (coder, truncated, &context, (BRRlpDecodeRoutine) rlpDecodeStreamRoutine));
+    assert (rlpCoderHasFailed (coder));
+    rlpCoderClrFailed (coder);
+
+    rlpReleaseItem (coder, truncated);
+    rlpReleaseItem (coder, list);
+    rlpDataRelease (data);
+    rlpCoderRelease (coder);
+}
+
 void runRlpTests (void) {
     printf ("==== RLP\n");
     runRlpEncodeTest ();
     runRlpDecodeTest ();
+    runRlpArenaTest ();
+    runRlpCachedTest ();
+    runRlpLazyTest ();
+    runRlpEncodeIntoTest ();
+    runRlpDecodeParallelTest ();
+    runRlpDecodeStreamTest ();
 }
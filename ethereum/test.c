@@ -84,6 +84,40 @@ void runAddressTests (BREthereumAccount account) {
     accountSetAddressNonce(account, address, 2, ETHEREUM_BOOLEAN_FALSE);
     assert (2 == accountGetAddressNonce(account, address));
 
+    // Released nonces are reassigned, lowest first; releasing the last backs up the nonce.
+    assert (2 == accountGetThenIncrementAddressNonce(account, address));
+    assert (3 == accountGetThenIncrementAddressNonce(account, address));
+    assert (4 == accountGetThenIncrementAddressNonce(account, address));
+    accountReleaseAddressNonce(account, address, 3);
+    accountReleaseAddressNonce(account, address, 2);
+    assert (5 == accountGetAddressNonce(account, address));
+    assert (2 == accountGetThenIncrementAddressNonce(account, address));
+    accountReleaseAddressNonce(account, address, 4);
+    assert (3 == accountGetAddressNonce(account, address));
+    accountReleaseAddressNonce(account, address, 2);
+    assert (2 == accountGetAddressNonce(account, address));
+
+    // An observed nonce above a released nonce means it is no longer a gap.
+    assert (2 == accountGetThenIncrementAddressNonce(account, address));
+    assert (3 == accountGetThenIncrementAddressNonce(account, address));
+    accountReleaseAddressNonce(account, address, 2);
+    accountSetAddressNonce(account, address, 3, ETHEREUM_BOOLEAN_FALSE);
+    assert (4 == accountGetAddressNonce(account, address));
+    assert (4 == accountGetThenIncrementAddressNonce(account, address));
+
+    // Derived addresses; index 0 is the primary address.
+    assert (ETHEREUM_BOOLEAN_IS_TRUE (addressEqual (address, accountGetAddressAtIndex (account, 0))));
+
+    const char *addressString1 = accountGetAddressStringAtIndex (account, 1);
+    assert (NULL != addressString1 && 0 == strcmp ("0x9595F373a4eAe74511561A52998cc6fB4F9C2bdD", addressString1));
+    free ((void *) addressString1);
+
+    BREthereumAddress addresses[5];
+    assert (5 == accountGetAddresses (account, 0, 5, addresses));
+    for (uint32_t index = 0; index < 5; index++)
+        assert (ETHEREUM_BOOLEAN_IS_TRUE (addressEqual (addresses[index], accountGetAddressAtIndex (account, index))));
+    assert (3 == accountGetAddressIndex (account, addresses[3]));
+
     free ((void *) addressString);
 }
 
@@ -10,16 +10,37 @@
 
 #include <stdlib.h>
 #include <assert.h>
-#include <ctype.h>
 #include <string.h>
 #include "support/BRInt.h"
 #include "BRUtilHex.h"
 
+//
+// Table driven conversions - one lookup per character, no branches.  A decode table entry holds
+// the nibble value in the low four bits and HEX_DECODE_VALID if the character is a hex digit.
+//
+#define HEX_DECODE_VALID        (0x10)
+
+#define HEX_DECODE_DIGIT(c,v)   [c] = HEX_DECODE_VALID | (v)
+
+static const uint8_t hexDecodeTable [256] = {
+    HEX_DECODE_DIGIT('0', 0x0), HEX_DECODE_DIGIT('1', 0x1), HEX_DECODE_DIGIT('2', 0x2), HEX_DECODE_DIGIT('3', 0x3),
+    HEX_DECODE_DIGIT('4', 0x4), HEX_DECODE_DIGIT('5', 0x5), HEX_DECODE_DIGIT('6', 0x6), HEX_DECODE_DIGIT('7', 0x7),
+    HEX_DECODE_DIGIT('8', 0x8), HEX_DECODE_DIGIT('9', 0x9),
+    HEX_DECODE_DIGIT('a', 0xa), HEX_DECODE_DIGIT('b', 0xb), HEX_DECODE_DIGIT('c', 0xc),
+    HEX_DECODE_DIGIT('d', 0xd), HEX_DECODE_DIGIT('e', 0xe), HEX_DECODE_DIGIT('f', 0xf),
+    HEX_DECODE_DIGIT('A', 0xa), HEX_DECODE_DIGIT('B', 0xb), HEX_DECODE_DIGIT('C', 0xc),
+    HEX_DECODE_DIGIT('D', 0xd), HEX_DECODE_DIGIT('E', 0xe), HEX_DECODE_DIGIT('F', 0xf)
+};
+
+static const char hexEncodeTable [16] = {
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
+};
+
 // Convert a char into uint8_t (decode)
-#define decodeChar(c)           ((uint8_t) _hexu(c))
+#define decodeChar(c)           (hexDecodeTable[(uint8_t) (c)])
 
 // Convert a uint8_t into a char (encode)
-#define encodeChar(u)           ((char)    _hexc(u))
+#define encodeChar(u)           (hexEncodeTable[(u) & 0x0f])
 
 extern void
 decodeHex (uint8_t *target, size_t targetLen, const char *source, size_t sourceLen) {
@@ -27,9 +48,24 @@ decodeHex (uint8_t *target, size_t targetLen, const char *source, size_t sourceL
     assert (0 == sourceLen % 2);
     assert (2 * targetLen == sourceLen);
     
-    for (int i = 0; i < targetLen; i++) {
-        target[i] = (uint8_t) ((decodeChar(source[2*i]) << 4) | decodeChar(source[(2*i)+1]));
+    for (size_t i = 0; i < targetLen; i++) {
+        target[i] = (uint8_t) ((decodeChar(source[2*i]) << 4) | (0x0f & decodeChar(source[(2*i)+1])));
+    }
+}
+
+extern int
+decodeHexChecked (uint8_t *target, size_t targetLen, const char *source, size_t sourceLen) {
+    uint8_t valid = HEX_DECODE_VALID;
+
+    if (sourceLen != 2 * targetLen) return 0;
+
+    for (size_t i = 0; i < targetLen; i++) {
+        uint8_t hi = decodeChar(source[2*i]);
+        uint8_t lo = decodeChar(source[(2*i)+1]);
+        valid &= hi & lo;
+        target[i] = (uint8_t) ((hi << 4) | (0x0f & lo));
     }
+    return HEX_DECODE_VALID == valid;
 }
 
 extern size_t
@@ -51,7 +87,7 @@ extern void
 encodeHex (char *target, size_t targetLen, const uint8_t *source, size_t sourceLen) {
     assert (targetLen == 2 * sourceLen  + 1);
     
-    for (int i = 0; i < sourceLen; i++) {
+    for (size_t i = 0; i < sourceLen; i++) {
         target[2*i + 0] = encodeChar (source[i] >> 4);
         target[2*i + 1] = encodeChar (source[i]);
     }
@@ -78,6 +114,6 @@ encodeHexValidate (const char *number) {
     if (NULL == number || '\0' == *number || 0 != strlen(number) % 2) return 0;
 
     while (*number)
-        if (!isxdigit (*number++)) return 0;
+        if (0 == (HEX_DECODE_VALID & decodeChar (*number++))) return 0;
     return 1;
 }
@@ -12,6 +12,7 @@
 #define BR_Util_Hex_H
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,6 +32,19 @@ extern "C" {
 extern void
 decodeHex (uint8_t *target, size_t targetLen, const char *source, size_t sourceLen);
 
+/**
+ * As decodeHex() but validate `source` in the same pass.  Return 1 if sourceLen is 2*targetLen
+ * and every source character is a hex digit; otherwise return 0, with `target` unspecified.
+ *
+ * @param target
+ * @param targetLen
+ * @param source
+ * @param sourceLen
+ * @return
+ */
+extern int
+decodeHexChecked (uint8_t *target, size_t targetLen, const char *source, size_t sourceLen);
+
 /**
  * Return the number `uint8_t *' elements needed to decode stringLen characters.  The provided
  * stringLen is the strlen() return (and even number is required); the provided stringLen *DOES NOT*
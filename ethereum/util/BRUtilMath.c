@@ -16,6 +16,13 @@
 
 #define AS_UINT64(x)  ((uint64_t) (x))
 
+// Where the compiler has 128-bit integers, multiply and divide 64-bit limbs directly; the compiler
+// emits the widening multiply (MUL/MULX, UMULH) and add-with-carry itself.
+#if defined (__SIZEOF_INT128__)
+#define HAS_UINT128
+typedef unsigned __int128 uint128_t;
+#endif
+
 extern UInt256
 createUInt256 (uint64_t value) {
     UInt256 result = { .u64 = { value, 0, 0, 0}};
@@ -48,23 +55,33 @@ createUInt256Power2 (uint8_t power) {  // always power < 256, as it must be.
     return z;
 }
 
-extern UInt256
-addUInt256_Overflow (const UInt256 y, const UInt256 x, int *overflow) {
-    assert (overflow != NULL);
-    
-    UInt256 z = UINT256_ZERO;
-    unsigned int count = sizeof (UInt256) / sizeof(uint32_t);
-    
-    // x = xa*2^0 + xb*2^32 + ...
-    // y = ya*2^0 + yb*2^32 + ...
-    // z = (xa + ya)*2^0 + (xb + yb)*2^32 + ...
+/**
+ * Add `x` and `y`, in 64-bit limbs, into `z` and return the carry out (0 or 1).
+ */
+static inline uint64_t
+addUInt256_Carry (UInt256 *z, const UInt256 x, const UInt256 y) {
+    unsigned int count = sizeof (UInt256) / sizeof(uint64_t);
+
+    // x = xa*2^0 + xb*2^64 + ...
+    // y = ya*2^0 + yb*2^64 + ...
+    // z = (xa + ya)*2^0 + (xb + yb)*2^64 + ...
     uint64_t carry = 0;
     for (int i = 0; i < count; i++) {
-        uint64_t sum = AS_UINT64(x.u32[i]) + AS_UINT64(y.u32[i]) + carry;
-        carry = sum >> 32;
-        z.u32[i] = (uint32_t) sum;
+        uint64_t sum = x.u64[i] + carry;
+        carry  = (sum < carry);
+        z->u64[i] = sum + y.u64[i];
+        carry += (z->u64[i] < sum);
     }
+    return carry;
+}
+
+extern UInt256
+addUInt256_Overflow (const UInt256 y, const UInt256 x, int *overflow) {
+    assert (overflow != NULL);
     
+    UInt256 z;
+    uint64_t carry = addUInt256_Carry (&z, x, y);
+
     *overflow = (int) carry;
     return (0 != carry
             ? UINT256_ZERO
@@ -74,38 +91,24 @@ addUInt256_Overflow (const UInt256 y, const UInt256 x, int *overflow) {
 extern UInt512
 addUInt256 (UInt256 x, UInt256 y) {
     UInt512 z = UINT512_ZERO;
-    unsigned int count = sizeof (UInt256) / sizeof(uint32_t);
-    
-    // x = xa*2^0 + xb*2^32 + ...
-    // y = ya*2^0 + yb*2^32 + ...
-    // z = (xa + ya)*2^0 + (xb + yb)*2^32 + ...
-    uint64_t carry = 0;
-    for (int i = 0; i < count; i++) {
-        uint64_t sum = AS_UINT64(x.u32[i]) + AS_UINT64(y.u32[i]) + carry;
-        carry = sum >> 32;
-        z.u32[i] = (uint32_t) sum;
-    }
-    z.u32[count] = (uint32_t) carry;
+    UInt256 sum;
+
+    z.u64[4] = addUInt256_Carry (&sum, x, y);
+    memcpy (z.u64, sum.u64, sizeof (UInt256));
     return z;
 }
 
 static UInt256
 subUInt256_x_gt_y (UInt256 x, UInt256 y) {
     UInt256 z = UINT256_ZERO;
-    unsigned int count = sizeof (UInt256) / sizeof(uint32_t);
+    unsigned int count = sizeof (UInt256) / sizeof(uint64_t);
     
     uint64_t borrow = 0;
     for (int i = 0; i < count; i++) {
-        uint64_t diff;
-        if (AS_UINT64(x.u32[i]) >= (AS_UINT64(y.u32[i]) + borrow)) {
-            diff = AS_UINT64(x.u32[i]) - (AS_UINT64(y.u32[i]) + borrow);
-            borrow = 0;
-        }
-        else {
-            diff = ((AS_UINT64(1) << 32) + AS_UINT64(x.u32[i])) - (AS_UINT64(y.u32[i]) + borrow);
-            borrow = 1;
-        }
-        z.u32[i] = (uint32_t) diff;
+        uint64_t diff = x.u64[i] - borrow;
+        borrow  = (diff > x.u64[i]);
+        z.u64[i] = diff - y.u64[i];
+        borrow += (z.u64[i] > diff);
     }
     return z;
 }
@@ -132,7 +135,22 @@ extern UInt512
 mulUInt256 (const UInt256 x, const UInt256 y) {
     //  assert (__LITTLE_ENDIAN__ == BYTE_ORDER);
     UInt512 z = UINT512_ZERO;
-    
+
+#if defined (HAS_UINT128)
+    unsigned int count = sizeof (UInt256) / sizeof(uint64_t);
+
+    // As below, but in base 64: 16 64x64->128-bit multiplications.
+    for (int xi = 0; xi < count; xi++) {
+        uint64_t carry = 0;
+        if (x.u64[xi] == 0) continue;
+        for (int yi = 0; yi < count; yi++) {
+            uint128_t total = (uint128_t) z.u64[yi + xi] + carry + (uint128_t) y.u64[yi] * x.u64[xi];
+            carry = (uint64_t) (total >> 64);
+            z.u64[yi + xi] = (uint64_t) total;
+        }
+        z.u64[xi + count] = carry;
+    }
+#else
     unsigned int count = sizeof (UInt256) / sizeof(uint32_t);
     
     // Use 'grade school' long multiplication in base 32.  For UInt256 we'll have 8 32-bit value
@@ -149,6 +167,7 @@ mulUInt256 (const UInt256 x, const UInt256 y) {
         }
         z.u32[xi + count] += carry;
     }
+#endif
     return z;
 }
 
@@ -223,6 +242,10 @@ mulUInt256_Double (UInt256 x, double y, int *overflow, int *negative, double *re
 extern UInt256
 divUInt256_Small (UInt256 x, uint32_t y, uint32_t *rem) {
     assert (NULL != rem);
+#if defined (HAS_UINT128)
+    uint64_t remainder;
+    UInt256 z = divUInt256_Small64 (x, y, &remainder);
+#else
     UInt256 z = UINT256_ZERO;
     uint64_t remainder = 0;
     for (int i = 7; i >= 0; i--) {
@@ -230,10 +253,45 @@ divUInt256_Small (UInt256 x, uint32_t y, uint32_t *rem) {
         z.u32[i] = (uint32_t) (value / y);
         remainder = value % y;
     }
+#endif
     *rem = (uint32_t) remainder;
     return z;
 }
 
+extern UInt256
+divUInt256_Small64 (UInt256 x, uint64_t y, uint64_t *rem) {
+    assert (NULL != rem && 0 != y);
+    UInt256 z = UINT256_ZERO;
+    uint64_t remainder = 0;
+
+#if defined (HAS_UINT128)
+    for (int i = 3; i >= 0; i--) {
+        uint128_t value = ((uint128_t) remainder << 64) | x.u64[i];
+        z.u64[i] = (uint64_t) (value / y);
+        remainder = (uint64_t) (value % y);
+    }
+#else
+    if (y <= UINT32_MAX) {
+        uint32_t remainder32;
+        z = divUInt256_Small (x, (uint32_t) y, &remainder32);
+        remainder = remainder32;
+    }
+    else {
+        // Shift-subtract long division, a bit at a time; `remainder` < y stays within 65 bits.
+        for (int i = 255; i >= 0; i--) {
+            uint64_t high = remainder >> 63;
+            remainder = (remainder << 1) | ((x.u64[i / 64] >> (i % 64)) & 1);
+            if (high || remainder >= y) {
+                remainder -= y;
+                z.u64[i / 64] |= AS_UINT64(1) << (i % 64);
+            }
+        }
+    }
+#endif
+    *rem = remainder;
+    return z;
+}
+
 static int
 tooBigUInt256 (UInt512 x) {
     return (0 != x.u64[4]
@@ -134,6 +134,13 @@ mulUInt256_Double (UInt256 x, double y, int *overflow, int *negative, double *re
 extern UInt256
 divUInt256_Small (UInt256 x, uint32_t y, uint32_t *rem);
 
+/**
+ * Divide `x` by `y`, a non-zero 64-bit value, filling `rem` with the remainder.  With a divisor
+ * of 10^19, coerceString() produces 19 decimal digits per division.
+ */
+extern UInt256
+divUInt256_Small64 (UInt256 x, uint64_t y, uint64_t *rem);
+
 /**
  * Coerce `x`, a UInt512, to a UInt256.  If `x` is too big then overflow is set to 1 and
  * zero is returned.
@@ -287,14 +287,19 @@ coerceString (UInt256 x, int base) {
             return encodeHexCreate (NULL, &xr.u8[xrIndex], sizeof (xr.u8) - xrIndex);
         }
             
-            // Repeatedly divide by 10; append the result with the remainder.
+            // Repeatedly divide by 10^19; append the result with the remainder's 19 digits.
         case 10: {
             char r[257];
             memset (r, 0, 257);
-            for (int i = 0; i < 256 && !eqUInt256(x, UINT256_ZERO); i++) {
-                uint32_t rem;
-                x = divUInt256_Small(x, base, &rem);
-                r[i] = '0' + rem;
+            int i = 0;
+            while (!eqUInt256(x, UINT256_ZERO)) {
+                uint64_t rem;
+                x = divUInt256_Small64(x, 10000000000000000000u, &rem);
+                // Every chunk but the most significant has all 19 digits
+                for (int digits = 0; digits < 19 && (rem != 0 || !eqUInt256(x, UINT256_ZERO)); digits++) {
+                    r[i++] = '0' + (char) (rem % 10);
+                    rem /= 10;
+                }
             }
             return coerceReverseString(r);
         }
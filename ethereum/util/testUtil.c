@@ -72,6 +72,12 @@ runMathSubTests () {
             && 0 == z.u32[7]
             && 1 == negative);
 
+    // borrow across every 64-bit limb: 2^192 - 1
+    UInt256 x6atOne = { .u32 = {          0, 0, 0, 0, 0, 0, 1, 0 }};
+    z = subUInt256_Negative(x6atOne, xOne, &negative);
+    assert (UINT64_MAX == z.u64[0] && UINT64_MAX == z.u64[1] && UINT64_MAX == z.u64[2] && 0 == z.u64[3]
+            && 0 == negative);
+
     z = subUInt256_Negative(xOneOne, xTwo, &negative);
     UInt256 zr5 = { .u32 = { UINT32_MAX, 0, 0, 0, 0, 0, 0, 0 }};
     assert (eqUInt256(zr5, z) && 0 == negative);
@@ -224,6 +230,16 @@ runMathDivTests () {
             && a.u64[1] == 0
             && a.u64[2] == 0
             && a.u64[3] == 0);
+
+    // 10^21 / 10^19 = 100
+    uint64_t rem64;
+    a = divUInt256_Small64(r, 10000000000000000000u, &rem64);
+    assert (0 == rem64 && 100 == a.u64[0] && 0 == a.u64[1]);
+
+    // (2^256 - 1) / (2^64 - 1) = 2^192 + 2^128 + 2^64 + 1
+    UInt256 xMax = { .u64 = { UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX }};
+    a = divUInt256_Small64(xMax, UINT64_MAX, &rem64);
+    assert (0 == rem64 && 1 == a.u64[0] && 1 == a.u64[1] && 1 == a.u64[2] && 1 == a.u64[3]);
 }
 
 static void
@@ -253,6 +269,17 @@ runMathCoerceTests () {
     assert (0 == strcmp (es, "0f"));  // unexpected
     free ((char *) es);
 
+    // 10^19 chunks must keep their inner zeros
+    UInt256 f = { .u64 = { 10000000000000000000u, 0, 0, 0}};
+    const char *fs = coerceString(f, 10);
+    assert (0 == strcmp (fs, "10000000000000000000"));
+    free ((char *) fs);
+
+    UInt256 g = { .u64 = { UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX }};
+    const char *gs = coerceString(g, 10);
+    assert (0 == strcmp (gs, "115792089237316195423570985008687907853269984665640564039457584007913129639935"));
+    free ((char *) gs);
+
 }
 
 static void
@@ -291,6 +318,17 @@ runMathParseTests () {
     assert (1 != encodeHexValidate("ff0"));
     assert (1 != encodeHexValidate("1g"));
 
+    uint8_t bytes[2];
+    assert (1 == decodeHexChecked (bytes, 2, "aB09", 4) && 0xab == bytes[0] && 0x09 == bytes[1]);
+    assert (1 != decodeHexChecked (bytes, 2, "aB0", 3));
+    assert (1 != decodeHexChecked (bytes, 2, "aB0x", 4));
+    assert (1 != decodeHexChecked (bytes, 2, "g00f", 4));
+
+    char chars[5];
+    decodeHex (bytes, 2, "F0e1", 4);
+    encodeHex (chars, sizeof (chars), bytes, 2);
+    assert (0 == strcmp (chars, "f0e1"));
+
 
     // "0x09184e72a000" // 10000000000000
     r = createUInt256Parse("09184e72a000", 16, &status);
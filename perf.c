@@ -0,0 +1,318 @@
+//
+//  perf.c
+//
+//  Copyright (c) 2018 breadwallet LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "BRCrypto.h"
+#include "BRSet.h"
+#include "BRKey.h"
+#include "BRAddress.h"
+#include "BRBIP32Sequence.h"
+#include "bitcoin/BRBloomFilter.h"
+#include "bitcoin/BRMerkleBlock.h"
+#include "bitcoin/BRTransaction.h"
+#include "ethereum/rlp/BRRlpCoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+// benchmarks for hot paths of the bitcoin and ethereum cores, run with fixed iteration counts so that results are
+// comparable across releases; prints a JSON object to stdout, optionally limited to the named benchmarks:
+//   make perf && ./perf [name ...]
+
+static volatile uint64_t _sink; // keeps results live so benchmark loops aren't optimized away
+
+static uint64_t _nanos(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+inline static size_t _hashUInt256(const void *h)
+{
+    return (size_t)((const UInt256 *)h)->u32[0];
+}
+
+inline static int _eqUInt256(const void *a, const void *b)
+{
+    return UInt256Eq(*(const UInt256 *)a, *(const UInt256 *)b);
+}
+
+static const char _block[] = // block 10001 filtered to include only transactions 0, 1, 2, and 6
+    "\x01\x00\x00\x00\x06\xe5\x33\xfd\x1a\xda\x86\x39\x1f\x3f\x6c\x34\x32\x04\xb0\xd2\x78\xd4\xaa\xec\x1c"
+    "\x0b\x20\xaa\x27\xba\x03\x00\x00\x00\x00\x00\x6a\xbb\xb3\xeb\x3d\x73\x3a\x9f\xe1\x89\x67\xfd\x7d\x4c\x11\x7e\x4c"
+    "\xcb\xba\xc5\xbe\xc4\xd9\x10\xd9\x00\xb3\xae\x07\x93\xe7\x7f\x54\x24\x1b\x4d\x4c\x86\x04\x1b\x40\x89\xcc\x9b\x0c"
+    "\x00\x00\x00\x08\x4c\x30\xb6\x3c\xfc\xdc\x2d\x35\xe3\x32\x94\x21\xb9\x80\x5e\xf0\xc6\x56\x5d\x35\x38\x1c\xa8\x57"
+    "\x76\x2e\xa0\xb3\xa5\xa1\x28\xbb\xca\x50\x65\xff\x96\x17\xcb\xcb\xa4\x5e\xb2\x37\x26\xdf\x64\x98\xa9\xb9\xca\xfe"
+    "\xd4\xf5\x4c\xba\xb9\xd2\x27\xb0\x03\x5d\xde\xfb\xbb\x15\xac\x1d\x57\xd0\x18\x2a\xae\xe6\x1c\x74\x74\x3a\x9c\x4f"
+    "\x78\x58\x95\xe5\x63\x90\x9b\xaf\xec\x45\xc9\xa2\xb0\xff\x31\x81\xd7\x77\x06\xbe\x8b\x1d\xcc\x91\x11\x2e\xad\xa8"
+    "\x6d\x42\x4e\x2d\x0a\x89\x07\xc3\x48\x8b\x6e\x44\xfd\xa5\xa7\x4a\x25\xcb\xc7\xd6\xbb\x4f\xa0\x42\x45\xf4\xac\x8a"
+    "\x1a\x57\x1d\x55\x37\xea\xc2\x4a\xdc\xa1\x45\x4d\x65\xed\xa4\x46\x05\x54\x79\xaf\x6c\x6d\x4d\xd3\xc9\xab\x65\x84"
+    "\x48\xc1\x0b\x69\x21\xb7\xa4\xce\x30\x21\xeb\x22\xed\x6b\xb6\xa7\xfd\xe1\xe5\xbc\xc4\xb1\xdb\x66\x15\xc6\xab\xc5"
+    "\xca\x04\x21\x27\xbf\xaf\x9f\x44\xeb\xce\x29\xcb\x29\xc6\xdf\x9d\x05\xb4\x7f\x35\xb2\xed\xff\x4f\x00\x64\xb5\x78"
+    "\xab\x74\x1f\xa7\x82\x76\x22\x26\x51\x20\x9f\xe1\xa2\xc4\xc0\xfa\x1c\x58\x51\x0a\xec\x8b\x09\x0d\xd1\xeb\x1f\x82"
+    "\xf9\xd2\x61\xb8\x27\x3b\x52\x5b\x02\xff\x1a";
+
+static uint64_t _perfRlpEncode(size_t n)
+{
+    BRRlpCoder coder = rlpCoderCreate();
+    uint8_t bytes[32] = { 0 }, buf[256];
+    uint64_t start = _nanos();
+
+    for (size_t i = 0; i < n; i++) {
+        BRRlpItem item = rlpEncodeList(coder, 4, rlpEncodeUInt64(coder, i, 1), rlpEncodeUInt64(coder, 21000, 1),
+                                       rlpEncodeBytes(coder, bytes, 20), rlpEncodeBytes(coder, bytes, sizeof(bytes)));
+
+        _sink += rlpGetDataInto(coder, item, buf, sizeof(buf));
+        rlpReleaseItem(coder, item);
+    }
+
+    start = _nanos() - start;
+    rlpCoderRelease(coder);
+    return start;
+}
+
+static uint64_t _perfRlpDecode(size_t n)
+{
+    BRRlpCoder coder = rlpCoderCreate();
+    uint8_t bytes[32] = { 0 };
+    BRRlpItem item = rlpEncodeList(coder, 4, rlpEncodeUInt64(coder, 1000000, 1), rlpEncodeUInt64(coder, 21000, 1),
+                                   rlpEncodeBytes(coder, bytes, 20), rlpEncodeBytes(coder, bytes, sizeof(bytes)));
+    BRRlpData data = rlpGetData(coder, item);
+    uint64_t start;
+    size_t count;
+
+    rlpReleaseItem(coder, item);
+    start = _nanos();
+
+    for (size_t i = 0; i < n; i++) {
+        item = rlpGetItem(coder, data);
+
+        const BRRlpItem *items = rlpDecodeList(coder, item, &count);
+
+        _sink += rlpDecodeUInt64(coder, items[0], 1) + rlpDecodeUInt64(coder, items[1], 1) + count;
+        rlpReleaseItem(coder, item);
+    }
+
+    start = _nanos() - start;
+    rlpDataRelease(data);
+    rlpCoderRelease(coder);
+    return start;
+}
+
+static uint64_t _perfMerkleBlockIsValid(size_t n)
+{
+    BRMerkleBlock *b = BRMerkleBlockParse((const uint8_t *)_block, sizeof(_block) - 1);
+    uint64_t start = _nanos();
+
+    for (size_t i = 0; i < n; i++) _sink += BRMerkleBlockIsValid(b, b->timestamp);
+    start = _nanos() - start;
+    BRMerkleBlockFree(b);
+    return start;
+}
+
+// returns an unsigned 1 input, 2 output tx spending to and from the address of key, which is set to secret 1
+static BRTransaction *_perfTx(BRKey *key)
+{
+    UInt256 secret = uint256("0000000000000000000000000000000000000000000000000000000000000001");
+    BRTransaction *tx = BRTransactionNew();
+    BRAddress address;
+
+    BRKeySetSecret(key, &secret, 1);
+    BRKeyLegacyAddr(key, address.s, sizeof(address));
+
+    uint8_t script[BRAddressScriptPubKey(NULL, 0, address.s)];
+    size_t scriptLen = BRAddressScriptPubKey(script, sizeof(script), address.s);
+
+    BRTransactionAddInput(tx, secret, 0, 1, script, scriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    BRTransactionAddOutput(tx, 100000000, script, scriptLen);
+    BRTransactionAddOutput(tx, 4900000000, script, scriptLen);
+    return tx;
+}
+
+static uint64_t _perfTxParse(size_t n)
+{
+    BRKey key;
+    BRTransaction *tx = _perfTx(&key);
+    uint64_t start;
+
+    BRTransactionSign(tx, 0, &key, 1);
+
+    uint8_t buf[BRTransactionSerialize(tx, NULL, 0)];
+    size_t len = BRTransactionSerialize(tx, buf, sizeof(buf));
+
+    BRTransactionFree(tx);
+    start = _nanos();
+
+    for (size_t i = 0; i < n; i++) {
+        tx = BRTransactionParse(buf, len);
+        _sink += tx->txHash.u8[0];
+        BRTransactionFree(tx);
+    }
+
+    return _nanos() - start;
+}
+
+static uint64_t _perfTxSign(size_t n)
+{
+    BRKey key;
+    BRTransaction *tx = _perfTx(&key);
+    uint64_t start = _nanos();
+
+    for (size_t i = 0; i < n; i++) _sink += BRTransactionSign(tx, 0, &key, 1);
+    start = _nanos() - start;
+    BRTransactionFree(tx);
+    return start;
+}
+
+static uint64_t _perfSet(size_t n)
+{
+    UInt256 *hashes = calloc(1000, sizeof(*hashes));
+    uint64_t start;
+
+    assert(hashes != NULL);
+    for (uint32_t i = 0; i < 1000; i++) BRSHA256(&hashes[i], &i, sizeof(i));
+    start = _nanos();
+
+    for (size_t i = 0; i < n; i++) { // each iteration adds 1000 items, gets them all, and removes half of them
+        BRSet *s = BRSetNew(_hashUInt256, _eqUInt256, 0);
+
+        for (size_t j = 0; j < 1000; j++) BRSetAdd(s, &hashes[j]);
+        for (size_t j = 0; j < 1000; j++) _sink += (BRSetGet(s, &hashes[999 - j]) != NULL);
+        for (size_t j = 0; j < 1000; j += 2) BRSetRemove(s, &hashes[j]);
+        BRSetFree(s);
+    }
+
+    start = _nanos() - start;
+    free(hashes);
+    return start;
+}
+
+static uint64_t _perfBloomFilterContains(size_t n)
+{
+    BRBloomFilter *f = BRBloomFilterNew(0.0005, 1000, 0, BLOOM_UPDATE_ALL);
+    UInt160 h;
+    uint64_t start;
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        BRHash160(&h, &i, sizeof(i));
+        BRBloomFilterInsertData(f, h.u8, sizeof(h));
+    }
+
+    start = _nanos();
+
+    for (size_t i = 0; i < n; i++) { // half hits, half misses
+        uint32_t x = (uint32_t)(i % 2000);
+
+        BRHash160(&h, &x, sizeof(x));
+        _sink += BRBloomFilterContainsData(f, h.u8, sizeof(h));
+    }
+
+    start = _nanos() - start;
+    BRBloomFilterFree(f);
+    return start;
+}
+
+static uint64_t _perfBIP32PubKey(size_t n)
+{
+    UInt512 seed = UINT512_ZERO;
+    BRMasterPubKey mpk = BRBIP32MasterPubKey(&seed, sizeof(seed));
+    uint8_t pubKey[33];
+    uint64_t start = _nanos();
+
+    for (size_t i = 0; i < n; i++) {
+        _sink += BRBIP32PubKey(pubKey, sizeof(pubKey), mpk, SEQUENCE_EXTERNAL_CHAIN, (uint32_t)i);
+    }
+
+    return _nanos() - start;
+}
+
+static uint64_t _perfScrypt(size_t n)
+{
+    uint8_t dk[64];
+    uint64_t start = _nanos();
+
+    for (size_t i = 0; i < n; i++) { // parameters of rfc7914 test vector 3
+        BRScrypt(dk, sizeof(dk), "password", 8, "NaCl", 4, 1024, 8, 16);
+        _sink += dk[0];
+    }
+
+    return _nanos() - start;
+}
+
+static uint64_t _perfKeccak256(size_t n)
+{
+    uint8_t data[1024] = { 0 }, md[32];
+    uint64_t start = _nanos();
+
+    for (size_t i = 0; i < n; i++) {
+        data[0] = (uint8_t)i;
+        BRKeccak256(md, data, sizeof(data));
+        _sink += md[0];
+    }
+
+    return _nanos() - start;
+}
+
+static const struct {
+    const char *name;
+    size_t iterations; // fixed, so that results can be compared across releases
+    uint64_t (*run)(size_t n); // returns the nanoseconds n iterations took, excluding setup
+} _benchmarks[] = {
+    { "rlpEncode",           200000, _perfRlpEncode },
+    { "rlpDecode",           200000, _perfRlpDecode },
+    { "merkleBlockIsValid",  200000, _perfMerkleBlockIsValid },
+    { "txParse",             100000, _perfTxParse },
+    { "txSign",                2000, _perfTxSign },
+    { "setAddGetRemove",       2000, _perfSet },
+    { "bloomFilterContains", 500000, _perfBloomFilterContains },
+    { "bip32PubKey",           2000, _perfBIP32PubKey },
+    { "scrypt",                  10, _perfScrypt },
+    { "keccak256",           100000, _perfKeccak256 }
+};
+
+int main(int argc, const char *argv[])
+{
+    const char *sep = "";
+
+    printf("{\n  \"benchmarks\": [");
+
+    for (size_t i = 0; i < sizeof(_benchmarks)/sizeof(*_benchmarks); i++) {
+        int j = 1;
+        uint64_t ns;
+
+        while (j < argc && strcmp(argv[j], _benchmarks[i].name) != 0) j++;
+        if (argc > 1 && j == argc) continue;
+        ns = _benchmarks[i].run(_benchmarks[i].iterations);
+        printf("%s\n    { \"name\": \"%s\", \"iterations\": %zu, \"totalNs\": %llu, \"nsPerOp\": %.1f }", sep,
+               _benchmarks[i].name, _benchmarks[i].iterations, (unsigned long long)ns,
+               (double)ns/_benchmarks[i].iterations);
+        fflush(stdout);
+        sep = ",";
+    }
+
+    printf("\n  ]\n}\n");
+    return 0;
+}
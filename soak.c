@@ -0,0 +1,368 @@
+//
+//  soak.c
+//
+//  Copyright (c) 2019 breadwallet LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "BRCrypto.h"
+#include "BRInt.h"
+#include "BRStats.h"
+#include "BRBIP32Sequence.h"
+#include "bitcoin/BRChainParams.h"
+#include "bitcoin/BRWalletManager.h"
+#include "ethereum/BREthereum.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <arpa/inet.h>
+
+// soak test of the multi-wallet sync path: starts M bitcoin wallet managers and N ethereum wallet managers, each with
+// a deterministic seed and empty storage, waits until all have synced or the duration has passed, and prints a JSON
+// object to stdout with each one's time-to-synced and the resources the process used meanwhile:
+//   make soak && ./soak [-b btcWallets] [-e ewms] [-d seconds] [-p btcPeer[:port]] [-t] [-s storagePath]
+// -p connects every bitcoin wallet to one local or recorded node (an ipv4 address) rather than to dns seeds; the
+// ewms always try the network's local enodes first (see BREthereumNetwork.c); -t uses testnet for both
+
+#define SOAK_BTC_EARLIEST_KEY_TIME 1539330275 // fixed, so that each run syncs the same blocks
+#define SOAK_ETH_TIMESTAMP         1539330275
+
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+static BRWalletManager *_btcManagers;
+static uint64_t *_btcSyncedNs; // nanoseconds from start to synced, or 0, as for SoakEWMContext
+static size_t _btcCount;
+static uint64_t _startNs;
+
+typedef struct {
+    uint64_t syncedNs;
+} SoakEWMContext;
+
+static uint64_t _nanos(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+// returns the calling process's thread count, or 0 where /proc isn't available
+static size_t _threadCount(void)
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    char line[256];
+    size_t count = 0;
+
+    while (f && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "Threads: %zu", &count) == 1) break;
+    }
+
+    if (f) fclose(f);
+    return count;
+}
+
+// a seed that depends only on the label and index, so that each run uses the same accounts
+static UInt512 _seed(const char *label, size_t idx)
+{
+    char s[64];
+    UInt512 seed;
+
+    snprintf(s, sizeof(s), "soak-%s-%zu", label, idx);
+    BRSHA512(&seed, s, strlen(s));
+    return seed;
+}
+
+static void _btcTransactionEvent(BRWalletManager manager, BRWallet *wallet, BRTransaction *tx,
+                                 BRTransactionEvent event)
+{
+}
+
+static void _btcWalletEvent(BRWalletManager manager, BRWallet *wallet, BRWalletEvent event)
+{
+}
+
+static void _btcWalletManagerEvent(BRWalletManager manager, BRWalletManagerEvent event)
+{
+    if (event.type != BITCOIN_WALLET_MANAGER_SYNC_STOPPED || event.u.syncStopped.error != 0) return;
+    pthread_mutex_lock(&_lock);
+
+    for (size_t i = 0; i < _btcCount; i++) {
+        if (_btcManagers[i] == manager && _btcSyncedNs[i] == 0) _btcSyncedNs[i] = _nanos() - _startNs;
+    }
+
+    pthread_mutex_unlock(&_lock);
+}
+
+// the ewms run in P2P_ONLY mode, so the BRD backend queries are never answered
+static void _ethGetBalance(BREthereumClientContext context, BREthereumEWM ewm, BREthereumWallet wid,
+                           const char *address, int rid)
+{
+}
+
+static void _ethGetGasPrice(BREthereumClientContext context, BREthereumEWM ewm, BREthereumWallet wid, int rid)
+{
+}
+
+static void _ethEstimateGas(BREthereumClientContext context, BREthereumEWM ewm, BREthereumWallet wid,
+                            BREthereumTransfer tid, const char *from, const char *to, const char *amount,
+                            const char *data, int rid)
+{
+}
+
+static void _ethSubmitTransaction(BREthereumClientContext context, BREthereumEWM ewm, BREthereumWallet wid,
+                                  BREthereumTransfer tid, const char *transaction, int rid)
+{
+}
+
+static void _ethGetTransactions(BREthereumClientContext context, BREthereumEWM ewm, const char *address,
+                                uint64_t begBlockNumber, uint64_t endBlockNumber, int rid)
+{
+}
+
+static void _ethGetLogs(BREthereumClientContext context, BREthereumEWM ewm, const char *contract,
+                        const char *address, const char *event, uint64_t begBlockNumber, uint64_t endBlockNumber,
+                        int rid)
+{
+}
+
+static void _ethGetBlocks(BREthereumClientContext context, BREthereumEWM ewm, const char *address,
+                          BREthereumSyncInterestSet interests, uint64_t blockNumberStart, uint64_t blockNumberStop,
+                          int rid)
+{
+}
+
+static void _ethGetTokens(BREthereumClientContext context, BREthereumEWM ewm, int rid)
+{
+}
+
+static void _ethGetBlockNumber(BREthereumClientContext context, BREthereumEWM ewm, int rid)
+{
+}
+
+static void _ethGetNonce(BREthereumClientContext context, BREthereumEWM ewm, const char *address, int rid)
+{
+}
+
+static void _ethEWMEvent(BREthereumClientContext context, BREthereumEWM ewm, BREthereumEWMEvent event,
+                         BREthereumStatus status, const char *errorDescription)
+{
+    SoakEWMContext *ctx = context;
+
+    if (event != EWM_EVENT_SYNC_STOPPED || status != SUCCESS) return;
+    pthread_mutex_lock(&_lock);
+    if (ctx->syncedNs == 0) ctx->syncedNs = _nanos() - _startNs;
+    pthread_mutex_unlock(&_lock);
+}
+
+static void _ethPeerEvent(BREthereumClientContext context, BREthereumEWM ewm, BREthereumPeerEvent event,
+                          BREthereumStatus status, const char *errorDescription)
+{
+}
+
+static void _ethWalletEvent(BREthereumClientContext context, BREthereumEWM ewm, BREthereumWallet wid,
+                            BREthereumWalletEvent event, BREthereumStatus status, const char *errorDescription)
+{
+}
+
+static void _ethTokenEvent(BREthereumClientContext context, BREthereumEWM ewm, BREthereumToken token,
+                           BREthereumTokenEvent event)
+{
+}
+
+static void _ethTransferEvent(BREthereumClientContext context, BREthereumEWM ewm, BREthereumWallet wid,
+                              BREthereumTransfer tid, BREthereumTransferEvent event, BREthereumStatus status,
+                              const char *errorDescription)
+{
+}
+
+// prints "name": [ ms, ... ] with null for those that didn't sync
+static void _printSyncedMs(const char *name, const uint64_t *syncedNs, size_t count, size_t stride)
+{
+    printf("  \"%s\": [", name);
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t ns = *(const uint64_t *)((const uint8_t *)syncedNs + i*stride);
+
+        if (ns == 0) printf("%snull", (i > 0) ? ", " : "");
+        else printf("%s%.1f", (i > 0) ? ", " : "", ns/1000000.0);
+    }
+
+    printf("],\n");
+}
+
+int main(int argc, char *argv[])
+{
+    size_t btcCount = 1, ethCount = 1, durationSec = 600, peakThreads = 0, btcSynced = 0, ethSynced = 0, i;
+    const char *storagePath = "soak.tmp";
+    int testnet = 0, opt;
+    UInt128 peerAddress = UINT128_ZERO;
+    uint16_t peerPort = 0;
+    BRStats begin, end;
+    struct rusage usage;
+    uint64_t elapsedNs;
+
+    while ((opt = getopt(argc, argv, "b:e:d:p:ts:")) != -1) {
+        switch (opt) {
+            case 'b': btcCount = strtoul(optarg, NULL, 10); break;
+            case 'e': ethCount = strtoul(optarg, NULL, 10); break;
+            case 'd': durationSec = strtoul(optarg, NULL, 10); break;
+            case 's': storagePath = optarg; break;
+            case 't': testnet = 1; break;
+            case 'p': {
+                char host[INET_ADDRSTRLEN] = "";
+                struct in_addr addr;
+                char *colon = strchr(optarg, ':');
+                size_t len = (colon) ? (size_t)(colon - optarg) : strlen(optarg);
+
+                if (len < sizeof(host)) memcpy(host, optarg, len);
+                if (colon) peerPort = (uint16_t)strtoul(colon + 1, NULL, 10);
+
+                if (inet_pton(AF_INET, host, &addr) != 1) {
+                    fprintf(stderr, "soak: bad peer address: %s\n", optarg);
+                    return 1;
+                }
+
+                peerAddress.u16[5] = 0xffff; // ipv4 mapped ipv6 address, as BRPeer expects
+                peerAddress.u32[3] = addr.s_addr;
+                break;
+            }
+            default:
+                fprintf(stderr, "usage: soak [-b btcWallets] [-e ewms] [-d seconds] [-p btcPeer[:port]] [-t] "
+                        "[-s storagePath]\n");
+                return 1;
+        }
+    }
+
+    const BRChainParams *params = (testnet) ? BRTestNetParams : BRMainNetParams;
+    BREthereumNetwork network = (testnet) ? ethereumTestnet : ethereumMainnet;
+    BRWalletManagerClient btcClient = { _btcTransactionEvent, _btcWalletEvent, _btcWalletManagerEvent };
+    BREthereumClient ethClient = {
+        NULL, _ethGetBalance, _ethGetGasPrice, _ethEstimateGas, _ethSubmitTransaction, _ethGetTransactions,
+        _ethGetLogs, _ethGetBlocks, _ethGetTokens, _ethGetBlockNumber, _ethGetNonce,
+        _ethEWMEvent, _ethPeerEvent, _ethWalletEvent, _ethTokenEvent, _ethTransferEvent, NULL
+    };
+    BREthereumEWM *ewms = calloc(ethCount, sizeof(*ewms));
+    SoakEWMContext *ethContexts = calloc(ethCount, sizeof(*ethContexts));
+
+    if (peerPort == 0) peerPort = params->standardPort;
+    _btcManagers = calloc(btcCount, sizeof(*_btcManagers));
+    _btcSyncedNs = calloc(btcCount, sizeof(*_btcSyncedNs));
+    _btcCount = btcCount;
+    BRStatsSnapshot(&begin);
+    _startNs = _nanos();
+
+    for (i = 0; i < btcCount; i++) {
+        UInt512 seed = _seed("btc", i);
+        char path[1024];
+
+        snprintf(path, sizeof(path), "%s/btc%zu", storagePath, i);
+        pthread_mutex_lock(&_lock);
+        _btcManagers[i] = BRWalletManagerNew(btcClient, BRBIP32MasterPubKey(&seed, sizeof(seed)), params,
+                                             SOAK_BTC_EARLIEST_KEY_TIME, path);
+        pthread_mutex_unlock(&_lock);
+        var_clean(&seed);
+
+        if (! _btcManagers[i]) {
+            fprintf(stderr, "soak: failed to create bitcoin wallet manager %zu\n", i);
+            return 1;
+        }
+
+        if (! UInt128IsZero(peerAddress)) {
+            BRPeerManagerSetFixedPeer(BRWalletManagerGetPeerManager(_btcManagers[i]), peerAddress, peerPort);
+        }
+
+        BRWalletManagerConnect(_btcManagers[i]);
+    }
+
+    for (i = 0; i < ethCount; i++) {
+        UInt512 seed = _seed("eth", i);
+        char path[1024];
+
+        snprintf(path, sizeof(path), "%s/eth%zu", storagePath, i);
+        ethClient.context = &ethContexts[i];
+        ewms[i] = ewmCreate(network, createAccountWithBIP32Seed(seed), SOAK_ETH_TIMESTAMP, P2P_ONLY, ethClient, path);
+        var_clean(&seed);
+
+        if (! ewms[i]) {
+            fprintf(stderr, "soak: failed to create ethereum wallet manager %zu\n", i);
+            return 1;
+        }
+
+        ewmConnect(ewms[i]);
+    }
+
+    // wait, sampling the thread count each second, until every wallet has synced or the duration has passed
+    do {
+        size_t threads = _threadCount();
+
+        if (threads > peakThreads) peakThreads = threads;
+        sleep(1);
+        pthread_mutex_lock(&_lock);
+        for (i = 0, btcSynced = 0; i < btcCount; i++) btcSynced += (_btcSyncedNs[i] != 0);
+        for (i = 0, ethSynced = 0; i < ethCount; i++) ethSynced += (ethContexts[i].syncedNs != 0);
+        pthread_mutex_unlock(&_lock);
+    } while ((btcSynced < btcCount || ethSynced < ethCount) && _nanos() - _startNs < durationSec*1000000000ULL);
+
+    elapsedNs = _nanos() - _startNs;
+    BRStatsSnapshot(&end);
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("{\n");
+    printf("  \"btcWallets\": %zu,\n  \"ewms\": %zu,\n  \"testnet\": %s,\n", btcCount, ethCount,
+           (testnet) ? "true" : "false");
+    printf("  \"elapsedMs\": %.1f,\n", elapsedNs/1000000.0);
+    printf("  \"btcSynced\": %zu,\n  \"ethSynced\": %zu,\n", btcSynced, ethSynced);
+    _printSyncedMs("btcSyncedMs", _btcSyncedNs, btcCount, sizeof(*_btcSyncedNs));
+    _printSyncedMs("ethSyncedMs", &ethContexts[0].syncedNs, ethCount, sizeof(*ethContexts));
+#if defined(__APPLE__)
+    printf("  \"peakRssKb\": %ld,\n", usage.ru_maxrss/1024); // bytes on darwin, kilobytes on linux
+#else
+    printf("  \"peakRssKb\": %ld,\n", usage.ru_maxrss);
+#endif
+    printf("  \"peakThreads\": %zu,\n", peakThreads);
+    printf("  \"cpuSeconds\": %.3f,\n", usage.ru_utime.tv_sec + usage.ru_utime.tv_usec/1000000.0 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec/1000000.0);
+    printf("  \"btcBytesIn\": %llu,\n  \"btcBytesOut\": %llu,\n",
+           (unsigned long long)(end.counters[BRStatsPeerBytesIn] - begin.counters[BRStatsPeerBytesIn]),
+           (unsigned long long)(end.counters[BRStatsPeerBytesOut] - begin.counters[BRStatsPeerBytesOut]));
+    printf("  \"ethBytesIn\": %llu,\n  \"ethBytesOut\": %llu\n",
+           (unsigned long long)(end.counters[BRStatsLESBytesIn] - begin.counters[BRStatsLESBytesIn]),
+           (unsigned long long)(end.counters[BRStatsLESBytesOut] - begin.counters[BRStatsLESBytesOut]));
+    printf("}\n");
+    fflush(stdout);
+
+    for (i = 0; i < btcCount; i++) {
+        BRWalletManagerDisconnect(_btcManagers[i]);
+        BRWalletManagerFree(_btcManagers[i]);
+    }
+
+    for (i = 0; i < ethCount; i++) {
+        ewmDisconnect(ewms[i]);
+        ewmDestroy(ewms[i]);
+    }
+
+    free(ewms);
+    free(ethContexts);
+    free(_btcManagers);
+    free(_btcSyncedNs);
+    return 0;
+}
@@ -229,12 +229,42 @@ size_t BRScriptPushData(uint8_t *script, size_t scriptLen, const uint8_t *data,
     return (! script || len <= scriptLen) ? len : 0;
 }
 
+// matches script against the fixed byte patterns of the standard scriptPubKey templates, without parsing elements
+// returns the template type, or SCRIPT_TEMPLATE_NONE, and writes a pointer to the hash in script to hash if non-NULL
+int BRScriptTemplate(const uint8_t *script, size_t scriptLen, const uint8_t **hash)
+{
+    const uint8_t *h = NULL;
+    int r = SCRIPT_TEMPLATE_NONE;
+    
+    assert(script != NULL || scriptLen == 0);
+    
+    if (scriptLen == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20 &&
+        script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG) {
+        r = SCRIPT_TEMPLATE_P2PKH, h = &script[3];
+    }
+    else if (scriptLen == 23 && script[0] == OP_HASH160 && script[1] == 20 && script[22] == OP_EQUAL) {
+        r = SCRIPT_TEMPLATE_P2SH, h = &script[2];
+    }
+    else if (scriptLen == 22 && script[0] == OP_0 && script[1] == 20) r = SCRIPT_TEMPLATE_P2WPKH, h = &script[2];
+    else if (scriptLen == 34 && script[0] == OP_0 && script[1] == 32) r = SCRIPT_TEMPLATE_P2WSH, h = &script[2];
+    
+    if (hash) *hash = h;
+    return r;
+}
+
 // returns a pointer to the 20byte pubkey-hash, or NULL if none
 const uint8_t *BRScriptPKH(const uint8_t *script, size_t scriptLen)
 {
+    const uint8_t *h;
+    
     assert(script != NULL || scriptLen == 0);
     if (! script || scriptLen == 0 || scriptLen > MAX_SCRIPT_LENGTH) return NULL;
 
+    switch (BRScriptTemplate(script, scriptLen, &h)) { // nearly all outputs match a template, skip parsing elements
+        case SCRIPT_TEMPLATE_P2PKH: case SCRIPT_TEMPLATE_P2SH: case SCRIPT_TEMPLATE_P2WPKH: return h;
+        case SCRIPT_TEMPLATE_P2WSH: return NULL;
+    }
+
     const uint8_t *elems[BRScriptElements(NULL, 0, script, scriptLen)], *r = NULL;
     size_t l, count = BRScriptElements(elems, sizeof(elems)/sizeof(*elems), script, scriptLen);
     
@@ -264,8 +294,20 @@ size_t BRAddressFromScriptPubKey(char *addr, size_t addrLen, const uint8_t *scri
     assert(script != NULL || scriptLen == 0);
     if (! script || scriptLen == 0 || scriptLen > MAX_SCRIPT_LENGTH) return 0;
     
-    char a[91];
     uint8_t data[21];
+    const uint8_t *h;
+    int t = BRScriptTemplate(script, scriptLen, &h);
+    
+    if (t == SCRIPT_TEMPLATE_P2PKH || t == SCRIPT_TEMPLATE_P2SH) { // skip parsing elements for the common templates
+        data[0] = (t == SCRIPT_TEMPLATE_P2PKH) ? BITCOIN_PUBKEY_ADDRESS : BITCOIN_SCRIPT_ADDRESS;
+#if BITCOIN_TESTNET
+        data[0] = (t == SCRIPT_TEMPLATE_P2PKH) ? BITCOIN_PUBKEY_ADDRESS_TEST : BITCOIN_SCRIPT_ADDRESS_TEST;
+#endif
+        memcpy(&data[1], h, 20);
+        return BRBase58CheckEncode(addr, addrLen, data, 21);
+    }
+    
+    char a[91];
     const uint8_t *d, *elems[BRScriptElements(NULL, 0, script, scriptLen)];
     size_t r = 0, l = 0, count = BRScriptElements(elems, sizeof(elems)/sizeof(*elems), script, scriptLen);
     
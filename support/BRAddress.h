@@ -81,6 +81,17 @@ size_t BRScriptPushData(uint8_t *script, size_t scriptLen, const uint8_t *data,
 
 // returns a pointer to the 20byte pubkey hash, or NULL if none
 const uint8_t *BRScriptPKH(const uint8_t *script, size_t scriptLen);
+
+// standard scriptPubKey templates
+#define SCRIPT_TEMPLATE_NONE   0
+#define SCRIPT_TEMPLATE_P2PKH  1 // 20byte pubkey hash
+#define SCRIPT_TEMPLATE_P2SH   2 // 20byte script hash
+#define SCRIPT_TEMPLATE_P2WPKH 3 // 20byte witness pubkey hash
+#define SCRIPT_TEMPLATE_P2WSH  4 // 32byte witness script hash
+
+// matches script against the fixed byte patterns of the standard scriptPubKey templates, without parsing elements
+// returns the template type, or SCRIPT_TEMPLATE_NONE, and writes a pointer to the hash in script to hash if non-NULL
+int BRScriptTemplate(const uint8_t *script, size_t scriptLen, const uint8_t **hash);
     
 typedef struct {
     char s[75];
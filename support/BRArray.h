@@ -56,29 +56,90 @@ extern "C" {
 // array_clear(myArray);                    // myArray is now empty
 // array_free(myArray);                     // free memory allocated for myArray
 //
+// array_reserve(myArray, 100);            // make room for 100 items at once, instead of growing several times
+// array_shrink_to_fit(myArray);            // release unused capacity, such as after removing many items
+//
+// small arrays can start out in caller provided storage, such as on the stack, and only move to the heap if they
+// outgrow it:
+//
+// array_storage(char, 16) buf;             // storage for up to 16 chars
+//
+// array_new_inline(myArray, buf);          // initialize myArray in buf
+// array_add_array(myArray, "abc", 3);      // no malloc
+// array_free(myArray);                     // frees myArray only if it grew past buf
+//
 // NOTE: when new items are added to an array past its current capacity, its memory location may change, so other
 // references to it or its members must be updated
 
+// capacity an array grows to when count items no longer fit, define before including BRArray.h to change the policy
+#ifndef array_grown_capacity
+#define array_grown_capacity(count) ((count)*3/2)
+#endif
+
+#define _ARRAY_INLINE ((size_t)1 << (sizeof(size_t)*8 - 1)) // capacity flag for arrays in caller provided storage
+
 #define array_new(array, capacity) do {\
     size_t _array_cap = (capacity);\
     assert(_array_cap >= 0);\
     (array) = (void *)((size_t *)calloc(1, _array_cap*sizeof(*(array)) + sizeof(size_t)*2) + 2);\
     assert((array) != NULL);\
-    array_capacity(array) = _array_cap;\
+    ((size_t *)(array))[-2] = _array_cap;\
+    array_count(array) = 0;\
+} while (0)
+
+// storage for an array of up to capacity items, to be initialized with array_new_inline()
+#define array_storage(type, capacity) struct { size_t header[2]; type items[capacity]; }
+
+// initializes array in storage declared with array_storage(), which must remain valid until array_free() is called
+#define array_new_inline(array, storage) do {\
+    assert(sizeof((storage).items[0]) == sizeof(*(array)));\
+    assert((void *)(storage).items == (void *)((storage).header + 2));\
+    memset(&(storage), 0, sizeof(storage));\
+    (array) = (void *)((storage).header + 2);\
+    ((size_t *)(array))[-2] = (sizeof((storage).items)/sizeof(*(array))) | _ARRAY_INLINE;\
     array_count(array) = 0;\
 } while (0)
 
-#define array_capacity(array) (((size_t *)(array))[-2])
+#define _array_is_inline(array) ((((size_t *)(array))[-2] & _ARRAY_INLINE) != 0)
+
+#define array_capacity(array) (((size_t *)(array))[-2] & ~_ARRAY_INLINE)
+
+// bytes of heap memory held by array, including its header, or 0 if array is NULL or in caller provided storage
+#define array_heap_size(array) (((array) && ! _array_is_inline(array)) ?\
+                                array_capacity(array)*sizeof(*(array)) + sizeof(size_t)*2 : 0)
 
 #define array_set_capacity(array, capacity) do {\
-    size_t _array_cap = (capacity);\
+    size_t _array_cap = (capacity), _array_old = array_capacity(array);\
     assert((array) != NULL);\
     assert(_array_cap >= array_count(array));\
-    (array) = (void *)((size_t *)realloc((size_t *)(array) - 2, _array_cap*sizeof(*(array)) + sizeof(size_t)*2) + 2);\
+    if (_array_is_inline(array)) { /* move from caller provided storage to the heap */\
+        size_t *_array_buf = malloc(_array_cap*sizeof(*(array)) + sizeof(size_t)*2);\
+        assert(_array_buf != NULL);\
+        if (_array_old > _array_cap) _array_old = _array_cap;\
+        memcpy(_array_buf, (size_t *)(array) - 2, _array_old*sizeof(*(array)) + sizeof(size_t)*2);\
+        (array) = (void *)(_array_buf + 2);\
+    }\
+    else (array) = (void *)((size_t *)realloc((size_t *)(array) - 2, _array_cap*sizeof(*(array)) +\
+                                               sizeof(size_t)*2) + 2);\
+    assert((array) != NULL);\
+    if (_array_cap > _array_old)\
+        memset((array) + _array_old, 0, (_array_cap - _array_old)*sizeof(*(array)));\
+    ((size_t *)(array))[-2] = _array_cap;\
+} while (0)
+
+// ensures array has capacity for at least capacity items
+#define array_reserve(array, capacity) do {\
+    size_t _array_rsv = (capacity);\
+    assert((array) != NULL);\
+    if (_array_rsv > array_capacity(array))\
+        array_set_capacity(array, _array_rsv);\
+} while (0)
+
+// reduces the capacity of array to its count, leaving arrays in caller provided storage as they are
+#define array_shrink_to_fit(array) do {\
     assert((array) != NULL);\
-    if (_array_cap > array_capacity(array))\
-        memset((array) + array_capacity(array), 0, (_array_cap - array_capacity(array))*sizeof(*(array)));\
-    array_capacity(array) = _array_cap;\
+    if (! _array_is_inline(array) && array_capacity(array) > array_count(array))\
+        array_set_capacity(array, array_count(array));\
 } while (0)
 
 #define array_count(array) (((size_t *)(array))[-1])
@@ -97,7 +158,7 @@ extern "C" {
 #define array_add(array, item) do {\
     assert((array) != NULL);\
     if (array_count(array) + 1 > array_capacity(array))\
-        array_set_capacity(array, (array_capacity(array) + 1)*3/2);\
+        array_set_capacity(array, array_grown_capacity(array_count(array) + 1));\
     (array)[array_count(array)++] = (item);\
 } while (0)
 
@@ -107,7 +168,7 @@ extern "C" {
     assert((other_array) != NULL || _array_cnt == 0);\
     assert(_array_cnt >= 0);\
     if (_array_i + _array_cnt > array_capacity(array))\
-        array_set_capacity(array, (_array_i + _array_cnt)*3/2);\
+        array_set_capacity(array, array_grown_capacity(_array_i + _array_cnt));\
     while (_array_j < _array_cnt)\
         (array)[_array_i++] = (other_array)[_array_j++];\
     array_count(array) += _array_cnt;\
@@ -118,7 +179,7 @@ extern "C" {
     size_t _array_idx = (index), _array_i = ++array_count(array);\
     assert(_array_idx >= 0 && _array_idx < array_count(array));\
     if (_array_i > array_capacity(array))\
-        array_set_capacity(array, (array_capacity(array) + 1)*3/2);\
+        array_set_capacity(array, array_grown_capacity(_array_i));\
     while (--_array_i > _array_idx)\
         (array)[_array_i] = (array)[_array_i - 1];\
     (array)[_array_idx] = (item);\
@@ -131,7 +192,7 @@ extern "C" {
     assert((other_array) != NULL || _array_cnt == 0);\
     assert(_array_cnt >= 0);\
     if (_array_i > array_capacity(array))\
-        array_set_capacity(array, _array_i*3/2);\
+        array_set_capacity(array, array_grown_capacity(_array_i));\
     while (_array_i-- > _array_idx + _array_cnt)\
         (array)[_array_i] = (array)[_array_i - _array_cnt];\
     while (_array_j < _array_cnt)\
@@ -174,7 +235,7 @@ extern "C" {
 
 #define array_free(array) do {\
     assert((array) != NULL);\
-    free((size_t *)(array) - 2);\
+    if (! _array_is_inline(array)) free((size_t *)(array) - 2);\
 } while (0)
 
 /**
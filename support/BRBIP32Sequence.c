@@ -26,11 +26,14 @@
 #include "BRCrypto.h"
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 
 #define BIP32_SEED_KEY "Bitcoin seed"
 #define BIP32_XPRV     "\x04\x88\xAD\xE4"
 #define BIP32_XPUB     "\x04\x88\xB2\x1E"
 
+#define CHAIN_NODE_CACHE_SIZE 8 // number of recently used N(m/0H/chain) nodes kept
+
 // BIP32 is a scheme for deriving chains of addresses from a seed value
 // https://github.com/bitcoin/bips/blob/master/bip-0032.mediawiki
 
@@ -134,18 +137,108 @@ BRMasterPubKey BRBIP32MasterPubKey(const void *seed, size_t seedLen)
     return mpk;
 }
 
+// returns the extended public key for the specified path, i.e. N(m/44H/60H/0H), in place of N(m/0H), so that the keys
+// of a chain below it, N(path/chain/index), can be derived from it alone with BRBIP32PubKey() or BRBIP32PubKeyRange()
+// depth is the number of arguments used to specify the path
+BRMasterPubKey BRBIP32MasterPubKeyPath(const void *seed, size_t seedLen, int depth, ...)
+{
+    BRMasterPubKey mpk = BR_MASTER_PUBKEY_NONE;
+    UInt512 I;
+    UInt256 secret, chain;
+    BRKey key;
+    va_list ap;
+
+    assert(seed != NULL || seedLen == 0);
+    assert(depth > 0);
+    
+    if ((seed || seedLen == 0) && depth > 0) {
+        BRHMAC(&I, BRSHA512, sizeof(UInt512), BIP32_SEED_KEY, strlen(BIP32_SEED_KEY), seed, seedLen);
+        secret = *(UInt256 *)&I;
+        chain = *(UInt256 *)&I.u8[sizeof(UInt256)];
+        var_clean(&I);
+        
+        va_start(ap, depth);
+        
+        for (int i = 0; i < depth; i++) {
+            if (i == depth - 1) { // the fingerprint is of the parent key
+                BRKeySetSecret(&key, &secret, 1);
+                mpk.fingerPrint = BRKeyHash160(&key).u32[0];
+            }
+            
+            _CKDpriv(&secret, &chain, va_arg(ap, uint32_t));
+        }
+        
+        va_end(ap);
+        mpk.chainCode = chain;
+        BRKeySetSecret(&key, &secret, 1);
+        var_clean(&secret, &chain);
+        BRKeyPubKey(&key, &mpk.pubKey, sizeof(mpk.pubKey)); // path N(path)
+        BRKeyClean(&key);
+    }
+    
+    return mpk;
+}
+
+typedef struct {
+    BRMasterPubKey mpk;
+    uint32_t chain;
+    BRECPoint K;
+    UInt256 c;
+    uint64_t lastUsed; // zero for an empty entry
+} _BRChainNode;
+
+static _BRChainNode _chainNodes[CHAIN_NODE_CACHE_SIZE];
+static uint64_t _chainNodesClock = 0;
+static pthread_mutex_t _chainNodesLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int _BRMasterPubKeyEq(const BRMasterPubKey *a, const BRMasterPubKey *b)
+{
+    return (a->fingerPrint == b->fingerPrint && UInt256Eq(a->chainCode, b->chainCode) &&
+            memcmp(a->pubKey, b->pubKey, sizeof(a->pubKey)) == 0);
+}
+
+// sets K and c to the public key and chain code for path N(m/0H/chain), from a small lru cache of recently used nodes
+// so that deriving a run of keys in the same chain doesn't repeat the chain level derivation for every key
+static void _BRBIP32ChainNode(BRECPoint *K, UInt256 *c, const BRMasterPubKey *mpk, uint32_t chain)
+{
+    size_t i, lru = 0;
+    
+    pthread_mutex_lock(&_chainNodesLock);
+    
+    for (i = 0; i < CHAIN_NODE_CACHE_SIZE; i++) {
+        if (_chainNodes[i].lastUsed > 0 && _chainNodes[i].chain == chain &&
+            _BRMasterPubKeyEq(&_chainNodes[i].mpk, mpk)) break;
+        if (_chainNodes[i].lastUsed < _chainNodes[lru].lastUsed) lru = i;
+    }
+    
+    if (i < CHAIN_NODE_CACHE_SIZE) { // cache hit
+        *K = _chainNodes[i].K;
+        *c = _chainNodes[i].c;
+        _chainNodes[i].lastUsed = ++_chainNodesClock;
+        pthread_mutex_unlock(&_chainNodesLock);
+    }
+    else {
+        pthread_mutex_unlock(&_chainNodesLock); // derive outside the lock
+        *K = *(BRECPoint *)mpk->pubKey;
+        *c = mpk->chainCode;
+        _CKDpub(K, c, chain); // path N(m/0H/chain)
+        
+        pthread_mutex_lock(&_chainNodesLock);
+        _chainNodes[lru] = (_BRChainNode) { *mpk, chain, *K, *c, ++_chainNodesClock };
+        pthread_mutex_unlock(&_chainNodesLock);
+    }
+}
+
 // writes the public key for path N(m/0H/chain/index) to pubKey
 // returns number of bytes written, or pubKeyLen needed if pubKey is NULL
 size_t BRBIP32PubKey(uint8_t *pubKey, size_t pubKeyLen, BRMasterPubKey mpk, uint32_t chain, uint32_t index)
 {
-    UInt256 chainCode = mpk.chainCode;
+    UInt256 chainCode;
     
     assert(memcmp(&mpk, &BR_MASTER_PUBKEY_NONE, sizeof(mpk)) != 0);
     
     if (pubKey && sizeof(BRECPoint) <= pubKeyLen) {
-        *(BRECPoint *)pubKey = *(BRECPoint *)mpk.pubKey;
-
-        _CKDpub((BRECPoint *)pubKey, &chainCode, chain); // path N(m/0H/chain)
+        _BRBIP32ChainNode((BRECPoint *)pubKey, &chainCode, &mpk, chain); // path N(m/0H/chain)
         _CKDpub((BRECPoint *)pubKey, &chainCode, index); // index'th key in chain
         var_clean(&chainCode);
     }
@@ -153,6 +246,31 @@ size_t BRBIP32PubKey(uint8_t *pubKey, size_t pubKeyLen, BRMasterPubKey mpk, uint
     return (! pubKey || sizeof(BRECPoint) <= pubKeyLen) ? sizeof(BRECPoint) : 0;
 }
 
+// writes the public keys for paths N(m/0H/chain/start) through N(m/0H/chain/start + count - 1) to pubKeys, deriving
+// the chain node only once for the whole range
+// returns the number of public keys written
+size_t BRBIP32PubKeyRange(BRECPoint pubKeys[], size_t count, BRMasterPubKey mpk, uint32_t chain, uint32_t start)
+{
+    BRECPoint K;
+    UInt256 chainCode, c;
+    size_t i;
+    
+    assert(pubKeys != NULL || count == 0);
+    assert(memcmp(&mpk, &BR_MASTER_PUBKEY_NONE, sizeof(mpk)) != 0);
+    
+    if (! pubKeys || count == 0) return 0;
+    _BRBIP32ChainNode(&K, &chainCode, &mpk, chain); // path N(m/0H/chain)
+    
+    for (i = 0; i < count && (uint32_t)(start + i) < BIP32_HARD; i++) {
+        pubKeys[i] = K;
+        c = chainCode;
+        _CKDpub(&pubKeys[i], &c, (uint32_t)(start + i)); // index'th key in chain
+    }
+    
+    var_clean(&chainCode, &c);
+    return i;
+}
+
 // sets the private key for path m/0H/chain/index to key
 void BRBIP32PrivKey(BRKey *key, const void *seed, size_t seedLen, uint32_t chain, uint32_t index)
 {
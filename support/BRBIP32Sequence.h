@@ -57,10 +57,19 @@ typedef struct {
 // returns the master public key for the default BIP32 wallet layout - derivation path N(m/0H)
 BRMasterPubKey BRBIP32MasterPubKey(const void *seed, size_t seedLen);
 
+// returns the extended public key for the specified path, i.e. N(m/44H/60H/0H), which then takes the place of N(m/0H)
+// below with BRBIP32PubKey() and BRBIP32PubKeyRange()
+// depth is the number of arguments used to specify the path
+BRMasterPubKey BRBIP32MasterPubKeyPath(const void *seed, size_t seedLen, int depth, ...);
+
 // writes the public key for path N(m/0H/chain/index) to pubKey
 // returns number of bytes written, or pubKeyLen needed if pubKey is NULL
 size_t BRBIP32PubKey(uint8_t *pubKey, size_t pubKeyLen, BRMasterPubKey mpk, uint32_t chain, uint32_t index);
 
+// writes the public keys for paths N(m/0H/chain/start) through N(m/0H/chain/start + count - 1) to pubKeys
+// returns the number of public keys written, which is less than count if the range runs into hardened indexes
+size_t BRBIP32PubKeyRange(BRECPoint pubKeys[], size_t count, BRMasterPubKey mpk, uint32_t chain, uint32_t start);
+
 // sets the private key for path m/0H/chain/index to key
 void BRBIP32PrivKey(BRKey *key, const void *seed, size_t seedLen, uint32_t chain, uint32_t index);
 
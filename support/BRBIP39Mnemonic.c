@@ -25,6 +25,7 @@
 #include "BRBIP39Mnemonic.h"
 #include "BRCrypto.h"
 #include "BRInt.h"
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -61,6 +62,50 @@ size_t BRBIP39Encode(char *phrase, size_t phraseLen, const char *wordList[], con
 
 // returns number of bytes written to data, or dataLen needed if data is NULL
 size_t BRBIP39Decode(uint8_t *data, size_t dataLen, const char *wordList[], const char *phrase)
+{
+    uint16_t index[BIP39_WORDINDEX_COUNT];
+
+    assert(wordList != NULL);
+    assert(phrase != NULL);
+    BRBIP39WordIndex(index, wordList); // hashing the wordlist once is faster than scanning it for every phrase word
+    return BRBIP39DecodeIndexed(data, dataLen, wordList, index, phrase);
+}
+
+// writes to index a hash table used to look up the position of a phrase word in wordList in constant time
+void BRBIP39WordIndex(uint16_t index[BIP39_WORDINDEX_COUNT], const char *wordList[])
+{
+    size_t i, j;
+    
+    assert(index != NULL);
+    assert(wordList != NULL);
+    memset(index, 0, BIP39_WORDINDEX_COUNT*sizeof(*index));
+    
+    // open addressing with linear probing, each slot holds a wordList position + 1, or 0 if empty
+    for (i = 0; wordList && i < BIP39_WORDLIST_COUNT; i++) {
+        j = BRMurmur3_32(wordList[i], strlen(wordList[i]), 0) % BIP39_WORDINDEX_COUNT;
+        while (index[j] != 0) j = (j + 1) % BIP39_WORDINDEX_COUNT;
+        index[j] = i + 1;
+    }
+}
+
+// returns the position in wordList of the word at the start of phrase, ending in a space or NULL, or INT32_MAX if not
+// found
+static uint32_t _BRBIP39WordIndexGet(const char *wordList[], const uint16_t index[], const char *word)
+{
+    size_t j, len = strcspn(word, " ");
+    
+    for (j = BRMurmur3_32(word, len, 0) % BIP39_WORDINDEX_COUNT; index[j] != 0; j = (j + 1) % BIP39_WORDINDEX_COUNT) {
+        const char *w = wordList[index[j] - 1];
+
+        if (strncmp(word, w, len) == 0 && w[len] == '\0') return index[j] - 1;
+    }
+    
+    return INT32_MAX;
+}
+
+// same as BRBIP39Decode(), using an index of wordList previously built with BRBIP39WordIndex()
+size_t BRBIP39DecodeIndexed(uint8_t *data, size_t dataLen, const char *wordList[], const uint16_t index[],
+                            const char *phrase)
 {
     uint32_t x, y, count = 0, idx[24], i;
     uint8_t b = 0, hash[32];
@@ -68,16 +113,11 @@ size_t BRBIP39Decode(uint8_t *data, size_t dataLen, const char *wordList[], cons
     size_t r = 0;
 
     assert(wordList != NULL);
+    assert(index != NULL);
     assert(phrase != NULL);
     
     while (word && *word && count < 24) {
-        for (i = 0, idx[count] = INT32_MAX; i < BIP39_WORDLIST_COUNT; i++) { // not fast, but simple and correct
-            if (strncmp(word, wordList[i], strlen(wordList[i])) != 0 ||
-                (word[strlen(wordList[i])] != ' ' && word[strlen(wordList[i])] != '\0')) continue;
-            idx[count] = i;
-            break;
-        }
-        
+        idx[count] = _BRBIP39WordIndexGet(wordList, index, word);
         if (idx[count] == INT32_MAX) break; // phrase contains unknown word
         count++;
         word = strchr(word, ' ');
@@ -118,6 +158,15 @@ int BRBIP39PhraseIsValid(const char *wordList[], const char *phrase)
     return (BRBIP39Decode(NULL, 0, wordList, phrase) > 0);
 }
 
+// same as BRBIP39PhraseIsValid(), using an index of wordList previously built with BRBIP39WordIndex()
+int BRBIP39PhraseIsValidIndexed(const char *wordList[], const uint16_t index[], const char *phrase)
+{
+    assert(wordList != NULL);
+    assert(index != NULL);
+    assert(phrase != NULL);
+    return (BRBIP39DecodeIndexed(NULL, 0, wordList, index, phrase) > 0);
+}
+
 // key64 must hold 64 bytes (512 bits), phrase and passphrase must be unicode NFKD normalized
 // http://www.unicode.org/reports/tr15/#Norm_Forms
 // BUG: does not currently support passphrases containing NULL characters
@@ -131,7 +180,37 @@ void BRBIP39DeriveKey(void *key64, const char *phrase, const char *passphrase)
     if (phrase) {
         strcpy(salt, "mnemonic");
         if (passphrase) strcpy(salt + strlen("mnemonic"), passphrase);
-        BRPBKDF2(key64, 64, BRSHA512, 512/8, phrase, strlen(phrase), salt, strlen(salt), 2048);
+        BRPBKDF2_SHA512(key64, 64, phrase, strlen(phrase), salt, strlen(salt), 2048);
         mem_clean(salt, sizeof(salt));
     }
 }
+
+// derives count keys at once, the same as BRBIP39DeriveKey(key64s[i], phrases[i], passphrases[i]), using as many
+// vector lanes as the cpu has, passphrases may be NULL to use no passphrase for every phrase
+void BRBIP39DeriveKeyBatch(void *key64s[], const char *phrases[], const char *passphrases[], size_t count)
+{
+    const void *pws[(count > 0) ? count : 1], *salts[(count > 0) ? count : 1];
+    size_t i, pwLens[(count > 0) ? count : 1], saltLens[(count > 0) ? count : 1];
+    char *salt;
+
+    assert(key64s != NULL || count == 0);
+    assert(phrases != NULL || count == 0);
+    
+    for (i = 0; i < count; i++) {
+        assert(phrases[i] != NULL);
+        pws[i] = phrases[i];
+        pwLens[i] = strlen(phrases[i]);
+        saltLens[i] = strlen("mnemonic") + ((passphrases && passphrases[i]) ? strlen(passphrases[i]) : 0);
+        salts[i] = salt = malloc(saltLens[i] + 1);
+        assert(salt != NULL);
+        strcpy(salt, "mnemonic");
+        if (passphrases && passphrases[i]) strcpy(salt + strlen("mnemonic"), passphrases[i]);
+    }
+    
+    BRPBKDF2_SHA512Batch(key64s, 64, pws, pwLens, salts, saltLens, 2048, count);
+    
+    for (i = 0; i < count; i++) {
+        mem_clean((void *)salts[i], saltLens[i]);
+        free((void *)salts[i]);
+    }
+}
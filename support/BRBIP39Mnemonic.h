@@ -37,6 +37,7 @@ extern "C" {
 
 #define BIP39_CREATION_TIME  1388534400 // oldest possible BIP39 phrase creation time, seconds after unix epoch
 #define BIP39_WORDLIST_COUNT 2048       // number of words in a BIP39 wordlist
+#define BIP39_WORDINDEX_COUNT 4096      // number of slots in a BIP39 wordlist hash index
 
 // returns number of bytes written to phrase including NULL terminator, or phraseLen needed if phrase is NULL
 size_t BRBIP39Encode(char *phrase, size_t phraseLen, const char *wordList[], const uint8_t *data, size_t dataLen);
@@ -44,14 +45,28 @@ size_t BRBIP39Encode(char *phrase, size_t phraseLen, const char *wordList[], con
 // returns number of bytes written to data, or dataLen needed if data is NULL
 size_t BRBIP39Decode(uint8_t *data, size_t dataLen, const char *wordList[], const char *phrase);
 
+// writes to index a hash table used to look up the position of a phrase word in wordList in constant time
+void BRBIP39WordIndex(uint16_t index[BIP39_WORDINDEX_COUNT], const char *wordList[]);
+
+// same as BRBIP39Decode(), using an index of wordList previously built with BRBIP39WordIndex()
+size_t BRBIP39DecodeIndexed(uint8_t *data, size_t dataLen, const char *wordList[], const uint16_t index[],
+                            const char *phrase);
+
 // verifies that all phrase words are contained in wordlist and checksum is valid
 int BRBIP39PhraseIsValid(const char *wordList[], const char *phrase);
 
+// same as BRBIP39PhraseIsValid(), using an index of wordList previously built with BRBIP39WordIndex()
+int BRBIP39PhraseIsValidIndexed(const char *wordList[], const uint16_t index[], const char *phrase);
+
 // key64 must hold 64 bytes (512 bits), phrase and passphrase must be unicode NFKD normalized
 // http://www.unicode.org/reports/tr15/#Norm_Forms
 // BUG: does not currently support passphrases containing NULL characters
 void BRBIP39DeriveKey(void *key64, const char *phrase, const char *passphrase);
 
+// derives count keys at once, the same as BRBIP39DeriveKey(key64s[i], phrases[i], passphrases[i]), using as many
+// vector lanes as the cpu has, passphrases may be NULL to use no passphrase for every phrase
+void BRBIP39DeriveKeyBatch(void *key64s[], const char *phrases[], const char *passphrases[], size_t count);
+
 #ifdef __cplusplus
 }
 #endif
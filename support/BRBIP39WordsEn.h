@@ -2082,6 +2082,267 @@ static const char *BRBIP39WordsEn[BIP39_WORDLIST_COUNT] = {
     "zoo"
 };
 
+// BRBIP39WordsEn hash index, the same as written by BRBIP39WordIndex(index, BRBIP39WordsEn), for use with
+// BRBIP39DecodeIndexed() and BRBIP39PhraseIsValidIndexed()
+static const uint16_t BRBIP39WordsEnIndex[BIP39_WORDINDEX_COUNT] = {
+    1377,  823,    0,    0,    0, 2001,    0,  987,    0,    0,    0,    0,    0, 1764,    0,  181,
+       0,    0,    0,    0,    0,  698, 1169,    0, 1404,  322, 1704,    0,    0, 1408, 1488,    0,
+     787,    0, 1040, 1167,    0,    0,    0,    0,    0,  170, 1311, 1092,    0, 1232, 2006, 1482,
+       0,    0,  866, 1843,   30,  262, 1703,    0,    0,    0, 1254,    0,    0,    0,  781,    0,
+     967,  804, 1652,    0,    0,  312,  497,  471,  567,  656,  742,  976, 1320, 1986,  528,    0,
+       0,    0,  184,  424,    0, 1117,    0,    0, 1095, 1385,  766, 1034,    0, 1579,  668,  304,
+     674,  267,  320,   23,  604, 1113, 1996,  491,    0,  775,   17,  936, 1346, 1835,    0,  395,
+     671,  777,  258,    0,  576,    0,  185,  696,    0,    0, 1774,    0,    0, 1677,  820,    0,
+       0,    0,    0,    0, 1829,    0,  159,    0,  335, 1871,    0,    0, 1312, 1461, 1963,    0,
+       0,    0,    0,    0,    0,    0, 1480,    0,    0, 1298, 1776,    0,    0, 1442, 2010,    0,
+       0,  460,    0, 1045,  103,    0,    0,  331,  323,  950,    0, 1972,    0, 1043,    0, 1056,
+       0,    0,    0, 1002,  859,  135,  894, 2018,    0,    0,    0,    0,  518, 1338,    0,    0,
+    1178, 1025, 1945, 1598,    0,    0,  636,    0,    0,    0,    0, 1063, 1332,    0,    0,    0,
+       0,  277,  615,    0,    0,    0, 1679,  734, 1017,  171,  962, 1891, 1998,    0,    0,    0,
+       0,  425,    0,    0,    0,    0,    0, 1976,   77,    0,    0,    0,    0,  230,    0, 1832,
+    1763,    0,    0, 1635,    0,  202,    0,    0,    0,    0,    0,    0,    0,  970, 1327,    0,
+    1439,    0, 1180,  195,    0,    0,  453, 1759,    0,    0,    0, 1586, 1365,    0,   70,    0,
+    1172,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,  201,  740,    0,    0,    0,
+       0,    0,    0,    0,    0,    0, 1575,  956,    0,    0,    0,    0,    0,    0,  881,  212,
+     300,    0,    0, 1947,    0, 1329,    0,    0,    0, 1957,    0,  873,  944,    0, 1685, 1619,
+    1362, 1723,  247,  810,  140,  867,  942, 1814,    0,    0,    0,    0,  565,    0,    0,    0,
+       0,    0,   12,    5, 1501,    0,    0,    0,    0,   94,    0,    0,    0,  813,    0,  367,
+       0, 1768,    0,  982,    0,  608,    0,    0, 1637, 1514, 1934, 1665,    0,  429, 1561,  815,
+    1570,  227,    0,    0,    0,  288,  222,  279, 1497,    0,    0, 1644,    0,    0,    0,    0,
+       0, 1908,    0,    0,    0,  297,  447, 1937,    0,    0,  232, 2008,    0,  285,  426,  774,
+    1289, 1634, 1697, 1955, 1968,    0,    0,  375,    0,  445,    0,    0,    0,    0, 2016,  927,
+     701,  914, 1261, 1263, 1594, 1828, 1495,  807, 1991,    0, 1576,    0, 2038, 1321,    0,    0,
+     274,    0,    0,    0,    0,    0,    0,   69,  619,  986,  316, 1290, 1307,    0, 1062, 1898,
+    1899,  751, 1490,  242,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0, 1715,    0,
+    1285,    0,  575,  941,  423, 1796,  318,  164,  639, 1212, 1402,  948, 1664,    0,    0,  107,
+       0, 1022, 1061,    0,   18,    0,    0,    0,  130, 1342,  275,  570,    0,   72,    0,  319,
+       0,    0,    0,    0,    0, 2000,  759, 1780, 1784,    0,  996, 1366,    0,    0,    0,   42,
+    1399, 1487, 1496, 1765, 2046,  112,  142, 1023,  918,  805, 1669, 1622,  961,    0, 1364,  307,
+       0, 1680,  911, 1778,  907, 1163, 1103, 1789,    0,    0,  737, 1076, 1435, 1455,  317, 1220,
+       0,    0,    0,    0,  607, 1625,    0, 1197, 1382,  221,    0,    0,    0,    0,    0,    0,
+    1845,    0, 1019, 1448, 1041,    0,    0, 1909, 1226, 1840,  693, 1912,    0, 1270,    0,   22,
+     251,    0,    0, 1097,    0,    0,  180,  953,    0,    0,    0,    0,    0,  994,    0, 1248,
+     516,    0,    0,    0,    0,    0,    0,    0,  630,  401,  418,  822,  870,    0,  848,  814,
+    1571,    0,  646, 1149,   16, 1309,  572,  197,    0,    0,    0,    0, 1533,    0,    0, 1192,
+      60, 1873,  444, 1559,    0,    0,  347,   63,  812,    0, 1318,    0,    0,  364,    0, 1604,
+     362,    0, 1817,  187,    0,  149,  243,    0,    0,    0, 1026,   52, 1088,    0, 1523,    0,
+       0,    0,    0,    0,    0,    0,    0,    0, 1422,    0, 1791, 1328,  353, 1589,    0,    0,
+       0, 1847,    0,    0,    0, 1509, 1530,    0,    0,    0,    0,    0,    0,    0,  466, 1006,
+       0,    0,    0,  690,   93,  839,    0,    0,    0, 1517,    0,    0, 2044,    0, 1432,  240,
+       0,    0,    0, 1272, 1387,    0,  110,  329,    0,  838, 1111,    0,   11,  256,  282, 1562,
+       0,  590,  513,  762, 1164, 1538, 1775,    0,    0,    0,    0,    0,    0,    0,  640, 1112,
+       0,    0, 1722,    0,    0,   20,  832, 1416,    0,    0,    0,    0,    0,    0,  928,    0,
+       0,  890,    0,  629,    0, 1186,    0,    0,  385,    0,    0,    0, 1153,  414, 1323, 1729,
+    1730, 1806,    0,    0,    0,  793, 1464, 1042,    0, 1434,    0,    0,    0, 2025,    0,  676,
+     372,  599, 1896, 1906,    0,    0,    0,    0, 1018,  707,    0,    0,    0,    0,  478,  313,
+    1462, 1396,  610,    0,  681,    0,    0,  388,    0, 1371,    0,    0,    0,  216,    0,    0,
+     878,  100,  196,  738, 1647,    0,    0,    0,    0,    0,    0,    0,  493,   57,    0,    0,
+       0,    0,    0,    0,    0,    0,    0,    0,    0,  345,    3,    0, 1360, 1491,    0,    0,
+       0,    0, 1668,    0,    0,    0,  343,    0, 1569, 1391, 1967,  826,    0,    0,    0,    0,
+       0,    0,    1,   83,    0,    0,  280,  390,    0,    0,    0,    0,    0,    0,    0,    0,
+       0, 1838,  586,  694, 1666,    0, 1151, 1527,    0,    0,  154,  847,  729,    0,    0,    0,
+       0,    0, 1714,  271,    0, 1733,  339,    0, 1682,    0,    0,    0,    0,    0,    0,   50,
+       0,  703,    0,    0,    0, 1423,    0,    0,  479, 1518, 1101, 1793, 2042, 1820,    0,    0,
+     207,  252, 1479, 1748,  641,    0,  165,  179, 1127, 1257, 1962,  378, 1525, 1811, 1970,    0,
+       0, 1633,    0,    0,    0,    0,  131, 1331, 1975,  633,    0,    0,    0,    0, 2033,    0,
+       0,  645,    0,    0,  346,  457,   82, 1588, 1389, 1810,  278, 1610,    0,    0,    0,    0,
+       0,    0,    0,    0, 1836,    0,    0,    0,    0,    0,    0,  286,  772,    0,    0,    2,
+       0,    0,    0,    0,    0,  264,  794, 1520,  138, 1587,  808, 1266, 1126, 1752,    0,  269,
+    1055, 1047, 1175,    0,    0, 1436, 1478, 1044,  141,  524, 1825,    0,    0,    0,    0,  526,
+     174,  843,    0,    0,    0,  915,    0, 1977,    0,  296, 1585,    0,    0,    0,    0,  806,
+      61,  420, 1146,    0,    0,   59, 1159, 1881,    0,    0,    0,    0, 1390,    0, 1359, 1211,
+     862, 1728, 1905,    0,    0,  514, 1830,    0,    0,  872, 1315, 1046, 1671,    0,    0,    0,
+       0,    0,    0,  571,    9,  946, 1443,    0,   35,    0, 1864,    0,    0, 1749, 1941,    0,
+       0,  239,    0,    0,    0,  821,   40, 1096,  829,   43,  790, 1978,  380,    0,    0,    0,
+       0,    0,    0, 1794,  505,    0,    0, 1302,    0,  732,    0,  735, 1516, 1983,    0,  856,
+       0,    0, 1317, 1534, 2035,    0,    0,    0,    0,  739, 1100,    0,    0,  782,    0,    0,
+       0, 1087,    0,  657,    0, 1280,  727,    0,    0,  981,  836, 1942,    0,  291,  827,    0,
+     496, 1923,  538,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    1278,    0,    0,    0,    0,    0,    0, 1524, 1547, 1310,  236, 1368,  298,  315,  406,  651,
+    1233, 1372, 1444, 1653, 1465, 1786,  523, 2028,    0,    0,    0,  324, 1643,    0,    0,    0,
+     529,    0, 1954,    0,    0,   80, 1015, 1841,    0,    0,    0,    0, 1453,   64,    0,   29,
+       0,    0,    0,  475,    0,    0,    0,  664, 1818,    0, 1119, 1314,   95,  530, 1695,  577,
+       0, 2007,    0,    0, 1313,    0,    8, 2005,    0,    0,    0, 1264, 1486,    0, 1641,    0,
+       0, 1732, 1198, 2048,    0,    0, 1910, 1067,   10,    0, 1833, 2003, 1376,    0, 1545,  869,
+     919, 1779, 1378,    0,    0,  386,  938,  854,    0,  487,    0,    0,    0,  916,  333, 1106,
+    1459, 1857, 1973,    0,    0,    0,    0, 1805,    0,    0,    0,    0,    0, 1754,  730,  643,
+    1075,  134, 1930, 1887,    0,   92,  620,    0,    0, 1401,    0,  462,    0, 1612,    0,    0,
+       0,    0, 1209,  921,    0, 1305,  120, 1157,    0,  311, 1920,    0,    0,    0, 1276,  238,
+    1199, 1639, 1788,    0,    0,    0,    0,  999,    0,    0,    0,    0,  649, 1918,    0,    0,
+     603,  666,    0, 1219,   51,  699,  991, 1089,  831,  638, 1224, 1243, 1348, 1494, 1692, 1705,
+     377,   39,  143,  670,  954, 1003, 1468, 1999,    0,    0,  463,    0,    0,    0, 1000,    0,
+       0,  370, 1885,  299, 1932,    0,    0,    0, 1772, 1195,  980,    0, 1354,  835, 1916,  543,
+       0,    0,    0,  442,    0,    0,    0,    0,  687,  979,    0,    0,  492, 1147, 1297,    0,
+       0, 1256,    0,    0,    0,    0, 1566,    0,    0,    0, 1907,    0,  259,  276,  861, 1260,
+     152,  359,  876, 1787,  600, 1031, 1951,    0,    0,  547,  182,    0,  253,  757, 1783,    0,
+    1596,  718,  155,    0,    0,    0,    0,    0,   99, 1903, 1578,  439, 1853,    0,  993,    0,
+       0,    0, 1466, 1809,  105,    0,    0,  502,  485,  672, 1948, 1640,    0,    0,    0,    0,
+     199, 1230,  495, 1229,  679, 1989,    0,    0,    0,    0,    0,    0,  218,  342, 1731, 2017,
+       0,    0, 1128, 1150,  173,    0,  593,    0, 1008, 1050,  841, 1066,  783, 1425, 1549,   78,
+       0,  225,    0,    0,    0,    0,  949,  648,    0,  433,    0,    0,    0,    0,    0,    0,
+    1299, 1420, 1992,    0,    0,    0,  422,    0,  913,  192,  389,    0,    0,    0,  723,  724,
+    1419, 1745, 1958,    0,    0,    0,    0, 1605,    0, 1583,    0,    0,    0,    0,    0,    0,
+    1107,  614,    0,    0, 1250,   89,    0,    0,    0,    0,    0, 1281, 1595,    0,  809,  566,
+     755,  882, 1952,    0, 1928,    0,  824,    0,    0,    0,    0,    0,    0,    0, 2022,    0,
+       0,    0,    0, 1247,    0,  382,  119,  623,  749, 1154,    0,    0,  984,  583, 1049, 1064,
+       0,    0,    0,  477,    0,  628,    0,  731,    0,    0,    0,  972,    0,    0,  294,    0,
+       0,    0, 1483,    0,    0,    0,    0,  939, 1268,  480,  850,    0,    0, 1071, 1782,  476,
+     973,    0, 1546, 1445,    0,    0,    0, 1223, 1207, 1699,    0,  533,  470, 1181,    0,    0,
+       0,    0,  934,    0,   44,  326,  635,  675, 1072, 1593, 1915, 2011,    0, 1528,    0,    0,
+    1886,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,  163, 1591,
+       0,    0,    0,    0,    0,    0,  113,  398,    0,    0, 1854,  943, 1844,    0,    0,    0,
+     527,    0, 1673,    0, 1935,  901, 1218,    0,  697,  797, 1059, 1717,    0,  121,  611,  992,
+      33,  573, 1413, 1433, 1454, 1974,    0,  368,    0,    0, 1032,    0,    0,    0,    0,    0,
+       0, 1237,    0, 1004,    0,    0,    0,    0, 1184,  468, 1536, 1531, 1238, 1953,    0,  612,
+       0,    0,    0,  837,  337, 1073,  489, 1440,  167, 1615, 1914,    0,    0,  396,    0,    0,
+       0,  748,    0,    0,  683,  126,  194,  133, 2034,  176,    0, 1014,    0,    0,    0, 1344,
+       0,    0,    0, 1663,    0, 1078,    0, 1584,  411,    0,    0,    0,    0, 1798,  351,    0,
+      73, 1943,    0,    0,    0,    0,    0,    0,    0,  795,    0,    0, 1048, 1319, 1380,    0,
+       0,    0,  852,    0,    0,    0,    0, 1339,    0,    0,  650, 1294,    0,    0,    0,    0,
+       0,    0,    0,    0,    0, 2041,    0,  287, 1554,    0,    0,  419,  704, 1630,    0,    0,
+       0,    0, 1291,    0,  587,    0, 1919,  481,    0, 1084,    0,  254,  272,  721,  853, 1166,
+    1217,  899, 1926,    0, 1438,    0,    0,    0, 1961,    0,    0, 1879,    0,    0, 1216,  920,
+       0, 1027,    0,    0,    0, 1120,    0,    0,    0,    0,    0, 1484,    0,    0, 1245,  332,
+    1506,    0,    0, 1966,   58, 1158, 1193, 1985,    0,    0,    0,   84,    0,  844,   85, 1306,
+    1757,    0,    0,    0,    0,    0,    0,    0,    0,    0,  705,  213,  215,  642,    0,    0,
+    1141, 1259, 1645,  341, 1580, 1367, 2009,    0, 1353,    0,    0,    0,   14, 1712,    0,    0,
+       0,    0,    0, 1701, 1969,  883,    0,    0,    0,    0, 1363,  376,    0,    0,    0,    0,
+      32,  887,  151,  166,  733, 1508, 1623,  891,  349,  974, 1249, 1526, 1656, 1760,    0,    0,
+       0,  490,    0,    0,    0, 1437,    0,   66,    0,  293,    0,    0,  791,    0,    0,    0,
+       0,    0,    0,    0,    0,    0, 1803, 1659,    0,  217,  128,  249,    0, 1406,    0,    0,
+       0,    0,    0, 1412, 1769,    0,    0,    0,    0,    0,    0,    0,    0, 1456,  598,    0,
+     678,    0,    0, 1129,    0, 1131,    0,  409,    0,    0,    0,    0,    0,    0,  309, 1130,
+       0,    0,    0,    0,  494,    0,    0,  416,  483,  686,  758, 1616,    0, 1628,    0,  559,
+    1407,    0,    0,    0,    0,    0,    0,    0,    0,    0, 1079,    0,    0,    0,    0,    0,
+       0,    0,    0,    0, 1358, 1674, 1751,    0,  157,  700, 2040,    0,    0,    0,    0,    0,
+       0, 1205, 1374, 1397, 1421, 1564,    0,    0,    0, 1161,    0,    0,    0,    0,    0,    0,
+       0,    0,    0,  521, 1866,    0, 1563,    0,  116, 1601,  234,    0,  325,  716,  871,    0,
+    1493, 1824,    0,    0,    0,    0, 1700, 1544,    0,    0,    0,    0,  769,    0, 1799,    0,
+    1917,    0,    0,    0,    0,    0,    0,    0, 2020,    7,    0,    0,  204,  780, 1148,  778,
+    1253,    0,    0,   28,  900, 1856, 1607,  786, 2021, 1577,    0,    0,    0, 1687,    0,    0,
+       0,    0,  504,  562, 1152,    0, 1636, 1980,    0,    0,  865, 1225, 1551,  935, 1710,  680,
+    1324, 1603, 1187, 1132, 1463,    0,    0, 1200,  722,    0,  692, 1334,  706,    0,    0,  702,
+      86,  930, 1155, 1592,  845,  501, 1702,    0,    0,    0,  684,    0, 1122,    0,    0,    0,
+    2039,  109,  321,    0,    0,    0,    0,    0,    0, 1893,  441,  909, 1182, 1855, 1174, 1326,
+    1661,    0,    0, 1070,    0,   25, 1185,    0,    0,    0,    0, 1995, 1190,    0,    0,  392,
+    1498,    0, 1057,  988, 1252,  673, 1068, 1611, 1984,    0,    0, 1719, 1234, 1642,    0,   27,
+       0,    0,    0,    0, 1831,    0,    0,    0, 1267,    0,    0,    0,   19,  168,    0,  104,
+     244,    0,    0,    0,  246,   75,    0,    0,    0,    0,    0,    0,    0,    0, 1743,    0,
+       0,  348, 1330, 1393, 1550,    0,    0,    0,    0,    0,    0,    0,    0,  328, 1024, 1753,
+       0,    0,  947,    0,    0,    0,    0,  710,  268,  923, 1239, 1938,    0,  352,    0,    0,
+       0,    0,    0, 1201,    0,   90,  283, 1850,  745, 1343, 1269,    0,    0,    0,    0,    0,
+       0,    0,  541,    0,    0, 1849, 1183,    0, 1458,    0,  965,    0,    0,    0,  563, 1105,
+       0,    0, 1373,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+     525, 1370,    0,    0, 1208,  860, 1065, 1727,    0, 1012,    0,  403,    0,  127,    0,    0,
+    1194, 1145, 1678,    0,    0,    0,  634,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+       0,    0,    0,    0,    0,    0,   79,    0,    0,    0,    0,    0,  709,    0,  260,    0,
+       0, 1028,    0,  544, 1567, 1767,  257,  374,  147,    0,    0,    0,    0, 1258,    0,    0,
+    1255, 1431,  381, 1629,  539,  932, 1982, 1143, 1657,  255,  741,    0,    0,  148,  449,    0,
+     955, 1337, 1441, 1933,    0,  248, 1429,  360, 1734,  469,    0,    0,  818, 1513,  365,    0,
+    1758,  498,    0, 1206,    0, 1013,  585,    0,    0,  200,  415, 2043, 1325, 1795,    0,    0,
+     456, 1602,    0,    0,    0,  725, 1939, 2027,    0,  391, 1058,    0,    0,    0,    0,    0,
+    1693,    0,  366, 1608,    0,  929,    0,    0,    0,    0,  968,    0,    0,    0,  667,    0,
+       0,    0,    0, 1007,    0,    0, 1118,    0,    0,    0, 1574,  517, 1405, 1797,    0, 1410,
+      88,  203,  665, 1384, 1863,    0, 1349,    0,    0,    0,    0,    0,    0,  451,    0,    0,
+       0,    0,    0,  712, 1505,  784, 1713,    0,   24,    0,    0,    0, 1202,  631,    0,    0,
+       0,    0, 1895,    0,    0,  589,    0,    0,    0,  160,    0, 1085,    0,  552,  779, 1565,
+     743, 2019, 2045,  561, 1210, 1109, 1160,  937,    0,   68,  788, 1875,  799,    0,    0,  763,
+     413,  153,  776,  785,  926,    6,  132,   67, 1214, 1826,  510,  579, 1369, 2014,  535,  924,
+       0,  438, 1357,    0,    0,    0,    0,    0,  661,    0, 1179,    0,    0,    0,    0,  387,
+     484, 1877,    0,  834,  977,    0,    0,  855,    0,    0, 1965,    0, 1165, 1720,  688,    0,
+       0,    0,    0, 1392,    0,    0,  118,  621,  903,    0,    0,  122, 1675,   45,    0,  695,
+       0, 1670,    0,  211,    0,    0,    0,    0,    0, 1411,    0,    0,    0,    0,    0,    0,
+     770, 1555, 1884,    0,    0,    0,    0,    0,    0,    0,   97,  647,    0,  624,    0,    0,
+       0, 1009, 1572, 1275,  208,  150,   47,  330,  473,    0,    0, 1029, 2037, 1676,    0,  175,
+       0,    0, 1308,    0,    0,    0,    0,  235, 1649, 1654, 1540, 1716,    0,    0,    0,    0,
+     685,    0, 1215, 1133, 1446,    0,    0,    0,    0,    0,    0, 1375,  228,  452,    0, 1300,
+     632,  925,    0,    0,    0,    0, 1837, 1940, 1724,    0,  408, 1862,    0,    0,    0,    0,
+    1936,    0,  595,    0,   46,    0,    0, 1086,    0, 1356, 1472,    0, 1503,    0,    0,    0,
+     605,    0,    0,    0,    0,  717,    0,    0,    0,  885,    0,    0,    0,  803,  448,  458,
+    1037, 1499,    0,   38,  764,  964,  404, 1287, 1861, 1929,    0,    0,    0,  357,  101,  669,
+    1394, 1418, 1581, 1819,    0,   53, 1381, 1708,    0,    0,    0,    0,    0,    0,  618,    0,
+       0,  188,  963, 2029, 1660, 1173,  361,  379,    0,    0, 1277, 1030,  263, 2031,    0,  989,
+    1171, 1475, 1511,  519,  549, 1473, 1512,    0,    0,   26,  265,    0,    0,    0,  206,  908,
+       0,    0,    0,  747,    0,   98,    0,  486,    0,  816,    0,  833,  334,    0, 1011,  397,
+     753,    0,    0, 1542, 1848, 1599, 1876,    0, 1868,    0,    0, 1428,    0,    0,    0,    0,
+       0,    0,    0,    0,    0, 1521,  601, 1481, 1960,    0,    0,    0,    0,  536,    0,    0,
+       0,    0,  209,    0, 1638,    0,    0, 1235,    0,    0,    0,    0,  499,  509,  966, 1878,
+       0,    0,    0,  306,   71, 1351,    0,  273,  125, 1039,  592, 1021,    0,  800,    0,  825,
+       0,  450, 1345, 1842, 1035,  653, 1990,  172,  654,    4,   65,  750, 1614, 1196,  270, 1658,
+    1890,    0,    0,    0, 1869,    0,    0,    0,    0,    0, 1865,  226, 1398, 1696,   54,  229,
+       0, 1098,  792, 2047,  191,  512, 1851,  945, 1902, 1104,    0,    0,  292,    0,    0,  393,
+    1870,    0,    0, 1901,    0,  895, 1400,  771, 1735,    0,    0, 1333, 1537,  874, 1846,  146,
+       0,  520,    0,  952,    0,    0,    0,    0,    0,    0,    0,    0,    0,  985,  412, 1822,
+    1956,  435,    0,    0,  144,  515, 1467,    0, 1156, 1449,    0,    0,    0,    0, 1108,  884,
+    1189,    0,    0, 1510,  851,  990,    0,    0,    0, 1777,    0,    0,    0,    0, 1568,    0,
+       0,    0,  975,    0, 1361,    0,    0,    0,    0, 1858,  356,    0, 1650,    0,    0,  314,
+     625,    0,    0,   74,    0,    0,    0, 1060,    0,    0,  407, 1279,  177,  922,  564, 1322,
+    1452, 1880,  305,    0, 1139,    0,    0,    0, 1477,    0,    0,    0,    0,    0,    0,    0,
+     554,  864,  219, 1889,    0, 1414,    0,  662,  241,    0,    0,    0,    0,    0,    0,  752,
+       0, 2026,    0,    0,    0,   21,    0, 1761, 1994, 1038,   96, 1082, 1204,    0, 1888,    0,
+    1099,    0,    0,  434, 1240,    0,    0,    0,  889,    0,    0,  508, 1114, 1539,   15, 1800,
+    1091, 1904, 2002,  736,    0,  358, 1296,  363, 1515, 1430,  893, 1872,    0, 1457,    0,    0,
+     817,    0,  156,    0,  896,    0, 1093, 1125,    0,  338,  400,  301, 1689,    0, 1762,  689,
+     437,    0, 1736,    0,    0,    0,  223,   36,    0, 1690,    0,    0,    0,    0,    0,    0,
+       0,  511, 1726, 1892,    0, 1813, 1897,  875, 1816,  613,  106,  888, 1573, 1706,    0,    0,
+    1271,  767,  548,  602,  746,  432,  303,  846, 1485, 1474, 1631, 1718,    0,    0, 1005,    0,
+     190, 1246,    0,    0, 1450,    0, 1808, 1913,    0,  801,    0,    0,    0,    0,    0, 1507,
+     186, 1424, 1557, 1582, 1632,    0,    0,    0, 1134, 1231,  488,  842, 1347, 1979,    0,    0,
+       0,  652,  189,    0, 1773,  158,    0,  443,    0,    0,    0,    0,    0,  558, 1489,    0,
+       0,    0,    0,    0,    0, 1383,    0,  931, 1624,    0,    0,    0,    0,    0,    0, 1931,
+     588, 1274, 1336,    0,   48,    0,    0,    0,    0,  622,    0, 1739,    0,    0,    0,    0,
+       0,  765,    0,    0,    0,    0,    0,    0,  596,  971,    0, 1927,    0,    0,    0,    0,
+       0,  663, 1949, 1522,    0,    0,    0,  569,    0,  578, 1944, 2030, 1203,  917,  560,  715,
+       0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,  183,  145,  205,  446,
+    1236, 1541,  744,    0,    0,    0, 1265, 1136,    0,    0, 1222,    0,  384,    0,    0, 1469,
+       0, 1340,    0,    0,    0,    0,    0,    0, 1997,    0,    0,    0,  773, 1686,    0, 2013,
+       0,  958, 1460,    0,    0,    0, 1648,    0,    0,  123, 1694, 1988, 1627, 1519,    0,    0,
+       0,  373,    0,    0,    0,  898,  440,  454,  582, 1304, 1646, 1922,  892,    0,    0, 1094,
+       0,    0,    0,    0,    0,    0,    0,   34,  691,    0, 1921,   37, 1924, 1286,    0, 1502,
+    1036,    0,   49,  245,    0,    0,    0,    0,  224,    0,    0,    0,    0,    0,  340, 2023,
+    1812, 1077,    0,    0, 1684,    0,    0,  682,  162, 1001,  289, 1352,    0,    0,    0,    0,
+       0,    0,    0, 1341,    0,  802,    0,  708,    0,    0,  178,  336, 1620,    0,    0,  906,
+    1292, 1597, 1355, 1737,  308,  542, 1738, 1874,    0,  464,    0,    0,    0,  214, 1221,  421,
+       0, 1074, 1069,    0,    0,    0, 1282,    0, 1698,    0,    0,  551,    0,  136,  472,    0,
+       0, 1721,  910, 1532, 1882,   87, 2012,    0, 1925,    0,    0,  344,    0,    0,  467,  960,
+       0,    0,    0,    0, 1987,   62,  350,  756,  410,  507, 1242, 1451,    0,    0,    0, 1804,
+       0,    0,    0,    0,    0,    0,  231,    0,    0, 1821,  584,    0, 1470, 1755, 1552, 1993,
+       0,    0,  383,    0,    0,    0,    0,  531,  574,    0, 1379,    0,  459, 1135, 1681,  220,
+       0,    0,    0,   55,    0,    0,    0,    0,  580, 1741,    0, 1744,    0,  198, 1711,    0,
+     233, 1288,    0,  550,    0,    0,    0,  658,    0,    0,  719,    0,    0,    0, 1709,    0,
+       0,  858,    0, 1188,    0,    0,  371,  659,    0,  627,  161,  868,  897,  959,  819, 1140,
+     597,    0,    0,  644, 1790,  137,  417,  998,  789, 1802, 1946,  983,  129,    0,    0,    0,
+       0,  284,  713,    0,  557, 1052, 1426,  609, 1839,    0, 1168, 1807,    0,    0,    0,    0,
+       0, 1600, 1492,    0,  482,    0,    0,    0,    0,    0,    0,  237, 1801,    0,    0,    0,
+    1667, 1792,    0,    0,    0,    0,  840,    0, 1350, 1386,    0,    0,  474, 1553,    0,    0,
+       0, 1409,  261, 1303, 2036,    0, 1959,    0,    0, 1162,    0,    0,    0,    0,    0,   41,
+       0, 1766,    0,    0,    0,    0,    0,  828,    0, 1606,    0, 1556, 1621,    0,    0, 1176,
+       0,  905,  532, 1911, 1417,    0, 1771,    0,    0,    0,    0,    0,    0,  581,  617,    0,
+    1740,    0,    0, 1725,    0,  281, 1227,   76,   13, 1504,  402, 1688,    0,    0,    0,    0,
+       0,    0,  556, 1020, 1662,    0, 1110, 1335,    0,    0,    0,    0,  886, 1415,    0,    0,
+       0,    0,  537,    0,    0,    0,    0,  250, 1655,    0,  830, 1651,    0,  102,  503,  594,
+    1016,  591, 1900,  355, 1241, 1529, 1950, 1815,    0,  720, 1170,    0,    0,    0,    0,  436,
+     500,    0,    0, 1283,   31,    0,    0,    0,    0,    0, 1102,  880,  857,    0,    0, 1618,
+       0,    0,  193,  546, 1033,    0,  768, 1083,    0,    0,    0, 1770,    0, 2015,  115,    0,
+       0,    0,    0,    0,  210,    0,    0,  912, 1590,    0,    0,  169, 1244, 1388,  951,    0,
+       0,    0,  728,    0,    0,  354,  540, 1548,  428,  108, 1626, 1781, 1860,  811, 1691,    0,
+       0,    0,    0,    0,  461, 1177, 1080,    0,    0,    0,    0,  111,  427,    0,    0,    0,
+     637, 1617, 1981,    0,    0,    0, 1124, 1707,    0,    0,    0,    0,  266,  877,  506, 1116,
+     754, 1090,  660,  969, 1316, 1471,  760,  465,  568, 1476, 1262, 1756, 1823,  124, 1852, 2032,
+       0,    0,    0,  726, 1273,  545, 1054, 1447, 1859, 2024,  114,    0,    0,    0,    0,  995,
+     399,    0,    0,    0,    0,  405, 1683,    0,    0,    0, 1115,    0,    0,    0,    0,  902,
+       0, 1609, 2004,    0,   91, 1138,    0,   81,  430,  677,  863,  904, 1785,  761,    0,    0,
+       0,    0, 1867,  940, 1964,    0,    0, 1228,    0,    0, 1747,    0, 1427,    0,    0,    0,
+    1883, 1121,    0,    0, 1081, 1191, 1301, 1535, 1827,    0,    0,    0,  369, 1295, 1560,    0,
+       0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0, 1500,    0,    0,    0,  978,
+    1971,  534, 1051,  117, 1123, 1894,    0,    0,    0, 1251,    0, 1543,  522,    0,    0,  553,
+       0,    0, 1613,    0,  394,  455, 1834,  431,    0,  310,  139,    0,    0,  327,  290,    0,
+       0,    0,    0,  711, 1142,  606,    0, 1213,  879,  849, 1395, 1403,  626, 1558, 1672,    0,
+       0,    0,  997, 1746,    0,    0,    0,    0,    0,  616,    0,    0,  555,  957,    0,    0,
+       0,    0, 1293, 1010, 1742,  796, 1750,    0,  714,  655,    0,    0,    0,    0,  295,    0,
+       0,    0,  798,    0,    0,    0,    0,    0,  933,   56, 1053, 1137, 1144, 1284,  302,    0
+};
+
 #ifdef __cplusplus
 }
 #endif
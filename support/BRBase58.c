@@ -32,41 +32,92 @@
 
 // base58 and base58check encoding: https://en.bitcoin.it/wiki/Base58Check_encoding
 
+#define BASE58_LIMB 656356768 // 58^5, the largest power of 58 that fits in a 32bit limb
+
+// returns the value of base58 digit c, or UINT32_MAX if c isn't a base58 digit
+inline static uint32_t _BRBase58Digit(uint8_t c)
+{
+    switch (c) {
+        case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+            return c - '1';
+            
+        case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H':
+            return c + 9 - 'A';
+            
+        case 'J': case 'K': case 'L': case 'M': case 'N':
+            return c + 17 - 'J';
+            
+        case 'P': case 'Q': case 'R': case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z':
+            return c + 22 - 'P';
+            
+        case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i': case 'j': case 'k':
+            return c + 33 - 'a';
+            
+        case 'm': case 'n': case 'o': case 'p': case 'q': case 'r': case 's': case 't': case 'u': case 'v':
+        case 'w': case 'x': case 'y': case 'z':
+            return c + 44 - 'm';
+            
+        default:
+            return UINT32_MAX;
+    }
+}
+
 // returns the number of characters written to str including NULL terminator, or total strLen needed if str is NULL
 size_t BRBase58Encode(char *str, size_t strLen, const uint8_t *data, size_t dataLen)
 {
     static const char chars[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
-    size_t i, j, len, zcount = 0;
+    size_t i, j, k, len, zcount = 0, count = 0;
     
     assert(data != NULL);
     while (zcount < dataLen && data && data[zcount] == 0) zcount++; // count leading zeroes
 
-    uint8_t buf[(dataLen - zcount)*138/100 + 1]; // log(256)/log(58), rounded up
+    // the number is built up in base 58^5 limbs, least significant first, from 4 bytes of data at a time, so each
+    // step of the inner loop does the work of 20 steps of the byte at a time loop
+    uint32_t limbs[((dataLen - zcount)*138/100 + 1)/5 + 1]; // log(256)/log(58), rounded up
+    uint8_t buf[sizeof(limbs)/sizeof(*limbs)*5];
     
-    memset(buf, 0, sizeof(buf));
-    
-    for (i = zcount; data && i < dataLen; i++) {
-        uint32_t carry = data[i];
+    for (i = zcount; data && i < dataLen; i += k) {
+        uint64_t carry = 0;
         
-        for (j = sizeof(buf); j > 0; j--) {
-            carry += (uint32_t)buf[j - 1] << 8;
-            buf[j - 1] = carry % 58;
-            carry /= 58;
+        k = (dataLen - i < 4) ? dataLen - i : 4;
+        for (j = 0; j < k; j++) carry = (carry << 8) | data[i + j];
+        
+        for (j = 0; j < count; j++) { // only the limbs in use so far, instead of the whole buffer
+            carry += (uint64_t)limbs[j] << (8*k);
+            limbs[j] = carry % BASE58_LIMB;
+            carry /= BASE58_LIMB;
+        }
+        
+        while (carry > 0) {
+            limbs[count++] = carry % BASE58_LIMB;
+            carry /= BASE58_LIMB;
         }
         
         var_clean(&carry);
     }
     
+    for (j = 0; j < count; j++) { // split each limb into 5 base58 digits, most significant first
+        uint32_t limb = limbs[j];
+        
+        for (k = 0; k < 5; k++) {
+            buf[(count - j)*5 - k - 1] = limb % 58;
+            limb /= 58;
+        }
+        
+        var_clean(&limb);
+    }
+    
     i = 0;
-    while (i < sizeof(buf) && buf[i] == 0) i++; // skip leading zeroes
-    len = (zcount + sizeof(buf) - i) + 1;
+    while (i < count*5 && buf[i] == 0) i++; // skip leading zeroes
+    len = (zcount + count*5 - i) + 1;
 
     if (str && len <= strLen) {
         while (zcount-- > 0) *(str++) = chars[0];
-        while (i < sizeof(buf)) *(str++) = chars[buf[i++]];
+        while (i < count*5) *(str++) = chars[buf[i++]];
         *str = '\0';
     }
     
+    mem_clean(limbs, sizeof(limbs));
     mem_clean(buf, sizeof(buf));
     return (! str || len <= strLen) ? len : 0;
 }
@@ -74,59 +125,49 @@ size_t BRBase58Encode(char *str, size_t strLen, const uint8_t *data, size_t data
 // returns the number of bytes written to data, or total dataLen needed if data is NULL
 size_t BRBase58Decode(uint8_t *data, size_t dataLen, const char *str)
 {
-    size_t i = 0, j, len, zcount = 0;
+    size_t i = 0, j, k = 0, len, zcount = 0, count = 0;
     
     assert(str != NULL);
     while (str && *str == '1') str++, zcount++; // count leading zeroes
     
-    uint8_t buf[(str) ? strlen(str)*733/1000 + 1 : 0]; // log(58)/log(256), rounded up
-    
-    memset(buf, 0, sizeof(buf));
+    // the number is built up in 32bit limbs, least significant first, from 5 base58 digits at a time
+    uint32_t limbs[((str) ? strlen(str)*733/1000 : 0)/4 + 1]; // log(58)/log(256), rounded up
+    uint8_t buf[sizeof(limbs)];
     
     while (str && *str) {
-        uint32_t carry = *(const uint8_t *)(str++);
+        uint64_t carry = 0, mul = 1;
+        uint32_t digit = 0;
         
-        switch (carry) {
-            case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
-                carry -= '1';
-                break;
-                
-            case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H':
-                carry += 9 - 'A';
-                break;
-                
-            case 'J': case 'K': case 'L': case 'M': case 'N':
-                carry += 17 - 'J';
-                break;
-                
-            case 'P': case 'Q': case 'R': case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': case 'Y':
-            case 'Z':
-                carry += 22 - 'P';
-                break;
-                
-            case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i': case 'j':
-            case 'k':
-                carry += 33 - 'a';
-                break;
-                
-            case 'm': case 'n': case 'o': case 'p': case 'q': case 'r': case 's': case 't': case 'u': case 'v':
-            case 'w': case 'x': case 'y': case 'z':
-                carry += 44 - 'm';
-                break;
-                
-            default:
-                carry = UINT32_MAX;
+        for (k = 0; k < 5 && *str; k++, str++) {
+            digit = _BRBase58Digit(*(const uint8_t *)str);
+            if (digit >= 58) break; // invalid base58 digit
+            carry = carry*58 + digit;
+            mul *= 58;
         }
         
-        if (carry >= 58) break; // invalid base58 digit
+        for (j = 0; j < count; j++) {
+            carry += (uint64_t)limbs[j]*mul;
+            limbs[j] = (uint32_t)carry;
+            carry >>= 32;
+        }
         
-        for (j = sizeof(buf); j > 0; j--) {
-            carry += (uint32_t)buf[j - 1]*58;
-            buf[j - 1] = carry & 0xff;
-            carry >>= 8;
+        while (carry > 0) {
+            limbs[count++] = (uint32_t)carry;
+            carry >>= 32;
         }
         
         var_clean(&carry);
+        var_clean(&digit);
+        if (k < 5 && *str) break; // stopped at an invalid base58 digit
+    }
+    
+    memset(buf, 0, sizeof(buf));
+    
+    for (j = 0; j < count; j++) { // write limbs to buf as a big endian number
+        buf[sizeof(buf) - j*4 - 1] = limbs[j] & 0xff;
+        buf[sizeof(buf) - j*4 - 2] = (limbs[j] >> 8) & 0xff;
+        buf[sizeof(buf) - j*4 - 3] = (limbs[j] >> 16) & 0xff;
+        buf[sizeof(buf) - j*4 - 4] = limbs[j] >> 24;
     }
     
     while (i < sizeof(buf) && buf[i] == 0) i++; // skip leading zeroes
@@ -137,6 +178,7 @@ size_t BRBase58Decode(uint8_t *data, size_t dataLen, const char *str)
         memcpy(&data[zcount], &buf[i], sizeof(buf) - i);
     }
 
+    mem_clean(limbs, sizeof(limbs));
     mem_clean(buf, sizeof(buf));
     return (! data || len <= dataLen) ? len : 0;
 }
@@ -161,6 +203,29 @@ size_t BRBase58CheckEncode(char *str, size_t strLen, const uint8_t *data, size_t
     return len;
 }
 
+// base58check encodes count payloads of dataLen bytes each, stored back to back in data, writing the i-th NULL
+// terminated string to &strs[i*strLen]
+// returns the number of payloads encoded, stopping at the first that doesn't fit in strLen characters
+size_t BRBase58CheckEncodeBatch(char *strs, size_t strLen, const uint8_t *data, size_t dataLen, size_t count)
+{
+    size_t i, bufLen = dataLen + 256/8;
+    uint8_t _buf[0x1000], *buf = (bufLen <= 0x1000) ? _buf : malloc(bufLen);
+
+    assert(buf != NULL);
+    assert(strs != NULL || count == 0);
+    assert(data != NULL || dataLen == 0 || count == 0);
+
+    for (i = 0; strs && i < count; i++) { // reuses one checksum buffer for the whole batch
+        memcpy(buf, &data[i*dataLen], dataLen);
+        BRSHA256_2(&buf[dataLen], &data[i*dataLen], dataLen);
+        if (BRBase58Encode(&strs[i*strLen], strLen, buf, dataLen + 4) == 0) break;
+    }
+    
+    mem_clean(buf, bufLen);
+    if (buf != _buf) free(buf);
+    return i;
+}
+
 // returns the number of bytes written to data, or total dataLen needed if data is NULL
 size_t BRBase58CheckDecode(uint8_t *data, size_t dataLen, const char *str)
 {
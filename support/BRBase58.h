@@ -44,6 +44,11 @@ size_t BRBase58Decode(uint8_t *data, size_t dataLen, const char *str);
 // returns the number of characters written to str including NULL terminator, or total strLen needed if str is NULL
 size_t BRBase58CheckEncode(char *str, size_t strLen, const uint8_t *data, size_t dataLen);
 
+// base58check encodes count payloads of dataLen bytes each, stored back to back in data, writing the i-th NULL
+// terminated string to &strs[i*strLen]
+// returns the number of payloads encoded, stopping at the first that doesn't fit in strLen characters
+size_t BRBase58CheckEncodeBatch(char *strs, size_t strLen, const uint8_t *data, size_t dataLen, size_t count);
+
 // returns the number of bytes written to data, or total dataLen needed if data is NULL
 size_t BRBase58CheckDecode(uint8_t *data, size_t dataLen, const char *str);
 
@@ -34,16 +34,55 @@
 
 // bech32 address format: https://github.com/bitcoin/bips/blob/master/bip-0173.mediawiki
 
-#define polymod(x) ((((x) & 0x1ffffff) << 5) ^ (-(((x) >> 25) & 1) & 0x3b6a57b2) ^\
-                    (-(((x) >> 26) & 1) & 0x26508e6d) ^ (-(((x) >> 27) & 1) & 0x1ea119fa) ^\
-                    (-(((x) >> 28) & 1) & 0x3d4233dd) ^ (-(((x) >> 29) & 1) & 0x2a1462b3))
+// the bech32 checksum is updated a 5bit group at a time, xoring in the generator terms selected by the top 5 bits of
+// the checksum, which are precomputed for all 32 possible values so that each update is a single table lookup
+static const uint32_t _polymodTable[32] = {
+    0x00000000, 0x3b6a57b2, 0x26508e6d, 0x1d3ad9df, 0x1ea119fa, 0x25cb4e48, 0x38f19797, 0x039bc025,
+    0x3d4233dd, 0x0628646f, 0x1b12bdb0, 0x2078ea02, 0x23e32a27, 0x18897d95, 0x05b3a44a, 0x3ed9f3f8,
+    0x2a1462b3, 0x117e3501, 0x0c44ecde, 0x372ebb6c, 0x34b57b49, 0x0fdf2cfb, 0x12e5f524, 0x298fa296,
+    0x1756516e, 0x2c3c06dc, 0x3106df03, 0x0a6c88b1, 0x09f74894, 0x329d1f26, 0x2fa7c6f9, 0x14cd914b
+};
 
+#define polymod(x) ((((x) & 0x1ffffff) << 5) ^ _polymodTable[((x) >> 25) & 0x1f])
+
+// 5bit values of bech32 digits indexed by ascii character (either case), or -1 if not a bech32 digit
+static const int8_t _digits[128] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    15, -1, 10, 17, 21, 20, 26, 30,  7,  5, -1, -1, -1, -1, -1, -1,
+    -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+     1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1,
+    -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+     1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1
+};
+
+// writes the checksum state after the expanded lowercase hrp to chk
+// returns the length of hrp, or 0 if it isn't valid
+static size_t _BRBech32HrpChk(uint32_t *chk, const char *hrp)
+{
+    size_t i, j;
+    uint32_t x = 1;
+    
+    for (i = 0; hrp && hrp[i]; i++) {
+        if (i > 83 || hrp[i] < 33 || hrp[i] > 126 || isupper(hrp[i])) return 0;
+        x = polymod(x) ^ (hrp[i] >> 5);
+    }
+    
+    x = polymod(x);
+    for (j = 0; j < i; j++) x = polymod(x) ^ (hrp[j] & 0x1f);
+    *chk = x;
+    return i;
+}
+
+// if hrp is non-NULL, addr must have that lowercase hrp, and hrpChk must be its checksum state from _BRBech32HrpChk()
 // returns the number of bytes written to data42 (maximum of 42)
-size_t BRBech32Decode(char *hrp84, uint8_t *data42, const char *addr)
+static size_t _BRBech32Decode(char *hrp84, uint8_t *data42, const char *addr, const char *hrp, uint32_t hrpChk)
 {
     size_t i, j, bufLen, addrLen, sep;
     uint32_t x, chk = 1;
-    uint8_t c, ver = 0xff, buf[52], upper = 0, lower = 0;
+    uint8_t ver = 0xff, buf[52], upper = 0, lower = 0;
+    int8_t c;
 
     assert(hrp84 != NULL);
     assert(data42 != NULL);
@@ -58,25 +97,24 @@ size_t BRBech32Decode(char *hrp84, uint8_t *data42, const char *addr)
     addrLen = sep = i;
     while (sep > 0 && addr[sep] != '1') sep--;
     if (addrLen < 8 || addrLen > 90 || sep < 1 || sep + 2 + 6 > addrLen || (upper && lower)) return 0;
-    for (i = 0; i < sep; i++) chk = polymod(chk) ^ (tolower(addr[i]) >> 5);
-    chk = polymod(chk);
-    for (i = 0; i < sep; i++) chk = polymod(chk) ^ (addr[i] & 0x1f);
+    
+    if (hrp) { // the hrp part of the checksum is already known
+        for (i = 0; i < sep && hrp[i] && tolower(addr[i]) == hrp[i]; i++);
+        if (i < sep || hrp[i] != '\0') return 0;
+        chk = hrpChk;
+    }
+    else {
+        for (i = 0; i < sep; i++) chk = polymod(chk) ^ (tolower(addr[i]) >> 5);
+        chk = polymod(chk);
+        for (i = 0; i < sep; i++) chk = polymod(chk) ^ (addr[i] & 0x1f);
+    }
+    
     memset(buf, 0, sizeof(buf));
 
     for (i = sep + 1, j = -1; i < addrLen; i++, j++) {
-        switch (tolower(addr[i])) {
-            case 'q': c = 0;  break; case 'p': c = 1;  break; case 'z': c = 2;  break; case 'r': c = 3;  break;
-            case 'y': c = 4;  break; case '9': c = 5;  break; case 'x': c = 6;  break; case '8': c = 7;  break;
-            case 'g': c = 8;  break; case 'f': c = 9;  break; case '2': c = 10; break; case 't': c = 11; break;
-            case 'v': c = 12; break; case 'd': c = 13; break; case 'w': c = 14; break; case '0': c = 15; break;
-            case 's': c = 16; break; case '3': c = 17; break; case 'j': c = 18; break; case 'n': c = 19; break;
-            case '5': c = 20; break; case '4': c = 21; break; case 'k': c = 22; break; case 'h': c = 23; break;
-            case 'c': c = 24; break; case 'e': c = 25; break; case '6': c = 26; break; case 'm': c = 27; break;
-            case 'u': c = 28; break; case 'a': c = 29; break; case '7': c = 30; break; case 'l': c = 31; break;
-            default: return 0; // invalid bech32 digit
-        }
-        
-        chk = polymod(chk) ^ c;
+        c = _digits[(uint8_t)addr[i]];
+        if (c < 0) return 0; // invalid bech32 digit
+        chk = polymod(chk) ^ (uint8_t)c;
         if (j == -1) ver = c;
         if (j == -1 || i + 6 >= addrLen) continue;
         x = (j % 8)*5 - ((j % 8)*5/8)*8;
@@ -96,30 +134,52 @@ size_t BRBech32Decode(char *hrp84, uint8_t *data42, const char *addr)
     return 2 + bufLen;
 }
 
-// data must contain a valid BIP141 witness program
+// returns the number of bytes written to data42 (maximum of 42)
+size_t BRBech32Decode(char *hrp84, uint8_t *data42, const char *addr)
+{
+    return _BRBech32Decode(hrp84, data42, addr, NULL, 0);
+}
+
+// decodes count addresses that must all have the given lowercase hrp, computing its part of the checksum only once,
+// writing the i-th witness program to &data42[i*42] and its length, or 0 if the address is invalid, to dataLens[i]
+// data42 and dataLens may each be NULL to only validate addrs
+// returns the number of valid addresses
+size_t BRBech32DecodeBatch(uint8_t *data42, size_t dataLens[], const char *hrp, const char *addrs[], size_t count)
+{
+    char h[84];
+    uint8_t buf[42];
+    uint32_t chk = 1;
+    size_t i, len, n = 0, hrpLen = _BRBech32HrpChk(&chk, hrp);
+
+    assert(hrp != NULL);
+    assert(addrs != NULL || count == 0);
+    
+    for (i = 0; i < count; i++) {
+        len = (hrpLen > 0 && addrs[i]) ? _BRBech32Decode(h, (data42) ? &data42[i*42] : buf, addrs[i], hrp, chk) : 0;
+        if (dataLens) dataLens[i] = len;
+        if (len > 0) n++;
+    }
+    
+    return n;
+}
+
+// chk must be the checksum state of the first hrpLen bytes of hrp from _BRBech32HrpChk()
 // returns the number of bytes written to addr91 (maximum of 91)
-size_t BRBech32Encode(char *addr91, const char *hrp, const uint8_t data[])
+static size_t _BRBech32Encode(char *addr91, const char *hrp, size_t hrpLen, uint32_t chk, const uint8_t data[])
 {
     static const char chars[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
     char addr[91];
-    uint32_t x, chk = 1;
+    uint32_t x;
     uint8_t ver, a, b = 0, c = 0;
-    size_t i, j, len;
+    size_t i = hrpLen, j, len;
 
     assert(addr91 != NULL);
     assert(hrp != NULL);
     assert(data != NULL);
     
-    for (i = 0; hrp && hrp[i]; i++) {
-        if (i > 83 || hrp[i] < 33 || hrp[i] > 126 || isupper(hrp[i])) return 0;
-        chk = polymod(chk) ^ (hrp[i] >> 5);
-        addr[i] = hrp[i];
-    }
-    
-    chk = polymod(chk);
-    for (j = 0; j < i; j++) chk = polymod(chk) ^ (hrp[j] & 0x1f);
+    memcpy(addr, hrp, hrpLen);
     addr[i++] = '1';
-    if (i < 1 || data == NULL || (data[0] > OP_0 && data[0] < OP_1)) return 0;
+    if (data == NULL || (data[0] > OP_0 && data[0] < OP_1)) return 0;
     ver = (data[0] >= OP_1) ? data[0] + 1 - OP_1 : 0;
     len = data[1];
     if (ver > 16 || len < 2 || len > 40 || i + 1 + len + 6 >= 91) return 0;
@@ -143,3 +203,35 @@ size_t BRBech32Encode(char *addr91, const char *hrp, const uint8_t data[])
     return i;
 }
 
+// data must contain a valid BIP141 witness program
+// returns the number of bytes written to addr91 (maximum of 91)
+size_t BRBech32Encode(char *addr91, const char *hrp, const uint8_t data[])
+{
+    uint32_t chk = 1;
+    size_t hrpLen;
+
+    assert(addr91 != NULL);
+    assert(hrp != NULL);
+    assert(data != NULL);
+    hrpLen = _BRBech32HrpChk(&chk, hrp);
+    return (hrpLen > 0) ? _BRBech32Encode(addr91, hrp, hrpLen, chk, data) : 0;
+}
+
+// encodes count witness programs stored at &data42[i*42] with the same hrp, computing its part of the checksum only
+// once, writing the i-th NULL terminated address to &addrs91[i*91]
+// returns the number of addresses encoded, stopping at the first that isn't a valid witness program
+size_t BRBech32EncodeBatch(char *addrs91, const char *hrp, const uint8_t *data42, size_t count)
+{
+    uint32_t chk = 1;
+    size_t i, hrpLen = _BRBech32HrpChk(&chk, hrp);
+
+    assert(addrs91 != NULL || count == 0);
+    assert(hrp != NULL);
+    assert(data42 != NULL || count == 0);
+    
+    for (i = 0; hrpLen > 0 && i < count; i++) { // every address shares the hrp part of the checksum
+        if (_BRBech32Encode(&addrs91[i*91], hrp, hrpLen, chk, &data42[i*42]) == 0) break;
+    }
+    
+    return (hrpLen > 0) ? i : 0;
+}
@@ -38,10 +38,21 @@ extern "C" {
 // returns the number of bytes written to data42 (maximum of 42)
 size_t BRBech32Decode(char *hrp84, uint8_t *data42, const char *addr);
 
+// decodes count addresses that must all have the given lowercase hrp, computing its part of the checksum only once,
+// writing the i-th witness program to &data42[i*42] and its length, or 0 if the address is invalid, to dataLens[i]
+// data42 and dataLens may each be NULL to only validate addrs
+// returns the number of valid addresses
+size_t BRBech32DecodeBatch(uint8_t *data42, size_t dataLens[], const char *hrp, const char *addrs[], size_t count);
+
 // data must contain a valid BIP141 witness program
 // returns the number of bytes written to addr91 (maximum of 91)
 size_t BRBech32Encode(char *addr91, const char *hrp, const uint8_t data[]);
 
+// encodes count witness programs stored at &data42[i*42] with the same hrp, computing its part of the checksum only
+// once, writing the i-th NULL terminated address to &addrs91[i*91]
+// returns the number of addresses encoded, stopping at the first that isn't a valid witness program
+size_t BRBech32EncodeBatch(char *addrs91, const char *hrp, const uint8_t *data42, size_t count);
+
 #ifdef __cplusplus
 }
 #endif
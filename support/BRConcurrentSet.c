@@ -0,0 +1,426 @@
+//
+//  BRConcurrentSet.c
+//
+//  Copyright (c) 2019 breadwallet LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "BRConcurrentSet.h"
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <assert.h>
+
+// chained hashtable with a power of 2 number of buckets, whose chains readers follow without locking
+// writers lock the stripe for the low bits of an item's hash, which includes every bucket that item could be in
+// resizing locks every stripe and publishes a copy of the table, so chains readers are following never change shape
+// unlinked nodes and replaced tables are freed once every reader that started before they were unlinked has finished,
+// by flipping between two reader epochs and waiting for the readers of the previous one to drain
+
+#define CSET_STRIPES      16 // must be a power of 2
+#define CSET_MIN_SIZE     CSET_STRIPES
+#define CSET_GARBAGE_MAX  64 // unlinked nodes and tables to collect before waiting on readers to free them
+
+typedef struct _BRConcurrentSetNode {
+    _Atomic(void *) item;
+    size_t hash; // mixed item hash, the bucket is hash & (size - 1)
+    _Atomic(struct _BRConcurrentSetNode *) next;
+    struct _BRConcurrentSetNode *garbageNext;
+    void (*itemFree)(void *item); // called with item when the node is freed, if not NULL
+} BRConcurrentSetNode;
+
+typedef struct _BRConcurrentSetTable {
+    size_t size; // number of buckets
+    struct _BRConcurrentSetTable *garbageNext;
+    _Atomic(BRConcurrentSetNode *) buckets[];
+} BRConcurrentSetTable;
+
+struct BRConcurrentSetStruct {
+    _Atomic(BRConcurrentSetTable *) table;
+    _Atomic size_t itemCount;
+    _Atomic unsigned epoch;
+    _Atomic size_t readers[2]; // lookups in progress that started in each epoch
+    pthread_mutex_t stripes[CSET_STRIPES]; // held to change the chains of buckets with the same low bits
+    pthread_mutex_t resizeLock; // held while resizing, before taking all stripes
+    pthread_mutex_t garbageLock; // held to add or free garbage, always taken last
+    BRConcurrentSetNode *garbageNodes;
+    BRConcurrentSetTable *garbageTables;
+    size_t garbageCount;
+    size_t (*hash)(const void *); // hash function
+    int (*eq)(const void *, const void *); // equality function
+};
+
+// spreads hash bits so the low bits used for buckets and stripes depend on all of them
+static size_t _BRConcurrentSetHash(const BRConcurrentSet *set, const void *item)
+{
+    uint64_t h = (uint64_t)set->hash(item);
+
+    h ^= h >> 33, h *= 0xff51afd7ed558ccd, h ^= h >> 33, h *= 0xc4ceb9fe1a85ec53, h ^= h >> 33;
+    return (size_t)h;
+}
+
+static BRConcurrentSetTable *_BRConcurrentSetTableNew(size_t size)
+{
+    BRConcurrentSetTable *table = calloc(1, sizeof(*table) + size*sizeof(*table->buckets));
+
+    assert(table != NULL);
+    table->size = size;
+    for (size_t i = 0; i < size; i++) atomic_init(&table->buckets[i], NULL);
+    return table;
+}
+
+// frees table and every node still linked in it
+static void _BRConcurrentSetTableFree(BRConcurrentSetTable *table)
+{
+    BRConcurrentSetNode *node, *next;
+
+    for (size_t i = 0; i < table->size; i++) {
+        for (node = atomic_load_explicit(&table->buckets[i], memory_order_relaxed); node; node = next) {
+            next = atomic_load_explicit(&node->next, memory_order_relaxed);
+            free(node);
+        }
+    }
+
+    free(table);
+}
+
+BRConcurrentSet *BRConcurrentSetNew(size_t (*hash)(const void *), int (*eq)(const void *, const void *),
+                                    size_t capacity)
+{
+    BRConcurrentSet *set = calloc(1, sizeof(*set));
+    size_t size = CSET_MIN_SIZE;
+
+    assert(set != NULL);
+    assert(hash != NULL);
+    assert(eq != NULL);
+    while (size < capacity) size *= 2; // load factor is at most 1
+    atomic_init(&set->table, _BRConcurrentSetTableNew(size));
+    atomic_init(&set->itemCount, 0);
+    atomic_init(&set->epoch, 0);
+    atomic_init(&set->readers[0], 0);
+    atomic_init(&set->readers[1], 0);
+    for (size_t i = 0; i < CSET_STRIPES; i++) pthread_mutex_init(&set->stripes[i], NULL);
+    pthread_mutex_init(&set->resizeLock, NULL);
+    pthread_mutex_init(&set->garbageLock, NULL);
+    set->hash = hash;
+    set->eq = eq;
+    return set;
+}
+
+// registers a lookup in the current epoch and returns the epoch, which is passed to _BRConcurrentSetReadEnd()
+static unsigned _BRConcurrentSetReadBegin(BRConcurrentSet *set)
+{
+    unsigned epoch;
+
+    for (;;) {
+        epoch = atomic_load(&set->epoch);
+        atomic_fetch_add(&set->readers[epoch], 1);
+        if (atomic_load(&set->epoch) == epoch) return epoch;
+        atomic_fetch_sub(&set->readers[epoch], 1); // the epoch flipped before the lookup was registered, try again
+    }
+}
+
+static void _BRConcurrentSetReadEnd(BRConcurrentSet *set, unsigned epoch)
+{
+    atomic_fetch_sub(&set->readers[epoch], 1);
+}
+
+// frees all garbage collected so far, once no lookup that could still be using it is in progress
+static void _BRConcurrentSetCollect(BRConcurrentSet *set)
+{
+    BRConcurrentSetNode *node, *nextNode;
+    BRConcurrentSetTable *table, *nextTable;
+    unsigned epoch;
+
+    pthread_mutex_lock(&set->garbageLock);
+    node = set->garbageNodes, set->garbageNodes = NULL;
+    table = set->garbageTables, set->garbageTables = NULL;
+    set->garbageCount = 0;
+
+    // garbage was unlinked before the flip, so only lookups registered in the previous epoch can still reach it
+    epoch = atomic_load(&set->epoch);
+    atomic_store(&set->epoch, epoch ^ 1);
+    while (atomic_load(&set->readers[epoch]) > 0) sched_yield();
+    pthread_mutex_unlock(&set->garbageLock);
+
+    for (; node; node = nextNode) {
+        nextNode = node->garbageNext;
+        if (node->itemFree) node->itemFree(atomic_load_explicit(&node->item, memory_order_relaxed));
+        free(node);
+    }
+
+    for (; table; table = nextTable) {
+        nextTable = table->garbageNext;
+        _BRConcurrentSetTableFree(table);
+    }
+}
+
+// adds an unlinked node or replaced table to the garbage, and returns true if it's time to collect it
+static int _BRConcurrentSetRetire(BRConcurrentSet *set, BRConcurrentSetNode *node, BRConcurrentSetTable *table)
+{
+    int collect;
+
+    pthread_mutex_lock(&set->garbageLock);
+    if (node) node->garbageNext = set->garbageNodes, set->garbageNodes = node;
+    if (table) table->garbageNext = set->garbageTables, set->garbageTables = table;
+    collect = (++set->garbageCount >= CSET_GARBAGE_MAX || table != NULL);
+    pthread_mutex_unlock(&set->garbageLock);
+    return collect;
+}
+
+// doubles the number of buckets if set has more items than buckets
+static void _BRConcurrentSetGrow(BRConcurrentSet *set)
+{
+    BRConcurrentSetTable *table, *newTable;
+    BRConcurrentSetNode *node, *copy;
+    size_t i;
+
+    pthread_mutex_lock(&set->resizeLock);
+    for (i = 0; i < CSET_STRIPES; i++) pthread_mutex_lock(&set->stripes[i]);
+    table = atomic_load(&set->table);
+    newTable = NULL;
+
+    if (atomic_load(&set->itemCount) > table->size) { // check again, another thread may have already resized
+        newTable = _BRConcurrentSetTableNew(table->size*2);
+
+        for (i = 0; i < table->size; i++) { // copy each node, leaving the chains of the old table intact for readers
+            for (node = atomic_load(&table->buckets[i]); node; node = atomic_load(&node->next)) {
+                copy = calloc(1, sizeof(*copy));
+                assert(copy != NULL);
+                atomic_init(&copy->item, atomic_load(&node->item));
+                copy->hash = node->hash;
+                atomic_init(&copy->next, atomic_load_explicit(&newTable->buckets[copy->hash & (newTable->size - 1)],
+                                                              memory_order_relaxed));
+                atomic_store_explicit(&newTable->buckets[copy->hash & (newTable->size - 1)], copy,
+                                      memory_order_relaxed);
+            }
+        }
+
+        atomic_store(&set->table, newTable);
+    }
+
+    for (i = CSET_STRIPES; i > 0; i--) pthread_mutex_unlock(&set->stripes[i - 1]);
+    pthread_mutex_unlock(&set->resizeLock);
+    if (newTable && _BRConcurrentSetRetire(set, NULL, table)) _BRConcurrentSetCollect(set);
+}
+
+// links a new node for item in place of the node for an equivalent existing item, or at the end of its chain, and
+// returns the node replaced, unlinked, or NULL if there was none
+// readers on a replaced node still see the rest of the chain, and may still pass its item to eq(), so it's retired
+// like a removed node rather than having its item swapped out from under them
+static BRConcurrentSetNode *_BRConcurrentSetLink(BRConcurrentSet *set, void *item, size_t hash)
+{
+    BRConcurrentSetTable *table = atomic_load(&set->table); // can't be replaced while a stripe is held
+    _Atomic(BRConcurrentSetNode *) *link = &table->buckets[hash & (table->size - 1)];
+    BRConcurrentSetNode *node, *added = calloc(1, sizeof(*added));
+
+    assert(added != NULL);
+
+    for (node = atomic_load(link); node; link = &node->next, node = atomic_load(link)) {
+        if (node->hash == hash && set->eq(atomic_load(&node->item), item)) break;
+    }
+
+    atomic_init(&added->item, item);
+    added->hash = hash;
+    atomic_init(&added->next, (node) ? atomic_load(&node->next) : NULL);
+    atomic_store(link, added); // publish the fully initialized node
+    if (! node) atomic_fetch_add(&set->itemCount, 1);
+    return node;
+}
+
+// adds given item to set, or replaces an equivalent existing item and retires its node, calling itemFree() with the
+// replaced item once no lookup could still be using it if itemFree is not NULL, and returns the item replaced if any
+static void *_BRConcurrentSetAdd(BRConcurrentSet *set, void *item, void (*itemFree)(void *item))
+{
+    BRConcurrentSetNode *node;
+    size_t hash, size;
+    void *replaced = NULL;
+
+    assert(set != NULL);
+    assert(item != NULL);
+    hash = _BRConcurrentSetHash(set, item);
+    pthread_mutex_lock(&set->stripes[hash & (CSET_STRIPES - 1)]);
+    node = _BRConcurrentSetLink(set, item, hash);
+    size = atomic_load(&set->table)->size;
+    pthread_mutex_unlock(&set->stripes[hash & (CSET_STRIPES - 1)]);
+
+    if (node) {
+        replaced = atomic_load(&node->item);
+        node->itemFree = itemFree;
+        if (_BRConcurrentSetRetire(set, node, NULL)) _BRConcurrentSetCollect(set);
+    }
+    else if (atomic_load(&set->itemCount) > size) _BRConcurrentSetGrow(set);
+
+    return replaced;
+}
+
+// adds given item to set or replaces an equivalent existing item and returns item replaced if any
+void *BRConcurrentSetAdd(BRConcurrentSet *set, void *item)
+{
+    return _BRConcurrentSetAdd(set, item, NULL);
+}
+
+// adds given item to set, or replaces an equivalent existing item and calls itemFree() with it once no lookup could
+// still be using it
+// returns true if an item was replaced
+int BRConcurrentSetAddAndFree(BRConcurrentSet *set, void *item, void (*itemFree)(void *item))
+{
+    assert(itemFree != NULL);
+    return (_BRConcurrentSetAdd(set, item, itemFree) != NULL);
+}
+
+// unlinks the node for the item equivalent to given item, and returns it, or NULL if there is none
+static BRConcurrentSetNode *_BRConcurrentSetUnlink(BRConcurrentSet *set, const void *item, size_t hash)
+{
+    BRConcurrentSetTable *table = atomic_load(&set->table);
+    _Atomic(BRConcurrentSetNode *) *link = &table->buckets[hash & (table->size - 1)];
+    BRConcurrentSetNode *node;
+
+    for (node = atomic_load(link); node; link = &node->next, node = atomic_load(link)) {
+        if (node->hash != hash || ! set->eq(atomic_load(&node->item), item)) continue;
+        atomic_store(link, atomic_load(&node->next)); // readers on node still see the rest of the chain
+        atomic_fetch_sub(&set->itemCount, 1);
+        break;
+    }
+
+    return node;
+}
+
+// removes item equivalent to given item from set and returns item removed if any
+void *BRConcurrentSetRemove(BRConcurrentSet *set, const void *item)
+{
+    BRConcurrentSetNode *node;
+    size_t hash;
+    void *removed = NULL;
+
+    assert(set != NULL);
+    assert(item != NULL);
+    hash = _BRConcurrentSetHash(set, item);
+    pthread_mutex_lock(&set->stripes[hash & (CSET_STRIPES - 1)]);
+    node = _BRConcurrentSetUnlink(set, item, hash);
+    pthread_mutex_unlock(&set->stripes[hash & (CSET_STRIPES - 1)]);
+
+    if (node) {
+        removed = atomic_load(&node->item);
+        if (_BRConcurrentSetRetire(set, node, NULL)) _BRConcurrentSetCollect(set);
+    }
+
+    return removed;
+}
+
+// removes item equivalent to given item from set, and calls itemFree() with it once no lookup could still be using it
+// returns true if an item was removed
+int BRConcurrentSetRemoveAndFree(BRConcurrentSet *set, const void *item, void (*itemFree)(void *item))
+{
+    BRConcurrentSetNode *node;
+    size_t hash;
+
+    assert(set != NULL);
+    assert(item != NULL);
+    assert(itemFree != NULL);
+    hash = _BRConcurrentSetHash(set, item);
+    pthread_mutex_lock(&set->stripes[hash & (CSET_STRIPES - 1)]);
+    node = _BRConcurrentSetUnlink(set, item, hash);
+    pthread_mutex_unlock(&set->stripes[hash & (CSET_STRIPES - 1)]);
+    if (! node) return 0;
+    node->itemFree = itemFree;
+    if (_BRConcurrentSetRetire(set, node, NULL)) _BRConcurrentSetCollect(set);
+    return 1;
+}
+
+// returns the number of items in set
+size_t BRConcurrentSetCount(const BRConcurrentSet *set)
+{
+    assert(set != NULL);
+    return atomic_load(&((BRConcurrentSet *)set)->itemCount);
+}
+
+// true if an item equivalant to the given item is contained in set
+int BRConcurrentSetContains(BRConcurrentSet *set, const void *item)
+{
+    return (BRConcurrentSetGet(set, item) != NULL);
+}
+
+// returns member item from set equivalent to given item, or NULL if there is none
+void *BRConcurrentSetGet(BRConcurrentSet *set, const void *item)
+{
+    return BRConcurrentSetGetWith(set, item, NULL);
+}
+
+// returns get() called with the member item from set equivalent to given item, or NULL if there is none
+void *BRConcurrentSetGetWith(BRConcurrentSet *set, const void *item, void *(*get)(void *item))
+{
+    BRConcurrentSetTable *table;
+    BRConcurrentSetNode *node;
+    size_t hash;
+    unsigned epoch;
+    void *found = NULL;
+
+    assert(set != NULL);
+    assert(item != NULL);
+    hash = _BRConcurrentSetHash(set, item);
+    epoch = _BRConcurrentSetReadBegin(set);
+    table = atomic_load(&set->table);
+
+    for (node = atomic_load(&table->buckets[hash & (table->size - 1)]); node; node = atomic_load(&node->next)) {
+        if (node->hash != hash) continue;
+        found = atomic_load(&node->item);
+        if (set->eq(found, item)) break;
+        found = NULL;
+    }
+
+    if (found && get) found = get(found); // before the read ends, so found can't have been freed yet
+    _BRConcurrentSetReadEnd(set, epoch);
+    return found;
+}
+
+// calls apply() with each item in set, apply() must not modify set
+// items added or removed by other threads while apply() is being called may or may not be included
+void BRConcurrentSetApply(BRConcurrentSet *set, void *info, void (*apply)(void *info, void *item))
+{
+    BRConcurrentSetTable *table;
+    BRConcurrentSetNode *node;
+    unsigned epoch;
+
+    assert(set != NULL);
+    assert(apply != NULL);
+    epoch = _BRConcurrentSetReadBegin(set);
+    table = atomic_load(&set->table);
+
+    for (size_t i = 0; i < table->size; i++) {
+        for (node = atomic_load(&table->buckets[i]); node; node = atomic_load(&node->next)) {
+            apply(info, atomic_load(&node->item));
+        }
+    }
+
+    _BRConcurrentSetReadEnd(set, epoch);
+}
+
+// frees memory allocated for set, which must no longer be in use by any other thread
+void BRConcurrentSetFree(BRConcurrentSet *set)
+{
+    assert(set != NULL);
+    _BRConcurrentSetCollect(set);
+    _BRConcurrentSetTableFree(atomic_load(&set->table));
+    for (size_t i = 0; i < CSET_STRIPES; i++) pthread_mutex_destroy(&set->stripes[i]);
+    pthread_mutex_destroy(&set->resizeLock);
+    pthread_mutex_destroy(&set->garbageLock);
+    free(set);
+}
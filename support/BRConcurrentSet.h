@@ -0,0 +1,88 @@
+//
+//  BRConcurrentSet.h
+//
+//  Copyright (c) 2019 breadwallet LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef BRConcurrentSet_h
+#define BRConcurrentSet_h
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// a set that may be shared between threads without an external lock, for read-mostly indexes
+// lookups never take a lock, and writers only lock the stripe of the table their item hashes to, except to resize
+// items removed or replaced may still be passed to eq() by lookups already in progress, so an item must not be freed
+// until no thread could still be looking it up, which BRConcurrentSetRemoveAndFree() and BRConcurrentSetAddAndFree()
+// take care of
+typedef struct BRConcurrentSetStruct BRConcurrentSet;
+
+// retruns a newly allocated empty set that must be freed by calling BRConcurrentSetFree()
+// hash, eq and capacity are the same as for BRSetNew()
+BRConcurrentSet *BRConcurrentSetNew(size_t (*hash)(const void *), int (*eq)(const void *, const void *),
+                                    size_t capacity);
+
+// adds given item to set or replaces an equivalent existing item and returns item replaced if any
+// like a removed item, the item replaced may still be passed to eq() by lookups already in progress
+void *BRConcurrentSetAdd(BRConcurrentSet *set, void *item);
+
+// adds given item to set, or replaces an equivalent existing item and calls itemFree() with it once no lookup could
+// still be using it
+// returns true if an item was replaced
+int BRConcurrentSetAddAndFree(BRConcurrentSet *set, void *item, void (*itemFree)(void *item));
+
+// removes item equivalent to given item from set and returns item removed if any
+void *BRConcurrentSetRemove(BRConcurrentSet *set, const void *item);
+
+// removes item equivalent to given item from set, and calls itemFree() with it once no lookup could still be using it
+// returns true if an item was removed
+int BRConcurrentSetRemoveAndFree(BRConcurrentSet *set, const void *item, void (*itemFree)(void *item));
+
+// returns the number of items in set
+size_t BRConcurrentSetCount(const BRConcurrentSet *set);
+
+// true if an item equivalant to the given item is contained in set
+int BRConcurrentSetContains(BRConcurrentSet *set, const void *item);
+
+// returns member item from set equivalent to given item, or NULL if there is none
+// the caller must ensure the item isn't freed by another thread while it's still using it
+void *BRConcurrentSetGet(BRConcurrentSet *set, const void *item);
+
+// returns get() called with the member item from set equivalent to given item, or NULL if there is none
+// get() is called before the item could be freed by BRConcurrentSetRemoveAndFree() or BRConcurrentSetAddAndFree(), so
+// it may read through an item that writers free that way, but must not modify set
+void *BRConcurrentSetGetWith(BRConcurrentSet *set, const void *item, void *(*get)(void *item));
+
+// calls apply() with each item in set, apply() must not modify set
+// items added or removed by other threads while apply() is being called may or may not be included
+void BRConcurrentSetApply(BRConcurrentSet *set, void *info, void (*apply)(void *info, void *item));
+
+// frees memory allocated for set, which must no longer be in use by any other thread
+void BRConcurrentSetFree(BRConcurrentSet *set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BRConcurrentSet_h
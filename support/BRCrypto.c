@@ -26,6 +26,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define SCRYPT_MAX_THREADS 16
 
 // endian swapping
 #if __BIG_ENDIAN__ || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
@@ -110,19 +114,20 @@ void BRSHA1(void *md20, const void *data, size_t dataLen)
 #define s2(x) (ror32((x), 7) ^ ror32((x), 18) ^ ((x) >> 3))
 #define s3(x) (ror32((x), 17) ^ ror32((x), 19) ^ ((x) >> 10))
 
-static void _BRSHA256Compress(uint32_t *r, const uint32_t *x)
+static const uint32_t _sha256K[] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// portable sha256 compression function
+static void _BRSHA256CompressC(uint32_t *r, const uint32_t *x)
 {
-    static const uint32_t k[] = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-    };
-    
     int i;
     uint32_t a = r[0], b = r[1], c = r[2], d = r[3], e = r[4], f = r[5], g = r[6], h = r[7], t1, t2, w[64];
     
@@ -130,7 +135,7 @@ static void _BRSHA256Compress(uint32_t *r, const uint32_t *x)
     for (; i < 64; i++) w[i] = s3(w[i - 2]) + w[i - 7] + s2(w[i - 15]) + w[i - 16];
     
     for (i = 0; i < 64; i++) {
-        t1 = h + s1(e) + ch(e, f, g) + k[i] + w[i];
+        t1 = h + s1(e) + ch(e, f, g) + _sha256K[i] + w[i];
         t2 = s0(a) + maj(a, b, c);
         h = g, g = f, f = e, e = d + t1, d = c, c = b, b = a, a = t1 + t2;
     }
@@ -140,6 +145,146 @@ static void _BRSHA256Compress(uint32_t *r, const uint32_t *x)
     mem_clean(w, sizeof(w));
 }
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BR_SHA256_SHANI 1
+#include <immintrin.h>
+#include <cpuid.h>
+
+// sha256 compression function using intel sha extensions (sha-ni)
+// based on the public domain reference code from the intel sha extensions whitepaper
+__attribute__((target("sha,sse4.1,ssse3")))
+static void _BRSHA256CompressSHANI(uint32_t *r, const uint32_t *x)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i s0, s1, t, msg, abef, cdgh, m[4];
+    int i;
+    
+    t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&r[0]), 0xb1);  // cdab
+    s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&r[4]), 0x1b); // efgh
+    s0 = _mm_alignr_epi8(t, s1, 8);                                         // abef
+    s1 = _mm_blend_epi16(s1, t, 0xf0);                                      // cdgh
+    abef = s0, cdgh = s1;
+    
+    for (i = 0; i < 4; i++) m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&x[i*4]), mask);
+    
+    for (i = 0; i < 16; i++) { // 16 groups of 4 rounds, the message schedule is rotated through m[0..3]
+        msg = _mm_add_epi32(m[i % 4], _mm_loadu_si128((const __m128i *)&_sha256K[i*4]));
+        s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+        
+        if (i >= 3 && i < 15) {
+            t = _mm_alignr_epi8(m[i % 4], m[(i + 3) % 4], 4);
+            m[(i + 1) % 4] = _mm_sha256msg2_epu32(_mm_add_epi32(m[(i + 1) % 4], t), m[i % 4]);
+        }
+        
+        s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(msg, 0x0e));
+        if (i >= 1 && i < 13) m[(i + 3) % 4] = _mm_sha256msg1_epu32(m[(i + 3) % 4], m[i % 4]);
+    }
+    
+    s0 = _mm_add_epi32(s0, abef);
+    s1 = _mm_add_epi32(s1, cdgh);
+    t = _mm_shuffle_epi32(s0, 0x1b);   // feba
+    s1 = _mm_shuffle_epi32(s1, 0xb1);  // dchg
+    _mm_storeu_si128((__m128i *)&r[0], _mm_blend_epi16(t, s1, 0xf0)); // dcba
+    _mm_storeu_si128((__m128i *)&r[4], _mm_alignr_epi8(s1, t, 8));    // hgfe
+}
+
+static int _BRSHA256SHANIIsSupported(void)
+{
+    unsigned a, b, c, d;
+    
+    if (__get_cpuid_max(0, NULL) < 7) return 0;
+    __cpuid(1, a, b, c, d);
+    if ((c & (1 << 9)) == 0 || (c & (1 << 19)) == 0) return 0; // ssse3, sse4.1
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b & (1 << 29)) != 0; // sha
+}
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+#define BR_SHA256_ARMV8 1
+#include <arm_neon.h>
+
+// sha256 compression function using armv8 cryptography extensions
+static void _BRSHA256CompressARMv8(uint32_t *r, const uint32_t *x)
+{
+    uint32x4_t s0 = vld1q_u32(&r[0]), s1 = vld1q_u32(&r[4]), abcd = s0, efgh = s1, t, t2, m[4];
+    int i;
+    
+    for (i = 0; i < 4; i++) m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8((const uint8_t *)&x[i*4])));
+    
+    for (i = 0; i < 16; i++) { // 16 groups of 4 rounds, the message schedule is rotated through m[0..3]
+        t = vaddq_u32(m[i % 4], vld1q_u32(&_sha256K[i*4]));
+        if (i < 12) m[i % 4] = vsha256su0q_u32(m[i % 4], m[(i + 1) % 4]);
+        t2 = s0;
+        s0 = vsha256hq_u32(s0, s1, t);
+        s1 = vsha256h2q_u32(s1, t2, t);
+        if (i < 12) m[i % 4] = vsha256su1q_u32(m[i % 4], m[(i + 2) % 4], m[(i + 3) % 4]);
+    }
+    
+    vst1q_u32(&r[0], vaddq_u32(s0, abcd));
+    vst1q_u32(&r[4], vaddq_u32(s1, efgh));
+}
+#endif
+
+static void _BRSHA256CompressInit(uint32_t *r, const uint32_t *x);
+
+// sha256 compression backend, selected on first use from the best implementation supported by the cpu
+// NOTE: concurrent first calls may each run the selection, but they always store the same function pointer
+static void (*volatile _BRSHA256Compress)(uint32_t *r, const uint32_t *x) = _BRSHA256CompressInit;
+static const char *_BRSHA256BackendName = "portable";
+
+static void _BRSHA256CompressInit(uint32_t *r, const uint32_t *x)
+{
+    void (*compress)(uint32_t *, const uint32_t *) = _BRSHA256CompressC;
+    
+#if BR_SHA256_SHANI
+    if (_BRSHA256SHANIIsSupported()) compress = _BRSHA256CompressSHANI, _BRSHA256BackendName = "sha-ni";
+#elif BR_SHA256_ARMV8
+    compress = _BRSHA256CompressARMv8, _BRSHA256BackendName = "armv8";
+#endif
+    _BRSHA256Compress = compress;
+    compress(r, x);
+}
+
+// returns the name of the sha-256 compression backend in use: "portable", "sha-ni" or "armv8"
+const char *BRSHA256Backend(void)
+{
+    uint32_t r[8] = { 0, 0, 0, 0, 0, 0, 0, 0 }, x[16] = { 0 };
+    
+    if (_BRSHA256Compress == _BRSHA256CompressInit) _BRSHA256Compress(r, x); // force backend selection
+    return _BRSHA256BackendName;
+}
+
+// compares every sha-256 backend supported by the cpu against the portable implementation over a range of pseudo
+// random blocks and chained states, returns true if all backends agree
+int BRSHA256SelfTest(void)
+{
+    void (*backends[2])(uint32_t *, const uint32_t *);
+    uint32_t x[16], r1[8], r2[8], seed = 0x811c9dc5;
+    size_t i, j, n, count = 0;
+    int ok = 1;
+    
+#if BR_SHA256_SHANI
+    if (_BRSHA256SHANIIsSupported()) backends[count++] = _BRSHA256CompressSHANI;
+#endif
+#if BR_SHA256_ARMV8
+    backends[count++] = _BRSHA256CompressARMv8;
+#endif
+    
+    for (n = 0; n < count; n++) {
+        for (i = 0; i < 8; i++) r1[i] = r2[i] = (seed = seed*0x01000193 + 0x9e3779b9);
+        
+        for (i = 0; i < 256 && ok; i++) { // chain the state through each block so errors accumulate
+            for (j = 0; j < 16; j++) x[j] = (i & 1) ? (seed = seed*0x01000193 + 0x9e3779b9) : (uint32_t)(i*j);
+            _BRSHA256CompressC(r1, x);
+            backends[n](r2, x);
+            if (memcmp(r1, r2, sizeof(r1)) != 0) ok = 0;
+        }
+    }
+    
+    return ok;
+}
+
 void BRSHA224(void *md28, const void *data, size_t dataLen) {
     size_t i;
     uint32_t x[16], buf[] = { 0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939, 0xffc00b31, 0x68581511,
@@ -191,6 +336,60 @@ void BRSHA256(void *md32, const void *data, size_t dataLen)
     mem_clean(buf, sizeof(buf));
 }
 
+void BRSHA256Init(BRSHA256Context *ctx)
+{
+    static const uint32_t iv[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                   0x1f83d9ab, 0x5be0cd19 }; // initial buffer values
+    
+    assert(ctx != NULL);
+    memcpy(ctx->buf, iv, sizeof(iv));
+    ctx->dataLen = 0;
+}
+
+void BRSHA256Update(BRSHA256Context *ctx, const void *data, size_t dataLen)
+{
+    size_t i = 0, n;
+    
+    assert(ctx != NULL);
+    assert(data != NULL || dataLen == 0);
+    
+    n = (size_t)(ctx->dataLen % 64);
+    ctx->dataLen += dataLen;
+    
+    if (n > 0) { // complete the block held back by the previous update
+        i = (dataLen < 64 - n) ? dataLen : 64 - n;
+        memcpy((uint8_t *)ctx->x + n, data, i);
+        if (n + i < 64) return;
+        _BRSHA256Compress(ctx->buf, ctx->x);
+    }
+    
+    for (; i + 64 <= dataLen; i += 64) { // process data in 64 byte blocks
+        memcpy(ctx->x, (const uint8_t *)data + i, 64);
+        _BRSHA256Compress(ctx->buf, ctx->x);
+    }
+    
+    memcpy(ctx->x, (const uint8_t *)data + i, dataLen - i);
+}
+
+// writes the sha-256 of all data added to ctx, and cleans ctx
+void BRSHA256Final(BRSHA256Context *ctx, void *md32)
+{
+    size_t i, n;
+    
+    assert(ctx != NULL);
+    assert(md32 != NULL);
+    
+    n = (size_t)(ctx->dataLen % 64);
+    memset((uint8_t *)ctx->x + n, 0, 64 - n); // clear remainder of x
+    ((uint8_t *)ctx->x)[n] = 0x80; // append padding
+    if (n >= 56) _BRSHA256Compress(ctx->buf, ctx->x), memset(ctx->x, 0, 64); // length goes to next block
+    ctx->x[14] = be32((uint32_t)(ctx->dataLen >> 29)), ctx->x[15] = be32((uint32_t)(ctx->dataLen << 3)); // length
+    _BRSHA256Compress(ctx->buf, ctx->x); // finalize
+    for (i = 0; i < 8; i++) ctx->buf[i] = be32(ctx->buf[i]); // endian swap
+    memcpy(md32, ctx->buf, 32); // write to md
+    mem_clean(ctx, sizeof(*ctx));
+}
+
 // double-sha-256 = sha-256(sha-256(x))
 void BRSHA256_2(void *md32, const void *data, size_t dataLen)
 {
@@ -202,6 +401,168 @@ void BRSHA256_2(void *md32, const void *data, size_t dataLen)
     BRSHA256(md32, t, sizeof(t));
 }
 
+#if BR_SHA256_SHANI
+#define BR_SHA256_LANES        8
+#define BR_SHA256_LANES_TARGET __attribute__((target("avx2")))
+#define _BRSHA256LanesIsSupported() __builtin_cpu_supports("avx2")
+#elif defined(__aarch64__) && defined(__ARM_NEON) && (defined(__GNUC__) || defined(__clang__))
+#define BR_SHA256_LANES        4
+#define BR_SHA256_LANES_TARGET
+#define _BRSHA256LanesIsSupported() 1
+#endif
+
+#ifdef BR_SHA256_LANES
+typedef uint32_t _BRSHA256Vec __attribute__((vector_size(BR_SHA256_LANES*sizeof(uint32_t))));
+
+// writes block b of the sha256 padded message data to lane l of the transposed message words x
+static void _BRSHA256LaneBlock(uint32_t x[16][BR_SHA256_LANES], size_t l, const uint8_t *data, size_t dataLen,
+                               size_t b)
+{
+    uint8_t buf[64];
+    size_t i, off = b*64;
+    
+    memset(buf, 0, sizeof(buf));
+    if (off < dataLen) memcpy(buf, &data[off], (dataLen - off < 64) ? dataLen - off : 64);
+    if (dataLen >= off && dataLen < off + 64) buf[dataLen - off] = 0x80; // append padding
+    
+    if ((dataLen + 9 + 63)/64 == b + 1) { // last block, append length in bits
+        for (i = 0; i < 8; i++) buf[63 - i] = (uint8_t)(((uint64_t)dataLen << 3) >> i*8);
+    }
+    
+    for (i = 0; i < 16; i++) {
+        x[i][l] = ((uint32_t)buf[i*4] << 24) | ((uint32_t)buf[i*4 + 1] << 16) | ((uint32_t)buf[i*4 + 2] << 8) |
+                  buf[i*4 + 3];
+    }
+}
+
+// sha256 compression of BR_SHA256_LANES independent states, one per vector lane
+BR_SHA256_LANES_TARGET
+static void _BRSHA256CompressLanes(_BRSHA256Vec *r, const _BRSHA256Vec *x)
+{
+    _BRSHA256Vec a = r[0], b = r[1], c = r[2], d = r[3], e = r[4], f = r[5], g = r[6], h = r[7], t1, t2, w[64];
+    int i;
+    
+    for (i = 0; i < 16; i++) w[i] = x[i];
+    for (; i < 64; i++) w[i] = s3(w[i - 2]) + w[i - 7] + s2(w[i - 15]) + w[i - 16];
+    
+    for (i = 0; i < 64; i++) {
+        t1 = h + s1(e) + ch(e, f, g) + _sha256K[i] + w[i];
+        t2 = s0(a) + maj(a, b, c);
+        h = g, g = f, f = e, e = d + t1, d = c, c = b, b = a, a = t1 + t2;
+    }
+    
+    r[0] += a, r[1] += b, r[2] += c, r[3] += d, r[4] += e, r[5] += f, r[6] += g, r[7] += h;
+}
+
+static const uint32_t _sha256IV[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                      0x1f83d9ab, 0x5be0cd19 }; // initial buffer values
+
+// sha-256 of BR_SHA256_LANES independent messages, processed in lockstep with one message per vector lane, leaves the
+// final states in r, with the digest words in host byte order
+BR_SHA256_LANES_TARGET
+static void _BRSHA256Lanes(_BRSHA256Vec r[8], const void *datas[], const size_t lens[])
+{
+    _BRSHA256Vec t[8], w[16], mask;
+    uint32_t x[16][BR_SHA256_LANES], active[BR_SHA256_LANES];
+    size_t i, l, b, blocks[BR_SHA256_LANES], maxBlocks = 0;
+    
+    for (l = 0; l < BR_SHA256_LANES; l++) {
+        blocks[l] = (lens[l] + 9 + 63)/64;
+        if (blocks[l] > maxBlocks) maxBlocks = blocks[l];
+    }
+    
+    for (i = 0; i < 8; i++) r[i] = (_BRSHA256Vec){ 0 } + _sha256IV[i];
+    
+    for (b = 0; b < maxBlocks; b++) {
+        for (l = 0; l < BR_SHA256_LANES; l++) {
+            active[l] = (b < blocks[l]) ? 0xffffffff : 0;
+            if (active[l]) _BRSHA256LaneBlock(x, l, datas[l], lens[l], b);
+            else for (i = 0; i < 16; i++) x[i][l] = 0;
+        }
+        
+        memcpy(w, x, sizeof(w));
+        memcpy(&mask, active, sizeof(mask));
+        memcpy(t, r, sizeof(t));
+        _BRSHA256CompressLanes(t, w);
+        for (i = 0; i < 8; i++) r[i] = (t[i] & mask) | (r[i] & ~mask); // lanes past their last block keep their state
+    }
+    
+    mem_clean(x, sizeof(x));
+    mem_clean(w, sizeof(w));
+}
+
+// double-sha-256 of BR_SHA256_LANES independent messages, processed in lockstep with one message per vector lane
+BR_SHA256_LANES_TARGET
+static void _BRSHA256_2Lanes(void *md32s[], const void *datas[], const size_t lens[])
+{
+    _BRSHA256Vec r[8], w[16];
+    uint32_t md[8];
+    size_t i, l;
+    
+    _BRSHA256Lanes(r, datas, lens);
+    
+    // the second hash is a single block: the first digest, padding, and a length of 256 bits
+    for (i = 0; i < 8; i++) w[i] = r[i], r[i] = (_BRSHA256Vec){ 0 } + _sha256IV[i];
+    w[8] = (_BRSHA256Vec){ 0 } + 0x80000000;
+    for (i = 9; i < 15; i++) w[i] = (_BRSHA256Vec){ 0 };
+    w[15] = (_BRSHA256Vec){ 0 } + 256;
+    _BRSHA256CompressLanes(r, w);
+    
+    for (l = 0; l < BR_SHA256_LANES; l++) {
+        for (i = 0; i < 8; i++) md[i] = be32(r[i][l]); // endian swap
+        memcpy(md32s[l], md, 32); // write to md
+    }
+    
+    mem_clean(w, sizeof(w));
+}
+
+// hashes count messages with lanes(), BR_SHA256_LANES at a time, filling the unused lanes of a final partial group
+// with empty messages if it's at least half full, returns the number of messages hashed
+static size_t _BRSHA256LanesBatch(void (*lanes)(void *mds[], const void *datas[], const size_t lens[]), void *mds[],
+                                  const void *datas[], const size_t lens[], size_t count)
+{
+    size_t i = 0;
+    
+    if (count < BR_SHA256_LANES/2 || ! _BRSHA256LanesIsSupported()) return 0;
+    for (; i + BR_SHA256_LANES <= count; i += BR_SHA256_LANES) lanes(&mds[i], &datas[i], &lens[i]);
+    
+    if (count - i >= BR_SHA256_LANES/2) {
+        uint8_t dummy[32];
+        void *m[BR_SHA256_LANES];
+        const void *d[BR_SHA256_LANES];
+        size_t ls[BR_SHA256_LANES], l;
+        
+        for (l = 0; l < BR_SHA256_LANES; l++) {
+            m[l] = (i + l < count) ? mds[i + l] : dummy;
+            d[l] = (i + l < count) ? datas[i + l] : dummy;
+            ls[l] = (i + l < count) ? lens[i + l] : 0;
+        }
+        
+        lanes(m, d, ls);
+        i = count;
+    }
+    
+    return i;
+}
+#endif
+
+// double-sha-256 of count independent messages, md32s[i] = sha-256(sha-256(datas[i])), hashing as many messages at
+// a time as the cpu has vector lanes for (8 with avx2, 4 with neon), or one at a time if none are available
+void BRSHA256_2Batch(void *md32s[], const void *datas[], const size_t lens[], size_t count)
+{
+    size_t i = 0;
+    
+    assert(md32s != NULL || count == 0);
+    assert(datas != NULL || count == 0);
+    assert(lens != NULL || count == 0);
+    
+#ifdef BR_SHA256_LANES
+    i = _BRSHA256LanesBatch(_BRSHA256_2Lanes, md32s, datas, lens, count);
+#endif
+    
+    for (; i < count; i++) BRSHA256_2(md32s[i], datas[i], lens[i]);
+}
+
 // bitwise right rotation
 #define ror64(a, b) (((a) >> (b)) | ((a) << (64 - (b))))
 
@@ -211,27 +572,27 @@ void BRSHA256_2(void *md32, const void *data, size_t dataLen)
 #define S2(x) (ror64((x), 1) ^ ror64((x), 8) ^ ((x) >> 7))
 #define S3(x) (ror64((x), 19) ^ ror64((x), 61) ^ ((x) >> 6))
 
+static const uint64_t _sha512K[] = {
+    0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
+    0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
+    0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
+    0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+    0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
+    0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+    0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
+    0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+    0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
+    0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
+    0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
+    0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+    0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
+    0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
+    0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
+    0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
+};
+
 static void _BRSHA512Compress(uint64_t *r, const uint64_t *x)
 {
-    static const uint64_t k[] = {
-        0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
-        0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
-        0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
-        0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
-        0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
-        0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
-        0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
-        0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
-        0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
-        0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
-        0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
-        0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
-        0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
-        0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
-        0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
-        0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
-    };
-    
     int i;
     uint64_t a = r[0], b = r[1], c = r[2], d = r[3], e = r[4], f = r[5], g = r[6], h = r[7], t1, t2, w[80];
     
@@ -239,7 +600,7 @@ static void _BRSHA512Compress(uint64_t *r, const uint64_t *x)
     for (; i < 80; i++) w[i] = S3(w[i - 2]) + w[i - 7] + S2(w[i - 15]) + w[i - 16];
     
     for (i = 0; i < 80; i++) {
-        t1 = h + S1(e) + ch(e, f, g) + k[i] + w[i];
+        t1 = h + S1(e) + ch(e, f, g) + _sha512K[i] + w[i];
         t2 = S0(a) + maj(a, b, c);
         h = g, g = f, f = e, e = d + t1, d = c, c = b, b = a, a = t1 + t2;
     }
@@ -301,6 +662,94 @@ void BRSHA512(void *md64, const void *data, size_t dataLen)
     mem_clean(buf, sizeof(buf));
 }
 
+void BRSHA512Init(BRSHA512Context *ctx)
+{
+    static const uint64_t iv[] = { 0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+                                   0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179 };
+    
+    assert(ctx != NULL);
+    memcpy(ctx->buf, iv, sizeof(iv));
+    ctx->dataLen = 0;
+}
+
+void BRSHA512Update(BRSHA512Context *ctx, const void *data, size_t dataLen)
+{
+    size_t i = 0, n;
+    
+    assert(ctx != NULL);
+    assert(data != NULL || dataLen == 0);
+    
+    n = (size_t)(ctx->dataLen % 128);
+    ctx->dataLen += dataLen;
+    
+    if (n > 0) { // complete the block held back by the previous update
+        i = (dataLen < 128 - n) ? dataLen : 128 - n;
+        memcpy((uint8_t *)ctx->x + n, data, i);
+        if (n + i < 128) return;
+        _BRSHA512Compress(ctx->buf, ctx->x);
+    }
+    
+    for (; i + 128 <= dataLen; i += 128) { // process data in 128 byte blocks
+        memcpy(ctx->x, (const uint8_t *)data + i, 128);
+        _BRSHA512Compress(ctx->buf, ctx->x);
+    }
+    
+    memcpy(ctx->x, (const uint8_t *)data + i, dataLen - i);
+}
+
+// writes the sha-512 of all data added to ctx, and cleans ctx
+void BRSHA512Final(BRSHA512Context *ctx, void *md64)
+{
+    size_t i, n;
+    
+    assert(ctx != NULL);
+    assert(md64 != NULL);
+    
+    n = (size_t)(ctx->dataLen % 128);
+    memset((uint8_t *)ctx->x + n, 0, 128 - n); // clear remainder of x
+    ((uint8_t *)ctx->x)[n] = 0x80; // append padding
+    if (n >= 112) _BRSHA512Compress(ctx->buf, ctx->x), memset(ctx->x, 0, 128); // length goes to next block
+    ctx->x[14] = be64(ctx->dataLen >> 61), ctx->x[15] = be64(ctx->dataLen << 3); // append length in bits
+    _BRSHA512Compress(ctx->buf, ctx->x); // finalize
+    for (i = 0; i < 8; i++) ctx->buf[i] = be64(ctx->buf[i]); // endian swap
+    memcpy(md64, ctx->buf, 64); // write to md
+    mem_clean(ctx, sizeof(*ctx));
+}
+
+#if BR_SHA256_SHANI
+#define BR_SHA512_LANES        4
+#define BR_SHA512_LANES_TARGET __attribute__((target("avx2")))
+#define _BRSHA512LanesIsSupported() __builtin_cpu_supports("avx2")
+#elif defined(__aarch64__) && defined(__ARM_NEON) && (defined(__GNUC__) || defined(__clang__))
+#define BR_SHA512_LANES        2
+#define BR_SHA512_LANES_TARGET
+#define _BRSHA512LanesIsSupported() 1
+#endif
+
+#ifdef BR_SHA512_LANES
+typedef uint64_t _BRSHA512Vec __attribute__((vector_size(BR_SHA512_LANES*sizeof(uint64_t))));
+
+// sha512 compression of BR_SHA512_LANES independent states, one per vector lane, with message words in host byte order
+BR_SHA512_LANES_TARGET
+static void _BRSHA512CompressLanes(_BRSHA512Vec *r, const _BRSHA512Vec *x)
+{
+    _BRSHA512Vec a = r[0], b = r[1], c = r[2], d = r[3], e = r[4], f = r[5], g = r[6], h = r[7], t1, t2, w[80];
+    int i;
+    
+    for (i = 0; i < 16; i++) w[i] = x[i];
+    for (; i < 80; i++) w[i] = S3(w[i - 2]) + w[i - 7] + S2(w[i - 15]) + w[i - 16];
+    
+    for (i = 0; i < 80; i++) {
+        t1 = h + S1(e) + ch(e, f, g) + _sha512K[i] + w[i];
+        t2 = S0(a) + maj(a, b, c);
+        h = g, g = f, f = e, e = d + t1, d = c, c = b, b = a, a = t1 + t2;
+    }
+    
+    r[0] += a, r[1] += b, r[2] += c, r[3] += d, r[4] += e, r[5] += f, r[6] += g, r[7] += h;
+    mem_clean(w, sizeof(w));
+}
+#endif
+
 // basic ripemd functions
 #define f(x, y, z) ((x) ^ (y) ^ (z))
 #define g(x, y, z) (((x) & (y)) | (~(x) & (z)))
@@ -312,33 +761,33 @@ void BRSHA512(void *md64, const void *data, size_t dataLen)
 #define rmd(a, b, c, d, e, f, g, h, i, j) ((a) = rol32((f) + (b) + le32(c) + (d), (e)) + (g), (f) = (g), (g) = (h),\
                                            (h) = rol32((i), 10), (i) = (j), (j) = (a))
 
+// left line
+static const int rl1[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 }, // round 1, id
+                 rl2[] = { 7, 4, 13, 1, 10, 6, 15, 3, 12, 0, 9, 5, 2, 14, 11, 8 }, // round 2, rho
+                 rl3[] = { 3, 10, 14, 4, 9, 15, 8, 1, 2, 7, 0, 6, 13, 11, 5, 12 }, // round 3, rho^2
+                 rl4[] = { 1, 9, 11, 10, 0, 8, 12, 4, 13, 3, 7, 15, 14, 5, 6, 2 }, // round 4, rho^3
+                 rl5[] = { 4, 0, 5, 9, 7, 12, 2, 10, 14, 1, 3, 8, 11, 6, 15, 13 }; // round 5, rho^4
+// right line
+static const int rr1[] = { 5, 14, 7, 0, 9, 2, 11, 4, 13, 6, 15, 8, 1, 10, 3, 12 }, // round 1, pi
+                 rr2[] = { 6, 11, 3, 7, 0, 13, 5, 10, 14, 15, 8, 12, 4, 9, 1, 2 }, // round 2, rho pi
+                 rr3[] = { 15, 5, 1, 3, 7, 14, 6, 9, 11, 8, 12, 2, 10, 0, 4, 13 }, // round 3, rho^2 pi
+                 rr4[] = { 8, 6, 4, 1, 3, 11, 15, 0, 5, 12, 2, 13, 9, 7, 10, 14 }, // round 4, rho^3 pi
+                 rr5[] = { 12, 15, 10, 4, 1, 5, 8, 7, 6, 2, 13, 14, 0, 3, 9, 11 }; // round 5, rho^4 pi
+// left line shifts
+static const int sl1[] = { 11, 14, 15, 12, 5, 8, 7, 9, 11, 13, 14, 15, 6, 7, 9, 8 }, // round 1
+                 sl2[] = { 7, 6, 8, 13, 11, 9, 7, 15, 7, 12, 15, 9, 11, 7, 13, 12 }, // round 2
+                 sl3[] = { 11, 13, 6, 7, 14, 9, 13, 15, 14, 8, 13, 6, 5, 12, 7, 5 }, // round 3
+                 sl4[] = { 11, 12, 14, 15, 14, 15, 9, 8, 9, 14, 5, 6, 8, 6, 5, 12 }, // round 4
+                 sl5[] = { 9, 15, 5, 11, 6, 8, 13, 12, 5, 12, 13, 14, 11, 8, 5, 6 }; // round 5
+// right line shifts
+static const int sr1[] = { 8, 9, 9, 11, 13, 15, 15, 5, 7, 7, 8, 11, 14, 14, 12, 6 }, // round 1
+                 sr2[] = { 9, 13, 15, 7, 12, 8, 9, 11, 7, 7, 12, 7, 6, 15, 13, 11 }, // round 2
+                 sr3[] = { 9, 7, 15, 11, 8, 6, 6, 14, 12, 13, 5, 14, 13, 13, 7, 5 }, // round 3
+                 sr4[] = { 15, 5, 8, 11, 14, 14, 6, 14, 6, 9, 12, 9, 12, 5, 15, 8 }, // round 4
+                 sr5[] = { 8, 5, 12, 9, 12, 5, 14, 6, 8, 13, 6, 5, 15, 13, 11, 11 }; // round 5
+
 static void _BRRMDCompress(uint32_t *r, const uint32_t *x)
 {
-    // left line
-    static const int rl1[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 }, // round 1, id
-                     rl2[] = { 7, 4, 13, 1, 10, 6, 15, 3, 12, 0, 9, 5, 2, 14, 11, 8 }, // round 2, rho
-                     rl3[] = { 3, 10, 14, 4, 9, 15, 8, 1, 2, 7, 0, 6, 13, 11, 5, 12 }, // round 3, rho^2
-                     rl4[] = { 1, 9, 11, 10, 0, 8, 12, 4, 13, 3, 7, 15, 14, 5, 6, 2 }, // round 4, rho^3
-                     rl5[] = { 4, 0, 5, 9, 7, 12, 2, 10, 14, 1, 3, 8, 11, 6, 15, 13 }; // round 5, rho^4
-    // right line
-    static const int rr1[] = { 5, 14, 7, 0, 9, 2, 11, 4, 13, 6, 15, 8, 1, 10, 3, 12 }, // round 1, pi
-                     rr2[] = { 6, 11, 3, 7, 0, 13, 5, 10, 14, 15, 8, 12, 4, 9, 1, 2 }, // round 2, rho pi
-                     rr3[] = { 15, 5, 1, 3, 7, 14, 6, 9, 11, 8, 12, 2, 10, 0, 4, 13 }, // round 3, rho^2 pi
-                     rr4[] = { 8, 6, 4, 1, 3, 11, 15, 0, 5, 12, 2, 13, 9, 7, 10, 14 }, // round 4, rho^3 pi
-                     rr5[] = { 12, 15, 10, 4, 1, 5, 8, 7, 6, 2, 13, 14, 0, 3, 9, 11 }; // round 5, rho^4 pi
-    // left line shifts
-    static const int sl1[] = { 11, 14, 15, 12, 5, 8, 7, 9, 11, 13, 14, 15, 6, 7, 9, 8 }, // round 1
-                     sl2[] = { 7, 6, 8, 13, 11, 9, 7, 15, 7, 12, 15, 9, 11, 7, 13, 12 }, // round 2
-                     sl3[] = { 11, 13, 6, 7, 14, 9, 13, 15, 14, 8, 13, 6, 5, 12, 7, 5 }, // round 3
-                     sl4[] = { 11, 12, 14, 15, 14, 15, 9, 8, 9, 14, 5, 6, 8, 6, 5, 12 }, // round 4
-                     sl5[] = { 9, 15, 5, 11, 6, 8, 13, 12, 5, 12, 13, 14, 11, 8, 5, 6 }; // round 5
-    // right line shifts
-    static const int sr1[] = { 8, 9, 9, 11, 13, 15, 15, 5, 7, 7, 8, 11, 14, 14, 12, 6 }, // round 1
-                     sr2[] = { 9, 13, 15, 7, 12, 8, 9, 11, 7, 7, 12, 7, 6, 15, 13, 11 }, // round 2
-                     sr3[] = { 9, 7, 15, 11, 8, 6, 6, 14, 12, 13, 5, 14, 13, 13, 7, 5 }, // round 3
-                     sr4[] = { 15, 5, 8, 11, 14, 14, 6, 14, 6, 9, 12, 9, 12, 5, 15, 8 }, // round 4
-                     sr5[] = { 8, 5, 12, 9, 12, 5, 14, 6, 8, 13, 6, 5, 15, 13, 11, 11 }; // round 5
-
     int i;
     uint32_t al = r[0], bl = r[1], cl = r[2], dl = r[3], el = r[4], ar = al, br = bl, cr = cl, dr = dl, er = el, t;
     
@@ -384,6 +833,59 @@ void BRRMD160(void *md20, const void *data, size_t dataLen)
     mem_clean(buf, sizeof(buf));
 }
 
+void BRRMD160Init(BRRMD160Context *ctx)
+{
+    static const uint32_t iv[] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 }; // initial values
+    
+    assert(ctx != NULL);
+    memcpy(ctx->buf, iv, sizeof(iv));
+    ctx->dataLen = 0;
+}
+
+void BRRMD160Update(BRRMD160Context *ctx, const void *data, size_t dataLen)
+{
+    size_t i = 0, n;
+    
+    assert(ctx != NULL);
+    assert(data != NULL || dataLen == 0);
+    
+    n = (size_t)(ctx->dataLen % 64);
+    ctx->dataLen += dataLen;
+    
+    if (n > 0) { // complete the block held back by the previous update
+        i = (dataLen < 64 - n) ? dataLen : 64 - n;
+        memcpy((uint8_t *)ctx->x + n, data, i);
+        if (n + i < 64) return;
+        _BRRMDCompress(ctx->buf, ctx->x);
+    }
+    
+    for (; i + 64 <= dataLen; i += 64) { // process data in 64 byte blocks
+        memcpy(ctx->x, (const uint8_t *)data + i, 64);
+        _BRRMDCompress(ctx->buf, ctx->x);
+    }
+    
+    memcpy(ctx->x, (const uint8_t *)data + i, dataLen - i);
+}
+
+// writes the ripemd-160 of all data added to ctx, and cleans ctx
+void BRRMD160Final(BRRMD160Context *ctx, void *md20)
+{
+    size_t i, n;
+    
+    assert(ctx != NULL);
+    assert(md20 != NULL);
+    
+    n = (size_t)(ctx->dataLen % 64);
+    memset((uint8_t *)ctx->x + n, 0, 64 - n); // clear remainder of x
+    ((uint8_t *)ctx->x)[n] = 0x80; // append padding
+    if (n >= 56) _BRRMDCompress(ctx->buf, ctx->x), memset(ctx->x, 0, 64); // length goes to next block
+    ctx->x[14] = le32((uint32_t)(ctx->dataLen << 3)), ctx->x[15] = le32((uint32_t)(ctx->dataLen >> 29)); // length
+    _BRRMDCompress(ctx->buf, ctx->x); // finalize
+    for (i = 0; i < 5; i++) ctx->buf[i] = le32(ctx->buf[i]); // endian swap
+    memcpy(md20, ctx->buf, 20); // write to md
+    mem_clean(ctx, sizeof(*ctx));
+}
+
 // bitcoin hash-160 = ripemd-160(sha-256(x))
 void BRHash160(void *md20, const void *data, size_t datalen)
 {
@@ -396,58 +898,154 @@ void BRHash160(void *md20, const void *data, size_t datalen)
     BRRMD160(md20, t, sizeof(t));
 }
 
-// bitwise left rotation
-#define rol64(a, b) ((a) << (b) ^ ((a) >> (64 - (b))))
+#ifdef BR_SHA256_LANES
+// basic ripemd operation on vector lanes, with message words in host byte order
+#define rmdLanes(a, b, c, d, e, f, g, h, i, j) ((a) = rol32((f) + (b) + (c) + (d), (e)) + (g), (f) = (g), (g) = (h),\
+                                                (h) = rol32((i), 10), (i) = (j), (j) = (a))
 
-static void _BRSHA3Compress(uint64_t *r, const uint64_t *x, size_t blockSize)
+// ripemd-160 compression of BR_SHA256_LANES independent states, one per vector lane
+BR_SHA256_LANES_TARGET
+static void _BRRMDCompressLanes(_BRSHA256Vec *r, const _BRSHA256Vec *x)
 {
-    static const uint64_t k[] = { // keccak round constants
-        0x0000000000000001, 0x0000000000008082, 0x800000000000808a, 0x8000000080008000, 0x000000000000808b,
-        0x0000000080000001, 0x8000000080008081, 0x8000000000008009, 0x000000000000008a, 0x0000000000000088,
-        0x0000000080008009, 0x000000008000000a, 0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
-        0x8000000000008003, 0x8000000000008002, 0x8000000000000080, 0x000000000000800a, 0x800000008000000a,
-        0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008
-    };
+    _BRSHA256Vec al = r[0], bl = r[1], cl = r[2], dl = r[3], el = r[4], ar = al, br = bl, cr = cl, dr = dl, er = el, t;
+    int i;
     
-    size_t i, j;
-    uint64_t a[5], b[5], r0, r1;
+    for (i = 0; i < 16; i++) rmdLanes(t, f(bl, cl, dl), x[rl1[i]], 0x00000000, sl1[i], al, el, dl, cl, bl);
+    for (i = 0; i < 16; i++) rmdLanes(t, j(br, cr, dr), x[rr1[i]], 0x50a28be6, sr1[i], ar, er, dr, cr, br);
+    for (i = 0; i < 16; i++) rmdLanes(t, g(bl, cl, dl), x[rl2[i]], 0x5a827999, sl2[i], al, el, dl, cl, bl);
+    for (i = 0; i < 16; i++) rmdLanes(t, i(br, cr, dr), x[rr2[i]], 0x5c4dd124, sr2[i], ar, er, dr, cr, br);
+    for (i = 0; i < 16; i++) rmdLanes(t, h(bl, cl, dl), x[rl3[i]], 0x6ed9eba1, sl3[i], al, el, dl, cl, bl);
+    for (i = 0; i < 16; i++) rmdLanes(t, h(br, cr, dr), x[rr3[i]], 0x6d703ef3, sr3[i], ar, er, dr, cr, br);
+    for (i = 0; i < 16; i++) rmdLanes(t, i(bl, cl, dl), x[rl4[i]], 0x8f1bbcdc, sl4[i], al, el, dl, cl, bl);
+    for (i = 0; i < 16; i++) rmdLanes(t, g(br, cr, dr), x[rr4[i]], 0x7a6d76e9, sr4[i], ar, er, dr, cr, br);
+    for (i = 0; i < 16; i++) rmdLanes(t, j(bl, cl, dl), x[rl5[i]], 0xa953fd4e, sl5[i], al, el, dl, cl, bl);
+    for (i = 0; i < 16; i++) rmdLanes(t, f(br, cr, dr), x[rr5[i]], 0x00000000, sr5[i], ar, er, dr, cr, br);
     
-    for (i = 0; i < blockSize/sizeof(uint64_t); i++) r[i] ^= le64(x[i]);
+    t = r[1] + cl + dr; // final result for r[0]
+    r[1] = r[2] + dl + er, r[2] = r[3] + el + ar, r[3] = r[4] + al + br, r[4] = r[0] + bl + cr, r[0] = t; // combine
+}
+
+// hash-160 of BR_SHA256_LANES independent messages, processed in lockstep with one message per vector lane
+BR_SHA256_LANES_TARGET
+static void _BRHash160Lanes(void *md20s[], const void *datas[], const size_t lens[])
+{
+    static const uint32_t iv[] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 }; // initial values
+    _BRSHA256Vec r[8], x[16];
+    uint32_t md[5];
+    size_t i, l;
     
-    for (i = 0; i < 24; i++) { // permute r
-        // theta(r)
-        for (j = 0; j < 5; j++) a[j] = r[j] ^ r[j + 5] ^ r[j + 10] ^ r[j + 15] ^ r[j + 20];
-        b[0] = rol64(a[1], 1) ^ a[4], b[1] = rol64(a[2], 1) ^ a[0], b[2] = rol64(a[3], 1) ^ a[1];
-        b[3] = rol64(a[4], 1) ^ a[2], b[4] = rol64(a[0], 1) ^ a[3];
-        for (j = 0; j < 5; j++) r[j] ^= b[j], r[j + 5] ^= b[j], r[j + 10] ^= b[j], r[j + 15] ^= b[j], r[j + 20] ^= b[j];
-        
-        // rho(r)
-        r[1] = rol64(r[1], 1), r[2] = rol64(r[2], 62), r[3] = rol64(r[3], 28), r[4] = rol64(r[4], 27);
-        r[5] = rol64(r[5], 36), r[6] = rol64(r[6], 44), r[7] = rol64(r[7], 6), r[8] = rol64(r[8], 55);
-        r[9] = rol64(r[9], 20), r[10] = rol64(r[10], 3), r[11] = rol64(r[11], 10), r[12] = rol64(r[12], 43);
-        r[13] = rol64(r[13], 25), r[14] = rol64(r[14], 39), r[15] = rol64(r[15], 41), r[16] = rol64(r[16], 45);
-        r[17] = rol64(r[17], 15), r[18] = rol64(r[18], 21), r[19] = rol64(r[19], 8), r[20] = rol64(r[20], 18);
-        r[21] = rol64(r[21], 2), r[22] = rol64(r[22], 61), r[23] = rol64(r[23], 56), r[24] = rol64(r[24], 14);
-        
-        // pi(r)
-        r1 = r[1], r[1] = r[6], r[6] = r[9], r[9] = r[22], r[22] = r[14], r[14] = r[20], r[20] = r[2], r[2] = r[12],
-        r[12] = r[13], r[13] = r[19], r[19] = r[23], r[23] = r[15], r[15] = r[4], r[4] = r[24], r[24] = r[21];
-        r[21] = r[8], r[8] = r[16], r[16] = r[5], r[5] = r[3], r[3] = r[18], r[18] = r[17], r[17] = r[11], r[11] = r[7];
-        r[7] = r[10], r[10] = r1; // r[0] left as is
-        
-        for (j = 0; j < 25; j += 5) { // chi(r)
-            r0 = r[0 + j], r1 = r[1 + j], r[0 + j] ^= ~r1 & r[2 + j], r[1 + j] ^= ~r[2 + j] & r[3 + j];
-            r[2 + j] ^= ~r[3 + j] & r[4 + j], r[3 + j] ^= ~r[4 + j] & r0, r[4 + j] ^= ~r0 & r1;
-        }
-        
-        *r ^= k[i]; // iota(r, i)
+    _BRSHA256Lanes(r, datas, lens);
+    
+    // the ripemd-160 is of a single block: the sha-256 digest read as little endian words, padding, and a length of
+    // 256 bits
+    for (i = 0; i < 8; i++) {
+        x[i] = (r[i] >> 24) | ((r[i] >> 8) & 0xff00) | ((r[i] & 0xff00) << 8) | (r[i] << 24);
     }
     
+    x[8] = (_BRSHA256Vec){ 0 } + 0x80;
+    for (i = 9; i < 16; i++) x[i] = (_BRSHA256Vec){ 0 };
+    x[14] = (_BRSHA256Vec){ 0 } + 256;
+    for (i = 0; i < 5; i++) r[i] = (_BRSHA256Vec){ 0 } + iv[i];
+    _BRRMDCompressLanes(r, x);
+    
+    for (l = 0; l < BR_SHA256_LANES; l++) {
+        for (i = 0; i < 5; i++) md[i] = le32(r[i][l]); // endian swap
+        memcpy(md20s[l], md, 20); // write to md
+    }
+    
+    mem_clean(x, sizeof(x));
+}
+#endif
+
+// hash-160 of count independent messages, md20s[i] = ripemd-160(sha-256(datas[i])), hashing as many messages at a time
+// as the cpu has vector lanes for, like BRSHA256_2Batch()
+void BRHash160Batch(void *md20s[], const void *datas[], const size_t lens[], size_t count)
+{
+    size_t i = 0;
+    
+    assert(md20s != NULL || count == 0);
+    assert(datas != NULL || count == 0);
+    assert(lens != NULL || count == 0);
+    
+#ifdef BR_SHA256_LANES
+    i = _BRSHA256LanesBatch(_BRHash160Lanes, md20s, datas, lens, count);
+#endif
+    
+    for (; i < count; i++) BRHash160(md20s[i], datas[i], lens[i]);
+}
+
+// bitwise left rotation
+#define rol64(a, b) ((a) << (b) ^ ((a) >> (64 - (b))))
+
+static const uint64_t _keccakK[] = { // keccak round constants
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808a, 0x8000000080008000, 0x000000000000808b,
+    0x0000000080000001, 0x8000000080008081, 0x8000000000008009, 0x000000000000008a, 0x0000000000000088,
+    0x0000000080008009, 0x000000008000000a, 0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
+    0x8000000000008003, 0x8000000000008002, 0x8000000000000080, 0x000000000000800a, 0x800000008000000a,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008
+};
+
+// keccak-f[1600] permutation of the 25 word state r, using a[5], b[5], r0, r1, i, j as scratch - a macro so that the
+// same rounds serve both a single state of uint64_t words and several states held in the lanes of a vector type
+#define keccak_f(r, a, b, r0, r1, i, j) do {\
+    for ((i) = 0; (i) < 24; (i)++) { /* permute r */\
+        /* theta(r) */\
+        for ((j) = 0; (j) < 5; (j)++) (a)[j] = (r)[j] ^ (r)[(j) + 5] ^ (r)[(j) + 10] ^ (r)[(j) + 15] ^ (r)[(j) + 20];\
+        (b)[0] = rol64((a)[1], 1) ^ (a)[4], (b)[1] = rol64((a)[2], 1) ^ (a)[0], (b)[2] = rol64((a)[3], 1) ^ (a)[1];\
+        (b)[3] = rol64((a)[4], 1) ^ (a)[2], (b)[4] = rol64((a)[0], 1) ^ (a)[3];\
+        for ((j) = 0; (j) < 5; (j)++) {\
+            (r)[j] ^= (b)[j], (r)[(j) + 5] ^= (b)[j], (r)[(j) + 10] ^= (b)[j], (r)[(j) + 15] ^= (b)[j];\
+            (r)[(j) + 20] ^= (b)[j];\
+        }\
+        \
+        /* rho(r) */\
+        (r)[1] = rol64((r)[1], 1), (r)[2] = rol64((r)[2], 62), (r)[3] = rol64((r)[3], 28);\
+        (r)[4] = rol64((r)[4], 27), (r)[5] = rol64((r)[5], 36), (r)[6] = rol64((r)[6], 44);\
+        (r)[7] = rol64((r)[7], 6), (r)[8] = rol64((r)[8], 55), (r)[9] = rol64((r)[9], 20);\
+        (r)[10] = rol64((r)[10], 3), (r)[11] = rol64((r)[11], 10), (r)[12] = rol64((r)[12], 43);\
+        (r)[13] = rol64((r)[13], 25), (r)[14] = rol64((r)[14], 39), (r)[15] = rol64((r)[15], 41);\
+        (r)[16] = rol64((r)[16], 45), (r)[17] = rol64((r)[17], 15), (r)[18] = rol64((r)[18], 21);\
+        (r)[19] = rol64((r)[19], 8), (r)[20] = rol64((r)[20], 18), (r)[21] = rol64((r)[21], 2);\
+        (r)[22] = rol64((r)[22], 61), (r)[23] = rol64((r)[23], 56), (r)[24] = rol64((r)[24], 14);\
+        \
+        /* pi(r) */\
+        (r1) = (r)[1], (r)[1] = (r)[6], (r)[6] = (r)[9], (r)[9] = (r)[22], (r)[22] = (r)[14], (r)[14] = (r)[20];\
+        (r)[20] = (r)[2], (r)[2] = (r)[12], (r)[12] = (r)[13], (r)[13] = (r)[19], (r)[19] = (r)[23];\
+        (r)[23] = (r)[15], (r)[15] = (r)[4], (r)[4] = (r)[24], (r)[24] = (r)[21], (r)[21] = (r)[8];\
+        (r)[8] = (r)[16], (r)[16] = (r)[5], (r)[5] = (r)[3], (r)[3] = (r)[18], (r)[18] = (r)[17];\
+        (r)[17] = (r)[11], (r)[11] = (r)[7], (r)[7] = (r)[10], (r)[10] = (r1); /* r[0] left as is */\
+        \
+        for ((j) = 0; (j) < 25; (j) += 5) { /* chi(r) */\
+            (r0) = (r)[0 + (j)], (r1) = (r)[1 + (j)], (r)[0 + (j)] ^= ~(r1) & (r)[2 + (j)];\
+            (r)[1 + (j)] ^= ~(r)[2 + (j)] & (r)[3 + (j)], (r)[2 + (j)] ^= ~(r)[3 + (j)] & (r)[4 + (j)];\
+            (r)[3 + (j)] ^= ~(r)[4 + (j)] & (r0), (r)[4 + (j)] ^= ~(r0) & (r1);\
+        }\
+        \
+        (r)[0] ^= _keccakK[i]; /* iota(r, i) */\
+    }\
+} while (0)
+
+// keccak-f[1600] permutation of the 25 word keccak state, in host byte order
+void BRKeccakF1600(uint64_t state[25])
+{
+    size_t i, j;
+    uint64_t a[5], b[5], r0, r1;
+    
+    assert(state != NULL);
+    keccak_f(state, a, b, r0, r1, i, j);
     mem_clean(a, sizeof(a));
     mem_clean(b, sizeof(b));
     var_clean(&r0, &r1);
 }
 
+static void _BRSHA3Compress(uint64_t *r, const uint64_t *x, size_t blockSize)
+{
+    size_t i;
+    
+    for (i = 0; i < blockSize/sizeof(uint64_t); i++) r[i] ^= le64(x[i]);
+    BRKeccakF1600(r);
+}
+
 // sha3-256: http://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.202.pdf
 void BRSHA3_256(void *md32, const void *data, size_t dataLen)
 {
@@ -498,8 +1096,162 @@ void BRKeccak256(void *md32, const void *data, size_t dataLen)
     mem_clean(buf, sizeof(buf));
 }
 
-// basic md5 functions
-#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+void BRKeccak256Init(BRKeccak256Context *ctx)
+{
+    assert(ctx != NULL);
+    memset(ctx->buf, 0, sizeof(ctx->buf));
+    ctx->dataLen = 0;
+}
+
+void BRKeccak256Update(BRKeccak256Context *ctx, const void *data, size_t dataLen)
+{
+    size_t i = 0, n;
+    
+    assert(ctx != NULL);
+    assert(data != NULL || dataLen == 0);
+    
+    n = (size_t)(ctx->dataLen % 136);
+    ctx->dataLen += dataLen;
+    
+    if (n > 0) { // complete the block held back by the previous update
+        i = (dataLen < 136 - n) ? dataLen : 136 - n;
+        memcpy((uint8_t *)ctx->x + n, data, i);
+        if (n + i < 136) return;
+        _BRSHA3Compress(ctx->buf, ctx->x, 136);
+    }
+    
+    for (; i + 136 <= dataLen; i += 136) { // process data in 136 byte blocks
+        memcpy(ctx->x, (const uint8_t *)data + i, 136);
+        _BRSHA3Compress(ctx->buf, ctx->x, 136);
+    }
+    
+    memcpy(ctx->x, (const uint8_t *)data + i, dataLen - i);
+}
+
+// writes the keccak-256 of all data added to ctx, and cleans ctx
+void BRKeccak256Final(BRKeccak256Context *ctx, void *md32)
+{
+    size_t i, n;
+    
+    assert(ctx != NULL);
+    assert(md32 != NULL);
+    
+    n = (size_t)(ctx->dataLen % 136);
+    memset((uint8_t *)ctx->x + n, 0, 136 - n); // clear remainder of x
+    ((uint8_t *)ctx->x)[n] |= 0x01; // append padding
+    ((uint8_t *)ctx->x)[135] |= 0x80;
+    _BRSHA3Compress(ctx->buf, ctx->x, 136); // finalize
+    for (i = 0; i < 4; i++) ctx->buf[i] = le64(ctx->buf[i]); // endian swap
+    memcpy(md32, ctx->buf, 32); // write to md
+    mem_clean(ctx, sizeof(*ctx));
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BR_KECCAK_LANES        4
+#define BR_KECCAK_LANES_TARGET __attribute__((target("avx2")))
+#define _BRKeccakLanesIsSupported() __builtin_cpu_supports("avx2")
+#elif defined(__aarch64__) && defined(__ARM_NEON) && (defined(__GNUC__) || defined(__clang__))
+#define BR_KECCAK_LANES        4
+#define BR_KECCAK_LANES_TARGET
+#define _BRKeccakLanesIsSupported() 1
+#endif
+
+#ifdef BR_KECCAK_LANES
+typedef uint64_t _BRKeccakVec __attribute__((vector_size(BR_KECCAK_LANES*sizeof(uint64_t))));
+
+// keccak-256 of BR_KECCAK_LANES independent messages, absorbed in lockstep with one message per vector lane
+BR_KECCAK_LANES_TARGET
+static void _BRKeccak256Lanes(void *md32s[], const void *datas[], const size_t lens[])
+{
+    _BRKeccakVec r[25], t[25], w[17], a[5], b[5], r0, r1, mask;
+    uint64_t x[17][BR_KECCAK_LANES], active[BR_KECCAK_LANES], md[4];
+    uint8_t buf[136];
+    size_t i, j, l, n, off, blk, blocks[BR_KECCAK_LANES], maxBlocks = 0;
+    
+    for (l = 0; l < BR_KECCAK_LANES; l++) {
+        blocks[l] = lens[l]/136 + 1;
+        if (blocks[l] > maxBlocks) maxBlocks = blocks[l];
+    }
+    
+    memset(r, 0, sizeof(r));
+    
+    for (blk = 0; blk < maxBlocks; blk++) {
+        for (l = 0; l < BR_KECCAK_LANES; l++) {
+            active[l] = (blk < blocks[l]) ? UINT64_MAX : 0;
+            memset(buf, 0, sizeof(buf));
+            off = blk*136;
+            
+            if (active[l]) {
+                n = (lens[l] - off < 136) ? lens[l] - off : 136;
+                memcpy(buf, (const uint8_t *)datas[l] + off, n);
+                
+                if (blk + 1 == blocks[l]) { // append padding
+                    buf[n] |= 0x01;
+                    buf[135] |= 0x80;
+                }
+            }
+            
+            for (i = 0; i < 17; i++) memcpy(&x[i][l], &buf[i*8], sizeof(uint64_t)), x[i][l] = le64(x[i][l]);
+        }
+        
+        memcpy(w, x, sizeof(w));
+        memcpy(&mask, active, sizeof(mask));
+        memcpy(t, r, sizeof(t));
+        for (i = 0; i < 17; i++) t[i] ^= w[i];
+        keccak_f(t, a, b, r0, r1, i, j);
+        for (i = 0; i < 25; i++) r[i] = (t[i] & mask) | (r[i] & ~mask); // lanes past their last block keep their state
+    }
+    
+    for (l = 0; l < BR_KECCAK_LANES; l++) {
+        for (i = 0; i < 4; i++) md[i] = le64(r[i][l]); // endian swap
+        memcpy(md32s[l], md, 32); // write to md
+    }
+    
+    mem_clean(buf, sizeof(buf));
+    mem_clean(x, sizeof(x));
+    mem_clean(w, sizeof(w));
+    mem_clean(r, sizeof(r));
+    mem_clean(t, sizeof(t));
+}
+#endif
+
+// keccak-256 of count independent messages, md32s[i] = keccak-256(datas[i]), hashing as many messages at a time as
+// the cpu has vector lanes for (4 with avx2 or neon), or one at a time if none are available
+void BRKeccak256Batch(void *md32s[], const void *datas[], const size_t lens[], size_t count)
+{
+    size_t i = 0;
+    
+    assert(md32s != NULL || count == 0);
+    assert(datas != NULL || count == 0);
+    assert(lens != NULL || count == 0);
+    
+#ifdef BR_KECCAK_LANES
+    if (count >= BR_KECCAK_LANES/2 && _BRKeccakLanesIsSupported()) {
+        for (; i + BR_KECCAK_LANES <= count; i += BR_KECCAK_LANES) _BRKeccak256Lanes(&md32s[i], &datas[i], &lens[i]);
+        
+        if (count - i >= BR_KECCAK_LANES/2) { // fill the unused lanes with empty messages
+            uint8_t dummy[32];
+            void *mds[BR_KECCAK_LANES];
+            const void *ds[BR_KECCAK_LANES];
+            size_t ls[BR_KECCAK_LANES], l;
+            
+            for (l = 0; l < BR_KECCAK_LANES; l++) {
+                mds[l] = (i + l < count) ? md32s[i + l] : dummy;
+                ds[l] = (i + l < count) ? datas[i + l] : dummy;
+                ls[l] = (i + l < count) ? lens[i + l] : 0;
+            }
+            
+            _BRKeccak256Lanes(mds, ds, ls);
+            i = count;
+        }
+    }
+#endif
+    
+    for (; i < count; i++) BRKeccak256(md32s[i], datas[i], lens[i]);
+}
+
+// basic md5 functions
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
 #define G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
 #define H(x, y, z) ((x) ^ (y) ^ (z))
 #define I(x, y, z) ((y) ^ ((x) | ~(z)))
@@ -597,6 +1349,88 @@ uint32_t BRMurmur3_32(const void *data, size_t dataLen, uint32_t seed)
     return h;
 }
 
+#if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+#define BR_MURMUR3_LANES 4
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+typedef __m128i _BRMurmurVec;
+#define murmur_set(x)      _mm_set1_epi32((int)(x))
+#define murmur_add(a, b)   _mm_add_epi32((a), (b))
+#define murmur_xor(a, b)   _mm_xor_si128((a), (b))
+#define murmur_shr(a, b)   _mm_srli_epi32((a), (b))
+#define murmur_rol(a, b)   _mm_or_si128(_mm_slli_epi32((a), (b)), _mm_srli_epi32((a), 32 - (b)))
+#define murmur_mul5(a)     _mm_add_epi32(_mm_slli_epi32((a), 2), (a))
+#define murmur_load(p)     _mm_loadu_si128((const __m128i *)(p))
+#define murmur_store(p, a) _mm_storeu_si128((__m128i *)(p), (a))
+
+// low 32bits of each lane of a*b, sse2 only multiplies the even lanes, into 64bit products
+static inline __m128i murmur_mul(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b), odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, 0x08), _mm_shuffle_epi32(odd, 0x08));
+}
+#else
+#include <arm_neon.h>
+typedef uint32x4_t _BRMurmurVec;
+#define murmur_set(x)      vdupq_n_u32((uint32_t)(x))
+#define murmur_add(a, b)   vaddq_u32((a), (b))
+#define murmur_xor(a, b)   veorq_u32((a), (b))
+#define murmur_shr(a, b)   vshrq_n_u32((a), (b))
+#define murmur_rol(a, b)   vsriq_n_u32(vshlq_n_u32((a), (b)), (a), 32 - (b))
+#define murmur_mul5(a)     vaddq_u32(vshlq_n_u32((a), 2), (a))
+#define murmur_load(p)     vld1q_u32((const uint32_t *)(p))
+#define murmur_store(p, a) vst1q_u32((uint32_t *)(p), (a))
+#define murmur_mul(a, b)   vmulq_u32((a), (b))
+#endif
+
+#define murmur_fmix(h) ((h) = murmur_xor((h), murmur_shr((h), 16)), (h) = murmur_mul((h), murmur_set(0x85ebca6b)),\
+                        (h) = murmur_xor((h), murmur_shr((h), 13)), (h) = murmur_mul((h), murmur_set(0xc2b2ae35)),\
+                        (h) = murmur_xor((h), murmur_shr((h), 16)))
+#endif
+
+// murmurHash3 (x86_32) of data with each of seedCount seeds, several seeds at a time across simd lanes where the cpu
+// supports it
+void BRMurmur3_32Seeds(uint32_t hashes[], const uint32_t seeds[], size_t seedCount, const void *data, size_t dataLen)
+{
+    size_t j = 0;
+    
+    assert(hashes != NULL || seedCount == 0);
+    assert(seeds != NULL || seedCount == 0);
+    assert(data != NULL || dataLen == 0);
+    
+#ifdef BR_MURMUR3_LANES
+    const uint8_t *d = data;
+    size_t i, count = dataLen/4;
+    uint32_t k, t = 0;
+    
+    switch (dataLen & 3) { // the tail block doesn't depend on the seed
+        case 3: t ^= d[count*4 + 2] << 16; // fall through
+        case 2: t ^= d[count*4 + 1] << 8;  // fall through
+        case 1: t ^= d[count*4], t *= C1, t = rol32(t, 15)*C2;
+    }
+    
+    for (; j + BR_MURMUR3_LANES <= seedCount; j += BR_MURMUR3_LANES) {
+        _BRMurmurVec h = murmur_load(&seeds[j]);
+        
+        for (i = 0; i < count*4; i += 4) {
+            k = (((uint32_t)d[i + 3] << 24) | ((uint32_t)d[i + 2] << 16) |
+                 ((uint32_t)d[i + 1] <<  8) | ((uint32_t)d[i]))*C1;
+            k = rol32(k, 15)*C2;
+            h = murmur_xor(h, murmur_set(k));
+            h = murmur_add(murmur_mul5(murmur_rol(h, 13)), murmur_set(0xe6546b64));
+        }
+        
+        h = murmur_xor(h, murmur_set(t ^ (uint32_t)dataLen));
+        murmur_fmix(h);
+        murmur_store(&hashes[j], h);
+    }
+#endif
+    
+    for (; j < seedCount; j++) hashes[j] = BRMurmur3_32(data, dataLen, seeds[j]);
+}
+
 #define sipround(a, b, c, d) a += b, b = rol64(b, 13) ^ a, a = rol64(a, 32), c += d, d = rol64(d, 16) ^ c,\
                              a += d, d = rol64(d, 21) ^ a, c += b, b = rol64(b, 17) ^ c, c = rol64(c, 32)
 
@@ -705,30 +1539,58 @@ void BRHMACDRBG(void *out, size_t outLen, void *K, void *V, void (*hash)(void *,
     }
 }
 
-static void _BRPoly1305Compress(uint32_t h[5], const void *key32, const void *data, size_t dataLen, int final)
-{
-    uint32_t x[4], b, t0, t1, t2, t3, t4, r0, r1, r2, r3, r4;
-    uint64_t d0, d1, d2, d3, d4;
+#if defined(__SIZEOF_INT128__)
+#define BR_POLY1305_64 1 // 3 limbs of 44bits, multiplied into 128bit products
+#endif
 
-    // r &= 0xffffffc0ffffffc0ffffffc0fffffff
-    memcpy(x, key32, 16);
-    t0 = le32(x[0]), t1 = le32(x[1]), t2 = le32(x[2]), t3 = le32(x[3]);
-    r0 = t0 & 0x03ffffff, r1 = ((t0 >> 26) | (t1 << 6)) & 0x03ffff03, r2 = ((t1 >> 20) | (t2 << 12)) & 0x03ffc0ff;
-    r3 = ((t2 >> 14) | (t3 << 18)) & 0x03f03fff, r4 = (t3 >> 8) & 0x000fffff;
-    
-    for (size_t i = 0; i < dataLen; i += 16) { // process data in 16 byte blocks
-        if (i + 16 > dataLen) {
-            memcpy(x, (const uint8_t *)data + i, dataLen - i);
-            memset((uint8_t *)x + (dataLen - i), 0, 16 - (dataLen - i)); // clear remainder of x
-            ((uint8_t *)x)[dataLen - i] = 1; // append padding
-        }
-        else memcpy(x, (const uint8_t *)data + i, 16);
+// poly1305 of the 16 byte blocks in data, with the high bit set as hibit for all but a final partial block
+static void _BRPoly1305Blocks(BRPoly1305Context *ctx, const uint8_t *data, size_t dataLen, int hibit)
+{
+#if BR_POLY1305_64
+    typedef unsigned __int128 uint128_t;
+    uint64_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2],
+             s1 = r1*(5 << 2), s2 = r2*(5 << 2), t0, t1, c, x[2];
+    uint128_t d0, d1, d2;
+    
+    for (size_t i = 0; i + 16 <= dataLen; i += 16) {
+        // h += x
+        memcpy(x, &data[i], 16);
+        t0 = le64(x[0]), t1 = le64(x[1]);
+        h0 += t0 & 0xfffffffffff, h1 += ((t0 >> 44) | (t1 << 20)) & 0xfffffffffff;
+        h2 += ((t1 >> 24) & 0x3ffffffffff) | ((uint64_t)hibit << 40);
+        
+        // h *= r
+        d0 = (uint128_t)h0*r0 + (uint128_t)h1*s2 + (uint128_t)h2*s1;
+        d1 = (uint128_t)h0*r1 + (uint128_t)h1*r0 + (uint128_t)h2*s2;
+        d2 = (uint128_t)h0*r2 + (uint128_t)h1*r1 + (uint128_t)h2*r0;
         
+        // (partial) h %= p
+        c = (uint64_t)(d0 >> 44), h0 = (uint64_t)d0 & 0xfffffffffff, d1 += c;
+        c = (uint64_t)(d1 >> 44), h1 = (uint64_t)d1 & 0xfffffffffff, d2 += c;
+        c = (uint64_t)(d2 >> 42), h2 = (uint64_t)d2 & 0x3ffffffffff;
+        h0 += c*5, c = h0 >> 44, h0 &= 0xfffffffffff, h1 += c;
+    }
+    
+    ctx->h[0] = h0, ctx->h[1] = h1, ctx->h[2] = h2;
+    mem_clean(&d0, sizeof(d0));
+    mem_clean(&d1, sizeof(d1));
+    mem_clean(&d2, sizeof(d2));
+    var_clean(&h0, &h1, &h2, &r0, &r1, &r2, &s1, &s2, &t0, &t1, &c);
+    mem_clean(x, sizeof(x));
+#else
+    uint32_t x[4], t0, t1, t2, t3, h[5], r0 = (uint32_t)ctx->r[0], r1 = (uint32_t)ctx->r[1],
+             r2 = (uint32_t)ctx->r[2], r3 = (uint32_t)ctx->r[3], r4 = (uint32_t)ctx->r[4];
+    uint64_t d0, d1, d2, d3, d4;
+    
+    for (size_t i = 0; i < 5; i++) h[i] = (uint32_t)ctx->h[i];
+    
+    for (size_t i = 0; i + 16 <= dataLen; i += 16) {
         // h += x
+        memcpy(x, &data[i], 16);
         t0 = le32(x[0]), t1 = le32(x[1]), t2 = le32(x[2]), t3 = le32(x[3]);
         h[0] += t0 & 0x03ffffff, h[1] += ((t0 >> 26) | (t1 << 6)) & 0x03ffffff;
         h[2] += ((t1 >> 20) | (t2 << 12)) & 0x03ffffff, h[3] += ((t2 >> 14) | (t3 << 18)) & 0x03ffffff;
-        h[4] += (t3 >> 8) | ((i + 16 <= dataLen) ? (1 << 24) : 0);
+        h[4] += (t3 >> 8) | ((uint32_t)hibit << 24);
     
         // h *= r
         d0 = (uint64_t)h[0]*r0 + (uint64_t)h[1]*r4*5 + (uint64_t)h[2]*r3*5 + (uint64_t)h[3]*r2*5 + (uint64_t)h[4]*r1*5;
@@ -743,107 +1605,370 @@ static void _BRPoly1305Compress(uint32_t h[5], const void *key32, const void *da
         h[0] = (d0 & 0x03ffffff) + (uint32_t)(d4 >> 26)*5, h[1] += h[0] >> 26, h[0] &= 0x03ffffff;
     }
     
-    if (final) {
-        // fully carry h
-        h[2] += h[1] >> 26, h[1] &= 0x03ffffff, h[3] += h[2] >> 26, h[2] &= 0x03ffffff, h[4] += h[3] >> 26;
-        h[3] &= 0x03ffffff, h[0] += (h[4] >> 26)*5, h[4] &= 0x03ffffff, h[1] += h[0] >> 26, h[0] &= 0x03ffffff;
-        
-        // compute h + -p
-        t0 = h[0] + 5, t1 = h[1] + (t0 >> 26), t0 &= 0x03ffffff, t2 = h[2] + (t1 >> 26), t1 &= 0x03ffffff;
-        t3 = h[3] + (t2 >> 26), t2 &= 0x03ffffff, t4 = h[4] + (t3 >> 26) - (1 << 26), t3 &= 0x03ffffff;
-        
-        // select h if h < p, or h + -p if h >= p
-        b = (t4 >> 31) - 1, h[0] = (h[0] & ~b) | (t0 & b), h[1] = (h[1] & ~b) | (t1 & b);
-        h[2] = (h[2] & ~b) | (t2 & b), h[3] = (h[3] & ~b) | (t3 & b), h[4] = (h[4] & ~b) | (t4 & b);
-        
-        // h = h % (2^128)
-        h[0] = (h[0] | (h[1] << 26)) & 0x0ffffffff, h[1] = ((h[1] >> 6) | (h[2] << 20)) & 0x0ffffffff;
-        h[2] = ((h[2] >> 12) | (h[3] << 14)) & 0x0ffffffff, h[3] = ((h[3] >> 18) | (h[4] << 8)) & 0x0ffffffff;
-        
-        // mac = (h + pad) % (2^128)
-        memcpy(x, (const uint8_t *)key32 + 16, 16);
-        d0 = (uint64_t)h[0] + le32(x[0]), d1 = (uint64_t)h[1] + le32(x[1]) + (d0 >> 32);
-        d2 = (uint64_t)h[2] + le32(x[2]) + (d1 >> 32), d3 = (uint64_t)h[3] + le32(x[3]) + (d2 >> 32);
-        h[0] = le32((uint32_t)d0), h[1] = le32((uint32_t)d1), h[2] = le32((uint32_t)d2), h[3] = le32((uint32_t)d3);
+    for (size_t i = 0; i < 5; i++) ctx->h[i] = h[i];
+    var_clean(&d0, &d1, &d2, &d3, &d4);
+    mem_clean(x, sizeof(x));
+    mem_clean(h, sizeof(h));
+    var_clean(&t0, &t1, &t2, &t3, &r0, &r1, &r2, &r3, &r4);
+#endif
+}
+
+// initializes ctx for incrementally computing the poly1305 mac of data with the one-time key32
+void BRPoly1305Init(BRPoly1305Context *ctx, const void *key32)
+{
+    uint64_t t[2];
+
+    assert(ctx != NULL);
+    assert(key32 != NULL);
+    memset(ctx, 0, sizeof(*ctx));
+    memcpy(t, key32, 16);
+    memcpy(ctx->pad, (const uint8_t *)key32 + 16, 16);
+#if BR_POLY1305_64
+    // r &= 0xffffffc0ffffffc0ffffffc0fffffff
+    t[0] = le64(t[0]), t[1] = le64(t[1]);
+    ctx->r[0] = t[0] & 0xffc0fffffff, ctx->r[1] = ((t[0] >> 44) | (t[1] << 20)) & 0xfffffc0ffff;
+    ctx->r[2] = (t[1] >> 24) & 0x00ffffffc0f;
+#else
+    uint32_t t0, t1, t2, t3;
+    
+    // r &= 0xffffffc0ffffffc0ffffffc0fffffff
+    memcpy(&t0, t, 4), memcpy(&t1, (uint8_t *)t + 4, 4), memcpy(&t2, (uint8_t *)t + 8, 4);
+    memcpy(&t3, (uint8_t *)t + 12, 4);
+    t0 = le32(t0), t1 = le32(t1), t2 = le32(t2), t3 = le32(t3);
+    ctx->r[0] = t0 & 0x03ffffff, ctx->r[1] = ((t0 >> 26) | (t1 << 6)) & 0x03ffff03;
+    ctx->r[2] = ((t1 >> 20) | (t2 << 12)) & 0x03ffc0ff, ctx->r[3] = ((t2 >> 14) | (t3 << 18)) & 0x03f03fff;
+    ctx->r[4] = (t3 >> 8) & 0x000fffff;
+    var_clean(&t0, &t1, &t2, &t3);
+#endif
+    mem_clean(t, sizeof(t));
+}
+
+// adds dataLen bytes of data to the mac being computed with ctx
+void BRPoly1305Update(BRPoly1305Context *ctx, const void *data, size_t dataLen)
+{
+    const uint8_t *d = data;
+    size_t n;
+    
+    assert(ctx != NULL);
+    assert(data != NULL || dataLen == 0);
+    
+    if (ctx->bufLen > 0) { // complete the block buffered by the previous update
+        n = (dataLen < 16 - ctx->bufLen) ? dataLen : 16 - ctx->bufLen;
+        memcpy(&ctx->buf[ctx->bufLen], d, n);
+        ctx->bufLen += n, d += n, dataLen -= n;
+        if (ctx->bufLen < 16) return;
+        _BRPoly1305Blocks(ctx, ctx->buf, 16, 1);
+        ctx->bufLen = 0;
     }
     
-    var_clean(&d0, &d1, &d2, &d3, &d4);
+    n = dataLen - dataLen % 16;
+    _BRPoly1305Blocks(ctx, d, n, 1);
+    memcpy(ctx->buf, &d[n], dataLen - n);
+    ctx->bufLen = dataLen - n;
+}
+
+// writes the 16 byte mac of all data added to ctx, and cleans ctx
+// NOTE: must use constant time mem comparison when verifying mac to defend against timing attacks
+void BRPoly1305Final(BRPoly1305Context *ctx, void *mac16)
+{
+    assert(ctx != NULL);
+    assert(mac16 != NULL);
+    
+    if (ctx->bufLen > 0) {
+        memset(&ctx->buf[ctx->bufLen], 0, 16 - ctx->bufLen); // clear remainder of buf
+        ctx->buf[ctx->bufLen] = 1; // append padding
+        _BRPoly1305Blocks(ctx, ctx->buf, 16, 0);
+    }
+    
+#if BR_POLY1305_64
+    uint64_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], g0, g1, g2, c, t0, t1, mac[2];
+    
+    // fully carry h
+    c = h1 >> 44, h1 &= 0xfffffffffff, h2 += c, c = h2 >> 42, h2 &= 0x3ffffffffff, h0 += c*5;
+    c = h0 >> 44, h0 &= 0xfffffffffff, h1 += c, c = h1 >> 44, h1 &= 0xfffffffffff, h2 += c;
+    c = h2 >> 42, h2 &= 0x3ffffffffff, h0 += c*5, c = h0 >> 44, h0 &= 0xfffffffffff, h1 += c;
+    
+    // compute h + -p
+    g0 = h0 + 5, c = g0 >> 44, g0 &= 0xfffffffffff, g1 = h1 + c, c = g1 >> 44, g1 &= 0xfffffffffff;
+    g2 = h2 + c - ((uint64_t)1 << 42);
+    
+    // select h if h < p, or h + -p if h >= p
+    c = (g2 >> 63) - 1, h0 = (h0 & ~c) | (g0 & c), h1 = (h1 & ~c) | (g1 & c), h2 = (h2 & ~c) | (g2 & c);
+    
+    // mac = (h + pad) % (2^128)
+    memcpy(mac, ctx->pad, 16);
+    t0 = le64(mac[0]), t1 = le64(mac[1]);
+    h0 += t0 & 0xfffffffffff, c = h0 >> 44, h0 &= 0xfffffffffff;
+    h1 += (((t0 >> 44) | (t1 << 20)) & 0xfffffffffff) + c, c = h1 >> 44, h1 &= 0xfffffffffff;
+    h2 += ((t1 >> 24) & 0x3ffffffffff) + c, h2 &= 0x3ffffffffff;
+    mac[0] = le64(h0 | (h1 << 44)), mac[1] = le64((h1 >> 20) | (h2 << 24));
+    memcpy(mac16, mac, 16);
+    var_clean(&h0, &h1, &h2, &g0, &g1, &g2, &c, &t0, &t1);
+    mem_clean(mac, sizeof(mac));
+#else
+    uint32_t h[5], x[4], b, t0, t1, t2, t3, t4;
+    uint64_t d0, d1, d2, d3;
+    
+    for (size_t i = 0; i < 5; i++) h[i] = (uint32_t)ctx->h[i];
+    
+    // fully carry h
+    h[2] += h[1] >> 26, h[1] &= 0x03ffffff, h[3] += h[2] >> 26, h[2] &= 0x03ffffff, h[4] += h[3] >> 26;
+    h[3] &= 0x03ffffff, h[0] += (h[4] >> 26)*5, h[4] &= 0x03ffffff, h[1] += h[0] >> 26, h[0] &= 0x03ffffff;
+    
+    // compute h + -p
+    t0 = h[0] + 5, t1 = h[1] + (t0 >> 26), t0 &= 0x03ffffff, t2 = h[2] + (t1 >> 26), t1 &= 0x03ffffff;
+    t3 = h[3] + (t2 >> 26), t2 &= 0x03ffffff, t4 = h[4] + (t3 >> 26) - (1 << 26), t3 &= 0x03ffffff;
+    
+    // select h if h < p, or h + -p if h >= p
+    b = (t4 >> 31) - 1, h[0] = (h[0] & ~b) | (t0 & b), h[1] = (h[1] & ~b) | (t1 & b);
+    h[2] = (h[2] & ~b) | (t2 & b), h[3] = (h[3] & ~b) | (t3 & b), h[4] = (h[4] & ~b) | (t4 & b);
+    
+    // h = h % (2^128)
+    h[0] = (h[0] | (h[1] << 26)) & 0x0ffffffff, h[1] = ((h[1] >> 6) | (h[2] << 20)) & 0x0ffffffff;
+    h[2] = ((h[2] >> 12) | (h[3] << 14)) & 0x0ffffffff, h[3] = ((h[3] >> 18) | (h[4] << 8)) & 0x0ffffffff;
+    
+    // mac = (h + pad) % (2^128)
+    memcpy(x, ctx->pad, 16);
+    d0 = (uint64_t)h[0] + le32(x[0]), d1 = (uint64_t)h[1] + le32(x[1]) + (d0 >> 32);
+    d2 = (uint64_t)h[2] + le32(x[2]) + (d1 >> 32), d3 = (uint64_t)h[3] + le32(x[3]) + (d2 >> 32);
+    h[0] = le32((uint32_t)d0), h[1] = le32((uint32_t)d1), h[2] = le32((uint32_t)d2), h[3] = le32((uint32_t)d3);
+    memcpy(mac16, h, 16);
+    var_clean(&d0, &d1, &d2, &d3);
+    mem_clean(h, sizeof(h));
     mem_clean(x, sizeof(x));
-    var_clean(&b, &t0, &t1, &t2, &t3, &t4, &r0, &r1, &r2, &r3, &r4);
+    var_clean(&b, &t0, &t1, &t2, &t3, &t4);
+#endif
+    mem_clean(ctx, sizeof(*ctx));
 }
 
 // poly1305 authenticator: https://tools.ietf.org/html/rfc7539
 // NOTE: must use constant time mem comparison when verifying mac to defend against timing attacks
 void BRPoly1305(void *mac16, const void *key32, const void *data, size_t dataLen)
 {
-    uint32_t h[5] = { 0, 0, 0, 0, 0 };
+    BRPoly1305Context ctx;
     
     assert(mac16 != NULL);
     assert(data != NULL || dataLen == 0);
     assert(key32 != NULL);
     
-    _BRPoly1305Compress(h, key32, data, dataLen, 1);
-    memcpy(mac16, h, 16);
-    mem_clean(h, sizeof(h));
+    BRPoly1305Init(&ctx, key32);
+    BRPoly1305Update(&ctx, data, dataLen);
+    BRPoly1305Final(&ctx, mac16);
 }
 
 // basic chacha quarter round operation
 #define qr(a, b, c, d) ((a) += (b), (d) = rol32((d) ^ (a), 16), (c) += (d), (b) = rol32((b) ^ (c), 12),\
                         (a) += (b), (d) = rol32((d) ^ (a), 8), (c) += (d), (b) = rol32((b) ^ (c), 7))
 
+// chacha20 double rounds on the 16 words x0...x15, which may be scalars or vectors
+#define chacha20_rounds(x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15) do {\
+    for (int _j = 0; _j < 10; _j++) {\
+        qr(x0, x4, x8, x12), qr(x1, x5, x9, x13), qr(x2, x6, x10, x14), qr(x3, x7, x11, x15);\
+        qr(x0, x5, x10, x15), qr(x1, x6, x11, x12), qr(x2, x7, x8, x13), qr(x3, x4, x9, x14);\
+    }\
+} while (0)
+
+// writes the 64 byte keystream block for state s to b, and increments the block counter in s
+static void _BRChacha20Block(uint32_t s[16], uint32_t b[16])
+{
+    uint32_t x[16];
+    
+    memcpy(x, s, sizeof(x));
+    chacha20_rounds(x[0], x[1], x[2], x[3], x[4], x[5], x[6], x[7], x[8], x[9], x[10], x[11], x[12], x[13], x[14],
+                    x[15]);
+    for (size_t i = 0; i < 16; i++) b[i] = le32(s[i] + x[i]);
+    s[12]++;
+    if (s[12] == 0) s[13]++;
+    mem_clean(x, sizeof(x));
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BR_CHACHA20_LANES 4 // blocks computed at once, one per vector lane
+typedef uint32_t _BRChacha20Vec __attribute__((vector_size(BR_CHACHA20_LANES*sizeof(uint32_t))));
+
+// xors BR_CHACHA20_LANES consecutive keystream blocks for state s with data, and advances the block counter in s
+static void _BRChacha20Lanes(uint32_t s[16], uint8_t *out, const uint8_t *data)
+{
+    _BRChacha20Vec x[16], t[16];
+    uint64_t counter = ((uint64_t)s[13] << 32) | s[12];
+    uint32_t w;
+    size_t i, l;
+    
+    for (i = 0; i < 16; i++) x[i] = (_BRChacha20Vec){ 0 } + s[i];
+    
+    for (l = 0; l < BR_CHACHA20_LANES; l++) {
+        x[12][l] = (uint32_t)(counter + l);
+        x[13][l] = (uint32_t)((counter + l) >> 32);
+    }
+    
+    memcpy(t, x, sizeof(t));
+    chacha20_rounds(x[0], x[1], x[2], x[3], x[4], x[5], x[6], x[7], x[8], x[9], x[10], x[11], x[12], x[13], x[14],
+                    x[15]);
+    for (i = 0; i < 16; i++) x[i] += t[i];
+    
+    for (l = 0; l < BR_CHACHA20_LANES; l++) {
+        for (i = 0; i < 16; i++) {
+            memcpy(&w, &data[l*64 + i*4], sizeof(w));
+            w ^= le32(x[i][l]);
+            memcpy(&out[l*64 + i*4], &w, sizeof(w));
+        }
+    }
+    
+    counter += BR_CHACHA20_LANES;
+    s[12] = (uint32_t)counter, s[13] = (uint32_t)(counter >> 32);
+    mem_clean(x, sizeof(x));
+    mem_clean(t, sizeof(t));
+    var_clean(&w);
+}
+#endif
+
+// initializes ctx for incrementally encrypting or decrypting with the chacha20 stream cipher, starting at block counter
+void BRChacha20Init(BRChacha20Context *ctx, const void *key32, const void *iv8, uint64_t counter)
+{
+    static const char sigma[16] = "expand 32-byte k";
+    
+    assert(ctx != NULL);
+    assert(key32 != NULL);
+    assert(iv8 != NULL);
+    
+    memcpy(ctx->s, sigma, 16);
+    memcpy(&ctx->s[4], key32, 32);
+    memcpy(&ctx->s[14], iv8, 8);
+    for (size_t i = 0; i < 16; i++) ctx->s[i] = le32(ctx->s[i]);
+    ctx->s[12] = (uint32_t)counter;
+    ctx->s[13] = (uint32_t)(counter >> 32);
+    ctx->bufLen = 0;
+}
+
+// xors dataLen bytes of data with the next bytes of the keystream for ctx, and writes the result to out
+void BRChacha20Update(BRChacha20Context *ctx, void *out, const void *data, size_t dataLen)
+{
+    uint8_t *o = out;
+    const uint8_t *d = data;
+    uint32_t w;
+    size_t i = 0, j;
+    
+    assert(ctx != NULL);
+    assert(out != NULL || dataLen == 0);
+    assert(data != NULL || dataLen == 0);
+    
+    for (; i < dataLen && ctx->bufLen > 0; i++, ctx->bufLen--) { // use keystream left over from the previous update
+        o[i] = d[i] ^ ((const uint8_t *)ctx->buf)[64 - ctx->bufLen];
+    }
+    
+#ifdef BR_CHACHA20_LANES
+    for (; i + BR_CHACHA20_LANES*64 <= dataLen; i += BR_CHACHA20_LANES*64) _BRChacha20Lanes(ctx->s, &o[i], &d[i]);
+#endif
+    
+    for (; i + 64 <= dataLen; i += 64) {
+        _BRChacha20Block(ctx->s, ctx->buf);
+        
+        for (j = 0; j < 64; j += sizeof(w)) {
+            memcpy(&w, &d[i + j], sizeof(w));
+            w ^= ctx->buf[j/sizeof(w)];
+            memcpy(&o[i + j], &w, sizeof(w));
+        }
+    }
+    
+    if (i < dataLen) {
+        _BRChacha20Block(ctx->s, ctx->buf);
+        ctx->bufLen = 64;
+        for (; i < dataLen; i++, ctx->bufLen--) o[i] = d[i] ^ ((const uint8_t *)ctx->buf)[64 - ctx->bufLen];
+    }
+    
+    var_clean(&w);
+}
+
 // chacha20 stream cipher: https://cr.yp.to/chacha.html
 void BRChacha20(void *out, const void *key32, const void *iv8, const void *data, size_t dataLen, uint64_t counter)
 {
-    static const char sigma[16] = "expand 32-byte k";
-    uint32_t b[16], s[16], x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
-    size_t i, j;
+    BRChacha20Context ctx;
     
     assert(out != NULL || dataLen == 0);
     assert(data != NULL || dataLen == 0);
     assert(key32 != NULL);
     assert(iv8 != NULL);
     
-    memcpy(s, sigma, 16);
-    memcpy(&s[4], key32, 32);
-    s[12] = le32((uint32_t)counter);
-    s[13] = le32(counter >> 32);
-    memcpy(&s[14], iv8, 8);
-    for (i = 0; i < 16; i++) s[i] = le32(s[i]);
-
-    for (i = 0; i < dataLen; i++) {
-        if (i % 64 == 0) {
-            x0 = s[0], x1 = s[1], x2 = s[2], x3 = s[3], x4 = s[4], x5 = s[5], x6 = s[6], x7 = s[7];
-            x8 = s[8], x9 = s[9], x10 = s[10], x11 = s[11], x12 = s[12], x13 = s[13], x14 = s[14], x15 = s[15];
-            
-            for (j = 0; j < 10; j++) {
-                qr(x0, x4, x8, x12), qr(x1, x5, x9, x13), qr(x2, x6, x10, x14), qr(x3, x7, x11, x15);
-                qr(x0, x5, x10, x15), qr(x1, x6, x11, x12), qr(x2, x7, x8, x13), qr(x3, x4, x9, x14);
-            }
-            
-            b[0] = le32(s[0] + x0), b[1] = le32(s[1] + x1), b[2] = le32(s[2] + x2), b[3] = le32(s[3] + x3);
-            b[4] = le32(s[4] + x4), b[5] = le32(s[5] + x5), b[6] = le32(s[6] + x6), b[7] = le32(s[7] + x7);
-            b[8] = le32(s[8] + x8), b[9] = le32(s[9] + x9), b[10] = le32(s[10] + x10), b[11] = le32(s[11] + x11);
-            b[12] = le32(s[12] + x12), b[13] = le32(s[13] + x13), b[14] = le32(s[14] + x14), b[15] = le32(s[15] + x15);
+    BRChacha20Init(&ctx, key32, iv8, counter);
+    BRChacha20Update(&ctx, out, data, dataLen);
+    mem_clean(&ctx, sizeof(ctx));
+}
 
-            s[12]++;
-            if (s[12] == 0) s[13]++;
-        }
-        
-        ((uint8_t *)out)[i] = ((const uint8_t *)data)[i] ^ ((uint8_t *)b)[i % 64];
-    }
+// initializes ctx for incrementally encrypting or decrypting a message with chacha20-poly1305 AEAD, authenticating
+// it together with the associated data ad
+void BRChacha20Poly1305AEADInit(BRChacha20Poly1305Context *ctx, const void *key32, const void *nonce12,
+                                const void *ad, size_t adLen)
+{
+    uint64_t counter = 0, macKey[4] = { 0, 0, 0, 0 }, pad[2] = { 0, 0 };
     
-    var_clean(&x0, &x1, &x2, &x3, &x4, &x5, &x6, &x7, &x8, &x9, &x10, &x11, &x12, &x13, &x14, &x15);
-    mem_clean(s, sizeof(s));
-    mem_clean(b, sizeof(b));
+    assert(ctx != NULL);
+    assert(key32 != NULL);
+    assert(nonce12 != NULL);
+    assert(ad != NULL || adLen == 0);
+    
+    memcpy(&((uint32_t *)&counter)[1], nonce12, sizeof(uint32_t));
+    BRChacha20Init(&ctx->chacha, key32, (const uint8_t *)nonce12 + 4, le64(counter));
+    BRChacha20Update(&ctx->chacha, macKey, macKey, sizeof(macKey));
+    BRChacha20Init(&ctx->chacha, key32, (const uint8_t *)nonce12 + 4, le64(counter) + 1);
+    BRPoly1305Init(&ctx->poly, macKey);
+    mem_clean(macKey, sizeof(macKey));
+    BRPoly1305Update(&ctx->poly, ad, adLen);
+    BRPoly1305Update(&ctx->poly, pad, (16 - adLen % 16) % 16);
+    ctx->adLen = adLen;
+    ctx->dataLen = 0;
+}
+
+// encrypts the next dataLen bytes of the message from data to out
+void BRChacha20Poly1305AEADEncryptUpdate(BRChacha20Poly1305Context *ctx, void *out, const void *data, size_t dataLen)
+{
+    assert(ctx != NULL);
+    BRChacha20Update(&ctx->chacha, out, data, dataLen);
+    BRPoly1305Update(&ctx->poly, out, dataLen);
+    ctx->dataLen += dataLen;
+}
+
+// decrypts the next dataLen bytes of the message from data to out
+// NOTE: the decrypted data must not be trusted until BRChacha20Poly1305AEADDecryptFinal() returns true
+void BRChacha20Poly1305AEADDecryptUpdate(BRChacha20Poly1305Context *ctx, void *out, const void *data, size_t dataLen)
+{
+    assert(ctx != NULL);
+    BRPoly1305Update(&ctx->poly, data, dataLen);
+    BRChacha20Update(&ctx->chacha, out, data, dataLen);
+    ctx->dataLen += dataLen;
+}
+
+// writes the 16 byte mac of the message to mac16, and cleans ctx
+void BRChacha20Poly1305AEADEncryptFinal(BRChacha20Poly1305Context *ctx, void *mac16)
+{
+    uint64_t pad[2] = { 0, 0 };
+    
+    assert(ctx != NULL);
+    assert(mac16 != NULL);
+    BRPoly1305Update(&ctx->poly, pad, (16 - ctx->dataLen % 16) % 16);
+    pad[0] = le64(ctx->adLen);
+    pad[1] = le64(ctx->dataLen);
+    BRPoly1305Update(&ctx->poly, pad, sizeof(pad));
+    BRPoly1305Final(&ctx->poly, mac16);
+    mem_clean(ctx, sizeof(*ctx));
+}
+
+// returns true if mac16 authenticates the decrypted message, and cleans ctx
+int BRChacha20Poly1305AEADDecryptFinal(BRChacha20Poly1305Context *ctx, const void *mac16)
+{
+    uint32_t h[4], mac[4];
+    
+    assert(ctx != NULL);
+    assert(mac16 != NULL);
+    BRChacha20Poly1305AEADEncryptFinal(ctx, h);
+    memcpy(mac, mac16, sizeof(mac));
+    return ((mac[0] ^ h[0]) | (mac[1] ^ h[1]) | (mac[2] ^ h[2]) | (mac[3] ^ h[3])) == 0; // constant time compare
 }
 
 // chacha20-poly1305 authenticated encryption with associated data (AEAD): https://tools.ietf.org/html/rfc7539
 size_t BRChacha20Poly1305AEADEncrypt(void *out, size_t outLen, const void *key32, const void *nonce12,
                                      const void *data, size_t dataLen, const void *ad, size_t adLen)
 {
-    const void *iv = (const uint8_t *)nonce12 + 4;
-    uint64_t counter = 0, macKey[4] = { 0, 0, 0, 0 }, pad[2] = { 0, 0 };
-    uint32_t h[5] = { 0, 0, 0, 0, 0 };
+    BRChacha20Poly1305Context ctx;
 
     if (! out) return dataLen + 16;
     if (outLen < dataLen + 16 || dataLen/64 >= UINT32_MAX) return 0;
@@ -853,30 +1978,18 @@ size_t BRChacha20Poly1305AEADEncrypt(void *out, size_t outLen, const void *key32
     assert(data != NULL || dataLen == 0);
     assert(ad != NULL || adLen == 0);
     
-    memcpy(&((uint32_t *)&counter)[1], nonce12, sizeof(uint32_t));    
-    BRChacha20(macKey, key32, iv, macKey, sizeof(macKey), le64(counter));
-    _BRPoly1305Compress(h, macKey, ad, (adLen/16)*16, 0);
-    memcpy(pad, (const uint8_t *)ad + (adLen/16)*16, adLen % 16);
-    if (adLen % 16) _BRPoly1305Compress(h, macKey, pad, 16, 0);
-    BRChacha20(out, key32, iv, data, dataLen, le64(counter) + 1);
-    _BRPoly1305Compress(h, macKey, out, (dataLen/16)*16, 0);
-    pad[0] = pad[1] = 0;
-    memcpy(pad, (const uint8_t *)out + (dataLen/16)*16, dataLen % 16);
-    if (dataLen % 16) _BRPoly1305Compress(h, macKey, pad, 16, 0);
-    pad[0] = le64(adLen);
-    pad[1] = le64(dataLen);
-    _BRPoly1305Compress(h, macKey, pad, 16, 1);
-    mem_clean(macKey, sizeof(macKey));
-    memcpy((uint8_t *)out + dataLen, h, 16);
+    BRChacha20Poly1305AEADInit(&ctx, key32, nonce12, ad, adLen);
+    BRChacha20Poly1305AEADEncryptUpdate(&ctx, out, data, dataLen);
+    BRChacha20Poly1305AEADEncryptFinal(&ctx, (uint8_t *)out + dataLen);
     return dataLen + 16;
 }
 
 size_t BRChacha20Poly1305AEADDecrypt(void *out, size_t outLen, const void *key32, const void *nonce12,
                                      const void *data, size_t dataLen, const void *ad, size_t adLen)
 {
-    const void *iv = (const uint8_t *)nonce12 + 4;
-    uint64_t counter = 0, macKey[4] = { 0, 0, 0, 0 }, pad[2] = { 0, 0 };
-    uint32_t h[5] = { 0, 0, 0, 0, 0 }, mac[4];
+    BRChacha20Poly1305Context ctx;
+    uint64_t counter = 0;
+    uint32_t h[4], mac[4];
     
     if (! out) return (dataLen < 16) ? 0 : dataLen - 16;
     if (dataLen < 16 || (dataLen - 16)/64 >= UINT32_MAX || outLen + 16 < dataLen) return 0;
@@ -886,26 +1999,151 @@ size_t BRChacha20Poly1305AEADDecrypt(void *out, size_t outLen, const void *key32
     assert(data != NULL || dataLen == 0);
     assert(ad != NULL || adLen == 0);
 
+    // authenticate before decrypting, so nothing is written to out for a forged message
     outLen = dataLen - 16;
-    memcpy(&((uint32_t *)&counter)[1], nonce12, sizeof(uint32_t));
-    BRChacha20(macKey, key32, iv, macKey, sizeof(macKey), le64(counter));
-    _BRPoly1305Compress(h, macKey, ad, (adLen/16)*16, 0);
-    memcpy(pad, (const uint8_t *)ad + (adLen/16)*16, adLen % 16);
-    if (adLen % 16) _BRPoly1305Compress(h, macKey, pad, 16, 0);
-    _BRPoly1305Compress(h, macKey, data, (outLen/16)*16, 0);
-    pad[0] = pad[1] = 0;
-    memcpy(pad, (const uint8_t *)data + (outLen/16)*16, outLen % 16);
-    if (outLen % 16) _BRPoly1305Compress(h, macKey, pad, 16, 0);
-    pad[0] = le64(adLen);
-    pad[1] = le64(outLen);
-    _BRPoly1305Compress(h, macKey, pad, 16, 1);
-    mem_clean(macKey, sizeof(macKey));
+    BRChacha20Poly1305AEADInit(&ctx, key32, nonce12, ad, adLen);
+    BRPoly1305Update(&ctx.poly, data, outLen);
+    ctx.dataLen = outLen;
+    BRChacha20Poly1305AEADEncryptFinal(&ctx, h);
     memcpy(mac, (const uint8_t *)data + outLen, 16);
-    if ((mac[0] ^ h[0]) | (mac[1] ^ h[1]) | (mac[2] ^ h[2]) | (mac[3] ^ h[3]) != 0) outLen = 0; // constant time compare
-    BRChacha20(out, key32, iv, data, outLen, le64(counter) + 1);
+    if ((mac[0] ^ h[0]) | (mac[1] ^ h[1]) | (mac[2] ^ h[2]) | (mac[3] ^ h[3])) outLen = 0; // constant time compare
+    memcpy(&((uint32_t *)&counter)[1], nonce12, sizeof(uint32_t));
+    BRChacha20(out, key32, (const uint8_t *)nonce12 + 4, data, outLen, le64(counter) + 1);
     return outLen;
 }
 
+#define RAND_BUF_LEN    512       // bytes of chacha20 keystream generated at a time, the first 32 of which rekey
+#define RAND_RESEED_LEN (1 << 20) // bytes generated before new entropy from the os is mixed into the key
+
+typedef struct {
+    uint8_t key[32];
+    uint8_t buf[RAND_BUF_LEN];
+    size_t bufLen; // the last bufLen bytes of buf haven't been used yet
+    size_t outLen; // bytes generated since the last reseed
+    unsigned forks; // _randForks when last reseeded
+} _BRRandState;
+
+static pthread_key_t _randKey;
+static pthread_once_t _randOnce = PTHREAD_ONCE_INIT;
+static volatile unsigned _randForks = 0;
+
+static void _BRRandStateFree(void *state)
+{
+    mem_clean(state, sizeof(_BRRandState));
+    free(state);
+}
+
+static void _BRRandAtFork(void)
+{
+    _randForks++; // a forked child must not repeat its parent's output
+}
+
+static void _BRRandInit(void)
+{
+    pthread_key_create(&_randKey, _BRRandStateFree);
+    pthread_atfork(NULL, NULL, _BRRandAtFork);
+}
+
+// fills buf with bufLen bytes of entropy from the os
+static void _BRRandOSBytes(void *buf, size_t bufLen)
+{
+#if defined(__APPLE__) || defined(__ANDROID__) || defined(__FreeBSD__) || defined(__OpenBSD__)
+    arc4random_buf(buf, bufLen);
+#else
+    for (size_t i = 0; i < bufLen; i += 256) { // getentropy() returns at most 256 bytes per call
+        if (getentropy((uint8_t *)buf + i, (bufLen - i < 256) ? bufLen - i : 256) != 0) abort();
+    }
+#endif
+}
+
+// returns the calling thread's generator state, seeding or reseeding it as needed
+static _BRRandState *_BRRandStateGet(void)
+{
+    _BRRandState *state;
+    uint8_t seed[64];
+
+    pthread_once(&_randOnce, _BRRandInit);
+    state = pthread_getspecific(_randKey);
+
+    if (! state) {
+        state = calloc(1, sizeof(*state));
+        assert(state != NULL);
+        state->outLen = RAND_RESEED_LEN;
+        pthread_setspecific(_randKey, state);
+    }
+
+    if (state->outLen >= RAND_RESEED_LEN || state->forks != _randForks) {
+        memcpy(seed, state->key, 32);
+        _BRRandOSBytes(&seed[32], 32);
+        BRSHA256(state->key, seed, sizeof(seed));
+        mem_clean(seed, sizeof(seed));
+        mem_clean(state->buf, sizeof(state->buf));
+        state->bufLen = state->outLen = 0;
+        state->forks = _randForks;
+    }
+
+    return state;
+}
+
+// replaces the key with the first 32 bytes of its keystream, so earlier output can't be recovered from the state
+static void _BRRandRefill(_BRRandState *state)
+{
+    static const uint8_t iv[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    memset(state->buf, 0, sizeof(state->buf));
+    BRChacha20(state->buf, state->key, iv, state->buf, sizeof(state->buf), 0);
+    memcpy(state->key, state->buf, 32);
+    mem_clean(state->buf, 32);
+    state->bufLen = sizeof(state->buf) - 32;
+}
+
+// fills buf with bufLen cryptographically secure random bytes, from a chacha20 keystream per thread, keyed from the os
+// entropy source and rekeyed after every use, with new os entropy mixed in every megabyte and after a fork
+void BRRandBytes(void *buf, size_t bufLen)
+{
+    static const uint8_t iv[8] = { 1, 0, 0, 0, 0, 0, 0, 0 }; // distinct from _BRRandRefill(), for bulk output
+    _BRRandState *state = _BRRandStateGet();
+    uint8_t *out = buf, *p;
+    size_t n;
+
+    assert(buf != NULL || bufLen == 0);
+    state->outLen += bufLen;
+
+    while (bufLen > 0) {
+        if (bufLen >= RAND_BUF_LEN && state->bufLen == 0) { // bulk output goes directly to buf, then rekeys
+            n = bufLen - bufLen % 64;
+            memset(out, 0, n);
+            BRChacha20(out, state->key, iv, out, n, 0);
+            _BRRandRefill(state);
+        }
+        else {
+            if (state->bufLen == 0) _BRRandRefill(state);
+            n = (bufLen < state->bufLen) ? bufLen : state->bufLen;
+            p = &state->buf[sizeof(state->buf) - state->bufLen];
+            memcpy(out, p, n);
+            mem_clean(p, n);
+            state->bufLen -= n;
+        }
+
+        out += n;
+        bufLen -= n;
+    }
+}
+
+// returns a cryptographically secure random number less than upperBound, without modulo bias
+uint32_t BRRandUniform(uint32_t upperBound)
+{
+    uint32_t r;
+
+    assert(upperBound > 0);
+
+    do { // to avoid modulo bias, find a rand value not less than 0x100000000 % upperBound
+        BRRandBytes(&r, sizeof(r));
+    } while (r < ((0xffffffff - upperBound*2) + 1) % upperBound); // (((0xffffffff - x*2) + 1) % x) == (0x100000000 % x)
+
+    return r % upperBound;
+}
+
 static const uint8_t sbox[256] = {
     0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
     0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
@@ -1011,6 +2249,182 @@ static void _BRAESDecipher(uint8_t x[16], const uint8_t k[256], size_t kl)
     var_clean(&a, &b, &c, &d, &e, &f, &g);
 }
 
+// aes-ctr keystream of blocks successive counters from iv, xored with data into out, advances iv past the blocks used
+static void _BRAESCTRBlocksC(uint8_t *out, const uint8_t *data, size_t blocks, const uint8_t k[256], size_t kl,
+                             uint8_t iv[16])
+{
+    uint8_t x[16];
+    size_t i, j;
+    
+    for (j = 0; j < blocks; j++) {
+        memcpy(x, iv, 16);
+        _BRAESCipher(x, k, kl);
+        i = 16;
+        do { iv[--i]++; } while (iv[i] == 0 && i > 0); // increment iv with overflow
+        for (i = 0; i < 16; i++) out[j*16 + i] = data[j*16 + i] ^ x[i];
+    }
+    
+    mem_clean(x, sizeof(x));
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BR_AES_AESNI 1
+
+// aes-ctr using intel aes-ni, four blocks at a time to cover the latency of aesenc
+__attribute__((target("aes,sse2")))
+static void _BRAESCTRBlocksAESNI(uint8_t *out, const uint8_t *data, size_t blocks, const uint8_t k[256], size_t kl,
+                                 uint8_t iv[16])
+{
+    __m128i rk[15], x[4];
+    uint64_t hi, lo;
+    size_t i, j, n, rounds = kl/4 + 6;
+    
+    memcpy(&hi, &iv[0], sizeof(hi)), memcpy(&lo, &iv[8], sizeof(lo));
+    hi = be64(hi), lo = be64(lo);
+    for (i = 0; i <= rounds; i++) rk[i] = _mm_loadu_si128((const __m128i *)&k[i*16]);
+    
+    for (; blocks > 0; blocks -= n, out += n*16, data += n*16) {
+        n = (blocks < 4) ? blocks : 4;
+        
+        for (j = 0; j < n; j++) { // counter blocks are the big endian 128bit iv, incremented with overflow
+            x[j] = _mm_xor_si128(_mm_set_epi64x((long long)be64(lo), (long long)be64(hi)), rk[0]);
+            if (++lo == 0) hi++;
+        }
+        
+        for (i = 1; i < rounds; i++) {
+            for (j = 0; j < n; j++) x[j] = _mm_aesenc_si128(x[j], rk[i]);
+        }
+        
+        for (j = 0; j < n; j++) {
+            x[j] = _mm_aesenclast_si128(x[j], rk[rounds]);
+            _mm_storeu_si128((__m128i *)&out[j*16],
+                             _mm_xor_si128(x[j], _mm_loadu_si128((const __m128i *)&data[j*16])));
+        }
+    }
+    
+    hi = be64(hi), lo = be64(lo);
+    memcpy(&iv[0], &hi, sizeof(hi)), memcpy(&iv[8], &lo, sizeof(lo));
+    mem_clean(rk, sizeof(rk));
+    mem_clean(x, sizeof(x));
+}
+
+static int _BRAESAESNIIsSupported(void)
+{
+    unsigned a, b, c, d;
+    
+    if (__get_cpuid_max(0, NULL) < 1) return 0;
+    __cpuid(1, a, b, c, d);
+    return (c & (1 << 25)) != 0 && (d & (1 << 26)) != 0; // aes, sse2
+}
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#define BR_AES_ARMV8 1
+#include <arm_neon.h>
+
+// aes-ctr using armv8 cryptography extensions, four blocks at a time
+static void _BRAESCTRBlocksARMv8(uint8_t *out, const uint8_t *data, size_t blocks, const uint8_t k[256], size_t kl,
+                                 uint8_t iv[16])
+{
+    uint8x16_t rk[15], x[4];
+    uint64_t hi, lo;
+    size_t i, j, n, rounds = kl/4 + 6;
+    
+    memcpy(&hi, &iv[0], sizeof(hi)), memcpy(&lo, &iv[8], sizeof(lo));
+    hi = be64(hi), lo = be64(lo);
+    for (i = 0; i <= rounds; i++) rk[i] = vld1q_u8(&k[i*16]);
+    
+    for (; blocks > 0; blocks -= n, out += n*16, data += n*16) {
+        n = (blocks < 4) ? blocks : 4;
+        
+        for (j = 0; j < n; j++) { // counter blocks are the big endian 128bit iv, incremented with overflow
+            x[j] = vcombine_u8(vcreate_u8(be64(hi)), vcreate_u8(be64(lo)));
+            if (++lo == 0) hi++;
+        }
+        
+        for (i = 0; i < rounds - 1; i++) { // aese is add round key, sub bytes and shift rows; aesmc is mix columns
+            for (j = 0; j < n; j++) x[j] = vaesmcq_u8(vaeseq_u8(x[j], rk[i]));
+        }
+        
+        for (j = 0; j < n; j++) {
+            x[j] = veorq_u8(vaeseq_u8(x[j], rk[rounds - 1]), rk[rounds]);
+            vst1q_u8(&out[j*16], veorq_u8(x[j], vld1q_u8(&data[j*16])));
+        }
+    }
+    
+    hi = be64(hi), lo = be64(lo);
+    memcpy(&iv[0], &hi, sizeof(hi)), memcpy(&iv[8], &lo, sizeof(lo));
+    mem_clean(rk, sizeof(rk));
+    mem_clean(x, sizeof(x));
+}
+#endif
+
+static void _BRAESCTRBlocksInit(uint8_t *out, const uint8_t *data, size_t blocks, const uint8_t k[256], size_t kl,
+                                uint8_t iv[16]);
+
+// aes-ctr backend, selected on first use from the best implementation supported by the cpu
+// NOTE: concurrent first calls may each run the selection, but they always store the same function pointer
+static void (*volatile _BRAESCTRBlocks)(uint8_t *, const uint8_t *, size_t, const uint8_t *, size_t, uint8_t *) =
+    _BRAESCTRBlocksInit;
+static const char *_BRAESBackendName = "portable";
+
+static void _BRAESCTRBlocksInit(uint8_t *out, const uint8_t *data, size_t blocks, const uint8_t k[256], size_t kl,
+                                uint8_t iv[16])
+{
+    void (*ctr)(uint8_t *, const uint8_t *, size_t, const uint8_t *, size_t, uint8_t *) = _BRAESCTRBlocksC;
+    
+#if BR_AES_AESNI
+    if (_BRAESAESNIIsSupported()) ctr = _BRAESCTRBlocksAESNI, _BRAESBackendName = "aes-ni";
+#elif BR_AES_ARMV8
+    ctr = _BRAESCTRBlocksARMv8, _BRAESBackendName = "armv8";
+#endif
+    _BRAESCTRBlocks = ctr;
+    ctr(out, data, blocks, k, kl, iv);
+}
+
+// returns the name of the aes backend in use: "portable", "aes-ni" or "armv8"
+const char *BRAESBackend(void)
+{
+    uint8_t k[256] = { 0 }, iv[16] = { 0 }, x[16] = { 0 };
+    
+    if (_BRAESCTRBlocks == _BRAESCTRBlocksInit) _BRAESCTRBlocks(x, x, 1, k, 16, iv); // force backend selection
+    return _BRAESBackendName;
+}
+
+// returns true if every aes backend supported by this cpu matches the portable implementation
+int BRAESSelfTest(void)
+{
+    void (*backends[2])(uint8_t *, const uint8_t *, size_t, const uint8_t *, size_t, uint8_t *);
+    uint8_t k[256], key[32], iv1[16], iv2[16], data[16*9], out1[sizeof(data)], out2[sizeof(data)];
+    uint32_t seed = 0x811c9dc5;
+    size_t i, n, kl, blocks, count = 0;
+    int ok = 1;
+    
+#if BR_AES_AESNI
+    if (_BRAESAESNIIsSupported()) backends[count++] = _BRAESCTRBlocksAESNI;
+#endif
+#if BR_AES_ARMV8
+    backends[count++] = _BRAESCTRBlocksARMv8;
+#endif
+    
+    for (n = 0; n < count; n++) {
+        for (kl = 16; kl <= 32; kl += 8) {
+            for (blocks = 1; blocks <= sizeof(data)/16 && ok; blocks++) {
+                for (i = 0; i < sizeof(key); i++) key[i] = (uint8_t)(seed = seed*0x01000193 + 0x9e3779b9);
+                for (i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(seed = seed*0x01000193 + 0x9e3779b9);
+                for (i = 0; i < 16; i++) iv1[i] = iv2[i] = (i < 14) ? (uint8_t)i : 0xff; // carry across the low word
+                _BRAESExpandKey(k, key, kl);
+                _BRAESCTRBlocksC(out1, data, blocks, k, kl, iv1);
+                backends[n](out2, data, blocks, k, kl, iv2);
+                if (memcmp(out1, out2, blocks*16) != 0 || memcmp(iv1, iv2, 16) != 0) ok = 0;
+            }
+        }
+    }
+    
+    mem_clean(k, sizeof(k));
+    return ok;
+}
+
 // aes-ecb block cipher
 void BRAESECBEncrypt(void *buf16, const void *key, size_t keyLen)
 {
@@ -1038,11 +2452,55 @@ void BRAESECBDecrypt(void *buf16, const void *key, size_t keyLen)
     mem_clean(k, sizeof(k));
 }
 
+// expands key into the 256 byte key schedule used by BRAESECBEncryptSchedule() and BRAESCTRSchedule()
+void BRAESKeySchedule(void *k256, const void *key, size_t keyLen)
+{
+    assert(k256 != NULL);
+    assert(key != NULL);
+    assert(keyLen == 16 || keyLen == 24 || keyLen == 32);
+    _BRAESExpandKey(k256, key, keyLen);
+}
+
+// aes-ecb block cipher, encrypt only, with a key schedule from BRAESKeySchedule()
+void BRAESECBEncryptSchedule(void *buf16, const void *k256, size_t keyLen)
+{
+    uint8_t zero[16] = { 0 }, iv[16];
+    
+    assert(buf16 != NULL);
+    assert(k256 != NULL);
+    assert(keyLen == 16 || keyLen == 24 || keyLen == 32);
+    memcpy(iv, buf16, 16);
+    _BRAESCTRBlocks(buf16, zero, 1, k256, keyLen, iv); // the ctr keystream for counter x is the encryption of x
+    mem_clean(iv, sizeof(iv));
+}
+
+// aes-ctr stream cipher encrypt/decrypt with a key schedule from BRAESKeySchedule()
+// iv16 is advanced past the blocks used, so consecutive calls continue the stream when each dataLen is a multiple of 16
+void BRAESCTRSchedule(void *out, const void *k256, size_t keyLen, void *iv16, const void *data, size_t dataLen)
+{
+    uint8_t x[16];
+    size_t blocks = dataLen/16, rem = dataLen % 16;
+    
+    assert(out != NULL);
+    assert(k256 != NULL);
+    assert(keyLen == 16 || keyLen == 24 || keyLen == 32);
+    assert(iv16 != NULL);
+    assert(data != NULL || dataLen == 0);
+    
+    if (blocks > 0) _BRAESCTRBlocks(out, data, blocks, k256, keyLen, iv16);
+    
+    if (rem > 0) {
+        memcpy(x, (const uint8_t *)data + blocks*16, rem);
+        _BRAESCTRBlocks(x, x, 1, k256, keyLen, iv16);
+        memcpy((uint8_t *)out + blocks*16, x, rem);
+        mem_clean(x, sizeof(x));
+    }
+}
+
 // aes-ctr stream cipher encrypt/decrypt
 void BRAESCTR(void *out, const void *key, size_t keyLen, const void *iv16, const void *data, size_t dataLen)
 {
-    uint8_t x[16], iv[16], k[256];
-    size_t off, i;
+    uint8_t iv[16], k[256];
     
     assert(out != NULL);
     assert(key != NULL);
@@ -1052,21 +2510,10 @@ void BRAESCTR(void *out, const void *key, size_t keyLen, const void *iv16, const
     
     memcpy(iv, iv16, 16);
     _BRAESExpandKey(k, key, keyLen);
-    
-    for (off = 0; off < dataLen; off++) {
-        if ((off % 16) == 0) { // generate xor compliment
-            memcpy(x, iv, 16);
-            _BRAESCipher(x, k, keyLen);
-            i = 16;
-            do { iv[--i]++; } while (iv[i] == 0 && i > 0); // increment iv with overflow
-        }
-        
-        ((uint8_t *)out)[off] = (((uint8_t *)data)[off] ^ x[off % 16]);
-    }
-    
+    BRAESCTRSchedule(out, k, keyLen, iv, data, dataLen);
     mem_clean(k, sizeof(k));
-    mem_clean(x, sizeof(x));
 }
+
 // aes-ctr stream cipher encrypt/decrypt
 void BRAESCTR_OFFSET(void *out, size_t outLen, const void *key, size_t keyLen, void *iv16, const void *data, size_t dataLen)
 {
@@ -1082,6 +2529,12 @@ void BRAESCTR_OFFSET(void *out, size_t outLen, const void *key, size_t keyLen, v
     memcpy(iv, iv16, 16);
     _BRAESExpandKey(k, key, keyLen);
     
+    if ((dataLen - outLen) % 16 == 0) { // block aligned, as rlpx frames always are
+        BRAESCTRSchedule(out, k, keyLen, iv16, data, outLen);
+        mem_clean(k, sizeof(k));
+        return;
+    }
+    
     for (off = (dataLen - outLen); off < dataLen; off++, outIdx++) {
         if ((off % 16) == 0) { // generate xor compliment
             memcpy(x, iv, 16);
@@ -1139,6 +2592,241 @@ void BRPBKDF2(void *dk, size_t dkLen, void (*hash)(void *, const void *, size_t)
     mem_clean(T, sizeof(T));
 }
 
+// writes the sha512 states after compressing the hmac key xored with the inner and outer pads, which are the same for
+// every hmac-sha512 using that key
+static void _BRHMACSHA512Pads(uint64_t istate[8], uint64_t ostate[8], const void *key, size_t keyLen)
+{
+    static const uint64_t iv[] = { 0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+                                   0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179 };
+    uint64_t k[16], x[16];
+    size_t i;
+    
+    memset(k, 0, sizeof(k));
+    if (keyLen > sizeof(k)) BRSHA512(k, key, keyLen);
+    else if (keyLen > 0) memcpy(k, key, keyLen);
+    for (i = 0; i < 16; i++) x[i] = k[i] ^ 0x3636363636363636;
+    memcpy(istate, iv, sizeof(iv));
+    _BRSHA512Compress(istate, x);
+    for (i = 0; i < 16; i++) x[i] = k[i] ^ 0x5c5c5c5c5c5c5c5c;
+    memcpy(ostate, iv, sizeof(iv));
+    _BRSHA512Compress(ostate, x);
+    mem_clean(k, sizeof(k));
+    mem_clean(x, sizeof(x));
+}
+
+// pbkdf2-hmac-sha512, the same as BRPBKDF2(dk, dkLen, BRSHA512, 512/8, pw, pwLen, salt, saltLen, rounds), but with the
+// hmac key pads compressed once up front, so that each round takes two sha512 compressions instead of four
+void BRPBKDF2_SHA512(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *salt, size_t saltLen,
+                     unsigned rounds)
+{
+    uint8_t s[saltLen + sizeof(uint32_t)];
+    uint64_t istate[8], ostate[8], r[8], x[16], U[8], T[8];
+    uint32_t i, j;
+    
+    assert(dk != NULL || dkLen == 0);
+    assert(pw != NULL || pwLen == 0);
+    assert(salt != NULL || saltLen == 0);
+    assert(rounds > 0);
+    
+    _BRHMACSHA512Pads(istate, ostate, pw, pwLen);
+    if (saltLen > 0) memcpy(s, salt, saltLen);
+    memset(x, 0, sizeof(x));
+    ((uint8_t *)x)[64] = 0x80; // padding for a 64 byte message following the 128 byte key pad block
+    x[15] = be64((uint64_t)(128 + 64)*8); // length in bits, including the key pad block
+    
+    for (i = 0; i < (dkLen + 64 - 1)/64; i++) {
+        j = be32(i + 1);
+        memcpy(s + saltLen, &j, sizeof(j));
+        BRHMAC(U, BRSHA512, 512/8, pw, pwLen, s, sizeof(s)); // U1 = hmac_hash(pw, salt || be32(i))
+        memcpy(T, U, sizeof(U));
+        
+        for (unsigned n = 1; n < rounds; n++) { // Urounds = hmac_hash(pw, Urounds-1)
+            memcpy(x, U, sizeof(U));
+            memcpy(r, istate, sizeof(r));
+            _BRSHA512Compress(r, x); // inner hash
+            for (j = 0; j < 8; j++) x[j] = be64(r[j]);
+            memcpy(r, ostate, sizeof(r));
+            _BRSHA512Compress(r, x); // outer hash, the inner hash has the same length and padding as U
+            for (j = 0; j < 8; j++) U[j] = be64(r[j]), T[j] ^= U[j]; // Ti = U1 ^ U2 ^ ... ^ Urounds
+        }
+        
+        // dk = T1 || T2 || ... || Tdklen/hlen
+        memcpy((uint8_t *)dk + i*64, T, (i*64 + 64 <= dkLen) ? 64 : dkLen % 64);
+    }
+    
+    mem_clean(s, sizeof(s));
+    mem_clean(istate, sizeof(istate));
+    mem_clean(ostate, sizeof(ostate));
+    mem_clean(r, sizeof(r));
+    mem_clean(x, sizeof(x));
+    mem_clean(U, sizeof(U));
+    mem_clean(T, sizeof(T));
+}
+
+#ifdef BR_SHA512_LANES
+// pbkdf2-hmac-sha512 of BR_SHA512_LANES independent passwords and salts, running the rounds in lockstep with one
+// derivation per vector lane
+BR_SHA512_LANES_TARGET
+static void _BRPBKDF2_SHA512Lanes(void *dks[], size_t dkLen, const void *pws[], const size_t pwLens[],
+                                  const void *salts[], const size_t saltLens[], unsigned rounds)
+{
+    _BRSHA512Vec istate[8], ostate[8], r[8], w[16], U[8], T[8];
+    uint64_t is[8], os[8], u[8];
+    size_t i, l, maxSaltLen = 0;
+    uint32_t j;
+    
+    for (l = 0; l < BR_SHA512_LANES; l++) {
+        if (saltLens[l] > maxSaltLen) maxSaltLen = saltLens[l];
+        _BRHMACSHA512Pads(is, os, pws[l], pwLens[l]);
+        for (i = 0; i < 8; i++) istate[i][l] = is[i], ostate[i][l] = os[i];
+    }
+
+    uint8_t s[maxSaltLen + sizeof(uint32_t)];
+    
+    for (i = 0; i < (dkLen + 64 - 1)/64; i++) {
+        for (l = 0; l < BR_SHA512_LANES; l++) { // U1 = hmac_hash(pw, salt || be32(i))
+            j = be32(i + 1);
+            if (saltLens[l] > 0) memcpy(s, salts[l], saltLens[l]);
+            memcpy(s + saltLens[l], &j, sizeof(j));
+            BRHMAC(u, BRSHA512, 512/8, pws[l], pwLens[l], s, saltLens[l] + sizeof(j));
+            for (j = 0; j < 8; j++) U[j][l] = be64(u[j]);
+        }
+        
+        memcpy(T, U, sizeof(U));
+        for (j = 8; j < 16; j++) w[j] = (_BRSHA512Vec){ 0 };
+        w[8] += 0x8000000000000000; // padding for a 64 byte message following the 128 byte key pad block
+        w[15] += (128 + 64)*8; // length in bits, including the key pad block
+        
+        for (unsigned n = 1; n < rounds; n++) { // Urounds = hmac_hash(pw, Urounds-1)
+            for (j = 0; j < 8; j++) w[j] = U[j];
+            memcpy(r, istate, sizeof(r));
+            _BRSHA512CompressLanes(r, w); // inner hash
+            for (j = 0; j < 8; j++) w[j] = r[j];
+            memcpy(r, ostate, sizeof(r));
+            _BRSHA512CompressLanes(r, w); // outer hash
+            for (j = 0; j < 8; j++) U[j] = r[j], T[j] ^= r[j]; // Ti = U1 ^ U2 ^ ... ^ Urounds
+        }
+        
+        for (l = 0; l < BR_SHA512_LANES; l++) { // dk = T1 || T2 || ... || Tdklen/hlen
+            for (j = 0; j < 8; j++) u[j] = be64(T[j][l]);
+            memcpy((uint8_t *)dks[l] + i*64, u, (i*64 + 64 <= dkLen) ? 64 : dkLen % 64);
+        }
+    }
+    
+    mem_clean(s, sizeof(s));
+    mem_clean(istate, sizeof(istate));
+    mem_clean(ostate, sizeof(ostate));
+    mem_clean(is, sizeof(is));
+    mem_clean(os, sizeof(os));
+    mem_clean(r, sizeof(r));
+    mem_clean(w, sizeof(w));
+    mem_clean(u, sizeof(u));
+    mem_clean(U, sizeof(U));
+    mem_clean(T, sizeof(T));
+}
+#endif
+
+// pbkdf2-hmac-sha512 of count independent passwords and salts, dks[i] = BRPBKDF2_SHA512(pws[i], salts[i]), running as
+// many derivations at a time as the cpu has vector lanes for (4 with avx2, 2 with neon), or one at a time if none are
+// available
+void BRPBKDF2_SHA512Batch(void *dks[], size_t dkLen, const void *pws[], const size_t pwLens[], const void *salts[],
+                          const size_t saltLens[], unsigned rounds, size_t count)
+{
+    size_t i = 0;
+    
+    assert(dks != NULL || count == 0);
+    assert(pws != NULL || count == 0);
+    assert(pwLens != NULL || count == 0);
+    assert(salts != NULL || count == 0);
+    assert(saltLens != NULL || count == 0);
+    assert(rounds > 0);
+    
+#ifdef BR_SHA512_LANES
+    if (count >= BR_SHA512_LANES/2 && _BRSHA512LanesIsSupported()) {
+        for (; i + BR_SHA512_LANES <= count; i += BR_SHA512_LANES) {
+            _BRPBKDF2_SHA512Lanes(&dks[i], dkLen, &pws[i], &pwLens[i], &salts[i], &saltLens[i], rounds);
+        }
+        
+        if (count - i >= BR_SHA512_LANES/2) { // fill the unused lanes with empty passwords and salts
+            uint8_t dummy[dkLen + 1];
+            void *ds[BR_SHA512_LANES];
+            const void *ps[BR_SHA512_LANES], *ss[BR_SHA512_LANES];
+            size_t pls[BR_SHA512_LANES], sls[BR_SHA512_LANES], l;
+            
+            for (l = 0; l < BR_SHA512_LANES; l++) {
+                ds[l] = (i + l < count) ? dks[i + l] : dummy;
+                ps[l] = (i + l < count) ? pws[i + l] : dummy;
+                pls[l] = (i + l < count) ? pwLens[i + l] : 0;
+                ss[l] = (i + l < count) ? salts[i + l] : dummy;
+                sls[l] = (i + l < count) ? saltLens[i + l] : 0;
+            }
+            
+            _BRPBKDF2_SHA512Lanes(ds, dkLen, ps, pls, ss, sls, rounds);
+            mem_clean(dummy, sizeof(dummy));
+            i = count;
+        }
+    }
+#endif
+    
+    for (; i < count; i++) BRPBKDF2_SHA512(dks[i], dkLen, pws[i], pwLens[i], salts[i], saltLens[i], rounds);
+}
+
+#if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+#define BR_SALSA_SIMD 1
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+typedef __m128i _BRSalsaVec;
+#define salsa_add(a, b)    _mm_add_epi32((a), (b))
+#define salsa_xor(a, b)    _mm_xor_si128((a), (b))
+#define salsa_rol(a, b)    _mm_xor_si128(_mm_slli_epi32((a), (b)), _mm_srli_epi32((a), 32 - (b)))
+#define salsa_shuf(a, n)   _mm_shuffle_epi32((a), ((n) == 1) ? 0x39 : ((n) == 2) ? 0x4e : 0x93)
+#define salsa_load(p)      _mm_loadu_si128((const __m128i *)(p))
+#define salsa_store(p, a)  _mm_storeu_si128((__m128i *)(p), (a))
+#else
+#include <arm_neon.h>
+typedef uint32x4_t _BRSalsaVec;
+#define salsa_add(a, b)    vaddq_u32((a), (b))
+#define salsa_xor(a, b)    veorq_u32((a), (b))
+#define salsa_rol(a, b)    vsriq_n_u32(vshlq_n_u32((a), (b)), (a), 32 - (b))
+#define salsa_shuf(a, n)   vextq_u32((a), (a), (n))
+#define salsa_load(p)      vld1q_u32((const uint32_t *)(p))
+#define salsa_store(p, a)  vst1q_u32((uint32_t *)(p), (a))
+#endif
+
+// word i of a simd salsa20 block is word salsa_idx(i) of the standard block, which stores the diagonals of the 4x4 word
+// matrix as rows, so that column and row rounds each operate on whole vectors with only lane rotations between them
+#define salsa_idx(i) (((i)*5) % 16)
+
+// salsa20/8 stream cipher: http://cr.yp.to/snuffle.html
+// b is in the diagonal word order given by salsa_idx()
+static void _salsa20_8(uint32_t b[16])
+{
+    _BRSalsaVec x0 = salsa_load(&b[0]), x1 = salsa_load(&b[4]), x2 = salsa_load(&b[8]), x3 = salsa_load(&b[12]),
+                b0 = x0, b1 = x1, b2 = x2, b3 = x3;
+    
+    for (unsigned i = 0; i < 8; i += 2) {
+        // operate on columns
+        x1 = salsa_xor(x1, salsa_rol(salsa_add(x0, x3), 7));
+        x2 = salsa_xor(x2, salsa_rol(salsa_add(x1, x0), 9));
+        x3 = salsa_xor(x3, salsa_rol(salsa_add(x2, x1), 13));
+        x0 = salsa_xor(x0, salsa_rol(salsa_add(x3, x2), 18));
+        x1 = salsa_shuf(x1, 3), x2 = salsa_shuf(x2, 2), x3 = salsa_shuf(x3, 1);
+        
+        // operate on rows
+        x3 = salsa_xor(x3, salsa_rol(salsa_add(x0, x1), 7));
+        x2 = salsa_xor(x2, salsa_rol(salsa_add(x3, x0), 9));
+        x1 = salsa_xor(x1, salsa_rol(salsa_add(x2, x3), 13));
+        x0 = salsa_xor(x0, salsa_rol(salsa_add(x1, x2), 18));
+        x1 = salsa_shuf(x1, 1), x2 = salsa_shuf(x2, 2), x3 = salsa_shuf(x3, 3);
+    }
+    
+    salsa_store(&b[0], salsa_add(b0, x0)), salsa_store(&b[4], salsa_add(b1, x1));
+    salsa_store(&b[8], salsa_add(b2, x2)), salsa_store(&b[12], salsa_add(b3, x3));
+}
+#else
+#define salsa_idx(i) (i)
+
 // salsa20/8 stream cipher: http://cr.yp.to/snuffle.html
 static void _salsa20_8(uint32_t b[16])
 {
@@ -1162,6 +2850,7 @@ static void _salsa20_8(uint32_t b[16])
     b[0] += x0, b[1] += x1, b[2] += x2,  b[3] += x3,  b[4] += x4,  b[5] += x5,  b[6] += x6,  b[7] += x7;
     b[8] += x8, b[9] += x9, b[10] += xa, b[11] += xb, b[12] += xc, b[13] += xd, b[14] += xe, b[15] += xf;
 }
+#endif
 
 static void _blockmix_salsa8(uint64_t *dest, const uint64_t *src, uint64_t *b, unsigned r)
 {
@@ -1177,25 +2866,26 @@ static void _blockmix_salsa8(uint64_t *dest, const uint64_t *src, uint64_t *b, u
     }
 }
 
-// scrypt key derivation: http://www.tarsnap.com/scrypt.html
-void BRScrypt(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *salt, size_t saltLen,
-              unsigned n, unsigned r, unsigned p)
+typedef struct {
+    uint32_t *b;
+    uint64_t *v;
+    unsigned n, r, p, first, step;
+} _BRScryptJob;
+
+// scrypt ROMix of each of the p blocks of b from job->first, every job->step blocks, using job->v as scratch memory
+static void *_BRScryptRoutine(void *info)
 {
-    uint64_t x[16*r], y[16*r], z[8], *v = malloc(128*r*n), m;
-    uint32_t b[32*r*p];
+    _BRScryptJob *job = info;
+    unsigned n = job->n, r = job->r;
+    uint64_t x[16*r], y[16*r], z[8], *v = job->v, m;
+    uint32_t *b;
     
-    assert(v != NULL);
-    assert(dk != NULL || dkLen == 0);
-    assert(pw != NULL || pwLen == 0);
-    assert(salt != NULL || saltLen == 0);
-    assert(n > 0);
-    assert(r > 0);
-    assert(p > 0);
-    
-    BRPBKDF2(b, sizeof(b), BRSHA256, 256/8, pw, pwLen, salt, saltLen, 1);
-    
-    for (int i = 0; i < p; i++) {
-        for (unsigned j = 0; j < 32*r; j++) ((uint32_t *)x)[j] = le32(b[i*32*r + j]);
+    for (unsigned i = job->first; i < job->p; i += job->step) {
+        b = &job->b[i*32*r];
+        
+        for (unsigned j = 0; j < 32*r; j++) { // load the block in salsa20 word order
+            ((uint32_t *)x)[j] = le32(b[(j & ~15) + salsa_idx(j & 15)]);
+        }
         
         for (unsigned j = 0; j < n; j += 2) {
             memcpy(&v[j*(16*r)], x, 128*r);
@@ -1204,23 +2894,80 @@ void BRScrypt(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *
             _blockmix_salsa8(x, y, z, r);
         }
         
-        for (unsigned j = 0; j < n; j += 2) {
-            m = le64(x[(2*r - 1)*8]) & (n - 1);
+        for (unsigned j = 0; j < n; j += 2) { // word 0 of the last 64 byte chunk is in place in either word order
+            m = ((uint32_t *)x)[(2*r - 1)*16] & (n - 1);
             for (unsigned k = 0; k < 16*r; k++) x[k] ^= v[m*(16*r) + k];
             _blockmix_salsa8(y, x, z, r);
-            m = le64(y[(2*r - 1)*8]) & (n - 1);
+            m = ((uint32_t *)y)[(2*r - 1)*16] & (n - 1);
             for (unsigned k = 0; k < 16*r; k++) y[k] ^= v[m*(16*r) + k];
             _blockmix_salsa8(x, y, z, r);
         }
         
-        for (unsigned j = 0; j < 32*r; j++) b[i*32*r + j] = le32(((uint32_t *)x)[j]);
+        for (unsigned j = 0; j < 32*r; j++) b[(j & ~15) + salsa_idx(j & 15)] = le32(((uint32_t *)x)[j]);
     }
     
-    BRPBKDF2(dk, dkLen, BRSHA256, 256/8, pw, pwLen, b, sizeof(b), 1);
-    mem_clean(b, sizeof(b));
     mem_clean(x, sizeof(x));
     mem_clean(y, sizeof(y));
     mem_clean(z, sizeof(z));
-    mem_clean(v, 128*r*n);
-    free(v);
+    return NULL;
+}
+
+// scrypt key derivation: http://www.tarsnap.com/scrypt.html
+void BRScrypt(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *salt, size_t saltLen,
+              unsigned n, unsigned r, unsigned p)
+{
+    BRScryptParallel(dk, dkLen, pw, pwLen, salt, saltLen, n, r, p, 1, NULL, 0);
+}
+
+// scrypt, running up to threadCount (0 for one per cpu core) of the p parallel ROMix blocks at once on worker threads
+// scratch may be NULL, or caller provided memory of scratchLen bytes to reuse across calls, which needs 128*r*n bytes
+// per thread, and limits the number of threads to what fits
+void BRScryptParallel(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *salt, size_t saltLen,
+                      unsigned n, unsigned r, unsigned p, unsigned threadCount, void *scratch, size_t scratchLen)
+{
+    uint32_t b[32*r*p];
+    uint64_t *v = scratch;
+    size_t i, vLen = (size_t)128*r*n;
+    
+    assert(dk != NULL || dkLen == 0);
+    assert(pw != NULL || pwLen == 0);
+    assert(salt != NULL || saltLen == 0);
+    assert(n > 0 && (n & (n - 1)) == 0);
+    assert(r > 0);
+    assert(p > 0);
+    assert(scratch != NULL || scratchLen == 0);
+    
+    if (threadCount == 0) threadCount = (sysconf(_SC_NPROCESSORS_ONLN) > 0) ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    if (threadCount > SCRYPT_MAX_THREADS) threadCount = SCRYPT_MAX_THREADS;
+    if (threadCount > p) threadCount = p;
+    if (scratch && threadCount > scratchLen/vLen) threadCount = (unsigned)(scratchLen/vLen);
+    if (scratch && threadCount == 0) v = NULL; // scratch is too small for even one block
+    if (threadCount == 0) threadCount = 1;
+    if (! v) v = malloc(vLen*threadCount);
+    assert(v != NULL);
+    
+    _BRScryptJob jobs[threadCount];
+    pthread_t threads[threadCount];
+    int started[threadCount];
+    
+    BRPBKDF2(b, sizeof(b), BRSHA256, 256/8, pw, pwLen, salt, saltLen, 1);
+    
+    for (i = 0; i < threadCount; i++) {
+        jobs[i] = (_BRScryptJob) { b, &v[i*vLen/sizeof(*v)], n, r, p, (unsigned)i, threadCount };
+        // the calling thread takes the first share, and any share a worker thread couldn't be started for
+        started[i] = (i > 0 && pthread_create(&threads[i], NULL, _BRScryptRoutine, &jobs[i]) == 0);
+    }
+    
+    for (i = 0; i < threadCount; i++) {
+        if (! started[i]) _BRScryptRoutine(&jobs[i]);
+    }
+    
+    for (i = 0; i < threadCount; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+    
+    BRPBKDF2(dk, dkLen, BRSHA256, 256/8, pw, pwLen, b, sizeof(b), 1);
+    mem_clean(b, sizeof(b));
+    mem_clean(v, vLen*threadCount);
+    if (v != scratch) free(v);
 }
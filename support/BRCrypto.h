@@ -39,33 +39,115 @@ void BRSHA1(void *md20, const void *data, size_t dataLen);
 
 void BRSHA256(void *md32, const void *data, size_t dataLen);
 
+// incremental sha-256 state, for hashing data as it's serialized instead of from one contiguous buffer
+typedef struct {
+    uint32_t buf[8];
+    uint32_t x[16]; // partial block held back until more data is added
+    uint64_t dataLen;
+} BRSHA256Context;
+
+void BRSHA256Init(BRSHA256Context *ctx);
+
+void BRSHA256Update(BRSHA256Context *ctx, const void *data, size_t dataLen);
+
+// writes the sha-256 of all data added to ctx, and cleans ctx
+void BRSHA256Final(BRSHA256Context *ctx, void *md32);
+
 void BRSHA224(void *md28, const void *data, size_t dataLen);
 
 // double-sha-256 = sha-256(sha-256(x))
 void BRSHA256_2(void *md32, const void *data, size_t dataLen);
 
+// batch double-sha-256 of count independent messages: md32s[i] = sha-256(sha-256(datas[i], lens[i]))
+// messages are hashed several at a time across simd lanes where the cpu supports it
+void BRSHA256_2Batch(void *md32s[], const void *datas[], const size_t lens[], size_t count);
+
+// the sha-256 compression backend is picked at runtime: sha-ni on x86, armv8 crypto extensions on arm64, or portable c
+// returns the name of the backend in use: "portable", "sha-ni" or "armv8"
+const char *BRSHA256Backend(void);
+
+// returns true if every sha-256 backend supported by this cpu matches the portable implementation
+int BRSHA256SelfTest(void);
+
 void BRSHA384(void *md48, const void *data, size_t dataLen);
 
 void BRSHA512(void *md64, const void *data, size_t dataLen);
 
+// incremental sha-512 state
+typedef struct {
+    uint64_t buf[8];
+    uint64_t x[16];
+    uint64_t dataLen;
+} BRSHA512Context;
+
+void BRSHA512Init(BRSHA512Context *ctx);
+
+void BRSHA512Update(BRSHA512Context *ctx, const void *data, size_t dataLen);
+
+// writes the sha-512 of all data added to ctx, and cleans ctx
+void BRSHA512Final(BRSHA512Context *ctx, void *md64);
+
 // ripemd-160: http://homes.esat.kuleuven.be/~bosselae/ripemd160.html
 void BRRMD160(void *md20, const void *data, size_t dataLen);
 
+// incremental ripemd-160 state
+typedef struct {
+    uint32_t buf[5];
+    uint32_t x[16];
+    uint64_t dataLen;
+} BRRMD160Context;
+
+void BRRMD160Init(BRRMD160Context *ctx);
+
+void BRRMD160Update(BRRMD160Context *ctx, const void *data, size_t dataLen);
+
+// writes the ripemd-160 of all data added to ctx, and cleans ctx
+void BRRMD160Final(BRRMD160Context *ctx, void *md20);
+
 // bitcoin hash-160 = ripemd-160(sha-256(x))
 void BRHash160(void *md20, const void *data, size_t dataLen);
 
+// hash-160 of count independent messages, md20s[i] = ripemd-160(sha-256(datas[i])), hashing as many messages at a time
+// as the cpu has vector lanes for (8 with avx2, 4 with neon), or one at a time if none are available
+void BRHash160Batch(void *md20s[], const void *datas[], const size_t lens[], size_t count);
+
 // sha3-256: http://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.202.pdf
 void BRSHA3_256(void *md32, const void *data, size_t dataLen);
 
 // keccak-256: https://keccak.team/files/Keccak-submission-3.pdf
 void BRKeccak256(void *md32, const void *data, size_t dataLen);
 
+// incremental keccak-256 state
+typedef struct {
+    uint64_t buf[25];
+    uint64_t x[17];
+    uint64_t dataLen;
+} BRKeccak256Context;
+
+void BRKeccak256Init(BRKeccak256Context *ctx);
+
+void BRKeccak256Update(BRKeccak256Context *ctx, const void *data, size_t dataLen);
+
+// writes the keccak-256 of all data added to ctx, and cleans ctx
+void BRKeccak256Final(BRKeccak256Context *ctx, void *md32);
+
+// batch keccak-256 of count independent messages: md32s[i] = keccak-256(datas[i], lens[i])
+// messages are hashed several at a time across simd lanes where the cpu supports it
+void BRKeccak256Batch(void *md32s[], const void *datas[], const size_t lens[], size_t count);
+
+// keccak-f[1600] permutation of the 25 word keccak state, shared by the sha3 and keccak hash implementations
+void BRKeccakF1600(uint64_t state[25]);
+
 // md5 - for non-cryptographic use only
 void BRMD5(void *md16, const void *data, size_t dataLen);
 
 // murmurHash3 (x86_32): https://code.google.com/p/smhasher/ - for non cryptographic use only
 uint32_t BRMurmur3_32(const void *data, size_t dataLen, uint32_t seed);
 
+// murmurHash3 (x86_32) of data with each of seedCount seeds, several seeds at a time across simd lanes where the cpu
+// supports it
+void BRMurmur3_32Seeds(uint32_t hashes[], const uint32_t seeds[], size_t seedCount, const void *data, size_t dataLen);
+
 // sipHash-64: https://131002.net/siphash
 uint64_t BRSip64(const void *key16, const void *data, size_t dataLen);
     
@@ -82,15 +164,79 @@ void BRHMACDRBG(void *out, size_t outLen, void *K, void *V, void (*hash)(void *,
 // NOTE: must use constant time mem comparison when verifying mac to defend against timing attacks
 void BRPoly1305(void *mac16, const void *key32, const void *data, size_t dataLen);
 
+// incremental poly1305 state, for data that isn't contiguous in memory
+typedef struct {
+    uint64_t h[5], r[5]; // accumulator and clamped key, in limbs of 44bits on 64bit cpus, or 26bits otherwise
+    uint8_t pad[16];
+    uint8_t buf[16]; // partial block held back until more data is added
+    size_t bufLen;
+} BRPoly1305Context;
+
+// initializes ctx for incrementally computing the poly1305 mac of data with the one-time key32
+void BRPoly1305Init(BRPoly1305Context *ctx, const void *key32);
+
+// adds dataLen bytes of data to the mac being computed with ctx
+void BRPoly1305Update(BRPoly1305Context *ctx, const void *data, size_t dataLen);
+
+// writes the 16 byte mac of all data added to ctx, and cleans ctx
+// NOTE: must use constant time mem comparison when verifying mac to defend against timing attacks
+void BRPoly1305Final(BRPoly1305Context *ctx, void *mac16);
+
 // chacha20 stream cipher: https://cr.yp.to/chacha.html
 void BRChacha20(void *out, const void *key32, const void *iv8, const void *data, size_t dataLen, uint64_t counter);
-    
+
+// incremental chacha20 state, for data that isn't contiguous in memory
+typedef struct {
+    uint32_t s[16];
+    uint32_t buf[16]; // keystream block, of which the last bufLen bytes haven't been used yet
+    size_t bufLen;
+} BRChacha20Context;
+
+// initializes ctx for incrementally encrypting or decrypting with the chacha20 stream cipher, starting at block counter
+void BRChacha20Init(BRChacha20Context *ctx, const void *key32, const void *iv8, uint64_t counter);
+
+// xors dataLen bytes of data with the next bytes of the keystream for ctx, and writes the result to out
+void BRChacha20Update(BRChacha20Context *ctx, void *out, const void *data, size_t dataLen);
+
 // chacha20-poly1305 authenticated encryption with associated data (AEAD): https://tools.ietf.org/html/rfc7539
 size_t BRChacha20Poly1305AEADEncrypt(void *out, size_t outLen, const void *key32, const void *nonce12,
                                      const void *data, size_t dataLen, const void *ad, size_t adLen);
 
 size_t BRChacha20Poly1305AEADDecrypt(void *out, size_t outLen, const void *key32, const void *nonce12,
                                      const void *data, size_t dataLen, const void *ad, size_t adLen);
+
+// incremental chacha20-poly1305 AEAD state, for messages that aren't contiguous in memory
+typedef struct {
+    BRChacha20Context chacha;
+    BRPoly1305Context poly;
+    uint64_t adLen, dataLen;
+} BRChacha20Poly1305Context;
+
+// initializes ctx for incrementally encrypting or decrypting a message with chacha20-poly1305 AEAD, authenticating
+// it together with the associated data ad
+void BRChacha20Poly1305AEADInit(BRChacha20Poly1305Context *ctx, const void *key32, const void *nonce12,
+                                const void *ad, size_t adLen);
+
+// encrypts the next dataLen bytes of the message from data to out
+void BRChacha20Poly1305AEADEncryptUpdate(BRChacha20Poly1305Context *ctx, void *out, const void *data, size_t dataLen);
+
+// writes the 16 byte mac of the message to mac16, and cleans ctx
+void BRChacha20Poly1305AEADEncryptFinal(BRChacha20Poly1305Context *ctx, void *mac16);
+
+// decrypts the next dataLen bytes of the message from data to out
+// NOTE: the decrypted data must not be trusted until BRChacha20Poly1305AEADDecryptFinal() returns true
+void BRChacha20Poly1305AEADDecryptUpdate(BRChacha20Poly1305Context *ctx, void *out, const void *data, size_t dataLen);
+
+// returns true if mac16 authenticates the decrypted message, and cleans ctx
+int BRChacha20Poly1305AEADDecryptFinal(BRChacha20Poly1305Context *ctx, const void *mac16);
+
+// fills buf with bufLen cryptographically secure random bytes, from a chacha20 keystream per thread, keyed from the os
+// entropy source and rekeyed after every use, with new os entropy mixed in every megabyte and after a fork
+// most calls are served from a buffer, so frequent small requests don't each go to the os
+void BRRandBytes(void *buf, size_t bufLen);
+
+// returns a cryptographically secure random number less than upperBound, without modulo bias
+uint32_t BRRandUniform(uint32_t upperBound);
     
 // aes-ecb block cipher
 void BRAESECBEncrypt(void *buf16, const void *key, size_t keyLen);
@@ -100,14 +246,47 @@ void BRAESECBDecrypt(void *buf16, const void *key, size_t keyLen);
 // aes-ctr stream cipher encrypt/decrypt
 void BRAESCTR(void *out, const void *key, size_t keyLen, const void *iv16, const void *data, size_t dataLen);
 void BRAESCTR_OFFSET(void *out, size_t outLen, const void *key, size_t keyLen, void *iv16, const void *data, size_t dataLen);
+
+// expands key into the 256 byte key schedule k256, for repeated use with the same key
+void BRAESKeySchedule(void *k256, const void *key, size_t keyLen);
+
+// aes-ecb block cipher, encrypt only, with a key schedule from BRAESKeySchedule()
+void BRAESECBEncryptSchedule(void *buf16, const void *k256, size_t keyLen);
+
+// aes-ctr stream cipher encrypt/decrypt with a key schedule from BRAESKeySchedule()
+// iv16 is advanced past the blocks used, so consecutive calls continue the stream when each dataLen is a multiple of 16
+void BRAESCTRSchedule(void *out, const void *k256, size_t keyLen, void *iv16, const void *data, size_t dataLen);
+
+// the aes-ctr backend is picked at runtime: aes-ni on x86, armv8 crypto extensions on arm64, or portable c
+// returns the name of the backend in use: "portable", "aes-ni" or "armv8"
+const char *BRAESBackend(void);
+
+// returns true if every aes backend supported by this cpu matches the portable implementation
+int BRAESSelfTest(void);
     
 void BRPBKDF2(void *dk, size_t dkLen, void (*hash)(void *, const void *, size_t), size_t hashLen,
               const void *pw, size_t pwLen, const void *salt, size_t saltLen, unsigned rounds);
 
+// pbkdf2-hmac-sha512, the same as BRPBKDF2(dk, dkLen, BRSHA512, 512/8, pw, pwLen, salt, saltLen, rounds), but faster
+void BRPBKDF2_SHA512(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *salt, size_t saltLen,
+                     unsigned rounds);
+
+// pbkdf2-hmac-sha512 of count independent passwords and salts, dks[i] = BRPBKDF2_SHA512(pws[i], salts[i]), running as
+// many derivations at a time as the cpu has vector lanes for (4 with avx2, 2 with neon), or one at a time if none are
+// available
+void BRPBKDF2_SHA512Batch(void *dks[], size_t dkLen, const void *pws[], const size_t pwLens[], const void *salts[],
+                          const size_t saltLens[], unsigned rounds, size_t count);
+
 // scrypt key derivation: http://www.tarsnap.com/scrypt.html
 void BRScrypt(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *salt, size_t saltLen,
               unsigned n, unsigned r, unsigned p);
 
+// scrypt, running up to threadCount (0 for one per cpu core) of the p parallel ROMix blocks at once on worker threads
+// scratch may be NULL, or caller provided memory of scratchLen bytes to reuse across calls, which needs 128*r*n bytes
+// per thread, and limits the number of threads to what fits
+void BRScryptParallel(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *salt, size_t saltLen,
+                      unsigned n, unsigned r, unsigned p, unsigned threadCount, void *scratch, size_t scratchLen);
+
 // zeros out memory in a way that can't be optimized out by the compiler
 inline static void mem_clean(void *ptr, size_t len)
 {
@@ -0,0 +1,252 @@
+//
+//  BRFeeEstimator.c
+//
+//  Copyright (c) 2019 breadwallet LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "BRFeeEstimator.h"
+#include "BRArray.h"
+#include <stdlib.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <assert.h>
+
+#define FEE_BUCKETS_MAX      128    // fee rate buckets, each about 10% above the one before it
+#define FEE_PENDING_MAX      1000   // most unconfirmed transactions tracked at once, the oldest are dropped first
+#define FEE_DECAY            0.998  // counts are multiplied by this every block, a half life of about 350 blocks
+#define FEE_SUCCESS_RATIO    0.85   // fraction of a range of buckets that must have confirmed within the target
+#define FEE_SUFFICIENT_TXS   2.0    // decayed number of transactions a range of buckets needs before it's judged
+
+typedef struct {
+    UInt256 txHash;
+    uint32_t height; // best block height when the transaction was first seen
+    uint32_t bucket;
+} BRFeeEstimatorTx;
+
+typedef struct {
+    float confirmed[BR_FEE_ESTIMATOR_MAX_TARGET]; // transactions confirmed within index + 1 blocks
+    float total; // transactions that either confirmed, or stayed unconfirmed longer than the max target
+} BRFeeEstimatorBucket;
+
+struct BRFeeEstimatorStruct {
+    uint64_t bounds[FEE_BUCKETS_MAX + 1]; // bucket i holds fee rates from bounds[i] to bounds[i + 1]
+    BRFeeEstimatorBucket buckets[FEE_BUCKETS_MAX];
+    size_t bucketCount;
+    BRFeeEstimatorTx *pending;
+    uint32_t height;
+    uint64_t estimates[BR_FEE_ESTIMATOR_MAX_TARGET];
+    int estimatesDirty;
+    pthread_mutex_t lock;
+};
+
+// returns a newly allocated estimator for fee rates from minFeeRate to maxFeeRate, in any units (satoshis per kb, wei
+// per gas, etc), that must be freed by calling BRFeeEstimatorFree()
+BRFeeEstimator *BRFeeEstimatorNew(uint64_t minFeeRate, uint64_t maxFeeRate)
+{
+    BRFeeEstimator *estimator = calloc(1, sizeof(*estimator));
+    size_t n = 0;
+
+    assert(estimator != NULL);
+    estimator->bounds[0] = (minFeeRate > 0) ? minFeeRate : 1;
+
+    do {
+        estimator->bounds[n + 1] = estimator->bounds[n] + ((estimator->bounds[n] >= 10) ? estimator->bounds[n]/10 : 1);
+        n++;
+    } while (estimator->bounds[n] < maxFeeRate && n < FEE_BUCKETS_MAX);
+
+    estimator->bucketCount = n;
+    array_new(estimator->pending, 16);
+    pthread_mutex_init(&estimator->lock, NULL);
+    return estimator;
+}
+
+// returns the bucket holding feeRate, rates outside the estimator's range go in the first or last bucket
+static uint32_t _BRFeeEstimatorBucket(const BRFeeEstimator *estimator, uint64_t feeRate)
+{
+    size_t lo = 0, hi = estimator->bucketCount;
+
+    while (hi - lo > 1) { // bounds[lo] <= feeRate < bounds[hi], or feeRate is outside the range
+        size_t mid = (lo + hi)/2;
+
+        if (estimator->bounds[mid] <= feeRate) lo = mid;
+        else hi = mid;
+    }
+
+    return (uint32_t)lo;
+}
+
+static ssize_t _BRFeeEstimatorPendingIndex(const BRFeeEstimator *estimator, UInt256 txHash)
+{
+    for (size_t i = array_count(estimator->pending); i > 0; i--) {
+        if (UInt256Eq(estimator->pending[i - 1].txHash, txHash)) return (ssize_t)(i - 1);
+    }
+
+    return -1;
+}
+
+// starts tracking a transaction first seen unconfirmed when the best block was at height, paying feeRate
+void BRFeeEstimatorAddTx(BRFeeEstimator *estimator, UInt256 txHash, uint64_t feeRate, uint32_t height)
+{
+    BRFeeEstimatorTx tx = { txHash, height, 0 };
+
+    assert(estimator != NULL);
+    pthread_mutex_lock(&estimator->lock);
+
+    if (_BRFeeEstimatorPendingIndex(estimator, txHash) < 0) {
+        tx.bucket = _BRFeeEstimatorBucket(estimator, feeRate);
+        if (array_count(estimator->pending) >= FEE_PENDING_MAX) array_rm(estimator->pending, 0);
+        array_add(estimator->pending, tx);
+    }
+
+    pthread_mutex_unlock(&estimator->lock);
+}
+
+static void _BRFeeEstimatorConfirm(BRFeeEstimator *estimator, size_t index, uint32_t height)
+{
+    BRFeeEstimatorTx *tx = &estimator->pending[index];
+    BRFeeEstimatorBucket *bucket = &estimator->buckets[tx->bucket];
+    uint32_t blocks = (height > tx->height) ? height - tx->height : 1;
+
+    for (uint32_t t = blocks; t <= BR_FEE_ESTIMATOR_MAX_TARGET; t++) bucket->confirmed[t - 1] += 1;
+    bucket->total += 1;
+    array_rm(estimator->pending, index);
+    estimator->estimatesDirty = 1;
+}
+
+// records that a tracked transaction was included in the block at height, ignored if it isn't being tracked
+void BRFeeEstimatorConfirmTx(BRFeeEstimator *estimator, UInt256 txHash, uint32_t height)
+{
+    ssize_t index;
+
+    assert(estimator != NULL);
+    pthread_mutex_lock(&estimator->lock);
+    index = _BRFeeEstimatorPendingIndex(estimator, txHash);
+    if (index >= 0) _BRFeeEstimatorConfirm(estimator, (size_t)index, height);
+    pthread_mutex_unlock(&estimator->lock);
+}
+
+// stops tracking a transaction that will never confirm (rejected, double spent, etc) without counting it
+void BRFeeEstimatorRemoveTx(BRFeeEstimator *estimator, UInt256 txHash)
+{
+    ssize_t index;
+
+    assert(estimator != NULL);
+    pthread_mutex_lock(&estimator->lock);
+    index = _BRFeeEstimatorPendingIndex(estimator, txHash);
+    if (index >= 0) array_rm(estimator->pending, (size_t)index);
+    pthread_mutex_unlock(&estimator->lock);
+}
+
+// advances the estimator to a new best block at height, confirming any tracked txHashes it includes
+// decays the counts, and counts transactions pending longer than BR_FEE_ESTIMATOR_MAX_TARGET blocks as failures
+void BRFeeEstimatorAddBlock(BRFeeEstimator *estimator, uint32_t height, const UInt256 txHashes[], size_t txCount)
+{
+    ssize_t index;
+
+    assert(estimator != NULL);
+    assert(txHashes != NULL || txCount == 0);
+    pthread_mutex_lock(&estimator->lock);
+
+    for (size_t i = 0; i < txCount && array_count(estimator->pending) > 0; i++) {
+        index = _BRFeeEstimatorPendingIndex(estimator, txHashes[i]);
+        if (index >= 0) _BRFeeEstimatorConfirm(estimator, (size_t)index, height);
+    }
+
+    if (height > estimator->height) { // a reorg or a repeated block doesn't decay the counts again
+        uint32_t blocks = (estimator->height > 0 && height - estimator->height < 100) ? height - estimator->height : 1;
+        float decay = 1;
+
+        while (blocks-- > 0) decay *= FEE_DECAY;
+
+        for (size_t i = 0; i < estimator->bucketCount; i++) {
+            BRFeeEstimatorBucket *bucket = &estimator->buckets[i];
+
+            for (size_t t = 0; t < BR_FEE_ESTIMATOR_MAX_TARGET; t++) bucket->confirmed[t] *= decay;
+            bucket->total *= decay;
+        }
+
+        estimator->height = height;
+        estimator->estimatesDirty = 1;
+    }
+
+    for (size_t i = array_count(estimator->pending); i > 0; i--) {
+        BRFeeEstimatorTx *tx = &estimator->pending[i - 1];
+
+        if (tx->height + BR_FEE_ESTIMATOR_MAX_TARGET < estimator->height) {
+            estimator->buckets[tx->bucket].total += 1;
+            array_rm(estimator->pending, i - 1);
+            estimator->estimatesDirty = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&estimator->lock);
+}
+
+// walks down from the highest fee rate bucket, grouping buckets into ranges with enough transactions to judge, and
+// returns the top of the lowest range before the first range that fails to confirm often enough within target blocks
+static uint64_t _BRFeeEstimatorCompute(const BRFeeEstimator *estimator, uint32_t target)
+{
+    double confirmed = 0, total = 0;
+    size_t best = estimator->bucketCount;
+
+    for (size_t i = estimator->bucketCount; i > 0; i--) {
+        confirmed += estimator->buckets[i - 1].confirmed[target - 1];
+        total += estimator->buckets[i - 1].total;
+        if (total < FEE_SUFFICIENT_TXS) continue;
+        if (confirmed < total*FEE_SUCCESS_RATIO) break;
+        best = i - 1;
+        confirmed = total = 0;
+    }
+
+    return (best < estimator->bucketCount) ? estimator->bounds[best + 1] : 0;
+}
+
+// returns a fee rate at or above which at least 85% of the transactions seen confirmed within targetBlocks, or 0 if
+// not enough transactions have been seen yet for an estimate
+uint64_t BRFeeEstimatorEstimate(BRFeeEstimator *estimator, uint32_t targetBlocks)
+{
+    uint64_t feeRate;
+
+    assert(estimator != NULL);
+    if (targetBlocks < 1) targetBlocks = 1;
+    if (targetBlocks > BR_FEE_ESTIMATOR_MAX_TARGET) targetBlocks = BR_FEE_ESTIMATOR_MAX_TARGET;
+    pthread_mutex_lock(&estimator->lock);
+
+    if (estimator->estimatesDirty) {
+        for (uint32_t t = 1; t <= BR_FEE_ESTIMATOR_MAX_TARGET; t++) {
+            estimator->estimates[t - 1] = _BRFeeEstimatorCompute(estimator, t);
+        }
+
+        estimator->estimatesDirty = 0;
+    }
+
+    feeRate = estimator->estimates[targetBlocks - 1];
+    pthread_mutex_unlock(&estimator->lock);
+    return feeRate;
+}
+
+// frees memory allocated for estimator
+void BRFeeEstimatorFree(BRFeeEstimator *estimator)
+{
+    assert(estimator != NULL);
+    array_free(estimator->pending);
+    pthread_mutex_destroy(&estimator->lock);
+    free(estimator);
+}
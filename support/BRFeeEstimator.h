@@ -0,0 +1,71 @@
+//
+//  BRFeeEstimator.h
+//
+//  Copyright (c) 2019 breadwallet LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef BRFeeEstimator_h
+#define BRFeeEstimator_h
+
+#include "BRInt.h"
+#include <stddef.h>
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BR_FEE_ESTIMATOR_MAX_TARGET 25 // the most blocks a confirmation target may be
+
+// learns the fee rates that get transactions confirmed from the transactions it sees broadcast and then included in
+// blocks. fee rates are grouped into buckets about 10% apart, and each bucket keeps counts of how many of its
+// transactions confirmed within each target number of blocks, decayed a little every block so old blocks count less
+// estimates are cached, so they're cheap enough to request before every send
+typedef struct BRFeeEstimatorStruct BRFeeEstimator;
+
+// returns a newly allocated estimator for fee rates from minFeeRate to maxFeeRate, in any units (satoshis per kb, wei
+// per gas, etc), that must be freed by calling BRFeeEstimatorFree()
+BRFeeEstimator *BRFeeEstimatorNew(uint64_t minFeeRate, uint64_t maxFeeRate);
+
+// starts tracking a transaction first seen unconfirmed when the best block was at height, paying feeRate
+void BRFeeEstimatorAddTx(BRFeeEstimator *estimator, UInt256 txHash, uint64_t feeRate, uint32_t height);
+
+// records that a tracked transaction was included in the block at height, ignored if it isn't being tracked
+void BRFeeEstimatorConfirmTx(BRFeeEstimator *estimator, UInt256 txHash, uint32_t height);
+
+// stops tracking a transaction that will never confirm (rejected, double spent, etc) without counting it
+void BRFeeEstimatorRemoveTx(BRFeeEstimator *estimator, UInt256 txHash);
+
+// advances the estimator to a new best block at height, confirming any tracked txHashes it includes
+// decays the counts, and counts transactions pending longer than BR_FEE_ESTIMATOR_MAX_TARGET blocks as failures
+void BRFeeEstimatorAddBlock(BRFeeEstimator *estimator, uint32_t height, const UInt256 txHashes[], size_t txCount);
+
+// returns a fee rate at or above which at least 85% of the transactions seen confirmed within targetBlocks, or 0 if
+// not enough transactions have been seen yet for an estimate
+uint64_t BRFeeEstimatorEstimate(BRFeeEstimator *estimator, uint32_t targetBlocks);
+
+// frees memory allocated for estimator
+void BRFeeEstimatorFree(BRFeeEstimator *estimator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BRFeeEstimator_h
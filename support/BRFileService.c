@@ -25,14 +25,30 @@
 
 #include "BRFileService.h"
 #include "BRArray.h"
+#include "BRCrypto.h"
+#include "BRStats.h"
 #include <stdio.h>
 #include <string.h>
 #include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/file.h>
 #include <errno.h>
+#include <assert.h>
+#include <pthread.h>
 
 #define FILE_SERVICE_INITIAL_TYPE_COUNT    (5)
 #define FILE_SERVICE_INITIAL_HANDLER_COUNT    (2)
+#define FILE_SERVICE_INITIAL_INDEX_COUNT    (100)
+#define FILE_SERVICE_INITIAL_PENDING_COUNT    (100)
+
+/// Compact a type's log once its dead bytes reach this and outnumber its live bytes
+#define FILE_SERVICE_LOG_COMPACT_MIN_BYTES    (256 * 1024)
+
+#define FILE_SERVICE_LOAD_MAX_THREADS      (4)
+#define FILE_SERVICE_LOAD_MIN_PER_THREAD   (64)  // fewer records parse faster than a thread can be started
 
 /// Return 0 on success, -1 otherwise
 static int directoryMake (const char *path) {
@@ -50,6 +66,107 @@ typedef enum {
 
 static BRFileServiceHeaderFormatVersion currentHeaderFormatVersion = HEADER_FORMAT_1;
 
+///
+/// Each type's entities are stored in a single append-only log, `<pathToType>/<type>.log`.  A save
+/// appends a record holding the entity's bytes; a remove appends a record marking the identifier
+/// as removed.  An in-memory index, keyed by identifier, locates the latest record of each live
+/// entity.  Records superseded by later ones are dead; once they outnumber the live ones the log is
+/// compacted by rewriting just the live records.
+///
+/// A record is a fixed size header followed by `bytesCount` bytes; all integers are little endian:
+///    uint8_t  kind        - FILE_SERVICE_RECORD_SAVE or FILE_SERVICE_RECORD_REMOVE
+///    UInt256  identifier
+///    uint8_t  version     - the BRFileServiceVersion of the bytes (0 for a remove)
+///    uint32_t bytesCount  - (0 for a remove)
+///    uint32_t checksum    - BRMurmur3_32 of the bytes, seeded with BRMurmur3_32 of the header fields above
+///
+/// A record that is truncated or fails its checksum, as from a crash during an append, ends the log;
+/// one damaged in the middle of the log, as by a partial write of a flash page, is skipped over by
+/// looking for the next record that checks out, so that only the damaged records are lost.  Either
+/// way the loss is counted; see fileServiceGetDroppedCount().
+///
+typedef enum {
+    FILE_SERVICE_RECORD_SAVE = 1,
+    FILE_SERVICE_RECORD_REMOVE = 2
+} BRFileServiceRecordKind;
+
+#define FILE_SERVICE_RECORD_HEADER_SIZE    (1 + sizeof (UInt256) + sizeof (BRFileServiceVersion) + 2 * sizeof (uint32_t))
+#define FILE_SERVICE_RECORD_CHECKSUM_OFFSET    (FILE_SERVICE_RECORD_HEADER_SIZE - sizeof (uint32_t))
+
+///
+/// The location of an entity's latest record in its type's log.  The identifier must be first, so
+/// that the index can be searched with a UInt256 alone.
+///
+typedef struct {
+    UInt256 identifier;
+    uint64_t offset;
+    uint32_t size;                  // size of the record, header included
+    BRFileServiceVersion version;
+} BRFileServiceLogEntry;
+
+static size_t
+fileServiceLogEntryHash (const void *entry) {
+    return (size_t) UInt32GetLE (((const BRFileServiceLogEntry *) entry)->identifier.u8);
+}
+
+static int
+fileServiceLogEntryEq (const void *entry1, const void *entry2) {
+    return UInt256Eq (((const BRFileServiceLogEntry *) entry1)->identifier,
+                      ((const BRFileServiceLogEntry *) entry2)->identifier);
+}
+
+static void
+fileServiceLogEntryRelease (void *info, void *entry) {
+    free (entry);
+}
+
+///
+/// A log mapped by fileServiceLogRead().  The log stays open, holding its shared file lock, until
+/// fileServiceLogReadRelease(); see fileServiceLogTruncate().
+///
+typedef struct {
+    uint8_t *bytes;
+    FILE *file;
+} BRFileServiceMapping;
+
+///
+/// A save or remove queued for the writer thread.  A later record for the same type and identifier
+/// replaces one still queued; the identifier must be first, as for BRFileServiceLogEntry.
+///
+typedef struct {
+    UInt256 identifier;
+    size_t typeIndex;
+    BRFileServiceRecordKind kind;
+    BRFileServiceVersion version;
+    uint8_t *bytes;
+    uint32_t bytesCount;
+} BRFileServicePendingRecord;
+
+static size_t
+fileServicePendingRecordHash (const void *record) {
+    const BRFileServicePendingRecord *r = record;
+    return (size_t) (UInt32GetLE (r->identifier.u8) ^ r->typeIndex);
+}
+
+static int
+fileServicePendingRecordEq (const void *record1, const void *record2) {
+    const BRFileServicePendingRecord *r1 = record1, *r2 = record2;
+    return r1 == r2 || (r1->typeIndex == r2->typeIndex && UInt256Eq (r1->identifier, r2->identifier));
+}
+
+static void
+fileServicePendingRecordRelease (void *info, void *record) {
+    free (((BRFileServicePendingRecord *) record)->bytes);
+    free (record);
+}
+
+static uint32_t
+fileServiceRecordChecksum (const uint8_t *header,
+                           const uint8_t *bytes,
+                           uint32_t bytesCount) {
+    return BRMurmur3_32 (bytes, bytesCount, BRMurmur3_32 (header, FILE_SERVICE_RECORD_CHECKSUM_OFFSET, 0));
+}
+
 ///
 /// The handlers for a particular entity's version
 ///
@@ -68,6 +185,20 @@ typedef struct {
     char *type;
     BRFileServiceVersion currentVersion;
     BRArrayOf(BRFileServiceEntityHandler) handlers;
+
+    // The type's log, opened for appending on first use, and the index of its live records.
+    FILE *log;
+    BRSetOf(BRFileServiceLogEntry*) index;
+    uint64_t logBytes;
+    uint64_t deadBytes;
+
+    // If the type's readers may be called concurrently; see fileServiceSetLoadConcurrent().
+    int loadConcurrent;
+
+    // If a load drops records that can't be read; see fileServiceSetLoadRepair().  And the records
+    // dropped so far, as corrupt or unreadable.
+    int loadRepair;
+    size_t droppedCount;
 } BRFileServiceEntityType;
 
 static void
@@ -75,6 +206,12 @@ fileServiceEntityTypeRelease (const BRFileServiceEntityType *entityType) {
     free (entityType->type);
     if (NULL != entityType->handlers)
         array_free(entityType->handlers);
+    if (NULL != entityType->log)
+        fclose (entityType->log);
+    if (NULL != entityType->index) {
+        BRSetApply (entityType->index, NULL, fileServiceLogEntryRelease);
+        BRSetFree (entityType->index);
+    }
 }
 
 static BRFileServiceEntityHandler *
@@ -107,6 +244,28 @@ struct BRFileServiceRecord {
     BRArrayOf(BRFileServiceEntityType) entityTypes;
     BRFileServiceContext context;
     BRFileServiceErrorHandler handler;
+    int loadMapped;
+
+    // The logs currently mapped, guarded by `lock`.
+    BRArrayOf(BRFileServiceMapping) mappings;
+
+    // Serializes access to the types' logs and indexes.
+    pthread_mutex_t lock;
+
+    // Write-behind: the records queued by fileServiceSave() and fileServiceRemove(), and the
+    // thread that appends them to the logs in batches.
+    pthread_mutex_t pendingLock;
+    pthread_cond_t pendingCond;     // signaled when a record is queued, or the writer should quit
+    pthread_cond_t writtenCond;     // broadcast when the writer finishes a batch
+    BRSetOf(BRFileServicePendingRecord*) pending;
+    pthread_t writer;
+    int writeBehind;
+    int writing;
+    int writerQuit;
+
+    // Batching: the records collected, guarded by `pendingLock`, while `batchDepth` is positive.
+    BRSetOf(BRFileServicePendingRecord*) batch;
+    unsigned int batchDepth;
 };
 
 extern BRFileService
@@ -141,20 +300,51 @@ fileServiceCreate (const char *basePath,
 
     fs->pathToType = strdup(dirPath);
     array_new (fs->entityTypes, FILE_SERVICE_INITIAL_TYPE_COUNT);
+    array_new (fs->mappings, 2);
 
     fileServiceSetErrorHandler (fs, context, handler);
 
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE); // fileServiceLoad() may save
+        pthread_mutex_init(&fs->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+
+    pthread_mutex_init (&fs->pendingLock, NULL);
+    pthread_cond_init (&fs->pendingCond, NULL);
+    pthread_cond_init (&fs->writtenCond, NULL);
+    fs->pending = BRSetNew (fileServicePendingRecordHash, fileServicePendingRecordEq, FILE_SERVICE_INITIAL_PENDING_COUNT);
+    fs->batch = BRSetNew (fileServicePendingRecordHash, fileServicePendingRecordEq, FILE_SERVICE_INITIAL_PENDING_COUNT);
+
     return fs;
 }
 
 extern void
 fileServiceRelease (BRFileService fs) {
+    // Write any open batch, then anything still queued.
+    if (fs->batchDepth > 0) {
+        fs->batchDepth = 1;
+        fileServiceEndBatch (fs);
+    }
+    fileServiceSetWriteBehind (fs, 0);
+
+    pthread_cond_destroy (&fs->writtenCond);
+    pthread_cond_destroy (&fs->pendingCond);
+    pthread_mutex_destroy (&fs->pendingLock);
+    pthread_mutex_destroy (&fs->lock);
+    BRSetFree (fs->batch);
+    BRSetFree (fs->pending);
+
     size_t typesCount = array_count(fs->entityTypes);
     for (size_t index = 0; index < typesCount; index++)
         fileServiceEntityTypeRelease (&fs->entityTypes[index]);
 
     free ((char *) fs->pathToType);
     if (NULL != fs->entityTypes) array_free (fs->entityTypes);
+    assert (0 == array_count (fs->mappings));
+    array_free (fs->mappings);
     free (fs);
 }
 
@@ -166,6 +356,12 @@ fileServiceSetErrorHandler (BRFileService fs,
     fs->handler = handler;
 }
 
+extern void
+fileServiceSetLoadMapped (BRFileService fs,
+                          int mapped) {
+    fs->loadMapped = mapped;
+}
+
 static BRFileServiceEntityType *
 fileServiceLookupType (const BRFileService fs,
                        const char *type) {
@@ -183,7 +379,12 @@ fileServiceAddType (const BRFileService fs,
     BRFileServiceEntityType entityType = {
         strdup (type),
         version,
-        NULL
+        NULL,
+        NULL,
+        NULL,
+        0,
+        0,
+        0
     };
     array_new (entityType.handlers, FILE_SERVICE_INITIAL_HANDLER_COUNT);
 
@@ -231,11 +432,12 @@ static int
 fileServiceFailedUnix(BRFileService fs,
                           void* bufferToFree,
                           FILE* fileToClose,
+                          const char *type,
                           int error) {
     return fileServiceFailedInternal (fs, bufferToFree, fileToClose,
                                           (BRFileServiceError) {
                                               FILE_SERVICE_UNIX,
-                                              { .unix = { error }}
+                                              { .unix = { error, type }}
                                           });
 }
 
@@ -252,121 +454,944 @@ fileServiceFailedEntity(BRFileService fs,
                                           });
 }
 
-/// MARK: - Load
+/// MARK: - Log
 
-extern int
-fileServiceLoad (BRFileService fs,
-                 BRSet *results,
-                 const char *type,
-                 int updateVersion) {
-    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
-    if (NULL == entityType) return fileServiceFailedImpl (fs, NULL, NULL, "missed type");
+static void
+fileServiceLogPath (BRFileService fs,
+                    const char *type,
+                    char *path) {
+    sprintf (path, "%s/%s.log", fs->pathToType, type);
+}
 
-    BRFileServiceEntityHandler *entityHandlerCurrent = fileServiceEntityTypeLookupHandler(entityType, entityType->currentVersion);
-    if (NULL == entityHandlerCurrent) return fileServiceFailedImpl (fs,  NULL, NULL, "missed type handler");
+/// Return the entire log for `type`, either read into a newly allocated buffer or, if `fs` loads
+/// mapped, mapped copy-on-write into memory; a missing log is empty.  Return NULL, with errno set,
+/// on failure.  The result must be released with fileServiceLogReadRelease().
+///
+/// A mapped log is held with a shared file lock, so that it isn't truncated under the mapping -
+/// which would raise SIGBUS on touching the lost pages.  A log that is locked exclusively, being
+/// truncated, is read instead.
+static uint8_t *
+fileServiceLogRead (BRFileService fs,
+                    const char *type,
+                    size_t *bufferLen) {
+    char path[strlen(fs->pathToType) + 1 + strlen(type) + 4 + 1];
+    fileServiceLogPath (fs, type, path);
+
+    *bufferLen = 0;
+
+    FILE *file = fopen (path, "rb");
+    if (NULL == file) return (ENOENT == errno ? malloc (1) : NULL);
+
+    // Lock before sizing the log, so that the size can't change while it is mapped.
+    int locked = (fs->loadMapped && 0 == flock (fileno (file), LOCK_SH | LOCK_NB));
+
+    struct stat fileStat;
+    if (0 != fstat (fileno (file), &fileStat)) { fclose (file); return NULL; }
+
+    // Map a non-empty log.  Pages are read from the file as a reader touches them, and can be
+    // dropped again, rather than all being copied into memory up front; a private mapping keeps
+    // any changes a reader makes to its bytes out of the file.
+    if (locked && fileStat.st_size > 0) {
+        void *mapping = mmap (NULL, (size_t) fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno (file), 0);
+        if (MAP_FAILED == mapping) { fclose (file); return NULL; }
+
+        madvise (mapping, (size_t) fileStat.st_size, MADV_SEQUENTIAL);
+        array_add (fs->mappings, ((BRFileServiceMapping) { mapping, file }));
+        *bufferLen = (size_t) fileStat.st_size;
+        return mapping;
+    }
+
+    uint8_t *buffer = malloc ((size_t) fileStat.st_size + 1);
+    if (NULL == buffer) { fclose (file); errno = ENOMEM; return NULL; }
+
+    *bufferLen = fread (buffer, 1, (size_t) fileStat.st_size, file);
+    if (*bufferLen != (size_t) fileStat.st_size && ferror (file)) {
+        free (buffer);
+        fclose (file);
+        return NULL;
+    }
+
+    fclose (file);
+    return buffer;
+}
+
+static void
+fileServiceLogReadRelease (BRFileService fs,
+                           uint8_t *buffer,
+                           size_t bufferLen) {
+    for (size_t index = 0; index < array_count (fs->mappings); index++)
+        if (buffer == fs->mappings[index].bytes) {
+            munmap (buffer, bufferLen);
+            fclose (fs->mappings[index].file);   // and, so, unlock
+            array_rm (fs->mappings, index);
+            return;
+        }
+    free (buffer);
+}
+
+/// Truncate the log at `path`, creating it if needed, to `size` bytes.  Hold its file lock
+/// exclusively while truncating, so as to wait for any mapping of the log, in this process or
+/// another, to be released.  Return 0 on success, -1 (with errno set) otherwise.
+static int
+fileServiceLogTruncate (const char *path,
+                        off_t size) {
+    int file = open (path, O_WRONLY | O_CREAT, 0666);
+    if (-1 == file) return -1;
+
+    int result = (0 == flock (file, LOCK_EX) && 0 == ftruncate (file, size)) ? 0 : -1;
+    int error = errno;
+
+    close (file);   // and, so, unlock
+    errno = error;
+    return result;
+}
+
+/// Point the index entry for `identifier` at the record at `offset`, or drop the entry if the
+/// record is a remove, and account for the bytes the record makes dead.
+static void
+fileServiceLogIndexRecord (BRFileServiceEntityType *entityType,
+                           BRFileServiceRecordKind kind,
+                           UInt256 identifier,
+                           BRFileServiceVersion version,
+                           uint64_t offset,
+                           uint32_t size) {
+    BRFileServiceLogEntry *entry = BRSetGet (entityType->index, &identifier);
+
+    if (NULL != entry) entityType->deadBytes += entry->size;
+
+    switch (kind) {
+        case FILE_SERVICE_RECORD_SAVE:
+            if (NULL == entry) {
+                entry = calloc (1, sizeof (BRFileServiceLogEntry));
+                entry->identifier = identifier;
+                BRSetAdd (entityType->index, entry);
+            }
+            entry->offset  = offset;
+            entry->size    = size;
+            entry->version = version;
+            break;
+
+        case FILE_SERVICE_RECORD_REMOVE:
+            // The remove record itself is only needed until compaction drops the records it removes.
+            entityType->deadBytes += size;
+            if (NULL != entry) {
+                BRSetRemove (entityType->index, entry);
+                free (entry);
+            }
+            break;
+    }
+}
+
+/// Index every record in `buffer`, skipping over any damaged span to the next record that checks
+/// out and counting each such span in `corruptCount`; the bytes of a span are dead.  Return the end
+/// of the last valid record; anything after it is a truncated or corrupt tail, counted too.
+static size_t
+fileServiceLogScan (BRFileServiceEntityType *entityType,
+                    const uint8_t *buffer,
+                    size_t bufferLen,
+                    size_t *corruptCount) {
+    size_t offset = 0, end = 0;
+
+    *corruptCount = 0;
+    while (offset + FILE_SERVICE_RECORD_HEADER_SIZE <= bufferLen) {
+        const uint8_t *header = &buffer[offset];
+        BRFileServiceRecordKind kind = header[0];
+        UInt256 identifier = UInt256Get (&header[1]);
+        BRFileServiceVersion version = header[1 + sizeof (UInt256)];
+        uint32_t bytesCount = UInt32GetLE (&header[1 + sizeof (UInt256) + sizeof (BRFileServiceVersion)]);
+        uint32_t checksum = UInt32GetLE (&header[FILE_SERVICE_RECORD_CHECKSUM_OFFSET]);
+
+        if ((FILE_SERVICE_RECORD_SAVE != kind && FILE_SERVICE_RECORD_REMOVE != kind) ||
+            bytesCount > bufferLen - offset - FILE_SERVICE_RECORD_HEADER_SIZE ||
+            checksum != fileServiceRecordChecksum (header, &header[FILE_SERVICE_RECORD_HEADER_SIZE], bytesCount)) {
+            // A new damaged span starts here; look for the next good record a byte on.
+            if (offset == end) *corruptCount += 1;
+            offset += 1;
+            continue;
+        }
+
+        entityType->deadBytes += offset - end;
+        fileServiceLogIndexRecord (entityType, kind, identifier, version, offset,
+                                   (uint32_t) (FILE_SERVICE_RECORD_HEADER_SIZE + bytesCount));
+        offset += FILE_SERVICE_RECORD_HEADER_SIZE + bytesCount;
+        end = offset;
+    }
+
+    // A tail too short to hold a header, that wasn't already counted as part of a damaged span
+    if (end != bufferLen && offset == end) *corruptCount += 1;
+
+    return end;
+}
+
+/// Append a record to the type's log and index it; if `flush`, flush the log.  Return 1 on
+/// success, 0 (with errno set) otherwise.
+static int
+fileServiceLogAppend (BRFileServiceEntityType *entityType,
+                      BRFileServiceRecordKind kind,
+                      UInt256 identifier,
+                      BRFileServiceVersion version,
+                      const uint8_t *bytes,
+                      uint32_t bytesCount,
+                      int flush) {
+    uint8_t header[FILE_SERVICE_RECORD_HEADER_SIZE];
+
+    header[0] = kind;
+    UInt256Set (&header[1], identifier);
+    header[1 + sizeof (UInt256)] = version;
+    UInt32SetLE (&header[1 + sizeof (UInt256) + sizeof (BRFileServiceVersion)], bytesCount);
+    UInt32SetLE (&header[FILE_SERVICE_RECORD_CHECKSUM_OFFSET], fileServiceRecordChecksum (header, bytes, bytesCount));
+
+    uint64_t start = BRStatsMicroseconds ();
+
+    if (1 != fwrite (header, sizeof (header), 1, entityType->log) ||
+        (bytesCount > 0 && bytesCount != fwrite (bytes, 1, bytesCount, entityType->log)) ||
+        (flush && 0 != fflush (entityType->log)))
+        return 0;
+
+    BRStatsRecord (BRStatsFileServiceWriteTime, BRStatsMicroseconds () - start);
+    BRStatsCount (BRStatsFileServiceWrites, 1);
+    BRStatsCount (BRStatsFileServiceBytes, sizeof (header) + bytesCount);
+
+    fileServiceLogIndexRecord (entityType, kind, identifier, version, entityType->logBytes,
+                               (uint32_t) (sizeof (header) + bytesCount));
+    entityType->logBytes += sizeof (header) + bytesCount;
+    return 1;
+}
+
+/// Sync the directory `path`, so that a rename within it survives a crash.  Return 1 on success, 0
+/// (with errno set) otherwise; a file system that can't sync a directory counts as success.
+static int
+fileServiceSyncDirectory (const char *path) {
+    int fd = open (path, O_RDONLY);
+    if (-1 == fd) return 0;
+
+    int success = (0 == fsync (fd) || EINVAL == errno);
+    int error = errno;
+
+    close (fd);
+    errno = error;
+    return success;
+}
+
+/// Rewrite the type's log with only its live records, replacing the log atomically by rename.  The
+/// new log is synced before the rename, and the directory after it, so that a crash leaves either
+/// the old log or the complete new one.
+static int
+fileServiceLogCompact (BRFileService fs,
+                       BRFileServiceEntityType *entityType) {
+    char path[strlen(fs->pathToType) + 1 + strlen(entityType->type) + 4 + 1];
+    char pathNew[sizeof (path) + 4];
+    fileServiceLogPath (fs, entityType->type, path);
+    sprintf (pathNew, "%s.new", path);
+
+    size_t bufferLen;
+    uint8_t *buffer = fileServiceLogRead (fs, entityType->type, &bufferLen);
+    if (NULL == buffer) return fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+
+    size_t entriesCount = BRSetCount (entityType->index);
+    BRFileServiceLogEntry **entries = calloc (entriesCount + 1, sizeof (BRFileServiceLogEntry*));
+    uint64_t *offsets = calloc (entriesCount + 1, sizeof (uint64_t));
+    uint64_t offset = 0;
+    BRSetAll (entityType->index, (void **) entries, entriesCount);
+
+    FILE *file = fopen (pathNew, "wb");
+    if (NULL == file) {
+        free (entries); free (offsets); fileServiceLogReadRelease (fs, buffer, bufferLen);
+        return fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+    }
+
+    // Write the live records, but only move the index over to them once the new log is in place.
+    for (size_t index = 0; index < entriesCount; index++) {
+        if (entries[index]->size != fwrite (&buffer[entries[index]->offset], 1, entries[index]->size, file)) {
+            free (entries); free (offsets); remove (pathNew); fileServiceLogReadRelease (fs, buffer, bufferLen);
+            return fileServiceFailedUnix (fs, NULL, file, entityType->type, errno);
+        }
+        offsets[index] = offset;
+        offset += entries[index]->size;
+    }
+
+    if (0 != fflush (file) || 0 != fsync (fileno (file))) {
+        int error = errno;
+        free (entries); free (offsets); remove (pathNew); fileServiceLogReadRelease (fs, buffer, bufferLen);
+        return fileServiceFailedUnix (fs, NULL, file, entityType->type, error);
+    }
+
+    if (0 != fclose (file) || 0 != rename (pathNew, path)) {
+        free (entries); free (offsets); remove (pathNew); fileServiceLogReadRelease (fs, buffer, bufferLen);
+        return fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+    }
+
+    // The new log is in place either way; an unsynced rename only risks the old log coming back.
+    int synced = fileServiceSyncDirectory (fs->pathToType);
+    int syncError = errno;
 
+    for (size_t index = 0; index < entriesCount; index++)
+        entries[index]->offset = offsets[index];
+
+    fclose (entityType->log);
+    entityType->log = fopen (path, "ab");
+    entityType->logBytes = offset;
+    entityType->deadBytes = 0;
+
+    free (entries);
+    free (offsets);
+    fileServiceLogReadRelease (fs, buffer, bufferLen);
+
+    if (NULL == entityType->log) return fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+    return (synced ? 1 : fileServiceFailedUnix (fs, NULL, NULL, entityType->type, syncError));
+}
+
+static int
+fileServiceLogCompactIfNeeded (BRFileService fs,
+                               BRFileServiceEntityType *entityType) {
+    return (entityType->deadBytes >= FILE_SERVICE_LOG_COMPACT_MIN_BYTES &&
+            entityType->deadBytes > entityType->logBytes - entityType->deadBytes
+            ? fileServiceLogCompact (fs, entityType)
+            : 1);
+}
+
+/// Move any entities saved one file each, by a prior version of the file service, into the log.
+/// A file is only removed once its record has been appended.
+static int
+fileServiceLogMigrate (BRFileService fs,
+                       BRFileServiceEntityType *entityType,
+                       int *migrated) {
     DIR *dir;
     struct dirent *dirEntry;
 
-    char dirPath[strlen(fs->pathToType) + 1 + strlen(type) + 1];
-    sprintf (dirPath, "%s/%s", fs->pathToType, type);
+    char dirPath[strlen(fs->pathToType) + 1 + strlen(entityType->type) + 1];
+    sprintf (dirPath, "%s/%s", fs->pathToType, entityType->type);
 
     char filename[strlen(dirPath) + 1 + 2 * sizeof(UInt256) + 1];
 
     if (-1 == directoryMake(dirPath) || NULL == (dir = opendir(dirPath)))
-        return fileServiceFailedUnix (fs, NULL, NULL, errno);
+        return fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
 
-    // Allocate some storage for entity bytes;
-    size_t bufferSize = 8 * 1024;
-    uint8_t *buffer = malloc (bufferSize);
-    if (NULL == buffer) return fileServiceFailedUnix (fs, NULL, NULL, ENOMEM);
+    uint8_t *buffer = NULL;
 
-    // Process each directory entry.
     while (NULL != (dirEntry = readdir(dir)))
-        if (dirEntry->d_type == DT_REG) {
+        if (dirEntry->d_type == DT_REG && 2 * sizeof(UInt256) == strlen (dirEntry->d_name)) {
             sprintf (filename, "%s/%s", dirPath, dirEntry->d_name);
             FILE *file = fopen (filename, "rb");
-            if (NULL == file) return fileServiceFailedUnix (fs, buffer, NULL, errno);
-
+            if (NULL == file) {
+                closedir (dir);
+                return fileServiceFailedUnix (fs, buffer, NULL, entityType->type, errno);
+            }
 
+            BRFileServiceHeaderFormatVersion headerVersion;
             BRFileServiceVersion version;
             uint32_t bytesCount;
 
-            // read the header version
-            BRFileServiceHeaderFormatVersion headerVersion;
-            if (1 != fread (&headerVersion, sizeof(BRFileServiceHeaderFormatVersion), 1, file))
-                return fileServiceFailedUnix (fs, buffer, file, errno);
-
-            // read the header
-            switch (headerVersion) {
-                case HEADER_FORMAT_1: {
-                    // read the version
-                    if (1 != fread (&version, sizeof(BRFileServiceVersion), 1, file) ||
-                        // read the checksum
-                        // read the bytesCount
-                        1 != fread (&bytesCount, sizeof(uint32_t), 1, file))
-                        return fileServiceFailedUnix (fs, buffer, file, errno);
-
-                    break;
-                }
+            // The per-file header is the header version, the version and the bytesCount.
+            uint8_t *bufferNew = NULL;
+            if (1 != fread (&headerVersion, sizeof(BRFileServiceHeaderFormatVersion), 1, file) ||
+                currentHeaderFormatVersion != headerVersion ||
+                1 != fread (&version, sizeof(BRFileServiceVersion), 1, file) ||
+                1 != fread (&bytesCount, sizeof(uint32_t), 1, file) ||
+                NULL == (bufferNew = realloc (buffer, bytesCount + 1)) ||
+                bytesCount != fread ((buffer = bufferNew), 1, bytesCount, file)) {
+                closedir (dir);
+                return fileServiceFailedUnix (fs, buffer, file, entityType->type, errno);
             }
 
-            // Ensure `buffer` is large enough
-            if (bytesCount > bufferSize) {
-                bufferSize = bytesCount;
+            fclose (file);
 
-                uint8_t *bufferNew = realloc (buffer, bufferSize);
-                if (NULL == bufferNew) return fileServiceFailedUnix (fs, buffer, NULL, ENOMEM);
-                buffer = bufferNew;
+            if (! fileServiceLogAppend (entityType, FILE_SERVICE_RECORD_SAVE, uint256 (dirEntry->d_name),
+                                        version, buffer, bytesCount, 1)) {
+                closedir (dir);
+                return fileServiceFailedUnix (fs, buffer, NULL, entityType->type, errno);
             }
 
-            // read the bytes - multiple might be required
-            if (bytesCount != fread (buffer, 1, bytesCount, file))
-                return fileServiceFailedUnix (fs, buffer, file, errno);
+            remove (filename);
+            *migrated = 1;
+        }
+
+    if (NULL != buffer) free (buffer);
+    closedir (dir);
+
+    return 1;
+}
+
+/// Open the type's log if it isn't already: index its records, dropping any torn record at its
+/// end, and migrate any older per-entity files.  If `buffer` is not NULL and the log's contents
+/// were read in full and are still current, hand them back in `buffer`; otherwise `buffer` is NULL.
+static int
+fileServiceLogOpen (BRFileService fs,
+                    BRFileServiceEntityType *entityType,
+                    uint8_t **buffer,
+                    size_t *bufferLen) {
+    if (NULL != buffer) *buffer = NULL;
+    if (NULL != entityType->log) return 1;
+
+    char path[strlen(fs->pathToType) + 1 + strlen(entityType->type) + 4 + 1];
+    fileServiceLogPath (fs, entityType->type, path);
+
+    size_t contentsLen;
+    uint8_t *contents = fileServiceLogRead (fs, entityType->type, &contentsLen);
+    if (NULL == contents) return fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+
+    if (NULL == entityType->index)
+        entityType->index = BRSetNew (fileServiceLogEntryHash, fileServiceLogEntryEq, FILE_SERVICE_INITIAL_INDEX_COUNT);
+
+    size_t corruptCount;
+    entityType->deadBytes = 0;
+    entityType->logBytes = fileServiceLogScan (entityType, contents, contentsLen, &corruptCount);
+    entityType->droppedCount += corruptCount;
+
+    // Drop a partially written record, so that appends follow the last good one.  Our own mapping
+    // must go first, as it holds the log's lock; the caller reads the log again.
+    if (entityType->logBytes != contentsLen) {
+        fileServiceLogReadRelease (fs, contents, contentsLen);
+        contents = NULL;
+
+        if (0 != fileServiceLogTruncate (path, (off_t) entityType->logBytes))
+            return fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+    }
+
+    entityType->log = fopen (path, "ab");
+    if (NULL == entityType->log) {
+        fileServiceLogReadRelease (fs, contents, contentsLen);
+        return fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+    }
+
+    // Damage in the middle of the log, which is every damaged span but one at its end, is rewritten
+    // away now rather than skipped over on every open.
+    int damaged = (corruptCount > (entityType->logBytes != contentsLen ? 1 : 0));
+    int migrated = 0;
+    if (1 != fileServiceLogMigrate (fs, entityType, &migrated) ||
+        1 != (damaged
+              ? fileServiceLogCompact (fs, entityType)
+              : fileServiceLogCompactIfNeeded (fs, entityType))) {
+        fileServiceLogReadRelease (fs, contents, contentsLen);
+        return 0;
+    }
+
+    if (NULL != buffer && ! migrated && 0 == entityType->deadBytes) {
+        *buffer = contents;
+        *bufferLen = contentsLen;
+    }
+    else fileServiceLogReadRelease (fs, contents, contentsLen);
+
+    return 1;
+}
+
+/// Append a tombstone for `identifier`, if it has a live record.
+static void
+fileServiceLogRemove (BRFileService fs,
+                      BRFileServiceEntityType *entityType,
+                      UInt256 identifier,
+                      int flush) {
+    // Nothing to remove if there's no live record
+    if (NULL == BRSetGet (entityType->index, &identifier)) return;
+
+    if (! fileServiceLogAppend (entityType, FILE_SERVICE_RECORD_REMOVE, identifier, 0, NULL, 0, flush))
+        fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+    else if (flush)
+        fileServiceLogCompactIfNeeded (fs, entityType);
+}
+
+/// MARK: - Write Behind
+
+/// If `fs` has an open batch, or writes behind, collect or queue a record for writing later, taking
+/// ownership of `bytes`, and return 1; otherwise return 0 and leave the write to the caller.
+static int
+fileServicePend (BRFileService fs,
+                 BRFileServiceEntityType *entityType,
+                 BRFileServiceRecordKind kind,
+                 UInt256 identifier,
+                 BRFileServiceVersion version,
+                 uint8_t *bytes,
+                 uint32_t bytesCount) {
+    pthread_mutex_lock (&fs->pendingLock);
+    if (0 == fs->batchDepth && ! fs->writeBehind) {
+        pthread_mutex_unlock (&fs->pendingLock);
+        return 0;
+    }
+
+    BRFileServicePendingRecord *record = malloc (sizeof (BRFileServicePendingRecord));
+    *record = (BRFileServicePendingRecord) {
+        identifier,
+        (size_t) (entityType - fs->entityTypes),
+        kind,
+        version,
+        bytes,
+        bytesCount
+    };
+
+    // Coalesce with a record of the same entity that hasn't been written yet.
+    BRFileServicePendingRecord *replaced = BRSetAdd (fs->batchDepth > 0 ? fs->batch : fs->pending, record);
+    if (NULL != replaced) fileServicePendingRecordRelease (NULL, replaced);
+
+    if (0 == fs->batchDepth) pthread_cond_signal (&fs->pendingCond);
+    pthread_mutex_unlock (&fs->pendingLock);
+    return 1;
+}
+
+/// Append a batch of queued records, then flush and sync each log written once.
+static void
+fileServiceWriteRecords (BRFileService fs,
+                         BRFileServicePendingRecord **records,
+                         size_t recordsCount) {
+    pthread_mutex_lock (&fs->lock);
+
+    size_t typesCount = array_count (fs->entityTypes);
+    uint8_t written[typesCount];
+    memset (written, 0, typesCount);
+
+    for (size_t index = 0; index < recordsCount; index++) {
+        BRFileServicePendingRecord *record = records[index];
+        BRFileServiceEntityType *entityType = &fs->entityTypes[record->typeIndex];
+
+        if (1 == fileServiceLogOpen (fs, entityType, NULL, NULL)) {
+            if (FILE_SERVICE_RECORD_REMOVE == record->kind)
+                fileServiceLogRemove (fs, entityType, record->identifier, 0);
+            else if (! fileServiceLogAppend (entityType, record->kind, record->identifier,
+                                             record->version, record->bytes, record->bytesCount, 0))
+                fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+            written[record->typeIndex] = 1;
+        }
+
+        fileServicePendingRecordRelease (NULL, record);
+    }
+
+    for (size_t index = 0; index < typesCount; index++) {
+        BRFileServiceEntityType *entityType = &fs->entityTypes[index];
+        if (!written[index] || NULL == entityType->log) continue;
+
+        if (0 != fflush (entityType->log) || 0 != fsync (fileno (entityType->log)))
+            fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+        else
+            fileServiceLogCompactIfNeeded (fs, entityType);
+    }
+
+    pthread_mutex_unlock (&fs->lock);
+}
+
+static void *
+fileServiceWriterThread (BRFileService fs) {
+    pthread_mutex_lock (&fs->pendingLock);
+
+    // Quit only once everything queued has been written.
+    while (!fs->writerQuit || BRSetCount (fs->pending) > 0) {
+        if (0 == BRSetCount (fs->pending)) {
+            pthread_cond_wait (&fs->pendingCond, &fs->pendingLock);
+            continue;
+        }
+
+        // Take the whole queue; records queued meanwhile coalesce into the next batch.
+        size_t recordsCount = BRSetCount (fs->pending);
+        BRFileServicePendingRecord **records = calloc (recordsCount, sizeof (BRFileServicePendingRecord*));
+        BRSetAll (fs->pending, (void **) records, recordsCount);
+        BRSetClear (fs->pending);
+        fs->writing = 1;
+        pthread_mutex_unlock (&fs->pendingLock);
 
-            // All file reading is complete; next read should be EOF.
+        fileServiceWriteRecords (fs, records, recordsCount);
+        free (records);
 
-            // Done with file.
-            if (0 != fclose (file))
-                return fileServiceFailedUnix (fs, buffer, NULL, errno);
+        pthread_mutex_lock (&fs->pendingLock);
+        fs->writing = 0;
+        pthread_cond_broadcast (&fs->writtenCond);
+    }
+
+    pthread_mutex_unlock (&fs->pendingLock);
+    return NULL;
+}
+
+extern void
+fileServiceSetWriteBehind (BRFileService fs,
+                           int writeBehind) {
+    pthread_mutex_lock (&fs->pendingLock);
+    int running = fs->writeBehind;
+
+    if (writeBehind && !running) {
+        pthread_attr_t attr;
+        pthread_attr_init (&attr);
+        pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_JOINABLE);
+
+        fs->writerQuit = 0;
+        fs->writeBehind = (0 == pthread_create (&fs->writer, &attr, (void *(*) (void *)) fileServiceWriterThread, fs));
+        pthread_attr_destroy (&attr);
+    }
+    else if (!writeBehind && running) {
+        // Stop queuing, then let the writer drain the queue and quit.
+        fs->writeBehind = 0;
+        fs->writerQuit = 1;
+        pthread_cond_signal (&fs->pendingCond);
+        pthread_mutex_unlock (&fs->pendingLock);
+        pthread_join (fs->writer, NULL);
+        return;
+    }
+
+    pthread_mutex_unlock (&fs->pendingLock);
+}
+
+extern void
+fileServiceBeginBatch (BRFileService fs) {
+    pthread_mutex_lock (&fs->pendingLock);
+    fs->batchDepth += 1;
+    pthread_mutex_unlock (&fs->pendingLock);
+}
+
+extern void
+fileServiceEndBatch (BRFileService fs) {
+    pthread_mutex_lock (&fs->pendingLock);
+    assert (fs->batchDepth > 0);
+    fs->batchDepth -= 1;
+
+    size_t recordsCount = BRSetCount (fs->batch);
+    if (fs->batchDepth > 0 || 0 == recordsCount) {
+        pthread_mutex_unlock (&fs->pendingLock);
+        return;
+    }
+
+    BRFileServicePendingRecord **records = calloc (recordsCount, sizeof (BRFileServicePendingRecord*));
+    BRSetAll (fs->batch, (void **) records, recordsCount);
+    BRSetClear (fs->batch);
+
+    // Writing behind, hand the writer the whole batch at once ...
+    if (fs->writeBehind) {
+        for (size_t index = 0; index < recordsCount; index++) {
+            BRFileServicePendingRecord *replaced = BRSetAdd (fs->pending, records[index]);
+            if (NULL != replaced) fileServicePendingRecordRelease (NULL, replaced);
+        }
+        pthread_cond_signal (&fs->pendingCond);
+        pthread_mutex_unlock (&fs->pendingLock);
+    }
 
-            // We now have everything
+    // ... otherwise write it now, after anything already queued.
+    else {
+        pthread_mutex_unlock (&fs->pendingLock);
+        fileServiceFlush (fs);
+        fileServiceWriteRecords (fs, records, recordsCount);
+    }
 
-            // This will need some later rework.  If a header includes some data, like a checksum,
-            // we won't have that value in this context when needed.
+    free (records);
+}
 
-            // Do something header specific
-            switch (headerVersion) {
-                case HEADER_FORMAT_1:
-                    // compute the checksum
-                    // compare the checksum
-                   break;
+/// Drop the batch's records of `entityType` or, if NULL, of every type.
+static void
+fileServiceBatchClear (BRFileService fs,
+                       BRFileServiceEntityType *entityType) {
+    pthread_mutex_lock (&fs->pendingLock);
+    size_t recordsCount = BRSetCount (fs->batch);
+    if (recordsCount > 0) {
+        BRFileServicePendingRecord **records = calloc (recordsCount, sizeof (BRFileServicePendingRecord*));
+        BRSetAll (fs->batch, (void **) records, recordsCount);
+
+        for (size_t index = 0; index < recordsCount; index++)
+            if (NULL == entityType || records[index]->typeIndex == (size_t) (entityType - fs->entityTypes)) {
+                BRSetRemove (fs->batch, records[index]);
+                fileServicePendingRecordRelease (NULL, records[index]);
             }
+        free (records);
+    }
+    pthread_mutex_unlock (&fs->pendingLock);
+}
+
+extern void
+fileServiceFlush (BRFileService fs) {
+    pthread_mutex_lock (&fs->pendingLock);
+    while (fs->writing || BRSetCount (fs->pending) > 0)
+        pthread_cond_wait (&fs->writtenCond, &fs->pendingLock);
+    pthread_mutex_unlock (&fs->pendingLock);
+}
+
+/// MARK: - Load
+
+/// A live record as fileServiceLoad() reads it: copied out of the type's index, with its handler,
+/// so that it can be read without holding the lock.
+typedef struct {
+    UInt256 identifier;
+    BRFileServiceEntityHandler handler;
+    uint8_t *bytes;
+    uint32_t bytesCount;
+    int update;
+    void *entity;
+} BRFileServiceLoadRecord;
+
+typedef struct {
+    BRFileService fs;
+    BRFileServiceLoadRecord *records;
+    size_t recordsCount;
+} BRFileServiceLoadJob;
+
+static void *
+fileServiceLoadThread (BRFileServiceLoadJob *job) {
+    for (size_t index = 0; index < job->recordsCount; index++) {
+        BRFileServiceLoadRecord *record = &job->records[index];
+        record->entity = record->handler.reader (record->handler.context, job->fs,
+                                                 record->bytes, record->bytesCount);
+    }
+    return NULL;
+}
+
+/// Read each record into its entity; if `concurrent`, split long runs of records across threads.
+static void
+fileServiceLoadRecords (BRFileService fs,
+                        BRFileServiceLoadRecord *records,
+                        size_t recordsCount,
+                        int concurrent) {
+    long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    size_t threadsCount = (concurrent && cpus > 0 ? (size_t) cpus : 1);
+
+    if (threadsCount > FILE_SERVICE_LOAD_MAX_THREADS) threadsCount = FILE_SERVICE_LOAD_MAX_THREADS;
+    if (threadsCount > recordsCount / FILE_SERVICE_LOAD_MIN_PER_THREAD)
+        threadsCount = recordsCount / FILE_SERVICE_LOAD_MIN_PER_THREAD;
+    if (0 == threadsCount) threadsCount = 1;
+
+    BRFileServiceLoadJob jobs[threadsCount];
+    pthread_t threads[threadsCount];
+    int started[threadsCount];
+
+    for (size_t index = 0; index < threadsCount; index++) {
+        size_t offset = recordsCount * index / threadsCount;
+        jobs[index] = (BRFileServiceLoadJob) {
+            fs,
+            &records[offset],
+            recordsCount * (index + 1) / threadsCount - offset
+        };
+
+        // The calling thread takes the first run, and any run a thread couldn't be started for.
+        started[index] = (index > 0 &&
+                          0 == pthread_create (&threads[index], NULL,
+                                               (void *(*) (void *)) fileServiceLoadThread, &jobs[index]));
+    }
+
+    for (size_t index = 0; index < threadsCount; index++)
+        if (!started[index]) fileServiceLoadThread (&jobs[index]);
+
+    for (size_t index = 0; index < threadsCount; index++)
+        if (started[index]) pthread_join (threads[index], NULL);
+}
+
+extern int
+fileServiceLoad (BRFileService fs,
+                 BRSet *results,
+                 const char *type,
+                 int updateVersion) {
+    return fileServiceLoadExcept (fs, results, type, updateVersion, NULL, 0);
+}
+
+extern int
+fileServiceLoadExcept (BRFileService fs,
+                       BRSet *results,
+                       const char *type,
+                       int updateVersion,
+                       const UInt256 *excluded,
+                       size_t excludedCount) {
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType) return fileServiceFailedImpl (fs, NULL, NULL, "missed type");
+
+    BRFileServiceEntityHandler *entityHandlerCurrent = fileServiceEntityTypeLookupHandler(entityType, entityType->currentVersion);
+    if (NULL == entityHandlerCurrent) return fileServiceFailedImpl (fs,  NULL, NULL, "missed type handler");
+
+    // Load what has been saved, including anything still queued.
+    fileServiceFlush (fs);
+    pthread_mutex_lock (&fs->lock);
 
-            // Look up the entity handler
-            BRFileServiceEntityHandler *handler = fileServiceEntityTypeLookupHandler(entityType, version);
-            if (NULL == handler) return fileServiceFailedImpl (fs,  buffer, NULL, "missed type handler");
+    // One read (or map) of the type's log replaces a directory scan and an open/read/close per entity.
+    uint8_t *buffer;
+    size_t bufferLen;
 
-            // Read the entity from buffer and add to results.
-            void *entity = handler->reader (handler->context, fs, buffer, bytesCount);
-            if (NULL == entity) return fileServiceFailedEntity (fs, buffer, NULL, type, "reader");
+    if (1 != fileServiceLogOpen (fs, entityType, &buffer, &bufferLen)) {
+        pthread_mutex_unlock (&fs->lock);
+        return 0;
+    }
+    if (NULL == buffer && NULL == (buffer = fileServiceLogRead (fs, type, &bufferLen))) {
+        pthread_mutex_unlock (&fs->lock);
+        return fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+    }
+
+    size_t entriesCount = BRSetCount (entityType->index);
+    BRFileServiceLogEntry **entries = calloc (entriesCount + 1, sizeof (BRFileServiceLogEntry*));
+    BRFileServiceLoadRecord *records = calloc (entriesCount + 1, sizeof (BRFileServiceLoadRecord));
 
-            // Update restuls with the newly restored entity
-            BRSetAdd (results, entity);
+    BRSetAll (entityType->index, (void **) entries, entriesCount);
 
-            // If the read version is not the current version, update
-            if (updateVersion &&
-                (version != entityType->currentVersion ||
-                 headerVersion != currentHeaderFormatVersion))
-                fileServiceSave (fs, type, entity);
+    // An identifier is an entry's first field; the excluded identifiers are looked up as entries.
+    BRSet *excludedSet = NULL;
+    if (excludedCount > 0) {
+        excludedSet = BRSetNew (fileServiceLogEntryHash, fileServiceLogEntryEq, excludedCount);
+        for (size_t index = 0; index < excludedCount; index++)
+            BRSetAdd (excludedSet, (void *) &excluded[index]);
+    }
+
+    // Collect each live record, but for those excluded.
+    size_t recordsCount = 0;
+    for (size_t index = 0; index < entriesCount; index++) {
+        BRFileServiceLogEntry *entry = entries[index];
+        if (NULL != excludedSet && BRSetContains (excludedSet, entry)) continue;
+
+        // Look up the entity handler
+        BRFileServiceEntityHandler *handler = fileServiceEntityTypeLookupHandler(entityType, entry->version);
+        if (NULL == handler) {
+            free (entries); free (records); fileServiceLogReadRelease (fs, buffer, bufferLen);
+            if (NULL != excludedSet) BRSetFree (excludedSet);
+            pthread_mutex_unlock (&fs->lock);
+            return fileServiceFailedImpl (fs,  NULL, NULL, "missed type handler");
         }
 
-    free (buffer);
-    closedir (dir);
+        records[recordsCount++] = (BRFileServiceLoadRecord) {
+            entry->identifier,
+            *handler,
+            &buffer[entry->offset + FILE_SERVICE_RECORD_HEADER_SIZE],
+            entry->size - FILE_SERVICE_RECORD_HEADER_SIZE,
+            updateVersion && entry->version != entityType->currentVersion,
+            NULL
+        };
+    }
+
+    int concurrent = entityType->loadConcurrent;
+    int repair = entityType->loadRepair;
+    free (entries);
+    if (NULL != excludedSet) BRSetFree (excludedSet);
+
+    // The buffer is this load's own copy, or a private mapping that appends and compactions (which
+    // write a new log) leave intact, so the records are read without the lock; other types load
+    // meanwhile.
+    pthread_mutex_unlock (&fs->lock);
+    fileServiceLoadRecords (fs, records, recordsCount, concurrent);
+    fileServiceLogReadRelease (fs, buffer, bufferLen);
+
+    // Add the restored entities to results, and if a record's version is not the current version,
+    // update it.  If repairing, drop the records that couldn't be read.
+    size_t failed = 0;
+    for (size_t index = 0; index < recordsCount; index++) {
+        if (NULL == records[index].entity) {
+            if (repair) fileServiceRemove (fs, type, records[index].identifier);
+            failed += 1;
+            continue;
+        }
+
+        BRSetAdd (results, records[index].entity);
+        if (records[index].update) {
+            fileServiceSave (fs, type, records[index].entity);
+
+            // A version may identify its entities differently; drop the record saved under the old
+            // identifier, or it would be loaded again alongside the updated one.
+            UInt256 identifier = entityHandlerCurrent->identifier (entityHandlerCurrent->context, fs,
+                                                                   records[index].entity);
+            if (!UInt256Eq (identifier, records[index].identifier))
+                fileServiceRemove (fs, type, records[index].identifier);
+        }
+    }
+
+    free (records);
+
+    if (repair) {
+        pthread_mutex_lock (&fs->lock);
+        entityType->droppedCount += failed;
+        pthread_mutex_unlock (&fs->lock);
+    }
+
+    return (failed && !repair
+            ? fileServiceFailedEntity (fs, NULL, NULL, type, "reader")
+            : 1);
+}
+
+extern void *
+fileServiceLoadEntity (BRFileService fs,
+                       const char *type,
+                       UInt256 identifier) {
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType) { fileServiceFailedImpl (fs, NULL, NULL, "missed type"); return NULL; }
+
+    // Load what has been saved, including anything still queued.
+    fileServiceFlush (fs);
+    pthread_mutex_lock (&fs->lock);
+
+    if (1 != fileServiceLogOpen (fs, entityType, NULL, NULL)) {
+        pthread_mutex_unlock (&fs->lock);
+        return NULL;
+    }
+
+    BRFileServiceLogEntry *entry = BRSetGet (entityType->index, &identifier);
+    if (NULL == entry) {
+        pthread_mutex_unlock (&fs->lock);
+        return NULL;
+    }
+
+    BRFileServiceEntityHandler *handler = fileServiceEntityTypeLookupHandler(entityType, entry->version);
+    if (NULL == handler) {
+        pthread_mutex_unlock (&fs->lock);
+        fileServiceFailedImpl (fs,  NULL, NULL, "missed type handler");
+        return NULL;
+    }
+
+    // Read just the entity's record, at its offset in the log; holding the lock keeps a compaction
+    // from replacing the log meanwhile.
+    char path[strlen(fs->pathToType) + 1 + strlen(type) + 4 + 1];
+    fileServiceLogPath (fs, type, path);
+
+    BRFileServiceEntityHandler entityHandler = *handler;
+    uint32_t size = entry->size;
+    uint8_t *bytes = malloc (size);
+    FILE *file = (0 == fflush (entityType->log) ? fopen (path, "rb") : NULL);
+
+    if (NULL == bytes || NULL == file ||
+        0 != fseeko (file, (off_t) entry->offset, SEEK_SET) ||
+        size != fread (bytes, 1, size, file)) {
+        int error = errno;
+        pthread_mutex_unlock (&fs->lock);
+        fileServiceFailedUnix (fs, bytes, file, type, error);
+        return NULL;
+    }
+
+    fclose (file);
+    pthread_mutex_unlock (&fs->lock);
+
+    if (UInt32GetLE (&bytes[FILE_SERVICE_RECORD_CHECKSUM_OFFSET]) !=
+        fileServiceRecordChecksum (bytes, &bytes[FILE_SERVICE_RECORD_HEADER_SIZE],
+                                   size - FILE_SERVICE_RECORD_HEADER_SIZE)) {
+        fileServiceFailedEntity (fs, bytes, NULL, type, "checksum");
+        return NULL;
+    }
+
+    void *entity = entityHandler.reader (entityHandler.context, fs,
+                                         &bytes[FILE_SERVICE_RECORD_HEADER_SIZE],
+                                         size - FILE_SERVICE_RECORD_HEADER_SIZE);
+    free (bytes);
+
+    if (NULL == entity) fileServiceFailedEntity (fs, NULL, NULL, type, "reader");
+    return entity;
+}
+
+extern int
+fileServiceSetLoadConcurrent (BRFileService fs,
+                              const char *type,
+                              int concurrent) {
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType) return fileServiceFailedImpl (fs, NULL, NULL, "missed type");
 
+    entityType->loadConcurrent = concurrent;
     return 1;
 }
 
+extern int
+fileServiceSetLoadRepair (BRFileService fs,
+                          const char *type,
+                          int repair) {
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType) return fileServiceFailedImpl (fs, NULL, NULL, "missed type");
+
+    entityType->loadRepair = repair;
+    return 1;
+}
+
+extern size_t
+fileServiceGetDroppedCount (BRFileService fs,
+                            const char *type) {
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType) return 0;
+
+    pthread_mutex_lock (&fs->lock);
+    size_t droppedCount = entityType->droppedCount;
+    pthread_mutex_unlock (&fs->lock);
+
+    return droppedCount;
+}
+
 /// MARK: - Save
 
 extern void /* error code? */
@@ -384,35 +1409,21 @@ fileServiceSave (BRFileService fs,
     uint32_t bytesCount;
     uint8_t *bytes = handler->writer (handler->context, fs, entity, &bytesCount);
 
-    char filename[strlen(fs->pathToType) + 1 + strlen(type) + 1 + 2*sizeof(UInt256) + 1];
-    sprintf (filename, "%s/%s/%s", fs->pathToType, type, u256hex(identifier));
-
-    FILE *file = fopen (filename, "wb");
-    if (NULL == file) { fileServiceFailedUnix (fs, bytes, NULL, errno); return; }
-
-
-    // Always, always write the header for the currentHeaderFormatVersion
-
-    if (// write the header version
-        1 != fwrite(&currentHeaderFormatVersion, sizeof(BRFileServiceHeaderFormatVersion), 1, file) ||
-        // then the version
-        1 != fwrite (&entityType->currentVersion, sizeof(BRFileServiceVersion), 1, file) ||
-        // then the checksum?
-        // write the bytesCount
-        1 != fwrite(&bytesCount, sizeof (uint32_t), 1, file)) {
-        fileServiceFailedUnix (fs, bytes, file, errno);
-        return;
-    }
+    // Always, always write the record for the currentVersion
+    if (fileServicePend (fs, entityType, FILE_SERVICE_RECORD_SAVE, identifier,
+                         entityType->currentVersion, bytes, bytesCount)) return;
 
-    // write the bytes.
-    if (bytesCount != fwrite(bytes, 1, bytesCount, file)) {
-        fileServiceFailedUnix (fs, bytes, file, errno);
-        return;
+    pthread_mutex_lock (&fs->lock);
+    if (1 != fileServiceLogOpen (fs, entityType, NULL, NULL))
+        free (bytes);
+    else if (! fileServiceLogAppend (entityType, FILE_SERVICE_RECORD_SAVE, identifier,
+                                     entityType->currentVersion, bytes, bytesCount, 1))
+        fileServiceFailedUnix (fs, bytes, NULL, entityType->type, errno);
+    else {
+        free (bytes);
+        fileServiceLogCompactIfNeeded (fs, entityType);
     }
-
-    if (0 != fclose (file)) {  fileServiceFailedUnix (fs, bytes, NULL, errno); return; }
-
-    free (bytes);
+    pthread_mutex_unlock (&fs->lock);
 }
 
 /// MARK: - Remove, Clear
@@ -424,11 +1435,12 @@ fileServiceRemove (BRFileService fs,
     BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
     if (NULL == entityType) { fileServiceFailedImpl (fs, NULL, NULL, "missed type"); return; };
 
-    char filename[strlen(fs->pathToType) + 1 + strlen(type) + 1 + 2*sizeof(UInt256) + 1];
-    sprintf (filename, "%s/%s/%s", fs->pathToType, type, u256hex(identifier));
+    if (fileServicePend (fs, entityType, FILE_SERVICE_RECORD_REMOVE, identifier, 0, NULL, 0)) return;
 
-    // If failed, then what?
-    remove (filename);
+    pthread_mutex_lock (&fs->lock);
+    if (1 == fileServiceLogOpen (fs, entityType, NULL, NULL))
+        fileServiceLogRemove (fs, entityType, identifier, 1);
+    pthread_mutex_unlock (&fs->lock);
 }
 
 static void
@@ -440,14 +1452,35 @@ fileServiceClearForType (BRFileService fs,
     char dirPath[strlen(fs->pathToType) + 1 + strlen(entityType->type) + 1];
     sprintf (dirPath, "%s/%s", fs->pathToType, entityType->type);
 
+    char filename[strlen(dirPath) + 1 + FILENAME_MAX + 1];
+
+    char path[strlen(fs->pathToType) + 1 + strlen(entityType->type) + 4 + 1];
+    fileServiceLogPath (fs, entityType->type, path);
+
+    // Truncate the log, keeping it open for appending if it was.
+    if (0 != fileServiceLogTruncate (path, 0)) {
+        fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
+        return;
+    }
+
+    if (NULL != entityType->index) {
+        BRSetApply (entityType->index, NULL, fileServiceLogEntryRelease);
+        BRSetClear (entityType->index);
+    }
+    entityType->logBytes = 0;
+    entityType->deadBytes = 0;
+
+    // Also remove any per-entity files not yet migrated into the log.
     if (-1 == directoryMake(dirPath) || NULL == (dir = opendir(dirPath))) {
-        fileServiceFailedUnix (fs, NULL, NULL, errno);
+        fileServiceFailedUnix (fs, NULL, NULL, entityType->type, errno);
         return;
     }
 
     while (NULL != (dirEntry = readdir(dir)))
-        if (dirEntry->d_type == DT_REG)
-            remove (dirEntry->d_name); // If failed, then what?
+        if (dirEntry->d_type == DT_REG) {
+            sprintf (filename, "%s/%s", dirPath, dirEntry->d_name);
+            remove (filename); // If failed, then what?
+        }
 
     closedir(dir);
 }
@@ -458,15 +1491,25 @@ fileServiceClear (BRFileService fs,
     BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
     if (NULL == entityType) { fileServiceFailedImpl (fs, NULL, NULL, "missed type"); return; };
 
+    // Don't let collected or queued records land after the clear.
+    fileServiceBatchClear (fs, entityType);
+    fileServiceFlush (fs);
+
+    pthread_mutex_lock (&fs->lock);
     fileServiceClearForType(fs, entityType);
+    pthread_mutex_unlock (&fs->lock);
 }
 
 extern void
 fileServiceClearAll (BRFileService fs) {
+    fileServiceBatchClear (fs, NULL);
+    fileServiceFlush (fs);
+
+    pthread_mutex_lock (&fs->lock);
     size_t typeCount = array_count(fs->entityTypes);
     for (size_t index = 0; index < typeCount; index++)
         fileServiceClearForType (fs, &fs->entityTypes[index]);
-
+    pthread_mutex_unlock (&fs->lock);
 }
 
 extern int
@@ -480,9 +1523,13 @@ fileServiceDefineType (BRFileService fs,
     // Lookup the entityType for `type`
     BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
 
-    // If there isn't an entityType, create one.
-    if (NULL == entityType)
+    // If there isn't an entityType, create one; adding may move the others, so not while the
+    // writer is using them.
+    if (NULL == entityType) {
+        pthread_mutex_lock (&fs->lock);
         entityType = fileServiceAddType (fs, type, version);
+        pthread_mutex_unlock (&fs->lock);
+    }
 
     // Create a handler for the entity
     BRFileServiceEntityHandler newEntityHander = {
@@ -507,7 +1554,7 @@ fileServiceDefineType (BRFileService fs,
         sprintf (dirPath, "%s/%s", fs->pathToType, type);
 
         if (-1 == directoryMake(dirPath))
-            return fileServiceFailedUnix (fs, NULL, NULL, errno);
+            return fileServiceFailedUnix (fs, NULL, NULL, type, errno);
 
         fileServiceEntityTypeAddHandler (entityType, &newEntityHander);
     }
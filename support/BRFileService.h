@@ -60,6 +60,7 @@ typedef struct {
 
         struct {
             int error;
+            const char *type;   // the entity type whose store failed
         } unix;
 
         struct {
@@ -93,6 +94,64 @@ fileServiceSetErrorHandler (BRFileService fs,
                             BRFileServiceContext context,
                             BRFileServiceErrorHandler handler);
 
+/**
+ * Set if fileServiceLoad() maps stored entities into memory and hands readers pointers into the
+ * mapping, rather than first reading them into a buffer.  Either way a reader's bytes are only
+ * valid for the duration of the call and must not be retained.
+ *
+ * @param fs The fileService
+ * @param mapped If true (1) map; otherwise read.  The default is to read.
+ */
+extern void
+fileServiceSetLoadMapped (BRFileService fs,
+                          int mapped);
+
+/**
+ * Set if fileServiceSave() and fileServiceRemove() write behind.  If so, the entity is serialized
+ * by the caller but its record is queued for a writer thread, which appends records in batches
+ * and syncs each log once per batch.  A queued save or remove of an entity replaces any still
+ * queued for it.  Errors from the writer are reported to the error handler on the writer thread.
+ * The default is to write synchronously; turning write behind off writes anything still queued.
+ *
+ * Types must be defined before entities are saved while writing behind.
+ *
+ * @param fs The fileService
+ * @param writeBehind If true (1) write behind; otherwise write synchronously.
+ */
+extern void
+fileServiceSetWriteBehind (BRFileService fs,
+                           int writeBehind);
+
+/**
+ * Begin a batch.  Until the matching fileServiceEndBatch(), saves and removes are collected, not
+ * written; then all are written together, with one flush and sync per type's log.  A save or
+ * remove of an entity replaces any collected for it; a clear drops those collected for its type.
+ * Batches nest - only the outermost end writes.  The batch belongs to `fs` not to a thread; saves
+ * from any thread while a batch is open join it.  Loads don't see collected records.
+ *
+ * @param fs The fileService
+ */
+extern void
+fileServiceBeginBatch (BRFileService fs);
+
+/**
+ * End a batch begun with fileServiceBeginBatch().  If this ends the outermost batch, write the
+ * collected records - synchronously, or by queuing the whole batch when writing behind.
+ *
+ * @param fs The fileService
+ */
+extern void
+fileServiceEndBatch (BRFileService fs);
+
+/**
+ * Wait until every queued save and remove has been written.  fileServiceLoad(), fileServiceClear()
+ * and fileServiceRelease() flush first.
+ *
+ * @param fs The fileService
+ */
+extern void
+fileServiceFlush (BRFileService fs);
+
 /**
  * Load all entities of `type` adding each to `results`.  If there is an error then the
  * fileServices' error handler is invoked and 0 is returned
@@ -111,6 +170,92 @@ fileServiceLoad (BRFileService fs,
                  const char *type,   /* blocks, peers, transactions, logs, ... */
                  int updateVersion);
 
+/**
+ * As fileServiceLoad() but skip the entities with any of the `excludedCount` identifiers in
+ * `excluded`; their records are neither read nor updated, and stay saved for a later
+ * fileServiceLoadEntity().
+ *
+ * @param fs The fileServie
+ * @param results A BRSet within which to store the results.
+ * @param type The type to restore
+ * @param updateVersion If true (1) update old versions with newer ones.
+ * @param excluded The identifiers to skip; may be NULL if `excludedCount` is 0
+ * @param excludedCount The number of identifiers in `excluded`
+ *
+ * @return true (1) if success, false (0) otherwise;
+ */
+extern int
+fileServiceLoadExcept (BRFileService fs,
+                       BRSet *results,
+                       const char *type,
+                       int updateVersion,
+                       const UInt256 *excluded,
+                       size_t excludedCount);
+
+/**
+ * Load the one entity of `type` with `identifier`, reading only its record rather than the whole
+ * log.  This suits an entity that is no longer held in memory and is needed again only rarely.  If
+ * there is an error then the fileService's error handler is invoked and NULL is returned.
+ *
+ * @param fs The fileService
+ * @param type The type to restore
+ * @param identifier The entity's identifier, as from the type's BRFileServiceIdentifier
+ *
+ * @return the entity, which the caller owns, or NULL if there is none or on error
+ */
+extern void *
+fileServiceLoadEntity (BRFileService fs,
+                       const char *type,
+                       UInt256 identifier);
+
+/**
+ * Set if the readers for `type` may be called concurrently, from threads other than the caller's.
+ * If so, fileServiceLoad() splits a long log's records across worker threads to read them.  Either
+ * way, the records are read without holding the fileService's lock, so loads of different types
+ * from different threads proceed in parallel.  The default is to read on the calling thread.
+ *
+ * @param fs The fileService
+ * @param type The type, which must be defined
+ * @param concurrent If true (1) the type's readers are thread-safe.
+ *
+ * @return true (1) if success, false (0) otherwise
+ */
+extern int
+fileServiceSetLoadConcurrent (BRFileService fs,
+                              const char *type,
+                              int concurrent);
+
+/**
+ * Set if fileServiceLoad() of `type` repairs, rather than fails on, records that can't be read.
+ * If so, a record whose reader fails is removed from the store and the load succeeds with the
+ * rest.  Records that fail their checksum, as from a partial write, are dropped regardless, and
+ * the records after them are kept.  The default is to fail the load.
+ *
+ * @param fs The fileService
+ * @param type The type, which must be defined
+ * @param repair If true (1) drop unreadable records.
+ *
+ * @return true (1) if success, false (0) otherwise
+ */
+extern int
+fileServiceSetLoadRepair (BRFileService fs,
+                          const char *type,
+                          int repair);
+
+/**
+ * Return the number of records of `type` lost so far: runs of them that failed their checksum
+ * and, if repairing, those that couldn't be read.  A caller can recover just these entities,
+ * rather than everything, when this is nonzero after fileServiceLoad().
+ *
+ * @param fs The fileService
+ * @param type The type
+ *
+ * @return the number of records dropped, or 0 if `type` is not defined
+ */
+extern size_t
+fileServiceGetDroppedCount (BRFileService fs,
+                            const char *type);
+
 extern void /* error code? */
 fileServiceSave (BRFileService fs,
                  const char *type,  /* block, peers, transactions, logs, ... */
@@ -130,8 +275,8 @@ fileServiceClearAll (BRFileService fs);
 
 /**
  * A function type to produce an identifer from an entity.  The identifer must be constant for
- * a particulary entity through time.  The identifier is used to derive a filename (more generally
- * a path and filename).
+ * a particulary entity through time.  The identifier keys the entity's records in its type's
+ * append-only log; a later save of the same identifier replaces the earlier one.
  */
 typedef UInt256
 (*BRFileServiceIdentifier) (BRFileServiceContext context,
@@ -25,15 +25,20 @@
 #include "BRKey.h"
 #include "BRAddress.h"
 #include "BRBase58.h"
+#include "BRThreadPool.h"
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
-#include <unistd.h>             // getpid()
+#include <unistd.h>
 #include <pthread.h>
 
 #define BITCOIN_PRIVKEY      128
 #define BITCOIN_PRIVKEY_TEST 239
 
+#define KEY_BATCH_MAX_THREADS    64
+#define KEY_BATCH_MIN_PER_THREAD 16 // smaller shares complete faster than they can be handed to another thread
+#define KEY_GENERATE_BATCH       32 // secrets drawn from BRRandBytes() at a time
+
 #if __BIG_ENDIAN__ || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__) ||\
     __ARMEB__ || __THUMBEB__ || __AARCH64EB__ || __MIPSEB__
 #define WORDS_BIGENDIAN        1
@@ -53,30 +58,19 @@
 #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
 #endif
 #include "secp256k1/src/basic-config.h"
+#ifdef BR_ECMULT_WINDOW_SIZE // size of the precomputed ecmult tables used for verification: 2^(window - 2) points
+#undef ECMULT_WINDOW_SIZE
+#define ECMULT_WINDOW_SIZE BR_ECMULT_WINDOW_SIZE
+#endif
 #include "secp256k1/src/secp256k1.c"
 #pragma clang diagnostic pop
 #pragma GCC diagnostic pop
 
-static pthread_once_t _rand_once = PTHREAD_ONCE_INIT;
-
-static void _rand_init (void) {
-    srand((((0x811C9dc5 ^ (unsigned)time(NULL))*0x01000193) ^ (unsigned)getpid())*0x01000193);
-}
-
-// returns a random number less than upperBound, for non-cryptographic use only
+// returns a random number less than upperBound, or less than BR_RAND_MAX if upperBound is 0
 uint32_t BRRand(uint32_t upperBound)
 {
-    uint32_t r;
-
-    pthread_once(&_rand_once, _rand_init);
-
     if (upperBound == 0 || upperBound > BR_RAND_MAX) upperBound = BR_RAND_MAX;
-
-    do { // to avoid modulo bias, find a rand value not less than 0x100000000 % upperBound
-        r = rand();
-    } while (r < ((0xffffffff - upperBound*2) + 1) % upperBound); // (((0xffffffff - x*2) + 1) % x) == (0x100000000 % x)
-
-    return r % upperBound;
+    return BRRandUniform(upperBound);
 }
 
 
@@ -202,6 +196,28 @@ int BRKeySetSecret(BRKey *key, const UInt256 *secret, int compressed)
     return secp256k1_ec_seckey_verify(_ctx, key->secret.u8);
 }
 
+// assigns a new random secret from BRRandBytes() to each of count keys, such as for ephemeral ecdh keys
+void BRKeyGenerate(BRKey keys[], size_t count, int compressed)
+{
+    UInt256 secrets[KEY_GENERATE_BATCH];
+    size_t i, j, n;
+
+    assert(keys != NULL || count == 0);
+
+    for (i = 0; i < count; i += n) { // draw secrets for a batch of keys at once
+        n = (count - i < KEY_GENERATE_BATCH) ? count - i : KEY_GENERATE_BATCH;
+        BRRandBytes(secrets, n*sizeof(*secrets));
+
+        for (j = 0; j < n; j++) {
+            while (! BRKeySetSecret(&keys[i + j], &secrets[j], compressed)) { // out of range secrets are vanishingly rare
+                BRRandBytes(&secrets[j], sizeof(*secrets));
+            }
+        }
+    }
+
+    mem_clean(secrets, sizeof(secrets));
+}
+
 // assigns privKey to key and returns true on success
 // privKey must be wallet import format (WIF), mini private key format, or hex string
 int BRKeySetPrivKey(BRKey *key, const char *privKey)
@@ -285,17 +301,45 @@ size_t BRKeyPrivKey(const BRKey *key, char *privKey, size_t pkLen)
     return pkLen;
 }
 
+// returns the length of the encoded public key in p, 33 if compressed, 65 if uncompressed, or 0 if p is empty
+static size_t _BRKeyPubKeyLen(const uint8_t *p)
+{
+    static uint8_t empty[65]; // static vars initialize to zero
+    size_t len = (p[0] == 0x02 || p[0] == 0x03) ? 33 : 65;
+    
+    return (memcmp(p, empty, len) != 0) ? len : 0;
+}
+
 // writes the DER encoded public key to pubKey and returns number of bytes written, or pkLen needed if pubKey is NULL
+// both the compressed and uncompressed encodings are cached in key, so changing key->compressed doesn't recompute it
 size_t BRKeyPubKey(BRKey *key, void *pubKey, size_t pkLen)
 {
-    static uint8_t empty[65]; // static vars initialize to zero
-    size_t size = (key->compressed) ? 33 : 65;
+    uint8_t p[65];
+    size_t size = (key->compressed) ? 33 : 65, len, altLen;
     secp256k1_pubkey pk;
 
     assert(key != NULL);
+    len = _BRKeyPubKeyLen(key->pubKey);
     
-    if (memcmp(key->pubKey, empty, size) == 0) {
-        if (secp256k1_ec_pubkey_create(_ctx, &pk, key->secret.u8)) {
+    if (len != size) {
+        altLen = _BRKeyPubKeyLen(key->altPubKey);
+        
+        if (altLen == size) { // swap in the cached encoding
+            memcpy(p, key->pubKey, sizeof(p));
+            memcpy(key->pubKey, key->altPubKey, sizeof(p));
+            memcpy(key->altPubKey, p, sizeof(p));
+        }
+        else if ((len > 0 && secp256k1_ec_pubkey_parse(_ctx, &pk, key->pubKey, len)) ||
+                 (len == 0 && secp256k1_ec_pubkey_create(_ctx, &pk, key->secret.u8))) {
+            // re-encoding a pubKey is cheap compared to the ec multiply deriving it from secret, so cache both
+            if (len > 0) memcpy(key->altPubKey, key->pubKey, sizeof(key->altPubKey));
+            else {
+                altLen = sizeof(key->altPubKey);
+                secp256k1_ec_pubkey_serialize(_ctx, key->altPubKey, &altLen, &pk,
+                                              (key->compressed ? SECP256K1_EC_UNCOMPRESSED : SECP256K1_EC_COMPRESSED));
+            }
+            
+            memset(key->pubKey, 0, sizeof(key->pubKey));
             secp256k1_ec_pubkey_serialize(_ctx, key->pubKey, &size, &pk,
                                           (key->compressed ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED));
         }
@@ -394,6 +438,108 @@ int BRKeyVerify(BRKey *key, UInt256 md, const void *sig, size_t sigLen)
     return r;
 }
 
+typedef struct {
+    int *results;
+    BRKey *keys;
+    const UInt256 *mds;
+    const void **sigs;
+    const size_t *sigLens; // NULL when recovering pubKeys
+    const int *ethereum; // when recovering pubKeys, true for each of sigs that uses the ethereum encoding
+    size_t start, end, succeeded;
+} _BRKeyBatchJob;
+
+static void _BRKeyPubKeyRoutine(void *info)
+{
+    _BRKeyBatchJob *job = info;
+    int r;
+    
+    for (size_t i = job->start; i < job->end; i++) {
+        r = (BRKeyPubKey(&job->keys[i], NULL, 0) > 0);
+        if (job->results) job->results[i] = r;
+        if (r) job->succeeded++;
+    }
+}
+
+static void _BRKeyVerifyRoutine(void *info)
+{
+    _BRKeyBatchJob *job = info;
+    
+    for (size_t i = job->start; i < job->end; i++) {
+        job->results[i] = BRKeyVerify(&job->keys[i], job->mds[i], job->sigs[i], job->sigLens[i]);
+        if (job->results[i]) job->succeeded++;
+    }
+}
+
+static void _BRKeyRecoverPubKeyRoutine(void *info)
+{
+    _BRKeyBatchJob *job = info;
+    
+    for (size_t i = job->start; i < job->end; i++) {
+        job->results[i] = (job->ethereum && job->ethereum[i]) ?
+                          BRKeyRecoverPubKeyEthereum(&job->keys[i], job->mds[i], job->sigs[i], 65) :
+                          BRKeyRecoverPubKey(&job->keys[i], job->mds[i], job->sigs[i], 65);
+        if (job->results[i]) job->succeeded++;
+    }
+}
+
+// runs routine on count items of job, split into threadCount shares (0 for one per cpu core) that run on the shared
+// thread pool, all sharing the one precomputed secp256k1 context, and returns the total number of items that succeeded
+static size_t _BRKeyBatchRun(_BRKeyBatchJob job, void (*routine)(void *), size_t count, size_t threadCount)
+{
+    BRTaskGroup *group = NULL;
+    size_t i, succeeded = 0;
+    
+    pthread_once(&_ctx_once, _ctx_init);
+    if (threadCount == 0) threadCount = (sysconf(_SC_NPROCESSORS_ONLN) > 0) ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    if (threadCount > KEY_BATCH_MAX_THREADS) threadCount = KEY_BATCH_MAX_THREADS;
+    if (threadCount > count/KEY_BATCH_MIN_PER_THREAD) threadCount = count/KEY_BATCH_MIN_PER_THREAD;
+    if (threadCount == 0) threadCount = 1;
+    
+    _BRKeyBatchJob jobs[threadCount];
+    
+    if (threadCount > 1) group = BRTaskGroupNew(BRThreadPoolShared());
+    
+    for (i = 0; i < threadCount; i++) {
+        jobs[i] = job;
+        jobs[i].start = count*i/threadCount;
+        jobs[i].end = count*(i + 1)/threadCount;
+        jobs[i].succeeded = 0;
+        if (i > 0) BRTaskGroupAdd(group, &jobs[i], routine);
+    }
+    
+    routine(&jobs[0]); // the calling thread takes the first share, and helps with the rest while it waits
+    if (group) BRTaskGroupFree(group);
+    for (i = 0; i < threadCount; i++) succeeded += jobs[i].succeeded;
+    return succeeded;
+}
+
+// verifies count signatures, setting results[i] to true if sigs[i] for mds[i] was made by keys[i], spread across
+// threadCount worker threads (0 for one per cpu core), all sharing the one precomputed secp256k1 context
+// returns the number of signatures verified
+size_t BRKeyVerifyBatch(int results[], BRKey keys[], const UInt256 mds[], const void *sigs[], const size_t sigLens[],
+                        size_t count, size_t threadCount)
+{
+    assert(results != NULL || count == 0);
+    assert(keys != NULL || count == 0);
+    assert(mds != NULL || count == 0);
+    assert(sigs != NULL || count == 0);
+    assert(sigLens != NULL || count == 0);
+    
+    return _BRKeyBatchRun((_BRKeyBatchJob) { results, keys, mds, sigs, sigLens, NULL, 0, 0, 0 },
+                          _BRKeyVerifyRoutine, count, threadCount);
+}
+
+// computes and caches the public keys of count keys from their secrets, spread across threadCount worker threads (0 for
+// one per cpu core), setting results[i] to true if keys[i] has a valid public key (results may be NULL)
+// returns the number of keys with valid public keys
+size_t BRKeyPubKeyBatch(int results[], BRKey keys[], size_t count, size_t threadCount)
+{
+    assert(keys != NULL || count == 0);
+    
+    return _BRKeyBatchRun((_BRKeyBatchJob) { results, keys, NULL, NULL, NULL, NULL, 0, 0, 0 },
+                          _BRKeyPubKeyRoutine, count, threadCount);
+}
+
 // wipes key material from key
 void BRKeyClean(BRKey *key)
 {
@@ -484,6 +630,8 @@ size_t BRKeyCompactSignEthereum(const BRKey *key, void *compactSig, size_t sigLe
 // assigns pubKey recovered from compactSig to key and returns true on success
 int BRKeyRecoverPubKeyEthereum(BRKey *key, UInt256 md, const void *compactSig, size_t sigLen)
 {
+    pthread_once(&_ctx_once, _ctx_init);
+
     int r = 0, compressed = 0, recid = 0;
     uint8_t pubKey[65];
     size_t len = sizeof(pubKey);
@@ -506,3 +654,19 @@ int BRKeyRecoverPubKeyEthereum(BRKey *key, UInt256 md, const void *compactSig, s
 
     return r;
 }
+
+// recovers count pubKeys, setting results[i] to true and assigning keys[i] the pubKey recovered from the 65 byte
+// compactSigs[i] for mds[i], where compactSigs[i] uses the ethereum encoding if ethereum[i] is true (ethereum may be
+// NULL), spread across threadCount worker threads (0 for one per cpu core), all sharing the one secp256k1 context
+// returns the number of pubKeys recovered
+size_t BRKeyRecoverPubKeyBatch(int results[], BRKey keys[], const UInt256 mds[], const void *compactSigs[],
+                               const int ethereum[], size_t count, size_t threadCount)
+{
+    assert(results != NULL || count == 0);
+    assert(keys != NULL || count == 0);
+    assert(mds != NULL || count == 0);
+    assert(compactSigs != NULL || count == 0);
+    
+    return _BRKeyBatchRun((_BRKeyBatchJob) { results, keys, mds, compactSigs, NULL, ethereum, 0, 0, 0 },
+                          _BRKeyRecoverPubKeyRoutine, count, threadCount);
+}
@@ -35,7 +35,9 @@ extern "C" {
 
 #define BR_RAND_MAX          ((RAND_MAX > 0x7fffffff) ? 0x7fffffff : RAND_MAX)
 
-// returns a random number less than upperBound (for non-cryptographic use only)
+// returns a random number less than upperBound, or less than BR_RAND_MAX if upperBound is 0
+// the number comes from BRRandBytes(), so is cryptographically secure, but use BRRandUniform() for bounds beyond
+// BR_RAND_MAX
 uint32_t BRRand(uint32_t upperBound);
 
     
@@ -71,11 +73,15 @@ typedef struct {
     UInt256 secret;
     uint8_t pubKey[65];
     int compressed;
+    uint8_t altPubKey[65]; // cache of the other encoding of pubKey, compressed or uncompressed, if it's been computed
 } BRKey;
 
 // assigns secret to key and returns true on success
 int BRKeySetSecret(BRKey *key, const UInt256 *secret, int compressed);
 
+// assigns a new random secret from BRRandBytes() to each of count keys, such as for ephemeral ecdh keys
+void BRKeyGenerate(BRKey keys[], size_t count, int compressed);
+
 // assigns privKey to key and returns true on success
 // privKey must be wallet import format (WIF), mini private key format, or hex string
 int BRKeySetPrivKey(BRKey *key, const char *privKey);
@@ -88,8 +94,14 @@ int BRKeySetPubKey(BRKey *key, const uint8_t *pubKey, size_t pkLen);
 size_t BRKeyPrivKey(const BRKey *key, char *privKey, size_t pkLen);
 
 // writes the DER encoded public key to pubKey and returns number of bytes written, or pkLen needed if pubKey is NULL
+// both the compressed and uncompressed encodings are cached in key, so changing key->compressed doesn't recompute it
 size_t BRKeyPubKey(BRKey *key, void *pubKey, size_t pkLen);
 
+// computes and caches the public keys of count keys from their secrets, spread across threadCount worker threads, or
+// one per cpu core if threadCount is 0, setting results[i] to true if keys[i] has a valid public key (results may be
+// NULL), returns the number of keys with valid public keys
+size_t BRKeyPubKeyBatch(int results[], BRKey keys[], size_t count, size_t threadCount);
+
 // returns the ripemd160 hash of the sha256 hash of the public key, or UINT160_ZERO on error
 UInt160 BRKeyHash160(BRKey *key);
 
@@ -109,6 +121,12 @@ size_t BRKeySign(const BRKey *key, void *sig, size_t sigLen, UInt256 md);
 // returns true if the signature for md is verified to have been made by key
 int BRKeyVerify(BRKey *key, UInt256 md, const void *sig, size_t sigLen);
 
+// verifies count signatures, setting results[i] to true if sigs[i] for mds[i] was made by keys[i]
+// the work is spread across threadCount worker threads, or one per cpu core if threadCount is 0
+// returns the number of signatures verified
+size_t BRKeyVerifyBatch(int results[], BRKey keys[], const UInt256 mds[], const void *sigs[], const size_t sigLens[],
+                        size_t count, size_t threadCount);
+
 // wipes key material from key
 void BRKeyClean(BRKey *key);
 
@@ -125,6 +143,13 @@ void BRKeyECDH(const BRKey *privKey, uint8_t *out32, BRKey *pubKey);
 size_t BRKeyCompactSignEthereum(const BRKey *key, void *compactSig, size_t sigLen, UInt256 md);
 int BRKeyRecoverPubKeyEthereum(BRKey *key, UInt256 md, const void *compactSig, size_t sigLen);
 
+// recovers count pubKeys, setting results[i] to true and assigning keys[i] the pubKey recovered from the 65 byte
+// compactSigs[i] for mds[i], where compactSigs[i] uses the ethereum encoding if ethereum[i] is true (ethereum may be
+// NULL), spread across threadCount worker threads, or one per cpu core if threadCount is 0
+// returns the number of pubKeys recovered
+size_t BRKeyRecoverPubKeyBatch(int results[], BRKey keys[], const UInt256 mds[], const void *compactSigs[],
+                               const int ethereum[], size_t count, size_t threadCount);
+
 
 #ifdef __cplusplus
 }
@@ -31,55 +31,103 @@
 // ecies-aes128-sha256 as specified in SEC 1, 5.1: http://www.secg.org/SEC1-Ver-1.0.pdf
 // NOTE: these are not implemented using constant time algorithms
 
+// derives ctx's encryption and mac keys from the ecdh shared secret of privKey and pubKey
+static void _BRKeyECIESContextDerive(BRKeyECIESContext *ctx, BRKey *privKey, BRKey *pubKey)
+{
+    uint8_t shared[32], buf[36] = { 0, 0, 0, 1 };
+
+    // shared-secret = kdf(ecdh(privKey, pubKey))
+    BRKeyECDH(privKey, &buf[4], pubKey);
+    BRSHA256(shared, buf, sizeof(buf));
+    mem_clean(buf, sizeof(buf));
+    memcpy(ctx->encKey, shared, sizeof(ctx->encKey));
+    BRSHA256(ctx->macKey, &shared[16], 16);
+    mem_clean(shared, sizeof(shared));
+}
+
 size_t BRKeyECIESAES128SHA256Encrypt(BRKey *pubKey, void *out, size_t outLen, BRKey *ephemKey,
                                      const void *data, size_t dataLen)
 {
-    uint8_t *encKey, macKey[32], shared[32], iv[16], K[32], V[32], buf[36] = { 0, 0, 0, 1 };
+    BRKeyECIESContext ctx;
+    size_t r;
+
+    memset(&ctx, 0, sizeof(ctx));
+    r = BRKeyECIESAES128SHA256EncryptContext(&ctx, pubKey, out, outLen, ephemKey, data, dataLen);
+    BRKeyECIESContextClean(&ctx);
+    return r;
+}
+
+size_t BRKeyECIESAES128SHA256Decrypt(BRKey *privKey, void *out, size_t outLen, const void *data, size_t dataLen)
+{
+    BRKeyECIESContext ctx;
+    size_t r;
+
+    memset(&ctx, 0, sizeof(ctx));
+    r = BRKeyECIESAES128SHA256DecryptContext(&ctx, privKey, out, outLen, data, dataLen);
+    BRKeyECIESContextClean(&ctx);
+    return r;
+}
+
+// same as BRKeyECIESAES128SHA256Encrypt(), but the ecdh and kdf are only done when pubKey or ephemKey differ from the
+// previous call with ctx
+size_t BRKeyECIESAES128SHA256EncryptContext(BRKeyECIESContext *ctx, BRKey *pubKey, void *out, size_t outLen,
+                                            BRKey *ephemKey, const void *data, size_t dataLen)
+{
+    uint8_t iv[16], K[32], V[32], md[32], pk[65];
     size_t pkLen = ephemKey ? BRKeyPubKey(ephemKey, NULL, 0) : 0;
     
+    assert(ctx != NULL);
     assert(pkLen > 0);
     if (! out) return pkLen + sizeof(iv) + dataLen + 32;
     if (outLen < pkLen + sizeof(iv) + dataLen + 32) return 0;
 
     assert(pubKey != NULL);
-    size_t pubKeyLen = BRKeyPubKey(pubKey, NULL, 0);
+    size_t pubKeyLen = BRKeyPubKey(pubKey, pk, sizeof(pk));
     assert(pubKeyLen > 0);
 
     assert(data != NULL || dataLen == 0);
 
-    // shared-secret = kdf(ecdh(ephemKey, pubKey))
-    BRKeyECDH(ephemKey, &buf[4], pubKey);
-    BRSHA256(shared, buf, sizeof(buf));
-    mem_clean(buf, sizeof(buf));
-    encKey = shared;
-    BRSHA256(macKey, &shared[16], 16);
-    
     // R = rG
     BRKeyPubKey(ephemKey, out, pkLen);
 
+    if (pkLen != ctx->ephemLen || memcmp(out, ctx->ephemPubKey, pkLen) != 0 || pubKeyLen != ctx->pubKeyLen ||
+        memcmp(pk, ctx->pubKey, pubKeyLen) != 0) {
+        _BRKeyECIESContextDerive(ctx, ephemKey, pubKey);
+        memcpy(ctx->ephemPubKey, out, pkLen);
+        ctx->ephemLen = pkLen;
+        memcpy(ctx->pubKey, pk, pubKeyLen);
+        ctx->pubKeyLen = pubKeyLen;
+    }
+
     // encrypt
-    BRSHA256(buf, data, dataLen);
-    BRHMACDRBG(iv, sizeof(iv), K, V, BRSHA256, 32, encKey, 16, buf, 32, NULL, 0); // generate iv
+    BRSHA256(md, data, dataLen);
+    BRHMACDRBG(iv, sizeof(iv), K, V, BRSHA256, 32, ctx->encKey, 16, md, 32, NULL, 0); // generate iv
     memcpy(&out[pkLen], iv, sizeof(iv));
-    BRAESCTR(&out[pkLen + sizeof(iv)], encKey, 16, iv, data, dataLen);
-    mem_clean(shared, sizeof(shared));
+    BRAESCTR(&out[pkLen + sizeof(iv)], ctx->encKey, 16, iv, data, dataLen);
     
     // tag with mac
-    BRHMAC(&out[pkLen + sizeof(iv) + dataLen], BRSHA256, 32, macKey, 32, &out[pkLen], sizeof(iv) + dataLen);
-    mem_clean(macKey, sizeof(macKey));
+    BRHMAC(&out[pkLen + sizeof(iv) + dataLen], BRSHA256, 32, ctx->macKey, 32, &out[pkLen], sizeof(iv) + dataLen);
     return pkLen + sizeof(iv) + dataLen + 32;
 }
 
-size_t BRKeyECIESAES128SHA256Decrypt(BRKey *privKey, void *out, size_t outLen, const void *data, size_t dataLen)
+// same as BRKeyECIESAES128SHA256Decrypt(), but the ecdh and kdf are only done when the sender's ephemeral public key
+// differs from the previous call with ctx, which must always be called with the same privKey
+size_t BRKeyECIESAES128SHA256DecryptContext(BRKeyECIESContext *ctx, BRKey *privKey, void *out, size_t outLen,
+                                            const void *data, size_t dataLen)
 {
-    uint8_t *encKey, macKey[32], shared[32], mac[32], iv[16], buf[36] = { 0, 0, 0, 1 }, r = 0;
+    uint8_t mac[32], iv[16], r = 0;
     size_t i, pkLen;
     BRKey pubKey;
 
+    assert(ctx != NULL);
     assert(data != NULL || dataLen == 0);
     pkLen = (dataLen > 0 && (((uint8_t *)data)[0] == 0x02 || ((uint8_t *)data)[0] == 0x03)) ? 33 : 65;
     if (dataLen < pkLen + sizeof(iv) + 32) return 0;
-    if (BRKeySetPubKey(&pubKey, data, pkLen) == 0) return 0;
+    
+    // a decryption context has no pubKey, and its ephemeral public key was already verified
+    int cached = (ctx->pubKeyLen == 0 && pkLen == ctx->ephemLen && memcmp(data, ctx->ephemPubKey, pkLen) == 0);
+    
+    if (! cached && BRKeySetPubKey(&pubKey, data, pkLen) == 0) return 0;
     if (! out) return dataLen - (pkLen + sizeof(iv) + 32);
     if (pkLen + sizeof(iv) + outLen + 32 < dataLen) return 0;
 
@@ -87,27 +135,32 @@ size_t BRKeyECIESAES128SHA256Decrypt(BRKey *privKey, void *out, size_t outLen, c
     size_t priKeyLen = BRKeyPrivKey(privKey, NULL, 0);
     assert(priKeyLen  > 0);
 
-    // shared-secret = kdf(ecdh(privKey, pubKey))
-    BRKeyECDH(privKey, &buf[4], &pubKey);
-    BRSHA256(shared, buf, sizeof(buf));
-    mem_clean(buf, sizeof(buf));
-    encKey = shared;
-    BRSHA256(macKey, &shared[16], 16);
+    if (! cached) {
+        _BRKeyECIESContextDerive(ctx, privKey, &pubKey);
+        memcpy(ctx->ephemPubKey, data, pkLen);
+        ctx->ephemLen = pkLen;
+        ctx->pubKeyLen = 0;
+    }
     
     // verify mac tag
-    BRHMAC(mac, BRSHA256, 32, macKey, 32, &data[pkLen], dataLen - (pkLen + 32));
-    mem_clean(macKey, sizeof(macKey));
+    BRHMAC(mac, BRSHA256, 32, ctx->macKey, 32, &data[pkLen], dataLen - (pkLen + 32));
     for (i = 0; i < 32; i++) r |= mac[i] ^ ((uint8_t *)data)[dataLen + i - 32]; // constant time compare
     mem_clean(mac, sizeof(mac));
     if (r != 0) return 0;
     
     // decrypt
     memcpy(iv, &data[pkLen], sizeof(iv));
-    BRAESCTR(out, encKey, 16, iv, &data[pkLen + sizeof(iv)], dataLen - (pkLen + sizeof(iv) + 32));
-    mem_clean(shared, sizeof(shared));
+    BRAESCTR(out, ctx->encKey, 16, iv, &data[pkLen + sizeof(iv)], dataLen - (pkLen + sizeof(iv) + 32));
     return dataLen - (pkLen + sizeof(iv) + 32);
 }
 
+// zeros the keys cached in ctx
+void BRKeyECIESContextClean(BRKeyECIESContext *ctx)
+{
+    assert(ctx != NULL);
+    mem_clean(ctx, sizeof(*ctx));
+}
+
 // Pigeon Encrypted Message Exchange
 
 static void BRKeyPigeonSharedKey(BRKey *privKey, uint8_t *out32, BRKey *pubKey)
@@ -135,10 +188,10 @@ size_t BRKeyPigeonEncrypt(BRKey *privKey, void *out, size_t outLen, BRKey *pubKe
 {
     if (! out) return dataLen + 16;
     
-    uint8_t sharedKey[32];
-    BRKeyPigeonSharedKey(privKey, sharedKey, pubKey);
-    size_t outSize = BRChacha20Poly1305AEADEncrypt(out, outLen, sharedKey, nonce12, data, dataLen, NULL, 0);
-    mem_clean(sharedKey, sizeof(sharedKey));
+    BRKeyPigeonContext ctx;
+    BRKeyPigeonContextSet(&ctx, privKey, pubKey);
+    size_t outSize = BRKeyPigeonContextEncrypt(&ctx, out, outLen, nonce12, data, dataLen);
+    BRKeyPigeonContextClean(&ctx);
     return outSize;
 }
 
@@ -146,9 +199,71 @@ size_t BRKeyPigeonDecrypt(BRKey *privKey, void *out, size_t outLen, BRKey *pubKe
 {
     if (! out) return (dataLen < 16) ? 0 : dataLen - 16;
     
-    uint8_t sharedKey[32];
-    BRKeyPigeonSharedKey(privKey, sharedKey, pubKey);
-    size_t outSize = BRChacha20Poly1305AEADDecrypt(out, outLen, sharedKey, nonce12, data, dataLen, NULL, 0);
-    mem_clean(sharedKey, sizeof(sharedKey));
+    BRKeyPigeonContext ctx;
+    BRKeyPigeonContextSet(&ctx, privKey, pubKey);
+    size_t outSize = BRKeyPigeonContextDecrypt(&ctx, out, outLen, nonce12, data, dataLen);
+    BRKeyPigeonContextClean(&ctx);
     return outSize;
 }
+
+void BRKeyPigeonContextSet(BRKeyPigeonContext *ctx, BRKey *privKey, BRKey *pubKey)
+{
+    assert(ctx != NULL);
+    BRKeyPigeonSharedKey(privKey, ctx->sharedKey, pubKey);
+}
+
+size_t BRKeyPigeonContextEncrypt(const BRKeyPigeonContext *ctx, void *out, size_t outLen, const void *nonce12,
+                                 const void *data, size_t dataLen)
+{
+    assert(ctx != NULL);
+    if (! out) return dataLen + 16;
+    return BRChacha20Poly1305AEADEncrypt(out, outLen, ctx->sharedKey, nonce12, data, dataLen, NULL, 0);
+}
+
+size_t BRKeyPigeonContextDecrypt(const BRKeyPigeonContext *ctx, void *out, size_t outLen, const void *nonce12,
+                                 const void *data, size_t dataLen)
+{
+    assert(ctx != NULL);
+    if (! out) return (dataLen < 16) ? 0 : dataLen - 16;
+    return BRChacha20Poly1305AEADDecrypt(out, outLen, ctx->sharedKey, nonce12, data, dataLen, NULL, 0);
+}
+
+size_t BRKeyPigeonContextEncryptBatch(const BRKeyPigeonContext *ctx, void *outs[], const void *nonces12,
+                                      const void *data[], const size_t dataLens[], size_t count)
+{
+    size_t i;
+
+    assert(ctx != NULL);
+    assert((outs != NULL && nonces12 != NULL && data != NULL && dataLens != NULL) || count == 0);
+
+    for (i = 0; i < count; i++) {
+        if (BRChacha20Poly1305AEADEncrypt(outs[i], dataLens[i] + 16, ctx->sharedKey, (const uint8_t *)nonces12 + i*12,
+                                          data[i], dataLens[i], NULL, 0) == 0) break;
+    }
+
+    return i;
+}
+
+size_t BRKeyPigeonContextDecryptBatch(const BRKeyPigeonContext *ctx, void *outs[], const void *nonces12,
+                                      const void *data[], const size_t dataLens[], size_t count)
+{
+    size_t i;
+
+    assert(ctx != NULL);
+    assert((outs != NULL && nonces12 != NULL && data != NULL && dataLens != NULL) || count == 0);
+
+    for (i = 0; i < count; i++) {
+        if (dataLens[i] < 16 || BRChacha20Poly1305AEADDecrypt(outs[i], dataLens[i] - 16, ctx->sharedKey,
+                                                              (const uint8_t *)nonces12 + i*12, data[i], dataLens[i],
+                                                              NULL, 0) != dataLens[i] - 16) break;
+    }
+
+    return i;
+}
+
+// zeros the shared key cached in ctx
+void BRKeyPigeonContextClean(BRKeyPigeonContext *ctx)
+{
+    assert(ctx != NULL);
+    mem_clean(ctx, sizeof(*ctx));
+}
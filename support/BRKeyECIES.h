@@ -38,6 +38,30 @@ size_t BRKeyECIESAES128SHA256Encrypt(BRKey *pubKey, void *out, size_t outLen, BR
                                      const void *data, size_t dataLen);
 
 size_t BRKeyECIESAES128SHA256Decrypt(BRKey *privKey, void *out, size_t outLen, const void *data, size_t dataLen);
+
+// the encryption and mac keys derived from the ecdh shared secret of a pair of keys, cached for any number of messages
+// between them, must be zero initialized before first use, and cleaned with BRKeyECIESContextClean() after last use
+typedef struct {
+    uint8_t ephemPubKey[65]; // the ephemeral public key the cached keys were derived for
+    size_t ephemLen;
+    uint8_t pubKey[65]; // the recipient public key when encrypting, unused when decrypting
+    size_t pubKeyLen;
+    uint8_t encKey[16];
+    uint8_t macKey[32];
+} BRKeyECIESContext;
+
+// same as BRKeyECIESAES128SHA256Encrypt(), but the ecdh and kdf are only done when pubKey or ephemKey differ from the
+// previous call with ctx
+size_t BRKeyECIESAES128SHA256EncryptContext(BRKeyECIESContext *ctx, BRKey *pubKey, void *out, size_t outLen,
+                                            BRKey *ephemKey, const void *data, size_t dataLen);
+
+// same as BRKeyECIESAES128SHA256Decrypt(), but the ecdh and kdf are only done when the sender's ephemeral public key
+// differs from the previous call with ctx, which must always be called with the same privKey
+size_t BRKeyECIESAES128SHA256DecryptContext(BRKeyECIESContext *ctx, BRKey *privKey, void *out, size_t outLen,
+                                            const void *data, size_t dataLen);
+
+// zeros the keys cached in ctx
+void BRKeyECIESContextClean(BRKeyECIESContext *ctx);
     
     
 // Generates a pairing key using HMAC_DRBG with the local private key as entropy and SHA256(identifier) as the nonce.
@@ -49,6 +73,31 @@ void BRKeyPigeonPairingKey(BRKey *privKey, BRKey *outPairingKey, const void *ide
 size_t BRKeyPigeonEncrypt(BRKey *privKey, void *out, size_t outLen, BRKey *pubKey, const void *nonce12, const void *data, size_t dataLen);
 size_t BRKeyPigeonDecrypt(BRKey *privKey, void *out, size_t outLen, BRKey *pubKey, const void *nonce12, const void *data, size_t dataLen);
 
+// the shared key of a local private key and a remote public key, cached for any number of messages between them
+typedef struct {
+    uint8_t sharedKey[32];
+} BRKeyPigeonContext;
+
+// derives the shared key from privKey and pubKey using ECDH, once for all messages encrypted or decrypted with ctx
+void BRKeyPigeonContextSet(BRKeyPigeonContext *ctx, BRKey *privKey, BRKey *pubKey);
+
+// same as BRKeyPigeonEncrypt() and BRKeyPigeonDecrypt() with the shared key cached in ctx
+size_t BRKeyPigeonContextEncrypt(const BRKeyPigeonContext *ctx, void *out, size_t outLen, const void *nonce12,
+                                 const void *data, size_t dataLen);
+size_t BRKeyPigeonContextDecrypt(const BRKeyPigeonContext *ctx, void *out, size_t outLen, const void *nonce12,
+                                 const void *data, size_t dataLen);
+
+// encrypts or decrypts count messages with the shared key cached in ctx, the i-th with nonce &nonces12[i*12], writing
+// it to outs[i], which must have room for dataLens[i] + 16 bytes when encrypting, or dataLens[i] - 16 when decrypting
+// returns the number of messages processed, stopping at the first that fails to encrypt or authenticate
+size_t BRKeyPigeonContextEncryptBatch(const BRKeyPigeonContext *ctx, void *outs[], const void *nonces12,
+                                      const void *data[], const size_t dataLens[], size_t count);
+size_t BRKeyPigeonContextDecryptBatch(const BRKeyPigeonContext *ctx, void *outs[], const void *nonces12,
+                                      const void *data[], const size_t dataLens[], size_t count);
+
+// zeros the shared key cached in ctx
+void BRKeyPigeonContextClean(BRKeyPigeonContext *ctx);
+
     
 #ifdef __cplusplus
 }
@@ -27,7 +27,8 @@
 #include <string.h>
 #include <assert.h>
 
-// linear probed hashtable for good cache performance, maximum load factor is 2/3
+// linear probed robin hood hashtable for good cache performance, maximum load factor is 2/3
+// each bucket caches its item's hash so probes compare hashes before calling eq(), and rehashing never calls hash()
 
 static const size_t tableSizes[] = { // starting with 1, multiply by 3/2, round up, then find next largest prime
     1, 3, 7, 13, 23, 37, 59, 97, 149, 227, 347, 523, 787, 1187, 1783, 2677, 4019, 6037, 9059, 13591,
@@ -38,14 +39,6 @@ static const size_t tableSizes[] = { // starting with 1, multiply by 3/2, round
 
 #define TABLE_SIZES_LEN (sizeof(tableSizes)/sizeof(*tableSizes))
 
-struct BRSetStruct {
-    void **table; // hashtable
-    size_t size; // number of buckets in table
-    size_t itemCount; // number of items in set
-    size_t (*hash)(const void *); // hash function
-    int (*eq)(const void *, const void *); // equality function
-};
-
 static void _BRSetInit(BRSet *set, size_t (*hash)(const void *), int (*eq)(const void *, const void *), size_t capacity)
 {
     assert(set != NULL);
@@ -58,7 +51,7 @@ static void _BRSetInit(BRSet *set, size_t (*hash)(const void *), int (*eq)(const
     while (i < TABLE_SIZES_LEN && tableSizes[i] < capacity) i++;
 
     if (i + 1 < TABLE_SIZES_LEN) { // use next larger table size to keep load factor below 2/3 at capacity
-        set->table = calloc(tableSizes[i + 1], sizeof(void *));
+        set->table = calloc(tableSizes[i + 1], sizeof(*set->table));
         assert(set->table != NULL);
         set->size = tableSizes[i + 1];
     }
@@ -82,38 +75,106 @@ BRSet *BRSetNew(size_t (*hash)(const void *), int (*eq)(const void *, const void
     return set;
 }
 
+// returns the bucket index of the item equivalent to given item, or the set size if there is none
+// a probe can stop as soon as it reaches an item closer to its home bucket than the probe is to the given item's
+static size_t _BRSetIndex(const BRSet *set, const void *item, uint32_t hash)
+{
+    size_t size = set->size, i = hash % size;
+    uint32_t dist = 0;
+    const BRSetBucket *b = &set->table[i];
+    
+    while (b->item && b->dist >= dist) { // probe for item
+        if (b->item == item || (b->hash == hash && set->eq(b->item, item))) return i;
+        if (++i == size) i = 0;
+        b = &set->table[i];
+        dist++;
+    }
+    
+    return size;
+}
+
+// inserts an item known not to be in set, displacing any item closer to its home bucket than the new item is
+static void _BRSetInsert(BRSet *set, void *item, uint32_t hash)
+{
+    size_t size = set->size, i = hash % size;
+    BRSetBucket b = { item, hash, 0 }, t;
+    
+    while (set->table[i].item) { // probe for empty bucket
+        if (set->table[i].dist < b.dist) t = set->table[i], set->table[i] = b, b = t;
+        if (++i == size) i = 0;
+        b.dist++;
+    }
+    
+    set->table[i] = b;
+    set->itemCount++;
+}
+
 // rebuilds hashtable to hold up to capacity items
 static void _BRSetGrow(BRSet *set, size_t capacity)
 {
     BRSet newSet;
     
     _BRSetInit(&newSet, set->hash, set->eq, capacity);
-    BRSetUnion(&newSet, set);
+    
+    for (size_t i = 0; i < set->size; i++) {
+        if (set->table[i].item) _BRSetInsert(&newSet, set->table[i].item, set->table[i].hash);
+    }
+    
     free(set->table);
     set->table = newSet.table;
     set->size = newSet.size;
     set->itemCount = newSet.itemCount;
 }
 
+// inserts an item with the given hash, known not to be in set, growing the hashtable as needed
+void _BRSetInsertNew(BRSet *set, void *item, uint32_t hash)
+{
+    _BRSetInsert(set, item, hash);
+    if (set->itemCount > ((set->size + 2)/3)*2) _BRSetGrow(set, set->size); // limit load factor to 2/3
+}
+
+// adds item with the given hash to set or replaces an equivalent existing item and returns item replaced if any
+static void *_BRSetAdd(BRSet *set, void *item, uint32_t hash)
+{
+    size_t i = _BRSetIndex(set, item, hash);
+    void *t = NULL;
+    
+    if (i < set->size) {
+        t = set->table[i].item;
+        set->table[i].item = item;
+    }
+    else _BRSetInsertNew(set, item, hash);
+    
+    return t;
+}
+
 // adds given item to set or replaces an equivalent existing item and returns item replaced if any
 void *BRSetAdd(BRSet *set, void *item)
 {
     assert(set != NULL);
     assert(item != NULL);
     
-    size_t size = set->size;
-    size_t i = set->hash(item) % size;
-    void *t = set->table[i];
+    return _BRSetAdd(set, item, (uint32_t)set->hash(item));
+}
 
-    while (t && t != item && ! set->eq(t, item)) { // probe for empty bucket
-        i = (i + 1) % size;
-        t = set->table[i];
+// removes and returns the item in the bucket at index
+void *_BRSetRemoveIndex(BRSet *set, size_t index)
+{
+    size_t size = set->size, i = index, j = (i + 1 == size) ? 0 : i + 1;
+    void *r = set->table[i].item;
+    
+    assert(index < size);
+    set->itemCount--;
+
+    while (set->table[j].item && set->table[j].dist > 0) { // shift following displaced items back one bucket
+        set->table[i] = set->table[j];
+        set->table[i].dist--;
+        i = j;
+        j = (j + 1 == size) ? 0 : j + 1;
     }
 
-    if (! t) set->itemCount++;
-    set->table[i] = item;
-    if (set->itemCount > ((size + 2)/3)*2) _BRSetGrow(set, size); // limit load factor to 2/3
-    return t;
+    memset(&set->table[i], 0, sizeof(set->table[i]));
+    return r;
 }
 
 // removes item equivalent to given item from set and returns item removed if any
@@ -122,31 +183,9 @@ void *BRSetRemove(BRSet *set, const void *item)
     assert(set != NULL);
     assert(item != NULL);
     
-    size_t size = set->size;
-    size_t i = set->hash(item) % size;
-    void *r = set->table[i], *t;
+    size_t i = _BRSetIndex(set, item, (uint32_t)set->hash(item));
 
-    while (r != item && r && ! set->eq(r, item)) { // probe for item
-        i = (i + 1) % size;
-        r = set->table[i];
-    }
-    
-    if (r) {
-        set->itemCount--;
-        set->table[i] = NULL;
-        i = (i + 1) % size;
-        t = set->table[i];
-        
-        while (t) { // hashtable cleanup
-            set->itemCount--;
-            set->table[i] = NULL;
-            BRSetAdd(set, t);
-            i = (i + 1) % size;
-            t = set->table[i];
-        }
-    }
-    
-    return r;
+    return (i < set->size) ? _BRSetRemoveIndex(set, i) : NULL;
 }
 
 // removes all items from set
@@ -166,6 +205,14 @@ size_t BRSetCount(const BRSet *set)
     return set->itemCount;
 }
 
+// returns the bytes of memory allocated for set and its hashtable, not including the items it holds
+size_t BRSetMemoryUsage(const BRSet *set)
+{
+    assert(set != NULL);
+    
+    return sizeof(*set) + set->size*sizeof(*set->table);
+}
+
 // true if an item equivalant to the given item is contained in set
 int BRSetContains(const BRSet *set, const void *item)
 {
@@ -182,7 +229,7 @@ int BRSetIntersects(const BRSet *set, const BRSet *otherSet)
     void *t;
     
     while (i < size) {
-        t = otherSet->table[i++];
+        t = otherSet->table[i++].item;
         if (t && BRSetGet(set, t) != NULL) return 1;
     }
     
@@ -195,16 +242,9 @@ void *BRSetGet(const BRSet *set, const void *item)
     assert(set != NULL);
     assert(item != NULL);
     
-    size_t size = set->size;
-    size_t i = set->hash(item) % size;
-    void *t = set->table[i];
-
-    while (t != item && t && ! set->eq(t, item)) { // probe for item
-        i = (i + 1) % size;
-        t = set->table[i];
-    }
+    size_t i = _BRSetIndex(set, item, (uint32_t)set->hash(item));
     
-    return t;
+    return (i < set->size) ? set->table[i].item : NULL;
 }
 
 // interates over set and returns the next item after previous, or NULL if no more items are available
@@ -214,21 +254,14 @@ void *BRSetIterate(const BRSet *set, const void *previous)
     assert(set != NULL);
     
     size_t i = 0, size = set->size;
-    void *t, *r = NULL;
+    void *r = NULL;
     
     if (previous != NULL) {
-        i = set->hash(previous) % size;
-        t = set->table[i];
-        
-        while (t != previous && t && ! set->eq(t, previous)) { // probe for item
-            i = (i + 1) % size;
-            t = set->table[i];
-        }
-    
-        i++;
+        i = _BRSetIndex(set, previous, (uint32_t)set->hash(previous));
+        if (i < size) i++;
     }
     
-    while (! r && i < size) r = set->table[i++];
+    while (! r && i < size) r = set->table[i++].item;
     return r;
 }
 
@@ -243,7 +276,7 @@ size_t BRSetAll(const BRSet *set, void *allItems[], size_t count)
     void *t;
     
     while (i < size && j < count) {
-        t = set->table[i++];
+        t = set->table[i++].item;
         if (t) allItems[j++] = t;
     }
     
@@ -260,7 +293,7 @@ void BRSetApply(const BRSet *set, void *info, void (*apply)(void *info, void *it
     void *t;
     
     while (i < size) {
-        t = set->table[i++];
+        t = set->table[i++].item;
         if (t) apply(info, t);
     }
 }
@@ -272,11 +305,15 @@ void BRSetUnion(BRSet *set, const BRSet *otherSet)
     assert(otherSet != NULL);
     
     size_t i = 0, size = otherSet->size;
-    void *t;
+    const BRSetBucket *b;
     
     while (i < size) {
-        t = otherSet->table[i++];
-        if (t) BRSetAdd(set, t);
+        b = &otherSet->table[i++];
+        if (! b->item) continue;
+        
+        // reuse the cached hash when both sets hash the same way
+        if (set->hash == otherSet->hash) _BRSetAdd(set, b->item, b->hash);
+        else BRSetAdd(set, b->item);
     }
 }
 
@@ -290,7 +327,7 @@ void BRSetMinus(BRSet *set, const BRSet *otherSet)
     void *t;
     
     while (i < size) {
-        t = otherSet->table[i++];
+        t = otherSet->table[i++].item;
         if (t) BRSetRemove(set, t);
     }
 }
@@ -305,7 +342,7 @@ void BRSetIntersect(BRSet *set, const BRSet *otherSet)
     void *t;
     
     while (i < size) {
-        t = set->table[i];
+        t = set->table[i].item;
 
         if (t && ! BRSetContains(otherSet, t)) {
             BRSetRemove(set, t);
@@ -332,7 +369,7 @@ void BRSetFreeAll (BRSet *set, void (*itemFree) (void *item)) {
     void *t;
 
     while (i < size) {
-        t = set->table[i++];
+        t = set->table[i++].item;
         if (t) itemFree(t);
     }
 
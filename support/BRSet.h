@@ -53,6 +53,9 @@ void BRSetClear(BRSet *set);
 // returns the number of items in set
 size_t BRSetCount(const BRSet *set);
 
+// returns the bytes of memory allocated for set and its hashtable, not including the items it holds
+size_t BRSetMemoryUsage(const BRSet *set);
+
 // true if an item equivalant to the given item is contained in set
 int BRSetContains(const BRSet *set, const void *item);
 
@@ -97,6 +100,78 @@ void BRSetFreeAll (BRSet *set, void (*itemFree) (void *item));
        NULL != var; \
        var = BRSetIterate(set, var))
 
+// type specialized set functions
+//
+// BR_SET_DEFINE(prefix, type, hashFunc, eqFunc) defines inline functions prefix##Get(), prefix##Contains(),
+// prefix##Add() and prefix##Remove() that work the same as BRSetGet(), etc, on any BRSet of type items, returning
+// type * instead of void *, except that hashFunc() and eqFunc() are called directly, so they can be inlined into each
+// probe instead of called through the set's function pointers. the set must have been created with the same hash and
+// eq functions, and the other BRSet functions can still be used on it
+//
+// example:
+//
+// BR_SET_DEFINE(BRTxSet, BRTransaction, BRTransactionHash, BRTransactionEq)
+//
+// BRSet *txSet = BRSetNew(BRTransactionHash, BRTransactionEq, 100);
+//
+// BRTxSetAdd(txSet, tx);                   // same as BRSetAdd(txSet, tx)
+// if (BRTxSetContains(txSet, tx)) ...      // same as BRSetContains(txSet, tx)
+// BRSetFree(txSet);
+
+// the hashtable layout, exposed only for BR_SET_DEFINE(), use the BRSet functions instead of accessing it directly
+typedef struct {
+    void *item; // NULL for an empty bucket
+    uint32_t hash; // item hash, truncated to 32bits, the home bucket is hash % size
+    uint32_t dist; // distance the item is from its home bucket
+} BRSetBucket;
+
+struct BRSetStruct {
+    BRSetBucket *table; // hashtable
+    size_t size; // number of buckets in table
+    size_t itemCount; // number of items in set
+    size_t (*hash)(const void *); // hash function
+    int (*eq)(const void *, const void *); // equality function
+};
+
+// inserts an item with the given hash, known not to be in set, growing the hashtable as needed
+void _BRSetInsertNew(BRSet *set, void *item, uint32_t hash);
+
+// removes and returns the item in the bucket at index
+void *_BRSetRemoveIndex(BRSet *set, size_t index);
+
+#define BR_SET_DEFINE(prefix, type, hashFunc, eqFunc)\
+inline static size_t _##prefix##Index(const BRSet *set, const void *item, uint32_t h) {\
+    size_t size = set->size, i = h % size;\
+    uint32_t dist = 0;\
+    const BRSetBucket *b = &set->table[i];\
+    while (b->item && b->dist >= dist) {\
+        if (b->item == item || (b->hash == h && eqFunc(b->item, item))) return i;\
+        if (++i == size) i = 0;\
+        b = &set->table[i];\
+        dist++;\
+    }\
+    return size;\
+}\
+inline static type *prefix##Get(const BRSet *set, const void *item) {\
+    size_t i = _##prefix##Index(set, item, (uint32_t)hashFunc(item));\
+    return (i < set->size) ? (type *)set->table[i].item : NULL;\
+}\
+inline static int prefix##Contains(const BRSet *set, const void *item) {\
+    return (_##prefix##Index(set, item, (uint32_t)hashFunc(item)) < set->size);\
+}\
+inline static type *prefix##Add(BRSet *set, void *item) {\
+    uint32_t h = (uint32_t)hashFunc(item);\
+    size_t i = _##prefix##Index(set, item, h);\
+    type *t = NULL;\
+    if (i < set->size) t = (type *)set->table[i].item, set->table[i].item = item;\
+    else _BRSetInsertNew(set, item, h);\
+    return t;\
+}\
+inline static type *prefix##Remove(BRSet *set, const void *item) {\
+    size_t i = _##prefix##Index(set, item, (uint32_t)hashFunc(item));\
+    return (i < set->size) ? (type *)_BRSetRemoveIndex(set, i) : NULL;\
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,199 @@
+//
+//  BRStats.c
+//
+//  Copyright (c) 2019 breadwallet LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "BRStats.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#define STATS_STRIPES 16 // threads are assigned stripes round robin, so updates from different threads rarely share one
+
+typedef struct {
+    _Alignas(64) _Atomic uint64_t counters[BRStatsCounterCount]; // aligned so stripes don't share cache lines
+    struct {
+        _Atomic uint64_t count, sum;
+        _Atomic uint64_t buckets[BR_STATS_BUCKETS];
+    } histograms[BRStatsHistogramCount];
+} BRStatsStripe;
+
+static BRStatsStripe _stripes[STATS_STRIPES];
+static _Atomic unsigned _stripeNext;
+static _Thread_local BRStatsStripe *_stripe;
+
+inline static BRStatsStripe *_BRStatsStripe(void)
+{
+    if (! _stripe) {
+        _stripe = &_stripes[atomic_fetch_add_explicit(&_stripeNext, 1, memory_order_relaxed) % STATS_STRIPES];
+    }
+
+    return _stripe;
+}
+
+// adds n to counter
+void BRStatsCount(BRStatsCounter counter, uint64_t n)
+{
+    assert(counter < BRStatsCounterCount);
+    atomic_fetch_add_explicit(&_BRStatsStripe()->counters[counter], n, memory_order_relaxed);
+}
+
+// adds value to histogram
+void BRStatsRecord(BRStatsHistogramType histogram, uint64_t value)
+{
+    BRStatsStripe *stripe = _BRStatsStripe();
+    size_t bucket = 0;
+
+    assert(histogram < BRStatsHistogramCount);
+    while (value >> bucket && bucket < BR_STATS_BUCKETS - 1) bucket++; // bit length of value, capped at last bucket
+    atomic_fetch_add_explicit(&stripe->histograms[histogram].count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stripe->histograms[histogram].sum, value, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stripe->histograms[histogram].buckets[bucket], 1, memory_order_relaxed);
+}
+
+// microseconds from a monotonic clock, for timing histogram values
+uint64_t BRStatsMicroseconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000 + (uint64_t)ts.tv_nsec/1000;
+}
+
+// sums the totals of all threads since startup into stats, take the difference of two snapshots to measure an interval
+void BRStatsSnapshot(BRStats *stats)
+{
+    size_t i, j, k;
+
+    assert(stats != NULL);
+    memset(stats, 0, sizeof(*stats));
+
+    for (i = 0; i < STATS_STRIPES; i++) {
+        for (j = 0; j < BRStatsCounterCount; j++) {
+            stats->counters[j] += atomic_load_explicit(&_stripes[i].counters[j], memory_order_relaxed);
+        }
+
+        for (j = 0; j < BRStatsHistogramCount; j++) {
+            stats->histograms[j].count += atomic_load_explicit(&_stripes[i].histograms[j].count, memory_order_relaxed);
+            stats->histograms[j].sum += atomic_load_explicit(&_stripes[i].histograms[j].sum, memory_order_relaxed);
+
+            for (k = 0; k < BR_STATS_BUCKETS; k++) {
+                stats->histograms[j].buckets[k] += atomic_load_explicit(&_stripes[i].histograms[j].buckets[k],
+                                                                        memory_order_relaxed);
+            }
+        }
+    }
+}
+
+#ifdef BR_TRACE
+
+typedef struct {
+    _Atomic uint64_t seq; // 1 + the index of the span written to the slot, 0 while a span is being written
+    _Atomic uint64_t begin, end, id;
+    _Atomic uint32_t span, thread;
+} BRTraceSlot;
+
+static BRTraceSlot _traceRing[BR_TRACE_CAPACITY];
+static _Atomic uint64_t _traceNext;
+static _Atomic uint32_t _traceThreadNext;
+static _Thread_local uint32_t _traceThread;
+
+#endif
+
+// records a span that ran from begin to end, in BRStatsMicroseconds(), on the calling thread, call it through
+// BR_TRACE_ADD() or BR_TRACE_END() so it compiles away without BR_TRACE
+void BRTraceAdd(BRTraceSpan span, uint64_t begin, uint64_t end, uint64_t id)
+{
+#ifdef BR_TRACE
+    uint64_t i = atomic_fetch_add_explicit(&_traceNext, 1, memory_order_relaxed);
+    BRTraceSlot *slot = &_traceRing[i & (BR_TRACE_CAPACITY - 1)];
+
+    assert(span < BRTraceSpanCount);
+    if (! _traceThread) _traceThread = atomic_fetch_add_explicit(&_traceThreadNext, 1, memory_order_relaxed) + 1;
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed); // seqlock, readers skip the slot until seq is set
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&slot->begin, begin, memory_order_relaxed);
+    atomic_store_explicit(&slot->end, (end > begin) ? end : begin, memory_order_relaxed);
+    atomic_store_explicit(&slot->id, id, memory_order_relaxed);
+    atomic_store_explicit(&slot->span, span, memory_order_relaxed);
+    atomic_store_explicit(&slot->thread, _traceThread, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, i + 1, memory_order_release);
+#else
+    (void)span, (void)begin, (void)end, (void)id;
+#endif
+}
+
+static size_t _BRTracePrintf(char *json, size_t jsonLen, size_t off, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf((json && off < jsonLen) ? &json[off] : NULL, (json && off < jsonLen) ? jsonLen - off : 0, fmt, ap);
+    va_end(ap);
+    return (n > 0) ? (size_t)n : 0;
+}
+
+// writes the spans in the ring buffer, oldest first, to json as a chrome trace and returns the length of the complete
+// trace, not counting the NUL terminator, the trace is truncated if jsonLen is too small, and json may be NULL
+size_t BRTraceChromeJSON(char *json, size_t jsonLen)
+{
+    size_t off = 0;
+
+    off += _BRTracePrintf(json, jsonLen, off, "{\"traceEvents\":[");
+#ifdef BR_TRACE
+    static const char *names[BRTraceSpanCount] = {
+        "peer connect", "peer getblocks", "filterload", "merkleblock", "wallet update",
+        "les provision wait", "les provision handle", "bcs provision", "ewm poll"
+    };
+    static const char *categories[BRTraceSpanCount] = {
+        "bitcoin", "bitcoin", "bitcoin", "bitcoin", "bitcoin", "ethereum", "ethereum", "ethereum", "ethereum"
+    };
+    uint64_t next = atomic_load_explicit(&_traceNext, memory_order_acquire), seq, begin, end, id;
+    uint32_t span, thread;
+    int first = 1;
+
+    for (uint64_t i = (next > BR_TRACE_CAPACITY) ? next - BR_TRACE_CAPACITY : 0; i < next; i++) {
+        BRTraceSlot *slot = &_traceRing[i & (BR_TRACE_CAPACITY - 1)];
+
+        seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        begin = atomic_load_explicit(&slot->begin, memory_order_relaxed);
+        end = atomic_load_explicit(&slot->end, memory_order_relaxed);
+        id = atomic_load_explicit(&slot->id, memory_order_relaxed);
+        span = atomic_load_explicit(&slot->span, memory_order_relaxed);
+        thread = atomic_load_explicit(&slot->thread, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (seq != i + 1 || seq != atomic_load_explicit(&slot->seq, memory_order_relaxed)) continue; // overwritten
+        if (span >= BRTraceSpanCount) continue;
+
+        off += _BRTracePrintf(json, jsonLen, off, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                              "\"tid\":%" PRIu32 ",\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 ",\"args\":{\"id\":%"
+                              PRIu64 "}}", (first) ? "" : ",", names[span], categories[span], thread, begin,
+                              end - begin, id);
+        first = 0;
+    }
+#endif
+    off += _BRTracePrintf(json, jsonLen, off, "]}");
+    return off;
+}
@@ -0,0 +1,135 @@
+//
+//  BRStats.h
+//
+//  Copyright (c) 2019 breadwallet LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef BRStats_h
+#define BRStats_h
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// hot path instrumentation shared by the bitcoin and ethereum cores: counters and histograms are updated lock-free
+// into per-thread stripes, and summed by BRStatsSnapshot()
+
+#define BR_STATS_MSG_TYPES 64 // per message type counters, indexed by a protocol specific type number
+#define BR_STATS_EVENT_PRIORITIES 3 // per event priority histograms, indexed by BREventPriority
+#define BR_STATS_BUCKETS   32 // histogram bucket 0 counts zero values, bucket i counts values in [2^(i-1), 2^i)
+
+typedef enum {
+    BRStatsPeerMsgsIn = 0, // + BRPeer message type index, bitcoin messages received
+    BRStatsPeerMsgsOut = BRStatsPeerMsgsIn + BR_STATS_MSG_TYPES, // + BRPeer message type index, bitcoin messages sent
+    BRStatsPeerBytesIn = BRStatsPeerMsgsOut + BR_STATS_MSG_TYPES, // including message headers
+    BRStatsPeerBytesOut,
+    BRStatsLESMsgsIn, // + RLPx message id, ethereum messages received
+    BRStatsLESMsgsOut = BRStatsLESMsgsIn + BR_STATS_MSG_TYPES, // + RLPx message id, ethereum messages sent
+    BRStatsLESBytesIn = BRStatsLESMsgsOut + BR_STATS_MSG_TYPES, // including frame headers and padding
+    BRStatsLESBytesOut,
+    BRStatsBCSSyncRanges, // block ranges searched by a BCS sync
+    BRStatsBCSBlockHeaders, // block headers handled by BCS
+    BRStatsEventsQueued, // events signalled to event handlers, less BRStatsEventsDispatched is the total queue depth
+    BRStatsEventsDispatched, // (except for events cleared without being dispatched)
+    BRStatsEventsCoalesced, // events signalled to event handlers that replaced a pending event, rather than queued
+    BRStatsFileServiceWrites, // records appended to file service logs
+    BRStatsFileServiceBytes,
+    BRStatsCounterCount
+} BRStatsCounter;
+
+typedef enum {
+    BRStatsPeerPingTime, // microseconds from ping to pong
+    BRStatsPeerManagerLockWait, // microseconds waiting for, and holding, the BRPeerManager lock
+    BRStatsPeerManagerLockHold,
+    BRStatsLESProvisionTime, // microseconds from a provision's first request to its first response
+    BRStatsEWMLockWait, // microseconds waiting for, and holding, the EWM lock in ewmLock() and ewmUnlock()
+    BRStatsEWMLockHold,
+    BRStatsEventBatchSize, // events dispatched together by an event handler
+    BRStatsFileServiceWriteTime, // microseconds to append a record to a file service log
+    BRStatsEventQueueLatency, // + BREventPriority, microseconds from signalling an event to dispatching it
+    BRStatsHistogramCount = BRStatsEventQueueLatency + BR_STATS_EVENT_PRIORITIES
+} BRStatsHistogramType;
+
+typedef struct {
+    uint64_t count, sum;
+    uint64_t buckets[BR_STATS_BUCKETS];
+} BRStatsHistogram;
+
+typedef struct {
+    uint64_t counters[BRStatsCounterCount];
+    BRStatsHistogram histograms[BRStatsHistogramCount];
+} BRStats;
+
+// adds n to counter
+void BRStatsCount(BRStatsCounter counter, uint64_t n);
+
+// adds value to histogram
+void BRStatsRecord(BRStatsHistogramType histogram, uint64_t value);
+
+// microseconds from a monotonic clock, for timing histogram values
+uint64_t BRStatsMicroseconds(void);
+
+// sums the totals of all threads since startup into stats, take the difference of two snapshots to measure an interval
+void BRStatsSnapshot(BRStats *stats);
+
+// span tracing, compiled in only when BR_TRACE is defined: spans are written lock-free into a ring buffer holding the
+// most recent BR_TRACE_CAPACITY, and BRTraceChromeJSON() dumps them in the chrome://tracing trace event format
+
+#define BR_TRACE_CAPACITY 65536 // spans kept, the oldest are overwritten first, must be a power of 2
+
+typedef enum {
+    BRTracePeerConnect, // from opening a peer's socket to its verack, id is the peer's port
+    BRTracePeerGetblocks, // from sending getblocks to the inv of block hashes in reply, id is the inv count
+    BRTracePeerManagerFilterload, // building a bloom filter and sending it to a peer, id is the element count
+    BRTracePeerManagerMerkleblock, // handling a relayed merkleblock, id is the block height
+    BRTraceWalletUpdate, // BRWalletUpdateTransactions(), id is the transaction count
+    BRTraceLESProvisionWait, // from sending a provision's first request to its first response, id is the provision
+    BRTraceLESProvisionHandle, // handling a response to a provision, id is the provision identifier
+    BRTraceBCSProvision, // BCS handling a completed provision, id is the provision identifier
+    BRTraceEWMPoll, // the periodic BRD mode poll of balances, nonces and transactions, id is the block height
+    BRTraceSpanCount
+} BRTraceSpan;
+
+// records a span that ran from begin to end, in BRStatsMicroseconds(), on the calling thread, call it through
+// BR_TRACE_ADD() or BR_TRACE_END() so it compiles away without BR_TRACE
+void BRTraceAdd(BRTraceSpan span, uint64_t begin, uint64_t end, uint64_t id);
+
+// writes the spans in the ring buffer, oldest first, to json as a chrome trace and returns the length of the complete
+// trace, not counting the NUL terminator, the trace is truncated if jsonLen is too small, and json may be NULL
+size_t BRTraceChromeJSON(char *json, size_t jsonLen);
+
+#ifdef BR_TRACE
+#define BR_TRACE_BEGIN(begin)           uint64_t begin = BRStatsMicroseconds()
+#define BR_TRACE_END(span, begin, id)   BRTraceAdd((span), (begin), BRStatsMicroseconds(), (id))
+#define BR_TRACE_ADD(span, begin, end, id) BRTraceAdd((span), (begin), (end), (id))
+#else
+#define BR_TRACE_BEGIN(begin)
+#define BR_TRACE_END(span, begin, id)   ((void)0)
+#define BR_TRACE_ADD(span, begin, end, id) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BRStats_h
@@ -0,0 +1,412 @@
+//
+//  BRThreadPool.c
+//
+//  Copyright (c) 2019 breadwallet LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // for CPU_SET()
+#endif
+
+#include "BRThreadPool.h"
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+// each worker owns a deque, and tasks added from outside the pool go on one more deque that only thieves take from
+// deques are short ring buffers behind their own lock, since tasks are expected to run for much longer than a lock is
+// held for, and workers only contend for a lock when one is stealing
+
+#define POOL_THREADS_MAX   64
+#define POOL_DEQUE_MIN     16 // initial capacity of each deque
+#define POOL_STACK_SIZE    (512 * 1024)
+
+typedef struct {
+    void (*run)(void *info);
+    void *info;
+    BRTaskGroup *group;
+} _BRTask;
+
+typedef struct {
+    pthread_mutex_t lock;
+    _BRTask *tasks; // ring buffer, the oldest task is at tasks[head]
+    size_t head, count, capacity;
+} _BRTaskDeque;
+
+typedef struct {
+    BRThreadPool *pool;
+    size_t index;
+    pthread_t thread;
+} _BRWorker;
+
+struct BRThreadPoolStruct {
+    size_t threadCount;
+    _BRWorker *workers;
+    _BRTaskDeque *deques; // one per worker, followed by the deque for tasks added from outside the pool
+    int *cpus;
+    size_t cpuCount;
+    pthread_mutex_t lock; // held to change queued or done, and to wait on cond
+    pthread_cond_t cond;
+    long queued; // tasks added to a deque and not yet taken, which may briefly be negative while a task is added
+    int done;
+};
+
+struct BRTaskGroupStruct {
+    BRThreadPool *pool;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t remaining; // tasks added that haven't finished or been skipped
+    int cancelled;
+};
+
+static pthread_key_t _workerKey; // the _BRWorker for the calling thread, or NULL if it isn't a worker
+static pthread_once_t _workerKeyOnce = PTHREAD_ONCE_INIT;
+
+static void _BRThreadPoolKeyInit(void)
+{
+    pthread_key_create(&_workerKey, NULL);
+}
+
+static void _BRTaskDequePush(_BRTaskDeque *deque, _BRTask task)
+{
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->count == deque->capacity) {
+        size_t capacity = (deque->capacity > 0) ? deque->capacity*2 : POOL_DEQUE_MIN;
+        _BRTask *tasks = malloc(capacity*sizeof(*tasks));
+
+        assert(tasks != NULL);
+        for (size_t i = 0; i < deque->count; i++) tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+        if (deque->tasks) free(deque->tasks);
+        deque->tasks = tasks;
+        deque->head = 0;
+        deque->capacity = capacity;
+    }
+
+    deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+    deque->count++;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+// takes the newest task if newest is true, otherwise the oldest, returns true if there was a task to take
+static int _BRTaskDequeTake(_BRTaskDeque *deque, int newest, _BRTask *task)
+{
+    int r = 0;
+
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->count > 0) {
+        deque->count--;
+
+        if (newest) *task = deque->tasks[(deque->head + deque->count) % deque->capacity];
+        else *task = deque->tasks[deque->head], deque->head = (deque->head + 1) % deque->capacity;
+
+        r = 1;
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+    return r;
+}
+
+// takes a task for the worker with the given index, or for a thread outside the pool if index is threadCount, first
+// from its own deque, then by stealing from the other deques, returns true if a task was taken
+static int _BRThreadPoolTake(BRThreadPool *pool, size_t index, _BRTask *task)
+{
+    size_t i, n = pool->threadCount + 1;
+    int r = 0;
+
+    if (index < pool->threadCount) r = _BRTaskDequeTake(&pool->deques[index], 1, task);
+
+    // steal starting with the next deque, so that thieves spread out instead of all contending for the first one
+    for (i = 1; ! r && i <= n; i++) r = _BRTaskDequeTake(&pool->deques[(index + i) % n], 0, task);
+
+    if (r) {
+        pthread_mutex_lock(&pool->lock);
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return r;
+}
+
+static void _BRTaskRun(_BRTask task)
+{
+    BRTaskGroup *group = task.group;
+    int cancelled;
+
+    pthread_mutex_lock(&group->lock);
+    cancelled = group->cancelled;
+    pthread_mutex_unlock(&group->lock);
+    if (! cancelled) task.run(task.info);
+    pthread_mutex_lock(&group->lock);
+    if (--group->remaining == 0) pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->lock);
+}
+
+static void _BRThreadPoolSetAffinity(BRThreadPool *pool)
+{
+#if defined(__linux__) && defined(CPU_SET)
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+
+    for (size_t i = 0; i < pool->cpuCount; i++) {
+        if (pool->cpus[i] >= 0 && pool->cpus[i] < CPU_SETSIZE) CPU_SET(pool->cpus[i], &set);
+    }
+
+    sched_setaffinity(0, sizeof(set), &set); // pid 0 is the calling thread, this works on both glibc and bionic
+#endif
+}
+
+static void *_BRWorkerRoutine(void *info)
+{
+    _BRWorker *worker = info;
+    BRThreadPool *pool = worker->pool;
+    _BRTask task;
+
+    pthread_setspecific(_workerKey, worker);
+    if (pool->cpuCount > 0) _BRThreadPoolSetAffinity(pool);
+    pthread_mutex_lock(&pool->lock);
+
+    while (! pool->done) {
+        if (pool->queued > 0) {
+            pthread_mutex_unlock(&pool->lock);
+            if (_BRThreadPoolTake(pool, worker->index, &task)) _BRTaskRun(task);
+            else sched_yield(); // a task is being added or taken by another thread
+            pthread_mutex_lock(&pool->lock);
+        }
+        else pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// returns a newly allocated pool of threadCount worker threads, or one per cpu core if threadCount is 0, that must be
+// freed by calling BRThreadPoolFree()
+// if cpuCount is greater than 0, the workers only run on the cpus listed in cpus, where supported (linux and android)
+BRThreadPool *BRThreadPoolNew(size_t threadCount, const int cpus[], size_t cpuCount)
+{
+    BRThreadPool *pool = calloc(1, sizeof(*pool));
+    pthread_attr_t attr;
+    size_t i;
+
+    assert(pool != NULL);
+    assert(cpus != NULL || cpuCount == 0);
+    pthread_once(&_workerKeyOnce, _BRThreadPoolKeyInit);
+    if (threadCount == 0) threadCount = (sysconf(_SC_NPROCESSORS_ONLN) > 0) ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    if (threadCount > POOL_THREADS_MAX) threadCount = POOL_THREADS_MAX;
+    pool->workers = calloc(threadCount, sizeof(*pool->workers));
+    pool->deques = calloc(threadCount + 1, sizeof(*pool->deques));
+    assert(pool->workers != NULL);
+    assert(pool->deques != NULL);
+
+    if (cpuCount > 0) {
+        pool->cpus = malloc(cpuCount*sizeof(*pool->cpus));
+        assert(pool->cpus != NULL);
+        memcpy(pool->cpus, cpus, cpuCount*sizeof(*pool->cpus));
+        pool->cpuCount = cpuCount;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, POOL_STACK_SIZE);
+
+    for (i = 0; i < threadCount; i++) { // the pool runs with however many workers could be started
+        pool->workers[pool->threadCount] = (_BRWorker) { pool, pool->threadCount, 0 };
+
+        if (pthread_create(&pool->workers[pool->threadCount].thread, &attr, _BRWorkerRoutine,
+                           &pool->workers[pool->threadCount]) == 0) pool->threadCount++;
+    }
+
+    pthread_attr_destroy(&attr);
+
+    // workers don't look at the deques until a task is added, so the deque for tasks added from outside the pool can
+    // follow the last worker that was started
+    for (i = 0; i <= pool->threadCount; i++) pthread_mutex_init(&pool->deques[i].lock, NULL);
+    return pool;
+}
+
+static BRThreadPool *_sharedPool = NULL;
+static pthread_once_t _sharedPoolOnce = PTHREAD_ONCE_INIT;
+
+static void _BRThreadPoolSharedInit(void)
+{
+    _sharedPool = BRThreadPoolNew(0, NULL, 0);
+}
+
+// returns the pool of one worker per cpu core shared by the support library, which is started on first use and never
+// freed
+BRThreadPool *BRThreadPoolShared(void)
+{
+    pthread_once(&_sharedPoolOnce, _BRThreadPoolSharedInit);
+    return _sharedPool;
+}
+
+// returns the number of worker threads in pool
+size_t BRThreadPoolThreadCount(const BRThreadPool *pool)
+{
+    assert(pool != NULL);
+    return pool->threadCount;
+}
+
+// waits for the workers to finish the tasks they're running, and frees memory allocated for pool
+// every task group of pool must have been waited on first
+void BRThreadPoolFree(BRThreadPool *pool)
+{
+    size_t i;
+
+    assert(pool != NULL);
+    assert(pool != _sharedPool);
+    pthread_mutex_lock(&pool->lock);
+    assert(pool->queued == 0);
+    pool->done = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->threadCount; i++) pthread_join(pool->workers[i].thread, NULL);
+
+    for (i = 0; i <= pool->threadCount; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        if (pool->deques[i].tasks) free(pool->deques[i].tasks);
+    }
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    if (pool->cpus) free(pool->cpus);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
+
+// returns a newly allocated empty task group that runs its tasks on pool, and must be freed by calling
+// BRTaskGroupFree()
+BRTaskGroup *BRTaskGroupNew(BRThreadPool *pool)
+{
+    BRTaskGroup *group = calloc(1, sizeof(*group));
+
+    assert(pool != NULL);
+    assert(group != NULL);
+    group->pool = pool;
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->cond, NULL);
+    return group;
+}
+
+// adds a task to group that calls run() with info on one of the pool's workers, or on a thread waiting on the pool
+// run() may add more tasks to the group, or to any other group
+// returns false without adding the task if group was cancelled
+int BRTaskGroupAdd(BRTaskGroup *group, void *info, void (*run)(void *info))
+{
+    BRThreadPool *pool;
+    _BRWorker *worker;
+    int r = 0;
+
+    assert(group != NULL);
+    assert(run != NULL);
+    pool = group->pool;
+    pthread_mutex_lock(&group->lock);
+
+    if (! group->cancelled) {
+        group->remaining++;
+        r = 1;
+    }
+
+    pthread_mutex_unlock(&group->lock);
+
+    if (r) {
+        worker = pthread_getspecific(_workerKey);
+        _BRTaskDequePush(&pool->deques[(worker && worker->pool == pool) ? worker->index : pool->threadCount],
+                         (_BRTask) { run, info, group });
+        pthread_mutex_lock(&pool->lock);
+        pool->queued++;
+        pthread_cond_signal(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return r;
+}
+
+// cancels group, so that its tasks that haven't started yet are skipped, and no more tasks are added to it
+// tasks already running are not interrupted, but long running tasks may check BRTaskGroupIsCancelled() to stop early
+void BRTaskGroupCancel(BRTaskGroup *group)
+{
+    assert(group != NULL);
+    pthread_mutex_lock(&group->lock);
+    group->cancelled = 1;
+    pthread_mutex_unlock(&group->lock);
+}
+
+// true if group was cancelled
+int BRTaskGroupIsCancelled(BRTaskGroup *group)
+{
+    int r;
+
+    assert(group != NULL);
+    pthread_mutex_lock(&group->lock);
+    r = group->cancelled;
+    pthread_mutex_unlock(&group->lock);
+    return r;
+}
+
+// waits for every task added to group to finish or be skipped, running queued tasks of the pool on the calling thread
+// meanwhile, so waiting from within a task doesn't leave a worker idle
+// returns false if group was cancelled
+int BRTaskGroupWait(BRTaskGroup *group)
+{
+    BRThreadPool *pool;
+    _BRWorker *worker;
+    _BRTask task;
+    size_t index;
+    int r;
+
+    assert(group != NULL);
+    pool = group->pool;
+    worker = pthread_getspecific(_workerKey);
+    index = (worker && worker->pool == pool) ? worker->index : pool->threadCount;
+    pthread_mutex_lock(&group->lock);
+
+    while (group->remaining > 0) {
+        pthread_mutex_unlock(&group->lock);
+
+        if (! _BRThreadPoolTake(pool, index, &task)) { // the group's remaining tasks are running on other threads
+            pthread_mutex_lock(&group->lock);
+            if (group->remaining > 0) pthread_cond_wait(&group->cond, &group->lock);
+        }
+        else _BRTaskRun(task), pthread_mutex_lock(&group->lock);
+    }
+
+    r = ! group->cancelled;
+    pthread_mutex_unlock(&group->lock);
+    return r;
+}
+
+// waits on group, and frees memory allocated for it
+void BRTaskGroupFree(BRTaskGroup *group)
+{
+    assert(group != NULL);
+    BRTaskGroupWait(group);
+    pthread_cond_destroy(&group->cond);
+    pthread_mutex_destroy(&group->lock);
+    free(group);
+}
@@ -0,0 +1,86 @@
+//
+//  BRThreadPool.h
+//
+//  Copyright (c) 2019 breadwallet LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef BRThreadPool_h
+#define BRThreadPool_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// a fixed set of worker threads that run short cpu bound tasks, so that batch work from different modules shares the
+// cpu cores rather than each starting its own threads
+// each worker has its own deque of tasks: tasks added from a worker go on that worker's deque, where it takes the most
+// recently added first, and idle workers steal the oldest tasks from the other deques
+typedef struct BRThreadPoolStruct BRThreadPool;
+
+// a set of tasks that can be waited on, or cancelled, together
+typedef struct BRTaskGroupStruct BRTaskGroup;
+
+// returns a newly allocated pool of threadCount worker threads, or one per cpu core if threadCount is 0, that must be
+// freed by calling BRThreadPoolFree()
+// if cpuCount is greater than 0, the workers only run on the cpus listed in cpus, where supported (linux and android)
+BRThreadPool *BRThreadPoolNew(size_t threadCount, const int cpus[], size_t cpuCount);
+
+// returns the pool of one worker per cpu core shared by the support library, which is started on first use and never
+// freed
+BRThreadPool *BRThreadPoolShared(void);
+
+// returns the number of worker threads in pool
+size_t BRThreadPoolThreadCount(const BRThreadPool *pool);
+
+// waits for the workers to finish the tasks they're running, and frees memory allocated for pool
+// every task group of pool must have been waited on first
+void BRThreadPoolFree(BRThreadPool *pool);
+
+// returns a newly allocated empty task group that runs its tasks on pool, and must be freed by calling
+// BRTaskGroupFree()
+BRTaskGroup *BRTaskGroupNew(BRThreadPool *pool);
+
+// adds a task to group that calls run() with info on one of the pool's workers, or on a thread waiting on the pool
+// run() may add more tasks to the group, or to any other group
+// returns false without adding the task if group was cancelled
+int BRTaskGroupAdd(BRTaskGroup *group, void *info, void (*run)(void *info));
+
+// cancels group, so that its tasks that haven't started yet are skipped, and no more tasks are added to it
+// tasks already running are not interrupted, but long running tasks may check BRTaskGroupIsCancelled() to stop early
+void BRTaskGroupCancel(BRTaskGroup *group);
+
+// true if group was cancelled
+int BRTaskGroupIsCancelled(BRTaskGroup *group);
+
+// waits for every task added to group to finish or be skipped, running queued tasks of the pool on the calling thread
+// meanwhile, so waiting from within a task doesn't leave a worker idle
+// returns false if group was cancelled
+int BRTaskGroupWait(BRTaskGroup *group);
+
+// waits on group, and frees memory allocated for it
+void BRTaskGroupFree(BRTaskGroup *group);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BRThreadPool_h
@@ -7,7 +7,10 @@
 //
 
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
 #include <ftw.h>
 #include <errno.h>
 #include <unistd.h>
@@ -15,6 +18,8 @@
 
 #include "BRFileService.h"
 #include "BRAssert.h"
+#include "BRStats.h"
+#include "BRFeeEstimator.h"
 
 /// MARK: - File Service Tests
 
@@ -40,6 +45,93 @@ fileServiceTestDone (char *path, int success) {
     return success;
 }
 
+typedef struct {
+    UInt256 identifier;
+    uint32_t value;
+} SupFileServiceEntity;
+
+static size_t
+supFileServiceEntityHash (const void *entity) {
+    return (size_t) UInt32GetLE (((const SupFileServiceEntity *) entity)->identifier.u8);
+}
+
+static int
+supFileServiceEntityEq (const void *entity1, const void *entity2) {
+    return UInt256Eq (((const SupFileServiceEntity *) entity1)->identifier,
+                      ((const SupFileServiceEntity *) entity2)->identifier);
+}
+
+static UInt256
+supFileServiceEntityIdentifier (BRFileServiceContext context,
+                                BRFileService fs,
+                                const void *entity) {
+    return ((const SupFileServiceEntity *) entity)->identifier;
+}
+
+static void *
+supFileServiceEntityReader (BRFileServiceContext context,
+                            BRFileService fs,
+                            uint8_t *bytes,
+                            uint32_t bytesCount) {
+    if (bytesCount != sizeof (UInt256) + sizeof (uint32_t)) return NULL;
+
+    SupFileServiceEntity *entity = malloc (sizeof (SupFileServiceEntity));
+    entity->identifier = UInt256Get (bytes);
+    entity->value = UInt32GetLE (&bytes[sizeof (UInt256)]);
+    return entity;
+}
+
+static uint8_t *
+supFileServiceEntityWriter (BRFileServiceContext context,
+                            BRFileService fs,
+                            const void* entity,
+                            uint32_t *bytesCount) {
+    const SupFileServiceEntity *supEntity = entity;
+    uint8_t *bytes = malloc (sizeof (UInt256) + sizeof (uint32_t));
+
+    UInt256Set (bytes, supEntity->identifier);
+    UInt32SetLE (&bytes[sizeof (UInt256)], supEntity->value);
+    *bytesCount = sizeof (UInt256) + sizeof (uint32_t);
+    return bytes;
+}
+
+static void
+supFileServiceEntityRelease (void *info, void *entity) {
+    free (entity);
+}
+
+/// Load `type` from a newly created file service, mapped or not and concurrently or not; return
+/// the count of entities loaded, with the value of the one for `identifier` in `value`, or -1 on error.
+static int
+supFileServiceLoad (char *path, char *currency, char *network, char *type, int mapped, int concurrent,
+                    UInt256 identifier, uint32_t *value) {
+    BRFileService fs = fileServiceCreate(path, currency, network, NULL, NULL);
+    if (NULL == fs) return -1;
+
+    fileServiceSetLoadMapped (fs, mapped);
+
+    if (1 != fileServiceDefineType (fs, type, 0, NULL,
+                                    supFileServiceEntityIdentifier,
+                                    supFileServiceEntityReader,
+                                    supFileServiceEntityWriter) ||
+        1 != fileServiceDefineCurrentVersion (fs, type, 0) ||
+        1 != fileServiceSetLoadConcurrent (fs, type, concurrent)) {
+        fileServiceRelease (fs);
+        return -1;
+    }
+
+    BRSet *entities = BRSetNew (supFileServiceEntityHash, supFileServiceEntityEq, 10);
+    int count = (1 == fileServiceLoad (fs, entities, type, 1) ? (int) BRSetCount (entities) : -1);
+
+    SupFileServiceEntity *entity = BRSetGet (entities, &identifier);
+    *value = (NULL == entity ? 0 : entity->value);
+
+    BRSetApply (entities, NULL, supFileServiceEntityRelease);
+    BRSetFree (entities);
+    fileServiceRelease (fs);
+    return count;
+}
+
 /// MARK: - File Service Tests
 
 static int runSupFileServiceTests (void) {
@@ -93,6 +185,241 @@ static int runSupFileServiceTests (void) {
     if (1 != fileServiceDefineCurrentVersion(fs, type1, 0))
         return fileServiceTestDone (path, 0);
 
+    //
+    // Save, update and remove entities of type2; expect a new file service to load what remains.
+    //
+    char *type2 = "bar";
+    SupFileServiceEntity entities[3] = {
+        { UINT256_ZERO, 1 },
+        { UINT256_ZERO, 2 },
+        { UINT256_ZERO, 3 }
+    };
+    uint32_t value;
+
+    for (size_t index = 0; index < 3; index++)
+        entities[index].identifier.u8[0] = (uint8_t) (index + 1);
+
+    if (1 != fileServiceDefineType (fs, type2, 0, NULL,
+                                    supFileServiceEntityIdentifier,
+                                    supFileServiceEntityReader,
+                                    supFileServiceEntityWriter))
+        return fileServiceTestDone (path, 0);
+
+    for (size_t index = 0; index < 3; index++)
+        fileServiceSave (fs, type2, &entities[index]);
+
+    entities[0].value = 10;
+    fileServiceSave (fs, type2, &entities[0]);
+    fileServiceRemove (fs, type2, entities[1].identifier);
+    fileServiceRelease (fs);
+
+    if (2 != supFileServiceLoad (path, currency, network, type2, 0, 0, entities[0].identifier, &value) || 10 != value)
+        return fileServiceTestDone (path, 0);
+
+    // Loading from a mapped log finds the same.
+    if (2 != supFileServiceLoad (path, currency, network, type2, 1, 0, entities[0].identifier, &value) || 10 != value)
+        return fileServiceTestDone (path, 0);
+
+    // A torn record at the end of the log, from a crash mid-append, is dropped.
+    sprintf (fullpath, "%s/%s/%s/%s.log", path, currency, network, type2);
+    FILE *file = fopen (fullpath, "ab");
+    if (NULL == file || 1 != fwrite ("\x01\x04", 2, 1, file) || 0 != fclose (file))
+        return fileServiceTestDone (path, 0);
+
+    if (2 != supFileServiceLoad (path, currency, network, type2, 1, 0, entities[2].identifier, &value) || 3 != value)
+        return fileServiceTestDone (path, 0);
+
+    // A log locked exclusively, as while another process truncates it, is read rather than mapped.
+    int locker = open (fullpath, O_RDONLY);
+    if (-1 == locker || 0 != flock (locker, LOCK_EX) ||
+        2 != supFileServiceLoad (path, currency, network, type2, 1, 0, entities[2].identifier, &value) || 3 != value)
+        return fileServiceTestDone (path, 0);
+    close (locker);
+
+    //
+    // Write behind; expect repeated saves to coalesce and a flush to make everything loadable.
+    //
+    char *type3 = "baz";
+
+    fs = fileServiceCreate(path, currency, network, NULL, NULL);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    if (1 != fileServiceDefineType (fs, type3, 0, NULL,
+                                    supFileServiceEntityIdentifier,
+                                    supFileServiceEntityReader,
+                                    supFileServiceEntityWriter))
+        return fileServiceTestDone (path, 0);
+
+    fileServiceSetWriteBehind (fs, 1);
+
+    for (uint32_t count = 0; count < 1000; count++) {
+        entities[count % 3].value = count;
+        fileServiceSave (fs, type3, &entities[count % 3]);
+    }
+    fileServiceRemove (fs, type3, entities[1].identifier);
+    fileServiceFlush (fs);
+
+    if (2 != supFileServiceLoad (path, currency, network, type3, 0, 0, entities[0].identifier, &value) || 999 != value)
+        return fileServiceTestDone (path, 0);
+
+    // Saves queued at release are written.
+    fileServiceSave (fs, type3, &entities[1]);
+    fileServiceRelease (fs);
+
+    if (3 != supFileServiceLoad (path, currency, network, type3, 0, 0, entities[1].identifier, &value) || 997 != value)
+        return fileServiceTestDone (path, 0);
+
+    //
+    // Batch; expect nothing written until the outermost end, and a clear to drop what was collected.
+    //
+    char *type4 = "qux";
+
+    fs = fileServiceCreate(path, currency, network, NULL, NULL);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    if (1 != fileServiceDefineType (fs, type4, 0, NULL,
+                                    supFileServiceEntityIdentifier,
+                                    supFileServiceEntityReader,
+                                    supFileServiceEntityWriter))
+        return fileServiceTestDone (path, 0);
+
+    fileServiceBeginBatch (fs);
+    fileServiceSave (fs, type4, &entities[0]);
+    fileServiceClear (fs, type4);
+    fileServiceBeginBatch (fs);
+    fileServiceSave (fs, type4, &entities[1]);
+    fileServiceSave (fs, type4, &entities[2]);
+    fileServiceEndBatch (fs);
+
+    if (0 != supFileServiceLoad (path, currency, network, type4, 0, 0, entities[1].identifier, &value))
+        return fileServiceTestDone (path, 0);
+
+    fileServiceEndBatch (fs);
+
+    if (2 != supFileServiceLoad (path, currency, network, type4, 0, 0, entities[1].identifier, &value) || 997 != value)
+        return fileServiceTestDone (path, 0);
+    fileServiceRelease (fs);
+
+    //
+    // Concurrent load; expect a log long enough to be split across threads to load in full.
+    //
+    char *type5 = "quux";
+    SupFileServiceEntity entity = { UINT256_ZERO, 0 };
+
+    fs = fileServiceCreate(path, currency, network, NULL, NULL);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    if (1 != fileServiceDefineType (fs, type5, 0, NULL,
+                                    supFileServiceEntityIdentifier,
+                                    supFileServiceEntityReader,
+                                    supFileServiceEntityWriter))
+        return fileServiceTestDone (path, 0);
+
+    for (uint32_t count = 0; count < 1000; count++) {
+        UInt32SetLE (entity.identifier.u8, count + 1);
+        entity.value = count;
+        fileServiceSave (fs, type5, &entity);
+    }
+
+    // One entity loads by its identifier alone; one never saved isn't found.
+    UInt32SetLE (entity.identifier.u8, 500);
+    SupFileServiceEntity *one = fileServiceLoadEntity (fs, type5, entity.identifier);
+    if (NULL == one || 499 != one->value) return fileServiceTestDone (path, 0);
+    free (one);
+
+    UInt32SetLE (entity.identifier.u8, 1001);
+    if (NULL != fileServiceLoadEntity (fs, type5, entity.identifier)) return fileServiceTestDone (path, 0);
+    UInt32SetLE (entity.identifier.u8, 1000);
+    fileServiceRelease (fs);
+
+    if (1000 != supFileServiceLoad (path, currency, network, type5, 1, 1, entity.identifier, &value) || 999 != value)
+        return fileServiceTestDone (path, 0);
+
+    //
+    // Damaged records; expect a record corrupted mid-log, and a torn one at its end, to be dropped
+    // alone, with the records after the first one kept, and the log rewritten without either.
+    //
+    char *type6 = "corge";
+    char logpath[1024];
+    size_t recordSize = 1 + sizeof (UInt256) + 1 + 2 * sizeof (uint32_t) + sizeof (UInt256) + sizeof (uint32_t);
+    sprintf (logpath, "%s/%s/%s/%s.log", path, currency, network, type6);
+
+    fs = fileServiceCreate(path, currency, network, NULL, NULL);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    if (1 != fileServiceDefineType (fs, type6, 0, NULL,
+                                    supFileServiceEntityIdentifier,
+                                    supFileServiceEntityReader,
+                                    supFileServiceEntityWriter))
+        return fileServiceTestDone (path, 0);
+
+    for (uint32_t count = 0; count < 3; count++) {
+        UInt32SetLE (entity.identifier.u8, count + 1);
+        entity.value = count;
+        fileServiceSave (fs, type6, &entity);
+    }
+    fileServiceRelease (fs);
+
+    FILE *log = fopen (logpath, "r+b");
+    if (NULL == log) return fileServiceTestDone (path, 0);
+    fseek (log, (long) (recordSize + recordSize / 2), SEEK_SET);
+    int byte = fgetc (log);
+    fseek (log, (long) (recordSize + recordSize / 2), SEEK_SET);
+    fputc (0xff ^ byte, log);
+    fseek (log, 0, SEEK_END);
+    fwrite ("torn", 1, 4, log);
+    fclose (log);
+
+    fs = fileServiceCreate(path, currency, network, NULL, NULL);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    if (1 != fileServiceDefineType (fs, type6, 0, NULL,
+                                    supFileServiceEntityIdentifier,
+                                    supFileServiceEntityReader,
+                                    supFileServiceEntityWriter) ||
+        1 != fileServiceDefineCurrentVersion (fs, type6, 0) ||
+        1 != fileServiceSetLoadRepair (fs, type6, 1))
+        return fileServiceTestDone (path, 0);
+
+    BRSet *loaded = BRSetNew (supFileServiceEntityHash, supFileServiceEntityEq, 10);
+    if (1 != fileServiceLoad (fs, loaded, type6, 1) || 2 != BRSetCount (loaded) ||
+        2 != fileServiceGetDroppedCount (fs, type6))
+        return fileServiceTestDone (path, 0);
+    BRSetApply (loaded, NULL, supFileServiceEntityRelease);
+    BRSetFree (loaded);
+    fileServiceRelease (fs);
+
+    if (0 != stat (logpath, &dirStat) || 2 * recordSize != (size_t) dirStat.st_size)
+        return fileServiceTestDone (path, 0);
+
+    UInt32SetLE (entity.identifier.u8, 3);
+    if (2 != supFileServiceLoad (path, currency, network, type6, 0, 0, entity.identifier, &value) || 2 != value)
+        return fileServiceTestDone (path, 0);
+
+    // An excluded entity is skipped, but stays saved
+    fs = fileServiceCreate(path, currency, network, NULL, NULL);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    if (1 != fileServiceDefineType (fs, type6, 0, NULL,
+                                    supFileServiceEntityIdentifier,
+                                    supFileServiceEntityReader,
+                                    supFileServiceEntityWriter) ||
+        1 != fileServiceDefineCurrentVersion (fs, type6, 0))
+        return fileServiceTestDone (path, 0);
+
+    loaded = BRSetNew (supFileServiceEntityHash, supFileServiceEntityEq, 10);
+    if (1 != fileServiceLoadExcept (fs, loaded, type6, 1, &entity.identifier, 1) || 1 != BRSetCount (loaded) ||
+        NULL != BRSetGet (loaded, &entity.identifier))
+        return fileServiceTestDone (path, 0);
+    BRSetApply (loaded, NULL, supFileServiceEntityRelease);
+    BRSetFree (loaded);
+
+    SupFileServiceEntity *excluded = fileServiceLoadEntity (fs, type6, entity.identifier);
+    if (NULL == excluded || 2 != excluded->value)
+        return fileServiceTestDone (path, 0);
+    free (excluded);
+    fileServiceRelease (fs);
+
     // Good, finally.
     return fileServiceTestDone(path, 1);
 }
@@ -390,6 +717,83 @@ runSupAssertTests (void) {
     return success;
 }
 
+///
+/// Stats
+///
+static int
+runSupStatsTests (void) {
+    printf ("==== SUP:Stats\n");
+    BRStats before, after;
+
+    BRStatsSnapshot (&before);
+    BRStatsCount (BRStatsFileServiceBytes, 10);
+    BRStatsCount (BRStatsFileServiceBytes, 5);
+    BRStatsRecord (BRStatsFileServiceWriteTime, 0);
+    BRStatsRecord (BRStatsFileServiceWriteTime, 1);
+    BRStatsRecord (BRStatsFileServiceWriteTime, 5);
+    BRStatsSnapshot (&after);
+
+    BRStatsHistogram *b = &before.histograms[BRStatsFileServiceWriteTime];
+    BRStatsHistogram *a = &after.histograms[BRStatsFileServiceWriteTime];
+
+    if (15 != after.counters[BRStatsFileServiceBytes] - before.counters[BRStatsFileServiceBytes]) return 0;
+    if (3 != a->count - b->count || 6 != a->sum - b->sum) return 0;
+    if (1 != a->buckets[0] - b->buckets[0] || // 0
+        1 != a->buckets[1] - b->buckets[1] || // [1, 2)
+        1 != a->buckets[3] - b->buckets[3])   // [4, 8)
+        return 0;
+    if (BRStatsMicroseconds () > BRStatsMicroseconds ()) return 0;
+
+    // Trace - truncated to the buffer, but always the complete length; spans only with BR_TRACE
+    char json[4096];
+    BR_TRACE_ADD (BRTraceWalletUpdate, 10, 25, 7);
+    size_t jsonLen = BRTraceChromeJSON (json, sizeof (json));
+    if (jsonLen != BRTraceChromeJSON (NULL, 0) || jsonLen != BRTraceChromeJSON (json, 8)) return 0;
+    if (7 != strlen (json) || 0 != strcmp (json, "{\"trace")) return 0;
+
+    BRTraceChromeJSON (json, sizeof (json));
+    if (0 != strncmp (json, "{\"traceEvents\":[", 16) || 0 != strcmp (&json[jsonLen - 2], "]}")) return 0;
+#ifdef BR_TRACE
+    if (NULL == strstr (json, "\"name\":\"wallet update\",\"cat\":\"bitcoin\",\"ph\":\"X\"")) return 0;
+    if (NULL == strstr (json, "\"ts\":10,\"dur\":15,\"args\":{\"id\":7}}")) return 0;
+#endif
+
+    return 1;
+}
+
+///
+/// Fee Estimator
+///
+static int
+runSupFeeEstimatorTests (void) {
+    printf ("==== SUP:FeeEstimator\n");
+    BRFeeEstimator *estimator = BRFeeEstimatorNew (1000, 1000000);
+    uint32_t height = 100;
+    UInt256 txHash = UINT256_ZERO, confirmed[4];
+    int success = 1;
+
+    BRFeeEstimatorAddBlock (estimator, height, NULL, 0);
+    if (0 != BRFeeEstimatorEstimate (estimator, 2)) success = 0;
+
+    // Every block, four txs paying 50000 confirm in the next block and four paying 2000 never do
+    for (uint32_t block = 0; block < 50; block++) {
+        for (uint32_t i = 0; i < 8; i++) {
+            txHash.u32[0] = block*8 + i + 1;
+            BRFeeEstimatorAddTx (estimator, txHash, (i < 4) ? 50000 : 2000, height);
+            if (i < 4) confirmed[i] = txHash;
+        }
+
+        BRFeeEstimatorAddBlock (estimator, ++height, confirmed, 4);
+    }
+
+    uint64_t feeRate = BRFeeEstimatorEstimate (estimator, 2);
+    if (feeRate <= 2000 || feeRate < 50000 || feeRate > 60000) success = 0;
+    if (feeRate != BRFeeEstimatorEstimate (estimator, BR_FEE_ESTIMATOR_MAX_TARGET + 10)) success = 0;
+
+    BRFeeEstimatorFree (estimator);
+    return success;
+}
+
 ///
 /// Support Tests
 ///
@@ -399,6 +803,8 @@ int BRRunSupTests (void) {
 
     success &= runSupFileServiceTests();
     success &= runSupAssertTests();
+    success &= runSupStatsTests();
+    success &= runSupFeeEstimatorTests();
 
     return success;
 }